@@ -0,0 +1,197 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar.h
+ *	  Header for the columnar table access method.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/columnar/columnar.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#include "access/relscan.h"
+#include "access/skey.h"
+#include "access/tupdesc.h"
+#include "access/xact.h"
+#include "executor/tuptable.h"
+#include "storage/itemptr.h"
+#include "storage/relfilenode.h"
+#include "utils/rel.h"
+#include "utils/snapshot.h"
+
+/*
+ * A columnar table's main fork consists of a metapage followed by data pages.
+ * The data pages hold a single append-only byte stream (addressed by
+ * "logical offsets"), in which each stripe is stored as a header, an array
+ * of chunk descriptors, and the chunks themselves.  A stripe holds the rows
+ * inserted by a single command, column by column, split into groups of
+ * chunk_rows rows; each (row group, column) pair is a chunk, compressed
+ * separately and carrying the minimum and maximum of its values.
+ */
+
+/* Preserved page numbers */
+#define COLUMNAR_METAPAGE_BLKNO		0
+#define COLUMNAR_FIRST_DATA_BLKNO	1
+
+/* Bytes of the logical stream stored on each data page */
+#define COLUMNAR_BYTES_PER_PAGE		(BLCKSZ - MAXALIGN(SizeOfPageHeaderData))
+
+#define COLUMNAR_MAGIC				0x434F4C31	/* "COL1" */
+#define COLUMNAR_STRIPE_MAGIC		0x53545231	/* "STR1" */
+#define COLUMNAR_VERSION			1
+
+/*
+ * Rows are identified by row numbers, which are mapped to item pointers so
+ * that they can be used as TIDs.  The mapping stays clear of offset number
+ * zero and the upper bits of the offset, which other code may use for flags.
+ */
+#define COLUMNAR_ROWS_PER_BLOCK		MaxHeapTuplesPerPage
+#define COLUMNAR_MAX_ROW_NUMBER \
+	((uint64) MaxBlockNumber * COLUMNAR_ROWS_PER_BLOCK)
+
+/* Contents of the metapage */
+typedef struct ColumnarMetaPageData
+{
+	uint32		magic;			/* COLUMNAR_MAGIC */
+	uint32		version;		/* COLUMNAR_VERSION */
+	uint64		data_end;		/* logical end of the stripe data */
+	uint64		nstripes;		/* number of stripes, visible or not */
+	uint64		next_row;		/* first row number not yet reserved */
+} ColumnarMetaPageData;
+
+/*
+ * Header of a stripe.  The stripe's rows have row numbers first_row to
+ * first_row + nrows - 1.  xmin and cmin are the transaction and command that
+ * inserted them; VACUUM sets xmin to FrozenTransactionId once the stripe is
+ * visible to everyone, and to InvalidTransactionId if the inserting
+ * transaction aborted.
+ */
+typedef struct ColumnarStripeHeader
+{
+	uint32		magic;			/* COLUMNAR_STRIPE_MAGIC */
+	uint32		natts;			/* number of columns stored */
+	TransactionId xmin;
+	CommandId	cmin;
+	uint64		length;			/* total length, including this header */
+	uint64		first_row;
+	uint32		nrows;
+	uint32		chunk_rows;		/* rows per row group */
+	uint32		nchunks;		/* number of row groups */
+	uint32		unused;
+	/* ColumnarChunk chunks[nchunks * natts] follow, row group-major */
+} ColumnarStripeHeader;
+
+/* Descriptor of one chunk of column data */
+typedef struct ColumnarChunk
+{
+	uint64		offset;			/* offset of the data within the stripe */
+	uint32		length;			/* stored length of the data */
+	uint32		rawlength;		/* length after decompression */
+	uint64		min;			/* smallest value, if CHUNK_HAS_MINMAX */
+	uint64		max;			/* largest value, if CHUNK_HAS_MINMAX */
+	uint16		flags;			/* see below */
+	uint16		unused1;
+	uint32		unused2;
+} ColumnarChunk;
+
+#define CHUNK_COMPRESSED	0x0001	/* data is pglz-compressed */
+#define CHUNK_HAS_NULLS		0x0002	/* data starts with a null bitmap */
+#define CHUNK_ALL_NULLS		0x0004	/* no data, every value is null */
+#define CHUNK_HAS_MINMAX	0x0008	/* min and max are valid */
+
+#define StripeHeaderSize(natts, nchunks) \
+	MAXALIGN(sizeof(ColumnarStripeHeader) + \
+			 sizeof(ColumnarChunk) * (natts) * (nchunks))
+
+/* A stripe header as read into memory */
+typedef struct ColumnarStripe
+{
+	uint64		offset;			/* logical offset of the stripe */
+	ColumnarStripeHeader hdr;
+	ColumnarChunk *chunks;
+} ColumnarStripe;
+
+#define StripeChunk(stripe, chunkno, attno) \
+	(&(stripe)->chunks[(chunkno) * (stripe)->hdr.natts + (attno)])
+
+/* Shared state of a parallel scan: stripes are handed out one at a time */
+typedef struct ParallelColumnarScanDescData
+{
+	ParallelTableScanDescData base;
+	uint64		data_end;		/* logical end of the data to scan */
+	pg_atomic_uint64 next_stripe;
+} ParallelColumnarScanDescData;
+typedef struct ParallelColumnarScanDescData *ParallelColumnarScanDesc;
+
+/* State of a scan of one relation, in columnar_reader.c */
+typedef struct ColumnarReadState ColumnarReadState;
+
+/* GUC variables */
+extern int	columnar_stripe_row_limit;
+extern int	columnar_chunk_row_limit;
+extern bool columnar_compression;
+
+/* columnar_storage.c */
+extern bool columnar_read_metapage(Relation rel, ColumnarMetaPageData *meta);
+extern void columnar_write_metapage(Relation rel, ColumnarMetaPageData *meta);
+extern void columnar_storage_read(Relation rel, uint64 offset, char *dst,
+								  uint64 len);
+extern void columnar_storage_write(Relation rel, uint64 offset,
+								   const char *src, uint64 len);
+extern uint64 columnar_reserve_rows(Relation rel, uint64 nrows);
+extern List *columnar_read_stripes(Relation rel, uint64 data_end);
+extern void columnar_rewrite_stripe_xmin(Relation rel, ColumnarStripe *stripe,
+										 TransactionId xmin);
+
+/* columnar_writer.c */
+extern void columnar_insert_row(Relation rel, TupleTableSlot *slot,
+								TransactionId xid, CommandId cid);
+extern void columnar_flush_writes(Relation rel);
+extern void columnar_discard_writes(Relation rel);
+extern bool columnar_fetch_pending_row(Relation rel, uint64 rownum,
+									   Snapshot snapshot, TupleTableSlot *slot);
+extern void columnar_writer_xact_callback(XactEvent event, void *arg);
+extern void columnar_writer_subxact_callback(SubXactEvent event,
+											 SubTransactionId mySubid,
+											 SubTransactionId parentSubid,
+											 void *arg);
+
+/* columnar_reader.c */
+extern ColumnarReadState *columnar_begin_read(Relation rel, Snapshot snapshot,
+											  ParallelColumnarScanDesc pscan);
+extern void columnar_set_read_hints(ColumnarReadState *state,
+									Bitmapset *attrs,
+									int nkeys, ScanKey keys);
+extern void columnar_rescan_read(ColumnarReadState *state);
+extern void columnar_end_read(ColumnarReadState *state);
+extern bool columnar_read_next_row(ColumnarReadState *state,
+								   TupleTableSlot *slot);
+extern uint64 columnar_read_max_row(ColumnarReadState *state);
+extern void columnar_read_set_range(ColumnarReadState *state,
+									uint64 first_row, uint64 end_row);
+extern bool columnar_read_row(ColumnarReadState *state, uint64 rownum,
+							  TupleTableSlot *slot);
+extern List *columnar_read_state_stripes(ColumnarReadState *state);
+extern bool columnar_xmin_visible(TransactionId xmin, CommandId cmin,
+								  Snapshot snapshot);
+
+/* Conversion between row numbers and item pointers */
+static inline void
+columnar_row_to_tid(uint64 rownum, ItemPointer tid)
+{
+	ItemPointerSet(tid, (BlockNumber) (rownum / COLUMNAR_ROWS_PER_BLOCK),
+				   (OffsetNumber) (rownum % COLUMNAR_ROWS_PER_BLOCK + 1));
+}
+
+static inline uint64
+columnar_tid_to_row(ItemPointer tid)
+{
+	return (uint64) ItemPointerGetBlockNumber(tid) * COLUMNAR_ROWS_PER_BLOCK +
+		ItemPointerGetOffsetNumber(tid) - 1;
+}
+
+#endif							/* COLUMNAR_H */
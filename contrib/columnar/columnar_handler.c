@@ -0,0 +1,942 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_handler.c
+ *		Table access method interface of columnar tables.
+ *
+ * Columnar tables are append-only: rows can be inserted, and are removed by
+ * TRUNCATE, but not updated or deleted.  They can't have indexes.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/columnar/columnar_handler.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/heapam.h"
+#include "access/multixact.h"
+#include "access/tableam.h"
+#include "access/tsmapi.h"
+#include "catalog/index.h"
+#include "catalog/storage.h"
+#include "catalog/storage_xlog.h"
+#include "commands/vacuum.h"
+#include "executor/tuptable.h"
+#include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "pgstat.h"
+#include "storage/bufmgr.h"
+#include "storage/procarray.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/snapmgr.h"
+
+#include "columnar.h"
+
+PG_MODULE_MAGIC;
+
+/* GUC variables */
+int			columnar_stripe_row_limit = 150000;
+int			columnar_chunk_row_limit = 10000;
+bool		columnar_compression = true;
+
+typedef struct ColumnarScanDescData
+{
+	TableScanDescData rs_base;
+	ColumnarReadState *state;
+
+	/* for ANALYZE and sample scans, which work on row number "blocks" */
+	BlockNumber nblocks;
+	BlockNumber cblock;			/* current block, or InvalidBlockNumber */
+} ColumnarScanDescData;
+typedef struct ColumnarScanDescData *ColumnarScanDesc;
+
+static const TableAmRoutine columnar_methods;
+
+void		_PG_init(void);
+
+PG_FUNCTION_INFO_V1(columnar_tableam_handler);
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	DefineCustomIntVariable("columnar.stripe_row_limit",
+							"Sets the maximum number of rows per stripe.",
+							NULL,
+							&columnar_stripe_row_limit,
+							150000,
+							1000, 1000000,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("columnar.chunk_row_limit",
+							"Sets the number of rows per row group within a stripe.",
+							"Row groups are the unit that scans skip based on their minimum and maximum values.",
+							&columnar_chunk_row_limit,
+							10000,
+							1000, 100000,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("columnar.compression",
+							 "Compresses column data of newly written stripes.",
+							 NULL,
+							 &columnar_compression,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	RegisterXactCallback(columnar_writer_xact_callback, NULL);
+	RegisterSubXactCallback(columnar_writer_subxact_callback, NULL);
+}
+
+Datum
+columnar_tableam_handler(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_POINTER(&columnar_methods);
+}
+
+static void
+columnar_unsupported(const char *what)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("columnar tables do not support %s", what)));
+}
+
+
+/* ------------------------------------------------------------------------
+ * Slot related callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static const TupleTableSlotOps *
+columnar_slot_callbacks(Relation relation)
+{
+	return &TTSOpsVirtual;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Sequential scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static TableScanDesc
+columnar_beginscan(Relation relation, Snapshot snapshot,
+				   int nkeys, ScanKey key,
+				   ParallelTableScanDesc parallel_scan,
+				   uint32 flags)
+{
+	ColumnarScanDesc scan;
+
+	if (nkeys > 0)
+		elog(ERROR, "scan keys are not supported by columnar tables");
+
+	scan = (ColumnarScanDesc) palloc0(sizeof(ColumnarScanDescData));
+	scan->rs_base.rs_rd = relation;
+	scan->rs_base.rs_snapshot = snapshot;
+	scan->rs_base.rs_nkeys = 0;
+	scan->rs_base.rs_key = NULL;
+	scan->rs_base.rs_flags = flags;
+	scan->rs_base.rs_parallel = parallel_scan;
+
+	scan->state = columnar_begin_read(relation,
+									  (flags & SO_TYPE_ANALYZE) ? NULL : snapshot,
+									  (ParallelColumnarScanDesc) parallel_scan);
+
+	if (flags & SO_TYPE_ANALYZE)
+		scan->nblocks = RelationGetNumberOfBlocks(relation);
+	else
+		scan->nblocks = (columnar_read_max_row(scan->state) +
+						 COLUMNAR_ROWS_PER_BLOCK - 1) / COLUMNAR_ROWS_PER_BLOCK;
+	scan->cblock = InvalidBlockNumber;
+
+	return (TableScanDesc) scan;
+}
+
+static void
+columnar_endscan(TableScanDesc sscan)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	columnar_end_read(scan->state);
+
+	if (scan->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
+		UnregisterSnapshot(scan->rs_base.rs_snapshot);
+
+	pfree(scan);
+}
+
+static void
+columnar_rescan(TableScanDesc sscan, ScanKey key, bool set_params,
+				bool allow_strat, bool allow_sync, bool allow_pagemode)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	columnar_rescan_read(scan->state);
+	scan->cblock = InvalidBlockNumber;
+}
+
+static bool
+columnar_getnextslot(TableScanDesc sscan, ScanDirection direction,
+					 TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	if (ScanDirectionIsBackward(direction))
+		columnar_unsupported("backward scans");
+
+	if (!columnar_read_next_row(scan->state, slot))
+	{
+		ExecClearTuple(slot);
+		return false;
+	}
+
+	pgstat_count_heap_getnext(scan->rs_base.rs_rd);
+	return true;
+}
+
+static void
+columnar_scan_set_column_hints(TableScanDesc sscan, Bitmapset *attrs,
+							   int nkeys, ScanKey keys)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	columnar_set_read_hints(scan->state, attrs, nkeys, keys);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Parallel scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static Size
+columnar_parallelscan_estimate(Relation rel)
+{
+	return sizeof(ParallelColumnarScanDescData);
+}
+
+/*
+ * Set up a parallel scan.  This runs in the leader before any worker starts,
+ * so it's where the leader's pending rows are written out, and where it's
+ * decided how much data the participants are going to read.
+ */
+static Size
+columnar_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan)
+{
+	ParallelColumnarScanDesc cpscan = (ParallelColumnarScanDesc) pscan;
+	ColumnarMetaPageData meta;
+
+	columnar_flush_writes(rel);
+	columnar_read_metapage(rel, &meta);
+
+	cpscan->base.phs_relid = RelationGetRelid(rel);
+	cpscan->base.phs_syncscan = false;
+	cpscan->data_end = meta.data_end;
+	pg_atomic_init_u64(&cpscan->next_stripe, 0);
+
+	return sizeof(ParallelColumnarScanDescData);
+}
+
+static void
+columnar_parallelscan_reinitialize(Relation rel, ParallelTableScanDesc pscan)
+{
+	ParallelColumnarScanDesc cpscan = (ParallelColumnarScanDesc) pscan;
+	ColumnarMetaPageData meta;
+
+	columnar_flush_writes(rel);
+	columnar_read_metapage(rel, &meta);
+
+	cpscan->data_end = meta.data_end;
+	pg_atomic_write_u64(&cpscan->next_stripe, 0);
+}
+
+
+/* ------------------------------------------------------------------------
+ * Index scan callbacks for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static IndexFetchTableData *
+columnar_index_fetch_begin(Relation rel)
+{
+	columnar_unsupported("indexes");
+	return NULL;				/* keep compiler quiet */
+}
+
+static void
+columnar_index_fetch_reset(IndexFetchTableData *scan)
+{
+	columnar_unsupported("indexes");
+}
+
+static void
+columnar_index_fetch_end(IndexFetchTableData *scan)
+{
+	columnar_unsupported("indexes");
+}
+
+static bool
+columnar_index_fetch_tuple(struct IndexFetchTableData *scan,
+						   ItemPointer tid,
+						   Snapshot snapshot,
+						   TupleTableSlot *slot,
+						   bool *call_again, bool *all_dead)
+{
+	columnar_unsupported("indexes");
+	return false;				/* keep compiler quiet */
+}
+
+
+/* ------------------------------------------------------------------------
+ * Callbacks for non-modifying operations on individual tuples for columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Fetch a single row.  Setting up a reader means reading the whole stripe
+ * directory, which is fine for the rare callers of this: AFTER triggers
+ * usually find their rows still buffered.
+ */
+static bool
+columnar_fetch_row_version(Relation relation, ItemPointer tid,
+						   Snapshot snapshot, TupleTableSlot *slot)
+{
+	uint64		rownum = columnar_tid_to_row(tid);
+	ColumnarReadState *state;
+	bool		found;
+
+	if (columnar_fetch_pending_row(relation, rownum, snapshot, slot))
+		return true;
+
+	state = columnar_begin_read(relation, snapshot, NULL);
+	found = columnar_read_row(state, rownum, slot);
+	if (found)
+		ExecMaterializeSlot(slot);
+	columnar_end_read(state);
+
+	return found;
+}
+
+static bool
+columnar_tuple_tid_valid(TableScanDesc sscan, ItemPointer tid)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	return ItemPointerIsValid(tid) &&
+		columnar_tid_to_row(tid) < columnar_read_max_row(scan->state);
+}
+
+static void
+columnar_get_latest_tid(TableScanDesc sscan, ItemPointer tid)
+{
+	/* rows are never updated, so every row is its own latest version */
+}
+
+static bool
+columnar_tuple_satisfies_snapshot(Relation rel, TupleTableSlot *slot,
+								  Snapshot snapshot)
+{
+	TupleTableSlot *tmpslot;
+	bool		result;
+
+	tmpslot = MakeSingleTupleTableSlot(RelationGetDescr(rel), &TTSOpsVirtual);
+	result = columnar_fetch_row_version(rel, &slot->tts_tid, snapshot, tmpslot);
+	ExecDropSingleTupleTableSlot(tmpslot);
+
+	return result;
+}
+
+static TransactionId
+columnar_compute_xid_horizon_for_tuples(Relation rel,
+										ItemPointerData *tids,
+										int nitems)
+{
+	columnar_unsupported("indexes");
+	return InvalidTransactionId;	/* keep compiler quiet */
+}
+
+
+/* ----------------------------------------------------------------------------
+ *  Functions for manipulations of physical tuples for columnar AM.
+ * ----------------------------------------------------------------------------
+ */
+
+static void
+columnar_tuple_insert(Relation relation, TupleTableSlot *slot, CommandId cid,
+					  int options, BulkInsertState bistate)
+{
+	columnar_insert_row(relation, slot, GetCurrentTransactionId(), cid);
+	pgstat_count_heap_insert(relation, 1);
+}
+
+static void
+columnar_tuple_insert_speculative(Relation relation, TupleTableSlot *slot,
+								  CommandId cid, int options,
+								  BulkInsertState bistate, uint32 specToken)
+{
+	columnar_unsupported("INSERT ... ON CONFLICT");
+}
+
+static void
+columnar_tuple_complete_speculative(Relation relation, TupleTableSlot *slot,
+									uint32 specToken, bool succeeded)
+{
+	columnar_unsupported("INSERT ... ON CONFLICT");
+}
+
+static void
+columnar_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
+					  CommandId cid, int options, BulkInsertState bistate)
+{
+	TransactionId xid = GetCurrentTransactionId();
+	int			i;
+
+	for (i = 0; i < ntuples; i++)
+		columnar_insert_row(relation, slots[i], xid, cid);
+	pgstat_count_heap_insert(relation, ntuples);
+}
+
+static TM_Result
+columnar_tuple_delete(Relation relation, ItemPointer tid, CommandId cid,
+					  Snapshot snapshot, Snapshot crosscheck, bool wait,
+					  TM_FailureData *tmfd, bool changingPart)
+{
+	columnar_unsupported("UPDATE and DELETE");
+	return TM_Invisible;		/* keep compiler quiet */
+}
+
+static TM_Result
+columnar_tuple_update(Relation relation, ItemPointer otid, TupleTableSlot *slot,
+					  CommandId cid, Snapshot snapshot, Snapshot crosscheck,
+					  bool wait, TM_FailureData *tmfd,
+					  LockTupleMode *lockmode, bool *update_indexes)
+{
+	columnar_unsupported("UPDATE and DELETE");
+	return TM_Invisible;		/* keep compiler quiet */
+}
+
+static TM_Result
+columnar_tuple_lock(Relation relation, ItemPointer tid, Snapshot snapshot,
+					TupleTableSlot *slot, CommandId cid, LockTupleMode mode,
+					LockWaitPolicy wait_policy, uint8 flags,
+					TM_FailureData *tmfd)
+{
+	columnar_unsupported("row locks");
+	return TM_Invisible;		/* keep compiler quiet */
+}
+
+static void
+columnar_finish_bulk_insert(Relation relation, int options)
+{
+	columnar_flush_writes(relation);
+}
+
+
+/* ------------------------------------------------------------------------
+ * DDL related callbacks for columnar AM.
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_relation_set_new_filenode(Relation rel,
+								   const RelFileNode *newrnode,
+								   char persistence,
+								   TransactionId *freezeXid,
+								   MultiXactId *minmulti)
+{
+	SMgrRelation srel;
+
+	/*
+	 * Rows buffered so far belong in the old storage, which is what a
+	 * rollback goes back to.
+	 */
+	columnar_flush_writes(rel);
+
+	/* see heapam_relation_set_new_filenode() */
+	*freezeXid = RecentXmin;
+	*minmulti = GetOldestMultiXactId();
+
+	srel = RelationCreateStorage(*newrnode, persistence);
+
+	if (persistence == RELPERSISTENCE_UNLOGGED)
+	{
+		Assert(rel->rd_rel->relkind == RELKIND_RELATION ||
+			   rel->rd_rel->relkind == RELKIND_MATVIEW);
+		smgrcreate(srel, INIT_FORKNUM, false);
+		log_smgrcreate(newrnode, INIT_FORKNUM);
+		smgrimmedsync(srel, INIT_FORKNUM);
+	}
+
+	smgrclose(srel);
+}
+
+static void
+columnar_relation_nontransactional_truncate(Relation rel)
+{
+	columnar_discard_writes(rel);
+	RelationTruncate(rel, 0);
+}
+
+static void
+columnar_relation_copy_data(Relation rel, const RelFileNode *newrnode)
+{
+	SMgrRelation dstrel;
+
+	columnar_flush_writes(rel);
+
+	dstrel = smgropen(*newrnode, rel->rd_backend);
+	RelationOpenSmgr(rel);
+
+	/* see heapam_relation_copy_data() */
+	FlushRelationBuffers(rel);
+
+	RelationCreateStorage(*newrnode, rel->rd_rel->relpersistence);
+
+	RelationCopyStorage(rel->rd_smgr, dstrel, MAIN_FORKNUM,
+						rel->rd_rel->relpersistence);
+
+	for (ForkNumber forkNum = MAIN_FORKNUM + 1;
+		 forkNum <= MAX_FORKNUM; forkNum++)
+	{
+		if (smgrexists(rel->rd_smgr, forkNum))
+		{
+			smgrcreate(dstrel, forkNum, false);
+
+			if (rel->rd_rel->relpersistence == RELPERSISTENCE_PERMANENT ||
+				(rel->rd_rel->relpersistence == RELPERSISTENCE_UNLOGGED &&
+				 forkNum == INIT_FORKNUM))
+				log_smgrcreate(newrnode, forkNum);
+			RelationCopyStorage(rel->rd_smgr, dstrel, forkNum,
+								rel->rd_rel->relpersistence);
+		}
+	}
+
+	/* drop old relation, and close new one */
+	RelationDropStorage(rel);
+	smgrclose(dstrel);
+}
+
+/*
+ * VACUUM FULL: copy the rows of each stripe that's still of use into a new
+ * stripe, freezing them if they're old enough.  Stripes of aborted
+ * transactions, and the space wasted by them and by partially used row
+ * number reservations, go away.
+ */
+static void
+columnar_relation_copy_for_cluster(Relation OldTable, Relation NewTable,
+								   Relation OldIndex, bool use_sort,
+								   TransactionId OldestXmin,
+								   TransactionId *xid_cutoff,
+								   MultiXactId *multi_cutoff,
+								   double *num_tuples,
+								   double *tups_vacuumed,
+								   double *tups_recently_dead)
+{
+	ColumnarReadState *state;
+	TupleTableSlot *slot;
+	ListCell   *lc;
+
+	if (OldIndex != NULL)
+		columnar_unsupported("indexes");
+
+	*num_tuples = 0;
+	*tups_vacuumed = 0;
+	*tups_recently_dead = 0;
+
+	state = columnar_begin_read(OldTable, SnapshotAny, NULL);
+	slot = MakeSingleTupleTableSlot(RelationGetDescr(OldTable), &TTSOpsVirtual);
+
+	foreach(lc, columnar_read_state_stripes(state))
+	{
+		ColumnarStripe *stripe = (ColumnarStripe *) lfirst(lc);
+		TransactionId xmin = stripe->hdr.xmin;
+
+		if (!TransactionIdIsValid(xmin) ||
+			(TransactionIdIsNormal(xmin) &&
+			 !TransactionIdIsCurrentTransactionId(xmin) &&
+			 !TransactionIdIsInProgress(xmin) &&
+			 !TransactionIdDidCommit(xmin)))
+		{
+			*tups_vacuumed += stripe->hdr.nrows;
+			continue;
+		}
+
+		if (TransactionIdIsNormal(xmin) &&
+			TransactionIdPrecedes(xmin, *xid_cutoff))
+			xmin = FrozenTransactionId;
+
+		columnar_read_set_range(state, stripe->hdr.first_row,
+								stripe->hdr.first_row + stripe->hdr.nrows);
+		while (columnar_read_next_row(state, slot))
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			columnar_insert_row(NewTable, slot, xmin, stripe->hdr.cmin);
+			*num_tuples += 1;
+		}
+	}
+
+	columnar_flush_writes(NewTable);
+
+	ExecDropSingleTupleTableSlot(slot);
+	columnar_end_read(state);
+}
+
+/*
+ * VACUUM: there's nothing to remove, but the xmins of stripes need to be
+ * frozen, and those of aborted transactions marked dead, before clog
+ * truncation makes them meaningless.  Every stripe older than OldestXmin is
+ * dealt with, so relfrozenxid can be advanced to OldestXmin.
+ */
+static void
+columnar_relation_vacuum(Relation rel, VacuumParams *params,
+						 BufferAccessStrategy bstrategy)
+{
+	TransactionId OldestXmin;
+	TransactionId FreezeLimit;
+	TransactionId xidFullScanLimit;
+	MultiXactId MultiXactCutoff;
+	MultiXactId mxactFullScanLimit;
+	ColumnarMetaPageData meta;
+	List	   *stripes;
+	ListCell   *lc;
+	double		live_rows = 0;
+	double		dead_rows = 0;
+
+	vacuum_set_xid_limits(rel,
+						  params->freeze_min_age,
+						  params->freeze_table_age,
+						  params->multixact_freeze_min_age,
+						  params->multixact_freeze_table_age,
+						  &OldestXmin, &FreezeLimit, &xidFullScanLimit,
+						  &MultiXactCutoff, &mxactFullScanLimit);
+
+	columnar_read_metapage(rel, &meta);
+	stripes = columnar_read_stripes(rel, meta.data_end);
+
+	foreach(lc, stripes)
+	{
+		ColumnarStripe *stripe = (ColumnarStripe *) lfirst(lc);
+		TransactionId xmin = stripe->hdr.xmin;
+
+		vacuum_delay_point();
+
+		if (!TransactionIdIsValid(xmin))
+			dead_rows += stripe->hdr.nrows;
+		else if (!TransactionIdIsNormal(xmin))
+			live_rows += stripe->hdr.nrows;
+		else if (!TransactionIdPrecedes(xmin, OldestXmin))
+		{
+			/* still in progress, or not yet visible to everyone */
+			if (TransactionIdDidCommit(xmin))
+				live_rows += stripe->hdr.nrows;
+		}
+		else if (TransactionIdDidCommit(xmin))
+		{
+			columnar_rewrite_stripe_xmin(rel, stripe, FrozenTransactionId);
+			live_rows += stripe->hdr.nrows;
+		}
+		else
+		{
+			/* aborted, or crashed */
+			columnar_rewrite_stripe_xmin(rel, stripe, InvalidTransactionId);
+			dead_rows += stripe->hdr.nrows;
+		}
+	}
+
+	vac_update_relstats(rel,
+						RelationGetNumberOfBlocks(rel),
+						live_rows,
+						0,
+						false,
+						OldestXmin,
+						MultiXactCutoff,
+						false);
+
+	pgstat_report_vacuum(RelationGetRelid(rel),
+						 rel->rd_rel->relisshared,
+						 live_rows,
+						 dead_rows,
+						 InvalidBlockNumber);
+}
+
+/*
+ * ANALYZE samples blocks of the relation, but rows aren't stored in blocks.
+ * Map each block to an equally sized range of row numbers instead, so that
+ * the sample is spread evenly over the rows.
+ */
+static bool
+columnar_scan_analyze_next_block(TableScanDesc sscan, BlockNumber blockno,
+								 BufferAccessStrategy bstrategy)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	double		max_row = (double) columnar_read_max_row(scan->state);
+	uint64		first_row;
+	uint64		end_row;
+
+	if (scan->nblocks == 0)
+		return false;
+
+	first_row = (uint64) (max_row * blockno / scan->nblocks);
+	end_row = (uint64) (max_row * (blockno + 1) / scan->nblocks);
+	columnar_read_set_range(scan->state, first_row, end_row);
+
+	return true;
+}
+
+static bool
+columnar_scan_analyze_next_tuple(TableScanDesc sscan, TransactionId OldestXmin,
+								 double *liverows, double *deadrows,
+								 TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+
+	if (!columnar_read_next_row(scan->state, slot))
+	{
+		ExecClearTuple(slot);
+		return false;
+	}
+
+	*liverows += 1;
+	return true;
+}
+
+static double
+columnar_index_build_range_scan(Relation table_rel,
+								Relation index_rel,
+								IndexInfo *index_info,
+								bool allow_sync,
+								bool anyvisible,
+								bool progress,
+								BlockNumber start_blockno,
+								BlockNumber numblocks,
+								IndexBuildCallback callback,
+								void *callback_state,
+								TableScanDesc scan)
+{
+	columnar_unsupported("indexes");
+	return 0;					/* keep compiler quiet */
+}
+
+static void
+columnar_index_validate_scan(Relation table_rel,
+							 Relation index_rel,
+							 IndexInfo *index_info,
+							 Snapshot snapshot,
+							 ValidateIndexState *state)
+{
+	columnar_unsupported("indexes");
+}
+
+
+/* ------------------------------------------------------------------------
+ * Miscellaneous callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static uint64
+columnar_relation_size(Relation rel, ForkNumber forkNumber)
+{
+	uint64		nblocks = 0;
+
+	RelationOpenSmgr(rel);
+
+	/* InvalidForkNumber indicates returning the size for all forks */
+	if (forkNumber == InvalidForkNumber)
+	{
+		for (int i = 0; i < MAX_FORKNUM; i++)
+			nblocks += smgrnblocks(rel->rd_smgr, i);
+	}
+	else
+		nblocks = smgrnblocks(rel->rd_smgr, forkNumber);
+
+	return nblocks * BLCKSZ;
+}
+
+/*
+ * Values are stored inline and compressed by us, so no TOAST table.
+ */
+static bool
+columnar_relation_needs_toast_table(Relation rel)
+{
+	return false;
+}
+
+
+/* ------------------------------------------------------------------------
+ * Planner related callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+static void
+columnar_estimate_rel_size(Relation rel, int32 *attr_widths,
+						   BlockNumber *pages, double *tuples,
+						   double *allvisfrac)
+{
+	BlockNumber curpages = RelationGetNumberOfBlocks(rel);
+	BlockNumber relpages = (BlockNumber) rel->rd_rel->relpages;
+
+	*pages = curpages;
+	*allvisfrac = 0;
+
+	if (curpages == 0)
+		*tuples = 0;
+	else if (relpages > 0)
+		*tuples = rint(rel->rd_rel->reltuples / relpages * curpages);
+	else
+	{
+		/* never vacuumed or analyzed; count the rows of all stripes */
+		ColumnarMetaPageData meta;
+		ListCell   *lc;
+
+		columnar_read_metapage(rel, &meta);
+		*tuples = 0;
+		foreach(lc, columnar_read_stripes(rel, meta.data_end))
+			*tuples += ((ColumnarStripe *) lfirst(lc))->hdr.nrows;
+	}
+}
+
+
+/* ------------------------------------------------------------------------
+ * Executor related callbacks for the columnar AM
+ * ------------------------------------------------------------------------
+ */
+
+/*
+ * Sample scans see the rows as COLUMNAR_ROWS_PER_BLOCK rows per block, as
+ * they're numbered by their TIDs.
+ */
+static bool
+columnar_scan_sample_next_block(TableScanDesc sscan, SampleScanState *scanstate)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	TsmRoutine *tsm = scanstate->tsmroutine;
+	BlockNumber blockno;
+
+	if (scan->nblocks == 0)
+		return false;
+
+	if (tsm->NextSampleBlock)
+		blockno = tsm->NextSampleBlock(scanstate, scan->nblocks);
+	else if (scan->cblock == InvalidBlockNumber)
+		blockno = 0;
+	else if (scan->cblock + 1 < scan->nblocks)
+		blockno = scan->cblock + 1;
+	else
+		blockno = InvalidBlockNumber;
+
+	scan->cblock = blockno;
+
+	return BlockNumberIsValid(blockno);
+}
+
+static bool
+columnar_scan_sample_next_tuple(TableScanDesc sscan, SampleScanState *scanstate,
+								TupleTableSlot *slot)
+{
+	ColumnarScanDesc scan = (ColumnarScanDesc) sscan;
+	TsmRoutine *tsm = scanstate->tsmroutine;
+
+	for (;;)
+	{
+		OffsetNumber tupoffset;
+		ItemPointerData tid;
+
+		CHECK_FOR_INTERRUPTS();
+
+		tupoffset = tsm->NextSampleTuple(scanstate, scan->cblock,
+										 COLUMNAR_ROWS_PER_BLOCK);
+		if (!OffsetNumberIsValid(tupoffset))
+		{
+			ExecClearTuple(slot);
+			return false;
+		}
+
+		ItemPointerSet(&tid, scan->cblock, tupoffset);
+		if (columnar_read_row(scan->state, columnar_tid_to_row(&tid), slot))
+		{
+			pgstat_count_heap_getnext(scan->rs_base.rs_rd);
+			return true;
+		}
+	}
+}
+
+
+/* ------------------------------------------------------------------------
+ * Definition of the columnar table access method.
+ * ------------------------------------------------------------------------
+ */
+
+static const TableAmRoutine columnar_methods = {
+	.type = T_TableAmRoutine,
+
+	.slot_callbacks = columnar_slot_callbacks,
+
+	.scan_begin = columnar_beginscan,
+	.scan_end = columnar_endscan,
+	.scan_rescan = columnar_rescan,
+	.scan_getnextslot = columnar_getnextslot,
+	.scan_set_column_hints = columnar_scan_set_column_hints,
+
+	.parallelscan_estimate = columnar_parallelscan_estimate,
+	.parallelscan_initialize = columnar_parallelscan_initialize,
+	.parallelscan_reinitialize = columnar_parallelscan_reinitialize,
+
+	.index_fetch_begin = columnar_index_fetch_begin,
+	.index_fetch_reset = columnar_index_fetch_reset,
+	.index_fetch_end = columnar_index_fetch_end,
+	.index_fetch_tuple = columnar_index_fetch_tuple,
+
+	.tuple_insert = columnar_tuple_insert,
+	.tuple_insert_speculative = columnar_tuple_insert_speculative,
+	.tuple_complete_speculative = columnar_tuple_complete_speculative,
+	.multi_insert = columnar_multi_insert,
+	.tuple_delete = columnar_tuple_delete,
+	.tuple_update = columnar_tuple_update,
+	.tuple_lock = columnar_tuple_lock,
+	.finish_bulk_insert = columnar_finish_bulk_insert,
+
+	.tuple_fetch_row_version = columnar_fetch_row_version,
+	.tuple_get_latest_tid = columnar_get_latest_tid,
+	.tuple_tid_valid = columnar_tuple_tid_valid,
+	.tuple_satisfies_snapshot = columnar_tuple_satisfies_snapshot,
+	.compute_xid_horizon_for_tuples = columnar_compute_xid_horizon_for_tuples,
+
+	.relation_set_new_filenode = columnar_relation_set_new_filenode,
+	.relation_nontransactional_truncate = columnar_relation_nontransactional_truncate,
+	.relation_copy_data = columnar_relation_copy_data,
+	.relation_copy_for_cluster = columnar_relation_copy_for_cluster,
+	.relation_vacuum = columnar_relation_vacuum,
+	.scan_analyze_next_block = columnar_scan_analyze_next_block,
+	.scan_analyze_next_tuple = columnar_scan_analyze_next_tuple,
+	.index_build_range_scan = columnar_index_build_range_scan,
+	.index_validate_scan = columnar_index_validate_scan,
+
+	.relation_size = columnar_relation_size,
+	.relation_needs_toast_table = columnar_relation_needs_toast_table,
+
+	.relation_estimate_size = columnar_estimate_rel_size,
+
+	.scan_sample_next_block = columnar_scan_sample_next_block,
+	.scan_sample_next_tuple = columnar_scan_sample_next_tuple
+};
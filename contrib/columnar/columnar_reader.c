@@ -0,0 +1,691 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_reader.c
+ *		Reading rows from columnar tables.
+ *
+ * A read state works on a copy of the stripe directory taken when it is
+ * created, sorted by row number.  Rows are decoded a row group at a time,
+ * and only for the columns the scan needs; row groups whose minimum and
+ * maximum values show that they can't satisfy the scan keys are skipped.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/columnar/columnar_reader.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "access/sysattr.h"
+#include "access/transam.h"
+#include "common/pg_lzcompress.h"
+#include "executor/tuptable.h"
+#include "miscadmin.h"
+#include "storage/procarray.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+
+#include "columnar.h"
+
+struct ColumnarReadState
+{
+	Relation	rel;
+	TupleDesc	tupdesc;
+	Snapshot	snapshot;		/* NULL when reading for ANALYZE */
+	ParallelColumnarScanDesc pscan;	/* shared state of a parallel scan */
+	MemoryContext cxt;			/* holds the state */
+
+	/* stripe directory */
+	uint64		data_end;		/* end of the data it covers */
+	List	   *stripe_list;
+	ColumnarStripe **stripes;	/* sorted by first_row */
+	bool	   *visible;		/* is stripes[i] visible to the snapshot? */
+	int			nstripes;
+	uint64		max_row;		/* no row number is this high */
+
+	/* what the scan needs */
+	bool	   *needed;			/* per attribute */
+	int			nkeys;
+	ScanKey		keys;
+	uint64		range_start;	/* only return rows in this range */
+	uint64		range_end;
+
+	/* scan position */
+	int			cur_stripe;		/* stripe being read, or -1 */
+	uint32		cur_chunk;		/* next row group of it to read */
+	uint32		cur_row;		/* next row of the loaded row group */
+
+	/* loaded row group */
+	int			loaded_stripe;	/* -1 if none */
+	uint32		loaded_chunk;
+	uint32		loaded_nrows;
+	uint64		loaded_first_row;
+	MemoryContext groupcxt;		/* holds the decoded values */
+	Datum	  **values;			/* values[attno][row] */
+	bool	  **nulls;			/* nulls[attno][row] */
+	Datum	   *missing;		/* values of attributes the stripe lacks */
+	bool	   *missing_null;
+};
+
+static void load_stripes(ColumnarReadState *state, uint64 data_end);
+static int	stripe_row_cmp(const void *a, const void *b);
+static int	find_stripe(ColumnarReadState *state, uint64 rownum);
+static bool next_row_group(ColumnarReadState *state);
+static bool row_group_may_match(ColumnarReadState *state,
+								ColumnarStripe *stripe, uint32 chunkno);
+static void load_row_group(ColumnarReadState *state, int stripeno,
+						   uint32 chunkno);
+static void decode_chunk(ColumnarReadState *state, ColumnarStripe *stripe,
+						 uint32 chunkno, int attno, uint32 nrows);
+static void store_row(ColumnarReadState *state, uint32 row,
+					  TupleTableSlot *slot);
+
+/*
+ * Does a snapshot see the rows inserted by (xmin, cmin)?
+ *
+ * A NULL snapshot asks whether the rows are to be counted as live by
+ * ANALYZE: they are if they are committed or our own.
+ */
+bool
+columnar_xmin_visible(TransactionId xmin, CommandId cmin, Snapshot snapshot)
+{
+	if (!TransactionIdIsValid(xmin))
+		return false;			/* marked dead by VACUUM */
+	if (!TransactionIdIsNormal(xmin))
+		return true;			/* frozen */
+
+	if (snapshot == NULL)
+	{
+		if (TransactionIdIsCurrentTransactionId(xmin))
+			return true;
+		if (TransactionIdIsInProgress(xmin))
+			return false;
+		return TransactionIdDidCommit(xmin);
+	}
+
+	switch (snapshot->snapshot_type)
+	{
+		case SNAPSHOT_ANY:
+			return true;
+
+		case SNAPSHOT_MVCC:
+			if (TransactionIdIsCurrentTransactionId(xmin))
+				return cmin < snapshot->curcid;
+			if (XidInMVCCSnapshot(xmin, snapshot))
+				return false;
+			return TransactionIdDidCommit(xmin);
+
+		default:
+			if (TransactionIdIsCurrentTransactionId(xmin))
+				return true;
+			if (TransactionIdIsInProgress(xmin))
+			{
+				if (snapshot->snapshot_type == SNAPSHOT_DIRTY)
+				{
+					snapshot->xmin = xmin;
+					return true;
+				}
+				return snapshot->snapshot_type == SNAPSHOT_NON_VACUUMABLE;
+			}
+			return TransactionIdDidCommit(xmin);
+	}
+}
+
+/*
+ * Start reading rel.  For a parallel scan, pscan is the shared state.
+ */
+ColumnarReadState *
+columnar_begin_read(Relation rel, Snapshot snapshot,
+					ParallelColumnarScanDesc pscan)
+{
+	ColumnarReadState *state = palloc0(sizeof(ColumnarReadState));
+	ColumnarMetaPageData meta;
+	int			natts = RelationGetDescr(rel)->natts;
+	int			i;
+
+	state->rel = rel;
+	state->tupdesc = RelationGetDescr(rel);
+	state->snapshot = snapshot;
+	state->pscan = pscan;
+	state->cxt = CurrentMemoryContext;
+
+	/*
+	 * Our own rows must be written out first.  In a parallel scan, that has
+	 * been done when setting up the shared state, which also determines
+	 * where all participants stop.
+	 */
+	if (pscan == NULL)
+		columnar_flush_writes(rel);
+	columnar_read_metapage(rel, &meta);
+	state->max_row = meta.next_row;
+	load_stripes(state, pscan ? pscan->data_end : meta.data_end);
+
+	state->needed = palloc(sizeof(bool) * Max(natts, 1));
+	for (i = 0; i < natts; i++)
+		state->needed[i] = !TupleDescAttr(state->tupdesc, i)->attisdropped;
+
+	state->range_start = 0;
+	state->range_end = PG_UINT64_MAX;
+	state->cur_stripe = -1;
+	state->loaded_stripe = -1;
+
+	state->groupcxt = AllocSetContextCreate(CurrentMemoryContext,
+											"columnar row group",
+											ALLOCSET_DEFAULT_SIZES);
+	state->values = palloc0(sizeof(Datum *) * Max(natts, 1));
+	state->nulls = palloc0(sizeof(bool *) * Max(natts, 1));
+	state->missing = palloc(sizeof(Datum) * Max(natts, 1));
+	state->missing_null = palloc(sizeof(bool) * Max(natts, 1));
+	for (i = 0; i < natts; i++)
+		state->missing[i] = getmissingattr(state->tupdesc, i + 1,
+										   &state->missing_null[i]);
+
+	return state;
+}
+
+/*
+ * Read the stripe directory up to data_end.
+ */
+static void
+load_stripes(ColumnarReadState *state, uint64 data_end)
+{
+	MemoryContext oldcxt = MemoryContextSwitchTo(state->cxt);
+	ListCell   *lc;
+	int			i;
+
+	state->data_end = data_end;
+	state->stripe_list = columnar_read_stripes(state->rel, data_end);
+	state->nstripes = list_length(state->stripe_list);
+	state->stripes = palloc(sizeof(ColumnarStripe *) * Max(state->nstripes, 1));
+	state->visible = palloc(sizeof(bool) * Max(state->nstripes, 1));
+	i = 0;
+	foreach(lc, state->stripe_list)
+		state->stripes[i++] = (ColumnarStripe *) lfirst(lc);
+
+	/*
+	 * Concurrent writers can append their stripes in a different order than
+	 * they reserved row numbers, so sort.
+	 */
+	qsort(state->stripes, state->nstripes, sizeof(ColumnarStripe *),
+		  stripe_row_cmp);
+	for (i = 0; i < state->nstripes; i++)
+		state->visible[i] = columnar_xmin_visible(state->stripes[i]->hdr.xmin,
+												  state->stripes[i]->hdr.cmin,
+												  state->snapshot);
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+static int
+stripe_row_cmp(const void *a, const void *b)
+{
+	const ColumnarStripe *sa = *(ColumnarStripe *const *) a;
+	const ColumnarStripe *sb = *(ColumnarStripe *const *) b;
+
+	if (sa->hdr.first_row < sb->hdr.first_row)
+		return -1;
+	if (sa->hdr.first_row > sb->hdr.first_row)
+		return 1;
+	return 0;
+}
+
+/*
+ * Restrict the read to the given attributes (see scan_set_column_hints in
+ * tableam.h), and to row groups that might satisfy the given scan keys.
+ */
+void
+columnar_set_read_hints(ColumnarReadState *state, Bitmapset *attrs,
+						int nkeys, ScanKey keys)
+{
+	int			i;
+
+	if (!bms_is_member(InvalidAttrNumber - FirstLowInvalidHeapAttributeNumber,
+					   attrs))
+	{
+		for (i = 0; i < state->tupdesc->natts; i++)
+		{
+			if (!bms_is_member(i + 1 - FirstLowInvalidHeapAttributeNumber,
+							   attrs))
+				state->needed[i] = false;
+		}
+	}
+
+	if (nkeys > 0)
+	{
+		state->keys = palloc(sizeof(ScanKeyData) * nkeys);
+		memcpy(state->keys, keys, sizeof(ScanKeyData) * nkeys);
+	}
+	state->nkeys = nkeys;
+}
+
+/*
+ * Only return rows with row numbers in [first_row, end_row).  This lets
+ * ANALYZE sample the table by row number ranges.
+ */
+void
+columnar_read_set_range(ColumnarReadState *state, uint64 first_row,
+						uint64 end_row)
+{
+	int			stripeno;
+
+	state->range_start = first_row;
+	state->range_end = end_row;
+
+	/* keep reading the loaded row group if the range starts in it */
+	if (state->loaded_stripe >= 0 &&
+		first_row >= state->loaded_first_row &&
+		first_row < state->loaded_first_row + state->loaded_nrows)
+	{
+		state->cur_stripe = state->loaded_stripe;
+		state->cur_chunk = state->loaded_chunk + 1;
+		state->cur_row = first_row - state->loaded_first_row;
+		return;
+	}
+
+	/* otherwise start at the row group holding first_row, if any */
+	stripeno = find_stripe(state, first_row);
+	state->loaded_stripe = -1;
+	if (stripeno >= 0)
+	{
+		ColumnarStripe *stripe = state->stripes[stripeno];
+
+		state->cur_stripe = stripeno;
+		state->cur_chunk = (first_row - stripe->hdr.first_row) /
+			stripe->hdr.chunk_rows;
+	}
+	else
+	{
+		/* start with the first stripe after first_row */
+		for (stripeno = 0; stripeno < state->nstripes; stripeno++)
+		{
+			if (state->stripes[stripeno]->hdr.first_row >= first_row)
+				break;
+		}
+		state->cur_stripe = stripeno;
+		state->cur_chunk = 0;
+	}
+}
+
+/*
+ * One more than the highest row number that might exist.
+ */
+uint64
+columnar_read_max_row(ColumnarReadState *state)
+{
+	return state->max_row;
+}
+
+/*
+ * The stripes the read state is working on, in no particular order.
+ */
+List *
+columnar_read_state_stripes(ColumnarReadState *state)
+{
+	return state->stripe_list;
+}
+
+/*
+ * Start reading from the beginning again.  A parallel scan may have been
+ * set up again with more data to read.
+ */
+void
+columnar_rescan_read(ColumnarReadState *state)
+{
+	if (state->pscan && state->pscan->data_end != state->data_end)
+	{
+		list_free_deep(state->stripe_list);
+		pfree(state->stripes);
+		pfree(state->visible);
+		load_stripes(state, state->pscan->data_end);
+	}
+
+	state->cur_stripe = -1;
+	state->loaded_stripe = -1;
+	state->range_start = 0;
+	state->range_end = PG_UINT64_MAX;
+	MemoryContextReset(state->groupcxt);
+}
+
+void
+columnar_end_read(ColumnarReadState *state)
+{
+	MemoryContextDelete(state->groupcxt);
+}
+
+/*
+ * Find the stripe containing rownum, or return -1.
+ */
+static int
+find_stripe(ColumnarReadState *state, uint64 rownum)
+{
+	int			low = 0;
+	int			high = state->nstripes - 1;
+
+	while (low <= high)
+	{
+		int			mid = (low + high) / 2;
+		ColumnarStripeHeader *hdr = &state->stripes[mid]->hdr;
+
+		if (rownum < hdr->first_row)
+			high = mid - 1;
+		else if (rownum >= hdr->first_row + hdr->nrows)
+			low = mid + 1;
+		else
+			return mid;
+	}
+
+	return -1;
+}
+
+/*
+ * Return the next row of the scan in slot, or false at the end.
+ */
+bool
+columnar_read_next_row(ColumnarReadState *state, TupleTableSlot *slot)
+{
+	for (;;)
+	{
+		if (state->loaded_stripe >= 0 &&
+			state->cur_stripe == state->loaded_stripe &&
+			state->cur_row < state->loaded_nrows)
+		{
+			uint32		row = state->cur_row++;
+			uint64		rownum = state->loaded_first_row + row;
+
+			if (rownum < state->range_start)
+				continue;
+			if (rownum >= state->range_end)
+				return false;
+
+			store_row(state, row, slot);
+			return true;
+		}
+
+		if (!next_row_group(state))
+			return false;
+	}
+}
+
+/*
+ * Fetch the row with the given row number, if it's visible.
+ */
+bool
+columnar_read_row(ColumnarReadState *state, uint64 rownum,
+				  TupleTableSlot *slot)
+{
+	int			stripeno = find_stripe(state, rownum);
+	ColumnarStripe *stripe;
+	uint32		chunkno;
+
+	if (stripeno < 0 || !state->visible[stripeno])
+		return false;
+
+	stripe = state->stripes[stripeno];
+	chunkno = (rownum - stripe->hdr.first_row) / stripe->hdr.chunk_rows;
+	if (state->loaded_stripe != stripeno || state->loaded_chunk != chunkno)
+		load_row_group(state, stripeno, chunkno);
+
+	store_row(state, rownum - state->loaded_first_row, slot);
+	return true;
+}
+
+/*
+ * Advance to, and load, the next row group that needs to be read.
+ */
+static bool
+next_row_group(ColumnarReadState *state)
+{
+	for (;;)
+	{
+		ColumnarStripe *stripe;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* move on to the next stripe if we're done with this one */
+		if (state->cur_stripe < 0 ||
+			(state->cur_stripe < state->nstripes &&
+			 state->cur_chunk >= state->stripes[state->cur_stripe]->hdr.nchunks))
+		{
+			if (state->pscan)
+				state->cur_stripe =
+					(int) pg_atomic_fetch_add_u64(&state->pscan->next_stripe, 1);
+			else
+				state->cur_stripe++;
+			state->cur_chunk = 0;
+		}
+
+		if (state->cur_stripe >= state->nstripes)
+		{
+			state->cur_stripe = state->nstripes;
+			return false;
+		}
+
+		stripe = state->stripes[state->cur_stripe];
+		if (!state->visible[state->cur_stripe] ||
+			stripe->hdr.first_row + stripe->hdr.nrows <= state->range_start)
+		{
+			state->cur_chunk = stripe->hdr.nchunks;
+			continue;
+		}
+		if (stripe->hdr.first_row >= state->range_end)
+		{
+			state->cur_stripe = state->nstripes;
+			return false;
+		}
+
+		if (row_group_may_match(state, stripe, state->cur_chunk))
+		{
+			load_row_group(state, state->cur_stripe, state->cur_chunk);
+			state->cur_chunk++;
+			state->cur_row = 0;
+			return true;
+		}
+		state->cur_chunk++;
+	}
+}
+
+/*
+ * Could any row of the row group satisfy all the scan keys?
+ */
+static bool
+row_group_may_match(ColumnarReadState *state, ColumnarStripe *stripe,
+					uint32 chunkno)
+{
+	int			i;
+
+	for (i = 0; i < state->nkeys; i++)
+	{
+		ScanKey		key = &state->keys[i];
+		int			attno = key->sk_attno - 1;
+		ColumnarChunk *chunk;
+		int32		mincmp;
+		int32		maxcmp;
+
+		if (attno >= (int) stripe->hdr.natts)
+			continue;
+
+		chunk = StripeChunk(stripe, chunkno, attno);
+
+		/* btree operators are strict */
+		if (chunk->flags & CHUNK_ALL_NULLS)
+			return false;
+		if (!(chunk->flags & CHUNK_HAS_MINMAX))
+			continue;
+
+		mincmp = DatumGetInt32(FunctionCall2Coll(&key->sk_func,
+												 key->sk_collation,
+												 (Datum) chunk->min,
+												 key->sk_argument));
+		maxcmp = DatumGetInt32(FunctionCall2Coll(&key->sk_func,
+												 key->sk_collation,
+												 (Datum) chunk->max,
+												 key->sk_argument));
+		switch (key->sk_strategy)
+		{
+			case BTLessStrategyNumber:
+				if (mincmp >= 0)
+					return false;
+				break;
+			case BTLessEqualStrategyNumber:
+				if (mincmp > 0)
+					return false;
+				break;
+			case BTEqualStrategyNumber:
+				if (mincmp > 0 || maxcmp < 0)
+					return false;
+				break;
+			case BTGreaterEqualStrategyNumber:
+				if (maxcmp < 0)
+					return false;
+				break;
+			case BTGreaterStrategyNumber:
+				if (maxcmp <= 0)
+					return false;
+				break;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Decode the needed columns of a row group.
+ */
+static void
+load_row_group(ColumnarReadState *state, int stripeno, uint32 chunkno)
+{
+	ColumnarStripe *stripe = state->stripes[stripeno];
+	uint32		nrows;
+	int			attno;
+	MemoryContext oldcxt;
+
+	MemoryContextReset(state->groupcxt);
+	oldcxt = MemoryContextSwitchTo(state->groupcxt);
+
+	nrows = Min(stripe->hdr.chunk_rows,
+				stripe->hdr.nrows - chunkno * stripe->hdr.chunk_rows);
+
+	for (attno = 0; attno < state->tupdesc->natts; attno++)
+	{
+		if (!state->needed[attno] || attno >= (int) stripe->hdr.natts)
+			continue;
+
+		state->values[attno] = palloc(sizeof(Datum) * nrows);
+		state->nulls[attno] = palloc(sizeof(bool) * nrows);
+		decode_chunk(state, stripe, chunkno, attno, nrows);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	state->loaded_stripe = stripeno;
+	state->loaded_chunk = chunkno;
+	state->loaded_nrows = nrows;
+	state->loaded_first_row = stripe->hdr.first_row +
+		(uint64) chunkno * stripe->hdr.chunk_rows;
+}
+
+/*
+ * Read, decompress and deform one chunk.
+ */
+static void
+decode_chunk(ColumnarReadState *state, ColumnarStripe *stripe,
+			 uint32 chunkno, int attno, uint32 nrows)
+{
+	ColumnarChunk *chunk = StripeChunk(stripe, chunkno, attno);
+	Form_pg_attribute att = TupleDescAttr(state->tupdesc, attno);
+	Datum	   *values = state->values[attno];
+	bool	   *nulls = state->nulls[attno];
+	char	   *data;
+	bits8	   *bitmap = NULL;
+	uint32		off = 0;
+	uint32		i;
+
+	if (chunk->flags & CHUNK_ALL_NULLS)
+	{
+		memset(nulls, true, sizeof(bool) * nrows);
+		memset(values, 0, sizeof(Datum) * nrows);
+		return;
+	}
+
+	data = palloc(chunk->length);
+	columnar_storage_read(state->rel, stripe->offset + chunk->offset,
+						  data, chunk->length);
+	if (chunk->flags & CHUNK_COMPRESSED)
+	{
+		char	   *raw = palloc(chunk->rawlength);
+
+		if (pglz_decompress(data, chunk->length, raw, chunk->rawlength,
+							true) != chunk->rawlength)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("compressed data is corrupted in columnar table \"%s\"",
+							RelationGetRelationName(state->rel))));
+		pfree(data);
+		data = raw;
+	}
+
+	if (chunk->flags & CHUNK_HAS_NULLS)
+	{
+		bitmap = (bits8 *) data;
+		off = MAXALIGN(BITMAPLEN(nrows));
+	}
+
+	for (i = 0; i < nrows; i++)
+	{
+		if (bitmap && att_isnull(i, bitmap))
+		{
+			values[i] = (Datum) 0;
+			nulls[i] = true;
+			continue;
+		}
+
+		off = att_align_pointer(off, att->attalign, att->attlen, data + off);
+		if (off >= chunk->rawlength)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("unexpected end of chunk data in columnar table \"%s\"",
+							RelationGetRelationName(state->rel))));
+		values[i] = fetchatt(att, data + off);
+		nulls[i] = false;
+		off = att_addlength_pointer(off, att->attlen, data + off);
+	}
+}
+
+/*
+ * Store a row of the loaded row group in slot.
+ */
+static void
+store_row(ColumnarReadState *state, uint32 row, TupleTableSlot *slot)
+{
+	ColumnarStripe *stripe = state->stripes[state->loaded_stripe];
+	int			natts = state->tupdesc->natts;
+	int			attno;
+
+	ExecClearTuple(slot);
+	for (attno = 0; attno < natts; attno++)
+	{
+		if (!state->needed[attno])
+		{
+			slot->tts_values[attno] = (Datum) 0;
+			slot->tts_isnull[attno] = true;
+		}
+		else if (attno >= (int) stripe->hdr.natts)
+		{
+			/* column added after the stripe was written */
+			slot->tts_values[attno] = state->missing[attno];
+			slot->tts_isnull[attno] = state->missing_null[attno];
+		}
+		else
+		{
+			slot->tts_values[attno] = state->values[attno][row];
+			slot->tts_isnull[attno] = state->nulls[attno][row];
+		}
+	}
+	ExecStoreVirtualTuple(slot);
+
+	slot->tts_tableOid = RelationGetRelid(state->rel);
+	columnar_row_to_tid(state->loaded_first_row + row, &slot->tts_tid);
+}
@@ -0,0 +1,304 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_storage.c
+ *		Page-level storage of columnar tables.
+ *
+ * Apart from the metapage, the pages of a columnar table just hold a byte
+ * stream, COLUMNAR_BYTES_PER_PAGE bytes per page, into which stripes are
+ * appended.  All changes are WAL-logged with generic WAL records.
+ *
+ * Appending to the stream, and modifying the metapage, requires holding the
+ * relation extension lock; readers only look at the part of the stream up
+ * to the data_end recorded in the metapage when they started.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/columnar/columnar_storage.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/generic_xlog.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
+
+#include "columnar.h"
+
+/* Offset of the start of page contents */
+#define COLUMNAR_CONTENTS_OFFSET	MAXALIGN(SizeOfPageHeaderData)
+
+/*
+ * Read the metapage into *meta.  Returns false, and fills *meta with the
+ * values for an empty table, if the metapage hasn't been written yet.
+ */
+bool
+columnar_read_metapage(Relation rel, ColumnarMetaPageData *meta)
+{
+	Buffer		buffer;
+	Page		page;
+	bool		found = false;
+
+	memset(meta, 0, sizeof(ColumnarMetaPageData));
+	meta->magic = COLUMNAR_MAGIC;
+	meta->version = COLUMNAR_VERSION;
+
+	if (RelationGetNumberOfBlocks(rel) == 0)
+		return false;
+
+	buffer = ReadBuffer(rel, COLUMNAR_METAPAGE_BLKNO);
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buffer);
+	if (!PageIsNew(page))
+	{
+		memcpy(meta, PageGetContents(page), sizeof(ColumnarMetaPageData));
+		found = true;
+	}
+	UnlockReleaseBuffer(buffer);
+
+	if (found &&
+		(meta->magic != COLUMNAR_MAGIC || meta->version != COLUMNAR_VERSION))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("relation \"%s\" is not a valid columnar table",
+						RelationGetRelationName(rel)),
+				 errdetail("Magic number %08X, version %u.",
+						   meta->magic, meta->version)));
+
+	return found;
+}
+
+/*
+ * Write *meta to the metapage, creating the metapage if necessary.
+ *
+ * The caller must hold the relation extension lock.
+ */
+void
+columnar_write_metapage(Relation rel, ColumnarMetaPageData *meta)
+{
+	GenericXLogState *state;
+	Buffer		buffer;
+	Page		page;
+
+	if (RelationGetNumberOfBlocks(rel) == 0)
+	{
+		buffer = ReadBuffer(rel, P_NEW);
+		Assert(BufferGetBlockNumber(buffer) == COLUMNAR_METAPAGE_BLKNO);
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+		state = GenericXLogStart(rel);
+		page = GenericXLogRegisterBuffer(state, buffer,
+										 GENERIC_XLOG_FULL_IMAGE);
+		PageInit(page, BLCKSZ, 0);
+	}
+	else
+	{
+		buffer = ReadBuffer(rel, COLUMNAR_METAPAGE_BLKNO);
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+		state = GenericXLogStart(rel);
+		page = GenericXLogRegisterBuffer(state, buffer, 0);
+		if (PageIsNew(page))
+			PageInit(page, BLCKSZ, 0);
+	}
+
+	memcpy(PageGetContents(page), meta, sizeof(ColumnarMetaPageData));
+	((PageHeader) page)->pd_lower =
+		COLUMNAR_CONTENTS_OFFSET + sizeof(ColumnarMetaPageData);
+
+	GenericXLogFinish(state);
+	UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * Copy len bytes at logical offset `offset` of the stream to dst.
+ */
+void
+columnar_storage_read(Relation rel, uint64 offset, char *dst, uint64 len)
+{
+	while (len > 0)
+	{
+		BlockNumber blkno;
+		uint32		pageoff;
+		uint32		n;
+		Buffer		buffer;
+		Page		page;
+
+		blkno = COLUMNAR_FIRST_DATA_BLKNO + offset / COLUMNAR_BYTES_PER_PAGE;
+		pageoff = offset % COLUMNAR_BYTES_PER_PAGE;
+		n = Min(len, COLUMNAR_BYTES_PER_PAGE - pageoff);
+
+		buffer = ReadBuffer(rel, blkno);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+		if (PageIsNew(page) ||
+			((PageHeader) page)->pd_lower < COLUMNAR_CONTENTS_OFFSET + pageoff + n)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("unexpected end of data in block %u of columnar table \"%s\"",
+							blkno, RelationGetRelationName(rel))));
+		memcpy(dst, PageGetContents(page) + pageoff, n);
+		UnlockReleaseBuffer(buffer);
+
+		offset += n;
+		dst += n;
+		len -= n;
+	}
+}
+
+/*
+ * Write len bytes from src at logical offset `offset` of the stream,
+ * extending the relation as needed.
+ *
+ * When appending, the caller must hold the relation extension lock.
+ */
+void
+columnar_storage_write(Relation rel, uint64 offset, const char *src,
+					   uint64 len)
+{
+	BlockNumber nblocks = RelationGetNumberOfBlocks(rel);
+
+	/* the metapage must have been created first */
+	Assert(nblocks > COLUMNAR_METAPAGE_BLKNO);
+
+	while (len > 0)
+	{
+		BlockNumber blkno;
+		uint32		pageoff;
+		uint32		n;
+		GenericXLogState *state;
+		Buffer		buffer;
+		Page		page;
+		PageHeader	phdr;
+
+		CHECK_FOR_INTERRUPTS();
+
+		blkno = COLUMNAR_FIRST_DATA_BLKNO + offset / COLUMNAR_BYTES_PER_PAGE;
+		pageoff = offset % COLUMNAR_BYTES_PER_PAGE;
+		n = Min(len, COLUMNAR_BYTES_PER_PAGE - pageoff);
+
+		if (blkno >= nblocks)
+		{
+			/* stripes are written in order, so this must be the next page */
+			Assert(blkno == nblocks);
+			buffer = ReadBuffer(rel, P_NEW);
+			Assert(BufferGetBlockNumber(buffer) == blkno);
+			nblocks++;
+			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+			state = GenericXLogStart(rel);
+			page = GenericXLogRegisterBuffer(state, buffer,
+											 GENERIC_XLOG_FULL_IMAGE);
+			PageInit(page, BLCKSZ, 0);
+		}
+		else
+		{
+			buffer = ReadBuffer(rel, blkno);
+			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+			state = GenericXLogStart(rel);
+			page = GenericXLogRegisterBuffer(state, buffer, 0);
+
+			/* might be left over from a crash before data_end was updated */
+			if (PageIsNew(page))
+				PageInit(page, BLCKSZ, 0);
+		}
+
+		memcpy(PageGetContents(page) + pageoff, src, n);
+
+		/* generic WAL ignores anything between pd_lower and pd_upper */
+		phdr = (PageHeader) page;
+		if (phdr->pd_lower < COLUMNAR_CONTENTS_OFFSET + pageoff + n)
+			phdr->pd_lower = COLUMNAR_CONTENTS_OFFSET + pageoff + n;
+
+		GenericXLogFinish(state);
+		UnlockReleaseBuffer(buffer);
+
+		offset += n;
+		src += n;
+		len -= n;
+	}
+}
+
+/*
+ * Reserve nrows consecutive row numbers, returning the first.
+ */
+uint64
+columnar_reserve_rows(Relation rel, uint64 nrows)
+{
+	ColumnarMetaPageData meta;
+	uint64		first_row;
+
+	LockRelationForExtension(rel, ExclusiveLock);
+
+	columnar_read_metapage(rel, &meta);
+	first_row = meta.next_row;
+	if (first_row + nrows > COLUMNAR_MAX_ROW_NUMBER)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("columnar table \"%s\" has run out of row numbers",
+						RelationGetRelationName(rel)),
+				 errhint("Rewrite the table with VACUUM FULL.")));
+	meta.next_row += nrows;
+	columnar_write_metapage(rel, &meta);
+
+	UnlockRelationForExtension(rel, ExclusiveLock);
+
+	return first_row;
+}
+
+/*
+ * Read the headers of all stripes before logical offset data_end, returning
+ * a list of ColumnarStripes.
+ */
+List *
+columnar_read_stripes(Relation rel, uint64 data_end)
+{
+	List	   *result = NIL;
+	uint64		offset = 0;
+
+	while (offset < data_end)
+	{
+		ColumnarStripe *stripe = palloc(sizeof(ColumnarStripe));
+		ColumnarStripeHeader *hdr = &stripe->hdr;
+		Size		nchunks;
+
+		columnar_storage_read(rel, offset, (char *) hdr,
+							  sizeof(ColumnarStripeHeader));
+		if (hdr->magic != COLUMNAR_STRIPE_MAGIC ||
+			hdr->length < StripeHeaderSize(hdr->natts, hdr->nchunks) ||
+			hdr->length > data_end - offset)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("invalid stripe header at offset " UINT64_FORMAT " of columnar table \"%s\"",
+							offset, RelationGetRelationName(rel))));
+
+		nchunks = (Size) hdr->natts * hdr->nchunks;
+		stripe->chunks = palloc(sizeof(ColumnarChunk) * nchunks);
+		columnar_storage_read(rel, offset + sizeof(ColumnarStripeHeader),
+							  (char *) stripe->chunks,
+							  sizeof(ColumnarChunk) * nchunks);
+		stripe->offset = offset;
+
+		result = lappend(result, stripe);
+		offset += hdr->length;
+	}
+
+	return result;
+}
+
+/*
+ * Overwrite the xmin of a stripe, as VACUUM does when freezing it or marking
+ * it dead.
+ *
+ * Since stripes start at MAXALIGN'd offsets and pages hold a multiple of
+ * MAXIMUM_ALIGNOF bytes, xmin never straddles a page boundary, and readers
+ * see either the old or the new value.
+ */
+void
+columnar_rewrite_stripe_xmin(Relation rel, ColumnarStripe *stripe,
+							 TransactionId xmin)
+{
+	columnar_storage_write(rel,
+						   stripe->offset + offsetof(ColumnarStripeHeader, xmin),
+						   (char *) &xmin, sizeof(TransactionId));
+	stripe->hdr.xmin = xmin;
+}
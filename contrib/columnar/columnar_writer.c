@@ -0,0 +1,665 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_writer.c
+ *		Buffering of inserted rows, and writing them out as stripes.
+ *
+ * Inserted rows are buffered in backend-local memory, per relation, and
+ * written out as a stripe when the buffer is full, when a different command
+ * or (sub)transaction inserts into the relation, when the relation is about
+ * to be scanned, and at commit.  Since every stripe then holds rows of just
+ * one command, the stripe header's xmin and cmin are all that's needed to
+ * decide which rows a snapshot sees.
+ *
+ * Row numbers, and hence TIDs, are reserved when a buffer is started, so
+ * that the rows have their final TIDs from the moment they are inserted.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/columnar/columnar_writer.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/relation.h"
+#include "access/tuptoaster.h"
+#include "common/pg_lzcompress.h"
+#include "executor/tuptable.h"
+#include "lib/stringinfo.h"
+#include "storage/lmgr.h"
+#include "utils/datum.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/typcache.h"
+
+#include "columnar.h"
+
+/* Buffered data beyond which we write out a stripe regardless of its rows */
+#define COLUMNAR_MAX_BUFFER_SIZE	((Size) 64 * 1024 * 1024)
+
+/* Amount of stripe data collected before handing it to the storage layer */
+#define COLUMNAR_WRITE_CHUNK_SIZE	(64 * COLUMNAR_BYTES_PER_PAGE)
+
+/* Rows buffered for one relation */
+typedef struct ColumnarWriteState
+{
+	RelFileNode relnode;		/* hash key: the relation's current storage */
+	Oid			relid;
+	SubTransactionId subid;		/* subtransaction that buffered the rows */
+	TransactionId xid;			/* inserting (sub)transaction */
+	CommandId	cid;			/* inserting command */
+	uint64		first_row;		/* first reserved row number */
+	uint32		maxrows;		/* number of reserved row numbers */
+	uint32		nrows;			/* number of rows buffered */
+	uint32		allocrows;		/* allocated length of the value arrays */
+	int			natts;
+	Size		datasize;		/* approximate memory used by the rows */
+	MemoryContext cxt;			/* holds the value arrays */
+	MemoryContext datacxt;		/* holds pass-by-reference values */
+	Datum	  **values;			/* values[attno][row] */
+	bool	  **nulls;			/* nulls[attno][row] */
+} ColumnarWriteState;
+
+/* Write states of the current transaction, or NULL */
+static HTAB *write_states = NULL;
+
+static ColumnarWriteState *get_write_state(Relation rel, bool create);
+static void flush_write_state(Relation rel, ColumnarWriteState *state);
+static void reset_write_state(ColumnarWriteState *state);
+static char *encode_chunk(Form_pg_attribute att, Datum *values, bool *nulls,
+						  int nrows, ColumnarChunk *chunk);
+
+/*
+ * Find the write state of rel, optionally creating it.
+ */
+static ColumnarWriteState *
+get_write_state(Relation rel, bool create)
+{
+	ColumnarWriteState *state;
+	bool		found;
+
+	if (write_states == NULL)
+	{
+		HASHCTL		ctl;
+
+		if (!create)
+			return NULL;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(RelFileNode);
+		ctl.entrysize = sizeof(ColumnarWriteState);
+		ctl.hcxt = TopTransactionContext;
+		write_states = hash_create("columnar write states", 16, &ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	state = hash_search(write_states, &rel->rd_node,
+						create ? HASH_ENTER : HASH_FIND, &found);
+	if (state == NULL || found)
+		return state;
+
+	state->relid = RelationGetRelid(rel);
+	state->subid = InvalidSubTransactionId;
+	state->xid = InvalidTransactionId;
+	state->cid = InvalidCommandId;
+	state->first_row = 0;
+	state->maxrows = 0;
+	state->nrows = 0;
+	state->allocrows = 0;
+	state->natts = 0;
+	state->datasize = 0;
+	state->cxt = AllocSetContextCreate(TopTransactionContext,
+									   "columnar write state",
+									   ALLOCSET_DEFAULT_SIZES);
+	state->datacxt = AllocSetContextCreate(TopTransactionContext,
+										   "columnar write data",
+										   ALLOCSET_DEFAULT_SIZES);
+	state->values = NULL;
+	state->nulls = NULL;
+
+	return state;
+}
+
+/*
+ * Forget the rows buffered in state.  Their reserved row numbers are lost.
+ */
+static void
+reset_write_state(ColumnarWriteState *state)
+{
+	MemoryContextReset(state->datacxt);
+	state->nrows = 0;
+	state->maxrows = 0;
+	state->datasize = 0;
+}
+
+/*
+ * Buffer a row for insertion into rel, and give the slot the row's TID.
+ */
+void
+columnar_insert_row(Relation rel, TupleTableSlot *slot, TransactionId xid,
+					CommandId cid)
+{
+	ColumnarWriteState *state = get_write_state(rel, true);
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	MemoryContext oldcxt;
+	uint32		row;
+	int			i;
+
+	/* start a new stripe if we can't add the row to the current one */
+	if (state->nrows > 0 &&
+		(state->xid != xid || state->cid != cid ||
+		 state->nrows >= state->maxrows ||
+		 state->natts != tupdesc->natts ||
+		 state->datasize >= COLUMNAR_MAX_BUFFER_SIZE))
+		flush_write_state(rel, state);
+
+	if (state->nrows == 0)
+	{
+		state->xid = xid;
+		state->cid = cid;
+		state->subid = GetCurrentSubTransactionId();
+		state->maxrows = columnar_stripe_row_limit;
+		state->first_row = columnar_reserve_rows(rel, state->maxrows);
+
+		if (state->natts != tupdesc->natts)
+		{
+			MemoryContextReset(state->cxt);
+			state->natts = tupdesc->natts;
+			state->allocrows = 0;
+			state->values = MemoryContextAllocZero(state->cxt,
+												   sizeof(Datum *) * Max(state->natts, 1));
+			state->nulls = MemoryContextAllocZero(state->cxt,
+												  sizeof(bool *) * Max(state->natts, 1));
+		}
+	}
+
+	/* make room for the row */
+	if (state->nrows >= state->allocrows)
+	{
+		uint32		newrows = Max(state->allocrows * 2, 1024);
+
+		newrows = Min(newrows, state->maxrows);
+		for (i = 0; i < state->natts; i++)
+		{
+			if (state->allocrows == 0)
+			{
+				state->values[i] = MemoryContextAlloc(state->cxt,
+													  sizeof(Datum) * newrows);
+				state->nulls[i] = MemoryContextAlloc(state->cxt,
+													 sizeof(bool) * newrows);
+			}
+			else
+			{
+				state->values[i] = repalloc(state->values[i],
+											sizeof(Datum) * newrows);
+				state->nulls[i] = repalloc(state->nulls[i],
+										   sizeof(bool) * newrows);
+			}
+		}
+		state->allocrows = newrows;
+	}
+
+	slot_getallattrs(slot);
+
+	row = state->nrows;
+	oldcxt = MemoryContextSwitchTo(state->datacxt);
+	for (i = 0; i < state->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+		Datum		value = slot->tts_values[i];
+		bool		isnull = slot->tts_isnull[i];
+
+		if (!isnull && !att->attbyval)
+		{
+			if (att->attlen == -1 &&
+				(VARATT_IS_EXTERNAL(DatumGetPointer(value)) ||
+				 VARATT_IS_COMPRESSED(DatumGetPointer(value))))
+			{
+				/* we store values inline and do our own compression */
+				value = PointerGetDatum(heap_tuple_untoast_attr((struct varlena *)
+																DatumGetPointer(value)));
+			}
+			else
+				value = datumCopy(value, false, att->attlen);
+			state->datasize += datumGetSize(value, false, att->attlen);
+		}
+		state->values[i][row] = value;
+		state->nulls[i][row] = isnull;
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	state->datasize += state->natts * (sizeof(Datum) + sizeof(bool));
+	state->nrows++;
+
+	slot->tts_tableOid = RelationGetRelid(rel);
+	columnar_row_to_tid(state->first_row + row, &slot->tts_tid);
+}
+
+/*
+ * Write out any rows buffered for rel.
+ *
+ * This must be done before anything looks at the relation's storage.
+ */
+void
+columnar_flush_writes(Relation rel)
+{
+	ColumnarWriteState *state = get_write_state(rel, false);
+
+	if (state != NULL)
+		flush_write_state(rel, state);
+}
+
+/*
+ * Forget any rows buffered for rel.
+ */
+void
+columnar_discard_writes(Relation rel)
+{
+	ColumnarWriteState *state = get_write_state(rel, false);
+
+	if (state != NULL)
+		reset_write_state(state);
+}
+
+/*
+ * Fetch a row that is still buffered in our backend, if it's visible to the
+ * given snapshot.  Returns false if rownum isn't one of the buffered rows.
+ */
+bool
+columnar_fetch_pending_row(Relation rel, uint64 rownum, Snapshot snapshot,
+						   TupleTableSlot *slot)
+{
+	ColumnarWriteState *state = get_write_state(rel, false);
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	uint32		row;
+	int			i;
+
+	if (state == NULL || rownum < state->first_row ||
+		rownum >= state->first_row + state->nrows)
+		return false;
+
+	if (!columnar_xmin_visible(state->xid, state->cid, snapshot))
+		return false;
+
+	row = rownum - state->first_row;
+
+	ExecClearTuple(slot);
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		if (i < state->natts)
+		{
+			slot->tts_values[i] = state->values[i][row];
+			slot->tts_isnull[i] = state->nulls[i][row];
+		}
+		else
+			slot->tts_values[i] = getmissingattr(tupdesc, i + 1,
+												 &slot->tts_isnull[i]);
+	}
+	ExecStoreVirtualTuple(slot);
+
+	/* the buffer may be written out and freed while the slot is in use */
+	ExecMaterializeSlot(slot);
+
+	slot->tts_tableOid = RelationGetRelid(rel);
+	columnar_row_to_tid(rownum, &slot->tts_tid);
+
+	return true;
+}
+
+/*
+ * Write the rows buffered in state as a new stripe of rel.
+ */
+static void
+flush_write_state(Relation rel, ColumnarWriteState *state)
+{
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	ColumnarStripeHeader hdr;
+	ColumnarChunk *chunks;
+	char	  **blobs;
+	ColumnarMetaPageData meta;
+	StringInfoData buf;
+	uint32		chunk_rows = columnar_chunk_row_limit;
+	uint32		nchunks;
+	uint64		length;
+	uint64		start;
+	uint64		written;
+	uint32		chunkno;
+	int			attno;
+	MemoryContext stripecxt;
+	MemoryContext oldcxt;
+
+	if (state->nrows == 0)
+		return;
+
+	Assert(state->natts <= tupdesc->natts);
+
+	stripecxt = AllocSetContextCreate(CurrentMemoryContext,
+									  "columnar stripe",
+									  ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(stripecxt);
+
+	/* Encode and compress the chunks, and lay them out */
+	nchunks = (state->nrows + chunk_rows - 1) / chunk_rows;
+	chunks = palloc0(sizeof(ColumnarChunk) * state->natts * nchunks);
+	blobs = palloc0(sizeof(char *) * state->natts * nchunks);
+	length = StripeHeaderSize(state->natts, nchunks);
+
+	for (chunkno = 0; chunkno < nchunks; chunkno++)
+	{
+		uint32		first = chunkno * chunk_rows;
+		uint32		n = Min(chunk_rows, state->nrows - first);
+
+		for (attno = 0; attno < state->natts; attno++)
+		{
+			int			i = chunkno * state->natts + attno;
+
+			blobs[i] = encode_chunk(TupleDescAttr(tupdesc, attno),
+									state->values[attno] + first,
+									state->nulls[attno] + first,
+									n, &chunks[i]);
+			chunks[i].offset = length;
+			length += MAXALIGN(chunks[i].length);
+		}
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = COLUMNAR_STRIPE_MAGIC;
+	hdr.natts = state->natts;
+	hdr.xmin = state->xid;
+	hdr.cmin = state->cid;
+	hdr.length = length;
+	hdr.first_row = state->first_row;
+	hdr.nrows = state->nrows;
+	hdr.chunk_rows = chunk_rows;
+	hdr.nchunks = nchunks;
+
+	/*
+	 * Append the stripe to the stream, handing it to the storage layer a few
+	 * pages at a time, and then make it part of the table by advancing
+	 * data_end.
+	 */
+	LockRelationForExtension(rel, ExclusiveLock);
+
+	columnar_read_metapage(rel, &meta);
+	start = meta.data_end;
+	written = 0;
+
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, (char *) &hdr, sizeof(hdr));
+	appendBinaryStringInfo(&buf, (char *) chunks,
+						   sizeof(ColumnarChunk) * state->natts * nchunks);
+	while (buf.len < StripeHeaderSize(state->natts, nchunks))
+		appendStringInfoCharMacro(&buf, '\0');
+
+	for (chunkno = 0; chunkno < nchunks * state->natts; chunkno++)
+	{
+		if (chunks[chunkno].length > 0)
+			appendBinaryStringInfo(&buf, blobs[chunkno],
+								   chunks[chunkno].length);
+		while (buf.len % MAXIMUM_ALIGNOF != 0)
+			appendStringInfoCharMacro(&buf, '\0');
+
+		if (buf.len >= COLUMNAR_WRITE_CHUNK_SIZE)
+		{
+			columnar_storage_write(rel, start + written, buf.data, buf.len);
+			written += buf.len;
+			resetStringInfo(&buf);
+		}
+	}
+	if (buf.len > 0)
+	{
+		columnar_storage_write(rel, start + written, buf.data, buf.len);
+		written += buf.len;
+	}
+	Assert(written == length);
+
+	meta.data_end = start + length;
+	meta.nstripes++;
+
+	/* give back the unused row numbers, if nobody reserved any after us */
+	if (meta.next_row == state->first_row + state->maxrows)
+		meta.next_row = state->first_row + state->nrows;
+	columnar_write_metapage(rel, &meta);
+
+	UnlockRelationForExtension(rel, ExclusiveLock);
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(stripecxt);
+
+	reset_write_state(state);
+}
+
+/*
+ * Encode nrows values of a column into a chunk, returning its data (NULL if
+ * there's none) and filling in *chunk, except for its offset.
+ *
+ * The values are laid out as in a heap tuple's data area, so that they can
+ * be read with the usual tuple access macros, preceded by a null bitmap if
+ * there are nulls.
+ */
+static char *
+encode_chunk(Form_pg_attribute att, Datum *values, bool *nulls, int nrows,
+			 ColumnarChunk *chunk)
+{
+	StringInfoData buf;
+	TypeCacheEntry *typentry = NULL;
+	bool		have_minmax = false;
+	Datum		min = 0;
+	Datum		max = 0;
+	int			nnulls = 0;
+	int			i;
+
+	for (i = 0; i < nrows; i++)
+	{
+		if (nulls[i])
+			nnulls++;
+	}
+
+	chunk->flags = 0;
+	chunk->min = chunk->max = 0;
+	if (nnulls == nrows)
+	{
+		chunk->flags |= CHUNK_ALL_NULLS;
+		chunk->length = chunk->rawlength = 0;
+		return NULL;
+	}
+
+	/* We keep track of min and max for types whose values fit in a Datum */
+	if (att->attbyval)
+	{
+		typentry = lookup_type_cache(att->atttypid, TYPECACHE_CMP_PROC_FINFO);
+		if (!OidIsValid(typentry->cmp_proc_finfo.fn_oid))
+			typentry = NULL;
+	}
+
+	initStringInfo(&buf);
+
+	if (nnulls > 0)
+	{
+		int			nbytes = BITMAPLEN(nrows);
+		bits8	   *bitmap;
+
+		chunk->flags |= CHUNK_HAS_NULLS;
+		enlargeStringInfo(&buf, MAXALIGN(nbytes));
+		bitmap = (bits8 *) buf.data;
+		memset(bitmap, 0, MAXALIGN(nbytes));
+		for (i = 0; i < nrows; i++)
+		{
+			if (!nulls[i])
+				bitmap[i >> 3] |= (1 << (i & 0x07));
+		}
+		buf.len = MAXALIGN(nbytes);
+	}
+
+	for (i = 0; i < nrows; i++)
+	{
+		Datum		value = values[i];
+		Size		align_len;
+
+		if (nulls[i])
+			continue;
+
+		if (typentry != NULL)
+		{
+			if (!have_minmax)
+			{
+				min = max = value;
+				have_minmax = true;
+			}
+			else if (DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo,
+													 att->attcollation,
+													 value, min)) < 0)
+				min = value;
+			else if (DatumGetInt32(FunctionCall2Coll(&typentry->cmp_proc_finfo,
+													 att->attcollation,
+													 value, max)) > 0)
+				max = value;
+		}
+
+		if (att->attlen == -1)
+		{
+			Pointer		val = DatumGetPointer(value);
+
+			if (VARATT_IS_SHORT(val))
+			{
+				/* no alignment for short varlenas */
+				appendBinaryStringInfo(&buf, val, VARSIZE_SHORT(val));
+				continue;
+			}
+			else if (att->attstorage != 'p' && VARATT_CAN_MAKE_SHORT(val))
+			{
+				/* convert to short varlena, as heap_fill_tuple does */
+				char		hdr;
+				Size		len = VARATT_CONVERTED_SHORT_SIZE(val);
+
+				SET_VARSIZE_SHORT(&hdr, len);
+				appendStringInfoCharMacro(&buf, hdr);
+				appendBinaryStringInfo(&buf, VARDATA(val), len - 1);
+				continue;
+			}
+		}
+
+		/* pad to the alignment the value needs */
+		align_len = att_align_nominal(buf.len, att->attalign);
+		while (buf.len < align_len)
+			appendStringInfoCharMacro(&buf, '\0');
+
+		if (att->attbyval)
+		{
+			Datum		tmp;
+
+			store_att_byval(&tmp, value, att->attlen);
+			appendBinaryStringInfo(&buf, (char *) &tmp, att->attlen);
+		}
+		else if (att->attlen == -1)
+			appendBinaryStringInfo(&buf, DatumGetPointer(value),
+								   VARSIZE(DatumGetPointer(value)));
+		else if (att->attlen == -2)
+			appendBinaryStringInfo(&buf, DatumGetPointer(value),
+								   strlen(DatumGetCString(value)) + 1);
+		else
+			appendBinaryStringInfo(&buf, DatumGetPointer(value), att->attlen);
+	}
+
+	if (have_minmax)
+	{
+		chunk->flags |= CHUNK_HAS_MINMAX;
+		chunk->min = (uint64) min;
+		chunk->max = (uint64) max;
+	}
+
+	chunk->rawlength = buf.len;
+	chunk->length = buf.len;
+
+	if (columnar_compression)
+	{
+		char	   *compressed = palloc(PGLZ_MAX_OUTPUT(buf.len));
+		int32		len;
+
+		len = pglz_compress(buf.data, buf.len, compressed,
+							PGLZ_strategy_default);
+		if (len >= 0 && len < buf.len)
+		{
+			chunk->flags |= CHUNK_COMPRESSED;
+			chunk->length = len;
+			pfree(buf.data);
+			return compressed;
+		}
+		pfree(compressed);
+	}
+
+	return buf.data;
+}
+
+/*
+ * Write out all buffered rows at commit, and forget them at abort.
+ */
+void
+columnar_writer_xact_callback(XactEvent event, void *arg)
+{
+	HASH_SEQ_STATUS status;
+	ColumnarWriteState *state;
+
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+		case XACT_EVENT_PARALLEL_PRE_COMMIT:
+		case XACT_EVENT_PRE_PREPARE:
+			if (write_states == NULL)
+				break;
+
+			hash_seq_init(&status, write_states);
+			while ((state = hash_seq_search(&status)) != NULL)
+			{
+				Relation	rel;
+
+				if (state->nrows == 0)
+					continue;
+
+				/*
+				 * Skip relations that have been dropped, or given new
+				 * storage (in which case the rows have been written to the
+				 * old storage already, or intentionally discarded).
+				 */
+				rel = try_relation_open(state->relid, NoLock);
+				if (rel == NULL)
+					continue;
+				if (RelFileNodeEquals(rel->rd_node, state->relnode))
+					flush_write_state(rel, state);
+				relation_close(rel, NoLock);
+			}
+			break;
+
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+		case XACT_EVENT_PREPARE:
+			/* the memory goes away with TopTransactionContext */
+			write_states = NULL;
+			break;
+	}
+}
+
+/*
+ * Forget the rows buffered by an aborted subtransaction, and its children.
+ */
+void
+columnar_writer_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+								 SubTransactionId parentSubid, void *arg)
+{
+	HASH_SEQ_STATUS status;
+	ColumnarWriteState *state;
+
+	if (event != SUBXACT_EVENT_ABORT_SUB || write_states == NULL)
+		return;
+
+	/* subtransactions started later have higher IDs */
+	hash_seq_init(&status, write_states);
+	while ((state = hash_seq_search(&status)) != NULL)
+	{
+		if (state->nrows > 0 && state->subid >= mySubid)
+			reset_write_state(state);
+	}
+}
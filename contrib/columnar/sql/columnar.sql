@@ -0,0 +1,61 @@
+CREATE EXTENSION columnar;
+
+-- small row groups, so that there's something to skip
+SET columnar.chunk_row_limit = 1000;
+
+CREATE TABLE col_test (a int, b text, c float8) USING columnar;
+INSERT INTO col_test SELECT i, 'row ' || i, i / 2.0 FROM generate_series(1, 30000) i;
+
+SELECT count(*), sum(a), min(b), max(c) FROM col_test;
+SELECT a, b FROM col_test WHERE a = 12345;
+SELECT count(*) FROM col_test WHERE a > 29990 AND a <= 29995;
+SELECT count(*) FROM col_test WHERE 100 > a;
+
+-- scans only ask for the columns they need
+EXPLAIN (VERBOSE, COSTS OFF) SELECT b FROM col_test WHERE a = 1;
+
+ANALYZE col_test;
+SELECT reltuples FROM pg_class WHERE relname = 'col_test';
+
+-- nulls, and a column that is all nulls
+CREATE TABLE col_nulls (a int, b text, c int) USING columnar;
+INSERT INTO col_nulls
+	SELECT i, CASE WHEN i % 3 = 0 THEN NULL ELSE repeat('x', i % 5) END, NULL
+	FROM generate_series(1, 2000) i;
+SELECT count(*), count(b), count(c), sum(length(b)) FROM col_nulls;
+
+-- rows of aborted transactions and subtransactions go away
+BEGIN;
+INSERT INTO col_nulls VALUES (-1, 'in xact', 1);
+SELECT count(*) FROM col_nulls WHERE a < 0;
+ROLLBACK;
+SELECT count(*) FROM col_nulls WHERE a < 0;
+
+BEGIN;
+INSERT INTO col_nulls VALUES (-2, 'kept', 2);
+SAVEPOINT s1;
+INSERT INTO col_nulls VALUES (-3, 'discarded', 3);
+ROLLBACK TO s1;
+COMMIT;
+SELECT a, b, c FROM col_nulls WHERE a < 0 ORDER BY a;
+
+-- not supported
+UPDATE col_nulls SET c = 1 WHERE a = 1;
+DELETE FROM col_nulls WHERE a = 1;
+CREATE INDEX ON col_nulls (a);
+
+-- columns added later, and rewriting the table
+ALTER TABLE col_nulls ADD COLUMN d int DEFAULT 42;
+SELECT a, b, d FROM col_nulls WHERE a IN (1, -2) ORDER BY a;
+VACUUM FULL col_nulls;
+SELECT count(*), count(b), sum(a), sum(d) FROM col_nulls;
+VACUUM col_nulls;
+SELECT count(*), count(b), sum(a), sum(d) FROM col_nulls;
+
+BEGIN;
+TRUNCATE col_nulls;
+SELECT count(*) FROM col_nulls;
+ROLLBACK;
+SELECT count(*) FROM col_nulls;
+
+DROP TABLE col_test, col_nulls;
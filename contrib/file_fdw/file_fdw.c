@@ -16,6 +16,7 @@
 #include <unistd.h>
 
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/reloptions.h"
 #include "access/sysattr.h"
 #include "access/table.h"
@@ -27,12 +28,17 @@
 #include "commands/vacuum.h"
 #include "foreign/fdwapi.h"
 #include "foreign/foreign.h"
+#include "mb/pg_wchar.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
+#include "optimizer/cost.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
+#include "port/atomics.h"
+#include "storage/fd.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/sampling.h"
@@ -95,6 +101,23 @@ typedef struct FileFdwPlanState
 	double		ntuples;		/* estimate of number of data rows */
 } FileFdwPlanState;
 
+/*
+ * Shared state of a parallel scan.
+ *
+ * The file is divided into chunks of chunk_size bytes, which the processes
+ * taking part in the scan claim one at a time.  A chunk stands for the lines
+ * that start within it; see file_claim_chunk().  A chunk_size of zero means
+ * that the file can't be divided, and the whole file is the first chunk.
+ */
+typedef struct FileFdwParallelState
+{
+	int64		file_size;		/* size of the file when the scan began */
+	int64		chunk_size;		/* bytes per chunk, or 0 */
+	pg_atomic_uint64 next_chunk;	/* number of the next chunk to claim */
+} FileFdwParallelState;
+
+#define FILE_FDW_CHUNK_SIZE		(1024 * 1024)
+
 /*
  * FDW-specific information for ForeignScanState.fdw_state.
  */
@@ -105,8 +128,21 @@ typedef struct FileFdwExecutionState
 	List	   *options;		/* merged COPY options, excluding filename and
 								 * is_program */
 	CopyState	cstate;			/* COPY execution state */
+
+	/*
+	 * For a parallel-aware scan, we read the file ourselves and pass COPY the
+	 * lines of the chunks we claim.
+	 */
+	FileFdwParallelState *pstate;	/* shared state, or NULL */
+	int			fd;				/* the file, or -1 if not parallel-aware */
+	int64		read_pos;		/* next byte to pass to COPY */
+	int64		read_end;		/* end of the claimed lines, or -1 for EOF */
+	bool		read_done;		/* no more chunks to claim? */
 } FileFdwExecutionState;
 
+/* Scan whose chunks file_read_chunks() reads; COPY gives it no argument */
+static FileFdwExecutionState *chunk_reader = NULL;
+
 /*
  * SQL functions
  */
@@ -139,6 +175,17 @@ static bool fileAnalyzeForeignTable(Relation relation,
 									BlockNumber *totalpages);
 static bool fileIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
 										  RangeTblEntry *rte);
+static Size fileEstimateDSMForeignScan(ForeignScanState *node,
+									   ParallelContext *pcxt);
+static void fileInitializeDSMForeignScan(ForeignScanState *node,
+										 ParallelContext *pcxt,
+										 void *coordinate);
+static void fileReInitializeDSMForeignScan(ForeignScanState *node,
+										   ParallelContext *pcxt,
+										   void *coordinate);
+static void fileInitializeWorkerForeignScan(ForeignScanState *node,
+											shm_toc *toc,
+											void *coordinate);
 
 /*
  * Helper functions
@@ -156,7 +203,14 @@ static void estimate_size(PlannerInfo *root, RelOptInfo *baserel,
 						  FileFdwPlanState *fdw_private);
 static void estimate_costs(PlannerInfo *root, RelOptInfo *baserel,
 						   FileFdwPlanState *fdw_private,
+						   double parallel_divisor,
 						   Cost *startup_cost, Cost *total_cost);
+static bool file_is_divisible(List *options);
+static CopyState begin_file_scan(ForeignScanState *node,
+								 FileFdwExecutionState *festate);
+static int	file_read_chunks(void *outbuf, int minread, int maxread);
+static bool file_claim_chunk(FileFdwExecutionState *festate);
+static int64 file_line_end(FileFdwExecutionState *festate, int64 pos);
 static int	file_acquire_sample_rows(Relation onerel, int elevel,
 									 HeapTuple *rows, int targrows,
 									 double *totalrows, double *totaldeadrows);
@@ -181,6 +235,10 @@ file_fdw_handler(PG_FUNCTION_ARGS)
 	fdwroutine->EndForeignScan = fileEndForeignScan;
 	fdwroutine->AnalyzeForeignTable = fileAnalyzeForeignTable;
 	fdwroutine->IsForeignScanParallelSafe = fileIsForeignScanParallelSafe;
+	fdwroutine->EstimateDSMForeignScan = fileEstimateDSMForeignScan;
+	fdwroutine->InitializeDSMForeignScan = fileInitializeDSMForeignScan;
+	fdwroutine->ReInitializeDSMForeignScan = fileReInitializeDSMForeignScan;
+	fdwroutine->InitializeWorkerForeignScan = fileInitializeWorkerForeignScan;
 
 	PG_RETURN_POINTER(fdwroutine);
 }
@@ -528,7 +586,8 @@ fileGetForeignRelSize(PlannerInfo *root,
  *
  *		Currently we don't support any push-down feature, so there is only one
  *		possible access path, which simply returns all records in the order in
- *		the data file.
+ *		the data file.  If the file can be divided among processes, there is
+ *		also a partial path for a parallel scan.
  */
 static void
 fileGetForeignPaths(PlannerInfo *root,
@@ -549,7 +608,7 @@ fileGetForeignPaths(PlannerInfo *root,
 										  (Node *) columns, -1));
 
 	/* Estimate costs */
-	estimate_costs(root, baserel, fdw_private,
+	estimate_costs(root, baserel, fdw_private, 1.0,
 				   &startup_cost, &total_cost);
 
 	/*
@@ -572,6 +631,52 @@ fileGetForeignPaths(PlannerInfo *root,
 									 NULL,	/* no extra plan */
 									 coptions));
 
+	/*
+	 * Consider a parallel scan, in which each process reads different lines
+	 * of the file.  Partial paths can't be parameterized.
+	 */
+	if (baserel->consider_parallel && baserel->lateral_relids == NULL &&
+		!fdw_private->is_program && file_is_divisible(fdw_private->options))
+	{
+		int			parallel_workers;
+
+		parallel_workers = compute_parallel_worker(baserel,
+												   fdw_private->pages, -1,
+												   max_parallel_workers_per_gather);
+		if (parallel_workers > 0)
+		{
+			ForeignPath *path;
+			double		parallel_divisor = parallel_workers;
+
+			/* The leader's share, as in get_parallel_divisor() */
+			if (parallel_leader_participation)
+			{
+				double		leader_contribution;
+
+				leader_contribution = 1.0 - (0.3 * parallel_workers);
+				if (leader_contribution > 0)
+					parallel_divisor += leader_contribution;
+			}
+
+			estimate_costs(root, baserel, fdw_private, parallel_divisor,
+						   &startup_cost, &total_cost);
+
+			path = create_foreignscan_path(root, baserel,
+										   NULL,	/* default pathtarget */
+										   clamp_row_est(baserel->rows /
+														 parallel_divisor),
+										   startup_cost,
+										   total_cost,
+										   NIL, /* no pathkeys */
+										   NULL,	/* no outer rel either */
+										   NULL,	/* no extra plan */
+										   coptions);
+			path->path.parallel_aware = true;
+			path->path.parallel_workers = parallel_workers;
+			add_partial_path(baserel, (Path *) path);
+		}
+	}
+
 	/*
 	 * If data file was sorted, and we knew it somehow, we could insert
 	 * appropriate pathkeys into the ForeignPath node to tell the planner
@@ -657,7 +762,6 @@ fileBeginForeignScan(ForeignScanState *node, int eflags)
 	char	   *filename;
 	bool		is_program;
 	List	   *options;
-	CopyState	cstate;
 	FileFdwExecutionState *festate;
 
 	/*
@@ -673,18 +777,6 @@ fileBeginForeignScan(ForeignScanState *node, int eflags)
 	/* Add any options from the plan (currently only convert_selectively) */
 	options = list_concat(options, plan->fdw_private);
 
-	/*
-	 * Create CopyState from FDW options.  We always acquire all columns, so
-	 * as to match the expected ScanTupleSlot signature.
-	 */
-	cstate = BeginCopyFrom(NULL,
-						   node->ss.ss_currentRelation,
-						   filename,
-						   is_program,
-						   NULL,
-						   NIL,
-						   options);
-
 	/*
 	 * Save state in node->fdw_state.  We must save enough information to call
 	 * BeginCopyFrom() again.
@@ -693,11 +785,58 @@ fileBeginForeignScan(ForeignScanState *node, int eflags)
 	festate->filename = filename;
 	festate->is_program = is_program;
 	festate->options = options;
-	festate->cstate = cstate;
+	festate->pstate = NULL;
+	festate->fd = -1;
+
+	/*
+	 * For a parallel-aware scan, open the file now; which lines to read is
+	 * only decided as the scan goes.
+	 */
+	if (plan->scan.plan.parallel_aware)
+	{
+		festate->fd = OpenTransientFile(filename, O_RDONLY | PG_BINARY);
+		if (festate->fd < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open file \"%s\" for reading: %m",
+							filename)));
+	}
+
+	festate->cstate = begin_file_scan(node, festate);
 
 	node->fdw_state = (void *) festate;
 }
 
+/*
+ * Create CopyState from FDW options.  We always acquire all columns, so
+ * as to match the expected ScanTupleSlot signature.
+ */
+static CopyState
+begin_file_scan(ForeignScanState *node, FileFdwExecutionState *festate)
+{
+	if (festate->fd < 0)
+		return BeginCopyFrom(NULL,
+							 node->ss.ss_currentRelation,
+							 festate->filename,
+							 festate->is_program,
+							 NULL,
+							 NIL,
+							 festate->options);
+
+	/* Start over with the chunks of a parallel-aware scan */
+	festate->read_pos = 0;
+	festate->read_end = 0;
+	festate->read_done = false;
+
+	return BeginCopyFrom(NULL,
+						 node->ss.ss_currentRelation,
+						 NULL,
+						 false,
+						 file_read_chunks,
+						 NIL,
+						 festate->options);
+}
+
 /*
  * fileIterateForeignScan
  *		Read next record from the data file and store it into the
@@ -730,6 +869,7 @@ fileIterateForeignScan(ForeignScanState *node)
 	 * foreign tables.
 	 */
 	ExecClearTuple(slot);
+	chunk_reader = festate;
 	found = NextCopyFrom(festate->cstate, NULL,
 						 slot->tts_values, slot->tts_isnull);
 	if (found)
@@ -752,13 +892,7 @@ fileReScanForeignScan(ForeignScanState *node)
 
 	EndCopyFrom(festate->cstate);
 
-	festate->cstate = BeginCopyFrom(NULL,
-									node->ss.ss_currentRelation,
-									festate->filename,
-									festate->is_program,
-									NULL,
-									NIL,
-									festate->options);
+	festate->cstate = begin_file_scan(node, festate);
 }
 
 /*
@@ -772,7 +906,11 @@ fileEndForeignScan(ForeignScanState *node)
 
 	/* if festate is NULL, we are in EXPLAIN; nothing to do */
 	if (festate)
+	{
 		EndCopyFrom(festate->cstate);
+		if (festate->fd >= 0)
+			CloseTransientFile(festate->fd);
+	}
 }
 
 /*
@@ -837,6 +975,73 @@ fileIsForeignScanParallelSafe(PlannerInfo *root, RelOptInfo *rel,
 	return true;
 }
 
+/*
+ * fileEstimateDSMForeignScan
+ *		Report the size of the shared state of a parallel scan
+ */
+static Size
+fileEstimateDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt)
+{
+	return sizeof(FileFdwParallelState);
+}
+
+/*
+ * fileInitializeDSMForeignScan
+ *		Set up the shared state of a parallel scan
+ */
+static void
+fileInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							 void *coordinate)
+{
+	FileFdwExecutionState *festate = (FileFdwExecutionState *) node->fdw_state;
+	FileFdwParallelState *pstate = (FileFdwParallelState *) coordinate;
+	struct stat stat_buf;
+
+	if (fstat(festate->fd, &stat_buf) < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not stat file \"%s\": %m",
+						festate->filename)));
+
+	/*
+	 * The encoding may have changed since planning, for a file without an
+	 * encoding option.  If the file can't be divided anymore, it is read as
+	 * a whole by one process.
+	 */
+	pstate->file_size = stat_buf.st_size;
+	pstate->chunk_size = file_is_divisible(festate->options) ?
+		FILE_FDW_CHUNK_SIZE : 0;
+	pg_atomic_init_u64(&pstate->next_chunk, 0);
+
+	festate->pstate = pstate;
+}
+
+/*
+ * fileReInitializeDSMForeignScan
+ *		Reset the shared state of a parallel scan before a rescan
+ */
+static void
+fileReInitializeDSMForeignScan(ForeignScanState *node, ParallelContext *pcxt,
+							   void *coordinate)
+{
+	FileFdwParallelState *pstate = (FileFdwParallelState *) coordinate;
+
+	pg_atomic_write_u64(&pstate->next_chunk, 0);
+}
+
+/*
+ * fileInitializeWorkerForeignScan
+ *		Attach a parallel worker to the shared state of the scan
+ */
+static void
+fileInitializeWorkerForeignScan(ForeignScanState *node, shm_toc *toc,
+								void *coordinate)
+{
+	FileFdwExecutionState *festate = (FileFdwExecutionState *) node->fdw_state;
+
+	festate->pstate = (FileFdwParallelState *) coordinate;
+}
+
 /*
  * check_selective_binary_conversion
  *
@@ -1053,7 +1258,7 @@ estimate_size(PlannerInfo *root, RelOptInfo *baserel,
  */
 static void
 estimate_costs(PlannerInfo *root, RelOptInfo *baserel,
-			   FileFdwPlanState *fdw_private,
+			   FileFdwPlanState *fdw_private, double parallel_divisor,
 			   Cost *startup_cost, Cost *total_cost)
 {
 	BlockNumber pages = fdw_private->pages;
@@ -1071,15 +1276,209 @@ estimate_costs(PlannerInfo *root, RelOptInfo *baserel,
 	 * from reality, but we have no good alternative; and it's not clear that
 	 * the numbers we produce here matter much anyway, since there's only one
 	 * access path for the rel.
+	 *
+	 * For a parallel scan, the CPU costs are divided by parallel_divisor, the
+	 * number of processes expected to share the work; the I/O isn't.
 	 */
 	run_cost += seq_page_cost * pages;
 
 	*startup_cost = baserel->baserestrictcost.startup;
 	cpu_per_tuple = cpu_tuple_cost * 10 + baserel->baserestrictcost.per_tuple;
-	run_cost += cpu_per_tuple * ntuples;
+	run_cost += cpu_per_tuple * ntuples / parallel_divisor;
 	*total_cost = *startup_cost + run_cost;
 }
 
+/*
+ * Check whether a file read with the given COPY options can be divided into
+ * chunks at newlines.
+ *
+ * That's the case in text format, where every newline that isn't escaped by
+ * a backslash ends a line.  In CSV format, quoted values can contain
+ * newlines, which can only be told apart by parsing from the start of the
+ * file; binary format has no lines at all.  Also, the encoding must not be
+ * one where the bytes of a newline or a backslash can be part of a
+ * multibyte character.
+ */
+static bool
+file_is_divisible(List *options)
+{
+	int			encoding = pg_get_client_encoding();
+	bool		text_format = true;
+	ListCell   *lc;
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "format") == 0)
+			text_format = (strcmp(defGetString(def), "text") == 0);
+		else if (strcmp(def->defname, "encoding") == 0)
+			encoding = pg_char_to_encoding(defGetString(def));
+	}
+
+	return text_format && encoding >= 0 &&
+		!PG_ENCODING_IS_CLIENT_ONLY(encoding);
+}
+
+/*
+ * Data source callback for COPY in a parallel-aware scan: pass on the lines
+ * of the chunks this process claims, claiming the next chunk whenever the
+ * lines of the previous one are used up.  Returns 0 at the end of the scan.
+ */
+static int
+file_read_chunks(void *outbuf, int minread, int maxread)
+{
+	FileFdwExecutionState *festate = chunk_reader;
+
+	for (;;)
+	{
+		if (festate->read_end < 0 || festate->read_pos < festate->read_end)
+		{
+			int64		nbytes = maxread;
+			int			nread;
+
+			if (festate->read_end >= 0)
+				nbytes = Min(nbytes, festate->read_end - festate->read_pos);
+
+			nread = pg_pread(festate->fd, outbuf, nbytes, festate->read_pos);
+			if (nread < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read file \"%s\": %m",
+								festate->filename)));
+			if (nread > 0)
+			{
+				festate->read_pos += nread;
+				return nread;
+			}
+			/* The file must have been truncated; that's the end of it */
+		}
+
+		if (!file_claim_chunk(festate))
+			return 0;
+	}
+}
+
+/*
+ * Claim the next chunk of the file that has any lines in it, and set up to
+ * read those lines.  Returns false if there is none left.
+ *
+ * A line belongs to the chunk its first byte is in.  So the lines of a chunk
+ * start after the first newline at or after the byte before the chunk (or
+ * at the start of the file), and end with the first newline at or after the
+ * last byte of the chunk.  The lines of consecutive chunks thus follow each
+ * other, even if a line spans several chunks.
+ */
+static bool
+file_claim_chunk(FileFdwExecutionState *festate)
+{
+	FileFdwParallelState *pstate = festate->pstate;
+
+	while (!festate->read_done)
+	{
+		uint64		chunk;
+		int64		start;
+
+		/* Without shared state, we read the whole file by ourselves */
+		if (pstate == NULL)
+		{
+			festate->read_pos = 0;
+			festate->read_end = -1;
+			festate->read_done = true;
+			return true;
+		}
+
+		chunk = pg_atomic_fetch_add_u64(&pstate->next_chunk, 1);
+
+		if (pstate->chunk_size == 0)
+		{
+			festate->read_done = true;
+			if (chunk > 0)
+				break;
+			festate->read_pos = 0;
+			festate->read_end = pstate->file_size;
+			return true;
+		}
+
+		start = chunk * pstate->chunk_size;
+		if (start >= pstate->file_size)
+		{
+			festate->read_done = true;
+			break;
+		}
+
+		festate->read_pos = (start == 0) ? 0 : file_line_end(festate, start - 1);
+		festate->read_end = file_line_end(festate,
+										  start + pstate->chunk_size - 1);
+		if (festate->read_pos < festate->read_end)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Find the end of the line that the byte at pos is in: return the position
+ * just past the first newline at or after pos that isn't escaped by a
+ * backslash, or the size of the file if there is none.
+ */
+static int64
+file_line_end(FileFdwExecutionState *festate, int64 pos)
+{
+	int64		file_size = festate->pstate->file_size;
+	int64		nbackslashes = 0;
+	int64		p;
+	char		buf[BLCKSZ];
+
+	if (pos >= file_size)
+		return file_size;
+
+	/*
+	 * A backslash escapes the next byte, so whether a newline is escaped
+	 * depends on the number of backslashes right before it.  Count those
+	 * before pos.
+	 */
+	for (p = pos; p > 0; p--)
+	{
+		char		c;
+
+		if (pg_pread(festate->fd, &c, 1, p - 1) != 1)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m",
+							festate->filename)));
+		if (c != '\\')
+			break;
+		nbackslashes++;
+	}
+
+	while (pos < file_size)
+	{
+		int			nread;
+		int			i;
+
+		nread = pg_pread(festate->fd, buf, Min(sizeof(buf), file_size - pos),
+						 pos);
+		if (nread < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m",
+							festate->filename)));
+		if (nread == 0)
+			break;
+
+		for (i = 0; i < nread; i++)
+		{
+			if (buf[i] == '\n' && nbackslashes % 2 == 0)
+				return pos + i + 1;
+			nbackslashes = (buf[i] == '\\') ? nbackslashes + 1 : 0;
+		}
+		pos += nread;
+	}
+
+	return file_size;
+}
+
 /*
  * file_acquire_sample_rows -- acquire a random sample of rows from the table
  *
@@ -0,0 +1,238 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnsw.h
+ *	  Header for hnsw index.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnsw.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _HNSW_H_
+#define _HNSW_H_
+
+#include "access/amapi.h"
+#include "access/generic_xlog.h"
+#include "access/itup.h"
+#include "lib/pairingheap.h"
+#include "nodes/pathnodes.h"
+#include "fmgr.h"
+
+/* Support procedures numbers */
+#define HNSW_DISTANCE_PROC		1
+#define HNSW_NPROC				1
+
+/* Scan strategies */
+#define HNSW_DISTANCE_STRATEGY	1
+#define HNSW_NSTRATEGIES		1
+
+/* Opaque for hnsw pages */
+typedef struct HnswPageOpaqueData
+{
+	uint32		unused;			/* placeholder to force maxaligning of size of
+								 * HnswPageOpaqueData and to place
+								 * hnsw_page_id exactly at the end of page */
+	uint16		flags;			/* see bit definitions below */
+	uint16		hnsw_page_id;	/* for identification of HNSW indexes */
+} HnswPageOpaqueData;
+
+typedef HnswPageOpaqueData *HnswPageOpaque;
+
+/* Hnsw page flags */
+#define HNSW_META		(1<<0)
+
+/*
+ * The page ID is for the convenience of pg_filedump and similar utilities,
+ * which otherwise would have a hard time telling pages of different index
+ * types apart.  It should be the last 2 bytes on the page.
+ */
+#define HNSW_PAGE_ID	0xFF84
+
+/* Macros for accessing hnsw page structures */
+#define HnswPageGetOpaque(page) ((HnswPageOpaque) PageGetSpecialPointer(page))
+#define HnswPageIsMeta(page) \
+	((HnswPageGetOpaque(page)->flags & HNSW_META) != 0)
+
+/* Preserved page numbers */
+#define HNSW_METAPAGE_BLKNO		(0)
+#define HNSW_HEAD_BLKNO			(1) /* first data page */
+
+/*
+ * Default and allowed values of the index options: the number of neighbors
+ * kept per element on each layer above the bottom one (twice that on the
+ * bottom layer), and the size of the candidate list used while inserting.
+ */
+#define HNSW_DEFAULT_M					16
+#define HNSW_MIN_M						2
+#define HNSW_MAX_M						100
+#define HNSW_DEFAULT_EF_CONSTRUCTION	64
+#define HNSW_MIN_EF_CONSTRUCTION		4
+#define HNSW_MAX_EF_CONSTRUCTION		1000
+
+/* Default and maximum size of the candidate list used by scans */
+#define HNSW_DEFAULT_EF_SEARCH			40
+#define HNSW_MAX_EF_SEARCH				1000
+
+/* No element is placed on more layers than this */
+#define HNSW_MAX_LEVEL					15
+
+/* Hnsw index options */
+typedef struct HnswOptions
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int			m;				/* neighbors per element and layer */
+	int			efConstruction; /* candidate list size for inserts */
+} HnswOptions;
+
+/* Metadata of hnsw index */
+typedef struct HnswMetaPageData
+{
+	uint32		magickNumber;
+	uint32		dimensions;		/* vector length, or 0 until first insert */
+	uint16		m;
+	uint16		efConstruction;
+	int16		entryLevel;		/* top layer of entryPoint, -1 if empty */
+	ItemPointerData entryPoint; /* element all searches start from */
+	BlockNumber insertPage;		/* page new elements are added to */
+} HnswMetaPageData;
+
+/* Magic number to distinguish hnsw pages among anothers */
+#define HNSW_MAGICK_NUMBER (0xA8C5D0E1)
+
+#define HnswPageGetMeta(page)	((HnswMetaPageData *) PageGetContents(page))
+
+/*
+ * A link to a neighboring element in the graph, with the distance between
+ * the two elements so that the farthest link can be found cheaply.
+ */
+typedef struct HnswNeighbor
+{
+	ItemPointerData tid;		/* location of the neighbor, or invalid */
+	float4		distance;
+} HnswNeighbor;
+
+/*
+ * Each indexed value is one element, stored as a line-pointer item on a data
+ * page and addressed by its TID.  The element holds its neighbor slots for
+ * layers 0 through level, followed by the indexed float4 array itself at a
+ * MAXALIGN'd offset.  Layer 0 has 2*m slots and every other layer has m;
+ * unused slots have an invalid TID.  Elements are never moved or removed,
+ * so links between them stay valid; VACUUM only marks them deleted, and
+ * deleted elements keep serving as stepping stones for searches.
+ */
+typedef struct HnswElementTupleData
+{
+	ItemPointerData heaptid;
+	uint8		level;
+	uint8		deleted;
+	HnswNeighbor neighbors[FLEXIBLE_ARRAY_MEMBER];
+} HnswElementTupleData;
+
+typedef HnswElementTupleData *HnswElementTuple;
+
+#define HnswLayerSlots(m, layer)		((layer) == 0 ? (m) * 2 : (m))
+#define HnswLayerFirstSlot(m, layer)	((layer) == 0 ? 0 : (m) * ((layer) + 1))
+#define HnswElementSlots(m, level)		((m) * ((level) + 2))
+#define HnswElementValueOffset(m, level) \
+	MAXALIGN(offsetof(HnswElementTupleData, neighbors) + \
+			 HnswElementSlots(m, level) * sizeof(HnswNeighbor))
+#define HnswElementGetValue(etup, m) \
+	((Pointer) (etup) + HnswElementValueOffset(m, (etup)->level))
+
+/* Largest element that fits on an otherwise empty page */
+#define HNSW_MAX_ELEMENT_SIZE \
+	(BLCKSZ - MAXALIGN(SizeOfPageHeaderData + sizeof(ItemIdData)) \
+	 - MAXALIGN(sizeof(HnswPageOpaqueData)))
+
+typedef struct HnswState
+{
+	Relation	index;
+	FmgrInfo	distanceFn;
+	Oid			collation;
+	int			m;				/* copy of options on index's metapage */
+	int			efConstruction;
+} HnswState;
+
+/*
+ * An element visited by a search, with its distance to the search target
+ * and its links on the layer being searched.
+ */
+typedef struct HnswCandidate
+{
+	pairingheap_node c_node;	/* in the nearest-first candidate heap */
+	pairingheap_node w_node;	/* in the farthest-first result heap */
+	ItemPointerData tid;		/* location of the element */
+	ItemPointerData heaptid;
+	bool		deleted;
+	double		distance;
+	int			nneighbors;
+	ItemPointerData *neighbors;
+} HnswCandidate;
+
+/* Opaque data structure for hnsw index scan */
+typedef struct HnswScanOpaqueData
+{
+	HnswState	state;
+	MemoryContext scanCtx;		/* holds results, reset on rescan */
+	bool		started;		/* has the search been run? */
+	List	   *results;		/* HnswCandidates, nearest first */
+	ListCell   *next;			/* next result to return */
+
+	/* Position of a physical-order scan, used for a NULL ORDER BY value */
+	bool		nullScan;
+	BlockNumber curBlkno;
+	OffsetNumber curOffset;
+} HnswScanOpaqueData;
+
+typedef HnswScanOpaqueData *HnswScanOpaque;
+
+/* hnswutils.c */
+extern int	hnsw_ef_search;
+extern void _PG_init(void);
+extern void initHnswState(HnswState *state, Relation index);
+extern void HnswInitPage(Page page, uint16 flags);
+extern void HnswFillMetapage(Relation index, Page metaPage);
+extern void HnswInitMetapage(Relation index);
+extern Buffer HnswNewBuffer(Relation index);
+extern Page HnswStartModify(Relation index, Buffer buffer, bool building,
+							int flags, GenericXLogState **xlogState);
+extern void HnswFinishModify(Buffer buffer, GenericXLogState *xlogState);
+extern void HnswAbortModify(GenericXLogState *xlogState);
+extern int	HnswCheckValue(Datum value);
+extern void HnswGetEntryPoint(Relation index, ItemPointer entryPoint,
+							  int *entryLevel);
+extern HnswCandidate *HnswLoadCandidate(HnswState *state, ItemPointer tid,
+										Datum query, int layer);
+extern List *HnswSearchLayer(HnswState *state, Datum query, List *entries,
+							 int ef, int layer);
+
+/* hnswvalidate.c */
+extern bool hnswvalidate(Oid opclassoid);
+
+/* index access method interface functions */
+extern bool hnswinsert(Relation index, Datum *values, bool *isnull,
+					   ItemPointer ht_ctid, Relation heapRel,
+					   IndexUniqueCheck checkUnique,
+					   struct IndexInfo *indexInfo);
+extern IndexScanDesc hnswbeginscan(Relation r, int nkeys, int norderbys);
+extern bool hnswgettuple(IndexScanDesc scan, ScanDirection dir);
+extern void hnswrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
+					   ScanKey orderbys, int norderbys);
+extern void hnswendscan(IndexScanDesc scan);
+extern IndexBuildResult *hnswbuild(Relation heap, Relation index,
+								   struct IndexInfo *indexInfo);
+extern void hnswbuildempty(Relation index);
+extern IndexBulkDeleteResult *hnswbulkdelete(IndexVacuumInfo *info,
+											 IndexBulkDeleteResult *stats, IndexBulkDeleteCallback callback,
+											 void *callback_state);
+extern IndexBulkDeleteResult *hnswvacuumcleanup(IndexVacuumInfo *info,
+												IndexBulkDeleteResult *stats);
+extern bytea *hnswoptions(Datum reloptions, bool validate);
+extern void hnswcostestimate(PlannerInfo *root, IndexPath *path,
+							 double loop_count, Cost *indexStartupCost,
+							 Cost *indexTotalCost, Selectivity *indexSelectivity,
+							 double *indexCorrelation, double *indexPages);
+
+#endif
@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnswcost.c
+ *		Cost estimate function for hnsw indexes.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnswcost.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "fmgr.h"
+#include "utils/selfuncs.h"
+
+#include "hnsw.h"
+
+/*
+ * Estimate cost of hnsw index scan.
+ */
+void
+hnswcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
+				 Cost *indexStartupCost, Cost *indexTotalCost,
+				 Selectivity *indexSelectivity, double *indexCorrelation,
+				 double *indexPages)
+{
+	IndexOptInfo *index = path->indexinfo;
+	GenericCosts costs;
+
+	MemSet(&costs, 0, sizeof(costs));
+
+	/*
+	 * A search visits roughly the candidate list's worth of elements on the
+	 * bottom layer, each with its links, however large the index is.
+	 */
+	costs.numIndexTuples = Min(index->tuples,
+							   (double) hnsw_ef_search * 2 * HNSW_DEFAULT_M);
+
+	/* Use generic estimate */
+	genericcostestimate(root, path, loop_count, &costs);
+
+	/* The whole search runs before the first row is returned */
+	*indexStartupCost = costs.indexTotalCost;
+	*indexTotalCost = costs.indexTotalCost;
+	*indexSelectivity = costs.indexSelectivity;
+	*indexCorrelation = costs.indexCorrelation;
+	*indexPages = costs.numIndexPages;
+}
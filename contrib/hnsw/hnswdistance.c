@@ -0,0 +1,202 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnswdistance.c
+ *		Distance functions between float4 arrays.
+ *
+ * These are the support functions of the hnsw operator classes, and also
+ * implement the distance operators.  The loops are unrolled into four
+ * independent accumulators so that the compiler can keep several
+ * multiply-adds in flight and vectorize them.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnswdistance.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "catalog/pg_type.h"
+#include "utils/array.h"
+#include "utils/float.h"
+
+#include "hnsw.h"
+
+PG_FUNCTION_INFO_V1(l2_distance);
+PG_FUNCTION_INFO_V1(inner_product);
+PG_FUNCTION_INFO_V1(negative_inner_product);
+PG_FUNCTION_INFO_V1(cosine_distance);
+
+/*
+ * Check that two arrays are vectors of the same length, and return their
+ * elements.
+ */
+static int
+check_vectors(ArrayType *a, ArrayType *b, float4 **pa, float4 **pb)
+{
+	int			na,
+				nb;
+
+	if (ARR_ELEMTYPE(a) != FLOAT4OID || ARR_ELEMTYPE(b) != FLOAT4OID)
+		elog(ERROR, "expected real[] arguments");
+	if (ARR_NDIM(a) > 1 || ARR_NDIM(b) > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+				 errmsg("vectors must be one-dimensional arrays")));
+	if (ARR_HASNULL(a) || ARR_HASNULL(b))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("vectors must not contain nulls")));
+
+	na = ArrayGetNItems(ARR_NDIM(a), ARR_DIMS(a));
+	nb = ArrayGetNItems(ARR_NDIM(b), ARR_DIMS(b));
+	if (na != nb)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("different vector dimensions %d and %d", na, nb)));
+
+	*pa = (float4 *) ARR_DATA_PTR(a);
+	*pb = (float4 *) ARR_DATA_PTR(b);
+
+	return na;
+}
+
+static double
+l2_squared(const float4 *a, const float4 *b, int n)
+{
+	double		s0 = 0,
+				s1 = 0,
+				s2 = 0,
+				s3 = 0;
+	int			i;
+
+	for (i = 0; i + 3 < n; i += 4)
+	{
+		double		d0 = (double) a[i] - b[i];
+		double		d1 = (double) a[i + 1] - b[i + 1];
+		double		d2 = (double) a[i + 2] - b[i + 2];
+		double		d3 = (double) a[i + 3] - b[i + 3];
+
+		s0 += d0 * d0;
+		s1 += d1 * d1;
+		s2 += d2 * d2;
+		s3 += d3 * d3;
+	}
+	for (; i < n; i++)
+	{
+		double		d = (double) a[i] - b[i];
+
+		s0 += d * d;
+	}
+
+	return (s0 + s1) + (s2 + s3);
+}
+
+static double
+dot_product(const float4 *a, const float4 *b, int n)
+{
+	double		s0 = 0,
+				s1 = 0,
+				s2 = 0,
+				s3 = 0;
+	int			i;
+
+	for (i = 0; i + 3 < n; i += 4)
+	{
+		s0 += (double) a[i] * b[i];
+		s1 += (double) a[i + 1] * b[i + 1];
+		s2 += (double) a[i + 2] * b[i + 2];
+		s3 += (double) a[i + 3] * b[i + 3];
+	}
+	for (; i < n; i++)
+		s0 += (double) a[i] * b[i];
+
+	return (s0 + s1) + (s2 + s3);
+}
+
+/*
+ * Euclidean distance
+ */
+Datum
+l2_distance(PG_FUNCTION_ARGS)
+{
+	ArrayType  *a = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *b = PG_GETARG_ARRAYTYPE_P(1);
+	float4	   *pa,
+			   *pb;
+	int			n;
+
+	n = check_vectors(a, b, &pa, &pb);
+
+	PG_RETURN_FLOAT8(sqrt(l2_squared(pa, pb, n)));
+}
+
+/*
+ * Inner product
+ */
+Datum
+inner_product(PG_FUNCTION_ARGS)
+{
+	ArrayType  *a = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *b = PG_GETARG_ARRAYTYPE_P(1);
+	float4	   *pa,
+			   *pb;
+	int			n;
+
+	n = check_vectors(a, b, &pa, &pb);
+
+	PG_RETURN_FLOAT8(dot_product(pa, pb, n));
+}
+
+/*
+ * Negated inner product, so that the most similar vectors sort first
+ */
+Datum
+negative_inner_product(PG_FUNCTION_ARGS)
+{
+	ArrayType  *a = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *b = PG_GETARG_ARRAYTYPE_P(1);
+	float4	   *pa,
+			   *pb;
+	int			n;
+
+	n = check_vectors(a, b, &pa, &pb);
+
+	PG_RETURN_FLOAT8(-dot_product(pa, pb, n));
+}
+
+/*
+ * Cosine distance, 1 - cosine similarity.  A zero vector has no direction,
+ * so its distance to anything is NaN.
+ */
+Datum
+cosine_distance(PG_FUNCTION_ARGS)
+{
+	ArrayType  *a = PG_GETARG_ARRAYTYPE_P(0);
+	ArrayType  *b = PG_GETARG_ARRAYTYPE_P(1);
+	float4	   *pa,
+			   *pb;
+	int			n;
+	double		dot;
+	double		norms;
+	double		similarity;
+
+	n = check_vectors(a, b, &pa, &pb);
+
+	dot = dot_product(pa, pb, n);
+	norms = sqrt(dot_product(pa, pa, n) * dot_product(pb, pb, n));
+	if (norms == 0)
+		PG_RETURN_FLOAT8(get_float8_nan());
+
+	/* Keep rounding errors from pushing the result out of [0, 2] */
+	similarity = dot / norms;
+	if (similarity > 1)
+		similarity = 1;
+	else if (similarity < -1)
+		similarity = -1;
+
+	PG_RETURN_FLOAT8(1 - similarity);
+}
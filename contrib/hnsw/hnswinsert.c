@@ -0,0 +1,450 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnswinsert.c
+ *		HNSW index build and insert functions.
+ *
+ * Inserts are serialized by holding an exclusive lock on the metapage for
+ * the whole insertion, which also protects the entry point.  Data pages are
+ * locked one at a time, after the metapage, so scans, which lock the
+ * metapage only to read the entry point, never wait for an insert to
+ * finish.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnswinsert.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/genam.h"
+#include "access/generic_xlog.h"
+#include "access/tableam.h"
+#include "access/xloginsert.h"
+#include "catalog/index.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/smgr.h"
+#include "utils/hashutils.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+#include "hnsw.h"
+
+PG_MODULE_MAGIC;
+
+/* State of hnsw index build */
+typedef struct
+{
+	HnswState	hnswstate;		/* hnsw index state */
+	int64		indtuples;		/* total number of tuples indexed */
+	MemoryContext tmpCtx;		/* temporary memory context reset after each
+								 * tuple */
+} HnswBuildState;
+
+/*
+ * Choose the top layer of a new element.
+ *
+ * The level follows the usual exponentially decaying distribution with
+ * normalization factor 1/ln(m).  It is derived from a hash of the heap TID
+ * rather than from a random number, so that building the same table twice
+ * gives the same graph.
+ */
+static int
+HnswChooseLevel(HnswState *state, ItemPointer heaptid)
+{
+	uint32		hash;
+	double		r;
+	int			level;
+
+	hash = DatumGetUInt32(hash_any((const unsigned char *) heaptid,
+								   sizeof(ItemPointerData)));
+	r = ((double) hash + 0.5) / 4294967296.0;
+
+	level = (int) floor(-log(r) / log((double) state->m));
+
+	return Min(level, HNSW_MAX_LEVEL);
+}
+
+/*
+ * Store a new element on the index's insert page, or on a new page if it
+ * does not fit there, and return its location in *tid.
+ */
+static void
+HnswPlaceElement(HnswState *state, HnswElementTuple etup, Size size,
+				 BlockNumber *insertPage, ItemPointer tid, bool building)
+{
+	Relation	index = state->index;
+	Buffer		buffer;
+	Page		page;
+	GenericXLogState *xlogState;
+	OffsetNumber offnum;
+
+	if (*insertPage != InvalidBlockNumber)
+	{
+		buffer = ReadBuffer(index, *insertPage);
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+
+		if (PageGetFreeSpace(BufferGetPage(buffer)) >= MAXALIGN(size))
+		{
+			page = HnswStartModify(index, buffer, building, 0, &xlogState);
+			offnum = PageAddItem(page, (Item) etup, size, InvalidOffsetNumber,
+								 false, false);
+			if (offnum == InvalidOffsetNumber)
+				elog(ERROR, "failed to add element to hnsw index \"%s\"",
+					 RelationGetRelationName(index));
+			HnswFinishModify(buffer, xlogState);
+
+			ItemPointerSet(tid, *insertPage, offnum);
+			UnlockReleaseBuffer(buffer);
+			return;
+		}
+
+		UnlockReleaseBuffer(buffer);
+	}
+
+	buffer = HnswNewBuffer(index);
+	page = HnswStartModify(index, buffer, building, GENERIC_XLOG_FULL_IMAGE,
+						   &xlogState);
+	HnswInitPage(page, 0);
+	offnum = PageAddItem(page, (Item) etup, size, InvalidOffsetNumber,
+						 false, false);
+	if (offnum == InvalidOffsetNumber)
+		elog(ERROR, "failed to add element to hnsw index \"%s\"",
+			 RelationGetRelationName(index));
+	HnswFinishModify(buffer, xlogState);
+
+	*insertPage = BufferGetBlockNumber(buffer);
+	ItemPointerSet(tid, *insertPage, offnum);
+	UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * Link the new element at 'newtid' into the neighbor list of the element at
+ * 'tid' on 'layer'.  If the list is full, the new element replaces the
+ * farthest neighbor, provided it is nearer than that one.
+ */
+static void
+HnswAddNeighbor(HnswState *state, ItemPointer tid, int layer,
+				ItemPointer newtid, float4 distance, bool building)
+{
+	Relation	index = state->index;
+	Buffer		buffer;
+	Page		page;
+	GenericXLogState *xlogState;
+	HnswElementTuple etup;
+	int			target = -1;
+
+	buffer = ReadBuffer(index, ItemPointerGetBlockNumber(tid));
+	LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+	page = HnswStartModify(index, buffer, building, 0, &xlogState);
+
+	etup = (HnswElementTuple) PageGetItem(page,
+										  PageGetItemId(page, ItemPointerGetOffsetNumber(tid)));
+
+	if (etup->level >= layer)
+	{
+		HnswNeighbor *slots = etup->neighbors + HnswLayerFirstSlot(state->m, layer);
+		int			nslots = HnswLayerSlots(state->m, layer);
+		int			farthest = -1;
+		int			i;
+
+		for (i = 0; i < nslots; i++)
+		{
+			if (!ItemPointerIsValid(&slots[i].tid))
+			{
+				target = i;
+				break;
+			}
+			if (farthest < 0 || slots[i].distance > slots[farthest].distance)
+				farthest = i;
+		}
+
+		if (target < 0 && farthest >= 0 && distance < slots[farthest].distance)
+			target = farthest;
+
+		if (target >= 0)
+		{
+			slots[target].tid = *newtid;
+			slots[target].distance = distance;
+		}
+	}
+
+	if (target >= 0)
+		HnswFinishModify(buffer, xlogState);
+	else
+		HnswAbortModify(xlogState);
+
+	UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * Add one value to the graph.  This is the INSERT algorithm of the HNSW
+ * paper, with the new element linked to the nearest elements found on each
+ * of its layers.
+ */
+static void
+HnswInsertValue(HnswState *state, Datum value, ItemPointer heaptid,
+				bool building)
+{
+	Relation	index = state->index;
+	int			m = state->m;
+	Buffer		metaBuffer;
+	HnswMetaPageData *meta;
+	int			dimensions;
+	int			level;
+	int			entryLevel;
+	BlockNumber insertPage;
+	List	   *entries = NIL;
+	List	   *neighbors[HNSW_MAX_LEVEL + 1];
+	HnswElementTuple etup;
+	Size		valueOffset;
+	Size		size;
+	ItemPointerData newtid;
+	int			layer;
+	int			i;
+	ListCell   *lc;
+
+	value = PointerGetDatum(PG_DETOAST_DATUM(value));
+	dimensions = HnswCheckValue(value);
+
+	level = HnswChooseLevel(state, heaptid);
+
+	valueOffset = HnswElementValueOffset(m, level);
+	size = valueOffset + VARSIZE(DatumGetPointer(value));
+	if (size > HNSW_MAX_ELEMENT_SIZE)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("index row size %zu exceeds hnsw maximum, %zu, for index \"%s\"",
+						size, (Size) HNSW_MAX_ELEMENT_SIZE,
+						RelationGetRelationName(index)),
+				 errhint("Use fewer dimensions or a smaller value of m.")));
+
+	metaBuffer = ReadBuffer(index, HNSW_METAPAGE_BLKNO);
+	LockBuffer(metaBuffer, BUFFER_LOCK_EXCLUSIVE);
+	meta = HnswPageGetMeta(BufferGetPage(metaBuffer));
+
+	if (meta->dimensions != 0 && meta->dimensions != dimensions)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_EXCEPTION),
+				 errmsg("expected %u dimensions, not %d",
+						meta->dimensions, dimensions)));
+
+	entryLevel = meta->entryLevel;
+	insertPage = meta->insertPage;
+
+	/* Find the nearest elements on each layer the new element will be on */
+	if (entryLevel >= 0)
+	{
+		HnswCandidate *entry = (HnswCandidate *) palloc0(sizeof(HnswCandidate));
+
+		entry->tid = meta->entryPoint;
+		entries = list_make1(entry);
+
+		/* Descend greedily through the layers above the new element's */
+		for (layer = entryLevel; layer > level; layer--)
+			entries = list_truncate(HnswSearchLayer(state, value, entries,
+													1, layer), 1);
+
+		for (layer = Min(level, entryLevel); layer >= 0; layer--)
+		{
+			entries = HnswSearchLayer(state, value, entries,
+									  state->efConstruction, layer);
+			neighbors[layer] = list_truncate(list_copy(entries),
+											 HnswLayerSlots(m, layer));
+		}
+	}
+
+	/* Form the new element, linked to the neighbors found */
+	etup = (HnswElementTuple) palloc0(size);
+	etup->heaptid = *heaptid;
+	etup->level = level;
+	etup->deleted = 0;
+	for (i = 0; i < HnswElementSlots(m, level); i++)
+		ItemPointerSetInvalid(&etup->neighbors[i].tid);
+	for (layer = Min(level, entryLevel); layer >= 0; layer--)
+	{
+		HnswNeighbor *slots = etup->neighbors + HnswLayerFirstSlot(m, layer);
+
+		i = 0;
+		foreach(lc, neighbors[layer])
+		{
+			HnswCandidate *c = (HnswCandidate *) lfirst(lc);
+
+			slots[i].tid = c->tid;
+			slots[i].distance = (float4) c->distance;
+			i++;
+		}
+	}
+	memcpy((Pointer) etup + valueOffset, DatumGetPointer(value),
+		   VARSIZE(DatumGetPointer(value)));
+
+	HnswPlaceElement(state, etup, size, &insertPage, &newtid, building);
+
+	/* Link the neighbors back to it */
+	for (layer = Min(level, entryLevel); layer >= 0; layer--)
+	{
+		foreach(lc, neighbors[layer])
+		{
+			HnswCandidate *c = (HnswCandidate *) lfirst(lc);
+
+			HnswAddNeighbor(state, &c->tid, layer, &newtid,
+							(float4) c->distance, building);
+		}
+	}
+
+	/* Update the metapage */
+	if (meta->dimensions == 0 || level > entryLevel ||
+		insertPage != meta->insertPage)
+	{
+		GenericXLogState *xlogState;
+		Page		metaPage;
+
+		metaPage = HnswStartModify(index, metaBuffer, building, 0, &xlogState);
+		meta = HnswPageGetMeta(metaPage);
+
+		meta->dimensions = dimensions;
+		if (level > entryLevel)
+		{
+			meta->entryPoint = newtid;
+			meta->entryLevel = level;
+		}
+		meta->insertPage = insertPage;
+
+		HnswFinishModify(metaBuffer, xlogState);
+	}
+
+	UnlockReleaseBuffer(metaBuffer);
+}
+
+/*
+ * Per-tuple callback for table_index_build_scan.
+ */
+static void
+hnswBuildCallback(Relation index, HeapTuple htup, Datum *values,
+				  bool *isnull, bool tupleIsAlive, void *state)
+{
+	HnswBuildState *buildstate = (HnswBuildState *) state;
+	MemoryContext oldCtx;
+
+	/* Nulls are not indexed */
+	if (isnull[0])
+		return;
+
+	oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+
+	HnswInsertValue(&buildstate->hnswstate, values[0], &htup->t_self, true);
+	buildstate->indtuples += 1;
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextReset(buildstate->tmpCtx);
+
+	CHECK_FOR_INTERRUPTS();
+}
+
+/*
+ * Build a new hnsw index.
+ */
+IndexBuildResult *
+hnswbuild(Relation heap, Relation index, IndexInfo *indexInfo)
+{
+	IndexBuildResult *result;
+	double		reltuples;
+	HnswBuildState buildstate;
+
+	if (RelationGetNumberOfBlocks(index) != 0)
+		elog(ERROR, "index \"%s\" already contains data",
+			 RelationGetRelationName(index));
+
+	/* Initialize the meta page */
+	HnswInitMetapage(index);
+
+	/* Initialize the hnsw build state */
+	memset(&buildstate, 0, sizeof(buildstate));
+	initHnswState(&buildstate.hnswstate, index);
+	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+											  "Hnsw build temporary context",
+											  ALLOCSET_DEFAULT_SIZES);
+
+	/* Do the heap scan */
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
+									   hnswBuildCallback, (void *) &buildstate,
+									   NULL);
+
+	MemoryContextDelete(buildstate.tmpCtx);
+
+	/*
+	 * We didn't write WAL records as we built the index, so if WAL-logging
+	 * is required, write all pages to the WAL now.
+	 */
+	if (RelationNeedsWAL(index))
+		log_newpage_range(index, MAIN_FORKNUM,
+						  0, RelationGetNumberOfBlocks(index),
+						  true);
+
+	result = (IndexBuildResult *) palloc(sizeof(IndexBuildResult));
+	result->heap_tuples = reltuples;
+	result->index_tuples = buildstate.indtuples;
+
+	return result;
+}
+
+/*
+ * Build an empty hnsw index in the initialization fork.
+ */
+void
+hnswbuildempty(Relation index)
+{
+	Page		metapage;
+
+	/* Construct metapage. */
+	metapage = (Page) palloc(BLCKSZ);
+	HnswFillMetapage(index, metapage);
+
+	/*
+	 * Write the page and log it, as blbuildempty() does and for the same
+	 * reasons.
+	 */
+	PageSetChecksumInplace(metapage, HNSW_METAPAGE_BLKNO);
+	smgrwrite(index->rd_smgr, INIT_FORKNUM, HNSW_METAPAGE_BLKNO,
+			  (char *) metapage, true);
+	log_newpage(&index->rd_smgr->smgr_rnode.node, INIT_FORKNUM,
+				HNSW_METAPAGE_BLKNO, metapage, true);
+
+	smgrimmedsync(index->rd_smgr, INIT_FORKNUM);
+}
+
+/*
+ * Insert new tuple to the hnsw index.
+ */
+bool
+hnswinsert(Relation index, Datum *values, bool *isnull,
+		   ItemPointer ht_ctid, Relation heapRel,
+		   IndexUniqueCheck checkUnique,
+		   IndexInfo *indexInfo)
+{
+	HnswState	hnswstate;
+	MemoryContext oldCtx;
+	MemoryContext insertCtx;
+
+	/* Nulls are not indexed */
+	if (isnull[0])
+		return false;
+
+	insertCtx = AllocSetContextCreate(CurrentMemoryContext,
+									  "Hnsw insert temporary context",
+									  ALLOCSET_DEFAULT_SIZES);
+
+	oldCtx = MemoryContextSwitchTo(insertCtx);
+
+	initHnswState(&hnswstate, index);
+	HnswInsertValue(&hnswstate, values[0], ht_ctid, false);
+
+	MemoryContextSwitchTo(oldCtx);
+	MemoryContextDelete(insertCtx);
+
+	return false;
+}
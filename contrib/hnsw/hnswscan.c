@@ -0,0 +1,219 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnswscan.c
+ *		HNSW index scan functions.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnswscan.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/relscan.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/bufmgr.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+#include "hnsw.h"
+
+/*
+ * Begin scan of hnsw index.
+ */
+IndexScanDesc
+hnswbeginscan(Relation r, int nkeys, int norderbys)
+{
+	IndexScanDesc scan;
+	HnswScanOpaque so;
+
+	scan = RelationGetIndexScan(r, nkeys, norderbys);
+
+	so = (HnswScanOpaque) palloc0(sizeof(HnswScanOpaqueData));
+	initHnswState(&so->state, scan->indexRelation);
+	so->scanCtx = AllocSetContextCreate(CurrentMemoryContext,
+										"Hnsw scan context",
+										ALLOCSET_DEFAULT_SIZES);
+	so->started = false;
+
+	scan->opaque = so;
+
+	return scan;
+}
+
+/*
+ * Rescan a hnsw index.
+ */
+void
+hnswrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
+		   ScanKey orderbys, int norderbys)
+{
+	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
+
+	MemoryContextReset(so->scanCtx);
+	so->started = false;
+	so->results = NIL;
+	so->next = NULL;
+
+	if (scankey && scan->numberOfKeys > 0)
+		memmove(scan->keyData, scankey,
+				scan->numberOfKeys * sizeof(ScanKeyData));
+	if (orderbys && scan->numberOfOrderBys > 0)
+		memmove(scan->orderByData, orderbys,
+				scan->numberOfOrderBys * sizeof(ScanKeyData));
+}
+
+/*
+ * End scan of hnsw index.
+ */
+void
+hnswendscan(IndexScanDesc scan)
+{
+	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
+
+	MemoryContextDelete(so->scanCtx);
+	pfree(so);
+}
+
+/*
+ * Search the graph for the hnsw.ef_search elements nearest to 'query'.
+ */
+static List *
+HnswSearch(HnswState *state, Datum query)
+{
+	ItemPointerData entryPoint;
+	int			entryLevel;
+	HnswCandidate *entry;
+	List	   *entries;
+	int			layer;
+
+	HnswGetEntryPoint(state->index, &entryPoint, &entryLevel);
+	if (entryLevel < 0)
+		return NIL;
+
+	entry = (HnswCandidate *) palloc0(sizeof(HnswCandidate));
+	entry->tid = entryPoint;
+	entries = list_make1(entry);
+
+	for (layer = entryLevel; layer > 0; layer--)
+		entries = list_truncate(HnswSearchLayer(state, query, entries,
+												1, layer), 1);
+
+	return HnswSearchLayer(state, query, entries, hnsw_ef_search, 0);
+}
+
+/*
+ * Return the next element of a physical-order scan of the index, which is
+ * used when the ORDER BY value is NULL and so every row sorts equal.
+ */
+static bool
+HnswNextPhysical(IndexScanDesc scan)
+{
+	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
+	Relation	index = scan->indexRelation;
+	BlockNumber npages = RelationGetNumberOfBlocks(index);
+
+	for (; so->curBlkno < npages; so->curBlkno++, so->curOffset = FirstOffsetNumber)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber maxOffset;
+
+		CHECK_FOR_INTERRUPTS();
+
+		buffer = ReadBuffer(index, so->curBlkno);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+		maxOffset = PageGetMaxOffsetNumber(page);
+
+		for (; so->curOffset <= maxOffset; so->curOffset++)
+		{
+			HnswElementTuple etup;
+
+			etup = (HnswElementTuple) PageGetItem(page,
+												  PageGetItemId(page, so->curOffset));
+			if (etup->deleted)
+				continue;
+
+			scan->xs_heaptid = etup->heaptid;
+			so->curOffset++;
+			UnlockReleaseBuffer(buffer);
+			return true;
+		}
+
+		UnlockReleaseBuffer(buffer);
+	}
+
+	return false;
+}
+
+/*
+ * Get next tuple from hnsw index scan.
+ */
+bool
+hnswgettuple(IndexScanDesc scan, ScanDirection dir)
+{
+	HnswScanOpaque so = (HnswScanOpaque) scan->opaque;
+
+	if (!so->started)
+	{
+		MemoryContext oldCtx = MemoryContextSwitchTo(so->scanCtx);
+
+		if (scan->numberOfOrderBys == 0)
+			elog(ERROR, "hnsw index scans require an ORDER BY distance");
+
+		pgstat_count_index_scan(scan->indexRelation);
+
+		so->nullScan = (scan->orderByData[0].sk_flags & SK_ISNULL) != 0;
+		if (so->nullScan)
+		{
+			so->curBlkno = HNSW_HEAD_BLKNO;
+			so->curOffset = FirstOffsetNumber;
+		}
+		else
+		{
+			Datum		query = scan->orderByData[0].sk_argument;
+
+			query = PointerGetDatum(PG_DETOAST_DATUM(query));
+			so->results = HnswSearch(&so->state, query);
+			so->next = list_head(so->results);
+		}
+
+		so->started = true;
+		MemoryContextSwitchTo(oldCtx);
+	}
+
+	scan->xs_recheck = false;
+	scan->xs_recheckorderby = false;
+
+	if (so->nullScan)
+	{
+		if (!HnswNextPhysical(scan))
+			return false;
+
+		scan->xs_orderbyvals[0] = (Datum) 0;
+		scan->xs_orderbynulls[0] = true;
+		return true;
+	}
+
+	while (so->next != NULL)
+	{
+		HnswCandidate *c = (HnswCandidate *) lfirst(so->next);
+
+		so->next = lnext(so->next);
+
+		/* Deleted elements still guide the search but are not returned */
+		if (c->deleted)
+			continue;
+
+		scan->xs_heaptid = c->heaptid;
+		scan->xs_orderbyvals[0] = Float8GetDatum(c->distance);
+		scan->xs_orderbynulls[0] = false;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,578 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnswutils.c
+ *		HNSW index utilities and graph search.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnswutils.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/amapi.h"
+#include "access/generic_xlog.h"
+#include "access/reloptions.h"
+#include "catalog/index.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+#include "storage/lmgr.h"
+#include "utils/array.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#include "hnsw.h"
+
+PG_FUNCTION_INFO_V1(hnswhandler);
+
+/* GUC variable */
+int			hnsw_ef_search = HNSW_DEFAULT_EF_SEARCH;
+
+/* Kind of relation options for hnsw index */
+static relopt_kind hnsw_relopt_kind;
+
+/* parse table for fillRelOptions */
+static relopt_parse_elt hnsw_relopt_tab[2];
+
+/*
+ * Module initialize function: initialize info about hnsw relation options
+ * and the hnsw.ef_search setting.
+ */
+void
+_PG_init(void)
+{
+	hnsw_relopt_kind = add_reloption_kind();
+
+	add_int_reloption(hnsw_relopt_kind, "m",
+					  "Number of neighbors kept per element and layer",
+					  HNSW_DEFAULT_M, HNSW_MIN_M, HNSW_MAX_M);
+	hnsw_relopt_tab[0].optname = "m";
+	hnsw_relopt_tab[0].opttype = RELOPT_TYPE_INT;
+	hnsw_relopt_tab[0].offset = offsetof(HnswOptions, m);
+
+	add_int_reloption(hnsw_relopt_kind, "ef_construction",
+					  "Size of the candidate list used while building the graph",
+					  HNSW_DEFAULT_EF_CONSTRUCTION, HNSW_MIN_EF_CONSTRUCTION,
+					  HNSW_MAX_EF_CONSTRUCTION);
+	hnsw_relopt_tab[1].optname = "ef_construction";
+	hnsw_relopt_tab[1].opttype = RELOPT_TYPE_INT;
+	hnsw_relopt_tab[1].offset = offsetof(HnswOptions, efConstruction);
+
+	DefineCustomIntVariable("hnsw.ef_search",
+							"Sets the size of the candidate list used by hnsw index scans.",
+							"An index scan returns at most this many rows.",
+							&hnsw_ef_search,
+							HNSW_DEFAULT_EF_SEARCH,
+							1, HNSW_MAX_EF_SEARCH,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	EmitWarningsOnPlaceholders("hnsw");
+}
+
+/*
+ * HNSW handler function: return IndexAmRoutine with access method parameters
+ * and callbacks.
+ */
+Datum
+hnswhandler(PG_FUNCTION_ARGS)
+{
+	IndexAmRoutine *amroutine = makeNode(IndexAmRoutine);
+
+	amroutine->amstrategies = HNSW_NSTRATEGIES;
+	amroutine->amsupport = HNSW_NPROC;
+	amroutine->amcanorder = false;
+	amroutine->amcanorderbyop = true;
+	amroutine->amcanbackward = false;
+	amroutine->amcanunique = false;
+	amroutine->amcanmulticol = false;
+	amroutine->amoptionalkey = true;
+	amroutine->amsearcharray = false;
+	amroutine->amsearchnulls = false;
+	amroutine->amstorage = false;
+	amroutine->amclusterable = false;
+	amroutine->ampredlocks = false;
+	amroutine->amcanparallel = false;
+	amroutine->amcanbuildparallel = false;
+	amroutine->amcanparallelvacuum = true;
+	amroutine->amcaninclude = false;
+	amroutine->amkeytype = InvalidOid;
+
+	amroutine->ambuild = hnswbuild;
+	amroutine->ambuildempty = hnswbuildempty;
+	amroutine->aminsert = hnswinsert;
+	amroutine->aminsertbatch = NULL;
+	amroutine->ambulkdelete = hnswbulkdelete;
+	amroutine->amvacuumcleanup = hnswvacuumcleanup;
+	amroutine->amcanreturn = NULL;
+	amroutine->amcostestimate = hnswcostestimate;
+	amroutine->amoptions = hnswoptions;
+	amroutine->amproperty = NULL;
+	amroutine->ambuildphasename = NULL;
+	amroutine->amvalidate = hnswvalidate;
+	amroutine->ambeginscan = hnswbeginscan;
+	amroutine->amrescan = hnswrescan;
+	amroutine->amgettuple = hnswgettuple;
+	amroutine->amgetbitmap = NULL;
+	amroutine->amendscan = hnswendscan;
+	amroutine->ammarkpos = NULL;
+	amroutine->amrestrpos = NULL;
+	amroutine->amestimateparallelscan = NULL;
+	amroutine->aminitparallelscan = NULL;
+	amroutine->amparallelrescan = NULL;
+
+	PG_RETURN_POINTER(amroutine);
+}
+
+/*
+ * Fill HnswState structure for particular index.
+ */
+void
+initHnswState(HnswState *state, Relation index)
+{
+	HnswOptions *opts;
+
+	state->index = index;
+	fmgr_info_copy(&state->distanceFn,
+				   index_getprocinfo(index, 1, HNSW_DISTANCE_PROC),
+				   CurrentMemoryContext);
+	state->collation = index->rd_indcollation[0];
+
+	/* Initialize amcache if needed with options from metapage */
+	if (!index->rd_amcache)
+	{
+		Buffer		buffer;
+		Page		page;
+		HnswMetaPageData *meta;
+
+		opts = MemoryContextAlloc(index->rd_indexcxt, sizeof(HnswOptions));
+
+		buffer = ReadBuffer(index, HNSW_METAPAGE_BLKNO);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+
+		page = BufferGetPage(buffer);
+
+		if (!HnswPageIsMeta(page))
+			elog(ERROR, "relation is not an hnsw index");
+		meta = HnswPageGetMeta(page);
+
+		if (meta->magickNumber != HNSW_MAGICK_NUMBER)
+			elog(ERROR, "relation is not an hnsw index");
+
+		opts->m = meta->m;
+		opts->efConstruction = meta->efConstruction;
+
+		UnlockReleaseBuffer(buffer);
+
+		index->rd_amcache = (void *) opts;
+	}
+
+	opts = (HnswOptions *) index->rd_amcache;
+	state->m = opts->m;
+	state->efConstruction = opts->efConstruction;
+}
+
+/*
+ * Initialize any page of an hnsw index.
+ */
+void
+HnswInitPage(Page page, uint16 flags)
+{
+	HnswPageOpaque opaque;
+
+	PageInit(page, BLCKSZ, sizeof(HnswPageOpaqueData));
+
+	opaque = HnswPageGetOpaque(page);
+	memset(opaque, 0, sizeof(HnswPageOpaqueData));
+	opaque->flags = flags;
+	opaque->hnsw_page_id = HNSW_PAGE_ID;
+}
+
+/*
+ * Fill in metapage for hnsw index.
+ */
+void
+HnswFillMetapage(Relation index, Page metaPage)
+{
+	HnswOptions *opts = (HnswOptions *) index->rd_options;
+	HnswMetaPageData *metadata;
+
+	HnswInitPage(metaPage, HNSW_META);
+	metadata = HnswPageGetMeta(metaPage);
+	memset(metadata, 0, sizeof(HnswMetaPageData));
+	metadata->magickNumber = HNSW_MAGICK_NUMBER;
+	metadata->dimensions = 0;
+
+	/* The options are frozen for the life of the index */
+	metadata->m = opts ? opts->m : HNSW_DEFAULT_M;
+	metadata->efConstruction = opts ? opts->efConstruction :
+		HNSW_DEFAULT_EF_CONSTRUCTION;
+
+	metadata->entryLevel = -1;
+	ItemPointerSetInvalid(&metadata->entryPoint);
+	metadata->insertPage = InvalidBlockNumber;
+	((PageHeader) metaPage)->pd_lower += sizeof(HnswMetaPageData);
+}
+
+/*
+ * Initialize metapage for hnsw index.
+ */
+void
+HnswInitMetapage(Relation index)
+{
+	Buffer		metaBuffer;
+	Page		metaPage;
+	GenericXLogState *state;
+
+	/*
+	 * Make a new page; since it is first page it should be associated with
+	 * block number 0 (HNSW_METAPAGE_BLKNO).
+	 */
+	metaBuffer = HnswNewBuffer(index);
+	Assert(BufferGetBlockNumber(metaBuffer) == HNSW_METAPAGE_BLKNO);
+
+	/* Initialize contents of meta page */
+	state = GenericXLogStart(index);
+	metaPage = GenericXLogRegisterBuffer(state, metaBuffer,
+										 GENERIC_XLOG_FULL_IMAGE);
+	HnswFillMetapage(index, metaPage);
+	GenericXLogFinish(state);
+
+	UnlockReleaseBuffer(metaBuffer);
+}
+
+/*
+ * Allocate a new page by extending the index file.  Elements are never
+ * removed, so there are no free pages to recycle.
+ *
+ * The returned buffer is already pinned and exclusive-locked.  Caller is
+ * responsible for initializing the page by calling HnswInitPage.
+ */
+Buffer
+HnswNewBuffer(Relation index)
+{
+	Buffer		buffer;
+	bool		needLock;
+
+	needLock = !RELATION_IS_LOCAL(index);
+	if (needLock)
+		LockRelationForExtension(index, ExclusiveLock);
+
+	buffer = ReadBuffer(index, P_NEW);
+	LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+
+	if (needLock)
+		UnlockRelationForExtension(index, ExclusiveLock);
+
+	return buffer;
+}
+
+/*
+ * Begin modifying an exclusive-locked page, returning the image to change.
+ *
+ * While the index is being built nothing is WAL-logged, since hnswbuild()
+ * logs all pages at the end; otherwise changes go through generic WAL.
+ */
+Page
+HnswStartModify(Relation index, Buffer buffer, bool building, int flags,
+				GenericXLogState **xlogState)
+{
+	if (building)
+	{
+		*xlogState = NULL;
+		return BufferGetPage(buffer);
+	}
+
+	*xlogState = GenericXLogStart(index);
+	return GenericXLogRegisterBuffer(*xlogState, buffer, flags);
+}
+
+/*
+ * Apply the changes made since HnswStartModify().
+ */
+void
+HnswFinishModify(Buffer buffer, GenericXLogState *xlogState)
+{
+	if (xlogState)
+		GenericXLogFinish(xlogState);
+	else
+		MarkBufferDirty(buffer);
+}
+
+/*
+ * Forget about a modification started with HnswStartModify() that made no
+ * changes.
+ */
+void
+HnswAbortModify(GenericXLogState *xlogState)
+{
+	if (xlogState)
+		GenericXLogAbort(xlogState);
+}
+
+/*
+ * Check that a value can be indexed, and return its number of dimensions.
+ */
+int
+HnswCheckValue(Datum value)
+{
+	ArrayType  *array = DatumGetArrayTypeP(value);
+
+	if (ARR_NDIM(array) != 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR),
+				 errmsg("hnsw index values must be one-dimensional arrays")));
+	if (ARR_HASNULL(array))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("hnsw index values must not contain nulls")));
+
+	return ARR_DIMS(array)[0];
+}
+
+/*
+ * Read the graph's entry point from the metapage.  *entryLevel is set to -1
+ * if the index is empty.
+ */
+void
+HnswGetEntryPoint(Relation index, ItemPointer entryPoint, int *entryLevel)
+{
+	Buffer		buffer;
+	HnswMetaPageData *meta;
+
+	buffer = ReadBuffer(index, HNSW_METAPAGE_BLKNO);
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	meta = HnswPageGetMeta(BufferGetPage(buffer));
+
+	*entryPoint = meta->entryPoint;
+	*entryLevel = meta->entryLevel;
+
+	UnlockReleaseBuffer(buffer);
+}
+
+/*
+ * Read the element at 'tid', compute its distance to 'query' and collect its
+ * links on 'layer'.
+ */
+HnswCandidate *
+HnswLoadCandidate(HnswState *state, ItemPointer tid, Datum query, int layer)
+{
+	HnswCandidate *c = (HnswCandidate *) palloc(sizeof(HnswCandidate));
+	Buffer		buffer;
+	Page		page;
+	HnswElementTuple etup;
+
+	buffer = ReadBuffer(state->index, ItemPointerGetBlockNumber(tid));
+	LockBuffer(buffer, BUFFER_LOCK_SHARE);
+	page = BufferGetPage(buffer);
+	etup = (HnswElementTuple) PageGetItem(page,
+										  PageGetItemId(page, ItemPointerGetOffsetNumber(tid)));
+
+	c->tid = *tid;
+	c->heaptid = etup->heaptid;
+	c->deleted = etup->deleted != 0;
+	c->distance = DatumGetFloat8(FunctionCall2Coll(&state->distanceFn,
+												   state->collation,
+												   query,
+												   PointerGetDatum(HnswElementGetValue(etup, state->m))));
+	c->nneighbors = 0;
+	c->neighbors = NULL;
+
+	if (etup->level >= layer)
+	{
+		HnswNeighbor *slots = etup->neighbors + HnswLayerFirstSlot(state->m, layer);
+		int			nslots = HnswLayerSlots(state->m, layer);
+		int			i;
+
+		c->neighbors = (ItemPointerData *) palloc(sizeof(ItemPointerData) * nslots);
+		for (i = 0; i < nslots; i++)
+		{
+			if (ItemPointerIsValid(&slots[i].tid))
+				c->neighbors[c->nneighbors++] = slots[i].tid;
+		}
+	}
+
+	UnlockReleaseBuffer(buffer);
+
+	return c;
+}
+
+/*
+ * Comparator for the heap of candidates still to expand: nearest first.
+ */
+static int
+candidate_nearest_cmp(const pairingheap_node *a, const pairingheap_node *b,
+					  void *arg)
+{
+	const HnswCandidate *ca = pairingheap_const_container(HnswCandidate, c_node, a);
+	const HnswCandidate *cb = pairingheap_const_container(HnswCandidate, c_node, b);
+
+	if (ca->distance < cb->distance)
+		return 1;
+	if (ca->distance > cb->distance)
+		return -1;
+	return 0;
+}
+
+/*
+ * Comparator for the heap of best elements found so far: farthest first.
+ */
+static int
+candidate_farthest_cmp(const pairingheap_node *a, const pairingheap_node *b,
+					   void *arg)
+{
+	const HnswCandidate *ca = pairingheap_const_container(HnswCandidate, w_node, a);
+	const HnswCandidate *cb = pairingheap_const_container(HnswCandidate, w_node, b);
+
+	if (ca->distance > cb->distance)
+		return 1;
+	if (ca->distance < cb->distance)
+		return -1;
+	return 0;
+}
+
+/*
+ * Search one layer of the graph for the 'ef' elements nearest to 'query',
+ * starting from the elements in 'entries' (HnswCandidates, of which only the
+ * TIDs are used).  Returns a list of HnswCandidates, nearest first.
+ *
+ * This is the SEARCH-LAYER algorithm of Malkov and Yashunin, "Efficient and
+ * robust approximate nearest neighbor search using Hierarchical Navigable
+ * Small World graphs": expand the nearest unexpanded candidate until it is
+ * farther than the farthest of the best 'ef' elements found.
+ */
+List *
+HnswSearchLayer(HnswState *state, Datum query, List *entries, int ef,
+				int layer)
+{
+	pairingheap *candidates;
+	pairingheap *found;
+	int			nfound = 0;
+	HTAB	   *visited;
+	HASHCTL		hash_ctl;
+	HnswCandidate **sorted;
+	List	   *result = NIL;
+	ListCell   *lc;
+	int			i;
+
+	candidates = pairingheap_allocate(candidate_nearest_cmp, NULL);
+	found = pairingheap_allocate(candidate_farthest_cmp, NULL);
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(ItemPointerData);
+	hash_ctl.entrysize = sizeof(ItemPointerData);
+	hash_ctl.hcxt = CurrentMemoryContext;
+	visited = hash_create("hnsw visited elements", 256, &hash_ctl,
+						  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	foreach(lc, entries)
+	{
+		HnswCandidate *entry = (HnswCandidate *) lfirst(lc);
+		HnswCandidate *c;
+		bool		isfound;
+
+		hash_search(visited, &entry->tid, HASH_ENTER, &isfound);
+		if (isfound)
+			continue;
+
+		c = HnswLoadCandidate(state, &entry->tid, query, layer);
+		pairingheap_add(candidates, &c->c_node);
+		pairingheap_add(found, &c->w_node);
+		nfound++;
+	}
+
+	while (nfound > ef)
+	{
+		pairingheap_remove_first(found);
+		nfound--;
+	}
+
+	while (!pairingheap_is_empty(candidates))
+	{
+		HnswCandidate *c;
+		HnswCandidate *farthest;
+
+		CHECK_FOR_INTERRUPTS();
+
+		c = pairingheap_container(HnswCandidate, c_node,
+								  pairingheap_remove_first(candidates));
+		farthest = pairingheap_container(HnswCandidate, w_node,
+										 pairingheap_first(found));
+
+		if (c->distance > farthest->distance)
+			break;
+
+		for (i = 0; i < c->nneighbors; i++)
+		{
+			HnswCandidate *e;
+			bool		isfound;
+
+			hash_search(visited, &c->neighbors[i], HASH_ENTER, &isfound);
+			if (isfound)
+				continue;
+
+			e = HnswLoadCandidate(state, &c->neighbors[i], query, layer);
+			farthest = pairingheap_container(HnswCandidate, w_node,
+											 pairingheap_first(found));
+
+			if (nfound < ef || e->distance < farthest->distance)
+			{
+				pairingheap_add(candidates, &e->c_node);
+				pairingheap_add(found, &e->w_node);
+				nfound++;
+
+				if (nfound > ef)
+				{
+					pairingheap_remove_first(found);
+					nfound--;
+				}
+			}
+			else
+			{
+				if (e->neighbors)
+					pfree(e->neighbors);
+				pfree(e);
+			}
+		}
+	}
+
+	/* Return the elements found, nearest first */
+	sorted = (HnswCandidate **) palloc(sizeof(HnswCandidate *) * Max(nfound, 1));
+	for (i = nfound - 1; i >= 0; i--)
+		sorted[i] = pairingheap_container(HnswCandidate, w_node,
+										  pairingheap_remove_first(found));
+	for (i = 0; i < nfound; i++)
+		result = lappend(result, sorted[i]);
+
+	pfree(sorted);
+	hash_destroy(visited);
+	pairingheap_free(candidates);
+	pairingheap_free(found);
+
+	return result;
+}
+
+/*
+ * Parse reloptions for hnsw index, producing a HnswOptions struct.
+ */
+bytea *
+hnswoptions(Datum reloptions, bool validate)
+{
+	relopt_value *options;
+	int			numoptions;
+	HnswOptions *rdopts;
+
+	/* Parse the user-given reloptions */
+	options = parseRelOptions(reloptions, validate, hnsw_relopt_kind, &numoptions);
+	rdopts = allocateReloptStruct(sizeof(HnswOptions), options, numoptions);
+	fillRelOptions((void *) rdopts, sizeof(HnswOptions), options, numoptions,
+				   validate, hnsw_relopt_tab, lengthof(hnsw_relopt_tab));
+
+	return (bytea *) rdopts;
+}
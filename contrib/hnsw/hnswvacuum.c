@@ -0,0 +1,146 @@
+/*-------------------------------------------------------------------------
+ *
+ * hnswvacuum.c
+ *		HNSW VACUUM functions.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/hnsw/hnswvacuum.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/generic_xlog.h"
+#include "commands/vacuum.h"
+#include "miscadmin.h"
+#include "storage/bufmgr.h"
+
+#include "hnsw.h"
+
+/*
+ * Bulk deletion of all index entries pointing to a set of heap tuples.
+ *
+ * Elements of dead tuples are only marked deleted: other elements link to
+ * them, and removing them would need the graph to be repaired around the
+ * hole.  Deleted elements are skipped by scans but still used to navigate.
+ */
+IndexBulkDeleteResult *
+hnswbulkdelete(IndexVacuumInfo *info, IndexBulkDeleteResult *stats,
+			   IndexBulkDeleteCallback callback, void *callback_state)
+{
+	Relation	index = info->index;
+	BlockNumber blkno,
+				npages;
+
+	if (stats == NULL)
+		stats = (IndexBulkDeleteResult *) palloc0(sizeof(IndexBulkDeleteResult));
+
+	/*
+	 * Iterate over the pages. We don't care about concurrently added pages,
+	 * they can't contain tuples to delete.
+	 */
+	npages = RelationGetNumberOfBlocks(index);
+	for (blkno = HNSW_HEAD_BLKNO; blkno < npages; blkno++)
+	{
+		Buffer		buffer;
+		Page		page;
+		GenericXLogState *gxlogState;
+		OffsetNumber offnum,
+					maxoff;
+		bool		changed = false;
+
+		vacuum_delay_point();
+
+		buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno,
+									RBM_NORMAL, info->strategy);
+
+		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+		gxlogState = GenericXLogStart(index);
+		page = GenericXLogRegisterBuffer(gxlogState, buffer, 0);
+
+		maxoff = PageIsNew(page) ? InvalidOffsetNumber :
+			PageGetMaxOffsetNumber(page);
+		for (offnum = FirstOffsetNumber; offnum <= maxoff; offnum++)
+		{
+			HnswElementTuple etup;
+
+			etup = (HnswElementTuple) PageGetItem(page,
+												  PageGetItemId(page, offnum));
+			if (etup->deleted)
+				continue;
+
+			if (callback(&etup->heaptid, callback_state))
+			{
+				etup->deleted = 1;
+				stats->tuples_removed += 1;
+				changed = true;
+			}
+		}
+
+		if (changed)
+			GenericXLogFinish(gxlogState);
+		else
+			GenericXLogAbort(gxlogState);
+		UnlockReleaseBuffer(buffer);
+	}
+
+	return stats;
+}
+
+/*
+ * Post-VACUUM cleanup.
+ *
+ * Result: a palloc'd struct containing statistical info for VACUUM displays.
+ */
+IndexBulkDeleteResult *
+hnswvacuumcleanup(IndexVacuumInfo *info, IndexBulkDeleteResult *stats)
+{
+	Relation	index = info->index;
+	BlockNumber npages,
+				blkno;
+
+	if (info->analyze_only)
+		return stats;
+
+	if (stats == NULL)
+		stats = (IndexBulkDeleteResult *) palloc0(sizeof(IndexBulkDeleteResult));
+
+	/* Count the live elements; no space is ever reclaimed */
+	npages = RelationGetNumberOfBlocks(index);
+	stats->num_pages = npages;
+	stats->pages_free = 0;
+	stats->num_index_tuples = 0;
+	for (blkno = HNSW_HEAD_BLKNO; blkno < npages; blkno++)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber offnum,
+					maxoff;
+
+		vacuum_delay_point();
+
+		buffer = ReadBufferExtended(index, MAIN_FORKNUM, blkno,
+									RBM_NORMAL, info->strategy);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+
+		maxoff = PageIsNew(page) ? InvalidOffsetNumber :
+			PageGetMaxOffsetNumber(page);
+		for (offnum = FirstOffsetNumber; offnum <= maxoff; offnum++)
+		{
+			HnswElementTuple etup;
+
+			etup = (HnswElementTuple) PageGetItem(page,
+												  PageGetItemId(page, offnum));
+			if (!etup->deleted)
+				stats->num_index_tuples += 1;
+		}
+
+		UnlockReleaseBuffer(buffer);
+	}
+
+	return stats;
+}
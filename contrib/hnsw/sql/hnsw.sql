@@ -0,0 +1,42 @@
+CREATE EXTENSION hnsw;
+
+-- distance functions
+SELECT l2_distance('{0,0}', '{3,4}');
+SELECT inner_product('{1,2}', '{3,4}');
+SELECT '{1,2}'::real[] <#> '{3,4}';
+SELECT cosine_distance('{1,1}', '{2,2}');
+SELECT '{1,0}'::real[] <=> '{0,1}';
+SELECT l2_distance('{1,2}', '{1,2,3}');
+
+CREATE TABLE tst (
+	id	int4,
+	v	real[]
+);
+
+INSERT INTO tst SELECT i, ARRAY[i, 10 - i, i % 4] FROM generate_series(1, 10) i;
+CREATE INDEX hnswidx ON tst USING hnsw (v) WITH (m = 8);
+
+SET enable_seqscan=off;
+
+EXPLAIN (COSTS OFF) SELECT id FROM tst ORDER BY v <-> '{3,7,3}' LIMIT 3;
+SELECT id, v <-> '{3,7,3}' AS dist FROM tst ORDER BY v <-> '{3,7,3}' LIMIT 3;
+
+-- inserts into an existing index
+INSERT INTO tst VALUES (11, '{3,7,2}'), (12, NULL);
+INSERT INTO tst VALUES (13, '{1,2}');
+SELECT id, v <-> '{3,7,3}' AS dist FROM tst ORDER BY v <-> '{3,7,3}' LIMIT 3;
+
+-- deleted rows are no longer returned
+DELETE FROM tst WHERE id = 3;
+VACUUM tst;
+SELECT id, v <-> '{3,7,3}' AS dist FROM tst ORDER BY v <-> '{3,7,3}' LIMIT 3;
+
+-- other operator classes
+CREATE INDEX hnswcosidx ON tst USING hnsw (v real_cosine_ops);
+EXPLAIN (COSTS OFF) SELECT id FROM tst ORDER BY v <=> '{1,1,1}' LIMIT 3;
+SELECT id FROM tst ORDER BY v <=> '{1,1,1}' LIMIT 3;
+
+CREATE INDEX hnswbadidx ON tst USING hnsw (v) WITH (m = 1);
+
+RESET enable_seqscan;
+DROP TABLE tst;
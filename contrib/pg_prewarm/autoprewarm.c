@@ -10,11 +10,14 @@
  *		and we need to lock the relations so that we don't try to prewarm
  *		pages from a relation that is in the process of being dropped.
  *
- *		While prewarming, autoprewarm will use two workers.  There's a
- *		master worker that reads and sorts the list of blocks to be
- *		prewarmed and then launches a per-database worker for each
- *		relevant database in turn.  The former keeps running after the
- *		initial prewarm is complete to update the dump file periodically.
+ *		While prewarming, autoprewarm uses a master worker that reads and
+ *		sorts the list of blocks to be prewarmed, splits it into chunks that
+ *		each belong to a single database, and launches per-database workers
+ *		to load the chunks, up to pg_prewarm.autoprewarm_workers of them at
+ *		a time.  Each of those reads the blocks of a relation fork through a
+ *		streaming read, so that sequential runs of blocks are prefetched
+ *		ahead of being read.  The master keeps running after the initial
+ *		prewarm is complete to update the dump file periodically.
  *
  *	Copyright (c) 2016-2019, PostgreSQL Global Development Group
  *
@@ -54,6 +57,12 @@
 
 #define AUTOPREWARM_FILE "autoprewarm.blocks"
 
+/* Upper limit for pg_prewarm.autoprewarm_workers */
+#define AUTOPREWARM_MAX_WORKERS		64
+
+/* Don't split the blocks of a database into chunks smaller than this */
+#define AUTOPREWARM_MIN_CHUNK		8192
+
 /* Metadata for each block we dump. */
 typedef struct BlockInfoRecord
 {
@@ -64,6 +73,14 @@ typedef struct BlockInfoRecord
 	BlockNumber blocknum;
 } BlockInfoRecord;
 
+/* A chunk of the block list, to be loaded by one per-database worker. */
+typedef struct AutoPrewarmTask
+{
+	Oid			database;		/* database to connect to */
+	int			start_idx;		/* first BlockInfoRecord to load */
+	int			stop_idx;		/* one past the last one */
+} AutoPrewarmTask;
+
 /* Shared state information for autoprewarm bgworker. */
 typedef struct AutoPrewarmSharedState
 {
@@ -71,14 +88,23 @@ typedef struct AutoPrewarmSharedState
 	pid_t		bgworker_pid;	/* for main bgworker */
 	pid_t		pid_using_dumpfile; /* for autoprewarm or block dump */
 
-	/* Following items are for communication with per-database worker */
+	/* Following items are for communication with per-database workers */
 	dsm_handle	block_info_handle;
-	Oid			database;
-	int			prewarm_start_idx;
-	int			prewarm_stop_idx;
-	int			prewarmed_blocks;
+	pg_atomic_uint32 prewarmed_blocks;
+
+	/* task of the worker started with each bgw_main_arg */
+	AutoPrewarmTask tasks[AUTOPREWARM_MAX_WORKERS];
 } AutoPrewarmSharedState;
 
+/* State of the streaming read over one relation fork's blocks. */
+typedef struct AutoPrewarmStream
+{
+	BlockInfoRecord *block_info;
+	int			pos;			/* next BlockInfoRecord to return */
+	int			stop;			/* end of this fork's records */
+	BlockNumber nblocks;		/* size of the fork */
+} AutoPrewarmStream;
+
 void		_PG_init(void);
 void		autoprewarm_main(Datum main_arg);
 void		autoprewarm_database_main(Datum main_arg);
@@ -89,7 +115,11 @@ PG_FUNCTION_INFO_V1(autoprewarm_dump_now);
 static void apw_load_buffers(void);
 static int	apw_dump_now(bool is_bgworker, bool dump_unlogged);
 static void apw_start_master_worker(void);
-static void apw_start_database_worker(void);
+static void apw_run_task(BackgroundWorkerHandle **handles, int nworkers,
+						 int *next_slot, Oid database, int start_idx,
+						 int stop_idx);
+static BackgroundWorkerHandle *apw_start_database_worker(int slot);
+static BlockNumber apw_next_block(void *callback_private);
 static bool apw_init_shmem(void);
 static void apw_detach_shmem(int code, Datum arg);
 static int	apw_compare_blockinfo(const void *p, const void *q);
@@ -106,6 +136,7 @@ static AutoPrewarmSharedState *apw_state = NULL;
 /* GUC variables. */
 static bool autoprewarm = true; /* start worker? */
 static int	autoprewarm_interval;	/* dump interval */
+static int	autoprewarm_workers;	/* max concurrent per-database workers */
 
 /*
  * Module load callback.
@@ -125,6 +156,18 @@ _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("pg_prewarm.autoprewarm_workers",
+							"Sets the maximum number of workers loading blocks concurrently.",
+							NULL,
+							&autoprewarm_workers,
+							4,
+							1, AUTOPREWARM_MAX_WORKERS,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	if (!process_shared_preload_libraries_in_progress)
 		return;
 
@@ -264,8 +307,8 @@ autoprewarm_main(Datum main_arg)
 }
 
 /*
- * Read the dump file and launch per-database workers one at a time to
- * prewarm the buffers found there.
+ * Read the dump file and launch per-database workers to prewarm the buffers
+ * found there.
  */
 static void
 apw_load_buffers(void)
@@ -275,6 +318,10 @@ apw_load_buffers(void)
 				i;
 	BlockInfoRecord *blkinfo;
 	dsm_segment *seg;
+	BackgroundWorkerHandle **handles;
+	int			nworkers;
+	int			next_slot = 0;
+	int			start_idx;
 
 	/*
 	 * Skip the prewarm if the dump file is in use; otherwise, prevent any
@@ -346,18 +393,23 @@ apw_load_buffers(void)
 
 	/* Populate shared memory state. */
 	apw_state->block_info_handle = dsm_segment_handle(seg);
-	apw_state->prewarm_start_idx = apw_state->prewarm_stop_idx = 0;
-	apw_state->prewarmed_blocks = 0;
+	pg_atomic_write_u32(&apw_state->prewarmed_blocks, 0);
+
+	nworkers = autoprewarm_workers;
+	handles = (BackgroundWorkerHandle **)
+		palloc0(sizeof(BackgroundWorkerHandle *) * nworkers);
 
 	/* Get the info position of the first block of the next database. */
-	while (apw_state->prewarm_start_idx < num_elements)
+	start_idx = 0;
+	while (start_idx < num_elements)
 	{
-		int			j = apw_state->prewarm_start_idx;
+		int			j = start_idx;
 		Oid			current_db = blkinfo[j].database;
+		int			chunk_size;
 
 		/*
-		 * Advance the prewarm_stop_idx to the first BlockInfoRecord that does
-		 * not belong to this database.
+		 * Advance j to the first BlockInfoRecord that does not belong to this
+		 * database.
 		 */
 		j++;
 		while (j < num_elements)
@@ -384,24 +436,43 @@ apw_load_buffers(void)
 		if (current_db == InvalidOid)
 			break;
 
-		/* Configure stop point and database for next per-database worker. */
-		apw_state->prewarm_stop_idx = j;
-		apw_state->database = current_db;
-		Assert(apw_state->prewarm_start_idx < apw_state->prewarm_stop_idx);
-
-		/* If we've run out of free buffers, don't launch another worker. */
-		if (!have_free_buffer())
-			break;
-
 		/*
-		 * Start a per-database worker to load blocks for this database; this
-		 * function will return once the per-database worker exits.
+		 * Split the database's blocks into as many chunks as we can have
+		 * workers, unless that would make them too small to be worth a
+		 * worker of their own.  Each chunk is handed to a worker as soon as
+		 * one is available, so different databases are loaded concurrently
+		 * as well.
 		 */
-		apw_start_database_worker();
+		chunk_size = Max((j - start_idx + nworkers - 1) / nworkers,
+						 AUTOPREWARM_MIN_CHUNK);
+
+		while (start_idx < j)
+		{
+			int			stop_idx = Min(start_idx + chunk_size, j);
 
-		/* Prepare for next database. */
-		apw_state->prewarm_start_idx = apw_state->prewarm_stop_idx;
+			/* If we've run out of free buffers, don't launch more workers. */
+			if (!have_free_buffer())
+				break;
+
+			apw_run_task(handles, nworkers, &next_slot, current_db,
+						 start_idx, stop_idx);
+			start_idx = stop_idx;
+		}
+
+		if (start_idx < j)
+			break;
+	}
+
+	/*
+	 * Wait for the workers still running.  Ignore return value; if it fails,
+	 * postmaster has died, but we have checks for that elsewhere.
+	 */
+	for (i = 0; i < nworkers; i++)
+	{
+		if (handles[i] != NULL)
+			WaitForBackgroundWorkerShutdown(handles[i]);
 	}
+	pfree(handles);
 
 	/* Clean up. */
 	dsm_detach(seg);
@@ -412,21 +483,75 @@ apw_load_buffers(void)
 
 	/* Report our success. */
 	ereport(LOG,
-			(errmsg("autoprewarm successfully prewarmed %d of %d previously-loaded blocks",
-					apw_state->prewarmed_blocks, num_elements)));
+			(errmsg("autoprewarm successfully prewarmed %u of %d previously-loaded blocks",
+					pg_atomic_read_u32(&apw_state->prewarmed_blocks),
+					num_elements)));
+}
+
+/*
+ * Launch a per-database worker to load the given range of BlockInfoRecords.
+ *
+ * Workers use the slots of handles[] in turn, so if the next slot is still
+ * occupied, we wait for the oldest of the running workers to finish.  If no
+ * bgworker slot is free, we also wait for our own workers, one at a time,
+ * before giving up.
+ */
+static void
+apw_run_task(BackgroundWorkerHandle **handles, int nworkers, int *next_slot,
+			 Oid database, int start_idx, int stop_idx)
+{
+	int			slot = *next_slot;
+	int			i;
+
+	if (handles[slot] != NULL)
+	{
+		WaitForBackgroundWorkerShutdown(handles[slot]);
+		pfree(handles[slot]);
+		handles[slot] = NULL;
+	}
+
+	apw_state->tasks[slot].database = database;
+	apw_state->tasks[slot].start_idx = start_idx;
+	apw_state->tasks[slot].stop_idx = stop_idx;
+
+	for (i = 1;; i++)
+	{
+		int			other = (slot + i) % nworkers;
+
+		handles[slot] = apw_start_database_worker(slot);
+		if (handles[slot] != NULL)
+			break;
+
+		/* Once we're back to our own slot, none of our workers is left */
+		if (other == slot)
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("registering dynamic bgworker autoprewarm failed"),
+					 errhint("Consider increasing configuration parameter \"max_worker_processes\".")));
+
+		if (handles[other] != NULL)
+		{
+			WaitForBackgroundWorkerShutdown(handles[other]);
+			pfree(handles[other]);
+			handles[other] = NULL;
+		}
+	}
+
+	*next_slot = (slot + 1) % nworkers;
 }
 
 /*
- * Prewarm all blocks for one database (and possibly also global objects, if
- * those got grouped with this database).
+ * Prewarm all blocks of one chunk of the block list.  The blocks all belong
+ * to one database, possibly together with global objects, if those got
+ * grouped with this database.
  */
 void
 autoprewarm_database_main(Datum main_arg)
 {
+	AutoPrewarmTask *task;
 	int			pos;
 	BlockInfoRecord *block_info;
 	Relation	rel = NULL;
-	BlockNumber nblocks = 0;
 	BlockInfoRecord *old_blk = NULL;
 	dsm_segment *seg;
 
@@ -436,23 +561,28 @@ autoprewarm_database_main(Datum main_arg)
 
 	/* Connect to correct database and get block information. */
 	apw_init_shmem();
+	task = &apw_state->tasks[DatumGetInt32(main_arg)];
 	seg = dsm_attach(apw_state->block_info_handle);
 	if (seg == NULL)
 		ereport(ERROR,
 				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
 				 errmsg("could not map dynamic shared memory segment")));
-	BackgroundWorkerInitializeConnectionByOid(apw_state->database, InvalidOid, 0);
+	BackgroundWorkerInitializeConnectionByOid(task->database, InvalidOid, 0);
 	block_info = (BlockInfoRecord *) dsm_segment_address(seg);
-	pos = apw_state->prewarm_start_idx;
+	pos = task->start_idx;
 
 	/*
 	 * Loop until we run out of blocks to prewarm or until we run out of free
-	 * buffers.
+	 * buffers.  Each iteration deals with all the blocks of one relation
+	 * fork.
 	 */
-	while (pos < apw_state->prewarm_stop_idx && have_free_buffer())
+	while (pos < task->stop_idx && have_free_buffer())
 	{
-		BlockInfoRecord *blk = &block_info[pos++];
+		BlockInfoRecord *blk = &block_info[pos];
+		AutoPrewarmStream apw_stream;
+		StreamingRead stream;
 		Buffer		buf;
+		int			stop;
 
 		CHECK_FOR_INTERRUPTS();
 
@@ -464,6 +594,15 @@ autoprewarm_database_main(Datum main_arg)
 			old_blk->database != 0)
 			break;
 
+		/* Find the end of this relation fork's records */
+		for (stop = pos + 1; stop < task->stop_idx; stop++)
+		{
+			if (block_info[stop].database != blk->database ||
+				block_info[stop].filenode != blk->filenode ||
+				block_info[stop].forknum != blk->forknum)
+				break;
+		}
+
 		/*
 		 * As soon as we encounter a block of a new relation, close the old
 		 * relation. Note that rel will be NULL if try_relation_open failed
@@ -494,49 +633,46 @@ autoprewarm_database_main(Datum main_arg)
 			if (!rel)
 				CommitTransactionCommand();
 		}
-		if (!rel)
-		{
-			old_blk = blk;
-			continue;
-		}
 
-		/* Once per fork, check for fork existence and size. */
-		if (old_blk == NULL ||
-			old_blk->filenode != blk->filenode ||
-			old_blk->forknum != blk->forknum)
-		{
-			RelationOpenSmgr(rel);
-
-			/*
-			 * smgrexists is not safe for illegal forknum, hence check whether
-			 * the passed forknum is valid before using it in smgrexists.
-			 */
-			if (blk->forknum > InvalidForkNumber &&
-				blk->forknum <= MAX_FORKNUM &&
-				smgrexists(rel->rd_smgr, blk->forknum))
-				nblocks = RelationGetNumberOfBlocksInFork(rel, blk->forknum);
-			else
-				nblocks = 0;
-		}
-
-		/* Check whether blocknum is valid and within fork file size. */
-		if (blk->blocknum >= nblocks)
+		old_blk = &block_info[stop - 1];
+		if (!rel)
 		{
-			/* Move to next forknum. */
-			old_blk = blk;
+			pos = stop;
 			continue;
 		}
 
-		/* Prewarm buffer. */
-		buf = ReadBufferExtended(rel, blk->forknum, blk->blocknum, RBM_NORMAL,
-								 NULL);
-		if (BufferIsValid(buf))
+		/*
+		 * Check for fork existence and size.  smgrexists is not safe for
+		 * illegal forknum, hence check whether the passed forknum is valid
+		 * before using it in smgrexists.
+		 */
+		RelationOpenSmgr(rel);
+		apw_stream.nblocks = 0;
+		if (blk->forknum > InvalidForkNumber &&
+			blk->forknum <= MAX_FORKNUM &&
+			smgrexists(rel->rd_smgr, blk->forknum))
+			apw_stream.nblocks = RelationGetNumberOfBlocksInFork(rel,
+																 blk->forknum);
+
+		/* Prewarm the buffers, reading ahead of ourselves. */
+		apw_stream.block_info = block_info;
+		apw_stream.pos = pos;
+		apw_stream.stop = stop;
+		stream = BeginStreamingRead(rel, blk->forknum, NULL,
+									apw_next_block, &apw_stream);
+
+		while (have_free_buffer())
 		{
-			apw_state->prewarmed_blocks++;
+			CHECK_FOR_INTERRUPTS();
+			buf = StreamingReadNextBuffer(stream);
+			if (!BufferIsValid(buf))
+				break;
+			pg_atomic_fetch_add_u32(&apw_state->prewarmed_blocks, 1);
 			ReleaseBuffer(buf);
 		}
 
-		old_blk = blk;
+		EndStreamingRead(stream);
+		pos = stop;
 	}
 
 	dsm_detach(seg);
@@ -549,6 +685,30 @@ autoprewarm_database_main(Datum main_arg)
 	}
 }
 
+/*
+ * Streaming read callback: return the next block of the relation fork that
+ * is within the fork's current size.  The records are sorted by block
+ * number, so once we see one past the end, the rest are too.
+ */
+static BlockNumber
+apw_next_block(void *callback_private)
+{
+	AutoPrewarmStream *apw_stream = (AutoPrewarmStream *) callback_private;
+	BlockNumber blocknum;
+
+	if (apw_stream->pos >= apw_stream->stop)
+		return InvalidBlockNumber;
+
+	blocknum = apw_stream->block_info[apw_stream->pos++].blocknum;
+	if (blocknum >= apw_stream->nblocks)
+	{
+		apw_stream->pos = apw_stream->stop;
+		return InvalidBlockNumber;
+	}
+
+	return blocknum;
+}
+
 /*
  * Dump information on blocks in shared buffers.  We use a text format here
  * so that it's easy to understand and even change the file contents if
@@ -763,6 +923,7 @@ apw_init_shmem(void)
 		LWLockInitialize(&apw_state->lock, LWLockNewTrancheId());
 		apw_state->bgworker_pid = InvalidPid;
 		apw_state->pid_using_dumpfile = InvalidPid;
+		pg_atomic_init_u32(&apw_state->prewarmed_blocks, 0);
 	}
 	LWLockRelease(AddinShmemInitLock);
 
@@ -828,10 +989,11 @@ apw_start_master_worker(void)
 }
 
 /*
- * Start autoprewarm per-database worker process.
+ * Start an autoprewarm per-database worker process for the task in the given
+ * slot.  Returns NULL if no background worker slot is available.
  */
-static void
-apw_start_database_worker(void)
+static BackgroundWorkerHandle *
+apw_start_database_worker(int slot)
 {
 	BackgroundWorker worker;
 	BackgroundWorkerHandle *handle;
@@ -845,21 +1007,15 @@ apw_start_database_worker(void)
 	strcpy(worker.bgw_function_name, "autoprewarm_database_main");
 	strcpy(worker.bgw_name, "autoprewarm worker");
 	strcpy(worker.bgw_type, "autoprewarm worker");
+	worker.bgw_main_arg = Int32GetDatum(slot);
 
 	/* must set notify PID to wait for shutdown */
 	worker.bgw_notify_pid = MyProcPid;
 
 	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
-		ereport(ERROR,
-				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
-				 errmsg("registering dynamic bgworker autoprewarm failed"),
-				 errhint("Consider increasing configuration parameter \"max_worker_processes\".")));
+		return NULL;
 
-	/*
-	 * Ignore return value; if it fails, postmaster has died, but we have
-	 * checks for that elsewhere.
-	 */
-	WaitForBackgroundWorkerShutdown(handle);
+	return handle;
 }
 
 /* Compare member elements to check whether they are not equal. */
@@ -878,7 +1034,8 @@ do { \
  * in the dump file; each per-database worker will preload blocks until
  * it sees a block for some other database.  Sorting by tablespace,
  * filenode, forknum, and blocknum isn't critical for correctness, but
- * helps us get a sequential I/O pattern.
+ * gives us a sequential I/O pattern, and lets each worker read a relation
+ * fork's blocks as one streaming read.
  */
 static int
 apw_compare_blockinfo(const void *p, const void *q)
@@ -36,7 +36,16 @@ typedef enum
 	PREWARM_BUFFER
 } PrewarmType;
 
-static PGAlignedBlock blockbuffer;
+static PGIOAlignedBlock blockbuffer;
+
+/* block range handed out by prewarm_next_block */
+typedef struct PrewarmRange
+{
+	int64		next_block;
+	int64		last_block;
+} PrewarmRange;
+
+static BlockNumber prewarm_next_block(void *callback_private);
 
 /*
  * pg_prewarm(regclass, mode text, fork text,
@@ -184,18 +193,30 @@ pg_prewarm(PG_FUNCTION_ARGS)
 	}
 	else if (ptype == PREWARM_BUFFER)
 	{
+		PrewarmRange range;
+		StreamingRead stream;
+		Buffer		buf;
+
 		/*
-		 * In buffer mode, we actually pull the data into shared_buffers.
+		 * In buffer mode, we actually pull the data into shared_buffers.  A
+		 * streaming read keeps prefetch requests going ahead of us.
 		 */
-		for (block = first_block; block <= last_block; ++block)
-		{
-			Buffer		buf;
+		range.next_block = first_block;
+		range.last_block = last_block;
+		stream = BeginStreamingRead(rel, forkNumber, NULL,
+									prewarm_next_block, &range);
 
+		for (;;)
+		{
 			CHECK_FOR_INTERRUPTS();
-			buf = ReadBufferExtended(rel, forkNumber, block, RBM_NORMAL, NULL);
+			buf = StreamingReadNextBuffer(stream);
+			if (!BufferIsValid(buf))
+				break;
 			ReleaseBuffer(buf);
 			++blocks_done;
 		}
+
+		EndStreamingRead(stream);
 	}
 
 	/* Close relation, release lock. */
@@ -203,3 +224,16 @@ pg_prewarm(PG_FUNCTION_ARGS)
 
 	PG_RETURN_INT64(blocks_done);
 }
+
+/*
+ * Streaming read callback: return the blocks of the requested range in order.
+ */
+static BlockNumber
+prewarm_next_block(void *callback_private)
+{
+	PrewarmRange *range = (PrewarmRange *) callback_private;
+
+	if (range->next_block > range->last_block)
+		return InvalidBlockNumber;
+	return (BlockNumber) range->next_block++;
+}
@@ -0,0 +1,81 @@
+/* contrib/pg_stat_statements/pg_stat_statements--1.8--1.9.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_stat_statements UPDATE TO '1.9'" to load this file. \quit
+
+/* First we have to remove them from the extension */
+ALTER EXTENSION pg_stat_statements DROP VIEW pg_stat_statements;
+ALTER EXTENSION pg_stat_statements DROP FUNCTION pg_stat_statements(boolean);
+
+/* Then we can drop them */
+DROP VIEW pg_stat_statements;
+DROP FUNCTION pg_stat_statements(boolean);
+
+/* Now redefine */
+CREATE FUNCTION pg_stat_statements(IN showtext boolean,
+    OUT userid oid,
+    OUT dbid oid,
+    OUT queryid bigint,
+    OUT query text,
+    OUT calls int8,
+    OUT total_time float8,
+    OUT min_time float8,
+    OUT max_time float8,
+    OUT mean_time float8,
+    OUT stddev_time float8,
+    OUT rows int8,
+    OUT shared_blks_hit int8,
+    OUT shared_blks_read int8,
+    OUT shared_blks_dirtied int8,
+    OUT shared_blks_written int8,
+    OUT local_blks_hit int8,
+    OUT local_blks_read int8,
+    OUT local_blks_dirtied int8,
+    OUT local_blks_written int8,
+    OUT temp_blks_read int8,
+    OUT temp_blks_written int8,
+    OUT blk_read_time float8,
+    OUT blk_write_time float8,
+    OUT max_peak_memory int8,
+    OUT mean_peak_memory float8,
+    OUT plans int8,
+    OUT total_plan_time float8,
+    OUT min_plan_time float8,
+    OUT max_plan_time float8,
+    OUT mean_plan_time float8,
+    OUT stddev_plan_time float8,
+    OUT wal_records int8,
+    OUT wal_fpi int8,
+    OUT wal_bytes int8,
+    OUT exec_time_histogram int8[]
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_stat_statements_1_9'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_stat_statements AS
+  SELECT * FROM pg_stat_statements(true);
+
+GRANT SELECT ON pg_stat_statements TO PUBLIC;
+
+/*
+ * Estimate a percentile of execution time from a histogram, as the upper
+ * bound of the bucket in which it falls.
+ */
+CREATE FUNCTION pg_stat_statements_percentile(histogram int8[],
+    fraction float8)
+RETURNS float8
+AS $$
+  SELECT CASE WHEN h.i = array_upper(histogram, 1) THEN 'Infinity'::float8
+         ELSE current_setting('pg_stat_statements.histogram_min_time')::float8
+              * 2 ^ (h.i - 1)
+         END
+  FROM (SELECT i,
+               sum(histogram[i]) OVER (ORDER BY i) AS cum,
+               sum(histogram[i]) OVER () AS total
+        FROM generate_subscripts(histogram, 1) AS i) AS h
+  WHERE h.total > 0 AND h.cum >= h.total * fraction
+  ORDER BY h.i
+  LIMIT 1
+$$
+LANGUAGE SQL STRICT STABLE PARALLEL SAFE;
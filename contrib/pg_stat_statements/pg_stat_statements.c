@@ -62,10 +62,12 @@
 #include <unistd.h>
 
 #include "catalog/pg_authid.h"
+#include "catalog/pg_type.h"
 #include "executor/instrument.h"
 #include "funcapi.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "optimizer/planner.h"
 #include "parser/analyze.h"
 #include "parser/parsetree.h"
 #include "parser/scanner.h"
@@ -76,6 +78,7 @@
 #include "storage/spin.h"
 #include "tcop/utility.h"
 #include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/hashutils.h"
 #include "utils/memutils.h"
@@ -86,17 +89,14 @@ PG_MODULE_MAGIC;
 #define PGSS_DUMP_FILE	PGSTAT_STAT_PERMANENT_DIRECTORY "/pg_stat_statements.stat"
 
 /*
- * Location of external query text file.  We don't keep it in the core
- * system's stats_temp_directory.  The core system can safely use that GUC
- * setting, because the statistics collector temp file paths are set only once
- * as part of changing the GUC, but pg_stat_statements has no way of avoiding
- * race conditions.  Besides, we only expect modest, infrequent I/O for query
- * strings, so placing the file on a faster filesystem is not compelling.
+ * Location of external query text file.  We only expect modest, infrequent
+ * I/O for query strings, so placing the file on a faster filesystem is not
+ * compelling.
  */
 #define PGSS_TEXT_FILE	PG_STAT_TMP_DIR "/pgss_query_texts.stat"
 
 /* Magic number identifying the stats file format */
-static const uint32 PGSS_FILE_HEADER = 0x20171004;
+static const uint32 PGSS_FILE_HEADER = 0x20261016;
 
 /* PostgreSQL major version number, changes in which invalidate all entries */
 static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
@@ -110,6 +110,8 @@ static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
 #define STICKY_DECREASE_FACTOR	(0.50)	/* factor for sticky entries */
 #define USAGE_DEALLOC_PERCENT	5	/* free this % of entries at once */
 
+#define PGSS_HIST_BUCKETS		20	/* # of execution time histogram buckets */
+
 #define JUMBLE_SIZE				1024	/* query serialization buffer size */
 
 /*
@@ -120,7 +122,9 @@ typedef enum pgssVersion
 	PGSS_V1_0 = 0,
 	PGSS_V1_1,
 	PGSS_V1_2,
-	PGSS_V1_3
+	PGSS_V1_3,
+	PGSS_V1_8,
+	PGSS_V1_9
 } pgssVersion;
 
 /*
@@ -163,6 +167,19 @@ typedef struct Counters
 	int64		temp_blks_written;	/* # of temp blocks written */
 	double		blk_read_time;	/* time spent reading, in msec */
 	double		blk_write_time; /* time spent writing, in msec */
+	int64		max_peak_mem;	/* maximum peak memory allocated, in bytes */
+	double		mean_peak_mem;	/* mean peak memory allocated, in bytes */
+	int64		plans;			/* # of times planned */
+	double		total_plan_time;	/* total planning time, in msec */
+	double		min_plan_time;	/* minimum planning time in msec */
+	double		max_plan_time;	/* maximum planning time in msec */
+	double		mean_plan_time; /* mean planning time in msec */
+	double		sum_var_plan_time;	/* sum of variances in planning time in
+									 * msec */
+	int64		wal_records;	/* # of WAL records generated */
+	int64		wal_fpi;		/* # of WAL full page images generated */
+	int64		wal_bytes;		/* total amount of WAL generated, in bytes */
+	int64		exec_hist[PGSS_HIST_BUCKETS];	/* execution time histogram */
 	double		usage;			/* usage factor */
 } Counters;
 
@@ -239,6 +256,7 @@ static int	nested_level = 0;
 /* Saved hook values in case of unload */
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
+static planner_hook_type prev_planner_hook = NULL;
 static ExecutorStart_hook_type prev_ExecutorStart = NULL;
 static ExecutorRun_hook_type prev_ExecutorRun = NULL;
 static ExecutorFinish_hook_type prev_ExecutorFinish = NULL;
@@ -270,6 +288,8 @@ static int	pgss_max;			/* max # statements to track */
 static int	pgss_track;			/* tracking level */
 static bool pgss_track_utility; /* whether to track utility commands */
 static bool pgss_save;			/* whether to save stats across shutdown */
+static bool pgss_track_planning;	/* whether to track planning duration */
+static double pgss_hist_min_time;	/* upper bound of first histogram bucket */
 
 
 #define pgss_enabled() \
@@ -293,11 +313,15 @@ PG_FUNCTION_INFO_V1(pg_stat_statements_reset);
 PG_FUNCTION_INFO_V1(pg_stat_statements_reset_1_7);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_2);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_3);
+PG_FUNCTION_INFO_V1(pg_stat_statements_1_8);
+PG_FUNCTION_INFO_V1(pg_stat_statements_1_9);
 PG_FUNCTION_INFO_V1(pg_stat_statements);
 
 static void pgss_shmem_startup(void);
 static void pgss_shmem_shutdown(int code, Datum arg);
 static void pgss_post_parse_analyze(ParseState *pstate, Query *query);
+static PlannedStmt *pgss_planner(Query *parse, int cursorOptions,
+								 ParamListInfo boundParams);
 static void pgss_ExecutorStart(QueryDesc *queryDesc, int eflags);
 static void pgss_ExecutorRun(QueryDesc *queryDesc,
 							 ScanDirection direction,
@@ -312,14 +336,17 @@ static uint64 pgss_hash_string(const char *str, int len);
 static void pgss_store(const char *query, uint64 queryId,
 					   int query_location, int query_len,
 					   double total_time, uint64 rows,
-					   const BufferUsage *bufusage,
-					   pgssJumbleState *jstate);
+					   const BufferUsage *bufusage, const WalUsage *walusage,
+					   Size peak_mem, pgssJumbleState *jstate);
+static void pgss_store_planning(uint64 queryId, double plan_time);
+static int	pgss_hist_bucket(double total_time);
 static void pg_stat_statements_internal(FunctionCallInfo fcinfo,
 										pgssVersion api_version,
 										bool showtext);
 static Size pgss_memsize(void);
 static pgssEntry *entry_alloc(pgssHashKey *key, Size query_offset, int query_len,
 							  int encoding, bool sticky);
+static void entry_select(pgssEntry **entries, int nentries, int k);
 static void entry_dealloc(void);
 static bool qtext_store(const char *query, int query_len,
 						Size *query_offset, int *gc_count);
@@ -409,6 +436,30 @@ _PG_init(void)
 							 NULL,
 							 NULL);
 
+	DefineCustomBoolVariable("pg_stat_statements.track_planning",
+							 "Selects whether planning duration is tracked by pg_stat_statements.",
+							 NULL,
+							 &pgss_track_planning,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomRealVariable("pg_stat_statements.histogram_min_time",
+							 "Sets the upper bound, in milliseconds, of the first execution time histogram bucket.",
+							 "Each following bucket covers twice the range of the previous one.",
+							 &pgss_hist_min_time,
+							 0.1,
+							 0.001,
+							 1000.0,
+							 PGC_POSTMASTER,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
 	EmitWarningsOnPlaceholders("pg_stat_statements");
 
 	/*
@@ -426,6 +477,8 @@ _PG_init(void)
 	shmem_startup_hook = pgss_shmem_startup;
 	prev_post_parse_analyze_hook = post_parse_analyze_hook;
 	post_parse_analyze_hook = pgss_post_parse_analyze;
+	prev_planner_hook = planner_hook;
+	planner_hook = pgss_planner;
 	prev_ExecutorStart = ExecutorStart_hook;
 	ExecutorStart_hook = pgss_ExecutorStart;
 	prev_ExecutorRun = ExecutorRun_hook;
@@ -447,6 +500,7 @@ _PG_fini(void)
 	/* Uninstall hooks. */
 	shmem_startup_hook = prev_shmem_startup_hook;
 	post_parse_analyze_hook = prev_post_parse_analyze_hook;
+	planner_hook = prev_planner_hook;
 	ExecutorStart_hook = prev_ExecutorStart;
 	ExecutorRun_hook = prev_ExecutorRun;
 	ExecutorFinish_hook = prev_ExecutorFinish;
@@ -470,6 +524,7 @@ pgss_shmem_startup(void)
 	uint32		header;
 	int32		num;
 	int32		pgver;
+	double		hist_min_time;
 	int32		i;
 	int			buffer_size;
 	char	   *buffer = NULL;
@@ -567,6 +622,7 @@ pgss_shmem_startup(void)
 
 	if (fread(&header, sizeof(uint32), 1, file) != 1 ||
 		fread(&pgver, sizeof(uint32), 1, file) != 1 ||
+		fread(&hist_min_time, sizeof(double), 1, file) != 1 ||
 		fread(&num, sizeof(int32), 1, file) != 1)
 		goto read_error;
 
@@ -617,6 +673,11 @@ pgss_shmem_startup(void)
 
 		/* copy in the actual stats */
 		entry->counters = temp.counters;
+
+		/* histogram buckets mean something else if their bounds changed */
+		if (hist_min_time != pgss_hist_min_time)
+			memset(entry->counters.exec_hist, 0,
+				   sizeof(entry->counters.exec_hist));
 	}
 
 	pfree(buffer);
@@ -709,6 +770,8 @@ pgss_shmem_shutdown(int code, Datum arg)
 		goto error;
 	if (fwrite(&PGSS_PG_MAJOR_VERSION, sizeof(uint32), 1, file) != 1)
 		goto error;
+	if (fwrite(&pgss_hist_min_time, sizeof(double), 1, file) != 1)
+		goto error;
 	num_entries = hash_get_num_entries(pgss_hash);
 	if (fwrite(&num_entries, sizeof(int32), 1, file) != 1)
 		goto error;
@@ -840,9 +903,65 @@ pgss_post_parse_analyze(ParseState *pstate, Query *query)
 				   0,
 				   0,
 				   NULL,
+				   NULL,
+				   0,
 				   &jstate);
 }
 
+/*
+ * Planner hook: forward to regular planner, but measure planning time
+ * if needed.
+ */
+static PlannedStmt *
+pgss_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
+{
+	PlannedStmt *result;
+
+	/*
+	 * We can't process the query if no query_id has been computed.  Note
+	 * that the planner can run nested queries, e.g. while inlining or
+	 * pre-evaluating functions, so it must count as a nesting level.
+	 */
+	if (pgss_enabled() && pgss_track_planning &&
+		parse->queryId != UINT64CONST(0))
+	{
+		instr_time	start;
+		instr_time	duration;
+
+		INSTR_TIME_SET_CURRENT(start);
+
+		nested_level++;
+		PG_TRY();
+		{
+			if (prev_planner_hook)
+				result = prev_planner_hook(parse, cursorOptions, boundParams);
+			else
+				result = standard_planner(parse, cursorOptions, boundParams);
+			nested_level--;
+		}
+		PG_CATCH();
+		{
+			nested_level--;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+
+		pgss_store_planning(parse->queryId, INSTR_TIME_GET_MILLISEC(duration));
+	}
+	else
+	{
+		if (prev_planner_hook)
+			result = prev_planner_hook(parse, cursorOptions, boundParams);
+		else
+			result = standard_planner(parse, cursorOptions, boundParams);
+	}
+
+	return result;
+}
+
 /*
  * ExecutorStart hook: start up tracking if needed
  */
@@ -947,6 +1066,8 @@ pgss_ExecutorEnd(QueryDesc *queryDesc)
 				   queryDesc->totaltime->total * 1000.0,	/* convert to msec */
 				   queryDesc->estate->es_processed,
 				   &queryDesc->totaltime->bufusage,
+				   &queryDesc->totaltime->walusage,
+				   MemoryContextGetPeak(&queryDesc->estate->es_mem_peak),
 				   NULL);
 	}
 
@@ -991,9 +1112,15 @@ pgss_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
 		uint64		rows;
 		BufferUsage bufusage_start,
 					bufusage;
+		WalUsage	walusage_start,
+					walusage;
+		MemoryPeakTracker mem_peak;
+		Size		peak_mem;
 
 		bufusage_start = pgBufferUsage;
+		walusage_start = pgWalUsage;
 		INSTR_TIME_SET_CURRENT(start);
+		MemoryContextBeginPeakTracking(&mem_peak);
 
 		nested_level++;
 		PG_TRY();
@@ -1011,10 +1138,14 @@ pgss_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
 		PG_CATCH();
 		{
 			nested_level--;
+			MemoryContextEndPeakTracking(&mem_peak);
 			PG_RE_THROW();
 		}
 		PG_END_TRY();
 
+		peak_mem = MemoryContextGetPeak(&mem_peak);
+		MemoryContextEndPeakTracking(&mem_peak);
+
 		INSTR_TIME_SET_CURRENT(duration);
 		INSTR_TIME_SUBTRACT(duration, start);
 
@@ -1051,6 +1182,10 @@ pgss_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
 		bufusage.blk_write_time = pgBufferUsage.blk_write_time;
 		INSTR_TIME_SUBTRACT(bufusage.blk_write_time, bufusage_start.blk_write_time);
 
+		/* calc differences of WAL counters. */
+		memset(&walusage, 0, sizeof(WalUsage));
+		WalUsageAccumDiff(&walusage, &pgWalUsage, &walusage_start);
+
 		pgss_store(queryString,
 				   0,			/* signal that it's a utility stmt */
 				   pstmt->stmt_location,
@@ -1058,6 +1193,8 @@ pgss_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
 				   INSTR_TIME_GET_MILLISEC(duration),
 				   rows,
 				   &bufusage,
+				   &walusage,
+				   peak_mem,
 				   NULL);
 	}
 	else
@@ -1093,14 +1230,15 @@ pgss_hash_string(const char *str, int len)
  *
  * If jstate is not NULL then we're trying to create an entry for which
  * we have no statistics as yet; we just want to record the normalized
- * query string.  total_time, rows, bufusage are ignored in this case.
+ * query string.  total_time, rows, bufusage, walusage, peak_mem are ignored
+ * in this case.
  */
 static void
 pgss_store(const char *query, uint64 queryId,
 		   int query_location, int query_len,
 		   double total_time, uint64 rows,
-		   const BufferUsage *bufusage,
-		   pgssJumbleState *jstate)
+		   const BufferUsage *bufusage, const WalUsage *walusage,
+		   Size peak_mem, pgssJumbleState *jstate)
 {
 	pgssHashKey key;
 	pgssEntry  *entry;
@@ -1290,6 +1428,14 @@ pgss_store(const char *query, uint64 queryId,
 		e->counters.temp_blks_written += bufusage->temp_blks_written;
 		e->counters.blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
 		e->counters.blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
+		if (e->counters.max_peak_mem < (int64) peak_mem)
+			e->counters.max_peak_mem = (int64) peak_mem;
+		e->counters.mean_peak_mem +=
+			((double) peak_mem - e->counters.mean_peak_mem) / e->counters.calls;
+		e->counters.wal_records += walusage->wal_records;
+		e->counters.wal_fpi += walusage->wal_fpi;
+		e->counters.wal_bytes += walusage->wal_bytes;
+		e->counters.exec_hist[pgss_hist_bucket(total_time)]++;
 		e->counters.usage += USAGE_EXEC(total_time);
 
 		SpinLockRelease(&e->mutex);
@@ -1303,6 +1449,91 @@ done:
 		pfree(norm_query);
 }
 
+/*
+ * Store the planning time of a statement.
+ *
+ * The planner doesn't know the source text of the query, so unlike
+ * pgss_store() we can't create a new entry here; planning time is only
+ * recorded for statements that already have one.  That's the case for any
+ * statement containing constants, since pgss_post_parse_analyze() creates
+ * its entry before planning, and for every statement once it has been
+ * executed.
+ */
+static void
+pgss_store_planning(uint64 queryId, double plan_time)
+{
+	pgssHashKey key;
+	pgssEntry  *entry;
+
+	/* Safety check... */
+	if (!pgss || !pgss_hash)
+		return;
+
+	key.userid = GetUserId();
+	key.dbid = MyDatabaseId;
+	key.queryid = queryId;
+
+	LWLockAcquire(pgss->lock, LW_SHARED);
+
+	entry = (pgssEntry *) hash_search(pgss_hash, &key, HASH_FIND, NULL);
+	if (entry)
+	{
+		volatile pgssEntry *e = (volatile pgssEntry *) entry;
+
+		SpinLockAcquire(&e->mutex);
+
+		e->counters.plans += 1;
+		e->counters.total_plan_time += plan_time;
+		if (e->counters.plans == 1)
+		{
+			e->counters.min_plan_time = plan_time;
+			e->counters.max_plan_time = plan_time;
+			e->counters.mean_plan_time = plan_time;
+		}
+		else
+		{
+			/* Welford's method, as in pgss_store() */
+			double		old_mean = e->counters.mean_plan_time;
+
+			e->counters.mean_plan_time +=
+				(plan_time - old_mean) / e->counters.plans;
+			e->counters.sum_var_plan_time +=
+				(plan_time - old_mean) * (plan_time - e->counters.mean_plan_time);
+
+			if (e->counters.min_plan_time > plan_time)
+				e->counters.min_plan_time = plan_time;
+			if (e->counters.max_plan_time < plan_time)
+				e->counters.max_plan_time = plan_time;
+		}
+
+		SpinLockRelease(&e->mutex);
+	}
+
+	LWLockRelease(pgss->lock);
+}
+
+/*
+ * Find the execution time histogram bucket for a duration in msec.  The
+ * first bucket counts executions faster than pg_stat_statements.
+ * histogram_min_time, each following one covers twice the range of the one
+ * before it, and the last one has no upper bound.
+ */
+static int
+pgss_hist_bucket(double total_time)
+{
+	double		bound = pgss_hist_min_time;
+	int			bucket;
+
+	for (bucket = 0; bucket < PGSS_HIST_BUCKETS - 1; bucket++)
+	{
+		if (total_time < bound)
+			break;
+		bound *= 2;
+	}
+
+	return bucket;
+}
+
 /*
  * Reset statement statistics corresponding to userid, dbid, and queryid.
  */
@@ -1338,7 +1569,9 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
 #define PG_STAT_STATEMENTS_COLS_V1_1	18
 #define PG_STAT_STATEMENTS_COLS_V1_2	19
 #define PG_STAT_STATEMENTS_COLS_V1_3	23
-#define PG_STAT_STATEMENTS_COLS			23	/* maximum of above */
+#define PG_STAT_STATEMENTS_COLS_V1_8	25
+#define PG_STAT_STATEMENTS_COLS_V1_9	35
+#define PG_STAT_STATEMENTS_COLS			34	/* maximum of above */
 
 /*
  * Retrieve statement statistics.
@@ -1350,6 +1583,26 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
  * expected API version is identified by embedding it in the C name of the
  * function.  Unfortunately we weren't bright enough to do that for 1.1.
  */
+Datum
+pg_stat_statements_1_9(PG_FUNCTION_ARGS)
+{
+	bool		showtext = PG_GETARG_BOOL(0);
+
+	pg_stat_statements_internal(fcinfo, PGSS_V1_9, showtext);
+
+	return (Datum) 0;
+}
+
+Datum
+pg_stat_statements_1_8(PG_FUNCTION_ARGS)
+{
+	bool		showtext = PG_GETARG_BOOL(0);
+
+	pg_stat_statements_internal(fcinfo, PGSS_V1_8, showtext);
+
+	return (Datum) 0;
+}
+
 Datum
 pg_stat_statements_1_3(PG_FUNCTION_ARGS)
 {
@@ -1456,6 +1709,14 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			if (api_version != PGSS_V1_3)
 				elog(ERROR, "incorrect number of output arguments");
 			break;
+		case PG_STAT_STATEMENTS_COLS_V1_8:
+			if (api_version != PGSS_V1_8)
+				elog(ERROR, "incorrect number of output arguments");
+			break;
+		case PG_STAT_STATEMENTS_COLS_V1_9:
+			if (api_version != PGSS_V1_9)
+				elog(ERROR, "incorrect number of output arguments");
+			break;
 		default:
 			elog(ERROR, "incorrect number of output arguments");
 	}
@@ -1540,6 +1801,7 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 		int			i = 0;
 		Counters	tmp;
 		double		stddev;
+		double		plan_stddev;
 		int64		queryid = entry->key.queryid;
 
 		memset(values, 0, sizeof(values));
@@ -1652,11 +1914,46 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			values[i++] = Float8GetDatumFast(tmp.blk_read_time);
 			values[i++] = Float8GetDatumFast(tmp.blk_write_time);
 		}
+		if (api_version >= PGSS_V1_8)
+		{
+			values[i++] = Int64GetDatumFast(tmp.max_peak_mem);
+			values[i++] = Float8GetDatumFast(tmp.mean_peak_mem);
+		}
+		if (api_version >= PGSS_V1_9)
+		{
+			Datum		hist[PGSS_HIST_BUCKETS];
+			int			j;
+
+			values[i++] = Int64GetDatumFast(tmp.plans);
+			values[i++] = Float8GetDatumFast(tmp.total_plan_time);
+			values[i++] = Float8GetDatumFast(tmp.min_plan_time);
+			values[i++] = Float8GetDatumFast(tmp.max_plan_time);
+			values[i++] = Float8GetDatumFast(tmp.mean_plan_time);
+			if (tmp.plans > 1)
+				plan_stddev = sqrt(tmp.sum_var_plan_time / tmp.plans);
+			else
+				plan_stddev = 0.0;
+			values[i++] = Float8GetDatumFast(plan_stddev);
+			values[i++] = Int64GetDatumFast(tmp.wal_records);
+			values[i++] = Int64GetDatumFast(tmp.wal_fpi);
+			values[i++] = Int64GetDatumFast(tmp.wal_bytes);
+
+			for (j = 0; j < PGSS_HIST_BUCKETS; j++)
+				hist[j] = Int64GetDatum(tmp.exec_hist[j]);
+			values[i++] = PointerGetDatum(construct_array(hist,
+														  PGSS_HIST_BUCKETS,
+														  INT8OID,
+														  sizeof(int64),
+														  FLOAT8PASSBYVAL,
+														  'd'));
+		}
 
 		Assert(i == (api_version == PGSS_V1_0 ? PG_STAT_STATEMENTS_COLS_V1_0 :
 					 api_version == PGSS_V1_1 ? PG_STAT_STATEMENTS_COLS_V1_1 :
 					 api_version == PGSS_V1_2 ? PG_STAT_STATEMENTS_COLS_V1_2 :
 					 api_version == PGSS_V1_3 ? PG_STAT_STATEMENTS_COLS_V1_3 :
+					 api_version == PGSS_V1_8 ? PG_STAT_STATEMENTS_COLS_V1_8 :
+					 api_version == PGSS_V1_9 ? PG_STAT_STATEMENTS_COLS_V1_9 :
 					 -1 /* fail if you forget to update this assert */ ));
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -1737,20 +2034,53 @@ entry_alloc(pgssHashKey *key, Size query_offset, int query_len, int encoding,
 }
 
 /*
- * qsort comparator for sorting into increasing usage order
+ * Partially order entries[] by increasing usage, so that entries[k] holds
+ * the entry that would be there if the array were fully sorted, everything
+ * before it has no greater usage, and everything after it has no less.
+ *
+ * This is Hoare's selection algorithm, which takes expected linear time;
+ * sorting the whole array would be O(N log N) and entry_dealloc() runs it
+ * while holding pgss->lock exclusively.
  */
-static int
-entry_cmp(const void *lhs, const void *rhs)
+static void
+entry_select(pgssEntry **entries, int nentries, int k)
 {
-	double		l_usage = (*(pgssEntry *const *) lhs)->counters.usage;
-	double		r_usage = (*(pgssEntry *const *) rhs)->counters.usage;
+	int			lo = 0;
+	int			hi = nentries - 1;
 
-	if (l_usage < r_usage)
-		return -1;
-	else if (l_usage > r_usage)
-		return +1;
-	else
-		return 0;
+	Assert(k >= 0 && k < nentries);
+
+	while (lo < hi)
+	{
+		double		pivot = entries[lo + (hi - lo) / 2]->counters.usage;
+		int			i = lo;
+		int			j = hi;
+
+		while (i <= j)
+		{
+			while (entries[i]->counters.usage < pivot)
+				i++;
+			while (entries[j]->counters.usage > pivot)
+				j--;
+			if (i <= j)
+			{
+				pgssEntry  *tmp = entries[i];
+
+				entries[i] = entries[j];
+				entries[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+
+		/* Now entries[lo..j] <= pivot, entries[i..hi] >= pivot, and j < i */
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;				/* entries[k] equals the pivot */
+	}
 }
 
 /*
@@ -1770,8 +2100,8 @@ entry_dealloc(void)
 	int			nvalidtexts;
 
 	/*
-	 * Sort entries by usage and deallocate USAGE_DEALLOC_PERCENT of them.
-	 * While we're scanning the table, apply the decay factor to the usage
+	 * Find the USAGE_DEALLOC_PERCENT of entries with the lowest usage and
+	 * deallocate them.  While we're scanning the table, apply the decay factor to the usage
 	 * values, and update the mean query length.
 	 *
 	 * Note that the mean query length is almost immediately obsolete, since
@@ -1804,22 +2134,32 @@ entry_dealloc(void)
 		}
 	}
 
-	/* Sort into increasing order by usage */
-	qsort(entries, i, sizeof(pgssEntry *), entry_cmp);
+	nvictims = Max(10, i * USAGE_DEALLOC_PERCENT / 100);
+	nvictims = Min(nvictims, i);
 
-	/* Record the (approximate) median usage */
+	/*
+	 * Move the nvictims lowest-usage entries to the front of the array, then
+	 * find the median within whichever side of that split it falls on.  We
+	 * don't need the entries fully sorted, only these two order statistics.
+	 */
+	if (nvictims < i)
+		entry_select(entries, i, nvictims);
 	if (i > 0)
+	{
+		/* Record the (approximate) median usage */
+		if (i / 2 < nvictims)
+			entry_select(entries, nvictims, i / 2);
+		else
+			entry_select(entries + nvictims, i - nvictims, i / 2 - nvictims);
 		pgss->cur_median_usage = entries[i / 2]->counters.usage;
+	}
 	/* Record the mean query length */
 	if (nvalidtexts > 0)
 		pgss->mean_query_len = tottextlen / nvalidtexts;
 	else
 		pgss->mean_query_len = ASSUMED_LENGTH_INIT;
 
-	/* Now zap an appropriate fraction of lowest-usage entries */
-	nvictims = Max(10, i * USAGE_DEALLOC_PERCENT / 100);
-	nvictims = Min(nvictims, i);
-
+	/* Now zap the lowest-usage entries */
 	for (i = 0; i < nvictims; i++)
 	{
 		hash_search(pgss_hash, &entries[i]->key, HASH_REMOVE, NULL);
@@ -253,6 +253,24 @@ SELECT query, calls, rows FROM pg_stat_statements ORDER BY query COLLATE "C";
 SELECT pg_stat_statements_reset(0,0,0);
 SELECT query, calls, rows FROM pg_stat_statements ORDER BY query COLLATE "C";
 
+--
+-- planning time, WAL usage and execution time histogram
+--
+SET pg_stat_statements.track_planning = TRUE;
+CREATE TABLE pgss_wal_tab (a int);
+SELECT pg_stat_statements_reset();
+INSERT INTO pgss_wal_tab VALUES (1);
+INSERT INTO pgss_wal_tab VALUES (2);
+SELECT query, calls, rows, plans,
+       wal_records > 0 AS wal_records, wal_bytes > 0 AS wal_bytes,
+       (SELECT sum(h) FROM unnest(exec_time_histogram) h) = calls AS hist_ok
+  FROM pg_stat_statements ORDER BY query COLLATE "C";
+SELECT pg_stat_statements_percentile('{0,3,1}', 0.5);
+SELECT pg_stat_statements_percentile('{0,3,1}', 0.99);
+SELECT pg_stat_statements_percentile('{0,0,0}', 0.5);
+DROP TABLE pgss_wal_tab;
+RESET pg_stat_statements.track_planning;
+
 --
 -- cleanup
 --
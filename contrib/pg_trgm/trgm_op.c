@@ -1140,8 +1140,15 @@ trgm_presence_map(TRGM *query, TRGM *key)
 	return result;
 }
 
-Datum
-similarity(PG_FUNCTION_ARGS)
+/*
+ * Compute similarity of the two text arguments of the function being called.
+ *
+ * The second argument is usually a constant query compared against every
+ * row, so when we have an flinfo we cache its trigrams across calls, like
+ * gtrgm_distance() does.
+ */
+static float4
+calc_similarity(FunctionCallInfo fcinfo)
 {
 	text	   *in1 = PG_GETARG_TEXT_PP(0);
 	text	   *in2 = PG_GETARG_TEXT_PP(1);
@@ -1150,16 +1157,55 @@ similarity(PG_FUNCTION_ARGS)
 	float4		res;
 
 	trg1 = generate_trgm(VARDATA_ANY(in1), VARSIZE_ANY_EXHDR(in1));
-	trg2 = generate_trgm(VARDATA_ANY(in2), VARSIZE_ANY_EXHDR(in2));
 
-	res = cnt_sml(trg1, trg2, false);
+	if (fcinfo->flinfo != NULL)
+	{
+		Size		querysize = VARSIZE_ANY(in2);
+		char	   *cache = (char *) fcinfo->flinfo->fn_extra;
+
+		if (cache == NULL ||
+			VARSIZE_ANY(cache) != querysize ||
+			memcmp(cache, in2, querysize) != 0)
+		{
+			char	   *newcache;
+
+			trg2 = generate_trgm(VARDATA_ANY(in2), VARSIZE_ANY_EXHDR(in2));
+
+			newcache = MemoryContextAlloc(fcinfo->flinfo->fn_mcxt,
+										  MAXALIGN(querysize) +
+										  VARSIZE(trg2));
+
+			memcpy(newcache, in2, querysize);
+			memcpy(newcache + MAXALIGN(querysize), trg2, VARSIZE(trg2));
+			pfree(trg2);
+
+			if (cache)
+				pfree(cache);
+			fcinfo->flinfo->fn_extra = newcache;
+			cache = newcache;
+		}
+
+		trg2 = (TRGM *) (cache + MAXALIGN(querysize));
+		res = cnt_sml(trg1, trg2, false);
+	}
+	else
+	{
+		trg2 = generate_trgm(VARDATA_ANY(in2), VARSIZE_ANY_EXHDR(in2));
+		res = cnt_sml(trg1, trg2, false);
+		pfree(trg2);
+	}
 
 	pfree(trg1);
-	pfree(trg2);
 	PG_FREE_IF_COPY(in1, 0);
 	PG_FREE_IF_COPY(in2, 1);
 
-	PG_RETURN_FLOAT4(res);
+	return res;
+}
+
+Datum
+similarity(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_FLOAT4(calc_similarity(fcinfo));
 }
 
 Datum
@@ -1197,9 +1243,7 @@ strict_word_similarity(PG_FUNCTION_ARGS)
 Datum
 similarity_dist(PG_FUNCTION_ARGS)
 {
-	float4		res = DatumGetFloat4(DirectFunctionCall2(similarity,
-														 PG_GETARG_DATUM(0),
-														 PG_GETARG_DATUM(1)));
+	float4		res = calc_similarity(fcinfo);
 
 	PG_RETURN_FLOAT4(1.0 - res);
 }
@@ -1207,9 +1251,7 @@ similarity_dist(PG_FUNCTION_ARGS)
 Datum
 similarity_op(PG_FUNCTION_ARGS)
 {
-	float4		res = DatumGetFloat4(DirectFunctionCall2(similarity,
-														 PG_GETARG_DATUM(0),
-														 PG_GETARG_DATUM(1)));
+	float4		res = calc_similarity(fcinfo);
 
 	PG_RETURN_BOOL(res >= similarity_threshold);
 }
@@ -58,6 +58,7 @@ typedef struct ConnCacheEntry
 	bool		invalidated;	/* true if reconnect is pending */
 	uint32		server_hashvalue;	/* hash value of foreign server OID */
 	uint32		mapping_hashvalue;	/* hash value of user mapping OID */
+	PgFdwConnState state;		/* extra per-connection state */
 } ConnCacheEntry;
 
 /*
@@ -102,9 +103,12 @@ static bool pgfdw_get_cleanup_result(PGconn *conn, TimestampTz endtime,
  * will_prep_stmt must be true if caller intends to create any prepared
  * statements.  Since those don't go away automatically at transaction end
  * (not even on error), we need this flag to cue manual cleanup.
+ *
+ * If state is not NULL, *state receives the per-connection state associated
+ * with the PGconn.
  */
 PGconn *
-GetConnection(UserMapping *user, bool will_prep_stmt)
+GetConnection(UserMapping *user, bool will_prep_stmt, PgFdwConnState **state)
 {
 	bool		found;
 	ConnCacheEntry *entry;
@@ -196,6 +200,7 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 		entry->mapping_hashvalue =
 			GetSysCacheHashValue1(USERMAPPINGOID,
 								  ObjectIdGetDatum(user->umid));
+		memset(&entry->state, 0, sizeof(entry->state));
 
 		/* Now try to make the connection */
 		entry->conn = connect_pg_server(server, user);
@@ -212,6 +217,10 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 	/* Remember if caller will prepare statements */
 	entry->have_prep_stmt |= will_prep_stmt;
 
+	/* If caller needs access to the per-connection state, return it. */
+	if (state)
+		*state = &entry->state;
+
 	return entry->conn;
 }
 
@@ -358,9 +367,16 @@ static void
 configure_remote_session(PGconn *conn)
 {
 	int			remoteversion = PQserverVersion(conn);
+	StringInfoData sql;
+
+	/*
+	 * The settings are sent as a single multi-statement query, so that they
+	 * take only one round trip.
+	 */
+	initStringInfo(&sql);
 
 	/* Force the search path to contain only pg_catalog (see deparse.c) */
-	do_sql_command(conn, "SET search_path = pg_catalog");
+	appendStringInfoString(&sql, "SET search_path = pg_catalog");
 
 	/*
 	 * Set remote timezone; this is basically just cosmetic, since all
@@ -371,24 +387,30 @@ configure_remote_session(PGconn *conn)
 	 * server might use a different timezone database.  Instead, use UTC
 	 * (quoted, because very old servers are picky about case).
 	 */
-	do_sql_command(conn, "SET timezone = 'UTC'");
+	appendStringInfoString(&sql, "; SET timezone = 'UTC'");
 
 	/*
 	 * Set values needed to ensure unambiguous data output from remote.  (This
 	 * logic should match what pg_dump does.  See also set_transmission_modes
 	 * in postgres_fdw.c.)
 	 */
-	do_sql_command(conn, "SET datestyle = ISO");
+	appendStringInfoString(&sql, "; SET datestyle = ISO");
 	if (remoteversion >= 80400)
-		do_sql_command(conn, "SET intervalstyle = postgres");
+		appendStringInfoString(&sql, "; SET intervalstyle = postgres");
 	if (remoteversion >= 90000)
-		do_sql_command(conn, "SET extra_float_digits = 3");
+		appendStringInfoString(&sql, "; SET extra_float_digits = 3");
 	else
-		do_sql_command(conn, "SET extra_float_digits = 2");
+		appendStringInfoString(&sql, "; SET extra_float_digits = 2");
+
+	do_sql_command(conn, sql.data);
+	pfree(sql.data);
 }
 
 /*
  * Convenience subroutine to issue a non-data-returning SQL command to remote
+ *
+ * The command may consist of several statements separated by semicolons.
+ * If one of them fails, the rest are skipped and the error is reported.
  */
 static void
 do_sql_command(PGconn *conn, const char *sql)
@@ -417,23 +439,34 @@ static void
 begin_remote_xact(ConnCacheEntry *entry)
 {
 	int			curlevel = GetCurrentTransactionNestLevel();
+	int			depth = entry->xact_depth;
+	StringInfoData sql;
+
+	if (depth >= curlevel)
+		return;
+
+	/*
+	 * All the commands needed are sent as one multi-statement query, so that
+	 * starting the remote transaction and any savepoints takes only one round
+	 * trip.  A scan of an outer level may have a fetch in flight, which must
+	 * be read first.
+	 */
+	if (entry->state.pendingScan)
+		process_pending_fetch(&entry->state);
+
+	initStringInfo(&sql);
 
 	/* Start main transaction if we haven't yet */
-	if (entry->xact_depth <= 0)
+	if (depth <= 0)
 	{
-		const char *sql;
-
 		elog(DEBUG3, "starting remote transaction on connection %p",
 			 entry->conn);
 
 		if (IsolationIsSerializable())
-			sql = "START TRANSACTION ISOLATION LEVEL SERIALIZABLE";
+			appendStringInfoString(&sql, "START TRANSACTION ISOLATION LEVEL SERIALIZABLE");
 		else
-			sql = "START TRANSACTION ISOLATION LEVEL REPEATABLE READ";
-		entry->changing_xact_state = true;
-		do_sql_command(entry->conn, sql);
-		entry->xact_depth = 1;
-		entry->changing_xact_state = false;
+			appendStringInfoString(&sql, "START TRANSACTION ISOLATION LEVEL REPEATABLE READ");
+		depth = 1;
 	}
 
 	/*
@@ -441,16 +474,19 @@ begin_remote_xact(ConnCacheEntry *entry)
 	 * This ensures we can rollback just the desired effects when a
 	 * subtransaction aborts.
 	 */
-	while (entry->xact_depth < curlevel)
+	while (depth < curlevel)
 	{
-		char		sql[64];
-
-		snprintf(sql, sizeof(sql), "SAVEPOINT s%d", entry->xact_depth + 1);
-		entry->changing_xact_state = true;
-		do_sql_command(entry->conn, sql);
-		entry->xact_depth++;
-		entry->changing_xact_state = false;
+		depth++;
+		appendStringInfo(&sql, "%sSAVEPOINT s%d",
+						 sql.len > 0 ? "; " : "", depth);
 	}
+
+	entry->changing_xact_state = true;
+	do_sql_command(entry->conn, sql.data);
+	entry->xact_depth = depth;
+	entry->changing_xact_state = false;
+
+	pfree(sql.data);
 }
 
 /*
@@ -502,11 +538,21 @@ GetPrepStmtNumber(PGconn *conn)
  *
  * This function is interruptible by signals.
  *
+ * If the connection has an asynchronous request or a read-ahead fetch still
+ * in flight, it is completed first, since a connection can only run one
+ * query at a time.
+ *
  * Caller is responsible for the error handling on the result.
  */
 PGresult *
-pgfdw_exec_query(PGconn *conn, const char *query)
+pgfdw_exec_query(PGconn *conn, const char *query, PgFdwConnState *state)
 {
+	/* First, process a pending asynchronous request or fetch, if any. */
+	if (state && state->pendingAreq)
+		process_pending_request(state->pendingAreq);
+	if (state && state->pendingScan)
+		process_pending_fetch(state);
+
 	/*
 	 * Submit a query.  Since we don't use non-blocking mode, this also can
 	 * block.  But its risk is relatively small, so we ignore that for now.
@@ -689,6 +735,10 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 					 */
 					pgfdw_reject_incomplete_xact_state_change(entry);
 
+					/* A cursor still open may have a fetch in flight */
+					if (entry->state.pendingScan)
+						process_pending_fetch(&entry->state);
+
 					/* Commit all remote transactions during pre-commit */
 					entry->changing_xact_state = true;
 					do_sql_command(entry->conn, "COMMIT TRANSACTION");
@@ -807,6 +857,9 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 		/* Reset state to show we're out of a transaction */
 		entry->xact_depth = 0;
 
+		/* Any pending async request died with the executor state */
+		memset(&entry->state, 0, sizeof(entry->state));
+
 		/*
 		 * If the connection isn't in a good idle state, discard it to
 		 * recover. Next GetConnection will open a new connection.
@@ -880,6 +933,10 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			 */
 			pgfdw_reject_incomplete_xact_state_change(entry);
 
+			/* A cursor still open may have a fetch in flight */
+			if (entry->state.pendingScan)
+				process_pending_fetch(&entry->state);
+
 			/* Commit all remote subtransactions during pre-commit */
 			snprintf(sql, sizeof(sql), "RELEASE SAVEPOINT s%d", curlevel);
 			entry->changing_xact_state = true;
@@ -904,6 +961,10 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			/* Assume we might have lost track of prepared statements */
 			entry->have_error = true;
 
+			/* Reset the per-connection state if needed */
+			if (entry->state.pendingAreq || entry->state.pendingScan)
+				memset(&entry->state, 0, sizeof(entry->state));
+
 			/*
 			 * If a command has been submitted to the remote server by using
 			 * an asynchronous execution function, the command might not have
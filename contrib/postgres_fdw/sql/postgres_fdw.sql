@@ -2479,3 +2479,73 @@ SELECT b, avg(a), max(a), count(*) FROM pagg_tab GROUP BY b HAVING sum(a) < 700
 
 -- Clean-up
 RESET enable_partitionwise_aggregate;
+
+-- ===================================================================
+-- test asynchronous execution
+-- ===================================================================
+ALTER SERVER loopback OPTIONS (ADD async_capable 'true');
+ALTER SERVER loopback2 OPTIONS (ADD async_capable 'true');
+CREATE TABLE async_pt (a int, b int, c text) PARTITION BY RANGE (a);
+CREATE TABLE base_tbl1 (a int, b int, c text);
+CREATE TABLE base_tbl2 (a int, b int, c text);
+CREATE FOREIGN TABLE async_p1 PARTITION OF async_pt FOR VALUES FROM (1000) TO (2000)
+  SERVER loopback OPTIONS (table_name 'base_tbl1');
+CREATE FOREIGN TABLE async_p2 PARTITION OF async_pt FOR VALUES FROM (2000) TO (3000)
+  SERVER loopback2 OPTIONS (table_name 'base_tbl2');
+INSERT INTO async_p1 SELECT 1000 + i, i, to_char(i, 'FM0000') FROM generate_series(0, 999, 5) i;
+INSERT INTO async_p2 SELECT 2000 + i, i, to_char(i, 'FM0000') FROM generate_series(0, 999, 5) i;
+
+EXPLAIN (COSTS OFF)
+SELECT * FROM async_pt WHERE b % 100 = 0;
+SELECT * FROM async_pt WHERE b % 100 = 0 ORDER BY a;
+
+-- Async execution is not used for ordered or single-child Appends, nor
+-- when disabled
+SET enable_async_append TO false;
+EXPLAIN (COSTS OFF)
+SELECT * FROM async_pt WHERE b % 100 = 0;
+RESET enable_async_append;
+
+EXPLAIN (COSTS OFF)
+SELECT * FROM async_pt WHERE a < 2000;
+
+-- Clean up
+DROP TABLE async_pt;
+DROP TABLE base_tbl1;
+DROP TABLE base_tbl2;
+ALTER SERVER loopback OPTIONS (DROP async_capable);
+ALTER SERVER loopback2 OPTIONS (DROP async_capable);
+
+-- ===================================================================
+-- test batch insert
+-- ===================================================================
+CREATE TABLE batch_table ( x int );
+CREATE FOREIGN TABLE ftable ( x int ) SERVER loopback
+  OPTIONS ( table_name 'batch_table', batch_size '10' );
+ALTER FOREIGN TABLE ftable OPTIONS ( SET batch_size '0' );  -- ERROR
+-- two full batches and a partial one
+INSERT INTO ftable SELECT * FROM generate_series(1, 25) i;
+SELECT COUNT(*), SUM(x) FROM ftable;
+-- errors are reported when the batch is sent
+ALTER TABLE batch_table ADD CONSTRAINT batch_table_x_check CHECK (x < 30);
+INSERT INTO ftable SELECT * FROM generate_series(26, 35) i;  -- ERROR
+SELECT COUNT(*), SUM(x) FROM ftable;
+-- not batched with RETURNING
+INSERT INTO ftable VALUES (26), (27) RETURNING *;
+DROP FOREIGN TABLE ftable;
+DROP TABLE batch_table;
+
+-- batching of rows routed to a foreign partition, by INSERT and COPY
+CREATE TABLE batch_pt ( x int ) PARTITION BY RANGE (x);
+CREATE TABLE batch_p1_remote ( x int );
+CREATE FOREIGN TABLE batch_p1 PARTITION OF batch_pt FOR VALUES FROM (1) TO (100)
+  SERVER loopback OPTIONS ( table_name 'batch_p1_remote', batch_size '10' );
+INSERT INTO batch_pt SELECT * FROM generate_series(1, 25) i;
+COPY batch_pt FROM stdin;
+26
+27
+28
+\.
+SELECT COUNT(*), SUM(x) FROM batch_pt;
+DROP TABLE batch_pt;
+DROP TABLE batch_p1_remote;
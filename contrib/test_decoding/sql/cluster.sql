@@ -0,0 +1,30 @@
+-- predictability
+SET synchronous_commit = on;
+
+-- the built-in plugin of CLUSTER CONCURRENTLY is not for general use
+SELECT 'init' FROM pg_create_logical_replication_slot('regression_slot', 'pg_cluster');
+
+CREATE TABLE clstr_conc (id int PRIMARY KEY, val text, dropme int);
+INSERT INTO clstr_conc SELECT g, 'row ' || g, g FROM generate_series(1, 1000) g;
+ALTER TABLE clstr_conc DROP COLUMN dropme;
+DELETE FROM clstr_conc WHERE id % 2 = 0;
+CREATE INDEX clstr_conc_val ON clstr_conc (val);
+
+CLUSTER CONCURRENTLY clstr_conc USING clstr_conc_val;
+SELECT count(*), sum(id) FROM clstr_conc;
+SELECT indexrelid::regclass, indisclustered FROM pg_index
+  WHERE indrelid = 'clstr_conc'::regclass ORDER BY 1;
+
+-- the indexes must have been carried over
+SET enable_seqscan = off;
+SELECT * FROM clstr_conc WHERE id = 501;
+SELECT * FROM clstr_conc WHERE val = 'row 777';
+RESET enable_seqscan;
+
+VACUUM (FULL, CONCURRENTLY) clstr_conc;
+SELECT count(*), sum(id) FROM clstr_conc;
+
+-- no slot is left behind
+SELECT count(*) FROM pg_replication_slots;
+
+DROP TABLE clstr_conc;
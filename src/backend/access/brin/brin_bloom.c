@@ -0,0 +1,479 @@
+/*
+ * brin_bloom.c
+ *		Implementation of Bloom opclass for BRIN
+ *
+ * A bloom filter is a compact probabilistic representation of a set of
+ * values, which answers the question "might this value be in the set?"
+ * with no false negatives and a tunable rate of false positives.  Storing
+ * one filter per page range makes BRIN usable for equality searches on
+ * columns whose values are not correlated with the physical order of the
+ * table, where minmax summaries degenerate into covering the whole domain.
+ *
+ * The filter is sized when it is first created, from the expected number
+ * of distinct values in a page range (derived from pages_per_range) and
+ * the desired false positive rate; every filter of an index has the same
+ * size, so the union of two filters is a simple bitwise OR.  Values are
+ * hashed by the opclass' hash support function and then mapped to bit
+ * positions using double hashing.
+ *
+ * Only equality searches can be answered, so the opclasses have a single
+ * operator strategy.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/brin/brin_bloom.c
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/brin.h"
+#include "access/brin_internal.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/stratnum.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/hashutils.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+
+
+#define BloomEqualStrategyNumber	1
+
+/*
+ * Additional SQL level support functions
+ *
+ * Procedure numbers must not use values reserved for BRIN itself; see
+ * brin_internal.h.
+ */
+#define		BLOOM_MAX_PROCNUMS		1	/* maximum support procs we need */
+#define		PROCNUM_HASH			11	/* required */
+
+/*
+ * Subtract this from procnum to obtain index in BloomOpaque arrays
+ * (Must be equal to minimum of private procnums).
+ */
+#define		PROCNUM_BASE			11
+
+/*
+ * Parameters of the filter.  A negative number of distinct values is a
+ * fraction of the maximum number of tuples in a page range, as in
+ * pg_statistic.stadistinct.  We never size a filter for less than
+ * BLOOM_MIN_NDISTINCT_PER_RANGE values, which would be pointless.
+ */
+#define		BLOOM_NDISTINCT_PER_RANGE		(-0.1)
+#define		BLOOM_MIN_NDISTINCT_PER_RANGE	16
+#define		BLOOM_FALSE_POSITIVE_RATE		0.01
+
+/*
+ * A filter must leave room for the summaries of the other columns of the
+ * index on the page, so we cap each one at an even share of half a page.
+ */
+#define		BLOOM_MAX_FILTER_SIZE			(BLCKSZ / 2)
+
+/* seeds of the two hash functions used for double hashing */
+#define		BLOOM_SEED_1	0x71d924af
+#define		BLOOM_SEED_2	0xba48b314
+
+/*
+ * On-disk (and in-memory) representation of a bloom filter.  It's a plain
+ * varlena stored as the only value of the index column.
+ */
+typedef struct BloomFilter
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	uint16		nhashes;		/* number of hash functions */
+	uint32		nbits;			/* number of bits in the bitmap */
+	char		data[FLEXIBLE_ARRAY_MEMBER];	/* the bitmap */
+} BloomFilter;
+
+typedef struct BloomOpaque
+{
+	FmgrInfo	extra_procinfos[BLOOM_MAX_PROCNUMS];
+	bool		extra_proc_missing[BLOOM_MAX_PROCNUMS];
+} BloomOpaque;
+
+static FmgrInfo *bloom_get_procinfo(BrinDesc *bdesc, uint16 attno,
+									uint16 procnum);
+
+
+/*
+ * Create an empty bloom filter sized for the index, in the given memory
+ * context.
+ */
+static BloomFilter *
+bloom_init(BrinDesc *bdesc, MemoryContext cxt)
+{
+	BloomFilter *filter;
+	double		ndistinct;
+	double		nbits;
+	int			nbytes;
+	int			maxbytes;
+	int			nhashes;
+
+	ndistinct = BLOOM_NDISTINCT_PER_RANGE;
+	if (ndistinct < 0)
+		ndistinct = -ndistinct * MaxHeapTuplesPerPage *
+			BrinGetPagesPerRange(bdesc->bd_index);
+	ndistinct = Max(ndistinct, BLOOM_MIN_NDISTINCT_PER_RANGE);
+
+	/* the optimal number of bits for the given ndistinct and false positives */
+	nbits = ceil(-(ndistinct * log(BLOOM_FALSE_POSITIVE_RATE)) /
+				 pow(log(2.0), 2));
+
+	/* round up to whole bytes, but don't exceed our share of the page */
+	nbytes = (int) ((nbits + 7) / 8);
+	maxbytes = BLOOM_MAX_FILTER_SIZE / bdesc->bd_tupdesc->natts -
+		offsetof(BloomFilter, data);
+	nbytes = Min(nbytes, maxbytes);
+
+	/* the optimal number of hash functions for the final filter size */
+	nhashes = (int) rint(log(2.0) * (nbytes * 8) / ndistinct);
+	nhashes = Max(nhashes, 1);
+
+	filter = (BloomFilter *) MemoryContextAllocZero(cxt,
+													offsetof(BloomFilter, data) +
+													nbytes);
+	SET_VARSIZE(filter, offsetof(BloomFilter, data) + nbytes);
+	filter->nhashes = nhashes;
+	filter->nbits = nbytes * 8;
+
+	return filter;
+}
+
+/*
+ * Compute the two hash values used for double hashing of a value whose
+ * hash (computed by the opclass' hash function) is "value".
+ */
+static inline void
+bloom_hashes(BloomFilter *filter, uint32 value, uint32 *h1, uint32 *h2)
+{
+	*h1 = DatumGetUInt64(hash_uint32_extended(value, BLOOM_SEED_1)) %
+		filter->nbits;
+	*h2 = DatumGetUInt64(hash_uint32_extended(value, BLOOM_SEED_2)) %
+		filter->nbits;
+}
+
+/*
+ * Add a value to the bloom filter.  Returns whether the filter changed.
+ */
+static bool
+bloom_add_value(BloomFilter *filter, uint32 value)
+{
+	uint32		h1,
+				h2;
+	bool		updated = false;
+	int			i;
+
+	bloom_hashes(filter, value, &h1, &h2);
+
+	for (i = 0; i < filter->nhashes; i++)
+	{
+		/* h1 + i * h2, in 64 bits so that it can't overflow */
+		uint32		h = (uint32) (((uint64) h1 + (uint64) i * h2) %
+								  filter->nbits);
+		uint32		byte = h / 8;
+		uint32		bit = h % 8;
+
+		if (!(filter->data[byte] & (0x01 << bit)))
+		{
+			filter->data[byte] |= (0x01 << bit);
+			updated = true;
+		}
+	}
+
+	return updated;
+}
+
+/*
+ * Check whether the bloom filter may contain the value.
+ */
+static bool
+bloom_contains_value(BloomFilter *filter, uint32 value)
+{
+	uint32		h1,
+				h2;
+	int			i;
+
+	bloom_hashes(filter, value, &h1, &h2);
+
+	for (i = 0; i < filter->nhashes; i++)
+	{
+		uint32		h = (uint32) (((uint64) h1 + (uint64) i * h2) %
+								  filter->nbits);
+		uint32		byte = h / 8;
+		uint32		bit = h % 8;
+
+		if (!(filter->data[byte] & (0x01 << bit)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Return the filter stored in the column, in a form that can be modified in
+ * place.  The filter deformed from an index tuple may have a short varlena
+ * header; if so, replace it with a regular copy living in the column's
+ * memory context.
+ */
+static BloomFilter *
+bloom_get_filter_for_update(BrinValues *column)
+{
+	struct varlena *value = (struct varlena *) DatumGetPointer(column->bv_values[0]);
+
+	if (VARATT_IS_EXTENDED(value))
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(column->bv_context);
+
+		value = PG_DETOAST_DATUM(column->bv_values[0]);
+		column->bv_values[0] = PointerGetDatum(value);
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	return (BloomFilter *) value;
+}
+
+/*
+ * Compute the hash of a value using the opclass' hash function.
+ */
+static uint32
+bloom_hash_value(BrinDesc *bdesc, AttrNumber attno, Oid colloid, Datum value)
+{
+	FmgrInfo   *hashFn;
+
+	hashFn = bloom_get_procinfo(bdesc, attno, PROCNUM_HASH);
+	if (hashFn == NULL)
+		elog(ERROR, "missing hash function %d for attribute %d of index \"%s\"",
+			 PROCNUM_HASH, attno, RelationGetRelationName(bdesc->bd_index));
+
+	return DatumGetUInt32(FunctionCall1Coll(hashFn, colloid, value));
+}
+
+
+Datum
+brin_bloom_opcinfo(PG_FUNCTION_ARGS)
+{
+	BrinOpcInfo *result;
+
+	/*
+	 * opaque->extra_procinfos is initialized lazily; here it is set to
+	 * all-uninitialized by palloc0 which sets fn_oid to InvalidOid.
+	 *
+	 * The filter is stored as a bytea, whatever the type of the column.
+	 */
+	result = palloc0(MAXALIGN(SizeofBrinOpcInfo(1)) +
+					 sizeof(BloomOpaque));
+	result->oi_nstored = 1;
+	result->oi_opaque = (BloomOpaque *)
+		MAXALIGN((char *) result + SizeofBrinOpcInfo(1));
+	result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Examine the given index tuple (which contains partial status of a certain
+ * page range) by comparing it to the given value that comes from another heap
+ * tuple.  If the new value is not yet represented in the bloom filter, add it
+ * and return true.  Otherwise, return false and do not modify in this case.
+ */
+Datum
+brin_bloom_add_value(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum		newval = PG_GETARG_DATUM(2);
+	bool		isnull = PG_GETARG_DATUM(3);
+	Oid			colloid = PG_GET_COLLATION();
+	BloomFilter *filter;
+	uint32		hashValue;
+	bool		updated = false;
+
+	/*
+	 * If the new value is null, we record that we saw it if it's the first
+	 * one; otherwise, there's nothing to do.
+	 */
+	if (isnull)
+	{
+		if (column->bv_hasnulls)
+			PG_RETURN_BOOL(false);
+
+		column->bv_hasnulls = true;
+		PG_RETURN_BOOL(true);
+	}
+
+	/*
+	 * If the recorded value is null, create an empty filter; it's allocated
+	 * in the column's context, so that it's freed along with the tuple.
+	 */
+	if (column->bv_allnulls)
+	{
+		filter = bloom_init(bdesc, column->bv_context);
+		column->bv_values[0] = PointerGetDatum(filter);
+		column->bv_allnulls = false;
+		updated = true;
+	}
+	else
+		filter = bloom_get_filter_for_update(column);
+
+	hashValue = bloom_hash_value(bdesc, column->bv_attno, colloid, newval);
+
+	updated |= bloom_add_value(filter, hashValue);
+
+	PG_RETURN_BOOL(updated);
+}
+
+/*
+ * Given an index tuple corresponding to a certain page range and a scan key,
+ * return whether the scan key is consistent with the index tuple's bloom
+ * filter.  Return true if so, false otherwise.
+ */
+Datum
+brin_bloom_consistent(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	ScanKey		key = (ScanKey) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION();
+	BloomFilter *filter;
+	uint32		hashValue;
+
+	Assert(key->sk_attno == column->bv_attno);
+
+	/* handle IS NULL/IS NOT NULL tests */
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+		{
+			if (column->bv_allnulls || column->bv_hasnulls)
+				PG_RETURN_BOOL(true);
+			PG_RETURN_BOOL(false);
+		}
+
+		/*
+		 * For IS NOT NULL, we can only skip ranges that are known to have
+		 * only nulls.
+		 */
+		if (key->sk_flags & SK_SEARCHNOTNULL)
+			PG_RETURN_BOOL(!column->bv_allnulls);
+
+		/*
+		 * Neither IS NULL nor IS NOT NULL was used; assume all indexable
+		 * operators are strict and return false.
+		 */
+		PG_RETURN_BOOL(false);
+	}
+
+	/* if the range is all empty, it cannot possibly be consistent */
+	if (column->bv_allnulls)
+		PG_RETURN_BOOL(false);
+
+	if (key->sk_strategy != BloomEqualStrategyNumber)
+		elog(ERROR, "invalid strategy number %d", key->sk_strategy);
+
+	filter = (BloomFilter *) PG_DETOAST_DATUM(column->bv_values[0]);
+	hashValue = bloom_hash_value(bdesc, key->sk_attno, colloid,
+								 key->sk_argument);
+
+	PG_RETURN_BOOL(bloom_contains_value(filter, hashValue));
+}
+
+/*
+ * Given two BrinValues, update the first of them as a union of the summary
+ * values contained in both.  The second one is untouched.
+ */
+Datum
+brin_bloom_union(PG_FUNCTION_ARGS)
+{
+	BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+	BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+	BloomFilter *filter_a;
+	BloomFilter *filter_b;
+	uint32		i;
+
+	Assert(col_a->bv_attno == col_b->bv_attno);
+
+	/* Adjust "hasnulls" */
+	if (!col_a->bv_hasnulls && col_b->bv_hasnulls)
+		col_a->bv_hasnulls = true;
+
+	/* If there are no values in B, there's nothing left to do */
+	if (col_b->bv_allnulls)
+		PG_RETURN_VOID();
+
+	/*
+	 * Adjust "allnulls".  If A doesn't have values, just copy the filter
+	 * from B into A, and we're done.
+	 */
+	if (col_a->bv_allnulls)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(col_a->bv_context);
+
+		col_a->bv_values[0] = PointerGetDatum(PG_DETOAST_DATUM_COPY(col_b->bv_values[0]));
+		col_a->bv_allnulls = false;
+		MemoryContextSwitchTo(oldcxt);
+		PG_RETURN_VOID();
+	}
+
+	filter_a = bloom_get_filter_for_update(col_a);
+	filter_b = (BloomFilter *) PG_DETOAST_DATUM(col_b->bv_values[0]);
+
+	/* all the filters of an index are built with the same parameters */
+	Assert(filter_a->nbits == filter_b->nbits);
+	Assert(filter_a->nhashes == filter_b->nhashes);
+
+	for (i = 0; i < filter_a->nbits / 8; i++)
+		filter_a->data[i] |= filter_b->data[i];
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Cache and return bloom opclass support procedure
+ *
+ * Return the procedure corresponding to the given function support number
+ * or null if it does not exist.
+ */
+static FmgrInfo *
+bloom_get_procinfo(BrinDesc *bdesc, uint16 attno, uint16 procnum)
+{
+	BloomOpaque *opaque;
+	uint16		basenum = procnum - PROCNUM_BASE;
+
+	/*
+	 * We cache these in the opaque struct, to avoid repetitive syscache
+	 * lookups.
+	 */
+	opaque = (BloomOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	/*
+	 * If we already searched for this proc and didn't find it, don't bother
+	 * searching again.
+	 */
+	if (opaque->extra_proc_missing[basenum])
+		return NULL;
+
+	if (opaque->extra_procinfos[basenum].fn_oid == InvalidOid)
+	{
+		if (RegProcedureIsValid(index_getprocid(bdesc->bd_index, attno,
+												procnum)))
+		{
+			fmgr_info_copy(&opaque->extra_procinfos[basenum],
+						   index_getprocinfo(bdesc->bd_index, attno, procnum),
+						   bdesc->bd_context);
+		}
+		else
+		{
+			opaque->extra_proc_missing[basenum] = true;
+			return NULL;
+		}
+	}
+
+	return &opaque->extra_procinfos[basenum];
+}
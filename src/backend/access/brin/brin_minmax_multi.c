@@ -0,0 +1,1035 @@
+/*
+ * brin_minmax_multi.c
+ *		Implementation of Multi Min/Max opclass for BRIN
+ *
+ * The regular minmax opclass summarizes each page range by a single
+ * interval [min, max], which works well as long as the values are well
+ * correlated with the physical order of the table.  A few outliers are
+ * enough to make the interval cover most of the domain, though, and then
+ * the index becomes useless.  The opclasses implemented here keep instead a
+ * small number of intervals per page range, so that outliers (or several
+ * clusters of values) only add narrow intervals to the summary.
+ *
+ * The summary is a sorted list of disjoint intervals, represented by their
+ * boundaries, plus a sorted list of individual points (intervals collapsed
+ * to a single value, which take half the space).  While the summary is
+ * being built we accumulate points in memory, well beyond the number of
+ * values we are allowed to store; whenever that buffer fills up, and right
+ * before the summary is written to the index tuple, we reduce it to at most
+ * MINMAX_MULTI_MAX_VALUES values by merging the intervals separated by the
+ * smallest gaps.  Gaps are measured by the opclass' distance support
+ * function.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/brin/brin_minmax_multi.c
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "access/brin_internal.h"
+#include "access/brin_tuple.h"
+#include "access/genam.h"
+#include "access/stratnum.h"
+#include "access/tupmacs.h"
+#include "catalog/pg_amop.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include "utils/date.h"
+#include "utils/datum.h"
+#include "utils/float.h"
+#include "utils/lsyscache.h"
+#include "utils/numeric.h"
+#include "utils/rel.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+
+
+/*
+ * Additional SQL level support functions
+ *
+ * Procedure numbers must not use values reserved for BRIN itself; see
+ * brin_internal.h.
+ */
+#define		MINMAX_MAX_PROCNUMS		1	/* maximum support procs we need */
+#define		PROCNUM_DISTANCE		11	/* required */
+
+/*
+ * Subtract this from procnum to obtain index in MinmaxMultiOpaque arrays
+ * (Must be equal to minimum of private procnums).
+ */
+#define		PROCNUM_BASE			11
+
+/*
+ * Maximum number of values (interval boundaries plus points) stored in the
+ * summary of a page range, and how many times that many values we are
+ * willing to accumulate in memory before reducing the summary.
+ */
+#define		MINMAX_MULTI_MAX_VALUES		32
+#define		MINMAX_BUFFER_FACTOR		10
+
+typedef struct MinmaxMultiOpaque
+{
+	FmgrInfo	extra_procinfos[MINMAX_MAX_PROCNUMS];
+	bool		extra_proc_missing[MINMAX_MAX_PROCNUMS];
+	Oid			cached_subtype;
+	FmgrInfo	strategy_procinfos[BTMaxStrategyNumber];
+} MinmaxMultiOpaque;
+
+/*
+ * In-memory representation of the summary.  The first 2 * nranges elements
+ * of values[] are the boundaries of the intervals, sorted and disjoint;
+ * they are followed by npoints sorted individual values.  The array has
+ * room for maxvalues elements in total.
+ */
+typedef struct Ranges
+{
+	AttrNumber	attno;			/* index attribute number */
+	Oid			colloid;		/* collation to compare values with */
+	Oid			typid;			/* type of the values */
+	bool		typbyval;
+	int16		typlen;
+	char		typalign;
+
+	int			nranges;		/* number of intervals */
+	int			npoints;		/* number of individual values */
+	int			maxvalues;		/* capacity of values[] */
+
+	Datum		values[FLEXIBLE_ARRAY_MEMBER];
+} Ranges;
+
+/*
+ * On-disk representation of the summary, stored as a bytea.  The values
+ * are laid out as in Ranges, each one aligned as required by its type.
+ */
+typedef struct SerializedRanges
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	Oid			typid;			/* type of the values */
+	int32		nranges;		/* number of intervals */
+	int32		npoints;		/* number of individual values */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} SerializedRanges;
+
+/*
+ * An interval while reducing the summary; individual points are intervals
+ * with minval == maxval and "collapsed" set.
+ */
+typedef struct ExpandedRange
+{
+	Datum		minval;
+	Datum		maxval;
+	bool		collapsed;
+} ExpandedRange;
+
+/* state for comparing values of the indexed type */
+typedef struct CompareContext
+{
+	FmgrInfo   *cmpFn;			/* the type's "<" operator */
+	Oid			colloid;
+} CompareContext;
+
+static FmgrInfo *minmax_multi_get_procinfo(BrinDesc *bdesc, uint16 attno,
+										   uint16 procnum);
+static FmgrInfo *minmax_multi_get_strategy_procinfo(BrinDesc *bdesc,
+													uint16 attno,
+													Oid subtype,
+													uint16 strategynum);
+static void brin_minmax_multi_serialize(BrinDesc *bdesc, Datum src,
+										Datum *dst);
+
+
+/*
+ * Compare two values of the indexed type, qsort-style.
+ */
+static int
+compare_values(const Datum a, const Datum b, CompareContext *cxt)
+{
+	if (DatumGetBool(FunctionCall2Coll(cxt->cmpFn, cxt->colloid, a, b)))
+		return -1;
+	if (DatumGetBool(FunctionCall2Coll(cxt->cmpFn, cxt->colloid, b, a)))
+		return 1;
+	return 0;
+}
+
+static int
+compare_expanded_ranges(const void *a, const void *b, void *arg)
+{
+	const ExpandedRange *ra = (const ExpandedRange *) a;
+	const ExpandedRange *rb = (const ExpandedRange *) b;
+
+	return compare_values(ra->minval, rb->minval, (CompareContext *) arg);
+}
+
+static void
+init_compare_context(BrinDesc *bdesc, Ranges *ranges, CompareContext *cxt)
+{
+	cxt->cmpFn = minmax_multi_get_strategy_procinfo(bdesc, ranges->attno,
+													ranges->typid,
+													BTLessStrategyNumber);
+	cxt->colloid = ranges->colloid;
+}
+
+/*
+ * Allocate an empty summary, in the current memory context.
+ */
+static Ranges *
+ranges_init(BrinDesc *bdesc, AttrNumber attno, Oid colloid)
+{
+	Form_pg_attribute attr = TupleDescAttr(bdesc->bd_tupdesc, attno - 1);
+	int			maxvalues = MINMAX_MULTI_MAX_VALUES * MINMAX_BUFFER_FACTOR;
+	Ranges	   *ranges;
+
+	ranges = palloc0(offsetof(Ranges, values) + maxvalues * sizeof(Datum));
+	ranges->attno = attno;
+	ranges->colloid = colloid;
+	ranges->typid = attr->atttypid;
+	ranges->typbyval = attr->attbyval;
+	ranges->typlen = attr->attlen;
+	ranges->typalign = attr->attalign;
+	ranges->maxvalues = maxvalues;
+
+	return ranges;
+}
+
+/*
+ * Build the in-memory summary from its on-disk form, in the current memory
+ * context.  Values passed by reference point into a private copy of the
+ * serialized summary.
+ */
+static Ranges *
+ranges_deserialize(BrinDesc *bdesc, AttrNumber attno, Oid colloid,
+				   Datum value)
+{
+	SerializedRanges *serialized;
+	Ranges	   *ranges;
+	char	   *ptr;
+	int			nvalues;
+	int			i;
+
+	serialized = (SerializedRanges *) PG_DETOAST_DATUM_COPY(value);
+	ranges = ranges_init(bdesc, attno, colloid);
+
+	Assert(serialized->typid == ranges->typid);
+
+	nvalues = 2 * serialized->nranges + serialized->npoints;
+	Assert(nvalues <= ranges->maxvalues);
+
+	ranges->nranges = serialized->nranges;
+	ranges->npoints = serialized->npoints;
+
+	ptr = serialized->data;
+	for (i = 0; i < nvalues; i++)
+	{
+		ptr = (char *) att_align_nominal(ptr, ranges->typalign);
+		ranges->values[i] = fetch_att(ptr, ranges->typbyval, ranges->typlen);
+		ptr = att_addlength_pointer(ptr, ranges->typlen, ptr);
+	}
+
+	return ranges;
+}
+
+/*
+ * Build the on-disk form of the summary, in the current memory context.
+ */
+static SerializedRanges *
+ranges_serialize(Ranges *ranges)
+{
+	SerializedRanges *serialized;
+	Size		len;
+	char	   *ptr;
+	int			nvalues = 2 * ranges->nranges + ranges->npoints;
+	int			i;
+
+	len = offsetof(SerializedRanges, data);
+	for (i = 0; i < nvalues; i++)
+	{
+		len = att_align_nominal(len, ranges->typalign);
+		len = att_addlength_datum(len, ranges->typlen, ranges->values[i]);
+	}
+
+	serialized = (SerializedRanges *) palloc0(len);
+	SET_VARSIZE(serialized, len);
+	serialized->typid = ranges->typid;
+	serialized->nranges = ranges->nranges;
+	serialized->npoints = ranges->npoints;
+
+	ptr = serialized->data;
+	for (i = 0; i < nvalues; i++)
+	{
+		ptr = (char *) att_align_nominal(ptr, ranges->typalign);
+
+		if (ranges->typbyval)
+			store_att_byval(ptr, ranges->values[i], ranges->typlen);
+		else
+		{
+			Size		datalen;
+
+			datalen = att_addlength_datum(0, ranges->typlen, ranges->values[i]);
+			memcpy(ptr, DatumGetPointer(ranges->values[i]), datalen);
+		}
+
+		ptr = att_addlength_datum(ptr, ranges->typlen, ranges->values[i]);
+	}
+
+	Assert(ptr == (char *) serialized + len);
+
+	return serialized;
+}
+
+/*
+ * Check whether the summary contains the given value.  If not, and insertpos
+ * isn't NULL, return the position at which it would go in the sorted array
+ * of points.
+ */
+static bool
+ranges_contain_value(Ranges *ranges, CompareContext *cxt, Datum value,
+					 int *insertpos)
+{
+	Datum	   *points = &ranges->values[2 * ranges->nranges];
+	int			lo,
+				hi;
+
+	/* binary search for the last interval starting at or before value */
+	lo = 0;
+	hi = ranges->nranges;
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+
+		if (compare_values(ranges->values[2 * mid], value, cxt) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo > 0 &&
+		compare_values(value, ranges->values[2 * (lo - 1) + 1], cxt) <= 0)
+		return true;
+
+	/* and now among the points */
+	lo = 0;
+	hi = ranges->npoints;
+	while (lo < hi)
+	{
+		int			mid = (lo + hi) / 2;
+		int			r = compare_values(points[mid], value, cxt);
+
+		if (r == 0)
+			return true;
+		if (r < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (insertpos)
+		*insertpos = lo;
+
+	return false;
+}
+
+/*
+ * Reduce the summary so that it has at most maxvalues values.
+ *
+ * We expand all the intervals and points into a single sorted array, merge
+ * the ones that overlap, and then keep merging the pair of neighbors with
+ * the smallest gap between them until the summary is small enough.  Note
+ * that merging two neighbors doesn't change the gaps to the other ones.
+ */
+static int
+reduce_expanded_ranges(BrinDesc *bdesc, Ranges *ranges, CompareContext *cxt,
+					   ExpandedRange *eranges, int neranges, int maxvalues)
+{
+	FmgrInfo   *distanceFn;
+	double	   *distances;
+	int			nvalues;
+	int			i,
+				j;
+
+	if (neranges == 0)
+		return 0;
+
+	/* sort by start of the interval and merge the overlapping ones */
+	qsort_arg(eranges, neranges, sizeof(ExpandedRange),
+			  compare_expanded_ranges, cxt);
+
+	for (i = 1, j = 0; i < neranges; i++)
+	{
+		if (compare_values(eranges[j].maxval, eranges[i].minval, cxt) < 0)
+		{
+			eranges[++j] = eranges[i];
+			continue;
+		}
+
+		if (compare_values(eranges[j].maxval, eranges[i].maxval, cxt) < 0)
+			eranges[j].maxval = eranges[i].maxval;
+		eranges[j].collapsed =
+			(compare_values(eranges[j].minval, eranges[j].maxval, cxt) == 0);
+	}
+	neranges = j + 1;
+
+	nvalues = 0;
+	for (i = 0; i < neranges; i++)
+		nvalues += eranges[i].collapsed ? 1 : 2;
+
+	if (nvalues <= maxvalues)
+		return neranges;
+
+	distanceFn = minmax_multi_get_procinfo(bdesc, ranges->attno,
+										   PROCNUM_DISTANCE);
+	if (distanceFn == NULL)
+		elog(ERROR, "missing distance function %d for attribute %d of index \"%s\"",
+			 PROCNUM_DISTANCE, ranges->attno,
+			 RelationGetRelationName(bdesc->bd_index));
+
+	/* distances[i] is the gap between eranges[i] and eranges[i + 1] */
+	distances = palloc(sizeof(double) * (neranges - 1));
+	for (i = 0; i < neranges - 1; i++)
+		distances[i] = DatumGetFloat8(FunctionCall2Coll(distanceFn,
+														ranges->colloid,
+														eranges[i].maxval,
+														eranges[i + 1].minval));
+
+	while (nvalues > maxvalues && neranges > 1)
+	{
+		int			best = 0;
+
+		for (i = 1; i < neranges - 1; i++)
+		{
+			if (distances[i] < distances[best])
+				best = i;
+		}
+
+		nvalues -= (eranges[best].collapsed ? 1 : 2) +
+			(eranges[best + 1].collapsed ? 1 : 2) - 2;
+
+		eranges[best].maxval = eranges[best + 1].maxval;
+		eranges[best].collapsed = false;
+
+		memmove(&eranges[best + 1], &eranges[best + 2],
+				sizeof(ExpandedRange) * (neranges - best - 2));
+		memmove(&distances[best], &distances[best + 1],
+				sizeof(double) * (neranges - best - 2));
+		neranges--;
+	}
+
+	pfree(distances);
+
+	return neranges;
+}
+
+/*
+ * Store the (sorted, disjoint) expanded ranges back into the summary.
+ */
+static void
+store_expanded_ranges(Ranges *ranges, ExpandedRange *eranges, int neranges)
+{
+	int			nranges = 0;
+	int			npoints = 0;
+	int			i;
+
+	for (i = 0; i < neranges; i++)
+	{
+		if (!eranges[i].collapsed)
+			nranges++;
+	}
+
+	Assert(neranges + nranges <= ranges->maxvalues);
+
+	for (i = 0; i < neranges; i++)
+	{
+		if (eranges[i].collapsed)
+			ranges->values[2 * nranges + npoints++] = eranges[i].minval;
+	}
+
+	ranges->nranges = nranges;
+	ranges->npoints = npoints;
+
+	for (i = 0, nranges = 0; i < neranges; i++)
+	{
+		if (eranges[i].collapsed)
+			continue;
+		ranges->values[2 * nranges] = eranges[i].minval;
+		ranges->values[2 * nranges + 1] = eranges[i].maxval;
+		nranges++;
+	}
+}
+
+/*
+ * Copy the intervals and points of the summary into eranges, which must
+ * have room for nranges + npoints elements.  Returns the number of elements
+ * added.
+ */
+static int
+fill_expanded_ranges(Ranges *ranges, ExpandedRange *eranges)
+{
+	int			n = 0;
+	int			i;
+
+	for (i = 0; i < ranges->nranges; i++, n++)
+	{
+		eranges[n].minval = ranges->values[2 * i];
+		eranges[n].maxval = ranges->values[2 * i + 1];
+		eranges[n].collapsed = false;
+	}
+	for (i = 0; i < ranges->npoints; i++, n++)
+	{
+		eranges[n].minval = eranges[n].maxval =
+			ranges->values[2 * ranges->nranges + i];
+		eranges[n].collapsed = true;
+	}
+
+	return n;
+}
+
+/*
+ * Reduce the summary to at most maxvalues values, if needed.
+ */
+static void
+ranges_compactify(BrinDesc *bdesc, Ranges *ranges, int maxvalues)
+{
+	CompareContext cxt;
+	ExpandedRange *eranges;
+	int			neranges;
+
+	if (2 * ranges->nranges + ranges->npoints <= maxvalues)
+		return;
+
+	init_compare_context(bdesc, ranges, &cxt);
+
+	eranges = palloc(sizeof(ExpandedRange) *
+					 (ranges->nranges + ranges->npoints));
+	neranges = fill_expanded_ranges(ranges, eranges);
+	neranges = reduce_expanded_ranges(bdesc, ranges, &cxt, eranges, neranges,
+									  maxvalues);
+	store_expanded_ranges(ranges, eranges, neranges);
+
+	pfree(eranges);
+}
+
+/*
+ * Return the in-memory summary of the column, building it (in the column's
+ * memory context) from the on-disk form if it doesn't exist yet.
+ */
+static Ranges *
+minmax_multi_get_ranges(BrinDesc *bdesc, BrinValues *column, Oid colloid)
+{
+	MemoryContext oldcxt;
+	Ranges	   *ranges;
+
+	if (column->bv_mem_value != PointerGetDatum(NULL))
+		return (Ranges *) DatumGetPointer(column->bv_mem_value);
+
+	oldcxt = MemoryContextSwitchTo(column->bv_context);
+	if (column->bv_allnulls)
+		ranges = ranges_init(bdesc, column->bv_attno, colloid);
+	else
+		ranges = ranges_deserialize(bdesc, column->bv_attno, colloid,
+									column->bv_values[0]);
+	MemoryContextSwitchTo(oldcxt);
+
+	column->bv_mem_value = PointerGetDatum(ranges);
+	column->bv_serialize = brin_minmax_multi_serialize;
+
+	return ranges;
+}
+
+/*
+ * Serialization callback, invoked when the index tuple is formed.
+ */
+static void
+brin_minmax_multi_serialize(BrinDesc *bdesc, Datum src, Datum *dst)
+{
+	Ranges	   *ranges = (Ranges *) DatumGetPointer(src);
+
+	ranges_compactify(bdesc, ranges, MINMAX_MULTI_MAX_VALUES);
+
+	dst[0] = PointerGetDatum(ranges_serialize(ranges));
+}
+
+
+Datum
+brin_minmax_multi_opcinfo(PG_FUNCTION_ARGS)
+{
+	BrinOpcInfo *result;
+
+	/*
+	 * All members of opaque are initialized lazily; see the notes in
+	 * brin_inclusion_opcinfo.
+	 *
+	 * The summary is stored as a bytea, whatever the type of the column.
+	 */
+	result = palloc0(MAXALIGN(SizeofBrinOpcInfo(1)) +
+					 sizeof(MinmaxMultiOpaque));
+	result->oi_nstored = 1;
+	result->oi_opaque = (MinmaxMultiOpaque *)
+		MAXALIGN((char *) result + SizeofBrinOpcInfo(1));
+	result->oi_typcache[0] = lookup_type_cache(BYTEAOID, 0);
+
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Examine the given index tuple (which contains partial status of a certain
+ * page range) by comparing it to the given value that comes from another heap
+ * tuple.  If the new value is not covered by the summary, add it and return
+ * true.  Otherwise, return false and do not modify in this case.
+ */
+Datum
+brin_minmax_multi_add_value(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	Datum		newval = PG_GETARG_DATUM(2);
+	bool		isnull = PG_GETARG_DATUM(3);
+	Oid			colloid = PG_GET_COLLATION();
+	Ranges	   *ranges;
+	CompareContext cxt;
+	MemoryContext oldcxt;
+	Datum	   *points;
+	int			pos;
+
+	/*
+	 * If the new value is null, we record that we saw it if it's the first
+	 * one; otherwise, there's nothing to do.
+	 */
+	if (isnull)
+	{
+		if (column->bv_hasnulls)
+			PG_RETURN_BOOL(false);
+
+		column->bv_hasnulls = true;
+		PG_RETURN_BOOL(true);
+	}
+
+	ranges = minmax_multi_get_ranges(bdesc, column, colloid);
+	column->bv_allnulls = false;
+
+	/* the summary keeps plain copies of varlena values */
+	if (ranges->typlen == -1)
+		newval = PointerGetDatum(PG_DETOAST_DATUM(newval));
+
+	init_compare_context(bdesc, ranges, &cxt);
+
+	if (ranges_contain_value(ranges, &cxt, newval, &pos))
+		PG_RETURN_BOOL(false);
+
+	/*
+	 * If the buffer is full, reduce the summary first.  The new value may be
+	 * covered by one of the merged intervals now.
+	 */
+	if (2 * ranges->nranges + ranges->npoints == ranges->maxvalues)
+	{
+		ranges_compactify(bdesc, ranges, MINMAX_MULTI_MAX_VALUES);
+
+		if (ranges_contain_value(ranges, &cxt, newval, &pos))
+			PG_RETURN_BOOL(true);
+	}
+
+	/* insert it in the sorted array of points */
+	points = &ranges->values[2 * ranges->nranges];
+	memmove(&points[pos + 1], &points[pos],
+			sizeof(Datum) * (ranges->npoints - pos));
+
+	oldcxt = MemoryContextSwitchTo(column->bv_context);
+	points[pos] = datumCopy(newval, ranges->typbyval, ranges->typlen);
+	MemoryContextSwitchTo(oldcxt);
+	ranges->npoints++;
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Given an index tuple corresponding to a certain page range and a scan key,
+ * return whether the scan key is consistent with the intervals and points of
+ * the summary.  Return true if so, false otherwise.
+ */
+Datum
+brin_minmax_multi_consistent(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *column = (BrinValues *) PG_GETARG_POINTER(1);
+	ScanKey		key = (ScanKey) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION(),
+				subtype;
+	AttrNumber	attno;
+	Datum		value;
+	Ranges	   *ranges;
+	Datum	   *points;
+	FmgrInfo   *finfo;
+	int			i;
+
+	Assert(key->sk_attno == column->bv_attno);
+
+	/* handle IS NULL/IS NOT NULL tests */
+	if (key->sk_flags & SK_ISNULL)
+	{
+		if (key->sk_flags & SK_SEARCHNULL)
+		{
+			if (column->bv_allnulls || column->bv_hasnulls)
+				PG_RETURN_BOOL(true);
+			PG_RETURN_BOOL(false);
+		}
+
+		/*
+		 * For IS NOT NULL, we can only skip ranges that are known to have
+		 * only nulls.
+		 */
+		if (key->sk_flags & SK_SEARCHNOTNULL)
+			PG_RETURN_BOOL(!column->bv_allnulls);
+
+		/*
+		 * Neither IS NULL nor IS NOT NULL was used; assume all indexable
+		 * operators are strict and return false.
+		 */
+		PG_RETURN_BOOL(false);
+	}
+
+	/* if the range is all empty, it cannot possibly be consistent */
+	if (column->bv_allnulls)
+		PG_RETURN_BOOL(false);
+
+	attno = key->sk_attno;
+	subtype = key->sk_subtype;
+	value = key->sk_argument;
+
+	ranges = ranges_deserialize(bdesc, attno, colloid, column->bv_values[0]);
+	points = &ranges->values[2 * ranges->nranges];
+
+	switch (key->sk_strategy)
+	{
+		case BTLessStrategyNumber:
+		case BTLessEqualStrategyNumber:
+
+			/*
+			 * Only the smallest value matters, and it's either the start of
+			 * the first interval or the first point.
+			 */
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   key->sk_strategy);
+			if (ranges->nranges > 0 &&
+				DatumGetBool(FunctionCall2Coll(finfo, colloid,
+											   ranges->values[0], value)))
+				PG_RETURN_BOOL(true);
+			if (ranges->npoints > 0 &&
+				DatumGetBool(FunctionCall2Coll(finfo, colloid,
+											   points[0], value)))
+				PG_RETURN_BOOL(true);
+			break;
+		case BTEqualStrategyNumber:
+			for (i = 0; i < ranges->nranges; i++)
+			{
+				/* min() <= scankey and max() >= scankey */
+				finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+														   BTLessEqualStrategyNumber);
+				if (!DatumGetBool(FunctionCall2Coll(finfo, colloid,
+													ranges->values[2 * i],
+													value)))
+					break;	/* the following intervals start even later */
+
+				finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+														   BTGreaterEqualStrategyNumber);
+				if (DatumGetBool(FunctionCall2Coll(finfo, colloid,
+												   ranges->values[2 * i + 1],
+												   value)))
+					PG_RETURN_BOOL(true);
+			}
+
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   BTEqualStrategyNumber);
+			for (i = 0; i < ranges->npoints; i++)
+			{
+				if (DatumGetBool(FunctionCall2Coll(finfo, colloid,
+												   points[i], value)))
+					PG_RETURN_BOOL(true);
+			}
+			break;
+		case BTGreaterEqualStrategyNumber:
+		case BTGreaterStrategyNumber:
+
+			/*
+			 * Only the largest value matters, and it's either the end of the
+			 * last interval or the last point.
+			 */
+			finfo = minmax_multi_get_strategy_procinfo(bdesc, attno, subtype,
+													   key->sk_strategy);
+			if (ranges->nranges > 0 &&
+				DatumGetBool(FunctionCall2Coll(finfo, colloid,
+											   ranges->values[2 * ranges->nranges - 1],
+											   value)))
+				PG_RETURN_BOOL(true);
+			if (ranges->npoints > 0 &&
+				DatumGetBool(FunctionCall2Coll(finfo, colloid,
+											   points[ranges->npoints - 1],
+											   value)))
+				PG_RETURN_BOOL(true);
+			break;
+		default:
+			/* shouldn't happen */
+			elog(ERROR, "invalid strategy number %d", key->sk_strategy);
+			break;
+	}
+
+	PG_RETURN_BOOL(false);
+}
+
+/*
+ * Given two BrinValues, update the first of them as a union of the summary
+ * values contained in both.  The second one is untouched.
+ */
+Datum
+brin_minmax_multi_union(PG_FUNCTION_ARGS)
+{
+	BrinDesc   *bdesc = (BrinDesc *) PG_GETARG_POINTER(0);
+	BrinValues *col_a = (BrinValues *) PG_GETARG_POINTER(1);
+	BrinValues *col_b = (BrinValues *) PG_GETARG_POINTER(2);
+	Oid			colloid = PG_GET_COLLATION();
+	Ranges	   *ranges_a;
+	Ranges	   *ranges_b;
+	CompareContext cxt;
+	ExpandedRange *eranges;
+	MemoryContext oldcxt;
+	int			neranges;
+
+	Assert(col_a->bv_attno == col_b->bv_attno);
+
+	/* Adjust "hasnulls" */
+	if (!col_a->bv_hasnulls && col_b->bv_hasnulls)
+		col_a->bv_hasnulls = true;
+
+	/* If there are no values in B, there's nothing left to do */
+	if (col_b->bv_allnulls)
+		PG_RETURN_VOID();
+
+	ranges_a = minmax_multi_get_ranges(bdesc, col_a, colloid);
+	col_a->bv_allnulls = false;
+
+	/*
+	 * B comes straight from an index tuple, so it only has the on-disk form.
+	 * Its values end up in A's summary, so they must live as long.
+	 */
+	Assert(col_b->bv_mem_value == PointerGetDatum(NULL));
+	oldcxt = MemoryContextSwitchTo(col_a->bv_context);
+	ranges_b = ranges_deserialize(bdesc, col_b->bv_attno, colloid,
+								  col_b->bv_values[0]);
+	MemoryContextSwitchTo(oldcxt);
+
+	init_compare_context(bdesc, ranges_a, &cxt);
+
+	eranges = palloc(sizeof(ExpandedRange) *
+					 (ranges_a->nranges + ranges_a->npoints +
+					  ranges_b->nranges + ranges_b->npoints));
+	neranges = fill_expanded_ranges(ranges_a, eranges);
+	neranges += fill_expanded_ranges(ranges_b, &eranges[neranges]);
+
+	neranges = reduce_expanded_ranges(bdesc, ranges_a, &cxt, eranges,
+									  neranges, MINMAX_MULTI_MAX_VALUES);
+	store_expanded_ranges(ranges_a, eranges, neranges);
+
+	pfree(eranges);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Cache and return minmax-multi opclass support procedure
+ *
+ * Return the procedure corresponding to the given function support number
+ * or null if it does not exist.
+ */
+static FmgrInfo *
+minmax_multi_get_procinfo(BrinDesc *bdesc, uint16 attno, uint16 procnum)
+{
+	MinmaxMultiOpaque *opaque;
+	uint16		basenum = procnum - PROCNUM_BASE;
+
+	/*
+	 * We cache these in the opaque struct, to avoid repetitive syscache
+	 * lookups.
+	 */
+	opaque = (MinmaxMultiOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	/*
+	 * If we already searched for this proc and didn't find it, don't bother
+	 * searching again.
+	 */
+	if (opaque->extra_proc_missing[basenum])
+		return NULL;
+
+	if (opaque->extra_procinfos[basenum].fn_oid == InvalidOid)
+	{
+		if (RegProcedureIsValid(index_getprocid(bdesc->bd_index, attno,
+												procnum)))
+		{
+			fmgr_info_copy(&opaque->extra_procinfos[basenum],
+						   index_getprocinfo(bdesc->bd_index, attno, procnum),
+						   bdesc->bd_context);
+		}
+		else
+		{
+			opaque->extra_proc_missing[basenum] = true;
+			return NULL;
+		}
+	}
+
+	return &opaque->extra_procinfos[basenum];
+}
+
+/*
+ * Cache and return the procedure for the given strategy.
+ *
+ * Note: this function mirrors minmax_get_strategy_procinfo; see notes
+ * there.  If changes are made here, see that function too.
+ */
+static FmgrInfo *
+minmax_multi_get_strategy_procinfo(BrinDesc *bdesc, uint16 attno, Oid subtype,
+								   uint16 strategynum)
+{
+	MinmaxMultiOpaque *opaque;
+
+	Assert(strategynum >= 1 &&
+		   strategynum <= BTMaxStrategyNumber);
+
+	opaque = (MinmaxMultiOpaque *) bdesc->bd_info[attno - 1]->oi_opaque;
+
+	/*
+	 * We cache the procedures for the previous subtype in the opaque struct,
+	 * to avoid repetitive syscache lookups.  If the subtype changed,
+	 * invalidate all the cached entries.
+	 */
+	if (opaque->cached_subtype != subtype)
+	{
+		uint16		i;
+
+		for (i = 1; i <= BTMaxStrategyNumber; i++)
+			opaque->strategy_procinfos[i - 1].fn_oid = InvalidOid;
+		opaque->cached_subtype = subtype;
+	}
+
+	if (opaque->strategy_procinfos[strategynum - 1].fn_oid == InvalidOid)
+	{
+		Form_pg_attribute attr;
+		HeapTuple	tuple;
+		Oid			opfamily,
+					oprid;
+		bool		isNull;
+
+		opfamily = bdesc->bd_index->rd_opfamily[attno - 1];
+		attr = TupleDescAttr(bdesc->bd_tupdesc, attno - 1);
+		tuple = SearchSysCache4(AMOPSTRATEGY, ObjectIdGetDatum(opfamily),
+								ObjectIdGetDatum(attr->atttypid),
+								ObjectIdGetDatum(subtype),
+								Int16GetDatum(strategynum));
+
+		if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+				 strategynum, attr->atttypid, subtype, opfamily);
+
+		oprid = DatumGetObjectId(SysCacheGetAttr(AMOPSTRATEGY, tuple,
+												 Anum_pg_amop_amopopr, &isNull));
+		ReleaseSysCache(tuple);
+		Assert(!isNull && RegProcedureIsValid(oprid));
+
+		fmgr_info_cxt(get_opcode(oprid),
+					  &opaque->strategy_procinfos[strategynum - 1],
+					  bdesc->bd_context);
+	}
+
+	return &opaque->strategy_procinfos[strategynum - 1];
+}
+
+
+/*
+ * Distance support functions
+ *
+ * Each returns the distance between two values a <= b of the indexed type,
+ * as a float8.  The distances only need to be comparable among themselves,
+ * as they are used to decide which intervals to merge.
+ */
+Datum
+brin_minmax_multi_distance_int2(PG_FUNCTION_ARGS)
+{
+	int16		a = DatumGetInt16(PG_GETARG_DATUM(0));
+	int16		b = DatumGetInt16(PG_GETARG_DATUM(1));
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_int4(PG_FUNCTION_ARGS)
+{
+	int32		a = DatumGetInt32(PG_GETARG_DATUM(0));
+	int32		b = DatumGetInt32(PG_GETARG_DATUM(1));
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_int8(PG_FUNCTION_ARGS)
+{
+	int64		a = DatumGetInt64(PG_GETARG_DATUM(0));
+	int64		b = DatumGetInt64(PG_GETARG_DATUM(1));
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_float4(PG_FUNCTION_ARGS)
+{
+	float4		a = DatumGetFloat4(PG_GETARG_DATUM(0));
+	float4		b = DatumGetFloat4(PG_GETARG_DATUM(1));
+
+	/* infinities, which would give NaN; NaNs sort as equal, too */
+	if (a == b || (isnan(a) && isnan(b)))
+		PG_RETURN_FLOAT8(0.0);
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+Datum
+brin_minmax_multi_distance_float8(PG_FUNCTION_ARGS)
+{
+	float8		a = DatumGetFloat8(PG_GETARG_DATUM(0));
+	float8		b = DatumGetFloat8(PG_GETARG_DATUM(1));
+
+	/* infinities, which would give NaN; NaNs sort as equal, too */
+	if (a == b || (isnan(a) && isnan(b)))
+		PG_RETURN_FLOAT8(0.0);
+
+	PG_RETURN_FLOAT8(b - a);
+}
+
+Datum
+brin_minmax_multi_distance_numeric(PG_FUNCTION_ARGS)
+{
+	Datum		a = PG_GETARG_DATUM(0);
+	Datum		b = PG_GETARG_DATUM(1);
+	Datum		d;
+
+	d = DirectFunctionCall2(numeric_sub, b, a);
+
+	PG_RETURN_FLOAT8(DatumGetFloat8(DirectFunctionCall1(numeric_float8_no_overflow,
+														d)));
+}
+
+Datum
+brin_minmax_multi_distance_date(PG_FUNCTION_ARGS)
+{
+	DateADT		a = DatumGetDateADT(PG_GETARG_DATUM(0));
+	DateADT		b = DatumGetDateADT(PG_GETARG_DATUM(1));
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
+
+/* also used for timestamptz, which has the same representation */
+Datum
+brin_minmax_multi_distance_timestamp(PG_FUNCTION_ARGS)
+{
+	Timestamp	a = DatumGetTimestamp(PG_GETARG_DATUM(0));
+	Timestamp	b = DatumGetTimestamp(PG_GETARG_DATUM(1));
+
+	PG_RETURN_FLOAT8((double) b - (double) a);
+}
@@ -23,6 +23,7 @@
 #include "access/relation.h"
 #include "access/xact.h"
 #include "catalog/namespace.h"
+#include "catalog/storage.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/lmgr.h"
@@ -73,6 +74,10 @@ relation_open(Oid relationId, LOCKMODE lockmode)
 	if (RelationUsesLocalBuffers(r))
 		MyXactFlags |= XACT_FLAGS_ACCESSEDTEMPNAMESPACE;
 
+	/* Set up this session's storage for a global temp relation */
+	if (RelationIsGlobalTemp(r) && !r->rd_localstorage)
+		RelationInitLocalStorage(r);
+
 	pgstat_initstats(r);
 
 	return r;
@@ -123,6 +128,10 @@ try_relation_open(Oid relationId, LOCKMODE lockmode)
 	if (RelationUsesLocalBuffers(r))
 		MyXactFlags |= XACT_FLAGS_ACCESSEDTEMPNAMESPACE;
 
+	/* Set up this session's storage for a global temp relation */
+	if (RelationIsGlobalTemp(r) && !r->rd_localstorage)
+		RelationInitLocalStorage(r);
+
 	pgstat_initstats(r);
 
 	return r;
@@ -73,6 +73,7 @@ CreateTemplateTupleDesc(int natts)
 	desc->tdtypeid = RECORDOID;
 	desc->tdtypmod = -1;
 	desc->tdrefcount = -1;		/* assume not reference-counted */
+	desc->tdnfixed = -1;
 
 	return desc;
 }
@@ -260,6 +261,39 @@ TupleDescCopy(TupleDesc dst, TupleDesc src)
 	dst->tdrefcount = -1;
 }
 
+/*
+ * TupleDescComputeFixedPrefix
+ *		Compute and remember the number of leading fixed-width attributes,
+ *		setting their attcacheoff along the way.
+ *
+ * Tuple deformation can fetch these attributes at their cached offsets
+ * without any per-attribute alignment work, as long as none of them is null.
+ * Use the TupleDescFixedPrefix() macro rather than calling this directly.
+ */
+int
+TupleDescComputeFixedPrefix(TupleDesc tupdesc)
+{
+	uint32		off = 0;
+	int			i;
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+
+		if (att->attlen <= 0)
+			break;
+
+		off = att_align_nominal(off, att->attalign);
+		Assert(att->attcacheoff < 0 || att->attcacheoff == off);
+		att->attcacheoff = off;
+		off += att->attlen;
+	}
+
+	tupdesc->tdnfixed = i;
+
+	return i;
+}
+
 /*
  * TupleDescCopyEntry
  *		This function copies a single attribute structure from one tuple
@@ -297,6 +331,7 @@ TupleDescCopyEntry(TupleDesc dst, AttrNumber dstAttno,
 	 */
 	dstAtt->attnum = dstAttno;
 	dstAtt->attcacheoff = -1;
+	dst->tdnfixed = -1;
 
 	/* since we're not copying constraints or defaults, clear these */
 	dstAtt->attnotnull = false;
@@ -462,6 +497,8 @@ equalTupleDescs(TupleDesc tupdesc1, TupleDesc tupdesc2)
 			return false;
 		if (attr1->attgenerated != attr2->attgenerated)
 			return false;
+		if (attr1->attcompression != attr2->attcompression)
+			return false;
 		if (attr1->attisdropped != attr2->attisdropped)
 			return false;
 		if (attr1->attislocal != attr2->attislocal)
@@ -638,6 +675,7 @@ TupleDescInitEntry(TupleDesc desc,
 	att->attstattarget = -1;
 	att->attcacheoff = -1;
 	att->atttypmod = typmod;
+	desc->tdnfixed = -1;
 
 	att->attnum = attributeNumber;
 	att->attndims = attdim;
@@ -647,6 +685,7 @@ TupleDescInitEntry(TupleDesc desc,
 	att->atthasmissing = false;
 	att->attidentity = '\0';
 	att->attgenerated = '\0';
+	att->attcompression = '\0';
 	att->attisdropped = false;
 	att->attislocal = true;
 	att->attinhcount = 0;
@@ -698,6 +737,7 @@ TupleDescInitBuiltinEntry(TupleDesc desc,
 	att->attstattarget = -1;
 	att->attcacheoff = -1;
 	att->atttypmod = typmod;
+	desc->tdnfixed = -1;
 
 	att->attnum = attributeNumber;
 	att->attndims = attdim;
@@ -707,6 +747,7 @@ TupleDescInitBuiltinEntry(TupleDesc desc,
 	att->atthasmissing = false;
 	att->attidentity = '\0';
 	att->attgenerated = '\0';
+	att->attcompression = '\0';
 	att->attisdropped = false;
 	att->attislocal = true;
 	att->attinhcount = 0;
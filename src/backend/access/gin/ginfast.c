@@ -40,6 +40,12 @@ int			gin_pending_list_limit = 0;
 #define GIN_PAGE_FREESIZE \
 	( BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXALIGN(sizeof(GinPageOpaqueData)) )
 
+/*
+ * Once the pending list is this many times larger than the cleanup size,
+ * inserters clean it up themselves even if autovacuum was asked to.
+ */
+#define GIN_PENDING_LIST_FORCE_FACTOR	4
+
 typedef struct KeyArray
 {
 	Datum	   *keys;			/* expansible array */
@@ -48,6 +54,8 @@ typedef struct KeyArray
 	int32		maxvalues;		/* allocated size of arrays */
 } KeyArray;
 
+static bool ginRequestPendingListCleanup(Relation index, Relation heapRel);
+
 
 /*
  * Build a pending-list page from the given array of tuples, and write it out.
@@ -213,9 +221,13 @@ makeSublist(Relation index, IndexTuple *tuples, int32 ntuples,
  *
  * Function guarantees that all these tuples will be inserted consecutively,
  * preserving order
+ *
+ * heapRel is the table the index belongs to; it's only used to decide
+ * whether autovacuum can be asked to clean up the pending list.
  */
 void
-ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
+ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector,
+					   Relation heapRel)
 {
 	Relation	index = ginstate->index;
 	Buffer		metabuffer;
@@ -226,6 +238,7 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	ginxlogUpdateMeta data;
 	bool		separateList = false;
 	bool		needCleanup = false;
+	bool		forceCleanup = false;
 	int			cleanupSize;
 	bool		needWal;
 
@@ -448,17 +461,61 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	cleanupSize = GinGetPendingListCleanupSize(index);
 	if (metadata->nPendingPages * GIN_PAGE_FREESIZE > cleanupSize * 1024L)
 		needCleanup = true;
+	if (metadata->nPendingPages * GIN_PAGE_FREESIZE >
+		GIN_PENDING_LIST_FORCE_FACTOR * cleanupSize * 1024L)
+		forceCleanup = true;
 
 	UnlockReleaseBuffer(metabuffer);
 
 	END_CRIT_SECTION();
 
+	if (!needCleanup)
+		return;
+
+	/*
+	 * The cleanup would be charged to whichever insertion happened to cross
+	 * the limit, so hand it over to autovacuum if we can.  If the list has
+	 * grown far beyond the limit anyway, autovacuum isn't keeping up and we
+	 * had better do the work ourselves.
+	 */
+	if (!forceCleanup && ginRequestPendingListCleanup(index, heapRel))
+		return;
+
 	/*
 	 * Since it could contend with concurrent cleanup process we cleanup
 	 * pending list not forcibly.
 	 */
-	if (needCleanup)
-		ginInsertCleanup(ginstate, false, true, false, NULL);
+	ginInsertCleanup(ginstate, false, true, false, NULL);
+}
+
+/*
+ * Ask autovacuum to clean up the pending list of the index, which it does
+ * with gin_clean_pending_list() and thus with maintenance_work_mem (or
+ * autovacuum_work_mem) rather than work_mem, so that it can also move the
+ * entries to the main structure in fewer, larger sorted batches.
+ *
+ * That's only possible if autovacuum is running and enabled for the table,
+ * and not for temporary tables, which autovacuum can't access.  Returns
+ * whether the request was recorded.
+ */
+static bool
+ginRequestPendingListCleanup(Relation index, Relation heapRel)
+{
+	StdRdOptions *options;
+
+	if (!AutoVacuumingActive() || IsAutoVacuumWorkerProcess())
+		return false;
+
+	if (heapRel == NULL || RelationUsesLocalBuffers(index))
+		return false;
+
+	options = (StdRdOptions *) heapRel->rd_options;
+	if (options != NULL && !options->autovacuum.enabled)
+		return false;
+
+	return AutoVacuumRequestWork(AVW_GINCleanPendingList,
+								 RelationGetRelid(index),
+								 InvalidBlockNumber);
 }
 
 /*
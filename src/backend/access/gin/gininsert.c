@@ -16,18 +16,126 @@
 
 #include "access/gin_private.h"
 #include "access/ginxlog.h"
+#include "access/parallel.h"
+#include "access/table.h"
+#include "access/xact.h"
 #include "access/xloginsert.h"
 #include "access/tableam.h"
 #include "catalog/index.h"
+#include "lib/binaryheap.h"
 #include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/buffile.h"
 #include "storage/bufmgr.h"
+#include "storage/condition_variable.h"
+#include "storage/sharedfileset.h"
 #include "storage/smgr.h"
 #include "storage/indexfsm.h"
 #include "storage/predicate.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/datum.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
 
 
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_KEY_GIN_SHARED			UINT64CONST(0xB000000000000001)
+#define PARALLEL_KEY_QUERY_TEXT			UINT64CONST(0xB000000000000002)
+
+/*
+ * Status for index builds performed in parallel.  This is allocated in a
+ * dynamic shared memory segment.
+ *
+ * Each participant scans a part of the heap into its own BuildAccumulator.
+ * Whenever that fills up, and at the end of the scan, the accumulated
+ * entries are written in key order to a "run", a temporary file in the
+ * shared fileset.  When all participants are done, the leader merges the
+ * runs and inserts the entries into the index.
+ */
+typedef struct GinShared
+{
+	/*
+	 * These fields are not modified during the build.  They primarily exist
+	 * for the benefit of worker processes that need to open the relations.
+	 */
+	Oid			heaprelid;
+	Oid			indexrelid;
+	bool		isconcurrent;
+	int			scantuplesortstates;
+
+	/* Temporary files holding the runs */
+	SharedFileSet fileset;
+
+	/*
+	 * workersdonecv is used to monitor the progress of workers.  All parallel
+	 * participants must indicate that they are done before leader can use
+	 * mutable state that workers maintain during scan (and before leader can
+	 * start merging the runs).
+	 */
+	ConditionVariable workersdonecv;
+
+	/*
+	 * mutex protects all fields before heapdesc.
+	 */
+	slock_t		mutex;
+
+	/*
+	 * Mutable state that is maintained by workers, and reported back to
+	 * leader at end of parallel scan.
+	 *
+	 * nparticipantsdone is number of worker processes finished.
+	 *
+	 * reltuples is the total number of input heap tuples.
+	 *
+	 * indtuples is the total number of entries extracted from them.
+	 *
+	 * nruns is the number of runs written so far; runs are numbered from 0.
+	 */
+	int			nparticipantsdone;
+	double		reltuples;
+	double		indtuples;
+	int			nruns;
+
+	/*
+	 * ParallelTableScanDescData data follows. Can't directly embed here, as
+	 * implementations of the parallel table scan desc interface might need
+	 * stronger alignment.
+	 */
+} GinShared;
+
+/*
+ * Return pointer to a GinShared's parallel table scan.
+ *
+ * c.f. shm_toc_allocate as to why BUFFERALIGN is used, rather than just
+ * MAXALIGN.
+ */
+#define ParallelTableScanFromGinShared(shared) \
+	(ParallelTableScanDesc) ((char *) (shared) + BUFFERALIGN(sizeof(GinShared)))
+
+/*
+ * Status for leader in parallel index build.
+ */
+typedef struct GinLeader
+{
+	/* parallel context itself */
+	ParallelContext *pcxt;
+
+	/*
+	 * nparticipants is the exact number of worker processes successfully
+	 * launched, plus one leader process if it participates as a worker.
+	 */
+	int			nparticipants;
+
+	/*
+	 * ginshared is the shared state for entire build.  snapshot is the
+	 * snapshot used by the scan iff an MVCC snapshot is required.
+	 */
+	GinShared  *ginshared;
+	Snapshot	snapshot;
+} GinLeader;
+
 typedef struct
 {
 	GinState	ginstate;
@@ -36,8 +144,62 @@ typedef struct
 	MemoryContext tmpCtx;
 	MemoryContext funcCtx;
 	BuildAccumulator accum;
+
+	/* memory the accumulator may use before it is dumped, in kilobytes */
+	int			work_mem;
+
+	/*
+	 * In a parallel build, ginshared is set in each participant, which then
+	 * dumps the accumulator into runs rather than into the index.  ginleader
+	 * is set only in the leader's own build state.
+	 */
+	GinShared  *ginshared;
+	GinLeader  *ginleader;
 } GinBuildState;
 
+/*
+ * Header of an entry in a run.  It is followed by keylen bytes of key data
+ * and nitems item pointers, in increasing order.
+ */
+typedef struct GinRunEntryHeader
+{
+	OffsetNumber attnum;
+	GinNullCategory category;
+	uint32		keylen;
+	uint32		nitems;
+} GinRunEntryHeader;
+
+/* A run being read back by the leader during the merge */
+typedef struct GinRunReader
+{
+	BufFile    *file;
+
+	/* the current entry; key and items point into the buffers below */
+	OffsetNumber attnum;
+	GinNullCategory category;
+	Datum		key;
+	ItemPointerData *items;
+	uint32		nitems;
+
+	char	   *keybuf;
+	uint32		keybufsize;
+	uint32		itemsbufsize;
+} GinRunReader;
+
+static void ginDumpBuildState(GinBuildState *buildstate);
+static void _gin_begin_parallel(GinBuildState *buildstate, Relation heap,
+								Relation index, bool isconcurrent,
+								int request);
+static void _gin_end_parallel(GinLeader *ginleader);
+static Size _gin_parallel_estimate_shared(Relation heap, Snapshot snapshot);
+static double _gin_parallel_heapscan(GinBuildState *buildstate);
+static void _gin_leader_participate_as_worker(GinBuildState *buildstate,
+											  Relation heap, Relation index);
+static void _gin_parallel_scan_and_build(Relation heap, Relation index,
+										 GinShared *ginshared, int workmem,
+										 bool progress);
+static void _gin_parallel_merge(GinBuildState *buildstate);
+
 
 /*
  * Adds array of item pointers to tuple's posting list, or
@@ -287,30 +449,114 @@ ginBuildCallback(Relation index, HeapTuple htup, Datum *values,
 							   values[i], isnull[i],
 							   &htup->t_self);
 
-	/* If we've maxed out our available memory, dump everything to the index */
-	if (buildstate->accum.allocatedMemory >= (Size) maintenance_work_mem * 1024L)
+	/*
+	 * If we've maxed out our available memory, dump everything to the index
+	 * (or to a run, in a parallel build)
+	 */
+	if (buildstate->accum.allocatedMemory >= (Size) buildstate->work_mem * 1024L)
 	{
-		ItemPointerData *list;
-		Datum		key;
-		GinNullCategory category;
-		uint32		nlist;
-		OffsetNumber attnum;
+		ginDumpBuildState(buildstate);
+		MemoryContextReset(buildstate->tmpCtx);
+		ginInitBA(&buildstate->accum);
+	}
+
+	MemoryContextSwitchTo(oldCtx);
+}
+
+/*
+ * Write data to a run file, erroring out on failure.
+ */
+static void
+ginRunWrite(BufFile *file, void *ptr, size_t size)
+{
+	if (BufFileWrite(file, ptr, size) != size)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not write to temporary file: %m")));
+}
 
-		ginBeginBAScan(&buildstate->accum);
-		while ((list = ginGetBAEntry(&buildstate->accum,
-									 &attnum, &key, &category, &nlist)) != NULL)
+/*
+ * Construct the name of run number runno; name must be MAXPGPATH bytes.
+ */
+static void
+ginRunName(char *name, int runno)
+{
+	snprintf(name, MAXPGPATH, "gin.%d", runno);
+}
+
+/*
+ * Dump the contents of the build accumulator, in key order.
+ *
+ * In a serial build, or in the leader, the entries go straight into the
+ * index.  In a parallel participant, they are written to a new run.
+ */
+static void
+ginDumpBuildState(GinBuildState *buildstate)
+{
+	GinShared  *ginshared = buildstate->ginshared;
+	TupleDesc	tupdesc = buildstate->ginstate.origTupdesc;
+	BufFile    *file = NULL;
+	ItemPointerData *list;
+	Datum		key;
+	GinNullCategory category;
+	uint32		nlist;
+	OffsetNumber attnum;
+
+	ginBeginBAScan(&buildstate->accum);
+	while ((list = ginGetBAEntry(&buildstate->accum,
+								 &attnum, &key, &category, &nlist)) != NULL)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+		GinRunEntryHeader hdr;
+
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		if (ginshared == NULL)
 		{
-			/* there could be many entries, so be willing to abort here */
-			CHECK_FOR_INTERRUPTS();
 			ginEntryInsert(&buildstate->ginstate, attnum, key, category,
 						   list, nlist, &buildstate->buildStats);
+			continue;
 		}
 
-		MemoryContextReset(buildstate->tmpCtx);
-		ginInitBA(&buildstate->accum);
+		/* Start a new run with the first entry */
+		if (file == NULL)
+		{
+			char		name[MAXPGPATH];
+			int			runno;
+
+			SpinLockAcquire(&ginshared->mutex);
+			runno = ginshared->nruns++;
+			SpinLockRelease(&ginshared->mutex);
+
+			ginRunName(name, runno);
+			file = BufFileCreateShared(&ginshared->fileset, name);
+		}
+
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.attnum = attnum;
+		hdr.category = category;
+		if (category != GIN_CAT_NORM_KEY)
+			hdr.keylen = 0;
+		else if (attr->attbyval)
+			hdr.keylen = sizeof(Datum);
+		else
+			hdr.keylen = datumGetSize(key, false, attr->attlen);
+		hdr.nitems = nlist;
+
+		ginRunWrite(file, &hdr, sizeof(hdr));
+		if (hdr.keylen > 0)
+			ginRunWrite(file,
+						attr->attbyval ? (void *) &key : DatumGetPointer(key),
+						hdr.keylen);
+		ginRunWrite(file, list, sizeof(ItemPointerData) * nlist);
 	}
 
-	MemoryContextSwitchTo(oldCtx);
+	if (file != NULL)
+	{
+		BufFileExportShared(file);
+		BufFileClose(file);
+	}
 }
 
 IndexBuildResult *
@@ -321,12 +567,7 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	GinBuildState buildstate;
 	Buffer		RootBuffer,
 				MetaBuffer;
-	ItemPointerData *list;
-	Datum		key;
-	GinNullCategory category;
-	uint32		nlist;
 	MemoryContext oldCtx;
-	OffsetNumber attnum;
 
 	if (RelationGetNumberOfBlocks(index) != 0)
 		elog(ERROR, "index \"%s\" already contains data",
@@ -335,6 +576,9 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	initGinState(&buildstate.ginstate, index);
 	buildstate.indtuples = 0;
 	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.work_mem = maintenance_work_mem;
+	buildstate.ginshared = NULL;
+	buildstate.ginleader = NULL;
 
 	/* initialize the meta page */
 	MetaBuffer = GinNewBuffer(index);
@@ -375,26 +619,33 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	buildstate.accum.ginstate = &buildstate.ginstate;
 	ginInitBA(&buildstate.accum);
 
-	/*
-	 * Do the heap scan.  We disallow sync scan here because dataPlaceToPage
-	 * prefers to receive tuples in TID order.
-	 */
-	reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
-									   ginBuildCallback, (void *) &buildstate,
-									   NULL);
+	/* Attempt to launch parallel worker scan when required */
+	if (indexInfo->ii_ParallelWorkers > 0)
+		_gin_begin_parallel(&buildstate, heap, index, indexInfo->ii_Concurrent,
+							indexInfo->ii_ParallelWorkers);
 
-	/* dump remaining entries to the index */
-	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
-	ginBeginBAScan(&buildstate.accum);
-	while ((list = ginGetBAEntry(&buildstate.accum,
-								 &attnum, &key, &category, &nlist)) != NULL)
+	if (buildstate.ginleader)
 	{
-		/* there could be many entries, so be willing to abort here */
-		CHECK_FOR_INTERRUPTS();
-		ginEntryInsert(&buildstate.ginstate, attnum, key, category,
-					   list, nlist, &buildstate.buildStats);
+		/* Wait for the scan to finish, then merge the runs into the index */
+		reltuples = _gin_parallel_heapscan(&buildstate);
+		_gin_parallel_merge(&buildstate);
+		_gin_end_parallel(buildstate.ginleader);
+	}
+	else
+	{
+		/*
+		 * Do the heap scan.  We disallow sync scan here because
+		 * dataPlaceToPage prefers to receive tuples in TID order.
+		 */
+		reltuples = table_index_build_scan(heap, index, indexInfo, false, true,
+										   ginBuildCallback,
+										   (void *) &buildstate, NULL);
+
+		/* dump remaining entries to the index */
+		oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+		ginDumpBuildState(&buildstate);
+		MemoryContextSwitchTo(oldCtx);
 	}
-	MemoryContextSwitchTo(oldCtx);
 
 	MemoryContextDelete(buildstate.funcCtx);
 	MemoryContextDelete(buildstate.tmpCtx);
@@ -427,6 +678,539 @@ ginbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	return result;
 }
 
+/*
+ * Create parallel context, and launch workers for leader.
+ *
+ * isconcurrent indicates if operation is CREATE INDEX CONCURRENTLY.
+ *
+ * request is the target number of parallel worker processes to launch.
+ *
+ * Sets buildstate's GinLeader, which caller must use to shut down parallel
+ * mode by passing it to _gin_end_parallel() at the very end of its index
+ * build.  If not even a single worker process can be launched, this is
+ * never set, and caller should proceed with a serial index build.
+ */
+static void
+_gin_begin_parallel(GinBuildState *buildstate, Relation heap, Relation index,
+					bool isconcurrent, int request)
+{
+	ParallelContext *pcxt;
+	int			scantuplesortstates;
+	Snapshot	snapshot;
+	Size		estginshared;
+	GinShared  *ginshared;
+	GinLeader  *ginleader = (GinLeader *) palloc0(sizeof(GinLeader));
+	bool		leaderparticipates = true;
+	char	   *sharedquery;
+	int			querylen;
+
+#ifdef DISABLE_LEADER_PARTICIPATION
+	leaderparticipates = false;
+#endif
+
+	/*
+	 * Enter parallel mode, and create context for parallel build of gin
+	 * index
+	 */
+	EnterParallelMode();
+	Assert(request > 0);
+	pcxt = CreateParallelContext("postgres", "_gin_parallel_build_main",
+								 request);
+	scantuplesortstates = leaderparticipates ? request + 1 : request;
+
+	/*
+	 * Prepare for scan of the base relation.  In a normal index build, we use
+	 * SnapshotAny because we must retrieve all tuples and do our own time
+	 * qual checks (because we have to index RECENTLY_DEAD tuples).  In a
+	 * concurrent build, we take a regular MVCC snapshot and index whatever's
+	 * live according to that.
+	 */
+	if (!isconcurrent)
+		snapshot = SnapshotAny;
+	else
+		snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/* Estimate size for our own PARALLEL_KEY_GIN_SHARED workspace */
+	estginshared = _gin_parallel_estimate_shared(heap, snapshot);
+	shm_toc_estimate_chunk(&pcxt->estimator, estginshared);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_KEY_QUERY_TEXT space */
+	querylen = strlen(debug_query_string);
+	shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Everyone's had a chance to ask for space, so now create the DSM */
+	InitializeParallelDSM(pcxt);
+
+	/* Store shared build state, for which we reserved space */
+	ginshared = (GinShared *) shm_toc_allocate(pcxt->toc, estginshared);
+	/* Initialize immutable state */
+	ginshared->heaprelid = RelationGetRelid(heap);
+	ginshared->indexrelid = RelationGetRelid(index);
+	ginshared->isconcurrent = isconcurrent;
+	ginshared->scantuplesortstates = scantuplesortstates;
+	SharedFileSetInit(&ginshared->fileset, pcxt->seg);
+	ConditionVariableInit(&ginshared->workersdonecv);
+	SpinLockInit(&ginshared->mutex);
+	/* Initialize mutable state */
+	ginshared->nparticipantsdone = 0;
+	ginshared->reltuples = 0.0;
+	ginshared->indtuples = 0.0;
+	ginshared->nruns = 0;
+	table_parallelscan_initialize(heap,
+								  ParallelTableScanFromGinShared(ginshared),
+								  snapshot);
+
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_GIN_SHARED, ginshared);
+
+	/* Store query string for workers */
+	sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+	memcpy(sharedquery, debug_query_string, querylen + 1);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_QUERY_TEXT, sharedquery);
+
+	/* Launch workers, saving status for leader/caller */
+	LaunchParallelWorkers(pcxt);
+	ginleader->pcxt = pcxt;
+	ginleader->nparticipants = pcxt->nworkers_launched;
+	if (leaderparticipates)
+		ginleader->nparticipants++;
+	ginleader->ginshared = ginshared;
+	ginleader->snapshot = snapshot;
+
+	/* If no workers were successfully launched, back out (do serial build) */
+	if (pcxt->nworkers_launched == 0)
+	{
+		_gin_end_parallel(ginleader);
+		return;
+	}
+
+	/* Save leader state now that it's clear build will be parallel */
+	buildstate->ginleader = ginleader;
+
+	/* Join heap scan ourselves */
+	if (leaderparticipates)
+		_gin_leader_participate_as_worker(buildstate, heap, index);
+
+	/*
+	 * Caller needs to wait for all launched workers when we return.  Make
+	 * sure that the failure-to-start case will not hang forever.
+	 */
+	WaitForParallelWorkersToAttach(pcxt);
+}
+
+/*
+ * Shut down workers, destroy parallel context, and end parallel mode.
+ *
+ * This also removes the runs, when the leader detaches from the shared
+ * fileset.
+ */
+static void
+_gin_end_parallel(GinLeader *ginleader)
+{
+	/* Shutdown worker processes */
+	WaitForParallelWorkersToFinish(ginleader->pcxt);
+	/* Free last reference to MVCC snapshot, if one was used */
+	if (IsMVCCSnapshot(ginleader->snapshot))
+		UnregisterSnapshot(ginleader->snapshot);
+	DestroyParallelContext(ginleader->pcxt);
+	ExitParallelMode();
+}
+
+/*
+ * Returns size of shared memory required to store state for a parallel
+ * gin index build based on the snapshot its parallel scan will use.
+ */
+static Size
+_gin_parallel_estimate_shared(Relation heap, Snapshot snapshot)
+{
+	/* c.f. shm_toc_allocate as to why BUFFERALIGN is used */
+	return add_size(BUFFERALIGN(sizeof(GinShared)),
+					table_parallelscan_estimate(heap, snapshot));
+}
+
+/*
+ * Within leader, wait for end of heap scan.
+ *
+ * When called, parallel heap scan started by _gin_begin_parallel() will
+ * already be underway within worker processes (when leader participates
+ * as a worker, we should end up here just as workers are finishing).
+ *
+ * Fills in fields needed for ambuild statistics, and returns the total
+ * number of heap tuples scanned.
+ */
+static double
+_gin_parallel_heapscan(GinBuildState *buildstate)
+{
+	GinShared  *ginshared = buildstate->ginleader->ginshared;
+	int			nparticipants;
+	double		reltuples;
+
+	nparticipants = buildstate->ginleader->nparticipants;
+	for (;;)
+	{
+		SpinLockAcquire(&ginshared->mutex);
+		if (ginshared->nparticipantsdone == nparticipants)
+		{
+			buildstate->indtuples = ginshared->indtuples;
+			reltuples = ginshared->reltuples;
+			SpinLockRelease(&ginshared->mutex);
+			break;
+		}
+		SpinLockRelease(&ginshared->mutex);
+
+		ConditionVariableSleep(&ginshared->workersdonecv,
+							   WAIT_EVENT_PARALLEL_CREATE_INDEX_SCAN);
+	}
+
+	ConditionVariableCancelSleep();
+
+	return reltuples;
+}
+
+/*
+ * Within leader, participate as a parallel worker.
+ */
+static void
+_gin_leader_participate_as_worker(GinBuildState *buildstate, Relation heap,
+								  Relation index)
+{
+	GinLeader  *ginleader = buildstate->ginleader;
+	int			workmem;
+
+	/*
+	 * Might as well use reliable figure when doling out maintenance_work_mem
+	 * (when requested number of workers were not launched, this will be
+	 * somewhat higher than it is for other workers).
+	 */
+	workmem = maintenance_work_mem / ginleader->nparticipants;
+
+	/* Perform work common to all participants */
+	_gin_parallel_scan_and_build(heap, index, ginleader->ginshared, workmem,
+								 true);
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+_gin_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	char	   *sharedquery;
+	GinShared  *ginshared;
+	Relation	heapRel;
+	Relation	indexRel;
+	LOCKMODE	heapLockmode;
+	LOCKMODE	indexLockmode;
+	int			workmem;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_KEY_QUERY_TEXT, false);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	/* Look up gin shared state */
+	ginshared = shm_toc_lookup(toc, PARALLEL_KEY_GIN_SHARED, false);
+
+	/* Open relations using lock modes known to be obtained by index.c */
+	if (!ginshared->isconcurrent)
+	{
+		heapLockmode = ShareLock;
+		indexLockmode = AccessExclusiveLock;
+	}
+	else
+	{
+		heapLockmode = ShareUpdateExclusiveLock;
+		indexLockmode = RowExclusiveLock;
+	}
+
+	/* Open relations within worker */
+	heapRel = table_open(ginshared->heaprelid, heapLockmode);
+	indexRel = index_open(ginshared->indexrelid, indexLockmode);
+
+	/* Attach to the fileset that holds the runs */
+	SharedFileSetAttach(&ginshared->fileset, seg);
+
+	/* Perform our part of the scan */
+	workmem = maintenance_work_mem / ginshared->scantuplesortstates;
+	_gin_parallel_scan_and_build(heapRel, indexRel, ginshared, workmem, false);
+
+	index_close(indexRel, indexLockmode);
+	table_close(heapRel, heapLockmode);
+}
+
+/*
+ * Perform a participant's portion of a parallel build: scan a part of the
+ * heap, and write the extracted entries to runs.
+ *
+ * workmem is the amount of memory the accumulator may use before it is
+ * written out as a run, expressed in KBs.
+ */
+static void
+_gin_parallel_scan_and_build(Relation heap, Relation index,
+							 GinShared *ginshared, int workmem, bool progress)
+{
+	GinBuildState buildstate;
+	TableScanDesc scan;
+	double		reltuples;
+	IndexInfo  *indexInfo;
+	MemoryContext oldCtx;
+
+	/* Fill in buildstate for ginBuildCallback() */
+	initGinState(&buildstate.ginstate, index);
+	buildstate.indtuples = 0;
+	memset(&buildstate.buildStats, 0, sizeof(GinStatsData));
+	buildstate.work_mem = workmem;
+	buildstate.ginshared = ginshared;
+	buildstate.ginleader = NULL;
+
+	buildstate.tmpCtx = AllocSetContextCreate(CurrentMemoryContext,
+											  "Gin build temporary context",
+											  ALLOCSET_DEFAULT_SIZES);
+	buildstate.funcCtx = AllocSetContextCreate(CurrentMemoryContext,
+											   "Gin build temporary context for user-defined function",
+											   ALLOCSET_DEFAULT_SIZES);
+
+	buildstate.accum.ginstate = &buildstate.ginstate;
+	ginInitBA(&buildstate.accum);
+
+	/* Join parallel scan */
+	indexInfo = BuildIndexInfo(index);
+	indexInfo->ii_Concurrent = ginshared->isconcurrent;
+	scan = table_beginscan_parallel(heap,
+									ParallelTableScanFromGinShared(ginshared));
+	reltuples = table_index_build_scan(heap, index, indexInfo, true, progress,
+									   ginBuildCallback,
+									   (void *) &buildstate, scan);
+
+	/* Write out the remaining entries as a last run */
+	oldCtx = MemoryContextSwitchTo(buildstate.tmpCtx);
+	ginDumpBuildState(&buildstate);
+	MemoryContextSwitchTo(oldCtx);
+
+	MemoryContextDelete(buildstate.funcCtx);
+	MemoryContextDelete(buildstate.tmpCtx);
+
+	/* Done.  Record ambuild statistics. */
+	SpinLockAcquire(&ginshared->mutex);
+	ginshared->nparticipantsdone++;
+	ginshared->reltuples += reltuples;
+	ginshared->indtuples += buildstate.indtuples;
+	SpinLockRelease(&ginshared->mutex);
+
+	/* Notify leader */
+	ConditionVariableSignal(&ginshared->workersdonecv);
+}
+
+/*
+ * Read data from a run file, erroring out on a short read.
+ */
+static void
+ginRunRead(BufFile *file, void *ptr, size_t size)
+{
+	if (BufFileRead(file, ptr, size) != size)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from GIN build temporary file: %m")));
+}
+
+/*
+ * Advance a run to its next entry.  Returns false at the end of the run.
+ */
+static bool
+ginRunReadEntry(GinBuildState *buildstate, GinRunReader *run)
+{
+	GinRunEntryHeader hdr;
+	size_t		nread;
+
+	nread = BufFileRead(run->file, &hdr, sizeof(hdr));
+	if (nread == 0)
+		return false;
+	if (nread != sizeof(hdr))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from GIN build temporary file: %m")));
+
+	run->attnum = hdr.attnum;
+	run->category = hdr.category;
+	run->nitems = hdr.nitems;
+
+	if (hdr.keylen == 0)
+		run->key = (Datum) 0;
+	else if (TupleDescAttr(buildstate->ginstate.origTupdesc,
+						   hdr.attnum - 1)->attbyval)
+	{
+		Assert(hdr.keylen == sizeof(Datum));
+		ginRunRead(run->file, &run->key, sizeof(Datum));
+	}
+	else
+	{
+		if (hdr.keylen > run->keybufsize)
+		{
+			run->keybufsize = Max(hdr.keylen, 2 * run->keybufsize);
+			run->keybuf = repalloc(run->keybuf, run->keybufsize);
+		}
+		ginRunRead(run->file, run->keybuf, hdr.keylen);
+		run->key = PointerGetDatum(run->keybuf);
+	}
+
+	if (hdr.nitems > run->itemsbufsize)
+	{
+		run->itemsbufsize = Max(hdr.nitems, 2 * run->itemsbufsize);
+		run->items = repalloc_huge(run->items,
+								   sizeof(ItemPointerData) * run->itemsbufsize);
+	}
+	ginRunRead(run->file, run->items, sizeof(ItemPointerData) * hdr.nitems);
+
+	return true;
+}
+
+/*
+ * binaryheap comparator for runs.  The heap keeps the largest element on
+ * top, so invert the order to get the run with the smallest key first.
+ */
+static int
+ginRunCompare(Datum a, Datum b, void *arg)
+{
+	GinBuildState *buildstate = (GinBuildState *) arg;
+	GinRunReader *runa = (GinRunReader *) DatumGetPointer(a);
+	GinRunReader *runb = (GinRunReader *) DatumGetPointer(b);
+
+	return -ginCompareAttEntries(&buildstate->ginstate,
+								 runa->attnum, runa->key, runa->category,
+								 runb->attnum, runb->key, runb->category);
+}
+
+/*
+ * Within leader, merge the runs written by all participants and insert
+ * their entries into the index.
+ *
+ * Each key is inserted once, with the item pointers of all runs merged into
+ * a single list, except that the list is inserted in parts if it would
+ * exceed maintenance_work_mem.  Keys are inserted in key order, the same as
+ * a serial build does for the contents of one accumulator.
+ */
+static void
+_gin_parallel_merge(GinBuildState *buildstate)
+{
+	GinShared  *ginshared = buildstate->ginleader->ginshared;
+	int			nruns = ginshared->nruns;
+	GinRunReader *runs;
+	binaryheap *heap;
+	Size		maxitems;
+	MemoryContext oldCtx;
+	int			i;
+
+	maxitems = Min((Size) maintenance_work_mem * 1024L, MaxAllocSize) /
+		sizeof(ItemPointerData);
+
+	runs = (GinRunReader *) palloc0(sizeof(GinRunReader) * Max(nruns, 1));
+	heap = binaryheap_allocate(Max(nruns, 1), ginRunCompare, buildstate);
+
+	for (i = 0; i < nruns; i++)
+	{
+		GinRunReader *run = &runs[i];
+		char		name[MAXPGPATH];
+
+		ginRunName(name, i);
+		run->file = BufFileOpenShared(&ginshared->fileset, name);
+		run->keybufsize = 64;
+		run->keybuf = palloc(run->keybufsize);
+		run->itemsbufsize = 64;
+		run->items = palloc(sizeof(ItemPointerData) * run->itemsbufsize);
+
+		if (ginRunReadEntry(buildstate, run))
+			binaryheap_add_unordered(heap, PointerGetDatum(run));
+	}
+	binaryheap_build(heap);
+
+	while (!binaryheap_empty(heap))
+	{
+		GinRunReader *run;
+		OffsetNumber attnum;
+		GinNullCategory category;
+		Datum		key;
+		ItemPointerData *list = NULL;
+		uint32		nlist = 0;
+
+		/* there could be many entries, so be willing to abort here */
+		CHECK_FOR_INTERRUPTS();
+
+		MemoryContextReset(buildstate->tmpCtx);
+		oldCtx = MemoryContextSwitchTo(buildstate->tmpCtx);
+
+		/* Copy the smallest key, to outlive advancing the run it came from */
+		run = (GinRunReader *) DatumGetPointer(binaryheap_first(heap));
+		attnum = run->attnum;
+		category = run->category;
+		if (category == GIN_CAT_NORM_KEY)
+		{
+			Form_pg_attribute attr;
+
+			attr = TupleDescAttr(buildstate->ginstate.origTupdesc, attnum - 1);
+			key = datumCopy(run->key, attr->attbyval, attr->attlen);
+		}
+		else
+			key = (Datum) 0;
+
+		/* Collect the item pointers of every run positioned on this key */
+		do
+		{
+			if (nlist > 0 && nlist + run->nitems > maxitems)
+			{
+				ginEntryInsert(&buildstate->ginstate, attnum, key, category,
+							   list, nlist, &buildstate->buildStats);
+				pfree(list);
+				nlist = 0;
+			}
+
+			if (nlist == 0)
+			{
+				list = palloc_extended(sizeof(ItemPointerData) * run->nitems,
+									   MCXT_ALLOC_HUGE);
+				memcpy(list, run->items, sizeof(ItemPointerData) * run->nitems);
+				nlist = run->nitems;
+			}
+			else
+			{
+				ItemPointerData *merged;
+				int			nmerged;
+
+				merged = ginMergeItemPointers(list, nlist,
+											  run->items, run->nitems,
+											  &nmerged);
+				pfree(list);
+				list = merged;
+				nlist = nmerged;
+			}
+
+			if (ginRunReadEntry(buildstate, run))
+				binaryheap_replace_first(heap, PointerGetDatum(run));
+			else
+				(void) binaryheap_remove_first(heap);
+
+			if (binaryheap_empty(heap))
+				break;
+			run = (GinRunReader *) DatumGetPointer(binaryheap_first(heap));
+		} while (ginCompareAttEntries(&buildstate->ginstate,
+									  run->attnum, run->key, run->category,
+									  attnum, key, category) == 0);
+
+		ginEntryInsert(&buildstate->ginstate, attnum, key, category,
+					   list, nlist, &buildstate->buildStats);
+
+		MemoryContextSwitchTo(oldCtx);
+	}
+
+	for (i = 0; i < nruns; i++)
+		BufFileClose(runs[i].file);
+	binaryheap_free(heap);
+	pfree(runs);
+	MemoryContextReset(buildstate->tmpCtx);
+}
+
 /*
  *	ginbuildempty() -- build an empty gin index in the initialization fork
  */
@@ -520,7 +1304,7 @@ gininsert(Relation index, Datum *values, bool *isnull,
 									values[i], isnull[i],
 									ht_ctid);
 
-		ginHeapTupleFastInsert(ginstate, &collector);
+		ginHeapTupleFastInsert(ginstate, &collector, heapRel);
 	}
 	else
 	{
@@ -24,6 +24,7 @@
 #include "utils/builtins.h"
 #include "utils/float.h"
 #include "utils/geo_decls.h"
+#include "utils/sortsupport.h"
 
 
 static bool gist_box_leaf_consistent(BOX *key, BOX *query,
@@ -1530,3 +1531,157 @@ gist_poly_distance(PG_FUNCTION_ARGS)
 
 	PG_RETURN_FLOAT8(distance);
 }
+
+
+/*
+ * Z-order routines for fast index build
+ */
+
+/*
+ * Convert a float4 to an unsigned integer that sorts in the same order.
+ *
+ * For positive numbers, flipping the sign bit makes them sort above all
+ * negative numbers.  For negative numbers, flipping all bits reverses the
+ * order of the magnitude bits, so that more negative numbers sort lower.
+ * Both zeroes map to the same value, and NaNs sort above everything else,
+ * like they do in the float comparison functions.
+ */
+static uint32
+ieee_float32_to_uint32(float f)
+{
+	union
+	{
+		float		f;
+		uint32		i;
+	}			u;
+
+	if (isnan(f))
+		return 0xFFFFFFFF;
+	if (f == 0)
+		return 0x80000000;
+
+	u.f = f;
+	if ((u.i & 0x80000000) != 0)
+		return ~u.i;
+	else
+		return u.i | 0x80000000;
+}
+
+/* Interleave 32 bits with zeroes */
+static uint64
+part_bits32_by2(uint32 x)
+{
+	uint64		n = x;
+
+	n = (n | (n << 16)) & UINT64CONST(0x0000FFFF0000FFFF);
+	n = (n | (n << 8)) & UINT64CONST(0x00FF00FF00FF00FF);
+	n = (n | (n << 4)) & UINT64CONST(0x0F0F0F0F0F0F0F0F);
+	n = (n | (n << 2)) & UINT64CONST(0x3333333333333333);
+	n = (n | (n << 1)) & UINT64CONST(0x5555555555555555);
+
+	return n;
+}
+
+/*
+ * Compute the Z-order (Morton code) of a point.
+ *
+ * The coordinates are converted to float4 first, so that the interleaved
+ * bits of both fit into a uint64.  That loses some precision, but the
+ * result is only used to decide the order in which entries are packed into
+ * pages, so it doesn't affect correctness.
+ */
+static uint64
+point_zorder_internal(float8 x, float8 y)
+{
+	uint32		ix = ieee_float32_to_uint32((float) x);
+	uint32		iy = ieee_float32_to_uint32((float) y);
+
+	/* Interleave the bits */
+	return part_bits32_by2(ix) | (part_bits32_by2(iy) << 1);
+}
+
+/*
+ * Comparator for the boxes formed from points by gist_point_compress.  The
+ * low and high corners are the same, so we only look at the low one.
+ */
+static int
+gist_bbox_zorder_cmp(Datum a, Datum b, SortSupport ssup)
+{
+	Point	   *p1 = &(DatumGetBoxP(a)->low);
+	Point	   *p2 = &(DatumGetBoxP(b)->low);
+	uint64		z1;
+	uint64		z2;
+
+	/*
+	 * Do a quick check for equality first.  This is worth it especially
+	 * when used as the tie-breaker for abbreviated keys.
+	 */
+	if (p1->x == p2->x && p1->y == p2->y)
+		return 0;
+
+	z1 = point_zorder_internal(p1->x, p1->y);
+	z2 = point_zorder_internal(p2->x, p2->y);
+	if (z1 > z2)
+		return 1;
+	else if (z1 < z2)
+		return -1;
+	else
+		return 0;
+}
+
+static Datum
+gist_bbox_zorder_abbrev_convert(Datum original, SortSupport ssup)
+{
+	Point	   *p = &(DatumGetBoxP(original)->low);
+	uint64		z = point_zorder_internal(p->x, p->y);
+
+#if SIZEOF_DATUM == 8
+	return (Datum) z;
+#else
+	return (Datum) (z >> 32);
+#endif
+}
+
+/*
+ * We never consider aborting the abbreviation.
+ *
+ * On 64-bit systems, the abbreviation is not lossy so it is always
+ * worthwhile.  (Perhaps it's not on 32-bit systems, but we don't bother
+ * with logic to decide.)
+ */
+static bool
+gist_bbox_zorder_abbrev_abort(int memtupcount, SortSupport ssup)
+{
+	return false;
+}
+
+static void
+gist_bbox_zorder_sortsupport(SortSupport ssup)
+{
+	if (ssup->abbreviate)
+	{
+		ssup->comparator = ssup_datum_unsigned_cmp;
+		ssup->abbrev_converter = gist_bbox_zorder_abbrev_convert;
+		ssup->abbrev_abort = gist_bbox_zorder_abbrev_abort;
+		ssup->abbrev_full_comparator = gist_bbox_zorder_cmp;
+	}
+	else
+	{
+		ssup->comparator = gist_bbox_zorder_cmp;
+	}
+}
+
+/*
+ * Sort support routine for sorted GiST index build with point_ops.
+ *
+ * The comparator works on the stored keys, which are the boxes produced by
+ * gist_point_compress.
+ */
+Datum
+gist_point_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	gist_bbox_zorder_sortsupport(ssup);
+	PG_RETURN_VOID();
+}
@@ -29,6 +29,7 @@
 #include "optimizer/plancat.h"
 #include "pgstat.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/index_selfuncs.h"
 #include "utils/rel.h"
 #include "miscadmin.h"
@@ -40,6 +41,7 @@ typedef struct
 	HSpool	   *spool;			/* NULL if not using spooling */
 	double		indtuples;		/* # tuples accepted into index */
 	Relation	heapRel;		/* heap relation descriptor */
+	IndexInfo  *indexInfo;		/* info about the index being built */
 } HashBuildState;
 
 static void hashbuildCallback(Relation index,
@@ -64,8 +66,8 @@ hashhandler(PG_FUNCTION_ARGS)
 	amroutine->amcanorder = false;
 	amroutine->amcanorderbyop = false;
 	amroutine->amcanbackward = true;
-	amroutine->amcanunique = false;
-	amroutine->amcanmulticol = false;
+	amroutine->amcanunique = true;
+	amroutine->amcanmulticol = true;
 	amroutine->amoptionalkey = false;
 	amroutine->amsearcharray = false;
 	amroutine->amsearchnulls = false;
@@ -73,12 +75,15 @@ hashhandler(PG_FUNCTION_ARGS)
 	amroutine->amclusterable = false;
 	amroutine->ampredlocks = true;
 	amroutine->amcanparallel = false;
+	amroutine->amcanbuildparallel = false;
+	amroutine->amcanparallelvacuum = true;
 	amroutine->amcaninclude = false;
 	amroutine->amkeytype = INT4OID;
 
 	amroutine->ambuild = hashbuild;
 	amroutine->ambuildempty = hashbuildempty;
 	amroutine->aminsert = hashinsert;
+	amroutine->aminsertbatch = NULL;
 	amroutine->ambulkdelete = hashbulkdelete;
 	amroutine->amvacuumcleanup = hashvacuumcleanup;
 	amroutine->amcanreturn = NULL;
@@ -148,10 +153,10 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	 * metapage, nor the first bitmap page.
 	 */
 	sort_threshold = (maintenance_work_mem * 1024L) / BLCKSZ;
-	if (index->rd_rel->relpersistence != RELPERSISTENCE_TEMP)
+	if (!RelationUsesLocalBuffers(index))
 		sort_threshold = Min(sort_threshold, NBuffers);
 	else
-		sort_threshold = Min(sort_threshold, NLocBuffer);
+		sort_threshold = Min(sort_threshold, num_temp_buffers);
 
 	if (num_buckets >= (uint32) sort_threshold)
 		buildstate.spool = _h_spoolinit(heap, index, num_buckets);
@@ -161,6 +166,7 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	/* prepare to build the index */
 	buildstate.indtuples = 0;
 	buildstate.heapRel = heap;
+	buildstate.indexInfo = indexInfo;
 
 	/* do the heap scan */
 	reltuples = table_index_build_scan(heap, index, indexInfo, true, true,
@@ -172,7 +178,7 @@ hashbuild(Relation heap, Relation index, IndexInfo *indexInfo)
 	if (buildstate.spool)
 	{
 		/* sort the tuples and insert them into the index */
-		_h_indexbuild(buildstate.spool, buildstate.heapRel);
+		_h_indexbuild(buildstate.spool, buildstate.heapRel, indexInfo);
 		_h_spooldestroy(buildstate.spool);
 	}
 
@@ -208,9 +214,10 @@ hashbuildCallback(Relation index,
 				  void *state)
 {
 	HashBuildState *buildstate = (HashBuildState *) state;
-	Datum		index_values[1];
-	bool		index_isnull[1];
+	Datum		index_values[INDEX_MAX_KEYS];
+	bool		index_isnull[INDEX_MAX_KEYS];
 	IndexTuple	itup;
+	bool		unique = buildstate->indexInfo->ii_Unique;
 
 	/* convert data to a hash key; on failure, do not insert anything */
 	if (!_hash_convert_tuple(index,
@@ -218,8 +225,13 @@ hashbuildCallback(Relation index,
 							 index_values, index_isnull))
 		return;
 
-	/* Either spool the tuple for sorting, or just put it into the index */
-	if (buildstate->spool)
+	/*
+	 * Either spool the tuple for sorting, or just put it into the index.
+	 * Dead tuples can't conflict with anything, so they go into a unique
+	 * index unchecked; since the spool doesn't remember which tuples are
+	 * alive, they're inserted directly even when sorting.
+	 */
+	if (buildstate->spool && (tupleIsAlive || !unique))
 		_h_spool(buildstate->spool, &htup->t_self,
 				 index_values, index_isnull);
 	else
@@ -228,7 +240,9 @@ hashbuildCallback(Relation index,
 		itup = index_form_tuple(RelationGetDescr(index),
 								index_values, index_isnull);
 		itup->t_tid = htup->t_self;
-		_hash_doinsert(index, itup, buildstate->heapRel);
+		_hash_doinsert(index, itup, buildstate->heapRel,
+					   (unique && tupleIsAlive) ? UNIQUE_CHECK_YES : UNIQUE_CHECK_NO,
+					   buildstate->indexInfo, true);
 		pfree(itup);
 	}
 
@@ -240,6 +254,10 @@ hashbuildCallback(Relation index,
  *
  *	Hash on the heap tuple's key, form an index tuple with hash code.
  *	Find the appropriate location for the new tuple, and put it there.
+ *
+ *	For a unique index, the result follows the aminsert convention: false
+ *	means a duplicate might exist, and is only possible with
+ *	UNIQUE_CHECK_PARTIAL.
  */
 bool
 hashinsert(Relation rel, Datum *values, bool *isnull,
@@ -247,25 +265,30 @@ hashinsert(Relation rel, Datum *values, bool *isnull,
 		   IndexUniqueCheck checkUnique,
 		   IndexInfo *indexInfo)
 {
-	Datum		index_values[1];
-	bool		index_isnull[1];
+	Datum		index_values[INDEX_MAX_KEYS];
+	bool		index_isnull[INDEX_MAX_KEYS];
 	IndexTuple	itup;
+	bool		result;
 
-	/* convert data to a hash key; on failure, do not insert anything */
+	/*
+	 * convert data to a hash key; on failure, do not insert anything.  Such a
+	 * tuple has a null key column, so it can't violate uniqueness either.
+	 */
 	if (!_hash_convert_tuple(rel,
 							 values, isnull,
 							 index_values, index_isnull))
-		return false;
+		return true;
 
 	/* form an index tuple and point it at the heap tuple */
 	itup = index_form_tuple(RelationGetDescr(rel), index_values, index_isnull);
 	itup->t_tid = *ht_ctid;
 
-	_hash_doinsert(rel, itup, heapRel);
+	result = _hash_doinsert(rel, itup, heapRel, checkUnique, indexInfo,
+							false);
 
 	pfree(itup);
 
-	return false;
+	return result;
 }
 
 
@@ -378,6 +401,11 @@ hashbeginscan(Relation rel, int nkeys, int norderbys)
 	so->killedItems = NULL;
 	so->numKilled = 0;
 
+	if (nkeys > 0)
+		so->hashso_sk_hashes = (uint32 *) palloc(nkeys * sizeof(uint32));
+	else
+		so->hashso_sk_hashes = NULL;
+
 	scan->opaque = so;
 
 	return scan;
@@ -437,6 +465,8 @@ hashendscan(IndexScanDesc scan)
 
 	if (so->killedItems != NULL)
 		pfree(so->killedItems);
+	if (so->hashso_sk_hashes != NULL)
+		pfree(so->hashso_sk_hashes);
 	pfree(so);
 	scan->opaque = NULL;
 }
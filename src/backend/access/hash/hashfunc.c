@@ -386,3 +386,55 @@ hashvarlenaextended(PG_FUNCTION_ARGS)
 
 	return result;
 }
+
+/*
+ * In-memory variants of hashtext() and hashvarlena()
+ *
+ * These use hash_bytes_fast() instead of hash_any().  They are not in
+ * pg_proc; the executor substitutes them for the regular functions when
+ * building hash tables that never leave the backend, see
+ * execHashFunctionInfo().  Values must agree with each other, but not with
+ * the regular functions.
+ */
+Datum
+hashtext_inmemory(PG_FUNCTION_ARGS)
+{
+	Oid			collid = PG_GET_COLLATION();
+	text	   *key;
+	uint32		result;
+
+	if (!collid)
+		ereport(ERROR,
+				(errcode(ERRCODE_INDETERMINATE_COLLATION),
+				 errmsg("could not determine which collation to use for string hashing"),
+				 errhint("Use the COLLATE clause to set the collation explicitly.")));
+
+	/* Nondeterministic collations hash a sort key; leave that to hashtext */
+	if (!lc_collate_is_c(collid) && collid != DEFAULT_COLLATION_OID &&
+		!pg_newlocale_from_collation(collid)->deterministic)
+		return hashtext(fcinfo);
+
+	key = PG_GETARG_TEXT_PP(0);
+	result = hash_bytes_fast((unsigned char *) VARDATA_ANY(key),
+							 VARSIZE_ANY_EXHDR(key));
+
+	/* Avoid leaking memory for toasted inputs */
+	PG_FREE_IF_COPY(key, 0);
+
+	PG_RETURN_UINT32(result);
+}
+
+Datum
+hashvarlena_inmemory(PG_FUNCTION_ARGS)
+{
+	struct varlena *key = PG_GETARG_VARLENA_PP(0);
+	uint32		result;
+
+	result = hash_bytes_fast((unsigned char *) VARDATA_ANY(key),
+							 VARSIZE_ANY_EXHDR(key));
+
+	/* Avoid leaking memory for toasted inputs */
+	PG_FREE_IF_COPY(key, 0);
+
+	PG_RETURN_UINT32(result);
+}
@@ -17,12 +17,60 @@
 
 #include "access/hash.h"
 #include "access/hash_xlog.h"
+#include "access/tableam.h"
+#include "catalog/index.h"
+#include "executor/executor.h"
 #include "miscadmin.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "storage/lmgr.h"
 #include "storage/lwlock.h"
 #include "storage/buf_internals.h"
 #include "storage/predicate.h"
 
+/*
+ * Working state for checking a new entry of a unique index for duplicates.
+ *
+ * A hash index stores only hash codes, so entries whose hash codes match
+ * those of the new entry have to be compared against it by fetching their
+ * heap tuples and computing their key values again.  All of this is set up
+ * the first time such an entry is found, which is rare unless the key really
+ * is a duplicate.
+ */
+typedef struct HashUniqueCheckState
+{
+	Relation	rel;			/* the index */
+	Relation	heapRel;		/* its heap */
+	IndexInfo  *indexInfo;		/* to compute key values from heap tuples */
+	List	   *savedExprState; /* indexInfo's expression state on entry */
+	EState	   *estate;			/* for evaluating index expressions; NULL
+								 * until we've found a possible duplicate */
+	IndexFetchTableData *fetch; /* for fetching heap tuples */
+	TupleTableSlot *newslot;	/* heap tuple being inserted */
+	TupleTableSlot *slot;		/* possibly conflicting heap tuple */
+	bool		newlive;		/* is the tuple being inserted still live? */
+	Datum		values[INDEX_MAX_KEYS]; /* key values being inserted */
+	bool		isnull[INDEX_MAX_KEYS];
+	FmgrInfo	eqprocs[INDEX_MAX_KEYS];	/* equality function of each
+											 * column */
+} HashUniqueCheckState;
+
+static TransactionId _hash_check_unique(Relation rel, IndexTuple itup,
+										Buffer bucket_buf, Buffer old_bucket_buf,
+										IndexUniqueCheck checkUnique,
+										HashUniqueCheckState *ustate,
+										bool *is_unique,
+										uint32 *speculativeToken);
+static TransactionId _hash_check_unique_bucket(Relation rel, IndexTuple itup,
+											   Buffer bucket_buf,
+											   IndexUniqueCheck checkUnique,
+											   HashUniqueCheckState *ustate,
+											   bool *is_unique,
+											   uint32 *speculativeToken);
+static void _hash_unique_begin(HashUniqueCheckState *ustate, IndexTuple itup);
+static bool _hash_unique_keys_equal(HashUniqueCheckState *ustate);
+static void _hash_unique_end(HashUniqueCheckState *ustate);
 static void _hash_vacuum_one_page(Relation rel, Relation hrel,
 								  Buffer metabuf, Buffer buf);
 
@@ -31,12 +79,21 @@ static void _hash_vacuum_one_page(Relation rel, Relation hrel,
  *
  *		This routine is called by the public interface routines, hashbuild
  *		and hashinsert.  By here, itup is completely filled in.
+ *
+ *		If checkUnique isn't UNIQUE_CHECK_NO, the index is unique and the
+ *		entry is first checked for duplicates; see _hash_check_unique().
+ *		indexInfo may be NULL if the caller hasn't got one.  isbuild says
+ *		whether we're called while building the index, which only affects
+ *		the error message.  The result is as for hashinsert().
  */
-void
-_hash_doinsert(Relation rel, IndexTuple itup, Relation heapRel)
+bool
+_hash_doinsert(Relation rel, IndexTuple itup, Relation heapRel,
+			   IndexUniqueCheck checkUnique, IndexInfo *indexInfo,
+			   bool isbuild)
 {
 	Buffer		buf = InvalidBuffer;
 	Buffer		bucket_buf;
+	Buffer		old_bucket_buf = InvalidBuffer;
 	Buffer		metabuf;
 	HashMetaPage metap;
 	HashMetaPage usedmetap = NULL;
@@ -48,12 +105,29 @@ _hash_doinsert(Relation rel, IndexTuple itup, Relation heapRel)
 	uint32		hashkey;
 	Bucket		bucket;
 	OffsetNumber itup_off;
+	bool		checkingunique;
+	bool		is_unique = true;
+	HashUniqueCheckState ustate;
 
 	/*
 	 * Get the hash key for the item (it's stored in the index tuple itself).
 	 */
 	hashkey = _hash_get_indextuple_hashkey(itup);
 
+	/*
+	 * An entry with a null key column can't be a duplicate of anything, so
+	 * there's nothing to check for it.
+	 */
+	checkingunique = (checkUnique != UNIQUE_CHECK_NO &&
+					  !IndexTupleHasNulls(itup));
+	if (checkUnique == UNIQUE_CHECK_EXISTING && !checkingunique)
+		return true;
+
+	ustate.rel = rel;
+	ustate.heapRel = heapRel;
+	ustate.indexInfo = indexInfo;
+	ustate.estate = NULL;
+
 	/* compute item size too */
 	itemsz = IndexTupleSize(itup);
 	itemsz = MAXALIGN(itemsz);	/* be safe, PageAddItem will do this but we
@@ -122,6 +196,110 @@ restart_insert:
 		goto restart_insert;
 	}
 
+	/*
+	 * For a unique index, look for existing entries with the same key.  We
+	 * hold the exclusive lock on the primary bucket page from before the
+	 * check until the new entry has been added, so any other inserter of the
+	 * same key has to wait for us and will then see our entry.
+	 */
+	if (checkingunique)
+	{
+		TransactionId xwait;
+		uint32		speculativeToken = 0;
+
+		/*
+		 * If this bucket is being populated by a split, entries for it may
+		 * still be in the bucket being split, so we must check that one too.
+		 * To avoid deadlocks, lock the bucket being split first, as scans do;
+		 * see _hash_first().  Since we keep the pin on our bucket, the split
+		 * can't make progress while we're at it.
+		 */
+		if (H_BUCKET_BEING_POPULATED(pageopaque))
+		{
+			BlockNumber old_blkno;
+
+			old_blkno = _hash_get_oldblock_from_newbucket(rel, bucket);
+
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+			old_bucket_buf = _hash_getbuf(rel, old_blkno, HASH_READ,
+										  LH_BUCKET_PAGE);
+			LockBuffer(buf, BUFFER_LOCK_EXCLUSIVE);
+
+			if (!H_BUCKET_BEING_POPULATED(pageopaque))
+			{
+				_hash_relbuf(rel, old_bucket_buf);
+				old_bucket_buf = InvalidBuffer;
+			}
+		}
+
+		xwait = _hash_check_unique(rel, itup, buf, old_bucket_buf,
+								   checkUnique, &ustate, &is_unique,
+								   &speculativeToken);
+
+		if (BufferIsValid(old_bucket_buf))
+		{
+			_hash_relbuf(rel, old_bucket_buf);
+			old_bucket_buf = InvalidBuffer;
+		}
+
+		if (TransactionIdIsValid(xwait))
+		{
+			/* Have to wait for the other guy ... */
+			_hash_relbuf(rel, buf);
+			_hash_dropbuf(rel, metabuf);
+
+			if (speculativeToken)
+				SpeculativeInsertionWait(xwait, speculativeToken);
+			else
+				XactLockTableWait(xwait, rel, &itup->t_tid, XLTW_InsertIndex);
+
+			/* start over... */
+			goto restart_insert;
+		}
+
+		if (!is_unique && checkUnique != UNIQUE_CHECK_PARTIAL)
+		{
+			char	   *key_desc;
+
+			/*
+			 * Release our locks before building the error message, which
+			 * could make catalog accesses.
+			 */
+			_hash_relbuf(rel, buf);
+			_hash_dropbuf(rel, metabuf);
+
+			key_desc = BuildIndexValueDescription(rel, ustate.values,
+												  ustate.isnull);
+			if (isbuild)
+				ereport(ERROR,
+						(errcode(ERRCODE_UNIQUE_VIOLATION),
+						 errmsg("could not create unique index \"%s\"",
+								RelationGetRelationName(rel)),
+						 key_desc ? errdetail("Key %s is duplicated.", key_desc) :
+						 errdetail("Duplicate keys exist."),
+						 errtableconstraint(heapRel,
+											RelationGetRelationName(rel))));
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_UNIQUE_VIOLATION),
+						 errmsg("duplicate key value violates unique constraint \"%s\"",
+								RelationGetRelationName(rel)),
+						 key_desc ? errdetail("Key %s already exists.",
+											  key_desc) : 0,
+						 errtableconstraint(heapRel,
+											RelationGetRelationName(rel))));
+		}
+
+		/* If we were only asked to check, we're done */
+		if (checkUnique == UNIQUE_CHECK_EXISTING)
+		{
+			_hash_relbuf(rel, buf);
+			_hash_dropbuf(rel, metabuf);
+			_hash_unique_end(&ustate);
+			return is_unique;
+		}
+	}
+
 	/* Do the insertion */
 	while (PageGetFreeSpace(page) < itemsz)
 	{
@@ -157,10 +335,11 @@ restart_insert:
 			 * release both the lock and pin if this is an overflow page, but
 			 * only the lock if this is the primary bucket page, since the pin
 			 * on the primary bucket must be retained throughout the scan.
+			 * When checking uniqueness, we keep the lock too.
 			 */
 			if (buf != bucket_buf)
 				_hash_relbuf(rel, buf);
-			else
+			else if (!checkingunique)
 				LockBuffer(buf, BUFFER_LOCK_UNLOCK);
 			buf = _hash_getbuf(rel, nextblkno, HASH_WRITE, LH_OVERFLOW_PAGE);
 			page = BufferGetPage(buf);
@@ -175,6 +354,21 @@ restart_insert:
 			/* release our write lock without modifying buffer */
 			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
 
+			/*
+			 * When checking uniqueness, giving up the lock on the primary
+			 * bucket page lets others insert duplicates of our key, so after
+			 * adding the overflow page we must start over.  Next time there
+			 * should be room on the new page.
+			 */
+			if (checkingunique && buf == bucket_buf)
+			{
+				buf = _hash_addovflpage(rel, metabuf, buf, true);
+				_hash_relbuf(rel, buf);
+				_hash_dropbuf(rel, bucket_buf);
+				_hash_dropbuf(rel, metabuf);
+				goto restart_insert;
+			}
+
 			/* chain to a new overflow page */
 			buf = _hash_addovflpage(rel, metabuf, buf, (buf == bucket_buf) ? true : false);
 			page = BufferGetPage(buf);
@@ -243,7 +437,12 @@ restart_insert:
 	 */
 	_hash_relbuf(rel, buf);
 	if (buf != bucket_buf)
-		_hash_dropbuf(rel, bucket_buf);
+	{
+		if (checkingunique)
+			_hash_relbuf(rel, bucket_buf);
+		else
+			_hash_dropbuf(rel, bucket_buf);
+	}
 
 	/* Attempt to split if a split is needed */
 	if (do_expand)
@@ -251,6 +450,297 @@ restart_insert:
 
 	/* Finally drop our pin on the metapage */
 	_hash_dropbuf(rel, metabuf);
+
+	_hash_unique_end(&ustate);
+
+	return is_unique;
+}
+
+/*
+ *	_hash_check_unique() -- Check for violation of unique index constraint
+ *
+ * The caller must hold an exclusive lock on the primary page of the bucket
+ * the new entry goes into, and a share lock on the primary page of the
+ * bucket being split, if the former one is being populated by a split.
+ *
+ * Returns InvalidTransactionId if there is no conflict, else an xact ID we
+ * must wait for to see if it commits a conflicting tuple.  If the conflicting
+ * tuple still has a speculative insertion in progress, *speculativeToken is
+ * set to non-zero, and the caller can wait for the verdict on the insertion
+ * using SpeculativeInsertionWait().  If an actual conflict is detected,
+ * *is_unique is set to false, and the caller should report it after
+ * releasing its locks; ustate->values then holds the key.
+ *
+ * However, if checkUnique == UNIQUE_CHECK_PARTIAL, we always return
+ * InvalidTransactionId because we don't want to wait.  In this case we set
+ * *is_unique to false if there is a potential conflict, and the core code
+ * must redo the uniqueness check later.
+ *
+ * This is modeled on _bt_check_unique().
+ */
+static TransactionId
+_hash_check_unique(Relation rel, IndexTuple itup,
+				   Buffer bucket_buf, Buffer old_bucket_buf,
+				   IndexUniqueCheck checkUnique,
+				   HashUniqueCheckState *ustate,
+				   bool *is_unique, uint32 *speculativeToken)
+{
+	TransactionId xwait;
+
+	/* Assume unique until we find a duplicate */
+	*is_unique = true;
+
+	xwait = _hash_check_unique_bucket(rel, itup, bucket_buf, checkUnique,
+									  ustate, is_unique, speculativeToken);
+
+	if (*is_unique && !TransactionIdIsValid(xwait) &&
+		BufferIsValid(old_bucket_buf))
+		xwait = _hash_check_unique_bucket(rel, itup, old_bucket_buf,
+										  checkUnique, ustate, is_unique,
+										  speculativeToken);
+
+	return xwait;
+}
+
+/*
+ *	_hash_check_unique_bucket() -- Check one bucket for duplicates
+ *
+ * Workhorse for _hash_check_unique().  bucket_buf is the locked primary
+ * bucket page, which stays locked; the overflow pages are locked in turn
+ * while we look at them.
+ */
+static TransactionId
+_hash_check_unique_bucket(Relation rel, IndexTuple itup, Buffer bucket_buf,
+						  IndexUniqueCheck checkUnique,
+						  HashUniqueCheckState *ustate,
+						  bool *is_unique, uint32 *speculativeToken)
+{
+	uint32		hashkey = _hash_get_indextuple_hashkey(itup);
+	int			natts = IndexRelationGetNumberOfKeyAttributes(rel);
+	char	   *hashcodes;
+	Buffer		buf = bucket_buf;
+	SnapshotData SnapshotDirty;
+
+	hashcodes = (char *) itup + IndexInfoFindDataOffset(itup->t_info);
+
+	for (;;)
+	{
+		Page		page = BufferGetPage(buf);
+		HashPageOpaque opaque = (HashPageOpaque) PageGetSpecialPointer(page);
+		OffsetNumber maxoff = PageGetMaxOffsetNumber(page);
+		OffsetNumber offnum;
+		BlockNumber nextblkno;
+
+		for (offnum = _hash_binsearch(page, hashkey);
+			 offnum <= maxoff;
+			 offnum = OffsetNumberNext(offnum))
+		{
+			ItemId		itemid = PageGetItemId(page, offnum);
+			IndexTuple	curitup = (IndexTuple) PageGetItem(page, itemid);
+			ItemPointerData htid;
+			bool		call_again = false;
+			TransactionId xwait;
+
+			if (_hash_get_indextuple_hashkey(curitup) != hashkey)
+				break;			/* we're past all the matching tuples */
+
+			/*
+			 * Skip killed items, and items whose hash codes for the other
+			 * columns differ.  The new entry has no nulls, so neither can a
+			 * duplicate; and without nulls, the hash codes are laid out the
+			 * same way in both tuples.
+			 */
+			if (ItemIdIsDead(itemid))
+				continue;
+			if (natts > 1 &&
+				(IndexTupleHasNulls(curitup) ||
+				 memcmp(hashcodes,
+						(char *) curitup + IndexInfoFindDataOffset(curitup->t_info),
+						natts * sizeof(uint32)) != 0))
+				continue;
+
+			/*
+			 * If we are doing a recheck, we expect to find the tuple we are
+			 * rechecking.  It's not a duplicate, but we have to keep
+			 * scanning.
+			 */
+			if (checkUnique == UNIQUE_CHECK_EXISTING &&
+				ItemPointerEquals(&curitup->t_tid, &itup->t_tid))
+				continue;
+
+			/*
+			 * Now we have to look at the heap.  If the tuple we want to
+			 * insert is itself committed dead, it can't conflict with
+			 * anything; that happens during CREATE INDEX CONCURRENTLY.
+			 */
+			if (ustate->estate == NULL)
+				_hash_unique_begin(ustate, itup);
+			if (!ustate->newlive)
+				goto done;
+
+			/*
+			 * Check if there's a table tuple for this index entry satisfying
+			 * SnapshotDirty, and if so whether it has the same key.  There's
+			 * a single index entry for a whole HOT chain, but all its members
+			 * have the same key.
+			 */
+			InitDirtySnapshot(SnapshotDirty);
+			htid = curitup->t_tid;
+			if (!table_index_fetch_tuple(ustate->fetch, &htid, &SnapshotDirty,
+										 ustate->slot, &call_again, NULL))
+				continue;
+			if (!_hash_unique_keys_equal(ustate))
+				continue;
+
+			/*
+			 * It is a duplicate.  If we are only doing a partial check, then
+			 * don't bother checking if the tuple is being updated in another
+			 * transaction.  Just return the fact that it is a potential
+			 * conflict and leave the full check till later.
+			 */
+			*is_unique = false;
+			if (checkUnique == UNIQUE_CHECK_PARTIAL)
+				goto done;
+
+			/*
+			 * If this tuple is being updated by other transaction then we
+			 * have to wait for its commit/abort.
+			 */
+			xwait = (TransactionIdIsValid(SnapshotDirty.xmin)) ?
+				SnapshotDirty.xmin : SnapshotDirty.xmax;
+			if (TransactionIdIsValid(xwait))
+			{
+				*is_unique = true;
+				*speculativeToken = SnapshotDirty.speculativeToken;
+				if (buf != bucket_buf)
+					_hash_relbuf(rel, buf);
+				return xwait;
+			}
+
+			/* Otherwise we have a definite conflict */
+			goto done;
+		}
+
+		/* advance to the next page of the bucket chain */
+		nextblkno = opaque->hasho_nextblkno;
+		if (!BlockNumberIsValid(nextblkno))
+			break;
+		if (buf != bucket_buf)
+			_hash_relbuf(rel, buf);
+		buf = _hash_getbuf(rel, nextblkno, HASH_READ, LH_OVERFLOW_PAGE);
+	}
+
+done:
+	if (buf != bucket_buf)
+		_hash_relbuf(rel, buf);
+	return InvalidTransactionId;
+}
+
+/*
+ * Set up to compare the entry being inserted with existing entries of a
+ * unique index, and compute its key values from its heap tuple.
+ */
+static void
+_hash_unique_begin(HashUniqueCheckState *ustate, IndexTuple itup)
+{
+	Relation	rel = ustate->rel;
+	int			natts = IndexRelationGetNumberOfKeyAttributes(rel);
+	ItemPointerData tid;
+	bool		call_again = false;
+	int			i;
+
+	if (ustate->indexInfo == NULL)
+		ustate->indexInfo = BuildIndexInfo(rel);
+	ustate->savedExprState = ustate->indexInfo->ii_ExpressionsState;
+
+	ustate->estate = CreateExecutorState();
+	ustate->fetch = table_index_fetch_begin(ustate->heapRel);
+	ustate->newslot = table_slot_create(ustate->heapRel, NULL);
+	ustate->slot = table_slot_create(ustate->heapRel, NULL);
+
+	for (i = 0; i < natts; i++)
+	{
+		Oid			opno;
+
+		opno = get_opfamily_member(rel->rd_opfamily[i],
+								   rel->rd_opcintype[i],
+								   rel->rd_opcintype[i],
+								   HTEqualStrategyNumber);
+		if (!OidIsValid(opno))
+			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
+				 HTEqualStrategyNumber, rel->rd_opcintype[i],
+				 rel->rd_opcintype[i], rel->rd_opfamily[i]);
+		fmgr_info(get_opcode(opno), &ustate->eqprocs[i]);
+	}
+
+	/*
+	 * Fetch the tuple being inserted.  We must follow its HOT chain, because
+	 * during a concurrent index build we insert the root TID though the live
+	 * tuple may be somewhere else in the chain.
+	 */
+	tid = itup->t_tid;
+	ustate->newlive = table_index_fetch_tuple(ustate->fetch, &tid,
+											  SnapshotSelf, ustate->newslot,
+											  &call_again, NULL);
+	if (ustate->newlive)
+	{
+		GetPerTupleExprContext(ustate->estate)->ecxt_scantuple = ustate->newslot;
+		FormIndexDatum(ustate->indexInfo, ustate->newslot, ustate->estate,
+					   ustate->values, ustate->isnull);
+	}
+}
+
+/*
+ * Does the heap tuple in ustate->slot have the same key as the entry being
+ * inserted?
+ *
+ * Whatever memory this uses is only released by _hash_unique_end(), since
+ * the key values of the entry being inserted could live in the same place.
+ */
+static bool
+_hash_unique_keys_equal(HashUniqueCheckState *ustate)
+{
+	Relation	rel = ustate->rel;
+	int			natts = IndexRelationGetNumberOfKeyAttributes(rel);
+	Datum		values[INDEX_MAX_KEYS];
+	bool		isnull[INDEX_MAX_KEYS];
+	int			i;
+
+	GetPerTupleExprContext(ustate->estate)->ecxt_scantuple = ustate->slot;
+	FormIndexDatum(ustate->indexInfo, ustate->slot, ustate->estate,
+				   values, isnull);
+
+	for (i = 0; i < natts; i++)
+	{
+		/* the new entry has no nulls, and null is never equal to anything */
+		if (isnull[i])
+			return false;
+		if (!DatumGetBool(FunctionCall2Coll(&ustate->eqprocs[i],
+											rel->rd_indcollation[i],
+											ustate->values[i], values[i])))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Release the resources acquired by _hash_unique_begin(), if any.
+ */
+static void
+_hash_unique_end(HashUniqueCheckState *ustate)
+{
+	if (ustate->estate == NULL)
+		return;
+
+	table_index_fetch_end(ustate->fetch);
+	ExecDropSingleTupleTableSlot(ustate->slot);
+	ExecDropSingleTupleTableSlot(ustate->newslot);
+	FreeExecutorState(ustate->estate);
+
+	/* forget any expression state that lived in our executor state */
+	ustate->indexInfo->ii_ExpressionsState = ustate->savedExprState;
+	ustate->estate = NULL;
 }
 
 /*
@@ -293,9 +293,10 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 {
 	Relation	rel = scan->indexRelation;
 	HashScanOpaque so = (HashScanOpaque) scan->opaque;
-	ScanKey		cur;
+	ScanKey		cur = NULL;
 	uint32		hashkey;
 	Bucket		bucket;
+	int			i;
 	Buffer		buf;
 	Page		page;
 	HashPageOpaque opaque;
@@ -314,39 +315,63 @@ _hash_first(IndexScanDesc scan, ScanDirection dir)
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("hash indexes do not support whole-index scans")));
 
-	/* There may be more than one index qual, but we hash only the first */
-	cur = &scan->keyData[0];
-
-	/* We support only single-column hash indexes */
-	Assert(cur->sk_attno == 1);
-	/* And there's only one operator strategy, too */
-	Assert(cur->sk_strategy == HTEqualStrategyNumber);
-
 	/*
-	 * If the constant in the index qual is NULL, assume it cannot match any
-	 * items in the index.
+	 * Okay to compute the hash keys.  We want to do this before acquiring any
+	 * locks, in case a user-defined hash function happens to be slow.  There
+	 * may be more than one index qual, but only the first one on the first
+	 * index column determines the bucket to scan; the others are checked by
+	 * _hash_checkqual.
 	 */
-	if (cur->sk_flags & SK_ISNULL)
-		return false;
+	for (i = 0; i < scan->numberOfKeys; i++)
+	{
+		ScanKey		key = &scan->keyData[i];
+		int			attoff = key->sk_attno - 1;
+
+		/* There's only one operator strategy */
+		Assert(key->sk_strategy == HTEqualStrategyNumber);
+
+		/*
+		 * If the constant in the index qual is NULL, assume it cannot match
+		 * any items in the index.
+		 */
+		if (key->sk_flags & SK_ISNULL)
+			return false;
+
+		/*
+		 * If scankey operator is not a cross-type comparison, we can use the
+		 * cached hash function; otherwise gotta look it up in the catalogs.
+		 *
+		 * We support the convention that sk_subtype == InvalidOid means the
+		 * opclass input type; this is a hack to simplify life for
+		 * ScanKeyInit().
+		 */
+		if (key->sk_subtype == rel->rd_opcintype[attoff] ||
+			key->sk_subtype == InvalidOid)
+			so->hashso_sk_hashes[i] = _hash_datum2hashkey(rel, key->sk_attno,
+														  key->sk_argument);
+		else
+			so->hashso_sk_hashes[i] = _hash_datum2hashkey_type(rel,
+															   key->sk_attno,
+															   key->sk_argument,
+															   key->sk_subtype);
+
+		if (cur == NULL && key->sk_attno == 1)
+		{
+			cur = key;
+			so->hashso_sk_hash = so->hashso_sk_hashes[i];
+		}
+	}
 
 	/*
-	 * Okay to compute the hash key.  We want to do this before acquiring any
-	 * locks, in case a user-defined hash function happens to be slow.
-	 *
-	 * If scankey operator is not a cross-type comparison, we can use the
-	 * cached hash function; otherwise gotta look it up in the catalogs.
-	 *
-	 * We support the convention that sk_subtype == InvalidOid means the
-	 * opclass input type; this is a hack to simplify life for ScanKeyInit().
+	 * The planner never chooses a hash index without a condition on its first
+	 * column, since amoptionalkey is false.
 	 */
-	if (cur->sk_subtype == rel->rd_opcintype[0] ||
-		cur->sk_subtype == InvalidOid)
-		hashkey = _hash_datum2hashkey(rel, cur->sk_argument);
-	else
-		hashkey = _hash_datum2hashkey_type(rel, cur->sk_argument,
-										   cur->sk_subtype);
+	if (cur == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("hash index scans require a condition on the first index column")));
 
-	so->hashso_sk_hash = hashkey;
+	hashkey = so->hashso_sk_hash;
 
 	buf = _hash_getbucketbuf_from_hashkey(rel, hashkey, HASH_READ, NULL);
 	PredicateLockPage(rel, BufferGetBlockNumber(buf), scan->xs_snapshot);
@@ -639,14 +664,7 @@ _hash_load_qualified_items(IndexScanDesc scan, Page page,
 				continue;
 			}
 
-			if (so->hashso_sk_hash == _hash_get_indextuple_hashkey(itup) &&
-				_hash_checkqual(scan, itup))
-			{
-				/* tuple is qualified, so remember it */
-				_hash_saveitem(so, itemIndex, offnum, itup);
-				itemIndex++;
-			}
-			else
+			if (so->hashso_sk_hash != _hash_get_indextuple_hashkey(itup))
 			{
 				/*
 				 * No more matching tuples exist in this page. so, exit while
@@ -655,6 +673,13 @@ _hash_load_qualified_items(IndexScanDesc scan, Page page,
 				break;
 			}
 
+			if (_hash_checkqual(scan, itup))
+			{
+				/* tuple is qualified, so remember it */
+				_hash_saveitem(so, itemIndex, offnum, itup);
+				itemIndex++;
+			}
+
 			offnum = OffsetNumberNext(offnum);
 		}
 
@@ -685,14 +710,7 @@ _hash_load_qualified_items(IndexScanDesc scan, Page page,
 				continue;
 			}
 
-			if (so->hashso_sk_hash == _hash_get_indextuple_hashkey(itup) &&
-				_hash_checkqual(scan, itup))
-			{
-				itemIndex--;
-				/* tuple is qualified, so remember it */
-				_hash_saveitem(so, itemIndex, offnum, itup);
-			}
-			else
+			if (so->hashso_sk_hash != _hash_get_indextuple_hashkey(itup))
 			{
 				/*
 				 * No more matching tuples exist in this page. so, exit while
@@ -701,6 +719,13 @@ _hash_load_qualified_items(IndexScanDesc scan, Page page,
 				break;
 			}
 
+			if (_hash_checkqual(scan, itup))
+			{
+				itemIndex--;
+				/* tuple is qualified, so remember it */
+				_hash_saveitem(so, itemIndex, offnum, itup);
+			}
+
 			offnum = OffsetNumberPrev(offnum);
 		}
 
@@ -28,6 +28,7 @@
 #include "access/hash.h"
 #include "commands/progress.h"
 #include "miscadmin.h"
+#include "nodes/execnodes.h"
 #include "pgstat.h"
 #include "utils/tuplesort.h"
 
@@ -112,10 +113,11 @@ _h_spool(HSpool *hspool, ItemPointer self, Datum *values, bool *isnull)
 
 /*
  * given a spool loaded by successive calls to _h_spool,
- * create an entire index.
+ * create an entire index.  All the spooled tuples are alive, so they're
+ * checked for duplicates if the index is unique.
  */
 void
-_h_indexbuild(HSpool *hspool, Relation heapRel)
+_h_indexbuild(HSpool *hspool, Relation heapRel, IndexInfo *indexInfo)
 {
 	IndexTuple	itup;
 	int64		tups_done = 0;
@@ -143,7 +145,9 @@ _h_indexbuild(HSpool *hspool, Relation heapRel)
 		Assert(hashkey >= lasthashkey);
 #endif
 
-		_hash_doinsert(hspool->index, itup, heapRel);
+		_hash_doinsert(hspool->index, itup, heapRel,
+					   indexInfo->ii_Unique ? UNIQUE_CHECK_YES : UNIQUE_CHECK_NO,
+					   indexInfo, true);
 
 		pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_DONE,
 									 ++tups_done);
@@ -31,43 +31,39 @@ bool
 _hash_checkqual(IndexScanDesc scan, IndexTuple itup)
 {
 	/*
-	 * Currently, we can't check any of the scan conditions since we do not
-	 * have the original index entry value to supply to the sk_func. Always
-	 * return true; we expect that hashgettuple already set the recheck flag
-	 * to make the main indexscan code do it.
+	 * We can't check any of the scan conditions exactly, since we do not have
+	 * the original index entry values to supply to the sk_func; we expect
+	 * that hashgettuple already set the recheck flag to make the main
+	 * indexscan code do it.  But we can reject tuples whose hash codes don't
+	 * match those of the scan keys.  The caller has already checked the hash
+	 * code of the first column, so there's nothing more to do for a
+	 * single-column index.
 	 */
-#ifdef NOT_USED
+	HashScanOpaque so = (HashScanOpaque) scan->opaque;
 	TupleDesc	tupdesc = RelationGetDescr(scan->indexRelation);
 	ScanKey		key = scan->keyData;
-	int			scanKeySize = scan->numberOfKeys;
+	int			i;
 
-	while (scanKeySize > 0)
+	if (tupdesc->natts == 1)
+		return true;
+
+	for (i = 0; i < scan->numberOfKeys; i++, key++)
 	{
 		Datum		datum;
 		bool		isNull;
-		Datum		test;
 
 		datum = index_getattr(itup,
 							  key->sk_attno,
 							  tupdesc,
 							  &isNull);
 
-		/* assume sk_func is strict */
+		/* the equality operator is assumed to be strict */
 		if (isNull)
 			return false;
-		if (key->sk_flags & SK_ISNULL)
-			return false;
 
-		test = FunctionCall2Coll(&key->sk_func, key->sk_collation,
-								 datum, key->sk_argument);
-
-		if (!DatumGetBool(test))
+		if (DatumGetUInt32(datum) != so->hashso_sk_hashes[i])
 			return false;
-
-		key++;
-		scanKeySize--;
 	}
-#endif
 
 	return true;
 }
@@ -79,14 +75,13 @@ _hash_checkqual(IndexScanDesc scan, IndexTuple itup)
  * "primary" hash function that's tracked for us by the generic index code.
  */
 uint32
-_hash_datum2hashkey(Relation rel, Datum key)
+_hash_datum2hashkey(Relation rel, AttrNumber attno, Datum key)
 {
 	FmgrInfo   *procinfo;
 	Oid			collation;
 
-	/* XXX assumes index has only one attribute */
-	procinfo = index_getprocinfo(rel, 1, HASHSTANDARD_PROC);
-	collation = rel->rd_indcollation[0];
+	procinfo = index_getprocinfo(rel, attno, HASHSTANDARD_PROC);
+	collation = rel->rd_indcollation[attno - 1];
 
 	return DatumGetUInt32(FunctionCall1Coll(procinfo, collation, key));
 }
@@ -99,13 +94,13 @@ _hash_datum2hashkey(Relation rel, Datum key)
  * cross-type situations.
  */
 uint32
-_hash_datum2hashkey_type(Relation rel, Datum key, Oid keytype)
+_hash_datum2hashkey_type(Relation rel, AttrNumber attno, Datum key,
+						 Oid keytype)
 {
 	RegProcedure hash_proc;
 	Oid			collation;
 
-	/* XXX assumes index has only one attribute */
-	hash_proc = get_opfamily_proc(rel->rd_opfamily[0],
+	hash_proc = get_opfamily_proc(rel->rd_opfamily[attno - 1],
 								  keytype,
 								  keytype,
 								  HASHSTANDARD_PROC);
@@ -113,7 +108,7 @@ _hash_datum2hashkey_type(Relation rel, Datum key, Oid keytype)
 		elog(ERROR, "missing support function %d(%u,%u) for index \"%s\"",
 			 HASHSTANDARD_PROC, keytype, keytype,
 			 RelationGetRelationName(rel));
-	collation = rel->rd_indcollation[0];
+	collation = rel->rd_indcollation[attno - 1];
 
 	return DatumGetUInt32(OidFunctionCall1Coll(hash_proc, collation, key));
 }
@@ -315,30 +310,47 @@ _hash_get_indextuple_hashkey(IndexTuple itup)
  * Outputs: values and isnull arrays for the index tuple, suitable for
  *		passing to index_form_tuple().
  *
- * Returns true if successful, false if not (because there are null values).
- * On a false result, the given data need not be indexed.
+ * Returns true if successful, false if not (because the first column is
+ * null).  On a false result, the given data need not be indexed.
  *
- * Note: callers know that the index-column arrays are always of length 1.
- * In principle, there could be more than one input column, though we do not
- * currently support that.
+ * The index tuple holds the hash code of each column.  Only the hash code
+ * of the first column determines the bucket, and is what the tuples of a
+ * page are ordered by; see _hash_get_indextuple_hashkey().  That way, a scan
+ * needs a condition on the first column only, just as for a btree index.
+ * The hash codes of the other columns let scans and uniqueness checks skip
+ * most of the tuples that don't match those columns without visiting the
+ * heap.  Nulls in the other columns are stored as nulls.
  */
 bool
 _hash_convert_tuple(Relation index,
 					Datum *user_values, bool *user_isnull,
 					Datum *index_values, bool *index_isnull)
 {
-	uint32		hashkey;
+	int			natts = IndexRelationGetNumberOfKeyAttributes(index);
+	int			i;
 
 	/*
-	 * We do not insert null values into hash indexes.  This is okay because
-	 * the only supported search operator is '=', and we assume it is strict.
+	 * We do not insert tuples with a null first column into hash indexes.
+	 * This is okay because the only supported search operator is '=', we
+	 * assume it is strict, and every scan has a condition on that column.
 	 */
 	if (user_isnull[0])
 		return false;
 
-	hashkey = _hash_datum2hashkey(index, user_values[0]);
-	index_values[0] = UInt32GetDatum(hashkey);
-	index_isnull[0] = false;
+	for (i = 0; i < natts; i++)
+	{
+		if (user_isnull[i])
+		{
+			index_values[i] = (Datum) 0;
+			index_isnull[i] = true;
+		}
+		else
+		{
+			index_values[i] = UInt32GetDatum(_hash_datum2hashkey(index, i + 1,
+																 user_values[i]));
+			index_isnull[i] = false;
+		}
+	}
 	return true;
 }
 
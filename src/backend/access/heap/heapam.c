@@ -297,6 +297,11 @@ initscan(HeapScanDesc scan, ScanKey key, bool keep_startblock)
 
 	scan->rs_numblocks = InvalidBlockNumber;
 	scan->rs_inited = false;
+
+	/* the stream's block sequence is computed at first use, see below */
+	scan->rs_stream_left = InvalidBlockNumber;
+	if (scan->rs_stream != NULL)
+		ResetStreamingRead(scan->rs_stream);
 	scan->rs_ctup.t_data = NULL;
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
 	scan->rs_cbuf = InvalidBuffer;
@@ -341,6 +346,41 @@ heap_setscanlimits(TableScanDesc sscan, BlockNumber startBlk, BlockNumber numBlk
 	scan->rs_numblocks = numBlks;
 }
 
+/*
+ * heap_scan_stream_next_block - streaming read callback for heap scans
+ *
+ * Produces the same sequence of blocks that a forward serial heapgettup()
+ * visits: starting at rs_startblock, wrapping around at the end of the
+ * relation if the scan is synchronized, and stopping after rs_numblocks
+ * blocks if heap_setscanlimits() restricted the scan.
+ */
+static BlockNumber
+heap_scan_stream_next_block(void *callback_private)
+{
+	HeapScanDesc scan = (HeapScanDesc) callback_private;
+	BlockNumber blkno;
+
+	if (scan->rs_stream_left == InvalidBlockNumber)
+	{
+		/* first call since initscan; the scan limits are now final */
+		scan->rs_stream_next = scan->rs_startblock;
+		scan->rs_stream_left = scan->rs_nblocks;
+		if (scan->rs_numblocks != InvalidBlockNumber)
+			scan->rs_stream_left = Min(scan->rs_stream_left,
+									   scan->rs_numblocks);
+	}
+
+	if (scan->rs_stream_left == 0)
+		return InvalidBlockNumber;
+
+	blkno = scan->rs_stream_next;
+	if (++scan->rs_stream_next >= scan->rs_nblocks)
+		scan->rs_stream_next = 0;
+	scan->rs_stream_left--;
+
+	return blkno;
+}
+
 /*
  * heapgetpage - subroutine for heapgettup()
  *
@@ -377,6 +417,19 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
+	/*
+	 * Advance the look-ahead stream, if any.  Should the scan ever ask for a
+	 * different page than the stream expects, as happens when a cursor
+	 * changes direction, the stream is of no further use: drop it, and just
+	 * read pages on demand from here on.
+	 */
+	if (scan->rs_stream != NULL &&
+		StreamingReadNextBlock(scan->rs_stream) != page)
+	{
+		EndStreamingRead(scan->rs_stream);
+		scan->rs_stream = NULL;
+	}
+
 	/* read page using selected strategy */
 	scan->rs_cbuf = ReadBufferExtended(scan->rs_base.rs_rd, MAIN_FORKNUM, page,
 									   RBM_NORMAL, scan->rs_strategy);
@@ -427,6 +480,10 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 	 */
 	all_visible = PageIsAllVisible(dp) && !snapshot->takenDuringRecovery;
 
+	/* Mark the buffer dirty at most once for any hint bits we set */
+	if (!all_visible)
+		HeapBeginHintBatch(buffer);
+
 	for (lineoff = FirstOffsetNumber, lpp = PageGetItemId(dp, lineoff);
 		 lineoff <= lines;
 		 lineoff++, lpp++)
@@ -454,6 +511,9 @@ heapgetpage(TableScanDesc sscan, BlockNumber page)
 		}
 	}
 
+	if (!all_visible)
+		HeapEndHintBatch();
+
 	LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
 	Assert(ntup <= MaxHeapTuplesPerPage);
@@ -1156,6 +1216,7 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 	scan->rs_base.rs_flags = flags;
 	scan->rs_base.rs_parallel = parallel_scan;
 	scan->rs_strategy = NULL;	/* set in initscan */
+	scan->rs_stream = NULL;
 
 	/*
 	 * Disable page-at-a-time mode if it's not a MVCC-safe snapshot.
@@ -1201,6 +1262,18 @@ heap_beginscan(Relation relation, Snapshot snapshot,
 
 	initscan(scan, key, false);
 
+	/*
+	 * Plain forward sequential scans visit blocks in an order we can predict,
+	 * so read ahead of them.  Parallel scans don't know which blocks they
+	 * will be handed, and catalog scans are too small to be worth it.
+	 */
+	if ((scan->rs_base.rs_flags & SO_TYPE_SEQSCAN) &&
+		parallel_scan == NULL &&
+		!IsCatalogRelation(relation))
+		scan->rs_stream = BeginStreamingRead(relation, MAIN_FORKNUM, NULL,
+											 heap_scan_stream_next_block,
+											 scan);
+
 	return (TableScanDesc) scan;
 }
 
@@ -1265,6 +1338,9 @@ heap_endscan(TableScanDesc sscan)
 	if (scan->rs_strategy != NULL)
 		FreeAccessStrategy(scan->rs_strategy);
 
+	if (scan->rs_stream != NULL)
+		EndStreamingRead(scan->rs_stream);
+
 	if (scan->rs_base.rs_flags & SO_TEMP_SNAPSHOT)
 		UnregisterSnapshot(scan->rs_base.rs_snapshot);
 
@@ -1379,6 +1455,113 @@ heap_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableSlot *s
 	return true;
 }
 
+/*
+ * heap_set_tidrange - restrict a scan to the TIDs from mintid to maxtid
+ *
+ * Only the blocks that can hold such tuples are read, using
+ * heap_setscanlimits(); heap_getnextslot_tidrange() filters out the tuples
+ * of the first and last of them that are outside the range.  Must be called
+ * before the scan returns its first tuple.
+ */
+void
+heap_set_tidrange(TableScanDesc sscan, ItemPointer mintid, ItemPointer maxtid)
+{
+	HeapScanDesc scan = (HeapScanDesc) sscan;
+	ItemPointerData lowestItem;
+	ItemPointerData highestItem;
+
+	/* an empty relation has no tuples outside the range, either */
+	if (scan->rs_nblocks == 0)
+	{
+		ItemPointerSet(&scan->rs_mintid, 0, FirstOffsetNumber);
+		ItemPointerSet(&scan->rs_maxtid, 0, FirstOffsetNumber);
+		return;
+	}
+
+	/* clamp the range to the TIDs that can exist in the relation */
+	ItemPointerSet(&lowestItem, 0, FirstOffsetNumber);
+	ItemPointerSet(&highestItem, scan->rs_nblocks - 1, MaxOffsetNumber);
+	if (ItemPointerCompare(mintid, &lowestItem) > 0)
+		ItemPointerCopy(mintid, &lowestItem);
+	if (ItemPointerCompare(maxtid, &highestItem) < 0)
+		ItemPointerCopy(maxtid, &highestItem);
+
+	if (ItemPointerCompare(&highestItem, &lowestItem) < 0)
+	{
+		/* nothing to scan */
+		heap_setscanlimits(sscan, 0, 0);
+	}
+	else
+	{
+		BlockNumber startBlk = ItemPointerGetBlockNumberNoCheck(&lowestItem);
+		BlockNumber endBlk = ItemPointerGetBlockNumberNoCheck(&highestItem);
+
+		heap_setscanlimits(sscan, startBlk, endBlk - startBlk + 1);
+	}
+
+	scan->rs_mintid = lowestItem;
+	scan->rs_maxtid = highestItem;
+}
+
+/*
+ * heap_getnextslot_tidrange - get the next tuple of a TID range scan
+ *
+ * Like heap_getnextslot(), but returns only tuples in the range set by
+ * heap_set_tidrange().
+ */
+bool
+heap_getnextslot_tidrange(TableScanDesc sscan, ScanDirection direction,
+						  TupleTableSlot *slot)
+{
+	HeapScanDesc scan = (HeapScanDesc) sscan;
+
+	/* Note: no locking manipulations needed */
+	for (;;)
+	{
+		if (sscan->rs_flags & SO_ALLOW_PAGEMODE)
+			heapgettup_pagemode(scan, direction, sscan->rs_nkeys, sscan->rs_key);
+		else
+			heapgettup(scan, direction, sscan->rs_nkeys, sscan->rs_key);
+
+		if (scan->rs_ctup.t_data == NULL)
+		{
+			ExecClearTuple(slot);
+			return false;
+		}
+
+		/*
+		 * The tuples of a page come in TID order, so once we're past the end
+		 * of the range in the direction of the scan, there's nothing more to
+		 * return.
+		 */
+		if (ItemPointerCompare(&scan->rs_ctup.t_self, &scan->rs_mintid) < 0)
+		{
+			if (ScanDirectionIsBackward(direction))
+			{
+				ExecClearTuple(slot);
+				return false;
+			}
+			continue;
+		}
+		if (ItemPointerCompare(&scan->rs_ctup.t_self, &scan->rs_maxtid) > 0)
+		{
+			if (ScanDirectionIsForward(direction))
+			{
+				ExecClearTuple(slot);
+				return false;
+			}
+			continue;
+		}
+
+		break;
+	}
+
+	pgstat_count_heap_getnext(scan->rs_base.rs_rd);
+
+	ExecStoreBufferHeapTuple(&scan->rs_ctup, slot, scan->rs_cbuf);
+	return true;
+}
+
 /*
  *	heap_fetch		- retrieve tuple with given tid
  *
@@ -1819,6 +2002,7 @@ GetBulkInsertState(void)
 	bistate = (BulkInsertState) palloc(sizeof(BulkInsertStateData));
 	bistate->strategy = GetAccessStrategy(BAS_BULKWRITE);
 	bistate->current_buf = InvalidBuffer;
+	bistate->direct_pages = NULL;
 	return bistate;
 }
 
@@ -1830,12 +2014,20 @@ FreeBulkInsertState(BulkInsertState bistate)
 {
 	if (bistate->current_buf != InvalidBuffer)
 		ReleaseBuffer(bistate->current_buf);
+	if (bistate->direct_pages != NULL)
+	{
+		RelationFlushDirectPages(bistate);
+		pfree(bistate->direct_pages);
+	}
 	FreeAccessStrategy(bistate->strategy);
 	pfree(bistate);
 }
 
 /*
  * ReleaseBulkInsertStatePin - release a buffer currently held in bistate
+ *
+ * This also writes out any pages built for HEAP_INSERT_DIRECT, so that the
+ * tuples inserted so far can be read back.
  */
 void
 ReleaseBulkInsertStatePin(BulkInsertState bistate)
@@ -1843,6 +2035,7 @@ ReleaseBulkInsertStatePin(BulkInsertState bistate)
 	if (bistate->current_buf != InvalidBuffer)
 		ReleaseBuffer(bistate->current_buf);
 	bistate->current_buf = InvalidBuffer;
+	RelationFlushDirectPages(bistate);
 }
 
 
@@ -2051,13 +2244,13 @@ heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
 {
 	/*
 	 * Parallel operations are required to be strictly read-only in a parallel
-	 * worker.  Parallel inserts are not safe even in the leader in the
-	 * general case, because group locking means that heavyweight locks for
-	 * relation extension or GIN page locks will not conflict between members
-	 * of a lock group, but we don't prohibit that case here because there are
-	 * useful special cases that we can safely allow, such as CREATE TABLE AS.
+	 * worker, unless the caller says otherwise with HEAP_INSERT_PARALLEL.
+	 * That's only safe if the leader has made sure that whatever else the
+	 * worker does while inserting is parallel safe, as parallel COPY FROM
+	 * and the planner for parallel INSERT ... SELECT do.  Relation extension and GIN page locks
+	 * conflict between members of a lock group, so that part is safe.
 	 */
-	if (IsParallelWorker())
+	if (IsParallelWorker() && !(options & HEAP_INSERT_PARALLEL))
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_TRANSACTION_STATE),
 				 errmsg("cannot insert tuples in a parallel worker")));
@@ -2098,6 +2291,12 @@ heap_prepare_insert(Relation relation, HeapTuple tup, TransactionId xid,
  * tuples can be inserted on a single page, we can write just a single WAL
  * record covering all of them, and only need to lock/unlock the page once.
  *
+ * With HEAP_INSERT_DIRECT and a bulk insert state, the tuples are instead
+ * put on pages built in private memory, which are written out directly and
+ * WAL-logged as whole pages; see RelationPutHeapTuplesDirect().  That isn't
+ * possible if the relation is logically logged, as logical decoding needs
+ * the individual tuples, so in that case the option is ignored.
+ *
  * Note: this leaks memory into the current memory context. You can create a
  * temporary context before calling this, if that's a problem.
  */
@@ -2162,6 +2361,13 @@ heap_multi_insert(Relation relation, TupleTableSlot **slots, int ntuples,
 	CheckForSerializableConflictIn(relation, NULL, InvalidBuffer);
 
 	ndone = 0;
+	if ((options & HEAP_INSERT_DIRECT) && bistate != NULL && !need_tuple_data)
+	{
+		RelationPutHeapTuplesDirect(relation, heaptuples, ntuples, options,
+									bistate);
+		ndone = ntuples;
+	}
+
 	while (ndone < ntuples)
 	{
 		Buffer		buffer;
@@ -3605,6 +3811,9 @@ l2:
 		PageSetFull(page);
 	}
 
+	/* Let future insertions adapt to how often we had to move */
+	RelationRecordUpdatePlacement(relation, newbuf == buffer);
+
 	/*
 	 * Compute replica identity tuple before entering the critical section so
 	 * we don't PANIC upon a memory allocation failure.
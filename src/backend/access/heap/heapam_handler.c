@@ -564,9 +564,11 @@ heapam_finish_bulk_insert(Relation relation, int options)
 {
 	/*
 	 * If we skipped writing WAL, then we need to sync the heap (but not
-	 * indexes since those use WAL anyway / don't go through tableam)
+	 * indexes since those use WAL anyway / don't go through tableam).  The
+	 * same goes if we wrote pages directly, bypassing shared buffers, as a
+	 * checkpoint might have happened after they were WAL-logged.
 	 */
-	if (options & HEAP_INSERT_SKIP_WAL)
+	if (options & (HEAP_INSERT_SKIP_WAL | HEAP_INSERT_DIRECT))
 		heap_sync(relation);
 }
 
@@ -604,6 +606,10 @@ heapam_relation_set_new_filenode(Relation rel,
 
 	srel = RelationCreateStorage(*newrnode, persistence);
 
+	/* this session's copy of a global temp table tracks them privately */
+	if (persistence == RELPERSISTENCE_GLOBAL_TEMP)
+		RelationSetLocalFrozenXids(*newrnode, *freezeXid, *minmulti);
+
 	/*
 	 * If required, set up an init fork for an unlogged table so that it can
 	 * be correctly reinitialized on restart.  An immediate sync is required
@@ -2251,10 +2257,18 @@ heapam_scan_bitmap_next_block(TableScanDesc scan,
 		/*
 		 * Bitmap is lossy, so we must examine each line pointer on the page.
 		 * But we can ignore HOT chains, since we'll check each tuple anyway.
+		 *
+		 * If the page is all-visible, every normal tuple on it is visible to
+		 * us, so skip the per-tuple visibility checks, as heapgetpage() does.
+		 * We still have to return each tuple, though, because a lossy page
+		 * always needs the bitmap quals rechecked.
 		 */
 		Page		dp = (Page) BufferGetPage(buffer);
 		OffsetNumber maxoff = PageGetMaxOffsetNumber(dp);
 		OffsetNumber offnum;
+		bool		all_visible;
+
+		all_visible = PageIsAllVisible(dp) && !snapshot->takenDuringRecovery;
 
 		for (offnum = FirstOffsetNumber; offnum <= maxoff; offnum = OffsetNumberNext(offnum))
 		{
@@ -2269,7 +2283,10 @@ heapam_scan_bitmap_next_block(TableScanDesc scan,
 			loctup.t_len = ItemIdGetLength(lp);
 			loctup.t_tableOid = scan->rs_rd->rd_id;
 			ItemPointerSet(&loctup.t_self, page, offnum);
-			valid = HeapTupleSatisfiesVisibility(&loctup, snapshot, buffer);
+			if (all_visible)
+				valid = true;
+			else
+				valid = HeapTupleSatisfiesVisibility(&loctup, snapshot, buffer);
 			if (valid)
 			{
 				hscan->rs_vistuples[ntup++] = offnum;
@@ -2609,6 +2626,8 @@ static const TableAmRoutine heapam_methods = {
 	.scan_end = heap_endscan,
 	.scan_rescan = heap_rescan,
 	.scan_getnextslot = heap_getnextslot,
+	.scan_set_tidrange = heap_set_tidrange,
+	.scan_getnextslot_tidrange = heap_getnextslot_tidrange,
 
 	.parallelscan_estimate = table_block_parallelscan_estimate,
 	.parallelscan_initialize = table_block_parallelscan_initialize,
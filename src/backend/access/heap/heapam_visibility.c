@@ -78,6 +78,17 @@
 #include "utils/snapmgr.h"
 
 
+/* GUC variable */
+bool		defer_hint_bit_writes = false;
+
+/*
+ * Buffer whose tuples are being checked between HeapBeginHintBatch() and
+ * HeapEndHintBatch(), and whether we have set any hint bits on it.
+ */
+static Buffer hintBatchBuffer = InvalidBuffer;
+static bool hintBatchDirty = false;
+
+
 /*
  * SetHintBits()
  *
@@ -127,7 +138,51 @@ SetHintBits(HeapTupleHeader tuple, Buffer buffer,
 	}
 
 	tuple->t_infomask |= infomask;
-	MarkBufferDirtyHint(buffer, true);
+
+	/* In a batch, the buffer is marked dirty once at the end */
+	if (buffer == hintBatchBuffer)
+		hintBatchDirty = true;
+	else
+		MarkBufferDirtyHint(buffer, true);
+}
+
+/*
+ * HeapBeginHintBatch --- start checking the visibility of many tuples on
+ * one page
+ *
+ * Until the matching HeapEndHintBatch() call, SetHintBits() doesn't mark the
+ * buffer dirty for each tuple but just remembers to do it at the end.  The
+ * caller must hold at least a share lock on the buffer throughout.
+ *
+ * If an error is thrown in between, the next batch resets the state.  Until
+ * then, hint bits set on the same buffer might not be written out, which is
+ * harmless.
+ */
+void
+HeapBeginHintBatch(Buffer buffer)
+{
+	hintBatchBuffer = buffer;
+	hintBatchDirty = false;
+}
+
+/*
+ * HeapEndHintBatch --- finish a batch started by HeapBeginHintBatch
+ *
+ * If defer_hint_bit_writes is on, the hint bits are left in the buffer
+ * without marking it dirty.  They will reach disk if the page is written
+ * for some other reason, and are otherwise set again by some later scan or
+ * VACUUM.  This avoids writing out (and, with checksums, WAL-logging) pages
+ * just because a scan set hint bits on them, for example when a bulk-loaded
+ * table is read for the first time, or on a hot standby.
+ */
+void
+HeapEndHintBatch(void)
+{
+	if (hintBatchDirty && !defer_hint_bit_writes)
+		MarkBufferDirtyHint(hintBatchBuffer, true);
+
+	hintBatchBuffer = InvalidBuffer;
+	hintBatchDirty = false;
 }
 
 /*
@@ -19,10 +19,32 @@
 #include "access/hio.h"
 #include "access/htup_details.h"
 #include "access/visibilitymap.h"
+#include "access/xloginsert.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
 #include "storage/smgr.h"
+#include "utils/memutils.h"
+
+/* GUC variable */
+bool		adaptive_fillfactor = true;
+
+/*
+ * Number of updates rd_update_spill is averaged over, and the most space
+ * that adaptive_fillfactor will reserve on a page, in percent.
+ */
+#define UPDATE_SPILL_SAMPLES		64
+#define ADAPTIVE_MAX_FREE_PERCENT	30
+
+
+/*
+ * Number of pages built in private memory before HEAP_INSERT_DIRECT writes
+ * them out.  This is also the number of page images that fit in one WAL
+ * record.
+ */
+#define DIRECT_RUN_PAGES	XLR_MAX_BLOCK_ID
+
+static void RelationWriteDirectRun(BulkInsertState bistate);
 
 
 /*
@@ -183,12 +205,13 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
  * the result to some sane overall value.
  */
 static void
-RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
+RelationAddExtraBlocks(Relation relation)
 {
 	BlockNumber blockNum,
-				firstBlock = InvalidBlockNumber;
+				firstBlock;
 	int			extraBlocks;
 	int			lockWaiters;
+	Size		freespace;
 
 	/* Use the length of the lock wait queue to judge how much to extend. */
 	lockWaiters = RelationExtensionLockWaiterCount(relation);
@@ -203,53 +226,27 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 */
 	extraBlocks = Min(512, lockWaiters * 20);
 
-	do
-	{
-		Buffer		buffer;
-		Page		page;
-		Size		freespace;
-
-		/*
-		 * Extend by one page.  This should generally match the main-line
-		 * extension code in RelationGetBufferForTuple, except that we hold
-		 * the relation extension lock throughout, and we don't immediately
-		 * initialize the page (see below).
-		 */
-		buffer = ReadBufferBI(relation, P_NEW, RBM_ZERO_AND_LOCK, bistate);
-		page = BufferGetPage(buffer);
-
-		if (!PageIsNew(page))
-			elog(ERROR, "page %u of relation \"%s\" should be empty but is not",
-				 BufferGetBlockNumber(buffer),
-				 RelationGetRelationName(relation));
-
-		/*
-		 * Add the page to the FSM without initializing. If we were to
-		 * initialize here, the page would potentially get flushed out to disk
-		 * before we add any useful content. There's no guarantee that that'd
-		 * happen before a potential crash, so we need to deal with
-		 * uninitialized pages anyway, thus avoid the potential for
-		 * unnecessary writes.
-		 */
-
-		/* we'll need this info below */
-		blockNum = BufferGetBlockNumber(buffer);
-		freespace = BufferGetPageSize(buffer) - SizeOfPageHeaderData;
-
-		UnlockReleaseBuffer(buffer);
-
-		/* Remember first block number thus added. */
-		if (firstBlock == InvalidBlockNumber)
-			firstBlock = blockNum;
+	/*
+	 * Extend the file by all of the blocks in one go.  We don't read the new
+	 * pages into shared buffers, nor initialize them: if we were to, the
+	 * pages would potentially get flushed out to disk before we add any
+	 * useful content.  There's no guarantee that that'd happen before a
+	 * potential crash, so we need to deal with uninitialized pages anyway,
+	 * thus avoid the potential for unnecessary writes.
+	 */
+	RelationOpenSmgr(relation);
+	firstBlock = smgrnblocks(relation->rd_smgr, MAIN_FORKNUM);
+	smgrzeroextend(relation->rd_smgr, MAIN_FORKNUM, firstBlock, extraBlocks,
+				   false);
 
-		/*
-		 * Immediately update the bottom level of the FSM.  This has a good
-		 * chance of making this page visible to other concurrently inserting
-		 * backends, and we want that to happen without delay.
-		 */
+	/*
+	 * Immediately update the bottom level of the FSM.  This has a good chance
+	 * of making the pages visible to other concurrently inserting backends,
+	 * and we want that to happen without delay.
+	 */
+	freespace = BLCKSZ - SizeOfPageHeaderData;
+	for (blockNum = firstBlock; blockNum < firstBlock + extraBlocks; blockNum++)
 		RecordPageWithFreeSpace(relation, blockNum, freespace);
-	}
-	while (--extraBlocks > 0);
 
 	/*
 	 * Updating the upper levels of the free space map is too expensive to do
@@ -257,7 +254,7 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 * subsequent insertion activity sees all of those nifty free pages we
 	 * just inserted.
 	 */
-	FreeSpaceMapVacuumRange(relation, firstBlock, blockNum + 1);
+	FreeSpaceMapVacuumRange(relation, firstBlock, firstBlock + extraBlocks);
 }
 
 /*
@@ -348,6 +345,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	/* Compute desired extra freespace due to fillfactor option */
 	saveFreeSpace = RelationGetTargetPageFreeSpace(relation,
 												   HEAP_DEFAULT_FILLFACTOR);
+	saveFreeSpace = Max(saveFreeSpace, RelationGetAdaptiveFreeSpace(relation));
 
 	if (otherBuffer != InvalidBuffer)
 		otherBlock = BufferGetBlockNumber(otherBuffer);
@@ -578,7 +576,7 @@ loop:
 			}
 
 			/* Time to bulk-extend. */
-			RelationAddExtraBlocks(relation, bistate);
+			RelationAddExtraBlocks(relation);
 		}
 	}
 
@@ -672,3 +670,215 @@ loop:
 
 	return buffer;
 }
+
+/*
+ * RelationPutHeapTuplesDirect - place tuples on privately built pages
+ *
+ * This is the HEAP_INSERT_DIRECT counterpart of RelationGetBufferForTuple()
+ * and RelationPutHeapTuple().  Rather than going through shared buffers, the
+ * tuples are added to a run of pages kept in the bulk insert state, which is
+ * appended to the relation with smgrextend() once it is full.  Block numbers
+ * are assigned as each page is started, so the tuples' t_self are valid on
+ * return, but nobody can read the tuples until the pages have been written
+ * out; see RelationFlushDirectPages().
+ *
+ * All of this is only safe if no other backend can see the relation, that
+ * is, if it was created or truncated in the current transaction, and if
+ * nothing else extends it while the load is in progress.
+ */
+void
+RelationPutHeapTuplesDirect(Relation relation, HeapTuple *tuples, int ntuples,
+							int options, BulkInsertState bistate)
+{
+	Size		saveFreeSpace;
+	int			i;
+
+	if (bistate->direct_pages == NULL)
+	{
+		/* The pages must outlive the caller's per-batch memory context */
+		bistate->direct_rel = relation;
+		bistate->direct_pages =
+			MemoryContextAlloc(GetMemoryChunkContext(bistate),
+							   DIRECT_RUN_PAGES * BLCKSZ);
+		bistate->direct_npages = 0;
+		bistate->direct_runblk = InvalidBlockNumber;
+		bistate->direct_startblk = InvalidBlockNumber;
+		bistate->direct_needwal = !(options & HEAP_INSERT_SKIP_WAL) &&
+			RelationNeedsWAL(relation);
+		bistate->direct_frozen = (options & HEAP_INSERT_FROZEN) != 0;
+	}
+	Assert(bistate->direct_rel == relation);
+
+	/* Compute desired extra freespace due to fillfactor option */
+	saveFreeSpace = RelationGetTargetPageFreeSpace(relation,
+												   HEAP_DEFAULT_FILLFACTOR);
+
+	for (i = 0; i < ntuples; i++)
+	{
+		HeapTuple	tuple = tuples[i];
+		Size		len = MAXALIGN(tuple->t_len);
+		Page		page = NULL;
+		BlockNumber blkno;
+		OffsetNumber offnum;
+		ItemId		itemId;
+		HeapTupleHeader item;
+
+		if (len > MaxHeapTupleSize)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+					 errmsg("row is too big: size %zu, maximum size %zu",
+							len, MaxHeapTupleSize)));
+
+		if (bistate->direct_npages > 0)
+			page = bistate->direct_pages +
+				(bistate->direct_npages - 1) * BLCKSZ;
+
+		/*
+		 * Start a new page if the current one is too full.  A tuple always
+		 * fits on an empty page, fillfactor or not.
+		 */
+		if (page == NULL ||
+			(!PageIsEmpty(page) &&
+			 PageGetHeapFreeSpace(page) < len + saveFreeSpace))
+		{
+			if (bistate->direct_npages == DIRECT_RUN_PAGES)
+				RelationWriteDirectRun(bistate);
+
+			if (bistate->direct_npages == 0)
+			{
+				bistate->direct_runblk = RelationGetNumberOfBlocks(relation);
+				if (bistate->direct_startblk == InvalidBlockNumber)
+					bistate->direct_startblk = bistate->direct_runblk;
+			}
+
+			page = bistate->direct_pages + bistate->direct_npages * BLCKSZ;
+			PageInit(page, BLCKSZ, 0);
+			if (bistate->direct_frozen)
+				PageSetAllVisible(page);
+			bistate->direct_npages++;
+		}
+		blkno = bistate->direct_runblk + bistate->direct_npages - 1;
+
+		offnum = PageAddItem(page, (Item) tuple->t_data,
+							 tuple->t_len, InvalidOffsetNumber, false, true);
+
+		if (offnum == InvalidOffsetNumber)
+			elog(ERROR, "failed to add tuple to page");
+
+		/* Update tuple->t_self to the actual position where it was stored */
+		ItemPointerSet(&(tuple->t_self), blkno, offnum);
+
+		/* Insert the correct position into CTID of the stored tuple, too */
+		itemId = PageGetItemId(page, offnum);
+		item = (HeapTupleHeader) PageGetItem(page, itemId);
+		item->t_ctid = tuple->t_self;
+	}
+}
+
+/*
+ * RelationWriteDirectRun - write out the run of privately built pages
+ *
+ * The pages are WAL-logged as full-page images, if needed, and appended to
+ * the relation.  We don't register them for fsync at checkpoint; the caller
+ * has to sync the relation before commit, as heap_sync() does, because a
+ * checkpoint occurring after the WAL record has no way to flush the pages.
+ */
+static void
+RelationWriteDirectRun(BulkInsertState bistate)
+{
+	Relation	relation = bistate->direct_rel;
+	BlockNumber blknos[DIRECT_RUN_PAGES];
+	Page		pages[DIRECT_RUN_PAGES];
+	int			npages = bistate->direct_npages;
+	int			i;
+
+	RelationOpenSmgr(relation);
+
+	/* Make sure nobody has extended the relation behind our back */
+	if (smgrnblocks(relation->rd_smgr, MAIN_FORKNUM) != bistate->direct_runblk)
+		elog(ERROR, "relation \"%s\" was extended during a direct load",
+			 RelationGetRelationName(relation));
+
+	for (i = 0; i < npages; i++)
+	{
+		blknos[i] = bistate->direct_runblk + i;
+		pages[i] = bistate->direct_pages + i * BLCKSZ;
+	}
+
+	if (bistate->direct_needwal)
+		log_newpages(&relation->rd_node, MAIN_FORKNUM, npages,
+					 blknos, pages, true);
+
+	for (i = 0; i < npages; i++)
+	{
+		PageSetChecksumInplace(pages[i], blknos[i]);
+		smgrextend(relation->rd_smgr, MAIN_FORKNUM, blknos[i],
+				   (char *) pages[i], true);
+	}
+
+	bistate->direct_runblk += npages;
+	bistate->direct_npages = 0;
+}
+
+/*
+ * RelationFlushDirectPages - finish writing pages built by HEAP_INSERT_DIRECT
+ *
+ * Writes out the partially filled run, if any, and for a frozen load sets the
+ * visibility map bits of all the pages written since the last call.  After
+ * this, the tuples can be read back through shared buffers as usual.
+ */
+void
+RelationFlushDirectPages(BulkInsertState bistate)
+{
+	if (bistate->direct_pages == NULL)
+		return;
+
+	if (bistate->direct_npages > 0)
+		RelationWriteDirectRun(bistate);
+
+	if (bistate->direct_frozen &&
+		bistate->direct_startblk != InvalidBlockNumber)
+		visibilitymap_set_range(bistate->direct_rel,
+								bistate->direct_startblk,
+								bistate->direct_runblk,
+								VISIBILITYMAP_ALL_VISIBLE |
+								VISIBILITYMAP_ALL_FROZEN);
+
+	bistate->direct_startblk = InvalidBlockNumber;
+}
+
+/*
+ * RelationRecordUpdatePlacement -- note where heap_update put a new version
+ *
+ * samepage is true if the new tuple version went on the same page as the old
+ * one.  Updates that have to move to another page can't be HOT, so if that
+ * happens a lot, RelationGetAdaptiveFreeSpace() makes us leave more room on
+ * pages as we fill them, much as if fillfactor had been lowered.
+ */
+void
+RelationRecordUpdatePlacement(Relation relation, bool samepage)
+{
+	float4		sample = samepage ? 0.0 : 1.0;
+
+	relation->rd_update_spill +=
+		(sample - relation->rd_update_spill) / UPDATE_SPILL_SAMPLES;
+}
+
+/*
+ * RelationGetAdaptiveFreeSpace
+ *		Returns the free space to leave on each page of a heap relation to
+ *		make room for updates, according to its recent update history.
+ *
+ * Relations whose updates don't move to other pages get no extra space; the
+ * more of them do, the more is reserved, up to ADAPTIVE_MAX_FREE_PERCENT of
+ * the page.  Like fillfactor, this only affects where new tuples are put.
+ */
+Size
+RelationGetAdaptiveFreeSpace(Relation relation)
+{
+	if (!adaptive_fillfactor)
+		return 0;
+
+	return (Size) (relation->rd_update_spill *
+				   (BLCKSZ * ADAPTIVE_MAX_FREE_PERCENT / 100));
+}
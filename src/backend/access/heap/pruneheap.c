@@ -16,16 +16,30 @@
 
 #include "access/heapam.h"
 #include "access/heapam_xlog.h"
+#include "access/hio.h"
+#include "access/relation.h"
 #include "access/transam.h"
 #include "access/htup_details.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
+#include "storage/procarray.h"
 #include "utils/snapmgr.h"
 #include "utils/rel.h"
 
+/* GUC variable */
+bool		deferred_page_pruning = true;
+
+/*
+ * How often, and how long between attempts, a deferred prune tries to get
+ * the cleanup lock before giving up on the page.
+ */
+#define DEFERRED_PRUNE_LOCK_ATTEMPTS	50
+#define DEFERRED_PRUNE_LOCK_WAIT_USEC	10000L
+
 /* Working data for heap_page_prune and subroutines */
 typedef struct
 {
@@ -52,6 +66,7 @@ static void heap_prune_record_redirect(PruneState *prstate,
 									   OffsetNumber offnum, OffsetNumber rdoffnum);
 static void heap_prune_record_dead(PruneState *prstate, OffsetNumber offnum);
 static void heap_prune_record_unused(PruneState *prstate, OffsetNumber offnum);
+static void heap_page_prune_defer(Relation relation, Buffer buffer);
 
 
 /*
@@ -59,7 +74,8 @@ static void heap_prune_record_unused(PruneState *prstate, OffsetNumber offnum);
  *
  * This is an opportunistic function.  It will perform housekeeping
  * only if the page heuristically looks like a candidate for pruning and we
- * can acquire buffer cleanup lock without blocking.
+ * can acquire buffer cleanup lock without blocking.  If the lock isn't
+ * available, the page is handed to autovacuum to be pruned later.
  *
  * Note: this is called quite often.  It's important that it fall out quickly
  * if there's not any use in pruning.
@@ -131,13 +147,22 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 	 */
 	minfree = RelationGetTargetPageFreeSpace(relation,
 											 HEAP_DEFAULT_FILLFACTOR);
+	minfree = Max(minfree, RelationGetAdaptiveFreeSpace(relation));
 	minfree = Max(minfree, BLCKSZ / 10);
 
 	if (PageIsFull(page) || PageGetHeapFreeSpace(page) < minfree)
 	{
-		/* OK, try to get exclusive buffer lock */
+		/*
+		 * OK, try to get exclusive buffer lock.  On a page that is busy
+		 * enough for that to fail, it's likely to keep failing for every
+		 * reader, so rather than leave the page unpruned, ask for it to be
+		 * pruned in the background.
+		 */
 		if (!ConditionalLockBufferForCleanup(buffer))
+		{
+			heap_page_prune_defer(relation, buffer);
 			return;
+		}
 
 		/*
 		 * Now that we have buffer lock, get accurate information about the
@@ -159,6 +184,104 @@ heap_page_prune_opt(Relation relation, Buffer buffer)
 	}
 }
 
+/*
+ * heap_page_prune_defer -- queue a page we couldn't prune for autovacuum
+ *
+ * Each backend remembers the last page it queued, so that readers of a hot
+ * page don't all keep taking AutovacuumLock; AutoVacuumRequestWork() weeds
+ * out the remaining duplicates.  Pruning requests may only fill part of the
+ * work item list, so as not to crowd out other kinds of work; beyond that,
+ * the request is simply dropped, and a later reader or VACUUM will get to
+ * the page.
+ */
+static void
+heap_page_prune_defer(Relation relation, Buffer buffer)
+{
+	static Oid	last_relid = InvalidOid;
+	static BlockNumber last_blkno = InvalidBlockNumber;
+	BlockNumber blkno;
+
+	/* autovacuum can't see other sessions' temporary tables */
+	if (!deferred_page_pruning || !AutoVacuumingActive() ||
+		RELATION_IS_LOCAL(relation) ||
+		relation->rd_rel->relpersistence == RELPERSISTENCE_TEMP)
+		return;
+
+	blkno = BufferGetBlockNumber(buffer);
+	if (RelationGetRelid(relation) == last_relid && blkno == last_blkno)
+		return;
+
+	last_relid = RelationGetRelid(relation);
+	last_blkno = blkno;
+
+	(void) AutoVacuumRequestWork(AVW_HeapPrunePage,
+								 RelationGetRelid(relation), blkno);
+}
+
+/*
+ * heap_page_prune_deferred -- prune a page queued by heap_page_prune_defer
+ *
+ * Called by autovacuum.  Unlike the reader that queued the page, we can
+ * afford to wait a little for the cleanup lock, retrying for up to half a
+ * second, but we don't use LockBufferForCleanup(): only one process at a
+ * time may wait that way, and VACUUM might want to.  We don't keep the page
+ * pinned between attempts either, since our pin would get in the way of
+ * anyone else wanting a cleanup lock on it.
+ */
+void
+heap_page_prune_deferred(Oid relid, BlockNumber blkno)
+{
+	Relation	relation;
+	Buffer		buffer;
+	TransactionId OldestXmin;
+	int			attempt;
+
+	relation = try_relation_open(relid, AccessShareLock);
+	if (relation == NULL)
+		return;
+
+	if (relation->rd_rel->relkind != RELKIND_RELATION &&
+		relation->rd_rel->relkind != RELKIND_MATVIEW &&
+		relation->rd_rel->relkind != RELKIND_TOASTVALUE)
+	{
+		relation_close(relation, AccessShareLock);
+		return;
+	}
+
+	/* The relation might have been truncated since the request was made */
+	if (blkno >= RelationGetNumberOfBlocks(relation))
+	{
+		relation_close(relation, AccessShareLock);
+		return;
+	}
+
+	OldestXmin = GetOldestXmin(relation, PROCARRAY_FLAGS_VACUUM);
+
+	for (attempt = 0; attempt < DEFERRED_PRUNE_LOCK_ATTEMPTS; attempt++)
+	{
+		buffer = ReadBuffer(relation, blkno);
+
+		if (ConditionalLockBufferForCleanup(buffer))
+		{
+			TransactionId ignore = InvalidTransactionId;
+
+			if (PageIsPrunable(BufferGetPage(buffer), OldestXmin))
+				(void) heap_page_prune(relation, buffer, OldestXmin, true,
+									   &ignore);
+
+			UnlockReleaseBuffer(buffer);
+			break;
+		}
+
+		ReleaseBuffer(buffer);
+
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(DEFERRED_PRUNE_LOCK_WAIT_USEC);
+	}
+
+	relation_close(relation, AccessShareLock);
+}
+
 
 /*
  * Prune and repair fragmentation in the specified page.
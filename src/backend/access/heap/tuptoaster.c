@@ -35,6 +35,7 @@
 #include "access/tuptoaster.h"
 #include "access/xact.h"
 #include "catalog/catalog.h"
+#include "common/int.h"
 #include "common/pg_lzcompress.h"
 #include "miscadmin.h"
 #include "utils/expandeddatum.h"
@@ -52,7 +53,8 @@
 typedef struct toast_compress_header
 {
 	int32		vl_len_;		/* varlena header (do not touch directly!) */
-	int32		rawsize;
+	uint32		tcinfo;			/* 2 bits for compression method and 30 bits
+								 * for raw size */
 } toast_compress_header;
 
 /*
@@ -60,11 +62,18 @@ typedef struct toast_compress_header
  * toast entries.
  */
 #define TOAST_COMPRESS_HDRSZ		((int32) sizeof(toast_compress_header))
-#define TOAST_COMPRESS_RAWSIZE(ptr) (((toast_compress_header *) (ptr))->rawsize)
+#define TOAST_COMPRESS_RAWSIZE(ptr) \
+	(((toast_compress_header *) (ptr))->tcinfo & VARLENA_RAWSIZE_MASK)
+#define TOAST_COMPRESS_METHOD(ptr) \
+	(((toast_compress_header *) (ptr))->tcinfo >> VARLENA_RAWSIZE_BITS)
 #define TOAST_COMPRESS_RAWDATA(ptr) \
 	(((char *) (ptr)) + TOAST_COMPRESS_HDRSZ)
-#define TOAST_COMPRESS_SET_RAWSIZE(ptr, len) \
-	(((toast_compress_header *) (ptr))->rawsize = (len))
+#define TOAST_COMPRESS_SET_SIZE_AND_METHOD(ptr, len, cm_id) \
+	do { \
+		Assert((len) > 0 && (len) <= VARLENA_RAWSIZE_MASK); \
+		((toast_compress_header *) (ptr))->tcinfo = \
+			(len) | ((uint32) (cm_id) << VARLENA_RAWSIZE_BITS); \
+	} while (0)
 
 static void toast_delete_datum(Relation rel, Datum value, bool is_speculative);
 static Datum toast_save_datum(Relation rel, Datum value,
@@ -262,6 +271,15 @@ heap_tuple_untoast_attr_slice(struct varlena *attr,
 	struct varlena *result;
 	char	   *attrdata;
 	int32		attrsize;
+	int32		slicelimit;
+
+	/*
+	 * Compute the end of the slice, or -1 if we need everything after the
+	 * offset anyway.
+	 */
+	if (sliceoffset < 0 || slicelength < 0 ||
+		pg_add_s32_overflow(sliceoffset, slicelength, &slicelimit))
+		slicelimit = -1;
 
 	if (VARATT_IS_EXTERNAL_ONDISK(attr))
 	{
@@ -273,8 +291,23 @@ heap_tuple_untoast_attr_slice(struct varlena *attr,
 		if (!VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
 			return toast_fetch_datum_slice(attr, sliceoffset, slicelength);
 
-		/* fetch it back (compressed marker will get set automatically) */
-		preslice = toast_fetch_datum(attr);
+		/*
+		 * Fetch it back (compressed marker will get set automatically).  If
+		 * only a prefix of the uncompressed data is wanted, we only need the
+		 * part of the compressed data that can decompress to it, which for a
+		 * small slice of a large value saves reading most of its chunks.
+		 */
+		if (slicelimit > 0)
+		{
+			int32		hdrsz = TOAST_COMPRESS_HDRSZ - VARHDRSZ;
+			int32		max_size;
+
+			max_size = pglz_maximum_compressed_size(slicelimit,
+													toast_pointer.va_extsize - hdrsz);
+			preslice = toast_fetch_datum_slice(attr, 0, max_size + hdrsz);
+		}
+		else
+			preslice = toast_fetch_datum(attr);
 	}
 	else if (VARATT_IS_EXTERNAL_INDIRECT(attr))
 	{
@@ -303,8 +336,8 @@ heap_tuple_untoast_attr_slice(struct varlena *attr,
 		struct varlena *tmp = preslice;
 
 		/* Decompress enough to encompass the slice and the offset */
-		if (slicelength > 0 && sliceoffset >= 0)
-			preslice = toast_decompress_datum_slice(tmp, slicelength + sliceoffset);
+		if (slicelimit > 0)
+			preslice = toast_decompress_datum_slice(tmp, slicelimit);
 		else
 			preslice = toast_decompress_datum(tmp);
 
@@ -775,7 +808,8 @@ toast_insert_or_update(Relation rel, HeapTuple newtup, HeapTuple oldtup,
 		if (TupleDescAttr(tupleDesc, i)->attstorage == 'x')
 		{
 			old_value = toast_values[i];
-			new_value = toast_compress_datum(old_value);
+			new_value = toast_compress_datum(old_value,
+											 TupleDescAttr(tupleDesc, i)->attcompression);
 
 			if (DatumGetPointer(new_value) != NULL)
 			{
@@ -916,7 +950,8 @@ toast_insert_or_update(Relation rel, HeapTuple newtup, HeapTuple oldtup,
 		 */
 		i = biggest_attno;
 		old_value = toast_values[i];
-		new_value = toast_compress_datum(old_value);
+		new_value = toast_compress_datum(old_value,
+										 TupleDescAttr(tupleDesc, i)->attcompression);
 
 		if (DatumGetPointer(new_value) != NULL)
 		{
@@ -1356,10 +1391,15 @@ toast_build_flattened_tuple(TupleDesc tupleDesc,
  *
  *	We use VAR{SIZE,DATA}_ANY so we can handle short varlenas here without
  *	copying them.  But we can't handle external or compressed datums.
+ *
+ *	cmethod is the column's attcompression; if it isn't set, the default
+ *	compression method is used.  The method is recorded in the compressed
+ *	datum's header, so that it can be decompressed regardless of what the
+ *	column's setting is by then.
  * ----------
  */
 Datum
-toast_compress_datum(Datum value)
+toast_compress_datum(Datum value, char cmethod)
 {
 	struct varlena *tmp;
 	int32		valsize = VARSIZE_ANY_EXHDR(DatumGetPointer(value));
@@ -1368,6 +1408,12 @@ toast_compress_datum(Datum value)
 	Assert(!VARATT_IS_EXTERNAL(DatumGetPointer(value)));
 	Assert(!VARATT_IS_COMPRESSED(DatumGetPointer(value)));
 
+	if (!CompressionMethodIsValid(cmethod))
+		cmethod = DefaultCompressionMethod;
+
+	/* pglz is currently the only compression method */
+	Assert(cmethod == ATTRIBUTE_COMPRESSION_PGLZ);
+
 	/*
 	 * No point in wasting a palloc cycle if value size is out of the allowed
 	 * range for compression
@@ -1396,7 +1442,8 @@ toast_compress_datum(Datum value)
 	if (len >= 0 &&
 		len + TOAST_COMPRESS_HDRSZ < valsize - 2)
 	{
-		TOAST_COMPRESS_SET_RAWSIZE(tmp, valsize);
+		TOAST_COMPRESS_SET_SIZE_AND_METHOD(tmp, valsize,
+										   TOAST_PGLZ_COMPRESSION_ID);
 		SET_VARSIZE_COMPRESSED(tmp, len + TOAST_COMPRESS_HDRSZ);
 		/* successful compression */
 		return PointerGetDatum(tmp);
@@ -1410,6 +1457,91 @@ toast_compress_datum(Datum value)
 }
 
 
+/* ----------
+ * toast_get_compression_method -
+ *
+ *	Return the compression method (as an attcompression value) that was
+ *	used to compress a varlena datum, or '\0' if it isn't compressed.
+ *	For an external compressed datum, the value has to be fetched to look
+ *	at its header.
+ * ----------
+ */
+char
+toast_get_compression_method(struct varlena *attr)
+{
+	struct varlena *tmp = NULL;
+	uint32		cm_id;
+
+	if (VARATT_IS_EXTERNAL_ONDISK(attr))
+	{
+		struct varatt_external toast_pointer;
+
+		VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+		if (!VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
+			return '\0';
+		attr = tmp = toast_fetch_datum(attr);
+	}
+	else if (!VARATT_IS_COMPRESSED(attr))
+		return '\0';
+
+	cm_id = TOAST_COMPRESS_METHOD(attr);
+
+	if (tmp)
+		pfree(tmp);
+
+	switch (cm_id)
+	{
+		case TOAST_PGLZ_COMPRESSION_ID:
+			return ATTRIBUTE_COMPRESSION_PGLZ;
+		default:
+			elog(ERROR, "invalid compression method id %d", cm_id);
+	}
+
+	return '\0';				/* keep compiler quiet */
+}
+
+/* ----------
+ * GetCompressionMethod -
+ *
+ *	Look up a compression method by name, as given in CREATE TABLE or
+ *	ALTER TABLE ... SET COMPRESSION.
+ * ----------
+ */
+char
+GetCompressionMethod(const char *name)
+{
+	if (strcmp(name, "pglz") == 0)
+		return ATTRIBUTE_COMPRESSION_PGLZ;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("invalid compression method \"%s\"", name)));
+	return '\0';				/* keep compiler quiet */
+}
+
+/* ----------
+ * GetCompressionMethodName -
+ *
+ *	Return the name of a compression method, or NULL if it isn't set.
+ * ----------
+ */
+const char *
+GetCompressionMethodName(char cmethod)
+{
+	switch (cmethod)
+	{
+		case ATTRIBUTE_COMPRESSION_PGLZ:
+			return "pglz";
+		case '\0':
+			return NULL;
+		default:
+			elog(ERROR, "invalid compression method %c", cmethod);
+	}
+
+	return NULL;				/* keep compiler quiet */
+}
+
+
 /* ----------
  * toast_get_valid_index
  *
@@ -2072,10 +2204,12 @@ toast_fetch_datum_slice(struct varlena *attr, int32 sliceoffset, int32 length)
 	VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
 
 	/*
-	 * It's nonsense to fetch slices of a compressed datum -- this isn't lo_*
-	 * we can't return a compressed datum which is meaningful to toast later
+	 * It's nonsense to fetch slices of a compressed datum, except for a
+	 * prefix -- this isn't lo_* we can't return a compressed datum which is
+	 * meaningful to toast later.  A prefix can still be decompressed as far
+	 * as it goes.
 	 */
-	Assert(!VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer));
+	Assert(!VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer) || sliceoffset == 0);
 
 	attrsize = toast_pointer.va_extsize;
 	totalchunks = ((attrsize - 1) / TOAST_MAX_CHUNK_SIZE) + 1;
@@ -2091,7 +2225,10 @@ toast_fetch_datum_slice(struct varlena *attr, int32 sliceoffset, int32 length)
 
 	result = (struct varlena *) palloc(length + VARHDRSZ);
 
-	SET_VARSIZE(result, length + VARHDRSZ);
+	if (VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer))
+		SET_VARSIZE_COMPRESSED(result, length + VARHDRSZ);
+	else
+		SET_VARSIZE(result, length + VARHDRSZ);
 
 	if (length == 0)
 		return result;			/* Can save a lot of work at this point! */
@@ -2274,11 +2411,19 @@ toast_decompress_datum(struct varlena *attr)
 		palloc(TOAST_COMPRESS_RAWSIZE(attr) + VARHDRSZ);
 	SET_VARSIZE(result, TOAST_COMPRESS_RAWSIZE(attr) + VARHDRSZ);
 
-	if (pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
-						VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
-						VARDATA(result),
-						TOAST_COMPRESS_RAWSIZE(attr), true) < 0)
-		elog(ERROR, "compressed data is corrupted");
+	switch (TOAST_COMPRESS_METHOD(attr))
+	{
+		case TOAST_PGLZ_COMPRESSION_ID:
+			if (pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
+								VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
+								VARDATA(result),
+								TOAST_COMPRESS_RAWSIZE(attr), true) < 0)
+				elog(ERROR, "compressed data is corrupted");
+			break;
+		default:
+			elog(ERROR, "invalid compression method id %d",
+				 TOAST_COMPRESS_METHOD(attr));
+	}
 
 	return result;
 }
@@ -2301,12 +2446,21 @@ toast_decompress_datum_slice(struct varlena *attr, int32 slicelength)
 
 	result = (struct varlena *) palloc(slicelength + VARHDRSZ);
 
-	rawsize = pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
-							  VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
-							  VARDATA(result),
-							  slicelength, false);
-	if (rawsize < 0)
-		elog(ERROR, "compressed data is corrupted");
+	switch (TOAST_COMPRESS_METHOD(attr))
+	{
+		case TOAST_PGLZ_COMPRESSION_ID:
+			rawsize = pglz_decompress(TOAST_COMPRESS_RAWDATA(attr),
+									  VARSIZE(attr) - TOAST_COMPRESS_HDRSZ,
+									  VARDATA(result),
+									  slicelength, false);
+			if (rawsize < 0)
+				elog(ERROR, "compressed data is corrupted");
+			break;
+		default:
+			elog(ERROR, "invalid compression method id %d",
+				 TOAST_COMPRESS_METHOD(attr));
+			rawsize = 0;		/* keep compiler quiet */
+	}
 
 	SET_VARSIZE(result, rawsize + VARHDRSZ);
 	return result;
@@ -4,23 +4,39 @@
  *	  Concurrent ("lazy") vacuuming.
  *
  *
- * The major space usage for LAZY VACUUM is storage for the array of dead tuple
- * TIDs.  We want to ensure we can vacuum even the very largest relations with
- * finite memory space usage.  To do that, we set upper bounds on the number of
- * tuples we will keep track of at once.
+ * The major space usage for LAZY VACUUM is storage for the TIDs of dead
+ * tuples.  We want to ensure we can vacuum even the very largest relations
+ * with finite memory space usage.  To do that, we set upper bounds on the
+ * amount of dead tuple information we will keep track of at once.
  *
  * We are willing to use at most maintenance_work_mem (or perhaps
  * autovacuum_work_mem) memory space to keep track of dead tuples.  We
- * initially allocate an array of TIDs of that size, with an upper limit that
- * depends on table size (this limit ensures we don't allocate a huge area
- * uselessly for vacuuming small tables).  If the array threatens to overflow,
- * we suspend the heap scan phase and perform a pass of index cleanup and page
- * compaction, then resume the heap scan with an empty TID array.
+ * initially allocate a dead tuple store of that size, with an upper limit
+ * that depends on table size (this limit ensures we don't allocate a huge
+ * area uselessly for vacuuming small tables).  If the store threatens to
+ * overflow, we suspend the heap scan phase and perform a pass of index
+ * cleanup and page compaction, then resume the heap scan with an empty store.
+ *
+ * The store keeps one entry per heap page having dead tuples, holding their
+ * offset numbers either as a sorted list or as a bitmap, whichever is
+ * smaller.  When many tuples on a page are dead, as is typical after bulk
+ * updates and deletes, the bitmap takes a fraction of the space a TID array
+ * would, so that more dead tuples fit and fewer index passes are needed.
  *
  * If we're processing a table with no indexes, we can just vacuum each page
  * as we go; there's no need to save up multiple tuples to minimize the number
  * of index scans performed.  So we don't use maintenance_work_mem memory for
- * the TID array, just enough to hold as many heap tuples as fit on one page.
+ * the dead tuple store, just enough to hold the dead tuples of one page.
+ *
+ * Lazy vacuum supports parallel vacuuming of indexes.  When the table has
+ * enough indexes that can be vacuumed by parallel workers, we enter parallel
+ * mode and place the dead tuple store, along with the per-index statistics, in a
+ * dynamic shared memory segment at the start of the heap scan.  At each index
+ * vacuuming or cleanup pass, we launch workers which, together with the
+ * leader, vacuum one index at a time until all of them are done.  The heap
+ * itself is always scanned and vacuumed by the leader alone.  Since no
+ * catalog updates are allowed in parallel mode, the index statistics are
+ * written to pg_class only after parallel mode has been exited.
  *
  *
  * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
@@ -36,25 +52,31 @@
 
 #include <math.h>
 
+#include "access/amapi.h"
 #include "access/genam.h"
 #include "access/heapam.h"
 #include "access/heapam_xlog.h"
 #include "access/htup_details.h"
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/transam.h"
 #include "access/visibilitymap.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/storage.h"
 #include "commands/dbcommands.h"
 #include "commands/progress.h"
 #include "commands/vacuum.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
+#include "optimizer/paths.h"
 #include "pgstat.h"
 #include "portability/instr_time.h"
 #include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
+#include "tcop/tcopprot.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
@@ -91,13 +113,6 @@
 #define VACUUM_FSM_EVERY_PAGES \
 	((BlockNumber) (((uint64) 8 * 1024 * 1024 * 1024) / BLCKSZ))
 
-/*
- * Guesstimation of number of dead tuples per page.  This is used to
- * provide an upper limit to memory allocated when vacuuming small
- * tables.
- */
-#define LAZY_ALLOC_TUPLES		MaxHeapTuplesPerPage
-
 /*
  * Before we consider skipping a page that's marked as clean in
  * visibility map, we must've seen at least this many clean pages.
@@ -110,6 +125,120 @@
  */
 #define PREFETCH_SIZE			((BlockNumber) 32)
 
+/* Magic numbers for parallel state sharing */
+#define PARALLEL_VACUUM_KEY_SHARED			UINT64CONST(0xC000000000000001)
+#define PARALLEL_VACUUM_KEY_DEAD_TUPLES		UINT64CONST(0xC000000000000002)
+#define PARALLEL_VACUUM_KEY_QUERY_TEXT		UINT64CONST(0xC000000000000003)
+#define PARALLEL_VACUUM_KEY_BUFFER_USAGE	UINT64CONST(0xC000000000000004)
+#define PARALLEL_VACUUM_KEY_WAL_USAGE		UINT64CONST(0xC000000000000005)
+
+/*
+ * The dead tuples of one heap page.  The page's offset numbers are stored at
+ * 'start' in the data area of the dead tuple store, as an ascending array of
+ * OffsetNumbers, or as a bitmap in which bit (offnum - 1) is set for each
+ * dead tuple, whichever is smaller.  Since a list takes sizeof(OffsetNumber)
+ * bytes per tuple, the data is a bitmap iff it is shorter than that.
+ */
+typedef struct LVDeadBlock
+{
+	BlockNumber blkno;			/* heap page number */
+	uint32		start;			/* offset of the data in the data area */
+	uint16		ntuples;		/* # of dead tuples on the page */
+	uint16		nbytes;			/* length of the data */
+} LVDeadBlock;
+
+#define DeadBlockIsBitmap(blk) \
+	((blk)->nbytes < (blk)->ntuples * sizeof(OffsetNumber))
+
+/*
+ * The most space the dead tuples of one page can take in the store,
+ * including alignment padding of the offset list.
+ */
+#define MaxDeadTupleBytesPerPage \
+	(sizeof(LVDeadBlock) + sizeof(OffsetNumber) + \
+	 MaxHeapTuplesPerPage / BITS_PER_BYTE)
+
+/*
+ * The dead tuples found by the heap scan.  The offset lists and bitmaps of
+ * the pages grow upwards from the start of the data area, and the
+ * LVDeadBlock entries, which are in block number order, grow downwards from
+ * its end; entry 0 is the last one in memory.  This keeps the store in a
+ * single chunk of fixed size, so that in a parallel vacuum it can be placed
+ * in the dynamic shared memory segment, where workers can check index
+ * entries against it.
+ */
+typedef struct LVDeadTuples
+{
+	Size		max_bytes;		/* size of the data area */
+	Size		used_bytes;		/* bytes used by offset lists and bitmaps */
+	int			nblocks;		/* # of LVDeadBlock entries */
+	int64		num_tuples;		/* current # of dead tuples */
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} LVDeadTuples;
+
+#define SizeOfDeadTuples(nbytes) \
+	add_size(offsetof(LVDeadTuples, data), (nbytes))
+
+#define DeadTuplesBlock(dead_tuples, i) \
+	((LVDeadBlock *) ((dead_tuples)->data + (dead_tuples)->max_bytes) - ((i) + 1))
+
+#define DeadTuplesFreeSpace(dead_tuples) \
+	((dead_tuples)->max_bytes - (dead_tuples)->used_bytes - \
+	 (dead_tuples)->nblocks * sizeof(LVDeadBlock))
+
+/*
+ * Per-index state of a parallel vacuum, in the dynamic shared memory
+ * segment.  Once an index AM has returned statistics for the index, they are
+ * kept here, so that whichever process vacuums the index next can pass them
+ * back to the AM.
+ */
+typedef struct LVSharedIndStats
+{
+	bool		parallel;		/* vacuumed by parallel workers? */
+	bool		updated;		/* are the stats valid? */
+	IndexBulkDeleteResult stats;
+} LVSharedIndStats;
+
+/*
+ * Shared state of a parallel vacuum, in the dynamic shared memory segment.
+ */
+typedef struct LVShared
+{
+	/* These fields are not modified during the vacuum */
+	Oid			relid;
+	int			elevel;
+
+	/*
+	 * These are set by the leader before each pass over the indexes:
+	 * for_cleanup tells whether to do bulk deletion of the dead tuples or
+	 * post-vacuum cleanup, and reltuples and estimated_count are the number
+	 * of heap tuples to pass to the index AM and whether it's an estimate.
+	 */
+	bool		for_cleanup;
+	double		reltuples;
+	bool		estimated_count;
+
+	/* The next index to vacuum, shared by all participants */
+	pg_atomic_uint32 idx;
+
+	int			nindexes;
+	LVSharedIndStats indstats[FLEXIBLE_ARRAY_MEMBER];
+} LVShared;
+
+#define SizeOfLVShared(nindexes) \
+	add_size(offsetof(LVShared, indstats), \
+			 mul_size(sizeof(LVSharedIndStats), nindexes))
+
+/* State of a parallel vacuum, in the leader */
+typedef struct LVParallelState
+{
+	ParallelContext *pcxt;
+	LVShared   *lvshared;
+	int			nlaunches;		/* # of passes workers were launched for */
+	BufferUsage *buffer_usage;	/* per-worker buffer usage, in DSM */
+	WalUsage   *wal_usage;		/* per-worker WAL usage, in DSM */
+} LVParallelState;
+
 typedef struct LVRelStats
 {
 	/* useindex = true means two-pass strategy; false means one-pass */
@@ -128,14 +257,14 @@ typedef struct LVRelStats
 	BlockNumber pages_removed;
 	double		tuples_deleted;
 	BlockNumber nonempty_pages; /* actually, last nonempty page + 1 */
-	/* List of TIDs of tuples we intend to delete */
-	/* NB: this list is ordered by TID address */
-	int			num_dead_tuples;	/* current # of entries */
-	int			max_dead_tuples;	/* # slots allocated in array */
-	ItemPointer dead_tuples;	/* array of ItemPointerData */
+	LVDeadTuples *dead_tuples;	/* TIDs of tuples we intend to delete */
+	LVParallelState *lps;		/* parallel vacuum state, or NULL */
 	int			num_index_scans;
 	TransactionId latestRemovedXid;
 	bool		lock_waiter_detected;
+	/* blocks in which all-visible pages are frozen eagerly: [start, end) */
+	BlockNumber eager_freeze_start;
+	BlockNumber eager_freeze_end;
 } LVRelStats;
 
 
@@ -155,26 +284,55 @@ static void lazy_scan_heap(Relation onerel, VacuumParams *params,
 						   bool aggressive);
 static void lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats);
 static bool lazy_check_needs_freeze(Buffer buf, bool *hastup);
+static void lazy_vacuum_all_indexes(Relation *Irel,
+									IndexBulkDeleteResult **stats,
+									LVRelStats *vacrelstats, int nindexes);
+static void lazy_cleanup_all_indexes(Relation *Irel,
+									 IndexBulkDeleteResult **stats,
+									 LVRelStats *vacrelstats, int nindexes);
 static void lazy_vacuum_index(Relation indrel,
 							  IndexBulkDeleteResult **stats,
-							  LVRelStats *vacrelstats);
+							  LVDeadTuples *dead_tuples, double reltuples);
 static void lazy_cleanup_index(Relation indrel,
-							   IndexBulkDeleteResult *stats,
-							   LVRelStats *vacrelstats);
+							   IndexBulkDeleteResult **stats,
+							   double reltuples, bool estimated_count);
+static void update_index_statistics(Relation *Irel,
+									IndexBulkDeleteResult **stats,
+									int nindexes);
 static int	lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
-							 int tupindex, LVRelStats *vacrelstats, Buffer *vmbuffer);
+							 int blkindex, LVRelStats *vacrelstats, Buffer *vmbuffer);
 static bool should_attempt_truncation(VacuumParams *params,
 									  LVRelStats *vacrelstats);
 static void lazy_truncate_heap(Relation onerel, LVRelStats *vacrelstats);
 static BlockNumber count_nondeletable_pages(Relation onerel,
 											LVRelStats *vacrelstats);
+static Size compute_dead_tuples_space(BlockNumber relblocks, bool useindex);
 static void lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks);
-static void lazy_record_dead_tuple(LVRelStats *vacrelstats,
+static void lazy_reset_dead_tuples(LVDeadTuples *dead_tuples);
+static void lazy_record_dead_tuple(LVDeadTuples *dead_tuples,
 								   ItemPointer itemptr);
+static int	lazy_dead_block_offsets(LVDeadTuples *dead_tuples,
+									LVDeadBlock *blk, OffsetNumber *offsets);
+static int	lazy_prepare_page_freeze(Page page, TransactionId relfrozenxid,
+									 MultiXactId relminmxid,
+									 TransactionId cutoff_xid,
+									 xl_heap_freeze_tuple *frozen,
+									 bool *all_frozen);
 static bool lazy_tid_reaped(ItemPointer itemptr, void *state);
-static int	vac_cmp_itemptr(const void *left, const void *right);
 static bool heap_page_is_all_visible(Relation rel, Buffer buf,
 									 TransactionId *visibility_cutoff_xid, bool *all_frozen);
+static LVParallelState *begin_parallel_vacuum(Relation onerel, Relation *Irel,
+											  LVRelStats *vacrelstats,
+											  BlockNumber nblocks,
+											  int nindexes, int nrequested);
+static void end_parallel_vacuum(LVParallelState *lps,
+								IndexBulkDeleteResult **stats, int nindexes);
+static void lazy_parallel_process_indexes(Relation *Irel,
+										  IndexBulkDeleteResult **stats,
+										  LVRelStats *vacrelstats,
+										  int nindexes, bool for_cleanup);
+static void parallel_vacuum_indexes(Relation *Irel, LVShared *lvshared,
+									LVDeadTuples *dead_tuples, int nindexes);
 
 
 /*
@@ -208,6 +366,9 @@ heap_vacuum_rel(Relation onerel, VacuumParams *params,
 	double		new_live_tuples;
 	TransactionId new_frozen_xid;
 	MultiXactId new_min_multi;
+	BlockNumber freeze_resume_block;
+	WalUsage	walusage_start = pgWalUsage;
+	WalUsage	walusage = {0, 0, 0};
 
 	Assert(params != NULL);
 	Assert(params->index_cleanup != VACOPT_TERNARY_DEFAULT);
@@ -280,6 +441,40 @@ heap_vacuum_rel(Relation onerel, VacuumParams *params,
 	vacrelstats->pages_removed = 0;
 	vacrelstats->lock_waiter_detected = false;
 
+	/*
+	 * If an aggressive vacuum is getting near, also freeze the all-visible
+	 * pages in a range of the table, continuing where the previous vacuum
+	 * doing this left off, so that the aggressive vacuum finds most pages
+	 * all-frozen and can skip them.  We start once the table's frozen Xid is
+	 * halfway to the full-table scan limit.
+	 */
+	if (!aggressive && params->eager_freeze_pages > 0)
+	{
+		TransactionId nextXid = ReadNewTransactionId();
+		TransactionId xidEagerFreezeLimit;
+
+		xidEagerFreezeLimit = xidFullScanLimit +
+			(nextXid - xidFullScanLimit) / 2;
+		if (!TransactionIdIsNormal(xidEagerFreezeLimit))
+			xidEagerFreezeLimit = FirstNormalTransactionId;
+
+		if (TransactionIdPrecedesOrEquals(onerel->rd_rel->relfrozenxid,
+										  xidEagerFreezeLimit))
+		{
+			PgStat_StatTabEntry *tabentry;
+			BlockNumber start = 0;
+
+			tabentry = pgstat_fetch_stat_tabentry(RelationGetRelid(onerel));
+			if (tabentry)
+				start = tabentry->freeze_resume_block;
+
+			vacrelstats->eager_freeze_start = start;
+			vacrelstats->eager_freeze_end =
+				start + Min((BlockNumber) params->eager_freeze_pages,
+							MaxBlockNumber - start);
+		}
+	}
+
 	/* Open all indexes of the relation */
 	vac_open_indexes(onerel, RowExclusiveLock, &nindexes, &Irel);
 	vacrelstats->useindex = (nindexes > 0 &&
@@ -307,6 +502,20 @@ heap_vacuum_rel(Relation onerel, VacuumParams *params,
 	else
 		scanned_all_unfrozen = true;
 
+	/*
+	 * Compute where the next vacuum is to continue freezing all-visible pages
+	 * eagerly.  After an aggressive vacuum, that starts over at the beginning
+	 * of the table.
+	 */
+	if (vacrelstats->eager_freeze_end > vacrelstats->eager_freeze_start)
+		freeze_resume_block =
+			(vacrelstats->eager_freeze_end >= vacrelstats->rel_pages) ?
+			0 : vacrelstats->eager_freeze_end;
+	else if (aggressive)
+		freeze_resume_block = 0;
+	else
+		freeze_resume_block = InvalidBlockNumber;
+
 	/*
 	 * Optionally truncate the relation.
 	 */
@@ -366,7 +575,8 @@ heap_vacuum_rel(Relation onerel, VacuumParams *params,
 	pgstat_report_vacuum(RelationGetRelid(onerel),
 						 onerel->rd_rel->relisshared,
 						 new_live_tuples,
-						 vacrelstats->new_dead_tuples);
+						 vacrelstats->new_dead_tuples,
+						 freeze_resume_block);
 	pgstat_progress_end_command();
 
 	/* and log the action if appropriate */
@@ -383,6 +593,8 @@ heap_vacuum_rel(Relation onerel, VacuumParams *params,
 
 			TimestampDifference(starttime, endtime, &secs, &usecs);
 
+			WalUsageAccumDiff(&walusage, &pgWalUsage, &walusage_start);
+
 			read_rate = 0;
 			write_rate = 0;
 			if ((secs > 0) || (usecs > 0))
@@ -434,6 +646,11 @@ heap_vacuum_rel(Relation onerel, VacuumParams *params,
 							 VacuumPageDirty);
 			appendStringInfo(&buf, _("avg read rate: %.3f MB/s, avg write rate: %.3f MB/s\n"),
 							 read_rate, write_rate);
+			appendStringInfo(&buf,
+							 _("WAL usage: %ld records, %ld full page images, " UINT64_FORMAT " bytes\n"),
+							 walusage.wal_records,
+							 walusage.wal_fpi,
+							 walusage.wal_bytes);
 			appendStringInfo(&buf, _("system usage: %s"), pg_rusage_show(&ru0));
 
 			ereport(LOG,
@@ -553,13 +770,48 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	vacrelstats->nonempty_pages = 0;
 	vacrelstats->latestRemovedXid = InvalidTransactionId;
 
-	lazy_space_alloc(vacrelstats, nblocks);
+	/* Fit the range of eager freezing to the current size of the table */
+	if (vacrelstats->eager_freeze_end > vacrelstats->eager_freeze_start)
+	{
+		if (vacrelstats->eager_freeze_start >= nblocks)
+		{
+			vacrelstats->eager_freeze_end -= vacrelstats->eager_freeze_start;
+			vacrelstats->eager_freeze_start = 0;
+		}
+		vacrelstats->eager_freeze_end = Min(vacrelstats->eager_freeze_end,
+											nblocks);
+	}
+
+	/*
+	 * Set up a parallel vacuum of the indexes, unless it's been disabled.
+	 * Workers can't access a temporary table, so don't try to use them for
+	 * one.
+	 */
+	vacrelstats->lps = NULL;
+	if (params->nworkers >= 0 && vacrelstats->useindex && nindexes > 0)
+	{
+		if (RelationUsesLocalBuffers(onerel))
+		{
+			if (params->nworkers > 0)
+				ereport(WARNING,
+						(errmsg("disabling parallel option of vacuum on \"%s\" --- cannot vacuum temporary tables in parallel",
+								relname)));
+		}
+		else
+			vacrelstats->lps = begin_parallel_vacuum(onerel, Irel, vacrelstats,
+													 nblocks, nindexes,
+													 params->nworkers);
+	}
+
+	/* Allocate the dead tuple store locally, unless it's in shared memory */
+	if (vacrelstats->lps == NULL)
+		lazy_space_alloc(vacrelstats, nblocks);
 	frozen = palloc(sizeof(xl_heap_freeze_tuple) * MaxHeapTuplesPerPage);
 
 	/* Report that we're scanning the heap, advertising total # of blocks */
 	initprog_val[0] = PROGRESS_VACUUM_PHASE_SCAN_HEAP;
 	initprog_val[1] = nblocks;
-	initprog_val[2] = vacrelstats->max_dead_tuples;
+	initprog_val[2] = vacrelstats->dead_tuples->max_bytes / sizeof(ItemPointerData);
 	pgstat_progress_update_multi_param(3, initprog_index, initprog_val);
 
 	/*
@@ -597,6 +849,10 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	 * computed, so they'll have no effect on the value to which we can safely
 	 * set relfrozenxid.  A similar argument applies for MXIDs and relminmxid.
 	 *
+	 * Within the range of eager freezing, we treat pages as an aggressive
+	 * scan would, so that all-visible pages are scanned and frozen, but
+	 * without the obligation to freeze every one of them.
+	 *
 	 * We will scan the table's last page, at least to the extent of
 	 * determining whether it has tuples or not, even if it should be skipped
 	 * according to the above rules; except when we've already determined that
@@ -606,6 +862,10 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	 * the last page.  This is worth avoiding mainly because such a lock must
 	 * be replayed on any hot standby, where it can be disruptive.
 	 */
+#define EAGER_FREEZE_BLOCK(blk) \
+	((blk) >= vacrelstats->eager_freeze_start && \
+	 (blk) < vacrelstats->eager_freeze_end)
+
 	next_unskippable_block = 0;
 	if ((params->options & VACOPT_DISABLE_PAGE_SKIPPING) == 0)
 	{
@@ -615,7 +875,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 
 			vmstatus = visibilitymap_get_status(onerel, next_unskippable_block,
 												&vmbuffer);
-			if (aggressive)
+			if (aggressive || EAGER_FREEZE_BLOCK(next_unskippable_block))
 			{
 				if ((vmstatus & VISIBILITYMAP_ALL_FROZEN) == 0)
 					break;
@@ -643,8 +903,10 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 					maxoff;
 		bool		tupgone,
 					hastup;
-		int			prev_dead_count;
+		int64		prev_dead_count;
+		int			npruned;
 		int			nfrozen;
+		TransactionId freeze_cutoff;
 		Size		freespace;
 		bool		all_visible_according_to_vm = false;
 		bool		all_visible;
@@ -671,7 +933,8 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 					vmskipflags = visibilitymap_get_status(onerel,
 														   next_unskippable_block,
 														   &vmbuffer);
-					if (aggressive)
+					if (aggressive ||
+						EAGER_FREEZE_BLOCK(next_unskippable_block))
 					{
 						if ((vmskipflags & VISIBILITYMAP_ALL_FROZEN) == 0)
 							break;
@@ -697,10 +960,12 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 
 			/*
 			 * Normally, the fact that we can't skip this block must mean that
-			 * it's not all-visible.  But in an aggressive vacuum we know only
-			 * that it's not all-frozen, so it might still be all-visible.
+			 * it's not all-visible.  But in an aggressive vacuum, or within
+			 * the range of eager freezing, we know only that it's not
+			 * all-frozen, so it might still be all-visible.
 			 */
-			if (aggressive && VM_ALL_VISIBLE(onerel, blkno, &vmbuffer))
+			if ((aggressive || EAGER_FREEZE_BLOCK(blkno)) &&
+				VM_ALL_VISIBLE(onerel, blkno, &vmbuffer))
 				all_visible_according_to_vm = true;
 		}
 		else
@@ -737,8 +1002,9 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		 * If we are close to overrunning the available space for dead-tuple
 		 * TIDs, pause and do a cycle of vacuuming before we tackle this page.
 		 */
-		if ((vacrelstats->max_dead_tuples - vacrelstats->num_dead_tuples) < MaxHeapTuplesPerPage &&
-			vacrelstats->num_dead_tuples > 0)
+		if (DeadTuplesFreeSpace(vacrelstats->dead_tuples) <
+			MaxDeadTupleBytesPerPage &&
+			vacrelstats->dead_tuples->num_tuples > 0)
 		{
 			const int	hvp_index[] = {
 				PROGRESS_VACUUM_PHASE,
@@ -766,10 +1032,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 										 PROGRESS_VACUUM_PHASE_VACUUM_INDEX);
 
 			/* Remove index entries */
-			for (i = 0; i < nindexes; i++)
-				lazy_vacuum_index(Irel[i],
-								  &indstats[i],
-								  vacrelstats);
+			lazy_vacuum_all_indexes(Irel, indstats, vacrelstats, nindexes);
 
 			/*
 			 * Report that we are now vacuuming the heap.  We also increase
@@ -789,7 +1052,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			 * not to reset latestRemovedXid since we want that value to be
 			 * valid.
 			 */
-			vacrelstats->num_dead_tuples = 0;
+			lazy_reset_dead_tuples(vacrelstats->dead_tuples);
 			vacrelstats->num_index_scans++;
 
 			/*
@@ -974,8 +1237,9 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		 *
 		 * We count tuples removed by the pruning step as removed by VACUUM.
 		 */
-		tups_vacuumed += heap_page_prune(onerel, buf, OldestXmin, false,
-										 &vacrelstats->latestRemovedXid);
+		npruned = heap_page_prune(onerel, buf, OldestXmin, false,
+								  &vacrelstats->latestRemovedXid);
+		tups_vacuumed += npruned;
 
 		/*
 		 * Now scan the page to collect vacuumable items and check for tuples
@@ -985,7 +1249,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		has_dead_tuples = false;
 		nfrozen = 0;
 		hastup = false;
-		prev_dead_count = vacrelstats->num_dead_tuples;
+		prev_dead_count = vacrelstats->dead_tuples->num_tuples;
 		maxoff = PageGetMaxOffsetNumber(page);
 
 		/*
@@ -1024,7 +1288,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			 */
 			if (ItemIdIsDead(itemid))
 			{
-				lazy_record_dead_tuple(vacrelstats, &(tuple.t_self));
+				lazy_record_dead_tuple(vacrelstats->dead_tuples, &(tuple.t_self));
 				all_visible = false;
 				continue;
 			}
@@ -1170,7 +1434,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 
 			if (tupgone)
 			{
-				lazy_record_dead_tuple(vacrelstats, &(tuple.t_self));
+				lazy_record_dead_tuple(vacrelstats->dead_tuples, &(tuple.t_self));
 				HeapTupleHeaderAdvanceLatestRemovedXid(tuple.t_data,
 													   &vacrelstats->latestRemovedXid);
 				tups_vacuumed += 1;
@@ -1199,6 +1463,25 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			}
 		}						/* scan along page */
 
+		/*
+		 * If the page is all-visible, but some tuples are too young to be
+		 * frozen under FreezeLimit, consider freezing them anyway so that the
+		 * page can be marked all-frozen, and future aggressive vacuums can
+		 * skip it.  We do that if the page has to be written out anyway
+		 * because pruning or freezing dirtied it, and within the range of
+		 * eager freezing.  Since every tuple is visible to everyone, any XID
+		 * older than OldestXmin can be frozen.
+		 */
+		freeze_cutoff = FreezeLimit;
+		if (all_visible && !all_frozen &&
+			(EAGER_FREEZE_BLOCK(blkno) ||
+			 (vacuum_eager_freeze && (npruned > 0 || nfrozen > 0))))
+		{
+			nfrozen = lazy_prepare_page_freeze(page, relfrozenxid, relminmxid,
+											   OldestXmin, frozen, &all_frozen);
+			freeze_cutoff = OldestXmin;
+		}
+
 		/*
 		 * If we froze any tuples, mark the buffer dirty, and write a WAL
 		 * record recording the changes.  We must log the changes to be
@@ -1227,7 +1510,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			{
 				XLogRecPtr	recptr;
 
-				recptr = log_heap_freeze(onerel, buf, FreezeLimit,
+				recptr = log_heap_freeze(onerel, buf, freeze_cutoff,
 										 frozen, nfrozen);
 				PageSetLSN(page, recptr);
 			}
@@ -1240,7 +1523,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		 * doing a second scan. Also we don't do that but forget dead tuples
 		 * when index cleanup is disabled.
 		 */
-		if (!vacrelstats->useindex && vacrelstats->num_dead_tuples > 0)
+		if (!vacrelstats->useindex && vacrelstats->dead_tuples->num_tuples > 0)
 		{
 			if (nindexes == 0)
 			{
@@ -1269,7 +1552,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 			 * not to reset latestRemovedXid since we want that value to be
 			 * valid.
 			 */
-			vacrelstats->num_dead_tuples = 0;
+			lazy_reset_dead_tuples(vacrelstats->dead_tuples);
 
 			/*
 			 * Periodically do incremental FSM vacuuming to make newly-freed
@@ -1384,7 +1667,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 		 * page, so remember its free space as-is.  (This path will always be
 		 * taken if there are no indexes.)
 		 */
-		if (vacrelstats->num_dead_tuples == prev_dead_count)
+		if (vacrelstats->dead_tuples->num_tuples == prev_dead_count)
 			RecordPageWithFreeSpace(onerel, blkno, freespace);
 	}
 
@@ -1418,7 +1701,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 
 	/* If any tuples need to be deleted, perform final vacuum cycle */
 	/* XXX put a threshold on min number of tuples here? */
-	if (vacrelstats->num_dead_tuples > 0)
+	if (vacrelstats->dead_tuples->num_tuples > 0)
 	{
 		const int	hvp_index[] = {
 			PROGRESS_VACUUM_PHASE,
@@ -1434,10 +1717,7 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 									 PROGRESS_VACUUM_PHASE_VACUUM_INDEX);
 
 		/* Remove index entries */
-		for (i = 0; i < nindexes; i++)
-			lazy_vacuum_index(Irel[i],
-							  &indstats[i],
-							  vacrelstats);
+		lazy_vacuum_all_indexes(Irel, indstats, vacrelstats, nindexes);
 
 		/* Report that we are now vacuuming the heap */
 		hvp_val[0] = PROGRESS_VACUUM_PHASE_VACUUM_HEAP;
@@ -1463,13 +1743,25 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 	pgstat_progress_update_param(PROGRESS_VACUUM_PHASE,
 								 PROGRESS_VACUUM_PHASE_INDEX_CLEANUP);
 
-	/* Do post-vacuum cleanup and statistics update for each index */
+	/* Do post-vacuum cleanup for each index */
 	if (vacrelstats->useindex)
+		lazy_cleanup_all_indexes(Irel, indstats, vacrelstats, nindexes);
+
+	/*
+	 * End parallel mode before updating the index statistics, which can't be
+	 * done in parallel mode.
+	 */
+	if (vacrelstats->lps != NULL)
 	{
-		for (i = 0; i < nindexes; i++)
-			lazy_cleanup_index(Irel[i], indstats[i], vacrelstats);
+		end_parallel_vacuum(vacrelstats->lps, indstats, nindexes);
+		vacrelstats->lps = NULL;
+		vacrelstats->dead_tuples = NULL;
 	}
 
+	/* Update the statistics of each index */
+	if (vacrelstats->useindex)
+		update_index_statistics(Irel, indstats, nindexes);
+
 	/* If no indexes, make log report that lazy_vacuum_heap would've made */
 	if (vacuumed_pages)
 		ereport(elevel,
@@ -1525,16 +1817,17 @@ lazy_scan_heap(Relation onerel, VacuumParams *params, LVRelStats *vacrelstats,
 static void
 lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 {
-	int			tupindex;
+	int			blkindex;
+	double		ntuples;
 	int			npages;
 	PGRUsage	ru0;
 	Buffer		vmbuffer = InvalidBuffer;
 
 	pg_rusage_init(&ru0);
 	npages = 0;
+	ntuples = 0;
 
-	tupindex = 0;
-	while (tupindex < vacrelstats->num_dead_tuples)
+	for (blkindex = 0; blkindex < vacrelstats->dead_tuples->nblocks; blkindex++)
 	{
 		BlockNumber tblk;
 		Buffer		buf;
@@ -1543,16 +1836,15 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 
 		vacuum_delay_point();
 
-		tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]);
+		tblk = DeadTuplesBlock(vacrelstats->dead_tuples, blkindex)->blkno;
 		buf = ReadBufferExtended(onerel, MAIN_FORKNUM, tblk, RBM_NORMAL,
 								 vac_strategy);
 		if (!ConditionalLockBufferForCleanup(buf))
 		{
 			ReleaseBuffer(buf);
-			++tupindex;
 			continue;
 		}
-		tupindex = lazy_vacuum_page(onerel, tblk, buf, tupindex, vacrelstats,
+		ntuples += lazy_vacuum_page(onerel, tblk, buf, blkindex, vacrelstats,
 									&vmbuffer);
 
 		/* Now that we've compacted the page, record its available space */
@@ -1571,9 +1863,9 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
 	}
 
 	ereport(elevel,
-			(errmsg("\"%s\": removed %d row versions in %d pages",
+			(errmsg("\"%s\": removed %.0f row versions in %d pages",
 					RelationGetRelationName(onerel),
-					tupindex, npages),
+					ntuples, npages),
 			 errdetail_internal("%s", pg_rusage_show(&ru0))));
 }
 
@@ -1583,37 +1875,35 @@ lazy_vacuum_heap(Relation onerel, LVRelStats *vacrelstats)
  *
  * Caller must hold pin and buffer cleanup lock on the buffer.
  *
- * tupindex is the index in vacrelstats->dead_tuples of the first dead
- * tuple for this page.  We assume the rest follow sequentially.
- * The return value is the first tupindex after the tuples of this page.
+ * blkindex is the index of the page's entry in vacrelstats->dead_tuples.
+ * The return value is the number of tuples removed from the page.
  */
 static int
 lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
-				 int tupindex, LVRelStats *vacrelstats, Buffer *vmbuffer)
+				 int blkindex, LVRelStats *vacrelstats, Buffer *vmbuffer)
 {
 	Page		page = BufferGetPage(buffer);
+	LVDeadBlock *blk = DeadTuplesBlock(vacrelstats->dead_tuples, blkindex);
 	OffsetNumber unused[MaxOffsetNumber];
-	int			uncnt = 0;
+	int			uncnt;
+	int			i;
 	TransactionId visibility_cutoff_xid;
 	bool		all_frozen;
 
+	Assert(blk->blkno == blkno);
+
 	pgstat_progress_update_param(PROGRESS_VACUUM_HEAP_BLKS_VACUUMED, blkno);
 
+	uncnt = lazy_dead_block_offsets(vacrelstats->dead_tuples, blk, unused);
+
 	START_CRIT_SECTION();
 
-	for (; tupindex < vacrelstats->num_dead_tuples; tupindex++)
+	for (i = 0; i < uncnt; i++)
 	{
-		BlockNumber tblk;
-		OffsetNumber toff;
 		ItemId		itemid;
 
-		tblk = ItemPointerGetBlockNumber(&vacrelstats->dead_tuples[tupindex]);
-		if (tblk != blkno)
-			break;				/* past end of tuples for this block */
-		toff = ItemPointerGetOffsetNumber(&vacrelstats->dead_tuples[tupindex]);
-		itemid = PageGetItemId(page, toff);
+		itemid = PageGetItemId(page, unused[i]);
 		ItemIdSetUnused(itemid);
-		unused[uncnt++] = toff;
 	}
 
 	PageRepairFragmentation(page);
@@ -1675,7 +1965,7 @@ lazy_vacuum_page(Relation onerel, BlockNumber blkno, Buffer buffer,
 							  *vmbuffer, visibility_cutoff_xid, flags);
 	}
 
-	return tupindex;
+	return uncnt;
 }
 
 /*
@@ -1732,16 +2022,65 @@ lazy_check_needs_freeze(Buffer buf, bool *hastup)
 }
 
 
+/*
+ *	lazy_vacuum_all_indexes() -- vacuum all indexes of the relation.
+ *
+ *		The indexes are vacuumed by parallel workers if a parallel vacuum
+ *		is in progress.
+ */
+static void
+lazy_vacuum_all_indexes(Relation *Irel, IndexBulkDeleteResult **stats,
+						LVRelStats *vacrelstats, int nindexes)
+{
+	int			i;
+
+	if (vacrelstats->lps != NULL)
+	{
+		lazy_parallel_process_indexes(Irel, stats, vacrelstats, nindexes,
+									  false);
+		return;
+	}
+
+	for (i = 0; i < nindexes; i++)
+		lazy_vacuum_index(Irel[i], &stats[i], vacrelstats->dead_tuples,
+						  vacrelstats->old_live_tuples);
+}
+
+/*
+ *	lazy_cleanup_all_indexes() -- do post-vacuum cleanup for all indexes.
+ */
+static void
+lazy_cleanup_all_indexes(Relation *Irel, IndexBulkDeleteResult **stats,
+						 LVRelStats *vacrelstats, int nindexes)
+{
+	int			i;
+
+	if (vacrelstats->lps != NULL)
+	{
+		lazy_parallel_process_indexes(Irel, stats, vacrelstats, nindexes,
+									  true);
+		return;
+	}
+
+	for (i = 0; i < nindexes; i++)
+		lazy_cleanup_index(Irel[i], &stats[i],
+						   vacrelstats->new_rel_tuples,
+						   vacrelstats->tupcount_pages < vacrelstats->rel_pages);
+}
+
 /*
  *	lazy_vacuum_index() -- vacuum one index relation.
  *
  *		Delete all the index entries pointing to tuples listed in
- *		vacrelstats->dead_tuples, and update running statistics.
+ *		dead_tuples, and update running statistics.
+ *
+ *		reltuples is the number of heap tuples to be passed to the
+ *		bulkdelete callback.
  */
 static void
 lazy_vacuum_index(Relation indrel,
 				  IndexBulkDeleteResult **stats,
-				  LVRelStats *vacrelstats)
+				  LVDeadTuples *dead_tuples, double reltuples)
 {
 	IndexVacuumInfo ivinfo;
 	PGRUsage	ru0;
@@ -1754,27 +2093,31 @@ lazy_vacuum_index(Relation indrel,
 	ivinfo.estimated_count = true;
 	ivinfo.message_level = elevel;
 	/* We can only provide an approximate value of num_heap_tuples here */
-	ivinfo.num_heap_tuples = vacrelstats->old_live_tuples;
+	ivinfo.num_heap_tuples = reltuples;
 	ivinfo.strategy = vac_strategy;
 
 	/* Do bulk deletion */
 	*stats = index_bulk_delete(&ivinfo, *stats,
-							   lazy_tid_reaped, (void *) vacrelstats);
+							   lazy_tid_reaped, (void *) dead_tuples);
 
 	ereport(elevel,
-			(errmsg("scanned index \"%s\" to remove %d row versions",
+			(errmsg("scanned index \"%s\" to remove %.0f row versions",
 					RelationGetRelationName(indrel),
-					vacrelstats->num_dead_tuples),
+					(double) dead_tuples->num_tuples),
 			 errdetail_internal("%s", pg_rusage_show(&ru0))));
 }
 
 /*
  *	lazy_cleanup_index() -- do post-vacuum cleanup for one index relation.
+ *
+ *		reltuples is the number of heap tuples and estimated_count is true
+ *		if the reltuples is an estimated value.  The statistics returned by
+ *		the index AM are left in *stats, for update_index_statistics().
  */
 static void
 lazy_cleanup_index(Relation indrel,
-				   IndexBulkDeleteResult *stats,
-				   LVRelStats *vacrelstats)
+				   IndexBulkDeleteResult **stats,
+				   double reltuples, bool estimated_count)
 {
 	IndexVacuumInfo ivinfo;
 	PGRUsage	ru0;
@@ -1784,7 +2127,7 @@ lazy_cleanup_index(Relation indrel,
 	ivinfo.index = indrel;
 	ivinfo.analyze_only = false;
 	ivinfo.report_progress = false;
-	ivinfo.estimated_count = (vacrelstats->tupcount_pages < vacrelstats->rel_pages);
+	ivinfo.estimated_count = estimated_count;
 	ivinfo.message_level = elevel;
 
 	/*
@@ -1792,41 +2135,62 @@ lazy_cleanup_index(Relation indrel,
 	 * tuples (we assume indexes are more interested in that than in the
 	 * number of nominally live tuples).
 	 */
-	ivinfo.num_heap_tuples = vacrelstats->new_rel_tuples;
+	ivinfo.num_heap_tuples = reltuples;
 	ivinfo.strategy = vac_strategy;
 
-	stats = index_vacuum_cleanup(&ivinfo, stats);
+	*stats = index_vacuum_cleanup(&ivinfo, *stats);
 
-	if (!stats)
+	if (!(*stats))
 		return;
 
-	/*
-	 * Now update statistics in pg_class, but only if the index says the count
-	 * is accurate.
-	 */
-	if (!stats->estimated_count)
-		vac_update_relstats(indrel,
-							stats->num_pages,
-							stats->num_index_tuples,
-							0,
-							false,
-							InvalidTransactionId,
-							InvalidMultiXactId,
-							false);
-
 	ereport(elevel,
 			(errmsg("index \"%s\" now contains %.0f row versions in %u pages",
 					RelationGetRelationName(indrel),
-					stats->num_index_tuples,
-					stats->num_pages),
+					(*stats)->num_index_tuples,
+					(*stats)->num_pages),
 			 errdetail("%.0f index row versions were removed.\n"
 					   "%u index pages have been deleted, %u are currently reusable.\n"
 					   "%s.",
-					   stats->tuples_removed,
-					   stats->pages_deleted, stats->pages_free,
+					   (*stats)->tuples_removed,
+					   (*stats)->pages_deleted, (*stats)->pages_free,
 					   pg_rusage_show(&ru0))));
+}
+
+/*
+ *	update_index_statistics() -- update the pg_class entries of the indexes.
+ *
+ *		This must not be called in parallel mode, since it updates catalogs.
+ */
+static void
+update_index_statistics(Relation *Irel, IndexBulkDeleteResult **stats,
+						int nindexes)
+{
+	int			i;
+
+	Assert(!IsInParallelMode());
+
+	for (i = 0; i < nindexes; i++)
+	{
+		if (stats[i] == NULL)
+			continue;
 
-	pfree(stats);
+		/*
+		 * Update statistics in pg_class, but only if the index says the count
+		 * is accurate.
+		 */
+		if (!stats[i]->estimated_count)
+			vac_update_relstats(Irel[i],
+								stats[i]->num_pages,
+								stats[i]->num_index_tuples,
+								0,
+								false,
+								InvalidTransactionId,
+								InvalidMultiXactId,
+								false);
+
+		pfree(stats[i]);
+		stats[i] = NULL;
+	}
 }
 
 /*
@@ -2134,113 +2498,332 @@ count_nondeletable_pages(Relation onerel, LVRelStats *vacrelstats)
 }
 
 /*
- * lazy_space_alloc - space allocation decisions for lazy vacuum
+ * compute_dead_tuples_space - how much space to make room for dead tuples
  *
  * See the comments at the head of this file for rationale.
  */
-static void
-lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks)
+static Size
+compute_dead_tuples_space(BlockNumber relblocks, bool useindex)
 {
-	long		maxtuples;
+	Size		nbytes;
 	int			vac_work_mem = IsAutoVacuumWorkerProcess() &&
 	autovacuum_work_mem != -1 ?
 	autovacuum_work_mem : maintenance_work_mem;
 
-	if (vacrelstats->useindex)
+	if (useindex)
 	{
-		maxtuples = (vac_work_mem * 1024L) / sizeof(ItemPointerData);
-		maxtuples = Min(maxtuples, INT_MAX);
-		maxtuples = Min(maxtuples, MaxAllocSize / sizeof(ItemPointerData));
+		nbytes = (Size) vac_work_mem * 1024L;
+		nbytes = Min(nbytes,
+					 MAXALIGN_DOWN(MaxAllocSize - offsetof(LVDeadTuples, data)));
 
 		/* curious coding here to ensure the multiplication can't overflow */
-		if ((BlockNumber) (maxtuples / LAZY_ALLOC_TUPLES) > relblocks)
-			maxtuples = relblocks * LAZY_ALLOC_TUPLES;
+		if ((BlockNumber) (nbytes / MaxDeadTupleBytesPerPage) > relblocks)
+			nbytes = relblocks * MaxDeadTupleBytesPerPage;
 
 		/* stay sane if small maintenance_work_mem */
-		maxtuples = Max(maxtuples, MaxHeapTuplesPerPage);
+		nbytes = Max(nbytes, MaxDeadTupleBytesPerPage);
 	}
 	else
 	{
-		maxtuples = MaxHeapTuplesPerPage;
+		nbytes = MaxDeadTupleBytesPerPage;
 	}
 
-	vacrelstats->num_dead_tuples = 0;
-	vacrelstats->max_dead_tuples = (int) maxtuples;
-	vacrelstats->dead_tuples = (ItemPointer)
-		palloc(maxtuples * sizeof(ItemPointerData));
+	/* keep the LVDeadBlock entries at the end of the data area aligned */
+	return MAXALIGN(nbytes);
+}
+
+/*
+ * lazy_space_alloc - allocate the dead tuple store in local memory
+ */
+static void
+lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks)
+{
+	LVDeadTuples *dead_tuples;
+	Size		dead_bytes;
+
+	dead_bytes = compute_dead_tuples_space(relblocks, vacrelstats->useindex);
+
+	dead_tuples = (LVDeadTuples *) palloc(SizeOfDeadTuples(dead_bytes));
+	dead_tuples->max_bytes = dead_bytes;
+	lazy_reset_dead_tuples(dead_tuples);
+
+	vacrelstats->dead_tuples = dead_tuples;
+}
+
+/*
+ * lazy_reset_dead_tuples - forget all the dead tuples in the store
+ */
+static void
+lazy_reset_dead_tuples(LVDeadTuples *dead_tuples)
+{
+	dead_tuples->used_bytes = 0;
+	dead_tuples->nblocks = 0;
+	dead_tuples->num_tuples = 0;
 }
 
 /*
  * lazy_record_dead_tuple - remember one deletable tuple
+ *
+ * Tuples must be recorded in TID order.
  */
 static void
-lazy_record_dead_tuple(LVRelStats *vacrelstats,
-					   ItemPointer itemptr)
+lazy_record_dead_tuple(LVDeadTuples *dead_tuples, ItemPointer itemptr)
 {
+	BlockNumber blkno = ItemPointerGetBlockNumber(itemptr);
+	OffsetNumber offnum = ItemPointerGetOffsetNumber(itemptr);
+	LVDeadBlock *blk = NULL;
+	Size		start = 0;
+	Size		needed = 0;
+	int			oldbytes = 0;
+	int			ntuples = 0;
+	int			listbytes;
+	int			bitmapbytes;
+	int			newbytes;
+	uint8	   *data;
+
+	Assert(offnum >= FirstOffsetNumber && offnum <= MaxHeapTuplesPerPage);
+
+	if (dead_tuples->nblocks > 0)
+	{
+		blk = DeadTuplesBlock(dead_tuples, dead_tuples->nblocks - 1);
+		if (blk->blkno == blkno)
+		{
+			oldbytes = blk->nbytes;
+			ntuples = blk->ntuples;
+		}
+		else
+		{
+			Assert(blk->blkno < blkno);
+			blk = NULL;
+		}
+	}
+
+	if (blk == NULL)
+	{
+		/* Need a new entry, with its data suitably aligned for a list */
+		start = TYPEALIGN(sizeof(OffsetNumber), dead_tuples->used_bytes);
+		needed = sizeof(LVDeadBlock) + (start - dead_tuples->used_bytes);
+	}
+
+	/* The offset list and the bitmap, whichever is smaller, get the tuple */
+	listbytes = (ntuples + 1) * sizeof(OffsetNumber);
+	bitmapbytes = (offnum - 1) / BITS_PER_BYTE + 1;
+	newbytes = Min(listbytes, bitmapbytes);
+	Assert(newbytes >= oldbytes);
+	needed += newbytes - oldbytes;
+
 	/*
-	 * The array shouldn't overflow under normal behavior, but perhaps it
+	 * The store shouldn't overflow under normal behavior, but perhaps it
 	 * could if we are given a really small maintenance_work_mem. In that
 	 * case, just forget the last few tuples (we'll get 'em next time).
 	 */
-	if (vacrelstats->num_dead_tuples < vacrelstats->max_dead_tuples)
+	if (needed > DeadTuplesFreeSpace(dead_tuples))
+		return;
+
+	if (blk == NULL)
 	{
-		vacrelstats->dead_tuples[vacrelstats->num_dead_tuples] = *itemptr;
-		vacrelstats->num_dead_tuples++;
-		pgstat_progress_update_param(PROGRESS_VACUUM_NUM_DEAD_TUPLES,
-									 vacrelstats->num_dead_tuples);
+		blk = DeadTuplesBlock(dead_tuples, dead_tuples->nblocks);
+		blk->blkno = blkno;
+		blk->start = (uint32) start;
+		blk->ntuples = 0;
+		blk->nbytes = 0;
+		dead_tuples->nblocks++;
+		dead_tuples->used_bytes = start;
 	}
+
+	data = (uint8 *) dead_tuples->data + blk->start;
+
+	if (bitmapbytes < listbytes)
+	{
+		if (blk->ntuples > 0 && !DeadBlockIsBitmap(blk))
+		{
+			/* Convert the offset list to a bitmap */
+			OffsetNumber offsets[MaxHeapTuplesPerPage];
+			int			noffsets;
+			int			i;
+
+			noffsets = lazy_dead_block_offsets(dead_tuples, blk, offsets);
+			memset(data, 0, newbytes);
+			for (i = 0; i < noffsets; i++)
+				data[(offsets[i] - 1) / BITS_PER_BYTE] |=
+					1 << ((offsets[i] - 1) % BITS_PER_BYTE);
+		}
+		else
+			memset(data + blk->nbytes, 0, newbytes - blk->nbytes);
+
+		data[(offnum - 1) / BITS_PER_BYTE] |= 1 << ((offnum - 1) % BITS_PER_BYTE);
+	}
+	else
+	{
+		if (blk->ntuples > 0 && DeadBlockIsBitmap(blk))
+		{
+			/* Convert the bitmap to an offset list */
+			OffsetNumber offsets[MaxHeapTuplesPerPage];
+			int			noffsets;
+
+			noffsets = lazy_dead_block_offsets(dead_tuples, blk, offsets);
+			memcpy(data, offsets, noffsets * sizeof(OffsetNumber));
+		}
+
+		Assert(blk->ntuples == 0 ||
+			   ((OffsetNumber *) data)[blk->ntuples - 1] < offnum);
+		((OffsetNumber *) data)[blk->ntuples] = offnum;
+	}
+
+	blk->ntuples++;
+	dead_tuples->used_bytes += newbytes - blk->nbytes;
+	blk->nbytes = newbytes;
+
+	dead_tuples->num_tuples++;
+	pgstat_progress_update_param(PROGRESS_VACUUM_NUM_DEAD_TUPLES,
+								 dead_tuples->num_tuples);
 }
 
 /*
- *	lazy_tid_reaped() -- is a particular tid deletable?
+ * lazy_dead_block_offsets - get the offset numbers of a page's dead tuples
  *
- *		This has the right signature to be an IndexBulkDeleteCallback.
- *
- *		Assumes dead_tuples array is in sorted order.
+ * The offsets are returned in ascending order in the caller-supplied array,
+ * which must have room for MaxHeapTuplesPerPage entries.  Returns the number
+ * of offsets.
  */
-static bool
-lazy_tid_reaped(ItemPointer itemptr, void *state)
+static int
+lazy_dead_block_offsets(LVDeadTuples *dead_tuples, LVDeadBlock *blk,
+						OffsetNumber *offsets)
 {
-	LVRelStats *vacrelstats = (LVRelStats *) state;
-	ItemPointer res;
+	uint8	   *data = (uint8 *) dead_tuples->data + blk->start;
+	int			noffsets = 0;
 
-	res = (ItemPointer) bsearch((void *) itemptr,
-								(void *) vacrelstats->dead_tuples,
-								vacrelstats->num_dead_tuples,
-								sizeof(ItemPointerData),
-								vac_cmp_itemptr);
+	if (DeadBlockIsBitmap(blk))
+	{
+		int			i;
 
-	return (res != NULL);
+		for (i = 0; i < blk->nbytes * BITS_PER_BYTE; i++)
+		{
+			if (data[i / BITS_PER_BYTE] & (1 << (i % BITS_PER_BYTE)))
+				offsets[noffsets++] = (OffsetNumber) (i + 1);
+		}
+	}
+	else
+	{
+		noffsets = blk->ntuples;
+		memcpy(offsets, data, noffsets * sizeof(OffsetNumber));
+	}
+
+	Assert(noffsets == blk->ntuples);
+
+	return noffsets;
 }
 
 /*
- * Comparator routines for use with qsort() and bsearch().
+ * lazy_prepare_page_freeze - prepare to freeze all the tuples on a page
+ *
+ * Fills 'frozen' with freeze plans for the tuples on the page that need
+ * freezing with the given XID cutoff, and returns their number.  *all_frozen
+ * is set to whether all the tuples will be frozen afterwards.  The page must
+ * be locked, and contain only tuples visible to everyone.
  */
 static int
-vac_cmp_itemptr(const void *left, const void *right)
+lazy_prepare_page_freeze(Page page, TransactionId relfrozenxid,
+						 MultiXactId relminmxid, TransactionId cutoff_xid,
+						 xl_heap_freeze_tuple *frozen, bool *all_frozen)
 {
-	BlockNumber lblk,
-				rblk;
-	OffsetNumber loff,
-				roff;
+	OffsetNumber offnum,
+				maxoff;
+	int			nfrozen = 0;
 
-	lblk = ItemPointerGetBlockNumber((ItemPointer) left);
-	rblk = ItemPointerGetBlockNumber((ItemPointer) right);
+	*all_frozen = true;
 
-	if (lblk < rblk)
-		return -1;
-	if (lblk > rblk)
-		return 1;
+	maxoff = PageGetMaxOffsetNumber(page);
+	for (offnum = FirstOffsetNumber;
+		 offnum <= maxoff;
+		 offnum = OffsetNumberNext(offnum))
+	{
+		ItemId		itemid = PageGetItemId(page, offnum);
+		bool		tuple_totally_frozen;
 
-	loff = ItemPointerGetOffsetNumber((ItemPointer) left);
-	roff = ItemPointerGetOffsetNumber((ItemPointer) right);
+		if (!ItemIdIsNormal(itemid))
+			continue;
 
-	if (loff < roff)
-		return -1;
-	if (loff > roff)
-		return 1;
+		if (heap_prepare_freeze_tuple((HeapTupleHeader) PageGetItem(page, itemid),
+									  relfrozenxid, relminmxid,
+									  cutoff_xid, MultiXactCutoff,
+									  &frozen[nfrozen],
+									  &tuple_totally_frozen))
+			frozen[nfrozen++].offset = offnum;
+
+		if (!tuple_totally_frozen)
+			*all_frozen = false;
+	}
 
-	return 0;
+	return nfrozen;
+}
+
+/*
+ *	lazy_tid_reaped() -- is a particular tid deletable?
+ *
+ *		This has the right signature to be an IndexBulkDeleteCallback.
+ */
+static bool
+lazy_tid_reaped(ItemPointer itemptr, void *state)
+{
+	LVDeadTuples *dead_tuples = (LVDeadTuples *) state;
+	BlockNumber blkno = ItemPointerGetBlockNumber(itemptr);
+	uint32		bit = ItemPointerGetOffsetNumber(itemptr) - 1;
+	LVDeadBlock *blk = NULL;
+	uint8	   *data;
+	int			lo;
+	int			hi;
+
+	/* Quick exit for pages outside the range of those having dead tuples */
+	if (dead_tuples->nblocks == 0 ||
+		blkno < DeadTuplesBlock(dead_tuples, 0)->blkno ||
+		blkno > DeadTuplesBlock(dead_tuples, dead_tuples->nblocks - 1)->blkno)
+		return false;
+
+	/* Binary search for the page's entry */
+	lo = 0;
+	hi = dead_tuples->nblocks - 1;
+	while (lo <= hi)
+	{
+		int			mid = lo + (hi - lo) / 2;
+
+		blk = DeadTuplesBlock(dead_tuples, mid);
+		if (blk->blkno < blkno)
+			lo = mid + 1;
+		else if (blk->blkno > blkno)
+			hi = mid - 1;
+		else
+			break;
+	}
+	if (lo > hi)
+		return false;
+
+	data = (uint8 *) dead_tuples->data + blk->start;
+
+	if (DeadBlockIsBitmap(blk))
+		return bit / BITS_PER_BYTE < blk->nbytes &&
+			(data[bit / BITS_PER_BYTE] & (1 << (bit % BITS_PER_BYTE))) != 0;
+	else
+	{
+		OffsetNumber *offsets = (OffsetNumber *) data;
+		OffsetNumber offnum = (OffsetNumber) (bit + 1);
+
+		/* Binary search the page's offset list */
+		lo = 0;
+		hi = blk->ntuples - 1;
+		while (lo <= hi)
+		{
+			int			mid = lo + (hi - lo) / 2;
+
+			if (offsets[mid] < offnum)
+				lo = mid + 1;
+			else if (offsets[mid] > offnum)
+				hi = mid - 1;
+			else
+				return true;
+		}
+		return false;
+	}
 }
 
 /*
@@ -2354,3 +2937,358 @@ heap_page_is_all_visible(Relation rel, Buffer buf,
 
 	return all_visible;
 }
+
+/*
+ * begin_parallel_vacuum - set up a parallel vacuum of the indexes
+ *
+ * Decides how many workers to use, enters parallel mode, and creates the
+ * dynamic shared memory segment holding the shared state and the dead tuple
+ * array, which is installed in vacrelstats.  nrequested is the number of
+ * workers requested by the user, or 0 to choose based on the number of
+ * indexes.
+ *
+ * Returns NULL, without entering parallel mode, if no workers would be used.
+ */
+static LVParallelState *
+begin_parallel_vacuum(Relation onerel, Relation *Irel, LVRelStats *vacrelstats,
+					  BlockNumber nblocks, int nindexes, int nrequested)
+{
+	LVParallelState *lps;
+	ParallelContext *pcxt;
+	LVShared   *shared;
+	LVDeadTuples *dead_tuples;
+	bool	   *can_parallel;
+	int			nindexes_parallel = 0;
+	int			nworkers;
+	Size		dead_bytes;
+	Size		est_shared;
+	Size		est_deadtuples;
+	char	   *sharedquery;
+	int			querylen;
+	int			i;
+
+	/*
+	 * Decide which indexes the workers can vacuum.  Workers only handle
+	 * indexes whose AM supports it, and which are large enough to be worth
+	 * the trouble; the leader vacuums the rest itself.
+	 */
+	can_parallel = (bool *) palloc0(sizeof(bool) * nindexes);
+	for (i = 0; i < nindexes; i++)
+	{
+		if (Irel[i]->rd_indam->amcanparallelvacuum &&
+			RelationGetNumberOfBlocks(Irel[i]) >= min_parallel_index_scan_size)
+		{
+			can_parallel[i] = true;
+			nindexes_parallel++;
+		}
+	}
+
+	/*
+	 * Unless the user asked for a number of workers, launch one fewer than
+	 * the number of indexes, since the leader vacuums one of them itself.
+	 */
+	if (nrequested > 0)
+		nworkers = Min(nrequested, nindexes_parallel);
+	else
+		nworkers = nindexes_parallel - 1;
+	nworkers = Min(nworkers, max_parallel_maintenance_workers);
+
+	if (nworkers <= 0)
+	{
+		pfree(can_parallel);
+		return NULL;
+	}
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "parallel_vacuum_main",
+								 nworkers);
+
+	/* Estimate size for the shared state -- PARALLEL_VACUUM_KEY_SHARED */
+	est_shared = MAXALIGN(SizeOfLVShared(nindexes));
+	shm_toc_estimate_chunk(&pcxt->estimator, est_shared);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate size for dead tuples -- PARALLEL_VACUUM_KEY_DEAD_TUPLES */
+	dead_bytes = compute_dead_tuples_space(nblocks, true);
+	est_deadtuples = MAXALIGN(SizeOfDeadTuples(dead_bytes));
+	shm_toc_estimate_chunk(&pcxt->estimator, est_deadtuples);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/*
+	 * Estimate space for BufferUsage and WalUsage --
+	 * PARALLEL_VACUUM_KEY_BUFFER_USAGE and PARALLEL_VACUUM_KEY_WAL_USAGE,
+	 * so that the workers' I/O and WAL are counted as the leader's.
+	 */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_VACUUM_KEY_QUERY_TEXT space */
+	querylen = strlen(debug_query_string);
+	shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	InitializeParallelDSM(pcxt);
+
+	/* Prepare shared state */
+	shared = (LVShared *) shm_toc_allocate(pcxt->toc, est_shared);
+	MemSet(shared, 0, est_shared);
+	shared->relid = RelationGetRelid(onerel);
+	shared->elevel = elevel;
+	pg_atomic_init_u32(&shared->idx, 0);
+	shared->nindexes = nindexes;
+	for (i = 0; i < nindexes; i++)
+		shared->indstats[i].parallel = can_parallel[i];
+	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_SHARED, shared);
+
+	/* Prepare the dead tuple store */
+	dead_tuples = (LVDeadTuples *) shm_toc_allocate(pcxt->toc, est_deadtuples);
+	dead_tuples->max_bytes = dead_bytes;
+	lazy_reset_dead_tuples(dead_tuples);
+	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_DEAD_TUPLES, dead_tuples);
+	vacrelstats->dead_tuples = dead_tuples;
+
+	/* Store query string for workers */
+	sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+	memcpy(sharedquery, debug_query_string, querylen + 1);
+	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_QUERY_TEXT, sharedquery);
+
+	pfree(can_parallel);
+
+	lps = (LVParallelState *) palloc0(sizeof(LVParallelState));
+	lps->pcxt = pcxt;
+	lps->lvshared = shared;
+	lps->nlaunches = 0;
+
+	/* Allocate space for each worker's usage counters; no need to zero */
+	lps->buffer_usage = shm_toc_allocate(pcxt->toc,
+										 mul_size(sizeof(BufferUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_BUFFER_USAGE,
+				   lps->buffer_usage);
+	lps->wal_usage = shm_toc_allocate(pcxt->toc,
+									  mul_size(sizeof(WalUsage), pcxt->nworkers));
+	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_WAL_USAGE, lps->wal_usage);
+
+	return lps;
+}
+
+/*
+ * end_parallel_vacuum - destroy the parallel context, and end parallel mode
+ *
+ * The statistics of the indexes vacuumed by workers are copied out of the
+ * dynamic shared memory segment into stats first, so that the caller can
+ * update pg_class with them.
+ */
+static void
+end_parallel_vacuum(LVParallelState *lps, IndexBulkDeleteResult **stats,
+					int nindexes)
+{
+	int			i;
+
+	for (i = 0; i < nindexes; i++)
+	{
+		LVSharedIndStats *shared_indstats = &lps->lvshared->indstats[i];
+
+		if (!shared_indstats->parallel || !shared_indstats->updated)
+			continue;
+
+		Assert(stats[i] == NULL);
+		stats[i] = (IndexBulkDeleteResult *)
+			palloc(sizeof(IndexBulkDeleteResult));
+		memcpy(stats[i], &shared_indstats->stats,
+			   sizeof(IndexBulkDeleteResult));
+	}
+
+	DestroyParallelContext(lps->pcxt);
+	ExitParallelMode();
+	pfree(lps);
+}
+
+/*
+ * lazy_parallel_process_indexes - vacuum or clean up all indexes in parallel
+ *
+ * The leader first processes the indexes that workers can't handle, then
+ * joins the workers in processing the others.
+ */
+static void
+lazy_parallel_process_indexes(Relation *Irel, IndexBulkDeleteResult **stats,
+							  LVRelStats *vacrelstats, int nindexes,
+							  bool for_cleanup)
+{
+	LVParallelState *lps = vacrelstats->lps;
+	LVShared   *lvshared = lps->lvshared;
+	int			i;
+
+	lvshared->for_cleanup = for_cleanup;
+	if (!for_cleanup)
+	{
+		/* We can only provide an approximate value of num_heap_tuples */
+		lvshared->reltuples = vacrelstats->old_live_tuples;
+		lvshared->estimated_count = true;
+	}
+	else
+	{
+		lvshared->reltuples = vacrelstats->new_rel_tuples;
+		lvshared->estimated_count =
+			(vacrelstats->tupcount_pages < vacrelstats->rel_pages);
+	}
+	pg_atomic_write_u32(&lvshared->idx, 0);
+
+	/* The segment must be reinitialized before workers are launched again */
+	if (lps->nlaunches > 0)
+		ReinitializeParallelDSM(lps->pcxt);
+	lps->nlaunches++;
+
+	LaunchParallelWorkers(lps->pcxt);
+
+	if (lps->pcxt->nworkers_launched > 0)
+		ereport(elevel,
+				(errmsg(for_cleanup ?
+						ngettext("launched %d parallel vacuum worker for index cleanup (planned: %d)",
+								 "launched %d parallel vacuum workers for index cleanup (planned: %d)",
+								 lps->pcxt->nworkers_launched) :
+						ngettext("launched %d parallel vacuum worker for index vacuuming (planned: %d)",
+								 "launched %d parallel vacuum workers for index vacuuming (planned: %d)",
+								 lps->pcxt->nworkers_launched),
+						lps->pcxt->nworkers_launched, lps->pcxt->nworkers)));
+
+	/* Process the indexes the workers won't touch */
+	for (i = 0; i < nindexes; i++)
+	{
+		if (lvshared->indstats[i].parallel)
+			continue;
+
+		if (for_cleanup)
+			lazy_cleanup_index(Irel[i], &stats[i], lvshared->reltuples,
+							   lvshared->estimated_count);
+		else
+			lazy_vacuum_index(Irel[i], &stats[i], vacrelstats->dead_tuples,
+							  lvshared->reltuples);
+	}
+
+	/* Join the workers in processing the others */
+	parallel_vacuum_indexes(Irel, lvshared, vacrelstats->dead_tuples,
+							nindexes);
+
+	WaitForParallelWorkersToFinish(lps->pcxt);
+
+	/* Count the workers' buffer and WAL usage as our own */
+	for (i = 0; i < lps->pcxt->nworkers_launched; i++)
+		InstrAccumParallelQuery(&lps->buffer_usage[i], &lps->wal_usage[i]);
+}
+
+/*
+ * parallel_vacuum_indexes - vacuum or clean up indexes, as a participant in
+ * a parallel vacuum
+ *
+ * Each participant claims the next index that hasn't been processed yet,
+ * until there are none left.  The statistics returned by the index AM are
+ * kept in the shared state.
+ */
+static void
+parallel_vacuum_indexes(Relation *Irel, LVShared *lvshared,
+						LVDeadTuples *dead_tuples, int nindexes)
+{
+	for (;;)
+	{
+		uint32		idx = pg_atomic_fetch_add_u32(&lvshared->idx, 1);
+		LVSharedIndStats *shared_indstats;
+		IndexBulkDeleteResult *stats;
+
+		if (idx >= nindexes)
+			break;
+
+		shared_indstats = &lvshared->indstats[idx];
+		if (!shared_indstats->parallel)
+			continue;
+
+		stats = shared_indstats->updated ? &shared_indstats->stats : NULL;
+
+		if (lvshared->for_cleanup)
+			lazy_cleanup_index(Irel[idx], &stats, lvshared->reltuples,
+							   lvshared->estimated_count);
+		else
+			lazy_vacuum_index(Irel[idx], &stats, dead_tuples,
+							  lvshared->reltuples);
+
+		/*
+		 * The first time the AM returns statistics, copy them into shared
+		 * memory; afterwards, it updates them there in place.
+		 */
+		if (stats != NULL && stats != &shared_indstats->stats)
+		{
+			memcpy(&shared_indstats->stats, stats,
+				   sizeof(IndexBulkDeleteResult));
+			shared_indstats->updated = true;
+			pfree(stats);
+		}
+	}
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
+{
+	LVShared   *lvshared;
+	LVDeadTuples *dead_tuples;
+	Relation	onerel;
+	Relation   *indrels;
+	int			nindexes;
+	char	   *sharedquery;
+	BufferUsage *buffer_usage;
+	WalUsage   *wal_usage;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_QUERY_TEXT, false);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	lvshared = (LVShared *) shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_SHARED,
+										   false);
+	dead_tuples = (LVDeadTuples *) shm_toc_lookup(toc,
+												  PARALLEL_VACUUM_KEY_DEAD_TUPLES,
+												  false);
+	elevel = lvshared->elevel;
+
+	/*
+	 * Open the table and its indexes, using the lock modes the leader holds.
+	 * The leader's lock on the table prevents indexes from being created or
+	 * dropped, so we see the same indexes, in the same order, as the leader.
+	 */
+	onerel = table_open(lvshared->relid, ShareUpdateExclusiveLock);
+	vac_open_indexes(onerel, RowExclusiveLock, &nindexes, &indrels);
+	Assert(nindexes == lvshared->nindexes);
+
+	/*
+	 * Use cost-based delay like the leader does.  Each worker accumulates
+	 * its own cost balance.
+	 */
+	VacuumCostActive = (VacuumCostDelay > 0);
+	VacuumCostBalance = 0;
+	VacuumPageHit = 0;
+	VacuumPageMiss = 0;
+	VacuumPageDirty = 0;
+
+	vac_strategy = GetAccessStrategy(BAS_VACUUM);
+
+	InstrStartParallelQuery();
+
+	parallel_vacuum_indexes(indrels, lvshared, dead_tuples, nindexes);
+
+	/* Report buffer and WAL usage during parallel execution */
+	buffer_usage = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_BUFFER_USAGE, false);
+	wal_usage = shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_WAL_USAGE, false);
+	InstrEndParallelQuery(&buffer_usage[ParallelWorkerNumber],
+						  &wal_usage[ParallelWorkerNumber]);
+
+	vac_close_indexes(nindexes, indrels, RowExclusiveLock);
+	table_close(onerel, ShareUpdateExclusiveLock);
+	FreeAccessStrategy(vac_strategy);
+}
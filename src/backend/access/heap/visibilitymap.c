@@ -15,6 +15,7 @@
  *		visibilitymap_pin	 - pin a map page for setting a bit
  *		visibilitymap_pin_ok - check whether correct map page is already pinned
  *		visibilitymap_set	 - set a bit in a previously pinned page
+ *		visibilitymap_set_range - set bits for a range of directly written pages
  *		visibilitymap_get_status - get status of bits
  *		visibilitymap_count  - count number of bits set in visibility map
  *		visibilitymap_truncate	- truncate the visibility map
@@ -88,6 +89,7 @@
 #include "access/heapam_xlog.h"
 #include "access/visibilitymap.h"
 #include "access/xlog.h"
+#include "access/xloginsert.h"
 #include "miscadmin.h"
 #include "port/pg_bitutils.h"
 #include "storage/bufmgr.h"
@@ -306,6 +308,57 @@ visibilitymap_set(Relation rel, BlockNumber heapBlk, Buffer heapBuf,
 	LockBuffer(vmBuf, BUFFER_LOCK_UNLOCK);
 }
 
+/*
+ *	visibilitymap_set_range - set bits for a range of new heap pages
+ *
+ * This is for callers that build heap pages in private memory and write them
+ * out directly, bypassing shared buffers, with PD_ALL_VISIBLE already set;
+ * see RelationPutHeapTuplesDirect().  The pages must already have been
+ * written, and WAL-logged if needed.  There's no heap buffer to tie an
+ * XLOG_HEAP2_VISIBLE record to, so instead each map page we modify is
+ * WAL-logged as a full-page image.  That's cheap, as a single map page covers
+ * a lot of heap pages.
+ */
+void
+visibilitymap_set_range(Relation rel, BlockNumber startBlk, BlockNumber endBlk,
+						uint8 flags)
+{
+	BlockNumber heapBlk = startBlk;
+
+	Assert(flags & VISIBILITYMAP_VALID_BITS);
+
+	while (heapBlk < endBlk)
+	{
+		BlockNumber mapBlock = HEAPBLK_TO_MAPBLOCK(heapBlk);
+		Buffer		mapBuffer;
+		uint8	   *map;
+
+#ifdef TRACE_VISIBILITYMAP
+		elog(DEBUG1, "vm_set_range %s %d", RelationGetRelationName(rel), heapBlk);
+#endif
+
+		mapBuffer = vm_readbuf(rel, mapBlock, true);
+		map = (uint8 *) PageGetContents(BufferGetPage(mapBuffer));
+		LockBuffer(mapBuffer, BUFFER_LOCK_EXCLUSIVE);
+
+		START_CRIT_SECTION();
+
+		for (; heapBlk < endBlk && HEAPBLK_TO_MAPBLOCK(heapBlk) == mapBlock;
+			 heapBlk++)
+			map[HEAPBLK_TO_MAPBYTE(heapBlk)] |=
+				(flags << HEAPBLK_TO_OFFSET(heapBlk));
+
+		MarkBufferDirty(mapBuffer);
+
+		if (RelationNeedsWAL(rel))
+			log_newpage_buffer(mapBuffer, false);
+
+		END_CRIT_SECTION();
+
+		UnlockReleaseBuffer(mapBuffer);
+	}
+}
+
 /*
  *	visibilitymap_get_status - get status of bits
  *
@@ -625,7 +678,7 @@ static void
 vm_extend(Relation rel, BlockNumber vm_nblocks)
 {
 	BlockNumber vm_nblocks_now;
-	PGAlignedBlock pg;
+	PGIOAlignedBlock pg;
 
 	PageInit((Page) pg.data, BLCKSZ, 0);
 
@@ -103,6 +103,8 @@ RelationGetIndexScan(Relation indexRelation, int nkeys, int norderbys)
 		scan->orderByData = NULL;
 
 	scan->xs_want_itup = false; /* may be set later */
+	scan->xs_prefetch_heap = NULL;	/* likewise */
+	scan->xs_prefetch_arg = NULL;
 
 	/*
 	 * During recovery we ignore killed tuples and don't bother to kill them
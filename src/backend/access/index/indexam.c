@@ -18,6 +18,7 @@
  *		index_rescan	- restart a scan of an index
  *		index_endscan	- end a scan
  *		index_insert	- insert an index tuple into a relation
+ *		index_insert_batch - insert several index tuples into a relation
  *		index_markpos	- mark a scan position
  *		index_restrpos	- restore a scan position
  *		index_parallelscan_estimate - estimate shared memory for parallel scan
@@ -188,6 +189,36 @@ index_insert(Relation indexRelation,
 											 checkUnique, indexInfo);
 }
 
+/* ----------------
+ *		index_insert_batch - insert several index tuples into a relation
+ *
+ * This is only valid for an index AM that provides aminsertbatch, and
+ * only for an index that doesn't need uniqueness checking.  values[i]
+ * and isnull[i] describe the index tuple for heap_tids[i].
+ * ----------------
+ */
+void
+index_insert_batch(Relation indexRelation,
+				   Datum **values,
+				   bool **isnull,
+				   ItemPointer heap_tids,
+				   int ntuples,
+				   Relation heapRelation,
+				   IndexInfo *indexInfo)
+{
+	RELATION_CHECKS;
+	CHECK_REL_PROCEDURE(aminsertbatch);
+
+	if (!(indexRelation->rd_indam->ampredlocks))
+		CheckForSerializableConflictIn(indexRelation,
+									   (HeapTuple) NULL,
+									   InvalidBuffer);
+
+	indexRelation->rd_indam->aminsertbatch(indexRelation, values, isnull,
+										   heap_tids, ntuples, heapRelation,
+										   indexInfo);
+}
+
 /*
  * index_beginscan - start a scan of an index with amgettuple
  *
@@ -491,11 +491,29 @@ _bt_recsplitloc(FindSplitData *state,
 	 * If we are on the leaf level, assume that suffix truncation cannot avoid
 	 * adding a heap TID to the left half's new high key when splitting at the
 	 * leaf level.  In practice the new high key will often be smaller and
-	 * will rarely be larger, but conservatively assume the worst case.
+	 * will rarely be larger, but conservatively assume the worst case.  We do
+	 * subtract away the posting list of an old firstright tuple, though,
+	 * since suffix truncation always removes it.
 	 */
 	if (state->is_leaf)
-		leftfree -= (int16) (firstrightitemsz +
+	{
+		Size		postingsz = 0;
+
+		if (!newitemisfirstonright)
+		{
+			ItemId		itemid;
+			IndexTuple	firstright;
+
+			itemid = PageGetItemId(state->page, firstoldonright);
+			firstright = (IndexTuple) PageGetItem(state->page, itemid);
+			if (BTreeTupleIsPosting(firstright))
+				postingsz = IndexTupleSize(firstright) -
+					BTreeTupleGetPostingOffset(firstright);
+		}
+
+		leftfree -= (int16) (firstrightitemsz - postingsz +
 							 MAXALIGN(sizeof(ItemPointerData)));
+	}
 	else
 		leftfree -= (int16) firstrightitemsz;
 
@@ -691,7 +709,8 @@ _bt_afternewitemoff(FindSplitData *state, OffsetNumber maxoff,
 	itemid = PageGetItemId(state->page, OffsetNumberPrev(state->newitemoff));
 	tup = (IndexTuple) PageGetItem(state->page, itemid);
 	/* Do cheaper test first */
-	if (!_bt_adjacenthtid(&tup->t_tid, &state->newitem->t_tid))
+	if (!_bt_adjacenthtid(BTreeTupleGetMaxHeapTID(tup),
+						  BTreeTupleGetHeapTID(state->newitem)))
 		return false;
 	/* Check same conditions as rightmost item case, too */
 	keepnatts = _bt_keep_natts_fast(state->rel, tup, state->newitem);
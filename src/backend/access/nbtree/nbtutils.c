@@ -20,6 +20,7 @@
 #include "access/nbtree.h"
 #include "access/reloptions.h"
 #include "access/relscan.h"
+#include "catalog/catalog.h"
 #include "commands/progress.h"
 #include "miscadmin.h"
 #include "utils/array.h"
@@ -36,6 +37,12 @@ typedef struct BTSortArrayContext
 	bool		reverse;
 } BTSortArrayContext;
 
+/*
+ * Minimum number of wasted descents before a skip scan gives up on skipping;
+ * see _bt_skip_advance
+ */
+#define BT_SKIP_MIN_WASTED		8
+
 static Datum _bt_find_extreme_element(IndexScanDesc scan, ScanKey skey,
 									  StrategyNumber strat,
 									  Datum *elems, int nelems);
@@ -43,6 +50,16 @@ static int	_bt_sort_array_elements(IndexScanDesc scan, ScanKey skey,
 									bool reverse,
 									Datum *elems, int nelems);
 static int	_bt_compare_array_elements(const void *a, const void *b, void *arg);
+static bool _bt_skip_allowed(IndexScanDesc scan);
+static void _bt_skip_init(IndexScanDesc scan);
+static void _bt_skip_set_key(IndexScanDesc scan, Datum value, bool isnull);
+static bool _bt_skip_set_range(IndexScanDesc scan, ScanDirection dir,
+							   Datum value);
+static bool _bt_skip_advance(IndexScanDesc scan, ScanDirection dir);
+static bool _bt_skip_value_equal(IndexScanDesc scan, Datum value,
+								 bool isnull);
+static void _bt_skip_free_value(IndexScanDesc scan, Datum value,
+								bool isnull);
 static bool _bt_compare_scankey_args(IndexScanDesc scan, ScanKey op,
 									 ScanKey leftarg, ScanKey rightarg,
 									 bool *result);
@@ -79,7 +96,10 @@ static int	_bt_keep_natts(Relation rel, IndexTuple lastleft,
  *		determine whether or not the keys in the index are expected to be
  *		unique (i.e. if this is a "heapkeyspace" index).  We assume a
  *		heapkeyspace index when caller passes a NULL tuple, allowing index
- *		build callers to avoid accessing the non-existent metapage.
+ *		build callers to avoid accessing the non-existent metapage.  We
+ *		also assume that the index is _not_ allequalimage when a NULL tuple
+ *		is passed; CREATE INDEX callers call _bt_allequalimage() to set the
+ *		field themselves.
  */
 BTScanInsert
 _bt_mkscankey(Relation rel, IndexTuple itup)
@@ -106,7 +126,14 @@ _bt_mkscankey(Relation rel, IndexTuple itup)
 	 */
 	key = palloc(offsetof(BTScanInsertData, scankeys) +
 				 sizeof(ScanKeyData) * indnkeyatts);
-	key->heapkeyspace = itup == NULL || _bt_heapkeyspace(rel);
+	if (itup)
+		_bt_metaversion(rel, &key->heapkeyspace, &key->allequalimage);
+	else
+	{
+		/* Utility statement callers can set these fields themselves */
+		key->heapkeyspace = true;
+		key->allequalimage = false;
+	}
 	key->anynullkeys = false;	/* initial assumption */
 	key->nextkey = false;
 	key->pivotsearch = false;
@@ -183,6 +210,17 @@ _bt_freestack(BTStack stack)
  * array keys, it's sufficient to find the extreme element value and replace
  * the whole array with that scalar value.
  *
+ * This is also where we decide whether to perform a skip scan.  When there
+ * are no quals on the first index column, but there are quals on the second,
+ * we add an "=" key on the first column at the front of so->arrayKeyData and
+ * treat it as an array key whose elements are the distinct values of the
+ * first column.  Each primitive index scan then only has to visit the part
+ * of the index matching the quals on the second and later columns for one
+ * such value, instead of having to read the whole index.  The elements are
+ * not known in advance: they are found by searching the index in between
+ * primitive index scans (see _bt_skip_next).  The skip array is always the
+ * first array key, since it belongs to the first index column.
+ *
  * Note: the reason we need so->arrayKeyData, rather than just scribbling
  * on scan->keyData, is that callers are permitted to call btrescan without
  * supplying a new set of scankey data.
@@ -194,10 +232,13 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 	int			numberOfKeys = scan->numberOfKeys;
 	int16	   *indoption = scan->indexRelation->rd_indoption;
 	int			numArrayKeys;
+	bool		skip;
 	ScanKey		cur;
 	int			i;
 	MemoryContext oldContext;
 
+	so->skipScan = false;
+
 	/* Quick check to see if there are any array keys */
 	numArrayKeys = 0;
 	for (i = 0; i < numberOfKeys; i++)
@@ -217,8 +258,10 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 		}
 	}
 
+	skip = _bt_skip_allowed(scan);
+
 	/* Quit if nothing to do. */
-	if (numArrayKeys == 0)
+	if (numArrayKeys == 0 && !skip)
 	{
 		so->numArrayKeys = 0;
 		so->arrayKeyData = NULL;
@@ -238,18 +281,34 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 
 	oldContext = MemoryContextSwitchTo(so->arrayContext);
 
-	/* Create modifiable copy of scan->keyData in the workspace context */
-	so->arrayKeyData = (ScanKey) palloc(scan->numberOfKeys * sizeof(ScanKeyData));
-	memcpy(so->arrayKeyData,
+	/*
+	 * Create modifiable copy of scan->keyData in the workspace context,
+	 * leaving room for the skip key in front if we need one
+	 */
+	if (skip)
+		numberOfKeys++;
+	so->arrayKeyData = (ScanKey) palloc(numberOfKeys * sizeof(ScanKeyData));
+	memcpy(so->arrayKeyData + (skip ? 1 : 0),
 		   scan->keyData,
 		   scan->numberOfKeys * sizeof(ScanKeyData));
 
 	/* Allocate space for per-array data in the workspace context */
+	if (skip)
+		numArrayKeys++;
 	so->arrayKeys = (BTArrayKeyInfo *) palloc0(numArrayKeys * sizeof(BTArrayKeyInfo));
 
-	/* Now process each array key */
+	/* Set up the skip array, if any */
 	numArrayKeys = 0;
-	for (i = 0; i < numberOfKeys; i++)
+	if (skip)
+	{
+		_bt_skip_init(scan);
+		so->arrayKeys[0].scan_key = 0;
+		so->arrayKeys[0].skip = true;
+		numArrayKeys++;
+	}
+
+	/* Now process each array key */
+	for (i = numArrayKeys; i < numberOfKeys; i++)
 	{
 		ArrayType  *arrayval;
 		int16		elmlen;
@@ -515,8 +574,12 @@ _bt_compare_array_elements(const void *a, const void *b, void *arg)
  *
  * Set up the cur_elem counters and fill in the first sk_argument value for
  * each array scankey.  We can't do this until we know the scan direction.
+ *
+ * For a skip scan, this searches the index for the first value of the first
+ * index column.  Returns false if there is none, meaning the index is empty
+ * and the scan need not be run at all.
  */
-void
+bool
 _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 {
 	BTScanOpaque so = (BTScanOpaque) scan->opaque;
@@ -527,6 +590,24 @@ _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 		BTArrayKeyInfo *curArrayKey = &so->arrayKeys[i];
 		ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
 
+		if (curArrayKey->skip)
+		{
+			Datum		value;
+			bool		isnull;
+
+			so->skipRangeDir = NoMovementScanDirection;
+			if (so->skipHintDir != NoMovementScanDirection)
+				_bt_skip_free_value(scan, so->skipHint, so->skipHintNull);
+			so->skipHintDir = NoMovementScanDirection;
+			so->skipLastPage = InvalidBlockNumber;
+			so->skipUseful = 0;
+			so->skipWasted = 0;
+			if (!_bt_skip_next(scan, dir, true, &value, &isnull))
+				return false;
+			_bt_skip_set_key(scan, value, isnull);
+			continue;
+		}
+
 		Assert(curArrayKey->num_elems > 0);
 		if (ScanDirectionIsBackward(dir))
 			curArrayKey->cur_elem = curArrayKey->num_elems - 1;
@@ -534,6 +615,8 @@ _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 			curArrayKey->cur_elem = 0;
 		skey->sk_argument = curArrayKey->elem_values[curArrayKey->cur_elem];
 	}
+
+	return true;
 }
 
 /*
@@ -562,6 +645,14 @@ _bt_advance_array_keys(IndexScanDesc scan, ScanDirection dir)
 		int			cur_elem = curArrayKey->cur_elem;
 		int			num_elems = curArrayKey->num_elems;
 
+		/* The skip array comes first, so it's the last one we advance */
+		if (curArrayKey->skip)
+		{
+			Assert(i == 0);
+			found = _bt_skip_advance(scan, dir);
+			break;
+		}
+
 		if (ScanDirectionIsBackward(dir))
 		{
 			if (--cur_elem < 0)
@@ -611,6 +702,27 @@ _bt_mark_array_keys(IndexScanDesc scan)
 	{
 		BTArrayKeyInfo *curArrayKey = &so->arrayKeys[i];
 
+		if (curArrayKey->skip)
+		{
+			ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
+			Form_pg_attribute att = TupleDescAttr(RelationGetDescr(scan->indexRelation), 0);
+
+			_bt_skip_free_value(scan, so->skipMarkValue, so->skipMarkNull);
+			so->skipMarkNull = (skey->sk_flags & SK_ISNULL) != 0;
+			so->skipMarkValue = (Datum) 0;
+			if (!so->skipMarkNull)
+			{
+				MemoryContext oldContext;
+
+				oldContext = MemoryContextSwitchTo(so->arrayContext);
+				so->skipMarkValue = datumCopy(skey->sk_argument,
+											  att->attbyval, att->attlen);
+				MemoryContextSwitchTo(oldContext);
+			}
+			so->skipMarkRangeDir = so->skipRangeDir;
+			continue;
+		}
+
 		curArrayKey->mark_elem = curArrayKey->cur_elem;
 	}
 }
@@ -634,6 +746,32 @@ _bt_restore_array_keys(IndexScanDesc scan)
 		ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
 		int			mark_elem = curArrayKey->mark_elem;
 
+		if (curArrayKey->skip)
+		{
+			Form_pg_attribute att = TupleDescAttr(RelationGetDescr(scan->indexRelation), 0);
+			Datum		value = (Datum) 0;
+			MemoryContext oldContext;
+
+			if (!so->skipMarkNull)
+			{
+				oldContext = MemoryContextSwitchTo(so->arrayContext);
+				value = datumCopy(so->skipMarkValue,
+								  att->attbyval, att->attlen);
+				MemoryContextSwitchTo(oldContext);
+			}
+			if (so->skipMarkRangeDir == NoMovementScanDirection)
+				_bt_skip_set_key(scan, value, so->skipMarkNull);
+			else if (!_bt_skip_set_range(scan, so->skipMarkRangeDir, value))
+				elog(ERROR, "could not restore skip scan key range");
+			so->skipRangeDir = so->skipMarkRangeDir;
+			/* a hint saved after the mark was set doesn't apply anymore */
+			if (so->skipHintDir != NoMovementScanDirection)
+				_bt_skip_free_value(scan, so->skipHint, so->skipHintNull);
+			so->skipHintDir = NoMovementScanDirection;
+			changed = true;
+			continue;
+		}
+
 		if (curArrayKey->cur_elem != mark_elem)
 		{
 			curArrayKey->cur_elem = mark_elem;
@@ -655,14 +793,331 @@ _bt_restore_array_keys(IndexScanDesc scan)
 	}
 }
 
+/*
+ * _bt_skip_allowed() -- Should the scan be performed as a skip scan?
+ *
+ * We skip when there are quals on the second index column but none on the
+ * first.  Quals that only start at the third or a later column would not be
+ * usable to position primitive index scans within each group of tuples with
+ * the same first column value, so those scans are not worth doing this way.
+ * Parallel index scans don't skip, since the workers would have to agree on
+ * the skip array's elements as they are discovered.  We also leave system
+ * catalogs alone, as the catalog lookups we need here could recurse.
+ */
+static bool
+_bt_skip_allowed(IndexScanDesc scan)
+{
+	Relation	rel = scan->indexRelation;
+
+	/* input keys are sorted by attribute, so we need only check the first */
+	if (scan->numberOfKeys < 1 || scan->keyData[0].sk_attno != 2)
+		return false;
+	if (scan->parallel_scan != NULL)
+		return false;
+	if (IsCatalogRelation(rel))
+		return false;
+
+	return OidIsValid(get_opfamily_member(rel->rd_opfamily[0],
+										  rel->rd_opcintype[0],
+										  rel->rd_opcintype[0],
+										  BTEqualStrategyNumber));
+}
+
+/*
+ * _bt_skip_init() -- Set up the skip key in so->arrayKeyData[0]
+ *
+ * Must be called in the array context.  The key is set to IS NULL until
+ * _bt_start_array_keys finds the first real element.
+ */
+static void
+_bt_skip_init(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	Oid			eq_op;
+
+	eq_op = get_opfamily_member(rel->rd_opfamily[0],
+								rel->rd_opcintype[0],
+								rel->rd_opcintype[0],
+								BTEqualStrategyNumber);
+	Assert(OidIsValid(eq_op));
+	ScanKeyEntryInitialize(&so->skipEqKey,
+						   0,
+						   1,
+						   BTEqualStrategyNumber,
+						   rel->rd_opcintype[0],
+						   rel->rd_indcollation[0],
+						   get_opcode(eq_op),
+						   (Datum) 0);
+
+	ScanKeyEntryInitialize(&so->arrayKeyData[0],
+						   SK_ISNULL | SK_SEARCHNULL,
+						   1,
+						   InvalidStrategy,
+						   InvalidOid,
+						   InvalidOid,
+						   InvalidOid,
+						   (Datum) 0);
+
+	so->skipScan = true;
+	so->skipRangeDir = NoMovementScanDirection;
+	so->skipMarkNull = true;
+	so->skipMarkValue = (Datum) 0;
+	so->skipMarkRangeDir = NoMovementScanDirection;
+	so->skipHintDir = NoMovementScanDirection;
+	so->skipLastPage = InvalidBlockNumber;
+	so->skipUseful = 0;
+	so->skipWasted = 0;
+}
+
+/*
+ * _bt_skip_set_key() -- Make the skip key search for the given value
+ *
+ * The skip key takes ownership of the value, which must have been allocated
+ * in the array context.  Its previous value is freed.
+ */
+static void
+_bt_skip_set_key(IndexScanDesc scan, Datum value, bool isnull)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	ScanKey		skey = &so->arrayKeyData[0];
+
+	_bt_skip_free_value(scan, skey->sk_argument,
+						(skey->sk_flags & SK_ISNULL) != 0);
+
+	if (isnull)
+		ScanKeyEntryInitialize(skey,
+							   SK_ISNULL | SK_SEARCHNULL,
+							   1,
+							   InvalidStrategy,
+							   InvalidOid,
+							   InvalidOid,
+							   InvalidOid,
+							   (Datum) 0);
+	else
+	{
+		memcpy(skey, &so->skipEqKey, sizeof(ScanKeyData));
+		skey->sk_argument = value;
+	}
+}
+
+/*
+ * _bt_skip_set_range() -- Relax the skip key to an inequality
+ *
+ * The skip key is made to match the given value and everything after it in
+ * the given scan direction, so that the next primitive index scan reads the
+ * rest of the index.  Returns false if the opfamily lacks the operator we
+ * need, in which case the skip key is left alone.
+ */
+static bool
+_bt_skip_set_range(IndexScanDesc scan, ScanDirection dir, Datum value)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	ScanKey		skey = &so->arrayKeyData[0];
+	bool		desc = (rel->rd_indoption[0] & INDOPTION_DESC) != 0;
+	StrategyNumber strat;
+	Oid			cmp_op;
+	MemoryContext oldContext;
+
+	/* _bt_fix_scankey_strategy will commute this again for DESC columns */
+	if (ScanDirectionIsForward(dir) != desc)
+		strat = BTGreaterEqualStrategyNumber;
+	else
+		strat = BTLessEqualStrategyNumber;
+
+	cmp_op = get_opfamily_member(rel->rd_opfamily[0],
+								 rel->rd_opcintype[0],
+								 rel->rd_opcintype[0],
+								 strat);
+	if (!OidIsValid(cmp_op))
+		return false;
+
+	_bt_skip_free_value(scan, skey->sk_argument,
+						(skey->sk_flags & SK_ISNULL) != 0);
+
+	oldContext = MemoryContextSwitchTo(so->arrayContext);
+	ScanKeyEntryInitialize(skey,
+						   0,
+						   1,
+						   strat,
+						   rel->rd_opcintype[0],
+						   rel->rd_indcollation[0],
+						   get_opcode(cmp_op),
+						   value);
+	MemoryContextSwitchTo(oldContext);
+
+	return true;
+}
+
+/*
+ * _bt_skip_advance() -- Advance the skip array to its next element
+ *
+ * Returns false if there are no more distinct values of the first index
+ * column in the scan direction.
+ *
+ * The value is usually taken from the tuple that ended the previous
+ * primitive index scan, since a scan that stops at a tuple whose first
+ * column differs from the skip key's value has landed on the very next
+ * value.  Otherwise we have to search the index for it.
+ *
+ * When the primitive index scans keep starting on the same leaf page that
+ * the one before them ended on, the groups of tuples with the same first
+ * column value are too small for skipping to save anything over reading the
+ * index, and each skip costs a descent of the tree.  Once that happens for
+ * most of the scan we relax the skip key to an inequality, so that the next
+ * primitive index scan just reads all of the rest of the index.  We can only
+ * do that when there are no other array keys, though: they'd have to start
+ * over for every primitive scan.
+ */
+static bool
+_bt_skip_advance(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	Datum		value = (Datum) 0;
+	bool		isnull = false;
+	bool		found = false;
+
+	/*
+	 * If the quals turned out to be contradictory without any help from
+	 * other array keys, no value of the first column can change that
+	 */
+	if (!so->qual_ok && so->numArrayKeys == 1)
+		return false;
+
+	if (so->skipRangeDir != NoMovementScanDirection)
+	{
+		bool		nulls_first;
+
+		if (so->skipRangeDir == dir)
+		{
+			/*
+			 * The last primitive scan read everything up to the end of the
+			 * index, except for the NULLs, which the inequality can't match.
+			 * Visit them separately if they come at the end.
+			 */
+			so->skipRangeDir = NoMovementScanDirection;
+			nulls_first = (rel->rd_indoption[0] & INDOPTION_NULLS_FIRST) != 0;
+			if (ScanDirectionIsForward(dir) == nulls_first)
+				return false;
+			_bt_skip_set_key(scan, (Datum) 0, true);
+			return true;
+		}
+
+		/*
+		 * The scan direction changed under us.  Carry on skipping from the
+		 * start of the range, which is where the last primitive scan ended.
+		 */
+		so->skipRangeDir = NoMovementScanDirection;
+	}
+
+	if (so->skipHintDir == dir)
+	{
+		so->skipHintDir = NoMovementScanDirection;
+		if (!_bt_skip_value_equal(scan, so->skipHint, so->skipHintNull))
+		{
+			value = so->skipHint;
+			isnull = so->skipHintNull;
+			found = true;
+		}
+		else
+			_bt_skip_free_value(scan, so->skipHint, so->skipHintNull);
+	}
+
+	if (!found && !_bt_skip_next(scan, dir, false, &value, &isnull))
+		return false;
+
+	if (!isnull && so->numArrayKeys == 1 &&
+		so->skipWasted >= BT_SKIP_MIN_WASTED &&
+		so->skipWasted > 2 * so->skipUseful &&
+		_bt_skip_set_range(scan, dir, value))
+	{
+		so->skipRangeDir = dir;
+		return true;
+	}
+
+	_bt_skip_set_key(scan, value, isnull);
+	return true;
+}
+
+/*
+ * _bt_skip_save_hint() -- Remember the tuple that ended a primitive scan
+ *
+ * Called by _bt_readpage when a skip scan's tuple fails a required key.  The
+ * first column value of the tuple is kept for _bt_skip_advance, along with
+ * the leaf page we're on.
+ */
+void
+_bt_skip_save_hint(IndexScanDesc scan, ScanDirection dir, IndexTuple itup)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	TupleDesc	itupdesc = RelationGetDescr(scan->indexRelation);
+	Form_pg_attribute att = TupleDescAttr(itupdesc, 0);
+	Datum		value;
+	bool		isnull;
+	MemoryContext oldContext;
+
+	Assert(so->skipScan);
+
+	if (so->skipHintDir != NoMovementScanDirection)
+		_bt_skip_free_value(scan, so->skipHint, so->skipHintNull);
+
+	value = index_getattr(itup, 1, itupdesc, &isnull);
+	so->skipHint = (Datum) 0;
+	if (!isnull)
+	{
+		oldContext = MemoryContextSwitchTo(so->arrayContext);
+		so->skipHint = datumCopy(value, att->attbyval, att->attlen);
+		MemoryContextSwitchTo(oldContext);
+	}
+	so->skipHintNull = isnull;
+	so->skipHintDir = dir;
+	so->skipLastPage = so->currPos.currPage;
+}
+
+/*
+ * _bt_skip_value_equal() -- Is value equal to the skip key's current value?
+ */
+static bool
+_bt_skip_value_equal(IndexScanDesc scan, Datum value, bool isnull)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	ScanKey		skey = &so->arrayKeyData[0];
+	FmgrInfo   *procinfo;
+
+	if (isnull || (skey->sk_flags & SK_ISNULL))
+		return isnull && (skey->sk_flags & SK_ISNULL);
+
+	procinfo = index_getprocinfo(rel, 1, BTORDER_PROC);
+	return DatumGetInt32(FunctionCall2Coll(procinfo,
+										   rel->rd_indcollation[0],
+										   skey->sk_argument,
+										   value)) == 0;
+}
+
+/*
+ * _bt_skip_free_value() -- Free a skip key value, if it was allocated
+ */
+static void
+_bt_skip_free_value(IndexScanDesc scan, Datum value, bool isnull)
+{
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(scan->indexRelation), 0);
+
+	if (!isnull && !att->attbyval && DatumGetPointer(value) != NULL)
+		pfree(DatumGetPointer(value));
+}
+
 
 /*
  *	_bt_preprocess_keys() -- Preprocess scan keys
  *
  * The given search-type keys (in scan->keyData[] or so->arrayKeyData[])
  * are copied to so->keyData[] with possible transformation.
- * scan->numberOfKeys is the number of input keys, so->numberOfKeys gets
- * the number of output keys (possibly less, never greater).
+ * scan->numberOfKeys is the number of input keys (not counting the skip key
+ * of a skip scan), so->numberOfKeys gets the number of output keys (possibly
+ * less, never greater).
  *
  * The output keys are marked with additional sk_flag bits beyond the
  * system-standard bits supplied by the caller.  The DESC and NULLS_FIRST
@@ -765,10 +1220,15 @@ _bt_preprocess_keys(IndexScanDesc scan)
 		return;					/* done if qual-less scan */
 
 	/*
-	 * Read so->arrayKeyData if array keys are present, else scan->keyData
+	 * Read so->arrayKeyData if array keys are present, else scan->keyData.
+	 * The former starts with an extra key for a skip scan.
 	 */
 	if (so->arrayKeyData != NULL)
+	{
 		inkeys = so->arrayKeyData;
+		if (so->skipScan)
+			numberOfKeys++;
+	}
 	else
 		inkeys = scan->keyData;
 
@@ -1786,10 +2246,71 @@ _bt_killitems(IndexScanDesc scan)
 		{
 			ItemId		iid = PageGetItemId(page, offnum);
 			IndexTuple	ituple = (IndexTuple) PageGetItem(page, iid);
+			bool		killtuple = false;
 
-			if (ItemPointerEquals(&ituple->t_tid, &kitem->heapTid))
+			if (BTreeTupleIsPosting(ituple))
 			{
-				/* found the item */
+				int			pi = i + 1;
+				int			nposting = BTreeTupleGetNPosting(ituple);
+				int			j;
+
+				/*
+				 * We rely on the convention that heap TIDs in the scanpos
+				 * items array are stored in ascending heap TID order for a
+				 * group of TIDs that originally came from a posting list
+				 * tuple.  This convention even applies during backwards
+				 * scans, where returning the TIDs in descending order might
+				 * seem more natural.  This is about effectiveness, not
+				 * correctness.
+				 *
+				 * Note that the page may have been modified in almost any way
+				 * since we first read it (in the unpinned case), so it's
+				 * possible that this posting list tuple wasn't a posting list
+				 * tuple when we first encountered its heap TIDs.
+				 */
+				for (j = 0; j < nposting; j++)
+				{
+					ItemPointer item = BTreeTupleGetPostingN(ituple, j);
+
+					if (!ItemPointerEquals(item, &kitem->heapTid))
+						break;	/* out of posting list loop */
+
+					/*
+					 * Read-ahead to later kitems here.
+					 *
+					 * We rely on the assumption that not advancing kitem here
+					 * will prevent us from considering the posting list tuple
+					 * fully dead by not matching its next heap TID in next
+					 * loop iteration.
+					 *
+					 * If, on the other hand, this is the final heap TID in
+					 * the posting list tuple, then tuple gets killed
+					 * regardless (i.e. we handle the case where the last
+					 * kitem is also the last heap TID in the last index tuple
+					 * correctly -- posting tuple still gets killed).
+					 */
+					if (pi < numKilled)
+						kitem = &so->currPos.items[so->killedItems[pi++]];
+				}
+
+				/*
+				 * Don't bother advancing the outermost loop's int iterator to
+				 * avoid processing killed items that relate to the same
+				 * offnum/posting list tuple.  This micro-optimization hardly
+				 * seems worth it.  (Further iterations of the outermost loop
+				 * will fail to match on this same posting list's first heap
+				 * TID instead, so we'll advance to the next offnum/index
+				 * tuple pretty quickly.)
+				 */
+				if (j == nposting)
+					killtuple = true;
+			}
+			else if (ItemPointerEquals(&ituple->t_tid, &kitem->heapTid))
+				killtuple = true;
+
+			if (killtuple)
+			{
+				/* found the item/all posting list items */
 				ItemIdMarkDead(iid);
 				killedsomething = true;
 				break;			/* out of inner search loop */
@@ -2130,6 +2651,7 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 	 */
 	Assert(BTreeTupleGetNAtts(lastleft, rel) == natts);
 	Assert(BTreeTupleGetNAtts(firstright, rel) == natts);
+	Assert(!BTreeTupleIsPivot(lastleft) && !BTreeTupleIsPivot(firstright));
 
 	/* Determine how many attributes must be kept in truncated tuple */
 	keepnatts = _bt_keep_natts(rel, lastleft, firstright, itup_key);
@@ -2145,6 +2667,19 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 
 		pivot = index_truncate_tuple(itupdesc, firstright, keepnatts);
 
+		if (BTreeTupleIsPosting(pivot))
+		{
+			/*
+			 * index_truncate_tuple() just returns a straight copy of
+			 * firstright when it has no key attributes to truncate.  We need
+			 * to truncate away the posting list ourselves.
+			 */
+			Assert(keepnatts == nkeyatts);
+			Assert(natts == nkeyatts);
+			pivot->t_info &= ~INDEX_SIZE_MASK;
+			pivot->t_info |= MAXALIGN(BTreeTupleGetPostingOffset(firstright));
+		}
+
 		/*
 		 * If there is a distinguishing key attribute within new pivot tuple,
 		 * there is no need to add an explicit heap TID attribute
@@ -2178,6 +2713,19 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 		newsize = IndexTupleSize(firstright) + MAXALIGN(sizeof(ItemPointerData));
 		pivot = palloc0(newsize);
 		memcpy(pivot, firstright, IndexTupleSize(firstright));
+
+		if (BTreeTupleIsPosting(firstright))
+		{
+			/*
+			 * New pivot tuple was copied from firstright, which happens to be
+			 * a posting list tuple.  We will have to include the max lastleft
+			 * heap TID in the final pivot tuple, but we can remove the
+			 * posting list now. (Pivot tuples should never contain a posting
+			 * list.)
+			 */
+			newsize = MAXALIGN(BTreeTupleGetPostingOffset(firstright)) +
+				MAXALIGN(sizeof(ItemPointerData));
+		}
 	}
 
 	/*
@@ -2202,10 +2750,13 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 	 * example in cases where no truncation takes place -- use lastleft's heap
 	 * TID.  (This is also the closest value to negative infinity that's
 	 * legally usable.)
+	 *
+	 * When lastleft is a posting list tuple, use its maximum heap TID, since
+	 * that is the heap TID that's closest to firstright.
 	 */
 	pivotheaptid = (ItemPointer) ((char *) pivot + newsize -
 								  sizeof(ItemPointerData));
-	ItemPointerCopy(&lastleft->t_tid, pivotheaptid);
+	ItemPointerCopy(BTreeTupleGetMaxHeapTID(lastleft), pivotheaptid);
 
 	/*
 	 * Lehman and Yao require that the downlink to the right page, which is to
@@ -2216,9 +2767,12 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 	 * tiebreaker.
 	 */
 #ifndef DEBUG_NO_TRUNCATE
-	Assert(ItemPointerCompare(&lastleft->t_tid, &firstright->t_tid) < 0);
-	Assert(ItemPointerCompare(pivotheaptid, &lastleft->t_tid) >= 0);
-	Assert(ItemPointerCompare(pivotheaptid, &firstright->t_tid) < 0);
+	Assert(ItemPointerCompare(BTreeTupleGetMaxHeapTID(lastleft),
+							  BTreeTupleGetHeapTID(firstright)) < 0);
+	Assert(ItemPointerCompare(pivotheaptid,
+							  BTreeTupleGetHeapTID(lastleft)) >= 0);
+	Assert(ItemPointerCompare(pivotheaptid,
+							  BTreeTupleGetHeapTID(firstright)) < 0);
 #else
 
 	/*
@@ -2231,7 +2785,7 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 	 * attribute values along with lastleft's heap TID value when lastleft's
 	 * TID happens to be greater than firstright's TID.
 	 */
-	ItemPointerCopy(&firstright->t_tid, pivotheaptid);
+	ItemPointerCopy(BTreeTupleGetHeapTID(firstright), pivotheaptid);
 
 	/*
 	 * Pivot heap TID should never be fully equal to firstright.  Note that
@@ -2240,7 +2794,8 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 	 */
 	ItemPointerSetOffsetNumber(pivotheaptid,
 							   OffsetNumberPrev(ItemPointerGetOffsetNumber(pivotheaptid)));
-	Assert(ItemPointerCompare(pivotheaptid, &firstright->t_tid) < 0);
+	Assert(ItemPointerCompare(pivotheaptid,
+							  BTreeTupleGetHeapTID(firstright)) < 0);
 #endif
 
 	BTreeTupleSetNAtts(pivot, nkeyatts);
@@ -2321,9 +2876,9 @@ _bt_keep_natts(Relation rel, IndexTuple lastleft, IndexTuple firstright,
  * The approach taken here usually provides the same answer as _bt_keep_natts
  * will (for the same pair of tuples from a heapkeyspace index), since the
  * majority of btree opclasses can never indicate that two datums are equal
- * unless they're bitwise equal (once detoasted).  Similarly, result may
- * differ from the _bt_keep_natts result when either tuple has TOASTed datums,
- * though this is barely possible in practice.
+ * unless they're bitwise equal after detoasting.  When an index only has
+ * "equal image" columns, routine is guaranteed to give the same result as
+ * _bt_keep_natts would.
  *
  * These issues must be acceptable to callers, typically because they're only
  * concerned about making suffix truncation as effective as possible without
@@ -2355,7 +2910,7 @@ _bt_keep_natts_fast(Relation rel, IndexTuple lastleft, IndexTuple firstright)
 			break;
 
 		if (!isNull1 &&
-			!datumIsEqual(datum1, datum2, att->attbyval, att->attlen))
+			!datum_image_eq(datum1, datum2, att->attbyval, att->attlen))
 			break;
 
 		keepnatts++;
@@ -2412,10 +2967,10 @@ _bt_check_natts(Relation rel, bool heapkeyspace, Page page, OffsetNumber offnum)
 		if (offnum >= P_FIRSTDATAKEY(opaque))
 		{
 			/*
-			 * Non-pivot tuples currently never use alternative heap TID
-			 * representation -- even those within heapkeyspace indexes
+			 * Non-pivot tuple should never be explicitly marked as a pivot
+			 * tuple
 			 */
-			if ((itup->t_info & INDEX_ALT_TID_MASK) != 0)
+			if (BTreeTupleIsPivot(itup))
 				return false;
 
 			/*
@@ -2497,7 +3052,11 @@ _bt_check_natts(Relation rel, bool heapkeyspace, Page page, OffsetNumber offnum)
 	 * heapkeyspace index pivot tuples, regardless of whether or not there are
 	 * non-key attributes.
 	 */
-	if ((itup->t_info & INDEX_ALT_TID_MASK) == 0)
+	if (!BTreeTupleIsPivot(itup))
+		return false;
+
+	/* Pivot tuple should not use posting list representation (redundant) */
+	if (BTreeTupleIsPosting(itup))
 		return false;
 
 	/*
@@ -2575,3 +3134,75 @@ _bt_check_third_page(Relation rel, Relation heap, bool needheaptidspace,
 					 "or use full text indexing."),
 			 errtableconstraint(heap, RelationGetRelationName(rel))));
 }
+
+/*
+ * Are all attributes in rel "equality is image equality" attributes?
+ *
+ * We use each attribute's BTEQUALIMAGE_PROC opclass procedure.  If any
+ * opclass either lacks a BTEQUALIMAGE_PROC procedure or returns false, we
+ * return false; otherwise we return true.
+ *
+ * Returned boolean value is stored in index metapage during index builds.
+ * Deduplication can only be used when we return true.
+ */
+bool
+_bt_allequalimage(Relation rel, bool debugmessage)
+{
+	bool		allequalimage = true;
+
+	/* INCLUDE indexes don't support deduplication */
+	if (IndexRelationGetNumberOfAttributes(rel) !=
+		IndexRelationGetNumberOfKeyAttributes(rel))
+		return false;
+
+	/*
+	 * There is no special reason why deduplication cannot work with system
+	 * relations (i.e. with system catalog indexes and TOAST indexes).  We
+	 * deem deduplication unsafe for these indexes all the same, since the
+	 * alternative is to force users to always use deduplication, without
+	 * being able to opt out.  (ALTER INDEX is not supported with system
+	 * indexes, so users would have no way to set the deduplicate_items
+	 * storage parameter to 'off'.)
+	 */
+	if (IsSystemRelation(rel))
+		return false;
+
+	for (int i = 0; i < IndexRelationGetNumberOfKeyAttributes(rel); i++)
+	{
+		Oid			opfamily = rel->rd_opfamily[i];
+		Oid			opcintype = rel->rd_opcintype[i];
+		Oid			collation = rel->rd_indcollation[i];
+		Oid			equalimageproc;
+
+		equalimageproc = get_opfamily_proc(opfamily, opcintype, opcintype,
+										   BTEQUALIMAGE_PROC);
+
+		/*
+		 * If there is no BTEQUALIMAGE_PROC then deduplication is assumed to
+		 * be unsafe.  Otherwise, actually call proc and see what it says.
+		 */
+		if (!OidIsValid(equalimageproc) ||
+			!DatumGetBool(OidFunctionCall1Coll(equalimageproc, collation,
+											   ObjectIdGetDatum(opcintype))))
+		{
+			allequalimage = false;
+			break;
+		}
+	}
+
+	/*
+	 * Don't elog() until here to avoid reporting on a system relation index
+	 * or an INCLUDE index
+	 */
+	if (debugmessage)
+	{
+		if (allequalimage)
+			elog(DEBUG1, "index \"%s\" can safely use deduplication",
+				 RelationGetRelationName(rel));
+		else
+			elog(DEBUG1, "index \"%s\" cannot use deduplication",
+				 RelationGetRelationName(rel));
+	}
+
+	return allequalimage;
+}
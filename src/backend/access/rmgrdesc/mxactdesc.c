@@ -41,7 +41,11 @@ out_member(StringInfo buf, MultiXactMember *member)
 			appendStringInfoString(buf, "(upd) ");
 			break;
 		default:
-			appendStringInfoString(buf, "(unk) ");
+			if (MXACT_IS_PARENT_LINK(member->status))
+				appendStringInfo(buf, "(parent, depth %d) ",
+								 MXACT_PARENT_LINK_DEPTH(member->status));
+			else
+				appendStringInfoString(buf, "(unk) ");
 			break;
 	}
 }
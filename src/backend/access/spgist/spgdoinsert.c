@@ -691,6 +691,9 @@ doPickSplit(Relation index, SpGistState *state,
 	Buffer		newInnerBuffer,
 				newLeafBuffer;
 	ItemPointerData *heapPtrs;
+	SpGistLeafTuple *oldLeafs;
+	Datum		leafDatums[INDEX_MAX_KEYS];
+	bool		leafIsnulls[INDEX_MAX_KEYS];
 	uint8	   *leafPageSelect;
 	int		   *leafSizes;
 	OffsetNumber *toDelete;
@@ -719,6 +722,7 @@ doPickSplit(Relation index, SpGistState *state,
 	n = max + 1;
 	in.datums = (Datum *) palloc(sizeof(Datum) * n);
 	heapPtrs = (ItemPointerData *) palloc(sizeof(ItemPointerData) * n);
+	oldLeafs = (SpGistLeafTuple *) palloc(sizeof(SpGistLeafTuple) * n);
 	toDelete = (OffsetNumber *) palloc(sizeof(OffsetNumber) * n);
 	toInsert = (OffsetNumber *) palloc(sizeof(OffsetNumber) * n);
 	newLeafs = (SpGistLeafTuple *) palloc(sizeof(SpGistLeafTuple) * n);
@@ -759,6 +763,7 @@ doPickSplit(Relation index, SpGistState *state,
 			{
 				in.datums[nToInsert] = SGLTDATUM(it, state);
 				heapPtrs[nToInsert] = it->heapPtr;
+				oldLeafs[nToInsert] = it;
 				nToInsert++;
 				toDelete[nToDelete] = i;
 				nToDelete++;
@@ -784,6 +789,7 @@ doPickSplit(Relation index, SpGistState *state,
 			{
 				in.datums[nToInsert] = SGLTDATUM(it, state);
 				heapPtrs[nToInsert] = it->heapPtr;
+				oldLeafs[nToInsert] = it;
 				nToInsert++;
 				toDelete[nToDelete] = i;
 				nToDelete++;
@@ -816,6 +822,7 @@ doPickSplit(Relation index, SpGistState *state,
 	 */
 	in.datums[in.nTuples] = SGLTDATUM(newLeafTuple, state);
 	heapPtrs[in.nTuples] = newLeafTuple->heapPtr;
+	oldLeafs[in.nTuples] = newLeafTuple;
 	in.nTuples++;
 
 	memset(&out, 0, sizeof(out));
@@ -832,14 +839,18 @@ doPickSplit(Relation index, SpGistState *state,
 						  PointerGetDatum(&out));
 
 		/*
-		 * Form new leaf tuples and count up the total space needed.
+		 * Form new leaf tuples and count up the total space needed.  Any
+		 * INCLUDE column values are carried over from the old tuples, which
+		 * are still intact at this point.
 		 */
 		totalLeafSizes = 0;
 		for (i = 0; i < in.nTuples; i++)
 		{
+			spgDeformLeafTuple(state, oldLeafs[i], false,
+							   leafDatums, leafIsnulls);
+			leafDatums[0] = out.leafTupleDatums[i];
 			newLeafs[i] = spgFormLeafTuple(state, heapPtrs + i,
-										   out.leafTupleDatums[i],
-										   false);
+										   leafDatums, leafIsnulls);
 			totalLeafSizes += newLeafs[i]->size + sizeof(ItemIdData);
 		}
 	}
@@ -860,9 +871,10 @@ doPickSplit(Relation index, SpGistState *state,
 		totalLeafSizes = 0;
 		for (i = 0; i < in.nTuples; i++)
 		{
+			spgDeformLeafTuple(state, oldLeafs[i], true,
+							   leafDatums, leafIsnulls);
 			newLeafs[i] = spgFormLeafTuple(state, heapPtrs + i,
-										   (Datum) 0,
-										   true);
+										   leafDatums, leafIsnulls);
 			totalLeafSizes += newLeafs[i]->size + sizeof(ItemIdData);
 		}
 	}
@@ -1889,11 +1901,17 @@ spgSplitNodeAction(Relation index, SpGistState *state,
  */
 bool
 spgdoinsert(Relation index, SpGistState *state,
-			ItemPointer heapPtr, Datum datum, bool isnull)
+			ItemPointer heapPtr, Datum *datums, bool *isnulls)
 {
+	Datum		datum = datums[0];
+	bool		isnull = isnulls[0];
+	int			natts = RelationGetDescr(index)->natts;
 	int			level = 0;
 	Datum		leafDatum;
+	Datum		leafDatums[INDEX_MAX_KEYS];
+	bool		leafIsnulls[INDEX_MAX_KEYS];
 	int			leafSize;
+	int			i;
 	SPPageDesc	current,
 				parent;
 	FmgrInfo   *procinfo = NULL;
@@ -1939,19 +1957,38 @@ spgdoinsert(Relation index, SpGistState *state,
 	else
 		leafDatum = (Datum) 0;
 
+	/*
+	 * The values of any INCLUDE columns go into the leaf tuple as they are,
+	 * except that we have to detoast them, for the same reason as above.
+	 */
+	leafDatums[0] = leafDatum;
+	leafIsnulls[0] = isnull;
+	for (i = 1; i < natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(state->inclTupDesc, i - 1);
+
+		leafIsnulls[i] = isnulls[i];
+		if (!isnulls[i] && att->attlen == -1)
+			leafDatums[i] = PointerGetDatum(PG_DETOAST_DATUM(datums[i]));
+		else
+			leafDatums[i] = datums[i];
+	}
+
 	/*
 	 * Compute space needed for a leaf tuple containing the given datum.
 	 *
 	 * If it isn't gonna fit, and the opclass can't reduce the datum size by
 	 * suffixing, bail out now rather than getting into an endless loop.
+	 * Suffixing can't do anything about the INCLUDE columns, so complain if
+	 * they wouldn't fit next to even the shortest possible leaf datum.
 	 */
-	if (!isnull)
-		leafSize = SGLTHDRSZ + sizeof(ItemIdData) +
-			SpGistGetTypeSize(&state->attLeafType, leafDatum);
-	else
-		leafSize = SGDTSIZE + sizeof(ItemIdData);
+	leafSize = SpGistGetLeafTupleSize(state, leafDatums, leafIsnulls) +
+		sizeof(ItemIdData);
 
-	if (leafSize > SPGIST_PAGE_CAPACITY && !state->config.longValuesOK)
+	if (leafSize > SPGIST_PAGE_CAPACITY &&
+		(!state->config.longValuesOK || isnull ||
+		 leafSize - SpGistGetTypeSize(&state->attLeafType, leafDatum) +
+		 sizeof(Datum) > SPGIST_PAGE_CAPACITY))
 		ereport(ERROR,
 				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
 				 errmsg("index row size %zu exceeds maximum %zu for index \"%s\"",
@@ -2048,7 +2085,8 @@ spgdoinsert(Relation index, SpGistState *state,
 			int			nToSplit,
 						sizeToSplit;
 
-			leafTuple = spgFormLeafTuple(state, heapPtr, leafDatum, isnull);
+			leafTuple = spgFormLeafTuple(state, heapPtr,
+										 leafDatums, leafIsnulls);
 			if (leafTuple->size + sizeof(ItemIdData) <=
 				SpGistPageGetFreeSpace(current.page, 1))
 			{
@@ -2161,8 +2199,10 @@ spgdoinsert(Relation index, SpGistState *state,
 					if (!isnull)
 					{
 						leafDatum = out.result.matchNode.restDatum;
-						leafSize = SGLTHDRSZ + sizeof(ItemIdData) +
-							SpGistGetTypeSize(&state->attLeafType, leafDatum);
+						leafDatums[0] = leafDatum;
+						leafSize = SpGistGetLeafTupleSize(state, leafDatums,
+														  leafIsnulls) +
+							sizeof(ItemIdData);
 					}
 
 					/*
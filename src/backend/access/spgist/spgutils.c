@@ -20,6 +20,7 @@
 #include "access/reloptions.h"
 #include "access/spgist_private.h"
 #include "access/transam.h"
+#include "access/tupmacs.h"
 #include "access/xact.h"
 #include "catalog/pg_amop.h"
 #include "storage/bufmgr.h"
@@ -55,12 +56,15 @@ spghandler(PG_FUNCTION_ARGS)
 	amroutine->amclusterable = false;
 	amroutine->ampredlocks = false;
 	amroutine->amcanparallel = false;
-	amroutine->amcaninclude = false;
+	amroutine->amcanbuildparallel = false;
+	amroutine->amcanparallelvacuum = true;
+	amroutine->amcaninclude = true;
 	amroutine->amkeytype = InvalidOid;
 
 	amroutine->ambuild = spgbuild;
 	amroutine->ambuildempty = spgbuildempty;
 	amroutine->aminsert = spginsert;
+	amroutine->aminsertbatch = NULL;
 	amroutine->ambulkdelete = spgbulkdelete;
 	amroutine->amvacuumcleanup = spgvacuumcleanup;
 	amroutine->amcanreturn = spgcanreturn;
@@ -111,8 +115,8 @@ spgGetCache(Relation index)
 		cache = MemoryContextAllocZero(index->rd_indexcxt,
 									   sizeof(SpGistCache));
 
-		/* SPGiST doesn't support multi-column indexes */
-		Assert(index->rd_att->natts == 1);
+		/* SPGiST doesn't support multi-column indexes, except for INCLUDE */
+		Assert(IndexRelationGetNumberOfKeyAttributes(index) == 1);
 
 		/*
 		 * Get the actual data type of the indexed column from the index
@@ -151,6 +155,23 @@ spgGetCache(Relation index)
 		fillTypeDesc(&cache->attPrefixType, cache->config.prefixType);
 		fillTypeDesc(&cache->attLabelType, cache->config.labelType);
 
+		/*
+		 * If there are INCLUDE columns, make a tuple descriptor for them,
+		 * which is what we use to store them in leaf tuples.
+		 */
+		if (index->rd_att->natts > 1)
+		{
+			MemoryContext oldcxt = MemoryContextSwitchTo(index->rd_indexcxt);
+			int			nincl = index->rd_att->natts - 1;
+			int			i;
+
+			cache->inclTupDesc = CreateTemplateTupleDesc(nincl);
+			for (i = 0; i < nincl; i++)
+				TupleDescCopyEntry(cache->inclTupDesc, i + 1,
+								   index->rd_att, i + 2);
+			MemoryContextSwitchTo(oldcxt);
+		}
+
 		/* Last, get the lastUsedPages data from the metapage */
 		metabuffer = ReadBuffer(index, SPGIST_METAPAGE_BLKNO);
 		LockBuffer(metabuffer, BUFFER_LOCK_SHARE);
@@ -190,6 +211,7 @@ initSpGistState(SpGistState *state, Relation index)
 	state->attLeafType = cache->attLeafType;
 	state->attPrefixType = cache->attPrefixType;
 	state->attLabelType = cache->attLabelType;
+	state->inclTupDesc = cache->inclTupDesc;
 
 	/* Make workspace for constructing dead tuples */
 	state->deadTupleStorage = palloc0(SGDTSIZE);
@@ -630,39 +652,135 @@ memcpyDatum(void *target, SpGistTypeDesc *att, Datum datum)
 }
 
 /*
- * Construct a leaf tuple containing the given heap TID and datum value
+ * Offset within a leaf tuple of the INCLUDE columns' null bitmap, given
+ * the leaf datum
  */
-SpGistLeafTuple
-spgFormLeafTuple(SpGistState *state, ItemPointer heapPtr,
-				 Datum datum, bool isnull)
+static Size
+spgLeafInclOffset(SpGistState *state, Datum key, bool keyIsNull)
 {
-	SpGistLeafTuple tup;
-	unsigned int size;
+	Size		off = SGLTHDRSZ;
+
+	if (!keyIsNull)
+		off += SpGistGetTypeSize(&state->attLeafType, key);
+
+	return off;
+}
+
+/*
+ * Compute the size of the leaf tuple spgFormLeafTuple would build from the
+ * given values.  datums[0] and isnulls[0] describe the leaf datum; any
+ * further entries are the values of the INCLUDE columns, which must not be
+ * toasted.
+ */
+Size
+SpGistGetLeafTupleSize(SpGistState *state, Datum *datums, bool *isnulls)
+{
+	Size		size;
 
 	/* compute space needed (note result is already maxaligned) */
-	size = SGLTHDRSZ;
-	if (!isnull)
-		size += SpGistGetTypeSize(&state->attLeafType, datum);
+	size = spgLeafInclOffset(state, datums[0], isnulls[0]);
+
+	if (state->inclTupDesc != NULL)
+	{
+		size = MAXALIGN(size + BITMAPLEN(state->inclTupDesc->natts));
+		size += heap_compute_data_size(state->inclTupDesc,
+									   datums + 1, isnulls + 1);
+		size = MAXALIGN(size);
+	}
 
 	/*
 	 * Ensure that we can replace the tuple with a dead tuple later.  This
-	 * test is unnecessary when !isnull, but let's be safe.
+	 * test is unnecessary when the leaf datum isn't null, but let's be safe.
 	 */
 	if (size < SGDTSIZE)
 		size = SGDTSIZE;
 
+	return size;
+}
+
+/*
+ * Construct a leaf tuple containing the given heap TID and datum values
+ * (see SpGistGetLeafTupleSize for the layout of datums[] and isnulls[])
+ */
+SpGistLeafTuple
+spgFormLeafTuple(SpGistState *state, ItemPointer heapPtr,
+				 Datum *datums, bool *isnulls)
+{
+	SpGistLeafTuple tup;
+	Size		size;
+
+	size = SpGistGetLeafTupleSize(state, datums, isnulls);
+
 	/* OK, form the tuple */
 	tup = (SpGistLeafTuple) palloc0(size);
 
 	tup->size = size;
 	tup->nextOffset = InvalidOffsetNumber;
 	tup->heapPtr = *heapPtr;
-	if (!isnull)
-		memcpyDatum(SGLTDATAPTR(tup), &state->attLeafType, datum);
+	if (!isnulls[0])
+		memcpyDatum(SGLTDATAPTR(tup), &state->attLeafType, datums[0]);
+
+	if (state->inclTupDesc != NULL)
+	{
+		Size		bitmapoff = spgLeafInclOffset(state, datums[0], isnulls[0]);
+		Size		dataoff;
+		uint16		infomask = 0;
+
+		dataoff = MAXALIGN(bitmapoff + BITMAPLEN(state->inclTupDesc->natts));
+		heap_fill_tuple(state->inclTupDesc, datums + 1, isnulls + 1,
+						(char *) tup + dataoff,
+						heap_compute_data_size(state->inclTupDesc,
+											   datums + 1, isnulls + 1),
+						&infomask, (bits8 *) tup + bitmapoff);
+	}
 
 	return tup;
 }
 
+/*
+ * Extract the values stored in a leaf tuple into datums[] and isnulls[],
+ * in the layout spgFormLeafTuple takes.  keyIsNull says whether the tuple
+ * came from the nulls tree.  Pass-by-reference results point into the
+ * tuple.
+ */
+void
+spgDeformLeafTuple(SpGistState *state, SpGistLeafTuple tup, bool keyIsNull,
+				   Datum *datums, bool *isnulls)
+{
+	datums[0] = keyIsNull ? (Datum) 0 : SGLTDATUM(tup, state);
+	isnulls[0] = keyIsNull;
+
+	if (state->inclTupDesc != NULL)
+	{
+		TupleDesc	tupdesc = state->inclTupDesc;
+		Size		bitmapoff = spgLeafInclOffset(state, datums[0], keyIsNull);
+		bits8	   *bp = (bits8 *) tup + bitmapoff;
+		char	   *tp;
+		long		off = 0;
+		int			i;
+
+		tp = (char *) tup + MAXALIGN(bitmapoff + BITMAPLEN(tupdesc->natts));
+
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute thisatt = TupleDescAttr(tupdesc, i);
+
+			if (att_isnull(i, bp))
+			{
+				datums[i + 1] = (Datum) 0;
+				isnulls[i + 1] = true;
+				continue;
+			}
+
+			isnulls[i + 1] = false;
+			off = att_align_pointer(off, thisatt->attalign, thisatt->attlen,
+									tp + off);
+			datums[i + 1] = fetchatt(thisatt, tp + off);
+			off = att_addlength_pointer(off, thisatt->attlen, tp + off);
+		}
+	}
+}
+
 /*
  * Construct a node (to go into an inner tuple) containing the given label
  *
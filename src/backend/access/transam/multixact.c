@@ -59,6 +59,16 @@
  * counter does not fall within the wraparound horizon considering the global
  * minimum value.
  *
+ * A multixact's members are normally stored in full.  But when a lock-only
+ * multixact with many members is expanded with one more locker, the new
+ * multixact only stores a link to the old one plus the new member, so that a
+ * row share-locked by a long series of overlapping transactions doesn't use
+ * quadratic space in the members area.  The links are resolved when the
+ * members are read, so callers never see them.  A linked-to multixact may be
+ * truncated away while one linking to it is still around; since it only had
+ * lockers and is older than any multixact that could still have running
+ * members, we can then just pretend it was empty.
+ *
  * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -192,10 +202,10 @@ static SlruCtlData MultiXactMemberCtlData;
 
 /*
  * MultiXact state shared across all backends.  All this state is protected
- * by MultiXactGenLock.  (We also use MultiXactOffsetControlLock and
- * MultiXactMemberControlLock to guard accesses to the two sets of SLRU
- * buffers.  For concurrency's sake, we avoid holding more than one of these
- * locks at a time.)
+ * by MultiXactGenLock.  (We also use the SLRU bank locks of MultiXactOffset
+ * and MultiXactMember to guard accesses to the two sets of SLRU buffers.  For
+ * concurrency's sake, we avoid holding more than one of these locks at a
+ * time.)
  */
 typedef struct MultiXactStateData
 {
@@ -314,11 +324,21 @@ typedef struct mXactCacheEnt
 {
 	MultiXactId multi;
 	int			nmembers;
+	int			depth;			/* length of the chain of parent links */
 	dlist_node	node;
 	MultiXactMember members[FLEXIBLE_ARRAY_MEMBER];
 } mXactCacheEnt;
 
 #define MAX_CACHE_ENTRIES	256
+
+/*
+ * MultiXactIdExpand links to the multixact being expanded, instead of
+ * copying its members, if it has at least this many members and the chain
+ * of links is shorter than this.
+ */
+#define MXACT_LINK_MIN_MEMBERS	8
+#define MXACT_LINK_MAX_DEPTH	8
+
 static dlist_head MXactCache = DLIST_STATIC_INIT(MXactCache);
 static int	MXactCacheMembers = 0;
 static MemoryContext MXactContext = NULL;
@@ -342,12 +362,20 @@ static void MultiXactIdSetOldestVisible(void);
 static void RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 							   int nmembers, MultiXactMember *members);
 static MultiXactId GetNewMultiXactId(int nmembers, MultiXactOffset *offset);
+static MultiXactId CreateMultiXact(int nmembers, MultiXactMember *members,
+								   MultiXactId parent, int nparent,
+								   int depth);
+static int	GetMultiXactIdMembersInternal(MultiXactId multi,
+										  MultiXactMember **members,
+										  bool from_pgupgrade, bool onlyLock,
+										  bool isParent, int *depth);
 
 /* MultiXact cache management */
 static int	mxactMemberComparator(const void *arg1, const void *arg2);
 static MultiXactId mXactCacheGetBySet(int nmembers, MultiXactMember *members);
-static int	mXactCacheGetById(MultiXactId multi, MultiXactMember **members);
-static void mXactCachePut(MultiXactId multi, int nmembers,
+static int	mXactCacheGetById(MultiXactId multi, MultiXactMember **members,
+							  int *depth);
+static void mXactCachePut(MultiXactId multi, int nmembers, int depth,
 						  MultiXactMember *members);
 
 static char *mxstatus_to_string(MultiXactStatus status);
@@ -440,6 +468,7 @@ MultiXactIdExpand(MultiXactId multi, TransactionId xid, MultiXactStatus status)
 	MultiXactMember *members;
 	MultiXactMember *newMembers;
 	int			nmembers;
+	int			depth;
 	int			i;
 	int			j;
 
@@ -457,7 +486,8 @@ MultiXactIdExpand(MultiXactId multi, TransactionId xid, MultiXactStatus status)
 	 * caller of this function does a check that the multixact is no longer
 	 * running.
 	 */
-	nmembers = GetMultiXactIdMembers(multi, &members, false, false);
+	nmembers = GetMultiXactIdMembersInternal(multi, &members, false, false,
+											 false, &depth);
 
 	if (nmembers < 0)
 	{
@@ -495,6 +525,47 @@ MultiXactIdExpand(MultiXactId multi, TransactionId xid, MultiXactStatus status)
 		}
 	}
 
+	/*
+	 * If the MultiXactId has many members and none of them updated the
+	 * tuple, store just a link to it plus the new member, rather than
+	 * copying all of its members.  This keeps a row that is share-locked by
+	 * many overlapping transactions (say, the referenced row of a foreign key
+	 * that many concurrent transactions insert rows for) from using space
+	 * quadratic in the number of lockers in the members area.  Lockers that
+	 * have finished remain reachable through the link, which is harmless:
+	 * they look just like lockers that finished after the new MultiXactId was
+	 * created.  Reading a chain of links costs one lookup per link, so past
+	 * MXACT_LINK_MAX_DEPTH links we flatten the chain again below.
+	 */
+	if (nmembers >= MXACT_LINK_MIN_MEMBERS && depth < MXACT_LINK_MAX_DEPTH)
+	{
+		for (i = 0; i < nmembers; i++)
+		{
+			if (ISUPDATE_from_mxstatus(members[i].status))
+				break;
+		}
+
+		if (i == nmembers)
+		{
+			newMembers = (MultiXactMember *)
+				palloc(sizeof(MultiXactMember) * (nmembers + 1));
+			memcpy(newMembers, members, sizeof(MultiXactMember) * nmembers);
+			newMembers[nmembers].xid = xid;
+			newMembers[nmembers].status = status;
+
+			newMulti = CreateMultiXact(nmembers + 1, newMembers,
+									   multi, nmembers, depth + 1);
+
+			pfree(members);
+			pfree(newMembers);
+
+			debug_elog4(DEBUG2, "Expand: returning new multi %u linked to %u",
+						newMulti, multi);
+
+			return newMulti;
+		}
+	}
+
 	/*
 	 * Determine which of the members of the MultiXactId are still of
 	 * interest. This is any running transaction, and also any transaction
@@ -744,14 +815,48 @@ ReadNextMultiXactId(void)
  */
 MultiXactId
 MultiXactIdCreateFromMembers(int nmembers, MultiXactMember *members)
+{
+	return CreateMultiXact(nmembers, members, InvalidMultiXactId, 0, 0);
+}
+
+/*
+ * CreateMultiXact
+ *		Guts of MultiXactIdCreateFromMembers
+ *
+ * If parent is valid, the first nparent entries of members[] must be the
+ * members of that lock-only MultiXactId, and the new one is stored as a link
+ * to it (at the given chain depth) followed by the remaining members only.
+ * Either way, the cache entry gets all the members.
+ *
+ * NB: the passed members[] array will be sorted in-place.
+ */
+static MultiXactId
+CreateMultiXact(int nmembers, MultiXactMember *members,
+				MultiXactId parent, int nparent, int depth)
 {
 	MultiXactId multi;
 	MultiXactOffset offset;
 	xl_multixact_create xlrec;
+	MultiXactMember *stored = members;
+	int			nstored = nmembers;
 
 	debug_elog3(DEBUG2, "Create: %s",
 				mxid_to_string(InvalidMultiXactId, nmembers, members));
 
+	/* Build the stored form before members[] gets sorted */
+	if (MultiXactIdIsValid(parent))
+	{
+		Assert(nparent > 0 && nparent < nmembers);
+		Assert(depth > 0 && depth <= MXACT_LINK_MAX_DEPTH);
+
+		nstored = nmembers - nparent + 1;
+		stored = (MultiXactMember *) palloc(sizeof(MultiXactMember) * nstored);
+		stored[0].xid = (TransactionId) parent;
+		stored[0].status = (MultiXactStatus) (MXACT_PARENT_LINK | depth);
+		memcpy(&stored[1], &members[nparent],
+			   sizeof(MultiXactMember) * (nmembers - nparent));
+	}
+
 	/*
 	 * See if the same set of members already exists in our cache; if so, just
 	 * re-use that MultiXactId.  (Note: it might seem that looking in our
@@ -766,6 +871,8 @@ MultiXactIdCreateFromMembers(int nmembers, MultiXactMember *members)
 	if (MultiXactIdIsValid(multi))
 	{
 		debug_elog2(DEBUG2, "Create: in cache!");
+		if (stored != members)
+			pfree(stored);
 		return multi;
 	}
 
@@ -797,12 +904,12 @@ MultiXactIdCreateFromMembers(int nmembers, MultiXactMember *members)
 	 * in vacuum.  During vacuum, in particular, it would be unacceptable to
 	 * keep OldestMulti set, in case it runs for long.
 	 */
-	multi = GetNewMultiXactId(nmembers, &offset);
+	multi = GetNewMultiXactId(nstored, &offset);
 
 	/* Make an XLOG entry describing the new MXID. */
 	xlrec.mid = multi;
 	xlrec.moff = offset;
-	xlrec.nmembers = nmembers;
+	xlrec.nmembers = nstored;
 
 	/*
 	 * XXX Note: there's a lot of padding space in MultiXactMember.  We could
@@ -812,18 +919,21 @@ MultiXactIdCreateFromMembers(int nmembers, MultiXactMember *members)
 	 */
 	XLogBeginInsert();
 	XLogRegisterData((char *) (&xlrec), SizeOfMultiXactCreate);
-	XLogRegisterData((char *) members, nmembers * sizeof(MultiXactMember));
+	XLogRegisterData((char *) stored, nstored * sizeof(MultiXactMember));
 
 	(void) XLogInsert(RM_MULTIXACT_ID, XLOG_MULTIXACT_CREATE_ID);
 
 	/* Now enter the information into the OFFSETs and MEMBERs logs */
-	RecordNewMultiXact(multi, offset, nmembers, members);
+	RecordNewMultiXact(multi, offset, nstored, stored);
 
 	/* Done with critical section */
 	END_CRIT_SECTION();
 
 	/* Store the new MultiXactId in the local cache, too */
-	mXactCachePut(multi, nmembers, members);
+	mXactCachePut(multi, nmembers, depth, members);
+
+	if (stored != members)
+		pfree(stored);
 
 	debug_elog2(DEBUG2, "Create: all done");
 
@@ -847,12 +957,15 @@ RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 	int			slotno;
 	MultiXactOffset *offptr;
 	int			i;
-
-	LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
+	LWLock	   *lock;
+	LWLock	   *prevlock = NULL;
 
 	pageno = MultiXactIdToOffsetPage(multi);
 	entryno = MultiXactIdToOffsetEntry(multi);
 
+	lock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+
 	/*
 	 * Note: we pass the MultiXactId to SimpleLruReadPage as the "transaction"
 	 * to complain about if there's any I/O error.  This is kinda bogus, but
@@ -868,10 +981,8 @@ RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 
 	MultiXactOffsetCtl->shared->page_dirty[slotno] = true;
 
-	/* Exchange our lock */
-	LWLockRelease(MultiXactOffsetControlLock);
-
-	LWLockAcquire(MultiXactMemberControlLock, LW_EXCLUSIVE);
+	/* Release MultiXactOffset SLRU lock. */
+	LWLockRelease(lock);
 
 	prev_pageno = -1;
 
@@ -884,7 +995,8 @@ RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 		int			flagsoff;
 		int			memberoff;
 
-		Assert(members[i].status <= MultiXactStatusUpdate);
+		Assert(members[i].status <= MultiXactStatusUpdate ||
+			   (i == 0 && MXACT_IS_PARENT_LINK(members[i].status)));
 
 		pageno = MXOffsetToMemberPage(offset);
 		memberoff = MXOffsetToMemberOffset(offset);
@@ -893,6 +1005,20 @@ RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 
 		if (pageno != prev_pageno)
 		{
+			/*
+			 * MultiXactMember SLRU page is changed so check if this new page
+			 * fall into the different SLRU bank then release the old bank's
+			 * lock and acquire lock on the new bank.
+			 */
+			lock = SimpleLruGetBankLock(MultiXactMemberCtl, pageno);
+			if (lock != prevlock)
+			{
+				if (prevlock != NULL)
+					LWLockRelease(prevlock);
+
+				LWLockAcquire(lock, LW_EXCLUSIVE);
+				prevlock = lock;
+			}
 			slotno = SimpleLruReadPage(MultiXactMemberCtl, pageno, true, multi);
 			prev_pageno = pageno;
 		}
@@ -913,7 +1039,8 @@ RecordNewMultiXact(MultiXactId multi, MultiXactOffset offset,
 		MultiXactMemberCtl->shared->page_dirty[slotno] = true;
 	}
 
-	LWLockRelease(MultiXactMemberControlLock);
+	if (prevlock != NULL)
+		LWLockRelease(prevlock);
 }
 
 /*
@@ -1201,6 +1328,24 @@ GetNewMultiXactId(int nmembers, MultiXactOffset *offset)
 int
 GetMultiXactIdMembers(MultiXactId multi, MultiXactMember **members,
 					  bool from_pgupgrade, bool onlyLock)
+{
+	return GetMultiXactIdMembersInternal(multi, members, from_pgupgrade,
+										 onlyLock, false, NULL);
+}
+
+/*
+ * GetMultiXactIdMembersInternal
+ *		Guts of GetMultiXactIdMembers
+ *
+ * isParent is true when we're resolving a parent link of another multixact,
+ * in which case a multi that has already been truncated away just has no
+ * members anymore.  If depth isn't NULL, the length of the multixact's chain
+ * of parent links is returned in *depth.
+ */
+static int
+GetMultiXactIdMembersInternal(MultiXactId multi, MultiXactMember **members,
+							  bool from_pgupgrade, bool onlyLock,
+							  bool isParent, int *depth)
 {
 	int			pageno;
 	int			prev_pageno;
@@ -1216,14 +1361,20 @@ GetMultiXactIdMembers(MultiXactId multi, MultiXactMember **members,
 	MultiXactId tmpMXact;
 	MultiXactOffset nextOffset;
 	MultiXactMember *ptr;
+	LWLock	   *lock;
+	MultiXactId parent = InvalidMultiXactId;
+	int			linkdepth = 0;
 
 	debug_elog3(DEBUG2, "GetMembers: asked for %u", multi);
 
+	if (depth)
+		*depth = 0;
+
 	if (!MultiXactIdIsValid(multi) || from_pgupgrade)
 		return -1;
 
 	/* See if the MultiXactId is in the local cache */
-	length = mXactCacheGetById(multi, members);
+	length = mXactCacheGetById(multi, members, depth);
 	if (length >= 0)
 	{
 		debug_elog3(DEBUG2, "GetMembers: found %s in the cache",
@@ -1272,6 +1423,12 @@ GetMultiXactIdMembers(MultiXactId multi, MultiXactMember **members,
 
 	if (MultiXactIdPrecedes(multi, oldestMXact))
 	{
+		/* A truncated parent only had lockers, all of them long gone */
+		if (isParent)
+		{
+			*members = NULL;
+			return -1;
+		}
 		ereport(ERROR,
 				(errcode(ERRCODE_INTERNAL_ERROR),
 				 errmsg("MultiXactId %u does no longer exist -- apparent wraparound",
@@ -1319,11 +1476,13 @@ GetMultiXactIdMembers(MultiXactId multi, MultiXactMember **members,
 	 * time on every multixact creation.
 	 */
 retry:
-	LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
-
 	pageno = MultiXactIdToOffsetPage(multi);
 	entryno = MultiXactIdToOffsetEntry(multi);
 
+	/* Acquire the bank lock for the page we need. */
+	lock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+
 	slotno = SimpleLruReadPage(MultiXactOffsetCtl, pageno, true, multi);
 	offptr = (MultiXactOffset *) MultiXactOffsetCtl->shared->page_buffer[slotno];
 	offptr += entryno;
@@ -1356,7 +1515,23 @@ retry:
 		entryno = MultiXactIdToOffsetEntry(tmpMXact);
 
 		if (pageno != prev_pageno)
+		{
+			LWLock	   *newlock;
+
+			/*
+			 * Since we're going to access a different SLRU page, if this page
+			 * falls under a different bank, release the old bank's lock and
+			 * acquire the lock of the new bank.
+			 */
+			newlock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
+			if (newlock != lock)
+			{
+				LWLockRelease(lock);
+				LWLockAcquire(newlock, LW_EXCLUSIVE);
+				lock = newlock;
+			}
 			slotno = SimpleLruReadPage(MultiXactOffsetCtl, pageno, true, tmpMXact);
+		}
 
 		offptr = (MultiXactOffset *) MultiXactOffsetCtl->shared->page_buffer[slotno];
 		offptr += entryno;
@@ -1365,7 +1540,7 @@ retry:
 		if (nextMXOffset == 0)
 		{
 			/* Corner case 2: next multixact is still being filled in */
-			LWLockRelease(MultiXactOffsetControlLock);
+			LWLockRelease(lock);
 			CHECK_FOR_INTERRUPTS();
 			pg_usleep(1000L);
 			goto retry;
@@ -1374,14 +1549,13 @@ retry:
 		length = nextMXOffset - offset;
 	}
 
-	LWLockRelease(MultiXactOffsetControlLock);
+	LWLockRelease(lock);
+	lock = NULL;
 
 	ptr = (MultiXactMember *) palloc(length * sizeof(MultiXactMember));
 	*members = ptr;
 
 	/* Now get the members themselves. */
-	LWLockAcquire(MultiXactMemberControlLock, LW_EXCLUSIVE);
-
 	truelength = 0;
 	prev_pageno = -1;
 	for (i = 0; i < length; i++, offset++)
@@ -1397,6 +1571,22 @@ retry:
 
 		if (pageno != prev_pageno)
 		{
+			LWLock	   *newlock;
+
+			/*
+			 * Since we're going to access a different SLRU page, if this page
+			 * falls under a different bank, release the old bank's lock and
+			 * acquire the lock of the new bank.
+			 */
+			newlock = SimpleLruGetBankLock(MultiXactMemberCtl, pageno);
+			if (newlock != lock)
+			{
+				if (lock)
+					LWLockRelease(lock);
+				LWLockAcquire(newlock, LW_EXCLUSIVE);
+				lock = newlock;
+			}
+
 			slotno = SimpleLruReadPage(MultiXactMemberCtl, pageno, true, multi);
 			prev_pageno = pageno;
 		}
@@ -1417,15 +1607,50 @@ retry:
 
 		ptr[truelength].xid = *xactptr;
 		ptr[truelength].status = (*flagsptr >> bshift) & MXACT_MEMBER_XACT_BITMASK;
+
+		/* Remember a parent link, to be resolved below */
+		if (MXACT_IS_PARENT_LINK(ptr[truelength].status))
+		{
+			parent = (MultiXactId) ptr[truelength].xid;
+			linkdepth = MXACT_PARENT_LINK_DEPTH(ptr[truelength].status);
+			continue;
+		}
 		truelength++;
 	}
 
-	LWLockRelease(MultiXactMemberControlLock);
+	if (lock)
+		LWLockRelease(lock);
+
+	/*
+	 * Add the members of the parent, if any.  It only has lockers, so if it's
+	 * too old to be visible to us they can't matter anymore.
+	 */
+	if (MultiXactIdIsValid(parent))
+	{
+		MultiXactMember *parentMembers;
+		int			nparent;
+
+		nparent = GetMultiXactIdMembersInternal(parent, &parentMembers,
+												false, true, true, NULL);
+		if (nparent > 0)
+		{
+			ptr = (MultiXactMember *)
+				repalloc(ptr, (truelength + nparent) * sizeof(MultiXactMember));
+			memcpy(&ptr[truelength], parentMembers,
+				   nparent * sizeof(MultiXactMember));
+			truelength += nparent;
+			pfree(parentMembers);
+		}
+		*members = ptr;
+	}
+
+	if (depth)
+		*depth = linkdepth;
 
 	/*
 	 * Copy the result into the local cache.
 	 */
-	mXactCachePut(multi, truelength, ptr);
+	mXactCachePut(multi, truelength, linkdepth, ptr);
 
 	debug_elog3(DEBUG2, "GetMembers: no cache for %s",
 				mxid_to_string(multi, truelength, ptr));
@@ -1509,10 +1734,11 @@ mXactCacheGetBySet(int nmembers, MultiXactMember *members)
  *		given MultiXactId, if present.
  *
  * If successful, *xids is set to the address of a palloc'd copy of the
- * MultiXactMember set.  Return value is number of members, or -1 on failure.
+ * MultiXactMember set, and *depth (if not NULL) to the length of its chain of
+ * parent links.  Return value is number of members, or -1 on failure.
  */
 static int
-mXactCacheGetById(MultiXactId multi, MultiXactMember **members)
+mXactCacheGetById(MultiXactId multi, MultiXactMember **members, int *depth)
 {
 	dlist_iter	iter;
 
@@ -1532,6 +1758,8 @@ mXactCacheGetById(MultiXactId multi, MultiXactMember **members)
 			*members = ptr;
 
 			memcpy(ptr, entry->members, size);
+			if (depth)
+				*depth = entry->depth;
 
 			debug_elog3(DEBUG2, "CacheGet: found %s",
 						mxid_to_string(multi,
@@ -1558,7 +1786,8 @@ mXactCacheGetById(MultiXactId multi, MultiXactMember **members)
  *		Add a new MultiXactId and its composing set into the local cache.
  */
 static void
-mXactCachePut(MultiXactId multi, int nmembers, MultiXactMember *members)
+mXactCachePut(MultiXactId multi, int nmembers, int depth,
+			  MultiXactMember *members)
 {
 	mXactCacheEnt *entry;
 
@@ -1581,6 +1810,7 @@ mXactCachePut(MultiXactId multi, int nmembers, MultiXactMember *members)
 
 	entry->multi = multi;
 	entry->nmembers = nmembers;
+	entry->depth = depth;
 	memcpy(entry->members, members, nmembers * sizeof(MultiXactMember));
 
 	/* mXactCacheGetBySet assumes the entries are sorted, so sort them */
@@ -1810,8 +2040,8 @@ MultiXactShmemSize(void)
 			 mul_size(sizeof(MultiXactId) * 2, MaxOldestSlot))
 
 	size = SHARED_MULTIXACT_STATE_SIZE;
-	size = add_size(size, SimpleLruShmemSize(NUM_MXACTOFFSET_BUFFERS, 0));
-	size = add_size(size, SimpleLruShmemSize(NUM_MXACTMEMBER_BUFFERS, 0));
+	size = add_size(size, SimpleLruShmemSize(multixact_offset_buffers, 0));
+	size = add_size(size, SimpleLruShmemSize(multixact_member_buffers, 0));
 
 	return size;
 }
@@ -1827,13 +2057,13 @@ MultiXactShmemInit(void)
 	MultiXactMemberCtl->PagePrecedes = MultiXactMemberPagePrecedes;
 
 	SimpleLruInit(MultiXactOffsetCtl,
-				  "multixact_offset", NUM_MXACTOFFSET_BUFFERS, 0,
-				  MultiXactOffsetControlLock, "pg_multixact/offsets",
-				  LWTRANCHE_MXACTOFFSET_BUFFERS);
+				  "multixact_offset", multixact_offset_buffers, 0,
+				  "pg_multixact/offsets", LWTRANCHE_MXACTOFFSET_BUFFERS,
+				  LWTRANCHE_MXACTOFFSET_SLRU);
 	SimpleLruInit(MultiXactMemberCtl,
-				  "multixact_member", NUM_MXACTMEMBER_BUFFERS, 0,
-				  MultiXactMemberControlLock, "pg_multixact/members",
-				  LWTRANCHE_MXACTMEMBER_BUFFERS);
+				  "multixact_member", multixact_member_buffers, 0,
+				  "pg_multixact/members", LWTRANCHE_MXACTMEMBER_BUFFERS,
+				  LWTRANCHE_MXACTMEMBER_SLRU);
 
 	/* Initialize our shared state struct */
 	MultiXactState = ShmemInitStruct("Shared MultiXact State",
@@ -1866,8 +2096,10 @@ void
 BootStrapMultiXact(void)
 {
 	int			slotno;
+	LWLock	   *lock;
 
-	LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
+	lock = SimpleLruGetBankLock(MultiXactOffsetCtl, 0);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/* Create and zero the first page of the offsets log */
 	slotno = ZeroMultiXactOffsetPage(0, false);
@@ -1876,9 +2108,10 @@ BootStrapMultiXact(void)
 	SimpleLruWritePage(MultiXactOffsetCtl, slotno);
 	Assert(!MultiXactOffsetCtl->shared->page_dirty[slotno]);
 
-	LWLockRelease(MultiXactOffsetControlLock);
+	LWLockRelease(lock);
 
-	LWLockAcquire(MultiXactMemberControlLock, LW_EXCLUSIVE);
+	lock = SimpleLruGetBankLock(MultiXactMemberCtl, 0);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/* Create and zero the first page of the members log */
 	slotno = ZeroMultiXactMemberPage(0, false);
@@ -1887,7 +2120,7 @@ BootStrapMultiXact(void)
 	SimpleLruWritePage(MultiXactMemberCtl, slotno);
 	Assert(!MultiXactMemberCtl->shared->page_dirty[slotno]);
 
-	LWLockRelease(MultiXactMemberControlLock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -1897,7 +2130,7 @@ BootStrapMultiXact(void)
  * The page is not actually written, just set up in shared memory.
  * The slot number of the new page is returned.
  *
- * Control lock must be held at entry, and will be held at exit.
+ * Bank lock must be held at entry, and will be held at exit.
  */
 static int
 ZeroMultiXactOffsetPage(int pageno, bool writeXlog)
@@ -1947,10 +2180,12 @@ static void
 MaybeExtendOffsetSlru(void)
 {
 	int			pageno;
+	LWLock	   *lock;
 
 	pageno = MultiXactIdToOffsetPage(MultiXactState->nextMXact);
+	lock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
 
-	LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	if (!SimpleLruDoesPhysicalPageExist(MultiXactOffsetCtl, pageno))
 	{
@@ -1965,7 +2200,7 @@ MaybeExtendOffsetSlru(void)
 		SimpleLruWritePage(MultiXactOffsetCtl, slotno);
 	}
 
-	LWLockRelease(MultiXactOffsetControlLock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -1987,13 +2222,15 @@ StartupMultiXact(void)
 	 * Initialize offset's idea of the latest page number.
 	 */
 	pageno = MultiXactIdToOffsetPage(multi);
-	MultiXactOffsetCtl->shared->latest_page_number = pageno;
+	pg_atomic_write_u32(&MultiXactOffsetCtl->shared->latest_page_number,
+						(uint32) pageno);
 
 	/*
 	 * Initialize member's idea of the latest page number.
 	 */
 	pageno = MXOffsetToMemberPage(offset);
-	MultiXactMemberCtl->shared->latest_page_number = pageno;
+	pg_atomic_write_u32(&MultiXactMemberCtl->shared->latest_page_number,
+						(uint32) pageno);
 }
 
 /*
@@ -2009,6 +2246,7 @@ TrimMultiXact(void)
 	int			pageno;
 	int			entryno;
 	int			flagsoff;
+	LWLock	   *lock;
 
 	LWLockAcquire(MultiXactGenLock, LW_SHARED);
 	nextMXact = MultiXactState->nextMXact;
@@ -2018,13 +2256,16 @@ TrimMultiXact(void)
 	LWLockRelease(MultiXactGenLock);
 
 	/* Clean up offsets state */
-	LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
 
 	/*
 	 * (Re-)Initialize our idea of the latest page number for offsets.
 	 */
 	pageno = MultiXactIdToOffsetPage(nextMXact);
-	MultiXactOffsetCtl->shared->latest_page_number = pageno;
+	pg_atomic_write_u32(&MultiXactOffsetCtl->shared->latest_page_number,
+						(uint32) pageno);
+
+	lock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/*
 	 * Zero out the remainder of the current offsets page.  See notes in
@@ -2049,16 +2290,19 @@ TrimMultiXact(void)
 		MultiXactOffsetCtl->shared->page_dirty[slotno] = true;
 	}
 
-	LWLockRelease(MultiXactOffsetControlLock);
+	LWLockRelease(lock);
 
 	/* And the same for members */
-	LWLockAcquire(MultiXactMemberControlLock, LW_EXCLUSIVE);
 
 	/*
 	 * (Re-)Initialize our idea of the latest page number for members.
 	 */
 	pageno = MXOffsetToMemberPage(offset);
-	MultiXactMemberCtl->shared->latest_page_number = pageno;
+	pg_atomic_write_u32(&MultiXactMemberCtl->shared->latest_page_number,
+						(uint32) pageno);
+
+	lock = SimpleLruGetBankLock(MultiXactMemberCtl, pageno);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/*
 	 * Zero out the remainder of the current members page.  See notes in
@@ -2087,7 +2331,7 @@ TrimMultiXact(void)
 		MultiXactMemberCtl->shared->page_dirty[slotno] = true;
 	}
 
-	LWLockRelease(MultiXactMemberControlLock);
+	LWLockRelease(lock);
 
 	/* signal that we're officially up */
 	LWLockAcquire(MultiXactGenLock, LW_EXCLUSIVE);
@@ -2389,6 +2633,7 @@ static void
 ExtendMultiXactOffset(MultiXactId multi)
 {
 	int			pageno;
+	LWLock	   *lock;
 
 	/*
 	 * No work except at first MultiXactId of a page.  But beware: just after
@@ -2399,13 +2644,14 @@ ExtendMultiXactOffset(MultiXactId multi)
 		return;
 
 	pageno = MultiXactIdToOffsetPage(multi);
+	lock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
 
-	LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
+	LWLockAcquire(lock, LW_EXCLUSIVE);
 
 	/* Zero the page and make an XLOG entry about it */
 	ZeroMultiXactOffsetPage(pageno, true);
 
-	LWLockRelease(MultiXactOffsetControlLock);
+	LWLockRelease(lock);
 }
 
 /*
@@ -2438,15 +2684,17 @@ ExtendMultiXactMember(MultiXactOffset offset, int nmembers)
 		if (flagsoff == 0 && flagsbit == 0)
 		{
 			int			pageno;
+			LWLock	   *lock;
 
 			pageno = MXOffsetToMemberPage(offset);
+			lock = SimpleLruGetBankLock(MultiXactMemberCtl, pageno);
 
-			LWLockAcquire(MultiXactMemberControlLock, LW_EXCLUSIVE);
+			LWLockAcquire(lock, LW_EXCLUSIVE);
 
 			/* Zero the page and make an XLOG entry about it */
 			ZeroMultiXactMemberPage(pageno, true);
 
-			LWLockRelease(MultiXactMemberControlLock);
+			LWLockRelease(lock);
 		}
 
 		/*
@@ -2747,7 +2995,7 @@ find_multixact_start(MultiXactId multi, MultiXactOffset *result)
 	offptr = (MultiXactOffset *) MultiXactOffsetCtl->shared->page_buffer[slotno];
 	offptr += entryno;
 	offset = *offptr;
-	LWLockRelease(MultiXactOffsetControlLock);
+	LWLockRelease(SimpleLruGetBankLock(MultiXactOffsetCtl, pageno));
 
 	*result = offset;
 	return true;
@@ -2882,23 +3130,16 @@ PerformMembersTruncation(MultiXactOffset oldestOffset, MultiXactOffset newOldest
 	const int	maxsegment = MXOffsetToMemberSegment(MaxMultiXactOffset);
 	int			startsegment = MXOffsetToMemberSegment(oldestOffset);
 	int			endsegment = MXOffsetToMemberSegment(newOldestOffset);
-	int			segment = startsegment;
 
 	/*
 	 * Delete all the segments but the last one. The last segment can still
-	 * contain, possibly partially, valid data.
+	 * contain, possibly partially, valid data.  Doing them all in one call
+	 * means the buffers are scanned only once, however many there are.
 	 */
-	while (segment != endsegment)
-	{
-		elog(DEBUG2, "truncating multixact members segment %x", segment);
-		SlruDeleteSegment(MultiXactMemberCtl, segment);
-
-		/* move to next segment, handling wraparound correctly */
-		if (segment == maxsegment)
-			segment = 0;
-		else
-			segment += 1;
-	}
+	elog(DEBUG2, "truncating multixact members segments [%x, %x)",
+		 startsegment, endsegment);
+	SlruDeleteSegmentRange(MultiXactMemberCtl, startsegment, endsegment,
+						   maxsegment);
 }
 
 /*
@@ -3225,31 +3466,35 @@ multixact_redo(XLogReaderState *record)
 	{
 		int			pageno;
 		int			slotno;
+		LWLock	   *lock;
 
 		memcpy(&pageno, XLogRecGetData(record), sizeof(int));
 
-		LWLockAcquire(MultiXactOffsetControlLock, LW_EXCLUSIVE);
+		lock = SimpleLruGetBankLock(MultiXactOffsetCtl, pageno);
+		LWLockAcquire(lock, LW_EXCLUSIVE);
 
 		slotno = ZeroMultiXactOffsetPage(pageno, false);
 		SimpleLruWritePage(MultiXactOffsetCtl, slotno);
 		Assert(!MultiXactOffsetCtl->shared->page_dirty[slotno]);
 
-		LWLockRelease(MultiXactOffsetControlLock);
+		LWLockRelease(lock);
 	}
 	else if (info == XLOG_MULTIXACT_ZERO_MEM_PAGE)
 	{
 		int			pageno;
 		int			slotno;
+		LWLock	   *lock;
 
 		memcpy(&pageno, XLogRecGetData(record), sizeof(int));
 
-		LWLockAcquire(MultiXactMemberControlLock, LW_EXCLUSIVE);
+		lock = SimpleLruGetBankLock(MultiXactMemberCtl, pageno);
+		LWLockAcquire(lock, LW_EXCLUSIVE);
 
 		slotno = ZeroMultiXactMemberPage(pageno, false);
 		SimpleLruWritePage(MultiXactMemberCtl, slotno);
 		Assert(!MultiXactMemberCtl->shared->page_dirty[slotno]);
 
-		LWLockRelease(MultiXactMemberControlLock);
+		LWLockRelease(lock);
 	}
 	else if (info == XLOG_MULTIXACT_CREATE_ID)
 	{
@@ -3274,6 +3519,9 @@ multixact_redo(XLogReaderState *record)
 		max_xid = XLogRecGetXid(record);
 		for (i = 0; i < xlrec->nmembers; i++)
 		{
+			/* a parent link holds a MultiXactId, not an XID */
+			if (MXACT_IS_PARENT_LINK(xlrec->members[i].status))
+				continue;
 			if (TransactionIdPrecedes(max_xid, xlrec->members[i].xid))
 				max_xid = xlrec->members[i].xid;
 		}
@@ -3315,7 +3563,8 @@ multixact_redo(XLogReaderState *record)
 		 * SimpleLruTruncate.
 		 */
 		pageno = MultiXactIdToOffsetPage(xlrec.endTruncOff);
-		MultiXactOffsetCtl->shared->latest_page_number = pageno;
+		pg_atomic_write_u32(&MultiXactOffsetCtl->shared->latest_page_number,
+							(uint32) pageno);
 		PerformOffsetsTruncation(xlrec.startTruncOff, xlrec.endTruncOff);
 
 		LWLockRelease(MultiXactTruncationLock);
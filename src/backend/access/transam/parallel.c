@@ -14,6 +14,8 @@
 
 #include "postgres.h"
 
+#include "access/gin_private.h"
+#include "access/heapam.h"
 #include "access/nbtree.h"
 #include "access/parallel.h"
 #include "access/session.h"
@@ -23,6 +25,8 @@
 #include "catalog/index.h"
 #include "catalog/namespace.h"
 #include "commands/async.h"
+#include "commands/copy.h"
+#include "commands/vacuum.h"
 #include "executor/execParallel.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
@@ -39,6 +43,7 @@
 #include "utils/guc.h"
 #include "utils/inval.h"
 #include "utils/memutils.h"
+#include "utils/numa.h"
 #include "utils/relmapper.h"
 #include "utils/snapmgr.h"
 #include "utils/typcache.h"
@@ -115,6 +120,9 @@ volatile bool ParallelMessagePending = false;
 /* Are we initializing a parallel worker? */
 bool		InitializingParallelWorker = false;
 
+/* GUC: where to run parallel workers */
+int			parallel_worker_affinity = PARALLEL_WORKER_AFFINITY_OFF;
+
 /* Pointer to our fixed parallel state. */
 static FixedParallelState *MyFixedParallelState;
 
@@ -140,6 +148,18 @@ static const struct
 	},
 	{
 		"_bt_parallel_build_main", _bt_parallel_build_main
+	},
+	{
+		"_gin_parallel_build_main", _gin_parallel_build_main
+	},
+	{
+		"parallel_vacuum_main", parallel_vacuum_main
+	},
+	{
+		"ParallelCopyMain", ParallelCopyMain
+	},
+	{
+		"parallel_analyze_main", parallel_analyze_main
 	}
 };
 
@@ -495,6 +515,7 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 {
 	MemoryContext oldcontext;
 	BackgroundWorker worker;
+	int			numa_node = -1;
 	int			i;
 	bool		any_registrations_failed = false;
 
@@ -502,6 +523,15 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	if (pcxt->nworkers == 0)
 		return;
 
+	/*
+	 * If requested, the workers bind themselves to our NUMA node, so that
+	 * they share its caches and memory with us and with each other.  Shared
+	 * memory is placed on the node that first touches it, so the parallel
+	 * query's DSM segments and DSA areas end up there too.
+	 */
+	if (parallel_worker_affinity == PARALLEL_WORKER_AFFINITY_LEADER_NODE)
+		numa_node = pg_numa_current_node();
+
 	/* We need to be a lock group leader. */
 	BecomeLockGroupLeader();
 
@@ -525,6 +555,7 @@ LaunchParallelWorkers(ParallelContext *pcxt)
 	sprintf(worker.bgw_function_name, "ParallelWorkerMain");
 	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(pcxt->seg));
 	worker.bgw_notify_pid = MyProcPid;
+	memcpy(worker.bgw_extra + sizeof(int), &numa_node, sizeof(int));
 
 	/*
 	 * Start workers.
@@ -1226,6 +1257,7 @@ ParallelWorkerMain(Datum main_arg)
 	char	   *enumblacklistspace;
 	StringInfoData msgbuf;
 	char	   *session_dsm_handle_space;
+	int			numa_node;
 
 	/* Set flag to indicate that we're initializing a parallel worker. */
 	InitializingParallelWorker = true;
@@ -1238,6 +1270,16 @@ ParallelWorkerMain(Datum main_arg)
 	Assert(ParallelWorkerNumber == -1);
 	memcpy(&ParallelWorkerNumber, MyBgworkerEntry->bgw_extra, sizeof(int));
 
+	/*
+	 * Move to the leader's NUMA node, if it asked us to.  Do this before we
+	 * touch any memory, so that what we allocate is local to that node.
+	 * It's only an optimization, so don't complain much if it fails.
+	 */
+	memcpy(&numa_node, MyBgworkerEntry->bgw_extra + sizeof(int), sizeof(int));
+	if (numa_node >= 0 && !pg_numa_bind_node(numa_node))
+		elog(DEBUG1, "could not bind parallel worker to NUMA node %d: %m",
+			 numa_node);
+
 	/* Set up a memory context to work in, just for cleanliness. */
 	CurrentMemoryContext = AllocSetContextCreate(TopMemoryContext,
 												 "Parallel worker",
@@ -0,0 +1,943 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallelredo.c
+ *	  Parallel application of WAL records during recovery.
+ *
+ * With parallel_redo_workers > 0, the startup process still reads and
+ * decodes every WAL record, but instead of replaying all of them itself it
+ * hands records off to a set of background workers.  Each block that a
+ * record references is assigned to a worker by hashing its buffer tag, and
+ * a record is sent to a worker only if all of its blocks belong to that
+ * worker.  Each worker replays its records in the order they were sent
+ * to it, so all changes to any given page are still applied in WAL order;
+ * changes to different pages may be applied in any relative order, which is
+ * harmless as long as the redo routine touches nothing but those pages.
+ *
+ * That is only true of a handful of record types, which luckily account for
+ * the bulk of WAL in typical workloads: heap and btree insertions, updates
+ * and deletions, and full-page images.  Everything else acts as a barrier:
+ * the startup process waits for the workers it might conflict with to catch
+ * up, and then replays the record itself, exactly as it would without
+ * parallel redo.  Records touching blocks of more than one worker only
+ * wait for those workers; records that may touch arbitrary pages or shared
+ * state, like relation drops, checkpoints or hot standby conflict records,
+ * wait for all of them.
+ *
+ * Outside hot standby nobody can look at the data until the end of
+ * recovery, so transaction commit and abort records only need to wait for
+ * the workers if they drop relations.  In hot standby mode they always do,
+ * so that a transaction is never visible before all its changes are.  We
+ * also wait for everything to be applied before the server is declared
+ * consistent, before pausing, and at the end of recovery.
+ *
+ * Records are passed to the workers through one shm_mq per worker, in the
+ * main shared memory segment.  Workers report progress by advertising the
+ * end of the last record they have applied, and wake up the startup process
+ * through its latch when it is waiting for them.
+ *
+ * Two things that redo routines normally get away with because only one
+ * process replays WAL need extra care.  First, a redo routine may have to
+ * extend a relation to reach the page it needs; concurrent extension is
+ * serialized by the locks in ParallelRedoCtl->extensionLocks.  Second,
+ * references to missing pages are recorded in a table local to the startup
+ * process (see xlogutils.c); workers pass them on to the startup process,
+ * which enters them into its table before it replays anything that might
+ * resolve them.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/transam/parallelredo.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/heapam_xlog.h"
+#include "access/nbtxlog.h"
+#include "access/parallelredo.h"
+#include "access/rmgr.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogutils.h"
+#include "catalog/pg_control.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/buf_internals.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "storage/standby.h"
+#include "tcop/tcopprot.h"
+#include "utils/hashutils.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+/* size of each worker's input queue */
+#define PARALLEL_REDO_QUEUE_SIZE		(1024 * 1024)
+
+/* number of invalid page references a worker can hold for the startup process */
+#define PARALLEL_REDO_INVALID_PAGES		64
+
+/* number of locks serializing relation extension */
+#define PARALLEL_REDO_EXTENSION_LOCKS	16
+
+/*
+ * Message types.  PR_MSG_SMGR_CLOSE asks the worker to close all its smgr
+ * relations, because the startup process is about to drop or truncate files.
+ */
+typedef enum ParallelRedoMsgType
+{
+	PR_MSG_RECORD,
+	PR_MSG_SMGR_CLOSE
+} ParallelRedoMsgType;
+
+/*
+ * Header of each message.  For PR_MSG_RECORD it is followed by the raw WAL
+ * record, at a MAXALIGN'd offset.
+ */
+typedef struct ParallelRedoMsg
+{
+	XLogRecPtr	ReadRecPtr;
+	XLogRecPtr	EndRecPtr;
+	ParallelRedoMsgType type;
+} ParallelRedoMsg;
+
+typedef union ParallelRedoMsgHeader
+{
+	ParallelRedoMsg msg;
+	char		pad[MAXALIGN(sizeof(ParallelRedoMsg))];
+} ParallelRedoMsgHeader;
+
+typedef struct ParallelRedoInvalidPage
+{
+	RelFileNode node;
+	ForkNumber	forkno;
+	BlockNumber blkno;
+	bool		present;
+} ParallelRedoInvalidPage;
+
+typedef struct ParallelRedoWorkerSlot
+{
+	PGPROC	   *proc;			/* worker's PGPROC, once it has started */
+	pg_atomic_uint64 appliedUpto;	/* end of last record replayed */
+	pg_atomic_uint32 failed;	/* worker exited abnormally */
+
+	/* invalid page references not yet absorbed by the startup process */
+	slock_t		mutex;			/* protects the fields below */
+	int			ninvalid;
+	ParallelRedoInvalidPage invalid[PARALLEL_REDO_INVALID_PAGES];
+} ParallelRedoWorkerSlot;
+
+typedef struct ParallelRedoCtlData
+{
+	int			nworkers;		/* number of workers in this recovery */
+	Latch	   *startupLatch;	/* startup process's latch */
+	pg_atomic_uint32 startupWaiting;	/* is startup waiting for workers? */
+	LWLockPadded extensionLocks[PARALLEL_REDO_EXTENSION_LOCKS];
+	ParallelRedoWorkerSlot slots[MAX_PARALLEL_REDO_WORKERS];
+} ParallelRedoCtlData;
+
+static ParallelRedoCtlData *ParallelRedoCtl = NULL;
+static char *ParallelRedoQueues = NULL;
+
+/* GUC variable */
+int			parallel_redo_workers = 0;
+
+/* State of the startup process */
+static bool parallel_redo_active = false;
+static shm_mq_handle *pr_mqh[MAX_PARALLEL_REDO_WORKERS];
+static XLogRecPtr pr_dispatched[MAX_PARALLEL_REDO_WORKERS];
+
+/* State of a worker */
+static int	MyParallelRedoWorker = -1;
+static bool pr_worker_done = false;
+
+#define PR_QUEUE(i) \
+	((shm_mq *) (ParallelRedoQueues + (Size) (i) * PARALLEL_REDO_QUEUE_SIZE))
+
+#define PR_ALL_WORKERS \
+	((uint32) (((uint64) 1 << ParallelRedoCtl->nworkers) - 1))
+
+static void pr_shutdown_workers(int code, Datum arg);
+static bool pr_record_is_dispatchable(XLogReaderState *record);
+static bool pr_record_is_barrier(XLogReaderState *record, bool *closesmgr);
+static void pr_send(int worker, ParallelRedoMsgType type,
+					XLogReaderState *record);
+static void pr_wait_for_workers(uint32 mask);
+static void pr_check_workers(void);
+static void pr_absorb_invalid_pages(void);
+static void pr_worker_exit(int code, Datum arg);
+static void pr_redo_error_callback(void *arg);
+
+
+/*
+ * Report shared-memory space needed by ParallelRedoShmemInit
+ */
+Size
+ParallelRedoShmemSize(void)
+{
+	Size		size;
+
+	if (parallel_redo_workers == 0)
+		return 0;
+
+	size = MAXALIGN(sizeof(ParallelRedoCtlData));
+	size = add_size(size, mul_size(parallel_redo_workers,
+								   PARALLEL_REDO_QUEUE_SIZE));
+
+	return size;
+}
+
+/*
+ * Allocate and initialize shared memory for parallel redo
+ */
+void
+ParallelRedoShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	StaticAssertStmt(MAX_PARALLEL_REDO_WORKERS <= 32,
+					 "worker masks must fit into a uint32");
+
+	if (parallel_redo_workers == 0)
+		return;
+
+	ParallelRedoCtl = (ParallelRedoCtlData *)
+		ShmemInitStruct("Parallel Redo Data", ParallelRedoShmemSize(), &found);
+	ParallelRedoQueues = (char *) ParallelRedoCtl +
+		MAXALIGN(sizeof(ParallelRedoCtlData));
+
+	if (found)
+		return;
+
+	ParallelRedoCtl->nworkers = 0;
+	ParallelRedoCtl->startupLatch = NULL;
+	pg_atomic_init_u32(&ParallelRedoCtl->startupWaiting, 0);
+	for (i = 0; i < PARALLEL_REDO_EXTENSION_LOCKS; i++)
+		LWLockInitialize(&ParallelRedoCtl->extensionLocks[i].lock,
+						 LWTRANCHE_PARALLEL_REDO_EXTENSION);
+	for (i = 0; i < MAX_PARALLEL_REDO_WORKERS; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[i];
+
+		slot->proc = NULL;
+		pg_atomic_init_u64(&slot->appliedUpto, InvalidXLogRecPtr);
+		pg_atomic_init_u32(&slot->failed, 0);
+		SpinLockInit(&slot->mutex);
+		slot->ninvalid = 0;
+	}
+}
+
+/*
+ * ParallelRedoStart -- launch the redo workers
+ *
+ * Called by the startup process just before entering the redo loop.  If the
+ * workers can't be started, we log that and carry on replaying serially.
+ */
+void
+ParallelRedoStart(void)
+{
+	BackgroundWorkerHandle *handles[MAX_PARALLEL_REDO_WORKERS];
+	MemoryContext oldcontext;
+	int			nworkers = parallel_redo_workers;
+	int			nstarted;
+	int			i;
+
+	Assert(!parallel_redo_active);
+
+	/* Workers need a postmaster to launch them */
+	if (nworkers == 0 || !IsUnderPostmaster)
+		return;
+
+	ParallelRedoCtl->nworkers = nworkers;
+	ParallelRedoCtl->startupLatch = MyLatch;
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 0);
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	for (nstarted = 0; nstarted < nworkers; nstarted++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[nstarted];
+		BackgroundWorker worker;
+		shm_mq	   *mq;
+
+		slot->proc = NULL;
+		pg_atomic_write_u64(&slot->appliedUpto, InvalidXLogRecPtr);
+		pg_atomic_write_u32(&slot->failed, 0);
+		slot->ninvalid = 0;
+		pr_dispatched[nstarted] = InvalidXLogRecPtr;
+
+		mq = shm_mq_create(PR_QUEUE(nstarted), PARALLEL_REDO_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+		pr_mqh[nstarted] = shm_mq_attach(mq, NULL, NULL);
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		sprintf(worker.bgw_library_name, "postgres");
+		sprintf(worker.bgw_function_name, "ParallelRedoWorkerMain");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "parallel redo worker %d",
+				 nstarted);
+		snprintf(worker.bgw_type, BGW_MAXLEN, "parallel redo worker");
+		worker.bgw_main_arg = Int32GetDatum(nstarted);
+		worker.bgw_notify_pid = MyProcPid;
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &handles[nstarted]))
+		{
+			shm_mq_detach(pr_mqh[nstarted]);
+			break;
+		}
+		shm_mq_set_handle(pr_mqh[nstarted], handles[nstarted]);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Make sure they're all up and running */
+	for (i = 0; i < nstarted; i++)
+	{
+		pid_t		pid;
+
+		if (WaitForBackgroundWorkerStartup(handles[i], &pid) != BGWH_STARTED)
+			break;
+	}
+
+	if (nstarted < nworkers || i < nstarted)
+	{
+		/* Detaching from the queues makes any running workers exit */
+		for (i = 0; i < nstarted; i++)
+			shm_mq_detach(pr_mqh[i]);
+		ParallelRedoCtl->nworkers = 0;
+
+		ereport(LOG,
+				(errmsg("could not start parallel redo workers, replaying WAL serially"),
+				 errhint("You might need to increase max_worker_processes.")));
+		return;
+	}
+
+	/* Make sure the workers go away if we exit before ParallelRedoStop() */
+	before_shmem_exit(pr_shutdown_workers, 0);
+
+	parallel_redo_active = true;
+
+	ereport(LOG,
+			(errmsg("replaying WAL with %d parallel redo workers", nworkers)));
+}
+
+/*
+ * ParallelRedoDispatch -- hand a record off to a redo worker, if possible
+ *
+ * Returns true if a worker has taken over the record.  Otherwise the caller
+ * must replay it itself; in that case, we have already waited for all the
+ * workers whose work the record might conflict with.
+ */
+bool
+ParallelRedoDispatch(XLogReaderState *record)
+{
+	uint32		mask = 0;
+	int			worker = -1;
+	int			block_id;
+	bool		closesmgr;
+
+	if (!parallel_redo_active)
+		return false;
+
+	if (!pr_record_is_dispatchable(record))
+	{
+		if (pr_record_is_barrier(record, &closesmgr))
+		{
+			pr_wait_for_workers(PR_ALL_WORKERS);
+
+			/*
+			 * The workers can't have any use for the files we're about to
+			 * remove, but they may still have them open.
+			 */
+			if (closesmgr)
+			{
+				int			i;
+
+				for (i = 0; i < ParallelRedoCtl->nworkers; i++)
+					pr_send(i, PR_MSG_SMGR_CLOSE, NULL);
+			}
+		}
+		return false;
+	}
+
+	for (block_id = 0; block_id <= record->max_block_id; block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+		BufferTag	tag;
+
+		if (!XLogRecGetBlockTag(record, block_id, &rnode, &forknum, &blkno))
+			continue;
+
+		INIT_BUFFERTAG(tag, rnode, forknum, blkno);
+		worker = tag_hash(&tag, sizeof(tag)) % ParallelRedoCtl->nworkers;
+		mask |= (uint32) 1 << worker;
+	}
+
+	/*
+	 * If the record's blocks are spread over several workers, wait for all
+	 * of them and replay the record here.  We do the same if the record asks
+	 * for consistency checking, since only the startup process does that.
+	 */
+	if (mask == 0 || (mask & (mask - 1)) != 0 ||
+		(XLogRecGetInfo(record) & XLR_CHECK_CONSISTENCY) != 0)
+	{
+		pr_wait_for_workers(mask);
+		return false;
+	}
+
+	pr_send(worker, PR_MSG_RECORD, record);
+	pr_dispatched[worker] = record->EndRecPtr;
+
+	return true;
+}
+
+/*
+ * ParallelRedoDrain -- wait until all dispatched records have been replayed
+ *
+ * This also takes over any invalid page references the workers found.
+ */
+void
+ParallelRedoDrain(void)
+{
+	if (!parallel_redo_active)
+		return;
+
+	pr_wait_for_workers(PR_ALL_WORKERS);
+}
+
+/*
+ * ParallelRedoStop -- wait for the workers to finish and shut them down
+ */
+void
+ParallelRedoStop(void)
+{
+	if (!parallel_redo_active)
+		return;
+
+	pr_wait_for_workers(PR_ALL_WORKERS);
+	pr_shutdown_workers(0, 0);
+}
+
+/*
+ * Detach from the workers' queues, which makes them exit once they have
+ * processed everything they were sent.
+ */
+static void
+pr_shutdown_workers(int code, Datum arg)
+{
+	int			i;
+
+	if (!parallel_redo_active)
+		return;
+
+	for (i = 0; i < ParallelRedoCtl->nworkers; i++)
+		shm_mq_detach(pr_mqh[i]);
+
+	ParallelRedoCtl->nworkers = 0;
+	parallel_redo_active = false;
+}
+
+/*
+ * Is this a record a redo worker can replay?
+ *
+ * That's the case if the redo routine touches no other pages than the ones
+ * referenced by the record's blocks, except for visibility map bits being
+ * cleared and free space map updates, which are fine in any order.  It also
+ * mustn't depend on or change any other shared state, resolve recovery
+ * conflicts or wait for cleanup locks.
+ */
+static bool
+pr_record_is_dispatchable(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_XLOG_ID:
+			return info == XLOG_FPI || info == XLOG_FPI_FOR_HINT;
+
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+				case XLOG_HEAP_DELETE:
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+				case XLOG_HEAP_CONFIRM:
+				case XLOG_HEAP_LOCK:
+				case XLOG_HEAP_INPLACE:
+					return true;
+			}
+			return false;
+
+		case RM_HEAP2_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP2_MULTI_INSERT:
+				case XLOG_HEAP2_LOCK_UPDATED:
+					return true;
+			}
+			return false;
+
+		case RM_BTREE_ID:
+			switch (info)
+			{
+				case XLOG_BTREE_INSERT_LEAF:
+				case XLOG_BTREE_INSERT_UPPER:
+				case XLOG_BTREE_INSERT_META:
+				case XLOG_BTREE_SPLIT_L:
+				case XLOG_BTREE_SPLIT_R:
+					return true;
+			}
+			return false;
+	}
+
+	return false;
+}
+
+/*
+ * Does the startup process have to wait for all workers before replaying
+ * this (non-dispatchable) record?  *closesmgr is set if, in addition, the
+ * workers must close their files because the record removes some.
+ */
+static bool
+pr_record_is_barrier(XLogReaderState *record, bool *closesmgr)
+{
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+
+	*closesmgr = false;
+
+	switch (XLogRecGetRmid(record))
+	{
+		case RM_XACT_ID:
+			{
+				uint8		xinfo = info & XLOG_XACT_OPMASK;
+				int			nrels = 0;
+
+				if (xinfo == XLOG_XACT_COMMIT ||
+					xinfo == XLOG_XACT_COMMIT_PREPARED)
+				{
+					xl_xact_parsed_commit parsed;
+
+					ParseCommitRecord(XLogRecGetInfo(record),
+									  (xl_xact_commit *) XLogRecGetData(record),
+									  &parsed);
+					nrels = parsed.nrels;
+				}
+				else if (xinfo == XLOG_XACT_ABORT ||
+						 xinfo == XLOG_XACT_ABORT_PREPARED)
+				{
+					xl_xact_parsed_abort parsed;
+
+					ParseAbortRecord(XLogRecGetInfo(record),
+									 (xl_xact_abort *) XLogRecGetData(record),
+									 &parsed);
+					nrels = parsed.nrels;
+				}
+				else
+					return true;
+
+				if (nrels > 0)
+				{
+					*closesmgr = true;
+					return true;
+				}
+
+				/*
+				 * Committing doesn't touch any data pages, so it's only
+				 * ordering with respect to readers that matters.
+				 */
+				return InHotStandby;
+			}
+
+		case RM_SMGR_ID:
+		case RM_DBASE_ID:
+		case RM_TBLSPC_ID:
+			*closesmgr = true;
+			return true;
+	}
+
+	return true;
+}
+
+/*
+ * Send a message to a worker.
+ *
+ * We don't block in shm_mq_send, so that we can take over invalid page
+ * references from a worker that is waiting for us to do so while we wait
+ * for room in its queue.
+ */
+static void
+pr_send(int worker, ParallelRedoMsgType type, XLogReaderState *record)
+{
+	ParallelRedoMsgHeader hdr;
+	shm_mq_iovec iov[2];
+	int			iovcnt = 1;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg.type = type;
+	iov[0].data = (char *) &hdr;
+	iov[0].len = sizeof(hdr);
+
+	if (record != NULL)
+	{
+		hdr.msg.ReadRecPtr = record->ReadRecPtr;
+		hdr.msg.EndRecPtr = record->EndRecPtr;
+		iov[1].data = (char *) record->decoded_record;
+		iov[1].len = record->decoded_record->xl_tot_len;
+		iovcnt = 2;
+	}
+
+	for (;;)
+	{
+		shm_mq_result res;
+
+		res = shm_mq_sendv(pr_mqh[worker], iov, iovcnt, true, true);
+		if (res == SHM_MQ_SUCCESS)
+			break;
+
+		pr_check_workers();
+		pr_absorb_invalid_pages();
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_MQ_SEND);
+		ResetLatch(MyLatch);
+
+		HandleStartupProcInterrupts();
+	}
+}
+
+/*
+ * Wait until the workers in 'mask' have replayed everything we sent them,
+ * then take over the invalid page references they reported.
+ */
+static void
+pr_wait_for_workers(uint32 mask)
+{
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 1);
+	pg_memory_barrier();
+
+	for (;;)
+	{
+		uint32		pending = 0;
+		int			i;
+
+		for (i = 0; i < ParallelRedoCtl->nworkers; i++)
+		{
+			ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[i];
+
+			if ((mask & ((uint32) 1 << i)) != 0 &&
+				pg_atomic_read_u64(&slot->appliedUpto) < pr_dispatched[i])
+				pending |= (uint32) 1 << i;
+		}
+
+		if (pending == 0)
+			break;
+
+		pr_check_workers();
+		pr_absorb_invalid_pages();
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_PARALLEL_REDO_DRAIN);
+		ResetLatch(MyLatch);
+
+		HandleStartupProcInterrupts();
+		mask = pending;
+	}
+
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 0);
+
+	/* the workers reported invalid pages before advancing appliedUpto */
+	pg_read_barrier();
+	pr_absorb_invalid_pages();
+}
+
+/*
+ * Error out if any worker has died.  There's no way to continue without it:
+ * records it hadn't replayed yet are lost.
+ */
+static void
+pr_check_workers(void)
+{
+	int			i;
+
+	for (i = 0; i < ParallelRedoCtl->nworkers; i++)
+	{
+		if (pg_atomic_read_u32(&ParallelRedoCtl->slots[i].failed) != 0)
+			ereport(FATAL,
+					(errmsg("parallel redo worker %d exited unexpectedly", i)));
+	}
+}
+
+/*
+ * Enter the invalid page references the workers reported into our own
+ * table, see log_invalid_page().
+ */
+static void
+pr_absorb_invalid_pages(void)
+{
+	int			i;
+
+	for (i = 0; i < ParallelRedoCtl->nworkers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[i];
+		ParallelRedoInvalidPage pages[PARALLEL_REDO_INVALID_PAGES];
+		int			n;
+		int			j;
+
+		/* unlocked check is fine, we'll look again */
+		if (slot->ninvalid == 0)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		n = slot->ninvalid;
+		memcpy(pages, slot->invalid, n * sizeof(ParallelRedoInvalidPage));
+		slot->ninvalid = 0;
+		SpinLockRelease(&slot->mutex);
+
+		/* the worker may be waiting for space */
+		if (n == PARALLEL_REDO_INVALID_PAGES && slot->proc != NULL)
+			SetLatch(&slot->proc->procLatch);
+
+		for (j = 0; j < n; j++)
+			XLogRememberInvalidPage(pages[j].node, pages[j].forkno,
+									pages[j].blkno, pages[j].present);
+	}
+}
+
+/*
+ * ParallelRedoLockExtension -- serialize relation extension during redo
+ *
+ * XLogReadBufferExtended() calls this before extending a relation fork.
+ * Returns false, without locking anything, if parallel redo isn't in use.
+ */
+bool
+ParallelRedoLockExtension(RelFileNode rnode, ForkNumber forknum)
+{
+	uint32		h;
+
+	if (!parallel_redo_active && MyParallelRedoWorker < 0)
+		return false;
+
+	h = hash_combine(rnode.relNode, rnode.dbNode) + forknum;
+	LWLockAcquire(&ParallelRedoCtl->extensionLocks[h % PARALLEL_REDO_EXTENSION_LOCKS].lock,
+				  LW_EXCLUSIVE);
+	return true;
+}
+
+void
+ParallelRedoUnlockExtension(RelFileNode rnode, ForkNumber forknum)
+{
+	uint32		h;
+
+	h = hash_combine(rnode.relNode, rnode.dbNode) + forknum;
+	LWLockRelease(&ParallelRedoCtl->extensionLocks[h % PARALLEL_REDO_EXTENSION_LOCKS].lock);
+}
+
+/*
+ * IsParallelRedoWorker -- are we a parallel redo worker?
+ */
+bool
+IsParallelRedoWorker(void)
+{
+	return MyParallelRedoWorker >= 0;
+}
+
+/*
+ * ParallelRedoRememberInvalidPage -- pass an invalid page reference on to
+ * the startup process
+ *
+ * If our slot is full, wait for the startup process to empty it; it always
+ * does so while waiting for us.  The caller mustn't hold any lock the
+ * startup process might need.
+ */
+void
+ParallelRedoRememberInvalidPage(RelFileNode node, ForkNumber forkno,
+								BlockNumber blkno, bool present)
+{
+	ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[MyParallelRedoWorker];
+
+	Assert(IsParallelRedoWorker());
+
+	for (;;)
+	{
+		SpinLockAcquire(&slot->mutex);
+		if (slot->ninvalid < PARALLEL_REDO_INVALID_PAGES)
+		{
+			ParallelRedoInvalidPage *page = &slot->invalid[slot->ninvalid++];
+
+			page->node = node;
+			page->forkno = forkno;
+			page->blkno = blkno;
+			page->present = present;
+			SpinLockRelease(&slot->mutex);
+			return;
+		}
+		SpinLockRelease(&slot->mutex);
+
+		SetLatch(ParallelRedoCtl->startupLatch);
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_PARALLEL_REDO_INVALID_PAGE);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Main entry point for a parallel redo worker
+ */
+void
+ParallelRedoWorkerMain(Datum main_arg)
+{
+	int			id = DatumGetInt32(main_arg);
+	ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[id];
+	shm_mq	   *mq = PR_QUEUE(id);
+	shm_mq_handle *mqh;
+	XLogReaderState *reader;
+	MemoryContext redo_context;
+
+	/* Redo routines are not prepared to be interrupted at random points */
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	MyParallelRedoWorker = id;
+	on_shmem_exit(pr_worker_exit, Int32GetDatum(id));
+	slot->proc = MyProc;
+
+	/* Buffer pins need a resource owner */
+	CreateAuxProcessResourceOwner();
+
+	/* Set up like the startup process, as far as redo routines care */
+	XLogInitRedoWorker();
+
+	MemoryContextSwitchTo(TopMemoryContext);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, NULL, NULL);
+
+	reader = XLogReaderAllocate(wal_segment_size, NULL, NULL);
+	if (reader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "Parallel redo",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		ParallelRedoMsg *msg;
+		XLogRecord *record;
+		ErrorContextCallback errcallback;
+		MemoryContext oldcontext;
+		char	   *errormsg;
+		Size		nbytes;
+		void	   *data;
+
+		/* The startup process detaching means we're done */
+		if (shm_mq_receive(mqh, &nbytes, &data, false) != SHM_MQ_SUCCESS)
+			break;
+
+		msg = (ParallelRedoMsg *) data;
+		if (msg->type == PR_MSG_SMGR_CLOSE)
+		{
+			smgrcloseall();
+			continue;
+		}
+
+		Assert(msg->type == PR_MSG_RECORD);
+		record = (XLogRecord *) ((char *) data + sizeof(ParallelRedoMsgHeader));
+
+		/*
+		 * Decode in TopMemoryContext: the reader keeps the buffers it
+		 * allocates for block data and main data across records, so they
+		 * mustn't go away with redo_context.
+		 */
+		if (!DecodeXLogRecord(reader, record, &errormsg))
+			elog(ERROR, "could not decode WAL record at %X/%X: %s",
+				 (uint32) (msg->ReadRecPtr >> 32), (uint32) msg->ReadRecPtr,
+				 errormsg);
+		reader->ReadRecPtr = msg->ReadRecPtr;
+		reader->EndRecPtr = msg->EndRecPtr;
+
+		errcallback.callback = pr_redo_error_callback;
+		errcallback.arg = (void *) reader;
+		errcallback.previous = error_context_stack;
+		error_context_stack = &errcallback;
+
+		oldcontext = MemoryContextSwitchTo(redo_context);
+		RmgrTable[record->xl_rmid].rm_redo(reader);
+		MemoryContextSwitchTo(oldcontext);
+
+		error_context_stack = errcallback.previous;
+
+		MemoryContextReset(redo_context);
+
+		/* Tell the startup process, if it's waiting for us */
+		pg_atomic_write_u64(&slot->appliedUpto, msg->EndRecPtr);
+		pg_memory_barrier();
+		if (pg_atomic_read_u32(&ParallelRedoCtl->startupWaiting) != 0)
+			SetLatch(ParallelRedoCtl->startupLatch);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	pr_worker_done = true;
+	proc_exit(0);
+}
+
+/*
+ * Let the startup process know if we exit before we're told to.
+ */
+static void
+pr_worker_exit(int code, Datum arg)
+{
+	ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->slots[DatumGetInt32(arg)];
+
+	slot->proc = NULL;
+	if (!pr_worker_done)
+	{
+		pg_atomic_write_u32(&slot->failed, 1);
+		SetLatch(ParallelRedoCtl->startupLatch);
+	}
+}
+
+/*
+ * Error context callback for errors occurring during redo in a worker,
+ * along the lines of rm_redo_error_callback().
+ */
+static void
+pr_redo_error_callback(void *arg)
+{
+	XLogReaderState *record = (XLogReaderState *) arg;
+	const RmgrData *rmgr = &RmgrTable[XLogRecGetRmid(record)];
+	const char *id;
+
+	id = rmgr->rm_identify(XLogRecGetInfo(record));
+	if (id == NULL)
+		id = psprintf("UNKNOWN (%X)", XLogRecGetInfo(record) & ~XLR_INFO_MASK);
+
+	errcontext("WAL redo at %X/%X for %s/%s",
+			   (uint32) (record->ReadRecPtr >> 32),
+			   (uint32) record->ReadRecPtr,
+			   rmgr->rm_name, id);
+}
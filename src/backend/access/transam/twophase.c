@@ -78,6 +78,7 @@
 
 #include "access/commit_ts.h"
 #include "access/htup_details.h"
+#include "access/multixact.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/twophase.h"
@@ -171,8 +172,23 @@ typedef struct GlobalTransactionData
 	bool		ondisk;			/* true if prepare state file is on disk */
 	bool		inredo;			/* true if entry was added via xlog_redo */
 	char		gid[GIDSIZE];	/* The GID assigned to the prepared xact */
+
+	/*
+	 * Copy of the state data, if it fits in TWOPHASE_CACHED_STATE_SIZE bytes,
+	 * so that committing the GXACT doesn't have to read it back from WAL.
+	 * cached_len is 0 if there is no copy.  cached_state always points to
+	 * this GXACT's slot in shared memory.
+	 */
+	uint32		cached_len;
+	char	   *cached_state;
 }			GlobalTransactionData;
 
+/*
+ * Size of each GXACT's slot for a copy of its state data.  This is enough
+ * for a transaction that holds a few dozen locks.
+ */
+#define TWOPHASE_CACHED_STATE_SIZE	2048
+
 /*
  * Two Phase Commit shared state.  Access to this struct is protected
  * by TwoPhaseStateLock.
@@ -245,6 +261,9 @@ TwoPhaseShmemSize(void)
 	size = MAXALIGN(size);
 	size = add_size(size, mul_size(max_prepared_xacts,
 								   sizeof(GlobalTransactionData)));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(max_prepared_xacts,
+								   TWOPHASE_CACHED_STATE_SIZE));
 
 	return size;
 }
@@ -260,6 +279,7 @@ TwoPhaseShmemInit(void)
 	if (!IsUnderPostmaster)
 	{
 		GlobalTransaction gxacts;
+		char	   *cached_states;
 		int			i;
 
 		Assert(!found);
@@ -273,6 +293,8 @@ TwoPhaseShmemInit(void)
 			((char *) TwoPhaseState +
 			 MAXALIGN(offsetof(TwoPhaseStateData, prepXacts) +
 					  sizeof(GlobalTransaction) * max_prepared_xacts));
+		cached_states = (char *) gxacts +
+			MAXALIGN(sizeof(GlobalTransactionData) * max_prepared_xacts);
 		for (i = 0; i < max_prepared_xacts; i++)
 		{
 			/* insert into linked list */
@@ -295,6 +317,10 @@ TwoPhaseShmemInit(void)
 			 * technique.
 			 */
 			gxacts[i].dummyBackendId = MaxBackends + 1 + i;
+
+			gxacts[i].cached_len = 0;
+			gxacts[i].cached_state = cached_states +
+				i * (Size) TWOPHASE_CACHED_STATE_SIZE;
 		}
 	}
 	else
@@ -473,8 +499,11 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 	proc->databaseId = databaseid;
 	proc->roleId = owner;
 	proc->tempNamespaceId = InvalidOid;
+	proc->globalTempFrozenXid = InvalidTransactionId;
+	proc->globalTempMinMulti = InvalidMultiXactId;
 	proc->isBackgroundWorker = false;
 	proc->lwWaiting = false;
+	proc->lwGranted = false;
 	proc->lwWaitMode = 0;
 	proc->waitLock = NULL;
 	proc->waitProcLock = NULL;
@@ -491,6 +520,7 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 	gxact->valid = false;
 	gxact->inredo = false;
 	strcpy(gxact->gid, gid);
+	gxact->cached_len = 0;
 
 	/*
 	 * Remember that we have this GlobalTransaction entry locked for us. If we
@@ -1114,6 +1144,22 @@ EndPrepare(GlobalTransaction gxact)
 				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
 				 errmsg("two-phase state file maximum length exceeded")));
 
+	/*
+	 * Keep a copy of the state data in shared memory if it's small enough,
+	 * for FinishPreparedTransaction.
+	 */
+	if (records.total_len <= TWOPHASE_CACHED_STATE_SIZE)
+	{
+		char	   *p = gxact->cached_state;
+
+		for (record = records.head; record != NULL; record = record->next)
+		{
+			memcpy(p, record->data, record->len);
+			p += record->len;
+		}
+		gxact->cached_len = records.total_len;
+	}
+
 	/*
 	 * Now writing 2PC state data to WAL. We let the WAL's CRC protection
 	 * cover us, so no need to calculate a separate CRC.
@@ -1481,9 +1527,16 @@ FinishPreparedTransaction(const char *gid, bool isCommit)
 	/*
 	 * Read and validate 2PC state data. State data will typically be stored
 	 * in WAL files if the LSN is after the last checkpoint record, or moved
-	 * to disk if for some reason they have lived for a long time.
+	 * to disk if for some reason they have lived for a long time.  Small
+	 * state data is also kept in shared memory since PREPARE, which saves
+	 * reading it back from either.
 	 */
-	if (gxact->ondisk)
+	if (gxact->cached_len > 0)
+	{
+		buf = palloc(gxact->cached_len);
+		memcpy(buf, gxact->cached_state, gxact->cached_len);
+	}
+	else if (gxact->ondisk)
 		buf = ReadTwoPhaseFile(xid, false);
 	else
 		XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, NULL);
@@ -2433,6 +2486,7 @@ PrepareRedoAdd(char *buf, XLogRecPtr start_lsn,
 	gxact->ondisk = XLogRecPtrIsInvalid(start_lsn);
 	gxact->inredo = true;		/* yes, added in redo */
 	strcpy(gxact->gid, gid);
+	gxact->cached_len = 0;
 
 	/* And insert it into the active array */
 	Assert(TwoPhaseState->numPrepXacts < max_prepared_xacts);
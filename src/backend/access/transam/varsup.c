@@ -24,6 +24,7 @@
 #include "postmaster/autovacuum.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
+#include "storage/procarray.h"
 #include "utils/syscache.h"
 
 
@@ -66,6 +67,7 @@ GetNewTransactionId(bool isSubXact)
 	{
 		Assert(!isSubXact);
 		MyPgXact->xid = BootstrapTransactionId;
+		ProcGlobal->xids[MyProc->pgxactoff] = BootstrapTransactionId;
 		return FullTransactionIdFromEpochAndXid(0, BootstrapTransactionId);
 	}
 
@@ -210,18 +212,25 @@ GetNewTransactionId(bool isSubXact)
 	 *
 	 * If there's no room to fit a subtransaction XID into PGPROC, set the
 	 * cache-overflowed flag instead.  This forces readers to look in
-	 * pg_subtrans to map subtransaction XIDs up to top-level XIDs. There is a
-	 * race-condition window, in that the new XID will not appear as running
-	 * until its parent link has been placed into pg_subtrans. However, that
-	 * will happen before anyone could possibly have a reason to inquire about
-	 * the status of the XID, so it seems OK.  (Snapshots taken during this
-	 * window *will* include the parent XID, so they will deliver the correct
-	 * answer later on when someone does have a reason to inquire.)
+	 * pg_subtrans to map subtransaction XIDs up to top-level XIDs, unless
+	 * they find the XID in our overflow array (see SubXidOverflowAdd).  There
+	 * is a race-condition window, in that the new XID will not appear as
+	 * running until its parent link has been placed into pg_subtrans.
+	 * However, that will happen before anyone could possibly have a reason
+	 * to inquire about the status of the XID, so it seems OK.  (Snapshots
+	 * taken during this window *will* include the parent XID, so they will
+	 * deliver the correct answer later on when someone does have a reason to
+	 * inquire.)
 	 */
 	if (!isSubXact)
-		MyPgXact->xid = xid;	/* LWLockRelease acts as barrier */
+	{
+		/* LWLockRelease acts as barrier */
+		MyPgXact->xid = xid;
+		ProcGlobal->xids[MyProc->pgxactoff] = xid;
+	}
 	else
 	{
+		XidCacheStatus *substat = &ProcGlobal->subxidStates[MyProc->pgxactoff];
 		int			nxids = MyPgXact->nxids;
 
 		if (nxids < PGPROC_MAX_CACHED_SUBXIDS)
@@ -229,9 +238,14 @@ GetNewTransactionId(bool isSubXact)
 			MyProc->subxids.xids[nxids] = xid;
 			pg_write_barrier();
 			MyPgXact->nxids = nxids + 1;
+			substat->count = nxids + 1;
 		}
 		else
+		{
 			MyPgXact->overflowed = true;
+			substat->overflowed = true;
+			SubXidOverflowAdd(MyProc, MyPgXact->xid, xid);
+		}
 	}
 
 	LWLockRelease(XidGenLock);
@@ -25,6 +25,7 @@
 #include "access/clog.h"
 #include "access/commit_ts.h"
 #include "access/multixact.h"
+#include "access/parallelredo.h"
 #include "access/rewriteheap.h"
 #include "access/subtrans.h"
 #include "access/timeline.h"
@@ -34,6 +35,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
+#include "access/xlogprefetcher.h"
 #include "access/xlogreader.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
@@ -41,6 +43,7 @@
 #include "catalog/pg_database.h"
 #include "commands/tablespace.h"
 #include "common/controldata_utils.h"
+#include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "port/atomics.h"
@@ -94,6 +97,7 @@ bool		EnableHotStandby = false;
 bool		fullPageWrites = true;
 bool		wal_log_hints = false;
 bool		wal_compression = false;
+bool		wal_record_compression = false;
 char	   *wal_consistency_checking_string = NULL;
 bool	   *wal_consistency_checking = NULL;
 bool		wal_init_zero = true;
@@ -103,6 +107,7 @@ int			sync_method = DEFAULT_SYNC_METHOD;
 int			wal_level = WAL_LEVEL_MINIMAL;
 int			CommitDelay = 0;	/* precommit delay in microseconds */
 int			CommitSiblings = 5; /* # concurrent xacts needed to sleep */
+bool		wal_group_commit = true;
 int			wal_retrieve_retry_interval = 5000;
 
 #ifdef WAL_DEBUG
@@ -112,11 +117,14 @@ bool		XLOG_DEBUG = false;
 int			wal_segment_size = DEFAULT_XLOG_SEG_SIZE;
 
 /*
- * Number of WAL insertion locks to use. A higher value allows more insertions
- * to happen concurrently, but adds some CPU overhead to flushing the WAL,
- * which needs to iterate all the locks.
+ * Number of WAL insertion locks to use (GUC wal_insert_locks). A higher value
+ * allows more insertions to happen concurrently, but adds some CPU overhead
+ * to flushing the WAL, which needs to iterate all the locks.  -1 means choose
+ * based on max_connections, see XLOGChooseNumInsertLocks().
  */
-#define NUM_XLOGINSERT_LOCKS  8
+int			wal_insert_locks = -1;
+
+#define MAX_AUTO_XLOGINSERT_LOCKS	64
 
 /*
  * Max distance from last checkpoint, before triggering a new xlog-based
@@ -612,6 +620,14 @@ typedef struct XLogCtlData
 	 */
 	XLogwrtResult LogwrtResult;
 
+	/*
+	 * All insertions before this point are known to have finished.  It is
+	 * advanced by WaitXLogInsertionsToFinish(), and may lag behind.  Kept
+	 * here rather than in XLogCtlInsert, since it changes about as often as
+	 * LogwrtResult does.
+	 */
+	pg_atomic_uint64 insertsFinishedUpto;
+
 	/*
 	 * Latest initialized page in the cache (last byte position + 1).
 	 *
@@ -878,6 +894,7 @@ static XLogRecPtr XLogGetReplicationSlotMinimumLSN(void);
 static void AdvanceXLInsertBuffer(XLogRecPtr upto, bool opportunistic);
 static bool XLogCheckpointNeeded(XLogSegNo new_segno);
 static void XLogWrite(XLogwrtRqst WriteRqst, bool flexible);
+static void XLogFlushGroup(XLogRecPtr upto);
 static bool InstallXLogFileSegment(XLogSegNo *segno, char *tmppath,
 								   bool find_free, XLogSegNo max_segno,
 								   bool use_lock);
@@ -922,6 +939,7 @@ static bool read_tablespace_map(List **tablespaces);
 
 static void rm_redo_error_callback(void *arg);
 static int	get_sync_bit(int method);
+static int	get_wal_open_flags(int method);
 
 static void CopyXLogRecordToWAL(int write_len, bool isLogSwitch,
 								XLogRecData *rdata,
@@ -957,6 +975,9 @@ static void WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt);
  * 'flags' gives more in-depth control on the record being inserted. See
  * XLogSetRecordFlags() for details.
  *
+ * 'num_fpi' is the number of full-page images in the record; it is only
+ * used to update the WAL usage counters.
+ *
  * The first XLogRecData in the chain must be for the record header, and its
  * data must be MAXALIGNed.  XLogInsertRecord fills in the xl_prev and
  * xl_crc fields in the header, the rest of the header must already be filled
@@ -971,7 +992,8 @@ static void WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt);
 XLogRecPtr
 XLogInsertRecord(XLogRecData *rdata,
 				 XLogRecPtr fpw_lsn,
-				 uint8 flags)
+				 uint8 flags,
+				 int num_fpi)
 {
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	pg_crc32c	rdata_crc;
@@ -1009,7 +1031,7 @@ XLogInsertRecord(XLogRecData *rdata,
 	 * inserter acquires an insertion lock. In addition to just indicating that
 	 * an insertion is in progress, the lock tells others how far the inserter
 	 * has progressed. There is a small fixed number of insertion locks,
-	 * determined by NUM_XLOGINSERT_LOCKS. When an inserter crosses a page
+	 * determined by wal_insert_locks. When an inserter crosses a page
 	 * boundary, it updates the value stored in the lock to the how far it has
 	 * inserted, to allow the previous buffer to be flushed.
 	 *
@@ -1226,6 +1248,14 @@ XLogInsertRecord(XLogRecData *rdata,
 	ProcLastRecPtr = StartPos;
 	XactLastRecEnd = EndPos;
 
+	/* Report WAL traffic to the instrumentation. */
+	if (inserted)
+	{
+		pgWalUsage.wal_records++;
+		pgWalUsage.wal_fpi += num_fpi;
+		pgWalUsage.wal_bytes += rechdr->xl_tot_len;
+	}
+
 	return EndPos;
 }
 
@@ -1631,7 +1661,7 @@ WALInsertLockAcquire(void)
 	static int	lockToTry = -1;
 
 	if (lockToTry == -1)
-		lockToTry = MyProc->pgprocno % NUM_XLOGINSERT_LOCKS;
+		lockToTry = MyProc->pgprocno % wal_insert_locks;
 	MyLockNo = lockToTry;
 
 	/*
@@ -1649,7 +1679,7 @@ WALInsertLockAcquire(void)
 		 * than locks, it still helps to distribute the inserters evenly
 		 * across the locks.
 		 */
-		lockToTry = (lockToTry + 1) % NUM_XLOGINSERT_LOCKS;
+		lockToTry = (lockToTry + 1) % wal_insert_locks;
 	}
 }
 
@@ -1667,7 +1697,7 @@ WALInsertLockAcquireExclusive(void)
 	 * indicator is set to 0xFFFFFFFFFFFFFFFF, which is higher than any real
 	 * XLogRecPtr value, to make sure that no-one blocks waiting on those.
 	 */
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS - 1; i++)
+	for (i = 0; i < wal_insert_locks - 1; i++)
 	{
 		LWLockAcquire(&WALInsertLocks[i].l.lock, LW_EXCLUSIVE);
 		LWLockUpdateVar(&WALInsertLocks[i].l.lock,
@@ -1693,7 +1723,7 @@ WALInsertLockRelease(void)
 	{
 		int			i;
 
-		for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+		for (i = 0; i < wal_insert_locks; i++)
 			LWLockReleaseClearVar(&WALInsertLocks[i].l.lock,
 								  &WALInsertLocks[i].l.insertingAt,
 								  0);
@@ -1721,8 +1751,8 @@ WALInsertLockUpdateInsertingAt(XLogRecPtr insertingAt)
 		 * We use the last lock to mark our actual position, see comments in
 		 * WALInsertLockAcquireExclusive.
 		 */
-		LWLockUpdateVar(&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.lock,
-						&WALInsertLocks[NUM_XLOGINSERT_LOCKS - 1].l.insertingAt,
+		LWLockUpdateVar(&WALInsertLocks[wal_insert_locks - 1].l.lock,
+						&WALInsertLocks[wal_insert_locks - 1].l.insertingAt,
 						insertingAt);
 	}
 	else
@@ -1751,12 +1781,24 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	uint64		bytepos;
 	XLogRecPtr	reservedUpto;
 	XLogRecPtr	finishedUpto;
+	XLogRecPtr	knownFinished;
 	XLogCtlInsert *Insert = &XLogCtl->Insert;
 	int			i;
 
 	if (MyProc == NULL)
 		elog(PANIC, "cannot wait without a PGPROC structure");
 
+	/*
+	 * Quick exit if an earlier call has already established that all
+	 * insertions up to the requested point are finished.  That is often the
+	 * case when several backends want WAL flushed at the same time, and saves
+	 * each of them from visiting every insertion lock.
+	 */
+	pg_memory_barrier();
+	knownFinished = pg_atomic_read_u64(&XLogCtl->insertsFinishedUpto);
+	if (upto <= knownFinished)
+		return knownFinished;
+
 	/* Read the current insert position */
 	SpinLockAcquire(&Insert->insertpos_lck);
 	bytepos = Insert->CurrBytePos;
@@ -1789,7 +1831,7 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 	 * out for any insertion that's still in progress.
 	 */
 	finishedUpto = reservedUpto;
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	insertingat = InvalidXLogRecPtr;
 
@@ -1825,7 +1867,19 @@ WaitXLogInsertionsToFinish(XLogRecPtr upto)
 		if (insertingat != InvalidXLogRecPtr && insertingat < finishedUpto)
 			finishedUpto = insertingat;
 	}
-	return finishedUpto;
+
+	/*
+	 * Advertise what we found, for the benefit of the quick exit above;
+	 * unless someone else has meanwhile established a later point, which
+	 * we'd then better return ourselves.
+	 */
+	while (knownFinished < finishedUpto)
+	{
+		if (pg_atomic_compare_exchange_u64(&XLogCtl->insertsFinishedUpto,
+										   &knownFinished, finishedUpto))
+			return finishedUpto;
+	}
+	return knownFinished;
 }
 
 /*
@@ -2177,6 +2231,14 @@ AdvanceXLInsertBuffer(XLogRecPtr upto, bool opportunistic)
 
 		NewPage = (XLogPageHeader) (XLogCtl->pages + nextidx * (Size) XLOG_BLCKSZ);
 
+		/*
+		 * Mark the buffer as not holding any page while we overwrite it, so
+		 * that XLogReadFromBuffers() can't mistake a partially overwritten
+		 * buffer for the old page.
+		 */
+		*((volatile XLogRecPtr *) &XLogCtl->xlblocks[nextidx]) = InvalidXLogRecPtr;
+		pg_write_barrier();
+
 		/*
 		 * Be sure to re-zero the buffer so that bytes beyond what we've
 		 * written will look like zeroes and not valid XLOG records...
@@ -2863,6 +2925,16 @@ XLogFlush(XLogRecPtr record)
 		 */
 		insertpos = WaitXLogInsertionsToFinish(WriteRqstPtr);
 
+		/*
+		 * With group commit, queue up behind whoever is going to flush next
+		 * and let a single leader do the write and fsync for everyone.
+		 */
+		if (wal_group_commit && MyProc != NULL)
+		{
+			XLogFlushGroup(insertpos);
+			break;
+		}
+
 		/*
 		 * Try to get the write lock. If we can't get it immediately, wait
 		 * until it's released, and recheck if we still need to do the flush
@@ -2959,6 +3031,156 @@ XLogFlush(XLogRecPtr record)
 			 (uint32) (LogwrtResult.Flush >> 32), (uint32) LogwrtResult.Flush);
 }
 
+/*
+ * XLogFlushGroup -- flush WAL up to 'upto' as a member of a group
+ *
+ * When many backends commit at once, having each of them acquire
+ * WALWriteLock in turn just to discover that the previous holder flushed
+ * their record already is expensive.  Instead, backends add themselves to a
+ * list of processes waiting for a flush.  The first one to do so becomes the
+ * leader: it acquires WALWriteLock on behalf of the whole group, writes and
+ * flushes far enough to satisfy every member, and then wakes the others.
+ * This mirrors ProcArrayGroupClearXid().
+ *
+ * The caller must already have waited for all insertions up to 'upto' to
+ * finish.  That lets the leader write out everything the group asks for
+ * without calling WaitXLogInsertionsToFinish() while holding WALWriteLock,
+ * which would be unsafe.
+ *
+ * On return, LogwrtResult has been refreshed and WAL is flushed at least
+ * up to 'upto'.  This is called inside a critical section, so any error in
+ * the leader is a PANIC and followers can never be left waiting.
+ */
+static void
+XLogFlushGroup(XLogRecPtr upto)
+{
+	PROC_HDR   *procglobal = ProcGlobal;
+	PGPROC	   *proc = MyProc;
+	uint32		nextidx;
+	uint32		wakeidx;
+	XLogRecPtr	target = 0;
+
+	/* Add ourselves to the list of processes needing a flush. */
+	proc->walFlushGroupMember = true;
+	proc->walFlushGroupUpto = upto;
+	while (true)
+	{
+		nextidx = pg_atomic_read_u32(&procglobal->walFlushGroupFirst);
+		pg_atomic_write_u32(&proc->walFlushGroupNext, nextidx);
+
+		if (pg_atomic_compare_exchange_u32(&procglobal->walFlushGroupFirst,
+										   &nextidx,
+										   (uint32) proc->pgprocno))
+			break;
+	}
+
+	/*
+	 * If the list was not empty, the leader will flush for us.  As in
+	 * ProcArrayGroupClearXid(), there can't be followers without a leader.
+	 */
+	if (nextidx != INVALID_PGPROCNO)
+	{
+		int			extraWaits = 0;
+
+		/* Sleep until the leader has flushed our WAL. */
+		pgstat_report_wait_start(WAIT_EVENT_WAL_GROUP_FLUSH);
+		for (;;)
+		{
+			/* acts as a read barrier */
+			PGSemaphoreLock(proc->sem);
+			if (!proc->walFlushGroupMember)
+				break;
+			extraWaits++;
+		}
+		pgstat_report_wait_end();
+
+		Assert(pg_atomic_read_u32(&proc->walFlushGroupNext) == INVALID_PGPROCNO);
+
+		/* Fix semaphore count for any absorbed wakeups */
+		while (extraWaits-- > 0)
+			PGSemaphoreUnlock(proc->sem);
+
+		SpinLockAcquire(&XLogCtl->info_lck);
+		LogwrtResult = XLogCtl->LogwrtResult;
+		SpinLockRelease(&XLogCtl->info_lck);
+		return;
+	}
+
+	/*
+	 * We are the leader.  Acquire the lock on behalf of everyone; more
+	 * followers can join the group while we wait for it.
+	 */
+	LWLockAcquire(WALWriteLock, LW_EXCLUSIVE);
+
+	/*
+	 * commit_delay gives further backends the opportunity to join the group
+	 * before we close it, just as it does in the ungrouped case.
+	 */
+	if (CommitDelay > 0 && enableFsync &&
+		MinimumActiveBackends(CommitSiblings))
+		pg_usleep(CommitDelay);
+
+	/*
+	 * Now detach the whole list, saving a pointer to its head.  Trying to pop
+	 * elements one at a time could lead to an ABA problem.  Anyone arriving
+	 * from here on starts a new group.
+	 */
+	nextidx = pg_atomic_exchange_u32(&procglobal->walFlushGroupFirst,
+									 INVALID_PGPROCNO);
+
+	/* Remember head of list so we can perform wakeups after dropping lock. */
+	wakeidx = nextidx;
+
+	/* Walk the list to find out how far we need to flush. */
+	while (nextidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = GetPGProcByNumber(nextidx);
+
+		if (target < member->walFlushGroupUpto)
+			target = member->walFlushGroupUpto;
+
+		nextidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+	}
+
+	/*
+	 * Every member waited for insertions up to its own request to finish, so
+	 * everything up to the largest of them is safe to write.
+	 */
+	LogwrtResult = XLogCtl->LogwrtResult;
+	if (LogwrtResult.Flush < target)
+	{
+		XLogwrtRqst WriteRqst;
+
+		WriteRqst.Write = target;
+		WriteRqst.Flush = target;
+		XLogWrite(WriteRqst, false);
+	}
+
+	/* We're done with the lock now. */
+	LWLockRelease(WALWriteLock);
+
+	/*
+	 * Now that we've released the lock, go back and wake everybody up.  As
+	 * in ProcArrayGroupClearXid(), the system calls needed for that are best
+	 * kept out of the lock.
+	 */
+	while (wakeidx != INVALID_PGPROCNO)
+	{
+		PGPROC	   *member = GetPGProcByNumber(wakeidx);
+
+		wakeidx = pg_atomic_read_u32(&member->walFlushGroupNext);
+		pg_atomic_write_u32(&member->walFlushGroupNext, INVALID_PGPROCNO);
+
+		/* ensure all previous writes are visible before follower continues. */
+		pg_write_barrier();
+
+		member->walFlushGroupMember = false;
+
+		if (member != MyProc)
+			PGSemaphoreUnlock(member->sem);
+	}
+}
+
 /*
  * Write & flush xlog, but without specifying exactly where to.
  *
@@ -3220,7 +3442,7 @@ XLogFileInit(XLogSegNo logsegno, bool *use_existent, bool use_lock)
 	 */
 	if (*use_existent)
 	{
-		fd = BasicOpenFile(path, O_RDWR | PG_BINARY | get_sync_bit(sync_method));
+		fd = BasicOpenFile(path, O_RDWR | PG_BINARY | get_wal_open_flags(sync_method));
 		if (fd < 0)
 		{
 			if (errno != ENOENT)
@@ -3362,7 +3584,7 @@ XLogFileInit(XLogSegNo logsegno, bool *use_existent, bool use_lock)
 	*use_existent = false;
 
 	/* Now open original target segment (might not be file I just made) */
-	fd = BasicOpenFile(path, O_RDWR | PG_BINARY | get_sync_bit(sync_method));
+	fd = BasicOpenFile(path, O_RDWR | PG_BINARY | get_wal_open_flags(sync_method));
 	if (fd < 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
@@ -3601,7 +3823,7 @@ XLogFileOpen(XLogSegNo segno)
 
 	XLogFilePath(path, ThisTimeLineID, segno, wal_segment_size);
 
-	fd = BasicOpenFile(path, O_RDWR | PG_BINARY | get_sync_bit(sync_method));
+	fd = BasicOpenFile(path, O_RDWR | PG_BINARY | get_wal_open_flags(sync_method));
 	if (fd < 0)
 		ereport(PANIC,
 				(errcode_for_file_access(),
@@ -4871,6 +5093,48 @@ XLOGChooseNumBuffers(void)
 	return xbuffers;
 }
 
+/*
+ * Auto-tune the number of WAL insertion locks.
+ *
+ * We use one lock per 16 allowed connections, but no fewer than 8 (the
+ * value used before this was made configurable) and no more than
+ * MAX_AUTO_XLOGINSERT_LOCKS, since flushing WAL has to look at all of them.
+ */
+static int
+XLOGChooseNumInsertLocks(void)
+{
+	int			nlocks;
+
+	nlocks = MaxConnections / 16;
+	if (nlocks > MAX_AUTO_XLOGINSERT_LOCKS)
+		nlocks = MAX_AUTO_XLOGINSERT_LOCKS;
+	if (nlocks < 8)
+		nlocks = 8;
+	return nlocks;
+}
+
+/*
+ * GUC check_hook for wal_insert_locks
+ */
+bool
+check_wal_insert_locks(int *newval, void **extra, GucSource source)
+{
+	/*
+	 * -1 indicates a request for auto-tune.  As with wal_buffers, leave the
+	 * boot_val alone until XLOGShmemSize is called.
+	 */
+	if (*newval == -1 && wal_insert_locks != -1)
+		*newval = XLOGChooseNumInsertLocks();
+
+	if (*newval == 0)
+	{
+		GUC_check_errdetail("At least one WAL insertion lock is required.");
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * GUC check_hook for wal_buffers
  */
@@ -4949,11 +5213,21 @@ XLOGShmemSize(void)
 	}
 	Assert(XLOGbuffers > 0);
 
+	/* Likewise for wal_insert_locks */
+	if (wal_insert_locks == -1)
+	{
+		char		buf[32];
+
+		snprintf(buf, sizeof(buf), "%d", XLOGChooseNumInsertLocks());
+		SetConfigOption("wal_insert_locks", buf, PGC_POSTMASTER, PGC_S_OVERRIDE);
+	}
+	Assert(wal_insert_locks > 0);
+
 	/* XLogCtl */
 	size = sizeof(XLogCtlData);
 
 	/* WAL insertion locks, plus alignment */
-	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), NUM_XLOGINSERT_LOCKS + 1));
+	size = add_size(size, mul_size(sizeof(WALInsertLockPadded), wal_insert_locks + 1));
 	/* xlblocks array */
 	size = add_size(size, mul_size(sizeof(XLogRecPtr), XLOGbuffers));
 	/* extra alignment padding for XLOG I/O buffers */
@@ -5045,10 +5319,10 @@ XLOGShmemInit(void)
 		((uintptr_t) allocptr) % sizeof(WALInsertLockPadded);
 	WALInsertLocks = XLogCtl->Insert.WALInsertLocks =
 		(WALInsertLockPadded *) allocptr;
-	allocptr += sizeof(WALInsertLockPadded) * NUM_XLOGINSERT_LOCKS;
+	allocptr += sizeof(WALInsertLockPadded) * wal_insert_locks;
 
 	LWLockRegisterTranche(LWTRANCHE_WAL_INSERT, "wal_insert");
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		LWLockInitialize(&WALInsertLocks[i].l.lock, LWTRANCHE_WAL_INSERT);
 		WALInsertLocks[i].l.insertingAt = InvalidXLogRecPtr;
@@ -5074,6 +5348,7 @@ XLOGShmemInit(void)
 	XLogCtl->WalWriterSleeping = false;
 
 	SpinLockInit(&XLogCtl->Insert.insertpos_lck);
+	pg_atomic_init_u64(&XLogCtl->insertsFinishedUpto, InvalidXLogRecPtr);
 	SpinLockInit(&XLogCtl->info_lck);
 	SpinLockInit(&XLogCtl->ulsn_lck);
 	InitSharedLatch(&XLogCtl->recoveryWakeupLatch);
@@ -5929,6 +6204,9 @@ recoveryPausesHere(void)
 	if (!LocalHotStandbyActive)
 		return;
 
+	/* Let users see everything replayed so far */
+	ParallelRedoDrain();
+
 	ereport(LOG,
 			(errmsg("recovery has paused"),
 			 errhint("Execute pg_wal_replay_resume() to continue.")));
@@ -6222,6 +6500,7 @@ StartupXLOG(void)
 	bool		backupFromStandby = false;
 	DBState		dbstate_at_startup;
 	XLogReaderState *xlogreader;
+	XLogPrefetcher *prefetcher;
 	XLogPageReadPrivate private;
 	bool		fast_promoted = false;
 	struct stat st;
@@ -6753,6 +7032,13 @@ StartupXLOG(void)
 		InRecovery = true;
 	}
 
+	/*
+	 * Load the statistics saved at the last clean shutdown.  If we're going
+	 * to perform recovery they may be invalid; they are reset below instead.
+	 */
+	if (!InRecovery)
+		pgstat_restore_stats();
+
 	/* REDO */
 	if (InRecovery)
 	{
@@ -7044,6 +7330,9 @@ StartupXLOG(void)
 					(errmsg("redo starts at %X/%X",
 							(uint32) (ReadRecPtr >> 32), (uint32) ReadRecPtr)));
 
+			ParallelRedoStart();
+			prefetcher = XLogPrefetcherAllocate();
+
 			/*
 			 * main redo apply loop
 			 */
@@ -7187,17 +7476,26 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
-				/* Now apply the WAL record itself */
-				RmgrTable[record->xl_rmid].rm_redo(xlogreader);
+				/* Prefetch blocks that upcoming records will need */
+				XLogPrefetcherReadAhead(prefetcher, ReadRecPtr);
 
 				/*
-				 * After redo, check whether the backup pages associated with
-				 * the WAL record are consistent with the existing pages. This
-				 * check is done only if consistency check is enabled for this
-				 * record.
+				 * Now apply the WAL record itself, unless a parallel redo
+				 * worker takes care of it.
 				 */
-				if ((record->xl_info & XLR_CHECK_CONSISTENCY) != 0)
-					checkXLogConsistency(xlogreader);
+				if (!ParallelRedoDispatch(xlogreader))
+				{
+					RmgrTable[record->xl_rmid].rm_redo(xlogreader);
+
+					/*
+					 * After redo, check whether the backup pages associated
+					 * with the WAL record are consistent with the existing
+					 * pages. This check is done only if consistency check is
+					 * enabled for this record.
+					 */
+					if ((record->xl_info & XLR_CHECK_CONSISTENCY) != 0)
+						checkXLogConsistency(xlogreader);
+				}
 
 				/* Pop the error context stack */
 				error_context_stack = errcallback.previous;
@@ -7261,6 +7559,10 @@ StartupXLOG(void)
 			 * end of main redo apply loop
 			 */
 
+			/* Wait for any records still being replayed by workers */
+			ParallelRedoStop();
+			XLogPrefetcherFree(prefetcher);
+
 			if (reachedStopPoint)
 			{
 				if (!reachedConsistency)
@@ -7837,6 +8139,8 @@ CheckRecoveryConsistency(void)
 		 * allow starting up at an earlier point even if recovery is stopped
 		 * and restarted soon after this.
 		 */
+		ParallelRedoDrain();
+
 		elog(DEBUG1, "end of backup reached");
 
 		LWLockAcquire(ControlFileLock, LW_EXCLUSIVE);
@@ -7863,6 +8167,12 @@ CheckRecoveryConsistency(void)
 		minRecoveryPoint <= lastReplayedEndRecPtr &&
 		XLogRecPtrIsInvalid(ControlFile->backupStartPoint))
 	{
+		/*
+		 * Everything up to here must really have been replayed, and any
+		 * invalid page references the redo workers found must be known.
+		 */
+		ParallelRedoDrain();
+
 		/*
 		 * Check to see if the XLOG sequence contained any unresolved
 		 * references to uninitialized pages.
@@ -8173,6 +8483,26 @@ InitXLOGAccess(void)
 	InitXLogInsert();
 }
 
+/*
+ * Initialize the XLOG state of a parallel redo worker, which replays WAL
+ * records on behalf of the startup process.
+ */
+void
+XLogInitRedoWorker(void)
+{
+	/* Redo routines expect to run in recovery */
+	InRecovery = true;
+
+	/*
+	 * Pick up minRecoveryPoint as the startup process did, so that flushing
+	 * a buffer updates it, or not, in the same way.
+	 */
+	LWLockAcquire(ControlFileLock, LW_SHARED);
+	minRecoveryPoint = ControlFile->minRecoveryPoint;
+	minRecoveryPointTLI = ControlFile->minRecoveryPointTLI;
+	LWLockRelease(ControlFileLock);
+}
+
 /*
  * Return the current Redo pointer from shared memory.
  *
@@ -8261,7 +8591,7 @@ GetLastImportantRecPtr(void)
 	XLogRecPtr	res = InvalidXLogRecPtr;
 	int			i;
 
-	for (i = 0; i < NUM_XLOGINSERT_LOCKS; i++)
+	for (i = 0; i < wal_insert_locks; i++)
 	{
 		XLogRecPtr	last_important;
 
@@ -8396,9 +8726,9 @@ LogCheckpointEnd(bool restartpoint)
 						&sync_secs, &sync_usecs);
 
 	/* Accumulate checkpoint timing summary data, in milliseconds. */
-	BgWriterStats.m_checkpoint_write_time +=
+	BgWriterStats.checkpoint_write_time +=
 		write_secs * 1000 + write_usecs / 1000;
-	BgWriterStats.m_checkpoint_sync_time +=
+	BgWriterStats.checkpoint_sync_time +=
 		sync_secs * 1000 + sync_usecs / 1000;
 
 	/*
@@ -8431,7 +8761,7 @@ LogCheckpointEnd(bool restartpoint)
 	elog(LOG, "%s complete: wrote %d buffers (%.1f%%); "
 		 "%d WAL file(s) added, %d removed, %d recycled; "
 		 "write=%ld.%03d s, sync=%ld.%03d s, total=%ld.%03d s; "
-		 "sync files=%d, longest=%ld.%03d s, average=%ld.%03d s; "
+		 "sync files=%d (%d early), longest=%ld.%03d s, average=%ld.%03d s; "
 		 "distance=%d kB, estimate=%d kB",
 		 restartpoint ? "restartpoint" : "checkpoint",
 		 CheckpointStats.ckpt_bufs_written,
@@ -8443,6 +8773,7 @@ LogCheckpointEnd(bool restartpoint)
 		 sync_secs, sync_usecs / 1000,
 		 total_secs, total_usecs / 1000,
 		 CheckpointStats.ckpt_sync_rels,
+		 CheckpointStats.ckpt_early_sync_rels,
 		 longest_secs, longest_usecs / 1000,
 		 average_secs, average_usecs / 1000,
 		 (int) (PrevCheckPointDistance / 1024.0),
@@ -10056,6 +10387,24 @@ get_sync_bit(int method)
 	}
 }
 
+/*
+ * Return the flags, besides O_RDWR and PG_BINARY, to open a WAL segment
+ * with: the sync flag for the given method, plus O_DIRECT whatever the
+ * method if io_direct includes "wal".  As in get_sync_bit(), walreceiver
+ * never uses O_DIRECT, because it writes WAL in unaligned pieces as it
+ * arrives.
+ */
+static int
+get_wal_open_flags(int method)
+{
+	int			flags = get_sync_bit(method);
+
+	if ((io_direct_flags & IO_DIRECT_WAL) && !AmWalReceiverProcess())
+		flags |= PG_O_DIRECT;
+
+	return flags;
+}
+
 /*
  * GUC support
  */
@@ -10079,7 +10428,8 @@ assign_xlog_sync_method(int new_sync_method, void *extra)
 						 errmsg("could not fsync file \"%s\": %m",
 								XLogFileNameP(ThisTimeLineID, openLogSegNo))));
 			pgstat_report_wait_end();
-			if (get_sync_bit(sync_method) != get_sync_bit(new_sync_method))
+			if (get_wal_open_flags(sync_method) !=
+				get_wal_open_flags(new_sync_method))
 				XLogFileClose();
 		}
 	}
@@ -11153,6 +11503,22 @@ GetXLogReplayRecPtr(TimeLineID *replayTLI)
 	return recptr;
 }
 
+/*
+ * Get the timeline that WAL at the given position, at or after the current
+ * replay position, is expected to be found on.
+ *
+ * Only for use in the startup process, by code that reads ahead of replay.
+ */
+TimeLineID
+GetXLogReadAheadTLI(XLogRecPtr recptr)
+{
+	Assert(AmStartupProcess() || !IsPostmasterEnvironment);
+
+	if (expectedTLEs == NIL)
+		return ThisTimeLineID;
+	return tliOfPointInHistory(recptr, expectedTLEs);
+}
+
 /*
  * Get latest WAL insert pointer
  */
@@ -11182,6 +11548,67 @@ GetXLogWriteRecPtr(void)
 	return LogwrtResult.Write;
 }
 
+/*
+ * Read WAL from the WAL buffers, for walsenders.
+ *
+ * Copies 'count' bytes starting at 'startptr' into 'buf' and returns true if
+ * they are all still in the WAL buffers.  Otherwise returns false, and the
+ * caller must read the WAL from disk instead.  The WAL must belong to
+ * timeline 'tli', and must already have been written out, so that no
+ * insertion can still be modifying it.
+ *
+ * We don't take WALBufMappingLock, so a buffer can be recycled for a newer
+ * page while we copy it.  AdvanceXLInsertBuffer() invalidates xlblocks[]
+ * before it overwrites a buffer, so checking xlblocks[] again after the copy
+ * tells us whether we got the right page.  That relies on 64-bit reads being
+ * atomic; on platforms where they aren't, we always return false.
+ */
+bool
+XLogReadFromBuffers(char *buf, XLogRecPtr startptr, Size count,
+					TimeLineID tli)
+{
+#ifdef PG_HAVE_8BYTE_SINGLE_COPY_ATOMICITY
+	char	   *p = buf;
+	XLogRecPtr	recptr = startptr;
+	Size		nbytes = count;
+
+	/* During recovery, the WAL buffers don't hold the WAL being replayed */
+	if (RecoveryInProgress() || tli != XLogCtl->ThisTimeLineID)
+		return false;
+
+	while (nbytes > 0)
+	{
+		int			idx = XLogRecPtrToBufIdx(recptr);
+		uint32		pageoff = recptr % XLOG_BLCKSZ;
+		XLogRecPtr	expectedEndPtr = recptr - pageoff + XLOG_BLCKSZ;
+		Size		npagebytes = Min(nbytes, XLOG_BLCKSZ - pageoff);
+		XLogRecPtr	endptr;
+
+		endptr = *((volatile XLogRecPtr *) &XLogCtl->xlblocks[idx]);
+		if (endptr != expectedEndPtr)
+			return false;
+
+		pg_read_barrier();
+		memcpy(p, XLogCtl->pages + idx * (Size) XLOG_BLCKSZ + pageoff,
+			   npagebytes);
+		pg_read_barrier();
+
+		/* Check that the buffer wasn't recycled while we copied it */
+		endptr = *((volatile XLogRecPtr *) &XLogCtl->xlblocks[idx]);
+		if (endptr != expectedEndPtr)
+			return false;
+
+		p += npagebytes;
+		recptr += npagebytes;
+		nbytes -= npagebytes;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
 /*
  * Returns the redo pointer of the last checkpoint or restartpoint. This is
  * the oldest point in WAL that we still need, if we have to restart recovery.
@@ -12080,6 +12507,9 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 						streaming_reply_sent = true;
 					}
 
+					/* Do any background tasks that might benefit us later. */
+					KnownAssignedTransactionIdsIdleMaintenance();
+
 					/*
 					 * Wait for more WAL to arrive. Time out after 5 seconds
 					 * to react to a trigger file promptly and to check if the
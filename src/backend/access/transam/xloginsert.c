@@ -87,6 +87,16 @@ static uint8 curinsert_flags = 0;
 static XLogRecData hdr_rdt;
 static char *hdr_scratch = NULL;
 
+/*
+ * Buffers used to compress a whole record when wal_record_compression is
+ * enabled: the payload is first gathered into 'record_scratch', and then
+ * compressed into the data of 'compressed_rdt'.  Like the other working
+ * areas, they're allocated at initialization, because we can't allocate
+ * memory within the critical section where records are assembled.
+ */
+static char *record_scratch = NULL;
+static XLogRecData compressed_rdt;
+
 #define SizeOfXlogOrigin	(sizeof(RepOriginId) + sizeof(char))
 
 #define HEADER_SCRATCH_SIZE \
@@ -108,9 +118,10 @@ static MemoryContext xloginsert_cxt;
 
 static XLogRecData *XLogRecordAssemble(RmgrId rmid, uint8 info,
 									   XLogRecPtr RedoRecPtr, bool doPageWrites,
-									   XLogRecPtr *fpw_lsn);
+									   XLogRecPtr *fpw_lsn, int *num_fpi);
 static bool XLogCompressBackupBlock(char *page, uint16 hole_offset,
 									uint16 hole_length, char *dest, uint16 *dlen);
+static bool XLogCompressRecord(RmgrId rmid, uint32 *total_len);
 
 /*
  * Begin constructing a WAL record. This must be called before the
@@ -448,6 +459,7 @@ XLogInsert(RmgrId rmid, uint8 info)
 		bool		doPageWrites;
 		XLogRecPtr	fpw_lsn;
 		XLogRecData *rdt;
+		int			num_fpi = 0;
 
 		/*
 		 * Get values needed to decide whether to do full-page writes. Since
@@ -457,9 +469,9 @@ XLogInsert(RmgrId rmid, uint8 info)
 		GetFullPageWriteInfo(&RedoRecPtr, &doPageWrites);
 
 		rdt = XLogRecordAssemble(rmid, info, RedoRecPtr, doPageWrites,
-								 &fpw_lsn);
+								 &fpw_lsn, &num_fpi);
 
-		EndPos = XLogInsertRecord(rdt, fpw_lsn, curinsert_flags);
+		EndPos = XLogInsertRecord(rdt, fpw_lsn, curinsert_flags, num_fpi);
 	} while (EndPos == InvalidXLogRecPtr);
 
 	XLogResetInsertion();
@@ -478,11 +490,13 @@ XLogInsert(RmgrId rmid, uint8 info)
  * of all of them, *fpw_lsn is set to the lowest LSN among such pages. This
  * signals that the assembled record is only good for insertion on the
  * assumption that the RedoRecPtr and doPageWrites values were up-to-date.
+ *
+ * *num_fpi is set to the number of full-page images included in the record.
  */
 static XLogRecData *
 XLogRecordAssemble(RmgrId rmid, uint8 info,
 				   XLogRecPtr RedoRecPtr, bool doPageWrites,
-				   XLogRecPtr *fpw_lsn)
+				   XLogRecPtr *fpw_lsn, int *num_fpi)
 {
 	XLogRecData *rdt;
 	uint32		total_len = 0;
@@ -521,6 +535,7 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	 * the headers for the block references in the scratch buffer.
 	 */
 	*fpw_lsn = InvalidXLogRecPtr;
+	*num_fpi = 0;
 	for (block_id = 0; block_id < max_registered_block_id; block_id++)
 	{
 		registered_buffer *regbuf = &registered_buffers[block_id];
@@ -586,6 +601,9 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 			Page		page = regbuf->page;
 			uint16		compressed_len = 0;
 
+			/* Report a full-page image for the instrumentation */
+			*num_fpi += 1;
+
 			/*
 			 * The page needs to be backed up, so calculate its hole length
 			 * and offset.
@@ -766,6 +784,9 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	hdr_rdt.len = (scratch - hdr_scratch);
 	total_len += hdr_rdt.len;
 
+	if (wal_record_compression && XLogCompressRecord(rmid, &total_len))
+		info |= XLR_COMPRESSED;
+
 	/*
 	 * Calculate CRC of the data
 	 *
@@ -794,6 +815,63 @@ XLogRecordAssemble(RmgrId rmid, uint8 info,
 	return &hdr_rdt;
 }
 
+/*
+ * Try to compress the payload of the record assembled in hdr_rdt and the
+ * chain following it.
+ *
+ * Returns true after replacing the payload with its compressed form, in
+ * which case *total_len is updated to the new length of the record.
+ * Returns false if the record is left alone, because it's too small or too
+ * large to be worth compressing, or because it doesn't compress well.
+ */
+static bool
+XLogCompressRecord(RmgrId rmid, uint32 *total_len)
+{
+	uint32		payload_len = *total_len - SizeOfXLogRecord;
+	uint32		rawlen;
+	char	   *ptr;
+	XLogRecData *rdt;
+	int32		len;
+
+	/*
+	 * The checkpoint and other records of the XLOG resource manager are read
+	 * directly by xlog.c with assumptions about their exact size, so leave
+	 * them alone.
+	 */
+	if (rmid == RM_XLOG_ID)
+		return false;
+
+	if (payload_len < XLR_COMPRESS_MIN_LEN || payload_len > XLR_COMPRESS_MAX_LEN)
+		return false;
+
+	/* gather the payload: the record's headers, then the data chain */
+	ptr = record_scratch;
+	memcpy(ptr, hdr_scratch + SizeOfXLogRecord, hdr_rdt.len - SizeOfXLogRecord);
+	ptr += hdr_rdt.len - SizeOfXLogRecord;
+	for (rdt = hdr_rdt.next; rdt != NULL; rdt = rdt->next)
+	{
+		memcpy(ptr, rdt->data, rdt->len);
+		ptr += rdt->len;
+	}
+	Assert(ptr - record_scratch == payload_len);
+
+	len = pglz_compress(record_scratch, payload_len, compressed_rdt.data,
+						PGLZ_strategy_default);
+	if (len < 0 || len + sizeof(uint32) >= payload_len)
+		return false;
+
+	/* the record header is now followed by the raw length, and the data */
+	rawlen = payload_len;
+	memcpy(hdr_scratch + SizeOfXLogRecord, &rawlen, sizeof(uint32));
+	hdr_rdt.len = SizeOfXLogRecord + sizeof(uint32);
+	hdr_rdt.next = &compressed_rdt;
+	compressed_rdt.len = len;
+	compressed_rdt.next = NULL;
+
+	*total_len = SizeOfXLogRecord + sizeof(uint32) + len;
+	return true;
+}
+
 /*
  * Create a compressed version of a backup block image.
  *
@@ -995,6 +1073,63 @@ log_newpage(RelFileNode *rnode, ForkNumber forkNum, BlockNumber blkno,
 	return recptr;
 }
 
+/*
+ * Like log_newpage(), but allows logging multiple pages in one operation.
+ * It is more efficient than calling log_newpage() for each page separately,
+ * because we can write multiple pages in a single WAL record.
+ */
+void
+log_newpages(RelFileNode *rnode, ForkNumber forkNum, int num_pages,
+			 BlockNumber *blknos, Page *pages, bool page_std)
+{
+	int			flags;
+	XLogRecPtr	recptr;
+	int			i;
+	int			j;
+
+	flags = REGBUF_FORCE_IMAGE;
+	if (page_std)
+		flags |= REGBUF_STANDARD;
+
+	/*
+	 * Iterate over all the pages. They are collected into batches of
+	 * XLR_MAX_BLOCK_ID pages, and a single WAL-record is written for each
+	 * batch.
+	 */
+	XLogEnsureRecordSpace(XLR_MAX_BLOCK_ID - 1, 0);
+
+	i = 0;
+	while (i < num_pages)
+	{
+		int			batch_start = i;
+		int			nbatch;
+
+		XLogBeginInsert();
+
+		nbatch = 0;
+		while (nbatch < XLR_MAX_BLOCK_ID && i < num_pages)
+		{
+			XLogRegisterBlock(nbatch, rnode, forkNum, blknos[i], pages[i], flags);
+			i++;
+			nbatch++;
+		}
+
+		recptr = XLogInsert(RM_XLOG_ID, XLOG_FPI);
+
+		for (j = batch_start; j < i; j++)
+		{
+			/*
+			 * The page may be uninitialized. If so, we can't set the LSN
+			 * because that would corrupt the page.
+			 */
+			if (!PageIsNew(pages[j]))
+			{
+				PageSetLSN(pages[j], recptr);
+			}
+		}
+	}
+}
+
 /*
  * Write a WAL record containing a full image of a page.
  *
@@ -1137,4 +1272,15 @@ InitXLogInsert(void)
 	if (hdr_scratch == NULL)
 		hdr_scratch = MemoryContextAllocZero(xloginsert_cxt,
 											 HEADER_SCRATCH_SIZE);
+
+	/*
+	 * Allocate the buffers used to compress whole records.
+	 */
+	if (record_scratch == NULL)
+	{
+		record_scratch = MemoryContextAlloc(xloginsert_cxt,
+											XLR_COMPRESS_MAX_LEN);
+		compressed_rdt.data = MemoryContextAlloc(xloginsert_cxt,
+												 PGLZ_MAX_OUTPUT(XLR_COMPRESS_MAX_LEN));
+	}
 }
@@ -0,0 +1,524 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetcher.c
+ *	  Prefetching of data blocks referenced by WAL, during recovery.
+ *
+ * Recovery replays records one at a time, and each time a record references
+ * a block that isn't in shared buffers, it has to wait for a synchronous
+ * read.  To avoid that, the startup process can read ahead in the WAL using
+ * a second XLogReader, decode the upcoming records, and issue prefetch
+ * requests (posix_fadvise(), through PrefetchSharedBuffer()) for the blocks
+ * they reference, so that the kernel may already have brought them into its
+ * cache by the time they are needed.  This is controlled by
+ * recovery_prefetch_distance, the maximum number of bytes of WAL to look
+ * ahead of the replay position.  The number of prefetches in flight is
+ * limited by effective_io_concurrency; we consider a prefetch complete once
+ * the record that needed it has been replayed.
+ *
+ * Blocks are not prefetched if they are already in shared buffers, if they
+ * are beyond the current end of their relation or will be initialized from
+ * scratch by the record, or if the record contains a full page image of
+ * them, since in all these cases replay won't read them.  Repeated
+ * references to the same block are also skipped.
+ *
+ * Read-ahead is purely advisory, so it never waits for WAL to arrive and
+ * never reports errors: it simply reads whatever can be found in pg_wal.
+ * If it runs into something it cannot read, such as the end of the WAL
+ * received so far or a segment that has only been restored from the archive
+ * under a temporary name, it gives up until replay has caught up with that
+ * point, and then starts over from the replay position.
+ *
+ * Counters describing what the prefetcher did are kept in shared memory
+ * and shown in the pg_stat_prefetch_recovery view.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/transam/xlogprefetcher.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "access/htup_details.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogprefetcher.h"
+#include "access/xlogreader.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/bufmgr.h"
+#include "storage/fd.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "utils/builtins.h"
+#include "utils/timestamp.h"
+
+/* GUC variables */
+int			recovery_prefetch_distance = 0;
+bool		recovery_prefetch_fpw = false;
+
+/*
+ * Statistics, shown in pg_stat_prefetch_recovery.  Only the startup process
+ * writes these; a reset is requested by bumping reset_request.
+ */
+typedef struct XLogPrefetchStats
+{
+	pg_atomic_uint64 reset_time;	/* TimestampTz of last reset */
+	pg_atomic_uint32 reset_request; /* bumped to request a reset */
+
+	pg_atomic_uint64 prefetch;	/* prefetches initiated */
+	pg_atomic_uint64 skip_hit;	/* blocks already in shared buffers */
+	pg_atomic_uint64 skip_new;	/* new or to-be-initialized blocks */
+	pg_atomic_uint64 skip_fpw;	/* blocks with full page images */
+	pg_atomic_uint64 skip_seq;	/* repeated references to a block */
+
+	pg_atomic_uint32 distance;	/* bytes of WAL currently looked ahead */
+	pg_atomic_uint32 queue_depth;	/* prefetches currently in flight */
+} XLogPrefetchStats;
+
+static XLogPrefetchStats *Stats;
+
+/*
+ * Process-local state of the startup process's prefetcher.
+ */
+struct XLogPrefetcher
+{
+	/* Reader looking ahead of the replay position */
+	XLogReaderState *reader;
+	bool		reader_valid;	/* has it read a record that we can go on
+								 * from? */
+	int			next_block_id;	/* next block reference of the current
+								 * record to consider */
+
+	/* After a read failure, don't try again until replay has reached this */
+	XLogRecPtr	retry_lsn;
+
+	/* WAL segment file currently open for reading ahead */
+	int			readFile;
+	XLogSegNo	readSegNo;
+	TimeLineID	readTLI;
+
+	/* The last block we considered, to skip repeated references */
+	RelFileNode last_rnode;
+	ForkNumber	last_forknum;
+	BlockNumber last_blkno;
+
+	/*
+	 * Ring buffer holding, for each prefetch in flight, the LSN of the record
+	 * that will consume it.  Entries are in LSN order.
+	 */
+	XLogRecPtr *queue;
+	int			queue_size;		/* allocated entries */
+	int			queue_head;		/* oldest entry */
+	int			queue_depth;	/* number of entries in use */
+
+	/* reset_request value we last acted on */
+	uint32		reset_request;
+};
+
+static int	XLogPrefetcherPageRead(XLogReaderState *reader,
+								   XLogRecPtr targetPagePtr, int reqLen,
+								   XLogRecPtr targetRecPtr, char *readBuf,
+								   TimeLineID *pageTLI);
+static bool XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher);
+static void XLogPrefetcherEnqueue(XLogPrefetcher *prefetcher, XLogRecPtr lsn);
+static void XLogPrefetcherResetStats(void);
+
+static inline void
+XLogPrefetchIncrement(pg_atomic_uint64 *counter)
+{
+	/* only the startup process writes these, so no need for fetch-add */
+	pg_atomic_write_u64(counter, pg_atomic_read_u64(counter) + 1);
+}
+
+Size
+XLogPrefetchShmemSize(void)
+{
+	return sizeof(XLogPrefetchStats);
+}
+
+void
+XLogPrefetchShmemInit(void)
+{
+	bool		found;
+
+	Stats = (XLogPrefetchStats *)
+		ShmemInitStruct("XLogPrefetchStats", sizeof(XLogPrefetchStats),
+						&found);
+	if (!found)
+	{
+		pg_atomic_init_u64(&Stats->reset_time, GetCurrentTimestamp());
+		pg_atomic_init_u32(&Stats->reset_request, 0);
+		pg_atomic_init_u64(&Stats->prefetch, 0);
+		pg_atomic_init_u64(&Stats->skip_hit, 0);
+		pg_atomic_init_u64(&Stats->skip_new, 0);
+		pg_atomic_init_u64(&Stats->skip_fpw, 0);
+		pg_atomic_init_u64(&Stats->skip_seq, 0);
+		pg_atomic_init_u32(&Stats->distance, 0);
+		pg_atomic_init_u32(&Stats->queue_depth, 0);
+	}
+}
+
+/*
+ * Ask the startup process to reset the counters.  Outside recovery, nothing
+ * is writing them, so we can just do it ourselves.
+ */
+void
+XLogPrefetchRequestResetStats(void)
+{
+	pg_atomic_fetch_add_u32(&Stats->reset_request, 1);
+	if (!RecoveryInProgress())
+		XLogPrefetcherResetStats();
+}
+
+static void
+XLogPrefetcherResetStats(void)
+{
+	pg_atomic_write_u64(&Stats->prefetch, 0);
+	pg_atomic_write_u64(&Stats->skip_hit, 0);
+	pg_atomic_write_u64(&Stats->skip_new, 0);
+	pg_atomic_write_u64(&Stats->skip_fpw, 0);
+	pg_atomic_write_u64(&Stats->skip_seq, 0);
+	pg_atomic_write_u64(&Stats->reset_time, GetCurrentTimestamp());
+}
+
+/*
+ * Create a prefetcher, to be used by the startup process during redo.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(void)
+{
+	XLogPrefetcher *prefetcher;
+
+	prefetcher = palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(wal_segment_size,
+											&XLogPrefetcherPageRead,
+											prefetcher);
+	if (!prefetcher->reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+	prefetcher->readFile = -1;
+	prefetcher->reset_request = pg_atomic_read_u32(&Stats->reset_request);
+
+	prefetcher->queue_size = 16;
+	prefetcher->queue = palloc(sizeof(XLogRecPtr) * prefetcher->queue_size);
+
+	return prefetcher;
+}
+
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	if (prefetcher->readFile >= 0)
+		close(prefetcher->readFile);
+	XLogReaderFree(prefetcher->reader);
+	pfree(prefetcher->queue);
+	pfree(prefetcher);
+
+	pg_atomic_write_u32(&Stats->distance, 0);
+	pg_atomic_write_u32(&Stats->queue_depth, 0);
+}
+
+/*
+ * Called by the startup process before it replays the record at
+ * replaying_lsn, to issue prefetches for records up to
+ * recovery_prefetch_distance bytes further on.
+ */
+void
+XLogPrefetcherReadAhead(XLogPrefetcher *prefetcher, XLogRecPtr replaying_lsn)
+{
+	XLogReaderState *reader = prefetcher->reader;
+	uint32		reset_request;
+
+	/* Handle any pending request to reset the counters */
+	reset_request = pg_atomic_read_u32(&Stats->reset_request);
+	if (reset_request != prefetcher->reset_request)
+	{
+		prefetcher->reset_request = reset_request;
+		XLogPrefetcherResetStats();
+	}
+
+	/* Forget about prefetches whose records are being replayed by now */
+	while (prefetcher->queue_depth > 0 &&
+		   prefetcher->queue[prefetcher->queue_head] <= replaying_lsn)
+	{
+		prefetcher->queue_head = (prefetcher->queue_head + 1) %
+			prefetcher->queue_size;
+		prefetcher->queue_depth--;
+	}
+
+	/* Has replay overtaken us? */
+	if (prefetcher->reader_valid && reader->EndRecPtr <= replaying_lsn)
+		prefetcher->reader_valid = false;
+
+	/* Is prefetching enabled? */
+	if (recovery_prefetch_distance <= 0 || target_prefetch_pages <= 0)
+	{
+		prefetcher->reader_valid = false;
+		pg_atomic_write_u32(&Stats->distance, 0);
+		pg_atomic_write_u32(&Stats->queue_depth, prefetcher->queue_depth);
+		return;
+	}
+
+	/*
+	 * If we aren't positioned in the WAL, start reading at the replay
+	 * position, unless that has already failed not long ago.  We skip the
+	 * record being replayed, as it's too late to prefetch for it.
+	 */
+	if (!prefetcher->reader_valid && replaying_lsn >= prefetcher->retry_lsn)
+	{
+		char	   *errormsg;
+
+		if (XLogReadRecord(reader, replaying_lsn, &errormsg) != NULL)
+		{
+			prefetcher->reader_valid = true;
+			prefetcher->next_block_id = reader->max_block_id + 1;
+		}
+		else
+			prefetcher->retry_lsn = replaying_lsn + XLOG_BLCKSZ;
+	}
+
+	while (prefetcher->reader_valid)
+	{
+		char	   *errormsg;
+
+		/* Finish off the record we have, unless we had to stop there */
+		if (!XLogPrefetcherScanBlocks(prefetcher))
+			break;
+
+		/* Don't look further ahead than we were asked to */
+		if (reader->EndRecPtr - replaying_lsn >=
+			(XLogRecPtr) recovery_prefetch_distance)
+			break;
+
+		if (XLogReadRecord(reader, InvalidXLogRecPtr, &errormsg) == NULL)
+		{
+			/*
+			 * Most likely this is just the end of the WAL that is available
+			 * so far.  Try again once replay has got that far.
+			 */
+			prefetcher->reader_valid = false;
+			prefetcher->retry_lsn = reader->EndRecPtr;
+			break;
+		}
+		prefetcher->next_block_id = 0;
+	}
+
+	pg_atomic_write_u32(&Stats->distance,
+						prefetcher->reader_valid ?
+						(uint32) (reader->EndRecPtr - replaying_lsn) : 0);
+	pg_atomic_write_u32(&Stats->queue_depth, prefetcher->queue_depth);
+}
+
+/*
+ * Consider the remaining block references of the record the reader has
+ * decoded.  Returns false if we had to stop because too many prefetches
+ * are in flight, true if all of them have been dealt with.
+ */
+static bool
+XLogPrefetcherScanBlocks(XLogPrefetcher *prefetcher)
+{
+	XLogReaderState *reader = prefetcher->reader;
+
+	for (; prefetcher->next_block_id <= reader->max_block_id;
+		 prefetcher->next_block_id++)
+	{
+		DecodedBkpBlock *block = &reader->blocks[prefetcher->next_block_id];
+		SMgrRelation reln;
+
+		if (!block->in_use)
+			continue;
+
+		/* Will replay read the page at all? */
+		if (block->flags & BKPBLOCK_WILL_INIT)
+		{
+			XLogPrefetchIncrement(&Stats->skip_new);
+			continue;
+		}
+		if (block->apply_image && !recovery_prefetch_fpw)
+		{
+			XLogPrefetchIncrement(&Stats->skip_fpw);
+			continue;
+		}
+
+		/* Same block as last time? */
+		if (RelFileNodeEquals(block->rnode, prefetcher->last_rnode) &&
+			block->forknum == prefetcher->last_forknum &&
+			block->blkno == prefetcher->last_blkno)
+		{
+			XLogPrefetchIncrement(&Stats->skip_seq);
+			continue;
+		}
+
+		/*
+		 * Stop if we already have as many prefetches in flight as
+		 * effective_io_concurrency allows.  We'll come back to this block
+		 * once replay has made progress.
+		 */
+		if (prefetcher->queue_depth >= target_prefetch_pages)
+			return false;
+
+		prefetcher->last_rnode = block->rnode;
+		prefetcher->last_forknum = block->forknum;
+		prefetcher->last_blkno = block->blkno;
+
+		/*
+		 * A block that doesn't exist yet will be created by replay, so
+		 * there's nothing to read.  Asking for it would fail, too.
+		 */
+		reln = smgropen(block->rnode, InvalidBackendId);
+		if (!smgrexists(reln, block->forknum) ||
+			block->blkno >= smgrnblocks(reln, block->forknum))
+		{
+			XLogPrefetchIncrement(&Stats->skip_new);
+			continue;
+		}
+
+		if (PrefetchSharedBuffer(reln, block->forknum, block->blkno))
+			XLogPrefetchIncrement(&Stats->skip_hit);
+		else
+		{
+			XLogPrefetchIncrement(&Stats->prefetch);
+			XLogPrefetcherEnqueue(prefetcher, reader->ReadRecPtr);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Remember that a prefetch is in flight until the record at lsn is replayed.
+ */
+static void
+XLogPrefetcherEnqueue(XLogPrefetcher *prefetcher, XLogRecPtr lsn)
+{
+	if (prefetcher->queue_depth == prefetcher->queue_size)
+	{
+		XLogRecPtr *queue;
+		int			i;
+
+		/* effective_io_concurrency must have been raised; make room */
+		queue = palloc(sizeof(XLogRecPtr) * prefetcher->queue_size * 2);
+		for (i = 0; i < prefetcher->queue_depth; i++)
+			queue[i] = prefetcher->queue[(prefetcher->queue_head + i) %
+										 prefetcher->queue_size];
+		pfree(prefetcher->queue);
+		prefetcher->queue = queue;
+		prefetcher->queue_size *= 2;
+		prefetcher->queue_head = 0;
+	}
+
+	prefetcher->queue[(prefetcher->queue_head + prefetcher->queue_depth) %
+					  prefetcher->queue_size] = lsn;
+	prefetcher->queue_depth++;
+}
+
+/*
+ * read_page callback for the look-ahead reader.
+ *
+ * Reads straight from the segment files in pg_wal, and fails rather than
+ * waiting if the page isn't there.  A page that is still being written may
+ * be read incompletely, but the reader's validation will then fail and we
+ * retry later.
+ */
+static int
+XLogPrefetcherPageRead(XLogReaderState *reader, XLogRecPtr targetPagePtr,
+					   int reqLen, XLogRecPtr targetRecPtr, char *readBuf,
+					   TimeLineID *pageTLI)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) reader->private_data;
+	XLogSegNo	targetSegNo;
+	uint32		targetPageOff;
+	TimeLineID	tli;
+	int			r;
+
+	XLByteToSeg(targetPagePtr, targetSegNo, wal_segment_size);
+	targetPageOff = XLogSegmentOffset(targetPagePtr, wal_segment_size);
+	tli = GetXLogReadAheadTLI(targetPagePtr);
+
+	if (prefetcher->readFile >= 0 &&
+		(prefetcher->readSegNo != targetSegNo || prefetcher->readTLI != tli))
+	{
+		close(prefetcher->readFile);
+		prefetcher->readFile = -1;
+	}
+
+	if (prefetcher->readFile < 0)
+	{
+		char		path[MAXPGPATH];
+
+		XLogFilePath(path, tli, targetSegNo, wal_segment_size);
+		prefetcher->readFile = BasicOpenFile(path, O_RDONLY | PG_BINARY);
+		if (prefetcher->readFile < 0)
+			return -1;
+		prefetcher->readSegNo = targetSegNo;
+		prefetcher->readTLI = tli;
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_WAL_READ);
+	r = pg_pread(prefetcher->readFile, readBuf, XLOG_BLCKSZ,
+				 (off_t) targetPageOff);
+	pgstat_report_wait_end();
+	if (r != XLOG_BLCKSZ)
+		return -1;
+
+	*pageTLI = tli;
+	return XLOG_BLCKSZ;
+}
+
+/*
+ * SQL-callable function backing the pg_stat_prefetch_recovery view.
+ */
+Datum
+pg_stat_get_prefetch_recovery(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_PREFETCH_RECOVERY_COLS 8
+	TupleDesc	tupdesc;
+	Datum		values[PG_STAT_GET_PREFETCH_RECOVERY_COLS];
+	bool		nulls[PG_STAT_GET_PREFETCH_RECOVERY_COLS];
+
+	/* Initialise values and NULL flags arrays */
+	MemSet(values, 0, sizeof(values));
+	MemSet(nulls, 0, sizeof(nulls));
+
+	/* Initialise attributes information in the tuple descriptor */
+	tupdesc = CreateTemplateTupleDesc(PG_STAT_GET_PREFETCH_RECOVERY_COLS);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 1, "stats_reset",
+					   TIMESTAMPTZOID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 2, "prefetch",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 3, "skip_hit",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 4, "skip_new",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 5, "skip_fpw",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 6, "skip_seq",
+					   INT8OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 7, "distance",
+					   INT4OID, -1, 0);
+	TupleDescInitEntry(tupdesc, (AttrNumber) 8, "queue_depth",
+					   INT4OID, -1, 0);
+	BlessTupleDesc(tupdesc);
+
+	values[0] = TimestampTzGetDatum(pg_atomic_read_u64(&Stats->reset_time));
+	values[1] = Int64GetDatum(pg_atomic_read_u64(&Stats->prefetch));
+	values[2] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_hit));
+	values[3] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_new));
+	values[4] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_fpw));
+	values[5] = Int64GetDatum(pg_atomic_read_u64(&Stats->skip_seq));
+	values[6] = Int32GetDatum(pg_atomic_read_u32(&Stats->distance));
+	values[7] = Int32GetDatum(pg_atomic_read_u32(&Stats->queue_depth));
+
+	/* Returns the record as Datum */
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
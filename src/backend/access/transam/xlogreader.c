@@ -137,6 +137,8 @@ XLogReaderFree(XLogReaderState *state)
 	}
 	if (state->main_data)
 		pfree(state->main_data);
+	if (state->decompression_buf)
+		pfree(state->decompression_buf);
 
 	pfree(state->errormsg_buf);
 	if (state->readRecordBuf)
@@ -1067,6 +1069,49 @@ DecodeXLogRecord(XLogReaderState *state, XLogRecord *record, char **errormsg)
 	ptr += SizeOfXLogRecord;
 	remaining = record->xl_tot_len - SizeOfXLogRecord;
 
+	/*
+	 * If the payload of the record was compressed as a whole, decompress it,
+	 * and decode the decompressed copy instead.  Backup images are not
+	 * copied below, so the buffer must stay around until the next record is
+	 * decoded.
+	 */
+	if (record->xl_info & XLR_COMPRESSED)
+	{
+		uint32		rawlen;
+
+		COPY_HEADER_FIELD(&rawlen, sizeof(uint32));
+		if (rawlen == 0 || rawlen > XLR_COMPRESS_MAX_LEN)
+		{
+			report_invalid_record(state,
+								  "invalid uncompressed length %u in compressed record at %X/%X",
+								  rawlen,
+								  (uint32) (state->ReadRecPtr >> 32),
+								  (uint32) state->ReadRecPtr);
+			goto err;
+		}
+
+		if (!state->decompression_buf || rawlen > state->decompression_bufsz)
+		{
+			if (state->decompression_buf)
+				pfree(state->decompression_buf);
+			state->decompression_bufsz = XLR_COMPRESS_MAX_LEN;
+			state->decompression_buf = palloc(state->decompression_bufsz);
+		}
+
+		if (pglz_decompress(ptr, remaining, state->decompression_buf,
+							rawlen, true) != rawlen)
+		{
+			report_invalid_record(state,
+								  "invalid compressed record at %X/%X",
+								  (uint32) (state->ReadRecPtr >> 32),
+								  (uint32) state->ReadRecPtr);
+			goto err;
+		}
+
+		ptr = state->decompression_buf;
+		remaining = rawlen;
+	}
+
 	/* Decode the headers */
 	datatotal = 0;
 	while (remaining > datatotal)
@@ -19,6 +19,7 @@
 
 #include <unistd.h>
 
+#include "access/parallelredo.h"
 #include "access/timeline.h"
 #include "access/xlog.h"
 #include "access/xlog_internal.h"
@@ -104,6 +105,16 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	if (log_min_messages <= DEBUG1 || client_min_messages <= DEBUG1)
 		report_invalid_page(DEBUG1, node, forkno, blkno, present);
 
+	/*
+	 * A parallel redo worker has no use for its own table; the startup
+	 * process keeps track of invalid pages for everyone.
+	 */
+	if (IsParallelRedoWorker())
+	{
+		ParallelRedoRememberInvalidPage(node, forkno, blkno, present);
+		return;
+	}
+
 	if (invalid_page_tab == NULL)
 	{
 		/* create hash table when first needed */
@@ -137,6 +148,17 @@ log_invalid_page(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
 	}
 }
 
+/*
+ * XLogRememberInvalidPage -- take over an invalid page reference found by a
+ * parallel redo worker
+ */
+void
+XLogRememberInvalidPage(RelFileNode node, ForkNumber forkno, BlockNumber blkno,
+						bool present)
+{
+	log_invalid_page(node, forkno, blkno, present);
+}
+
 /* Forget any invalid pages >= minblkno, because they've been dropped */
 static void
 forget_invalid_pages(RelFileNode node, ForkNumber forkno, BlockNumber minblkno)
@@ -440,6 +462,7 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 	BlockNumber lastblock;
 	Buffer		buffer;
 	SMgrRelation smgr;
+	bool		extension_locked = false;
 
 	Assert(blkno != P_NEW);
 
@@ -458,24 +481,38 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 
 	lastblock = smgrnblocks(smgr, forknum);
 
+	/*
+	 * With parallel redo, other processes may be extending the relation
+	 * concurrently.  Look again once we have locked them out.
+	 */
+	if (blkno >= lastblock &&
+		ParallelRedoLockExtension(rnode, forknum))
+	{
+		extension_locked = true;
+		lastblock = smgrnblocks(smgr, forknum);
+	}
+
 	if (blkno < lastblock)
 	{
 		/* page exists in file */
+		if (extension_locked)
+			ParallelRedoUnlockExtension(rnode, forknum);
 		buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
 										   mode, NULL);
 	}
 	else
 	{
 		/* hm, page doesn't exist in file */
-		if (mode == RBM_NORMAL)
+		if (mode == RBM_NORMAL || mode == RBM_NORMAL_NO_LOG)
 		{
-			log_invalid_page(rnode, forknum, blkno, false);
+			if (extension_locked)
+				ParallelRedoUnlockExtension(rnode, forknum);
+			if (mode == RBM_NORMAL)
+				log_invalid_page(rnode, forknum, blkno, false);
 			return InvalidBuffer;
 		}
-		if (mode == RBM_NORMAL_NO_LOG)
-			return InvalidBuffer;
 		/* OK to extend the file */
-		/* we do this in recovery only - no rel-extension lock needed */
+		/* we do this in recovery only - no heavyweight extension lock needed */
 		Assert(InRecovery);
 		buffer = InvalidBuffer;
 		do
@@ -499,6 +536,8 @@ XLogReadBufferExtended(RelFileNode rnode, ForkNumber forknum,
 			buffer = ReadBufferWithoutRelcache(rnode, forknum, blkno,
 											   mode, NULL);
 		}
+		if (extension_locked)
+			ParallelRedoUnlockExtension(rnode, forknum);
 	}
 
 	if (mode == RBM_NORMAL)
@@ -411,6 +411,7 @@ GetNewRelFileNode(Oid reltablespace, Relation pg_class, char relpersistence)
 			break;
 		case RELPERSISTENCE_UNLOGGED:
 		case RELPERSISTENCE_PERMANENT:
+		case RELPERSISTENCE_GLOBAL_TEMP:
 			backend = InvalidBackendId;
 			break;
 		default:
@@ -461,6 +462,27 @@ GetNewRelFileNode(Oid reltablespace, Relation pg_class, char relpersistence)
 		}
 
 		pfree(rpath);
+
+		/*
+		 * Every session has its own files for a global temporary relation,
+		 * named like those of a temporary relation.  A session might still
+		 * have files of a global temporary relation that another session
+		 * dropped, so make sure that no backend has any.
+		 */
+		if (!collides && relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+		{
+			RelFileNodeBackend brnode = rnode;
+
+			for (brnode.backend = 1; brnode.backend <= MaxBackends;
+				 brnode.backend++)
+			{
+				rpath = relpath(brnode, MAIN_FORKNUM);
+				collides = (access(rpath, F_OK) == 0);
+				pfree(rpath);
+				if (collides)
+					break;
+			}
+		}
 	} while (collides);
 
 	return rnode.node.relNode;
@@ -338,6 +338,7 @@ ConstructTupleDescriptor(Relation heapRelation,
 			to->attbyval = from->attbyval;
 			to->attstorage = from->attstorage;
 			to->attalign = from->attalign;
+			to->attcompression = from->attcompression;
 		}
 		else
 		{
@@ -453,6 +454,9 @@ ConstructTupleDescriptor(Relation heapRelation,
 			to->attbyval = typeTup->typbyval;
 			to->attalign = typeTup->typalign;
 			to->attstorage = typeTup->typstorage;
+			/* the key type might not support compression */
+			if (typeTup->typstorage == 'p')
+				to->attcompression = '\0';
 
 			ReleaseSysCache(tuple);
 		}
@@ -1241,6 +1245,24 @@ index_create(Relation heapRelation,
 Oid
 index_concurrently_create_copy(Relation heapRelation, Oid oldIndexId, const char *newName)
 {
+	return index_create_copy(heapRelation,
+							 INDEX_CREATE_SKIP_BUILD | INDEX_CREATE_CONCURRENT,
+							 oldIndexId, newName);
+}
+
+/*
+ * index_create_copy
+ *
+ * Create an index on heapRelation based on the definition of the one
+ * provided by caller, which need not be on the same table as long as the
+ * column numbers match.  flags are passed to index_create; unless they
+ * include INDEX_CREATE_SKIP_BUILD, the index is built right away.
+ */
+Oid
+index_create_copy(Relation heapRelation, bits16 flags, Oid oldIndexId,
+				  const char *newName)
+{
+	bool		concurrent = (flags & INDEX_CREATE_CONCURRENT) != 0;
 	Relation	indexRelation;
 	IndexInfo  *oldInfo,
 			   *newInfo;
@@ -1264,12 +1286,19 @@ index_concurrently_create_copy(Relation heapRelation, Oid oldIndexId, const char
 
 	/*
 	 * Concurrent build of an index with exclusion constraints is not
-	 * supported.
+	 * supported, and the exclusion information is not copied otherwise.
 	 */
 	if (oldInfo->ii_ExclusionOps != NULL)
-		ereport(ERROR,
-				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("concurrent index creation for exclusion constraints is not supported")));
+	{
+		if (concurrent)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("concurrent index creation for exclusion constraints is not supported")));
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("copying indexes with exclusion constraints is not supported")));
+	}
 
 	/* Get the array of class and column options IDs from index info */
 	indexTuple = SearchSysCache1(INDEXRELID, ObjectIdGetDatum(oldIndexId));
@@ -1336,8 +1365,8 @@ index_concurrently_create_copy(Relation heapRelation, Oid oldIndexId, const char
 							indexExprs,
 							indexPreds,
 							oldInfo->ii_Unique,
-							false,	/* not ready for inserts */
-							true);
+							!concurrent,	/* ready for inserts? */
+							concurrent);
 
 	/*
 	 * Extract the list of column names and the column numbers for the new
@@ -1374,7 +1403,7 @@ index_concurrently_create_copy(Relation heapRelation, Oid oldIndexId, const char
 							  indclass->values,
 							  indcoloptions->values,
 							  optionDatum,
-							  INDEX_CREATE_SKIP_BUILD | INDEX_CREATE_CONCURRENT,
+							  flags,
 							  0,
 							  true, /* allow table to be a system catalog? */
 							  false,	/* is_internal? */
@@ -1687,6 +1716,7 @@ index_concurrently_swap(Oid newIndexId, Oid oldIndexId, const char *oldName)
 				newClassRel->pgstat_info->t_counts.t_numscans = tabentry->numscans;
 				newClassRel->pgstat_info->t_counts.t_tuples_returned = tabentry->tuples_returned;
 				newClassRel->pgstat_info->t_counts.t_tuples_fetched = tabentry->tuples_fetched;
+				newClassRel->pgstat_info->t_counts.t_heap_fetches = tabentry->heap_fetches;
 				newClassRel->pgstat_info->t_counts.t_blocks_fetched = tabentry->blocks_fetched;
 				newClassRel->pgstat_info->t_counts.t_blocks_hit = tabentry->blocks_hit;
 
@@ -2458,7 +2488,7 @@ CompareIndexInfo(IndexInfo *info1, IndexInfo *info2,
  *			Add extra state to IndexInfo record
  *
  * For unique indexes, we usually don't want to add info to the IndexInfo for
- * checking uniqueness, since the B-Tree AM handles that directly.  However,
+ * checking uniqueness, since the index AM handles that directly.  However,
  * in the case of speculative insertion, additional support is required.
  *
  * Do this processing here rather than in BuildIndexInfo() to not incur the
@@ -2470,6 +2500,7 @@ BuildSpeculativeIndexInfo(Relation index, IndexInfo *ii)
 {
 	int			indnkeyatts;
 	int			i;
+	uint16		eqstrategy;
 
 	indnkeyatts = IndexRelationGetNumberOfKeyAttributes(index);
 
@@ -2478,8 +2509,12 @@ BuildSpeculativeIndexInfo(Relation index, IndexInfo *ii)
 	 */
 	Assert(ii->ii_Unique);
 
-	if (index->rd_rel->relam != BTREE_AM_OID)
-		elog(ERROR, "unexpected non-btree speculative unique index");
+	if (index->rd_rel->relam == BTREE_AM_OID)
+		eqstrategy = BTEqualStrategyNumber;
+	else if (index->rd_rel->relam == HASH_AM_OID)
+		eqstrategy = HTEqualStrategyNumber;
+	else
+		elog(ERROR, "unexpected non-btree, non-hash speculative unique index");
 
 	ii->ii_UniqueOps = (Oid *) palloc(sizeof(Oid) * indnkeyatts);
 	ii->ii_UniqueProcs = (Oid *) palloc(sizeof(Oid) * indnkeyatts);
@@ -2492,7 +2527,7 @@ BuildSpeculativeIndexInfo(Relation index, IndexInfo *ii)
 	/* We need the func OIDs and strategy numbers too */
 	for (i = 0; i < indnkeyatts; i++)
 	{
-		ii->ii_UniqueStrats[i] = BTEqualStrategyNumber;
+		ii->ii_UniqueStrats[i] = eqstrategy;
 		ii->ii_UniqueOps[i] =
 			get_opfamily_member(index->rd_opfamily[i],
 								index->rd_opcintype[i],
@@ -2773,13 +2808,13 @@ index_build(Relation heapRelation,
 	Assert(PointerIsValid(indexRelation->rd_indam->ambuildempty));
 
 	/*
-	 * Determine worker process details for parallel CREATE INDEX.  Currently,
-	 * only btree has support for parallel builds.
+	 * Determine worker process details for parallel CREATE INDEX, if the
+	 * access method supports parallel builds.
 	 *
 	 * Note that planner considers parallel safety for us.
 	 */
 	if (parallel && IsNormalProcessingMode() &&
-		indexRelation->rd_rel->relam == BTREE_AM_OID)
+		indexRelation->rd_indam->amcanbuildparallel)
 		indexInfo->ii_ParallelWorkers =
 			plan_create_index_workers(RelationGetRelid(heapRelation),
 									  RelationGetRelid(indexRelation));
@@ -2935,6 +2970,50 @@ index_build(Relation heapRelation,
 	SetUserIdAndSecContext(save_userid, save_sec_context);
 }
 
+/*
+ * index_build_global_temp - fill this session's copy of a global temp index
+ *
+ * Each session has its own storage for a global temporary table and its
+ * indexes, so an index has to be built the first time a session touches it,
+ * and again whenever the session truncates the table.  This is index_build()
+ * without the catalog updates: the pg_class statistics and pg_index flags are
+ * shared by all sessions and must not depend on one session's contents.
+ * The index storage must already exist and be empty.
+ */
+void
+index_build_global_temp(Relation indexRelation)
+{
+	Relation	heapRelation;
+	IndexInfo  *indexInfo;
+	IndexBuildResult *stats;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			save_nestlevel;
+
+	Assert(RelationIsGlobalTemp(indexRelation));
+	Assert(PointerIsValid(indexRelation->rd_indam->ambuild));
+
+	heapRelation = table_open(indexRelation->rd_index->indrelid,
+							  AccessShareLock);
+	indexInfo = BuildIndexInfo(indexRelation);
+
+	/* Run index functions as the table owner, as index_build() does */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(heapRelation->rd_rel->relowner,
+						   save_sec_context | SECURITY_RESTRICTED_OPERATION);
+	save_nestlevel = NewGUCNestLevel();
+
+	stats = indexRelation->rd_indam->ambuild(heapRelation, indexRelation,
+											 indexInfo);
+	Assert(PointerIsValid(stats));
+	pfree(stats);
+
+	AtEOXact_GUC(false, save_nestlevel);
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	table_close(heapRelation, NoLock);
+}
+
 /*
  * IndexCheckExclusion - verify that a new exclusion constraint is satisfied
  *
@@ -3453,12 +3532,24 @@ reindex_index(Oid indexId, bool skip_constraint_checks, char persistence,
 		/* Suppress use of the target index while rebuilding it */
 		SetReindexProcessing(heapId, indexId);
 
-		/* Create a new physical relation for the index */
-		RelationSetNewRelfilenode(iRel, persistence);
+		if (RelationIsGlobalTemp(iRel))
+		{
+			/*
+			 * A global temp index only rebuilds this session's copy; the
+			 * relfilenode is shared by all sessions and stays put.
+			 */
+			RelationTruncate(iRel, 0);
+			index_build_global_temp(iRel);
+		}
+		else
+		{
+			/* Create a new physical relation for the index */
+			RelationSetNewRelfilenode(iRel, persistence);
 
-		/* Initialize the index and rebuild */
-		/* Note: we do not need to re-establish pkey setting */
-		index_build(heapRelation, iRel, indexInfo, true, true);
+			/* Initialize the index and rebuild */
+			/* Note: we do not need to re-establish pkey setting */
+			index_build(heapRelation, iRel, indexInfo, true, true);
+		}
 	}
 	PG_CATCH();
 	{
@@ -21,17 +21,26 @@
 
 #include "miscadmin.h"
 
+#include "access/multixact.h"
+#include "access/transam.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xloginsert.h"
 #include "access/xlogutils.h"
+#include "catalog/index.h"
+#include "catalog/pg_class.h"
 #include "catalog/storage.h"
 #include "catalog/storage_xlog.h"
+#include "port/pg_iovec.h"
 #include "storage/freespace.h"
+#include "storage/ipc.h"
+#include "storage/procarray.h"
 #include "storage/smgr.h"
+#include "utils/hsearch.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
 
 /*
  * We keep a list of all relations (represented as RelFileNode values)
@@ -64,6 +73,34 @@ typedef struct PendingRelDelete
 
 static PendingRelDelete *pendingDeletes = NULL; /* head of linked list */
 
+/*
+ * A global temporary relation has a separate set of files for every session
+ * that uses it, named like those of temporary relations.  They're created
+ * when the relation is first opened in the session, and they aren't
+ * WAL-logged or tracked by transactions.  We remember which ones we've
+ * created, so that we can remove them again at backend exit.
+ *
+ * pg_class can't hold the relfrozenxid and relminmxid of each session's copy
+ * of a table, so we keep those here too.  The oldest ones are advertised in
+ * our PGPROC, for vac_update_datfrozenxid() and vac_truncate_clog() to
+ * honor; only a VACUUM in this session can advance them.
+ */
+typedef struct GlobalTempFile
+{
+	RelFileNode rnode;			/* hash key; must be first */
+	TransactionId frozenxid;	/* as relfrozenxid; invalid for indexes */
+	MultiXactId minmulti;		/* as relminmxid; invalid for indexes */
+} GlobalTempFile;
+
+static HTAB *globalTempFiles = NULL;
+
+static void RememberGlobalTempStorage(RelFileNode rnode,
+									  TransactionId frozenxid,
+									  MultiXactId minmulti);
+static void ForgetGlobalTempStorage(RelFileNode rnode);
+static void AdvertiseGlobalTempXids(void);
+static void RemoveGlobalTempStorage(int code, Datum arg);
+
 /*
  * RelationCreateStorage
  *		Create physical storage for a relation.
@@ -89,6 +126,13 @@ RelationCreateStorage(RelFileNode rnode, char relpersistence)
 			backend = BackendIdForTempRelations();
 			needs_wal = false;
 			break;
+		case RELPERSISTENCE_GLOBAL_TEMP:
+			backend = BackendIdForTempRelations();
+			needs_wal = false;
+			/* the table AM fills in the horizons, if it has any */
+			RememberGlobalTempStorage(rnode, InvalidTransactionId,
+									  InvalidMultiXactId);
+			break;
 		case RELPERSISTENCE_UNLOGGED:
 			backend = InvalidBackendId;
 			needs_wal = false;
@@ -121,6 +165,205 @@ RelationCreateStorage(RelFileNode rnode, char relpersistence)
 	return srel;
 }
 
+/*
+ * RelationInitLocalStorage
+ *		Make sure that this session's storage of a global temporary relation
+ *		exists.
+ *
+ * This is called when a global temporary relation is opened and its relcache
+ * entry doesn't know yet.  If the storage is missing, we create it; an index
+ * is then built over this session's contents of its table.  A file we didn't
+ * create ourselves can only have been left behind by an earlier backend with
+ * the same ID that failed to clean up, so its contents are thrown away.
+ */
+void
+RelationInitLocalStorage(Relation rel)
+{
+	bool		found = false;
+
+	Assert(RelationIsGlobalTemp(rel));
+
+	if (globalTempFiles != NULL)
+		(void) hash_search(globalTempFiles, &rel->rd_node, HASH_FIND, &found);
+
+	RelationOpenSmgr(rel);
+	if (!found || !smgrexists(rel->rd_smgr, MAIN_FORKNUM))
+	{
+		ForkNumber	forknum;
+		TransactionId frozenxid = InvalidTransactionId;
+		MultiXactId minmulti = InvalidMultiXactId;
+
+		for (forknum = 0; forknum <= MAX_FORKNUM; forknum++)
+		{
+			if (smgrexists(rel->rd_smgr, forknum))
+				smgrtruncate(rel->rd_smgr, forknum, 0);
+		}
+
+		/* isRedo = true, in case there was a file already */
+		smgrcreate(rel->rd_smgr, MAIN_FORKNUM, true);
+
+		/*
+		 * Remember the file only once an index is complete, so that a build
+		 * that fails is started over at the next open.
+		 */
+		if (rel->rd_rel->relkind == RELKIND_INDEX)
+			index_build_global_temp(rel);
+
+		/* as in heapam_relation_set_new_filenode() */
+		if (rel->rd_rel->relkind == RELKIND_RELATION ||
+			rel->rd_rel->relkind == RELKIND_MATVIEW ||
+			rel->rd_rel->relkind == RELKIND_TOASTVALUE)
+		{
+			frozenxid = RecentXmin;
+			minmulti = GetOldestMultiXactId();
+		}
+		RememberGlobalTempStorage(rel->rd_node, frozenxid, minmulti);
+	}
+
+	rel->rd_localstorage = true;
+}
+
+/*
+ * RelationSetLocalFrozenXids
+ *		Advance the relfrozenxid and relminmxid of this session's storage of a
+ *		global temporary relation.
+ *
+ * Invalid values, and values older than the current ones, are ignored.
+ */
+void
+RelationSetLocalFrozenXids(RelFileNode rnode, TransactionId frozenxid,
+						   MultiXactId minmulti)
+{
+	GlobalTempFile *file = NULL;
+	bool		changed = false;
+
+	if (globalTempFiles != NULL)
+		file = (GlobalTempFile *) hash_search(globalTempFiles, &rnode,
+											  HASH_FIND, NULL);
+	if (file == NULL)
+		return;
+
+	if (TransactionIdIsNormal(frozenxid) &&
+		(!TransactionIdIsValid(file->frozenxid) ||
+		 TransactionIdPrecedes(file->frozenxid, frozenxid)))
+	{
+		file->frozenxid = frozenxid;
+		changed = true;
+	}
+
+	if (MultiXactIdIsValid(minmulti) &&
+		(!MultiXactIdIsValid(file->minmulti) ||
+		 MultiXactIdPrecedes(file->minmulti, minmulti)))
+	{
+		file->minmulti = minmulti;
+		changed = true;
+	}
+
+	if (changed)
+		AdvertiseGlobalTempXids();
+}
+
+/*
+ * ForgetGlobalTempStorage
+ *		Forget about this session's storage of a global temporary relation,
+ *		once it has been dropped.
+ */
+static void
+ForgetGlobalTempStorage(RelFileNode rnode)
+{
+	GlobalTempFile *file;
+
+	if (globalTempFiles == NULL)
+		return;
+
+	file = (GlobalTempFile *) hash_search(globalTempFiles, &rnode,
+										  HASH_REMOVE, NULL);
+	if (file != NULL &&
+		(TransactionIdIsValid(file->frozenxid) ||
+		 MultiXactIdIsValid(file->minmulti)))
+		AdvertiseGlobalTempXids();
+}
+
+/*
+ * RememberGlobalTempStorage
+ *		Remember that this session has created storage for a global temporary
+ *		relation, with the given horizons.
+ */
+static void
+RememberGlobalTempStorage(RelFileNode rnode, TransactionId frozenxid,
+						  MultiXactId minmulti)
+{
+	GlobalTempFile *file;
+
+	if (globalTempFiles == NULL)
+	{
+		HASHCTL		ctl;
+
+		memset(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(RelFileNode);
+		ctl.entrysize = sizeof(GlobalTempFile);
+		globalTempFiles = hash_create("Global temporary relation files",
+									  64, &ctl, HASH_ELEM | HASH_BLOBS);
+		before_shmem_exit(RemoveGlobalTempStorage, 0);
+	}
+
+	file = (GlobalTempFile *) hash_search(globalTempFiles, &rnode,
+										  HASH_ENTER, NULL);
+	file->frozenxid = frozenxid;
+	file->minmulti = minmulti;
+
+	if (TransactionIdIsValid(frozenxid) || MultiXactIdIsValid(minmulti))
+		AdvertiseGlobalTempXids();
+}
+
+/*
+ * AdvertiseGlobalTempXids
+ *		Recompute the oldest horizons over this session's global temporary
+ *		storage, and advertise them in our PGPROC.
+ *
+ * The table is small, so we simply rescan it whenever an entry changes.
+ */
+static void
+AdvertiseGlobalTempXids(void)
+{
+	HASH_SEQ_STATUS status;
+	GlobalTempFile *file;
+	TransactionId oldestXid = InvalidTransactionId;
+	MultiXactId oldestMulti = InvalidMultiXactId;
+
+	hash_seq_init(&status, globalTempFiles);
+	while ((file = (GlobalTempFile *) hash_seq_search(&status)) != NULL)
+	{
+		if (TransactionIdIsValid(file->frozenxid) &&
+			(!TransactionIdIsValid(oldestXid) ||
+			 TransactionIdPrecedes(file->frozenxid, oldestXid)))
+			oldestXid = file->frozenxid;
+		if (MultiXactIdIsValid(file->minmulti) &&
+			(!MultiXactIdIsValid(oldestMulti) ||
+			 MultiXactIdPrecedes(file->minmulti, oldestMulti)))
+			oldestMulti = file->minmulti;
+	}
+
+	ProcArraySetGlobalTempXids(oldestXid, oldestMulti);
+}
+
+/*
+ * RemoveGlobalTempStorage
+ *		before_shmem_exit callback to remove this session's storage of global
+ *		temporary relations.
+ */
+static void
+RemoveGlobalTempStorage(int code, Datum arg)
+{
+	HASH_SEQ_STATUS status;
+	GlobalTempFile *file;
+
+	hash_seq_init(&status, globalTempFiles);
+	while ((file = (GlobalTempFile *) hash_seq_search(&status)) != NULL)
+		smgrdounlinkprivate(smgropen(file->rnode,
+									 BackendIdForTempRelations()));
+}
+
 /*
  * Perform XLogInsert of an XLOG_SMGR_CREATE record to WAL.
  */
@@ -297,6 +540,9 @@ RelationTruncate(Relation rel, BlockNumber nblocks)
 /*
  * Copy a fork's data, block by block.
  *
+ * The source is read in runs of up to PG_IOV_MAX blocks, so that copying a
+ * large relation doesn't cost one read system call per block.
+ *
  * Note that this requires that there is no dirty data in shared buffers. If
  * it's possible that there are, callers need to flush those using
  * e.g. FlushRelationBuffers(rel).
@@ -305,14 +551,21 @@ void
 RelationCopyStorage(SMgrRelation src, SMgrRelation dst,
 					ForkNumber forkNum, char relpersistence)
 {
-	PGAlignedBlock buf;
-	Page		page;
+	char	   *bufspace;
+	PGAlignedBlock *bufs;
+	char	   *bufptrs[PG_IOV_MAX];
 	bool		use_wal;
 	bool		copying_initfork;
 	BlockNumber nblocks;
 	BlockNumber blkno;
+	BlockNumber nread;
+	int			i;
 
-	page = (Page) buf.data;
+	/* align the buffers for direct I/O */
+	bufspace = palloc(sizeof(PGAlignedBlock) * PG_IOV_MAX + PG_IO_ALIGN_SIZE);
+	bufs = (PGAlignedBlock *) TYPEALIGN(PG_IO_ALIGN_SIZE, bufspace);
+	for (i = 0; i < PG_IOV_MAX; i++)
+		bufptrs[i] = bufs[i].data;
 
 	/*
 	 * The init fork for an unlogged relation in many respects has to be
@@ -331,40 +584,50 @@ RelationCopyStorage(SMgrRelation src, SMgrRelation dst,
 
 	nblocks = smgrnblocks(src, forkNum);
 
-	for (blkno = 0; blkno < nblocks; blkno++)
+	for (blkno = 0; blkno < nblocks; blkno += nread)
 	{
+		nread = Min(nblocks - blkno, PG_IOV_MAX);
+
 		/* If we got a cancel signal during the copy of the data, quit */
 		CHECK_FOR_INTERRUPTS();
 
-		smgrread(src, forkNum, blkno, buf.data);
+		smgrreadv(src, forkNum, blkno, bufptrs, nread);
 
-		if (!PageIsVerified(page, blkno))
-			ereport(ERROR,
-					(errcode(ERRCODE_DATA_CORRUPTED),
-					 errmsg("invalid page in block %u of relation %s",
-							blkno,
-							relpathbackend(src->smgr_rnode.node,
-										   src->smgr_rnode.backend,
-										   forkNum))));
-
-		/*
-		 * WAL-log the copied page. Unfortunately we don't know what kind of a
-		 * page this is, so we have to log the full page including any unused
-		 * space.
-		 */
-		if (use_wal)
-			log_newpage(&dst->smgr_rnode.node, forkNum, blkno, page, false);
-
-		PageSetChecksumInplace(page, blkno);
-
-		/*
-		 * Now write the page.  We say isTemp = true even if it's not a temp
-		 * rel, because there's no need for smgr to schedule an fsync for this
-		 * write; we'll do it ourselves below.
-		 */
-		smgrextend(dst, forkNum, blkno, buf.data, true);
+		for (i = 0; i < nread; i++)
+		{
+			Page		page = (Page) bufptrs[i];
+
+			if (!PageIsVerified(page, blkno + i))
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid page in block %u of relation %s",
+								blkno + i,
+								relpathbackend(src->smgr_rnode.node,
+											   src->smgr_rnode.backend,
+											   forkNum))));
+
+			/*
+			 * WAL-log the copied page. Unfortunately we don't know what kind
+			 * of a page this is, so we have to log the full page including
+			 * any unused space.
+			 */
+			if (use_wal)
+				log_newpage(&dst->smgr_rnode.node, forkNum, blkno + i, page,
+							false);
+
+			PageSetChecksumInplace(page, blkno + i);
+
+			/*
+			 * Now write the page.  We say isTemp = true even if it's not a
+			 * temp rel, because there's no need for smgr to schedule an
+			 * fsync for this write; we'll do it ourselves below.
+			 */
+			smgrextend(dst, forkNum, blkno + i, bufptrs[i], true);
+		}
 	}
 
+	pfree(bufspace);
+
 	/*
 	 * If the rel is WAL-logged, must fsync before commit.  We use heap_sync
 	 * to ensure that the toast table gets fsync'd too.  (For a temp or
@@ -443,6 +706,10 @@ smgrDoPendingDeletes(bool isCommit)
 				}
 
 				srels[nrels++] = srel;
+
+				/* a dropped global temp rel no longer holds back anything */
+				if (pending->backend != InvalidBackendId)
+					ForgetGlobalTempStorage(pending->relnode);
 			}
 			/* must explicitly free the list entry */
 			pfree(pending);
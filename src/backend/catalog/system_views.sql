@@ -547,6 +547,12 @@ CREATE VIEW pg_config AS
 REVOKE ALL on pg_config FROM PUBLIC;
 REVOKE EXECUTE ON FUNCTION pg_config() FROM PUBLIC;
 
+CREATE VIEW pg_backend_memory_contexts AS
+    SELECT * FROM pg_get_backend_memory_contexts();
+
+REVOKE ALL ON pg_backend_memory_contexts FROM PUBLIC;
+REVOKE EXECUTE ON FUNCTION pg_get_backend_memory_contexts() FROM PUBLIC;
+
 -- Statistics views
 
 CREATE VIEW pg_stat_all_tables AS
@@ -664,7 +670,8 @@ CREATE VIEW pg_stat_all_indexes AS
             I.relname AS indexrelname,
             pg_stat_get_numscans(I.oid) AS idx_scan,
             pg_stat_get_tuples_returned(I.oid) AS idx_tup_read,
-            pg_stat_get_tuples_fetched(I.oid) AS idx_tup_fetch
+            pg_stat_get_tuples_fetched(I.oid) AS idx_tup_fetch,
+            pg_stat_get_heap_fetches(I.oid) AS idx_heap_fetch
     FROM pg_class C JOIN
             pg_index X ON C.oid = X.indrelid JOIN
             pg_class I ON I.oid = X.indexrelid
@@ -750,11 +757,29 @@ CREATE VIEW pg_stat_activity AS
             S.backend_xid,
             s.backend_xmin,
             S.query,
-            S.backend_type
+            S.backend_type,
+            S.numa_node
     FROM pg_stat_get_activity(NULL) AS S
         LEFT JOIN pg_database AS D ON (S.datid = D.oid)
         LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
 
+CREATE VIEW pg_stat_active_session_history AS
+    SELECT
+            S.sample_time,
+            S.pid,
+            S.datid AS datid,
+            D.datname AS datname,
+            S.usesysid,
+            U.rolname AS usename,
+            S.query_id,
+            S.wait_event_type,
+            S.wait_event,
+            S.plan_node_id,
+            S.plan_node
+    FROM pg_stat_get_active_session_history() AS S
+        LEFT JOIN pg_database AS D ON (S.datid = D.oid)
+        LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
+
 CREATE VIEW pg_stat_replication AS
     SELECT
             S.pid,
@@ -776,7 +801,13 @@ CREATE VIEW pg_stat_replication AS
             W.replay_lag,
             W.sync_priority,
             W.sync_state,
-            W.reply_time
+            W.reply_time,
+            W.compression,
+            W.sent_bytes,
+            W.sent_compressed_bytes,
+            W.write_lag_histogram,
+            W.flush_lag_histogram,
+            W.replay_lag_histogram
     FROM pg_stat_get_activity(NULL) AS S
         JOIN pg_stat_get_wal_senders() AS W ON (S.pid = W.pid)
         LEFT JOIN pg_authid AS U ON (S.usesysid = U.oid);
@@ -836,6 +867,26 @@ CREATE VIEW pg_stat_gssapi AS
             S.gss_enc AS encrypted
     FROM pg_stat_get_activity(NULL) AS S;
 
+CREATE VIEW pg_stat_compression AS
+    SELECT
+            S.pid,
+            S.compression IS NOT NULL AS compression,
+            S.compression AS algorithm,
+            S.raw_bytes_sent,
+            S.compressed_bytes_sent,
+            S.raw_bytes_received,
+            S.compressed_bytes_received
+    FROM pg_stat_get_activity(NULL) AS S;
+
+CREATE VIEW pg_stat_backend_wal AS
+    SELECT
+            S.pid,
+            S.backend_type,
+            S.wal_records,
+            S.wal_fpi,
+            S.wal_bytes
+    FROM pg_stat_get_activity(NULL) AS S;
+
 CREATE VIEW pg_replication_slots AS
     SELECT
             L.slot_name,
@@ -875,6 +926,8 @@ CREATE VIEW pg_stat_database AS
             pg_stat_get_db_temp_files(D.oid) AS temp_files,
             pg_stat_get_db_temp_bytes(D.oid) AS temp_bytes,
             pg_stat_get_db_deadlocks(D.oid) AS deadlocks,
+            pg_stat_get_db_fastpath_overflows(D.oid) AS fastpath_overflows,
+            pg_stat_get_db_suboverflowed_snapshots(D.oid) AS suboverflowed_snapshots,
             pg_stat_get_db_checksum_failures(D.oid) AS checksum_failures,
             pg_stat_get_db_checksum_last_failure(D.oid) AS checksum_last_failure,
             pg_stat_get_db_blk_read_time(D.oid) AS blk_read_time,
@@ -932,6 +985,29 @@ CREATE VIEW pg_stat_archiver AS
         s.stats_reset
     FROM pg_stat_get_archiver() s;
 
+CREATE VIEW pg_stat_prefetch_recovery AS
+    SELECT
+        s.stats_reset,
+        s.prefetch,
+        s.skip_hit,
+        s.skip_new,
+        s.skip_fpw,
+        s.skip_seq,
+        s.distance,
+        s.queue_depth
+    FROM pg_stat_get_prefetch_recovery() s;
+
+CREATE VIEW pg_stat_lwlocks AS
+    SELECT
+        s.tranche,
+        s.shared_acquires,
+        s.exclusive_acquires,
+        s.contended_acquires,
+        s.spin_delays,
+        s.wait_time,
+        s.stats_reset
+    FROM pg_stat_get_lwlocks() s;
+
 CREATE VIEW pg_stat_bgwriter AS
     SELECT
         pg_stat_get_bgwriter_timed_checkpoints() AS checkpoints_timed,
@@ -946,6 +1022,19 @@ CREATE VIEW pg_stat_bgwriter AS
         pg_stat_get_buf_alloc() AS buffers_alloc,
         pg_stat_get_bgwriter_stat_reset_time() AS stats_reset;
 
+CREATE VIEW pg_stat_autovacuum_queue AS
+    SELECT
+            Q.relid,
+            N.nspname AS schemaname,
+            C.relname,
+            Q.needs_vacuum,
+            Q.needs_analyze,
+            Q.for_wraparound,
+            Q.priority
+    FROM pg_stat_get_autovacuum_queue() AS Q
+            JOIN pg_class C ON C.oid = Q.relid
+            LEFT JOIN pg_namespace N ON N.oid = C.relnamespace;
+
 CREATE VIEW pg_stat_progress_vacuum AS
     SELECT
         S.pid AS pid, S.datid AS datid, D.datname AS datname,
@@ -1058,7 +1147,7 @@ REVOKE ALL ON pg_replication_origin_status FROM public;
 
 -- All columns of pg_subscription except subconninfo are readable.
 REVOKE ALL ON pg_subscription FROM public;
-GRANT SELECT (subdbid, subname, subowner, subenabled, subslotname, subpublications)
+GRANT SELECT (subdbid, subname, subowner, subenabled, subbinary, subslotname, subpublications)
     ON pg_subscription TO public;
 
 
@@ -1303,6 +1392,7 @@ REVOKE EXECUTE ON FUNCTION pg_switch_wal() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_wal_replay_pause() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_wal_replay_resume() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_rotate_logfile() FROM public;
+REVOKE EXECUTE ON FUNCTION pg_log_backend_memory_contexts(integer) FROM public;
 REVOKE EXECUTE ON FUNCTION pg_reload_conf() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_current_logfile() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_current_logfile(text) FROM public;
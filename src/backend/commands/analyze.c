@@ -18,6 +18,7 @@
 
 #include "access/genam.h"
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/relation.h"
 #include "access/sysattr.h"
 #include "access/table.h"
@@ -33,6 +34,7 @@
 #include "catalog/pg_collation.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_namespace.h"
+#include "catalog/pg_proc.h"
 #include "catalog/pg_statistic_ext.h"
 #include "commands/dbcommands.h"
 #include "commands/tablecmds.h"
@@ -51,10 +53,12 @@
 #include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
+#include "tcop/tcopprot.h"
 #include "utils/acl.h"
 #include "utils/attoptcache.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/dsa.h"
 #include "utils/fmgroids.h"
 #include "utils/guc.h"
 #include "utils/lsyscache.h"
@@ -75,6 +79,67 @@ typedef struct AnlIndexData
 	int			attr_cnt;
 } AnlIndexData;
 
+/*
+ * DSM keys for parallel ANALYZE.  Unlike other parallel execution code, since
+ * we don't need to worry about DSM keys conflicting with plan_node_id we can
+ * use small integers.
+ */
+#define PARALLEL_ANALYZE_KEY_SHARED			1
+#define PARALLEL_ANALYZE_KEY_ROWS			2
+#define PARALLEL_ANALYZE_KEY_DSA			3
+#define PARALLEL_ANALYZE_KEY_QUERY_TEXT		4
+
+/*
+ * Number of sampled values of the parallel-safe columns that justify one
+ * more process computing statistics, when the user doesn't ask for a number
+ * of workers.
+ */
+#define PARALLEL_ANALYZE_VALUES_PER_PROCESS	1000000
+
+/* One column to be analyzed in parallel */
+typedef struct AnlParallelColumn
+{
+	AttrNumber	attnum;			/* column number */
+	dsa_pointer result;			/* AnlColumnStats computed by a worker, or
+								 * InvalidDsaPointer if none did */
+} AnlParallelColumn;
+
+/*
+ * Shared state for parallel ANALYZE.  Each process, including the leader,
+ * takes the next column to analyze from nextcolumn until all are done.
+ */
+typedef struct AnlParallelShared
+{
+	Oid			relid;
+	int			numrows;		/* number of sample rows */
+	double		totalrows;		/* estimated total rows in the table */
+	pg_atomic_uint32 nextcolumn;	/* next column to analyze */
+	int			ncolumns;
+	AnlParallelColumn columns[FLEXIBLE_ARRAY_MEMBER];
+} AnlParallelShared;
+
+#define SizeOfAnlParallelShared(ncolumns) \
+	add_size(offsetof(AnlParallelShared, columns), \
+			 mul_size(sizeof(AnlParallelColumn), ncolumns))
+
+/*
+ * Header of the statistics a worker computed for a column.  It is followed
+ * by the stanumbers arrays, and then the stavalues serialized by
+ * datumSerialize().
+ */
+typedef struct AnlColumnStats
+{
+	bool		stats_valid;
+	float4		stanullfrac;
+	int32		stawidth;
+	float4		stadistinct;
+	int16		stakind[STATISTIC_NUM_SLOTS];
+	Oid			staop[STATISTIC_NUM_SLOTS];
+	Oid			stacoll[STATISTIC_NUM_SLOTS];
+	int			numnumbers[STATISTIC_NUM_SLOTS];
+	int			numvalues[STATISTIC_NUM_SLOTS];
+} AnlColumnStats;
+
 
 /* Default statistics target (GUC parameter) */
 int			default_statistics_target = 100;
@@ -92,8 +157,20 @@ static void compute_index_stats(Relation onerel, double totalrows,
 								AnlIndexData *indexdata, int nindexes,
 								HeapTuple *rows, int numrows,
 								MemoryContext col_context);
+static bool can_compute_stats_in_parallel(VacAttrStats *stats);
+static bool *compute_column_stats_parallel(Relation onerel, bool inh,
+										   int elevel,
+										   VacAttrStats **vacattrstats,
+										   int attr_cnt,
+										   HeapTuple *rows, int numrows,
+										   double totalrows, int nrequested,
+										   MemoryContext col_context);
+static dsa_pointer serialize_column_stats(VacAttrStats *stats,
+										  dsa_area *area);
+static void restore_column_stats(VacAttrStats *stats, char *ptr);
 static VacAttrStats *examine_attribute(Relation onerel, int attnum,
 									   Node *index_expr);
+static BlockNumber acquire_sample_next_block(void *callback_private);
 static int	acquire_sample_rows(Relation onerel, int elevel,
 								HeapTuple *rows, int targrows,
 								double *totalrows, double *totaldeadrows);
@@ -183,6 +260,16 @@ analyze_rel(Oid relid, RangeVar *relation,
 		return;
 	}
 
+	/*
+	 * Likewise ignore global temp tables: statistics are shared by all
+	 * sessions, but the contents are not.
+	 */
+	if (RelationIsGlobalTemp(onerel))
+	{
+		relation_close(onerel, ShareUpdateExclusiveLock);
+		return;
+	}
+
 	/*
 	 * We can ANALYZE any table except pg_statistic. See update_attstats
 	 */
@@ -250,6 +337,7 @@ analyze_rel(Oid relid, RangeVar *relation,
 	 */
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	MyPgXact->vacuumFlags |= PROC_IN_ANALYZE;
+	ProcGlobal->vacuumFlags[MyProc->pgxactoff] = MyPgXact->vacuumFlags;
 	LWLockRelease(ProcArrayLock);
 
 	/*
@@ -281,6 +369,7 @@ analyze_rel(Oid relid, RangeVar *relation,
 	 */
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	MyPgXact->vacuumFlags &= ~PROC_IN_ANALYZE;
+	ProcGlobal->vacuumFlags[MyProc->pgxactoff] = MyPgXact->vacuumFlags;
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -513,10 +602,23 @@ do_analyze_rel(Relation onerel, VacuumParams *params,
 	{
 		MemoryContext col_context,
 					old_context;
+		bool	   *computed = NULL;
 
 		col_context = AllocSetContextCreate(anl_context,
 											"Analyze Column",
 											ALLOCSET_DEFAULT_SIZES);
+
+		/*
+		 * Let parallel workers compute the statistics of the columns they
+		 * can, unless parallelism has been disabled.
+		 */
+		if (params->nworkers >= 0)
+			computed = compute_column_stats_parallel(onerel, inh, elevel,
+													 vacattrstats, attr_cnt,
+													 rows, numrows, totalrows,
+													 params->nworkers,
+													 col_context);
+
 		old_context = MemoryContextSwitchTo(col_context);
 
 		for (i = 0; i < attr_cnt; i++)
@@ -524,12 +626,15 @@ do_analyze_rel(Relation onerel, VacuumParams *params,
 			VacAttrStats *stats = vacattrstats[i];
 			AttributeOpts *aopt;
 
-			stats->rows = rows;
-			stats->tupDesc = onerel->rd_att;
-			stats->compute_stats(stats,
-								 std_fetch_func,
-								 numrows,
-								 totalrows);
+			if (computed == NULL || !computed[i])
+			{
+				stats->rows = rows;
+				stats->tupDesc = onerel->rd_att;
+				stats->compute_stats(stats,
+									 std_fetch_func,
+									 numrows,
+									 totalrows);
+			}
 
 			/*
 			 * If the appropriate flavor of the n_distinct option is
@@ -866,6 +971,450 @@ compute_index_stats(Relation onerel, double totalrows,
 	MemoryContextDelete(ind_context);
 }
 
+/*
+ * can_compute_stats_in_parallel -- can a worker compute stats for a column?
+ *
+ * Workers only compute statistics using the standard routines, whose
+ * operators must be parallel safe.  A type-specific typanalyze function
+ * might do anything, so such columns are left to the leader.
+ */
+static bool
+can_compute_stats_in_parallel(VacAttrStats *stats)
+{
+	StdAnalyzeData *mystats;
+
+	if (OidIsValid(stats->attrtype->typanalyze))
+		return false;
+
+	mystats = (StdAnalyzeData *) stats->extra_data;
+	if (OidIsValid(mystats->eqfunc) &&
+		func_parallel(mystats->eqfunc) != PROPARALLEL_SAFE)
+		return false;
+	if (OidIsValid(mystats->ltopr) &&
+		func_parallel(get_opcode(mystats->ltopr)) != PROPARALLEL_SAFE)
+		return false;
+
+	return true;
+}
+
+/*
+ * compute_column_stats_parallel -- compute column statistics using workers
+ *
+ * The columns that can_compute_stats_in_parallel() accepts are shared out
+ * between the leader and the workers, one column at a time.  The sample rows
+ * are copied into the dynamic shared memory segment, and the workers send
+ * their results back through a DSA area.  nrequested is the number of
+ * workers requested by the user, or 0 to choose based on the amount of work.
+ *
+ * Returns an array telling which of the columns were computed, or NULL if no
+ * workers would be used.  The caller computes the other columns itself,
+ * which also keeps the type-specific routines out of parallel mode.
+ */
+static bool *
+compute_column_stats_parallel(Relation onerel, bool inh, int elevel,
+							  VacAttrStats **vacattrstats, int attr_cnt,
+							  HeapTuple *rows, int numrows, double totalrows,
+							  int nrequested, MemoryContext col_context)
+{
+	ParallelContext *pcxt;
+	AnlParallelShared *shared;
+	char	   *sharedrows;
+	char	   *area_space;
+	dsa_area   *area;
+	int		   *columns;
+	int			ncolumns = 0;
+	int			nworkers;
+	bool	   *computed;
+	Size		est_shared;
+	Size		est_rows;
+	char	   *sharedquery;
+	const char *querytext;
+	int			querylen;
+	Size		offset;
+	int			i;
+
+	/* Workers can't read the local buffers of temporary relations */
+	if (RELATION_IS_LOCAL(onerel))
+		return NULL;
+	if (inh)
+	{
+		ListCell   *lc;
+
+		foreach(lc, find_all_inheritors(RelationGetRelid(onerel), NoLock,
+										NULL))
+		{
+			if (get_rel_persistence(lfirst_oid(lc)) == RELPERSISTENCE_TEMP)
+				return NULL;
+		}
+	}
+
+	columns = (int *) palloc(attr_cnt * sizeof(int));
+	for (i = 0; i < attr_cnt; i++)
+	{
+		if (can_compute_stats_in_parallel(vacattrstats[i]))
+			columns[ncolumns++] = i;
+	}
+
+	/*
+	 * Unless the user asked for a number of workers, use one process per
+	 * PARALLEL_ANALYZE_VALUES_PER_PROCESS sampled values, counting the
+	 * leader, since computing the statistics of a small sample costs less
+	 * than starting a worker.
+	 */
+	if (nrequested > 0)
+		nworkers = Min(nrequested, ncolumns);
+	else
+		nworkers = (int) Min((double) numrows * ncolumns /
+							 PARALLEL_ANALYZE_VALUES_PER_PROCESS - 1,
+							 ncolumns - 1);
+	nworkers = Min(nworkers, max_parallel_maintenance_workers);
+
+	if (nworkers <= 0)
+	{
+		pfree(columns);
+		return NULL;
+	}
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "parallel_analyze_main",
+								 nworkers);
+
+	/* Estimate size for the shared state -- PARALLEL_ANALYZE_KEY_SHARED */
+	est_shared = MAXALIGN(SizeOfAnlParallelShared(ncolumns));
+	shm_toc_estimate_chunk(&pcxt->estimator, est_shared);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/*
+	 * Estimate size for the sample rows -- PARALLEL_ANALYZE_KEY_ROWS.  Each
+	 * row is stored as its length followed by the tuple header and data.
+	 */
+	est_rows = 0;
+	for (i = 0; i < numrows; i++)
+		est_rows += MAXALIGN(sizeof(uint32)) + MAXALIGN(rows[i]->t_len);
+	shm_toc_estimate_chunk(&pcxt->estimator, est_rows);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate space for the DSA area -- PARALLEL_ANALYZE_KEY_DSA */
+	shm_toc_estimate_chunk(&pcxt->estimator, dsa_minimum_size());
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Finally, estimate PARALLEL_ANALYZE_KEY_QUERY_TEXT space */
+	querytext = debug_query_string ? debug_query_string : "";
+	querylen = strlen(querytext);
+	shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	InitializeParallelDSM(pcxt);
+
+	/* If we didn't get a DSM segment after all, do it all in the leader */
+	if (pcxt->seg == NULL)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		pfree(columns);
+		return NULL;
+	}
+
+	/* Prepare shared state */
+	shared = (AnlParallelShared *) shm_toc_allocate(pcxt->toc, est_shared);
+	MemSet(shared, 0, est_shared);
+	shared->relid = RelationGetRelid(onerel);
+	shared->numrows = numrows;
+	shared->totalrows = totalrows;
+	pg_atomic_init_u32(&shared->nextcolumn, 0);
+	shared->ncolumns = ncolumns;
+	for (i = 0; i < ncolumns; i++)
+	{
+		shared->columns[i].attnum = vacattrstats[columns[i]]->tupattnum;
+		shared->columns[i].result = InvalidDsaPointer;
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_SHARED, shared);
+
+	/* Copy the sample rows */
+	sharedrows = shm_toc_allocate(pcxt->toc, est_rows);
+	offset = 0;
+	for (i = 0; i < numrows; i++)
+	{
+		*(uint32 *) (sharedrows + offset) = rows[i]->t_len;
+		offset += MAXALIGN(sizeof(uint32));
+		memcpy(sharedrows + offset, rows[i]->t_data, rows[i]->t_len);
+		offset += MAXALIGN(rows[i]->t_len);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_ROWS, sharedrows);
+
+	/* Create the DSA area for the results */
+	area_space = shm_toc_allocate(pcxt->toc, dsa_minimum_size());
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_DSA, area_space);
+	area = dsa_create_in_place(area_space, dsa_minimum_size(),
+							   LWTRANCHE_PARALLEL_ANALYZE_DSA, pcxt->seg);
+
+	/* Store query string for workers */
+	sharedquery = (char *) shm_toc_allocate(pcxt->toc, querylen + 1);
+	memcpy(sharedquery, querytext, querylen + 1);
+	shm_toc_insert(pcxt->toc, PARALLEL_ANALYZE_KEY_QUERY_TEXT, sharedquery);
+
+	LaunchParallelWorkers(pcxt);
+
+	ereport(elevel,
+			(errmsg(ngettext("launched %d parallel analyze worker for computing statistics (planned: %d)",
+							 "launched %d parallel analyze workers for computing statistics (planned: %d)",
+							 pcxt->nworkers_launched),
+					pcxt->nworkers_launched, nworkers)));
+
+	/* Join the workers, computing the statistics straight into our structs */
+	computed = (bool *) palloc0(attr_cnt * sizeof(bool));
+	for (;;)
+	{
+		VacAttrStats *stats;
+		MemoryContext old_context;
+
+		i = pg_atomic_fetch_add_u32(&shared->nextcolumn, 1);
+		if (i >= ncolumns)
+			break;
+
+		stats = vacattrstats[columns[i]];
+		old_context = MemoryContextSwitchTo(col_context);
+		stats->rows = rows;
+		stats->tupDesc = onerel->rd_att;
+		stats->compute_stats(stats,
+							 std_fetch_func,
+							 numrows,
+							 totalrows);
+		MemoryContextSwitchTo(old_context);
+		MemoryContextResetAndDeleteChildren(col_context);
+
+		computed[columns[i]] = true;
+	}
+
+	WaitForParallelWorkersToFinish(pcxt);
+
+	/* Collect the statistics the workers computed */
+	for (i = 0; i < ncolumns; i++)
+	{
+		AnlParallelColumn *column = &shared->columns[i];
+
+		if (!DsaPointerIsValid(column->result))
+			continue;
+
+		restore_column_stats(vacattrstats[columns[i]],
+							 dsa_get_address(area, column->result));
+		computed[columns[i]] = true;
+	}
+
+	dsa_detach(area);
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+	pfree(columns);
+
+	return computed;
+}
+
+/*
+ * serialize_column_stats -- copy the results of compute_stats into a DSA area
+ */
+static dsa_pointer
+serialize_column_stats(VacAttrStats *stats, dsa_area *area)
+{
+	AnlColumnStats *result;
+	dsa_pointer dp;
+	Size		size;
+	char	   *ptr;
+	int			i,
+				j;
+
+	size = MAXALIGN(sizeof(AnlColumnStats));
+	for (i = 0; i < STATISTIC_NUM_SLOTS; i++)
+	{
+		size += stats->numnumbers[i] * sizeof(float4);
+		for (j = 0; j < stats->numvalues[i]; j++)
+			size += datumEstimateSpace(stats->stavalues[i][j], false,
+									   stats->statypbyval[i],
+									   stats->statyplen[i]);
+	}
+
+	dp = dsa_allocate(area, size);
+	ptr = dsa_get_address(area, dp);
+
+	result = (AnlColumnStats *) ptr;
+	result->stats_valid = stats->stats_valid;
+	result->stanullfrac = stats->stanullfrac;
+	result->stawidth = stats->stawidth;
+	result->stadistinct = stats->stadistinct;
+	memcpy(result->stakind, stats->stakind, sizeof(result->stakind));
+	memcpy(result->staop, stats->staop, sizeof(result->staop));
+	memcpy(result->stacoll, stats->stacoll, sizeof(result->stacoll));
+	memcpy(result->numnumbers, stats->numnumbers, sizeof(result->numnumbers));
+	memcpy(result->numvalues, stats->numvalues, sizeof(result->numvalues));
+	ptr += MAXALIGN(sizeof(AnlColumnStats));
+
+	for (i = 0; i < STATISTIC_NUM_SLOTS; i++)
+	{
+		if (stats->numnumbers[i] > 0)
+		{
+			memcpy(ptr, stats->stanumbers[i],
+				   stats->numnumbers[i] * sizeof(float4));
+			ptr += stats->numnumbers[i] * sizeof(float4);
+		}
+		for (j = 0; j < stats->numvalues[i]; j++)
+			datumSerialize(stats->stavalues[i][j], false,
+						   stats->statypbyval[i], stats->statyplen[i], &ptr);
+	}
+
+	return dp;
+}
+
+/*
+ * restore_column_stats -- fill in a VacAttrStats from serialize_column_stats
+ *
+ * The stanumbers and stavalues arrays are allocated in anl_context, like
+ * compute_stats does.
+ */
+static void
+restore_column_stats(VacAttrStats *stats, char *ptr)
+{
+	AnlColumnStats *result = (AnlColumnStats *) ptr;
+	MemoryContext old_context;
+	int			i,
+				j;
+
+	stats->stats_valid = result->stats_valid;
+	stats->stanullfrac = result->stanullfrac;
+	stats->stawidth = result->stawidth;
+	stats->stadistinct = result->stadistinct;
+	memcpy(stats->stakind, result->stakind, sizeof(stats->stakind));
+	memcpy(stats->staop, result->staop, sizeof(stats->staop));
+	memcpy(stats->stacoll, result->stacoll, sizeof(stats->stacoll));
+	memcpy(stats->numnumbers, result->numnumbers, sizeof(stats->numnumbers));
+	memcpy(stats->numvalues, result->numvalues, sizeof(stats->numvalues));
+	ptr += MAXALIGN(sizeof(AnlColumnStats));
+
+	old_context = MemoryContextSwitchTo(stats->anl_context);
+	for (i = 0; i < STATISTIC_NUM_SLOTS; i++)
+	{
+		if (stats->numnumbers[i] > 0)
+		{
+			stats->stanumbers[i] = (float4 *)
+				palloc(stats->numnumbers[i] * sizeof(float4));
+			memcpy(stats->stanumbers[i], ptr,
+				   stats->numnumbers[i] * sizeof(float4));
+			ptr += stats->numnumbers[i] * sizeof(float4);
+		}
+		if (stats->numvalues[i] > 0)
+		{
+			stats->stavalues[i] = (Datum *)
+				palloc(stats->numvalues[i] * sizeof(Datum));
+			for (j = 0; j < stats->numvalues[i]; j++)
+			{
+				bool		isnull;
+
+				stats->stavalues[i][j] = datumRestore(&ptr, &isnull);
+				Assert(!isnull);
+			}
+		}
+	}
+	MemoryContextSwitchTo(old_context);
+}
+
+/*
+ * Perform work within a launched parallel process.
+ */
+void
+parallel_analyze_main(dsm_segment *seg, shm_toc *toc)
+{
+	AnlParallelShared *shared;
+	char	   *sharedrows;
+	char	   *area_space;
+	dsa_area   *area;
+	char	   *sharedquery;
+	Relation	onerel;
+	HeapTupleData *tuples;
+	HeapTuple  *rows;
+	MemoryContext col_context;
+	Size		offset;
+	int			i;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_QUERY_TEXT, false);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	shared = (AnlParallelShared *) shm_toc_lookup(toc,
+												  PARALLEL_ANALYZE_KEY_SHARED,
+												  false);
+	sharedrows = shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_ROWS, false);
+	area_space = shm_toc_lookup(toc, PARALLEL_ANALYZE_KEY_DSA, false);
+	area = dsa_attach_in_place(area_space, seg);
+
+	/* Open the table using the lock mode the leader holds */
+	onerel = table_open(shared->relid, ShareUpdateExclusiveLock);
+
+	/* Point our tuple headers at the shared copy of the sample rows */
+	tuples = (HeapTupleData *) palloc0(shared->numrows * sizeof(HeapTupleData));
+	rows = (HeapTuple *) palloc(shared->numrows * sizeof(HeapTuple));
+	offset = 0;
+	for (i = 0; i < shared->numrows; i++)
+	{
+		tuples[i].t_len = *(uint32 *) (sharedrows + offset);
+		offset += MAXALIGN(sizeof(uint32));
+		tuples[i].t_tableOid = shared->relid;
+		tuples[i].t_data = (HeapTupleHeader) (sharedrows + offset);
+		offset += MAXALIGN(tuples[i].t_len);
+		rows[i] = &tuples[i];
+	}
+
+	/* Use cost-based delay like the leader does */
+	VacuumCostActive = (VacuumCostDelay > 0);
+	VacuumCostBalance = 0;
+
+	anl_context = AllocSetContextCreate(CurrentMemoryContext,
+										"Analyze",
+										ALLOCSET_DEFAULT_SIZES);
+	col_context = AllocSetContextCreate(CurrentMemoryContext,
+										"Analyze Column",
+										ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		AnlParallelColumn *column;
+		VacAttrStats *stats;
+		MemoryContext old_context;
+
+		i = pg_atomic_fetch_add_u32(&shared->nextcolumn, 1);
+		if (i >= shared->ncolumns)
+			break;
+		column = &shared->columns[i];
+
+		/* The leader has checked that the standard routines will be used */
+		old_context = MemoryContextSwitchTo(anl_context);
+		stats = examine_attribute(onerel, column->attnum, NULL);
+		if (stats == NULL)
+			elog(ERROR, "could not examine column %d of relation %u",
+				 column->attnum, shared->relid);
+
+		MemoryContextSwitchTo(col_context);
+		stats->rows = rows;
+		stats->tupDesc = onerel->rd_att;
+		stats->compute_stats(stats,
+							 std_fetch_func,
+							 shared->numrows,
+							 shared->totalrows);
+		MemoryContextSwitchTo(old_context);
+
+		column->result = serialize_column_stats(stats, area);
+
+		MemoryContextResetAndDeleteChildren(col_context);
+		MemoryContextResetAndDeleteChildren(anl_context);
+	}
+
+	MemoryContextDelete(col_context);
+	MemoryContextDelete(anl_context);
+	anl_context = NULL;
+	dsa_detach(area);
+	table_close(onerel, ShareUpdateExclusiveLock);
+}
+
 /*
  * examine_attribute -- pre-analysis of a single column
  *
@@ -973,6 +1522,19 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
 	return stats;
 }
 
+/*
+ * acquire_sample_next_block -- streaming read callback for ANALYZE
+ */
+static BlockNumber
+acquire_sample_next_block(void *callback_private)
+{
+	BlockSampler bs = (BlockSampler) callback_private;
+
+	if (!BlockSampler_HasMore(bs))
+		return InvalidBlockNumber;
+	return BlockSampler_Next(bs);
+}
+
 /*
  * acquire_sample_rows -- acquire a random sample of rows from the table
  *
@@ -1022,6 +1584,8 @@ acquire_sample_rows(Relation onerel, int elevel,
 	ReservoirStateData rstate;
 	TupleTableSlot *slot;
 	TableScanDesc scan;
+	StreamingRead stream;
+	BlockNumber targblock;
 
 	Assert(targrows > 0);
 
@@ -1038,11 +1602,17 @@ acquire_sample_rows(Relation onerel, int elevel,
 	scan = table_beginscan_analyze(onerel);
 	slot = table_slot_create(onerel, NULL);
 
+	/*
+	 * The sampled blocks are known in advance, so let a streaming read
+	 * prefetch them while we are busy with earlier ones.  The AM still reads
+	 * each block itself.
+	 */
+	stream = BeginStreamingRead(onerel, MAIN_FORKNUM, vac_strategy,
+								acquire_sample_next_block, &bs);
+
 	/* Outer loop over blocks to sample */
-	while (BlockSampler_HasMore(&bs))
+	while (BlockNumberIsValid(targblock = StreamingReadNextBlock(stream)))
 	{
-		BlockNumber targblock = BlockSampler_Next(&bs);
-
 		vacuum_delay_point();
 
 		if (!table_scan_analyze_next_block(scan, targblock, vac_strategy))
@@ -1094,6 +1664,7 @@ acquire_sample_rows(Relation onerel, int elevel,
 		}
 	}
 
+	EndStreamingRead(stream);
 	ExecDropSingleTupleTableSlot(slot);
 	table_endscan(scan);
 
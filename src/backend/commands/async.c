@@ -24,8 +24,9 @@
  *	  All notification messages are placed in the queue and later read out
  *	  by listening backends.
  *
- *	  There is no central knowledge of which backend listens on which channel;
- *	  every backend has its own list of interesting channels.
+ *	  Every backend has its own list of interesting channels.  In shared
+ *	  memory, each listening backend only advertises a small bitmap of the
+ *	  hashes of those channels (see 4. below).
  *
  *	  Although there is only one queue, notifications are treated as being
  *	  database-local; this is done by including the sender's database OID
@@ -73,9 +74,13 @@
  *	  Finally, after we are out of the transaction altogether, we check if
  *	  we need to signal listening backends.  In SignalBackends() we scan the
  *	  list of listening backends and send a PROCSIG_NOTIFY_INTERRUPT signal
- *	  to every listening backend (we don't know which backend is listening on
- *	  which channel so we must signal them all). We can exclude backends that
- *	  are already up to date, though.  We don't bother with a self-signal
+ *	  to those whose channel bitmap has a bit in common with the channels we
+ *	  notified; false positives just cost a useless wakeup.  A backend that
+ *	  is not interested and has read everything up to our notifications is
+ *	  instead moved past them directly, so that it doesn't hold back the
+ *	  queue tail.  Backends that have fallen far behind the head are
+ *	  signaled regardless, for the same reason.  We can exclude backends
+ *	  that are already up to date.  We don't bother with a self-signal
  *	  either, but just process the queue directly.
  *
  * 5. Upon receipt of a PROCSIG_NOTIFY_INTERRUPT signal, the signal handler
@@ -104,7 +109,7 @@
  * frontend during startup.)  The above design guarantees that notifies from
  * other backends will never be missed by ignoring self-notifies.
  *
- * The amount of shared memory used for notify management (NUM_ASYNC_BUFFERS)
+ * The amount of shared memory used for notify management (notify_buffers)
  * can be varied without affecting anything but performance.  The maximum
  * amount of notification data that can be queued at one time is determined
  * by slru.c's wraparound limit; see QUEUE_MAX_PAGE below.
@@ -135,6 +140,7 @@
 #include "storage/sinval.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
+#include "utils/hashutils.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/snapmgr.h"
@@ -210,6 +216,13 @@ typedef struct QueuePosition
 	 (x).page != (y).page ? (x) : \
 	 (x).offset > (y).offset ? (x) : (y))
 
+/*
+ * Channel names are advertised in shared memory as a bitmap with one bit set
+ * per channel, chosen by hashing the channel name.
+ */
+#define NOTIFY_CHANNEL_FILTER_BITS	1024
+#define NOTIFY_CHANNEL_FILTER_WORDS	(NOTIFY_CHANNEL_FILTER_BITS / 32)
+
 /*
  * Struct describing a listening backend's status
  */
@@ -217,7 +230,10 @@ typedef struct QueueBackendStatus
 {
 	int32		pid;			/* either a PID or InvalidPid */
 	Oid			dboid;			/* backend's database OID, or InvalidOid */
+	BackendId	nextListener;	/* id of next listener, or InvalidBackendId */
 	QueuePosition pos;			/* backend has read queue up to here */
+	uint32		channelFilter[NOTIFY_CHANNEL_FILTER_WORDS]; /* listened-on
+															 * channels */
 } QueueBackendStatus;
 
 /*
@@ -231,21 +247,25 @@ typedef struct QueueBackendStatus
  * other backend will inspect it).
  *
  * When holding the lock in EXCLUSIVE mode, backends can inspect the entries
- * of other backends and also change the head and tail pointers.
+ * of other backends and also change the head and tail pointers, the list of
+ * listeners, and the positions of other backends (see SignalBackends).
  *
- * AsyncCtlLock is used as the control lock for the pg_notify SLRU buffers.
+ * The SLRU bank locks of AsyncCtl protect the pg_notify SLRU buffers.
  * In order to avoid deadlocks, whenever we need both locks, we always first
- * get AsyncQueueLock and then AsyncCtlLock.
+ * get AsyncQueueLock and then the bank lock.
  *
  * Each backend uses the backend[] array entry with index equal to its
  * BackendId (which can range from 1 to MaxBackends).  We rely on this to make
- * SendProcSignal fast.
+ * SendProcSignal fast.  The entries of listening backends are linked into a
+ * list starting at firstListener, so that scanning them doesn't require
+ * looking at all MaxBackends entries.
  */
 typedef struct AsyncQueueControl
 {
 	QueuePosition head;			/* head points to the next free location */
 	QueuePosition tail;			/* the global tail is equivalent to the pos of
 								 * the "slowest" backend */
+	BackendId	firstListener;	/* id of first listener, or InvalidBackendId */
 	TimestampTz lastQueueFillWarn;	/* time of last queue-full msg */
 	QueueBackendStatus backend[FLEXIBLE_ARRAY_MEMBER];
 	/* backend[0] is not used; used entries are from [1] to [MaxBackends] */
@@ -255,9 +275,12 @@ static AsyncQueueControl *asyncQueueControl;
 
 #define QUEUE_HEAD					(asyncQueueControl->head)
 #define QUEUE_TAIL					(asyncQueueControl->tail)
+#define QUEUE_FIRST_LISTENER		(asyncQueueControl->firstListener)
 #define QUEUE_BACKEND_PID(i)		(asyncQueueControl->backend[i].pid)
 #define QUEUE_BACKEND_DBOID(i)		(asyncQueueControl->backend[i].dboid)
+#define QUEUE_NEXT_LISTENER(i)		(asyncQueueControl->backend[i].nextListener)
 #define QUEUE_BACKEND_POS(i)		(asyncQueueControl->backend[i].pos)
+#define QUEUE_BACKEND_FILTER(i)		(asyncQueueControl->backend[i].channelFilter)
 
 /*
  * The SLRU buffer area through which we access the notification queue
@@ -287,6 +310,13 @@ static SlruCtlData AsyncCtlData;
  */
 #define QUEUE_MAX_PAGE			(SLRU_PAGES_PER_SEGMENT * 0x10000 - 1)
 
+/*
+ * Listening backends that are more than this many pages behind the queue
+ * head are signaled even if they are not interested in the notifications
+ * being sent, so that they advance and let the queue tail move on.
+ */
+#define QUEUE_CLEANUP_DELAY		4
+
 /*
  * listenChannels identifies the channels we are actually listening to
  * (ie, have committed a LISTEN on).  It is a simple list of channel names,
@@ -365,18 +395,31 @@ static bool amRegisteredListener = false;
 /* has this backend sent notifications in the current transaction? */
 static bool backendHasSentNotifications = false;
 
+/*
+ * Bitmap of the channels notified by the transactions whose notifications
+ * SignalBackends has yet to announce, and the queue range they occupy.  The
+ * range is only usable if those notifications were added contiguously.
+ */
+static uint32 sentChannelFilter[NOTIFY_CHANNEL_FILTER_WORDS];
+static QueuePosition sentRangeStart;
+static QueuePosition sentRangeEnd;
+static bool sentRangeValid = false;
+
 /* GUC parameter */
 bool		Trace_notify = false;
 
 /* local function prototypes */
+static int	asyncQueuePageDiff(int p, int q);
 static bool asyncQueuePagePrecedes(int p, int q);
+static void channelFilterAdd(uint32 *filter, const char *channel);
 static void queue_listen(ListenActionKind action, const char *channel);
 static void Async_UnlistenOnExit(int code, Datum arg);
-static void Exec_ListenPreCommit(void);
+static void Exec_ListenPreCommit(const char *channel);
 static void Exec_ListenCommit(const char *channel);
 static void Exec_UnlistenCommit(const char *channel);
 static void Exec_UnlistenAllCommit(void);
 static bool IsListeningOn(const char *channel);
+static void asyncQueueResetChannelFilter(void);
 static void asyncQueueUnregister(void);
 static bool asyncQueueIsFull(void);
 static bool asyncQueueAdvance(volatile QueuePosition *position, int entryLength);
@@ -396,10 +439,13 @@ static bool AsyncExistsPendingNotify(const char *channel, const char *payload);
 static void ClearPendingActionsAndNotifies(void);
 
 /*
+ * Compute the difference between two queue page numbers (i.e., p - q),
+ * accounting for wraparound.
+ *
  * We will work on the page range of 0..QUEUE_MAX_PAGE.
  */
-static bool
-asyncQueuePagePrecedes(int p, int q)
+static int
+asyncQueuePageDiff(int p, int q)
 {
 	int			diff;
 
@@ -415,7 +461,26 @@ asyncQueuePagePrecedes(int p, int q)
 		diff -= QUEUE_MAX_PAGE + 1;
 	else if (diff < -((QUEUE_MAX_PAGE + 1) / 2))
 		diff += QUEUE_MAX_PAGE + 1;
-	return diff < 0;
+	return diff;
+}
+
+static bool
+asyncQueuePagePrecedes(int p, int q)
+{
+	return asyncQueuePageDiff(p, q) < 0;
+}
+
+/*
+ * Set the bit for a channel name in a channel bitmap.
+ */
+static void
+channelFilterAdd(uint32 *filter, const char *channel)
+{
+	uint32		bit;
+
+	bit = DatumGetUInt32(hash_any((const unsigned char *) channel,
+								  strlen(channel))) % NOTIFY_CHANNEL_FILTER_BITS;
+	filter[bit / 32] |= ((uint32) 1) << (bit % 32);
 }
 
 /*
@@ -430,7 +495,7 @@ AsyncShmemSize(void)
 	size = mul_size(MaxBackends + 1, sizeof(QueueBackendStatus));
 	size = add_size(size, offsetof(AsyncQueueControl, backend));
 
-	size = add_size(size, SimpleLruShmemSize(NUM_ASYNC_BUFFERS, 0));
+	size = add_size(size, SimpleLruShmemSize(notify_buffers, 0));
 
 	return size;
 }
@@ -464,13 +529,17 @@ AsyncShmemInit(void)
 
 		SET_QUEUE_POS(QUEUE_HEAD, 0, 0);
 		SET_QUEUE_POS(QUEUE_TAIL, 0, 0);
+		QUEUE_FIRST_LISTENER = InvalidBackendId;
 		asyncQueueControl->lastQueueFillWarn = 0;
 		/* zero'th entry won't be used, but let's initialize it anyway */
 		for (i = 0; i <= MaxBackends; i++)
 		{
 			QUEUE_BACKEND_PID(i) = InvalidPid;
 			QUEUE_BACKEND_DBOID(i) = InvalidOid;
+			QUEUE_NEXT_LISTENER(i) = InvalidBackendId;
 			SET_QUEUE_POS(QUEUE_BACKEND_POS(i), 0, 0);
+			memset(QUEUE_BACKEND_FILTER(i), 0,
+				   sizeof(QUEUE_BACKEND_FILTER(i)));
 		}
 	}
 
@@ -478,24 +547,27 @@ AsyncShmemInit(void)
 	 * Set up SLRU management of the pg_notify data.
 	 */
 	AsyncCtl->PagePrecedes = asyncQueuePagePrecedes;
-	SimpleLruInit(AsyncCtl, "async", NUM_ASYNC_BUFFERS, 0,
-				  AsyncCtlLock, "pg_notify", LWTRANCHE_ASYNC_BUFFERS);
+	SimpleLruInit(AsyncCtl, "async", notify_buffers, 0,
+				  "pg_notify", LWTRANCHE_ASYNC_BUFFERS, LWTRANCHE_ASYNC_SLRU);
 	/* Override default assumption that writes should be fsync'd */
 	AsyncCtl->do_fsync = false;
 
 	if (!found)
 	{
+		LWLock	   *lock = SimpleLruGetBankLock(AsyncCtl,
+												QUEUE_POS_PAGE(QUEUE_HEAD));
+
 		/*
 		 * During start or reboot, clean out the pg_notify directory.
 		 */
 		(void) SlruScanDirectory(AsyncCtl, SlruScanDirCbDeleteAll, NULL);
 
 		/* Now initialize page zero to empty */
-		LWLockAcquire(AsyncCtlLock, LW_EXCLUSIVE);
+		LWLockAcquire(lock, LW_EXCLUSIVE);
 		slotno = SimpleLruZeroPage(AsyncCtl, QUEUE_POS_PAGE(QUEUE_HEAD));
 		/* This write is just to verify that pg_notify/ is writable */
 		SimpleLruWritePage(AsyncCtl, slotno);
-		LWLockRelease(AsyncCtlLock);
+		LWLockRelease(lock);
 	}
 }
 
@@ -789,7 +861,7 @@ PreCommit_Notify(void)
 		switch (actrec->action)
 		{
 			case LISTEN_LISTEN:
-				Exec_ListenPreCommit();
+				Exec_ListenPreCommit(actrec->channel);
 				break;
 			case LISTEN_UNLISTEN:
 				/* there is no Exec_UnlistenPreCommit() */
@@ -832,9 +904,25 @@ PreCommit_Notify(void)
 		LockSharedObject(DatabaseRelationId, InvalidOid, 0,
 						 AccessExclusiveLock);
 
-		/* Now push the notifications into the queue */
-		backendHasSentNotifications = true;
+		/*
+		 * Remember which channels we are notifying, for SignalBackends.  If
+		 * it hasn't run since an earlier transaction of ours sent
+		 * notifications (which can happen in procedures), add to what that
+		 * transaction sent.
+		 */
+		if (!backendHasSentNotifications)
+		{
+			memset(sentChannelFilter, 0, sizeof(sentChannelFilter));
+			sentRangeValid = false;
+		}
+		foreach(p, pendingNotifies)
+		{
+			Notification *n = (Notification *) lfirst(p);
+
+			channelFilterAdd(sentChannelFilter, n->channel);
+		}
 
+		/* Now push the notifications into the queue */
 		nextNotify = list_head(pendingNotifies);
 		while (nextNotify != NULL)
 		{
@@ -856,7 +944,23 @@ PreCommit_Notify(void)
 				ereport(ERROR,
 						(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
 						 errmsg("too many notifications in the NOTIFY queue")));
+			if (nextNotify == list_head(pendingNotifies))
+			{
+				/*
+				 * Our notifications start here.  They continue a range we
+				 * sent before only if nobody else wrote in between.
+				 */
+				if (!backendHasSentNotifications)
+				{
+					sentRangeStart = QUEUE_HEAD;
+					sentRangeValid = true;
+				}
+				else if (!QUEUE_POS_EQUAL(sentRangeEnd, QUEUE_HEAD))
+					sentRangeValid = false;
+				backendHasSentNotifications = true;
+			}
 			nextNotify = asyncQueueAddEntries(nextNotify);
+			sentRangeEnd = QUEUE_HEAD;
 			LWLockRelease(AsyncQueueLock);
 		}
 	}
@@ -906,6 +1010,8 @@ AtCommit_Notify(void)
 	/* If no longer listening to anything, get out of listener array */
 	if (amRegisteredListener && listenChannels == NIL)
 		asyncQueueUnregister();
+	else if (amRegisteredListener && pendingActions != NIL)
+		asyncQueueResetChannelFilter();
 
 	/* And clean up */
 	ClearPendingActionsAndNotifies();
@@ -914,21 +1020,30 @@ AtCommit_Notify(void)
 /*
  * Exec_ListenPreCommit --- subroutine for PreCommit_Notify
  *
- * This function must make sure we are ready to catch any incoming messages.
+ * This function must make sure we are ready to catch any incoming messages
+ * on the channel.
  */
 static void
-Exec_ListenPreCommit(void)
+Exec_ListenPreCommit(const char *channel)
 {
 	QueuePosition head;
 	QueuePosition max;
-	int			i;
+	BackendId	i;
 
 	/*
-	 * Nothing to do if we are already listening to something, nor if we
-	 * already ran this routine in this transaction.
+	 * If we are already listening to something, or already ran this routine
+	 * in this transaction, we only need to advertise the channel.  Notifiers
+	 * look at the bitmap only after committing, so having it set before we
+	 * commit ensures that we get signaled for anything committed after us.
+	 * We may update our own entry while holding only a shared lock.
 	 */
 	if (amRegisteredListener)
+	{
+		LWLockAcquire(AsyncQueueLock, LW_SHARED);
+		channelFilterAdd(QUEUE_BACKEND_FILTER(MyBackendId), channel);
+		LWLockRelease(AsyncQueueLock);
 		return;
+	}
 
 	if (Trace_notify)
 		elog(DEBUG1, "Exec_ListenPreCommit(%d)", MyProcPid);
@@ -962,14 +1077,15 @@ Exec_ListenPreCommit(void)
 	 * with that if there's more than a page worth of notifications
 	 * outstanding, otherwise scanning all the other backends isn't worth it.
 	 *
-	 * We need exclusive lock here so we can look at other backends' entries.
+	 * We need exclusive lock here so we can look at other backends' entries
+	 * and add ourselves to the list of listeners.
 	 */
 	LWLockAcquire(AsyncQueueLock, LW_EXCLUSIVE);
 	head = QUEUE_HEAD;
 	max = QUEUE_TAIL;
 	if (QUEUE_POS_PAGE(max) != QUEUE_POS_PAGE(head))
 	{
-		for (i = 1; i <= MaxBackends; i++)
+		for (i = QUEUE_FIRST_LISTENER; i > 0; i = QUEUE_NEXT_LISTENER(i))
 		{
 			if (QUEUE_BACKEND_DBOID(i) == MyDatabaseId)
 				max = QUEUE_POS_MAX(max, QUEUE_BACKEND_POS(i));
@@ -978,6 +1094,11 @@ Exec_ListenPreCommit(void)
 	QUEUE_BACKEND_POS(MyBackendId) = max;
 	QUEUE_BACKEND_PID(MyBackendId) = MyProcPid;
 	QUEUE_BACKEND_DBOID(MyBackendId) = MyDatabaseId;
+	memset(QUEUE_BACKEND_FILTER(MyBackendId), 0,
+		   sizeof(QUEUE_BACKEND_FILTER(MyBackendId)));
+	channelFilterAdd(QUEUE_BACKEND_FILTER(MyBackendId), channel);
+	QUEUE_NEXT_LISTENER(MyBackendId) = QUEUE_FIRST_LISTENER;
+	QUEUE_FIRST_LISTENER = MyBackendId;
 	LWLockRelease(AsyncQueueLock);
 
 	/* Now we are listed in the global array, so remember we're listening */
@@ -1179,6 +1300,25 @@ IsListeningOn(const char *channel)
 	return false;
 }
 
+/*
+ * Recompute our advertised channel bitmap from listenChannels, dropping the
+ * bits of channels we have stopped listening on.
+ */
+static void
+asyncQueueResetChannelFilter(void)
+{
+	uint32		filter[NOTIFY_CHANNEL_FILTER_WORDS];
+	ListCell   *p;
+
+	memset(filter, 0, sizeof(filter));
+	foreach(p, listenChannels)
+		channelFilterAdd(filter, (char *) lfirst(p));
+
+	LWLockAcquire(AsyncQueueLock, LW_SHARED);
+	memcpy(QUEUE_BACKEND_FILTER(MyBackendId), filter, sizeof(filter));
+	LWLockRelease(AsyncQueueLock);
+}
+
 /*
  * Remove our entry from the listeners array when we are no longer listening
  * on any channel.  NB: must not fail if we're already not listening.
@@ -1193,13 +1333,31 @@ asyncQueueUnregister(void)
 	if (!amRegisteredListener)	/* nothing to do */
 		return;
 
-	LWLockAcquire(AsyncQueueLock, LW_SHARED);
+	/* Need exclusive lock here to manipulate list links */
+	LWLockAcquire(AsyncQueueLock, LW_EXCLUSIVE);
 	/* check if entry is valid and oldest ... */
 	advanceTail = (MyProcPid == QUEUE_BACKEND_PID(MyBackendId)) &&
 		QUEUE_POS_EQUAL(QUEUE_BACKEND_POS(MyBackendId), QUEUE_TAIL);
 	/* ... then mark it invalid */
 	QUEUE_BACKEND_PID(MyBackendId) = InvalidPid;
 	QUEUE_BACKEND_DBOID(MyBackendId) = InvalidOid;
+	/* and remove it from the list */
+	if (QUEUE_FIRST_LISTENER == MyBackendId)
+		QUEUE_FIRST_LISTENER = QUEUE_NEXT_LISTENER(MyBackendId);
+	else
+	{
+		BackendId	i;
+
+		for (i = QUEUE_FIRST_LISTENER; i > 0; i = QUEUE_NEXT_LISTENER(i))
+		{
+			if (QUEUE_NEXT_LISTENER(i) == MyBackendId)
+			{
+				QUEUE_NEXT_LISTENER(i) = QUEUE_NEXT_LISTENER(MyBackendId);
+				break;
+			}
+		}
+	}
+	QUEUE_NEXT_LISTENER(MyBackendId) = InvalidBackendId;
 	LWLockRelease(AsyncQueueLock);
 
 	/* mark ourselves as no longer listed in the global array */
@@ -1315,8 +1473,8 @@ asyncQueueNotificationToEntry(Notification *n, AsyncQueueEntry *qe)
  * and return the first still-unwritten cell back.  Eventually we will return
  * NULL indicating all is done.
  *
- * We are holding AsyncQueueLock already from the caller and grab AsyncCtlLock
- * locally in this function.
+ * We are holding AsyncQueueLock already from the caller and grab the bank
+ * lock of the head page locally in this function.
  */
 static ListCell *
 asyncQueueAddEntries(ListCell *nextNotify)
@@ -1326,9 +1484,7 @@ asyncQueueAddEntries(ListCell *nextNotify)
 	int			pageno;
 	int			offset;
 	int			slotno;
-
-	/* We hold both AsyncQueueLock and AsyncCtlLock during this operation */
-	LWLockAcquire(AsyncCtlLock, LW_EXCLUSIVE);
+	LWLock	   *prevlock;
 
 	/*
 	 * We work with a local copy of QUEUE_HEAD, which we write back to shared
@@ -1343,8 +1499,15 @@ asyncQueueAddEntries(ListCell *nextNotify)
 	 */
 	queue_head = QUEUE_HEAD;
 
-	/* Fetch the current page */
+	/*
+	 * We hold both AsyncQueueLock and the bank lock of the current page
+	 * during this operation.
+	 */
 	pageno = QUEUE_POS_PAGE(queue_head);
+	prevlock = SimpleLruGetBankLock(AsyncCtl, pageno);
+	LWLockAcquire(prevlock, LW_EXCLUSIVE);
+
+	/* Fetch the current page */
 	slotno = SimpleLruReadPage(AsyncCtl, pageno, true, InvalidTransactionId);
 	/* Note we mark the page dirty before writing in it */
 	AsyncCtl->shared->page_dirty[slotno] = true;
@@ -1391,9 +1554,20 @@ asyncQueueAddEntries(ListCell *nextNotify)
 			 * idea of the head page is always the same as ours, which avoids
 			 * boundary problems in SimpleLruTruncate.  The test in
 			 * asyncQueueIsFull() ensured that there is room to create this
-			 * page without overrunning the queue.
+			 * page without overrunning the queue.  The next page may live in
+			 * another bank, in which case we must switch bank locks.
 			 */
-			slotno = SimpleLruZeroPage(AsyncCtl, QUEUE_POS_PAGE(queue_head));
+			LWLock	   *lock;
+
+			pageno = QUEUE_POS_PAGE(queue_head);
+			lock = SimpleLruGetBankLock(AsyncCtl, pageno);
+			if (lock != prevlock)
+			{
+				LWLockRelease(prevlock);
+				LWLockAcquire(lock, LW_EXCLUSIVE);
+				prevlock = lock;
+			}
+			slotno = SimpleLruZeroPage(AsyncCtl, pageno);
 			/* And exit the loop */
 			break;
 		}
@@ -1402,7 +1576,7 @@ asyncQueueAddEntries(ListCell *nextNotify)
 	/* Success, so update the global QUEUE_HEAD */
 	QUEUE_HEAD = queue_head;
 
-	LWLockRelease(AsyncCtlLock);
+	LWLockRelease(prevlock);
 
 	return nextNotify;
 }
@@ -1474,16 +1648,14 @@ asyncQueueFillWarning(void)
 	{
 		QueuePosition min = QUEUE_HEAD;
 		int32		minPid = InvalidPid;
-		int			i;
+		BackendId	i;
 
-		for (i = 1; i <= MaxBackends; i++)
+		for (i = QUEUE_FIRST_LISTENER; i > 0; i = QUEUE_NEXT_LISTENER(i))
 		{
-			if (QUEUE_BACKEND_PID(i) != InvalidPid)
-			{
-				min = QUEUE_POS_MIN(min, QUEUE_BACKEND_POS(i));
-				if (QUEUE_POS_EQUAL(min, QUEUE_BACKEND_POS(i)))
-					minPid = QUEUE_BACKEND_PID(i);
-			}
+			Assert(QUEUE_BACKEND_PID(i) != InvalidPid);
+			min = QUEUE_POS_MIN(min, QUEUE_BACKEND_POS(i));
+			if (QUEUE_POS_EQUAL(min, QUEUE_BACKEND_POS(i)))
+				minPid = QUEUE_BACKEND_PID(i);
 		}
 
 		ereport(WARNING,
@@ -1516,6 +1688,7 @@ static bool
 SignalBackends(void)
 {
 	bool		signalled = false;
+	bool		advanced = false;
 	int32	   *pids;
 	BackendId  *ids;
 	int			count;
@@ -1523,9 +1696,16 @@ SignalBackends(void)
 	int32		pid;
 
 	/*
-	 * Identify all backends that are listening and not already up-to-date. We
-	 * don't want to send signals while holding the AsyncQueueLock, so we just
-	 * build a list of target PIDs.
+	 * Identify all backends that are listening and not already up-to-date,
+	 * and that either listen on one of the channels we notified or have
+	 * fallen far enough behind to hold back the queue tail.  Others that have
+	 * read everything before our notifications are just moved past them.
+	 * That is only done if our notifications don't cross a page boundary, so
+	 * that a backend concurrently reading from its old position can't have
+	 * the page truncated away under it.
+	 *
+	 * We don't want to send signals while holding the AsyncQueueLock, so we
+	 * just build a list of target PIDs.
 	 *
 	 * XXX in principle these pallocs could fail, which would be bad. Maybe
 	 * preallocate the arrays?	But in practice this is only run in trivial
@@ -1536,23 +1716,54 @@ SignalBackends(void)
 	count = 0;
 
 	LWLockAcquire(AsyncQueueLock, LW_EXCLUSIVE);
-	for (i = 1; i <= MaxBackends; i++)
+	for (i = QUEUE_FIRST_LISTENER; i > 0; i = QUEUE_NEXT_LISTENER(i))
 	{
+		QueuePosition pos = QUEUE_BACKEND_POS(i);
+		bool		interested = false;
+		int			w;
+
 		pid = QUEUE_BACKEND_PID(i);
-		if (pid != InvalidPid && pid != MyProcPid)
+		Assert(pid != InvalidPid);
+		if (pid == MyProcPid || QUEUE_POS_EQUAL(pos, QUEUE_HEAD))
+			continue;
+
+		if (QUEUE_BACKEND_DBOID(i) == MyDatabaseId)
 		{
-			QueuePosition pos = QUEUE_BACKEND_POS(i);
+			for (w = 0; w < NOTIFY_CHANNEL_FILTER_WORDS; w++)
+			{
+				if (QUEUE_BACKEND_FILTER(i)[w] & sentChannelFilter[w])
+				{
+					interested = true;
+					break;
+				}
+			}
+		}
 
-			if (!QUEUE_POS_EQUAL(pos, QUEUE_HEAD))
+		if (!interested)
+		{
+			if (sentRangeValid &&
+				QUEUE_POS_EQUAL(pos, sentRangeStart) &&
+				QUEUE_POS_PAGE(sentRangeStart) == QUEUE_POS_PAGE(sentRangeEnd))
 			{
-				pids[count] = pid;
-				ids[count] = i;
-				count++;
+				QUEUE_BACKEND_POS(i) = sentRangeEnd;
+				advanced = true;
+				continue;
 			}
+			if (asyncQueuePageDiff(QUEUE_POS_PAGE(QUEUE_HEAD),
+								   QUEUE_POS_PAGE(pos)) < QUEUE_CLEANUP_DELAY)
+				continue;
 		}
+
+		pids[count] = pid;
+		ids[count] = i;
+		count++;
 	}
 	LWLockRelease(AsyncQueueLock);
 
+	/* If we moved anyone forward, the tail may be able to advance */
+	if (advanced)
+		asyncQueueAdvanceTail();
+
 	/* Now send signals */
 	for (i = 0; i < count; i++)
 	{
@@ -1594,6 +1805,8 @@ AtAbort_Notify(void)
 	 */
 	if (amRegisteredListener && listenChannels == NIL)
 		asyncQueueUnregister();
+	else if (amRegisteredListener && pendingActions != NIL)
+		asyncQueueResetChannelFilter();
 
 	/* And clean up */
 	ClearPendingActionsAndNotifies();
@@ -1822,7 +2035,7 @@ asyncQueueReadAllNotifications(void)
 
 			/*
 			 * We copy the data from SLRU into a local buffer, so as to avoid
-			 * holding the AsyncCtlLock while we are examining the entries and
+			 * holding the SLRU lock while we are examining the entries and
 			 * possibly transmitting them to our frontend.  Copy only the part
 			 * of the page we will actually inspect.
 			 */
@@ -1844,7 +2057,7 @@ asyncQueueReadAllNotifications(void)
 				   AsyncCtl->shared->page_buffer[slotno] + curoffset,
 				   copysize);
 			/* Release lock that we got from SimpleLruReadPage_ReadOnly() */
-			LWLockRelease(AsyncCtlLock);
+			LWLockRelease(SimpleLruGetBankLock(AsyncCtl, curpage));
 
 			/*
 			 * Process messages up to the stop position, end of page, or an
@@ -1870,7 +2083,8 @@ asyncQueueReadAllNotifications(void)
 	{
 		/* Update shared state */
 		LWLockAcquire(AsyncQueueLock, LW_SHARED);
-		QUEUE_BACKEND_POS(MyBackendId) = pos;
+		QUEUE_BACKEND_POS(MyBackendId) =
+			QUEUE_POS_MAX(QUEUE_BACKEND_POS(MyBackendId), pos);
 		advanceTail = QUEUE_POS_EQUAL(oldpos, QUEUE_TAIL);
 		LWLockRelease(AsyncQueueLock);
 
@@ -1883,8 +2097,13 @@ asyncQueueReadAllNotifications(void)
 	PG_END_TRY();
 
 	/* Update shared state */
+	/*
+	 * A notifier may have moved us past notifications we had no interest in
+	 * while we were reading (see SignalBackends), so never move backwards.
+	 */
 	LWLockAcquire(AsyncQueueLock, LW_SHARED);
-	QUEUE_BACKEND_POS(MyBackendId) = pos;
+	QUEUE_BACKEND_POS(MyBackendId) =
+		QUEUE_POS_MAX(QUEUE_BACKEND_POS(MyBackendId), pos);
 	advanceTail = QUEUE_POS_EQUAL(oldpos, QUEUE_TAIL);
 	LWLockRelease(AsyncQueueLock);
 
@@ -1902,7 +2121,7 @@ asyncQueueReadAllNotifications(void)
  *
  * The current page must have been fetched into page_buffer from shared
  * memory.  (We could access the page right in shared memory, but that
- * would imply holding the AsyncCtlLock throughout this routine.)
+ * would imply holding the SLRU bank lock throughout this routine.)
  *
  * We stop if we reach the "stop" position, or reach a notification from an
  * uncommitted transaction, or reach the end of the page.
@@ -2012,10 +2231,10 @@ asyncQueueAdvanceTail(void)
 
 	LWLockAcquire(AsyncQueueLock, LW_EXCLUSIVE);
 	min = QUEUE_HEAD;
-	for (i = 1; i <= MaxBackends; i++)
+	for (i = QUEUE_FIRST_LISTENER; i > 0; i = QUEUE_NEXT_LISTENER(i))
 	{
-		if (QUEUE_BACKEND_PID(i) != InvalidPid)
-			min = QUEUE_POS_MIN(min, QUEUE_BACKEND_POS(i));
+		Assert(QUEUE_BACKEND_PID(i) != InvalidPid);
+		min = QUEUE_POS_MIN(min, QUEUE_BACKEND_POS(i));
 	}
 	oldtailpage = QUEUE_POS_PAGE(QUEUE_TAIL);
 	QUEUE_TAIL = min;
@@ -2033,8 +2252,8 @@ asyncQueueAdvanceTail(void)
 	if (asyncQueuePagePrecedes(oldtailpage, boundary))
 	{
 		/*
-		 * SimpleLruTruncate() will ask for AsyncCtlLock but will also release
-		 * the lock again.
+		 * SimpleLruTruncate() will ask for the SLRU bank locks but will also
+		 * release them again.
 		 */
 		SimpleLruTruncate(AsyncCtl, newtailpage);
 	}
@@ -35,15 +35,24 @@
 #include "catalog/objectaccess.h"
 #include "catalog/toasting.h"
 #include "commands/cluster.h"
+#include "commands/defrem.h"
 #include "commands/progress.h"
 #include "commands/tablecmds.h"
 #include "commands/vacuum.h"
+#include "executor/executor.h"
 #include "miscadmin.h"
 #include "optimizer/optimizer.h"
 #include "pgstat.h"
+#include "replication/decode.h"
+#include "replication/logical.h"
+#include "replication/logicalfuncs.h"
+#include "replication/message.h"
+#include "replication/slot.h"
+#include "replication/snapbuild.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
+#include "storage/proc.h"
 #include "utils/acl.h"
 #include "utils/fmgroids.h"
 #include "utils/inval.h"
@@ -67,12 +76,85 @@ typedef struct
 	Oid			indexOid;
 } RelToCluster;
 
+/*
+ * CLUSTER CONCURRENTLY applies the changes that were made to the table
+ * while it was being copied in batches of this many.
+ */
+#define CLUSTER_APPLY_BATCH_SIZE	1024
+
+/*
+ * Before taking AccessExclusiveLock for the final round, CLUSTER
+ * CONCURRENTLY keeps catching up with concurrent changes until a round
+ * replays fewer than CLUSTER_CATCHUP_THRESHOLD of them, but for at most
+ * CLUSTER_MAX_CATCHUP_ROUNDS rounds.
+ */
+#define CLUSTER_CATCHUP_THRESHOLD	1024
+#define CLUSTER_MAX_CATCHUP_ROUNDS	8
+
+/* A change to the table being clustered, as decoded from WAL */
+typedef struct ConcurrentChange
+{
+	enum ReorderBufferChangeType action;	/* INSERT, UPDATE or DELETE */
+	HeapTuple	oldtuple;		/* old key, if logged */
+	HeapTuple	newtuple;		/* new row, NULL for DELETE */
+} ConcurrentChange;
+
+/* Private state of the built-in decoding plugin */
+typedef struct ClusterDecodingState
+{
+	Oid			relid;			/* table whose changes we collect */
+	MemoryContext change_cxt;	/* holds the changes */
+	List	   *changes;		/* ConcurrentChanges, in commit order */
+	int			nchanges;		/* length of the above */
+} ClusterDecodingState;
+
+/* State needed to apply concurrent changes to the new heap */
+typedef struct ClusterApplyState
+{
+	Relation	NewHeap;
+	Oid			identIndex;		/* copy of the identity index on NewHeap */
+	EState	   *estate;			/* for index insertions */
+	TupleTableSlot *newslot;	/* new row to store */
+	TupleTableSlot *keyslot;	/* key of the row to look up */
+	TupleTableSlot *foundslot;	/* row found in NewHeap */
+	double		num_tuples;		/* live tuples in NewHeap */
+	double		napplied;		/* changes applied so far */
+} ClusterApplyState;
+
+/*
+ * The local transaction in which CLUSTER CONCURRENTLY is setting up its
+ * decoding context.  The built-in plugin refuses to start anywhere else.
+ */
+static LocalTransactionId cluster_decoding_lxid = InvalidLocalTransactionId;
+
 
 static void rebuild_relation(Relation OldHeap, Oid indexOid, bool verbose);
 static void copy_table_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex,
 							bool verbose, bool *pSwapToastByContent,
 							TransactionId *pFreezeXid, MultiXactId *pCutoffMulti);
 static List *get_tables_to_cluster(MemoryContext cluster_context);
+static void drop_transient_heap(Oid OIDOldHeap, Oid OIDNewHeap,
+								bool is_system_catalog,
+								bool swap_toast_by_content,
+								Oid *mapped_tables);
+static double copy_table_data_concurrently(Relation OldHeap, Relation NewHeap,
+										   Relation OldIndex, bool verbose);
+static double decode_concurrent_changes(LogicalDecodingContext *ctx,
+										ClusterApplyState *astate);
+static void apply_concurrent_changes(ClusterDecodingState *dstate,
+									 ClusterApplyState *astate);
+static void find_concurrent_target(ClusterApplyState *astate, HeapTuple key);
+static void cluster_store_tuple(HeapTuple tuple, TupleTableSlot *slot);
+static HeapTuple copy_decoded_tuple(HeapTuple tuple, TupleDesc desc);
+static void cluster_decode_startup(LogicalDecodingContext *ctx,
+								   OutputPluginOptions *opt, bool is_init);
+static void cluster_decode_begin(LogicalDecodingContext *ctx,
+								 ReorderBufferTXN *txn);
+static void cluster_decode_change(LogicalDecodingContext *ctx,
+								  ReorderBufferTXN *txn, Relation relation,
+								  ReorderBufferChange *change);
+static void cluster_decode_commit(LogicalDecodingContext *ctx,
+								  ReorderBufferTXN *txn, XLogRecPtr commit_lsn);
 
 
 /*---------------------------------------------------------------------------
@@ -108,9 +190,19 @@ cluster(ClusterStmt *stmt, bool isTopLevel)
 		Oid			tableOid,
 					indexOid = InvalidOid;
 		Relation	rel;
+		bool		concurrent = (stmt->options & CLUOPT_CONCURRENTLY) != 0;
+
+		/*
+		 * CLUSTER CONCURRENTLY commits and starts transactions of its own, and
+		 * locks out neither reads nor writes until the very end.
+		 */
+		if (concurrent)
+			PreventInTransactionBlock(isTopLevel, "CLUSTER CONCURRENTLY");
 
 		/* Find, lock, and check permissions on the table */
 		tableOid = RangeVarGetRelidExtended(stmt->relation,
+											concurrent ?
+											ShareUpdateExclusiveLock :
 											AccessExclusiveLock,
 											0,
 											RangeVarCallbackOwnsTable, NULL);
@@ -183,7 +275,11 @@ cluster(ClusterStmt *stmt, bool isTopLevel)
 		table_close(rel, NoLock);
 
 		/* Do the job. */
-		cluster_rel(tableOid, indexOid, stmt->options);
+		if (concurrent)
+			cluster_concurrently(tableOid, indexOid,
+								 (stmt->options & CLUOPT_VERBOSE) != 0);
+		else
+			cluster_rel(tableOid, indexOid, stmt->options);
 	}
 	else
 	{
@@ -654,6 +750,16 @@ make_new_heap(Oid OIDOldHeap, Oid NewTableSpace, char relpersistence,
 	OldHeap = table_open(OIDOldHeap, lockmode);
 	OldHeapDesc = RelationGetDescr(OldHeap);
 
+	/*
+	 * A rewrite gives the table a new relfilenode, which would strand the
+	 * contents other sessions keep under the old one.
+	 */
+	if (RelationIsGlobalTemp(OldHeap))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot rewrite global temporary table \"%s\"",
+						RelationGetRelationName(OldHeap))));
+
 	/*
 	 * Note that the NewHeap will not receive any of the defaults or
 	 * constraints associated with the OldHeap; we don't need 'em, and there's
@@ -1347,10 +1453,8 @@ finish_heap_swap(Oid OIDOldHeap, Oid OIDNewHeap,
 				 MultiXactId cutoffMulti,
 				 char newrelpersistence)
 {
-	ObjectAddress object;
 	Oid			mapped_tables[4];
 	int			reindex_flags;
-	int			i;
 
 	/* Report that we are now swapping relation files */
 	pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
@@ -1446,6 +1550,22 @@ finish_heap_swap(Oid OIDOldHeap, Oid OIDNewHeap,
 		table_close(relRelation, RowExclusiveLock);
 	}
 
+	drop_transient_heap(OIDOldHeap, OIDNewHeap, is_system_catalog,
+						swap_toast_by_content, mapped_tables);
+}
+
+/*
+ * Drop the transient table once its files have been swapped with those of
+ * OIDOldHeap, and tidy up after the swap.  Subroutine of finish_heap_swap,
+ * also used by CLUSTER CONCURRENTLY.
+ */
+static void
+drop_transient_heap(Oid OIDOldHeap, Oid OIDNewHeap, bool is_system_catalog,
+					bool swap_toast_by_content, Oid *mapped_tables)
+{
+	ObjectAddress object;
+	int			i;
+
 	/* Destroy new heap with old filenode */
 	object.classId = RelationRelationId;
 	object.objectId = OIDNewHeap;
@@ -1576,3 +1696,750 @@ get_tables_to_cluster(MemoryContext cluster_context)
 
 	return rvs;
 }
+
+
+/*
+ * cluster_concurrently
+ *
+ * CLUSTER CONCURRENTLY and VACUUM (FULL, CONCURRENTLY): rebuild the table
+ * like cluster_rel does, but without blocking reads and writes for most of
+ * the time.
+ *
+ * The table is copied into the new heap with only ShareUpdateExclusiveLock
+ * held, using the initial snapshot of a temporary logical replication slot.
+ * The changes committed after that snapshot are then decoded from WAL and
+ * replayed on the new heap, looking up rows by a copy of the table's
+ * identity index.  Only the last round of replay and the swap of relation
+ * files are done under AccessExclusiveLock.  Rather than being rebuilt
+ * after the swap, the indexes are copied onto the new heap before the
+ * replay starts, and their files are swapped along with the heap's.
+ *
+ * The caller must hold ShareUpdateExclusiveLock on the table, and must be
+ * at top level outside a transaction block, since we commit the current
+ * transaction and start new ones.
+ */
+void
+cluster_concurrently(Oid tableOid, Oid indexOid, bool verbose)
+{
+	const char *cmd = OidIsValid(indexOid) ?
+	"CLUSTER CONCURRENTLY" : "VACUUM (FULL, CONCURRENTLY)";
+	Relation	OldHeap,
+				NewHeap,
+				OldIndex = NULL;
+	LockRelId	heaprelid;
+	Oid			identIndex;
+	Oid			OIDNewHeap;
+	List	   *indexes;
+	List	   *newindexes = NIL;
+	ListCell   *lc,
+			   *lc2;
+	char		slotname[NAMEDATALEN];
+	LogicalDecodingContext *ctx;
+	ClusterDecodingState *dstate;
+	ClusterApplyState astate;
+	ResultRelInfo *resultRelInfo;
+	RangeTblEntry *rte;
+	Snapshot	snapshot;
+	Relation	relRelation;
+	HeapTuple	reltup;
+	Form_pg_class relform;
+	MultiXactId cutoffMulti;
+	Oid			mapped_tables[4];
+	int			round;
+	int			elevel = verbose ? INFO : DEBUG2;
+
+	pgstat_progress_start_command(PROGRESS_COMMAND_CLUSTER, tableOid);
+	if (OidIsValid(indexOid))
+		pgstat_progress_update_param(PROGRESS_CLUSTER_COMMAND,
+									 PROGRESS_CLUSTER_COMMAND_CLUSTER);
+	else
+		pgstat_progress_update_param(PROGRESS_CLUSTER_COMMAND,
+									 PROGRESS_CLUSTER_COMMAND_VACUUM_FULL);
+
+	OldHeap = table_open(tableOid, NoLock);
+
+	/*
+	 * Changes to catalogs cannot be replayed this way, and those to temporary
+	 * and unlogged tables are not decoded at all.
+	 */
+	if (OldHeap->rd_rel->relkind != RELKIND_RELATION ||
+		OldHeap->rd_rel->relpersistence != RELPERSISTENCE_PERMANENT ||
+		IsCatalogRelation(OldHeap) ||
+		RelationIsUsedAsCatalogTable(OldHeap))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot rebuild relation \"%s\" concurrently",
+						RelationGetRelationName(OldHeap)),
+				 errdetail("Only permanent tables that are not catalogs can be rebuilt concurrently.")));
+
+	CheckTableNotInUse(OldHeap, cmd);
+
+	/* We need the identity index to find the rows that were changed */
+	identIndex = RelationGetReplicaIndex(OldHeap);
+	if (!OidIsValid(identIndex))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("cannot rebuild table \"%s\" concurrently",
+						RelationGetRelationName(OldHeap)),
+				 errdetail("The table has neither a primary key nor a replica identity index.")));
+
+	/*
+	 * The indexes are going to be copied, which index_create_copy cannot do
+	 * for exclusion constraints.  An invalid index would be left pointing to
+	 * the old heap.
+	 */
+	indexes = RelationGetIndexList(OldHeap);
+	foreach(lc, indexes)
+	{
+		Relation	ind = index_open(lfirst_oid(lc), ShareUpdateExclusiveLock);
+
+		if (ind->rd_index->indisexclusion)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot rebuild table \"%s\" concurrently",
+							RelationGetRelationName(OldHeap)),
+					 errdetail("Index \"%s\" is used by an exclusion constraint.",
+							   RelationGetRelationName(ind))));
+		if (!ind->rd_index->indisvalid)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("cannot rebuild table \"%s\" concurrently",
+							RelationGetRelationName(OldHeap)),
+					 errdetail("Index \"%s\" is not valid.",
+							   RelationGetRelationName(ind)),
+					 errhint("Drop or rebuild the index first.")));
+		index_close(ind, NoLock);
+	}
+
+	if (OidIsValid(indexOid))
+		check_index_is_clusterable(OldHeap, indexOid, false,
+								   ShareUpdateExclusiveLock);
+
+	CheckLogicalDecodingRequirements();
+
+	/*
+	 * Hold our lock on the table across the transactions below, as CREATE
+	 * INDEX CONCURRENTLY does.
+	 */
+	heaprelid = OldHeap->rd_lockInfo.lockRelId;
+	LockRelationIdForSession(&heaprelid, ShareUpdateExclusiveLock);
+	table_close(OldHeap, NoLock);
+
+	/*
+	 * The initial snapshot of the replication slot must be the first one
+	 * taken in its transaction, so start a new one.
+	 */
+	if (ActiveSnapshotSet())
+		PopActiveSnapshot();
+	CommitTransactionCommand();
+	StartTransactionCommand();
+	XactIsoLevel = XACT_REPEATABLE_READ;
+
+	/*
+	 * Create the slot.  This waits for the transactions running now to
+	 * finish, so that all the changes committed after the snapshot can be
+	 * decoded.
+	 */
+	snprintf(slotname, sizeof(slotname), "pg_cluster_%d", MyProcPid);
+	ReplicationSlotCreate(slotname, true, RS_TEMPORARY);
+
+	cluster_decoding_lxid = MyProc->lxid;
+	ctx = CreateInitDecodingContext(CLUSTER_DECODING_PLUGIN, NIL, true,
+									InvalidXLogRecPtr,
+									logical_read_local_xlog_page,
+									NULL, NULL, NULL);
+	cluster_decoding_lxid = InvalidLocalTransactionId;
+	DecodingContextFindStartpoint(ctx);
+
+	InvalidateCatalogSnapshot();
+	snapshot = SnapBuildInitialSnapshot(ctx->snapshot_builder);
+	RestoreTransactionSnapshot(snapshot, MyProc);
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	dstate = (ClusterDecodingState *) palloc0(sizeof(ClusterDecodingState));
+	dstate->relid = tableOid;
+	dstate->change_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											   "CLUSTER CONCURRENTLY changes",
+											   ALLOCSET_DEFAULT_SIZES);
+	ctx->output_plugin_private = dstate;
+
+	/* Now copy the table as of the slot's snapshot */
+	OldHeap = table_open(tableOid, ShareUpdateExclusiveLock);
+	if (OidIsValid(indexOid))
+	{
+		OldIndex = index_open(indexOid, ShareUpdateExclusiveLock);
+		mark_index_clustered(OldHeap, indexOid, true);
+	}
+	cutoffMulti = OldHeap->rd_rel->relminmxid;
+	indexes = RelationGetIndexList(OldHeap);
+
+	OIDNewHeap = make_new_heap(tableOid, OldHeap->rd_rel->reltablespace,
+							   RELPERSISTENCE_PERMANENT,
+							   ShareUpdateExclusiveLock);
+	NewHeap = table_open(OIDNewHeap, AccessExclusiveLock);
+
+	memset(&astate, 0, sizeof(astate));
+	astate.NewHeap = NewHeap;
+	astate.num_tuples = copy_table_data_concurrently(OldHeap, NewHeap,
+													 OldIndex, verbose);
+
+	/* Build a copy of each index on the new heap */
+	pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+								 PROGRESS_CLUSTER_PHASE_REBUILD_INDEX);
+	foreach(lc, indexes)
+	{
+		Oid			oldIndexId = lfirst_oid(lc);
+		Oid			newIndexId;
+
+		newIndexId = index_create_copy(NewHeap, 0, oldIndexId,
+									   ChooseRelationName(get_rel_name(oldIndexId),
+														  NULL,
+														  "ccnew",
+														  RelationGetNamespace(NewHeap),
+														  false));
+		newindexes = lappend_oid(newindexes, newIndexId);
+		if (oldIndexId == identIndex)
+			astate.identIndex = newIndexId;
+
+		pgstat_progress_update_param(PROGRESS_CLUSTER_INDEX_REBUILD_COUNT,
+									 list_length(newindexes));
+	}
+	CommandCounterIncrement();
+
+	/* Set up to apply the changes, cf. create_estate_for_relation */
+	astate.estate = CreateExecutorState();
+
+	rte = makeNode(RangeTblEntry);
+	rte->rtekind = RTE_RELATION;
+	rte->relid = OIDNewHeap;
+	rte->relkind = RELKIND_RELATION;
+	rte->rellockmode = AccessExclusiveLock;
+	ExecInitRangeTable(astate.estate, list_make1(rte));
+
+	resultRelInfo = makeNode(ResultRelInfo);
+	InitResultRelInfo(resultRelInfo, NewHeap, 1, NULL, 0);
+	astate.estate->es_result_relations = resultRelInfo;
+	astate.estate->es_num_result_relations = 1;
+	astate.estate->es_result_relation_info = resultRelInfo;
+	ExecOpenIndices(resultRelInfo, false);
+
+	astate.newslot = MakeSingleTupleTableSlot(RelationGetDescr(NewHeap),
+											  &TTSOpsVirtual);
+	astate.keyslot = MakeSingleTupleTableSlot(RelationGetDescr(NewHeap),
+											  &TTSOpsVirtual);
+	astate.foundslot = table_slot_create(NewHeap, NULL);
+
+	/* Catch up with the changes made while we were copying */
+	pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+								 PROGRESS_CLUSTER_PHASE_WRITE_NEW_HEAP);
+	for (round = 0; round < CLUSTER_MAX_CATCHUP_ROUNDS; round++)
+	{
+		if (decode_concurrent_changes(ctx, &astate) < CLUSTER_CATCHUP_THRESHOLD)
+			break;
+	}
+
+	/*
+	 * Lock out everybody else, and apply whatever has been committed since
+	 * the last round.
+	 */
+	LockRelationOid(tableOid, AccessExclusiveLock);
+	foreach(lc, indexes)
+		LockRelationOid(lfirst_oid(lc), AccessExclusiveLock);
+	decode_concurrent_changes(ctx, &astate);
+
+	ereport(elevel,
+			(errmsg("\"%s\": applied %.0f concurrent changes",
+					RelationGetRelationName(OldHeap), astate.napplied)));
+
+	ExecCloseIndices(resultRelInfo);
+	ExecDropSingleTupleTableSlot(astate.newslot);
+	ExecDropSingleTupleTableSlot(astate.keyslot);
+	ExecDropSingleTupleTableSlot(astate.foundslot);
+	FreeExecutorState(astate.estate);
+
+	FreeDecodingContext(ctx);
+	MemoryContextDelete(dstate->change_cxt);
+	ReplicationSlotRelease();
+	ReplicationSlotDrop(slotname, false);
+
+	/* Update pg_class to reflect the correct values of pages and tuples. */
+	relRelation = table_open(RelationRelationId, RowExclusiveLock);
+	reltup = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(OIDNewHeap));
+	if (!HeapTupleIsValid(reltup))
+		elog(ERROR, "cache lookup failed for relation %u", OIDNewHeap);
+	relform = (Form_pg_class) GETSTRUCT(reltup);
+	relform->relpages = RelationGetNumberOfBlocks(NewHeap);
+	relform->reltuples = astate.num_tuples;
+	CatalogTupleUpdate(relRelation, &reltup->t_self, reltup);
+	heap_freetuple(reltup);
+	table_close(relRelation, RowExclusiveLock);
+	CommandCounterIncrement();
+
+	/* Predicate locks on the old files would be lost, as in cluster_rel */
+	TransferPredicateLocksToHeapRelation(OldHeap);
+	foreach(lc, indexes)
+	{
+		Relation	ind = index_open(lfirst_oid(lc), NoLock);
+
+		TransferPredicateLocksToHeapRelation(ind);
+		index_close(ind, NoLock);
+	}
+
+	if (OldIndex != NULL)
+		index_close(OldIndex, NoLock);
+	table_close(NewHeap, NoLock);
+	table_close(OldHeap, NoLock);
+
+	/*
+	 * Swap the files of the heaps and of each pair of indexes.  The rows we
+	 * copied are frozen, and all the others were written by our transaction,
+	 * so that's what relfrozenxid can be set to.  The new heap has no
+	 * multixacts at all, but don't move relminmxid backwards.
+	 */
+	pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+								 PROGRESS_CLUSTER_PHASE_SWAP_REL_FILES);
+
+	if (!MultiXactIdIsValid(cutoffMulti) ||
+		MultiXactIdPrecedes(cutoffMulti, GetOldestMultiXactId()))
+		cutoffMulti = GetOldestMultiXactId();
+
+	memset(mapped_tables, 0, sizeof(mapped_tables));
+	swap_relation_files(tableOid, OIDNewHeap, false, false, true,
+						GetCurrentTransactionId(), cutoffMulti,
+						mapped_tables);
+	forboth(lc, indexes, lc2, newindexes)
+	{
+		swap_relation_files(lfirst_oid(lc), lfirst_oid(lc2), false, false,
+							true, InvalidTransactionId, InvalidMultiXactId,
+							mapped_tables);
+	}
+	CommandCounterIncrement();
+
+	pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+								 PROGRESS_CLUSTER_PHASE_FINAL_CLEANUP);
+
+	drop_transient_heap(tableOid, OIDNewHeap, false, false, mapped_tables);
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	StartTransactionCommand();
+
+	UnlockRelationIdForSession(&heaprelid, ShareUpdateExclusiveLock);
+
+	pgstat_progress_end_command();
+}
+
+/*
+ * Copy the rows of OldHeap visible to the active snapshot into NewHeap, in
+ * the order of OldIndex if given.  Returns the number of rows copied.
+ *
+ * The rows are inserted frozen and not decoded, since the copy is not
+ * visible to anybody else until it is swapped in.
+ */
+static double
+copy_table_data_concurrently(Relation OldHeap, Relation NewHeap,
+							 Relation OldIndex, bool verbose)
+{
+	TupleDesc	oldTupDesc = RelationGetDescr(OldHeap);
+	Tuplesortstate *tuplesort = NULL;
+	TableScanDesc scan = NULL;
+	IndexScanDesc indexScan = NULL;
+	TupleTableSlot *slot,
+			   *newslot;
+	BulkInsertState bistate;
+	CommandId	mycid = GetCurrentCommandId(true);
+	int			options = TABLE_INSERT_SKIP_FSM | TABLE_INSERT_FROZEN |
+	TABLE_INSERT_NO_LOGICAL;
+	double		num_tuples = 0;
+	int			elevel = verbose ? INFO : DEBUG2;
+	PGRUsage	ru0;
+
+	pg_rusage_init(&ru0);
+
+	/* Sort unless there's no index, or we only know how to scan it */
+	if (OldIndex != NULL && OldIndex->rd_rel->relam == BTREE_AM_OID)
+	{
+		ereport(elevel,
+				(errmsg("clustering \"%s.%s\" using sequential scan and sort",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap))));
+		tuplesort = tuplesort_begin_cluster(oldTupDesc, OldIndex,
+											maintenance_work_mem,
+											NULL, false);
+	}
+	else if (OldIndex != NULL)
+		ereport(elevel,
+				(errmsg("clustering \"%s.%s\" using index scan on \"%s\"",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap),
+						RelationGetRelationName(OldIndex))));
+	else
+		ereport(elevel,
+				(errmsg("vacuuming \"%s.%s\"",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap))));
+
+	slot = table_slot_create(OldHeap, NULL);
+	newslot = MakeSingleTupleTableSlot(RelationGetDescr(NewHeap),
+									   &TTSOpsVirtual);
+	bistate = GetBulkInsertState();
+
+	if (OldIndex != NULL && tuplesort == NULL)
+	{
+		pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+									 PROGRESS_CLUSTER_PHASE_INDEX_SCAN_HEAP);
+		indexScan = index_beginscan(OldHeap, OldIndex, GetActiveSnapshot(),
+									0, 0);
+		index_rescan(indexScan, NULL, 0, NULL, 0);
+	}
+	else
+	{
+		pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+									 PROGRESS_CLUSTER_PHASE_SEQ_SCAN_HEAP);
+		pgstat_progress_update_param(PROGRESS_CLUSTER_TOTAL_HEAP_BLKS,
+									 RelationGetNumberOfBlocks(OldHeap));
+		scan = table_beginscan(OldHeap, GetActiveSnapshot(), 0, NULL);
+	}
+
+	for (;;)
+	{
+		HeapTuple	tuple;
+		bool		shouldFree;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (indexScan != NULL)
+		{
+			if (!index_getnext_slot(indexScan, ForwardScanDirection, slot))
+				break;
+		}
+		else if (!table_scan_getnextslot(scan, ForwardScanDirection, slot))
+			break;
+
+		num_tuples += 1;
+		pgstat_progress_update_param(PROGRESS_CLUSTER_HEAP_TUPLES_SCANNED,
+									 num_tuples);
+
+		if (tuplesort != NULL)
+		{
+			tuple = ExecFetchSlotHeapTuple(slot, false, &shouldFree);
+			tuplesort_putheaptuple(tuplesort, tuple);
+			if (shouldFree)
+				heap_freetuple(tuple);
+			continue;
+		}
+
+		tuple = ExecFetchSlotHeapTuple(slot, false, &shouldFree);
+		cluster_store_tuple(tuple, newslot);
+		table_tuple_insert(NewHeap, newslot, mycid, options, bistate);
+		if (shouldFree)
+			heap_freetuple(tuple);
+		pgstat_progress_update_param(PROGRESS_CLUSTER_HEAP_TUPLES_WRITTEN,
+									 num_tuples);
+	}
+
+	if (indexScan != NULL)
+		index_endscan(indexScan);
+	if (scan != NULL)
+		table_endscan(scan);
+
+	if (tuplesort != NULL)
+	{
+		double		n_written = 0;
+
+		pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+									 PROGRESS_CLUSTER_PHASE_SORT_TUPLES);
+		tuplesort_performsort(tuplesort);
+
+		pgstat_progress_update_param(PROGRESS_CLUSTER_PHASE,
+									 PROGRESS_CLUSTER_PHASE_WRITE_NEW_HEAP);
+		for (;;)
+		{
+			HeapTuple	tuple;
+
+			CHECK_FOR_INTERRUPTS();
+
+			tuple = tuplesort_getheaptuple(tuplesort, true);
+			if (tuple == NULL)
+				break;
+
+			cluster_store_tuple(tuple, newslot);
+			table_tuple_insert(NewHeap, newslot, mycid, options, bistate);
+			n_written += 1;
+			pgstat_progress_update_param(PROGRESS_CLUSTER_HEAP_TUPLES_WRITTEN,
+										 n_written);
+		}
+
+		tuplesort_end(tuplesort);
+	}
+
+	FreeBulkInsertState(bistate);
+	table_finish_bulk_insert(NewHeap, options);
+	ExecDropSingleTupleTableSlot(newslot);
+	ExecDropSingleTupleTableSlot(slot);
+
+	ereport(elevel,
+			(errmsg("\"%s\": copied %.0f row versions in %u pages",
+					RelationGetRelationName(OldHeap), num_tuples,
+					RelationGetNumberOfBlocks(OldHeap)),
+			 errdetail_internal("%s.", pg_rusage_show(&ru0))));
+
+	return num_tuples;
+}
+
+/*
+ * Decode the WAL written so far, applying the changes to the table being
+ * clustered.  Returns the number of changes applied.
+ */
+static double
+decode_concurrent_changes(LogicalDecodingContext *ctx,
+						  ClusterApplyState *astate)
+{
+	ClusterDecodingState *dstate = (ClusterDecodingState *) ctx->output_plugin_private;
+	double		napplied = astate->napplied;
+	XLogRecPtr	end_of_wal;
+
+	/*
+	 * Write a record of our own and decode up to it; every transaction that
+	 * committed before it is then accounted for.
+	 */
+	end_of_wal = LogLogicalMessage(CLUSTER_DECODING_PLUGIN, "", 0, false);
+	XLogFlush(end_of_wal);
+
+	while (ctx->reader->EndRecPtr < end_of_wal)
+	{
+		XLogRecord *record;
+		char	   *errm = NULL;
+
+		CHECK_FOR_INTERRUPTS();
+
+		record = XLogReadRecord(ctx->reader, InvalidXLogRecPtr, &errm);
+		if (errm)
+			elog(ERROR, "%s", errm);
+		if (record != NULL)
+			LogicalDecodingProcessRecord(ctx, ctx->reader);
+
+		if (dstate->nchanges >= CLUSTER_APPLY_BATCH_SIZE)
+			apply_concurrent_changes(dstate, astate);
+	}
+	apply_concurrent_changes(dstate, astate);
+
+	LogicalConfirmReceivedLocation(ctx->reader->EndRecPtr);
+
+	return astate->napplied - napplied;
+}
+
+/*
+ * Apply the changes collected by the decoding plugin to the new heap, and
+ * forget them.
+ */
+static void
+apply_concurrent_changes(ClusterDecodingState *dstate,
+						 ClusterApplyState *astate)
+{
+	Relation	rel = astate->NewHeap;
+	ListCell   *lc;
+
+	foreach(lc, dstate->changes)
+	{
+		ConcurrentChange *change = (ConcurrentChange *) lfirst(lc);
+		bool		update_indexes;
+
+		switch (change->action)
+		{
+			case REORDER_BUFFER_CHANGE_INSERT:
+				cluster_store_tuple(change->newtuple, astate->newslot);
+				table_tuple_insert(rel, astate->newslot,
+								   GetCurrentCommandId(true), 0, NULL);
+				ExecInsertIndexTuples(astate->newslot, astate->estate,
+									  false, NULL, NIL);
+				astate->num_tuples += 1;
+				break;
+
+			case REORDER_BUFFER_CHANGE_UPDATE:
+				/* the old key is only logged if it changed */
+				find_concurrent_target(astate, change->oldtuple ?
+									   change->oldtuple : change->newtuple);
+				cluster_store_tuple(change->newtuple, astate->newslot);
+				simple_table_tuple_update(rel, &astate->foundslot->tts_tid,
+										  astate->newslot, GetActiveSnapshot(),
+										  &update_indexes);
+				if (update_indexes)
+					ExecInsertIndexTuples(astate->newslot, astate->estate,
+										  false, NULL, NIL);
+				break;
+
+			case REORDER_BUFFER_CHANGE_DELETE:
+				find_concurrent_target(astate, change->oldtuple);
+				simple_table_tuple_delete(rel, &astate->foundslot->tts_tid,
+										  GetActiveSnapshot());
+				astate->num_tuples -= 1;
+				break;
+
+			default:
+				elog(ERROR, "unexpected change type %d", change->action);
+		}
+
+		ResetPerTupleExprContext(astate->estate);
+
+		/* make the change visible to the lookups of the following ones */
+		CommandCounterIncrement();
+	}
+
+	astate->napplied += dstate->nchanges;
+
+	dstate->changes = NIL;
+	dstate->nchanges = 0;
+	MemoryContextReset(dstate->change_cxt);
+}
+
+/*
+ * Find the row of the new heap with the identity key of the given tuple,
+ * and leave it in astate->foundslot.
+ */
+static void
+find_concurrent_target(ClusterApplyState *astate, HeapTuple key)
+{
+	if (key == NULL)
+		elog(ERROR, "no identity key logged for concurrent change");
+
+	cluster_store_tuple(key, astate->keyslot);
+	if (!RelationFindReplTupleByIndex(astate->NewHeap, astate->identIndex,
+									  LockTupleExclusive, astate->keyslot,
+									  astate->foundslot))
+		elog(ERROR, "could not find row of concurrent change in new heap of \"%s\"",
+			 RelationGetRelationName(astate->NewHeap));
+}
+
+/*
+ * Store a row of the old heap in a virtual slot of the new one.  Like
+ * reform_and_rewrite_tuple, this gets rid of the values of dropped columns.
+ */
+static void
+cluster_store_tuple(HeapTuple tuple, TupleTableSlot *slot)
+{
+	TupleDesc	desc = slot->tts_tupleDescriptor;
+	int			i;
+
+	ExecClearTuple(slot);
+	heap_deform_tuple(tuple, desc, slot->tts_values, slot->tts_isnull);
+	for (i = 0; i < desc->natts; i++)
+	{
+		if (TupleDescAttr(desc, i)->attisdropped)
+			slot->tts_isnull[i] = true;
+	}
+	ExecStoreVirtualTuple(slot);
+}
+
+/*
+ * Copy a decoded tuple into the current memory context.
+ *
+ * Values the reorder buffer reassembled from TOAST chunks are referenced by
+ * indirect pointers into memory that goes away after the change callback,
+ * so those are copied too.  Pointers to values on disk are kept: they are
+ * still valid when the change is applied.
+ */
+static HeapTuple
+copy_decoded_tuple(HeapTuple tuple, TupleDesc desc)
+{
+	Datum	   *values;
+	bool	   *isnull;
+	HeapTuple	result;
+	int			i;
+
+	values = (Datum *) palloc(desc->natts * sizeof(Datum));
+	isnull = (bool *) palloc(desc->natts * sizeof(bool));
+	heap_deform_tuple(tuple, desc, values, isnull);
+
+	for (i = 0; i < desc->natts; i++)
+	{
+		struct varlena *value;
+
+		if (isnull[i] || TupleDescAttr(desc, i)->attlen != -1)
+			continue;
+
+		value = (struct varlena *) DatumGetPointer(values[i]);
+		if (VARATT_IS_EXTERNAL_INDIRECT(value))
+			values[i] = PointerGetDatum(heap_tuple_fetch_attr(value));
+	}
+
+	result = heap_form_tuple(desc, values, isnull);
+
+	pfree(values);
+	pfree(isnull);
+
+	return result;
+}
+
+/*
+ * Output plugin used by CLUSTER CONCURRENTLY.
+ *
+ * It does not write any output, but collects the changes to the table
+ * being clustered in the ClusterDecodingState that cluster_concurrently
+ * sets as the context's private data.
+ */
+void
+cluster_decoding_init(OutputPluginCallbacks *cb)
+{
+	cb->startup_cb = cluster_decode_startup;
+	cb->begin_cb = cluster_decode_begin;
+	cb->change_cb = cluster_decode_change;
+	cb->commit_cb = cluster_decode_commit;
+}
+
+static void
+cluster_decode_startup(LogicalDecodingContext *ctx, OutputPluginOptions *opt,
+					   bool is_init)
+{
+	if (cluster_decoding_lxid != MyProc->lxid)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("output plugin \"%s\" can only be used by CLUSTER CONCURRENTLY",
+						CLUSTER_DECODING_PLUGIN)));
+
+	opt->output_type = OUTPUT_PLUGIN_BINARY_OUTPUT;
+}
+
+static void
+cluster_decode_begin(LogicalDecodingContext *ctx, ReorderBufferTXN *txn)
+{
+	/* nothing to do */
+}
+
+static void
+cluster_decode_commit(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					  XLogRecPtr commit_lsn)
+{
+	/* nothing to do */
+}
+
+static void
+cluster_decode_change(LogicalDecodingContext *ctx, ReorderBufferTXN *txn,
+					  Relation relation, ReorderBufferChange *change)
+{
+	ClusterDecodingState *dstate = (ClusterDecodingState *) ctx->output_plugin_private;
+	TupleDesc	desc = RelationGetDescr(relation);
+	ConcurrentChange *cc;
+	MemoryContext oldcxt;
+
+	if (RelationGetRelid(relation) != dstate->relid)
+		return;
+
+	oldcxt = MemoryContextSwitchTo(dstate->change_cxt);
+
+	cc = (ConcurrentChange *) palloc(sizeof(ConcurrentChange));
+	cc->action = change->action;
+	cc->oldtuple = NULL;
+	cc->newtuple = NULL;
+	if (change->data.tp.oldtuple != NULL)
+		cc->oldtuple = copy_decoded_tuple(&change->data.tp.oldtuple->tuple,
+										  desc);
+	if (change->data.tp.newtuple != NULL)
+		cc->newtuple = copy_decoded_tuple(&change->data.tp.newtuple->tuple,
+										  desc);
+
+	dstate->changes = lappend(dstate->changes, cc);
+	dstate->nchanges++;
+
+	MemoryContextSwitchTo(oldcxt);
+}
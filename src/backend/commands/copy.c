@@ -18,14 +18,18 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include "access/genam.h"
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/sysattr.h"
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/dependency.h"
 #include "catalog/pg_authid.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_trigger.h"
 #include "catalog/pg_type.h"
 #include "commands/copy.h"
 #include "commands/defrem.h"
@@ -39,15 +43,20 @@
 #include "libpq/pqformat.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
+#include "optimizer/clauses.h"
 #include "optimizer/optimizer.h"
 #include "nodes/makefuncs.h"
 #include "parser/parse_coerce.h"
 #include "parser/parse_collate.h"
 #include "parser/parse_expr.h"
 #include "parser/parse_relation.h"
+#include "pgstat.h"
 #include "port/pg_bswap.h"
+#include "port/simd.h"
+#include "postmaster/bgworker_internals.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/fd.h"
+#include "storage/shm_mq.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -57,6 +66,7 @@
 #include "utils/rel.h"
 #include "utils/rls.h"
 #include "utils/snapmgr.h"
+#include "utils/typcache.h"
 
 
 #define ISOCTAL(c) (((c) >= '0') && ((c) <= '7'))
@@ -71,7 +81,8 @@ typedef enum CopyDest
 	COPY_FILE,					/* to/from file (or a piped program) */
 	COPY_OLD_FE,				/* to/from frontend (2.0 protocol) */
 	COPY_NEW_FE,				/* to/from frontend (3.0 protocol) */
-	COPY_CALLBACK				/* to/from callback function */
+	COPY_CALLBACK,				/* to/from callback function */
+	COPY_LEADER					/* to the leader, in a parallel COPY TO */
 } CopyDest;
 
 /*
@@ -95,6 +106,82 @@ typedef enum CopyInsertMethod
 	CIM_MULTI_CONDITIONAL		/* use table_multi_insert only if valid */
 } CopyInsertMethod;
 
+/*
+ * Parallel COPY FROM.
+ *
+ * The leader reads the input and splits it into lines, which it sends in
+ * batches to the workers through one shm_mq per worker.  Each worker runs
+ * the usual CopyFrom() loop on the lines it receives: it converts them to
+ * server encoding, parses the fields, evaluates defaults and constraints and
+ * inserts the tuples.  Only the splitting stays in the leader, since in CSV
+ * mode a newline may be quoted, so that line boundaries can only be found by
+ * scanning the input in order.
+ *
+ * A batch is a single message holding the line number of its first line,
+ * followed by the lines themselves, each preceded by its length as an int32.
+ * The lines are still in the file encoding.
+ *
+ * Parallel COPY TO works the other way around: the workers scan the table
+ * together and format the rows they find, and send them to the leader in
+ * batches of rows, each preceded by its length, but without the line
+ * terminator.  The leader writes them out, one at a time, as CopyTo() would
+ * have.
+ */
+#define PARALLEL_COPY_KEY_SHARED		UINT64CONST(0xD000000000000001)
+#define PARALLEL_COPY_KEY_OPTIONS		UINT64CONST(0xD000000000000002)
+#define PARALLEL_COPY_KEY_ATTNAMELIST	UINT64CONST(0xD000000000000003)
+#define PARALLEL_COPY_KEY_WHERE_CLAUSE	UINT64CONST(0xD000000000000004)
+#define PARALLEL_COPY_KEY_QUEUES		UINT64CONST(0xD000000000000005)
+#define PARALLEL_COPY_KEY_QUERY_TEXT	UINT64CONST(0xD000000000000006)
+#define PARALLEL_COPY_KEY_SCAN			UINT64CONST(0xD000000000000007)
+
+/* Size of each worker's queue, and the size up to which a batch is filled */
+#define PARALLEL_COPY_QUEUE_SIZE	(256 * 1024)
+#define PARALLEL_COPY_BATCH_SIZE	(64 * 1024)
+
+/* Shared state of a parallel COPY, in the DSM segment */
+typedef struct ParallelCopyShared
+{
+	/* These fields are not modified during the copy */
+	bool		is_from;
+	Oid			relid;
+	int			file_encoding;
+	bool		need_transcoding;
+
+	/* Number of tuples inserted by the workers, in COPY FROM */
+	pg_atomic_uint64 processed;
+} ParallelCopyShared;
+
+/* Leader state of a parallel COPY */
+typedef struct ParallelCopyLeader
+{
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	int			nqueues;		/* number of launched workers */
+	shm_mq_handle **queues;		/* one per worker, NULL once it's gone */
+
+	/* these are only used by COPY FROM */
+	StringInfoData *pending;	/* batch not fully sent yet, per worker */
+	int			next_queue;		/* worker to try first for the next batch */
+	StringInfoData batch;		/* batch being filled */
+} ParallelCopyLeader;
+
+/* Worker state of a parallel COPY */
+typedef struct ParallelCopyWorker
+{
+	shm_mq_handle *mqh;
+
+	/* COPY FROM */
+	char	   *batch;			/* last batch received */
+	Size		batch_len;
+	Size		batch_pos;		/* offset of the next line in batch */
+	uint64		next_lineno;	/* line number of that line */
+
+	/* COPY TO */
+	ParallelTableScanDesc pscan;	/* scan shared with the other workers */
+	StringInfoData rows;		/* rows not sent to the leader yet */
+} ParallelCopyWorker;
+
 /*
  * This struct contains all the state variables used throughout a COPY
  * operation. For simplicity, we use the same struct for all variants of COPY,
@@ -154,6 +241,9 @@ typedef struct CopyStateData
 	List	   *convert_select; /* list of column names (can be NIL) */
 	bool	   *convert_select_flags;	/* per-column CSV/TEXT CS flags */
 	Node	   *whereClause;	/* WHERE condition (or NULL) */
+	int			nworkers;		/* number of parallel workers, or 0 */
+	List	   *attnamelist;	/* column list and options as given, for */
+	List	   *options;		/* ... setting up parallel workers */
 
 	/* these are just for error messages, see CopyFromErrorCallback */
 	const char *cur_relname;	/* table name for error messages */
@@ -224,6 +314,15 @@ typedef struct CopyStateData
 	char	   *raw_buf;
 	int			raw_buf_index;	/* next byte to process */
 	int			raw_buf_len;	/* total # of bytes stored */
+
+	/*
+	 * In a parallel COPY FROM, the leader only splits the input into lines,
+	 * leaving their conversion to the workers, which take their lines from
+	 * parallel_worker instead of reading the input.  In a parallel COPY TO,
+	 * the workers' rows go to parallel_worker, see COPY_LEADER.
+	 */
+	bool		parallel_leader;
+	ParallelCopyWorker *parallel_worker;
 } CopyStateData;
 
 /* DestReceiver for COPY (query) TO */
@@ -364,7 +463,24 @@ static void EndCopyTo(CopyState cstate);
 static uint64 DoCopyTo(CopyState cstate);
 static uint64 CopyTo(CopyState cstate);
 static void CopyOneRowTo(CopyState cstate, TupleTableSlot *slot);
+static bool CopyFromDirectOK(CopyState cstate, ResultRelInfo *resultRelInfo);
+static bool CopyFromParallelSafe(CopyState cstate);
+static bool CopyToParallelSafe(CopyState cstate);
+static ParallelCopyLeader *BeginParallelCopy(CopyState cstate);
+static void ParallelCopySplitInput(CopyState cstate, ParallelCopyLeader *pcl);
+static void ParallelCopySendBatch(ParallelCopyLeader *pcl);
+static bool ParallelCopyRetryPending(ParallelCopyLeader *pcl);
+static void ParallelCopyTrySend(ParallelCopyLeader *pcl, int queue);
+static uint64 ParallelCopyReceiveRows(CopyState cstate, ParallelCopyLeader *pcl);
+static void ParallelCopySendRows(ParallelCopyWorker *pcw);
+static uint64 EndParallelCopy(ParallelCopyLeader *pcl);
+static void ParallelCopyToMain(ParallelCopyShared *shared,
+							   ParallelCopyWorker *pcw,
+							   List *attnamelist, List *options);
+static int	ParallelCopyNoInput(void *outbuf, int minread, int maxread);
 static bool CopyReadLine(CopyState cstate);
+static bool ParallelCopyReadLine(CopyState cstate);
+static void CopyConvertLineBuf(CopyState cstate);
 static bool CopyReadLineText(CopyState cstate);
 static int	CopyReadAttributesText(CopyState cstate);
 static int	CopyReadAttributesCSV(CopyState cstate);
@@ -590,6 +706,18 @@ CopySendEndOfRow(CopyState cstate)
 		case COPY_CALLBACK:
 			Assert(false);		/* Not yet supported. */
 			break;
+		case COPY_LEADER:
+			{
+				ParallelCopyWorker *pcw = cstate->parallel_worker;
+				int32		len = fe_msgbuf->len;
+
+				/* The leader adds the line terminator its destination needs */
+				appendBinaryStringInfo(&pcw->rows, (char *) &len, sizeof(int32));
+				appendBinaryStringInfo(&pcw->rows, fe_msgbuf->data, len);
+				if (pcw->rows.len >= PARALLEL_COPY_BATCH_SIZE)
+					ParallelCopySendRows(pcw);
+			}
+			break;
 	}
 
 	resetStringInfo(fe_msgbuf);
@@ -709,6 +837,9 @@ CopyGetData(CopyState cstate, void *databuf, int minread, int maxread)
 		case COPY_CALLBACK:
 			bytesread = cstate->data_source_cb(databuf, minread, maxread);
 			break;
+		case COPY_LEADER:
+			Assert(false);		/* COPY TO only */
+			break;
 	}
 
 	return bytesread;
@@ -1114,6 +1245,7 @@ ProcessCopyOptions(ParseState *pstate,
 				   List *options)
 {
 	bool		format_specified = false;
+	bool		parallel_specified = false;
 	ListCell   *option;
 
 	/* Support external use for option sanity checking */
@@ -1291,6 +1423,23 @@ ProcessCopyOptions(ParseState *pstate,
 								defel->defname),
 						 parser_errposition(pstate, defel->location)));
 		}
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			if (parallel_specified)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options"),
+						 parser_errposition(pstate, defel->location)));
+			parallel_specified = true;
+			cstate->nworkers = defGetInt32(defel);
+			if (cstate->nworkers < 0 ||
+				cstate->nworkers > MAX_PARALLEL_WORKER_LIMIT)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("argument to option \"%s\" must be between 0 and %d",
+								defel->defname, MAX_PARALLEL_WORKER_LIMIT),
+						 parser_errposition(pstate, defel->location)));
+		}
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_SYNTAX_ERROR),
@@ -1429,6 +1578,12 @@ ProcessCopyOptions(ParseState *pstate,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("COPY force null only available using COPY FROM")));
 
+	/* Check parallel */
+	if (cstate->binary && cstate->nworkers > 0 && is_from)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY parallel in binary mode only available using COPY TO")));
+
 	/* Don't allow the delimiter to appear in the null string. */
 	if (strchr(cstate->null_print, cstate->delim[0]) != NULL)
 		ereport(ERROR,
@@ -2021,6 +2176,7 @@ CopyTo(CopyState cstate)
 	int			num_phys_attrs;
 	ListCell   *cur;
 	uint64		processed;
+	ParallelCopyLeader *pcl = NULL;
 
 	if (cstate->rel)
 		tupDesc = RelationGetDescr(cstate->rel);
@@ -2064,17 +2220,23 @@ CopyTo(CopyState cstate)
 
 	if (cstate->binary)
 	{
-		/* Generate header for a binary copy */
-		int32		tmp;
-
-		/* Signature */
-		CopySendData(cstate, BinarySignature, 11);
-		/* Flags field */
-		tmp = 0;
-		CopySendInt32(cstate, tmp);
-		/* No header extension */
-		tmp = 0;
-		CopySendInt32(cstate, tmp);
+		/*
+		 * Generate header for a binary copy.  In a parallel COPY, the leader
+		 * sends it, and the trailer, on its own.
+		 */
+		if (cstate->copy_dest != COPY_LEADER)
+		{
+			int32		tmp;
+
+			/* Signature */
+			CopySendData(cstate, BinarySignature, 11);
+			/* Flags field */
+			tmp = 0;
+			CopySendInt32(cstate, tmp);
+			/* No header extension */
+			tmp = 0;
+			CopySendInt32(cstate, tmp);
+		}
 	}
 	else
 	{
@@ -2111,12 +2273,30 @@ CopyTo(CopyState cstate)
 		}
 	}
 
-	if (cstate->rel)
+	/*
+	 * Leave the scan to parallel workers if that was asked for and is safe,
+	 * and we can launch any; we then just pass on the rows they send us.
+	 */
+	if (cstate->rel && cstate->nworkers > 0 && !IsParallelWorker() &&
+		CopyToParallelSafe(cstate))
+		pcl = BeginParallelCopy(cstate);
+
+	if (pcl != NULL)
+	{
+		processed = ParallelCopyReceiveRows(cstate, pcl);
+		(void) EndParallelCopy(pcl);
+	}
+	else if (cstate->rel)
 	{
 		TupleTableSlot *slot;
 		TableScanDesc scandesc;
 
-		scandesc = table_beginscan(cstate->rel, GetActiveSnapshot(), 0, NULL);
+		if (cstate->parallel_worker != NULL)
+			scandesc = table_beginscan_parallel(cstate->rel,
+												cstate->parallel_worker->pscan);
+		else
+			scandesc = table_beginscan(cstate->rel, GetActiveSnapshot(),
+									   0, NULL);
 		slot = table_slot_create(cstate->rel, NULL);
 
 		processed = 0;
@@ -2142,7 +2322,7 @@ CopyTo(CopyState cstate)
 		processed = ((DR_copy *) cstate->queryDesc->dest)->processed;
 	}
 
-	if (cstate->binary)
+	if (cstate->binary && cstate->copy_dest != COPY_LEADER)
 	{
 		/* Generate trailer for a binary copy */
 		CopySendInt16(cstate, -1);
@@ -2468,11 +2648,18 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 					   buffer->bistate);
 	MemoryContextSwitchTo(oldcontext);
 
+	/*
+	 * Insert into the indexes that can take the whole batch at once.  Like
+	 * table_multi_insert, this can't report which line caused an error.
+	 */
+	if (resultRelInfo->ri_NumIndices > 0)
+		ExecInsertIndexTuplesBatch(slots, nused, estate);
+
 	for (i = 0; i < nused; i++)
 	{
 		/*
-		 * If there are any indexes, update them for all the inserted tuples,
-		 * and run AFTER ROW INSERT triggers.
+		 * If there are any indexes, update the rest of them for all the
+		 * inserted tuples, and run AFTER ROW INSERT triggers.
 		 */
 		if (resultRelInfo->ri_NumIndices > 0)
 		{
@@ -2480,8 +2667,7 @@ CopyMultiInsertBufferFlush(CopyMultiInsertInfo *miinfo,
 
 			cstate->cur_lineno = buffer->linenos[i];
 			recheckIndexes =
-				ExecInsertIndexTuples(buffer->slots[i], estate, false, NULL,
-									  NIL);
+				ExecInsertUnbatchedIndexTuples(buffer->slots[i], estate);
 			ExecARInsertTriggers(estate, resultRelInfo,
 								 slots[i], recheckIndexes,
 								 cstate->transition_capture);
@@ -2652,6 +2838,46 @@ CopyMultiInsertInfoStore(CopyMultiInsertInfo *miinfo, ResultRelInfo *rri,
 	miinfo->bufferedBytes += tuplen;
 }
 
+/*
+ * Can the table be loaded with TABLE_INSERT_DIRECT?
+ *
+ * The table AM may then write the new pages out itself, bypassing shared
+ * buffers, which requires that nobody else can see the relation and that we
+ * don't read the new tuples back before the end of the COPY.  Checking unique
+ * and exclusion constraints would, so no such indexes are allowed.  As with
+ * FREEZE, the relfilenode must be new in the current subtransaction: if it
+ * aborts, the relation and its indexes are then thrown away as a whole, and
+ * no index entries are left behind pointing at pages that were never written.
+ * Parallel COPY isn't supported, as the workers would all be extending the
+ * relation at once.
+ */
+static bool
+CopyFromDirectOK(CopyState cstate, ResultRelInfo *resultRelInfo)
+{
+	Relation	rel = cstate->rel;
+	int			i;
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION)
+		return false;
+
+	if (rel->rd_createSubid != GetCurrentSubTransactionId() &&
+		rel->rd_newRelfilenodeSubid != GetCurrentSubTransactionId())
+		return false;
+
+	if (cstate->parallel_leader || cstate->parallel_worker != NULL)
+		return false;
+
+	for (i = 0; i < resultRelInfo->ri_NumIndices; i++)
+	{
+		IndexInfo  *ii = resultRelInfo->ri_IndexRelationInfo[i];
+
+		if (ii->ii_Unique || ii->ii_ExclusionOps != NULL)
+			return false;
+	}
+
+	return true;
+}
+
 /*
  * Copy FROM file to relation.
  */
@@ -2715,6 +2941,23 @@ CopyFrom(CopyState cstate)
 							RelationGetRelationName(cstate->rel))));
 	}
 
+	/*
+	 * Leave the work to parallel workers if that was asked for and is safe,
+	 * and any can be launched; otherwise we just do it ourselves.
+	 */
+	if (cstate->nworkers > 0 && !IsParallelWorker() &&
+		CopyFromParallelSafe(cstate))
+	{
+		ParallelCopyLeader *pcl = BeginParallelCopy(cstate);
+
+		if (pcl != NULL)
+		{
+			FreeExecutorState(estate);
+			ParallelCopySplitInput(cstate, pcl);
+			return EndParallelCopy(pcl);
+		}
+	}
+
 	/*----------
 	 * Check to see if we can avoid writing WAL
 	 *
@@ -2825,6 +3068,10 @@ CopyFrom(CopyState cstate)
 		ti_options |= TABLE_INSERT_FROZEN;
 	}
 
+	/* A parallel worker may insert, on behalf of the leader */
+	if (cstate->parallel_worker != NULL)
+		ti_options |= TABLE_INSERT_PARALLEL;
+
 	/*
 	 * We need a ResultRelInfo so we can use the regular executor's
 	 * index-entry-making machinery.  (There used to be a huge amount of code
@@ -2963,8 +3210,13 @@ CopyFrom(CopyState cstate)
 		if (proute)
 			insertMethod = CIM_MULTI_CONDITIONAL;
 		else
+		{
 			insertMethod = CIM_MULTI;
 
+			if (CopyFromDirectOK(cstate, resultRelInfo))
+				ti_options |= TABLE_INSERT_DIRECT;
+		}
+
 		CopyMultiInsertInfoInit(&multiInsertInfo, resultRelInfo, cstate,
 								estate, mycid, ti_options);
 	}
@@ -3325,6 +3577,13 @@ CopyFrom(CopyState cstate)
 	{
 		if (!CopyMultiInsertInfoIsEmpty(&multiInsertInfo))
 			CopyMultiInsertInfoFlush(&multiInsertInfo, NULL);
+
+		/*
+		 * With TABLE_INSERT_DIRECT, the last pages may not have been written
+		 * out yet.  Do so before any AFTER triggers get to see the tuples.
+		 */
+		if (ti_options & TABLE_INSERT_DIRECT)
+			ReleaseBulkInsertStatePin(target_resultRelInfo->ri_CopyMultiInsertBuffer->bistate);
 	}
 
 	/* Done, clean up */
@@ -3374,6 +3633,706 @@ CopyFrom(CopyState cstate)
 	return processed;
 }
 
+/*
+ * Can the rows of a COPY FROM be inserted by parallel workers?
+ *
+ * The workers run the whole CopyFrom() loop, so everything it evaluates on
+ * the way must be parallel safe: the input functions of the columns, their
+ * defaults and generation expressions, domain constraints, the WHERE clause,
+ * CHECK constraints, index expressions and predicates, and any BEFORE ROW
+ * INSERT triggers.  Other insert triggers rule it out, since statement
+ * triggers would fire once per worker and the events of AFTER ROW triggers,
+ * which include foreign key checks, can't be passed back to the leader.  So
+ * do FREEZE, which depends on the leader's relcache, temporary tables, which
+ * live in its local buffers, and serializable transactions, whose predicate
+ * locks the workers can't take.
+ */
+static bool
+CopyFromParallelSafe(CopyState cstate)
+{
+	Relation	rel = cstate->rel;
+	TupleDesc	tupDesc = RelationGetDescr(rel);
+	TupleConstr *constr = tupDesc->constr;
+	List	   *indexoidlist;
+	ListCell   *lc;
+	int			i;
+
+	if (rel->rd_rel->relkind != RELKIND_RELATION ||
+		RelationUsesLocalBuffers(rel) ||
+		cstate->freeze ||
+		IsolationIsSerializable())
+		return false;
+
+	if (cstate->whereClause && !is_parallel_safe_expr(cstate->whereClause))
+		return false;
+
+	for (i = 0; i < tupDesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupDesc, i);
+
+		if (att->attisdropped)
+			continue;
+
+		if (DomainHasConstraints(att->atttypid))
+			return false;
+
+		if (list_member_int(cstate->attnumlist, i + 1))
+		{
+			if (func_parallel(cstate->in_functions[i].fn_oid) != PROPARALLEL_SAFE)
+				return false;
+		}
+		else
+		{
+			/* not read from the input, so filled from the default */
+			Node	   *defexpr = build_column_default(rel, i + 1);
+
+			if (defexpr != NULL && !is_parallel_safe_expr(defexpr))
+				return false;
+		}
+	}
+
+	if (constr != NULL)
+	{
+		for (i = 0; i < constr->num_check; i++)
+		{
+			if (!is_parallel_safe_expr(stringToNode(constr->check[i].ccbin)))
+				return false;
+		}
+	}
+
+	indexoidlist = RelationGetIndexList(rel);
+	foreach(lc, indexoidlist)
+	{
+		Relation	indexRel = index_open(lfirst_oid(lc), AccessShareLock);
+		bool		safe;
+
+		safe = is_parallel_safe_expr((Node *) RelationGetIndexExpressions(indexRel)) &&
+			is_parallel_safe_expr((Node *) RelationGetIndexPredicate(indexRel));
+		index_close(indexRel, AccessShareLock);
+
+		if (!safe)
+		{
+			list_free(indexoidlist);
+			return false;
+		}
+	}
+	list_free(indexoidlist);
+
+	if (rel->trigdesc != NULL)
+	{
+		TriggerDesc *trigdesc = rel->trigdesc;
+
+		for (i = 0; i < trigdesc->numtriggers; i++)
+		{
+			Trigger    *trigger = &trigdesc->triggers[i];
+
+			if (!TRIGGER_FOR_INSERT(trigger->tgtype))
+				continue;
+			if (!TRIGGER_FOR_ROW(trigger->tgtype) ||
+				!TRIGGER_FOR_BEFORE(trigger->tgtype) ||
+				func_parallel(trigger->tgfoid) != PROPARALLEL_SAFE)
+				return false;
+			if (trigger->tgqual != NULL &&
+				!is_parallel_safe_expr(stringToNode(trigger->tgqual)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Can the rows of a COPY TO be scanned and formatted by parallel workers?
+ *
+ * That takes a plain permanent table, and parallel safe output functions.
+ */
+static bool
+CopyToParallelSafe(CopyState cstate)
+{
+	ListCell   *cur;
+
+	if (cstate->rel->rd_rel->relkind != RELKIND_RELATION ||
+		RelationUsesLocalBuffers(cstate->rel))
+		return false;
+
+	foreach(cur, cstate->attnumlist)
+	{
+		int			attnum = lfirst_int(cur);
+
+		if (func_parallel(cstate->out_functions[attnum - 1].fn_oid) !=
+			PROPARALLEL_SAFE)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Set up a parallel COPY and launch its workers.
+ *
+ * Returns NULL if no workers could be launched.
+ */
+static ParallelCopyLeader *
+BeginParallelCopy(CopyState cstate)
+{
+	ParallelCopyLeader *pcl;
+	ParallelContext *pcxt;
+	ParallelCopyShared *shared;
+	char	   *options_str;
+	char	   *attnamelist_str;
+	char	   *where_str;
+	char	   *ptr;
+	char	   *queues;
+	Size		querylen;
+	Size		pscan_len = 0;
+	int			nworkers = Min(cstate->nworkers, max_parallel_workers);
+	int			i;
+
+	if (nworkers <= 0)
+		return NULL;
+
+	/*
+	 * The workers of a COPY FROM insert with our transaction ID and command
+	 * ID, but can't assign the one or mark the other as used themselves.
+	 */
+	if (cstate->is_copy_from)
+	{
+		(void) GetCurrentTransactionId();
+		(void) GetCurrentCommandId(true);
+	}
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "ParallelCopyMain", nworkers);
+
+	/* Estimate size for shared state -- PARALLEL_COPY_KEY_SHARED */
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(ParallelCopyShared));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate size for the serialized options, column list and WHERE clause */
+	options_str = nodeToString(cstate->options);
+	attnamelist_str = nodeToString(cstate->attnamelist);
+	where_str = nodeToString(cstate->whereClause);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(options_str) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(attnamelist_str) + 1);
+	shm_toc_estimate_chunk(&pcxt->estimator, strlen(where_str) + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 3);
+
+	/* Estimate size for the queues -- PARALLEL_COPY_KEY_QUEUES */
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(PARALLEL_COPY_QUEUE_SIZE, nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	/* Estimate size for the scan of a COPY TO -- PARALLEL_COPY_KEY_SCAN */
+	if (!cstate->is_copy_from)
+	{
+		pscan_len = table_parallelscan_estimate(cstate->rel,
+												GetActiveSnapshot());
+		shm_toc_estimate_chunk(&pcxt->estimator, pscan_len);
+		shm_toc_estimate_keys(&pcxt->estimator, 1);
+	}
+
+	/* Finally, estimate PARALLEL_COPY_KEY_QUERY_TEXT space */
+	querylen = strlen(debug_query_string);
+	shm_toc_estimate_chunk(&pcxt->estimator, querylen + 1);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+
+	InitializeParallelDSM(pcxt);
+
+	shared = (ParallelCopyShared *) shm_toc_allocate(pcxt->toc,
+													 sizeof(ParallelCopyShared));
+	shared->is_from = cstate->is_copy_from;
+	shared->relid = RelationGetRelid(cstate->rel);
+	shared->file_encoding = cstate->file_encoding;
+	shared->need_transcoding = cstate->need_transcoding;
+	pg_atomic_init_u64(&shared->processed, 0);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_SHARED, shared);
+
+	ptr = shm_toc_allocate(pcxt->toc, strlen(options_str) + 1);
+	strcpy(ptr, options_str);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_OPTIONS, ptr);
+	ptr = shm_toc_allocate(pcxt->toc, strlen(attnamelist_str) + 1);
+	strcpy(ptr, attnamelist_str);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_ATTNAMELIST, ptr);
+	ptr = shm_toc_allocate(pcxt->toc, strlen(where_str) + 1);
+	strcpy(ptr, where_str);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_WHERE_CLAUSE, ptr);
+
+	/*
+	 * Each worker has its own queue, which it receives lines from in COPY
+	 * FROM, and sends rows to in COPY TO.
+	 */
+	queues = shm_toc_allocate(pcxt->toc,
+							  mul_size(PARALLEL_COPY_QUEUE_SIZE, nworkers));
+	for (i = 0; i < nworkers; i++)
+	{
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(queues + i * PARALLEL_COPY_QUEUE_SIZE,
+						   PARALLEL_COPY_QUEUE_SIZE);
+		if (cstate->is_copy_from)
+			shm_mq_set_sender(mq, MyProc);
+		else
+			shm_mq_set_receiver(mq, MyProc);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_QUEUES, queues);
+
+	if (!cstate->is_copy_from)
+	{
+		ParallelTableScanDesc pscan;
+
+		pscan = (ParallelTableScanDesc) shm_toc_allocate(pcxt->toc, pscan_len);
+		table_parallelscan_initialize(cstate->rel, pscan, GetActiveSnapshot());
+		shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_SCAN, pscan);
+	}
+
+	/* Store query string for workers */
+	ptr = shm_toc_allocate(pcxt->toc, querylen + 1);
+	memcpy(ptr, debug_query_string, querylen + 1);
+	shm_toc_insert(pcxt->toc, PARALLEL_COPY_KEY_QUERY_TEXT, ptr);
+
+	LaunchParallelWorkers(pcxt);
+
+	if (pcxt->nworkers_launched == 0)
+	{
+		DestroyParallelContext(pcxt);
+		ExitParallelMode();
+		return NULL;
+	}
+
+	pcl = (ParallelCopyLeader *) palloc0(sizeof(ParallelCopyLeader));
+	pcl->pcxt = pcxt;
+	pcl->shared = shared;
+	pcl->nqueues = pcxt->nworkers_launched;
+	pcl->queues = (shm_mq_handle **)
+		palloc(sizeof(shm_mq_handle *) * pcl->nqueues);
+	pcl->pending = (StringInfoData *)
+		palloc(sizeof(StringInfoData) * pcl->nqueues);
+	for (i = 0; i < pcl->nqueues; i++)
+	{
+		shm_mq	   *mq = (shm_mq *) (queues + i * PARALLEL_COPY_QUEUE_SIZE);
+
+		pcl->queues[i] = shm_mq_attach(mq, pcxt->seg,
+									   pcxt->worker[i].bgwhandle);
+		initStringInfo(&pcl->pending[i]);
+	}
+	initStringInfo(&pcl->batch);
+
+	return pcl;
+}
+
+/*
+ * Read the input of a parallel COPY FROM, and send it to the workers line
+ * by line.
+ */
+static void
+ParallelCopySplitInput(CopyState cstate, ParallelCopyLeader *pcl)
+{
+	ErrorContextCallback errcallback;
+	bool		done = false;
+	int			i;
+
+	/*
+	 * Set up callback to identify error line number.  It's installed only
+	 * while we read, so that it isn't added to errors rethrown from the
+	 * workers, which carry their own.
+	 */
+	errcallback.callback = CopyFromErrorCallback;
+	errcallback.arg = (void *) cstate;
+	errcallback.previous = error_context_stack;
+
+	cstate->parallel_leader = true;
+
+	/* on input just throw the header line away */
+	if (cstate->header_line)
+	{
+		cstate->cur_lineno++;
+		error_context_stack = &errcallback;
+		done = CopyReadLine(cstate);
+		error_context_stack = errcallback.previous;
+	}
+
+	while (!done)
+	{
+		int32		len;
+
+		CHECK_FOR_INTERRUPTS();
+
+		cstate->cur_lineno++;
+		error_context_stack = &errcallback;
+		done = CopyReadLine(cstate);
+		error_context_stack = errcallback.previous;
+
+		/* at EOF, the last line may still have data */
+		if (done && cstate->line_buf.len == 0)
+			break;
+
+		if (pcl->batch.len == 0)
+			appendBinaryStringInfo(&pcl->batch, (char *) &cstate->cur_lineno,
+								   sizeof(uint64));
+		len = cstate->line_buf.len;
+		appendBinaryStringInfo(&pcl->batch, (char *) &len, sizeof(int32));
+		appendBinaryStringInfo(&pcl->batch, cstate->line_buf.data, len);
+
+		if (pcl->batch.len >= PARALLEL_COPY_BATCH_SIZE)
+			ParallelCopySendBatch(pcl);
+	}
+
+	/*
+	 * In the old protocol, tell pqcomm that we can process normal protocol
+	 * messages again.
+	 */
+	if (cstate->copy_dest == COPY_OLD_FE)
+		pq_endmsgread();
+
+	/* Send what's left, and wait until all of it is in the queues */
+	if (pcl->batch.len > 0)
+		ParallelCopySendBatch(pcl);
+	while (ParallelCopyRetryPending(pcl))
+	{
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+						 WAIT_EVENT_MQ_SEND);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	/* Detaching tells the workers that there are no more lines */
+	for (i = 0; i < pcl->nqueues; i++)
+	{
+		if (pcl->queues[i] != NULL)
+		{
+			shm_mq_detach(pcl->queues[i]);
+			pcl->queues[i] = NULL;
+		}
+	}
+}
+
+/*
+ * Hand the batch being filled to one of the workers.
+ *
+ * Every queue has room for one more batch on our side, which we keep until
+ * it's been sent in full: the new batch goes to the next worker that has no
+ * such batch pending, which lets the workers fall behind unevenly without
+ * holding up the others.  If all of them have one pending, we wait.
+ */
+static void
+ParallelCopySendBatch(ParallelCopyLeader *pcl)
+{
+	for (;;)
+	{
+		bool		any_live = false;
+		int			i;
+
+		(void) ParallelCopyRetryPending(pcl);
+
+		for (i = 0; i < pcl->nqueues; i++)
+		{
+			int			q = (pcl->next_queue + i) % pcl->nqueues;
+			StringInfoData empty;
+
+			if (pcl->queues[q] == NULL)
+				continue;
+			any_live = true;
+			if (pcl->pending[q].len > 0)
+				continue;
+
+			/* swap the buffers, so that the batch becomes the pending one */
+			empty = pcl->pending[q];
+			pcl->pending[q] = pcl->batch;
+			pcl->batch = empty;
+			pcl->next_queue = (q + 1) % pcl->nqueues;
+
+			ParallelCopyTrySend(pcl, q);
+			return;
+		}
+
+		if (!any_live)
+		{
+			/* this reports the error the workers exited with */
+			WaitForParallelWorkersToFinish(pcl->pcxt);
+			elog(ERROR, "parallel COPY workers exited prematurely");
+		}
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+						 WAIT_EVENT_MQ_SEND);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Go on sending the pending batches, as far as the queues have room for
+ * them.  Returns true if any are left.
+ */
+static bool
+ParallelCopyRetryPending(ParallelCopyLeader *pcl)
+{
+	bool		result = false;
+	int			i;
+
+	for (i = 0; i < pcl->nqueues; i++)
+	{
+		if (pcl->queues[i] != NULL && pcl->pending[i].len > 0)
+		{
+			ParallelCopyTrySend(pcl, i);
+			if (pcl->pending[i].len > 0)
+				result = true;
+		}
+	}
+
+	return result;
+}
+
+/*
+ * Try to send the batch pending for a queue, without blocking.  If the
+ * queue fills up, shm_mq remembers how far we got, and the next call for
+ * the same batch continues from there.
+ */
+static void
+ParallelCopyTrySend(ParallelCopyLeader *pcl, int queue)
+{
+	shm_mq_result res;
+
+	res = shm_mq_send(pcl->queues[queue], pcl->pending[queue].len,
+					  pcl->pending[queue].data, true, true);
+	if (res == SHM_MQ_SUCCESS)
+		resetStringInfo(&pcl->pending[queue]);
+	else if (res == SHM_MQ_DETACHED)
+	{
+		/*
+		 * The worker is gone, which only happens on an error that it will
+		 * report to us presently.  Just stop sending to it.
+		 */
+		shm_mq_detach(pcl->queues[queue]);
+		pcl->queues[queue] = NULL;
+		resetStringInfo(&pcl->pending[queue]);
+	}
+}
+
+/*
+ * Receive the rows formatted by the workers of a parallel COPY TO, and send
+ * them on.  Returns the number of rows.
+ */
+static uint64
+ParallelCopyReceiveRows(CopyState cstate, ParallelCopyLeader *pcl)
+{
+	uint64		processed = 0;
+	int			nlive = pcl->nqueues;
+
+	while (nlive > 0)
+	{
+		bool		got_any = false;
+		int			i;
+
+		for (i = 0; i < pcl->nqueues; i++)
+		{
+			shm_mq_result res;
+			Size		nbytes;
+			void	   *data;
+			Size		pos;
+
+			if (pcl->queues[i] == NULL)
+				continue;
+
+			res = shm_mq_receive(pcl->queues[i], &nbytes, &data, true);
+			if (res == SHM_MQ_WOULD_BLOCK)
+				continue;
+			if (res == SHM_MQ_DETACHED)
+			{
+				/* the worker is done, or has failed and will tell us so */
+				shm_mq_detach(pcl->queues[i]);
+				pcl->queues[i] = NULL;
+				nlive--;
+				continue;
+			}
+
+			got_any = true;
+			for (pos = 0; pos < nbytes;)
+			{
+				int32		len;
+
+				memcpy(&len, (char *) data + pos, sizeof(int32));
+				pos += sizeof(int32);
+				CopySendData(cstate, (char *) data + pos, len);
+				CopySendEndOfRow(cstate);
+				pos += len;
+				processed++;
+			}
+		}
+
+		if (!got_any && nlive > 0)
+		{
+			(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1L,
+							 WAIT_EVENT_MQ_RECEIVE);
+			ResetLatch(MyLatch);
+		}
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	return processed;
+}
+
+/*
+ * Send the rows a worker of a parallel COPY TO has formatted to the leader.
+ */
+static void
+ParallelCopySendRows(ParallelCopyWorker *pcw)
+{
+	shm_mq_result res;
+
+	res = shm_mq_send(pcw->mqh, pcw->rows.len, pcw->rows.data, false,
+					  true);
+	if (res != SHM_MQ_SUCCESS)
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("could not send rows to parallel COPY leader")));
+	resetStringInfo(&pcw->rows);
+}
+
+/*
+ * Wait for the workers of a parallel COPY to finish, and shut it down.
+ * Returns the number of tuples inserted by the workers of a COPY FROM.
+ */
+static uint64
+EndParallelCopy(ParallelCopyLeader *pcl)
+{
+	uint64		processed;
+
+	WaitForParallelWorkersToFinish(pcl->pcxt);
+
+	processed = pg_atomic_read_u64(&pcl->shared->processed);
+
+	DestroyParallelContext(pcl->pcxt);
+	ExitParallelMode();
+
+	return processed;
+}
+
+/*
+ * Data source callback of a parallel worker's CopyState.  It's never called,
+ * since the worker gets its lines from the leader, in ParallelCopyReadLine.
+ */
+static int
+ParallelCopyNoInput(void *outbuf, int minread, int maxread)
+{
+	elog(ERROR, "parallel COPY worker cannot read the input");
+	return 0;					/* keep compiler quiet */
+}
+
+/*
+ * Main entry point of a parallel COPY worker.
+ */
+void
+ParallelCopyMain(dsm_segment *seg, shm_toc *toc)
+{
+	ParallelCopyShared *shared;
+	ParallelCopyWorker pcw;
+	char	   *sharedquery;
+	char	   *queues;
+	shm_mq	   *mq;
+	List	   *options;
+	List	   *attnamelist;
+	Node	   *whereClause;
+	Relation	rel;
+	ParseState *pstate;
+	CopyState	cstate;
+	uint64		processed;
+
+	/* Set debug_query_string for individual workers first */
+	sharedquery = shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUERY_TEXT, false);
+	debug_query_string = sharedquery;
+
+	/* Report the query string from leader */
+	pgstat_report_activity(STATE_RUNNING, debug_query_string);
+
+	shared = (ParallelCopyShared *) shm_toc_lookup(toc,
+												   PARALLEL_COPY_KEY_SHARED,
+												   false);
+	options = (List *)
+		stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_OPTIONS, false));
+	attnamelist = (List *)
+		stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_ATTNAMELIST, false));
+	whereClause = (Node *)
+		stringToNode(shm_toc_lookup(toc, PARALLEL_COPY_KEY_WHERE_CLAUSE, false));
+
+	/* Attach to our queue */
+	queues = shm_toc_lookup(toc, PARALLEL_COPY_KEY_QUEUES, false);
+	mq = (shm_mq *) (queues + ParallelWorkerNumber * PARALLEL_COPY_QUEUE_SIZE);
+	if (shared->is_from)
+		shm_mq_set_receiver(mq, MyProc);
+	else
+		shm_mq_set_sender(mq, MyProc);
+	memset(&pcw, 0, sizeof(pcw));
+	pcw.mqh = shm_mq_attach(mq, seg, NULL);
+
+	if (!shared->is_from)
+	{
+		pcw.pscan = shm_toc_lookup(toc, PARALLEL_COPY_KEY_SCAN, false);
+		ParallelCopyToMain(shared, &pcw, attnamelist, options);
+		shm_mq_detach(pcw.mqh);
+		return;
+	}
+
+	/* The leader holds the same lock, and has checked our permissions */
+	rel = table_open(shared->relid, RowExclusiveLock);
+
+	pstate = make_parsestate(NULL);
+	(void) addRangeTableEntryForRelation(pstate, rel, RowExclusiveLock,
+										 NULL, false, false);
+
+	cstate = BeginCopyFrom(pstate, rel, NULL, false, ParallelCopyNoInput,
+						   attnamelist, options);
+	cstate->whereClause = whereClause;
+	cstate->header_line = false;	/* the leader has skipped it */
+	cstate->file_encoding = shared->file_encoding;
+	cstate->need_transcoding = shared->need_transcoding;
+	cstate->parallel_worker = &pcw;
+
+	processed = CopyFrom(cstate);
+	pg_atomic_fetch_add_u64(&shared->processed, processed);
+
+	EndCopyFrom(cstate);
+	free_parsestate(pstate);
+	shm_mq_detach(pcw.mqh);
+
+	table_close(rel, RowExclusiveLock);
+}
+
+/*
+ * Do the part of a parallel COPY TO that falls to a worker: scan our share of
+ * the table and send the formatted rows to the leader.
+ */
+static void
+ParallelCopyToMain(ParallelCopyShared *shared, ParallelCopyWorker *pcw,
+				   List *attnamelist, List *options)
+{
+	Relation	rel;
+	ParseState *pstate;
+	CopyState	cstate;
+
+	/* The leader holds the same lock, and has checked our permissions */
+	rel = table_open(shared->relid, AccessShareLock);
+
+	pstate = make_parsestate(NULL);
+	cstate = BeginCopy(pstate, false, rel, NULL, InvalidOid, attnamelist,
+					   options);
+	cstate->copy_dest = COPY_LEADER;
+	cstate->header_line = false;	/* the leader sends it */
+	cstate->file_encoding = shared->file_encoding;
+	cstate->need_transcoding = shared->need_transcoding;
+	cstate->parallel_worker = pcw;
+	initStringInfo(&pcw->rows);
+
+	(void) CopyTo(cstate);
+
+	if (pcw->rows.len > 0)
+		ParallelCopySendRows(pcw);
+
+	EndCopy(cstate);
+	free_parsestate(pstate);
+
+	table_close(rel, AccessShareLock);
+}
+
 /*
  * Setup to read tuples from a file for COPY FROM.
  *
@@ -3418,6 +4377,10 @@ BeginCopyFrom(ParseState *pstate,
 	cstate->cur_attname = NULL;
 	cstate->cur_attval = NULL;
 
+	/* Saved for parallel workers, which build a CopyState of their own */
+	cstate->attnamelist = attnamelist;
+	cstate->options = options;
+
 	/* Set up variables to avoid per-attribute overhead. */
 	initStringInfo(&cstate->attribute_buf);
 	initStringInfo(&cstate->line_buf);
@@ -3894,6 +4857,10 @@ CopyReadLine(CopyState cstate)
 {
 	bool		result;
 
+	/* A parallel worker gets its lines from the leader */
+	if (cstate->parallel_worker != NULL)
+		return ParallelCopyReadLine(cstate);
+
 	resetStringInfo(&cstate->line_buf);
 	cstate->line_buf_valid = true;
 
@@ -3952,7 +4919,66 @@ CopyReadLine(CopyState cstate)
 		}
 	}
 
-	/* Done reading the line.  Convert it to server encoding. */
+	/*
+	 * Done reading the line.  Convert it to server encoding, unless we're
+	 * the leader of a parallel COPY, which leaves that to the workers.
+	 */
+	if (!cstate->parallel_leader)
+		CopyConvertLineBuf(cstate);
+
+	return result;
+}
+
+/*
+ * Parallel worker's version of CopyReadLine: take the next line from the
+ * batches sent by the leader, and convert it to server encoding.
+ */
+static bool
+ParallelCopyReadLine(CopyState cstate)
+{
+	ParallelCopyWorker *pcw = cstate->parallel_worker;
+	int32		len;
+
+	resetStringInfo(&cstate->line_buf);
+	cstate->line_buf_valid = true;
+	cstate->line_buf_converted = false;
+
+	if (pcw->batch_pos >= pcw->batch_len)
+	{
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+
+		res = shm_mq_receive(pcw->mqh, &nbytes, &data, false);
+		if (res == SHM_MQ_DETACHED)
+			return true;		/* the leader has sent all the lines */
+		Assert(res == SHM_MQ_SUCCESS);
+
+		pcw->batch = (char *) data;
+		pcw->batch_len = nbytes;
+		memcpy(&pcw->next_lineno, pcw->batch, sizeof(uint64));
+		pcw->batch_pos = sizeof(uint64);
+	}
+
+	memcpy(&len, pcw->batch + pcw->batch_pos, sizeof(int32));
+	pcw->batch_pos += sizeof(int32);
+	appendBinaryStringInfo(&cstate->line_buf, pcw->batch + pcw->batch_pos, len);
+	pcw->batch_pos += len;
+
+	/* Report errors against the line's position in the whole input */
+	cstate->cur_lineno = pcw->next_lineno++;
+
+	CopyConvertLineBuf(cstate);
+
+	return false;
+}
+
+/*
+ * Convert the line in line_buf to server encoding.
+ */
+static void
+CopyConvertLineBuf(CopyState cstate)
+{
 	if (cstate->need_transcoding)
 	{
 		char	   *cvt;
@@ -3971,8 +4997,39 @@ CopyReadLine(CopyState cstate)
 
 	/* Now it's safe to use the buffer in error messages */
 	cstate->line_buf_converted = true;
+}
 
-	return result;
+/*
+ * Return the length of the longest prefix of buf[0 .. len) that can be taken
+ * as it is, because it contains none of the bytes c1 .. c5 (nor, if highbit,
+ * any byte with the high bit set), rounded down to a multiple of the vector
+ * size.  Callers pass a byte more than once if they have fewer to look for.
+ *
+ * The scanning loops below use this to skip over data that needs no special
+ * treatment, and fall back to looking at each byte where that fails.  To
+ * keep it from costing more than it saves on short fields, they only retry
+ * a whole vector after each failure.
+ */
+static inline int
+CopyScanPlain(const char *buf, int len, char c1, char c2, char c3, char c4,
+			  char c5, bool highbit)
+{
+	int			skip = 0;
+
+	while (len - skip >= (int) sizeof(Vector8))
+	{
+		Vector8		chunk;
+
+		vector8_load(&chunk, (const uint8 *) buf + skip);
+		if (vector8_has(chunk, c1) || vector8_has(chunk, c2) ||
+			vector8_has(chunk, c3) || vector8_has(chunk, c4) ||
+			vector8_has(chunk, c5) ||
+			(highbit && vector8_is_highbit_set(chunk)))
+			break;
+		skip += sizeof(Vector8);
+	}
+
+	return skip;
 }
 
 /*
@@ -3988,6 +5045,7 @@ CopyReadLineText(CopyState cstate)
 	bool		hit_eof = false;
 	bool		result = false;
 	char		mblen_str[2];
+	int			next_scan = 0;
 
 	/* CSV variables */
 	bool		first_char_in_line = true;
@@ -3996,6 +5054,10 @@ CopyReadLineText(CopyState cstate)
 	char		quotec = '\0';
 	char		escapec = '\0';
 
+	/* bytes CopyScanPlain must stop at; the repeats are just fillers */
+	char		scan_quotec = '\n';
+	char		scan_escapec = '\n';
+
 	if (cstate->csv_mode)
 	{
 		quotec = cstate->quote[0];
@@ -4003,6 +5065,9 @@ CopyReadLineText(CopyState cstate)
 		/* ignore special escape processing if it's the same as quotec */
 		if (quotec == escapec)
 			escapec = '\0';
+		scan_quotec = scan_escapec = quotec;
+		if (escapec != '\0')
+			scan_escapec = escapec;
 	}
 
 	mblen_str[1] = '\0';
@@ -4058,6 +5123,7 @@ CopyReadLineText(CopyState cstate)
 			if (!CopyLoadRawBuf(cstate))
 				hit_eof = true;
 			raw_buf_ptr = 0;
+			next_scan = 0;
 			copy_buf_len = cstate->raw_buf_len;
 
 			/*
@@ -4072,6 +5138,28 @@ CopyReadLineText(CopyState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip over bytes that can't end the line or change the CSV state,
+		 * leaving at least one to be fetched below.  Multibyte characters
+		 * must be looked at one by one if they can embed ASCII bytes.
+		 */
+		if (raw_buf_ptr >= next_scan)
+		{
+			int			skip;
+
+			skip = CopyScanPlain(copy_raw_buf + raw_buf_ptr,
+								 copy_buf_len - raw_buf_ptr - 1,
+								 '\n', '\r', '\\', scan_quotec, scan_escapec,
+								 cstate->encoding_embeds_ascii);
+			if (skip > 0)
+			{
+				raw_buf_ptr += skip;
+				first_char_in_line = false;
+				last_was_esc = false;
+			}
+			next_scan = raw_buf_ptr + sizeof(Vector8);
+		}
+
 		/* OK to fetch a character */
 		prev_raw_ptr = raw_buf_ptr;
 		c = copy_raw_buf[raw_buf_ptr++];
@@ -4378,6 +5466,7 @@ CopyReadAttributesText(CopyState cstate)
 	char	   *output_ptr;
 	char	   *cur_ptr;
 	char	   *line_end_ptr;
+	char	   *next_scan;
 
 	/*
 	 * We need a special case for zero-column tables: check that the input
@@ -4408,6 +5497,7 @@ CopyReadAttributesText(CopyState cstate)
 	/* set pointer variables for loop */
 	cur_ptr = cstate->line_buf.data;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
+	next_scan = cur_ptr;
 
 	/* Outer loop iterates over fields */
 	fieldno = 0;
@@ -4446,6 +5536,19 @@ CopyReadAttributesText(CopyState cstate)
 		{
 			char		c;
 
+			/* copy over whatever needs no de-escaping in one go */
+			if (cur_ptr >= next_scan)
+			{
+				int			skip;
+
+				skip = CopyScanPlain(cur_ptr, line_end_ptr - cur_ptr,
+									 delimc, '\\', '\\', '\\', '\\', false);
+				memcpy(output_ptr, cur_ptr, skip);
+				output_ptr += skip;
+				cur_ptr += skip;
+				next_scan = cur_ptr + sizeof(Vector8);
+			}
+
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
 				break;
@@ -4608,6 +5711,7 @@ CopyReadAttributesCSV(CopyState cstate)
 	char	   *output_ptr;
 	char	   *cur_ptr;
 	char	   *line_end_ptr;
+	char	   *next_scan;
 
 	/*
 	 * We need a special case for zero-column tables: check that the input
@@ -4638,6 +5742,7 @@ CopyReadAttributesCSV(CopyState cstate)
 	/* set pointer variables for loop */
 	cur_ptr = cstate->line_buf.data;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
+	next_scan = cur_ptr;
 
 	/* Outer loop iterates over fields */
 	fieldno = 0;
@@ -4675,6 +5780,20 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* Not in quote */
 			for (;;)
 			{
+				/* copy over plain data in one go, as in the text case */
+				if (cur_ptr >= next_scan)
+				{
+					int			skip;
+
+					skip = CopyScanPlain(cur_ptr, line_end_ptr - cur_ptr,
+										 delimc, quotec, quotec, quotec, quotec,
+										 false);
+					memcpy(output_ptr, cur_ptr, skip);
+					output_ptr += skip;
+					cur_ptr += skip;
+					next_scan = cur_ptr + sizeof(Vector8);
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -4698,6 +5817,19 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* In quote */
 			for (;;)
 			{
+				if (cur_ptr >= next_scan)
+				{
+					int			skip;
+
+					skip = CopyScanPlain(cur_ptr, line_end_ptr - cur_ptr,
+										 quotec, escapec, escapec, escapec,
+										 escapec, false);
+					memcpy(output_ptr, cur_ptr, skip);
+					output_ptr += skip;
+					cur_ptr += skip;
+					next_scan = cur_ptr + sizeof(Vector8);
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -280,6 +280,22 @@ ExecCreateTableAs(CreateTableAsStmt *stmt, const char *queryString,
 	}
 	Assert(query->commandType == CMD_SELECT);
 
+	/*
+	 * An incrementally maintained materialized view stores hidden columns
+	 * next to the ones the query asks for.  Add them to a copy of the query
+	 * to execute, so that a cached statement is not scribbled on.  The view
+	 * query can be changed in place, since AddIvmHiddenColumns replaces any
+	 * hidden columns it finds there.
+	 */
+	if (stmt->incremental)
+	{
+		Assert(is_matview);
+		CheckIvmQuery(query);
+		query = copyObject(query);
+		AddIvmHiddenColumns(query);
+		AddIvmHiddenColumns((Query *) into->viewQuery);
+	}
+
 	/*
 	 * For materialized views, lock down security-restricted operations and
 	 * arrange to make GUC variable changes local to this command.  This is
@@ -380,6 +396,9 @@ ExecCreateTableAs(CreateTableAsStmt *stmt, const char *queryString,
 		SetUserIdAndSecContext(save_userid, save_sec_context);
 	}
 
+	if (stmt->incremental)
+		CreateIvmTriggers(address.objectId, (Query *) into->viewQuery);
+
 	return address;
 }
 
@@ -61,6 +61,7 @@
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/pg_locale.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -946,6 +947,12 @@ dropdb(const char *dbname, bool missing_ok)
 	 */
 	pgstat_drop_database(db_id);
 
+	/*
+	 * Nor should any plans made in it be left in the shared plan cache,
+	 * where a database later created with the same OID could find them.
+	 */
+	SharedPlanCacheReset(db_id);
+
 	/*
 	 * Tell checkpointer to forget any pending fsync and unlink requests for
 	 * files in the database; else the fsyncs will fail at next checkpoint, or
@@ -608,6 +608,16 @@ DefineIndex(Oid relationId,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("cannot create indexes on temporary tables of other sessions")));
 
+	/*
+	 * Other sessions build their copies of a new global temp index when they
+	 * first open it, which a concurrent build can't coordinate with.
+	 */
+	if (stmt->concurrent && RelationIsGlobalTemp(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot create index on global temporary table \"%s\" concurrently",
+						RelationGetRelationName(rel))));
+
 	/*
 	 * Unless our caller vouches for having checked this already, insist that
 	 * the table not be in use by our own session, either.  Otherwise we might
@@ -737,7 +747,7 @@ DefineIndex(Oid relationId,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("access method \"%s\" does not support included columns",
 						accessMethodName)));
-	if (numberOfAttributes > 1 && !amRoutine->amcanmulticol)
+	if (numberOfKeyAttributes > 1 && !amRoutine->amcanmulticol)
 		ereport(ERROR,
 				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 				 errmsg("access method \"%s\" does not support multicolumn indexes",
@@ -2601,6 +2611,13 @@ ReindexMultipleTables(const char *objectName, ReindexObjectType objectKind,
 			!pg_class_ownercheck(relid, GetUserId()))
 			continue;
 
+		/*
+		 * Skip global temp tables; there is only this session's copy to
+		 * rebuild, and it is built afresh when first used anyway.
+		 */
+		if (classtuple->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+			continue;
+
 		/*
 		 * Skip system tables, since index_create() would reject indexing them
 		 * concurrently (and it would likely fail if we tried).
@@ -2738,6 +2755,15 @@ ReindexRelationConcurrently(Oid relationOid, int options)
 
 	relkind = get_rel_relkind(relationOid);
 
+	/*
+	 * Swapping in new indexes would give them new relfilenodes, stranding
+	 * other sessions' copies of a global temp index.
+	 */
+	if (get_rel_persistence(relationOid) == RELPERSISTENCE_GLOBAL_TEMP)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot reindex global temporary tables concurrently")));
+
 	/*
 	 * Extract the list of indexes that are going to be rebuilt based on the
 	 * list of relation Oids given by caller.
@@ -22,29 +22,46 @@
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
+#include "catalog/dependency.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_inherits.h"
+#include "catalog/pg_namespace.h"
 #include "catalog/pg_opclass.h"
 #include "catalog/pg_operator.h"
+#include "catalog/pg_trigger.h"
+#include "catalog/pg_type.h"
 #include "commands/cluster.h"
 #include "commands/matview.h"
 #include "commands/tablecmds.h"
 #include "commands/tablespace.h"
+#include "commands/trigger.h"
 #include "executor/executor.h"
 #include "executor/spi.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/tlist.h"
 #include "parser/parse_relation.h"
+#include "parser/parser.h"
+#include "parser/parsetree.h"
 #include "pgstat.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/lmgr.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"
+#include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
+#include "utils/regproc.h"
 #include "utils/rel.h"
+#include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 
 
 typedef struct
@@ -58,6 +75,34 @@ typedef struct
 	BulkInsertState bistate;	/* bulk insert state */
 } DR_transientrel;
 
+/*
+ * Per-column information used to build the queries that maintain an
+ * incrementally maintained materialized view.
+ */
+typedef struct IvmColumn
+{
+	char	   *name;			/* column name in the materialized view */
+	char		kind;			/* IVM_COLUMN_xxx, see below */
+	Oid			type;			/* column data type */
+	Oid			eqop;			/* equality operator, for key columns */
+	char	   *countname;		/* for sums, name of the hidden count column */
+} IvmColumn;
+
+#define IVM_COLUMN_KEY		'k'	/* GROUP BY column, or any column of a
+								 * view without aggregates */
+#define IVM_COLUMN_COUNT	'c'	/* count(*) or count(expr) */
+#define IVM_COLUMN_SUM		's'	/* sum(expr) */
+
+/* Names of hidden columns, and of the transition tables of IVM triggers */
+#define IVM_HIDDEN_PREFIX	"__ivm_"
+#define IVM_COUNT_COLNAME	"__ivm_count__"
+#define IVM_OLDTABLE_NAME	"__ivm_oldtable__"
+#define IVM_NEWTABLE_NAME	"__ivm_newtable__"
+
+/* OIDs of count(*) and count("any") */
+#define COUNT_STAR_AGG_OID	2803
+#define COUNT_ANY_AGG_OID	2147
+
 static int	matview_maintenance_depth = 0;
 
 static void transientrel_startup(DestReceiver *self, int operation, TupleDesc typeinfo);
@@ -71,8 +116,26 @@ static void refresh_by_match_merge(Oid matviewOid, Oid tempOid, Oid relowner,
 								   int save_sec_context);
 static void refresh_by_heap_swap(Oid matviewOid, Oid OIDNewHeap, char relpersistence);
 static bool is_usable_unique_index(Relation indexRel);
+static Query *get_matview_query(Relation matviewRel);
 static void OpenMatViewIncrementalMaintenance(void);
 static void CloseMatViewIncrementalMaintenance(void);
+static void ivm_unsupported(const char *what);
+static char ivm_aggregate_kind(Aggref *aggref);
+static bool is_ivm_hidden_column(TargetEntry *tle);
+static Expr *make_ivm_count(Expr *arg);
+static void create_ivm_trigger(Oid relOid, Oid matviewOid, int16 event);
+static IvmColumn *get_ivm_columns(Relation matviewRel, Query *query,
+								  char **countname);
+static char *ivm_delta_query(Relation matviewRel, Query *query,
+							 Oid changedRelid, const char *enrname);
+static void ivm_walk_jointree(Node *jtnode, List **rtindexes, List **quals);
+static void ivm_append_key_match(StringInfo buf, IvmColumn *columns,
+								 int ncolumns);
+static void ivm_apply_delta(Relation matviewRel, Query *query,
+							Oid changedRelid, const char *enrname,
+							bool is_insert);
+static void ivm_apply_truncate(Relation matviewRel, Query *query);
+static void ivm_execute(const char *sql, int expected);
 
 /*
  * SetMatViewPopulatedState
@@ -114,6 +177,44 @@ SetMatViewPopulatedState(Relation relation, bool newstate)
 	CommandCounterIncrement();
 }
 
+/*
+ * get_matview_query
+ *		Return the query stored in a materialized view's SELECT rule.
+ *
+ * Problems at this point are internal errors, so elog is sufficient.
+ */
+static Query *
+get_matview_query(Relation matviewRel)
+{
+	RewriteRule *rule;
+	List	   *actions;
+
+	if (matviewRel->rd_rel->relhasrules == false ||
+		matviewRel->rd_rules->numLocks < 1)
+		elog(ERROR,
+			 "materialized view \"%s\" is missing rewrite information",
+			 RelationGetRelationName(matviewRel));
+
+	if (matviewRel->rd_rules->numLocks > 1)
+		elog(ERROR,
+			 "materialized view \"%s\" has too many rules",
+			 RelationGetRelationName(matviewRel));
+
+	rule = matviewRel->rd_rules->rules[0];
+	if (rule->event != CMD_SELECT || !(rule->isInstead))
+		elog(ERROR,
+			 "the rule for materialized view \"%s\" is not a SELECT INSTEAD OF rule",
+			 RelationGetRelationName(matviewRel));
+
+	actions = rule->actions;
+	if (list_length(actions) != 1)
+		elog(ERROR,
+			 "the rule for materialized view \"%s\" is not a single action",
+			 RelationGetRelationName(matviewRel));
+
+	return linitial_node(Query, actions);
+}
+
 /*
  * ExecRefreshMatView -- execute a REFRESH MATERIALIZED VIEW command
  *
@@ -140,8 +241,6 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 {
 	Oid			matviewOid;
 	Relation	matviewRel;
-	RewriteRule *rule;
-	List	   *actions;
 	Query	   *dataQuery;
 	Oid			tableSpace;
 	Oid			relowner;
@@ -188,31 +287,11 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 				 errmsg("CONCURRENTLY and WITH NO DATA options cannot be used together")));
 
 	/*
-	 * Check that everything is correct for a refresh. Problems at this point
-	 * are internal errors, so elog is sufficient.
+	 * Check that everything is correct for a refresh.  The stored query was
+	 * rewritten at the time of the MV definition, but has not been scribbled
+	 * on by the planner.
 	 */
-	if (matviewRel->rd_rel->relhasrules == false ||
-		matviewRel->rd_rules->numLocks < 1)
-		elog(ERROR,
-			 "materialized view \"%s\" is missing rewrite information",
-			 RelationGetRelationName(matviewRel));
-
-	if (matviewRel->rd_rules->numLocks > 1)
-		elog(ERROR,
-			 "materialized view \"%s\" has too many rules",
-			 RelationGetRelationName(matviewRel));
-
-	rule = matviewRel->rd_rules->rules[0];
-	if (rule->event != CMD_SELECT || !(rule->isInstead))
-		elog(ERROR,
-			 "the rule for materialized view \"%s\" is not a SELECT INSTEAD OF rule",
-			 RelationGetRelationName(matviewRel));
-
-	actions = rule->actions;
-	if (list_length(actions) != 1)
-		elog(ERROR,
-			 "the rule for materialized view \"%s\" is not a single action",
-			 RelationGetRelationName(matviewRel));
+	dataQuery = get_matview_query(matviewRel);
 
 	/*
 	 * Check that there is a unique index with no WHERE clause on one or more
@@ -247,12 +326,6 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 					 errhint("Create a unique index with no WHERE clause on one or more columns of the materialized view.")));
 	}
 
-	/*
-	 * The stored query was rewritten at the time of the MV definition, but
-	 * has not been scribbled on by the planner.
-	 */
-	dataQuery = linitial_node(Query, actions);
-
 	/*
 	 * Check for active uses of the relation in the current transaction, such
 	 * as open scans.
@@ -926,3 +999,890 @@ CloseMatViewIncrementalMaintenance(void)
 	matview_maintenance_depth--;
 	Assert(matview_maintenance_depth >= 0);
 }
+
+
+/*
+ * Incremental maintenance
+ *
+ * A materialized view created with CREATE INCREMENTAL MATERIALIZED VIEW is
+ * kept up to date by AFTER ... FOR EACH STATEMENT triggers on its base
+ * tables.  The triggers compute the change to the view's contents from the
+ * statement's transition tables, joined with the current contents of the
+ * other base tables, and apply it to the materialized view with ordinary
+ * DML.  The work done is thus proportional to the size of the change rather
+ * than to the size of the view.
+ *
+ * The view query must be an inner join of plain tables, optionally grouped,
+ * whose aggregates are count() and sum().  Aggregate views get hidden count
+ * columns: one count(*), to know when a group becomes empty, and a count of
+ * the non-null inputs of each sum, to know when the sum goes back to NULL.
+ */
+
+static void
+ivm_unsupported(const char *what)
+{
+	ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("incrementally maintained materialized views do not support %s",
+					what)));
+}
+
+/*
+ * Return IVM_COLUMN_COUNT or IVM_COLUMN_SUM for the aggregates that can be
+ * maintained incrementally, or '\0' for anything else.
+ */
+static char
+ivm_aggregate_kind(Aggref *aggref)
+{
+	if (aggref->aggfnoid == COUNT_STAR_AGG_OID ||
+		aggref->aggfnoid == COUNT_ANY_AGG_OID)
+		return IVM_COLUMN_COUNT;
+
+	if (get_func_namespace(aggref->aggfnoid) == PG_CATALOG_NAMESPACE &&
+		strcmp(get_func_name(aggref->aggfnoid), "sum") == 0)
+		return IVM_COLUMN_SUM;
+
+	return '\0';
+}
+
+/*
+ * Is this one of the count columns added by AddIvmHiddenColumns?
+ */
+static bool
+is_ivm_hidden_column(TargetEntry *tle)
+{
+	return tle->resname != NULL &&
+		strncmp(tle->resname, IVM_HIDDEN_PREFIX, strlen(IVM_HIDDEN_PREFIX)) == 0 &&
+		IsA(tle->expr, Aggref) &&
+		ivm_aggregate_kind((Aggref *) tle->expr) == IVM_COLUMN_COUNT;
+}
+
+/*
+ * CheckIvmQuery
+ *		Verify that a materialized view query can be maintained incrementally.
+ */
+void
+CheckIvmQuery(Query *query)
+{
+	List	   *relids = NIL;
+	ListCell   *lc;
+
+	Assert(query->commandType == CMD_SELECT);
+
+	if (query->cteList != NIL)
+		ivm_unsupported("WITH");
+	if (query->setOperations != NULL)
+		ivm_unsupported("UNION/INTERSECT/EXCEPT");
+	if (query->distinctClause != NIL)
+		ivm_unsupported("DISTINCT");
+	if (query->hasWindowFuncs)
+		ivm_unsupported("window functions");
+	if (query->hasSubLinks)
+		ivm_unsupported("subqueries");
+	if (query->hasTargetSRFs)
+		ivm_unsupported("set-returning functions");
+	if (query->groupingSets != NIL)
+		ivm_unsupported("GROUPING SETS");
+	if (query->havingQual != NULL)
+		ivm_unsupported("HAVING");
+	if (query->sortClause != NIL)
+		ivm_unsupported("ORDER BY");
+	if (query->limitCount != NULL || query->limitOffset != NULL)
+		ivm_unsupported("LIMIT/OFFSET");
+	if (query->rowMarks != NIL)
+		ivm_unsupported("FOR UPDATE/SHARE");
+	if (query->groupClause != NIL && !query->hasAggs)
+		ivm_unsupported("GROUP BY without aggregates");
+	if (contain_mutable_functions((Node *) query))
+		ivm_unsupported("mutable functions");
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		AclResult	aclresult;
+
+		switch (rte->rtekind)
+		{
+			case RTE_RELATION:
+				if (rte->relkind != RELKIND_RELATION)
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("incrementally maintained materialized views can only reference plain tables"),
+							 errdetail("\"%s\" is not a table.",
+									   get_rel_name(rte->relid))));
+				if (rte->tablesample != NULL)
+					ivm_unsupported("TABLESAMPLE");
+				if (rte->inh && has_subclass(rte->relid))
+					ivm_unsupported("inheritance");
+				if (list_member_oid(relids, rte->relid))
+					ivm_unsupported("self-join");
+				relids = lappend_oid(relids, rte->relid);
+
+				/* The maintenance triggers are as good as user triggers */
+				aclresult = pg_class_aclcheck(rte->relid, GetUserId(),
+											  ACL_TRIGGER);
+				if (aclresult != ACLCHECK_OK)
+					aclcheck_error(aclresult, OBJECT_TABLE,
+								   get_rel_name(rte->relid));
+				break;
+			case RTE_JOIN:
+				if (rte->jointype != JOIN_INNER)
+					ivm_unsupported("outer join");
+				break;
+			default:
+				ivm_unsupported("FROM items other than tables");
+				break;
+		}
+	}
+
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		if (tle->resname != NULL && !is_ivm_hidden_column(tle) &&
+			strncmp(tle->resname, IVM_HIDDEN_PREFIX, strlen(IVM_HIDDEN_PREFIX)) == 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_RESERVED_NAME),
+					 errmsg("column name \"%s\" is reserved for incremental maintenance",
+							tle->resname)));
+
+		if (query->hasAggs)
+		{
+			if (tle->resjunk)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("GROUP BY expressions of an incrementally maintained materialized view must appear in its select list")));
+
+			if (IsA(tle->expr, Aggref))
+			{
+				Aggref	   *aggref = (Aggref *) tle->expr;
+
+				if (ivm_aggregate_kind(aggref) == '\0')
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("aggregate function %s is not supported in incrementally maintained materialized views",
+									format_procedure(aggref->aggfnoid)),
+							 errhint("Only count() and sum() can be maintained incrementally.")));
+				if (aggref->aggdistinct != NIL)
+					ivm_unsupported("aggregate with DISTINCT");
+				if (aggref->aggorder != NIL)
+					ivm_unsupported("aggregate with ORDER BY");
+				if (aggref->aggfilter != NULL)
+					ivm_unsupported("aggregate with FILTER");
+			}
+			else if (tle->ressortgroupref == 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("column \"%s\" of an incrementally maintained materialized view must be a GROUP BY expression or an aggregate",
+								tle->resname)));
+		}
+		else
+		{
+			Oid			type = exprType((Node *) tle->expr);
+			TypeCacheEntry *typentry;
+
+			/* Deleting rows from the view requires comparing them */
+			typentry = lookup_type_cache(type, TYPECACHE_EQ_OPR);
+			if (!OidIsValid(typentry->eq_opr))
+				ereport(ERROR,
+						(errcode(ERRCODE_UNDEFINED_FUNCTION),
+						 errmsg("could not identify an equality operator for type %s",
+								format_type_be(type)),
+						 errdetail("Columns of an incrementally maintained materialized view without aggregates must be comparable.")));
+		}
+	}
+}
+
+/*
+ * Build count(arg), or count(*) if arg is NULL.
+ */
+static Expr *
+make_ivm_count(Expr *arg)
+{
+	Aggref	   *aggref = makeNode(Aggref);
+
+	aggref->aggfnoid = arg ? COUNT_ANY_AGG_OID : COUNT_STAR_AGG_OID;
+	aggref->aggtype = INT8OID;
+	aggref->aggcollid = InvalidOid;
+	aggref->inputcollid = arg ? exprCollation((Node *) arg) : InvalidOid;
+	aggref->aggtranstype = InvalidOid;	/* filled by planner */
+	aggref->aggargtypes = arg ? list_make1_oid(exprType((Node *) arg)) : NIL;
+	aggref->aggdirectargs = NIL;
+	aggref->args = arg ? list_make1(makeTargetEntry(copyObject(arg), 1,
+													NULL, false)) : NIL;
+	aggref->aggorder = NIL;
+	aggref->aggdistinct = NIL;
+	aggref->aggfilter = NULL;
+	aggref->aggstar = (arg == NULL);
+	aggref->aggvariadic = false;
+	aggref->aggkind = AGGKIND_NORMAL;
+	aggref->agglevelsup = 0;
+	aggref->aggsplit = AGGSPLIT_SIMPLE;
+	aggref->location = -1;
+
+	return (Expr *) aggref;
+}
+
+/*
+ * AddIvmHiddenColumns
+ *		Append the hidden count columns to an aggregate view's target list.
+ *
+ * A definition that already carries them, as one read back by pg_dump does,
+ * has them replaced rather than duplicated.
+ */
+void
+AddIvmHiddenColumns(Query *query)
+{
+	List	   *tlist = query->targetList;
+	int			natts;
+	int			i;
+
+	if (!query->hasAggs)
+		return;
+
+	while (tlist != NIL && is_ivm_hidden_column((TargetEntry *) llast(tlist)))
+		tlist = list_truncate(tlist, list_length(tlist) - 1);
+
+	natts = list_length(tlist);
+	for (i = 0; i < natts; i++)
+	{
+		TargetEntry *tle = (TargetEntry *) list_nth(tlist, i);
+		TargetEntry *arg;
+
+		if (!IsA(tle->expr, Aggref) ||
+			ivm_aggregate_kind((Aggref *) tle->expr) != IVM_COLUMN_SUM)
+			continue;
+
+		arg = linitial_node(TargetEntry, ((Aggref *) tle->expr)->args);
+		tlist = lappend(tlist,
+						makeTargetEntry(make_ivm_count(arg->expr),
+										list_length(tlist) + 1,
+										psprintf(IVM_HIDDEN_PREFIX "count_%d__",
+												 tle->resno),
+										false));
+	}
+
+	tlist = lappend(tlist,
+					makeTargetEntry(make_ivm_count(NULL),
+									list_length(tlist) + 1,
+									pstrdup(IVM_COUNT_COLNAME),
+									false));
+
+	query->targetList = tlist;
+}
+
+/*
+ * CreateIvmTriggers
+ *		Create the triggers maintaining a materialized view on its base tables.
+ */
+void
+CreateIvmTriggers(Oid matviewOid, Query *query)
+{
+	List	   *rtindexes = NIL;
+	List	   *quals = NIL;
+	ListCell   *lc;
+
+	ivm_walk_jointree((Node *) query->jointree, &rtindexes, &quals);
+	foreach(lc, rtindexes)
+	{
+		RangeTblEntry *rte = rt_fetch(lfirst_int(lc), query->rtable);
+
+		create_ivm_trigger(rte->relid, matviewOid, TRIGGER_TYPE_INSERT);
+		create_ivm_trigger(rte->relid, matviewOid, TRIGGER_TYPE_DELETE);
+		create_ivm_trigger(rte->relid, matviewOid, TRIGGER_TYPE_UPDATE);
+		create_ivm_trigger(rte->relid, matviewOid, TRIGGER_TYPE_TRUNCATE);
+	}
+
+	/* Make the new triggers visible */
+	CommandCounterIncrement();
+}
+
+static void
+create_ivm_trigger(Oid relOid, Oid matviewOid, int16 event)
+{
+	CreateTrigStmt *stmt = makeNode(CreateTrigStmt);
+	ObjectAddress trigaddr;
+	ObjectAddress mvaddr;
+
+	if (event & (TRIGGER_TYPE_DELETE | TRIGGER_TYPE_UPDATE))
+	{
+		TriggerTransition *tt = makeNode(TriggerTransition);
+
+		tt->name = IVM_OLDTABLE_NAME;
+		tt->isNew = false;
+		tt->isTable = true;
+		stmt->transitionRels = lappend(stmt->transitionRels, tt);
+	}
+	if (event & (TRIGGER_TYPE_INSERT | TRIGGER_TYPE_UPDATE))
+	{
+		TriggerTransition *tt = makeNode(TriggerTransition);
+
+		tt->name = IVM_NEWTABLE_NAME;
+		tt->isNew = true;
+		tt->isTable = true;
+		stmt->transitionRels = lappend(stmt->transitionRels, tt);
+	}
+
+	/* CreateTrigger appends the trigger OID to the name of internal ones */
+	stmt->trigname = "IVM_trigger";
+	stmt->relation = NULL;
+	stmt->funcname = SystemFuncName("ivm_immediate_maintenance");
+	stmt->args = list_make1(makeString(psprintf("%u", matviewOid)));
+	stmt->row = false;
+	stmt->timing = TRIGGER_TYPE_AFTER;
+	stmt->events = event;
+	stmt->columns = NIL;
+	stmt->whenClause = NULL;
+	stmt->isconstraint = false;
+	stmt->deferrable = false;
+	stmt->initdeferred = false;
+	stmt->constrrel = NULL;
+
+	trigaddr = CreateTrigger(stmt, NULL, relOid, InvalidOid, InvalidOid,
+							 InvalidOid, InvalidOid, InvalidOid, NULL,
+							 true, false);
+
+	/* Drop the trigger along with the materialized view */
+	ObjectAddressSet(mvaddr, RelationRelationId, matviewOid);
+	recordDependencyOn(&trigaddr, &mvaddr, DEPENDENCY_AUTO);
+}
+
+/*
+ * Describe the columns of an incrementally maintained materialized view.
+ * The name of its hidden count(*) column, if any, is returned in *countname.
+ */
+static IvmColumn *
+get_ivm_columns(Relation matviewRel, Query *query, char **countname)
+{
+	TupleDesc	tupdesc = RelationGetDescr(matviewRel);
+	IvmColumn  *columns;
+	ListCell   *lc;
+
+	columns = (IvmColumn *) palloc0(sizeof(IvmColumn) * tupdesc->natts);
+	*countname = NULL;
+
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		IvmColumn  *col;
+
+		if (tle->resjunk || tle->resno > tupdesc->natts)
+			elog(ERROR, "unexpected target list of materialized view \"%s\"",
+				 RelationGetRelationName(matviewRel));
+
+		col = &columns[tle->resno - 1];
+		col->name = NameStr(TupleDescAttr(tupdesc, tle->resno - 1)->attname);
+		col->type = exprType((Node *) tle->expr);
+
+		if (IsA(tle->expr, Aggref))
+			col->kind = ivm_aggregate_kind((Aggref *) tle->expr);
+		else
+		{
+			col->kind = IVM_COLUMN_KEY;
+			if (tle->ressortgroupref != 0)
+				col->eqop = get_sortgroupref_clause(tle->ressortgroupref,
+													query->groupClause)->eqop;
+			else
+				col->eqop = lookup_type_cache(col->type,
+											  TYPECACHE_EQ_OPR)->eq_opr;
+		}
+
+		if (tle->resname != NULL && strcmp(tle->resname, IVM_COUNT_COLNAME) == 0)
+			*countname = col->name;
+	}
+
+	/* Pair each sum with the hidden count of its non-null inputs */
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		char	   *hidden;
+		ListCell   *lc2;
+
+		if (columns[tle->resno - 1].kind != IVM_COLUMN_SUM)
+			continue;
+
+		hidden = psprintf(IVM_HIDDEN_PREFIX "count_%d__", tle->resno);
+		foreach(lc2, query->targetList)
+		{
+			TargetEntry *tle2 = lfirst_node(TargetEntry, lc2);
+
+			if (tle2->resname != NULL && strcmp(tle2->resname, hidden) == 0)
+				columns[tle->resno - 1].countname = columns[tle2->resno - 1].name;
+		}
+		if (columns[tle->resno - 1].countname == NULL)
+			elog(ERROR, "could not find column \"%s\" in materialized view \"%s\"",
+				 hidden, RelationGetRelationName(matviewRel));
+	}
+
+	if (query->hasAggs && *countname == NULL)
+		elog(ERROR, "could not find column \"%s\" in materialized view \"%s\"",
+			 IVM_COUNT_COLNAME, RelationGetRelationName(matviewRel));
+
+	return columns;
+}
+
+/*
+ * Collect the range table indexes of the base tables in a join tree, and its
+ * join conditions.  A stored view query has extra range table entries for
+ * the view itself, so the range table cannot be used directly.
+ */
+static void
+ivm_walk_jointree(Node *jtnode, List **rtindexes, List **quals)
+{
+	if (jtnode == NULL)
+		return;
+
+	if (IsA(jtnode, RangeTblRef))
+		*rtindexes = lappend_int(*rtindexes, ((RangeTblRef *) jtnode)->rtindex);
+	else if (IsA(jtnode, FromExpr))
+	{
+		FromExpr   *f = (FromExpr *) jtnode;
+		ListCell   *lc;
+
+		foreach(lc, f->fromlist)
+			ivm_walk_jointree(lfirst(lc), rtindexes, quals);
+		if (f->quals != NULL)
+			*quals = lappend(*quals, f->quals);
+	}
+	else if (IsA(jtnode, JoinExpr))
+	{
+		JoinExpr   *j = (JoinExpr *) jtnode;
+
+		ivm_walk_jointree(j->larg, rtindexes, quals);
+		ivm_walk_jointree(j->rarg, rtindexes, quals);
+		if (j->quals != NULL)
+			*quals = lappend(*quals, j->quals);
+	}
+	else
+		elog(ERROR, "unrecognized node type: %d", (int) nodeTag(jtnode));
+}
+
+/*
+ * Build the view query with one base table replaced by a transition table.
+ *
+ * The result has the materialized view's columns, in order and under their
+ * current names.  Since only inner joins are allowed, all join conditions
+ * can go in a single WHERE clause.
+ */
+static char *
+ivm_delta_query(Relation matviewRel, Query *query, Oid changedRelid,
+				const char *enrname)
+{
+	StringInfoData buf;
+	List	   *rtable_names = NIL;
+	List	   *context;
+	List	   *rtindexes = NIL;
+	List	   *quals = NIL;
+	ListCell   *lc;
+	int			rti;
+	bool		first;
+
+	for (rti = 1; rti <= list_length(query->rtable); rti++)
+		rtable_names = lappend(rtable_names, psprintf("t%d", rti));
+	context = deparse_context_for_plan_rtable(query->rtable, rtable_names);
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, "SELECT ");
+	first = true;
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		Node	   *expr;
+
+		expr = flatten_join_alias_vars(query, (Node *) tle->expr);
+		appendStringInfo(&buf, "%s%s AS %s",
+						 first ? "" : ", ",
+						 deparse_expression(expr, context, true, false),
+						 quote_identifier(NameStr(TupleDescAttr(RelationGetDescr(matviewRel),
+																tle->resno - 1)->attname)));
+		first = false;
+	}
+
+	ivm_walk_jointree((Node *) query->jointree, &rtindexes, &quals);
+
+	appendStringInfoString(&buf, " FROM ");
+	first = true;
+	foreach(lc, rtindexes)
+	{
+		RangeTblEntry *rte;
+
+		rti = lfirst_int(lc);
+		rte = rt_fetch(rti, query->rtable);
+
+		if (!first)
+			appendStringInfoString(&buf, ", ");
+		first = false;
+
+		if (rte->relid == changedRelid)
+			appendStringInfo(&buf, "%s t%d", quote_identifier(enrname), rti);
+		else
+			appendStringInfo(&buf, "%s%s t%d",
+							 rte->inh ? "" : "ONLY ",
+							 quote_qualified_identifier(get_namespace_name(get_rel_namespace(rte->relid)),
+														get_rel_name(rte->relid)),
+							 rti);
+	}
+
+	first = true;
+	foreach(lc, quals)
+	{
+		Node	   *qual = flatten_join_alias_vars(query, (Node *) lfirst(lc));
+
+		appendStringInfo(&buf, "%s(%s)",
+						 first ? " WHERE " : " AND ",
+						 deparse_expression(qual, context, true, false));
+		first = false;
+	}
+
+	first = true;
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		if (tle->ressortgroupref == 0)
+			continue;
+		appendStringInfo(&buf, "%s%d", first ? " GROUP BY " : ", ", tle->resno);
+		first = false;
+	}
+
+	return buf.data;
+}
+
+/*
+ * Append a condition matching rows of "mv" and "d" on all key columns, with
+ * nulls matching each other as they do in GROUP BY.
+ */
+static void
+ivm_append_key_match(StringInfo buf, IvmColumn *columns, int ncolumns)
+{
+	bool		first = true;
+	int			i;
+
+	for (i = 0; i < ncolumns; i++)
+	{
+		char	   *leftop;
+		char	   *rightop;
+
+		if (columns[i].kind != IVM_COLUMN_KEY)
+			continue;
+
+		leftop = quote_qualified_identifier("mv", columns[i].name);
+		rightop = quote_qualified_identifier("d", columns[i].name);
+
+		appendStringInfoString(buf, first ? "(" : " AND (");
+		generate_operator_clause(buf, leftop, columns[i].type, columns[i].eqop,
+								 rightop, columns[i].type);
+		appendStringInfo(buf, " OR (%s IS NULL AND %s IS NULL))",
+						 leftop, rightop);
+		first = false;
+	}
+
+	if (first)
+		appendStringInfoString(buf, "true");
+}
+
+/*
+ * Apply the change recorded in one transition table to the materialized view.
+ */
+static void
+ivm_apply_delta(Relation matviewRel, Query *query, Oid changedRelid,
+				const char *enrname, bool is_insert)
+{
+	int			ncolumns = RelationGetNumberOfAttributes(matviewRel);
+	IvmColumn  *columns;
+	char	   *countname;
+	char	   *matviewname;
+	char	   *delta;
+	StringInfoData querybuf;
+	bool		first;
+	int			i;
+
+	columns = get_ivm_columns(matviewRel, query, &countname);
+	matviewname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+											 RelationGetRelationName(matviewRel));
+	delta = ivm_delta_query(matviewRel, query, changedRelid, enrname);
+
+	initStringInfo(&querybuf);
+
+	if (!query->hasAggs)
+	{
+		if (is_insert)
+		{
+			appendStringInfo(&querybuf, "INSERT INTO %s %s", matviewname, delta);
+			ivm_execute(querybuf.data, SPI_OK_INSERT);
+			return;
+		}
+
+		/*
+		 * Delete as many copies of each deleted row as it occurs in the
+		 * delta.  Number the delta's distinct rows so that the copies found
+		 * for each of them can be counted.
+		 */
+		appendStringInfoString(&querybuf,
+							   "WITH __ivm_delta__ AS (SELECT g.*, "
+							   "pg_catalog.row_number() OVER () AS __ivm_id__ "
+							   "FROM (SELECT ");
+		for (i = 0; i < ncolumns; i++)
+			appendStringInfo(&querybuf, "d.%s, ", quote_identifier(columns[i].name));
+		appendStringInfo(&querybuf,
+						 "pg_catalog.count(*) AS __ivm_count__ FROM (%s) d GROUP BY ",
+						 delta);
+		for (i = 0; i < ncolumns; i++)
+			appendStringInfo(&querybuf, "%s%d", i > 0 ? ", " : "", i + 1);
+		appendStringInfo(&querybuf,
+						 ") g), __ivm_target__ AS (SELECT mv.ctid AS __ivm_tid__, "
+						 "d.__ivm_count__, pg_catalog.row_number() OVER "
+						 "(PARTITION BY d.__ivm_id__) AS __ivm_rn__ "
+						 "FROM %s mv JOIN __ivm_delta__ d ON (",
+						 matviewname);
+		ivm_append_key_match(&querybuf, columns, ncolumns);
+		appendStringInfo(&querybuf,
+						 ")) DELETE FROM %s mv USING __ivm_target__ t "
+						 "WHERE mv.ctid OPERATOR(pg_catalog.=) t.__ivm_tid__ "
+						 "AND t.__ivm_rn__ OPERATOR(pg_catalog.<=) t.__ivm_count__",
+						 matviewname);
+		ivm_execute(querybuf.data, SPI_OK_DELETE);
+		return;
+	}
+
+	/* Aggregate view: update the aggregates of the affected groups. */
+	appendStringInfo(&querybuf,
+					 "WITH __ivm_delta__ AS (%s), "
+					 "__ivm_upd__ AS (UPDATE %s mv SET ",
+					 delta, matviewname);
+	first = true;
+	for (i = 0; i < ncolumns; i++)
+	{
+		const char *col = quote_identifier(columns[i].name);
+
+		if (columns[i].kind == IVM_COLUMN_KEY)
+			continue;
+
+		if (!first)
+			appendStringInfoString(&querybuf, ", ");
+		first = false;
+
+		if (columns[i].kind == IVM_COLUMN_COUNT)
+			appendStringInfo(&querybuf,
+							 "%s = mv.%s OPERATOR(pg_catalog.%s) d.%s",
+							 col, col, is_insert ? "+" : "-", col);
+		else if (is_insert)
+			appendStringInfo(&querybuf,
+							 "%s = CASE WHEN mv.%s IS NULL THEN d.%s "
+							 "WHEN d.%s IS NULL THEN mv.%s "
+							 "ELSE mv.%s OPERATOR(pg_catalog.+) d.%s END",
+							 col, col, col, col, col, col, col);
+		else
+		{
+			const char *count = quote_identifier(columns[i].countname);
+
+			appendStringInfo(&querybuf,
+							 "%s = CASE WHEN d.%s IS NULL THEN mv.%s "
+							 "WHEN mv.%s OPERATOR(pg_catalog.=) d.%s THEN NULL "
+							 "ELSE mv.%s OPERATOR(pg_catalog.-) d.%s END",
+							 col, col, col, count, count, col, col);
+		}
+	}
+	appendStringInfoString(&querybuf, " FROM __ivm_delta__ d WHERE ");
+	ivm_append_key_match(&querybuf, columns, ncolumns);
+
+	if (query->groupClause == NIL)
+	{
+		/* Without GROUP BY, the view always has exactly one row. */
+		appendStringInfoString(&querybuf, " RETURNING 1) SELECT 1");
+		ivm_execute(querybuf.data, SPI_OK_SELECT);
+		return;
+	}
+
+	if (is_insert)
+	{
+		/* Groups that were not found in the view are inserted. */
+		first = true;
+		for (i = 0; i < ncolumns; i++)
+		{
+			if (columns[i].kind != IVM_COLUMN_KEY)
+				continue;
+			appendStringInfo(&querybuf, "%smv.%s",
+							 first ? " RETURNING " : ", ",
+							 quote_identifier(columns[i].name));
+			first = false;
+		}
+		appendStringInfo(&querybuf,
+						 ") INSERT INTO %s SELECT * FROM __ivm_delta__ d "
+						 "WHERE NOT EXISTS (SELECT 1 FROM __ivm_upd__ mv WHERE ",
+						 matviewname);
+		ivm_append_key_match(&querybuf, columns, ncolumns);
+		appendStringInfoChar(&querybuf, ')');
+		ivm_execute(querybuf.data, SPI_OK_INSERT);
+	}
+	else
+	{
+		/* Groups losing all their rows are deleted instead of updated. */
+		const char *count = quote_identifier(countname);
+
+		appendStringInfo(&querybuf,
+						 " AND mv.%s OPERATOR(pg_catalog.<>) d.%s RETURNING 1), "
+						 "__ivm_del__ AS (DELETE FROM %s mv USING __ivm_delta__ d WHERE ",
+						 count, count, matviewname);
+		ivm_append_key_match(&querybuf, columns, ncolumns);
+		appendStringInfo(&querybuf,
+						 " AND mv.%s OPERATOR(pg_catalog.=) d.%s RETURNING 1) SELECT 1",
+						 count, count);
+		ivm_execute(querybuf.data, SPI_OK_SELECT);
+	}
+}
+
+/*
+ * Empty the materialized view after a base table was truncated.
+ */
+static void
+ivm_apply_truncate(Relation matviewRel, Query *query)
+{
+	StringInfoData querybuf;
+	char	   *matviewname;
+
+	matviewname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+											 RelationGetRelationName(matviewRel));
+	initStringInfo(&querybuf);
+
+	if (query->hasAggs && query->groupClause == NIL)
+	{
+		/* The single row of an aggregate without GROUP BY stays. */
+		int			ncolumns = RelationGetNumberOfAttributes(matviewRel);
+		IvmColumn  *columns;
+		char	   *countname;
+		int			i;
+
+		columns = get_ivm_columns(matviewRel, query, &countname);
+		appendStringInfo(&querybuf, "UPDATE %s SET ", matviewname);
+		for (i = 0; i < ncolumns; i++)
+			appendStringInfo(&querybuf, "%s%s = %s",
+							 i > 0 ? ", " : "",
+							 quote_identifier(columns[i].name),
+							 columns[i].kind == IVM_COLUMN_COUNT ? "0" : "NULL");
+		ivm_execute(querybuf.data, SPI_OK_UPDATE);
+	}
+	else
+	{
+		appendStringInfo(&querybuf, "DELETE FROM %s", matviewname);
+		ivm_execute(querybuf.data, SPI_OK_DELETE);
+	}
+}
+
+/*
+ * Run a maintenance query.  Like the RI triggers, read with a fresh snapshot
+ * even in a serializable transaction, so that changes committed by another
+ * maintenance run we may have waited for are not missed.
+ */
+static void
+ivm_execute(const char *sql, int expected)
+{
+	SPIPlanPtr	plan;
+
+	plan = SPI_prepare(sql, 0, NULL);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare returned %s for %s",
+			 SPI_result_code_string(SPI_result), sql);
+
+	if (SPI_execute_snapshot(plan, NULL, NULL,
+							 GetLatestSnapshot(), InvalidSnapshot,
+							 false, false, 0) != expected)
+		elog(ERROR, "SPI_exec failed: %s", sql);
+
+	SPI_freeplan(plan);
+}
+
+/*
+ * ivm_immediate_maintenance
+ *		Trigger function applying a statement's changes to a base table of an
+ *		incrementally maintained materialized view.
+ *
+ * The OID of the materialized view is the trigger's only argument.  The view
+ * is locked in ExclusiveLock mode, which serializes maintenance runs with
+ * each other and with REFRESH, while still allowing reads.  A materialized
+ * view that is not populated is left alone; REFRESH will compute it anyway.
+ */
+Datum
+ivm_immediate_maintenance(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	Trigger    *trigger;
+	Oid			matviewOid;
+	Relation	matviewRel;
+	Query	   *query;
+	Oid			relid;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			save_nestlevel;
+	int			old_depth = matview_maintenance_depth;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "ivm_immediate_maintenance: not fired by trigger manager");
+	if (!TRIGGER_FIRED_AFTER(trigdata->tg_event) ||
+		!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event))
+		elog(ERROR, "ivm_immediate_maintenance: must be fired after statement");
+
+	trigger = trigdata->tg_trigger;
+	if (trigger->tgnargs != 1)
+		elog(ERROR, "ivm_immediate_maintenance: wrong number of arguments");
+	matviewOid = DatumGetObjectId(DirectFunctionCall1(oidin,
+													  CStringGetDatum(trigger->tgargs[0])));
+	relid = RelationGetRelid(trigdata->tg_relation);
+
+	matviewRel = table_open(matviewOid, ExclusiveLock);
+	if (!RelationIsPopulated(matviewRel))
+	{
+		table_close(matviewRel, NoLock);
+		return PointerGetDatum(NULL);
+	}
+	query = get_matview_query(matviewRel);
+
+	/* Run the maintenance queries as the owner of the materialized view. */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(matviewRel->rd_rel->relowner,
+						   save_sec_context | SECURITY_RESTRICTED_OPERATION);
+	save_nestlevel = NewGUCNestLevel();
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+	if (SPI_register_trigger_data(trigdata) != SPI_OK_TD_REGISTER)
+		elog(ERROR, "SPI_register_trigger_data failed");
+
+	OpenMatViewIncrementalMaintenance();
+	PG_TRY();
+	{
+		if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+			ivm_apply_truncate(matviewRel, query);
+		else
+		{
+			/* Remove the old rows' contribution first, then add the new. */
+			if (trigdata->tg_oldtable != NULL)
+				ivm_apply_delta(matviewRel, query, relid,
+								IVM_OLDTABLE_NAME, false);
+			if (trigdata->tg_newtable != NULL)
+				ivm_apply_delta(matviewRel, query, relid,
+								IVM_NEWTABLE_NAME, true);
+		}
+	}
+	PG_CATCH();
+	{
+		matview_maintenance_depth = old_depth;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	CloseMatViewIncrementalMaintenance();
+	Assert(matview_maintenance_depth == old_depth);
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish failed");
+
+	/* Roll back any GUC changes */
+	AtEOXact_GUC(false, save_nestlevel);
+
+	/* Restore userid and security context */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	table_close(matviewRel, NoLock);
+
+	return PointerGetDatum(NULL);
+}
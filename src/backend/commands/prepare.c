@@ -29,6 +29,7 @@
 #include "parser/parse_collate.h"
 #include "parser/parse_expr.h"
 #include "parser/parse_type.h"
+#include "portability/instr_time.h"
 #include "rewrite/rewriteHandler.h"
 #include "tcop/pquery.h"
 #include "tcop/utility.h"
@@ -210,6 +211,8 @@ ExecuteQuery(ExecuteStmt *stmt, IntoClause *intoClause,
 	char	   *query_string;
 	int			eflags;
 	long		count;
+	bool		time_run;
+	instr_time	starttime;
 
 	/* Look it up in the hash table */
 	entry = FetchPreparedStatement(stmt->name, true);
@@ -301,8 +304,28 @@ ExecuteQuery(ExecuteStmt *stmt, IntoClause *intoClause,
 	 */
 	PortalStart(portal, paramLI, eflags, GetActiveSnapshot());
 
+	time_run = (plan_cache_mode == PLAN_CACHE_MODE_ADAPTIVE);
+	if (time_run)
+		INSTR_TIME_SET_CURRENT(starttime);
+
 	(void) PortalRun(portal, count, false, true, dest, dest, completionTag);
 
+	/*
+	 * Tell the plan cache how long that took.  Look up the statement again,
+	 * as it might have been deallocated while running.
+	 */
+	if (time_run)
+	{
+		instr_time	duration;
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
+		entry = FetchPreparedStatement(stmt->name, false);
+		if (entry)
+			CachedPlanRecordRun(entry->plansource, cplan,
+								INSTR_TIME_GET_MILLISEC(duration));
+	}
+
 	PortalDrop(portal, false);
 
 	if (estate)
@@ -632,6 +655,9 @@ ExplainExecuteQuery(ExecuteStmt *execstmt, IntoClause *into, ExplainState *es,
 	EState	   *estate = NULL;
 	instr_time	planstart;
 	instr_time	planduration;
+	MemoryContextCounters mem_counters;
+	MemoryContext planner_ctx = NULL;
+	MemoryContext saved_ctx = NULL;
 
 	INSTR_TIME_SET_CURRENT(planstart);
 
@@ -659,12 +685,27 @@ ExplainExecuteQuery(ExecuteStmt *execstmt, IntoClause *into, ExplainState *es,
 								 queryString, estate);
 	}
 
+	if (es->memory)
+	{
+		/* See ExplainOneQuery about this */
+		planner_ctx = AllocSetContextCreate(CurrentMemoryContext,
+											"explain analyze planner context",
+											ALLOCSET_DEFAULT_SIZES);
+		saved_ctx = MemoryContextSwitchTo(planner_ctx);
+	}
+
 	/* Replan if needed, and acquire a transient refcount */
 	cplan = GetCachedPlan(entry->plansource, paramLI, true, queryEnv);
 
 	INSTR_TIME_SET_CURRENT(planduration);
 	INSTR_TIME_SUBTRACT(planduration, planstart);
 
+	if (es->memory)
+	{
+		MemoryContextSwitchTo(saved_ctx);
+		MemoryContextMemConsumed(planner_ctx, &mem_counters);
+	}
+
 	plan_list = cplan->stmt_list;
 
 	/* Explain each query */
@@ -674,7 +715,7 @@ ExplainExecuteQuery(ExecuteStmt *execstmt, IntoClause *into, ExplainState *es,
 
 		if (pstmt->commandType != CMD_UTILITY)
 			ExplainOnePlan(pstmt, into, es, query_string, paramLI, queryEnv,
-						   &planduration);
+						   &planduration, (es->memory ? &mem_counters : NULL));
 		else
 			ExplainOneUtility(pstmt->utilityStmt, into, es, query_string,
 							  paramLI, queryEnv);
@@ -39,9 +39,12 @@
 #include "parser/parse_type.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/hashutils.h"
 #include "utils/lsyscache.h"
 #include "utils/resowner.h"
 #include "utils/syscache.h"
@@ -88,6 +91,38 @@ typedef SeqTableData *SeqTable;
 
 static HTAB *seqhashtab = NULL; /* hash table for SeqTable items */
 
+/*
+ * With shared_sequence_cache enabled, the values a backend would otherwise
+ * cache locally for a sequence with CACHE > 1 are kept in shared memory
+ * instead, so that all backends can hand them out without locking the
+ * sequence's buffer.  The cache is a small direct-mapped array; a sequence
+ * whose slot is taken by another simply replaces it, losing the values that
+ * were left, just as happens when a backend with cached values exits.
+ *
+ * A slot is filled, and invalidated by setval() and ALTER SEQUENCE, while
+ * holding the sequence's buffer lock, so a backend that finds the slot
+ * empty after acquiring that lock may safely refill it.  The cached values
+ * are never beyond the last_value stored in the sequence tuple, so the
+ * usual WAL-logging of the tuple protects them across crashes.
+ */
+#define NUM_SHARED_SEQ_SLOTS	64
+
+typedef struct SharedSeqSlot
+{
+	slock_t		mutex;			/* protects all the fields below */
+	Oid			dbid;			/* database of the sequence */
+	Oid			relid;			/* sequence OID, or InvalidOid if empty */
+	Oid			filenode;		/* relfilenode the values came from */
+	int64		next;			/* next value to hand out */
+	int64		increment;		/* sequence's increment */
+	int64		remaining;		/* number of values left, including next */
+} SharedSeqSlot;
+
+static SharedSeqSlot *SharedSeqCache = NULL;
+
+/* GUC variable */
+bool		shared_sequence_cache = false;
+
 /*
  * last_used_seq is updated by nextval() to point to the last used
  * sequence.
@@ -108,6 +143,43 @@ static void init_params(ParseState *pstate, List *options, bool for_identity,
 						List **owned_by);
 static void do_setval(Oid relid, int64 next, bool iscalled);
 static void process_owned_by(Relation seqrel, List *owned_by, bool for_identity);
+static SharedSeqSlot *shared_seq_slot(Oid relid);
+static bool shared_seq_fetch(Relation seqrel, int64 *result);
+static void shared_seq_fill(Relation seqrel, int64 next, int64 increment,
+							int64 count);
+static void shared_seq_invalidate(Oid relid);
+
+
+/*
+ * Report shared-memory space needed by SequenceShmemInit
+ */
+Size
+SequenceShmemSize(void)
+{
+	return mul_size(NUM_SHARED_SEQ_SLOTS, sizeof(SharedSeqSlot));
+}
+
+/*
+ * Allocate and initialize the shared sequence cache
+ */
+void
+SequenceShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	SharedSeqCache = (SharedSeqSlot *)
+		ShmemInitStruct("Shared Sequence Cache", SequenceShmemSize(), &found);
+
+	if (!found)
+	{
+		for (i = 0; i < NUM_SHARED_SEQ_SLOTS; i++)
+		{
+			SpinLockInit(&SharedSeqCache[i].mutex);
+			SharedSeqCache[i].relid = InvalidOid;
+		}
+	}
+}
 
 
 /*
@@ -332,6 +404,7 @@ ResetSequence(Oid seq_relid)
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
 	elm->cached = elm->last;
+	shared_seq_invalidate(seq_relid);
 
 	relation_close(seq_rel, NoLock);
 }
@@ -477,6 +550,7 @@ AlterSequence(ParseState *pstate, AlterSeqStmt *stmt)
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
 	elm->cached = elm->last;
+	shared_seq_invalidate(relid);
 
 	/* If needed, rewrite the sequence relation itself */
 	if (need_seq_rewrite)
@@ -538,6 +612,9 @@ DeleteSequenceTuple(Oid relid)
 
 	ReleaseSysCache(tuple);
 	table_close(rel, RowExclusiveLock);
+
+	/* Don't let a later sequence with the same OID see our values */
+	shared_seq_invalidate(relid);
 }
 
 /*
@@ -598,6 +675,7 @@ nextval_internal(Oid relid, bool check_permissions)
 				rescnt = 0;
 	bool		cycle;
 	bool		logit = false;
+	bool		useshared;
 
 	/* open and lock sequence */
 	init_sequence(relid, &elm, &seqrel);
@@ -631,6 +709,12 @@ nextval_internal(Oid relid, bool check_permissions)
 		return elm->last;
 	}
 
+	/* try the shared cache before touching the sequence itself */
+	if (shared_sequence_cache &&
+		seqrel->rd_rel->relpersistence != RELPERSISTENCE_TEMP &&
+		shared_seq_fetch(seqrel, &result))
+		goto shared_done;
+
 	pgstuple = SearchSysCache1(SEQRELID, ObjectIdGetDatum(relid));
 	if (!HeapTupleIsValid(pgstuple))
 		elog(ERROR, "cache lookup failed for sequence %u", relid);
@@ -642,10 +726,24 @@ nextval_internal(Oid relid, bool check_permissions)
 	cycle = pgsform->seqcycle;
 	ReleaseSysCache(pgstuple);
 
+	/*
+	 * Cycling sequences are left out of the shared cache, since the values
+	 * it holds must form a simple arithmetic progression.
+	 */
+	useshared = (shared_sequence_cache && cache > 1 && !cycle &&
+				 seqrel->rd_rel->relpersistence != RELPERSISTENCE_TEMP);
+
 	/* lock page' buffer and read tuple */
 	seq = read_seq_tuple(seqrel, &buf, &seqdatatuple);
 	page = BufferGetPage(buf);
 
+	/* somebody may have refilled the shared cache while we waited */
+	if (useshared && shared_seq_fetch(seqrel, &result))
+	{
+		UnlockReleaseBuffer(buf);
+		goto shared_done;
+	}
+
 	elm->increment = incby;
 	last = next = result = seq->last_value;
 	fetch = cache;
@@ -751,9 +849,9 @@ nextval_internal(Oid relid, bool check_permissions)
 	log -= fetch;				/* adjust for any unfetched numbers */
 	Assert(log >= 0);
 
-	/* save info in local cache */
+	/* save info in local cache, unless the values go to the shared cache */
 	elm->last = result;			/* last returned number */
-	elm->cached = last;			/* last fetched number */
+	elm->cached = useshared ? result : last;	/* last fetched number */
 	elm->last_valid = true;
 
 	last_used_seq = elm;
@@ -819,10 +917,23 @@ nextval_internal(Oid relid, bool check_permissions)
 
 	END_CRIT_SECTION();
 
+	/* publish the rest of the values while we still hold the buffer lock */
+	if (useshared)
+		shared_seq_fill(seqrel, result + incby, incby, rescnt - 1);
+
 	UnlockReleaseBuffer(buf);
 
 	relation_close(seqrel, NoLock);
 
+	return result;
+
+shared_done:
+	elm->last = result;
+	elm->cached = result;
+	elm->last_valid = true;
+	last_used_seq = elm;
+	relation_close(seqrel, NoLock);
+
 	return result;
 }
 
@@ -974,6 +1085,7 @@ do_setval(Oid relid, int64 next, bool iscalled)
 
 	/* In any case, forget any future cached numbers */
 	elm->cached = elm->last;
+	shared_seq_invalidate(relid);
 
 	/* check the comment above nextval_internal()'s equivalent call. */
 	if (RelationNeedsWAL(seqrel))
@@ -1929,6 +2041,82 @@ seq_redo(XLogReaderState *record)
 	pfree(localpage);
 }
 
+/*
+ * Find the shared cache slot a sequence maps to.
+ */
+static SharedSeqSlot *
+shared_seq_slot(Oid relid)
+{
+	uint32		h;
+
+	h = hash_combine(murmurhash32((uint32) MyDatabaseId),
+					 murmurhash32((uint32) relid));
+	return &SharedSeqCache[h % NUM_SHARED_SEQ_SLOTS];
+}
+
+/*
+ * Take the next value of a sequence from the shared cache.  Returns false if
+ * the cache has no values for it.
+ */
+static bool
+shared_seq_fetch(Relation seqrel, int64 *result)
+{
+	SharedSeqSlot *slot = shared_seq_slot(RelationGetRelid(seqrel));
+	bool		found = false;
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->relid == RelationGetRelid(seqrel) &&
+		slot->dbid == MyDatabaseId &&
+		slot->filenode == seqrel->rd_node.relNode &&
+		slot->remaining > 0)
+	{
+		*result = slot->next;
+		/* don't step past the last value, it might overflow */
+		if (--slot->remaining > 0)
+			slot->next += slot->increment;
+		found = true;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	return found;
+}
+
+/*
+ * Store count values of a sequence, starting at next, in the shared cache.
+ * Caller must hold the sequence's buffer lock.
+ */
+static void
+shared_seq_fill(Relation seqrel, int64 next, int64 increment, int64 count)
+{
+	SharedSeqSlot *slot = shared_seq_slot(RelationGetRelid(seqrel));
+
+	if (count <= 0)
+		return;
+
+	SpinLockAcquire(&slot->mutex);
+	slot->dbid = MyDatabaseId;
+	slot->relid = RelationGetRelid(seqrel);
+	slot->filenode = seqrel->rd_node.relNode;
+	slot->next = next;
+	slot->increment = increment;
+	slot->remaining = count;
+	SpinLockRelease(&slot->mutex);
+}
+
+/*
+ * Forget any values of a sequence in the shared cache.
+ */
+static void
+shared_seq_invalidate(Oid relid)
+{
+	SharedSeqSlot *slot = shared_seq_slot(relid);
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->relid == relid && slot->dbid == MyDatabaseId)
+		slot->relid = InvalidOid;
+	SpinLockRelease(&slot->mutex);
+}
+
 /*
  * Flush cached sequence information.
  */
@@ -3611,10 +3611,22 @@ typedef SetConstraintStateData *SetConstraintState;
  * be fired at the same time, if they were queued between the same firing
  * cycles.  So we need only ensure that ats_firing_id is zero when attaching
  * a new event to an existing AfterTriggerSharedData record.
+ *
+ * A bulk INSERT, UPDATE or DELETE typically queues the same trigger for
+ * tuples at consecutive offsets of the same heap pages.  Rather than storing
+ * each such event separately, a row event that continues the most recently
+ * queued one is folded into it: AFTER_TRIGGER_RUN says that a uint32 count
+ * follows the ctid fields, and the event then stands for that many events
+ * whose ctids advance by one line pointer each (both of them, for an
+ * update).  The members of a run share their status bits, so they are fired
+ * together and in order.  Only the last event of a list is ever extended
+ * this way, and never once its status bits are set or the list position has
+ * been remembered elsewhere; see afterTriggerAddEvent().
  */
 typedef uint32 TriggerFlags;
 
-#define AFTER_TRIGGER_OFFSET			0x0FFFFFFF	/* must be low-order bits */
+#define AFTER_TRIGGER_OFFSET			0x07FFFFFF	/* must be low-order bits */
+#define AFTER_TRIGGER_RUN				0x08000000
 #define AFTER_TRIGGER_DONE				0x10000000
 #define AFTER_TRIGGER_IN_PROGRESS		0x20000000
 /* bits describing the size and tuple sources of this event */
@@ -3657,13 +3669,23 @@ typedef struct AfterTriggerEventDataZeroCtids
 	TriggerFlags ate_flags;		/* status bits and offset to shared data */
 }			AfterTriggerEventDataZeroCtids;
 
-#define SizeofTriggerEvent(evt) \
+#define SizeofTriggerEventCtids(evt) \
 	(((evt)->ate_flags & AFTER_TRIGGER_TUP_BITS) == AFTER_TRIGGER_2CTID ? \
 	 sizeof(AfterTriggerEventData) : \
 		((evt)->ate_flags & AFTER_TRIGGER_TUP_BITS) == AFTER_TRIGGER_1CTID ? \
 		sizeof(AfterTriggerEventDataOneCtid) : \
 			sizeof(AfterTriggerEventDataZeroCtids))
 
+#define SizeofTriggerEvent(evt) \
+	(SizeofTriggerEventCtids(evt) + \
+	 (((evt)->ate_flags & AFTER_TRIGGER_RUN) ? sizeof(uint32) : 0))
+
+#define TriggerEventRunLength(evt) \
+	(*(uint32 *) ((char *) (evt) + SizeofTriggerEventCtids(evt)))
+
+#define GetTriggerEventRunLength(evt) \
+	(((evt)->ate_flags & AFTER_TRIGGER_RUN) ? TriggerEventRunLength(evt) : 1)
+
 #define GetTriggerSharedData(evt) \
 	((AfterTriggerShared) ((char *) (evt) + ((evt)->ate_flags & AFTER_TRIGGER_OFFSET)))
 
@@ -3691,6 +3713,7 @@ typedef struct AfterTriggerEventList
 	AfterTriggerEventChunk *head;
 	AfterTriggerEventChunk *tail;
 	char	   *tailfree;		/* freeptr of tail chunk */
+	AfterTriggerEvent lastevent;	/* last event, if it may be extended */
 } AfterTriggerEventList;
 
 /* Macros to help in iterating over a list of events */
@@ -3843,6 +3866,7 @@ static AfterTriggersData afterTriggers;
 
 static void AfterTriggerExecute(EState *estate,
 								AfterTriggerEvent event,
+								uint32 runidx,
 								ResultRelInfo *relInfo,
 								TriggerDesc *trigdesc,
 								FmgrInfo *finfo,
@@ -3939,11 +3963,82 @@ afterTriggerCheckState(AfterTriggerShared evtshared)
 }
 
 
+/* ----------
+ * afterTriggerExtendRun()
+ *
+ *	Try to fold a new trigger event into the last event of the queue, as
+ *	described above AFTER_TRIGGER_RUN.  Returns true if that was done.
+ * ----------
+ */
+static bool
+afterTriggerExtendRun(AfterTriggerEventList *events,
+					  AfterTriggerEvent event, AfterTriggerShared evtshared)
+{
+	AfterTriggerEventChunk *chunk = events->tail;
+	AfterTriggerEvent prev = events->lastevent;
+	AfterTriggerShared prevshared;
+	TriggerFlags tupbits = event->ate_flags & AFTER_TRIGGER_TUP_BITS;
+	uint32		prevlen;
+
+	if (prev == NULL ||
+		(char *) prev + SizeofTriggerEvent(prev) != chunk->freeptr)
+		return false;
+
+	/* Both must be not-yet-scheduled row events of the same trigger */
+	if ((prev->ate_flags | event->ate_flags) &
+		(AFTER_TRIGGER_DONE | AFTER_TRIGGER_IN_PROGRESS))
+		return false;
+	if (!TRIGGER_FIRED_FOR_ROW(evtshared->ats_event))
+		return false;
+	if ((prev->ate_flags & AFTER_TRIGGER_TUP_BITS) != tupbits ||
+		(tupbits != AFTER_TRIGGER_1CTID && tupbits != AFTER_TRIGGER_2CTID))
+		return false;
+	prevshared = GetTriggerSharedData(prev);
+	if (prevshared->ats_tgoid != evtshared->ats_tgoid ||
+		prevshared->ats_relid != evtshared->ats_relid ||
+		prevshared->ats_event != evtshared->ats_event ||
+		prevshared->ats_table != evtshared->ats_table ||
+		prevshared->ats_firing_id != 0)
+		return false;
+
+	/* The new event's tuples must follow the run's on the same pages */
+	prevlen = GetTriggerEventRunLength(prev);
+	if (!ItemPointerIsValid(&prev->ate_ctid1) ||
+		!ItemPointerIsValid(&event->ate_ctid1) ||
+		ItemPointerGetBlockNumber(&event->ate_ctid1) !=
+		ItemPointerGetBlockNumber(&prev->ate_ctid1) ||
+		ItemPointerGetOffsetNumber(&event->ate_ctid1) !=
+		ItemPointerGetOffsetNumber(&prev->ate_ctid1) + prevlen)
+		return false;
+	if (tupbits == AFTER_TRIGGER_2CTID &&
+		(!ItemPointerIsValid(&prev->ate_ctid2) ||
+		 !ItemPointerIsValid(&event->ate_ctid2) ||
+		 ItemPointerGetBlockNumber(&event->ate_ctid2) !=
+		 ItemPointerGetBlockNumber(&prev->ate_ctid2) ||
+		 ItemPointerGetOffsetNumber(&event->ate_ctid2) !=
+		 ItemPointerGetOffsetNumber(&prev->ate_ctid2) + prevlen))
+		return false;
+
+	if (!(prev->ate_flags & AFTER_TRIGGER_RUN))
+	{
+		/* Make room for the count after the ctids */
+		if (chunk->endfree - chunk->freeptr < sizeof(uint32))
+			return false;
+		prev->ate_flags |= AFTER_TRIGGER_RUN;
+		chunk->freeptr += sizeof(uint32);
+		events->tailfree = chunk->freeptr;
+	}
+	TriggerEventRunLength(prev) = prevlen + GetTriggerEventRunLength(event);
+
+	return true;
+}
+
 /* ----------
  * afterTriggerAddEvent()
  *
  *	Add a new trigger event to the specified queue.
- *	The passed-in event data is copied.
+ *	The passed-in event data is copied, or merged into the last event
+ *	already queued if possible.
  * ----------
  */
 static void
@@ -3956,6 +4051,9 @@ afterTriggerAddEvent(AfterTriggerEventList *events,
 	AfterTriggerShared newshared;
 	AfterTriggerEvent newevent;
 
+	if (afterTriggerExtendRun(events, event, evtshared))
+		return;
+
 	/*
 	 * If empty list or not enough room in the tail chunk, make a new chunk.
 	 * We assume here that a new shared record will always be needed.
@@ -4054,6 +4152,7 @@ afterTriggerAddEvent(AfterTriggerEventList *events,
 
 	chunk->freeptr += eventsize;
 	events->tailfree = chunk->freeptr;
+	events->lastevent = newevent;
 }
 
 /* ----------
@@ -4074,6 +4173,7 @@ afterTriggerFreeEventList(AfterTriggerEventList *events)
 	}
 	events->tail = NULL;
 	events->tailfree = NULL;
+	events->lastevent = NULL;
 }
 
 /* ----------
@@ -4146,6 +4246,7 @@ afterTriggerDeleteHeadEventChunk(AfterTriggersQueryData *qs)
 			table->after_trig_events.head = NULL;
 			table->after_trig_events.tail = NULL;
 			table->after_trig_events.tailfree = NULL;
+			table->after_trig_events.lastevent = NULL;
 		}
 	}
 
@@ -4167,6 +4268,7 @@ afterTriggerDeleteHeadEventChunk(AfterTriggersQueryData *qs)
  *	the end of a query, we can even piggyback on the executor's state.)
  *
  *	event: event currently being fired.
+ *	runidx: which member of the event's run is being fired (0 if not a run).
  *	rel: open relation for event.
  *	trigdesc: working copy of rel's trigger info.
  *	finfo: array of fmgr lookup cache entries (one per trigger in trigdesc).
@@ -4180,6 +4282,7 @@ afterTriggerDeleteHeadEventChunk(AfterTriggersQueryData *qs)
 static void
 AfterTriggerExecute(EState *estate,
 					AfterTriggerEvent event,
+					uint32 runidx,
 					ResultRelInfo *relInfo,
 					TriggerDesc *trigdesc,
 					FmgrInfo *finfo, Instrumentation *instr,
@@ -4267,9 +4370,15 @@ AfterTriggerExecute(EState *estate,
 		default:
 			if (ItemPointerIsValid(&(event->ate_ctid1)))
 			{
+				ItemPointerData ctid1 = event->ate_ctid1;
+
+				if (runidx > 0)
+					ItemPointerSetOffsetNumber(&ctid1,
+											   ItemPointerGetOffsetNumber(&ctid1) + runidx);
+
 				LocTriggerData.tg_trigslot = ExecGetTriggerOldSlot(estate, relInfo);
 
-				if (!table_tuple_fetch_row_version(rel, &(event->ate_ctid1),
+				if (!table_tuple_fetch_row_version(rel, &ctid1,
 												   SnapshotAny,
 												   LocTriggerData.tg_trigslot))
 					elog(ERROR, "failed to fetch tuple1 for AFTER trigger");
@@ -4286,9 +4395,15 @@ AfterTriggerExecute(EState *estate,
 				AFTER_TRIGGER_2CTID &&
 				ItemPointerIsValid(&(event->ate_ctid2)))
 			{
+				ItemPointerData ctid2 = event->ate_ctid2;
+
+				if (runidx > 0)
+					ItemPointerSetOffsetNumber(&ctid2,
+											   ItemPointerGetOffsetNumber(&ctid2) + runidx);
+
 				LocTriggerData.tg_newslot = ExecGetTriggerNewSlot(estate, relInfo);
 
-				if (!table_tuple_fetch_row_version(rel, &(event->ate_ctid2),
+				if (!table_tuple_fetch_row_version(rel, &ctid2,
 												   SnapshotAny,
 												   LocTriggerData.tg_newslot))
 					elog(ERROR, "failed to fetch tuple2 for AFTER trigger");
@@ -4495,6 +4610,8 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 		for_each_event(event, chunk)
 		{
 			AfterTriggerShared evtshared = GetTriggerSharedData(event);
+			uint32		nrun,
+						i;
 
 			/*
 			 * Is it one for me to fire?
@@ -4531,12 +4648,15 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 				}
 
 				/*
-				 * Fire it.  Note that the AFTER_TRIGGER_IN_PROGRESS flag is
-				 * still set, so recursive examinations of the event list
-				 * won't try to re-fire it.
+				 * Fire it, once for each member of a run.  Note that the
+				 * AFTER_TRIGGER_IN_PROGRESS flag is still set, so recursive
+				 * examinations of the event list won't try to re-fire it.
 				 */
-				AfterTriggerExecute(estate, event, rInfo, trigdesc, finfo, instr,
-									per_tuple_context, slot1, slot2);
+				nrun = GetTriggerEventRunLength(event);
+				for (i = 0; i < nrun; i++)
+					AfterTriggerExecute(estate, event, i, rInfo, trigdesc,
+										finfo, instr, per_tuple_context,
+										slot1, slot2);
 
 				/*
 				 * Mark the event as done.
@@ -4564,7 +4684,10 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 			 * list, since we'd fail to fix their copies of tailfree.
 			 */
 			if (chunk == events->tail)
+			{
 				events->tailfree = chunk->freeptr;
+				events->lastevent = NULL;
+			}
 		}
 	}
 	if (slot1 != NULL)
@@ -5018,6 +5141,7 @@ AfterTriggerEndXact(bool isCommit)
 		afterTriggers.events.head = NULL;
 		afterTriggers.events.tail = NULL;
 		afterTriggers.events.tailfree = NULL;
+		afterTriggers.events.lastevent = NULL;
 	}
 
 	/*
@@ -5086,6 +5210,8 @@ AfterTriggerBeginSubXact(void)
 	 */
 	afterTriggers.trans_stack[my_level].state = NULL;
 	afterTriggers.trans_stack[my_level].events = afterTriggers.events;
+	/* events queued from now on must not extend the saved ones */
+	afterTriggers.events.lastevent = NULL;
 	afterTriggers.trans_stack[my_level].query_depth = afterTriggers.query_depth;
 	afterTriggers.trans_stack[my_level].firing_counter = afterTriggers.firing_counter;
 }
@@ -5234,6 +5360,7 @@ AfterTriggerEnlargeQueryState(void)
 		qs->events.head = NULL;
 		qs->events.tail = NULL;
 		qs->events.tailfree = NULL;
+		qs->events.lastevent = NULL;
 		qs->fdw_tuplestore = NULL;
 		qs->tables = NIL;
 
@@ -6162,6 +6289,7 @@ done:
 	/* In any case, save current insertion point for next time */
 	table->after_trig_done = true;
 	table->after_trig_events = qs->events;
+	qs->events.lastevent = NULL;
 }
 
 /*
@@ -35,13 +35,16 @@
 #include "catalog/pg_database.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_namespace.h"
+#include "catalog/storage.h"
 #include "commands/cluster.h"
 #include "commands/defrem.h"
+#include "commands/tablecmds.h"
 #include "commands/vacuum.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "pgstat.h"
 #include "postmaster/autovacuum.h"
+#include "postmaster/bgworker_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
@@ -61,6 +64,7 @@ int			vacuum_freeze_min_age;
 int			vacuum_freeze_table_age;
 int			vacuum_multixact_freeze_min_age;
 int			vacuum_multixact_freeze_table_age;
+bool		vacuum_eager_freeze;
 
 
 /* A few variables that don't seem worth passing around as parameters */
@@ -94,12 +98,19 @@ ExecVacuum(ParseState *pstate, VacuumStmt *vacstmt, bool isTopLevel)
 	bool		freeze = false;
 	bool		full = false;
 	bool		disable_page_skipping = false;
+	bool		concurrently = false;
 	ListCell   *lc;
 
 	/* Set default value */
 	params.index_cleanup = VACOPT_TERNARY_DEFAULT;
 	params.truncate = VACOPT_TERNARY_DEFAULT;
 
+	/* By default parallel vacuum is enabled */
+	params.nworkers = 0;
+
+	/* Spreading out the freezing of all-visible pages is for autovacuum */
+	params.eager_freeze_pages = 0;
+
 	/* Parse options list */
 	foreach(lc, vacstmt->options)
 	{
@@ -110,6 +121,28 @@ ExecVacuum(ParseState *pstate, VacuumStmt *vacstmt, bool isTopLevel)
 			verbose = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "skip_locked") == 0)
 			skip_locked = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "parallel") == 0)
+		{
+			int			nworkers;
+
+			if (opt->arg == NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("parallel option requires a value between 0 and %d",
+								MAX_PARALLEL_WORKER_LIMIT),
+						 parser_errposition(pstate, opt->location)));
+
+			nworkers = defGetInt32(opt);
+			if (nworkers < 0 || nworkers > MAX_PARALLEL_WORKER_LIMIT)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("parallel vacuum degree must be between 0 and %d",
+								MAX_PARALLEL_WORKER_LIMIT),
+						 parser_errposition(pstate, opt->location)));
+
+			/* PARALLEL 0 disables parallel vacuum and analyze */
+			params.nworkers = (nworkers == 0) ? -1 : nworkers;
+		}
 		else if (!vacstmt->is_vacuumcmd)
 			ereport(ERROR,
 					(errcode(ERRCODE_SYNTAX_ERROR),
@@ -125,6 +158,8 @@ ExecVacuum(ParseState *pstate, VacuumStmt *vacstmt, bool isTopLevel)
 			full = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "disable_page_skipping") == 0)
 			disable_page_skipping = defGetBoolean(opt);
+		else if (strcmp(opt->defname, "concurrently") == 0)
+			concurrently = defGetBoolean(opt);
 		else if (strcmp(opt->defname, "index_cleanup") == 0)
 			params.index_cleanup = get_vacopt_ternary_value(opt);
 		else if (strcmp(opt->defname, "truncate") == 0)
@@ -152,6 +187,11 @@ ExecVacuum(ParseState *pstate, VacuumStmt *vacstmt, bool isTopLevel)
 		   !(params.options & (VACOPT_FULL | VACOPT_FREEZE)));
 	Assert(!(params.options & VACOPT_SKIPTOAST));
 
+	if ((params.options & VACOPT_FULL) && params.nworkers > 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot specify both FULL and PARALLEL options")));
+
 	/*
 	 * Make sure VACOPT_ANALYZE is specified if any column lists are present.
 	 */
@@ -195,6 +235,38 @@ ExecVacuum(ParseState *pstate, VacuumStmt *vacstmt, bool isTopLevel)
 	/* user-invoked vacuum never uses this parameter */
 	params.log_min_duration = -1;
 
+	/* VACUUM (FULL, CONCURRENTLY) is a job for cluster.c alone */
+	if (concurrently)
+	{
+		VacuumRelation *vrel;
+		Oid			relid;
+
+		if (!(params.options & VACOPT_FULL))
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("VACUUM option CONCURRENTLY requires option FULL")));
+		if (params.options & VACOPT_ANALYZE)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("cannot specify both CONCURRENTLY and ANALYZE options")));
+		if (list_length(vacstmt->rels) != 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("VACUUM (FULL, CONCURRENTLY) must be given a single table")));
+
+		PreventInTransactionBlock(isTopLevel, "VACUUM (FULL, CONCURRENTLY)");
+
+		vrel = linitial_node(VacuumRelation, vacstmt->rels);
+		relid = RangeVarGetRelidExtended(vrel->relation,
+										 ShareUpdateExclusiveLock,
+										 0,
+										 RangeVarCallbackOwnsTable, NULL);
+
+		cluster_concurrently(relid, InvalidOid,
+							 (params.options & VACOPT_VERBOSE) != 0);
+		return;
+	}
+
 	/* Now go through the common routine */
 	vacuum(vacstmt->rels, &params, NULL, isTopLevel);
 }
@@ -837,6 +909,13 @@ get_all_vacuum_rels(int options)
 			classForm->relkind != RELKIND_PARTITIONED_TABLE)
 			continue;
 
+		/*
+		 * Skip global temp tables; opening one would set up storage for it
+		 * in this session just to find it empty.
+		 */
+		if (classForm->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+			continue;
+
 		/*
 		 * Build VacuumRelation(s) specifying the table OIDs to be processed.
 		 * We omit a RangeVar since it wouldn't be appropriate to complain
@@ -1161,6 +1240,17 @@ vac_update_relstats(Relation relation,
 	Form_pg_class pgcform;
 	bool		dirty;
 
+	/*
+	 * One session's copy of a global temp table says nothing about others,
+	 * so pg_class is left alone; but the horizons of this session's copy are
+	 * tracked privately.
+	 */
+	if (RelationIsGlobalTemp(relation))
+	{
+		RelationSetLocalFrozenXids(relation->rd_node, frozenxid, minmulti);
+		return;
+	}
+
 	rd = table_open(RelationRelationId, RowExclusiveLock);
 
 	/* Fetch a copy of the tuple to scribble on */
@@ -1284,6 +1374,8 @@ vac_update_datfrozenxid(void)
 	HeapTuple	classTup;
 	TransactionId newFrozenXid;
 	MultiXactId newMinMulti;
+	TransactionId gttFrozenXid;
+	MultiXactId gttMinMulti;
 	TransactionId lastSaneFrozenXid;
 	MultiXactId lastSaneMinMulti;
 	bool		bogus = false;
@@ -1337,6 +1429,14 @@ vac_update_datfrozenxid(void)
 			continue;
 		}
 
+		/*
+		 * The relfrozenxid of a global temp table is never advanced, since
+		 * it can't describe every session's copy; leave it out.  The copies
+		 * are accounted for below.
+		 */
+		if (classForm->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+			continue;
+
 		/*
 		 * Some table AMs might not need per-relation xid / multixid horizons.
 		 * It therefore seems reasonable to allow relfrozenxid and relminmxid
@@ -1391,6 +1491,21 @@ vac_update_datfrozenxid(void)
 	if (bogus)
 		return;
 
+	/*
+	 * Each backend's private copies of global temp tables may hold XIDs and
+	 * MultiXactIds older than anything in pg_class.  A backend that creates
+	 * such storage after this is either still running a transaction covered
+	 * by GetOldestXmin above, or only writes newer XIDs to it.
+	 */
+	GetOldestGlobalTempXids(MyDatabaseId, &gttFrozenXid, NULL,
+							&gttMinMulti, NULL);
+	if (TransactionIdIsValid(gttFrozenXid) &&
+		TransactionIdPrecedes(gttFrozenXid, newFrozenXid))
+		newFrozenXid = gttFrozenXid;
+	if (MultiXactIdIsValid(gttMinMulti) &&
+		MultiXactIdPrecedes(gttMinMulti, newMinMulti))
+		newMinMulti = gttMinMulti;
+
 	Assert(TransactionIdIsNormal(newFrozenXid));
 	Assert(MultiXactIdIsValid(newMinMulti));
 
@@ -1475,6 +1590,10 @@ vac_truncate_clog(TransactionId frozenXID,
 	HeapTuple	tuple;
 	Oid			oldestxid_datoid;
 	Oid			minmulti_datoid;
+	TransactionId gttFrozenXid;
+	MultiXactId gttMinMulti;
+	Oid			gttxid_datoid;
+	Oid			gttmulti_datoid;
 	bool		bogus = false;
 	bool		frozenAlreadyWrapped = false;
 
@@ -1545,6 +1664,26 @@ vac_truncate_clog(TransactionId frozenXID,
 
 	table_close(relation, AccessShareLock);
 
+	/*
+	 * A database's datfrozenxid only accounts for the global temp table
+	 * storage of its backends as of its last update, so check them all
+	 * again; see vac_update_datfrozenxid().
+	 */
+	GetOldestGlobalTempXids(InvalidOid, &gttFrozenXid, &gttxid_datoid,
+							&gttMinMulti, &gttmulti_datoid);
+	if (TransactionIdIsValid(gttFrozenXid) &&
+		TransactionIdPrecedes(gttFrozenXid, frozenXID))
+	{
+		frozenXID = gttFrozenXid;
+		oldestxid_datoid = gttxid_datoid;
+	}
+	if (MultiXactIdIsValid(gttMinMulti) &&
+		MultiXactIdPrecedes(gttMinMulti, minMulti))
+	{
+		minMulti = gttMinMulti;
+		minmulti_datoid = gttmulti_datoid;
+	}
+
 	/*
 	 * Do not truncate CLOG if we seem to have suffered wraparound already;
 	 * the computed minimum XID might be bogus.  This case should now be
@@ -1657,6 +1796,7 @@ vacuum_rel(Oid relid, RangeVar *relation, VacuumParams *params)
 		MyPgXact->vacuumFlags |= PROC_IN_VACUUM;
 		if (params->is_wraparound)
 			MyPgXact->vacuumFlags |= PROC_VACUUM_FOR_WRAPAROUND;
+		ProcGlobal->vacuumFlags[MyProc->pgxactoff] = MyPgXact->vacuumFlags;
 		LWLockRelease(ProcArrayLock);
 	}
 
@@ -1750,6 +1890,19 @@ vacuum_rel(Oid relid, RangeVar *relation, VacuumParams *params)
 		return true;
 	}
 
+	/*
+	 * Silently skip VACUUM FULL of global temp tables, which can't be
+	 * rewritten; see make_new_heap().  A plain VACUUM only processes this
+	 * session's copy.
+	 */
+	if ((params->options & VACOPT_FULL) && RelationIsGlobalTemp(onerel))
+	{
+		relation_close(onerel, lmode);
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+		return false;
+	}
+
 	/*
 	 * Get a session-level lock too. This will protect our access to the
 	 * relation across multiple transactions, so that we can vacuum the
@@ -0,0 +1,1040 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.c
+ *	  Batch-at-a-time evaluation of scan quals and simple aggregates.
+ *
+ * Normally tuples are passed between plan nodes one at a time, and every
+ * expression is evaluated once per tuple by dispatching through the steps
+ * of its ExprState.  For a few very common cases it is much cheaper to fetch
+ * a batch of tuples at once, extract the columns of interest into plain C
+ * arrays, and then run tight loops over those arrays:
+ *
+ *	- quals of a sequential scan of the form "column op constant", where op
+ *	  is one of the ordinary comparison operators on int2, int4, int8 or
+ *	  float8, and IS [NOT] NULL tests of columns;
+ *	- count, and sum and avg of int2, int4, int8 and float8 columns, in a
+ *	  plain aggregate reading directly from a sequential scan.
+ *
+ * Those comparisons cannot fail, so it does no harm to evaluate them for rows
+ * before anyone has asked for them.  The results must be exactly those of the
+ * regular code paths, which is why float8 comparisons use the NaN-aware
+ * helpers from float.h, and the aggregates repeat the arithmetic of their
+ * transition and final functions.
+ *
+ * The nodes using this (nodeSeqscan.c and nodeAgg.c) decide for themselves
+ * when batch evaluation is possible, and fall back to the regular code
+ * otherwise.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execBatch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/pg_aggregate.h"
+#include "catalog/pg_type.h"
+#include "common/int.h"
+#include "executor/execBatch.h"
+#include "executor/executor.h"
+#include "nodes/nodeFuncs.h"
+#include "utils/builtins.h"
+#include "utils/float.h"
+#include "utils/fmgroids.h"
+
+
+/* GUC variable */
+int			executor_batch_size = 1024;
+
+/* Comparisons that batch qual clauses can perform */
+typedef enum BatchCompare
+{
+	BATCH_CMP_EQ,
+	BATCH_CMP_NE,
+	BATCH_CMP_LT,
+	BATCH_CMP_LE,
+	BATCH_CMP_GT,
+	BATCH_CMP_GE,
+	BATCH_CMP_ISNULL,
+	BATCH_CMP_ISNOTNULL
+} BatchCompare;
+
+typedef struct BatchQualClause
+{
+	int			col;			/* index into the batch's cols[] */
+	BatchCompare cmp;
+	int64		ival;			/* constant for BATCH_COL_INT columns */
+	float8		fval;			/* constant for BATCH_COL_FLOAT columns */
+} BatchQualClause;
+
+struct BatchQual
+{
+	int			nclauses;
+	BatchQualClause clauses[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/*
+ * Comparison operators we can evaluate over a batch, by implementing
+ * function.  Integer comparisons of any width are done on values widened to
+ * int64, which gives the same answers as the cross-type operators.
+ */
+typedef struct BatchOperator
+{
+	Oid			funcid;
+	BatchCompare cmp;
+	BatchColumnKind kind;
+} BatchOperator;
+
+#define BATCH_COMPARISONS(prefix, kind) \
+	{F_##prefix##EQ, BATCH_CMP_EQ, kind}, \
+	{F_##prefix##NE, BATCH_CMP_NE, kind}, \
+	{F_##prefix##LT, BATCH_CMP_LT, kind}, \
+	{F_##prefix##LE, BATCH_CMP_LE, kind}, \
+	{F_##prefix##GT, BATCH_CMP_GT, kind}, \
+	{F_##prefix##GE, BATCH_CMP_GE, kind}
+
+static const BatchOperator batch_operators[] = {
+	BATCH_COMPARISONS(INT2, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT4, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT8, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT24, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT42, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT28, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT82, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT48, BATCH_COL_INT),
+	BATCH_COMPARISONS(INT84, BATCH_COL_INT),
+	BATCH_COMPARISONS(FLOAT8, BATCH_COL_FLOAT)
+};
+
+/* Aggregates with a batch implementation */
+typedef enum BatchAggKind
+{
+	BATCH_AGG_COUNT_STAR,
+	BATCH_AGG_COUNT,
+	BATCH_AGG_SUM_INT,			/* sum(int2), sum(int4): int8 result */
+	BATCH_AGG_SUM_INT8,			/* sum(int8): numeric result */
+	BATCH_AGG_SUM_FLOAT8,
+	BATCH_AGG_AVG_INT,			/* avg(int2), avg(int4) */
+	BATCH_AGG_AVG_INT8,
+	BATCH_AGG_AVG_FLOAT8
+} BatchAggKind;
+
+typedef struct BatchAggregate
+{
+	Oid			aggfnoid;
+	BatchAggKind kind;
+	Oid			argtype;		/* InvalidOid if any type is accepted */
+} BatchAggregate;
+
+/* OIDs are those assigned in pg_proc.dat */
+static const BatchAggregate batch_aggregates[] = {
+	{2803, BATCH_AGG_COUNT_STAR, InvalidOid},	/* count(*) */
+	{2147, BATCH_AGG_COUNT, InvalidOid},	/* count(any) */
+	{2109, BATCH_AGG_SUM_INT, INT2OID},
+	{2108, BATCH_AGG_SUM_INT, INT4OID},
+	{2107, BATCH_AGG_SUM_INT8, INT8OID},
+	{2111, BATCH_AGG_SUM_FLOAT8, FLOAT8OID},
+	{2102, BATCH_AGG_AVG_INT, INT2OID},
+	{2101, BATCH_AGG_AVG_INT, INT4OID},
+	{2100, BATCH_AGG_AVG_INT8, INT8OID},
+	{2105, BATCH_AGG_AVG_FLOAT8, FLOAT8OID}
+};
+
+struct BatchAggState
+{
+	BatchAggKind kind;
+	int			col;			/* batch column of the argument, or -1 */
+	int64		count;			/* number of non-null inputs */
+	int64		isum;			/* integer sum since the last flush */
+	Datum		nsum;			/* flushed part of an int8 sum, numeric */
+	bool		have_nsum;
+	float8		N;				/* float8 transition values, as in */
+	float8		Sx;				/* float8_accum() */
+	float8		Sxx;
+};
+
+static BatchColumnKind batch_column_kind(Oid typid);
+static bool batch_scan_var(Node *node, Index scanrelid);
+static bool batch_qual_clause(Expr *clause, Index scanrelid,
+							  TupleBatch *batch, BatchQualClause *bclause);
+static const BatchAggregate *batch_aggregate_lookup(Oid aggfnoid);
+static void batch_agg_flush_int8(BatchAggState *state);
+static Datum batch_agg_int8_total(BatchAggState *state);
+
+
+/*
+ * How values of the given type are stored in a batch column.
+ */
+static BatchColumnKind
+batch_column_kind(Oid typid)
+{
+	switch (typid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			return BATCH_COL_INT;
+		case FLOAT8OID:
+			return BATCH_COL_FLOAT;
+		default:
+			return BATCH_COL_NULLONLY;
+	}
+}
+
+/*
+ * ExecCreateTupleBatch
+ *
+ * Create an empty batch with room for maxrows tuples of the given row type.
+ * No slots are created yet; callers must use ExecBatchReserveSlots() before
+ * filling the batch.  A scan that stops after a few rows thus doesn't pay
+ * for maxrows slots.
+ */
+TupleBatch *
+ExecCreateTupleBatch(EState *estate, TupleDesc desc,
+					 const TupleTableSlotOps *tts_ops, int maxrows)
+{
+	TupleBatch *batch = palloc0(sizeof(TupleBatch));
+
+	Assert(maxrows > 0 && maxrows <= MAX_EXECUTOR_BATCH_SIZE);
+
+	batch->maxrows = maxrows;
+	batch->slots = palloc(sizeof(TupleTableSlot *) * maxrows);
+	batch->sel = palloc(sizeof(int) * maxrows);
+	batch->estate = estate;
+	batch->desc = desc;
+	batch->tts_ops = tts_ops;
+
+	/* there's never more than one column per attribute */
+	batch->cols = palloc0(sizeof(BatchColumn) * Max(desc->natts, 1));
+
+	return batch;
+}
+
+/*
+ * ExecBatchAddColumn
+ *
+ * Ask for attribute attnum to be extracted into a column of the batch, and
+ * return the column's index in batch->cols.  If need_values is false, the
+ * caller is only interested in NULL-ness; otherwise typid must be one that
+ * batch_column_kind() knows how to store.
+ *
+ * This must be called before the batch is first filled, in a long-lived
+ * memory context.
+ */
+int
+ExecBatchAddColumn(TupleBatch *batch, AttrNumber attnum, Oid typid,
+				   bool need_values)
+{
+	BatchColumn *col = NULL;
+	int			i;
+
+	for (i = 0; i < batch->ncols; i++)
+	{
+		if (batch->cols[i].attnum == attnum)
+		{
+			col = &batch->cols[i];
+			break;
+		}
+	}
+
+	if (col == NULL)
+	{
+		col = &batch->cols[batch->ncols++];
+		col->attnum = attnum;
+		col->typid = typid;
+		col->kind = BATCH_COL_NULLONLY;
+		col->isnull = palloc(sizeof(bool) * batch->maxrows);
+		batch->maxattnum = Max(batch->maxattnum, attnum);
+	}
+
+	if (need_values && col->kind == BATCH_COL_NULLONLY)
+	{
+		Assert(col->typid == typid);
+
+		col->kind = batch_column_kind(typid);
+		if (col->kind == BATCH_COL_INT)
+			col->ints = palloc(sizeof(int64) * batch->maxrows);
+		else if (col->kind == BATCH_COL_FLOAT)
+			col->floats = palloc(sizeof(float8) * batch->maxrows);
+		else
+			elog(ERROR, "type %u is not supported in batch columns", typid);
+	}
+
+	return col - batch->cols;
+}
+
+/*
+ * ExecBatchReserveSlots
+ *
+ * Make sure the first nrows slots of the batch exist.  The slots are
+ * registered in the estate's tuple table, and live as long as the query.
+ */
+void
+ExecBatchReserveSlots(TupleBatch *batch, int nrows)
+{
+	MemoryContext oldcontext;
+
+	Assert(nrows <= batch->maxrows);
+
+	if (nrows <= batch->nslots)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(batch->estate->es_query_cxt);
+	while (batch->nslots < nrows)
+		batch->slots[batch->nslots++] =
+			ExecInitExtraTupleSlot(batch->estate, batch->desc,
+								   batch->tts_ops);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * ExecBatchClear
+ *
+ * Release the tuples of a batch, and mark it empty.
+ */
+void
+ExecBatchClear(TupleBatch *batch)
+{
+	int			i;
+
+	for (i = 0; i < batch->nrows; i++)
+		ExecClearTuple(batch->slots[i]);
+	batch->nrows = 0;
+	batch->nsel = 0;
+}
+
+/*
+ * ExecBatchExtractColumns
+ *
+ * After the caller has stored nrows tuples in the batch's slots, select all
+ * of them and extract the requested columns.
+ */
+void
+ExecBatchExtractColumns(TupleBatch *batch)
+{
+	TupleTableSlot **slots = batch->slots;
+	int			nrows = batch->nrows;
+	int			i;
+	int			c;
+
+	for (i = 0; i < nrows; i++)
+		batch->sel[i] = i;
+	batch->nsel = nrows;
+
+	if (batch->ncols == 0)
+		return;
+
+	for (i = 0; i < nrows; i++)
+		slot_getsomeattrs(slots[i], batch->maxattnum);
+
+	for (c = 0; c < batch->ncols; c++)
+	{
+		BatchColumn *col = &batch->cols[c];
+		int			att = col->attnum - 1;
+		bool	   *isnull = col->isnull;
+
+		for (i = 0; i < nrows; i++)
+			isnull[i] = slots[i]->tts_isnull[att];
+
+		if (col->kind == BATCH_COL_INT)
+		{
+			int64	   *ints = col->ints;
+
+			switch (col->typid)
+			{
+				case INT2OID:
+					for (i = 0; i < nrows; i++)
+						ints[i] = isnull[i] ? 0 :
+							DatumGetInt16(slots[i]->tts_values[att]);
+					break;
+				case INT4OID:
+					for (i = 0; i < nrows; i++)
+						ints[i] = isnull[i] ? 0 :
+							DatumGetInt32(slots[i]->tts_values[att]);
+					break;
+				case INT8OID:
+					for (i = 0; i < nrows; i++)
+						ints[i] = isnull[i] ? 0 :
+							DatumGetInt64(slots[i]->tts_values[att]);
+					break;
+				default:
+					elog(ERROR, "unexpected batch column type %u", col->typid);
+			}
+		}
+		else if (col->kind == BATCH_COL_FLOAT)
+		{
+			float8	   *floats = col->floats;
+
+			for (i = 0; i < nrows; i++)
+				floats[i] = isnull[i] ? 0.0 :
+					DatumGetFloat8(slots[i]->tts_values[att]);
+		}
+	}
+}
+
+/*
+ * Is node a plain column reference to the scanned relation?
+ */
+static bool
+batch_scan_var(Node *node, Index scanrelid)
+{
+	Var		   *var = (Var *) node;
+
+	return IsA(node, Var) &&
+		var->varno == scanrelid &&
+		var->varlevelsup == 0 &&
+		var->varattno > 0;
+}
+
+/*
+ * If clause can be evaluated over a batch, fill in *bclause and return true.
+ * If batch is NULL, only check whether it can.
+ */
+static bool
+batch_qual_clause(Expr *clause, Index scanrelid, TupleBatch *batch,
+				  BatchQualClause *bclause)
+{
+	if (IsA(clause, NullTest))
+	{
+		NullTest   *ntest = (NullTest *) clause;
+		Var		   *var = (Var *) ntest->arg;
+
+		if (ntest->argisrow || !batch_scan_var((Node *) var, scanrelid))
+			return false;
+		if (batch == NULL)
+			return true;
+
+		bclause->col = ExecBatchAddColumn(batch, var->varattno, var->vartype,
+										  false);
+		bclause->cmp = (ntest->nulltesttype == IS_NULL) ?
+			BATCH_CMP_ISNULL : BATCH_CMP_ISNOTNULL;
+		return true;
+	}
+	else if (IsA(clause, OpExpr))
+	{
+		OpExpr	   *opexpr = (OpExpr *) clause;
+		const BatchOperator *bop = NULL;
+		Node	   *left;
+		Node	   *right;
+		Var		   *var;
+		Const	   *con;
+		bool		commuted;
+		int			i;
+
+		if (list_length(opexpr->args) != 2)
+			return false;
+		left = linitial(opexpr->args);
+		right = lsecond(opexpr->args);
+
+		if (batch_scan_var(left, scanrelid) && IsA(right, Const))
+		{
+			var = (Var *) left;
+			con = (Const *) right;
+			commuted = false;
+		}
+		else if (IsA(left, Const) && batch_scan_var(right, scanrelid))
+		{
+			var = (Var *) right;
+			con = (Const *) left;
+			commuted = true;
+		}
+		else
+			return false;
+
+		/* leave comparisons with NULL to the regular code */
+		if (con->constisnull)
+			return false;
+
+		set_opfuncid(opexpr);
+		for (i = 0; i < lengthof(batch_operators); i++)
+		{
+			if (batch_operators[i].funcid == opexpr->opfuncid)
+			{
+				bop = &batch_operators[i];
+				break;
+			}
+		}
+		if (bop == NULL ||
+			batch_column_kind(var->vartype) != bop->kind ||
+			batch_column_kind(con->consttype) != bop->kind)
+			return false;
+		if (batch == NULL)
+			return true;
+
+		bclause->col = ExecBatchAddColumn(batch, var->varattno, var->vartype,
+										  true);
+		bclause->cmp = bop->cmp;
+		if (commuted)
+		{
+			/* "const op var" is the same as "var commutator(op) const" */
+			switch (bop->cmp)
+			{
+				case BATCH_CMP_LT:
+					bclause->cmp = BATCH_CMP_GT;
+					break;
+				case BATCH_CMP_LE:
+					bclause->cmp = BATCH_CMP_GE;
+					break;
+				case BATCH_CMP_GT:
+					bclause->cmp = BATCH_CMP_LT;
+					break;
+				case BATCH_CMP_GE:
+					bclause->cmp = BATCH_CMP_LE;
+					break;
+				default:
+					break;
+			}
+		}
+
+		if (bop->kind == BATCH_COL_INT)
+		{
+			switch (con->consttype)
+			{
+				case INT2OID:
+					bclause->ival = DatumGetInt16(con->constvalue);
+					break;
+				case INT4OID:
+					bclause->ival = DatumGetInt32(con->constvalue);
+					break;
+				default:
+					bclause->ival = DatumGetInt64(con->constvalue);
+					break;
+			}
+		}
+		else
+			bclause->fval = DatumGetFloat8(con->constvalue);
+
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * ExecQualHasBatchClauses
+ *
+ * Could ExecInitBatchQual() batch any clause of an implicitly-ANDed qual
+ * list of a scan?
+ */
+bool
+ExecQualHasBatchClauses(List *qual, Index scanrelid)
+{
+	ListCell   *lc;
+
+	foreach(lc, qual)
+	{
+		if (batch_qual_clause((Expr *) lfirst(lc), scanrelid, NULL, NULL))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * ExecInitBatchQual
+ *
+ * Split an implicitly-ANDed qual list of a scan into the clauses that can be
+ * evaluated over a batch, and the rest, which is returned in *residual to be
+ * evaluated row by row.  Returns NULL if no clause can be batched.
+ *
+ * The columns referenced by the batched clauses are added to the batch.
+ */
+BatchQual *
+ExecInitBatchQual(List *qual, Index scanrelid, TupleBatch *batch,
+				  List **residual)
+{
+	BatchQual  *bqual;
+	ListCell   *lc;
+
+	*residual = NIL;
+
+	bqual = palloc(offsetof(BatchQual, clauses) +
+				   sizeof(BatchQualClause) * Max(list_length(qual), 1));
+	bqual->nclauses = 0;
+
+	foreach(lc, qual)
+	{
+		Expr	   *clause = (Expr *) lfirst(lc);
+
+		if (batch_qual_clause(clause, scanrelid, batch,
+							  &bqual->clauses[bqual->nclauses]))
+			bqual->nclauses++;
+		else
+			*residual = lappend(*residual, clause);
+	}
+
+	if (bqual->nclauses == 0)
+	{
+		pfree(bqual);
+		return NULL;
+	}
+
+	return bqual;
+}
+
+/*
+ * Keep only the selected rows for which cond, an expression of row index i,
+ * holds.
+ */
+#define BATCH_FILTER(cond) \
+	do { \
+		int			nkeep = 0; \
+		\
+		for (k = 0; k < nsel; k++) \
+		{ \
+			int			i = sel[k]; \
+			\
+			if (cond) \
+				sel[nkeep++] = i; \
+		} \
+		nsel = nkeep; \
+	} while (0)
+
+/*
+ * ExecBatchQualEval
+ *
+ * Remove the rows that fail the batch qual from the batch's selection.
+ */
+void
+ExecBatchQualEval(BatchQual *bqual, TupleBatch *batch)
+{
+	int		   *sel = batch->sel;
+	int			nsel = batch->nsel;
+	int			c;
+	int			k;
+
+	for (c = 0; c < bqual->nclauses && nsel > 0; c++)
+	{
+		BatchQualClause *clause = &bqual->clauses[c];
+		BatchColumn *col = &batch->cols[clause->col];
+		bool	   *isnull = col->isnull;
+
+		if (clause->cmp == BATCH_CMP_ISNULL)
+			BATCH_FILTER(isnull[i]);
+		else if (clause->cmp == BATCH_CMP_ISNOTNULL)
+			BATCH_FILTER(!isnull[i]);
+		else if (col->kind == BATCH_COL_INT)
+		{
+			int64	   *v = col->ints;
+			int64		cv = clause->ival;
+
+			switch (clause->cmp)
+			{
+				case BATCH_CMP_EQ:
+					BATCH_FILTER(!isnull[i] && v[i] == cv);
+					break;
+				case BATCH_CMP_NE:
+					BATCH_FILTER(!isnull[i] && v[i] != cv);
+					break;
+				case BATCH_CMP_LT:
+					BATCH_FILTER(!isnull[i] && v[i] < cv);
+					break;
+				case BATCH_CMP_LE:
+					BATCH_FILTER(!isnull[i] && v[i] <= cv);
+					break;
+				case BATCH_CMP_GT:
+					BATCH_FILTER(!isnull[i] && v[i] > cv);
+					break;
+				case BATCH_CMP_GE:
+					BATCH_FILTER(!isnull[i] && v[i] >= cv);
+					break;
+				default:
+					elog(ERROR, "unrecognized batch comparison: %d",
+						 (int) clause->cmp);
+			}
+		}
+		else
+		{
+			float8	   *v = col->floats;
+			float8		cv = clause->fval;
+
+			Assert(col->kind == BATCH_COL_FLOAT);
+
+			switch (clause->cmp)
+			{
+				case BATCH_CMP_EQ:
+					BATCH_FILTER(!isnull[i] && float8_eq(v[i], cv));
+					break;
+				case BATCH_CMP_NE:
+					BATCH_FILTER(!isnull[i] && float8_ne(v[i], cv));
+					break;
+				case BATCH_CMP_LT:
+					BATCH_FILTER(!isnull[i] && float8_lt(v[i], cv));
+					break;
+				case BATCH_CMP_LE:
+					BATCH_FILTER(!isnull[i] && float8_le(v[i], cv));
+					break;
+				case BATCH_CMP_GT:
+					BATCH_FILTER(!isnull[i] && float8_gt(v[i], cv));
+					break;
+				case BATCH_CMP_GE:
+					BATCH_FILTER(!isnull[i] && float8_ge(v[i], cv));
+					break;
+				default:
+					elog(ERROR, "unrecognized batch comparison: %d",
+						 (int) clause->cmp);
+			}
+		}
+	}
+
+	batch->nsel = nsel;
+}
+
+static const BatchAggregate *
+batch_aggregate_lookup(Oid aggfnoid)
+{
+	int			i;
+
+	for (i = 0; i < lengthof(batch_aggregates); i++)
+	{
+		if (batch_aggregates[i].aggfnoid == aggfnoid)
+			return &batch_aggregates[i];
+	}
+	return NULL;
+}
+
+/*
+ * ExecBatchAggSupported
+ *
+ * Can the aggregate be computed by ExecBatchAggAdvance()?  Only simple calls
+ * of the aggregates in batch_aggregates, with a plain column of the Agg
+ * node's input as argument, qualify.
+ */
+bool
+ExecBatchAggSupported(Aggref *aggref)
+{
+	const BatchAggregate *bagg;
+	TargetEntry *tle;
+	Var		   *var;
+
+	if (aggref->aggkind != AGGKIND_NORMAL ||
+		aggref->aggdirectargs != NIL ||
+		aggref->aggorder != NIL ||
+		aggref->aggdistinct != NIL ||
+		aggref->aggfilter != NULL)
+		return false;
+
+	bagg = batch_aggregate_lookup(aggref->aggfnoid);
+	if (bagg == NULL)
+		return false;
+
+	if (bagg->kind == BATCH_AGG_COUNT_STAR)
+		return aggref->aggstar;
+
+	if (list_length(aggref->args) != 1)
+		return false;
+	tle = linitial_node(TargetEntry, aggref->args);
+	var = (Var *) tle->expr;
+	if (!IsA(var, Var) || var->varno != OUTER_VAR || var->varattno <= 0)
+		return false;
+
+	return bagg->argtype == InvalidOid || bagg->argtype == var->vartype;
+}
+
+/*
+ * ExecInitBatchAgg
+ *
+ * Set up batch computation of an aggregate that ExecBatchAggSupported()
+ * accepted, over batches of the Agg node's input.
+ */
+BatchAggState *
+ExecInitBatchAgg(Aggref *aggref, TupleBatch *batch)
+{
+	BatchAggState *state = palloc0(sizeof(BatchAggState));
+	const BatchAggregate *bagg = batch_aggregate_lookup(aggref->aggfnoid);
+
+	Assert(ExecBatchAggSupported(aggref));
+
+	state->kind = bagg->kind;
+	if (bagg->kind == BATCH_AGG_COUNT_STAR)
+		state->col = -1;
+	else
+	{
+		Var		   *var = (Var *) linitial_node(TargetEntry, aggref->args)->expr;
+
+		state->col = ExecBatchAddColumn(batch, var->varattno, var->vartype,
+										bagg->kind != BATCH_AGG_COUNT);
+	}
+
+	return state;
+}
+
+/*
+ * ExecBatchAggReset
+ *
+ * Forget all input seen so far.
+ */
+void
+ExecBatchAggReset(BatchAggState *state)
+{
+	state->count = 0;
+	state->isum = 0;
+	state->nsum = (Datum) 0;
+	state->have_nsum = false;
+	state->N = 0.0;
+	state->Sx = 0.0;
+	state->Sxx = 0.0;
+}
+
+/*
+ * Move the integer part of an int8 sum into its numeric part.
+ */
+static void
+batch_agg_flush_int8(BatchAggState *state)
+{
+	Datum		part = DirectFunctionCall1(int8_numeric,
+										   Int64GetDatum(state->isum));
+
+	if (state->have_nsum)
+		state->nsum = DirectFunctionCall2(numeric_add, state->nsum, part);
+	else
+		state->nsum = part;
+	state->have_nsum = true;
+	state->isum = 0;
+}
+
+/*
+ * The exact total of an int8 sum, as numeric.
+ */
+static Datum
+batch_agg_int8_total(BatchAggState *state)
+{
+	Datum		total = DirectFunctionCall1(int8_numeric,
+											Int64GetDatum(state->isum));
+
+	if (state->have_nsum)
+		total = DirectFunctionCall2(numeric_add, state->nsum, total);
+	return total;
+}
+
+/*
+ * ExecBatchAggAdvance
+ *
+ * Accumulate the selected rows of a batch.  An int8 sum that overflows int64
+ * is carried over into a numeric, allocated in CurrentMemoryContext, which
+ * must therefore live as long as the aggregate's state.
+ */
+void
+ExecBatchAggAdvance(BatchAggState *state, TupleBatch *batch)
+{
+	int		   *sel = batch->sel;
+	int			nsel = batch->nsel;
+	BatchColumn *col = NULL;
+	bool	   *isnull = NULL;
+	int			k;
+
+	if (state->col >= 0)
+	{
+		col = &batch->cols[state->col];
+		isnull = col->isnull;
+	}
+
+	switch (state->kind)
+	{
+		case BATCH_AGG_COUNT_STAR:
+			state->count += nsel;
+			break;
+
+		case BATCH_AGG_COUNT:
+			{
+				int64		count = state->count;
+
+				for (k = 0; k < nsel; k++)
+				{
+					if (!isnull[sel[k]])
+						count++;
+				}
+				state->count = count;
+			}
+			break;
+
+		case BATCH_AGG_SUM_INT:
+		case BATCH_AGG_AVG_INT:
+			{
+				/* like int4_sum() and int4_avg_accum(), no overflow check */
+				int64	   *v = col->ints;
+				int64		count = state->count;
+				int64		sum = state->isum;
+
+				for (k = 0; k < nsel; k++)
+				{
+					int			i = sel[k];
+
+					if (!isnull[i])
+					{
+						sum += v[i];
+						count++;
+					}
+				}
+				state->count = count;
+				state->isum = sum;
+			}
+			break;
+
+		case BATCH_AGG_SUM_INT8:
+		case BATCH_AGG_AVG_INT8:
+			{
+				int64	   *v = col->ints;
+
+				for (k = 0; k < nsel; k++)
+				{
+					int			i = sel[k];
+					int64		newsum;
+
+					if (isnull[i])
+						continue;
+
+					state->count++;
+					if (unlikely(pg_add_s64_overflow(state->isum, v[i],
+													 &newsum)))
+					{
+						batch_agg_flush_int8(state);
+						newsum = v[i];
+					}
+					state->isum = newsum;
+				}
+			}
+			break;
+
+		case BATCH_AGG_SUM_FLOAT8:
+			{
+				/* like float8pl(), with the first input as initial value */
+				float8	   *v = col->floats;
+
+				for (k = 0; k < nsel; k++)
+				{
+					int			i = sel[k];
+
+					if (isnull[i])
+						continue;
+
+					if (state->count == 0)
+						state->Sx = v[i];
+					else
+						state->Sx = float8_pl(state->Sx, v[i]);
+					state->count++;
+				}
+			}
+			break;
+
+		case BATCH_AGG_AVG_FLOAT8:
+			{
+				/* keep this in sync with float8_accum() */
+				float8	   *v = col->floats;
+				float8		N = state->N;
+				float8		Sx = state->Sx;
+				float8		Sxx = state->Sxx;
+
+				for (k = 0; k < nsel; k++)
+				{
+					int			i = sel[k];
+					float8		newval = v[i];
+					float8		oldN = N;
+					float8		oldSx = Sx;
+					float8		tmp;
+
+					if (isnull[i])
+						continue;
+
+					N += 1.0;
+					Sx += newval;
+					if (oldN > 0.0)
+					{
+						tmp = newval * N - Sx;
+						Sxx += tmp * tmp / (N * oldN);
+
+						if (isinf(Sx) || isinf(Sxx))
+						{
+							if (!isinf(oldSx) && !isinf(newval))
+								ereport(ERROR,
+										(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+										 errmsg("value out of range: overflow")));
+
+							Sxx = get_float8_nan();
+						}
+					}
+					else
+					{
+						if (isnan(newval) || isinf(newval))
+							Sxx = get_float8_nan();
+					}
+				}
+				state->N = N;
+				state->Sx = Sx;
+				state->Sxx = Sxx;
+			}
+			break;
+	}
+}
+
+/*
+ * ExecBatchAggFinal
+ *
+ * Compute the aggregate's result, as its final function would.
+ */
+void
+ExecBatchAggFinal(BatchAggState *state, Datum *value, bool *isnull)
+{
+	*isnull = false;
+
+	switch (state->kind)
+	{
+		case BATCH_AGG_COUNT_STAR:
+		case BATCH_AGG_COUNT:
+			*value = Int64GetDatum(state->count);
+			break;
+
+		case BATCH_AGG_SUM_INT:
+			if (state->count == 0)
+				*isnull = true;
+			else
+				*value = Int64GetDatum(state->isum);
+			break;
+
+		case BATCH_AGG_AVG_INT:
+			if (state->count == 0)
+				*isnull = true;
+			else
+				*value = DirectFunctionCall2(numeric_div,
+											 DirectFunctionCall1(int8_numeric,
+																 Int64GetDatum(state->isum)),
+											 DirectFunctionCall1(int8_numeric,
+																 Int64GetDatum(state->count)));
+			break;
+
+		case BATCH_AGG_SUM_INT8:
+			if (state->count == 0)
+				*isnull = true;
+			else
+				*value = batch_agg_int8_total(state);
+			break;
+
+		case BATCH_AGG_AVG_INT8:
+			if (state->count == 0)
+				*isnull = true;
+			else
+				*value = DirectFunctionCall2(numeric_div,
+											 batch_agg_int8_total(state),
+											 DirectFunctionCall1(int8_numeric,
+																 Int64GetDatum(state->count)));
+			break;
+
+		case BATCH_AGG_SUM_FLOAT8:
+			if (state->count == 0)
+				*isnull = true;
+			else
+				*value = Float8GetDatum(state->Sx);
+			break;
+
+		case BATCH_AGG_AVG_FLOAT8:
+			/* SQL defines AVG of no values to be NULL */
+			if (state->N == 0.0)
+				*isnull = true;
+			else
+				*value = Float8GetDatum(state->Sx / state->N);
+			break;
+	}
+}
@@ -42,12 +42,21 @@
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
 #include "pgstat.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/typcache.h"
 
 
+/*
+ * Smallest constant array for which "scalar = ANY (array)" is evaluated by
+ * probing a hash table of the array's elements rather than by comparing
+ * against each element in turn.
+ */
+#define MIN_ARRAY_SIZE_FOR_HASHED_SAOP 9
+
 typedef struct LastAttnumInfo
 {
 	AttrNumber	last_inner;
@@ -72,13 +81,16 @@ static void ExecInitSubscriptingRef(ExprEvalStep *scratch,
 									ExprState *state,
 									Datum *resv, bool *resnull);
 static bool isAssignmentIndirectionExpr(Expr *expr);
+static bool use_hashed_saop(ScalarArrayOpExpr *opexpr, Oid *hashfuncid);
 static void ExecInitCoerceToDomain(ExprEvalStep *scratch, CoerceToDomain *ctest,
 								   ExprState *state,
 								   Datum *resv, bool *resnull);
 static void ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 								  ExprEvalStep *scratch,
 								  FunctionCallInfo fcinfo, AggStatePerTrans pertrans,
-								  int transno, int setno, int setoff, bool ishash);
+								  int transno, int setno, int setoff, bool ishash,
+								  bool nullcheck);
+static AggTransInlineFn ExecAggTransInlineFn(Oid transfn_oid);
 
 
 /*
@@ -950,6 +962,7 @@ ExecInitExprRec(Expr *node, ExprState *state,
 				FmgrInfo   *finfo;
 				FunctionCallInfo fcinfo;
 				AclResult	aclresult;
+				Oid			hashfuncid;
 
 				Assert(list_length(opexpr->args) == 2);
 				scalararg = (Expr *) linitial(opexpr->args);
@@ -985,12 +998,38 @@ ExecInitExprRec(Expr *node, ExprState *state,
 				ExecInitExprRec(arrayarg, state, resv, resnull);
 
 				/* And perform the operation */
-				scratch.opcode = EEOP_SCALARARRAYOP;
-				scratch.d.scalararrayop.element_type = InvalidOid;
-				scratch.d.scalararrayop.useOr = opexpr->useOr;
-				scratch.d.scalararrayop.finfo = finfo;
-				scratch.d.scalararrayop.fcinfo_data = fcinfo;
-				scratch.d.scalararrayop.fn_addr = finfo->fn_addr;
+				if (use_hashed_saop(opexpr, &hashfuncid))
+				{
+					FmgrInfo   *hash_finfo;
+					FunctionCallInfo hash_fcinfo;
+
+					hash_finfo = palloc0(sizeof(FmgrInfo));
+					hash_fcinfo = palloc0(SizeForFunctionCallInfo(1));
+					execHashFunctionInfo(hashfuncid, hashfuncid,
+										 hash_finfo, NULL);
+					fmgr_info_set_expr((Node *) node, hash_finfo);
+					InitFunctionCallInfoData(*hash_fcinfo, hash_finfo, 1,
+											 opexpr->inputcollid, NULL, NULL);
+
+					scratch.opcode = EEOP_HASHED_SCALARARRAYOP;
+					scratch.d.hashedscalararrayop.has_nulls = false;
+					scratch.d.hashedscalararrayop.elements_tab = NULL;
+					scratch.d.hashedscalararrayop.finfo = finfo;
+					scratch.d.hashedscalararrayop.fcinfo_data = fcinfo;
+					scratch.d.hashedscalararrayop.fn_addr = finfo->fn_addr;
+					scratch.d.hashedscalararrayop.hash_finfo = hash_finfo;
+					scratch.d.hashedscalararrayop.hash_fcinfo_data = hash_fcinfo;
+					scratch.d.hashedscalararrayop.hash_fn_addr = hash_finfo->fn_addr;
+				}
+				else
+				{
+					scratch.opcode = EEOP_SCALARARRAYOP;
+					scratch.d.scalararrayop.element_type = InvalidOid;
+					scratch.d.scalararrayop.useOr = opexpr->useOr;
+					scratch.d.scalararrayop.finfo = finfo;
+					scratch.d.scalararrayop.fcinfo_data = fcinfo;
+					scratch.d.scalararrayop.fn_addr = finfo->fn_addr;
+				}
 				ExprEvalPushStep(state, &scratch);
 				break;
 			}
@@ -2758,6 +2797,47 @@ isAssignmentIndirectionExpr(Expr *expr)
 	return false;
 }
 
+/*
+ * Decide whether a ScalarArrayOpExpr should be evaluated with a hash table.
+ *
+ * That's possible for "= ANY" with a strict operator belonging to a hash
+ * opfamily, when both inputs share the same hash function.  It only pays off
+ * if the table is built once and probed for many rows, so we require the
+ * array to be a non-null constant of a decent size.  If so, returns true
+ * and sets *hashfuncid to the hash function to use.
+ */
+static bool
+use_hashed_saop(ScalarArrayOpExpr *opexpr, Oid *hashfuncid)
+{
+	Expr	   *arrayarg = (Expr *) lsecond(opexpr->args);
+	Const	   *arrayconst;
+	ArrayType  *arr;
+	RegProcedure lefthashfunc;
+	RegProcedure righthashfunc;
+
+	if (!opexpr->useOr)
+		return false;
+
+	if (!IsA(arrayarg, Const) || ((Const *) arrayarg)->constisnull)
+		return false;
+	arrayconst = (Const *) arrayarg;
+
+	if (!func_strict(opexpr->opfuncid))
+		return false;
+
+	if (!get_op_hash_functions(opexpr->opno, &lefthashfunc, &righthashfunc) ||
+		lefthashfunc != righthashfunc)
+		return false;
+
+	arr = DatumGetArrayTypeP(arrayconst->constvalue);
+	if (ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr)) <
+		MIN_ARRAY_SIZE_FOR_HASHED_SAOP)
+		return false;
+
+	*hashfuncid = lefthashfunc;
+	return true;
+}
+
 /*
  * Prepare evaluation of a CoerceToDomain expression.
  */
@@ -2910,10 +2990,15 @@ ExecInitCoerceToDomain(ExprEvalStep *scratch, CoerceToDomain *ctest,
  * check for filters, evaluate aggregate input, check that that input is not
  * NULL for a strict transition function, and then finally invoke the
  * transition for each of the concurrently computed grouping sets.
+ *
+ * If nullcheck is true, the hash based transitions are skipped for any
+ * grouping set whose pergroup array pointer is NULL.  nodeAgg.c uses that
+ * for input tuples whose group has no hash table entry because they have
+ * been spilled to disk.
  */
 ExprState *
 ExecBuildAggTrans(AggState *aggstate, AggStatePerPhase phase,
-				  bool doSort, bool doHash)
+				  bool doSort, bool doHash, bool nullcheck)
 {
 	ExprState  *state = makeNode(ExprState);
 	PlanState  *parent = &aggstate->ss.ps;
@@ -3146,7 +3231,8 @@ ExecBuildAggTrans(AggState *aggstate, AggStatePerPhase phase,
 			for (setno = 0; setno < processGroupingSets; setno++)
 			{
 				ExecBuildAggTransCall(state, aggstate, &scratch, trans_fcinfo,
-									  pertrans, transno, setno, setoff, false);
+									  pertrans, transno, setno, setoff, false,
+									  false);
 				setoff++;
 			}
 		}
@@ -3164,7 +3250,8 @@ ExecBuildAggTrans(AggState *aggstate, AggStatePerPhase phase,
 			for (setno = 0; setno < numHashes; setno++)
 			{
 				ExecBuildAggTransCall(state, aggstate, &scratch, trans_fcinfo,
-									  pertrans, transno, setno, setoff, true);
+									  pertrans, transno, setno, setoff, true,
+									  nullcheck);
 				setoff++;
 			}
 		}
@@ -3212,10 +3299,13 @@ static void
 ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 					  ExprEvalStep *scratch,
 					  FunctionCallInfo fcinfo, AggStatePerTrans pertrans,
-					  int transno, int setno, int setoff, bool ishash)
+					  int transno, int setno, int setoff, bool ishash,
+					  bool nullcheck)
 {
 	int			adjust_init_jumpnull = -1;
 	int			adjust_strict_jumpnull = -1;
+	int			adjust_nullcheck_jumpnull = -1;
+	AggTransInlineFn inlinefn = AGG_TRANS_INLINE_NONE;
 	ExprContext *aggcontext;
 
 	if (ishash)
@@ -3223,6 +3313,20 @@ ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 	else
 		aggcontext = aggstate->aggcontexts[setno];
 
+	/*
+	 * Skip this transition entirely if there's no group for the current
+	 * input tuple in this grouping set.
+	 */
+	if (nullcheck)
+	{
+		scratch->opcode = EEOP_AGG_PLAIN_PERGROUP_NULLCHECK;
+		scratch->d.agg_plain_pergroup_nullcheck.setoff = setoff;
+		scratch->d.agg_plain_pergroup_nullcheck.jumpnull = -1;	/* adjust later */
+		ExprEvalPushStep(state, scratch);
+
+		adjust_nullcheck_jumpnull = state->steps_len - 1;
+	}
+
 	/*
 	 * If the initial value for the transition state doesn't exist in the
 	 * pg_aggregate table then we will let the first non-NULL value returned
@@ -3269,6 +3373,11 @@ ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 
 	/* invoke appropriate transition implementation */
 	if (pertrans->numSortCols == 0 && pertrans->transtypeByVal)
+		inlinefn = ExecAggTransInlineFn(fcinfo->flinfo->fn_oid);
+
+	if (inlinefn != AGG_TRANS_INLINE_NONE)
+		scratch->opcode = EEOP_AGG_PLAIN_TRANS_INLINE;
+	else if (pertrans->numSortCols == 0 && pertrans->transtypeByVal)
 		scratch->opcode = EEOP_AGG_PLAIN_TRANS_BYVAL;
 	else if (pertrans->numSortCols == 0)
 		scratch->opcode = EEOP_AGG_PLAIN_TRANS;
@@ -3283,6 +3392,7 @@ ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 	scratch->d.agg_trans.setoff = setoff;
 	scratch->d.agg_trans.transno = transno;
 	scratch->d.agg_trans.aggcontext = aggcontext;
+	scratch->d.agg_trans.inlinefn = inlinefn;
 	ExprEvalPushStep(state, scratch);
 
 	/* adjust jumps so they jump till after transition invocation */
@@ -3300,6 +3410,49 @@ ExecBuildAggTransCall(ExprState *state, AggState *aggstate,
 		Assert(as->d.agg_strict_trans_check.jumpnull == -1);
 		as->d.agg_strict_trans_check.jumpnull = state->steps_len;
 	}
+	if (adjust_nullcheck_jumpnull != -1)
+	{
+		ExprEvalStep *as = &state->steps[adjust_nullcheck_jumpnull];
+
+		Assert(as->d.agg_plain_pergroup_nullcheck.jumpnull == -1);
+		as->d.agg_plain_pergroup_nullcheck.jumpnull = state->steps_len;
+	}
+}
+
+/*
+ * Which, if any, of the transition functions that EEOP_AGG_PLAIN_TRANS_INLINE
+ * can evaluate without a function call is this?  The caller must make sure
+ * the transition type is pass-by-value.
+ */
+static AggTransInlineFn
+ExecAggTransInlineFn(Oid transfn_oid)
+{
+	switch (transfn_oid)
+	{
+		case F_INT8INC:
+		case F_INT8INC_ANY:
+			return AGG_TRANS_INLINE_INT8INC;
+		case F_INT8PL:
+			return AGG_TRANS_INLINE_INT8PL;
+		case F_INT4_SUM:
+			return AGG_TRANS_INLINE_INT4_SUM;
+		case F_FLOAT8PL:
+			return AGG_TRANS_INLINE_FLOAT8PL;
+		case F_INT4LARGER:
+			return AGG_TRANS_INLINE_INT4LARGER;
+		case F_INT4SMALLER:
+			return AGG_TRANS_INLINE_INT4SMALLER;
+		case F_INT8LARGER:
+			return AGG_TRANS_INLINE_INT8LARGER;
+		case F_INT8SMALLER:
+			return AGG_TRANS_INLINE_INT8SMALLER;
+		case F_FLOAT8LARGER:
+			return AGG_TRANS_INLINE_FLOAT8LARGER;
+		case F_FLOAT8SMALLER:
+			return AGG_TRANS_INLINE_FLOAT8SMALLER;
+		default:
+			return AGG_TRANS_INLINE_NONE;
+	}
 }
 
 /*
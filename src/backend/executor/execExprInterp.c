@@ -59,6 +59,7 @@
 #include "access/tuptoaster.h"
 #include "catalog/pg_type.h"
 #include "commands/sequence.h"
+#include "common/int.h"
 #include "executor/execExpr.h"
 #include "executor/nodeSubplan.h"
 #include "funcapi.h"
@@ -71,6 +72,7 @@
 #include "utils/date.h"
 #include "utils/datum.h"
 #include "utils/expandedrecord.h"
+#include "utils/float.h"
 #include "utils/lsyscache.h"
 #include "utils/timestamp.h"
 #include "utils/typcache.h"
@@ -160,6 +162,38 @@ static Datum ExecJustAssignOuterVar(ExprState *state, ExprContext *econtext, boo
 static Datum ExecJustAssignScanVar(ExprState *state, ExprContext *econtext, bool *isnull);
 static Datum ExecJustApplyFuncToCase(ExprState *state, ExprContext *econtext, bool *isnull);
 
+/* support for EEOP_HASHED_SCALARARRAYOP */
+typedef struct ScalarArrayOpExprHashEntry
+{
+	Datum		key;
+	uint32		status;			/* hash status */
+	uint32		hash;			/* hash value (cached) */
+} ScalarArrayOpExprHashEntry;
+
+struct saophash_hash;
+static bool saop_hash_element_match(struct saophash_hash *tb, Datum key1,
+									Datum key2);
+static uint32 saop_element_hash(struct saophash_hash *tb, Datum key);
+
+#define SH_PREFIX saophash
+#define SH_ELEMENT_TYPE ScalarArrayOpExprHashEntry
+#define SH_KEY_TYPE Datum
+#define SH_KEY key
+#define SH_HASH_KEY(tb, key) saop_element_hash(tb, key)
+#define SH_EQUAL(tb, a, b) saop_hash_element_match(tb, a, b)
+#define SH_SCOPE static inline
+#define SH_STORE_HASH
+#define SH_GET_HASH(tb, a) a->hash
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+typedef struct ScalarArrayOpExprHashTable
+{
+	saophash_hash *hashtab;		/* underlying hash table */
+	ExprEvalStep *op;			/* the step that owns the table */
+} ScalarArrayOpExprHashTable;
+
 
 /*
  * Prepare ExprState for interpreted execution.
@@ -379,6 +413,7 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 		&&CASE_EEOP_DOMAIN_CHECK,
 		&&CASE_EEOP_CONVERT_ROWTYPE,
 		&&CASE_EEOP_SCALARARRAYOP,
+		&&CASE_EEOP_HASHED_SCALARARRAYOP,
 		&&CASE_EEOP_XMLEXPR,
 		&&CASE_EEOP_AGGREF,
 		&&CASE_EEOP_GROUPING_FUNC,
@@ -391,8 +426,10 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 		&&CASE_EEOP_AGG_STRICT_INPUT_CHECK_NULLS,
 		&&CASE_EEOP_AGG_INIT_TRANS,
 		&&CASE_EEOP_AGG_STRICT_TRANS_CHECK,
+		&&CASE_EEOP_AGG_PLAIN_PERGROUP_NULLCHECK,
 		&&CASE_EEOP_AGG_PLAIN_TRANS_BYVAL,
 		&&CASE_EEOP_AGG_PLAIN_TRANS,
+		&&CASE_EEOP_AGG_PLAIN_TRANS_INLINE,
 		&&CASE_EEOP_AGG_ORDERED_TRANS_DATUM,
 		&&CASE_EEOP_AGG_ORDERED_TRANS_TUPLE,
 		&&CASE_EEOP_LAST
@@ -1415,6 +1452,14 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 			EEO_NEXT();
 		}
 
+		EEO_CASE(EEOP_HASHED_SCALARARRAYOP)
+		{
+			/* too complex for an inline implementation */
+			ExecEvalHashedScalarArrayOp(state, op, econtext);
+
+			EEO_NEXT();
+		}
+
 		EEO_CASE(EEOP_DOMAIN_NOTNULL)
 		{
 			/* too complex for an inline implementation */
@@ -1603,6 +1648,21 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 			EEO_NEXT();
 		}
 
+		/* skip a grouping set that has no group for the current tuple */
+		EEO_CASE(EEOP_AGG_PLAIN_PERGROUP_NULLCHECK)
+		{
+			AggState   *aggstate = castNode(AggState, state->parent);
+			AggStatePerGroup pergroup_allaggs;
+
+			pergroup_allaggs = aggstate->all_pergroups
+				[op->d.agg_plain_pergroup_nullcheck.setoff];
+
+			if (pergroup_allaggs == NULL)
+				EEO_JUMP(op->d.agg_plain_pergroup_nullcheck.jumpnull);
+
+			EEO_NEXT();
+		}
+
 		/*
 		 * Evaluate aggregate transition / combine function that has a
 		 * by-value transition type. That's a separate case from the
@@ -1717,6 +1777,18 @@ ExecInterpExpr(ExprState *state, ExprContext *econtext, bool *isnull)
 			EEO_NEXT();
 		}
 
+		/*
+		 * Evaluate a simple by-value transition function without calling
+		 * it.  No memory is allocated, so there's no need to set up the
+		 * aggregate's memory contexts.
+		 */
+		EEO_CASE(EEOP_AGG_PLAIN_TRANS_INLINE)
+		{
+			ExecAggPlainTransInline(state, op, econtext);
+
+			EEO_NEXT();
+		}
+
 		/* process single-column ordered aggregate datum */
 		EEO_CASE(EEOP_AGG_ORDERED_TRANS_DATUM)
 		{
@@ -3491,6 +3563,179 @@ ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op)
 	*op->resnull = resultnull;
 }
 
+/*
+ * Hash function for an element of the array of a hashed ScalarArrayOpExpr,
+ * or for the scalar that's probed for.
+ */
+static uint32
+saop_element_hash(struct saophash_hash *tb, Datum key)
+{
+	ScalarArrayOpExprHashTable *elements_tab = (ScalarArrayOpExprHashTable *) tb->private_data;
+	FunctionCallInfo fcinfo = elements_tab->op->d.hashedscalararrayop.hash_fcinfo_data;
+	Datum		hash;
+
+	fcinfo->args[0].value = key;
+	fcinfo->args[0].isnull = false;
+
+	hash = elements_tab->op->d.hashedscalararrayop.hash_fn_addr(fcinfo);
+
+	return DatumGetUInt32(hash);
+}
+
+/*
+ * Equality function for the hash table of a hashed ScalarArrayOpExpr,
+ * using the expression's own operator.
+ */
+static bool
+saop_hash_element_match(struct saophash_hash *tb, Datum key1, Datum key2)
+{
+	Datum		result;
+
+	ScalarArrayOpExprHashTable *elements_tab = (ScalarArrayOpExprHashTable *) tb->private_data;
+	FunctionCallInfo fcinfo = elements_tab->op->d.hashedscalararrayop.fcinfo_data;
+
+	fcinfo->args[0].value = key1;
+	fcinfo->args[0].isnull = false;
+	fcinfo->args[1].value = key2;
+	fcinfo->args[1].isnull = false;
+
+	result = elements_tab->op->d.hashedscalararrayop.fn_addr(fcinfo);
+
+	return DatumGetBool(result);
+}
+
+/*
+ * Evaluate "scalar = ANY (array)" by probing a hash table of the array's
+ * elements.
+ *
+ * The array is a constant, so the hash table is built the first time
+ * through and kept for the lifetime of the expression.  Source array is in
+ * our result area, scalar arg is already evaluated into fcinfo->args[0].
+ * The operator is known to be strict, so the result is NULL if the scalar
+ * is NULL, or if there's no match and the array contains a NULL.
+ */
+void
+ExecEvalHashedScalarArrayOp(ExprState *state, ExprEvalStep *op, ExprContext *econtext)
+{
+	ScalarArrayOpExprHashTable *elements_tab = op->d.hashedscalararrayop.elements_tab;
+	FunctionCallInfo fcinfo = op->d.hashedscalararrayop.fcinfo_data;
+	bool		hashfound;
+	Datum		scalar = fcinfo->args[0].value;
+	bool		scalar_isnull = fcinfo->args[0].isnull;
+
+	/*
+	 * If the array is NULL then we return NULL --- it's not very meaningful
+	 * to do anything else, even if the operator isn't strict.
+	 */
+	if (*op->resnull)
+		return;
+
+	/* If the scalar is NULL, so is the result; the operator is strict. */
+	if (scalar_isnull)
+	{
+		*op->resnull = true;
+		return;
+	}
+
+	/* Build the hash table on first evaluation */
+	if (elements_tab == NULL)
+	{
+		int16		typlen;
+		bool		typbyval;
+		char		typalign;
+		int			nitems;
+		bool		has_nulls = false;
+		char	   *s;
+		bits8	   *bitmap;
+		int			bitmask;
+		MemoryContext oldcontext;
+		ArrayType  *arr;
+
+		/*
+		 * The table, and the array the elements point into, must survive
+		 * for as long as the expression does.
+		 */
+		oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_query_memory);
+
+		arr = DatumGetArrayTypeP(*op->resvalue);
+		nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
+
+		get_typlenbyvalalign(ARR_ELEMTYPE(arr),
+							 &typlen,
+							 &typbyval,
+							 &typalign);
+
+		elements_tab = (ScalarArrayOpExprHashTable *)
+			palloc(sizeof(ScalarArrayOpExprHashTable));
+		op->d.hashedscalararrayop.elements_tab = elements_tab;
+		elements_tab->op = op;
+
+		/*
+		 * Create the hash table sizing it according to the number of
+		 * elements in the array.  This does assume that the array has no
+		 * duplicates.  If the array happens to contain many duplicate
+		 * values then it'll just mean that we sized the table a bit on the
+		 * large side.
+		 */
+		elements_tab->hashtab = saophash_create(CurrentMemoryContext, nitems,
+												elements_tab);
+
+		MemoryContextSwitchTo(oldcontext);
+
+		s = (char *) ARR_DATA_PTR(arr);
+		bitmap = ARR_NULLBITMAP(arr);
+		bitmask = 1;
+		for (int i = 0; i < nitems; i++)
+		{
+			/* Get array element, checking for NULL. */
+			if (bitmap && (*bitmap & bitmask) == 0)
+			{
+				has_nulls = true;
+			}
+			else
+			{
+				Datum		element;
+
+				element = fetch_att(s, typbyval, typlen);
+				s = att_addlength_pointer(s, typlen, s);
+				s = (char *) att_align_nominal(s, typalign);
+
+				saophash_insert(elements_tab->hashtab, element, &hashfound);
+			}
+
+			/* Advance bitmap pointer if any. */
+			if (bitmap)
+			{
+				bitmask <<= 1;
+				if (bitmask == 0x100)
+				{
+					bitmap++;
+					bitmask = 1;
+				}
+			}
+		}
+
+		/* Remember if we had any nulls for when there's no match */
+		op->d.hashedscalararrayop.has_nulls = has_nulls;
+	}
+
+	/* Check the hash to see if we have a match. */
+	hashfound = saophash_lookup(elements_tab->hashtab, scalar) != NULL;
+
+	*op->resvalue = BoolGetDatum(hashfound);
+	*op->resnull = false;
+
+	/*
+	 * An array containing NULL gives NULL rather than false when there's no
+	 * match, same as comparing against each element would.
+	 */
+	if (!hashfound && op->d.hashedscalararrayop.has_nulls)
+	{
+		*op->resvalue = (Datum) 0;
+		*op->resnull = true;
+	}
+}
+
 /*
  * Evaluate a NOT NULL domain constraint.
  */
@@ -4113,6 +4358,109 @@ ExecAggTransReparent(AggState *aggstate, AggStatePerTrans pertrans,
 	return newValue;
 }
 
+/*
+ * Evaluate a transition function that ExecBuildAggTrans() recognized as one
+ * of the AggTransInlineFn cases.  The result, including overflow errors,
+ * is the same as calling the function would give.
+ *
+ * The strictness checks for strict functions have already been made by
+ * preceding steps; only int4_sum has to deal with NULLs here.
+ */
+void
+ExecAggPlainTransInline(ExprState *state, ExprEvalStep *op,
+						ExprContext *econtext)
+{
+	AggState   *aggstate = op->d.agg_trans.aggstate;
+	FunctionCallInfo fcinfo = op->d.agg_trans.pertrans->transfn_fcinfo;
+	AggStatePerGroup pergroup;
+	Datum		transValue;
+	Datum		value = fcinfo->args[1].value;
+	int64		result;
+
+	pergroup = &aggstate->all_pergroups
+		[op->d.agg_trans.setoff]
+		[op->d.agg_trans.transno];
+	transValue = pergroup->transValue;
+
+	switch (op->d.agg_trans.inlinefn)
+	{
+		case AGG_TRANS_INLINE_INT8INC:
+			if (unlikely(pg_add_s64_overflow(DatumGetInt64(transValue), 1,
+											 &result)))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("bigint out of range")));
+			pergroup->transValue = Int64GetDatum(result);
+			break;
+
+		case AGG_TRANS_INLINE_INT8PL:
+			if (unlikely(pg_add_s64_overflow(DatumGetInt64(transValue),
+											 DatumGetInt64(value),
+											 &result)))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("bigint out of range")));
+			pergroup->transValue = Int64GetDatum(result);
+			break;
+
+		case AGG_TRANS_INLINE_INT4_SUM:
+			/* a NULL input leaves the sum unchanged, even if still NULL */
+			if (fcinfo->args[1].isnull)
+				break;
+			if (pergroup->transValueIsNull)
+			{
+				pergroup->transValue =
+					Int64GetDatum((int64) DatumGetInt32(value));
+				pergroup->transValueIsNull = false;
+			}
+			else
+				pergroup->transValue =
+					Int64GetDatum(DatumGetInt64(transValue) +
+								  (int64) DatumGetInt32(value));
+			break;
+
+		case AGG_TRANS_INLINE_FLOAT8PL:
+			pergroup->transValue =
+				Float8GetDatum(float8_pl(DatumGetFloat8(transValue),
+										 DatumGetFloat8(value)));
+			break;
+
+		case AGG_TRANS_INLINE_INT4LARGER:
+			if (!(DatumGetInt32(transValue) > DatumGetInt32(value)))
+				pergroup->transValue = value;
+			break;
+
+		case AGG_TRANS_INLINE_INT4SMALLER:
+			if (!(DatumGetInt32(transValue) < DatumGetInt32(value)))
+				pergroup->transValue = value;
+			break;
+
+		case AGG_TRANS_INLINE_INT8LARGER:
+			if (!(DatumGetInt64(transValue) > DatumGetInt64(value)))
+				pergroup->transValue = value;
+			break;
+
+		case AGG_TRANS_INLINE_INT8SMALLER:
+			if (!(DatumGetInt64(transValue) < DatumGetInt64(value)))
+				pergroup->transValue = value;
+			break;
+
+		case AGG_TRANS_INLINE_FLOAT8LARGER:
+			if (!float8_gt(DatumGetFloat8(transValue), DatumGetFloat8(value)))
+				pergroup->transValue = value;
+			break;
+
+		case AGG_TRANS_INLINE_FLOAT8SMALLER:
+			if (!float8_lt(DatumGetFloat8(transValue), DatumGetFloat8(value)))
+				pergroup->transValue = value;
+			break;
+
+		case AGG_TRANS_INLINE_NONE:
+			elog(ERROR, "transition function cannot be inlined");
+			break;
+	}
+}
+
 /*
  * Invoke ordered transition function, with a datum argument.
  */
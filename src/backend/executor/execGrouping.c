@@ -18,14 +18,17 @@
  */
 #include "postgres.h"
 
+#include "access/hash.h"
 #include "access/parallel.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/hashutils.h"
 #include "utils/memutils.h"
 
-static uint32 TupleHashTableHash(struct tuplehash_hash *tb, const MinimalTuple tuple);
+static uint32 TupleHashTableHash_internal(struct tuplehash_hash *tb,
+										  const MinimalTuple tuple);
 static int	TupleHashTableMatch(struct tuplehash_hash *tb, const MinimalTuple tuple1, const MinimalTuple tuple2);
 
 /*
@@ -37,7 +40,7 @@ static int	TupleHashTableMatch(struct tuplehash_hash *tb, const MinimalTuple tup
 #define SH_ELEMENT_TYPE TupleHashEntryData
 #define SH_KEY_TYPE MinimalTuple
 #define SH_KEY firstTuple
-#define SH_HASH_KEY(tb, key) TupleHashTableHash(tb, key)
+#define SH_HASH_KEY(tb, key) TupleHashTableHash_internal(tb, key)
 #define SH_EQUAL(tb, a, b) TupleHashTableMatch(tb, a, b) == 0
 #define SH_SCOPE extern
 #define SH_STORE_HASH
@@ -118,7 +121,61 @@ execTuplesHashPrepare(int numCols,
 		/* We're not supporting cross-type cases here */
 		Assert(left_hash_function == right_hash_function);
 		(*eqFuncOids)[i] = eq_function;
-		fmgr_info(right_hash_function, &(*hashFunctions)[i]);
+		execHashFunctionInfo(left_hash_function, right_hash_function,
+							 NULL, &(*hashFunctions)[i]);
+	}
+}
+
+/*
+ * execHashFunctionInfo
+ *		Look up the hash functions of a hashable equality operator, for use
+ *		in a hash table that lives only in this backend's memory.
+ *
+ * left_hashfn and right_hashfn are the hash functions for the operator's
+ * input types, as returned by get_op_hash_functions(); either FmgrInfo
+ * pointer may be NULL if the caller doesn't need it.  Hash values produced
+ * by the returned functions may differ from the SQL-visible functions, so
+ * callers must not mix them with hash values from anywhere else (hash
+ * indexes, partition bounds, ...).  Every in-memory hash table has to get
+ * its functions from here, though, so that e.g. a hash join's bloom filter
+ * agrees with its hash table.
+ *
+ * We substitute a faster hash for the common variable-length types.  That's
+ * only safe when both inputs use the same function; a cross-type operator
+ * needs the two functions to agree, and we only have fast versions of some.
+ */
+void
+execHashFunctionInfo(Oid left_hashfn, Oid right_hashfn,
+					 FmgrInfo *left_finfo, FmgrInfo *right_finfo)
+{
+	PGFunction	inmemory = NULL;
+
+	if (left_hashfn == right_hashfn)
+	{
+		switch (left_hashfn)
+		{
+			case F_HASHTEXT:
+				inmemory = hashtext_inmemory;
+				break;
+			case F_HASHVARLENA:
+				inmemory = hashvarlena_inmemory;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (left_finfo)
+	{
+		fmgr_info(left_hashfn, left_finfo);
+		if (inmemory)
+			left_finfo->fn_addr = inmemory;
+	}
+	if (right_finfo)
+	{
+		fmgr_info(right_hashfn, right_finfo);
+		if (inmemory)
+			right_finfo->fn_addr = inmemory;
 	}
 }
 
@@ -345,6 +402,29 @@ LookupTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
 	return entry;
 }
 
+/*
+ * Compute the hash value that LookupTupleHashEntry() would use for the given
+ * tuple.  The tuple must be the same type as the hashtable entries.
+ */
+uint32
+TupleHashTableHash(TupleHashTable hashtable, TupleTableSlot *slot)
+{
+	MemoryContext oldContext;
+	uint32		hash;
+
+	/* Need to run the hash functions in short-lived context */
+	oldContext = MemoryContextSwitchTo(hashtable->tempcxt);
+
+	hashtable->inputslot = slot;
+	hashtable->in_hash_funcs = hashtable->tab_hash_funcs;
+
+	hash = TupleHashTableHash_internal(hashtable->hashtab, NULL);
+
+	MemoryContextSwitchTo(oldContext);
+
+	return hash;
+}
+
 /*
  * Search for a hashtable entry matching the given tuple.  No entry is
  * created if there's not a match.  This is similar to the non-creating
@@ -393,7 +473,8 @@ FindTupleHashEntry(TupleHashTable hashtable, TupleTableSlot *slot,
  * the hash functions. (dynahash.c doesn't change CurrentMemoryContext.)
  */
 static uint32
-TupleHashTableHash(struct tuplehash_hash *tb, const MinimalTuple tuple)
+TupleHashTableHash_internal(struct tuplehash_hash *tb,
+							const MinimalTuple tuple)
 {
 	TupleHashTable hashtable = (TupleHashTable) tb->private_data;
 	int			numCols = hashtable->numCols;
@@ -106,6 +106,7 @@
  */
 #include "postgres.h"
 
+#include "access/amapi.h"
 #include "access/genam.h"
 #include "access/relscan.h"
 #include "access/tableam.h"
@@ -136,6 +137,11 @@ static bool check_exclusion_or_unique_constraint(Relation heap, Relation index,
 static bool index_recheck_constraint(Relation index, Oid *constr_procs,
 									 Datum *existing_values, bool *existing_isnull,
 									 Datum *new_values);
+static List *ExecInsertIndexTuplesGuts(TupleTableSlot *slot, EState *estate,
+									   bool noDupErr, bool *specConflict,
+									   List *arbiterIndexes, bool skipBatched);
+static bool ExecIndexCanBatchInsert(Relation indexRelation,
+									IndexInfo *indexInfo);
 
 /* ----------------------------------------------------------------
  *		ExecOpenIndices
@@ -275,6 +281,169 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 					  bool noDupErr,
 					  bool *specConflict,
 					  List *arbiterIndexes)
+{
+	return ExecInsertIndexTuplesGuts(slot, estate, noDupErr, specConflict,
+									 arbiterIndexes, false);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInsertIndexTuplesBatch
+ *
+ *		Insert index tuples for a batch of newly inserted heap tuples,
+ *		for those indexes of the result relation that can take them in
+ *		one go (see ExecIndexCanBatchInsert).  Such indexes have no
+ *		constraint to enforce, so there is nothing to report back.
+ *
+ *		The caller must then call ExecInsertUnbatchedIndexTuples for
+ *		each of the slots to take care of the remaining indexes.
+ *
+ *		The same CAUTION as for ExecInsertIndexTuples applies.
+ * ----------------------------------------------------------------
+ */
+void
+ExecInsertIndexTuplesBatch(TupleTableSlot **slots,
+						   int nslots,
+						   EState *estate)
+{
+	ResultRelInfo *resultRelInfo;
+	int			i;
+	int			numIndices;
+	RelationPtr relationDescs;
+	Relation	heapRelation;
+	IndexInfo **indexInfoArray;
+	ExprContext *econtext;
+
+	resultRelInfo = estate->es_result_relation_info;
+	numIndices = resultRelInfo->ri_NumIndices;
+	relationDescs = resultRelInfo->ri_IndexRelationDescs;
+	indexInfoArray = resultRelInfo->ri_IndexRelationInfo;
+	heapRelation = resultRelInfo->ri_RelationDesc;
+
+	econtext = GetPerTupleExprContext(estate);
+
+	for (i = 0; i < numIndices; i++)
+	{
+		Relation	indexRelation = relationDescs[i];
+		IndexInfo  *indexInfo;
+		ExprState  *predicate = NULL;
+		MemoryContext oldcontext;
+		Datum	  **values;
+		bool	  **isnull;
+		ItemPointer tupleids;
+		int			ntuples = 0;
+		int			j;
+
+		if (indexRelation == NULL)
+			continue;
+
+		indexInfo = indexInfoArray[i];
+
+		/* If the index is marked as read-only, ignore it */
+		if (!indexInfo->ii_ReadyForInserts)
+			continue;
+
+		if (!ExecIndexCanBatchInsert(indexRelation, indexInfo))
+			continue;
+
+		/* Set up predicate state for a partial index, as above */
+		if (indexInfo->ii_Predicate != NIL)
+		{
+			predicate = indexInfo->ii_PredicateState;
+			if (predicate == NULL)
+			{
+				predicate = ExecPrepareQual(indexInfo->ii_Predicate, estate);
+				indexInfo->ii_PredicateState = predicate;
+			}
+		}
+
+		/*
+		 * Everything we build here, including the results of any index
+		 * expressions, lives in the per-tuple context until the whole batch
+		 * has been handed to the index AM.
+		 */
+		oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+		values = (Datum **) palloc(sizeof(Datum *) * nslots);
+		isnull = (bool **) palloc(sizeof(bool *) * nslots);
+		tupleids = (ItemPointer) palloc(sizeof(ItemPointerData) * nslots);
+
+		for (j = 0; j < nslots; j++)
+		{
+			TupleTableSlot *slot = slots[j];
+
+			Assert(ItemPointerIsValid(&slot->tts_tid));
+			Assert(slot->tts_tableOid == RelationGetRelid(heapRelation));
+
+			econtext->ecxt_scantuple = slot;
+
+			/* Skip this tuple if the predicate isn't satisfied */
+			if (predicate != NULL && !ExecQual(predicate, econtext))
+				continue;
+
+			values[ntuples] = (Datum *)
+				palloc(sizeof(Datum) * indexInfo->ii_NumIndexAttrs);
+			isnull[ntuples] = (bool *)
+				palloc(sizeof(bool) * indexInfo->ii_NumIndexAttrs);
+			FormIndexDatum(indexInfo,
+						   slot,
+						   estate,
+						   values[ntuples],
+						   isnull[ntuples]);
+			tupleids[ntuples] = slot->tts_tid;
+			ntuples++;
+		}
+
+		if (ntuples > 0)
+			index_insert_batch(indexRelation,
+							   values,
+							   isnull,
+							   tupleids,
+							   ntuples,
+							   heapRelation,
+							   indexInfo);
+
+		MemoryContextSwitchTo(oldcontext);
+		ResetExprContext(econtext);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInsertUnbatchedIndexTuples
+ *
+ *		Like ExecInsertIndexTuples, but skips the indexes that
+ *		ExecInsertIndexTuplesBatch has already taken care of.
+ *		Speculative insertion is not supported.
+ * ----------------------------------------------------------------
+ */
+List *
+ExecInsertUnbatchedIndexTuples(TupleTableSlot *slot,
+							   EState *estate)
+{
+	return ExecInsertIndexTuplesGuts(slot, estate, false, NULL, NIL, true);
+}
+
+/*
+ * Can the index be maintained with ExecInsertIndexTuplesBatch?
+ *
+ * That requires the index AM to provide aminsertbatch, and the index must
+ * not enforce any constraint: unique and exclusion checks are done one
+ * tuple at a time, and errors are reported against that tuple.
+ */
+static bool
+ExecIndexCanBatchInsert(Relation indexRelation, IndexInfo *indexInfo)
+{
+	return indexRelation->rd_indam->aminsertbatch != NULL &&
+		!indexRelation->rd_index->indisunique &&
+		indexInfo->ii_ExclusionOps == NULL;
+}
+
+static List *
+ExecInsertIndexTuplesGuts(TupleTableSlot *slot,
+						  EState *estate,
+						  bool noDupErr,
+						  bool *specConflict,
+						  List *arbiterIndexes,
+						  bool skipBatched)
 {
 	ItemPointer tupleid = &slot->tts_tid;
 	List	   *result = NIL;
@@ -331,6 +500,10 @@ ExecInsertIndexTuples(TupleTableSlot *slot,
 		if (!indexInfo->ii_ReadyForInserts)
 			continue;
 
+		/* Skip indexes that ExecInsertIndexTuplesBatch already handled */
+		if (skipBatched && ExecIndexCanBatchInsert(indexRelation, indexInfo))
+			continue;
+
 		/* Check for partial index */
 		if (indexInfo->ii_Predicate != NIL)
 		{
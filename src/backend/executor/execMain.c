@@ -39,6 +39,7 @@
 
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/sysattr.h"
 #include "access/tableam.h"
 #include "access/transam.h"
@@ -58,12 +59,15 @@
 #include "storage/lmgr.h"
 #include "tcop/utility.h"
 #include "utils/acl.h"
+#include "utils/ash.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/partcache.h"
 #include "utils/rls.h"
 #include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
 
 
 /* Hooks for plugins to get control in ExecutorStart/Run/Finish/End */
@@ -75,6 +79,14 @@ ExecutorEnd_hook_type ExecutorEnd_hook = NULL;
 /* Hook for plugin to get control in ExecCheckRTPerms() */
 ExecutorCheckPerms_hook_type ExecutorCheckPerms_hook = NULL;
 
+/*
+ * Advanced whenever a catalog change could affect the outcome of
+ * ExecCheckRTPerms, so that the note InitPlan leaves in a PlannedStmt about
+ * passed permission checks can be recognized as stale.  Zero is never used.
+ */
+static uint64 exec_perms_generation = 1;
+static bool exec_perms_callbacks_registered = false;
+
 /* decls for local routines only used within this module */
 static void InitPlan(QueryDesc *queryDesc, int eflags);
 static void CheckValidRowMarkRel(Relation rel, RowMarkType markType);
@@ -88,6 +100,8 @@ static void ExecutePlan(EState *estate, PlanState *planstate,
 						ScanDirection direction,
 						DestReceiver *dest,
 						bool execute_once);
+static void ExecCheckPlannedStmtPerms(PlannedStmt *plannedstmt);
+static void ExecPermsInvalCallback(Datum arg, int cacheid, uint32 hashvalue);
 static bool ExecCheckRTEPerms(RangeTblEntry *rte);
 static bool ExecCheckRTEPermsModified(Oid relOid, Oid userid,
 									  Bitmapset *modifiedCols,
@@ -153,6 +167,7 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 {
 	EState	   *estate;
 	MemoryContext oldcontext;
+	MemoryPeakTracker mem_peak;
 
 	/* sanity checks: queryDesc must not be started already */
 	Assert(queryDesc != NULL);
@@ -177,10 +192,17 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 		!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
 		ExecCheckXactReadOnly(queryDesc->plannedstmt);
 
+	/*
+	 * Start tracking the query's memory peak before building the EState, so
+	 * that the EState counts too.
+	 */
+	MemoryContextBeginPeakTracking(&mem_peak);
+
 	/*
 	 * Build EState, switch into per-query memory context for startup.
 	 */
 	estate = CreateExecutorState();
+	estate->es_mem_peak = mem_peak;
 	queryDesc->estate = estate;
 
 	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
@@ -317,6 +339,7 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 	DestReceiver *dest;
 	bool		sendTuples;
 	MemoryContext oldcontext;
+	uint64		save_query_id;
 
 	/* sanity checks */
 	Assert(queryDesc != NULL);
@@ -361,6 +384,14 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 			elog(ERROR, "can't re-execute query flagged for single execution");
 		queryDesc->already_executed = true;
 
+		/*
+		 * Tell the session sampler which statement is running.  Nested
+		 * executor calls overwrite this, so restore the outer value once the
+		 * plan has run; after an error AshStopSampling resets it.
+		 */
+		save_query_id = AshCurrentQueryId;
+		AshCurrentQueryId = queryDesc->plannedstmt->queryId;
+
 		ExecutePlan(estate,
 					queryDesc->planstate,
 					queryDesc->plannedstmt->parallelModeNeeded,
@@ -370,6 +401,8 @@ standard_ExecutorRun(QueryDesc *queryDesc,
 					direction,
 					dest,
 					execute_once);
+
+		AshCurrentQueryId = save_query_id;
 	}
 
 	/*
@@ -504,6 +537,8 @@ standard_ExecutorEnd(QueryDesc *queryDesc)
 	 */
 	MemoryContextSwitchTo(oldcontext);
 
+	MemoryContextEndPeakTracking(&estate->es_mem_peak);
+
 	/*
 	 * Release EState and per-query memory context.  This should release
 	 * everything the executor has allocated.
@@ -594,6 +629,59 @@ ExecCheckRTPerms(List *rangeTable, bool ereport_on_violation)
 	return result;
 }
 
+/*
+ * ExecCheckPlannedStmtPerms
+ *		Check access permissions for the range table of a plan about to be
+ *		executed, unless they already passed for the same plan.
+ *
+ * A cached plan is typically executed many times by the same user, and
+ * checking every RTE each time is a noticeable part of executor startup for
+ * short queries.  After a successful check we note the user and the current
+ * exec_perms_generation in the PlannedStmt; later executions can skip the
+ * checks as long as the user is the same and no catalog change that could
+ * affect privileges (of relations, columns or roles) has been seen since.
+ * We always check when a plugin hooks in, since we don't know what its
+ * verdict depends on.
+ */
+static void
+ExecCheckPlannedStmtPerms(PlannedStmt *plannedstmt)
+{
+	Oid			userid = GetUserId();
+
+	if (ExecutorCheckPerms_hook == NULL &&
+		plannedstmt->permsCheckedAs == userid &&
+		plannedstmt->permsCheckedGen == exec_perms_generation)
+		return;
+
+	ExecCheckRTPerms(plannedstmt->rtable, true);
+
+	if (!exec_perms_callbacks_registered)
+	{
+		CacheRegisterSyscacheCallback(RELOID,
+									  ExecPermsInvalCallback, (Datum) 0);
+		CacheRegisterSyscacheCallback(ATTNUM,
+									  ExecPermsInvalCallback, (Datum) 0);
+		CacheRegisterSyscacheCallback(AUTHOID,
+									  ExecPermsInvalCallback, (Datum) 0);
+		CacheRegisterSyscacheCallback(AUTHMEMROLEMEM,
+									  ExecPermsInvalCallback, (Datum) 0);
+		exec_perms_callbacks_registered = true;
+	}
+
+	plannedstmt->permsCheckedAs = userid;
+	plannedstmt->permsCheckedGen = exec_perms_generation;
+}
+
+/*
+ * ExecPermsInvalCallback
+ *		Syscache inval callback: forget all passed permission checks.
+ */
+static void
+ExecPermsInvalCallback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	exec_perms_generation++;
+}
+
 /*
  * ExecCheckRTEPerms
  *		Check access permissions for a single RTE.
@@ -790,7 +878,13 @@ ExecCheckXactReadOnly(PlannedStmt *plannedstmt)
 		PreventCommandIfReadOnly(CreateCommandTag((Node *) plannedstmt));
 	}
 
-	if (plannedstmt->commandType != CMD_SELECT || plannedstmt->hasModifyingCTE)
+	/*
+	 * A parallel worker may run the INSERT of a parallel INSERT ... SELECT;
+	 * the planner has made sure that's safe.
+	 */
+	if ((plannedstmt->commandType != CMD_SELECT &&
+		 !(plannedstmt->commandType == CMD_INSERT && IsParallelWorker())) ||
+		plannedstmt->hasModifyingCTE)
 		PreventCommandIfParallelMode(CreateCommandTag((Node *) plannedstmt));
 }
 
@@ -818,7 +912,7 @@ InitPlan(QueryDesc *queryDesc, int eflags)
 	/*
 	 * Do permissions checks
 	 */
-	ExecCheckRTPerms(rangeTable, true);
+	ExecCheckPlannedStmtPerms(plannedstmt);
 
 	/*
 	 * initialize the node's execution state
@@ -1630,7 +1724,16 @@ ExecutePlan(EState *estate,
 
 	estate->es_use_parallel_mode = use_parallel_mode;
 	if (use_parallel_mode)
+	{
+		/*
+		 * An INSERT may be carried out by parallel workers, which use our
+		 * transaction ID but can't assign it themselves.  The command ID has
+		 * already been marked used by standard_ExecutorStart.
+		 */
+		if (operation == CMD_INSERT)
+			(void) GetCurrentTransactionId();
 		EnterParallelMode();
+	}
 
 	/*
 	 * Loop until we've processed the proper number of tuples from the plan.
@@ -33,6 +33,7 @@
 #include "utils/rel.h"
 #include "utils/rls.h"
 #include "utils/ruleutils.h"
+#include "utils/snapmgr.h"
 
 
 /*-----------------------
@@ -127,6 +128,14 @@ struct PartitionTupleRouting
  *		routing it through this table). A NULL value is stored if no tuple
  *		conversion is required.
  *
+ * last_found_datum_index, last_found_part_index, last_found_count
+ *		The bound offset and partition index last found by
+ *		get_partition_for_tuple() for a list or range partitioned table, and
+ *		how many times in a row it has been found.  Once that reaches
+ *		PARTITION_CACHED_FIND_THRESHOLD, the bound is checked before doing a
+ *		binary search, which makes routing rows that all go to the same
+ *		partition, such as rows with ascending timestamps, much cheaper.
+ *
  * indexes
  *		Array of partdesc->nparts elements.  For leaf partitions the index
  *		corresponds to the partition's ResultRelInfo in the encapsulating
@@ -144,9 +153,18 @@ typedef struct PartitionDispatchData
 	PartitionDesc partdesc;
 	TupleTableSlot *tupslot;
 	AttrNumber *tupmap;
+	int			last_found_datum_index;
+	int			last_found_part_index;
+	int			last_found_count;
 	int			indexes[FLEXIBLE_ARRAY_MEMBER];
 }			PartitionDispatchData;
 
+/*
+ * Number of consecutive times get_partition_for_tuple() must find the same
+ * bound before it starts checking that bound first.
+ */
+#define PARTITION_CACHED_FIND_THRESHOLD		16
+
 /* struct to hold result relations coming from UPDATE subplans */
 typedef struct SubplanResultRelHashElem
 {
@@ -1028,6 +1046,9 @@ ExecInitPartitionDispatchInfo(EState *estate,
 	pd->key = RelationGetPartitionKey(rel);
 	pd->keystate = NIL;
 	pd->partdesc = partdesc;
+	pd->last_found_datum_index = -1;
+	pd->last_found_part_index = -1;
+	pd->last_found_count = 0;
 	if (parent_pd != NULL)
 	{
 		TupleDesc	tupdesc = RelationGetDescr(rel);
@@ -1231,11 +1252,15 @@ FormPartitionKeyDatum(PartitionDispatch pd,
  *
  * Return value is index of the partition (>= 0 and < partdesc->nparts) if one
  * found or -1 if none found.
+ *
+ * For list and range partitioning, when the same bound has been found many
+ * times in a row, we check whether the tuple still matches it before doing
+ * a binary search over all the bounds.
  */
 static int
 get_partition_for_tuple(PartitionDispatch pd, Datum *values, bool *isnull)
 {
-	int			bound_offset;
+	int			bound_offset = -1;
 	int			part_index = -1;
 	PartitionKey key = pd->key;
 	PartitionDesc partdesc = pd->partdesc;
@@ -1269,6 +1294,20 @@ get_partition_for_tuple(PartitionDispatch pd, Datum *values, bool *isnull)
 			{
 				bool		equal = false;
 
+				if (pd->last_found_count >= PARTITION_CACHED_FIND_THRESHOLD)
+				{
+					int			last_offset = pd->last_found_datum_index;
+					int32		cmpval;
+
+					cmpval = DatumGetInt32(FunctionCall2Coll(&key->partsupfunc[0],
+															 key->partcollation[0],
+															 boundinfo->datums[last_offset][0],
+															 values[0]));
+					if (cmpval == 0)
+						return pd->last_found_part_index;
+					/* else fall through to a binary search */
+				}
+
 				bound_offset = partition_list_bsearch(key->partsupfunc,
 													  key->partcollation,
 													  boundinfo,
@@ -1297,6 +1336,39 @@ get_partition_for_tuple(PartitionDispatch pd, Datum *values, bool *isnull)
 					}
 				}
 
+				if (!range_partkey_has_null &&
+					pd->last_found_count >= PARTITION_CACHED_FIND_THRESHOLD)
+				{
+					int			last_offset = pd->last_found_datum_index;
+					int32		cmpval;
+
+					/*
+					 * The tuple belongs to the same partition if it's at or
+					 * above the lower bound found last time and below the
+					 * next bound.  The lower bound may be -1, meaning minus
+					 * infinity, and there may be no next bound.
+					 */
+					cmpval = last_offset < 0 ? -1 :
+						partition_rbound_datum_cmp(key->partsupfunc,
+												   key->partcollation,
+												   boundinfo->datums[last_offset],
+												   boundinfo->kind[last_offset],
+												   values,
+												   key->partnatts);
+					if (cmpval == 0)
+						return pd->last_found_part_index;
+					if (cmpval < 0 &&
+						(last_offset + 1 >= boundinfo->ndatums ||
+						 partition_rbound_datum_cmp(key->partsupfunc,
+													key->partcollation,
+													boundinfo->datums[last_offset + 1],
+													boundinfo->kind[last_offset + 1],
+													values,
+													key->partnatts) > 0))
+						return pd->last_found_part_index;
+					/* else fall through to a binary search */
+				}
+
 				if (!range_partkey_has_null)
 				{
 					bound_offset = partition_range_datum_bsearch(key->partsupfunc,
@@ -1324,10 +1396,32 @@ get_partition_for_tuple(PartitionDispatch pd, Datum *values, bool *isnull)
 
 	/*
 	 * part_index < 0 means we failed to find a partition of this parent. Use
-	 * the default partition, if there is one.
+	 * the default partition, if there is one.  We don't remember that, as
+	 * the rows going there needn't have anything in common.
 	 */
 	if (part_index < 0)
-		part_index = boundinfo->default_index;
+	{
+		pd->last_found_count = 0;
+		return boundinfo->default_index;
+	}
+
+	/*
+	 * Remember the bound we found, for range partitioning and for non-null
+	 * list partition keys.
+	 */
+	if (key->strategy == PARTITION_STRATEGY_RANGE ||
+		(key->strategy == PARTITION_STRATEGY_LIST && bound_offset >= 0))
+	{
+		if (pd->last_found_count > 0 &&
+			bound_offset == pd->last_found_datum_index)
+			pd->last_found_count++;
+		else
+		{
+			pd->last_found_datum_index = bound_offset;
+			pd->last_found_part_index = part_index;
+			pd->last_found_count = 1;
+		}
+	}
 
 	return part_index;
 }
@@ -1536,6 +1630,10 @@ adjust_partition_tlist(List *tlist, TupleConversionMap *map)
  *		expressions.  This function can only be called during execution and
  *		must be called again each time the value of a Param listed in
  *		PartitionPruneState's 'execparamids' changes.
+ *
+ * ExecInitialPruningRelids:
+ *		Performs the initial pruning of a whole PlannedStmt ahead of executor
+ *		startup, to find out which partitions need to be locked for it.
  *-------------------------------------------------------------------------
  */
 
@@ -2039,6 +2137,88 @@ ExecFindMatchingSubPlans(PartitionPruneState *prunestate)
 	return result;
 }
 
+/*
+ * ExecInitialPruningRelids
+ *		Determine which of the relations in plannedstmt->prunableRelids are
+ *		scanned by subplans that survive initial pruning with the given
+ *		Param values.
+ *
+ * This lets the plan cache lock only the partitions a generic plan will
+ * actually scan; see AcquireExecutorLocks().  All the relations that are not
+ * in prunableRelids, which include the partitioned tables the pruning steps
+ * refer to, must be locked already.
+ *
+ * The executor repeats the pruning at startup, and locks any prunable
+ * relation it keeps that hasn't been locked here.
+ */
+Bitmapset *
+ExecInitialPruningRelids(PlannedStmt *plannedstmt, ParamListInfo params)
+{
+	EState	   *estate;
+	PlanState  *planstate;
+	MemoryContext oldcontext;
+	Bitmapset  *survivors = NULL;
+	Bitmapset  *result;
+	bool		snapshot_set = false;
+	ListCell   *lc;
+	int			i;
+
+	estate = CreateExecutorState();
+	estate->es_param_list_info = params;
+	ExecInitRangeTable(estate, plannedstmt->rtable);
+
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+
+	/* The pruning expressions need a parent node to be evaluated in */
+	planstate = makeNode(PlanState);
+	planstate->state = estate;
+	ExecAssignExprContext(estate, planstate);
+
+	/* ... and stable functions in them may need a snapshot */
+	if (!ActiveSnapshotSet())
+	{
+		PushActiveSnapshot(GetTransactionSnapshot());
+		snapshot_set = true;
+	}
+
+	foreach(lc, plannedstmt->partPruneInfos)
+	{
+		PartitionPruneInfo *pruneinfo = lfirst_node(PartitionPruneInfo, lc);
+		PartitionPruneState *prunestate;
+		Bitmapset  *validsubplans;
+
+		prunestate = ExecCreatePartitionPruneState(planstate, pruneinfo);
+		validsubplans = ExecFindInitialMatchingSubPlans(prunestate,
+														pruneinfo->nsubplans);
+
+		i = -1;
+		while ((i = bms_next_member(validsubplans, i)) >= 0)
+		{
+			if (pruneinfo->subplan_rtis[i] > 0)
+				survivors = bms_add_member(survivors,
+										   pruneinfo->subplan_rtis[i]);
+		}
+	}
+
+	if (snapshot_set)
+		PopActiveSnapshot();
+
+	/* Close the partitioned tables opened for pruning, but keep the locks */
+	for (i = 0; i < estate->es_range_table_size; i++)
+	{
+		if (estate->es_relations[i])
+			table_close(estate->es_relations[i], NoLock);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	result = bms_intersect(survivors, plannedstmt->prunableRelids);
+
+	FreeExecutorState(estate);
+
+	return result;
+}
+
 /*
  * find_matching_subplans_recurse
  *		Recursive worker function for ExecFindMatchingSubPlans and
@@ -19,6 +19,7 @@
 #include "access/tableam.h"
 #include "access/transam.h"
 #include "access/xact.h"
+#include "catalog/pg_am.h"
 #include "commands/trigger.h"
 #include "executor/executor.h"
 #include "executor/nodeModifyTable.h"
@@ -56,9 +57,16 @@ build_replindex_scan_key(ScanKey skey, Relation rel, Relation idxrel,
 	oidvector  *opclass;
 	int2vector *indkey = &idxrel->rd_index->indkey;
 	bool		hasnulls = false;
+	StrategyNumber eqstrategy;
 
 	Assert(RelationGetReplicaIndex(rel) == RelationGetRelid(idxrel));
 
+	/* Unique indexes are either btree or hash indexes */
+	if (idxrel->rd_rel->relam == HASH_AM_OID)
+		eqstrategy = HTEqualStrategyNumber;
+	else
+		eqstrategy = BTEqualStrategyNumber;
+
 	indclassDatum = SysCacheGetAttr(INDEXRELID, idxrel->rd_indextuple,
 									Anum_pg_index_indclass, &isnull);
 	Assert(!isnull);
@@ -82,17 +90,17 @@ build_replindex_scan_key(ScanKey skey, Relation rel, Relation idxrel,
 
 		operator = get_opfamily_member(opfamily, optype,
 									   optype,
-									   BTEqualStrategyNumber);
+									   eqstrategy);
 		if (!OidIsValid(operator))
 			elog(ERROR, "missing operator %d(%u,%u) in opfamily %u",
-				 BTEqualStrategyNumber, optype, optype, opfamily);
+				 eqstrategy, optype, optype, opfamily);
 
 		regop = get_opcode(operator);
 
 		/* Initialize the scankey. */
 		ScanKeyInit(&skey[attoff],
 					pkattno,
-					BTEqualStrategyNumber,
+					eqstrategy,
 					regop,
 					searchslot->tts_values[mainattno - 1]);
 
@@ -63,6 +63,7 @@
 #include "funcapi.h"
 #include "catalog/pg_type.h"
 #include "nodes/nodeFuncs.h"
+#include "port/pg_bitutils.h"
 #include "storage/bufmgr.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -871,6 +872,31 @@ tts_buffer_heap_store_tuple(TupleTableSlot *slot, HeapTuple tuple,
 	}
 }
 
+/*
+ * first_null_attr
+ *		Return the number of the first null attribute in [start, end) according
+ *		to the null bitmap bp, or end if there is none.
+ *
+ * The bitmap has a bit set for each non-null attribute, so we look for the
+ * first clear bit, a byte (eight attributes) at a time.
+ */
+static inline int
+first_null_attr(bits8 *bp, int start, int end)
+{
+	int			attnum = start;
+
+	while (attnum < end)
+	{
+		uint8		nulls = ~bp[attnum >> 3] & (0xFF << (attnum & 0x07));
+
+		if (nulls != 0)
+			return Min(end, (attnum & ~0x07) + pg_rightmost_one_pos[nulls]);
+		attnum = (attnum & ~0x07) + 8;
+	}
+
+	return end;
+}
+
 /*
  * slot_deform_heap_tuple
  *		Given a TupleTableSlot, extract data from the slot's physical tuple
@@ -923,6 +949,32 @@ slot_deform_heap_tuple(TupleTableSlot *slot, HeapTuple tuple, uint32 *offp,
 
 	tp = (char *) tup + tup->t_hoff;
 
+	/*
+	 * Fast path for the leading fixed-width attributes: as long as none of
+	 * them is null, each is found at its cached offset, so there's no need
+	 * for the alignment and null checks of the general loop below.
+	 */
+	if (!slow)
+	{
+		int			nfixed = Min(TupleDescFixedPrefix(tupleDesc), natts);
+
+		if (hasnulls)
+			nfixed = first_null_attr(bp, attnum, nfixed);
+
+		if (attnum < nfixed)
+		{
+			Form_pg_attribute thisatt = NULL;
+
+			for (; attnum < nfixed; attnum++)
+			{
+				thisatt = TupleDescAttr(tupleDesc, attnum);
+				values[attnum] = fetchatt(thisatt, tp + thisatt->attcacheoff);
+				isnull[attnum] = false;
+			}
+			off = thisatt->attcacheoff + thisatt->attlen;
+		}
+	}
+
 	for (; attnum < natts; attnum++)
 	{
 		Form_pg_attribute thisatt = TupleDescAttr(tupleDesc, attnum);
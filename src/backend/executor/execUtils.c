@@ -778,7 +778,9 @@ ExecGetRangeTableRelation(EState *estate, Index rti)
 
 		Assert(rte->rtekind == RTE_RELATION);
 
-		if (!IsParallelWorker())
+		if (!IsParallelWorker() &&
+			(estate->es_plannedstmt == NULL ||
+			 !bms_is_member(rti, estate->es_plannedstmt->prunableRelids)))
 		{
 			/*
 			 * In a normal query, we should already have the appropriate lock,
@@ -796,7 +798,10 @@ ExecGetRangeTableRelation(EState *estate, Index rti)
 			/*
 			 * If we are a parallel worker, we need to obtain our own local
 			 * lock on the relation.  This ensures sane behavior in case the
-			 * parent process exits before we do.
+			 * parent process exits before we do.  Partitions whose scans
+			 * survived initial pruning may not have been locked yet either;
+			 * usually the plan cache has done so already, which makes this
+			 * cheap.
 			 */
 			rel = table_open(rte->relid, rte->rellockmode);
 		}
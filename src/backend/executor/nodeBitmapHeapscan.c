@@ -37,6 +37,7 @@
 
 #include <math.h>
 
+#include "access/htup_details.h"
 #include "access/relscan.h"
 #include "access/tableam.h"
 #include "access/transam.h"
@@ -55,6 +56,8 @@
 
 static TupleTableSlot *BitmapHeapNext(BitmapHeapScanState *node);
 static inline void BitmapDoneInitializingSharedState(ParallelBitmapHeapState *pstate);
+static TBMIterateResult *BitmapSharedIterate(BitmapHeapScanState *node);
+static bool BitmapClaimSharedPage(BitmapHeapScanState *node, bool prefetch);
 static inline void BitmapAdjustPrefetchIterator(BitmapHeapScanState *node,
 												TBMIterateResult *tbmres);
 static inline void BitmapAdjustPrefetchTarget(BitmapHeapScanState *node);
@@ -76,7 +79,6 @@ BitmapHeapNext(BitmapHeapScanState *node)
 	TableScanDesc scan;
 	TIDBitmap  *tbm;
 	TBMIterator *tbmiterator = NULL;
-	TBMSharedIterator *shared_tbmiterator = NULL;
 	TBMIterateResult *tbmres;
 	TupleTableSlot *slot;
 	ParallelBitmapHeapState *pstate = node->pstate;
@@ -91,8 +93,6 @@ BitmapHeapNext(BitmapHeapScanState *node)
 	tbm = node->tbm;
 	if (pstate == NULL)
 		tbmiterator = node->tbmiterator;
-	else
-		shared_tbmiterator = node->shared_tbmiterator;
 	tbmres = node->tbmres;
 
 	/*
@@ -106,6 +106,13 @@ BitmapHeapNext(BitmapHeapScanState *node)
 	 * desired prefetch distance, which starts small and increases up to the
 	 * node->prefetch_maximum.  This is to avoid doing a lot of prefetching in
 	 * a scan that stops after a few tuples because of a LIMIT.
+	 *
+	 * In a parallel scan, a second shared iterator would hand out pages that
+	 * are then read by some other process, and keeping the shared prefetch
+	 * distance in step takes a spinlock for every page.  Instead, each
+	 * process claims pages from the shared iterator ahead of time into its
+	 * own queue, and prefetches exactly the pages it is going to read; see
+	 * BitmapSharedIterate.
 	 */
 	if (!node->initialized)
 	{
@@ -150,35 +157,39 @@ BitmapHeapNext(BitmapHeapScanState *node)
 				 * multiple processes to iterate jointly.
 				 */
 				pstate->tbmiterator = tbm_prepare_shared_iterate(tbm);
-#ifdef USE_PREFETCH
-				if (node->prefetch_maximum > 0)
-				{
-					pstate->prefetch_iterator =
-						tbm_prepare_shared_iterate(tbm);
-
-					/*
-					 * We don't need the mutex here as we haven't yet woke up
-					 * others.
-					 */
-					pstate->prefetch_pages = 0;
-					pstate->prefetch_target = -1;
-				}
-#endif
-
 				/* We have initialized the shared state so wake up others. */
 				BitmapDoneInitializingSharedState(pstate);
 			}
 
 			/* Allocate a private iterator and attach the shared state to it */
-			node->shared_tbmiterator = shared_tbmiterator =
+			node->shared_tbmiterator =
 				tbm_attach_shared_iterate(dsa, pstate->tbmiterator);
 			node->tbmres = tbmres = NULL;
 
 #ifdef USE_PREFETCH
 			if (node->prefetch_maximum > 0)
 			{
-				node->shared_prefetch_iterator =
-					tbm_attach_shared_iterate(dsa, pstate->prefetch_iterator);
+				/*
+				 * One slot more than the maximum distance, for the page
+				 * currently being scanned.  The queue survives rescans.
+				 */
+				if (node->prefetch_queue == NULL)
+				{
+					Size		slotsize;
+					int			i;
+
+					slotsize = offsetof(TBMIterateResult, offsets) +
+						MaxHeapTuplesPerPage * sizeof(OffsetNumber);
+					node->prefetch_queue = (TBMIterateResult **)
+						palloc((node->prefetch_maximum + 1) *
+							   sizeof(TBMIterateResult *));
+					for (i = 0; i <= node->prefetch_maximum; i++)
+						node->prefetch_queue[i] = palloc(slotsize);
+				}
+				node->prefetch_head = 0;
+				node->prefetch_pages = 0;
+				node->prefetch_target = -1;
+				node->shared_exhausted = false;
 			}
 #endif							/* USE_PREFETCH */
 		}
@@ -199,7 +210,7 @@ BitmapHeapNext(BitmapHeapScanState *node)
 			if (!pstate)
 				node->tbmres = tbmres = tbm_iterate(tbmiterator);
 			else
-				node->tbmres = tbmres = tbm_shared_iterate(shared_tbmiterator);
+				node->tbmres = tbmres = BitmapSharedIterate(node);
 			if (tbmres == NULL)
 			{
 				/* no more entries in the bitmap */
@@ -259,19 +270,8 @@ BitmapHeapNext(BitmapHeapScanState *node)
 			 * Try to prefetch at least a few pages even before we get to the
 			 * second page if we don't stop reading after the first tuple.
 			 */
-			if (!pstate)
-			{
-				if (node->prefetch_target < node->prefetch_maximum)
-					node->prefetch_target++;
-			}
-			else if (pstate->prefetch_target < node->prefetch_maximum)
-			{
-				/* take spinlock while updating shared state */
-				SpinLockAcquire(&pstate->mutex);
-				if (pstate->prefetch_target < node->prefetch_maximum)
-					pstate->prefetch_target++;
-				SpinLockRelease(&pstate->mutex);
-			}
+			if (node->prefetch_target < node->prefetch_maximum)
+				node->prefetch_target++;
 #endif							/* USE_PREFETCH */
 		}
 
@@ -354,6 +354,95 @@ BitmapDoneInitializingSharedState(ParallelBitmapHeapState *pstate)
 	ConditionVariableBroadcast(&pstate->cv);
 }
 
+/*
+ *	BitmapSharedIterate - Get the next page to scan in a parallel scan
+ *
+ *	Without prefetching, this is just the next page from the shared iterator.
+ *	Otherwise the page comes from the queue of pages this process has already
+ *	claimed, and prefetched, in BitmapPrefetch.  The result stays valid until
+ *	the next call.
+ */
+static TBMIterateResult *
+BitmapSharedIterate(BitmapHeapScanState *node)
+{
+	TBMIterateResult *tbmres;
+
+	if (node->prefetch_queue == NULL)
+		return tbm_shared_iterate(node->shared_tbmiterator);
+
+	/* Claim a page now if we haven't got any queued up */
+	if (node->prefetch_pages == 0 && !BitmapClaimSharedPage(node, false))
+		return NULL;
+
+	tbmres = node->prefetch_queue[node->prefetch_head];
+	node->prefetch_head = (node->prefetch_head + 1) % (node->prefetch_maximum + 1);
+	node->prefetch_pages--;
+
+	return tbmres;
+}
+
+/*
+ *	BitmapClaimSharedPage - Add the next page from the shared iterator to the
+ *	queue of pages this process will scan
+ *
+ *	If 'prefetch' is true, also issue a prefetch request for the page, unless
+ *	we expect not to have to read it.  Returns false when the shared iterator
+ *	is exhausted.
+ *
+ *	The caller must make sure that there is room in the queue: it has one
+ *	slot more than the maximum prefetch distance, and the slot just before
+ *	prefetch_head holds the page currently being scanned.
+ */
+static bool
+BitmapClaimSharedPage(BitmapHeapScanState *node, bool prefetch)
+{
+	TBMIterateResult *tbmpre;
+	TBMIterateResult *slot;
+	int			ntuples;
+
+	Assert(node->prefetch_pages < node->prefetch_maximum);
+
+	if (node->shared_exhausted)
+		return false;
+
+	tbmpre = tbm_shared_iterate(node->shared_tbmiterator);
+	if (tbmpre == NULL)
+	{
+		node->shared_exhausted = true;
+		return false;
+	}
+
+	/* The iterator reuses its result struct, so take a copy */
+	ntuples = Max(tbmpre->ntuples, 0);
+	slot = node->prefetch_queue[(node->prefetch_head + node->prefetch_pages) %
+								(node->prefetch_maximum + 1)];
+	memcpy(slot, tbmpre,
+		   offsetof(TBMIterateResult, offsets) + ntuples * sizeof(OffsetNumber));
+	node->prefetch_pages++;
+
+	if (prefetch)
+	{
+		/*
+		 * Unlike the non-parallel case, we know exactly which page we will
+		 * read next and whether it needs rechecking, so there's no need to
+		 * guess whether we can skip fetching it.
+		 */
+		bool		skip_fetch;
+
+		skip_fetch = (node->can_skip_fetch &&
+					  !slot->recheck &&
+					  VM_ALL_VISIBLE(node->ss.ss_currentRelation,
+									 slot->blockno,
+									 &node->pvmbuffer));
+
+		if (!skip_fetch)
+			PrefetchBuffer(node->ss.ss_currentRelation, MAIN_FORKNUM,
+						   slot->blockno);
+	}
+
+	return true;
+}
+
 /*
  *	BitmapAdjustPrefetchIterator - Adjust the prefetch iterator
  */
@@ -364,52 +453,24 @@ BitmapAdjustPrefetchIterator(BitmapHeapScanState *node,
 #ifdef USE_PREFETCH
 	ParallelBitmapHeapState *pstate = node->pstate;
 
-	if (pstate == NULL)
-	{
-		TBMIterator *prefetch_iterator = node->prefetch_iterator;
-
-		if (node->prefetch_pages > 0)
-		{
-			/* The main iterator has closed the distance by one page */
-			node->prefetch_pages--;
-		}
-		else if (prefetch_iterator)
-		{
-			/* Do not let the prefetch iterator get behind the main one */
-			TBMIterateResult *tbmpre = tbm_iterate(prefetch_iterator);
+	TBMIterator *prefetch_iterator = node->prefetch_iterator;
 
-			if (tbmpre == NULL || tbmpre->blockno != tbmres->blockno)
-				elog(ERROR, "prefetch and main iterators are out of sync");
-		}
+	/* In a parallel scan, BitmapSharedIterate already took it off the queue */
+	if (pstate != NULL)
 		return;
-	}
 
-	if (node->prefetch_maximum > 0)
+	if (node->prefetch_pages > 0)
 	{
-		TBMSharedIterator *prefetch_iterator = node->shared_prefetch_iterator;
-
-		SpinLockAcquire(&pstate->mutex);
-		if (pstate->prefetch_pages > 0)
-		{
-			pstate->prefetch_pages--;
-			SpinLockRelease(&pstate->mutex);
-		}
-		else
-		{
-			/* Release the mutex before iterating */
-			SpinLockRelease(&pstate->mutex);
+		/* The main iterator has closed the distance by one page */
+		node->prefetch_pages--;
+	}
+	else if (prefetch_iterator)
+	{
+		/* Do not let the prefetch iterator get behind the main one */
+		TBMIterateResult *tbmpre = tbm_iterate(prefetch_iterator);
 
-			/*
-			 * In case of shared mode, we can not ensure that the current
-			 * blockno of the main iterator and that of the prefetch iterator
-			 * are same.  It's possible that whatever blockno we are
-			 * prefetching will be processed by another process.  Therefore,
-			 * we don't validate the blockno here as we do in non-parallel
-			 * case.
-			 */
-			if (prefetch_iterator)
-				tbm_shared_iterate(prefetch_iterator);
-		}
+		if (tbmpre == NULL || tbmpre->blockno != tbmres->blockno)
+			elog(ERROR, "prefetch and main iterators are out of sync");
 	}
 #endif							/* USE_PREFETCH */
 }
@@ -426,35 +487,14 @@ static inline void
 BitmapAdjustPrefetchTarget(BitmapHeapScanState *node)
 {
 #ifdef USE_PREFETCH
-	ParallelBitmapHeapState *pstate = node->pstate;
-
-	if (pstate == NULL)
-	{
-		if (node->prefetch_target >= node->prefetch_maximum)
-			 /* don't increase any further */ ;
-		else if (node->prefetch_target >= node->prefetch_maximum / 2)
-			node->prefetch_target = node->prefetch_maximum;
-		else if (node->prefetch_target > 0)
-			node->prefetch_target *= 2;
-		else
-			node->prefetch_target++;
-		return;
-	}
-
-	/* Do an unlocked check first to save spinlock acquisitions. */
-	if (pstate->prefetch_target < node->prefetch_maximum)
-	{
-		SpinLockAcquire(&pstate->mutex);
-		if (pstate->prefetch_target >= node->prefetch_maximum)
-			 /* don't increase any further */ ;
-		else if (pstate->prefetch_target >= node->prefetch_maximum / 2)
-			pstate->prefetch_target = node->prefetch_maximum;
-		else if (pstate->prefetch_target > 0)
-			pstate->prefetch_target *= 2;
-		else
-			pstate->prefetch_target++;
-		SpinLockRelease(&pstate->mutex);
-	}
+	if (node->prefetch_target >= node->prefetch_maximum)
+		 /* don't increase any further */ ;
+	else if (node->prefetch_target >= node->prefetch_maximum / 2)
+		node->prefetch_target = node->prefetch_maximum;
+	else if (node->prefetch_target > 0)
+		node->prefetch_target *= 2;
+	else
+		node->prefetch_target++;
 #endif							/* USE_PREFETCH */
 }
 
@@ -512,53 +552,14 @@ BitmapPrefetch(BitmapHeapScanState *node, TableScanDesc scan)
 		return;
 	}
 
-	if (pstate->prefetch_pages < pstate->prefetch_target)
-	{
-		TBMSharedIterator *prefetch_iterator = node->shared_prefetch_iterator;
-
-		if (prefetch_iterator)
-		{
-			while (1)
-			{
-				TBMIterateResult *tbmpre;
-				bool		do_prefetch = false;
-				bool		skip_fetch;
-
-				/*
-				 * Recheck under the mutex. If some other process has already
-				 * done enough prefetching then we need not to do anything.
-				 */
-				SpinLockAcquire(&pstate->mutex);
-				if (pstate->prefetch_pages < pstate->prefetch_target)
-				{
-					pstate->prefetch_pages++;
-					do_prefetch = true;
-				}
-				SpinLockRelease(&pstate->mutex);
-
-				if (!do_prefetch)
-					return;
-
-				tbmpre = tbm_shared_iterate(prefetch_iterator);
-				if (tbmpre == NULL)
-				{
-					/* No more pages to prefetch */
-					tbm_end_shared_iterate(prefetch_iterator);
-					node->shared_prefetch_iterator = NULL;
-					break;
-				}
-
-				/* As above, skip prefetch if we expect not to need page */
-				skip_fetch = (node->can_skip_fetch &&
-							  (node->tbmres ? !node->tbmres->recheck : false) &&
-							  VM_ALL_VISIBLE(node->ss.ss_currentRelation,
-											 tbmpre->blockno,
-											 &node->pvmbuffer));
+	if (node->prefetch_queue == NULL)
+		return;
 
-				if (!skip_fetch)
-					PrefetchBuffer(scan->rs_rd, MAIN_FORKNUM, tbmpre->blockno);
-			}
-		}
+	/* Claim pages for this process until the queue is deep enough */
+	while (node->prefetch_pages < node->prefetch_target)
+	{
+		if (!BitmapClaimSharedPage(node, true))
+			break;
 	}
 #endif							/* USE_PREFETCH */
 }
@@ -614,8 +615,6 @@ ExecReScanBitmapHeapScan(BitmapHeapScanState *node)
 		tbm_end_iterate(node->prefetch_iterator);
 	if (node->shared_tbmiterator)
 		tbm_end_shared_iterate(node->shared_tbmiterator);
-	if (node->shared_prefetch_iterator)
-		tbm_end_shared_iterate(node->shared_prefetch_iterator);
 	if (node->tbm)
 		tbm_free(node->tbm);
 	if (node->vmbuffer != InvalidBuffer)
@@ -628,7 +627,9 @@ ExecReScanBitmapHeapScan(BitmapHeapScanState *node)
 	node->prefetch_iterator = NULL;
 	node->initialized = false;
 	node->shared_tbmiterator = NULL;
-	node->shared_prefetch_iterator = NULL;
+	node->prefetch_head = 0;
+	node->prefetch_pages = 0;
+	node->shared_exhausted = false;
 	node->vmbuffer = InvalidBuffer;
 	node->pvmbuffer = InvalidBuffer;
 
@@ -684,8 +685,6 @@ ExecEndBitmapHeapScan(BitmapHeapScanState *node)
 		tbm_free(node->tbm);
 	if (node->shared_tbmiterator)
 		tbm_end_shared_iterate(node->shared_tbmiterator);
-	if (node->shared_prefetch_iterator)
-		tbm_end_shared_iterate(node->shared_prefetch_iterator);
 	if (node->vmbuffer != InvalidBuffer)
 		ReleaseBuffer(node->vmbuffer);
 	if (node->pvmbuffer != InvalidBuffer)
@@ -743,7 +742,9 @@ ExecInitBitmapHeapScan(BitmapHeapScan *node, EState *estate, int eflags)
 	scanstate->pscan_len = 0;
 	scanstate->initialized = false;
 	scanstate->shared_tbmiterator = NULL;
-	scanstate->shared_prefetch_iterator = NULL;
+	scanstate->prefetch_queue = NULL;
+	scanstate->prefetch_head = 0;
+	scanstate->shared_exhausted = false;
 	scanstate->pstate = NULL;
 
 	/*
@@ -900,12 +901,9 @@ ExecBitmapHeapInitializeDSM(BitmapHeapScanState *node,
 	pstate = shm_toc_allocate(pcxt->toc, node->pscan_len);
 
 	pstate->tbmiterator = 0;
-	pstate->prefetch_iterator = 0;
 
 	/* Initialize the mutex */
 	SpinLockInit(&pstate->mutex);
-	pstate->prefetch_pages = 0;
-	pstate->prefetch_target = 0;
 	pstate->state = BM_INITIAL;
 
 	ConditionVariableInit(&pstate->cv);
@@ -937,11 +935,7 @@ ExecBitmapHeapReInitializeDSM(BitmapHeapScanState *node,
 	if (DsaPointerIsValid(pstate->tbmiterator))
 		tbm_free_shared_area(dsa, pstate->tbmiterator);
 
-	if (DsaPointerIsValid(pstate->prefetch_iterator))
-		tbm_free_shared_area(dsa, pstate->prefetch_iterator);
-
 	pstate->tbmiterator = InvalidDsaPointer;
-	pstate->prefetch_iterator = InvalidDsaPointer;
 }
 
 /* ----------------------------------------------------------------
@@ -276,11 +276,16 @@ gather_getnext(GatherState *gatherstate)
 		{
 			tup = gather_readnext(gatherstate);
 
+			/*
+			 * The tuple points into the tuple queue, and stays valid until
+			 * we read from that queue again, which we don't do before our
+			 * caller is done with the slot.  So there's no need to copy it.
+			 */
 			if (HeapTupleIsValid(tup))
 			{
 				ExecStoreHeapTuple(tup, /* tuple to store */
 								   fslot,	/* slot to store the tuple */
-								   true);	/* pfree tuple when done with it */
+								   false);	/* don't pfree */
 				return fslot;
 			}
 		}
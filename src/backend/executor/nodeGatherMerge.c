@@ -732,6 +732,14 @@ gm_readnext_tuple(GatherMergeState *gm_state, int nreader, bool nowait,
 	reader = gm_state->reader[nreader - 1];
 	tup = TupleQueueReaderNext(reader, nowait, done);
 
+	/*
+	 * The tuple points into the tuple queue, and will be overwritten by the
+	 * next read from it, while we need to keep it until it's this worker's
+	 * turn in the merge.  So copy it.
+	 */
+	if (tup != NULL)
+		tup = heap_copytuple(tup);
+
 	return tup;
 }
 
@@ -38,6 +38,8 @@
 #include "pgstat.h"
 #include "port/atomics.h"
 #include "utils/dynahash.h"
+#include "utils/hashutils.h"
+#include "utils/memlimit.h"
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
@@ -49,6 +51,9 @@ static void ExecParallelHashIncreaseNumBatches(HashJoinTable hashtable);
 static void ExecParallelHashIncreaseNumBuckets(HashJoinTable hashtable);
 static void ExecHashBuildSkewHash(HashJoinTable hashtable, Hash *node,
 								  int mcvsToUse);
+static void ExecParallelHashBuildSkewHash(HashJoinTable hashtable, Hash *node,
+										  int mcvsToUse);
+static int	skew_hash_cmp(const void *a, const void *b);
 static void ExecHashSkewTableInsert(HashJoinTable hashtable,
 									TupleTableSlot *slot,
 									uint32 hashvalue,
@@ -60,6 +65,8 @@ static HashJoinTuple ExecParallelHashTupleAlloc(HashJoinTable hashtable,
 												size_t size,
 												dsa_pointer *shared);
 static void MultiExecPrivateHash(HashState *node);
+static inline void ExecHashBloomFilterAdd(HashBloomFilter bloom,
+										  uint32 hashvalue);
 static void MultiExecParallelHash(HashState *node);
 static inline HashJoinTuple ExecParallelHashFirstTuple(HashJoinTable table,
 													   int bucketno);
@@ -142,6 +149,7 @@ MultiExecPrivateHash(HashState *node)
 	HashJoinTable hashtable;
 	TupleTableSlot *slot;
 	ExprContext *econtext;
+	HashBloomFilter bloom = node->bloom;
 	uint32		hashvalue;
 
 	/*
@@ -156,6 +164,13 @@ MultiExecPrivateHash(HashState *node)
 	hashkeys = node->hashkeys;
 	econtext = node->ps.ps_ExprContext;
 
+	/* the outer scan mustn't use the Bloom filter until it's rebuilt */
+	if (bloom)
+	{
+		bloom->active = false;
+		memset(bloom->bits, 0, (bloom->mask / 64 + 1) * sizeof(uint64));
+	}
+
 	/*
 	 * Get all tuples from the node below the Hash node and insert into the
 	 * hash table (or temp files).
@@ -173,6 +188,9 @@ MultiExecPrivateHash(HashState *node)
 		{
 			int			bucketNumber;
 
+			if (bloom)
+				ExecHashBloomFilterAdd(bloom, hashvalue);
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -200,6 +218,14 @@ MultiExecPrivateHash(HashState *node)
 		hashtable->spacePeak = hashtable->spaceUsed;
 
 	hashtable->partialTuples = hashtable->totalTuples;
+
+	/*
+	 * With more than one value per four bits, the filter would let through
+	 * too many tuples to be worth testing them.
+	 */
+	if (bloom && !bloom->disabled &&
+		hashtable->totalTuples * 4 <= (double) bloom->mask + 1)
+		bloom->active = true;
 }
 
 /* ----------------------------------------------------------------
@@ -491,6 +517,9 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 	hashtable->skewBucketLen = 0;
 	hashtable->nSkewBuckets = 0;
 	hashtable->skewBucketNums = NULL;
+	hashtable->parallelSkewHashes = NULL;
+	hashtable->stripeTuple = NULL;
+	hashtable->stripeHashValue = 0;
 	hashtable->nbatch = nbatch;
 	hashtable->curbatch = 0;
 	hashtable->nbatch_original = nbatch;
@@ -504,6 +533,15 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 	hashtable->spaceUsed = 0;
 	hashtable->spacePeak = 0;
 	hashtable->spaceAllowed = space_allowed;
+
+	/*
+	 * If the server as a whole is short of memory, start out with a smaller
+	 * budget than planned, so that we increase the number of batches sooner.
+	 * Parallel Hash shares its budget among the participants, so we leave it
+	 * alone.
+	 */
+	if (state->parallel_state == NULL)
+		hashtable->spaceAllowed = MemoryLimitClampWorkspace(space_allowed);
 	hashtable->spaceUsedSkew = 0;
 	hashtable->spaceAllowedSkew =
 		hashtable->spaceAllowed * SKEW_WORK_MEM_PERCENT / 100;
@@ -555,8 +593,9 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 		if (!get_op_hash_functions(hashop, &left_hashfn, &right_hashfn))
 			elog(ERROR, "could not find hash function for hash operator %u",
 				 hashop);
-		fmgr_info(left_hashfn, &hashtable->outer_hashfunctions[i]);
-		fmgr_info(right_hashfn, &hashtable->inner_hashfunctions[i]);
+		execHashFunctionInfo(left_hashfn, right_hashfn,
+							 &hashtable->outer_hashfunctions[i],
+							 &hashtable->inner_hashfunctions[i]);
 		hashtable->hashStrict[i] = op_strict(hashop);
 		hashtable->collations[i] = lfirst_oid(hc);
 		i++;
@@ -612,6 +651,15 @@ ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 			/* Set up the shared state for coordinating batches. */
 			ExecParallelHashJoinSetUpBatches(hashtable, nbatch);
 
+			/*
+			 * Choose the skew values for everyone, if there's a need for more
+			 * than one batch.
+			 */
+			pstate->skew_hashes = InvalidDsaPointer;
+			pstate->nskew_hashes = 0;
+			if (nbatch > 1)
+				ExecParallelHashBuildSkewHash(hashtable, node, num_skew_mcvs);
+
 			/*
 			 * Allocate batch 0's hash table up front so we can load it
 			 * directly while hashing.
@@ -1175,6 +1223,15 @@ ExecParallelHashIncreaseNumBatches(HashJoinTable hashtable)
 				/* Move all chunks to the work queue for parallel processing. */
 				pstate->chunk_work_queue = old_batch0->chunks;
 
+				/*
+				 * Stop keeping the skew values in batch 0.  They may be what
+				 * filled it up, and in any case we don't want to evict them
+				 * selectively: repartitioning them along with everything
+				 * else keeps batch 0 within budget.  The outer relation
+				 * hasn't been partitioned yet, so it will follow suit.
+				 */
+				pstate->nskew_hashes = 0;
+
 				/* Disable further growth temporarily while we're growing. */
 				pstate->growth = PHJ_GROWTH_DISABLED;
 			}
@@ -1293,8 +1350,8 @@ ExecParallelHashRepartitionFirst(HashJoinTable hashtable)
 			int			bucketno;
 			int			batchno;
 
-			ExecHashGetBucketAndBatch(hashtable, hashTuple->hashvalue,
-									  &bucketno, &batchno);
+			ExecParallelHashGetBucketAndBatch(hashtable, hashTuple->hashvalue,
+											  &bucketno, &batchno);
 
 			Assert(batchno < hashtable->nbatch);
 			if (batchno == 0)
@@ -1376,8 +1433,8 @@ ExecParallelHashRepartitionRest(HashJoinTable hashtable)
 			int			batchno;
 
 			/* Decide which partition it goes to in the new generation. */
-			ExecHashGetBucketAndBatch(hashtable, hashvalue, &bucketno,
-									  &batchno);
+			ExecParallelHashGetBucketAndBatch(hashtable, hashvalue, &bucketno,
+											  &batchno);
 
 			hashtable->batches[batchno].estimated_size += tuple_size;
 			++hashtable->batches[batchno].ntuples;
@@ -1691,7 +1748,8 @@ ExecParallelHashTableInsert(HashJoinTable hashtable,
 	int			batchno;
 
 retry:
-	ExecHashGetBucketAndBatch(hashtable, hashvalue, &bucketno, &batchno);
+	ExecParallelHashGetBucketAndBatch(hashtable, hashvalue, &bucketno,
+									  &batchno);
 
 	if (batchno == 0)
 	{
@@ -1756,7 +1814,8 @@ ExecParallelHashTableInsertCurrentBatch(HashJoinTable hashtable,
 	int			batchno;
 	int			bucketno;
 
-	ExecHashGetBucketAndBatch(hashtable, hashvalue, &bucketno, &batchno);
+	ExecParallelHashGetBucketAndBatch(hashtable, hashvalue, &bucketno,
+									  &batchno);
 	Assert(batchno == hashtable->curbatch);
 	hashTuple = ExecParallelHashTupleAlloc(hashtable,
 										   HJTUPLE_OVERHEAD + tuple->t_len,
@@ -1771,6 +1830,95 @@ ExecParallelHashTableInsertCurrentBatch(HashJoinTable hashtable,
 		heap_free_minimal_tuple(tuple);
 }
 
+/*
+ * ExecParallelHashTableInsertStripe
+ *		insert a tuple into the current batch's hash table, unless that would
+ *		exceed the memory budget
+ *
+ * This is used to load an oversized batch one stripe at a time (see
+ * ExecParallelHashJoinNewBatch), and returns false without inserting the
+ * tuple if the current stripe is full.  The first chunk of a stripe is always
+ * allowed, so that we make progress even with very large tuples.
+ */
+bool
+ExecParallelHashTableInsertStripe(HashJoinTable hashtable,
+								  TupleTableSlot *slot,
+								  uint32 hashvalue)
+{
+	ParallelHashJoinBatchAccessor *batch =
+	&hashtable->batches[hashtable->curbatch];
+	HashMemoryChunk chunk = hashtable->current_chunk;
+	bool		shouldFree;
+	MinimalTuple tuple = ExecFetchSlotMinimalTuple(slot, &shouldFree);
+	size_t		size = MAXALIGN(HJTUPLE_OVERHEAD + tuple->t_len);
+
+	if (shouldFree)
+		heap_free_minimal_tuple(tuple);
+
+	/* Would we need a new chunk, and would that take us over the limit? */
+	if (batch->at_least_one_chunk &&
+		(chunk == NULL ||
+		 size > HASH_CHUNK_THRESHOLD ||
+		 chunk->maxlen - chunk->used < size))
+	{
+		size_t		chunk_size;
+
+		if (size > HASH_CHUNK_THRESHOLD)
+			chunk_size = size + HASH_CHUNK_HEADER_SIZE;
+		else
+			chunk_size = HASH_CHUNK_SIZE;
+		if (batch->shared->size + chunk_size >
+			hashtable->parallel_state->space_allowed)
+			return false;
+	}
+
+	ExecParallelHashTableInsertCurrentBatch(hashtable, slot, hashvalue);
+
+	return true;
+}
+
+/*
+ * ExecParallelHashTableResetBatch
+ *		discard the contents of the current batch's hash table, keeping the
+ *		bucket array
+ *
+ * Only the participant that claimed an oversized batch may do this, between
+ * stripes.
+ */
+void
+ExecParallelHashTableResetBatch(HashJoinTable hashtable)
+{
+	ParallelHashJoinBatchAccessor *accessor =
+	&hashtable->batches[hashtable->curbatch];
+	ParallelHashJoinBatch *batch = accessor->shared;
+	int			i;
+
+	Assert(batch->claimed);
+
+	/* The stripe we're dropping counts for EXPLAIN, too. */
+	hashtable->spacePeak =
+		Max(hashtable->spacePeak,
+			batch->size + sizeof(dsa_pointer_atomic) * hashtable->nbuckets);
+
+	while (DsaPointerIsValid(batch->chunks))
+	{
+		HashMemoryChunk chunk =
+		dsa_get_address(hashtable->area, batch->chunks);
+		dsa_pointer next = chunk->next.shared;
+
+		dsa_free(hashtable->area, batch->chunks);
+		batch->chunks = next;
+	}
+	batch->size = 0;
+	accessor->at_least_one_chunk = false;
+	hashtable->current_chunk = NULL;
+	hashtable->current_chunk_shared = InvalidDsaPointer;
+
+	for (i = 0; i < hashtable->nbuckets; ++i)
+		dsa_pointer_atomic_write(&hashtable->buckets.shared[i],
+								 InvalidDsaPointer);
+}
+
 /*
  * ExecHashGetHashValue
  *		Compute the hash value for a tuple
@@ -1914,6 +2062,60 @@ ExecHashGetBucketAndBatch(HashJoinTable hashtable,
 	}
 }
 
+/*
+ * ExecParallelHashGetBucketAndBatch
+ *		Determine the bucket number and batch number for a hash value in a
+ *		Parallel Hash table
+ *
+ * This is ExecHashGetBucketAndBatch, except that hash values belonging to the
+ * outer relation's most common values are assigned to batch 0 while we have
+ * a skew set (see ExecParallelHashBuildSkewHash).  Their inner tuples then
+ * stay in memory instead of being written out and loaded again later.  The
+ * set is the same for all participants, and only ever goes away as a whole
+ * before any outer tuple has been partitioned, so inner and outer tuples
+ * always agree on the batch.
+ */
+void
+ExecParallelHashGetBucketAndBatch(HashJoinTable hashtable,
+								  uint32 hashvalue,
+								  int *bucketno,
+								  int *batchno)
+{
+	ParallelHashJoinState *pstate = hashtable->parallel_state;
+
+	ExecHashGetBucketAndBatch(hashtable, hashvalue, bucketno, batchno);
+
+	if (*batchno != 0 && pstate->nskew_hashes > 0)
+	{
+		uint32	   *skew_hashes = hashtable->parallelSkewHashes;
+		int			low = 0;
+		int			high = pstate->nskew_hashes - 1;
+
+		if (skew_hashes == NULL)
+		{
+			skew_hashes = (uint32 *)
+				dsa_get_address(hashtable->area, pstate->skew_hashes);
+			hashtable->parallelSkewHashes = skew_hashes;
+		}
+
+		/* Binary search the sorted array. */
+		while (low <= high)
+		{
+			int			mid = low + (high - low) / 2;
+
+			if (skew_hashes[mid] == hashvalue)
+			{
+				*batchno = 0;
+				break;
+			}
+			else if (skew_hashes[mid] < hashvalue)
+				low = mid + 1;
+			else
+				high = mid - 1;
+		}
+	}
+}
+
 /*
  * ExecScanHashBucket
  *		scan a hash bucket for matches to the current outer tuple
@@ -2197,6 +2399,160 @@ ExecReScanHash(HashState *node)
 		ExecReScan(node->ps.lefttree);
 }
 
+/*
+ * ExecHashBloomFilterCreate
+ *
+ *		Create a Bloom filter to be built by the Hash node along with its
+ *		private hash tables, and used by the join's outer plan, a SeqScan,
+ *		to skip tuples that can't find a match.  The bloomkeys are the outer
+ *		hash keys in terms of the scan tuple, see HashJoin.
+ *
+ *		The filter is sized for about 8 bits per planned inner tuple, which
+ *		lets through some 5% of the non-matching tuples, but isn't allowed
+ *		to take more than a sixteenth of work_mem.
+ */
+HashBloomFilter
+ExecHashBloomFilterCreate(HashState *node, PlanState *scanstate,
+						  List *bloomkeys, List *hashOperators,
+						  List *hashCollations)
+{
+	HashBloomFilter bloom;
+	int			nkeys = list_length(hashOperators);
+	double		inner_rows = node->ps.plan->plan_rows;
+	double		max_bits;
+	uint64		nbits;
+	ListCell   *ho;
+	ListCell   *hc;
+	int			i;
+
+	max_bits = Min((double) work_mem * 1024.0 * BITS_PER_BYTE / 16,
+				   (double) ((uint64) 1 << 31));
+	nbits = 1024;
+	while (nbits < inner_rows * 8 && nbits * 2 <= max_bits)
+		nbits *= 2;
+
+	bloom = (HashBloomFilter) palloc0(sizeof(HashBloomFilterData));
+	bloom->bits = (uint64 *) palloc0(nbits / BITS_PER_BYTE);
+	bloom->mask = (uint32) (nbits - 1);
+	bloom->keys = ExecInitExprList(bloomkeys, scanstate);
+	bloom->hashfunctions = (FmgrInfo *) palloc(nkeys * sizeof(FmgrInfo));
+	bloom->hashStrict = (bool *) palloc(nkeys * sizeof(bool));
+	bloom->collations = (Oid *) palloc(nkeys * sizeof(Oid));
+
+	i = 0;
+	forboth(ho, hashOperators, hc, hashCollations)
+	{
+		Oid			hashop = lfirst_oid(ho);
+		Oid			left_hashfn;
+		Oid			right_hashfn;
+
+		if (!get_op_hash_functions(hashop, &left_hashfn, &right_hashfn))
+			elog(ERROR, "could not find hash function for hash operator %u",
+				 hashop);
+		execHashFunctionInfo(left_hashfn, right_hashfn,
+							 &bloom->hashfunctions[i], NULL);
+		bloom->hashStrict[i] = op_strict(hashop);
+		bloom->collations[i] = lfirst_oid(hc);
+		i++;
+	}
+
+	node->bloom = bloom;
+
+	return bloom;
+}
+
+/*
+ * ExecHashBloomFilterAdd
+ *		Add the hash value of an inner tuple to the Bloom filter
+ */
+static inline void
+ExecHashBloomFilterAdd(HashBloomFilter bloom, uint32 hashvalue)
+{
+	uint32		bit1 = hashvalue & bloom->mask;
+	uint32		bit2 = murmurhash32(hashvalue) & bloom->mask;
+
+	bloom->bits[bit1 / 64] |= UINT64CONST(1) << (bit1 % 64);
+	bloom->bits[bit2 / 64] |= UINT64CONST(1) << (bit2 % 64);
+}
+
+/*
+ * ExecHashBloomFilterTest
+ *		Test the tuple in econtext->ecxt_scantuple against the Bloom filter
+ *
+ * Returns false if the tuple can't match any inner tuple.  The hash value
+ * is computed like ExecHashGetHashValue does for an outer tuple; a null key
+ * for a strict operator can't match either.
+ *
+ * The scan should only call this while bloom->active is set.  We clear it
+ * if too few of the first BLOOM_TRIAL_TUPLES tuples are removed, since then
+ * testing the tuples costs more than it saves.
+ */
+bool
+ExecHashBloomFilterTest(HashBloomFilter bloom, ExprContext *econtext)
+{
+	uint32		hashkey = 0;
+	bool		found = true;
+	ListCell   *lc;
+	int			i = 0;
+	MemoryContext oldContext;
+
+	Assert(bloom->active);
+
+	ResetExprContext(econtext);
+
+	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+	foreach(lc, bloom->keys)
+	{
+		ExprState  *keyexpr = (ExprState *) lfirst(lc);
+		Datum		keyval;
+		bool		isNull;
+
+		/* rotate hashkey left 1 bit at each step */
+		hashkey = (hashkey << 1) | ((hashkey & 0x80000000) ? 1 : 0);
+
+		keyval = ExecEvalExpr(keyexpr, econtext, &isNull);
+
+		if (isNull)
+		{
+			if (bloom->hashStrict[i])
+			{
+				found = false;
+				break;
+			}
+		}
+		else
+			hashkey ^= DatumGetUInt32(FunctionCall1Coll(&bloom->hashfunctions[i],
+														bloom->collations[i],
+														keyval));
+		i++;
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	if (found)
+	{
+		uint32		bit1 = hashkey & bloom->mask;
+		uint32		bit2 = murmurhash32(hashkey) & bloom->mask;
+
+		found = (bloom->bits[bit1 / 64] & (UINT64CONST(1) << (bit1 % 64))) != 0 &&
+			(bloom->bits[bit2 / 64] & (UINT64CONST(1) << (bit2 % 64))) != 0;
+	}
+
+	bloom->ntested++;
+	if (!found)
+		bloom->nremoved++;
+
+	if (bloom->ntested == BLOOM_TRIAL_TUPLES &&
+		bloom->nremoved < BLOOM_TRIAL_TUPLES / 8)
+	{
+		bloom->active = false;
+		bloom->disabled = true;
+	}
+
+	return found;
+}
+
 
 /*
  * ExecHashBuildSkewHash
@@ -2354,6 +2710,109 @@ ExecHashBuildSkewHash(HashJoinTable hashtable, Hash *node, int mcvsToUse)
 	ReleaseSysCache(statsTuple);
 }
 
+/*
+ * ExecParallelHashBuildSkewHash
+ *
+ *		Set up for skew optimization in a Parallel Hash Join
+ *
+ * Parallel Hash has no private skew buckets: each participant probes one batch
+ * at a time, and all outer tuples are partitioned before probing begins.
+ * Instead we publish the hash values of the outer relation's MCVs in a sorted
+ * array in the DSA area, and ExecParallelHashGetBucketAndBatch assigns
+ * tuples with those hash values to batch 0, so that the inner tuples matching
+ * the most common outer values are never written out to a batch file.
+ * The elected participant calls this while setting up the shared state.
+ */
+static void
+ExecParallelHashBuildSkewHash(HashJoinTable hashtable, Hash *node,
+							  int mcvsToUse)
+{
+	ParallelHashJoinState *pstate = hashtable->parallel_state;
+	HeapTupleData *statsTuple;
+	AttStatsSlot sslot;
+
+	/* Do nothing if planner didn't identify the outer relation's join key */
+	if (!OidIsValid(node->skewTable))
+		return;
+	/* Also, do nothing if we don't have room for at least one skew value */
+	if (mcvsToUse <= 0)
+		return;
+
+	/*
+	 * Try to find the MCV statistics for the outer relation's join key.
+	 */
+	statsTuple = SearchSysCache3(STATRELATTINH,
+								 ObjectIdGetDatum(node->skewTable),
+								 Int16GetDatum(node->skewColumn),
+								 BoolGetDatum(node->skewInherit));
+	if (!HeapTupleIsValid(statsTuple))
+		return;
+
+	if (get_attstatsslot(&sslot, statsTuple,
+						 STATISTIC_KIND_MCV, InvalidOid,
+						 ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+	{
+		double		frac;
+		uint32	   *skew_hashes;
+		int			nskew_hashes;
+		int			i;
+
+		if (mcvsToUse > sslot.nvalues)
+			mcvsToUse = sslot.nvalues;
+
+		/* As in ExecHashBuildSkewHash, make sure it's worth the trouble. */
+		frac = 0;
+		for (i = 0; i < mcvsToUse; i++)
+			frac += sslot.numbers[i];
+		if (frac < SKEW_MIN_OUTER_FRACTION)
+		{
+			free_attstatsslot(&sslot);
+			ReleaseSysCache(statsTuple);
+			return;
+		}
+
+		pstate->skew_hashes = dsa_allocate(hashtable->area,
+										   sizeof(uint32) * mcvsToUse);
+		skew_hashes = (uint32 *)
+			dsa_get_address(hashtable->area, pstate->skew_hashes);
+		for (i = 0; i < mcvsToUse; i++)
+			skew_hashes[i] =
+				DatumGetUInt32(FunctionCall1Coll(&hashtable->outer_hashfunctions[0],
+												 hashtable->collations[0],
+												 sslot.values[i]));
+
+		/* Sort for binary search, and drop duplicates. */
+		qsort(skew_hashes, mcvsToUse, sizeof(uint32), skew_hash_cmp);
+		nskew_hashes = 1;
+		for (i = 1; i < mcvsToUse; i++)
+		{
+			if (skew_hashes[i] != skew_hashes[nskew_hashes - 1])
+				skew_hashes[nskew_hashes++] = skew_hashes[i];
+		}
+		pstate->nskew_hashes = nskew_hashes;
+
+		free_attstatsslot(&sslot);
+	}
+
+	ReleaseSysCache(statsTuple);
+}
+
+/*
+ * qsort comparator for skew hash values
+ */
+static int
+skew_hash_cmp(const void *a, const void *b)
+{
+	uint32		ha = *(const uint32 *) a;
+	uint32		hb = *(const uint32 *) b;
+
+	if (ha < hb)
+		return -1;
+	if (ha > hb)
+		return 1;
+	return 0;
+}
+
 /*
  * ExecHashGetSkewBucket
  *
@@ -3094,6 +3553,13 @@ ExecHashTableDetachBatch(HashJoinTable hashtable)
 		sts_end_parallel_scan(hashtable->batches[curbatch].inner_tuples);
 		sts_end_parallel_scan(hashtable->batches[curbatch].outer_tuples);
 
+		/* Forget the rest of an oversized batch, if we're giving up on it. */
+		if (hashtable->stripeTuple != NULL)
+		{
+			pfree(hashtable->stripeTuple);
+			hashtable->stripeTuple = NULL;
+		}
+
 		/* Detach from the batch we were last working on. */
 		if (BarrierArriveAndDetach(&batch->batch_barrier))
 		{
@@ -3166,6 +3632,12 @@ ExecHashTableDetach(HashJoinTable hashtable)
 				dsa_free(hashtable->area, pstate->batches);
 				pstate->batches = InvalidDsaPointer;
 			}
+			if (DsaPointerIsValid(pstate->skew_hashes))
+			{
+				dsa_free(hashtable->area, pstate->skew_hashes);
+				pstate->skew_hashes = InvalidDsaPointer;
+				pstate->nskew_hashes = 0;
+			}
 		}
 
 		hashtable->parallel_state = NULL;
@@ -88,6 +88,16 @@
  * PHJ_BATCH_PROBING; populating batch 0's hash table is done during
  * PHJ_BUILD_HASHING_INNER so we can skip loading.
  *
+ * If repartitioning was given up because of extreme skew, some batches may
+ * be too large to load within our memory budget.  For inner joins, such a
+ * batch is claimed by a single participant, which loads as much of it as
+ * fits (a "stripe"), probes it with all of the batch's outer tuples, and
+ * then repeats with the next stripe until the inner tuples are exhausted.
+ * Since no one else is attached to the batch, that doesn't require waiting
+ * on its barrier after returning tuples.  Other join types would need to
+ * remember which outer tuples found a match in earlier stripes, so they
+ * still load the whole batch regardless of the budget.
+ *
  * Initially we try to plan for a single-batch hash join using the combined
  * work_mem of all participants to create a large shared hash table.  If that
  * turns out either at planning or execution time to be impossible then we
@@ -145,6 +155,12 @@ static TupleTableSlot *ExecHashJoinGetSavedTuple(HashJoinState *hjstate,
 												 TupleTableSlot *tupleSlot);
 static bool ExecHashJoinNewBatch(HashJoinState *hjstate);
 static bool ExecParallelHashJoinNewBatch(HashJoinState *hjstate);
+static bool ExecParallelHashJoinBatchIsOversized(HashJoinState *hjstate,
+												 int batchno);
+static bool ExecParallelHashJoinClaimBatch(HashJoinTable hashtable,
+										   int batchno);
+static void ExecParallelHashJoinLoadStripe(HashJoinState *hjstate);
+static void ExecParallelHashJoinNextStripe(HashJoinState *hjstate);
 static void ExecParallelHashJoinPartitionOuter(HashJoinState *node);
 
 
@@ -729,6 +745,26 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	hjstate->hj_HashOperators = node->hashoperators;
 	hjstate->hj_Collations = node->hashcollations;
 
+	/*
+	 * If the planner found that the outer SeqScan can evaluate our hash
+	 * keys, have the Hash node build a Bloom filter of the inner tuples for
+	 * the scan to skip the tuples that can't find a match.
+	 */
+	hjstate->hj_BloomFilter = NULL;
+	if (node->bloomkeys != NIL &&
+		IsA(outerPlanState(hjstate), SeqScanState))
+	{
+		SeqScanState *scanstate = (SeqScanState *) outerPlanState(hjstate);
+
+		hjstate->hj_BloomFilter =
+			ExecHashBloomFilterCreate((HashState *) innerPlanState(hjstate),
+									  (PlanState *) scanstate,
+									  node->bloomkeys,
+									  node->hashoperators,
+									  node->hashcollations);
+		scanstate->bloom = hjstate->hj_BloomFilter;
+	}
+
 	hjstate->hj_JoinState = HJ_BUILD_HASHTABLE;
 	hjstate->hj_MatchedOuter = false;
 	hjstate->hj_OuterNotEmpty = false;
@@ -1086,6 +1122,16 @@ ExecParallelHashJoinNewBatch(HashJoinState *hjstate)
 	 */
 	if (hashtable->curbatch >= 0)
 	{
+		/*
+		 * If we are working through an oversized batch and there are inner
+		 * tuples left over, carry on with its next stripe instead.
+		 */
+		if (hashtable->stripeTuple != NULL)
+		{
+			ExecParallelHashJoinNextStripe(hjstate);
+			return true;
+		}
+
 		hashtable->batches[hashtable->curbatch].done = true;
 		ExecHashTableDetachBatch(hashtable);
 	}
@@ -1104,6 +1150,15 @@ ExecParallelHashJoinNewBatch(HashJoinState *hjstate)
 		MinimalTuple tuple;
 		TupleTableSlot *slot;
 
+		/*
+		 * An oversized batch is processed by one participant alone.  If
+		 * someone else got to it first, there's nothing for us to do.
+		 */
+		if (!hashtable->batches[batchno].done &&
+			ExecParallelHashJoinBatchIsOversized(hjstate, batchno) &&
+			!ExecParallelHashJoinClaimBatch(hashtable, batchno))
+			hashtable->batches[batchno].done = true;
+
 		if (!hashtable->batches[batchno].done)
 		{
 			SharedTuplestoreAccessor *inner_tuples;
@@ -1131,17 +1186,25 @@ ExecParallelHashJoinNewBatch(HashJoinState *hjstate)
 					ExecParallelHashTableSetCurrentBatch(hashtable, batchno);
 					inner_tuples = hashtable->batches[batchno].inner_tuples;
 					sts_begin_parallel_scan(inner_tuples);
-					while ((tuple = sts_parallel_scan_next(inner_tuples,
-														   &hashvalue)))
+					if (hashtable->batches[batchno].shared->claimed)
 					{
-						ExecForceStoreMinimalTuple(tuple,
-												   hjstate->hj_HashTupleSlot,
-												   false);
-						slot = hjstate->hj_HashTupleSlot;
-						ExecParallelHashTableInsertCurrentBatch(hashtable, slot,
-																hashvalue);
+						/* We're on our own; load the first stripe. */
+						ExecParallelHashJoinLoadStripe(hjstate);
+					}
+					else
+					{
+						while ((tuple = sts_parallel_scan_next(inner_tuples,
+															   &hashvalue)))
+						{
+							ExecForceStoreMinimalTuple(tuple,
+													   hjstate->hj_HashTupleSlot,
+													   false);
+							slot = hjstate->hj_HashTupleSlot;
+							ExecParallelHashTableInsertCurrentBatch(hashtable, slot,
+																	hashvalue);
+						}
+						sts_end_parallel_scan(inner_tuples);
 					}
-					sts_end_parallel_scan(inner_tuples);
 					BarrierArriveAndWait(batch_barrier,
 										 WAIT_EVENT_HASH_BATCH_LOADING);
 					/* Fall through. */
@@ -1184,6 +1247,123 @@ ExecParallelHashJoinNewBatch(HashJoinState *hjstate)
 	return false;
 }
 
+/*
+ * ExecParallelHashJoinBatchIsOversized
+ *		Is this batch too large to be loaded within our memory budget, and can
+ *		we process it in stripes instead?
+ *
+ * The decision depends only on shared state that doesn't change after the
+ * build is done, so all participants come to the same conclusion.
+ */
+static bool
+ExecParallelHashJoinBatchIsOversized(HashJoinState *hjstate, int batchno)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+
+	/* Batch 0 was loaded while hashing, whatever its size. */
+	if (batchno == 0)
+		return false;
+
+	/* See the notes at the top of this file. */
+	if (hjstate->js.jointype != JOIN_INNER)
+		return false;
+
+	return hashtable->batches[batchno].shared->estimated_size >
+		hashtable->parallel_state->space_allowed;
+}
+
+/*
+ * ExecParallelHashJoinClaimBatch
+ *		Try to become the only participant processing an oversized batch.
+ */
+static bool
+ExecParallelHashJoinClaimBatch(HashJoinTable hashtable, int batchno)
+{
+	ParallelHashJoinState *pstate = hashtable->parallel_state;
+	ParallelHashJoinBatch *batch = hashtable->batches[batchno].shared;
+	bool		claimed = false;
+
+	LWLockAcquire(&pstate->lock, LW_EXCLUSIVE);
+	if (!batch->claimed)
+	{
+		batch->claimed = true;
+		claimed = true;
+	}
+	LWLockRelease(&pstate->lock);
+
+	return claimed;
+}
+
+/*
+ * ExecParallelHashJoinLoadStripe
+ *		Load as many of the current batch's inner tuples as fit in memory.
+ *
+ * If we run out of space before we run out of tuples, the tuple that didn't
+ * fit is kept in hashtable->stripeTuple to begin the next stripe.  Only the
+ * participant that claimed the batch may call this.
+ */
+static void
+ExecParallelHashJoinLoadStripe(HashJoinState *hjstate)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	SharedTuplestoreAccessor *inner_tuples =
+	hashtable->batches[hashtable->curbatch].inner_tuples;
+	TupleTableSlot *slot = hjstate->hj_HashTupleSlot;
+	MinimalTuple tuple;
+	uint32		hashvalue;
+
+	/* The hash table is empty, so the left-over tuple always fits. */
+	if (hashtable->stripeTuple != NULL)
+	{
+		ExecForceStoreMinimalTuple(hashtable->stripeTuple, slot, true);
+		ExecParallelHashTableInsertCurrentBatch(hashtable, slot,
+												hashtable->stripeHashValue);
+		hashtable->stripeTuple = NULL;
+	}
+
+	while ((tuple = sts_parallel_scan_next(inner_tuples, &hashvalue)))
+	{
+		ExecForceStoreMinimalTuple(tuple, slot, false);
+		if (!ExecParallelHashTableInsertStripe(hashtable, slot, hashvalue))
+		{
+			MemoryContext oldcxt;
+
+			/* This stripe is full.  Keep the tuple for the next one. */
+			oldcxt = MemoryContextSwitchTo(hashtable->hashCxt);
+			hashtable->stripeTuple = heap_copy_minimal_tuple(tuple);
+			hashtable->stripeHashValue = hashvalue;
+			MemoryContextSwitchTo(oldcxt);
+			return;
+		}
+	}
+	sts_end_parallel_scan(inner_tuples);
+}
+
+/*
+ * ExecParallelHashJoinNextStripe
+ *		Replace the stripe we have just probed with the next one, and rewind
+ *		the batch's outer tuples to probe it.
+ *
+ * We don't need to coordinate with anyone, because no other participant is
+ * attached to a batch we claimed.
+ */
+static void
+ExecParallelHashJoinNextStripe(HashJoinState *hjstate)
+{
+	HashJoinTable hashtable = hjstate->hj_HashTable;
+	SharedTuplestoreAccessor *outer_tuples =
+	hashtable->batches[hashtable->curbatch].outer_tuples;
+
+	Assert(hashtable->batches[hashtable->curbatch].shared->claimed);
+
+	ExecParallelHashTableResetBatch(hashtable);
+	ExecParallelHashJoinLoadStripe(hjstate);
+
+	sts_end_parallel_scan(outer_tuples);
+	sts_reinitialize(outer_tuples);
+	sts_begin_parallel_scan(outer_tuples);
+}
+
 /*
  * ExecHashJoinSaveTuple
  *		save a tuple to a batch file.
@@ -1205,7 +1385,7 @@ ExecHashJoinSaveTuple(MinimalTuple tuple, uint32 hashvalue,
 	if (file == NULL)
 	{
 		/* First write to this batch file, so open it. */
-		file = BufFileCreateTemp(false);
+		file = BufFileCreateCompressedTemp(false);
 		*fileptr = file;
 	}
 
@@ -1321,6 +1501,10 @@ ExecReScanHashJoin(HashJoinState *node)
 			node->hj_HashTable = NULL;
 			node->hj_JoinState = HJ_BUILD_HASHTABLE;
 
+			/* ... and the Bloom filter, which the outer scan can't use now */
+			if (node->hj_BloomFilter)
+				node->hj_BloomFilter->active = false;
+
 			/*
 			 * if chgParam of subnode is not null then plan will be re-scanned
 			 * by first ExecProcNode.
@@ -1392,8 +1576,8 @@ ExecParallelHashJoinPartitionOuter(HashJoinState *hjstate)
 			bool		shouldFree;
 			MinimalTuple mintup = ExecFetchSlotMinimalTuple(slot, &shouldFree);
 
-			ExecHashGetBucketAndBatch(hashtable, hashvalue, &bucketno,
-									  &batchno);
+			ExecParallelHashGetBucketAndBatch(hashtable, hashvalue, &bucketno,
+											  &batchno);
 			sts_puttuple(hashtable->batches[batchno].outer_tuples,
 						 &hashvalue, mintup);
 
@@ -0,0 +1,390 @@
+/*-------------------------------------------------------------------------
+ *
+ * nodeIncrementalSort.c
+ *	  Routines to handle incremental sorting of relations.
+ *
+ * An incremental sort is used when the input is already sorted by a prefix
+ * of the required sort keys.  Rather than sorting the whole input, it only
+ * sorts each group of tuples that have equal values in the presorted keys,
+ * and emits the groups one after the other.  Each group is sorted in
+ * memory when it is small enough, and since the first group can be returned
+ * as soon as it has been read, a LIMIT above the node does not need to wait
+ * for the whole input to be read.
+ *
+ * Starting a sort has some overhead, so sorting tiny groups one at a time
+ * would be slow.  We therefore collect at least MIN_GROUP_SIZE tuples into
+ * each batch, and then keep adding tuples until the presorted keys change;
+ * a batch thus consists of whole groups, and sorting it by all the keys
+ * gives the correct order because any later input tuple has presorted keys
+ * greater than those of every tuple in the batch.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/nodeIncrementalSort.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/execdebug.h"
+#include "executor/nodeIncrementalSort.h"
+#include "miscadmin.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplesort.h"
+
+/* Minimum number of tuples to sort at once */
+#define MIN_GROUP_SIZE 32
+
+
+/*
+ * Start sorting a new batch of tuples.
+ */
+static Tuplesortstate *
+begin_batch(IncrementalSortState *node)
+{
+	IncrementalSort *plannode = (IncrementalSort *) node->ss.ps.plan;
+	Tuplesortstate *tuplesortstate;
+
+	tuplesortstate = tuplesort_begin_heap(ExecGetResultType(outerPlanState(node)),
+										  plannode->sort.numCols,
+										  plannode->sort.sortColIdx,
+										  plannode->sort.sortOperators,
+										  plannode->sort.collations,
+										  plannode->sort.nullsFirst,
+										  work_mem,
+										  NULL, false);
+
+	/*
+	 * If the result is bounded, this batch only needs to produce the tuples
+	 * that earlier batches have not already returned.
+	 */
+	if (node->bounded)
+		tuplesort_set_bound(tuplesortstate,
+							Max(node->bound - node->bound_Done, 1));
+
+	node->tuplesortstate = (void *) tuplesortstate;
+	return tuplesortstate;
+}
+
+/*
+ * Finish the current batch, recording its statistics for EXPLAIN ANALYZE.
+ */
+static void
+end_batch(IncrementalSortState *node)
+{
+	Tuplesortstate *tuplesortstate = (Tuplesortstate *) node->tuplesortstate;
+	IncrementalSortInfo *info = &node->incsort_info;
+	TuplesortInstrumentation stats;
+
+	if (tuplesortstate == NULL)
+		return;
+
+	if (node->sorting)
+	{
+		tuplesort_get_stats(tuplesortstate, &stats);
+		info->groupCount++;
+		info->sortMethods |= (1 << stats.sortMethod);
+		if (stats.spaceType == SORT_SPACE_TYPE_DISK)
+			info->maxDiskSpaceUsed = Max(info->maxDiskSpaceUsed,
+										 stats.spaceUsed);
+		else
+			info->maxMemorySpaceUsed = Max(info->maxMemorySpaceUsed,
+										   stats.spaceUsed);
+	}
+
+	tuplesort_end(tuplesortstate);
+	node->tuplesortstate = NULL;
+	node->sorting = false;
+}
+
+/*
+ * Does the slot have the same presorted keys as the group pivot?
+ */
+static bool
+same_presorted_keys(IncrementalSortState *node, TupleTableSlot *slot)
+{
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	econtext->ecxt_innertuple = node->group_pivot;
+	econtext->ecxt_outertuple = slot;
+	return ExecQualAndReset(node->presortedEq, econtext);
+}
+
+/*
+ * Read the next batch of tuples from the outer plan and sort it.  Returns
+ * false if there are no more tuples.
+ */
+static bool
+load_batch(IncrementalSortState *node)
+{
+	PlanState  *outerNode = outerPlanState(node);
+	Tuplesortstate *tuplesortstate;
+	TupleTableSlot *slot;
+	int64		ntuples = 0;
+
+	if (node->outerNodeDone && TupIsNull(node->group_pivot))
+		return false;
+
+	tuplesortstate = begin_batch(node);
+
+	/*
+	 * The first tuple of this batch may have been read already, while the
+	 * previous batch was being filled.
+	 */
+	if (!TupIsNull(node->group_pivot))
+	{
+		tuplesort_puttupleslot(tuplesortstate, node->group_pivot);
+		ExecClearTuple(node->group_pivot);
+		ntuples++;
+	}
+
+	while (!node->outerNodeDone)
+	{
+		slot = ExecProcNode(outerNode);
+
+		if (TupIsNull(slot))
+		{
+			node->outerNodeDone = true;
+			break;
+		}
+
+		/*
+		 * Once the batch is big enough, stop at the first tuple that starts a
+		 * new group, and keep it for the next batch.
+		 */
+		if (ntuples >= MIN_GROUP_SIZE && !same_presorted_keys(node, slot))
+		{
+			ExecCopySlot(node->group_pivot, slot);
+			break;
+		}
+
+		tuplesort_puttupleslot(tuplesortstate, slot);
+		ntuples++;
+
+		/* remember the group we're in once the batch is big enough */
+		if (ntuples == MIN_GROUP_SIZE)
+			ExecCopySlot(node->group_pivot, slot);
+	}
+
+	/* at this point the pivot is either empty or the next batch's first tuple */
+	if (ntuples >= MIN_GROUP_SIZE && node->outerNodeDone)
+		ExecClearTuple(node->group_pivot);
+
+	if (ntuples == 0)
+	{
+		end_batch(node);
+		return false;
+	}
+
+	tuplesort_performsort(tuplesortstate);
+	node->sorting = true;
+	return true;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecIncrementalSort
+ *
+ *		Returns the next tuple of the incrementally sorted output.
+ *		Each batch of tuples is read from the outer plan and sorted
+ *		when the tuples of the previous one have all been returned.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecIncrementalSort(PlanState *pstate)
+{
+	IncrementalSortState *node = castNode(IncrementalSortState, pstate);
+	EState	   *estate = node->ss.ps.state;
+	ScanDirection dir = estate->es_direction;
+	TupleTableSlot *slot = node->ss.ps.ps_ResultTupleSlot;
+
+	CHECK_FOR_INTERRUPTS();
+
+	/* we don't support backward scans */
+	Assert(ScanDirectionIsForward(dir));
+
+	for (;;)
+	{
+		if (node->sorting)
+		{
+			if (tuplesort_gettupleslot((Tuplesortstate *) node->tuplesortstate,
+									   true, false, slot, NULL))
+			{
+				node->bound_Done++;
+				return slot;
+			}
+			end_batch(node);
+		}
+
+		/* once the bound has been reached, there's no need to read further */
+		if (node->bounded && node->bound_Done >= node->bound)
+			return ExecClearTuple(slot);
+
+		SO1_printf("ExecIncrementalSort: %s\n", "sorting next batch");
+
+		if (!load_batch(node))
+			return ExecClearTuple(slot);
+	}
+}
+
+/* ----------------------------------------------------------------
+ *		ExecInitIncrementalSort
+ *
+ *		Creates the run-time state information for the incremental sort
+ *		node produced by the planner and initializes its outer subtree.
+ * ----------------------------------------------------------------
+ */
+IncrementalSortState *
+ExecInitIncrementalSort(IncrementalSort *node, EState *estate, int eflags)
+{
+	IncrementalSortState *incrsortstate;
+	Oid		   *eqOperators;
+	int			i;
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "initializing incremental sort node");
+
+	/*
+	 * Incremental sort can't be used with EXEC_FLAG_BACKWARD or
+	 * EXEC_FLAG_MARK, because we only keep one batch of tuples at a time.
+	 */
+	Assert((eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)) == 0);
+
+	/*
+	 * create state structure
+	 */
+	incrsortstate = makeNode(IncrementalSortState);
+	incrsortstate->ss.ps.plan = (Plan *) node;
+	incrsortstate->ss.ps.state = estate;
+	incrsortstate->ss.ps.ExecProcNode = ExecIncrementalSort;
+
+	incrsortstate->bounded = false;
+	incrsortstate->outerNodeDone = false;
+	incrsortstate->sorting = false;
+	incrsortstate->bound_Done = 0;
+	incrsortstate->tuplesortstate = NULL;
+
+	/*
+	 * Miscellaneous initialization
+	 *
+	 * We need an expression context to compare the presorted keys.
+	 */
+	ExecAssignExprContext(estate, &incrsortstate->ss.ps);
+
+	/*
+	 * initialize child nodes
+	 *
+	 * We shield the child node from the need to support REWIND; we re-read
+	 * the input on rescan anyway.
+	 */
+	eflags &= ~EXEC_FLAG_REWIND;
+
+	outerPlanState(incrsortstate) = ExecInitNode(outerPlan(node), estate, eflags);
+
+	/*
+	 * Initialize scan slot and type.
+	 */
+	ExecCreateScanSlotFromOuterPlan(estate, &incrsortstate->ss, &TTSOpsVirtual);
+
+	/*
+	 * Initialize return slot and type. No need to initialize projection info
+	 * because this node doesn't do projections.
+	 */
+	ExecInitResultTupleSlotTL(&incrsortstate->ss.ps, &TTSOpsMinimalTuple);
+	incrsortstate->ss.ps.ps_ProjInfo = NULL;
+
+	/* slot for the group pivot */
+	incrsortstate->group_pivot =
+		ExecInitExtraTupleSlot(estate,
+							   ExecGetResultType(outerPlanState(incrsortstate)),
+							   &TTSOpsMinimalTuple);
+
+	/*
+	 * Precompute the comparison of the presorted keys.  The sort operators
+	 * come from btree opfamilies, so they all have matching equality
+	 * operators.
+	 */
+	eqOperators = (Oid *) palloc(node->nPresortedCols * sizeof(Oid));
+	for (i = 0; i < node->nPresortedCols; i++)
+	{
+		eqOperators[i] = get_equality_op_for_ordering_op(node->sort.sortOperators[i],
+														 NULL);
+		if (!OidIsValid(eqOperators[i]))
+			elog(ERROR, "missing equality operator for ordering operator %u",
+				 node->sort.sortOperators[i]);
+	}
+
+	incrsortstate->presortedEq =
+		execTuplesMatchPrepare(ExecGetResultType(outerPlanState(incrsortstate)),
+							   node->nPresortedCols,
+							   node->sort.sortColIdx,
+							   eqOperators,
+							   node->sort.collations,
+							   &incrsortstate->ss.ps);
+
+	SO1_printf("ExecInitIncrementalSort: %s\n",
+			   "incremental sort node initialized");
+
+	return incrsortstate;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecEndIncrementalSort(node)
+ * ----------------------------------------------------------------
+ */
+void
+ExecEndIncrementalSort(IncrementalSortState *node)
+{
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "shutting down incremental sort node");
+
+	ExecFreeExprContext(&node->ss.ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	/* must drop pointer to sort result tuple */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->group_pivot);
+
+	/*
+	 * Release tuplesort resources
+	 */
+	end_batch(node);
+
+	/*
+	 * shut down the subplan
+	 */
+	ExecEndNode(outerPlanState(node));
+
+	SO1_printf("ExecEndIncrementalSort: %s\n",
+			   "incremental sort node shutdown");
+}
+
+void
+ExecReScanIncrementalSort(IncrementalSortState *node)
+{
+	PlanState  *outerPlan = outerPlanState(node);
+
+	/*
+	 * We only keep the current batch, so we always have to re-read the
+	 * subplan and sort it again.
+	 */
+	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	ExecClearTuple(node->group_pivot);
+	end_batch(node);
+
+	node->outerNodeDone = false;
+	node->bound_Done = 0;
+
+	/*
+	 * if chgParam of subnode is not null then plan will be re-scanned by
+	 * first ExecProcNode.
+	 */
+	if (outerPlan->chgParam == NULL)
+		ExecReScan(outerPlan);
+}
@@ -30,6 +30,8 @@
  */
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/genam.h"
 #include "access/relscan.h"
 #include "access/tableam.h"
@@ -39,15 +41,20 @@
 #include "executor/nodeIndexonlyscan.h"
 #include "executor/nodeIndexscan.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/predicate.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/spccache.h"
 
 
 static TupleTableSlot *IndexOnlyNext(IndexOnlyScanState *node);
 static void StoreIndexTuple(TupleTableSlot *slot, IndexTuple itup,
 							TupleDesc itupdesc);
+static void IndexOnlySetupScanDesc(IndexOnlyScanState *node);
+static void IndexOnlyPrefetchHeap(IndexScanDesc scandesc, ItemPointer tids,
+								  int ntids);
 
 
 /* ----------------------------------------------------------------
@@ -97,11 +104,8 @@ IndexOnlyNext(IndexOnlyScanState *node)
 								   node->ioss_NumOrderByKeys);
 
 		node->ioss_ScanDesc = scandesc;
-
-
-		/* Set it up for index-only scan */
-		node->ioss_ScanDesc->xs_want_itup = true;
 		node->ioss_VMBuffer = InvalidBuffer;
+		IndexOnlySetupScanDesc(node);
 
 		/*
 		 * If no run-time keys to calculate or they are ready, go ahead and
@@ -166,6 +170,7 @@ IndexOnlyNext(IndexOnlyScanState *node)
 			 * Rats, we have to visit the heap to check visibility.
 			 */
 			InstrCountTuples2(node, 1);
+			pgstat_count_index_heap_fetch(scandesc->indexRelation);
 			if (!index_fetch_heap(scandesc, node->ioss_TableSlot))
 				continue;		/* no visible tuple, try next index entry */
 
@@ -284,6 +289,61 @@ StoreIndexTuple(TupleTableSlot *slot, IndexTuple itup, TupleDesc itupdesc)
 	ExecStoreVirtualTuple(slot);
 }
 
+/*
+ * IndexOnlySetupScanDesc
+ *		Prepare a freshly created index scan descriptor for index-only use.
+ */
+static void
+IndexOnlySetupScanDesc(IndexOnlyScanState *node)
+{
+	IndexScanDesc scandesc = node->ioss_ScanDesc;
+
+	scandesc->xs_want_itup = true;
+
+	if (node->ioss_PrefetchMaximum > 0)
+	{
+		scandesc->xs_prefetch_heap = IndexOnlyPrefetchHeap;
+		scandesc->xs_prefetch_arg = node;
+	}
+}
+
+/*
+ * IndexOnlyPrefetchHeap
+ *		Prefetch the heap pages an upcoming batch of index entries will need.
+ *
+ * Called by the index AM with the TIDs of an index page's matches.  Entries
+ * on all-visible heap pages will be answered from the index alone, so we
+ * only prefetch pages whose visibility map bit is clear, and at most
+ * ioss_PrefetchMaximum distinct ones per batch so that a scan stopped early
+ * by a LIMIT doesn't pay for I/O it never uses.
+ */
+static void
+IndexOnlyPrefetchHeap(IndexScanDesc scandesc, ItemPointer tids, int ntids)
+{
+#ifdef USE_PREFETCH
+	IndexOnlyScanState *node = (IndexOnlyScanState *) scandesc->xs_prefetch_arg;
+	BlockNumber lastblock = InvalidBlockNumber;
+	int			nprefetched = 0;
+	int			i;
+
+	for (i = 0; i < ntids && nprefetched < node->ioss_PrefetchMaximum; i++)
+	{
+		BlockNumber blkno = ItemPointerGetBlockNumber(&tids[i]);
+
+		if (blkno == lastblock)
+			continue;
+		lastblock = blkno;
+
+		if (VM_ALL_VISIBLE(scandesc->heapRelation, blkno,
+						   &node->ioss_VMBuffer))
+			continue;
+
+		PrefetchBuffer(scandesc->heapRelation, MAIN_FORKNUM, blkno);
+		nprefetched++;
+	}
+#endif							/* USE_PREFETCH */
+}
+
 /*
  * IndexOnlyRecheck -- access method routine to recheck a tuple in EvalPlanQual
  *
@@ -520,6 +580,25 @@ ExecInitIndexOnlyScan(IndexOnlyScan *node, EState *estate, int eflags)
 	indexstate->ss.ss_currentRelation = currentRelation;
 	indexstate->ss.ss_currentScanDesc = NULL;	/* no heap scan here */
 
+	/*
+	 * Heap pages that aren't all-visible are prefetched as the index AM
+	 * reports upcoming TIDs, up to the tablespace's I/O concurrency.
+	 */
+	indexstate->ioss_PrefetchMaximum = target_prefetch_pages;
+	{
+		int			io_concurrency;
+
+		io_concurrency =
+			get_tablespace_io_concurrency(currentRelation->rd_rel->reltablespace);
+		if (io_concurrency != effective_io_concurrency)
+		{
+			double		maximum;
+
+			if (ComputeIoConcurrency(io_concurrency, &maximum))
+				indexstate->ioss_PrefetchMaximum = rint(maximum);
+		}
+	}
+
 	/*
 	 * Build the scan tuple type using the indextlist generated by the
 	 * planner.  We use this, rather than the index's physical tuple
@@ -679,8 +758,8 @@ ExecIndexOnlyScanInitializeDSM(IndexOnlyScanState *node,
 								 node->ioss_NumScanKeys,
 								 node->ioss_NumOrderByKeys,
 								 piscan);
-	node->ioss_ScanDesc->xs_want_itup = true;
 	node->ioss_VMBuffer = InvalidBuffer;
+	IndexOnlySetupScanDesc(node);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -724,7 +803,7 @@ ExecIndexOnlyScanInitializeWorker(IndexOnlyScanState *node,
 								 node->ioss_NumScanKeys,
 								 node->ioss_NumOrderByKeys,
 								 piscan);
-	node->ioss_ScanDesc->xs_want_itup = true;
+	IndexOnlySetupScanDesc(node);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -29,6 +29,8 @@
  */
 #include "postgres.h"
 
+#include <math.h>
+
 #include "access/nbtree.h"
 #include "access/relscan.h"
 #include "access/tableam.h"
@@ -38,11 +40,13 @@
 #include "lib/pairingheap.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "storage/bufmgr.h"
 #include "utils/array.h"
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/spccache.h"
 
 /*
  * When an ordering operator is used, tuples fetched from the index that
@@ -68,6 +72,10 @@ static int	reorderqueue_cmp(const pairingheap_node *a,
 static void reorderqueue_push(IndexScanState *node, TupleTableSlot *slot,
 							  Datum *orderbyvals, bool *orderbynulls);
 static HeapTuple reorderqueue_pop(IndexScanState *node);
+static void IndexSetupPrefetch(IndexScanState *node);
+static void IndexPrefetchBatch(IndexScanDesc scandesc, ItemPointer tids,
+							   int ntids);
+static void IndexPrefetchAdvance(IndexScanState *node);
 
 
 /* ----------------------------------------------------------------
@@ -116,6 +124,7 @@ IndexNext(IndexScanState *node)
 								   node->iss_NumOrderByKeys);
 
 		node->iss_ScanDesc = scandesc;
+		IndexSetupPrefetch(node);
 
 		/*
 		 * If no run-time keys to calculate or they are ready, go ahead and
@@ -134,6 +143,19 @@ IndexNext(IndexScanState *node)
 	{
 		CHECK_FOR_INTERRUPTS();
 
+		/*
+		 * Each time the scan moves on to another heap page, one of the pages
+		 * we prefetched has been consumed, so top up the read-ahead window.
+		 */
+		if (node->iss_PrefetchNumTids > 0 &&
+			ItemPointerGetBlockNumber(&scandesc->xs_heaptid) != node->iss_CurrentBlock)
+		{
+			node->iss_CurrentBlock = ItemPointerGetBlockNumber(&scandesc->xs_heaptid);
+			if (node->iss_PrefetchPages > 0)
+				node->iss_PrefetchPages--;
+			IndexPrefetchAdvance(node);
+		}
+
 		/*
 		 * If the index was lossy, we have to recheck the index quals using
 		 * the fetched tuple.
@@ -382,6 +404,86 @@ EvalOrderByExpressions(IndexScanState *node, ExprContext *econtext)
 	MemoryContextSwitchTo(oldContext);
 }
 
+/*
+ * IndexSetupPrefetch -- ask the index AM to report upcoming heap TIDs
+ *
+ * Scans with ORDER BY operators may return tuples out of index order after
+ * rechecking, so we don't read ahead for them.
+ */
+static void
+IndexSetupPrefetch(IndexScanState *node)
+{
+	IndexScanDesc scandesc = node->iss_ScanDesc;
+
+	node->iss_PrefetchNumTids = 0;
+
+	if (node->iss_PrefetchMaximum > 0 && node->iss_NumOrderByKeys == 0)
+	{
+		scandesc->xs_prefetch_heap = IndexPrefetchBatch;
+		scandesc->xs_prefetch_arg = node;
+	}
+}
+
+/*
+ * IndexPrefetchBatch -- remember a batch of heap TIDs from the index AM
+ *
+ * The AM hands us the TIDs of an index page's matches in the order it is
+ * going to return them.  We keep a copy and start prefetching their heap
+ * pages; IndexNext keeps the read-ahead window topped up as the scan moves
+ * through the batch.
+ */
+static void
+IndexPrefetchBatch(IndexScanDesc scandesc, ItemPointer tids, int ntids)
+{
+	IndexScanState *node = (IndexScanState *) scandesc->xs_prefetch_arg;
+
+	if (node->iss_PrefetchTids == NULL)
+		node->iss_PrefetchTids = (ItemPointerData *)
+			MemoryContextAlloc(node->ss.ps.state->es_query_cxt,
+							   MaxTIDsPerBTreePage * sizeof(ItemPointerData));
+
+	ntids = Min(ntids, MaxTIDsPerBTreePage);
+	memcpy(node->iss_PrefetchTids, tids, ntids * sizeof(ItemPointerData));
+	node->iss_PrefetchNumTids = ntids;
+	node->iss_PrefetchNext = 0;
+	node->iss_PrefetchPages = 0;
+	node->iss_PrefetchBlock = InvalidBlockNumber;
+	node->iss_CurrentBlock = InvalidBlockNumber;
+
+	IndexPrefetchAdvance(node);
+}
+
+/*
+ * IndexPrefetchAdvance -- issue prefetches until the window is full
+ *
+ * Consecutive TIDs on the same heap page are prefetched only once.  Like
+ * bitmap heap scans, we count prefetched pages against the scan's current
+ * position, not against what is actually still in the kernel's cache.
+ */
+static void
+IndexPrefetchAdvance(IndexScanState *node)
+{
+#ifdef USE_PREFETCH
+	Relation	heapRel = node->ss.ss_currentRelation;
+
+	while (node->iss_PrefetchPages < node->iss_PrefetchMaximum &&
+		   node->iss_PrefetchNext < node->iss_PrefetchNumTids)
+	{
+		BlockNumber blkno;
+
+		blkno = ItemPointerGetBlockNumber(&node->iss_PrefetchTids[node->iss_PrefetchNext]);
+		node->iss_PrefetchNext++;
+
+		if (blkno == node->iss_PrefetchBlock)
+			continue;
+		node->iss_PrefetchBlock = blkno;
+
+		PrefetchBuffer(heapRel, MAIN_FORKNUM, blkno);
+		node->iss_PrefetchPages++;
+	}
+#endif							/* USE_PREFETCH */
+}
+
 /*
  * IndexRecheck -- access method routine to recheck a tuple in EvalPlanQual
  */
@@ -584,6 +686,7 @@ ExecReScanIndexScan(IndexScanState *node)
 					 node->iss_ScanKeys, node->iss_NumScanKeys,
 					 node->iss_OrderByKeys, node->iss_NumOrderByKeys);
 	node->iss_ReachedEnd = false;
+	node->iss_PrefetchNumTids = 0;
 
 	ExecScanReScan(&node->ss);
 }
@@ -926,6 +1029,25 @@ ExecInitIndexScan(IndexScan *node, EState *estate, int eflags)
 	indexstate->ss.ss_currentRelation = currentRelation;
 	indexstate->ss.ss_currentScanDesc = NULL;	/* no heap scan here */
 
+	/*
+	 * Heap pages are read ahead from the TIDs the index AM reports, up to the
+	 * tablespace's I/O concurrency.
+	 */
+	indexstate->iss_PrefetchMaximum = target_prefetch_pages;
+	{
+		int			io_concurrency;
+
+		io_concurrency =
+			get_tablespace_io_concurrency(currentRelation->rd_rel->reltablespace);
+		if (io_concurrency != effective_io_concurrency)
+		{
+			double		maximum;
+
+			if (ComputeIoConcurrency(io_concurrency, &maximum))
+				indexstate->iss_PrefetchMaximum = rint(maximum);
+		}
+	}
+
 	/*
 	 * get the scan type from the relation descriptor.
 	 */
@@ -1688,6 +1810,7 @@ ExecIndexScanInitializeDSM(IndexScanState *node,
 								 node->iss_NumScanKeys,
 								 node->iss_NumOrderByKeys,
 								 piscan);
+	IndexSetupPrefetch(node);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
@@ -1731,6 +1854,7 @@ ExecIndexScanInitializeWorker(IndexScanState *node,
 								 node->iss_NumScanKeys,
 								 node->iss_NumOrderByKeys,
 								 piscan);
+	IndexSetupPrefetch(node);
 
 	/*
 	 * If no run-time keys to calculate or they are ready, go ahead and pass
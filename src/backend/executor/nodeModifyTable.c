@@ -39,6 +39,7 @@
 
 #include "access/heapam.h"
 #include "access/htup_details.h"
+#include "access/parallel.h"
 #include "access/tableam.h"
 #include "access/xact.h"
 #include "catalog/catalog.h"
@@ -583,10 +584,14 @@ ExecInsert(ModifyTableState *mtstate,
 		}
 		else
 		{
-			/* insert the tuple normally */
+			/*
+			 * Insert the tuple normally.  In a parallel worker, the planner
+			 * has checked that the table can take it.
+			 */
 			table_tuple_insert(resultRelationDesc, slot,
 							   estate->es_output_cid,
-							   0, NULL);
+							   IsParallelWorker() ? TABLE_INSERT_PARALLEL : 0,
+							   NULL);
 
 			/* insert index entries for tuple */
 			if (resultRelInfo->ri_NumIndices > 0)
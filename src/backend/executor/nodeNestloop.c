@@ -24,9 +24,43 @@
 #include "executor/execdebug.h"
 #include "executor/nodeNestloop.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
 
 
+/*
+ * When the plan has hashclauses, we switch to hashing the inner tuples once
+ * the outer plan has returned NESTLOOP_HASH_FACTOR times as many tuples as
+ * estimated, and at least NESTLOOP_HASH_MIN_ROWS.
+ */
+#define NESTLOOP_HASH_FACTOR	10.0
+#define NESTLOOP_HASH_MIN_ROWS	1000.0
+
+/*
+ * The inner tuples are kept in the hash table in lists, one per distinct key,
+ * in the order the inner plan returned them; so the join returns its tuples
+ * in the same order as it would without hashing.
+ */
+typedef struct NestLoopHashTuple
+{
+	struct NestLoopHashTuple *next;
+	MinimalTuple tuple;
+} NestLoopHashTuple;
+
+typedef struct NestLoopHashGroup
+{
+	NestLoopHashTuple *head;
+	NestLoopHashTuple *tail;
+} NestLoopHashGroup;
+
+static void ExecInitNestLoopHash(NestLoopState *nlstate, EState *estate);
+static double ExecNestLoopHashThreshold(NestLoopState *node);
+static void ExecNestLoopSwitchToHash(NestLoopState *node);
+static NestLoopHashTuple *ExecNestLoopHashProbe(NestLoopState *node);
+static bool slotNoNulls(TupleTableSlot *slot);
+
+
 /* ----------------------------------------------------------------
  *		ExecNestLoop(node)
  *
@@ -146,10 +180,24 @@ ExecNestLoop(PlanState *pstate)
 			}
 
 			/*
-			 * now rescan the inner plan
+			 * If the outer plan has returned many more tuples than expected,
+			 * try to switch to hashing the inner tuples.
+			 */
+			if (!node->nl_Hashing && node->nl_HashThreshold >= 0 &&
+				++node->nl_OuterCount > node->nl_HashThreshold)
+				ExecNestLoopSwitchToHash(node);
+
+			/*
+			 * now rescan the inner plan, or look up the inner tuples that
+			 * may match if we're hashing
 			 */
-			ENL1_printf("rescanning inner plan");
-			ExecReScan(innerPlan);
+			if (node->nl_Hashing)
+				node->nl_CurMatch = ExecNestLoopHashProbe(node);
+			else
+			{
+				ENL1_printf("rescanning inner plan");
+				ExecReScan(innerPlan);
+			}
 		}
 
 		/*
@@ -157,7 +205,22 @@ ExecNestLoop(PlanState *pstate)
 		 */
 		ENL1_printf("getting new inner tuple");
 
-		innerTupleSlot = ExecProcNode(innerPlan);
+		if (node->nl_Hashing)
+		{
+			NestLoopHashTuple *match = node->nl_CurMatch;
+
+			if (match != NULL)
+			{
+				node->nl_CurMatch = match->next;
+				innerTupleSlot = ExecStoreMinimalTuple(match->tuple,
+													   node->nl_HashInnerSlot,
+													   false);
+			}
+			else
+				innerTupleSlot = NULL;
+		}
+		else
+			innerTupleSlot = ExecProcNode(innerPlan);
 		econtext->ecxt_innertuple = innerTupleSlot;
 
 		if (TupIsNull(innerTupleSlot))
@@ -340,6 +403,20 @@ ExecInitNestLoop(NestLoop *node, EState *estate, int eflags)
 				 (int) node->join.jointype);
 	}
 
+	/*
+	 * set up for switching to hashing, if possible
+	 */
+	if (node->hashclauses != NIL && !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		ExecInitNestLoopHash(nlstate, estate);
+		nlstate->nl_HashThreshold = ExecNestLoopHashThreshold(nlstate);
+	}
+	else
+		nlstate->nl_HashThreshold = -1;
+	nlstate->nl_OuterCount = 0;
+	nlstate->nl_Hashing = false;
+	nlstate->nl_HashSwitchRow = 0;
+
 	/*
 	 * finally, wipe the current outer tuple clean.
 	 */
@@ -406,6 +483,320 @@ ExecReScanNestLoop(NestLoopState *node)
 	 * outer Vars are used as run-time keys...
 	 */
 
+	/*
+	 * The inner tuples may change, so forget any hash table of them.
+	 */
+	if (node->nl_HashTable != NULL)
+	{
+		ResetTupleHashTable(node->nl_HashTable);
+		MemoryContextReset(node->nl_HashTableContext);
+		node->nl_HashThreshold = ExecNestLoopHashThreshold(node);
+	}
+	node->nl_OuterCount = 0;
+	node->nl_Hashing = false;
+	node->nl_CurMatch = NULL;
+
 	node->nl_NeedNewOuter = true;
 	node->nl_MatchedOuter = false;
 }
+
+/* ----------------------------------------------------------------
+ *		ExecInitNestLoopHash
+ *
+ *		Set up what we need to switch to hashing the inner tuples
+ *		on the plan's hashclauses.  This follows the setup for hashed
+ *		subplans in nodeSubplan.c.
+ * ----------------------------------------------------------------
+ */
+static void
+ExecInitNestLoopHash(NestLoopState *nlstate, EState *estate)
+{
+	NestLoop   *node = (NestLoop *) nlstate->js.ps.plan;
+	int			ncols = list_length(node->hashclauses);
+	AttrNumber *keyColIdx;
+	Oid		   *tab_eq_funcoids;
+	Oid		   *cross_eq_funcoids;
+	FmgrInfo   *tab_hash_funcs;
+	Oid		   *tab_collations;
+	List	   *outertlist = NIL;
+	List	   *innertlist = NIL;
+	TupleDesc	outerdesc;
+	TupleDesc	innerdesc;
+	TupleTableSlot *slot;
+	ListCell   *lc;
+	long		nbuckets;
+	int			i;
+
+	/* We need a memory context to hold the hash table */
+	nlstate->nl_HashTableContext =
+		AllocSetContextCreate(CurrentMemoryContext,
+							  "NestLoop HashTable Context",
+							  ALLOCSET_DEFAULT_SIZES);
+	/* and a small one for the hash table to use as temp storage */
+	nlstate->nl_HashTempContext =
+		AllocSetContextCreate(CurrentMemoryContext,
+							  "NestLoop HashTable Temp Context",
+							  ALLOCSET_SMALL_SIZES);
+	/* and a short-lived exprcontext for computing inner keys */
+	nlstate->nl_InnerKeyContext = CreateExprContext(estate);
+
+	/* Silly little array of column numbers 1..n */
+	keyColIdx = (AttrNumber *) palloc(ncols * sizeof(AttrNumber));
+	for (i = 0; i < ncols; i++)
+		keyColIdx[i] = i + 1;
+
+	tab_eq_funcoids = (Oid *) palloc(ncols * sizeof(Oid));
+	cross_eq_funcoids = (Oid *) palloc(ncols * sizeof(Oid));
+	tab_hash_funcs = (FmgrInfo *) palloc(ncols * sizeof(FmgrInfo));
+	tab_collations = (Oid *) palloc(ncols * sizeof(Oid));
+	nlstate->nl_OuterHashFunctions =
+		(FmgrInfo *) palloc(ncols * sizeof(FmgrInfo));
+
+	i = 1;
+	foreach(lc, node->hashclauses)
+	{
+		OpExpr	   *opexpr = lfirst_node(OpExpr, lc);
+		Oid			rhs_eq_oper;
+		Oid			left_hashfn;
+		Oid			right_hashfn;
+
+		Assert(list_length(opexpr->args) == 2);
+
+		/* The outer argument is on the left, see create_nestloop_plan */
+		outertlist = lappend(outertlist,
+							 makeTargetEntry((Expr *) linitial(opexpr->args),
+											 i, NULL, false));
+		innertlist = lappend(innertlist,
+							 makeTargetEntry((Expr *) lsecond(opexpr->args),
+											 i, NULL, false));
+
+		/* The equality function, potentially cross-type */
+		cross_eq_funcoids[i - 1] = opexpr->opfuncid;
+
+		/* The equality function for the inner type */
+		if (!get_compatible_hash_operators(opexpr->opno,
+										   NULL, &rhs_eq_oper))
+			elog(ERROR, "could not find compatible hash operator for operator %u",
+				 opexpr->opno);
+		tab_eq_funcoids[i - 1] = get_opcode(rhs_eq_oper);
+
+		/* The associated hash functions */
+		if (!get_op_hash_functions(opexpr->opno,
+								   &left_hashfn, &right_hashfn))
+			elog(ERROR, "could not find hash function for hash operator %u",
+				 opexpr->opno);
+		execHashFunctionInfo(left_hashfn, right_hashfn,
+							 &nlstate->nl_OuterHashFunctions[i - 1],
+							 &tab_hash_funcs[i - 1]);
+
+		tab_collations[i - 1] = opexpr->inputcollid;
+
+		i++;
+	}
+
+	/*
+	 * The outer keys are computed in the node's own exprcontext, where the
+	 * current outer tuple is, and the inner keys in nl_InnerKeyContext.
+	 */
+	outerdesc = ExecTypeFromTL(outertlist);
+	slot = ExecInitExtraTupleSlot(estate, outerdesc, &TTSOpsVirtual);
+	nlstate->nl_OuterKeyProj =
+		ExecBuildProjectionInfo(outertlist,
+								nlstate->js.ps.ps_ExprContext,
+								slot,
+								&nlstate->js.ps,
+								NULL);
+
+	innerdesc = ExecTypeFromTL(innertlist);
+	slot = ExecInitExtraTupleSlot(estate, innerdesc, &TTSOpsVirtual);
+	nlstate->nl_InnerKeyProj =
+		ExecBuildProjectionInfo(innertlist,
+								nlstate->nl_InnerKeyContext,
+								slot,
+								&nlstate->js.ps,
+								NULL);
+
+	/* Comparator for lookups of outer keys in the table */
+	nlstate->nl_CrossEqComp =
+		ExecBuildGroupingEqual(outerdesc, innerdesc,
+							   &TTSOpsVirtual, &TTSOpsMinimalTuple,
+							   ncols,
+							   keyColIdx,
+							   cross_eq_funcoids,
+							   tab_collations,
+							   &nlstate->js.ps);
+
+	/*
+	 * Create the hash table now, but small, since we don't expect to need
+	 * it; it'll grow as needed.
+	 */
+	nbuckets = (long) Min(innerPlan(node)->plan_rows, 256.0);
+	if (nbuckets < 1)
+		nbuckets = 1;
+	nlstate->nl_HashTable =
+		BuildTupleHashTableExt(&nlstate->js.ps,
+							   innerdesc,
+							   ncols,
+							   keyColIdx,
+							   tab_eq_funcoids,
+							   tab_hash_funcs,
+							   tab_collations,
+							   nbuckets,
+							   0,
+							   estate->es_query_cxt,
+							   nlstate->nl_HashTableContext,
+							   nlstate->nl_HashTempContext,
+							   false);
+
+	/* Slot to return inner tuples from the hash table in */
+	nlstate->nl_HashInnerSlot =
+		ExecInitExtraTupleSlot(estate,
+							   ExecGetResultType(innerPlanState(nlstate)),
+							   &TTSOpsMinimalTuple);
+}
+
+/*
+ * ExecNestLoopHashThreshold
+ *		Number of outer tuples after which to switch to hashing.
+ */
+static double
+ExecNestLoopHashThreshold(NestLoopState *node)
+{
+	Plan	   *outerPlan = outerPlan(node->js.ps.plan);
+
+	return Max(outerPlan->plan_rows * NESTLOOP_HASH_FACTOR,
+			   NESTLOOP_HASH_MIN_ROWS);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecNestLoopSwitchToHash
+ *
+ *		Load all inner tuples into the hash table, and start using it
+ *		instead of rescanning the inner plan.  If they don't fit in
+ *		work_mem, give up on hashing until the next rescan of the node
+ *		and keep doing a plain nested loop.
+ * ----------------------------------------------------------------
+ */
+static void
+ExecNestLoopSwitchToHash(NestLoopState *node)
+{
+	PlanState  *innerPlan = innerPlanState(node);
+	ExprContext *keycontext = node->nl_InnerKeyContext;
+	TupleHashTable hashtable = node->nl_HashTable;
+	Size		spaceUsed = 0;
+	Size		spaceAllowed = work_mem * 1024L;
+	TupleTableSlot *slot;
+
+	ExecReScan(innerPlan);
+
+	for (slot = ExecProcNode(innerPlan);
+		 !TupIsNull(slot);
+		 slot = ExecProcNode(innerPlan))
+	{
+		TupleTableSlot *keyslot;
+		TupleHashEntry entry;
+		NestLoopHashGroup *group;
+		NestLoopHashTuple *hashtup;
+		MemoryContext oldcontext;
+		bool		isnew;
+
+		keycontext->ecxt_innertuple = slot;
+		keyslot = ExecProject(node->nl_InnerKeyProj);
+
+		/* Rows with null keys can't satisfy the strict hash clauses */
+		if (!slotNoNulls(keyslot))
+		{
+			ResetExprContext(keycontext);
+			continue;
+		}
+
+		entry = LookupTupleHashEntry(hashtable, keyslot, &isnew);
+
+		oldcontext = MemoryContextSwitchTo(node->nl_HashTableContext);
+		if (isnew)
+		{
+			group = (NestLoopHashGroup *) palloc0(sizeof(NestLoopHashGroup));
+			entry->additional = group;
+			spaceUsed += sizeof(TupleHashEntryData) +
+				sizeof(NestLoopHashGroup) + entry->firstTuple->t_len;
+		}
+		else
+			group = (NestLoopHashGroup *) entry->additional;
+
+		hashtup = (NestLoopHashTuple *) palloc(sizeof(NestLoopHashTuple));
+		hashtup->tuple = ExecCopySlotMinimalTuple(slot);
+		hashtup->next = NULL;
+		if (group->tail)
+			group->tail->next = hashtup;
+		else
+			group->head = hashtup;
+		group->tail = hashtup;
+		MemoryContextSwitchTo(oldcontext);
+
+		spaceUsed += sizeof(NestLoopHashTuple) + hashtup->tuple->t_len;
+
+		ResetExprContext(keycontext);
+		MemoryContextReset(node->nl_HashTempContext);
+
+		if (spaceUsed > spaceAllowed)
+		{
+			ExecClearTuple(node->nl_InnerKeyProj->pi_state.resultslot);
+			ResetTupleHashTable(hashtable);
+			MemoryContextReset(node->nl_HashTableContext);
+			node->nl_HashThreshold = -1;
+			return;
+		}
+	}
+
+	ExecClearTuple(node->nl_InnerKeyProj->pi_state.resultslot);
+
+	node->nl_Hashing = true;
+	node->nl_HashSwitchRow = node->nl_OuterCount;
+}
+
+/*
+ * ExecNestLoopHashProbe
+ *		Return the list of inner tuples whose keys match those of the
+ *		current outer tuple, or NULL if there are none.
+ */
+static NestLoopHashTuple *
+ExecNestLoopHashProbe(NestLoopState *node)
+{
+	TupleTableSlot *keyslot;
+	TupleHashEntry entry;
+
+	keyslot = ExecProject(node->nl_OuterKeyProj);
+
+	/* Null keys can't satisfy the strict hash clauses */
+	if (!slotNoNulls(keyslot))
+		entry = NULL;
+	else
+		entry = FindTupleHashEntry(node->nl_HashTable, keyslot,
+								   node->nl_CrossEqComp,
+								   node->nl_OuterHashFunctions);
+
+	ExecClearTuple(keyslot);
+	MemoryContextReset(node->nl_HashTempContext);
+
+	if (entry == NULL)
+		return NULL;
+	return ((NestLoopHashGroup *) entry->additional)->head;
+}
+
+/*
+ * slotNoNulls: is the slot entirely not NULL?
+ */
+static bool
+slotNoNulls(TupleTableSlot *slot)
+{
+	int			ncols = slot->tts_tupleDescriptor->natts;
+	int			i;
+
+	slot_getallattrs(slot);
+	for (i = 0; i < ncols; i++)
+	{
+		if (slot->tts_isnull[i])
+			return false;
+	}
+	return true;
+}
@@ -24,16 +24,39 @@
  *		ExecSeqScanInitializeDSM initialize DSM for parallel scan
  *		ExecSeqScanReInitializeDSM reinitialize DSM for fresh parallel scan
  *		ExecSeqScanInitializeWorker attach to DSM info in parallel worker
+ *		ExecSeqScanStartBatchMode	fetch tuples in batches, for a parent node
+ *		ExecSeqScanNextBatch	retrieve the next batch of qualifying tuples
  */
 #include "postgres.h"
 
+#include "access/nbtree.h"
 #include "access/relscan.h"
 #include "access/tableam.h"
+#include "executor/execBatch.h"
+#include "executor/execScan.h"
 #include "executor/execdebug.h"
+#include "executor/hashjoin.h"
+#include "executor/nodeHash.h"
 #include "executor/nodeSeqscan.h"
+#include "miscadmin.h"
+#include "optimizer/optimizer.h"
+#include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/typcache.h"
+
+/*
+ * In batch mode with a regular parent node, start with small batches and
+ * double their size up to executor_batch_size, so that a scan of which only
+ * the first few rows are needed doesn't fetch many more.
+ */
+#define SEQSCAN_INITIAL_BATCH_ROWS	64
 
 static TupleTableSlot *SeqNext(SeqScanState *node);
+static inline bool SeqScanBloomFilterPass(SeqScanState *node,
+										  TupleTableSlot *slot);
+static void SeqScanSetColumnHints(SeqScanState *node);
+static void ExecSeqScanInitBatch(SeqScanState *node);
+static bool SeqNextBatch(SeqScanState *node);
 
 /* ----------------------------------------------------------------
  *						Scan Support
@@ -72,16 +95,201 @@ SeqNext(SeqScanState *node)
 								   estate->es_snapshot,
 								   0, NULL);
 		node->ss.ss_currentScanDesc = scandesc;
+		SeqScanSetColumnHints(node);
 	}
 
 	/*
-	 * get the next tuple from the table
+	 * get the next tuple from the table, skipping those that can't pass a
+	 * parent HashJoin's Bloom filter
 	 */
-	if (table_scan_getnextslot(scandesc, direction, slot))
-		return slot;
+	while (table_scan_getnextslot(scandesc, direction, slot))
+	{
+		if (SeqScanBloomFilterPass(node, slot))
+			return slot;
+		CHECK_FOR_INTERRUPTS();
+	}
 	return NULL;
 }
 
+/*
+ * SeqScanBloomFilterPass -- test a tuple against the Bloom filter, if any
+ *
+ * A parent HashJoin may have given us a Bloom filter of its inner tuples'
+ * hash values; see ExecHashBloomFilterCreate.  Returns false if the tuple
+ * can't find a match in the join.
+ */
+static inline bool
+SeqScanBloomFilterPass(SeqScanState *node, TupleTableSlot *slot)
+{
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	if (node->bloom == NULL || !node->bloom->active)
+		return true;
+
+	econtext->ecxt_scantuple = slot;
+	if (ExecHashBloomFilterTest(node->bloom, econtext))
+		return true;
+
+	InstrCountFiltered3(node, 1);
+	return false;
+}
+
+/*
+ * SeqScanSetColumnHints -- tell the table AM what the scan's tuples are used for
+ *
+ * This is only of interest to table AMs that can avoid reading unneeded
+ * columns, or skip over tuples that can't pass the quals; see
+ * scan_set_column_hints in tableam.h.  We pass the set of attributes the
+ * targetlist and quals refer to, and those quals of the form "Var op Const"
+ * where op is a btree operator of the column type's default opfamily.
+ */
+static void
+SeqScanSetColumnHints(SeqScanState *node)
+{
+	Relation	rel = node->ss.ss_currentRelation;
+	Plan	   *plan = node->ss.ps.plan;
+	Index		scanrelid = ((Scan *) plan)->scanrelid;
+	Bitmapset  *attrs = NULL;
+	ScanKey		keys;
+	int			nkeys = 0;
+	ListCell   *lc;
+
+	if (rel->rd_tableam->scan_set_column_hints == NULL)
+		return;
+
+	pull_varattnos((Node *) plan->targetlist, scanrelid, &attrs);
+	pull_varattnos((Node *) plan->qual, scanrelid, &attrs);
+
+	keys = (ScanKey) palloc(sizeof(ScanKeyData) * Max(list_length(plan->qual), 1));
+	foreach(lc, plan->qual)
+	{
+		OpExpr	   *opexpr = (OpExpr *) lfirst(lc);
+		Var		   *var;
+		Const	   *con;
+		TypeCacheEntry *typentry;
+		int			strategy;
+		Oid			lefttype;
+		Oid			righttype;
+		Oid			cmpproc;
+
+		if (!IsA(opexpr, OpExpr) || list_length(opexpr->args) != 2)
+			continue;
+
+		var = linitial(opexpr->args);
+		con = lsecond(opexpr->args);
+		if (IsA(var, Const) && IsA(con, Var))
+		{
+			var = lsecond(opexpr->args);
+			con = linitial(opexpr->args);
+		}
+		if (!IsA(var, Var) || !IsA(con, Const) ||
+			var->varno != scanrelid || var->varlevelsup != 0 ||
+			var->varattno <= 0 || con->constisnull ||
+			opexpr->inputcollid != var->varcollid)
+			continue;
+
+		typentry = lookup_type_cache(var->vartype, TYPECACHE_BTREE_OPFAMILY);
+		if (!OidIsValid(typentry->btree_opf) ||
+			!op_in_opfamily(opexpr->opno, typentry->btree_opf))
+			continue;
+		get_op_opfamily_properties(opexpr->opno, typentry->btree_opf, false,
+								   &strategy, &lefttype, &righttype);
+
+		/* the key is "var op const", so commute the operator if need be */
+		if ((Node *) var != linitial(opexpr->args))
+		{
+			Oid			tmp = lefttype;
+
+			lefttype = righttype;
+			righttype = tmp;
+			strategy = BTCommuteStrategyNumber(strategy);
+		}
+		if (lefttype != var->vartype)
+			continue;
+
+		cmpproc = get_opfamily_proc(typentry->btree_opf, lefttype, righttype,
+									BTORDER_PROC);
+		if (!RegProcedureIsValid(cmpproc))
+			continue;
+
+		ScanKeyEntryInitialize(&keys[nkeys++], 0, var->varattno,
+							   strategy, righttype, opexpr->inputcollid,
+							   cmpproc, con->constvalue);
+	}
+
+	table_scan_set_column_hints(node->ss.ss_currentScanDesc, attrs,
+								nkeys, keys);
+}
+
+/*
+ * SeqNextBatch -- fetch the next batch of tuples, and apply the batch quals
+ *
+ * Returns false at the end of the scan.  Note that it's possible for no row
+ * of a batch to pass the quals.
+ */
+static bool
+SeqNextBatch(SeqScanState *node)
+{
+	TupleBatch *batch = node->batch;
+	TableScanDesc scandesc = node->ss.ss_currentScanDesc;
+	EState	   *estate = node->ss.ps.state;
+	int			nrows = Min(node->batch_rows, batch->maxrows);
+
+	/* batch mode is only used for forward scans */
+	Assert(ScanDirectionIsForward(estate->es_direction));
+
+	if (scandesc == NULL)
+	{
+		/* as in SeqNext */
+		scandesc = table_beginscan(node->ss.ss_currentRelation,
+								   estate->es_snapshot,
+								   0, NULL);
+		node->ss.ss_currentScanDesc = scandesc;
+		SeqScanSetColumnHints(node);
+	}
+
+	ExecBatchClear(batch);
+	ExecBatchReserveSlots(batch, nrows);
+	node->batch_next = 0;
+
+	while (batch->nrows < nrows &&
+		   table_scan_getnextslot(scandesc, ForwardScanDirection,
+								  batch->slots[batch->nrows]))
+		batch->nrows++;
+
+	if (batch->nrows == 0)
+		return false;
+
+	ExecBatchExtractColumns(batch);
+
+	if (node->batchqual)
+	{
+		int			nrows_before = batch->nsel;
+
+		ExecBatchQualEval(node->batchqual, batch);
+		InstrCountFiltered1(node, nrows_before - batch->nsel);
+	}
+
+	if (node->bloom && node->bloom->active)
+	{
+		int			nsel = 0;
+		int			k;
+
+		for (k = 0; k < batch->nsel; k++)
+		{
+			if (SeqScanBloomFilterPass(node, batch->slots[batch->sel[k]]))
+				batch->sel[nsel++] = batch->sel[k];
+		}
+		batch->nsel = nsel;
+	}
+
+	/* grow the next batch */
+	if (node->batch_rows < batch->maxrows)
+		node->batch_rows *= 2;
+
+	return true;
+}
+
 /*
  * SeqRecheck -- access method routine to recheck a tuple in EvalPlanQual
  */
@@ -100,8 +308,9 @@ SeqRecheck(SeqScanState *node, TupleTableSlot *slot)
  *
  *		Scans the relation sequentially and returns the next qualifying
  *		tuple.
- *		We call the ExecScan() routine and pass it the appropriate
- *		access method functions.
+ *		We call the ExecScanExtended() routine and pass it the appropriate
+ *		access method functions.  This version is for scans with neither
+ *		a qual nor a projection.
  * ----------------------------------------------------------------
  */
 static TupleTableSlot *
@@ -109,11 +318,259 @@ ExecSeqScan(PlanState *pstate)
 {
 	SeqScanState *node = castNode(SeqScanState, pstate);
 
+	Assert(pstate->state->es_epq_active == NULL);
+	Assert(pstate->qual == NULL);
+	Assert(pstate->ps_ProjInfo == NULL);
+
+	return ExecScanExtended(&node->ss,
+							(ExecScanAccessMtd) SeqNext,
+							(ExecScanRecheckMtd) SeqRecheck,
+							NULL,
+							NULL,
+							NULL);
+}
+
+/*
+ * Variants of ExecSeqScan for scans with a qual and/or a projection.  They
+ * pass constant NULLs to ExecScanExtended for what they lack, so each gets
+ * a per-tuple loop without the checks for those.  ExecInitSeqScan picks the
+ * right one.
+ */
+static TupleTableSlot *
+ExecSeqScanWithQual(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+
+	Assert(pstate->state->es_epq_active == NULL);
+	Assert(pstate->qual != NULL);
+	Assert(pstate->ps_ProjInfo == NULL);
+
+	return ExecScanExtended(&node->ss,
+							(ExecScanAccessMtd) SeqNext,
+							(ExecScanRecheckMtd) SeqRecheck,
+							NULL,
+							pstate->qual,
+							NULL);
+}
+
+static TupleTableSlot *
+ExecSeqScanWithProject(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+
+	Assert(pstate->state->es_epq_active == NULL);
+	Assert(pstate->qual == NULL);
+	Assert(pstate->ps_ProjInfo != NULL);
+
+	return ExecScanExtended(&node->ss,
+							(ExecScanAccessMtd) SeqNext,
+							(ExecScanRecheckMtd) SeqRecheck,
+							NULL,
+							NULL,
+							pstate->ps_ProjInfo);
+}
+
+static TupleTableSlot *
+ExecSeqScanWithQualProject(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+
+	Assert(pstate->state->es_epq_active == NULL);
+	Assert(pstate->qual != NULL);
+	Assert(pstate->ps_ProjInfo != NULL);
+
+	return ExecScanExtended(&node->ss,
+							(ExecScanAccessMtd) SeqNext,
+							(ExecScanRecheckMtd) SeqRecheck,
+							NULL,
+							pstate->qual,
+							pstate->ps_ProjInfo);
+}
+
+/*
+ * Variant of ExecSeqScan for scans in an EvalPlanQual recheck, which need
+ * the generic checks.
+ */
+static TupleTableSlot *
+ExecSeqScanEPQ(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+
 	return ExecScan(&node->ss,
 					(ExecScanAccessMtd) SeqNext,
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecSeqScanBatched(node)
+ *
+ *		Like ExecSeqScan, but fetches tuples from the table in batches,
+ *		so that the qual clauses that support it can be evaluated for
+ *		a whole batch at once.  The rest of the qual and the projection
+ *		are still done row by row, when the row is asked for.
+ *
+ *		Each row is returned in ss_ScanTupleSlot, like ExecScan does,
+ *		since that's where WHERE CURRENT OF looks for it.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecSeqScanBatched(PlanState *pstate)
+{
+	SeqScanState *node = castNode(SeqScanState, pstate);
+	TupleBatch *batch = node->batch;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	ProjectionInfo *projInfo = node->ss.ps.ps_ProjInfo;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+
+	for (;;)
+	{
+		TupleTableSlot *batchslot;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (node->batch_next >= batch->nsel)
+		{
+			if (!SeqNextBatch(node))
+			{
+				if (projInfo)
+					return ExecClearTuple(projInfo->pi_state.resultslot);
+				else
+					return ExecClearTuple(slot);
+			}
+			continue;
+		}
+
+		batchslot = batch->slots[batch->sel[node->batch_next++]];
+		ExecCopySlot(slot, batchslot);
+		slot->tts_tableOid = batchslot->tts_tableOid;
+
+		/* reset per-tuple memory context to free any expression evals */
+		ResetExprContext(econtext);
+		econtext->ecxt_scantuple = slot;
+
+		if (node->residualqual == NULL ||
+			ExecQual(node->residualqual, econtext))
+		{
+			if (projInfo)
+				return ExecProject(projInfo);
+			return slot;
+		}
+
+		InstrCountFiltered1(node, 1);
+	}
+}
+
+/*
+ * ExecSeqScanInitBatch
+ *
+ *		Set up batch mode: create the batch, and split the quals in those
+ *		evaluated over the batch and the residual ones.
+ */
+static void
+ExecSeqScanInitBatch(SeqScanState *node)
+{
+	SeqScan    *plan = (SeqScan *) node->ss.ps.plan;
+	EState	   *estate = node->ss.ps.state;
+	Relation	rel = node->ss.ss_currentRelation;
+	List	   *residual;
+
+	Assert(node->batch_allowed && node->batch == NULL);
+
+	node->batch = ExecCreateTupleBatch(estate, RelationGetDescr(rel),
+									   table_slot_callbacks(rel),
+									   executor_batch_size);
+	node->batchqual = ExecInitBatchQual(plan->plan.qual, plan->scanrelid,
+										node->batch, &residual);
+	node->residualqual = ExecInitQual(residual, (PlanState *) node);
+	node->batch_next = 0;
+	node->batch_rows = Min(SEQSCAN_INITIAL_BATCH_ROWS, executor_batch_size);
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanStartBatchMode
+ *
+ *		Called by a parent node that wants to consume the scan's output
+ *		with ExecSeqScanNextBatch() instead of ExecProcNode().  Returns
+ *		the batch, to which the parent may add columns it wants extracted,
+ *		or NULL if batch mode can't be used.  The parent must not use
+ *		ExecProcNode() on this node afterwards.
+ *
+ *		The scan must not have a projection, so that the attributes of
+ *		the batch's tuples are those of the scan's output.
+ * ----------------------------------------------------------------
+ */
+TupleBatch *
+ExecSeqScanStartBatchMode(SeqScanState *node)
+{
+	if (!node->batch_allowed || node->ss.ps.ps_ProjInfo != NULL)
+		return NULL;
+
+	if (node->batch == NULL)
+		ExecSeqScanInitBatch(node);
+
+	/* no point in starting small, all rows will be needed */
+	node->batch_rows = node->batch->maxrows;
+
+	return node->batch;
+}
+
+/* ----------------------------------------------------------------
+ *		ExecSeqScanNextBatch
+ *
+ *		Retrieve the next batch of tuples for a parent node that called
+ *		ExecSeqScanStartBatchMode().  All quals have been applied, and
+ *		batch->sel lists the qualifying rows, of which there is at least
+ *		one.  Returns NULL at the end of the scan.
+ * ----------------------------------------------------------------
+ */
+TupleBatch *
+ExecSeqScanNextBatch(SeqScanState *node)
+{
+	TupleBatch *batch = node->batch;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	Assert(batch != NULL);
+
+	/* this bypasses ExecProcNode, so do its instrumentation here */
+	if (node->ss.ps.instrument)
+		InstrStartNode(node->ss.ps.instrument);
+
+	for (;;)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		if (!SeqNextBatch(node))
+		{
+			batch = NULL;
+			break;
+		}
+
+		if (node->residualqual != NULL)
+		{
+			int			nsel = 0;
+			int			k;
+
+			for (k = 0; k < batch->nsel; k++)
+			{
+				ResetExprContext(econtext);
+				econtext->ecxt_scantuple = batch->slots[batch->sel[k]];
+				if (ExecQual(node->residualqual, econtext))
+					batch->sel[nsel++] = batch->sel[k];
+			}
+			InstrCountFiltered1(node, batch->nsel - nsel);
+			batch->nsel = nsel;
+		}
+
+		if (batch->nsel > 0)
+			break;
+	}
+
+	if (node->ss.ps.instrument)
+		InstrStopNode(node->ss.ps.instrument, batch ? batch->nsel : 0);
+
+	return batch;
+}
+
 
 /* ----------------------------------------------------------------
  *		ExecInitSeqScan
@@ -171,6 +628,39 @@ ExecInitSeqScan(SeqScan *node, EState *estate, int eflags)
 	scanstate->ss.ps.qual =
 		ExecInitQual(node->plan.qual, (PlanState *) scanstate);
 
+	/*
+	 * Batch mode fetches rows ahead, which is only possible when scanning
+	 * forward, and isn't useful in an EvalPlanQual recheck.  We use it for
+	 * our own output if some qual clauses can be evaluated over a batch; a
+	 * parent node can ask for it regardless, see ExecSeqScanStartBatchMode.
+	 */
+	scanstate->batch_allowed = executor_batch_size > 0 &&
+		!(eflags & EXEC_FLAG_BACKWARD) &&
+		estate->es_epq_active == NULL;
+
+	if (scanstate->batch_allowed &&
+		ExecQualHasBatchClauses(node->plan.qual, node->scanrelid))
+	{
+		ExecSeqScanInitBatch(scanstate);
+		scanstate->ss.ps.ExecProcNode = ExecSeqScanBatched;
+	}
+	else if (estate->es_epq_active != NULL)
+		scanstate->ss.ps.ExecProcNode = ExecSeqScanEPQ;
+	else if (scanstate->ss.ps.qual == NULL)
+	{
+		if (scanstate->ss.ps.ps_ProjInfo == NULL)
+			scanstate->ss.ps.ExecProcNode = ExecSeqScan;
+		else
+			scanstate->ss.ps.ExecProcNode = ExecSeqScanWithProject;
+	}
+	else
+	{
+		if (scanstate->ss.ps.ps_ProjInfo == NULL)
+			scanstate->ss.ps.ExecProcNode = ExecSeqScanWithQual;
+		else
+			scanstate->ss.ps.ExecProcNode = ExecSeqScanWithQualProject;
+	}
+
 	return scanstate;
 }
 
@@ -201,6 +691,8 @@ ExecEndSeqScan(SeqScanState *node)
 	if (node->ss.ps.ps_ResultTupleSlot)
 		ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
 	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+	if (node->batch)
+		ExecBatchClear(node->batch);
 
 	/*
 	 * close heap scan
@@ -231,6 +723,12 @@ ExecReScanSeqScan(SeqScanState *node)
 		table_rescan(scan,		/* scan desc */
 					 NULL);		/* new scan keys */
 
+	if (node->batch)
+	{
+		ExecBatchClear(node->batch);
+		node->batch_next = 0;
+	}
+
 	ExecScanReScan((ScanState *) node);
 }
 
@@ -278,6 +776,7 @@ ExecSeqScanInitializeDSM(SeqScanState *node,
 	shm_toc_insert(pcxt->toc, node->ss.ps.plan->plan_node_id, pscan);
 	node->ss.ss_currentScanDesc =
 		table_beginscan_parallel(node->ss.ss_currentRelation, pscan);
+	SeqScanSetColumnHints(node);
 }
 
 /* ----------------------------------------------------------------
@@ -311,4 +810,5 @@ ExecSeqScanInitializeWorker(SeqScanState *node,
 	pscan = shm_toc_lookup(pwcxt->toc, node->ss.ps.plan->plan_node_id, false);
 	node->ss.ss_currentScanDesc =
 		table_beginscan_parallel(node->ss.ss_currentRelation, pscan);
+	SeqScanSetColumnHints(node);
 }
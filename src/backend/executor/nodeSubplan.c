@@ -974,8 +974,9 @@ ExecInitSubPlan(SubPlan *subplan, PlanState *parent)
 									   &left_hashfn, &right_hashfn))
 				elog(ERROR, "could not find hash function for hash operator %u",
 					 opexpr->opno);
-			fmgr_info(left_hashfn, &sstate->lhs_hash_funcs[i - 1]);
-			fmgr_info(right_hashfn, &sstate->tab_hash_funcs[i - 1]);
+			execHashFunctionInfo(left_hashfn, right_hashfn,
+								 &sstate->lhs_hash_funcs[i - 1],
+								 &sstate->tab_hash_funcs[i - 1]);
 
 			/* Set collation */
 			sstate->tab_collations[i - 1] = opexpr->inputcollid;
@@ -98,6 +98,16 @@ typedef struct WindowStatePerFuncData
 	WindowObject winobj;		/* object used in window function API */
 }			WindowStatePerFuncData;
 
+/*
+ * One candidate for the result of an extremum aggregate; see
+ * advance_windowaggregate_extremum.
+ */
+typedef struct WindowExtremumEntry
+{
+	int64		pos;			/* row the value came from */
+	Datum		value;			/* argument value, copied into aggcontext */
+} WindowExtremumEntry;
+
 /*
  * For plain aggregate window functions, we also have one of these.
  */
@@ -153,6 +163,21 @@ typedef struct WindowStatePerAggData
 
 	int64		transValueCount;	/* number of currently-aggregated rows */
 
+	/*
+	 * An aggregate that has a sort operator (min, max and the like) but no
+	 * inverse transition function can still follow a moving frame head, by
+	 * keeping every row that might yet become the result in a deque instead
+	 * of a transition value.  Entries run from extremum[extremum_first] up to
+	 * but not including extremum[extremum_last], in increasing row order;
+	 * the first one is the current result.
+	 */
+	bool		use_extremum;	/* use the deque rather than transfn? */
+	FmgrInfo	sortopfn;		/* fmgr lookup data for aggsortop */
+	WindowExtremumEntry *extremum;	/* deque, allocated in aggcontext */
+	int			extremum_first;
+	int			extremum_last;
+	int			extremum_size;	/* allocated length of extremum[] */
+
 	/* Data local to eval_windowaggregates() */
 	bool		restart;		/* need to restart this agg in this cycle? */
 } WindowStatePerAggData;
@@ -160,6 +185,10 @@ typedef struct WindowStatePerAggData
 static void initialize_windowaggregate(WindowAggState *winstate,
 									   WindowStatePerFunc perfuncstate,
 									   WindowStatePerAgg peraggstate);
+static void advance_windowaggregate_extremum(WindowAggState *winstate,
+											 WindowStatePerFunc perfuncstate,
+											 WindowStatePerAgg peraggstate,
+											 Datum value);
 static void advance_windowaggregate(WindowAggState *winstate,
 									WindowStatePerFunc perfuncstate,
 									WindowStatePerAgg peraggstate);
@@ -230,6 +259,94 @@ initialize_windowaggregate(WindowAggState *winstate,
 	peraggstate->transValueCount = 0;
 	peraggstate->resultValue = (Datum) 0;
 	peraggstate->resultValueIsNull = true;
+
+	/* the deque went away with the private aggcontext, if we had one */
+	peraggstate->extremum = NULL;
+	peraggstate->extremum_first = 0;
+	peraggstate->extremum_last = 0;
+	peraggstate->extremum_size = 0;
+}
+
+/*
+ * advance_windowaggregate_extremum
+ * Add the row at aggregatedupto to an extremum aggregate's deque.
+ *
+ * Entries at the tail that the new value beats (or ties with) can never be
+ * the result again, since the new row stays in the frame at least as long as
+ * they do, so we drop them before appending.  That keeps the deque ordered
+ * by the sort operator, with the result at its head, and makes each row cost
+ * amortized O(1) however far the frame moves.  Ties go to the newer row, as
+ * they do in the smaller/larger transition functions of the built-in
+ * aggregates.
+ *
+ * The caller has already dealt with FILTER and NULL inputs.
+ */
+static void
+advance_windowaggregate_extremum(WindowAggState *winstate,
+								 WindowStatePerFunc perfuncstate,
+								 WindowStatePerAgg peraggstate,
+								 Datum value)
+{
+	WindowExtremumEntry *entry;
+	MemoryContext oldContext;
+
+	while (peraggstate->extremum_last > peraggstate->extremum_first)
+	{
+		entry = &peraggstate->extremum[peraggstate->extremum_last - 1];
+		if (DatumGetBool(FunctionCall2Coll(&peraggstate->sortopfn,
+										   perfuncstate->winCollation,
+										   entry->value, value)))
+			break;
+		if (!peraggstate->transtypeByVal)
+			pfree(DatumGetPointer(entry->value));
+		peraggstate->extremum_last--;
+	}
+
+	oldContext = MemoryContextSwitchTo(peraggstate->aggcontext);
+
+	/* Make room at the tail, sliding the entries down if that's enough */
+	if (peraggstate->extremum_last >= peraggstate->extremum_size)
+	{
+		int			nentries;
+
+		nentries = peraggstate->extremum_last - peraggstate->extremum_first;
+
+		if (peraggstate->extremum == NULL)
+		{
+			peraggstate->extremum_size = 16;
+			peraggstate->extremum = (WindowExtremumEntry *)
+				palloc(peraggstate->extremum_size * sizeof(WindowExtremumEntry));
+		}
+		else if (nentries > peraggstate->extremum_size / 2)
+		{
+			peraggstate->extremum_size *= 2;
+			peraggstate->extremum = (WindowExtremumEntry *)
+				repalloc(peraggstate->extremum,
+						 peraggstate->extremum_size * sizeof(WindowExtremumEntry));
+		}
+		if (peraggstate->extremum_first > 0)
+		{
+			memmove(peraggstate->extremum,
+					&peraggstate->extremum[peraggstate->extremum_first],
+					nentries * sizeof(WindowExtremumEntry));
+			peraggstate->extremum_first = 0;
+			peraggstate->extremum_last = nentries;
+		}
+	}
+
+	entry = &peraggstate->extremum[peraggstate->extremum_last++];
+	entry->pos = winstate->aggregatedupto;
+	entry->value = datumCopy(value,
+							 peraggstate->transtypeByVal,
+							 peraggstate->transtypeLen);
+
+	MemoryContextSwitchTo(oldContext);
+
+	/* The head of the deque is the aggregate's value */
+	peraggstate->transValue =
+		peraggstate->extremum[peraggstate->extremum_first].value;
+	peraggstate->transValueIsNull = false;
+	peraggstate->transValueCount++;
 }
 
 /*
@@ -293,6 +410,15 @@ advance_windowaggregate(WindowAggState *winstate,
 			}
 		}
 
+		if (peraggstate->use_extremum)
+		{
+			MemoryContextSwitchTo(oldContext);
+			advance_windowaggregate_extremum(winstate, perfuncstate,
+											 peraggstate,
+											 fcinfo->args[1].value);
+			return;
+		}
+
 		/*
 		 * For strict transition functions with initial value NULL we use the
 		 * first non-NULL input as the initial state.  (We already checked
@@ -411,6 +537,9 @@ advance_windowaggregate(WindowAggState *winstate,
  * Returns true if we successfully removed the current row from this
  * aggregate, false if not (in the latter case, caller is responsible
  * for cleaning up by restarting the aggregation).
+ *
+ * Extremum aggregates don't need to look at the row at all: it matters only
+ * if it is the one at the head of the deque.
  */
 static bool
 advance_windowaggregate_base(WindowAggState *winstate,
@@ -427,6 +556,33 @@ advance_windowaggregate_base(WindowAggState *winstate,
 	ExprContext *econtext = winstate->tmpcontext;
 	ExprState  *filter = wfuncstate->aggfilter;
 
+	if (peraggstate->use_extremum)
+	{
+		WindowExtremumEntry *entry;
+
+		if (peraggstate->extremum_first == peraggstate->extremum_last)
+			return true;
+		entry = &peraggstate->extremum[peraggstate->extremum_first];
+		Assert(entry->pos >= winstate->aggregatedbase);
+		if (entry->pos != winstate->aggregatedbase)
+			return true;
+
+		if (!peraggstate->transtypeByVal)
+			pfree(DatumGetPointer(entry->value));
+		peraggstate->extremum_first++;
+		peraggstate->transValueCount--;
+
+		if (peraggstate->extremum_first == peraggstate->extremum_last)
+		{
+			peraggstate->transValue = (Datum) 0;
+			peraggstate->transValueIsNull = true;
+		}
+		else
+			peraggstate->transValue =
+				peraggstate->extremum[peraggstate->extremum_first].value;
+		return true;
+	}
+
 	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
 
 	/* Skip anything FILTERed out */
@@ -706,7 +862,10 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * unable to remove the tuple from aggregation.  If this happens, or if
 	 * the aggregate doesn't have an inverse transition function at all, we
 	 * must perform the aggregation all over again for all tuples within the
-	 * new frame boundaries.
+	 * new frame boundaries.  The exception is aggregates like min() and max()
+	 * that have a sort operator: for those we instead keep a deque of the
+	 * rows that could still become the result, from which removing the rows
+	 * that left the frame is trivial (see advance_windowaggregate_extremum).
 	 *
 	 * If there's any exclusion clause, then we may have to aggregate over a
 	 * non-contiguous set of rows, so we punt and recalculate for every row.
@@ -784,7 +943,8 @@ eval_windowaggregates(WindowAggState *winstate)
 		peraggstate = &winstate->peragg[i];
 		if (winstate->currentpos == 0 ||
 			(winstate->aggregatedbase != winstate->frameheadpos &&
-			 !OidIsValid(peraggstate->invtransfn_oid)) ||
+			 !OidIsValid(peraggstate->invtransfn_oid) &&
+			 !peraggstate->use_extremum) ||
 			(winstate->frameOptions & FRAMEOPTION_EXCLUSION) ||
 			winstate->aggregatedupto <= winstate->frameheadpos)
 		{
@@ -2850,6 +3010,31 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 				(errcode(ERRCODE_INVALID_FUNCTION_DEFINITION),
 				 errmsg("strictness of aggregate's forward and inverse transition functions must match")));
 
+	/*
+	 * An aggregate without an inverse transition function that just picks
+	 * the first of its non-NULL inputs by a sort operator can follow a moving
+	 * frame head with a deque of candidate rows instead.  We rely on the
+	 * aggregate being a plain min() or max() workalike, as aggsortop already
+	 * promises the planner; the same volatility caveat as above applies, and
+	 * with an exclusion clause the frame isn't contiguous, so restarting is
+	 * all we can do.
+	 */
+	if (!use_ma_code &&
+		OidIsValid(aggform->aggsortop) &&
+		numArguments == 1 &&
+		!OidIsValid(finalfn_oid) &&
+		peraggstate->transfn.fn_strict &&
+		peraggstate->initValueIsNull &&
+		!(winstate->frameOptions & (FRAMEOPTION_START_UNBOUNDED_PRECEDING |
+									FRAMEOPTION_EXCLUSION)) &&
+		!contain_volatile_functions((Node *) wfunc))
+	{
+		peraggstate->use_extremum = true;
+		fmgr_info(get_opcode(aggform->aggsortop), &peraggstate->sortopfn);
+	}
+	else
+		peraggstate->use_extremum = false;
+
 	/*
 	 * Moving aggregates use their own aggcontext.
 	 *
@@ -2862,9 +3047,10 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	 * since we'd miss any indirectly referenced data.  We could, in theory,
 	 * make the memory allocation rules for moving aggregates different than
 	 * they have historically been for plain aggregates, but that seems grotty
-	 * and likely to lead to memory leaks.
+	 * and likely to lead to memory leaks.  Extremum aggregates restart at
+	 * their own times too, so the same goes for them.
 	 */
-	if (OidIsValid(invtransfn_oid))
+	if (OidIsValid(invtransfn_oid) || peraggstate->use_extremum)
 		peraggstate->aggcontext =
 			AllocSetContextCreate(CurrentMemoryContext,
 								  "WindowAgg Per Aggregate",
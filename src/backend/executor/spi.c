@@ -2108,6 +2108,8 @@ _SPI_execute_plan(SPIPlanPtr plan, ParamListInfo paramLI,
 	bool		pushed_active_snap = false;
 	ErrorContextCallback spierrcontext;
 	CachedPlan *cplan = NULL;
+	bool		time_run = false;
+	instr_time	starttime;
 	ListCell   *lc1;
 
 	/*
@@ -2215,6 +2217,11 @@ _SPI_execute_plan(SPIPlanPtr plan, ParamListInfo paramLI,
 		cplan = GetCachedPlan(plansource, paramLI, plan->saved, _SPI_current->queryEnv);
 		stmt_list = cplan->stmt_list;
 
+		/* Time the run if the plan cache wants to know */
+		time_run = (plan_cache_mode == PLAN_CACHE_MODE_ADAPTIVE);
+		if (time_run)
+			INSTR_TIME_SET_CURRENT(starttime);
+
 		/*
 		 * In the default non-read-only case, get a new snapshot, replacing
 		 * any that we pushed in a previous cycle.
@@ -2391,6 +2398,16 @@ _SPI_execute_plan(SPIPlanPtr plan, ParamListInfo paramLI,
 			}
 		}
 
+		if (time_run)
+		{
+			instr_time	duration;
+
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, starttime);
+			CachedPlanRecordRun(plansource, cplan,
+								INSTR_TIME_GET_MILLISEC(duration));
+		}
+
 		/* Done with this plan, so release refcount */
 		ReleaseCachedPlan(cplan, plan->saved);
 		cplan = NULL;
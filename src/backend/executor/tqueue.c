@@ -36,13 +36,15 @@ typedef struct TQueueDestReceiver
 /*
  * TupleQueueReader object's private contents
  *
- * queue is a pointer to data supplied by reader's caller.
+ * queue is a pointer to data supplied by reader's caller.  htup is the
+ * header of the tuple last returned.
  *
  * "typedef struct TupleQueueReader TupleQueueReader" is in tqueue.h
  */
 struct TupleQueueReader
 {
 	shm_mq_handle *queue;		/* shm_mq to receive from */
+	HeapTupleData htup;			/* tuple last returned */
 };
 
 /*
@@ -58,9 +60,14 @@ tqueueReceiveSlot(TupleTableSlot *slot, DestReceiver *self)
 	shm_mq_result result;
 	bool		should_free;
 
-	/* Send the tuple itself. */
+	/*
+	 * Send the tuple itself.  We don't force a flush, so that tuples are
+	 * made visible to the receiver in batches rather than one at a time; the
+	 * rest is flushed when we detach from the queue.
+	 */
 	tuple = ExecFetchSlotHeapTuple(slot, true, &should_free);
-	result = shm_mq_send(tqueue->queue, tuple->t_len, tuple->t_data, false);
+	result = shm_mq_send(tqueue->queue, tuple->t_len, tuple->t_data, false,
+						 false);
 
 	if (should_free)
 		heap_freetuple(tuple);
@@ -164,9 +171,11 @@ DestroyTupleQueueReader(TupleQueueReader *reader)
  * nowait = true and no tuple is ready to return.  *done, if not NULL,
  * is set to true when there are no remaining tuples and otherwise to false.
  *
- * The returned tuple, if any, is allocated in CurrentMemoryContext.
- * Note that this routine must not leak memory!  (We used to allow that,
- * but not any more.)
+ * The returned tuple, if any, points either into shared memory or into a
+ * private buffer of the queue handle, so no copy is made here.  It must not
+ * be freed, and it's only valid until the next call for this reader; the
+ * caller has to copy it if it needs to keep it any longer.  Note that this
+ * routine must not leak memory!  (We used to allow that, but not any more.)
  *
  * Even when shm_mq_receive() returns SHM_MQ_WOULD_BLOCK, this can still
  * accumulate bytes from a partially-read message, so it's useful to call
@@ -175,7 +184,7 @@ DestroyTupleQueueReader(TupleQueueReader *reader)
 HeapTuple
 TupleQueueReaderNext(TupleQueueReader *reader, bool nowait, bool *done)
 {
-	HeapTupleData htup;
+	HeapTuple	htup;
 	shm_mq_result result;
 	Size		nbytes;
 	void	   *data;
@@ -200,13 +209,14 @@ TupleQueueReaderNext(TupleQueueReader *reader, bool nowait, bool *done)
 	Assert(result == SHM_MQ_SUCCESS);
 
 	/*
-	 * Set up a dummy HeapTupleData pointing to the data from the shm_mq
-	 * (which had better be sufficiently aligned).
+	 * Set up a HeapTupleData pointing to the data from the shm_mq (which had
+	 * better be sufficiently aligned).
 	 */
-	ItemPointerSetInvalid(&htup.t_self);
-	htup.t_tableOid = InvalidOid;
-	htup.t_len = nbytes;
-	htup.t_data = data;
+	htup = &reader->htup;
+	ItemPointerSetInvalid(&htup->t_self);
+	htup->t_tableOid = InvalidOid;
+	htup->t_len = nbytes;
+	htup->t_data = data;
 
-	return heap_copytuple(&htup);
+	return htup;
 }
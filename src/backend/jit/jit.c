@@ -42,6 +42,7 @@ bool		jit_tuple_deforming = true;
 double		jit_above_cost = 100000;
 double		jit_inline_above_cost = 500000;
 double		jit_optimize_above_cost = 500000;
+int			jit_warmup_calls = 0;
 
 static JitProviderCallbacks provider;
 static bool provider_successfully_loaded = false;
@@ -182,6 +183,35 @@ jit_compile_expr(struct ExprState *state)
 	return false;
 }
 
+/*
+ * Compile an expression that has no parent PlanState, such as a PL/pgSQL
+ * simple expression.
+ *
+ * The generated code is kept in estate's JIT context, and estate->es_jit_flags
+ * decides what is done, so callers should use an EState that lives exactly
+ * as long as the expression state and set its flags themselves.  The JIT
+ * context, if one has to be created, is registered with CurrentResourceOwner.
+ */
+bool
+jit_compile_standalone_expr(struct ExprState *state, struct EState *estate)
+{
+	Assert(state->parent == NULL);
+
+	/* if no jitting should be performed at all */
+	if (!(estate->es_jit_flags & PGJIT_PERFORM))
+		return false;
+
+	/* or if expressions aren't JITed */
+	if (!(estate->es_jit_flags & PGJIT_EXPR))
+		return false;
+
+	/* this also takes !jit_enabled into account */
+	if (provider_init() && provider.compile_standalone_expr)
+		return provider.compile_standalone_expr(state, estate);
+
+	return false;
+}
+
 /* Aggregate JIT instrumentation information */
 void
 InstrJitAgg(JitInstrumentation *dst, JitInstrumentation *add)
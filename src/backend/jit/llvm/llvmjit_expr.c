@@ -51,9 +51,13 @@ typedef struct CompiledExprState
 {
 	LLVMJitContext *context;
 	const char *funcname;
+	bool		validated;		/* CheckExprStillValid() already done? */
+	int			warmup_calls;	/* evaluations left to interpret */
+	ExprStateEvalFunc interp_func;	/* evalfunc for interpreting */
 } CompiledExprState;
 
 
+static bool llvm_compile_expr_internal(ExprState *state, EState *estate);
 static Datum ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull);
 
 static LLVMValueRef BuildV1Call(LLVMJitContext *context, LLVMBuilderRef b,
@@ -71,6 +75,22 @@ static LLVMValueRef create_LifetimeEnd(LLVMModuleRef mod);
  */
 bool
 llvm_compile_expr(ExprState *state)
+{
+	return llvm_compile_expr_internal(state, state->parent->state);
+}
+
+/*
+ * JIT compile expression without a parent PlanState, using estate's JIT
+ * context.
+ */
+bool
+llvm_compile_standalone_expr(ExprState *state, EState *estate)
+{
+	return llvm_compile_expr_internal(state, estate);
+}
+
+static bool
+llvm_compile_expr_internal(ExprState *state, EState *estate)
 {
 	PlanState  *parent = state->parent;
 	int			i;
@@ -122,19 +142,14 @@ llvm_compile_expr(ExprState *state)
 	llvm_enter_fatal_on_oom();
 
 	/* get or create JIT context */
-	if (parent && parent->state->es_jit)
+	if (estate->es_jit)
 	{
-		context = (LLVMJitContext *) parent->state->es_jit;
+		context = (LLVMJitContext *) estate->es_jit;
 	}
 	else
 	{
-		context = llvm_create_context(parent->state->es_jit_flags);
-
-		if (parent)
-		{
-			parent->state->es_jit = &context->base;
-		}
-
+		context = llvm_create_context(estate->es_jit_flags);
+		estate->es_jit = &context->base;
 	}
 
 	INSTR_TIME_SET_CURRENT(starttime);
@@ -1876,6 +1891,12 @@ llvm_compile_expr(ExprState *state)
 				LLVMBuildBr(b, opblocks[i + 1]);
 				break;
 
+			case EEOP_HASHED_SCALARARRAYOP:
+				build_EvalXFunc(b, mod, "ExecEvalHashedScalarArrayOp",
+								v_state, v_econtext, op);
+				LLVMBuildBr(b, opblocks[i + 1]);
+				break;
+
 			case EEOP_XMLEXPR:
 				build_EvalXFunc(b, mod, "ExecEvalXmlExpr",
 								v_state, v_econtext, op);
@@ -2230,6 +2251,45 @@ llvm_compile_expr(ExprState *state)
 					break;
 				}
 
+			case EEOP_AGG_PLAIN_PERGROUP_NULLCHECK:
+				{
+					int			jumpnull;
+					LLVMValueRef v_aggstatep;
+					LLVMValueRef v_allpergroupsp;
+					LLVMValueRef v_pergroup_allaggs;
+					LLVMValueRef v_setoff;
+
+					jumpnull = op->d.agg_plain_pergroup_nullcheck.jumpnull;
+
+					/*
+					 * pergroup_allaggs = aggstate->all_pergroups
+					 * [op->d.agg_plain_pergroup_nullcheck.setoff];
+					 */
+					v_aggstatep = l_ptr_const(castNode(AggState, parent),
+											  l_ptr(StructAggState));
+
+					v_allpergroupsp =
+						l_load_struct_gep(b, v_aggstatep,
+										  FIELDNO_AGGSTATE_ALL_PERGROUPS,
+										  "aggstate.all_pergroups");
+
+					v_setoff =
+						l_int32_const(op->d.agg_plain_pergroup_nullcheck.setoff);
+
+					v_pergroup_allaggs =
+						l_load_gep1(b, v_allpergroupsp, v_setoff, "");
+
+					LLVMBuildCondBr(b,
+									LLVMBuildICmp(b, LLVMIntEQ,
+												  LLVMBuildPtrToInt(b, v_pergroup_allaggs,
+																	TypeSizeT, ""),
+												  l_sizet_const(0), ""),
+									opblocks[jumpnull],
+									opblocks[i + 1]);
+
+					break;
+				}
+
 			case EEOP_AGG_PLAIN_TRANS_BYVAL:
 			case EEOP_AGG_PLAIN_TRANS:
 				{
@@ -2419,6 +2479,181 @@ llvm_compile_expr(ExprState *state)
 					break;
 				}
 
+			case EEOP_AGG_PLAIN_TRANS_INLINE:
+				{
+					AggTransInlineFn inlinefn = op->d.agg_trans.inlinefn;
+					FunctionCallInfo fcinfo;
+
+					LLVMValueRef v_aggstatep;
+					LLVMValueRef v_allpergroupsp;
+					LLVMValueRef v_pergroupp;
+					LLVMValueRef v_setoff;
+					LLVMValueRef v_transno;
+					LLVMValueRef v_fcinfo;
+					LLVMValueRef v_transvaluep;
+					LLVMValueRef v_transnullp;
+					LLVMValueRef v_transvalue;
+					LLVMValueRef v_value;
+					LLVMValueRef v_newval = NULL;
+					LLVMValueRef v_slow = NULL;
+
+					LLVMBasicBlockRef b_slow;
+					LLVMBasicBlockRef b_fast;
+
+					/*
+					 * The float8 cases have NaN and overflow rules that
+					 * aren't worth duplicating here; just call the
+					 * interpreter's implementation.
+					 */
+					if (inlinefn == AGG_TRANS_INLINE_FLOAT8PL ||
+						inlinefn == AGG_TRANS_INLINE_FLOAT8LARGER ||
+						inlinefn == AGG_TRANS_INLINE_FLOAT8SMALLER)
+					{
+						build_EvalXFunc(b, mod, "ExecAggPlainTransInline",
+										v_state, v_econtext, op);
+						LLVMBuildBr(b, opblocks[i + 1]);
+						break;
+					}
+
+					fcinfo = op->d.agg_trans.pertrans->transfn_fcinfo;
+
+					v_aggstatep = l_ptr_const(op->d.agg_trans.aggstate,
+											  l_ptr(StructAggState));
+					v_allpergroupsp =
+						l_load_struct_gep(b, v_aggstatep,
+										  FIELDNO_AGGSTATE_ALL_PERGROUPS,
+										  "aggstate.all_pergroups");
+					v_setoff = l_int32_const(op->d.agg_trans.setoff);
+					v_transno = l_int32_const(op->d.agg_trans.transno);
+					v_pergroupp =
+						LLVMBuildGEP(b,
+									 l_load_gep1(b, v_allpergroupsp, v_setoff, ""),
+									 &v_transno, 1, "");
+					v_transvaluep =
+						LLVMBuildStructGEP(b, v_pergroupp,
+										   FIELDNO_AGGSTATEPERGROUPDATA_TRANSVALUE,
+										   "transvalue");
+					v_transnullp =
+						LLVMBuildStructGEP(b, v_pergroupp,
+										   FIELDNO_AGGSTATEPERGROUPDATA_TRANSVALUEISNULL,
+										   "transnullp");
+					v_transvalue = LLVMBuildLoad(b, v_transvaluep, "transvalue");
+
+					v_fcinfo = l_ptr_const(fcinfo,
+										   l_ptr(StructFunctionCallInfoData));
+					v_value = l_funcvalue(b, v_fcinfo, 1);
+
+					/*
+					 * Compute the new value inline, and a condition under
+					 * which we must instead fall back to
+					 * ExecAggPlainTransInline(): NULLs for int4_sum, and
+					 * overflow, which has to raise an error.
+					 */
+					switch (inlinefn)
+					{
+						case AGG_TRANS_INLINE_INT8INC:
+							v_slow = LLVMBuildICmp(b, LLVMIntEQ, v_transvalue,
+												   l_sizet_const(PG_INT64_MAX),
+												   "");
+							v_newval = LLVMBuildAdd(b, v_transvalue,
+													l_sizet_const(1), "");
+							break;
+
+						case AGG_TRANS_INLINE_INT8PL:
+							/* overflow iff the result's sign differs from both inputs' */
+							v_newval = LLVMBuildAdd(b, v_transvalue, v_value, "");
+							v_slow =
+								LLVMBuildICmp(b, LLVMIntSLT,
+											  LLVMBuildAnd(b,
+														   LLVMBuildXor(b, v_transvalue, v_newval, ""),
+														   LLVMBuildXor(b, v_value, v_newval, ""),
+														   ""),
+											  l_sizet_const(0), "");
+							break;
+
+						case AGG_TRANS_INLINE_INT4_SUM:
+							v_slow =
+								LLVMBuildOr(b,
+											LLVMBuildICmp(b, LLVMIntNE,
+														  LLVMBuildLoad(b, v_transnullp, ""),
+														  l_sbool_const(0), ""),
+											LLVMBuildICmp(b, LLVMIntNE,
+														  l_funcnull(b, v_fcinfo, 1),
+														  l_sbool_const(0), ""),
+											"");
+							v_newval =
+								LLVMBuildAdd(b, v_transvalue,
+											 LLVMBuildSExt(b,
+														   LLVMBuildTrunc(b, v_value,
+																		  LLVMInt32Type(), ""),
+														   TypeSizeT, ""),
+											 "");
+							break;
+
+						case AGG_TRANS_INLINE_INT4LARGER:
+						case AGG_TRANS_INLINE_INT4SMALLER:
+							{
+								LLVMValueRef v_keep;
+
+								v_keep =
+									LLVMBuildICmp(b,
+												  inlinefn == AGG_TRANS_INLINE_INT4LARGER ?
+												  LLVMIntSGT : LLVMIntSLT,
+												  LLVMBuildTrunc(b, v_transvalue,
+																 LLVMInt32Type(), ""),
+												  LLVMBuildTrunc(b, v_value,
+																 LLVMInt32Type(), ""),
+												  "");
+								v_newval = LLVMBuildSelect(b, v_keep,
+														   v_transvalue, v_value, "");
+							}
+							break;
+
+						case AGG_TRANS_INLINE_INT8LARGER:
+						case AGG_TRANS_INLINE_INT8SMALLER:
+							{
+								LLVMValueRef v_keep;
+
+								v_keep =
+									LLVMBuildICmp(b,
+												  inlinefn == AGG_TRANS_INLINE_INT8LARGER ?
+												  LLVMIntSGT : LLVMIntSLT,
+												  v_transvalue, v_value, "");
+								v_newval = LLVMBuildSelect(b, v_keep,
+														   v_transvalue, v_value, "");
+							}
+							break;
+
+						default:
+							elog(ERROR, "unexpected inline transition function %d",
+								 (int) inlinefn);
+							break;
+					}
+
+					if (v_slow == NULL)
+					{
+						LLVMBuildStore(b, v_newval, v_transvaluep);
+						LLVMBuildBr(b, opblocks[i + 1]);
+						break;
+					}
+
+					b_slow = l_bb_before_v(opblocks[i + 1],
+										   "op.%d.inlinetrans.slow", i);
+					b_fast = l_bb_before_v(opblocks[i + 1],
+										   "op.%d.inlinetrans.fast", i);
+					LLVMBuildCondBr(b, v_slow, b_slow, b_fast);
+
+					LLVMPositionBuilderAtEnd(b, b_fast);
+					LLVMBuildStore(b, v_newval, v_transvaluep);
+					LLVMBuildBr(b, opblocks[i + 1]);
+
+					LLVMPositionBuilderAtEnd(b, b_slow);
+					build_EvalXFunc(b, mod, "ExecAggPlainTransInline",
+									v_state, v_econtext, op);
+					LLVMBuildBr(b, opblocks[i + 1]);
+					break;
+				}
+
 			case EEOP_AGG_ORDERED_TRANS_DATUM:
 				build_EvalXFunc(b, mod, "ExecEvalAggOrderedTransDatum",
 								v_state, v_econtext, op);
@@ -2452,6 +2687,18 @@ llvm_compile_expr(ExprState *state)
 		cstate->context = context;
 		cstate->funcname = funcname;
 
+		/*
+		 * If the expression should be interpreted for a while first, get it
+		 * ready for that too.  The generated code doesn't depend on the
+		 * opcodes of the steps, which the interpreter may overwrite.
+		 */
+		if (jit_warmup_calls > 0)
+		{
+			ExecReadyInterpretedExpr(state);
+			cstate->warmup_calls = jit_warmup_calls;
+			cstate->interp_func = (ExprStateEvalFunc) state->evalfunc_private;
+		}
+
 		state->evalfunc = ExecRunCompiledExpr;
 		state->evalfunc_private = cstate;
 	}
@@ -2468,10 +2715,11 @@ llvm_compile_expr(ExprState *state)
 /*
  * Run compiled expression.
  *
- * This will only be called the first time a JITed expression is called. We
- * first make sure the expression is still up2date, and then get a pointer to
- * the emitted function. The latter can be the first thing that triggers
- * optimizing and emitting all the generated functions.
+ * This will only be called the first time a JITed expression is called,
+ * or, with jit_warmup_calls, until it has been interpreted that many times.
+ * We first make sure the expression is still up2date, and then get a
+ * pointer to the emitted function. The latter can be the first thing that
+ * triggers optimizing and emitting all the generated functions.
  */
 static Datum
 ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
@@ -2479,7 +2727,17 @@ ExecRunCompiledExpr(ExprState *state, ExprContext *econtext, bool *isNull)
 	CompiledExprState *cstate = state->evalfunc_private;
 	ExprStateEvalFunc func;
 
-	CheckExprStillValid(state, econtext);
+	if (!cstate->validated)
+	{
+		CheckExprStillValid(state, econtext);
+		cstate->validated = true;
+	}
+
+	if (cstate->warmup_calls > 0)
+	{
+		cstate->warmup_calls--;
+		return cstate->interp_func(state, econtext, isNull);
+	}
 
 	llvm_enter_fatal_on_oom();
 	func = (ExprStateEvalFunc) llvm_get_function(cstate->context,
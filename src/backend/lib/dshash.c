@@ -17,8 +17,12 @@
  * is only expected to happen a small number of times until a stable size is
  * found, since growth is geometric.
  *
- * Future versions may support iterators and incremental resizing; for now
- * the implementation is minimalist.
+ * A sequential scan visits the partitions in order, holding the lock of one
+ * partition at a time (two, briefly, while moving to the next one), which
+ * also keeps the table from being resized while the scan is in progress.
+ *
+ * Future versions may support incremental resizing; for now the
+ * implementation is minimalist.
  *
  * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -153,6 +157,10 @@ struct dshash_table
 #define BUCKET_INDEX_FOR_PARTITION(partition, size_log2)	\
 	((partition) << NUM_SPLITS(size_log2))
 
+/* The partition a given bucket belongs to. */
+#define PARTITION_FOR_BUCKET_INDEX(bucket_idx, size_log2)	\
+	((bucket_idx) >> NUM_SPLITS(size_log2))
+
 /* The head of the active bucket for a given hash value (lvalue). */
 #define BUCKET_FOR_HASH(hash_table, hash)								\
 	(hash_table->buckets[												\
@@ -592,6 +600,131 @@ dshash_memhash(const void *v, size_t size, void *arg)
 	return tag_hash(v, size);
 }
 
+/*
+ * Initialize a sequential scan over the whole hash table.  If 'exclusive' is
+ * true, the partitions are locked exclusively, so that the entries returned
+ * can be modified or deleted with dshash_delete_current().
+ *
+ * The caller must hold no partition locks, and must not try to find, insert
+ * or delete other entries of the same table until the scan has been ended
+ * with dshash_seq_term().
+ */
+void
+dshash_seq_init(dshash_seq_status *status, dshash_table *hash_table,
+				bool exclusive)
+{
+	Assert(hash_table->control->magic == DSHASH_MAGIC);
+	Assert(!hash_table->find_locked);
+
+	status->hash_table = hash_table;
+	status->curbucket = 0;
+	status->nbuckets = 0;
+	status->curitem = NULL;
+	status->pnextitem = InvalidDsaPointer;
+	status->curpartition = -1;
+	status->exclusive = exclusive;
+}
+
+/*
+ * Return the next entry of a sequential scan, or NULL when all entries have
+ * been returned.  The partition holding the returned entry stays locked
+ * until the next call.
+ */
+void *
+dshash_seq_next(dshash_seq_status *status)
+{
+	dshash_table *hash_table = status->hash_table;
+	LWLockMode	lockmode = status->exclusive ? LW_EXCLUSIVE : LW_SHARED;
+	dsa_pointer next_item_pointer;
+
+	if (status->curpartition < 0)
+	{
+		/* First call, lock the first partition */
+		if (status->nbuckets > 0)
+			return NULL;		/* the scan has already ended */
+
+		LWLockAcquire(PARTITION_LOCK(hash_table, 0), lockmode);
+		status->curpartition = 0;
+
+		/* The table can't be resized while we hold a partition lock */
+		ensure_valid_bucket_pointers(hash_table);
+		status->nbuckets = ((size_t) 1) << hash_table->size_log2;
+		next_item_pointer = hash_table->buckets[0];
+	}
+	else
+		next_item_pointer = status->pnextitem;
+
+	/* Move to the next non-empty bucket if we're done with this one */
+	while (!DsaPointerIsValid(next_item_pointer))
+	{
+		int			next_partition;
+
+		if (++status->curbucket >= status->nbuckets)
+		{
+			/* That was the last bucket */
+			LWLockRelease(PARTITION_LOCK(hash_table, status->curpartition));
+			status->curpartition = -1;
+			status->curitem = NULL;
+			return NULL;
+		}
+
+		next_partition = PARTITION_FOR_BUCKET_INDEX(status->curbucket,
+													hash_table->size_log2);
+		if (next_partition != status->curpartition)
+		{
+			/*
+			 * Lock the next partition before releasing the current one, so
+			 * that the table can't be resized in between.  We acquire the
+			 * locks in the same order as resize() does, so this can't
+			 * deadlock.
+			 */
+			LWLockAcquire(PARTITION_LOCK(hash_table, next_partition),
+						  lockmode);
+			LWLockRelease(PARTITION_LOCK(hash_table, status->curpartition));
+			status->curpartition = next_partition;
+		}
+
+		next_item_pointer = hash_table->buckets[status->curbucket];
+	}
+
+	status->curitem = dsa_get_address(hash_table->area, next_item_pointer);
+
+	/* Remember the next item, in case the caller deletes this one */
+	status->pnextitem = status->curitem->next;
+
+	return ENTRY_FROM_ITEM(status->curitem);
+}
+
+/*
+ * End a sequential scan, releasing the lock still held, if any.  This must be
+ * called even if dshash_seq_next() has returned NULL, which is harmless.
+ */
+void
+dshash_seq_term(dshash_seq_status *status)
+{
+	if (status->curpartition >= 0)
+		LWLockRelease(PARTITION_LOCK(status->hash_table,
+									 status->curpartition));
+	status->curpartition = -1;
+	status->curitem = NULL;
+}
+
+/*
+ * Delete the entry most recently returned by an exclusive sequential scan.
+ */
+void
+dshash_delete_current(dshash_seq_status *status)
+{
+	dshash_table *hash_table = status->hash_table;
+
+	Assert(status->exclusive);
+	Assert(status->curitem != NULL);
+	Assert(hash_table->control->magic == DSHASH_MAGIC);
+
+	delete_item(hash_table, status->curitem);
+	status->curitem = NULL;
+}
+
 /*
  * Print debugging information about the internal state of the hash table to
  * stderr.  The caller must hold no partition locks.
@@ -57,6 +57,7 @@
  *		pq_flush		- flush pending output
  *		pq_flush_if_writable - flush pending output if writable without blocking
  *		pq_getbyte_if_available - get a byte if available without blocking
+ *		pq_enable_compression - compress all further traffic
  *
  * message-level I/O (and old-style-COPY-OUT cruft):
  *		pq_putmessage	- send a normal message (suppressed in COPY OUT mode)
@@ -91,6 +92,7 @@
 #include "common/ip.h"
 #include "libpq/libpq.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "port/pg_bswap.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
@@ -147,6 +149,16 @@ static int	PqRecvLength;		/* End of data available in PqRecvBuffer */
 /*
  * Message status
  */
+/*
+ * With protocol compression, compressed output that secure_write() has not
+ * yet fully accepted.  It stands for PqCompressedRaw bytes at the start of
+ * the pending part of PqSendBuffer; PqCompressedRaw is zero if there is none.
+ */
+static const char *PqCompressedData;
+static size_t PqCompressedLen;
+static size_t PqCompressedSent;
+static size_t PqCompressedRaw;
+
 static bool PqCommBusy;			/* busy sending data to the client */
 static bool PqCommReadingMsg;	/* in the middle of reading a message */
 static bool DoingCopyOut;		/* in old-protocol COPY OUT processing */
@@ -165,6 +177,8 @@ static void socket_startcopyout(void);
 static void socket_endcopyout(bool errorAbort);
 static int	internal_putbytes(const char *s, size_t len);
 static int	internal_flush(void);
+static ssize_t pq_secure_read(void *ptr, size_t len);
+static ssize_t pq_secure_write(void *ptr, size_t len);
 
 #ifdef HAVE_UNIX_SOCKETS
 static int	Lock_AF_UNIX(char *unixSocketDir, char *unixSocketPath);
@@ -968,8 +982,8 @@ pq_recvbuf(void)
 	{
 		int			r;
 
-		r = secure_read(MyProcPort, PqRecvBuffer + PqRecvLength,
-						PQ_RECV_BUFFER_SIZE - PqRecvLength);
+		r = pq_secure_read(PqRecvBuffer + PqRecvLength,
+						   PQ_RECV_BUFFER_SIZE - PqRecvLength);
 
 		if (r < 0)
 		{
@@ -1061,7 +1075,7 @@ pq_getbyte_if_available(unsigned char *c)
 	/* Put the socket into non-blocking mode */
 	socket_set_nonblocking(true);
 
-	r = secure_read(MyProcPort, c, 1);
+	r = pq_secure_read(c, 1);
 	if (r < 0)
 	{
 		/*
@@ -1093,6 +1107,138 @@ pq_getbyte_if_available(unsigned char *c)
 	return r;
 }
 
+/* --------------------------------
+ *		pq_enable_compression - start compressing the connection
+ *
+ * This is called once during connection startup, right after the
+ * acknowledgement of the client's compression request has been flushed.
+ * From then on, everything sent to the client is compressed and everything
+ * received from it is decompressed, including anything already sitting in
+ * the receive buffer.
+ * --------------------------------
+ */
+void
+pq_enable_compression(ZpqStream *zs)
+{
+	Assert(MyProcPort->zpq_stream == NULL);
+	Assert(PqSendStart == PqSendPointer);
+
+	if (PqRecvLength > PqRecvPointer)
+	{
+		if (!zpq_rx_feed(zs, PqRecvBuffer + PqRecvPointer,
+						 PqRecvLength - PqRecvPointer))
+			ereport(FATAL,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+		PqRecvLength = PqRecvPointer = 0;
+	}
+
+	MyProcPort->zpq_stream = zs;
+}
+
+/* --------------------------------
+ *		pq_secure_read	- read from the client, decompressing if needed
+ *
+ * Same API as secure_read().  A corrupt compressed stream is logged and
+ * reported as EOF.
+ * --------------------------------
+ */
+static ssize_t
+pq_secure_read(void *ptr, size_t len)
+{
+	ZpqStream  *zs = MyProcPort->zpq_stream;
+
+	if (zs == NULL)
+		return secure_read(MyProcPort, ptr, len);
+
+	for (;;)
+	{
+		ssize_t		r;
+		char	   *buf;
+		size_t		space;
+
+		if (zpq_rx_pending(zs))
+		{
+			r = zpq_decompress(zs, ptr, len);
+			if (r < 0)
+			{
+				ereport(COMMERROR,
+						(errcode(ERRCODE_PROTOCOL_VIOLATION),
+						 errmsg("could not decompress data from client")));
+				return 0;
+			}
+			if (r > 0)
+			{
+				pgstat_report_compression();
+				return r;
+			}
+		}
+
+		/* need more compressed input */
+		buf = zpq_rx_space(zs, &space);
+		if (buf == NULL)
+		{
+			ereport(COMMERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+			return 0;
+		}
+		r = secure_read(MyProcPort, buf, space);
+		if (r <= 0)
+			return r;
+		zpq_rx_added(zs, r);
+	}
+}
+
+/* --------------------------------
+ *		pq_secure_write - write to the client, compressing if needed
+ *
+ * Same API as secure_write(), except that with compression, a call that
+ * fails with EAGAIN or EWOULDBLOCK must be retried with the same data
+ * (possibly followed by more), because that data has already been
+ * compressed.  internal_flush() always does that.
+ * --------------------------------
+ */
+static ssize_t
+pq_secure_write(void *ptr, size_t len)
+{
+	ZpqStream  *zs = MyProcPort->zpq_stream;
+	ssize_t		r;
+
+	if (zs == NULL)
+		return secure_write(MyProcPort, ptr, len);
+
+	if (PqCompressedRaw == 0)
+	{
+		if (zpq_compress(zs, ptr, len, &PqCompressedData,
+						 &PqCompressedLen) != 0)
+		{
+			ereport(COMMERROR,
+					(errmsg("could not compress data sent to client")));
+			errno = ECONNRESET;
+			return -1;
+		}
+		PqCompressedSent = 0;
+		PqCompressedRaw = len;
+	}
+	Assert(len >= PqCompressedRaw);
+
+	while (PqCompressedSent < PqCompressedLen)
+	{
+		r = secure_write(MyProcPort,
+						 (char *) PqCompressedData + PqCompressedSent,
+						 PqCompressedLen - PqCompressedSent);
+		if (r <= 0)
+			return r;
+		PqCompressedSent += r;
+	}
+
+	r = PqCompressedRaw;
+	PqCompressedRaw = 0;
+	pgstat_report_compression();
+	return r;
+}
+
 /* --------------------------------
  *		pq_getbytes		- get a known number of bytes from connection
  *
@@ -1442,7 +1588,7 @@ internal_flush(void)
 	{
 		int			r;
 
-		r = secure_write(MyProcPort, bufptr, bufend - bufptr);
+		r = pq_secure_write(bufptr, bufend - bufptr);
 
 		if (r <= 0)
 		{
@@ -1483,6 +1629,7 @@ internal_flush(void)
 			 * the connection.
 			 */
 			PqSendStart = PqSendPointer = 0;
+			PqCompressedRaw = 0;
 			ClientConnectionLost = 1;
 			InterruptPending = 1;
 			return EOF;
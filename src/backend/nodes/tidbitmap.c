@@ -28,6 +28,14 @@
  * into a bitmap, and it can also happen internally when we AND a lossy
  * and a non-lossy page.
  *
+ * Exact pages with only a few tuples are common in big bitmaps, for example
+ * when the index order is not correlated with the heap order.  Storing a
+ * whole tuple bitmap for each of them wastes most of the memory, so such
+ * pages are kept in a second hashtable with much smaller entries that just
+ * list the tuple offsets, and a page is moved over to the main table only
+ * once it has too many tuples for that.  This lets a bitmap stay exact for
+ * two to three times as many pages within the same memory.
+ *
  *
  * Copyright (c) 2003-2019, PostgreSQL Global Development Group
  *
@@ -105,6 +113,36 @@ typedef struct PagetableEntry
 	bitmapword	words[Max(WORDS_PER_PAGE, WORDS_PER_CHUNK)];
 } PagetableEntry;
 
+/*
+ * Entries of the sparse page table.  These are exact pages with at most
+ * SPARSE_TUPLES_PER_PAGE tuples, whose offsets are kept in ascending order.
+ * A page is never present in both tables, and a page that is the header of
+ * a lossy chunk is never in the sparse table.
+ *
+ * Sparse entries are only used in a backend-private bitmap that has a
+ * hashtable (TBM_HASH); shared bitmaps store all exact pages in the main
+ * table, so that the shared iteration code needn't know about them.
+ */
+#define SPARSE_TUPLES_PER_PAGE	6
+
+typedef struct SparsePageEntry
+{
+	BlockNumber blockno;		/* page number (hashtable key) */
+	char		status;			/* hash entry status */
+	bool		recheck;		/* should the tuples be rechecked? */
+	uint8		noffsets;		/* number of valid offsets[] */
+	OffsetNumber offsets[SPARSE_TUPLES_PER_PAGE];
+} SparsePageEntry;
+
+/*
+ * Relative memory cost of a sparse entry, in units of main table entries.
+ * We count the hashtable entry plus the pointer(s) in the sorted arrays
+ * built for iteration, as tbm_calculate_entries does.
+ */
+#define SPARSE_ENTRY_COST \
+	((double) (sizeof(SparsePageEntry) + sizeof(Pointer)) / \
+	 (sizeof(PagetableEntry) + sizeof(Pointer) + sizeof(Pointer)))
+
 /*
  * Holds array of pagetable entries.
  */
@@ -155,12 +193,15 @@ struct TIDBitmap
 	int			maxentries;		/* limit on same to meet maxbytes */
 	int			npages;			/* number of exact entries in pagetable */
 	int			nchunks;		/* number of lossy entries in pagetable */
+	struct sparsetable_hash *sparsetable;	/* hash table of sparse pages */
+	int			nsparse;		/* number of entries in sparsetable */
 	TBMIteratingState iterating;	/* tbm_begin_iterate called? */
 	uint32		lossify_start;	/* offset to start lossifying hashtable at */
 	PagetableEntry entry1;		/* used when status == TBM_ONE_PAGE */
 	/* these are valid when iterating is true: */
 	PagetableEntry **spages;	/* sorted exact-page list, or NULL */
 	PagetableEntry **schunks;	/* sorted lossy-chunk list, or NULL */
+	SparsePageEntry **ssparse;	/* sorted sparse-page list, or NULL */
 	dsa_pointer dsapagetable;	/* dsa_pointer to the element array */
 	dsa_pointer dsapagetableold;	/* dsa_pointer to the old element array */
 	dsa_pointer ptpages;		/* dsa_pointer to the page array */
@@ -178,6 +219,7 @@ struct TBMIterator
 {
 	TIDBitmap  *tbm;			/* TIDBitmap we're iterating over */
 	int			spageptr;		/* next spages index */
+	int			ssparseptr;		/* next ssparse index */
 	int			schunkptr;		/* next schunks index */
 	int			schunkbit;		/* next bit to check in current schunk */
 	TBMIterateResult output;	/* MUST BE LAST (because variable-size) */
@@ -226,15 +268,26 @@ struct TBMSharedIterator
 
 /* Local function prototypes */
 static void tbm_union_page(TIDBitmap *a, const PagetableEntry *bpage);
+static void tbm_union_sparse_page(TIDBitmap *a, const SparsePageEntry *bpage);
 static bool tbm_intersect_page(TIDBitmap *a, PagetableEntry *apage,
 							   const TIDBitmap *b);
+static bool tbm_intersect_sparse_page(SparsePageEntry *apage,
+									  const TIDBitmap *b);
 static const PagetableEntry *tbm_find_pageentry(const TIDBitmap *tbm,
 												BlockNumber pageno);
+static const SparsePageEntry *tbm_find_sparse_pageentry(const TIDBitmap *tbm,
+														BlockNumber pageno);
 static PagetableEntry *tbm_get_pageentry(TIDBitmap *tbm, BlockNumber pageno);
+static void tbm_init_pageentry(TIDBitmap *tbm, PagetableEntry *page,
+							   BlockNumber pageno);
+static SparsePageEntry *tbm_get_sparse_pageentry(TIDBitmap *tbm,
+												 BlockNumber pageno);
+static bool tbm_sparse_add_offset(SparsePageEntry *page, OffsetNumber off);
 static bool tbm_page_is_lossy(const TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno);
 static void tbm_lossify(TIDBitmap *tbm);
 static int	tbm_comparator(const void *left, const void *right);
+static int	tbm_sparse_comparator(const void *left, const void *right);
 static int	tbm_shared_comparator(const void *left, const void *right,
 								  void *arg);
 
@@ -251,6 +304,30 @@ static int	tbm_shared_comparator(const void *left, const void *right,
 #define SH_DECLARE
 #include "lib/simplehash.h"
 
+/* and another one for SparsePageEntry's, which are never in DSA */
+#define SH_PREFIX sparsetable
+#define SH_ELEMENT_TYPE SparsePageEntry
+#define SH_KEY_TYPE BlockNumber
+#define SH_KEY blockno
+#define SH_HASH_KEY(tb, key) murmurhash32(key)
+#define SH_EQUAL(tb, a, b) a == b
+#define SH_SCOPE static inline
+#define SH_DEFINE
+#define SH_DECLARE
+#include "lib/simplehash.h"
+
+/*
+ * tbm_over_limit - does the bitmap use more memory than it should?
+ *
+ * Sparse entries count for a fraction of a main table entry.
+ */
+static inline bool
+tbm_over_limit(const TIDBitmap *tbm, int maxentries)
+{
+	return (tbm->nentries - tbm->nsparse) +
+		tbm->nsparse * SPARSE_ENTRY_COST > maxentries;
+}
+
 
 /*
  * tbm_create - create an initially-empty bitmap
@@ -322,10 +399,14 @@ tbm_free(TIDBitmap *tbm)
 {
 	if (tbm->pagetable)
 		pagetable_destroy(tbm->pagetable);
+	if (tbm->sparsetable)
+		sparsetable_destroy(tbm->sparsetable);
 	if (tbm->spages)
 		pfree(tbm->spages);
 	if (tbm->schunks)
 		pfree(tbm->schunks);
+	if (tbm->ssparse)
+		pfree(tbm->ssparse);
 	pfree(tbm);
 }
 
@@ -378,6 +459,7 @@ tbm_add_tuples(TIDBitmap *tbm, const ItemPointer tids, int ntids,
 {
 	BlockNumber currblk = InvalidBlockNumber;
 	PagetableEntry *page = NULL;	/* only valid when currblk is valid */
+	SparsePageEntry *spage = NULL;	/* ditto */
 	int			i;
 
 	Assert(tbm->iterating == TBM_NOT_ITERATING);
@@ -399,31 +481,45 @@ tbm_add_tuples(TIDBitmap *tbm, const ItemPointer tids, int ntids,
 		 */
 		if (blk != currblk)
 		{
+			page = NULL;
+			spage = NULL;
 			if (tbm_page_is_lossy(tbm, blk))
-				page = NULL;	/* remember page is lossy */
-			else
+				 /* remember page is lossy */ ;
+			else if ((spage = tbm_get_sparse_pageentry(tbm, blk)) == NULL)
 				page = tbm_get_pageentry(tbm, blk);
 			currblk = blk;
 		}
 
-		if (page == NULL)
-			continue;			/* whole page is already marked */
-
-		if (page->ischunk)
-		{
-			/* The page is a lossy chunk header, set bit for itself */
-			wordnum = bitnum = 0;
-		}
+		if (spage != NULL && tbm_sparse_add_offset(spage, off))
+			spage->recheck |= recheck;
 		else
 		{
-			/* Page is exact, so set bit for individual tuple */
-			wordnum = WORDNUM(off - 1);
-			bitnum = BITNUM(off - 1);
+			if (spage != NULL)
+			{
+				/* No room for more offsets, move page to the main table */
+				page = tbm_get_pageentry(tbm, blk);
+				spage = NULL;
+			}
+
+			if (page == NULL)
+				continue;		/* whole page is already marked */
+
+			if (page->ischunk)
+			{
+				/* The page is a lossy chunk header, set bit for itself */
+				wordnum = bitnum = 0;
+			}
+			else
+			{
+				/* Page is exact, so set bit for individual tuple */
+				wordnum = WORDNUM(off - 1);
+				bitnum = BITNUM(off - 1);
+			}
+			page->words[wordnum] |= ((bitmapword) 1 << bitnum);
+			page->recheck |= recheck;
 		}
-		page->words[wordnum] |= ((bitmapword) 1 << bitnum);
-		page->recheck |= recheck;
 
-		if (tbm->nentries > tbm->maxentries)
+		if (tbm_over_limit(tbm, tbm->maxentries))
 		{
 			tbm_lossify(tbm);
 			/* Page could have been converted to lossy, so force new lookup */
@@ -444,7 +540,7 @@ tbm_add_page(TIDBitmap *tbm, BlockNumber pageno)
 	/* Enter the page in the bitmap, or mark it lossy if already present */
 	tbm_mark_page_lossy(tbm, pageno);
 	/* If we went over the memory limit, lossify some more pages */
-	if (tbm->nentries > tbm->maxentries)
+	if (tbm_over_limit(tbm, tbm->maxentries))
 		tbm_lossify(tbm);
 }
 
@@ -472,6 +568,16 @@ tbm_union(TIDBitmap *a, const TIDBitmap *b)
 		pagetable_start_iterate(b->pagetable, &i);
 		while ((bpage = pagetable_iterate(b->pagetable, &i)) != NULL)
 			tbm_union_page(a, bpage);
+
+		if (b->nsparse > 0)
+		{
+			sparsetable_iterator si;
+			SparsePageEntry *bspage;
+
+			sparsetable_start_iterate(b->sparsetable, &si);
+			while ((bspage = sparsetable_iterate(b->sparsetable, &si)) != NULL)
+				tbm_union_sparse_page(a, bspage);
+		}
 	}
 }
 
@@ -526,7 +632,58 @@ tbm_union_page(TIDBitmap *a, const PagetableEntry *bpage)
 		}
 	}
 
-	if (a->nentries > a->maxentries)
+	if (tbm_over_limit(a, a->maxentries))
+		tbm_lossify(a);
+}
+
+/* Process one sparse page of b during a union op */
+static void
+tbm_union_sparse_page(TIDBitmap *a, const SparsePageEntry *bpage)
+{
+	SparsePageEntry *aspage;
+	int			i;
+
+	/* If the page is already lossy in a, there's nothing to do */
+	if (tbm_page_is_lossy(a, bpage->blockno))
+		return;
+
+	aspage = tbm_get_sparse_pageentry(a, bpage->blockno);
+	if (aspage != NULL)
+	{
+		for (i = 0; i < bpage->noffsets; i++)
+		{
+			if (!tbm_sparse_add_offset(aspage, bpage->offsets[i]))
+				break;
+		}
+		if (i == bpage->noffsets)
+			aspage->recheck |= bpage->recheck;
+		else
+			aspage = NULL;		/* didn't fit, use the main table instead */
+	}
+
+	if (aspage == NULL)
+	{
+		PagetableEntry *apage = tbm_get_pageentry(a, bpage->blockno);
+
+		if (apage->ischunk)
+		{
+			/* The page is a lossy chunk header, set bit for itself */
+			apage->words[0] |= ((bitmapword) 1 << 0);
+		}
+		else
+		{
+			for (i = 0; i < bpage->noffsets; i++)
+			{
+				OffsetNumber off = bpage->offsets[i];
+
+				apage->words[WORDNUM(off - 1)] |=
+					((bitmapword) 1 << BITNUM(off - 1));
+			}
+			apage->recheck |= bpage->recheck;
+		}
+	}
+
+	if (tbm_over_limit(a, a->maxentries))
 		tbm_lossify(a);
 }
 
@@ -542,6 +699,20 @@ tbm_intersect(TIDBitmap *a, const TIDBitmap *b)
 	/* Nothing to do if a is empty */
 	if (a->nentries == 0)
 		return;
+	/* If b is empty, so is the result; just throw away a's contents */
+	if (b->nentries == 0)
+	{
+		if (a->status == TBM_HASH)
+		{
+			pagetable_reset(a->pagetable);
+			if (a->sparsetable)
+				sparsetable_reset(a->sparsetable);
+		}
+		else
+			a->status = TBM_EMPTY;
+		a->nentries = a->npages = a->nchunks = a->nsparse = 0;
+		return;
+	}
 	/* Scan through chunks and pages in a, try to match to b */
 	if (a->status == TBM_ONE_PAGE)
 	{
@@ -576,6 +747,25 @@ tbm_intersect(TIDBitmap *a, const TIDBitmap *b)
 					elog(ERROR, "hash table corrupted");
 			}
 		}
+
+		if (a->nsparse > 0)
+		{
+			sparsetable_iterator si;
+			SparsePageEntry *aspage;
+
+			sparsetable_start_iterate(a->sparsetable, &si);
+			while ((aspage = sparsetable_iterate(a->sparsetable, &si)) != NULL)
+			{
+				if (tbm_intersect_sparse_page(aspage, b))
+				{
+					/* Page is now empty, remove it from a */
+					a->nsparse--;
+					a->nentries--;
+					if (!sparsetable_delete(a->sparsetable, aspage->blockno))
+						elog(ERROR, "hash table corrupted");
+				}
+			}
+		}
 	}
 }
 
@@ -612,7 +802,8 @@ tbm_intersect_page(TIDBitmap *a, PagetableEntry *apage, const TIDBitmap *b)
 					if (w & 1)
 					{
 						if (!tbm_page_is_lossy(b, pg) &&
-							tbm_find_pageentry(b, pg) == NULL)
+							tbm_find_pageentry(b, pg) == NULL &&
+							tbm_find_sparse_pageentry(b, pg) == NULL)
 						{
 							/* Page is not in b at all, lose lossy bit */
 							neww &= ~((bitmapword) 1 << bitnum);
@@ -643,6 +834,7 @@ tbm_intersect_page(TIDBitmap *a, PagetableEntry *apage, const TIDBitmap *b)
 	else
 	{
 		bool		candelete = true;
+		const SparsePageEntry *bspage;
 
 		bpage = tbm_find_pageentry(b, apage->blockno);
 		if (bpage != NULL)
@@ -657,11 +849,92 @@ tbm_intersect_page(TIDBitmap *a, PagetableEntry *apage, const TIDBitmap *b)
 			}
 			apage->recheck |= bpage->recheck;
 		}
+		else if ((bspage = tbm_find_sparse_pageentry(b, apage->blockno)) != NULL)
+		{
+			/* Keep only the bits for b's offsets */
+			bitmapword	mask[WORDS_PER_PAGE];
+			int			i;
+
+			memset(mask, 0, sizeof(mask));
+			for (i = 0; i < bspage->noffsets; i++)
+			{
+				OffsetNumber off = bspage->offsets[i];
+
+				mask[WORDNUM(off - 1)] |= ((bitmapword) 1 << BITNUM(off - 1));
+			}
+			for (wordnum = 0; wordnum < WORDS_PER_PAGE; wordnum++)
+			{
+				apage->words[wordnum] &= mask[wordnum];
+				if (apage->words[wordnum] != 0)
+					candelete = false;
+			}
+			apage->recheck |= bspage->recheck;
+		}
 		/* If there is no matching b page, we can just delete the a page */
 		return candelete;
 	}
 }
 
+/*
+ * Process one sparse page of a during an intersection op
+ *
+ * Returns true if apage is now empty and should be deleted from a
+ */
+static bool
+tbm_intersect_sparse_page(SparsePageEntry *apage, const TIDBitmap *b)
+{
+	const PagetableEntry *bpage;
+	const SparsePageEntry *bspage;
+	int			n = 0;
+	int			i;
+
+	if (tbm_page_is_lossy(b, apage->blockno))
+	{
+		/* As in tbm_intersect_page, the remaining tuples need rechecking */
+		apage->recheck = true;
+		return false;
+	}
+
+	bpage = tbm_find_pageentry(b, apage->blockno);
+	if (bpage != NULL)
+	{
+		/* Keep the offsets whose bits are set in b */
+		for (i = 0; i < apage->noffsets; i++)
+		{
+			OffsetNumber off = apage->offsets[i];
+
+			if ((bpage->words[WORDNUM(off - 1)] &
+				 ((bitmapword) 1 << BITNUM(off - 1))) != 0)
+				apage->offsets[n++] = off;
+		}
+		apage->recheck |= bpage->recheck;
+	}
+	else if ((bspage = tbm_find_sparse_pageentry(b, apage->blockno)) != NULL)
+	{
+		/* Both offset lists are sorted, so merge them */
+		int			j = 0;
+
+		for (i = 0; i < apage->noffsets && j < bspage->noffsets;)
+		{
+			if (apage->offsets[i] < bspage->offsets[j])
+				i++;
+			else if (apage->offsets[i] > bspage->offsets[j])
+				j++;
+			else
+			{
+				apage->offsets[n++] = apage->offsets[i];
+				i++;
+				j++;
+			}
+		}
+		apage->recheck |= bspage->recheck;
+	}
+	/* If there is no matching b page, we can just delete the a page */
+
+	apage->noffsets = n;
+	return (n == 0);
+}
+
 /*
  * tbm_is_empty - is a TIDBitmap completely empty?
  */
@@ -703,6 +976,7 @@ tbm_begin_iterate(TIDBitmap *tbm)
 	 * Initialize iteration pointers.
 	 */
 	iterator->spageptr = 0;
+	iterator->ssparseptr = 0;
 	iterator->schunkptr = 0;
 	iterator->schunkbit = 0;
 
@@ -745,6 +1019,26 @@ tbm_begin_iterate(TIDBitmap *tbm)
 		if (nchunks > 1)
 			qsort(tbm->schunks, nchunks, sizeof(PagetableEntry *),
 				  tbm_comparator);
+
+		if (tbm->nsparse > 0)
+		{
+			sparsetable_iterator si;
+			SparsePageEntry *spage;
+			int			nsparse = 0;
+
+			if (!tbm->ssparse)
+				tbm->ssparse = (SparsePageEntry **)
+					MemoryContextAlloc(tbm->mcxt,
+									   tbm->nsparse * sizeof(SparsePageEntry *));
+
+			sparsetable_start_iterate(tbm->sparsetable, &si);
+			while ((spage = sparsetable_iterate(tbm->sparsetable, &si)) != NULL)
+				tbm->ssparse[nsparse++] = spage;
+			Assert(nsparse == tbm->nsparse);
+			if (nsparse > 1)
+				qsort(tbm->ssparse, nsparse, sizeof(SparsePageEntry *),
+					  tbm_sparse_comparator);
+		}
 	}
 
 	tbm->iterating = TBM_ITERATING_PRIVATE;
@@ -772,6 +1066,8 @@ tbm_prepare_shared_iterate(TIDBitmap *tbm)
 
 	Assert(tbm->dsa != NULL);
 	Assert(tbm->iterating != TBM_ITERATING_PRIVATE);
+	/* a shared bitmap never has sparse pages, see tbm_get_sparse_pageentry */
+	Assert(tbm->nsparse == 0);
 
 	/*
 	 * Allocate TBMSharedIteratorState from DSA to hold the shared members and
@@ -971,6 +1267,8 @@ tbm_iterate(TBMIterator *iterator)
 {
 	TIDBitmap  *tbm = iterator->tbm;
 	TBMIterateResult *output = &(iterator->output);
+	PagetableEntry *page = NULL;
+	SparsePageEntry *spage = NULL;
 
 	Assert(tbm->iterating == TBM_ITERATING_PRIVATE);
 
@@ -994,6 +1292,18 @@ tbm_iterate(TBMIterator *iterator)
 		iterator->schunkbit = 0;
 	}
 
+	/* Find the next exact page in each of the two tables */
+	if (iterator->spageptr < tbm->npages)
+	{
+		/* In ONE_PAGE state, we don't allocate an spages[] array */
+		if (tbm->status == TBM_ONE_PAGE)
+			page = &tbm->entry1;
+		else
+			page = tbm->spages[iterator->spageptr];
+	}
+	if (iterator->ssparseptr < tbm->nsparse)
+		spage = tbm->ssparse[iterator->ssparseptr];
+
 	/*
 	 * If both chunk and per-page data remain, must output the numerically
 	 * earlier page.
@@ -1004,8 +1314,8 @@ tbm_iterate(TBMIterator *iterator)
 		BlockNumber chunk_blockno;
 
 		chunk_blockno = chunk->blockno + iterator->schunkbit;
-		if (iterator->spageptr >= tbm->npages ||
-			chunk_blockno < tbm->spages[iterator->spageptr]->blockno)
+		if ((page == NULL || chunk_blockno < page->blockno) &&
+			(spage == NULL || chunk_blockno < spage->blockno))
 		{
 			/* Return a lossy page indicator from the chunk */
 			output->blockno = chunk_blockno;
@@ -1016,16 +1326,21 @@ tbm_iterate(TBMIterator *iterator)
 		}
 	}
 
-	if (iterator->spageptr < tbm->npages)
+	if (spage != NULL && (page == NULL || spage->blockno < page->blockno))
 	{
-		PagetableEntry *page;
-		int			ntuples;
+		/* the offsets are stored in order, so just copy them */
+		memcpy(output->offsets, spage->offsets,
+			   spage->noffsets * sizeof(OffsetNumber));
+		output->blockno = spage->blockno;
+		output->ntuples = spage->noffsets;
+		output->recheck = spage->recheck;
+		iterator->ssparseptr++;
+		return output;
+	}
 
-		/* In ONE_PAGE state, we don't allocate an spages[] array */
-		if (tbm->status == TBM_ONE_PAGE)
-			page = &tbm->entry1;
-		else
-			page = tbm->spages[iterator->spageptr];
+	if (page != NULL)
+	{
+		int			ntuples;
 
 		/* scan bitmap to extract individual offset numbers */
 		ntuples = tbm_extract_page_tuple(page, output);
@@ -1189,6 +1504,20 @@ tbm_find_pageentry(const TIDBitmap *tbm, BlockNumber pageno)
 	return page;
 }
 
+/*
+ * tbm_find_sparse_pageentry - find a SparsePageEntry for the pageno
+ *
+ * Returns NULL if the page isn't in the sparse table.
+ */
+static const SparsePageEntry *
+tbm_find_sparse_pageentry(const TIDBitmap *tbm, BlockNumber pageno)
+{
+	if (tbm->nsparse == 0)
+		return NULL;
+
+	return sparsetable_lookup(tbm->sparsetable, pageno);
+}
+
 /*
  * tbm_get_pageentry - find or create a PagetableEntry for the pageno
  *
@@ -1221,24 +1550,133 @@ tbm_get_pageentry(TIDBitmap *tbm, BlockNumber pageno)
 			tbm_create_pagetable(tbm);
 		}
 
+		/* A sparse page that is needed in the main table is moved over */
+		if (tbm->nsparse > 0)
+		{
+			SparsePageEntry *spage;
+
+			spage = sparsetable_lookup(tbm->sparsetable, pageno);
+			if (spage != NULL)
+			{
+				SparsePageEntry old = *spage;
+				int			i;
+
+				if (!sparsetable_delete(tbm->sparsetable, pageno))
+					elog(ERROR, "hash table corrupted");
+				tbm->nentries--;
+				tbm->nsparse--;
+
+				page = pagetable_insert(tbm->pagetable, pageno, &found);
+				Assert(!found);
+				tbm_init_pageentry(tbm, page, pageno);
+				for (i = 0; i < old.noffsets; i++)
+				{
+					OffsetNumber off = old.offsets[i];
+
+					page->words[WORDNUM(off - 1)] |=
+						((bitmapword) 1 << BITNUM(off - 1));
+				}
+				page->recheck = old.recheck;
+				return page;
+			}
+		}
+
 		/* Look up or create an entry */
 		page = pagetable_insert(tbm->pagetable, pageno, &found);
 	}
 
 	/* Initialize it if not present before */
 	if (!found)
-	{
-		char		oldstatus = page->status;
+		tbm_init_pageentry(tbm, page, pageno);
 
-		MemSet(page, 0, sizeof(PagetableEntry));
-		page->status = oldstatus;
-		page->blockno = pageno;
+	return page;
+}
+
+/*
+ * tbm_get_sparse_pageentry - find or create a SparsePageEntry for the pageno
+ *
+ * Returns NULL if the page can't be stored in the sparse table, because it
+ * already has an entry in the main table, or the bitmap doesn't use sparse
+ * entries at all.  The caller must check for lossy storage first.
+ *
+ * This may cause the table to exceed the desired memory size.  It is
+ * up to the caller to call tbm_lossify() at the next safe point if so.
+ */
+static SparsePageEntry *
+tbm_get_sparse_pageentry(TIDBitmap *tbm, BlockNumber pageno)
+{
+	SparsePageEntry *spage;
+	bool		found;
+
+	/*
+	 * The first page goes into entry1 as usual, and shared bitmaps store all
+	 * pages in the main table.
+	 */
+	if (tbm->status != TBM_HASH || tbm->dsa != NULL)
+		return NULL;
+
+	if (tbm->npages + tbm->nchunks > 0 &&
+		pagetable_lookup(tbm->pagetable, pageno) != NULL)
+		return NULL;
+
+	if (tbm->sparsetable == NULL)
+		tbm->sparsetable = sparsetable_create(tbm->mcxt, 128, NULL);
+
+	spage = sparsetable_insert(tbm->sparsetable, pageno, &found);
+	if (!found)
+	{
+		spage->recheck = false;
+		spage->noffsets = 0;
 		/* must count it too */
 		tbm->nentries++;
-		tbm->npages++;
+		tbm->nsparse++;
 	}
 
-	return page;
+	return spage;
+}
+
+/*
+ * tbm_init_pageentry - initialize a new exact PagetableEntry
+ */
+static void
+tbm_init_pageentry(TIDBitmap *tbm, PagetableEntry *page, BlockNumber pageno)
+{
+	char		oldstatus = page->status;
+
+	MemSet(page, 0, sizeof(PagetableEntry));
+	page->status = oldstatus;
+	page->blockno = pageno;
+	/* must count it too */
+	tbm->nentries++;
+	tbm->npages++;
+}
+
+/*
+ * tbm_sparse_add_offset - add a tuple offset to a sparse page
+ *
+ * Returns false if the page has no room for another offset.
+ */
+static bool
+tbm_sparse_add_offset(SparsePageEntry *page, OffsetNumber off)
+{
+	int			i;
+
+	/* Find the insertion point, keeping the offsets sorted */
+	for (i = page->noffsets; i > 0 && page->offsets[i - 1] >= off; i--)
+	{
+		if (page->offsets[i - 1] == off)
+			return true;		/* already present */
+	}
+
+	if (page->noffsets >= SPARSE_TUPLES_PER_PAGE)
+		return false;
+
+	memmove(&page->offsets[i + 1], &page->offsets[i],
+			(page->noffsets - i) * sizeof(OffsetNumber));
+	page->offsets[i] = off;
+	page->noffsets++;
+
+	return true;
 }
 
 /*
@@ -1287,6 +1725,7 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 	int			bitno;
 	int			wordnum;
 	int			bitnum;
+	bool		chunk_had_sparse = false;
 
 	/* We force the bitmap into hashtable mode whenever it's lossy */
 	if (tbm->status != TBM_HASH)
@@ -1295,6 +1734,25 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 	bitno = pageno % PAGES_PER_CHUNK;
 	chunk_pageno = pageno - bitno;
 
+	/*
+	 * Remove any sparse entries for the page and for the chunk-header page,
+	 * since the latter can't be exact once the chunk exists.
+	 */
+	if (tbm->nsparse > 0)
+	{
+		if (bitno != 0 && sparsetable_delete(tbm->sparsetable, pageno))
+		{
+			tbm->nentries--;
+			tbm->nsparse--;
+		}
+		if (sparsetable_delete(tbm->sparsetable, chunk_pageno))
+		{
+			tbm->nentries--;
+			tbm->nsparse--;
+			chunk_had_sparse = true;
+		}
+	}
+
 	/*
 	 * Remove any extant non-lossy entry for the page.  If the page is its own
 	 * chunk header, however, we skip this and handle the case below.
@@ -1321,6 +1779,9 @@ tbm_mark_page_lossy(TIDBitmap *tbm, BlockNumber pageno)
 		page->status = oldstatus;
 		page->blockno = chunk_pageno;
 		page->ischunk = true;
+		/* a former sparse chunk header page must become lossy too */
+		if (chunk_had_sparse)
+			page->words[0] = ((bitmapword) 1 << 0);
 		/* must count it too */
 		tbm->nentries++;
 		tbm->nchunks++;
@@ -1384,7 +1845,7 @@ tbm_lossify(TIDBitmap *tbm)
 		/* This does the dirty work ... */
 		tbm_mark_page_lossy(tbm, page->blockno);
 
-		if (tbm->nentries <= tbm->maxentries / 2)
+		if (!tbm_over_limit(tbm, tbm->maxentries / 2))
 		{
 			/*
 			 * We have made enough room. Remember where to start lossifying
@@ -1402,6 +1863,34 @@ tbm_lossify(TIDBitmap *tbm)
 		 */
 	}
 
+	/*
+	 * If that wasn't enough, lossify sparse pages too.  We do those last
+	 * because they save less memory each and lose the most precision.
+	 */
+	if (tbm->nsparse > 0 && tbm_over_limit(tbm, tbm->maxentries / 2))
+	{
+		sparsetable_iterator si;
+		SparsePageEntry *spage;
+
+		sparsetable_start_iterate(tbm->sparsetable, &si);
+		while ((spage = sparsetable_iterate(tbm->sparsetable, &si)) != NULL)
+		{
+			/* As above, skip pages that would become chunk headers */
+			if ((spage->blockno % PAGES_PER_CHUNK) == 0)
+				continue;
+
+			/*
+			 * This removes the entry from the sparse table, and perhaps the
+			 * entry for its chunk header page, too.  As above, it's not
+			 * fatal if that makes us miss an element.
+			 */
+			tbm_mark_page_lossy(tbm, spage->blockno);
+
+			if (!tbm_over_limit(tbm, tbm->maxentries / 2))
+				break;
+		}
+	}
+
 	/*
 	 * With a big bitmap and small work_mem, it's possible that we cannot get
 	 * under maxentries.  Again, if that happens, we'd end up uselessly
@@ -1412,7 +1901,7 @@ tbm_lossify(TIDBitmap *tbm)
 	 * we broke out of the loop early; and if we didn't, the current number of
 	 * entries is simply not reducible any further.
 	 */
-	if (tbm->nentries > tbm->maxentries / 2)
+	if (tbm_over_limit(tbm, tbm->maxentries / 2))
 		tbm->maxentries = Min(tbm->nentries, (INT_MAX - 1) / 2) * 2;
 }
 
@@ -1432,6 +1921,22 @@ tbm_comparator(const void *left, const void *right)
 	return 0;
 }
 
+/*
+ * As above, for SparsePageEntry pointers.
+ */
+static int
+tbm_sparse_comparator(const void *left, const void *right)
+{
+	BlockNumber l = (*((SparsePageEntry *const *) left))->blockno;
+	BlockNumber r = (*((SparsePageEntry *const *) right))->blockno;
+
+	if (l < r)
+		return -1;
+	else if (l > r)
+		return 1;
+	return 0;
+}
+
 /*
  * As above, but this will get index into PagetableEntry array.  Therefore,
  * it needs to get actual PagetableEntry using the index before comparing the
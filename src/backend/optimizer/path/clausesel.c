@@ -95,6 +95,17 @@ clauselist_selectivity(PlannerInfo *root,
 											 jointype, sjinfo, rel,
 											 &estimatedclauses);
 	}
+	else if (rel == NULL && list_length(clauses) > 1)
+	{
+		/*
+		 * The clauses may be join clauses.  Estimate equalities between
+		 * several columns of two relations as a composite key, if extended
+		 * statistics say how many distinct values it has.
+		 */
+		s1 *= statext_join_clauselist_selectivity(root, clauses, varRelid,
+												  jointype, sjinfo,
+												  &estimatedclauses);
+	}
 
 	/*
 	 * Apply normal selectivity estimates for the remaining clauses, passing
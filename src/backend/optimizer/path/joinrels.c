@@ -42,6 +42,10 @@ static void try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1,
 								   RelOptInfo *rel2, RelOptInfo *joinrel,
 								   SpecialJoinInfo *parent_sjinfo,
 								   List *parent_restrictlist);
+static bool get_partition_join_map(RelOptInfo *joinrel, RelOptInfo *rel,
+								   int **map);
+static RelOptInfo *get_partition_join_child(RelOptInfo *rel, int *map,
+											int cnt_parts);
 static SpecialJoinInfo *build_child_join_sjinfo(PlannerInfo *root,
 												SpecialJoinInfo *parent_sjinfo,
 												Relids left_relids, Relids right_relids);
@@ -1312,6 +1316,56 @@ restriction_is_constant_false(List *restrictlist,
 	return false;
 }
 
+/*
+ * get_partition_join_map
+ *		Compute the array mapping each partition index of the partitioned join
+ *		relation 'joinrel' to the index of the only partition of the joining
+ *		relation 'rel' that may hold matching rows, or -1 if none may.  *map
+ *		is set to NULL if 'rel' has the same partition bounds as 'joinrel'.
+ *
+ * Returns false if the bounds of 'joinrel' are not a refinement of those of
+ * 'rel'.  That's possible even though build_joinrel_partition_info accepted
+ * another pair of relations making up the same join.
+ */
+static bool
+get_partition_join_map(RelOptInfo *joinrel, RelOptInfo *rel, int **map)
+{
+	PartitionScheme part_scheme = joinrel->part_scheme;
+
+	if (rel->boundinfo == joinrel->boundinfo ||
+		(rel->nparts == joinrel->nparts &&
+		 partition_bounds_equal(part_scheme->partnatts,
+								part_scheme->parttyplen,
+								part_scheme->parttypbyval,
+								joinrel->boundinfo, rel->boundinfo)))
+	{
+		*map = NULL;
+		return true;
+	}
+
+	*map = partition_bounds_refine(part_scheme->partnatts,
+								   part_scheme->partsupfunc,
+								   part_scheme->partcollation,
+								   joinrel->boundinfo, joinrel->nparts,
+								   rel->boundinfo);
+	return (*map != NULL);
+}
+
+/*
+ * get_partition_join_child
+ *		Return the partition of 'rel' to be joined in the join partition with
+ *		index 'cnt_parts', using 'map' from get_partition_join_map.
+ */
+static RelOptInfo *
+get_partition_join_child(RelOptInfo *rel, int *map, int cnt_parts)
+{
+	if (map == NULL)
+		return rel->part_rels[cnt_parts];
+	if (map[cnt_parts] < 0)
+		return NULL;
+	return rel->part_rels[map[cnt_parts]];
+}
+
 /*
  * Assess whether join between given two partitioned relations can be broken
  * down into joins between matching partitions; a technique called
@@ -1341,6 +1395,8 @@ try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 	bool		rel2_is_simple = IS_SIMPLE_REL(rel2);
 	int			nparts;
 	int			cnt_parts;
+	int		   *map1;
+	int		   *map2;
 
 	/* Guard against stack overflow due to overly deep partition hierarchy. */
 	check_stack_depth();
@@ -1354,10 +1410,17 @@ try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 
 	/*
 	 * Since this join relation is partitioned, all the base relations
-	 * participating in this join must be partitioned and so are all the
-	 * intermediate join relations.
+	 * participating in this join must be partitioned.  The intermediate join
+	 * relations may not be, though, when some of their inputs have partition
+	 * bounds that don't refine one another; see build_joinrel_partition_info.
+	 * Treat that like the cases below where the join can't be done
+	 * partitionwise after all.
 	 */
-	Assert(IS_PARTITIONED_REL(rel1) && IS_PARTITIONED_REL(rel2));
+	if (!IS_PARTITIONED_REL(rel1) || !IS_PARTITIONED_REL(rel2))
+	{
+		joinrel->nparts = 0;
+		return;
+	}
 	Assert(REL_HAS_ALL_PART_PROPS(rel1) && REL_HAS_ALL_PART_PROPS(rel2));
 
 	/* The joining relations should have consider_partitionwise_join set. */
@@ -1372,18 +1435,33 @@ try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 		   joinrel->part_scheme == rel2->part_scheme);
 
 	/*
-	 * Since we allow partitionwise join only when the partition bounds of the
-	 * joining relations exactly match, the partition bounds of the join
-	 * should match those of the joining relations.
+	 * The join is partitioned like the finer of the joining relations, see
+	 * build_joinrel_partition_info.  Map each partition of the join to the
+	 * matching partition of each joining relation; no map is needed for a
+	 * relation with the same bounds as the join.
+	 *
+	 * When neither side has the same bounds as the join, the child joins
+	 * would not be disjoint.  Also, a coarser input's partitions are joined
+	 * once per partition of the finer one, so that must be a side whose
+	 * unmatched rows are not emitted.  For the same reason, we don't do this
+	 * when rows have to be locked, as each scan of a coarser partition would
+	 * return its rows to EvalPlanQual rechecks.
+	 *
+	 * If this pair of relations doesn't qualify, mark the joinrel as
+	 * unpartitioned as below, since other pairs may not qualify either.
 	 */
-	Assert(partition_bounds_equal(joinrel->part_scheme->partnatts,
-								  joinrel->part_scheme->parttyplen,
-								  joinrel->part_scheme->parttypbyval,
-								  joinrel->boundinfo, rel1->boundinfo));
-	Assert(partition_bounds_equal(joinrel->part_scheme->partnatts,
-								  joinrel->part_scheme->parttyplen,
-								  joinrel->part_scheme->parttypbyval,
-								  joinrel->boundinfo, rel2->boundinfo));
+	if (!get_partition_join_map(joinrel, rel1, &map1) ||
+		!get_partition_join_map(joinrel, rel2, &map2) ||
+		(map1 != NULL && map2 != NULL) ||
+		((map1 != NULL || map2 != NULL) &&
+		 (root->rowMarks != NIL ||
+		  parent_sjinfo->jointype == JOIN_FULL ||
+		  (map1 != NULL && parent_sjinfo->jointype != JOIN_INNER &&
+		   parent_sjinfo->jointype != JOIN_SEMI))))
+	{
+		joinrel->nparts = 0;
+		return;
+	}
 
 	nparts = joinrel->nparts;
 
@@ -1394,8 +1472,8 @@ try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 	 */
 	for (cnt_parts = 0; cnt_parts < nparts; cnt_parts++)
 	{
-		RelOptInfo *child_rel1 = rel1->part_rels[cnt_parts];
-		RelOptInfo *child_rel2 = rel2->part_rels[cnt_parts];
+		RelOptInfo *child_rel1 = get_partition_join_child(rel1, map1, cnt_parts);
+		RelOptInfo *child_rel2 = get_partition_join_child(rel2, map2, cnt_parts);
 		bool		rel1_empty = (child_rel1 == NULL ||
 								  IS_DUMMY_REL(child_rel1));
 		bool		rel2_empty = (child_rel2 == NULL ||
@@ -0,0 +1,256 @@
+/*-------------------------------------------------------------------------
+ *
+ * linearjoin.c
+ *	  Join search for queries with many relations, using linearized
+ *	  dynamic programming
+ *
+ * Exhaustive dynamic programming over all subsets of the relations (see
+ * standard_join_search) takes exponential time.  Instead, we first choose a
+ * linear order of the relations greedily, always adding the relation that
+ * gives the smallest join with the relations chosen so far.  Then we run
+ * dynamic programming over the contiguous subsequences of that order only,
+ * which considers bushy plans as well as left-deep ones in O(n^3) joins.
+ *
+ * Unlike GEQO, the result doesn't depend on random choices, so the same
+ * query always gets the same plan.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/optimizer/path/linearjoin.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "optimizer/joininfo.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+#include "utils/memutils.h"
+
+
+static bool choose_join_order(PlannerInfo *root, int nrels,
+							  RelOptInfo **rels, RelOptInfo **order);
+static RelOptInfo *join_interval(PlannerInfo *root, RelOptInfo **dp,
+								 int nrels, int first, int last,
+								 bool clauseless);
+
+
+/*
+ * linear_join_search
+ *	  Find a join plan for 'initial_rels' without exhaustive search.
+ *
+ * The arguments and result are as for standard_join_search.  Returns NULL if
+ * no valid join order was found, which shouldn't normally happen; the caller
+ * can then fall back to another search method.
+ */
+RelOptInfo *
+linear_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	RelOptInfo **rels;
+	RelOptInfo **order;
+	RelOptInfo **dp;
+	ListCell   *lc;
+	int			nrels = levels_needed;
+	int			len;
+	int			i;
+
+	/* join_rel_level[] isn't used here, see make_join_rel */
+	Assert(root->join_rel_level == NULL);
+	Assert(list_length(initial_rels) == nrels);
+
+	rels = (RelOptInfo **) palloc(nrels * sizeof(RelOptInfo *));
+	i = 0;
+	foreach(lc, initial_rels)
+		rels[i++] = (RelOptInfo *) lfirst(lc);
+
+	order = (RelOptInfo **) palloc(nrels * sizeof(RelOptInfo *));
+	if (!choose_join_order(root, nrels, rels, order))
+		return NULL;
+
+	/*
+	 * dp[first * nrels + last] is the join of order[first] to order[last].
+	 * Build the joins of each length in turn from the shorter ones.
+	 */
+	dp = (RelOptInfo **) palloc0(nrels * nrels * sizeof(RelOptInfo *));
+	for (i = 0; i < nrels; i++)
+		dp[i * nrels + i] = order[i];
+
+	for (len = 2; len <= nrels; len++)
+	{
+		for (i = 0; i + len <= nrels; i++)
+		{
+			int			last = i + len - 1;
+			RelOptInfo *joinrel;
+
+			/*
+			 * As in join_search_one_level, only consider clauseless joins if
+			 * the subsequence can't be formed otherwise.
+			 */
+			joinrel = join_interval(root, dp, nrels, i, last, false);
+			if (joinrel == NULL)
+				joinrel = join_interval(root, dp, nrels, i, last, true);
+			if (joinrel == NULL)
+				continue;
+
+			/* Create paths for partitionwise joins. */
+			generate_partitionwise_join_paths(root, joinrel);
+
+			/*
+			 * Except for the topmost scan/join rel, consider gathering
+			 * partial paths.  We'll do the same for the topmost scan/join rel
+			 * once we know the final targetlist (see grouping_planner).
+			 */
+			if (len < nrels)
+				generate_gather_paths(root, joinrel, false);
+
+			/* Find and save the cheapest paths for this joinrel */
+			set_cheapest(joinrel);
+
+			dp[i * nrels + last] = joinrel;
+		}
+	}
+
+	return dp[nrels - 1];
+}
+
+/*
+ * join_interval
+ *	  Join order[first..last] in every way that splits it in two.
+ *
+ * Returns the joinrel, or NULL if no split gives a valid join.  Unless
+ * 'clauseless', only splits whose halves are connected by a join clause or
+ * a join order restriction are considered.
+ */
+static RelOptInfo *
+join_interval(PlannerInfo *root, RelOptInfo **dp, int nrels,
+			  int first, int last, bool clauseless)
+{
+	RelOptInfo *result = NULL;
+	int			split;
+
+	for (split = first; split < last; split++)
+	{
+		RelOptInfo *left = dp[first * nrels + split];
+		RelOptInfo *right = dp[(split + 1) * nrels + last];
+		RelOptInfo *joinrel;
+
+		if (left == NULL || right == NULL)
+			continue;
+
+		if (!clauseless &&
+			!have_relevant_joinclause(root, left, right) &&
+			!have_join_order_restriction(root, left, right))
+			continue;
+
+		/* all splits yield the same joinrel, which collects their paths */
+		joinrel = make_join_rel(root, left, right);
+		if (joinrel)
+			result = joinrel;
+	}
+
+	return result;
+}
+
+/*
+ * choose_join_order
+ *	  Order the relations for linear_join_search.
+ *
+ * Starting from the relation with the fewest rows, repeatedly append the
+ * relation whose join with those chosen so far has the fewest rows.  Only
+ * relations connected to the chosen ones are considered, unless there are
+ * none that can be joined.  The result is stored in 'order'.
+ *
+ * The joinrels built to estimate the sizes are thrown away afterwards, in
+ * the same way as geqo_eval() does.  Returns false if we got stuck.
+ */
+static bool
+choose_join_order(PlannerInfo *root, int nrels, RelOptInfo **rels,
+				  RelOptInfo **order)
+{
+	MemoryContext mycontext;
+	MemoryContext oldcxt;
+	int			savelength;
+	struct HTAB *savehash;
+	bool	   *used;
+	RelOptInfo *current;
+	int			norder;
+	int			first;
+	int			i;
+
+	mycontext = AllocSetContextCreate(CurrentMemoryContext,
+									  "linear join search",
+									  ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(mycontext);
+
+	savelength = list_length(root->join_rel_list);
+	savehash = root->join_rel_hash;
+	root->join_rel_hash = NULL;
+
+	used = (bool *) palloc0(nrels * sizeof(bool));
+
+	first = 0;
+	for (i = 1; i < nrels; i++)
+	{
+		if (rels[i]->rows < rels[first]->rows)
+			first = i;
+	}
+	used[first] = true;
+	order[0] = rels[first];
+	current = rels[first];
+
+	for (norder = 1; norder < nrels; norder++)
+	{
+		RelOptInfo *best = NULL;
+		int			bestidx = -1;
+		int			pass;
+
+		for (pass = 0; pass < 2 && best == NULL; pass++)
+		{
+			bool		clauseless = (pass == 1);
+
+			for (i = 0; i < nrels; i++)
+			{
+				RelOptInfo *joinrel;
+
+				if (used[i])
+					continue;
+				if (!clauseless &&
+					!have_relevant_joinclause(root, current, rels[i]) &&
+					!have_join_order_restriction(root, current, rels[i]))
+					continue;
+
+				joinrel = make_join_rel(root, current, rels[i]);
+				if (joinrel == NULL)
+					continue;
+				set_cheapest(joinrel);
+
+				if (best == NULL || joinrel->rows < best->rows ||
+					(joinrel->rows == best->rows &&
+					 joinrel->cheapest_total_path->total_cost <
+					 best->cheapest_total_path->total_cost))
+				{
+					best = joinrel;
+					bestidx = i;
+				}
+			}
+		}
+
+		if (best == NULL)
+			break;
+
+		used[bestidx] = true;
+		order[norder] = rels[bestidx];
+		current = best;
+	}
+
+	root->join_rel_list = list_truncate(root->join_rel_list, savelength);
+	root->join_rel_hash = savehash;
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(mycontext);
+
+	return norder == nrels;
+}
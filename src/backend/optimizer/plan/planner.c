@@ -23,10 +23,12 @@
 #include "access/parallel.h"
 #include "access/sysattr.h"
 #include "access/table.h"
+#include "access/tableam.h"
 #include "access/xact.h"
 #include "catalog/pg_constraint.h"
 #include "catalog/pg_inherits.h"
 #include "catalog/pg_proc.h"
+#include "catalog/pg_trigger.h"
 #include "catalog/pg_type.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
@@ -184,15 +186,28 @@ static RelOptInfo *create_window_paths(PlannerInfo *root,
 									   bool output_target_parallel_safe,
 									   WindowFuncLists *wflists,
 									   List *activeWindows);
-static void create_one_window_path(PlannerInfo *root,
-								   RelOptInfo *window_rel,
-								   Path *path,
-								   PathTarget *input_target,
-								   PathTarget *output_target,
-								   WindowFuncLists *wflists,
-								   List *activeWindows);
+static Path *create_one_window_path(PlannerInfo *root,
+									RelOptInfo *window_rel,
+									Path *path,
+									PathTarget *input_target,
+									PathTarget *output_target,
+									WindowFuncLists *wflists,
+									List *activeWindows);
+static void create_partitionwise_window_path(PlannerInfo *root,
+											 RelOptInfo *window_rel,
+											 RelOptInfo *input_rel,
+											 PathTarget *input_target,
+											 PathTarget *output_target,
+											 WindowFuncLists *wflists,
+											 List *activeWindows);
 static RelOptInfo *create_distinct_paths(PlannerInfo *root,
 										 RelOptInfo *input_rel);
+static void create_partial_distinct_paths(PlannerInfo *root,
+										  RelOptInfo *input_rel,
+										  RelOptInfo *final_distinct_rel);
+static RelOptInfo *create_final_distinct_paths(PlannerInfo *root,
+											   RelOptInfo *input_rel,
+											   RelOptInfo *distinct_rel);
 static RelOptInfo *create_ordered_paths(PlannerInfo *root,
 										RelOptInfo *input_rel,
 										PathTarget *target,
@@ -248,7 +263,11 @@ static void create_partitionwise_grouping_paths(PlannerInfo *root,
 static bool group_by_has_partkey(RelOptInfo *input_rel,
 								 List *targetList,
 								 List *groupClause);
+static bool windows_have_partkey(RelOptInfo *input_rel,
+								 List *targetList,
+								 List *activeWindows);
 static int	common_prefix_cmp(const void *a, const void *b);
+static bool is_parallel_insert_target_safe(Query *parse);
 
 
 /*****************************************************************************
@@ -308,6 +327,8 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	glob->relationOids = NIL;
 	glob->invalItems = NIL;
 	glob->paramExecTypes = NIL;
+	glob->prunableRelids = NULL;
+	glob->partPruneInfos = NIL;
 	glob->lastPHId = 0;
 	glob->lastRowMarkId = 0;
 	glob->lastPlanNodeId = 0;
@@ -317,19 +338,16 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	/*
 	 * Assess whether it's feasible to use parallel mode for this query. We
 	 * can't do this in a standalone backend, or if the command will try to
-	 * modify any data, or if this is a cursor operation, or if GUCs are set
-	 * to values that don't permit parallelism, or if parallel-unsafe
+	 * modify any data other than by inserting into a table that parallel
+	 * workers can insert into, or if this is a cursor operation, or if GUCs
+	 * are set to values that don't permit parallelism, or if parallel-unsafe
 	 * functions are present in the query tree.
 	 *
 	 * (Note that we do allow CREATE TABLE AS, SELECT INTO, and CREATE
-	 * MATERIALIZED VIEW to use parallel plans, but this is safe only because
-	 * the command is writing into a completely new table which workers won't
-	 * be able to see.  If the workers could see the table, the fact that
-	 * group locking would cause them to ignore the leader's heavyweight
-	 * relation extension lock and GIN page locks would make this unsafe.
-	 * We'll have to fix that somehow if we want to allow parallel inserts in
-	 * general; updates and deletes have additional problems especially around
-	 * combo CIDs.)
+	 * MATERIALIZED VIEW to use parallel plans; only the leader writes into
+	 * the new table there.  For an INSERT, the workers may run the
+	 * ModifyTable node themselves, see grouping_planner.  Updates and deletes
+	 * have additional problems especially around combo CIDs.)
 	 *
 	 * For now, we don't try to use parallel mode if we're running inside a
 	 * parallel worker.  We might eventually be able to relax this
@@ -338,13 +356,18 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	 */
 	if ((cursorOptions & CURSOR_OPT_PARALLEL_OK) != 0 &&
 		IsUnderPostmaster &&
-		parse->commandType == CMD_SELECT &&
+		(parse->commandType == CMD_SELECT ||
+		 parse->commandType == CMD_INSERT) &&
 		!parse->hasModifyingCTE &&
 		max_parallel_workers_per_gather > 0 &&
 		!IsParallelWorker())
 	{
 		/* all the cheap tests pass, so scan the query tree */
 		glob->maxParallelHazard = max_parallel_hazard(parse);
+		if (parse->commandType == CMD_INSERT &&
+			glob->maxParallelHazard != PROPARALLEL_UNSAFE &&
+			!is_parallel_insert_target_safe(parse))
+			glob->maxParallelHazard = PROPARALLEL_UNSAFE;
 		glob->parallelModeOK = (glob->maxParallelHazard != PROPARALLEL_UNSAFE);
 	}
 	else
@@ -506,6 +529,25 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 		lfirst(lp) = set_plan_references(subroot, subplan);
 	}
 
+	/*
+	 * Executor startup opens relations that are row-marked or are result
+	 * relations whether or not pruning removes their scans, so those must be
+	 * locked up front like any others.
+	 */
+	if (glob->prunableRelids)
+	{
+		foreach(lp, glob->finalrowmarks)
+		{
+			PlanRowMark *rc = lfirst_node(PlanRowMark, lp);
+
+			glob->prunableRelids = bms_del_member(glob->prunableRelids,
+												  rc->rti);
+		}
+		foreach(lp, glob->resultRelations)
+			glob->prunableRelids = bms_del_member(glob->prunableRelids,
+												  lfirst_int(lp));
+	}
+
 	/* build the PlannedStmt result */
 	result = makeNode(PlannedStmt);
 
@@ -527,6 +569,8 @@ standard_planner(Query *parse, int cursorOptions, ParamListInfo boundParams)
 	result->relationOids = glob->relationOids;
 	result->invalItems = glob->invalItems;
 	result->paramExecTypes = glob->paramExecTypes;
+	result->prunableRelids = glob->prunableRelids;
+	result->partPruneInfos = glob->partPruneInfos;
 	/* utilityStmt should be null, but we might as well copy it */
 	result->utilityStmt = parse->utilityStmt;
 	result->stmt_location = parse->stmt_location;
@@ -2178,6 +2222,7 @@ grouping_planner(PlannerInfo *root, bool inheritance_update,
 		root->upper_targets[UPPERREL_FINAL] = final_target;
 		root->upper_targets[UPPERREL_ORDERED] = final_target;
 		root->upper_targets[UPPERREL_DISTINCT] = sort_input_target;
+		root->upper_targets[UPPERREL_PARTIAL_DISTINCT] = sort_input_target;
 		root->upper_targets[UPPERREL_WINDOW] = sort_input_target;
 		root->upper_targets[UPPERREL_GROUP_AGG] = grouping_target;
 
@@ -2394,6 +2439,43 @@ grouping_planner(PlannerInfo *root, bool inheritance_update,
 		}
 	}
 
+	/*
+	 * For an INSERT, also consider having the workers insert the rows they
+	 * produce themselves, by putting the ModifyTable node below a Gather.
+	 * standard_planner has already checked that they can do that for this
+	 * target table, if parallel mode is allowed at all.  No rows come back
+	 * through the Gather.
+	 */
+	if (parse->commandType == CMD_INSERT && !inheritance_update &&
+		final_rel->consider_parallel && !limit_needed(parse) &&
+		current_rel->partial_pathlist != NIL)
+	{
+		Path	   *subpath = (Path *) linitial(current_rel->partial_pathlist);
+		ModifyTablePath *mtpath;
+		double		rows = 0;
+
+		mtpath = create_modifytable_path(root, final_rel,
+										 parse->commandType,
+										 parse->canSetTag,
+										 parse->resultRelation,
+										 0,
+										 false,
+										 list_make1_int(parse->resultRelation),
+										 list_make1(subpath),
+										 list_make1(root),
+										 NIL,
+										 NIL,
+										 NIL,
+										 NULL,
+										 assign_special_exec_param(root));
+		mtpath->path.parallel_safe = true;
+		mtpath->path.parallel_workers = subpath->parallel_workers;
+
+		add_path(final_rel, (Path *)
+				 create_gather_path(root, final_rel, &mtpath->path,
+									final_rel->reltarget, NULL, &rows));
+	}
+
 	extra.limit_needed = limit_needed(parse);
 	extra.limit_tuples = limit_tuples;
 	extra.count_est = count_est;
@@ -4584,15 +4666,34 @@ create_window_paths(PlannerInfo *root,
 
 		if (path == input_rel->cheapest_total_path ||
 			pathkeys_contained_in(root->window_pathkeys, path->pathkeys))
-			create_one_window_path(root,
-								   window_rel,
-								   path,
-								   input_target,
-								   output_target,
-								   wflists,
-								   activeWindows);
+			add_path(window_rel,
+					 create_one_window_path(root,
+											window_rel,
+											path,
+											input_target,
+											output_target,
+											wflists,
+											activeWindows));
 	}
 
+	/*
+	 * If the input relation is partitioned and every window's PARTITION BY
+	 * includes the partition key, all the rows of any one window partition
+	 * come from the same partition of the input.  Then the window functions
+	 * can be computed in parallel by workers that each take whole partitions.
+	 */
+	if (window_rel->consider_parallel &&
+		enable_partitionwise_aggregate && enable_parallel_append &&
+		IS_PARTITIONED_REL(input_rel) && !IS_OTHER_REL(input_rel) &&
+		windows_have_partkey(input_rel, root->processed_tlist, activeWindows))
+		create_partitionwise_window_path(root,
+										 window_rel,
+										 input_rel,
+										 input_target,
+										 output_target,
+										 wflists,
+										 activeWindows);
+
 	/*
 	 * If there is an FDW that's responsible for all baserels of the query,
 	 * let it consider adding ForeignPaths.
@@ -4616,7 +4717,7 @@ create_window_paths(PlannerInfo *root,
 
 /*
  * Stack window-function implementation steps atop the given Path, and
- * add the result to window_rel.
+ * return the topmost one.
  *
  * window_rel: upperrel to contain result
  * path: input Path to use (must return input_target)
@@ -4625,7 +4726,7 @@ create_window_paths(PlannerInfo *root,
  * wflists: result of find_window_functions
  * activeWindows: result of select_active_windows
  */
-static void
+static Path *
 create_one_window_path(PlannerInfo *root,
 					   RelOptInfo *window_rel,
 					   Path *path,
@@ -4705,6 +4806,81 @@ create_one_window_path(PlannerInfo *root,
 								  wc);
 	}
 
+	return path;
+}
+
+/*
+ * create_partitionwise_window_path
+ *
+ * Add a path to window_rel that computes the window functions in parallel
+ * workers, below a Gather Merge.  The workers share the partitions of the
+ * input relation by way of a Parallel Append whose subpaths are all
+ * non-partial, so each partition is read by exactly one of them; they sort
+ * what they read and compute the window functions over it.  The caller must
+ * have checked that this gives the right answer (see windows_have_partkey).
+ */
+static void
+create_partitionwise_window_path(PlannerInfo *root,
+								 RelOptInfo *window_rel,
+								 RelOptInfo *input_rel,
+								 PathTarget *input_target,
+								 PathTarget *output_target,
+								 WindowFuncLists *wflists,
+								 List *activeWindows)
+{
+	List	   *subpaths = NIL;
+	List	   *partitioned_rels = NIL;
+	int			parallel_workers;
+	int			partition_idx;
+	double		total_rows;
+	Path	   *path;
+
+	for (partition_idx = 0; partition_idx < input_rel->nparts; partition_idx++)
+	{
+		RelOptInfo *child_rel = input_rel->part_rels[partition_idx];
+		Path	   *child_path;
+
+		/* Pruned or dummy children can be ignored. */
+		if (child_rel == NULL || IS_DUMMY_REL(child_rel))
+			continue;
+
+		child_path = child_rel->cheapest_total_path;
+		if (child_path == NULL || !child_path->parallel_safe)
+			return;
+		subpaths = lappend(subpaths, child_path);
+	}
+
+	/*
+	 * With only one partition there's nothing to share out; worse, the
+	 * Append would be removed and its child run by every worker.
+	 */
+	if (list_length(subpaths) < 2)
+		return;
+
+	/* Same formula as add_paths_to_append_rel uses for non-partial paths. */
+	parallel_workers = Min(fls(list_length(subpaths)),
+						   max_parallel_workers_per_gather);
+	if (parallel_workers <= 0)
+		return;
+
+	if (IS_SIMPLE_REL(input_rel))
+		partitioned_rels = list_make1(input_rel->partitioned_child_rels);
+
+	path = (Path *) create_append_path(root, input_rel, subpaths, NIL,
+									   NIL, NULL, parallel_workers, true,
+									   partitioned_rels, -1);
+	path = create_one_window_path(root,
+								  window_rel,
+								  path,
+								  input_target,
+								  output_target,
+								  wflists,
+								  activeWindows);
+
+	total_rows = path->rows * path->parallel_workers;
+	path = (Path *) create_gather_merge_path(root, window_rel, path,
+											 path->pathtarget, path->pathkeys,
+											 NULL, &total_rows);
 	add_path(window_rel, path);
 }
 
@@ -4722,13 +4898,7 @@ static RelOptInfo *
 create_distinct_paths(PlannerInfo *root,
 					  RelOptInfo *input_rel)
 {
-	Query	   *parse = root->parse;
-	Path	   *cheapest_input_path = input_rel->cheapest_total_path;
 	RelOptInfo *distinct_rel;
-	double		numDistinctRows;
-	bool		allow_hash;
-	Path	   *path;
-	ListCell   *lc;
 
 	/* For now, do all work in the (DISTINCT, NULL) upperrel */
 	distinct_rel = fetch_upper_rel(root, UPPERREL_DISTINCT, NULL);
@@ -4750,6 +4920,186 @@ create_distinct_paths(PlannerInfo *root,
 	distinct_rel->useridiscurrent = input_rel->useridiscurrent;
 	distinct_rel->fdwroutine = input_rel->fdwroutine;
 
+	/* build distinct paths based on input_rel's pathlist */
+	create_final_distinct_paths(root, input_rel, distinct_rel);
+
+	/* now build distinct paths based on input_rel's partial_pathlist */
+	create_partial_distinct_paths(root, input_rel, distinct_rel);
+
+	/*
+	 * If there is an FDW that's responsible for all baserels of the query,
+	 * let it consider adding ForeignPaths.
+	 */
+	if (distinct_rel->fdwroutine &&
+		distinct_rel->fdwroutine->GetForeignUpperPaths)
+		distinct_rel->fdwroutine->GetForeignUpperPaths(root, UPPERREL_DISTINCT,
+													   input_rel, distinct_rel,
+													   NULL);
+
+	/* Let extensions possibly add some more paths */
+	if (create_upper_paths_hook)
+		(*create_upper_paths_hook) (root, UPPERREL_DISTINCT,
+									input_rel, distinct_rel, NULL);
+
+	/* Now choose the best path(s) */
+	set_cheapest(distinct_rel);
+
+	return distinct_rel;
+}
+
+/*
+ * create_partial_distinct_paths
+ *
+ * Process 'input_rel' partial paths and add unique/aggregate paths to the
+ * UPPERREL_PARTIAL_DISTINCT rel.  For paths created, add Gather/GatherMerge
+ * paths on top and add a final unique/aggregate path to remove any duplicate
+ * produced from combining rows from parallel workers.
+ */
+static void
+create_partial_distinct_paths(PlannerInfo *root, RelOptInfo *input_rel,
+							  RelOptInfo *final_distinct_rel)
+{
+	RelOptInfo *partial_distinct_rel;
+	Query	   *parse;
+	List	   *distinctExprs;
+	double		numDistinctRows;
+	Path	   *cheapest_partial_path;
+	ListCell   *lc;
+
+	/* nothing to do when there are no partial paths in the input rel */
+	if (!input_rel->consider_parallel || input_rel->partial_pathlist == NIL)
+		return;
+
+	parse = root->parse;
+
+	/*
+	 * Can't do parallel DISTINCT ON: which row is kept depends on the input
+	 * order, and the workers' rows get mixed up in the Gather.
+	 */
+	if (parse->hasDistinctOn)
+		return;
+
+	/*
+	 * With grouping or aggregation, the input is assumed to be mostly unique
+	 * already, and deduplicating it in the workers wouldn't pay off.
+	 */
+	if (parse->groupClause || parse->groupingSets || parse->hasAggs ||
+		root->hasHavingQual)
+		return;
+
+	partial_distinct_rel = fetch_upper_rel(root, UPPERREL_PARTIAL_DISTINCT,
+										   NULL);
+	partial_distinct_rel->reltarget = root->upper_targets[UPPERREL_PARTIAL_DISTINCT];
+	partial_distinct_rel->consider_parallel = input_rel->consider_parallel;
+
+	/*
+	 * If input_rel belongs to a single FDW, so does the partial_distinct_rel.
+	 */
+	partial_distinct_rel->serverid = input_rel->serverid;
+	partial_distinct_rel->userid = input_rel->userid;
+	partial_distinct_rel->useridiscurrent = input_rel->useridiscurrent;
+	partial_distinct_rel->fdwroutine = input_rel->fdwroutine;
+
+	cheapest_partial_path = linitial(input_rel->partial_pathlist);
+
+	distinctExprs = get_sortgrouplist_exprs(parse->distinctClause,
+											parse->targetList);
+
+	/* estimate how many distinct rows we'll get from each worker */
+	numDistinctRows = estimate_num_groups(root, distinctExprs,
+										  cheapest_partial_path->rows,
+										  NULL);
+
+	/* first try adding unique paths atop of sorted paths */
+	if (grouping_is_sortable(parse->distinctClause))
+	{
+		foreach(lc, input_rel->partial_pathlist)
+		{
+			Path	   *path = (Path *) lfirst(lc);
+
+			if (pathkeys_contained_in(root->distinct_pathkeys, path->pathkeys))
+			{
+				add_partial_path(partial_distinct_rel, (Path *)
+								 create_upper_unique_path(root,
+														  partial_distinct_rel,
+														  path,
+														  list_length(root->distinct_pathkeys),
+														  numDistinctRows));
+			}
+		}
+	}
+
+	/*
+	 * Now try hash aggregate paths, if enabled and hashing is possible.
+	 * Since we're not on the hook to ensure we do our best to create at
+	 * least one path here, we treat enable_hashagg as a hard off-switch
+	 * rather than the slightly softer variant in create_final_distinct_paths.
+	 */
+	if (enable_hashagg && grouping_is_hashable(parse->distinctClause))
+	{
+		add_partial_path(partial_distinct_rel, (Path *)
+						 create_agg_path(root,
+										 partial_distinct_rel,
+										 cheapest_partial_path,
+										 cheapest_partial_path->pathtarget,
+										 AGG_HASHED,
+										 AGGSPLIT_SIMPLE,
+										 parse->distinctClause,
+										 NIL,
+										 NULL,
+										 numDistinctRows));
+	}
+
+	/*
+	 * If there is an FDW that's responsible for all baserels of the query,
+	 * let it consider adding ForeignPaths.
+	 */
+	if (partial_distinct_rel->fdwroutine &&
+		partial_distinct_rel->fdwroutine->GetForeignUpperPaths)
+		partial_distinct_rel->fdwroutine->GetForeignUpperPaths(root,
+															   UPPERREL_PARTIAL_DISTINCT,
+															   input_rel,
+															   partial_distinct_rel,
+															   NULL);
+
+	/* Let extensions possibly add some more partial paths */
+	if (create_upper_paths_hook)
+		(*create_upper_paths_hook) (root, UPPERREL_PARTIAL_DISTINCT,
+									input_rel, partial_distinct_rel, NULL);
+
+	if (partial_distinct_rel->partial_pathlist != NIL)
+	{
+		generate_gather_paths(root, partial_distinct_rel, true);
+		set_cheapest(partial_distinct_rel);
+
+		/*
+		 * Finally, create paths to distinctify the final result.  This step
+		 * is needed to remove any duplicates due to combining rows from
+		 * parallel workers.
+		 */
+		create_final_distinct_paths(root, partial_distinct_rel,
+									final_distinct_rel);
+	}
+}
+
+/*
+ * create_final_distinct_paths
+ *		Create distinct paths in 'distinct_rel' based on 'input_rel' pathlist
+ *
+ * input_rel: contains the source-data paths
+ * distinct_rel: destination relation for storing created paths
+ */
+static RelOptInfo *
+create_final_distinct_paths(PlannerInfo *root, RelOptInfo *input_rel,
+							RelOptInfo *distinct_rel)
+{
+	Query	   *parse = root->parse;
+	Path	   *cheapest_input_path = input_rel->cheapest_total_path;
+	double		numDistinctRows;
+	bool		allow_hash;
+	Path	   *path;
+	ListCell   *lc;
+
 	/* Estimate number of distinct rows there will be */
 	if (parse->groupClause || parse->groupingSets || parse->hasAggs ||
 		root->hasHavingQual)
@@ -4895,24 +5245,6 @@ create_distinct_paths(PlannerInfo *root,
 				 errmsg("could not implement DISTINCT"),
 				 errdetail("Some of the datatypes only support hashing, while others only support sorting.")));
 
-	/*
-	 * If there is an FDW that's responsible for all baserels of the query,
-	 * let it consider adding ForeignPaths.
-	 */
-	if (distinct_rel->fdwroutine &&
-		distinct_rel->fdwroutine->GetForeignUpperPaths)
-		distinct_rel->fdwroutine->GetForeignUpperPaths(root, UPPERREL_DISTINCT,
-													   input_rel, distinct_rel,
-													   NULL);
-
-	/* Let extensions possibly add some more paths */
-	if (create_upper_paths_hook)
-		(*create_upper_paths_hook) (root, UPPERREL_DISTINCT,
-									input_rel, distinct_rel, NULL);
-
-	/* Now choose the best path(s) */
-	set_cheapest(distinct_rel);
-
 	return distinct_rel;
 }
 
@@ -4962,13 +5294,17 @@ create_ordered_paths(PlannerInfo *root,
 
 	foreach(lc, input_rel->pathlist)
 	{
-		Path	   *path = (Path *) lfirst(lc);
+		Path	   *input_path = (Path *) lfirst(lc);
+		Path	   *path;
 		bool		is_sorted;
+		int			presorted_keys;
 
-		is_sorted = pathkeys_contained_in(root->sort_pathkeys,
-										  path->pathkeys);
-		if (path == cheapest_input_path || is_sorted)
+		is_sorted = pathkeys_count_contained_in(root->sort_pathkeys,
+												input_path->pathkeys,
+												&presorted_keys);
+		if (input_path == cheapest_input_path || is_sorted)
 		{
+			path = input_path;
 			if (!is_sorted)
 			{
 				/* An explicit sort here can take advantage of LIMIT */
@@ -4986,6 +5322,30 @@ create_ordered_paths(PlannerInfo *root,
 
 			add_path(ordered_rel, path);
 		}
+
+		/*
+		 * If the path is sorted by a prefix of the required pathkeys, also
+		 * consider an incremental sort.  Unlike with a full sort, this is
+		 * worth trying for every such path and not just the cheapest one,
+		 * because the cost depends on how well presorted the path is, and
+		 * the low startup cost may make it win under a LIMIT.
+		 */
+		if (!is_sorted && presorted_keys > 0 && enable_incremental_sort)
+		{
+			path = (Path *) create_incremental_sort_path(root,
+														 ordered_rel,
+														 input_path,
+														 root->sort_pathkeys,
+														 presorted_keys,
+														 limit_tuples);
+
+			/* Add projection step if needed */
+			if (path->pathtarget != target)
+				path = apply_projection_to_path(root, ordered_rel,
+												path, target);
+
+			add_path(ordered_rel, path);
+		}
 	}
 
 	/*
@@ -6306,7 +6666,7 @@ plan_create_index_workers(Oid tableOid, Oid indexOid)
 	 * Furthermore, any index predicate or index expressions must be parallel
 	 * safe.
 	 */
-	if (heap->rd_rel->relpersistence == RELPERSISTENCE_TEMP ||
+	if (RelationUsesLocalBuffers(heap) ||
 		!is_parallel_safe(root, (Node *) RelationGetIndexExpressions(index)) ||
 		!is_parallel_safe(root, (Node *) RelationGetIndexPredicate(index)))
 	{
@@ -7403,3 +7763,127 @@ group_by_has_partkey(RelOptInfo *input_rel,
 
 	return true;
 }
+
+/*
+ * windows_have_partkey
+ *
+ * Returns true, if all the partition keys of the given relation are part of
+ * the PARTITION BY clause of every active window, false otherwise.
+ */
+static bool
+windows_have_partkey(RelOptInfo *input_rel,
+					 List *targetList,
+					 List *activeWindows)
+{
+	ListCell   *lc;
+
+	foreach(lc, activeWindows)
+	{
+		WindowClause *wc = lfirst_node(WindowClause, lc);
+
+		if (wc->partitionClause == NIL ||
+			!group_by_has_partkey(input_rel, targetList, wc->partitionClause))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * is_parallel_insert_target_safe
+ *
+ * Can parallel workers insert into the target table of this INSERT?
+ *
+ * Whatever the ModifyTable node evaluates on the way must be parallel safe,
+ * since the workers may run it: generation expressions, CHECK constraints,
+ * index expressions and predicates, and BEFORE ROW INSERT triggers.  Other
+ * insert triggers, including those for foreign keys, rule it out, as the
+ * events of AFTER triggers can't be passed back to the leader and statement
+ * triggers would fire once per worker; so do ON CONFLICT, RETURNING and WITH
+ * CHECK OPTIONs.  The table must be a plain permanent heap table.  Defaults
+ * were already put into the targetlist by the rewriter, so the caller's
+ * check of the query covers them.
+ */
+static bool
+is_parallel_insert_target_safe(Query *parse)
+{
+	RangeTblEntry *rte = rt_fetch(parse->resultRelation, parse->rtable);
+	Relation	rel;
+	TupleDesc	tupDesc;
+	TupleConstr *constr;
+	List	   *indexoidlist;
+	ListCell   *lc;
+	bool		safe = true;
+	int			i;
+
+	if (parse->onConflict != NULL ||
+		parse->returningList != NIL ||
+		parse->withCheckOptions != NIL ||
+		rte->relkind != RELKIND_RELATION)
+		return false;
+
+	/* the parser already locked the table */
+	rel = table_open(rte->relid, NoLock);
+	tupDesc = RelationGetDescr(rel);
+	constr = tupDesc->constr;
+
+	if (rel->rd_tableam != GetHeapamTableAmRoutine() ||
+		RelationUsesLocalBuffers(rel))
+		safe = false;
+
+	if (safe && constr != NULL)
+	{
+		for (i = 0; i < constr->num_defval && safe; i++)
+		{
+			AttrDefault *defval = &constr->defval[i];
+
+			if (TupleDescAttr(tupDesc, defval->adnum - 1)->attgenerated &&
+				!is_parallel_safe_expr(stringToNode(defval->adbin)))
+				safe = false;
+		}
+		for (i = 0; i < constr->num_check && safe; i++)
+		{
+			if (!is_parallel_safe_expr(stringToNode(constr->check[i].ccbin)))
+				safe = false;
+		}
+	}
+
+	if (safe)
+	{
+		indexoidlist = RelationGetIndexList(rel);
+		foreach(lc, indexoidlist)
+		{
+			Relation	indexRel = index_open(lfirst_oid(lc), AccessShareLock);
+
+			safe = is_parallel_safe_expr((Node *) RelationGetIndexExpressions(indexRel)) &&
+				is_parallel_safe_expr((Node *) RelationGetIndexPredicate(indexRel));
+			index_close(indexRel, AccessShareLock);
+			if (!safe)
+				break;
+		}
+		list_free(indexoidlist);
+	}
+
+	if (safe && rel->trigdesc != NULL)
+	{
+		TriggerDesc *trigdesc = rel->trigdesc;
+
+		for (i = 0; i < trigdesc->numtriggers && safe; i++)
+		{
+			Trigger    *trigger = &trigdesc->triggers[i];
+
+			if (!TRIGGER_FOR_INSERT(trigger->tgtype))
+				continue;
+			if (!TRIGGER_FOR_ROW(trigger->tgtype) ||
+				!TRIGGER_FOR_BEFORE(trigger->tgtype) ||
+				func_parallel(trigger->tgfoid) != PROPARALLEL_SAFE ||
+				(trigger->tgqual != NULL &&
+				 !is_parallel_safe_expr(stringToNode(trigger->tgqual))))
+				safe = false;
+		}
+	}
+
+	table_close(rel, NoLock);
+
+	return safe;
+}
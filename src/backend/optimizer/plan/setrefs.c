@@ -107,6 +107,9 @@ static Plan *set_append_references(PlannerInfo *root,
 static Plan *set_mergeappend_references(PlannerInfo *root,
 										MergeAppend *mplan,
 										int rtoffset);
+static void set_prunable_subplans(PlannerInfo *root,
+								  PartitionPruneInfo *pruneinfo,
+								  List *subplans);
 static void set_hash_references(PlannerInfo *root, Plan *plan, int rtoffset);
 static Node *fix_scan_expr(PlannerInfo *root, Node *node, int rtoffset);
 static Node *fix_scan_expr_mutator(Node *node, fix_scan_expr_context *context);
@@ -548,6 +551,19 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 					fix_scan_list(root, splan->tidquals, rtoffset);
 			}
 			break;
+		case T_TidRangeScan:
+			{
+				TidRangeScan *splan = (TidRangeScan *) plan;
+
+				splan->scan.scanrelid += rtoffset;
+				splan->scan.plan.targetlist =
+					fix_scan_list(root, splan->scan.plan.targetlist, rtoffset);
+				splan->scan.plan.qual =
+					fix_scan_list(root, splan->scan.plan.qual, rtoffset);
+				splan->tidrangequals =
+					fix_scan_list(root, splan->tidrangequals, rtoffset);
+			}
+			break;
 		case T_SubqueryScan:
 			/* Needs special treatment, see comments below */
 			return set_subqueryscan_references(root,
@@ -652,6 +668,7 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 
 		case T_Material:
 		case T_Sort:
+		case T_IncrementalSort:
 		case T_Unique:
 		case T_SetOp:
 
@@ -670,6 +687,26 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 			 */
 			Assert(plan->qual == NIL);
 			break;
+		case T_ResultCache:
+			{
+				ResultCache *rcplan = (ResultCache *) plan;
+
+				/*
+				 * ResultCache does not evaluate its targetlist.  It just uses
+				 * the same targetlist from its outer subnode.
+				 */
+				set_dummy_tlist_references(plan, rtoffset);
+
+				/*
+				 * ResultCache does not check plan->qual, so it had better be
+				 * NIL.
+				 */
+				Assert(plan->qual == NIL);
+
+				rcplan->param_exprs = fix_scan_list(root, rcplan->param_exprs,
+													rtoffset);
+			}
+			break;
 		case T_LockRows:
 			{
 				LockRows   *splan = (LockRows *) plan;
@@ -1352,6 +1389,8 @@ set_append_references(PlannerInfo *root,
 				pinfo->rtindex += rtoffset;
 			}
 		}
+
+		set_prunable_subplans(root, aplan->part_prune_info, aplan->appendplans);
 	}
 
 	/* We don't need to recurse to lefttree or righttree ... */
@@ -1414,6 +1453,8 @@ set_mergeappend_references(PlannerInfo *root,
 				pinfo->rtindex += rtoffset;
 			}
 		}
+
+		set_prunable_subplans(root, mplan->part_prune_info, mplan->mergeplans);
 	}
 
 	/* We don't need to recurse to lefttree or righttree ... */
@@ -1423,6 +1464,77 @@ set_mergeappend_references(PlannerInfo *root,
 	return (Plan *) mplan;
 }
 
+/*
+ * set_prunable_subplans
+ *		Record the relations that initial pruning may keep from being scanned
+ *
+ * If the PartitionPruneInfo of an Append or MergeAppend calls for initial
+ * pruning, the relations scanned by its subplans need not be locked before
+ * pruning has shown that they are needed; this matters mostly for generic
+ * plans of queries on tables with many partitions.  We only bother with
+ * subplans that scan a single leaf partition, possibly below a Sort or a
+ * projecting Result; anything else is locked up front as usual.
+ */
+static void
+set_prunable_subplans(PlannerInfo *root, PartitionPruneInfo *pruneinfo,
+					  List *subplans)
+{
+	PlannerGlobal *glob = root->glob;
+	bool		initial_pruning = false;
+	ListCell   *l;
+	int			i;
+
+	foreach(l, pruneinfo->prune_infos)
+	{
+		List	   *prune_infos = lfirst(l);
+		ListCell   *l2;
+
+		foreach(l2, prune_infos)
+		{
+			PartitionedRelPruneInfo *pinfo = lfirst(l2);
+
+			if (pinfo->initial_pruning_steps != NIL)
+				initial_pruning = true;
+		}
+	}
+
+	if (!initial_pruning)
+		return;
+
+	pruneinfo->nsubplans = list_length(subplans);
+	pruneinfo->subplan_rtis = (int *) palloc0(pruneinfo->nsubplans * sizeof(int));
+
+	i = 0;
+	foreach(l, subplans)
+	{
+		Plan	   *plan = (Plan *) lfirst(l);
+
+		while ((IsA(plan, Sort) || IsA(plan, Result)) &&
+			   plan->lefttree != NULL && plan->initPlan == NIL)
+			plan = plan->lefttree;
+
+		switch (nodeTag(plan))
+		{
+			case T_SeqScan:
+			case T_SampleScan:
+			case T_IndexScan:
+			case T_IndexOnlyScan:
+			case T_BitmapHeapScan:
+			case T_TidScan:
+			case T_TidRangeScan:
+				pruneinfo->subplan_rtis[i] = ((Scan *) plan)->scanrelid;
+				glob->prunableRelids = bms_add_member(glob->prunableRelids,
+													  ((Scan *) plan)->scanrelid);
+				break;
+			default:
+				break;
+		}
+		i++;
+	}
+
+	glob->partPruneInfos = lappend(glob->partPruneInfos, pruneinfo);
+}
+
 /*
  * set_hash_references
  *	   Do set_plan_references processing on a Hash node
@@ -1752,6 +1864,13 @@ set_join_references(PlannerInfo *root, Join *join, int rtoffset)
 		NestLoop   *nl = (NestLoop *) join;
 		ListCell   *lc;
 
+		nl->hashclauses = fix_join_expr(root,
+										nl->hashclauses,
+										outer_itlist,
+										inner_itlist,
+										(Index) 0,
+										rtoffset);
+
 		foreach(lc, nl->nestParams)
 		{
 			NestLoopParam *nlp = (NestLoopParam *) lfirst(lc);
@@ -1798,6 +1917,14 @@ set_join_references(PlannerInfo *root, Join *join, int rtoffset)
 											   outer_itlist,
 											   OUTER_VAR,
 											   rtoffset);
+
+		/*
+		 * The bloomkeys are evaluated by the outer plan itself, a SeqScan,
+		 * so they refer to its scan tuple like a scan qual does.
+		 */
+		hj->bloomkeys = (List *) fix_scan_expr(root,
+											   (Node *) hj->bloomkeys,
+											   rtoffset);
 	}
 
 	/*
@@ -65,9 +65,14 @@ static RelOptInfo *generate_nonunion_paths(SetOperationStmt *op, PlannerInfo *ro
 static List *plan_union_children(PlannerInfo *root,
 								 SetOperationStmt *top_union,
 								 List *refnames_tlist,
-								 List **tlist_list);
+								 List **tlist_list,
+								 double *pNumGroups);
 static Path *make_union_unique(SetOperationStmt *op, Path *path, List *tlist,
 							   PlannerInfo *root);
+static Path *make_partial_union_unique(SetOperationStmt *op,
+									   RelOptInfo *result_rel, Path *ppath,
+									   List *tlist, double dNumGroups,
+									   PlannerInfo *root);
 static void postprocess_setop_rel(PlannerInfo *root, RelOptInfo *rel);
 static bool choose_hashed_setop(PlannerInfo *root, List *groupClauses,
 								Path *input_path,
@@ -549,6 +554,7 @@ generate_union_paths(SetOperationStmt *op, PlannerInfo *root,
 	List	   *tlist_list;
 	List	   *tlist;
 	Path	   *path;
+	double		dNumGroups = 0;
 
 	/*
 	 * If plain UNION, tell children to fetch all tuples.
@@ -570,7 +576,8 @@ generate_union_paths(SetOperationStmt *op, PlannerInfo *root,
 	 * only one Append and unique-ification for the lot.  Recurse to find such
 	 * nodes and compute their children's paths.
 	 */
-	rellist = plan_union_children(root, op, refnames_tlist, &tlist_list);
+	rellist = plan_union_children(root, op, refnames_tlist, &tlist_list,
+								  op->all ? NULL : &dNumGroups);
 
 	/*
 	 * Generate tlist for Append plan node.
@@ -675,6 +682,18 @@ generate_union_paths(SetOperationStmt *op, PlannerInfo *root,
 							   NIL, NULL,
 							   parallel_workers, enable_parallel_append,
 							   NIL, -1);
+
+		/* For UNION, also consider removing duplicates in the workers */
+		if (!op->all)
+		{
+			Path	   *upath;
+
+			upath = make_partial_union_unique(op, result_rel, ppath, tlist,
+											  dNumGroups, root);
+			if (upath)
+				add_path(result_rel, upath);
+		}
+
 		ppath = (Path *)
 			create_gather_path(root, result_rel, ppath,
 							   result_rel->reltarget, NULL, NULL);
@@ -868,18 +887,25 @@ generate_nonunion_paths(SetOperationStmt *op, PlannerInfo *root,
  * implementation standpoint because we don't care about the ordering of
  * a UNION child's result: UNION ALL results are always unordered, and
  * generate_union_paths will force a fresh sort if the top level is a UNION.
+ *
+ * If pNumGroups isn't NULL, the children's estimated numbers of distinct rows
+ * are added up and stored there.
  */
 static List *
 plan_union_children(PlannerInfo *root,
 					SetOperationStmt *top_union,
 					List *refnames_tlist,
-					List **tlist_list)
+					List **tlist_list,
+					double *pNumGroups)
 {
 	List	   *pending_rels = list_make1(top_union);
 	List	   *result = NIL;
 	List	   *child_tlist;
+	double		child_groups;
 
 	*tlist_list = NIL;
+	if (pNumGroups)
+		*pNumGroups = 0;
 
 	while (pending_rels != NIL)
 	{
@@ -918,8 +944,10 @@ plan_union_children(PlannerInfo *root,
 														false, -1,
 														refnames_tlist,
 														&child_tlist,
-														NULL));
+														pNumGroups ? &child_groups : NULL));
 		*tlist_list = lappend(*tlist_list, child_tlist);
+		if (pNumGroups)
+			*pNumGroups += child_groups;
 	}
 
 	return result;
@@ -988,6 +1016,101 @@ make_union_unique(SetOperationStmt *op, Path *path, List *tlist,
 	return path;
 }
 
+/*
+ * Build a path for UNION that removes duplicates in each worker, below the
+ * Gather, as well as in the leader.
+ *
+ * 'ppath' is the partial Append of the children.  Deduplicating it in the
+ * workers means fewer rows to pass to the leader, and less work for the
+ * final deduplication there.  Unlike make_union_unique, we use the
+ * children's estimated numbers of distinct rows, summed in 'dNumGroups':
+ * if we assumed that there are no duplicates, removing them twice would
+ * never look cheaper than doing it once.
+ *
+ * Returns NULL if there are no columns to deduplicate on.
+ */
+static Path *
+make_partial_union_unique(SetOperationStmt *op, RelOptInfo *result_rel,
+						  Path *ppath, List *tlist, double dNumGroups,
+						  PlannerInfo *root)
+{
+	PathTarget *target = result_rel->reltarget;
+	List	   *groupList;
+	List	   *pathkeys;
+	double		dPartialGroups;
+	double		gatherRows;
+	Path	   *path;
+
+	groupList = generate_setop_grouplist(op, tlist);
+	if (groupList == NIL)
+		return NULL;
+
+	/* Each worker sees at most all the distinct rows */
+	dPartialGroups = Min(dNumGroups, ppath->rows);
+
+	if (choose_hashed_setop(root, groupList, ppath,
+							dPartialGroups, dPartialGroups,
+							"UNION"))
+	{
+		/* Hash in the workers, then Gather */
+		path = (Path *) create_agg_path(root,
+										result_rel,
+										ppath,
+										target,
+										AGG_HASHED,
+										AGGSPLIT_SIMPLE,
+										groupList,
+										NIL,
+										NULL,
+										dPartialGroups);
+		gatherRows = path->rows * path->parallel_workers;
+		path = (Path *) create_gather_path(root, result_rel, path, target,
+										   NULL, &gatherRows);
+		dNumGroups = Min(dNumGroups, gatherRows);
+
+		if (choose_hashed_setop(root, groupList, path,
+								dNumGroups, dNumGroups,
+								"UNION"))
+			return (Path *) create_agg_path(root,
+											result_rel,
+											path,
+											target,
+											AGG_HASHED,
+											AGGSPLIT_SIMPLE,
+											groupList,
+											NIL,
+											NULL,
+											dNumGroups);
+
+		pathkeys = make_pathkeys_for_sortclauses(root, groupList, tlist);
+		path = (Path *) create_sort_path(root, result_rel, path, pathkeys,
+										 -1.0);
+	}
+	else
+	{
+		/* Sort and Unique in the workers, then Gather Merge */
+		pathkeys = make_pathkeys_for_sortclauses(root, groupList, tlist);
+		path = (Path *) create_sort_path(root, result_rel, ppath, pathkeys,
+										 -1.0);
+		path = (Path *) create_upper_unique_path(root,
+												 result_rel,
+												 path,
+												 list_length(pathkeys),
+												 dPartialGroups);
+		gatherRows = path->rows * path->parallel_workers;
+		path = (Path *) create_gather_merge_path(root, result_rel, path,
+												 target, pathkeys, NULL,
+												 &gatherRows);
+		dNumGroups = Min(dNumGroups, gatherRows);
+	}
+
+	return (Path *) create_upper_unique_path(root,
+											 result_rel,
+											 path,
+											 list_length(pathkeys),
+											 dNumGroups);
+}
+
 /*
  * postprocess_setop_rel - perform steps required after adding paths
  */
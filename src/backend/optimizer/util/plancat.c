@@ -95,6 +95,8 @@ static void set_baserel_partition_key_exprs(Relation relation,
  *	pages		number of pages
  *	tuples		number of tuples
  *	rel_parallel_workers user-defined number of parallel workers
+ *	rel_narrow_scans	whether the table AM benefits from narrow scans
+ *	rel_tid_range_scans	whether the table AM supports TID range scans
  *
  * Also, add information about the relation's foreign keys to root->fkey_list.
  *
@@ -151,6 +153,14 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 	/* Retrieve the parallel_workers reloption, or -1 if not set. */
 	rel->rel_parallel_workers = RelationGetParallelWorkers(relation, -1);
 
+	/* Does the table AM want to know which columns a scan needs? */
+	rel->rel_narrow_scans = relation->rd_tableam != NULL &&
+		relation->rd_tableam->scan_set_column_hints != NULL;
+
+	/* Can the table AM scan a range of TIDs? */
+	rel->rel_tid_range_scans = relation->rd_tableam != NULL &&
+		relation->rd_tableam->scan_set_tidrange != NULL;
+
 	/*
 	 * Make list of indexes.  Ignore indexes on system catalogs if told to.
 	 * Don't bother with indexes for an inheritance parent, either.
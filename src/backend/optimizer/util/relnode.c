@@ -55,6 +55,9 @@ static List *subbuild_joinrel_joinlist(RelOptInfo *joinrel,
 static void set_foreign_rel_properties(RelOptInfo *joinrel,
 									   RelOptInfo *outer_rel, RelOptInfo *inner_rel);
 static void add_join_rel(PlannerInfo *root, RelOptInfo *joinrel);
+static bool is_partition_refinement(PartitionScheme part_scheme,
+									PartitionBoundInfo fine, int fine_nparts,
+									PartitionBoundInfo coarse);
 static void build_joinrel_partition_info(RelOptInfo *joinrel,
 										 RelOptInfo *outer_rel, RelOptInfo *inner_rel,
 										 List *restrictlist, JoinType jointype);
@@ -221,6 +224,8 @@ build_simple_rel(PlannerInfo *root, int relid, RelOptInfo *parent)
 	rel->subroot = NULL;
 	rel->subplan_params = NIL;
 	rel->rel_parallel_workers = -1; /* set up in get_relation_info */
+	rel->rel_narrow_scans = false;	/* likewise */
+	rel->rel_tid_range_scans = false;	/* likewise */
 	rel->serverid = InvalidOid;
 	rel->userid = rte->checkAsUser;
 	rel->useridiscurrent = false;
@@ -632,6 +637,8 @@ build_join_rel(PlannerInfo *root,
 	joinrel->subroot = NULL;
 	joinrel->subplan_params = NIL;
 	joinrel->rel_parallel_workers = -1;
+	joinrel->rel_narrow_scans = false;
+	joinrel->rel_tid_range_scans = false;
 	joinrel->serverid = InvalidOid;
 	joinrel->userid = InvalidOid;
 	joinrel->useridiscurrent = false;
@@ -1589,6 +1596,26 @@ find_param_path_info(RelOptInfo *rel, Relids required_outer)
 	return NULL;
 }
 
+/*
+ * is_partition_refinement
+ *		Are partition bounds 'fine' a refinement of partition bounds 'coarse'?
+ */
+static bool
+is_partition_refinement(PartitionScheme part_scheme, PartitionBoundInfo fine,
+						int fine_nparts, PartitionBoundInfo coarse)
+{
+	int		   *map;
+
+	map = partition_bounds_refine(part_scheme->partnatts,
+								  part_scheme->partsupfunc,
+								  part_scheme->partcollation,
+								  fine, fine_nparts, coarse);
+	if (map == NULL)
+		return false;
+	pfree(map);
+	return true;
+}
+
 /*
  * build_joinrel_partition_info
  *		If the two relations have same partitioning scheme, their join may be
@@ -1604,6 +1631,7 @@ build_joinrel_partition_info(RelOptInfo *joinrel, RelOptInfo *outer_rel,
 	int			partnatts;
 	int			cnt;
 	PartitionScheme part_scheme;
+	RelOptInfo *fine_rel;
 
 	/* Nothing to do if partitionwise join technique is disabled. */
 	if (!enable_partitionwise_join)
@@ -1640,15 +1668,34 @@ build_joinrel_partition_info(RelOptInfo *joinrel, RelOptInfo *outer_rel,
 		   REL_HAS_ALL_PART_PROPS(inner_rel));
 
 	/*
-	 * For now, our partition matching algorithm can match partitions only
-	 * when the partition bounds of the joining relations are exactly same.
-	 * So, bail out otherwise.
+	 * If the partition bounds of the joining relations are exactly the same,
+	 * the join has the same bounds too.  Failing that, if the bounds of one
+	 * side are a refinement of those of the other, such as monthly partitions
+	 * against quarterly ones, each partition of the finer side need only be
+	 * joined to the single partition of the coarser side overlapping it, and
+	 * the join is partitioned like the finer side.  The coarser side's
+	 * partitions are then scanned multiple times, which is only correct when
+	 * no row of the coarser side is emitted without a partner from the finer
+	 * side; hence the coarser side may only be the inner side of a LEFT or
+	 * ANTI join, and FULL joins are left alone.  See try_partitionwise_join.
 	 */
-	if (outer_rel->nparts != inner_rel->nparts ||
-		!partition_bounds_equal(part_scheme->partnatts,
-								part_scheme->parttyplen,
-								part_scheme->parttypbyval,
-								outer_rel->boundinfo, inner_rel->boundinfo))
+	if (outer_rel->nparts == inner_rel->nparts &&
+		partition_bounds_equal(part_scheme->partnatts,
+							   part_scheme->parttyplen,
+							   part_scheme->parttypbyval,
+							   outer_rel->boundinfo, inner_rel->boundinfo))
+		fine_rel = outer_rel;
+	else if (jointype != JOIN_FULL &&
+			 is_partition_refinement(part_scheme, outer_rel->boundinfo,
+									   outer_rel->nparts,
+									   inner_rel->boundinfo))
+		fine_rel = outer_rel;
+	else if ((jointype == JOIN_INNER || jointype == JOIN_SEMI) &&
+			 is_partition_refinement(part_scheme, inner_rel->boundinfo,
+									   inner_rel->nparts,
+									   outer_rel->boundinfo))
+		fine_rel = inner_rel;
+	else
 	{
 		Assert(!IS_PARTITIONED_REL(joinrel));
 		return;
@@ -1665,15 +1712,15 @@ build_joinrel_partition_info(RelOptInfo *joinrel, RelOptInfo *outer_rel,
 
 	/*
 	 * Join relation is partitioned using the same partitioning scheme as the
-	 * joining relations and has same bounds.
+	 * joining relations and has the bounds of the finer one.
 	 */
 	joinrel->part_scheme = part_scheme;
-	joinrel->boundinfo = outer_rel->boundinfo;
+	joinrel->boundinfo = fine_rel->boundinfo;
 	partnatts = joinrel->part_scheme->partnatts;
 	joinrel->partexprs = (List **) palloc0(sizeof(List *) * partnatts);
 	joinrel->nullable_partexprs =
 		(List **) palloc0(sizeof(List *) * partnatts);
-	joinrel->nparts = outer_rel->nparts;
+	joinrel->nparts = fine_rel->nparts;
 	joinrel->part_rels =
 		(RelOptInfo **) palloc0(sizeof(RelOptInfo *) * joinrel->nparts);
 
@@ -31,6 +31,7 @@
 #include "access/relation.h"
 #include "access/reloptions.h"
 #include "access/table.h"
+#include "access/tuptoaster.h"
 #include "catalog/dependency.h"
 #include "catalog/heap.h"
 #include "catalog/index.h"
@@ -1091,11 +1092,19 @@ transformTableLikeClause(CreateStmtContext *cxt, TableLikeClause *table_like_cla
 			def->identity = attribute->attidentity;
 		}
 
-		/* Likewise, copy storage if requested */
+		/* Likewise, copy storage and compression method if requested */
 		if (table_like_clause->options & CREATE_TABLE_LIKE_STORAGE)
+		{
+			const char *cmname = GetCompressionMethodName(attribute->attcompression);
+
 			def->storage = attribute->attstorage;
+			def->compression = cmname ? pstrdup(cmname) : NULL;
+		}
 		else
+		{
 			def->storage = 0;
+			def->compression = NULL;
+		}
 
 		/* Likewise, copy comment if requested */
 		if ((table_like_clause->options & CREATE_TABLE_LIKE_COMMENTS) &&
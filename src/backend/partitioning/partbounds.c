@@ -773,6 +773,187 @@ partition_bounds_equal(int partnatts, int16 *parttyplen, bool *parttypbyval,
 	return true;
 }
 
+/*
+ * partition_bounds_refine
+ *
+ * Check whether 'fine' is a refinement of 'coarse', that is, whether the
+ * key values accepted by each partition of 'fine' overlap those accepted by
+ * at most one partition of 'coarse'.  If so, return a palloc'd array of
+ * 'fine_nparts' elements giving, for each partition index of 'fine', the
+ * index of the only partition of 'coarse' that can contain rows with equal
+ * partition keys, or -1 if there is none.  Otherwise return NULL.
+ *
+ * This allows a partitionwise join between, say, a table partitioned by
+ * month and one partitioned by quarter: each monthly partition needs to be
+ * joined only to the quarterly partition covering it.  NULL partition keys
+ * are disregarded; partitionwise join requires strict equi-join clauses on
+ * the partition keys, so such rows can never find a join partner anyway.
+ */
+int *
+partition_bounds_refine(int partnatts, FmgrInfo *partsupfunc,
+						Oid *partcollation, PartitionBoundInfo fine,
+						int fine_nparts, PartitionBoundInfo coarse)
+{
+	int		   *map;
+	int			fi;
+	int			ci;
+
+	if (fine->strategy != coarse->strategy)
+		return NULL;
+
+	map = (int *) palloc(sizeof(int) * fine_nparts);
+	for (fi = 0; fi < fine_nparts; fi++)
+		map[fi] = -1;
+
+/*
+ * Note that the key values in some part of the key space are accepted by
+ * partition 'f' of 'fine' and partition 'c' of 'coarse'; fail if 'f' has
+ * already been found to overlap another partition of 'coarse'.
+ */
+#define RECORD_OVERLAP(f, c) \
+	do { \
+		if ((f) >= 0 && (c) >= 0) \
+		{ \
+			if (map[(f)] == -1) \
+				map[(f)] = (c); \
+			else if (map[(f)] != (c)) \
+			{ \
+				pfree(map); \
+				return NULL; \
+			} \
+		} \
+	} while (0)
+
+	switch (fine->strategy)
+	{
+		case PARTITION_STRATEGY_HASH:
+			{
+				int			fine_modulus;
+				int			coarse_modulus;
+
+				/*
+				 * A row whose hash value falls in a given remainder of the
+				 * fine greatest modulus falls in that remainder modulo the
+				 * coarse greatest modulus, provided the latter divides the
+				 * former.
+				 */
+				fine_modulus = get_hash_partition_greatest_modulus(fine);
+				coarse_modulus = get_hash_partition_greatest_modulus(coarse);
+				if (fine_modulus % coarse_modulus != 0)
+				{
+					pfree(map);
+					return NULL;
+				}
+
+				for (fi = 0; fi < fine_modulus; fi++)
+					RECORD_OVERLAP(fine->indexes[fi],
+								   coarse->indexes[fi % coarse_modulus]);
+			}
+			break;
+
+		case PARTITION_STRATEGY_LIST:
+			{
+				/*
+				 * Walk both sorted lists of values at once.  A value listed
+				 * on only one side is accepted by the default partition, if
+				 * any, of the other.
+				 */
+				fi = ci = 0;
+				while (fi < fine->ndatums || ci < coarse->ndatums)
+				{
+					int32		cmpval;
+
+					if (fi >= fine->ndatums)
+						cmpval = 1;
+					else if (ci >= coarse->ndatums)
+						cmpval = -1;
+					else
+						cmpval = DatumGetInt32(FunctionCall2Coll(&partsupfunc[0],
+																 partcollation[0],
+																 fine->datums[fi][0],
+																 coarse->datums[ci][0]));
+					if (cmpval < 0)
+					{
+						RECORD_OVERLAP(fine->indexes[fi], coarse->default_index);
+						fi++;
+					}
+					else if (cmpval > 0)
+					{
+						RECORD_OVERLAP(fine->default_index, coarse->indexes[ci]);
+						ci++;
+					}
+					else
+					{
+						RECORD_OVERLAP(fine->indexes[fi], coarse->indexes[ci]);
+						fi++;
+						ci++;
+					}
+				}
+
+				/* Values listed on neither side go to both default partitions */
+				RECORD_OVERLAP(fine->default_index, coarse->default_index);
+			}
+			break;
+
+		case PARTITION_STRATEGY_RANGE:
+			{
+				/*
+				 * Walk the merged sequence of bounds of both sides.  Between
+				 * two consecutive bounds, the key space is covered by the
+				 * partition whose upper bound is the next bound of each side,
+				 * or by the default partition where there is none.  Note that
+				 * indexes[] has ndatums + 1 elements for range partitioning.
+				 */
+				fi = ci = 0;
+				for (;;)
+				{
+					int			f = fine->indexes[fi];
+					int			c = coarse->indexes[ci];
+					int32		cmpval;
+
+					RECORD_OVERLAP(f >= 0 ? f : fine->default_index,
+								   c >= 0 ? c : coarse->default_index);
+
+					if (fi >= fine->ndatums && ci >= coarse->ndatums)
+						break;
+
+					if (fi >= fine->ndatums)
+						cmpval = 1;
+					else if (ci >= coarse->ndatums)
+						cmpval = -1;
+					else
+					{
+						PartitionRangeBound bound;
+
+						bound.index = -1;
+						bound.datums = coarse->datums[ci];
+						bound.kind = coarse->kind[ci];
+						bound.lower = false;
+						cmpval = partition_rbound_cmp(partnatts, partsupfunc,
+													  partcollation,
+													  fine->datums[fi],
+													  fine->kind[fi],
+													  false, &bound);
+					}
+
+					if (cmpval <= 0)
+						fi++;
+					if (cmpval >= 0)
+						ci++;
+				}
+			}
+			break;
+
+		default:
+			elog(ERROR, "unexpected partition strategy: %d",
+				 (int) fine->strategy);
+	}
+
+#undef RECORD_OVERLAP
+
+	return map;
+}
+
 /*
  * Return a copy of given PartitionBoundInfo structure. The data types of bounds
  * are described by given partition key specification.
@@ -77,6 +77,7 @@
 #include "catalog/pg_database.h"
 #include "commands/dbcommands.h"
 #include "commands/vacuum.h"
+#include "funcapi.h"
 #include "lib/ilist.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
@@ -105,6 +106,7 @@
 #include "utils/syscache.h"
 #include "utils/timeout.h"
 #include "utils/timestamp.h"
+#include "utils/tuplestore.h"
 
 
 /*
@@ -112,6 +114,8 @@
  */
 bool		autovacuum_start_daemon = false;
 int			autovacuum_max_workers;
+int			autovacuum_max_parallel_workers = 0;
+int			autovacuum_eager_freeze_pages = 0;
 int			autovacuum_work_mem = -1;
 int			autovacuum_naptime;
 int			autovacuum_vac_thresh;
@@ -126,9 +130,6 @@ int			autovacuum_vac_cost_limit;
 
 int			Log_autovacuum_min_duration = -1;
 
-/* how long to keep pgstat data in the launcher, in milliseconds */
-#define STATS_READ_DELAY 1000
-
 /* the minimum allowed time between two awakenings of the launcher */
 #define MIN_AUTOVAC_SLEEPTIME 100.0 /* milliseconds */
 #define MAX_AUTOVAC_SLEEPTIME 300	/* seconds */
@@ -184,6 +185,16 @@ typedef struct av_relation
 								 * reloptions, or NULL if none */
 } av_relation;
 
+/* struct to keep track of tables needing work and their priority, in 1st pass */
+typedef struct av_candidate
+{
+	Oid			ac_relid;
+	bool		ac_dovacuum;
+	bool		ac_doanalyze;
+	bool		ac_wraparound;
+	double		ac_priority;
+} av_candidate;
+
 /* struct to keep track of tables to vacuum and/or analyze, after rechecking */
 typedef struct autovac_table
 {
@@ -262,6 +273,13 @@ typedef struct AutoVacuumWorkItem
 
 #define NUM_WORKITEMS	256
 
+/*
+ * Heap page pruning requests can be very numerous under load, and are the
+ * least important ones, so they may take only part of the array; that leaves
+ * room for the BRIN and GIN requests, which aren't retried if dropped.
+ */
+#define MAX_PRUNE_WORKITEMS	(NUM_WORKITEMS / 4)
+
 /*-------------
  * The main autovacuum shmem struct.  On shared memory we store this main
  * struct and the array of WorkerInfo structs.  This struct keeps:
@@ -320,6 +338,14 @@ static int	db_comparator(const void *a, const void *b);
 static void autovac_balance_cost(void);
 
 static void do_autovacuum(void);
+static List *get_autovacuum_tables(Relation classRel, TupleDesc pg_class_desc,
+								   HTAB *table_toast_map,
+								   int effective_multixact_freeze_max_age,
+								   List **orphan_oids);
+static List *add_autovacuum_table(List *tables, Oid relid, bool dovacuum,
+								  bool doanalyze, bool wraparound,
+								  double priority);
+static int	av_candidate_comparator(const void *a, const void *b);
 static void FreeWorkerInfo(int code, Datum arg);
 
 static autovac_table *table_recheck_autovac(Oid relid, HTAB *table_toast_map,
@@ -329,15 +355,13 @@ static void relation_needs_vacanalyze(Oid relid, AutoVacOpts *relopts,
 									  Form_pg_class classForm,
 									  PgStat_StatTabEntry *tabentry,
 									  int effective_multixact_freeze_max_age,
-									  bool *dovacuum, bool *doanalyze, bool *wraparound);
+									  bool *dovacuum, bool *doanalyze, bool *wraparound,
+									  double *priority);
 
 static void autovacuum_do_vac_analyze(autovac_table *tab,
 									  BufferAccessStrategy bstrategy);
 static AutoVacOpts *extract_autovac_opts(HeapTuple tup,
 										 TupleDesc pg_class_desc);
-static PgStat_StatTabEntry *get_pgstat_tabentry_relid(Oid relid, bool isshared,
-													  PgStat_StatDBEntry *shared,
-													  PgStat_StatDBEntry *dbentry);
 static void perform_work_item(AutoVacuumWorkItem *workitem);
 static void autovac_report_activity(autovac_table *tab);
 static void autovac_report_workitem(AutoVacuumWorkItem *workitem,
@@ -345,7 +369,6 @@ static void autovac_report_workitem(AutoVacuumWorkItem *workitem,
 static void av_sighup_handler(SIGNAL_ARGS);
 static void avl_sigusr2_handler(SIGNAL_ARGS);
 static void avl_sigterm_handler(SIGNAL_ARGS);
-static void autovac_refresh_stats(void);
 
 
 
@@ -544,8 +567,7 @@ AutoVacLauncherMain(int argc, char *argv[])
 		dlist_init(&DatabaseList);
 
 		/*
-		 * Make sure pgstat also considers our stat data as gone.  Note: we
-		 * mustn't use autovac_refresh_stats here.
+		 * Make sure pgstat also considers our stat data as gone.
 		 */
 		pgstat_clear_snapshot();
 
@@ -928,7 +950,7 @@ rebuild_database_list(Oid newdb)
 	dlist_iter	iter;
 
 	/* use fresh stats */
-	autovac_refresh_stats();
+	pgstat_clear_snapshot();
 
 	newcxt = AllocSetContextCreate(AutovacMemCxt,
 								   "AV dblist",
@@ -1149,7 +1171,7 @@ do_start_worker(void)
 	oldcxt = MemoryContextSwitchTo(tmpcxt);
 
 	/* use fresh stats */
-	autovac_refresh_stats();
+	pgstat_clear_snapshot();
 
 	/* Get a list of databases */
 	dblist = get_database_list();
@@ -1931,17 +1953,14 @@ do_autovacuum(void)
 {
 	Relation	classRel;
 	HeapTuple	tuple;
-	TableScanDesc relScan;
 	Form_pg_database dbForm;
+	List	   *tables;
 	List	   *table_oids = NIL;
 	List	   *orphan_oids = NIL;
 	HASHCTL		ctl;
 	HTAB	   *table_toast_map;
 	ListCell   *volatile cell;
-	PgStat_StatDBEntry *shared;
-	PgStat_StatDBEntry *dbentry;
 	BufferAccessStrategy bstrategy;
-	ScanKeyData key;
 	TupleDesc	pg_class_desc;
 	int			effective_multixact_freeze_max_age;
 	bool		did_vacuum = false;
@@ -1958,12 +1977,6 @@ do_autovacuum(void)
 										  ALLOCSET_DEFAULT_SIZES);
 	MemoryContextSwitchTo(AutovacMemCxt);
 
-	/*
-	 * may be NULL if we couldn't find an entry (only happens if we are
-	 * forcing a vacuum for anti-wrap purposes).
-	 */
-	dbentry = pgstat_fetch_stat_dbentry(MyDatabaseId);
-
 	/* Start a transaction so our commands have one to play into. */
 	StartTransactionCommand();
 
@@ -2011,9 +2024,6 @@ do_autovacuum(void)
 	/* StartTransactionCommand changed elsewhere */
 	MemoryContextSwitchTo(AutovacMemCxt);
 
-	/* The database hash where pgstat keeps shared relations */
-	shared = pgstat_fetch_stat_dbentry(InvalidOid);
-
 	classRel = table_open(RelationRelationId, AccessShareLock);
 
 	/* create a copy so we can use it after closing pg_class */
@@ -2029,167 +2039,16 @@ do_autovacuum(void)
 								  &ctl,
 								  HASH_ELEM | HASH_BLOBS);
 
-	/*
-	 * Scan pg_class to determine which tables to vacuum.
-	 *
-	 * We do this in two passes: on the first one we collect the list of plain
-	 * relations and materialized views, and on the second one we collect
-	 * TOAST tables. The reason for doing the second pass is that during it we
-	 * want to use the main relation's pg_class.reloptions entry if the TOAST
-	 * table does not have any, and we cannot obtain it unless we know
-	 * beforehand what's the main table OID.
-	 *
-	 * We need to check TOAST tables separately because in cases with short,
-	 * wide tables there might be proportionally much more activity in the
-	 * TOAST table than in its parent.
-	 */
-	relScan = table_beginscan_catalog(classRel, 0, NULL);
-
-	/*
-	 * On the first pass, we collect main tables to vacuum, and also the main
-	 * table relid to TOAST relid mapping.
-	 */
-	while ((tuple = heap_getnext(relScan, ForwardScanDirection)) != NULL)
-	{
-		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
-		PgStat_StatTabEntry *tabentry;
-		AutoVacOpts *relopts;
-		Oid			relid;
-		bool		dovacuum;
-		bool		doanalyze;
-		bool		wraparound;
-
-		if (classForm->relkind != RELKIND_RELATION &&
-			classForm->relkind != RELKIND_MATVIEW)
-			continue;
-
-		relid = classForm->oid;
-
-		/*
-		 * Check if it is a temp table (presumably, of some other backend's).
-		 * We cannot safely process other backends' temp tables.
-		 */
-		if (classForm->relpersistence == RELPERSISTENCE_TEMP)
-		{
-			/*
-			 * We just ignore it if the owning backend is still active and
-			 * using the temporary schema.
-			 */
-			if (!isTempNamespaceInUse(classForm->relnamespace))
-			{
-				/*
-				 * The table seems to be orphaned -- although it might be that
-				 * the owning backend has already deleted it and exited; our
-				 * pg_class scan snapshot is not necessarily up-to-date
-				 * anymore, so we could be looking at a committed-dead entry.
-				 * Remember it so we can try to delete it later.
-				 */
-				orphan_oids = lappend_oid(orphan_oids, relid);
-			}
-			continue;
-		}
-
-		/* Fetch reloptions and the pgstat entry for this table */
-		relopts = extract_autovac_opts(tuple, pg_class_desc);
-		tabentry = get_pgstat_tabentry_relid(relid, classForm->relisshared,
-											 shared, dbentry);
-
-		/* Check if it needs vacuum or analyze */
-		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
-								  effective_multixact_freeze_max_age,
-								  &dovacuum, &doanalyze, &wraparound);
-
-		/* Relations that need work are added to table_oids */
-		if (dovacuum || doanalyze)
-			table_oids = lappend_oid(table_oids, relid);
-
-		/*
-		 * Remember TOAST associations for the second pass.  Note: we must do
-		 * this whether or not the table is going to be vacuumed, because we
-		 * don't automatically vacuum toast tables along the parent table.
-		 */
-		if (OidIsValid(classForm->reltoastrelid))
-		{
-			av_relation *hentry;
-			bool		found;
-
-			hentry = hash_search(table_toast_map,
-								 &classForm->reltoastrelid,
-								 HASH_ENTER, &found);
-
-			if (!found)
-			{
-				/* hash_search already filled in the key */
-				hentry->ar_relid = relid;
-				hentry->ar_hasrelopts = false;
-				if (relopts != NULL)
-				{
-					hentry->ar_hasrelopts = true;
-					memcpy(&hentry->ar_reloptions, relopts,
-						   sizeof(AutoVacOpts));
-				}
-			}
-		}
-	}
-
-	table_endscan(relScan);
-
-	/* second pass: check TOAST tables */
-	ScanKeyInit(&key,
-				Anum_pg_class_relkind,
-				BTEqualStrategyNumber, F_CHAREQ,
-				CharGetDatum(RELKIND_TOASTVALUE));
-
-	relScan = table_beginscan_catalog(classRel, 1, &key);
-	while ((tuple = heap_getnext(relScan, ForwardScanDirection)) != NULL)
-	{
-		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
-		PgStat_StatTabEntry *tabentry;
-		Oid			relid;
-		AutoVacOpts *relopts = NULL;
-		bool		dovacuum;
-		bool		doanalyze;
-		bool		wraparound;
-
-		/*
-		 * We cannot safely process other backends' temp tables, so skip 'em.
-		 */
-		if (classForm->relpersistence == RELPERSISTENCE_TEMP)
-			continue;
-
-		relid = classForm->oid;
-
-		/*
-		 * fetch reloptions -- if this toast table does not have them, try the
-		 * main rel
-		 */
-		relopts = extract_autovac_opts(tuple, pg_class_desc);
-		if (relopts == NULL)
-		{
-			av_relation *hentry;
-			bool		found;
-
-			hentry = hash_search(table_toast_map, &relid, HASH_FIND, &found);
-			if (found && hentry->ar_hasrelopts)
-				relopts = &hentry->ar_reloptions;
-		}
-
-		/* Fetch the pgstat entry for this table */
-		tabentry = get_pgstat_tabentry_relid(relid, classForm->relisshared,
-											 shared, dbentry);
-
-		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
-								  effective_multixact_freeze_max_age,
-								  &dovacuum, &doanalyze, &wraparound);
-
-		/* ignore analyze for toast tables */
-		if (dovacuum)
-			table_oids = lappend_oid(table_oids, relid);
-	}
-
-	table_endscan(relScan);
+	/* Find the tables to process, the most urgent first */
+	tables = get_autovacuum_tables(classRel, pg_class_desc, table_toast_map,
+								   effective_multixact_freeze_max_age,
+								   &orphan_oids);
 	table_close(classRel, AccessShareLock);
 
+	foreach(cell, tables)
+		table_oids = lappend_oid(table_oids,
+								 ((av_candidate *) lfirst(cell))->ac_relid);
+
 	/*
 	 * Recheck orphan temporary tables, and if they still seem orphaned, drop
 	 * them.  We'll eat a transaction per dropped table, which might seem
@@ -2605,6 +2464,240 @@ deleted:
 	CommitTransactionCommand();
 }
 
+/*
+ * get_autovacuum_tables
+ *
+ * Scan pg_class to find the tables of the current database that need to be
+ * vacuumed or analyzed, and return them as a list of av_candidate, the most
+ * urgent first.  The mapping from TOAST tables to their main tables is
+ * stored in table_toast_map.  If orphan_oids isn't NULL, the OIDs of
+ * orphaned temporary tables are appended to *orphan_oids.
+ */
+static List *
+get_autovacuum_tables(Relation classRel, TupleDesc pg_class_desc,
+					  HTAB *table_toast_map,
+					  int effective_multixact_freeze_max_age,
+					  List **orphan_oids)
+{
+	HeapTuple	tuple;
+	TableScanDesc relScan;
+	ScanKeyData key;
+	List	   *tables = NIL;
+
+	/*
+	 * Scan pg_class to determine which tables to vacuum.
+	 *
+	 * We do this in two passes: on the first one we collect the list of plain
+	 * relations and materialized views, and on the second one we collect
+	 * TOAST tables. The reason for doing the second pass is that during it we
+	 * want to use the main relation's pg_class.reloptions entry if the TOAST
+	 * table does not have any, and we cannot obtain it unless we know
+	 * beforehand what's the main table OID.
+	 *
+	 * We need to check TOAST tables separately because in cases with short,
+	 * wide tables there might be proportionally much more activity in the
+	 * TOAST table than in its parent.
+	 */
+	relScan = table_beginscan_catalog(classRel, 0, NULL);
+
+	/*
+	 * On the first pass, we collect main tables to vacuum, and also the main
+	 * table relid to TOAST relid mapping.
+	 */
+	while ((tuple = heap_getnext(relScan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
+		PgStat_StatTabEntry *tabentry;
+		AutoVacOpts *relopts;
+		Oid			relid;
+		bool		dovacuum;
+		bool		doanalyze;
+		bool		wraparound;
+		double		priority;
+
+		if (classForm->relkind != RELKIND_RELATION &&
+			classForm->relkind != RELKIND_MATVIEW)
+			continue;
+
+		relid = classForm->oid;
+
+		/*
+		 * Check if it is a temp table (presumably, of some other backend's).
+		 * We cannot safely process other backends' temp tables.
+		 */
+		if (classForm->relpersistence == RELPERSISTENCE_TEMP)
+		{
+			/*
+			 * We just ignore it if the owning backend is still active and
+			 * using the temporary schema.
+			 */
+			if (!isTempNamespaceInUse(classForm->relnamespace))
+			{
+				/*
+				 * The table seems to be orphaned -- although it might be that
+				 * the owning backend has already deleted it and exited; our
+				 * pg_class scan snapshot is not necessarily up-to-date
+				 * anymore, so we could be looking at a committed-dead entry.
+				 * Remember it so that the caller can try to delete it later.
+				 */
+				if (orphan_oids)
+					*orphan_oids = lappend_oid(*orphan_oids, relid);
+			}
+			continue;
+		}
+
+		/* Global temp tables have no contents outside their sessions */
+		if (classForm->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+			continue;
+
+		/* Fetch reloptions and the pgstat entry for this table */
+		relopts = extract_autovac_opts(tuple, pg_class_desc);
+		tabentry = pgstat_fetch_stat_tabentry_ext(classForm->relisshared,
+												  relid);
+
+		/* Check if it needs vacuum or analyze */
+		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
+								  effective_multixact_freeze_max_age,
+								  &dovacuum, &doanalyze, &wraparound,
+								  &priority);
+
+		/* Relations that need work are added to the list */
+		if (dovacuum || doanalyze)
+			tables = add_autovacuum_table(tables, relid, dovacuum, doanalyze,
+										  wraparound, priority);
+
+		/*
+		 * Remember TOAST associations for the second pass.  Note: we must do
+		 * this whether or not the table is going to be vacuumed, because we
+		 * don't automatically vacuum toast tables along the parent table.
+		 */
+		if (OidIsValid(classForm->reltoastrelid))
+		{
+			av_relation *hentry;
+			bool		found;
+
+			hentry = hash_search(table_toast_map,
+								 &classForm->reltoastrelid,
+								 HASH_ENTER, &found);
+
+			if (!found)
+			{
+				/* hash_search already filled in the key */
+				hentry->ar_relid = relid;
+				hentry->ar_hasrelopts = false;
+				if (relopts != NULL)
+				{
+					hentry->ar_hasrelopts = true;
+					memcpy(&hentry->ar_reloptions, relopts,
+						   sizeof(AutoVacOpts));
+				}
+			}
+		}
+	}
+
+	table_endscan(relScan);
+
+	/* second pass: check TOAST tables */
+	ScanKeyInit(&key,
+				Anum_pg_class_relkind,
+				BTEqualStrategyNumber, F_CHAREQ,
+				CharGetDatum(RELKIND_TOASTVALUE));
+
+	relScan = table_beginscan_catalog(classRel, 1, &key);
+	while ((tuple = heap_getnext(relScan, ForwardScanDirection)) != NULL)
+	{
+		Form_pg_class classForm = (Form_pg_class) GETSTRUCT(tuple);
+		PgStat_StatTabEntry *tabentry;
+		Oid			relid;
+		AutoVacOpts *relopts = NULL;
+		bool		dovacuum;
+		bool		doanalyze;
+		bool		wraparound;
+		double		priority;
+
+		/*
+		 * We cannot safely process other backends' temp tables, so skip 'em.
+		 * The same goes for the per-session contents of global temp tables.
+		 */
+		if (classForm->relpersistence == RELPERSISTENCE_TEMP ||
+			classForm->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+			continue;
+
+		relid = classForm->oid;
+
+		/*
+		 * fetch reloptions -- if this toast table does not have them, try the
+		 * main rel
+		 */
+		relopts = extract_autovac_opts(tuple, pg_class_desc);
+		if (relopts == NULL)
+		{
+			av_relation *hentry;
+			bool		found;
+
+			hentry = hash_search(table_toast_map, &relid, HASH_FIND, &found);
+			if (found && hentry->ar_hasrelopts)
+				relopts = &hentry->ar_reloptions;
+		}
+
+		/* Fetch the pgstat entry for this table */
+		tabentry = pgstat_fetch_stat_tabentry_ext(classForm->relisshared,
+												  relid);
+
+		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
+								  effective_multixact_freeze_max_age,
+								  &dovacuum, &doanalyze, &wraparound,
+								  &priority);
+
+		/* ignore analyze for toast tables */
+		if (dovacuum)
+			tables = add_autovacuum_table(tables, relid, true, false,
+										  wraparound, priority);
+	}
+
+	table_endscan(relScan);
+
+	return list_qsort(tables, av_candidate_comparator);
+}
+
+/*
+ * add_autovacuum_table
+ *		Append a table needing work to a list of av_candidate
+ */
+static List *
+add_autovacuum_table(List *tables, Oid relid, bool dovacuum, bool doanalyze,
+					 bool wraparound, double priority)
+{
+	av_candidate *cand = (av_candidate *) palloc(sizeof(av_candidate));
+
+	cand->ac_relid = relid;
+	cand->ac_dovacuum = dovacuum;
+	cand->ac_doanalyze = doanalyze;
+	cand->ac_wraparound = wraparound;
+	cand->ac_priority = priority;
+
+	return lappend(tables, cand);
+}
+
+/*
+ * qsort comparator for av_candidate list elements: tables at risk of
+ * wraparound go first, then the others by decreasing priority.
+ */
+static int
+av_candidate_comparator(const void *a, const void *b)
+{
+	av_candidate *ca = (av_candidate *) lfirst(*(ListCell **) a);
+	av_candidate *cb = (av_candidate *) lfirst(*(ListCell **) b);
+
+	if (ca->ac_wraparound != cb->ac_wraparound)
+		return ca->ac_wraparound ? -1 : 1;
+	if (ca->ac_priority != cb->ac_priority)
+		return (ca->ac_priority > cb->ac_priority) ? -1 : 1;
+	if (ca->ac_relid != cb->ac_relid)
+		return (ca->ac_relid < cb->ac_relid) ? -1 : 1;
+	return 0;
+}
+
 /*
  * Execute a previously registered work item.
  */
@@ -2657,6 +2750,14 @@ perform_work_item(AutoVacuumWorkItem *workitem)
 									ObjectIdGetDatum(workitem->avw_relation),
 									Int64GetDatum((int64) workitem->avw_blockNumber));
 				break;
+			case AVW_GINCleanPendingList:
+				DirectFunctionCall1(gin_clean_pending_list,
+									ObjectIdGetDatum(workitem->avw_relation));
+				break;
+			case AVW_HeapPrunePage:
+				heap_page_prune_deferred(workitem->avw_relation,
+										 workitem->avw_blockNumber);
+				break;
 			default:
 				elog(WARNING, "unrecognized work item found: type %d",
 					 workitem->avw_type);
@@ -2735,30 +2836,6 @@ extract_autovac_opts(HeapTuple tup, TupleDesc pg_class_desc)
 	return av;
 }
 
-/*
- * get_pgstat_tabentry_relid
- *
- * Fetch the pgstat entry of a table, either local to a database or shared.
- */
-static PgStat_StatTabEntry *
-get_pgstat_tabentry_relid(Oid relid, bool isshared, PgStat_StatDBEntry *shared,
-						  PgStat_StatDBEntry *dbentry)
-{
-	PgStat_StatTabEntry *tabentry = NULL;
-
-	if (isshared)
-	{
-		if (PointerIsValid(shared))
-			tabentry = hash_search(shared->tables, &relid,
-								   HASH_FIND, NULL);
-	}
-	else if (PointerIsValid(dbentry))
-		tabentry = hash_search(dbentry->tables, &relid,
-							   HASH_FIND, NULL);
-
-	return tabentry;
-}
-
 /*
  * table_recheck_autovac
  *
@@ -2778,16 +2855,12 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 	bool		doanalyze;
 	autovac_table *tab = NULL;
 	PgStat_StatTabEntry *tabentry;
-	PgStat_StatDBEntry *shared;
-	PgStat_StatDBEntry *dbentry;
 	bool		wraparound;
+	double		priority;
 	AutoVacOpts *avopts;
 
 	/* use fresh stats */
-	autovac_refresh_stats();
-
-	shared = pgstat_fetch_stat_dbentry(InvalidOid);
-	dbentry = pgstat_fetch_stat_dbentry(MyDatabaseId);
+	pgstat_clear_snapshot();
 
 	/* fetch the relation's relcache entry */
 	classTup = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(relid));
@@ -2812,12 +2885,12 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 	}
 
 	/* fetch the pgstat table entry */
-	tabentry = get_pgstat_tabentry_relid(relid, classForm->relisshared,
-										 shared, dbentry);
+	tabentry = pgstat_fetch_stat_tabentry_ext(classForm->relisshared,
+											  relid);
 
 	relation_needs_vacanalyze(relid, avopts, classForm, tabentry,
 							  effective_multixact_freeze_max_age,
-							  &dovacuum, &doanalyze, &wraparound);
+							  &dovacuum, &doanalyze, &wraparound, &priority);
 
 	/* ignore ANALYZE for toast tables */
 	if (classForm->relkind == RELKIND_TOASTVALUE)
@@ -2888,6 +2961,10 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 			(!wraparound ? VACOPT_SKIP_LOCKED : 0);
 		tab->at_params.index_cleanup = VACOPT_TERNARY_DEFAULT;
 		tab->at_params.truncate = VACOPT_TERNARY_DEFAULT;
+		/* parallel vacuum is only used if enabled for autovacuum */
+		tab->at_params.nworkers = autovacuum_max_parallel_workers > 0 ?
+			autovacuum_max_parallel_workers : -1;
+		tab->at_params.eager_freeze_pages = autovacuum_eager_freeze_pages;
 		tab->at_params.freeze_min_age = freeze_min_age;
 		tab->at_params.freeze_table_age = freeze_table_age;
 		tab->at_params.multixact_freeze_min_age = multixact_freeze_min_age;
@@ -2919,7 +2996,8 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
  *
  * Check whether a relation needs to be vacuumed or analyzed; return each into
  * "dovacuum" and "doanalyze", respectively.  Also return whether the vacuum is
- * being forced because of Xid or multixact wraparound.
+ * being forced because of Xid or multixact wraparound, and into "priority" a
+ * measure of how urgently the relation needs attention.
  *
  * relopts is a pointer to the AutoVacOpts options (either for itself in the
  * case of a plain table, or for either itself or its parent table in the case
@@ -2950,6 +3028,14 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
  * autovacuum_vacuum_threshold GUC variable.  Similarly, a vac_scale_factor
  * value < 0 is substituted with the value of
  * autovacuum_vacuum_scale_factor GUC variable.  Ditto for analyze.
+ *
+ * The priority is the largest of the ratios of the number of dead tuples to
+ * the vacuum threshold, of the number of changed tuples to the analyze
+ * threshold, and of the ages of relfrozenxid and relminmxid to the ages at
+ * which vacuum is forced.  So a table needs work if its priority exceeds 1
+ * (except that analyze-only work doesn't count if autovacuum is disabled for
+ * it), and tables with many dead tuples compared to their size come before
+ * huge tables that barely cross their threshold.
  */
 static void
 relation_needs_vacanalyze(Oid relid,
@@ -2960,7 +3046,8 @@ relation_needs_vacanalyze(Oid relid,
  /* output params below */
 						  bool *dovacuum,
 						  bool *doanalyze,
-						  bool *wraparound)
+						  bool *wraparound,
+						  double *priority)
 {
 	bool		force_vacuum;
 	bool		av_enabled;
@@ -3039,6 +3126,16 @@ relation_needs_vacanalyze(Oid relid,
 	}
 	*wraparound = force_vacuum;
 
+	/* Priority based on the Xid and multixact ages */
+	*priority = 0;
+	if (TransactionIdIsNormal(classForm->relfrozenxid))
+		*priority = (double) (recentXid - classForm->relfrozenxid) /
+			Max(freeze_max_age, 1);
+	if (MultiXactIdIsValid(classForm->relminmxid))
+		*priority = Max(*priority,
+						(double) (recentMulti - classForm->relminmxid) /
+						Max(multixact_freeze_max_age, 1));
+
 	/* User disabled it in pg_class.reloptions?  (But ignore if at risk) */
 	if (!av_enabled && !force_vacuum)
 	{
@@ -3075,6 +3172,9 @@ relation_needs_vacanalyze(Oid relid,
 		/* Determine if this table needs vacuum or analyze. */
 		*dovacuum = force_vacuum || (vactuples > vacthresh);
 		*doanalyze = (anltuples > anlthresh);
+
+		*priority = Max(*priority, vactuples / Max(vacthresh, 1));
+		*priority = Max(*priority, anltuples / Max(anlthresh, 1));
 	}
 	else
 	{
@@ -3174,6 +3274,14 @@ autovac_report_workitem(AutoVacuumWorkItem *workitem,
 			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
 					 "autovacuum: BRIN summarize");
 			break;
+		case AVW_GINCleanPendingList:
+			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
+					 "autovacuum: GIN pending list cleanup");
+			break;
+		case AVW_HeapPrunePage:
+			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
+					 "autovacuum: heap page prune");
+			break;
 	}
 
 	/*
@@ -3210,17 +3318,47 @@ AutoVacuumingActive(void)
 
 /*
  * Request one work item to the next autovacuum run processing our database.
- * Return false if the request can't be recorded.
+ * Return false if the request can't be recorded.  An identical request that
+ * is still waiting to be processed counts as recorded.
  */
 bool
 AutoVacuumRequestWork(AutoVacuumWorkItemType type, Oid relationId,
 					  BlockNumber blkno)
 {
 	int			i;
+	int			nsametype = 0;
 	bool		result = false;
 
 	LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
 
+	/*
+	 * Don't queue the same work twice; a request that is already being
+	 * processed doesn't count, as it might miss the work we want done now.
+	 */
+	for (i = 0; i < NUM_WORKITEMS; i++)
+	{
+		AutoVacuumWorkItem *workitem = &AutoVacuumShmem->av_workItems[i];
+
+		if (workitem->avw_used && workitem->avw_type == type)
+			nsametype++;
+
+		if (workitem->avw_used && !workitem->avw_active &&
+			workitem->avw_type == type &&
+			workitem->avw_database == MyDatabaseId &&
+			workitem->avw_relation == relationId &&
+			workitem->avw_blockNumber == blkno)
+		{
+			LWLockRelease(AutovacuumLock);
+			return true;
+		}
+	}
+
+	if (type == AVW_HeapPrunePage && nsametype >= MAX_PRUNE_WORKITEMS)
+	{
+		LWLockRelease(AutovacuumLock);
+		return false;
+	}
+
 	/*
 	 * Locate an unused work item and fill it with the given data.
 	 */
@@ -3341,33 +3479,92 @@ AutoVacuumShmemInit(void)
 }
 
 /*
- * autovac_refresh_stats
- *		Refresh pgstats data for an autovacuum process
- *
- * Cause the next pgstats read operation to obtain fresh data, but throttle
- * such refreshing in the autovacuum launcher.  This is mostly to avoid
- * rereading the pgstats files too many times in quick succession when there
- * are many databases.
+ * pg_stat_get_autovacuum_queue
  *
- * Note: we avoid throttling in the autovac worker, as it would be
- * counterproductive in the recheck logic.
+ * Return the tables of the current database that autovacuum would process
+ * now, according to the current statistics, and their priorities.
  */
-static void
-autovac_refresh_stats(void)
+Datum
+pg_stat_get_autovacuum_queue(PG_FUNCTION_ARGS)
 {
-	if (IsAutoVacuumLauncherProcess())
+#define PG_STAT_GET_AUTOVACUUM_QUEUE_COLS	5
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Relation	classRel;
+	HASHCTL		ctl;
+	HTAB	   *table_toast_map;
+	List	   *tables;
+	ListCell   *lc;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	/* relation_needs_vacanalyze() measures ages against these */
+	recentXid = ReadNewTransactionId();
+	recentMulti = ReadNextMultiXactId();
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(av_relation);
+	ctl.hcxt = CurrentMemoryContext;
+
+	table_toast_map = hash_create("TOAST to main relid map",
+								  100,
+								  &ctl,
+								  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	classRel = table_open(RelationRelationId, AccessShareLock);
+	tables = get_autovacuum_tables(classRel, RelationGetDescr(classRel),
+								   table_toast_map,
+								   MultiXactMemberFreezeThreshold(),
+								   NULL);
+	table_close(classRel, AccessShareLock);
+
+	foreach(lc, tables)
 	{
-		static TimestampTz last_read = 0;
-		TimestampTz current_time;
+		av_candidate *cand = (av_candidate *) lfirst(lc);
+		Datum		values[PG_STAT_GET_AUTOVACUUM_QUEUE_COLS];
+		bool		nulls[PG_STAT_GET_AUTOVACUUM_QUEUE_COLS];
 
-		current_time = GetCurrentTimestamp();
+		MemSet(nulls, 0, sizeof(nulls));
 
-		if (!TimestampDifferenceExceeds(last_read, current_time,
-										STATS_READ_DELAY))
-			return;
+		values[0] = ObjectIdGetDatum(cand->ac_relid);
+		values[1] = BoolGetDatum(cand->ac_dovacuum);
+		values[2] = BoolGetDatum(cand->ac_doanalyze);
+		values[3] = BoolGetDatum(cand->ac_wraparound);
+		values[4] = Float8GetDatum(cand->ac_priority);
 
-		last_read = current_time;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
 	}
 
-	pgstat_clear_snapshot();
+	hash_destroy(table_toast_map);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
 }
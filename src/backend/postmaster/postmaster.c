@@ -109,10 +109,10 @@
 #include "pg_getopt.h"
 #include "pgstat.h"
 #include "port/pg_bswap.h"
+#include "portability/instr_time.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/fork_process.h"
-#include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
 #include "postmaster/syslogger.h"
 #include "replication/logicallauncher.h"
@@ -185,6 +185,23 @@ typedef struct bkend
 
 static dlist_head BackendList = DLIST_STATIC_INIT(BackendList);
 
+#ifndef EXEC_BACKEND
+
+/*
+ * Idle preforked backends.  These have been forked and are registered in
+ * BackendList like any other backend, but wait for us to pass them a client
+ * connection through a socket pair; see StartPreforkedBackend().
+ */
+typedef struct PreforkedBackend
+{
+	Backend    *bn;				/* its entry in BackendList */
+	pgsocket	sock;			/* our end of the socket pair */
+} PreforkedBackend;
+
+static PreforkedBackend *PreforkedBackends = NULL;
+static int	NumPreforkedBackends = 0;
+#endif
+
 #ifdef EXEC_BACKEND
 static Backend *ShmemBackendArray;
 #endif
@@ -213,6 +230,9 @@ char	   *ListenAddresses;
  */
 int			ReservedBackends;
 
+/* Number of idle backends to keep forked ahead of connection requests */
+int			preforked_backends = 0;
+
 /* The socket(s) we're listening to. */
 #define MAXLISTEN	64
 static pgsocket ListenSocket[MAXLISTEN];
@@ -235,6 +255,8 @@ static int	SendStop = false;
 /* still more option variables */
 bool		EnableSSL = false;
 
+bool		libpq_compression = true;
+
 int			PreAuthDelay = 0;
 int			AuthenticationTimeout = 60;
 
@@ -254,7 +276,6 @@ static pid_t StartupPID = 0,
 			WalReceiverPID = 0,
 			AutoVacPID = 0,
 			PgArchPID = 0,
-			PgStatPID = 0,
 			SysLoggerPID = 0;
 
 /* Startup process's status */
@@ -406,6 +427,7 @@ static int	ServerLoop(void);
 static int	BackendStartup(Port *port);
 static int	ProcessStartupPacket(Port *port, bool secure_done);
 static void SendNegotiateProtocolVersion(List *unrecognized_protocol_options);
+static void SendCompressionAck(ZpqAlgorithm algorithm);
 static void processCancelRequest(Port *port, void *pkt);
 static int	initMasks(fd_set *rmask);
 static void report_fork_failure_to_client(Port *port, int errnum);
@@ -414,6 +436,14 @@ static bool RandomCancelKey(int32 *cancel_key);
 static void signal_child(pid_t pid, int signal);
 static bool SignalSomeChildren(int signal, int targets);
 static void TerminateChildren(int signal);
+#ifndef EXEC_BACKEND
+static void MaybeStartPreforkedBackends(void);
+static bool StartPreforkedBackend(void);
+static Port *ReceivePreforkedConnection(pgsocket sock);
+static bool HandOffToPreforkedBackend(Port *port);
+static void ForgetPreforkedBackend(pid_t pid);
+static void RetirePreforkedBackends(void);
+#endif
 
 #define SignalChildren(sig)			   SignalSomeChildren(sig, BACKEND_TYPE_ALL)
 
@@ -502,7 +532,6 @@ typedef struct
 	PGPROC	   *AuxiliaryProcs;
 	PGPROC	   *PreparedXactProcs;
 	PMSignalData *PMSignalState;
-	InheritableSocket pgStatSock;
 	pid_t		PostmasterPid;
 	TimestampTz PgStartTime;
 	TimestampTz PgReloadTime;
@@ -543,6 +572,7 @@ static void ShmemBackendArrayRemove(Backend *bn);
 #define StartCheckpointer()		StartChildProcess(CheckpointerProcess)
 #define StartWalWriter()		StartChildProcess(WalWriterProcess)
 #define StartWalReceiver()		StartChildProcess(WalReceiverProcess)
+#define StartArchiver()			StartChildProcess(ArchiverProcess)
 
 /* Macros to check exit status of a child process */
 #define EXIT_STATUS_0(st)  ((st) == 0)
@@ -1335,13 +1365,6 @@ PostmasterMain(int argc, char *argv[])
 
 	whereToSendOutput = DestNone;
 
-	/*
-	 * Initialize stats collection subsystem (this does NOT start the
-	 * collector process!)
-	 *
-	 */
-	pgstat_init();
-
 	/*
 	 * Initialize the autovacuum subsystem (again, no process start yet)
 	 * 只做检查
@@ -1751,6 +1774,11 @@ ServerLoop(void)
 			}
 		}
 
+#ifndef EXEC_BACKEND
+		/* Replace preforked backends that got a connection */
+		MaybeStartPreforkedBackends();
+#endif
+
 		/* If we have lost the log collector, try to start a new one */
 		if (SysLoggerPID == 0 && Logging_collector)
 			SysLoggerPID = SysLogger_Start();
@@ -1792,14 +1820,9 @@ ServerLoop(void)
 				start_autovac_launcher = false; /* signal processed */
 		}
 
-		/* If we have lost the stats collector, try to start a new one */
-		if (PgStatPID == 0 &&
-			(pmState == PM_RUN || pmState == PM_HOT_STANDBY))
-			PgStatPID = pgstat_start();
-
 		/* If we have lost the archiver, try to start a new one. */
 		if (PgArchPID == 0 && PgArchStartupAllowed())
-			PgArchPID = pgarch_start();
+			PgArchPID = StartArchiver();
 
 		/* If we need to signal the autovacuum launcher, do so now */
 		if (avlauncher_needs_signal)
@@ -2110,6 +2133,7 @@ retry1:
 	{
 		int32		offset = sizeof(ProtocolVersion);
 		List	   *unrecognized_protocol_options = NIL;
+		char	   *compression_request = NULL;
 
 		/*
 		 * Scan packet body for name/option pairs.  We can assume any string
@@ -2159,12 +2183,16 @@ retry1:
 									valptr),
 							 errhint("Valid values are: \"false\", 0, \"true\", 1, \"database\".")));
 			}
+			else if (strcmp(nameptr, "_pq_.compression") == 0)
+			{
+				/* List of compression algorithms the client can handle */
+				compression_request = pstrdup(valptr);
+			}
 			else if (strncmp(nameptr, "_pq_.", 5) == 0)
 			{
 				/*
-				 * Any option beginning with _pq_. is reserved for use as a
-				 * protocol-level option, but at present no such options are
-				 * defined.
+				 * Any other option beginning with _pq_. is reserved for use
+				 * as a protocol-level option, but we don't know it.
 				 */
 				unrecognized_protocol_options =
 					lappend(unrecognized_protocol_options, pstrdup(nameptr));
@@ -2213,6 +2241,29 @@ retry1:
 		if (PG_PROTOCOL_MINOR(proto) > PG_PROTOCOL_MINOR(PG_PROTOCOL_LATEST) ||
 			unrecognized_protocol_options != NIL)
 			SendNegotiateProtocolVersion(unrecognized_protocol_options);
+
+		/*
+		 * If the client offered protocol compression and we can do one of
+		 * the algorithms it listed, tell it which, and compress everything
+		 * from here on.  Otherwise say nothing, and the client carries on
+		 * without compression.
+		 */
+		if (compression_request != NULL && libpq_compression)
+		{
+			ZpqAlgorithm algorithm = zpq_choose_algorithm(compression_request);
+
+			if (algorithm != ZPQ_NONE)
+			{
+				ZpqStream  *zs = zpq_create(algorithm);
+
+				if (zs == NULL)
+					ereport(FATAL,
+							(errcode(ERRCODE_OUT_OF_MEMORY),
+							 errmsg("out of memory")));
+				SendCompressionAck(algorithm);
+				pq_enable_compression(zs);
+			}
+		}
 	}
 	else
 	{
@@ -2355,6 +2406,26 @@ SendNegotiateProtocolVersion(List *unrecognized_protocol_options)
 	/* no need to flush, some other message will follow */
 }
 
+/*
+ * Send a CompressionAck message, naming the algorithm the rest of the
+ * session will be compressed with.  Unlike everything that follows it, this
+ * message goes out uncompressed, so it has to be flushed right away.
+ */
+static void
+SendCompressionAck(ZpqAlgorithm algorithm)
+{
+	StringInfoData buf;
+
+	pq_beginmessage(&buf, 'z');
+	pq_sendstring(&buf, zpq_algorithm_name(algorithm));
+	pq_endmessage(&buf);
+
+	if (pq_flush())
+		ereport(FATAL,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("could not send compression acknowledgement")));
+}
+
 /*
  * The client has sent a cancel request packet, not a normal
  * start-a-new-connection packet.  Perform the necessary processing.
@@ -2574,6 +2645,17 @@ ClosePostmasterPorts(bool am_syslogger)
 		}
 	}
 
+#ifndef EXEC_BACKEND
+
+	/*
+	 * Close our ends of the preforked backends' socket pairs, so that they
+	 * see the end of file when the postmaster closes them.
+	 */
+	for (i = 0; i < NumPreforkedBackends; i++)
+		closesocket(PreforkedBackends[i].sock);
+	NumPreforkedBackends = 0;
+#endif
+
 	/* If using syslogger, close the read side of the pipe */
 	if (!am_syslogger)
 	{
@@ -2630,6 +2712,13 @@ InitProcessGlobals(void)
 			((uint64) MyStartTimestamp >> 20);
 	}
 	srandom(rseed);
+
+	/*
+	 * Calibrate the cheap instrumentation clock.  This takes a few
+	 * milliseconds, but the result is cached, so it only happens in the
+	 * postmaster or a standalone backend; forked children inherit it.
+	 */
+	(void) pg_initialize_fast_clock();
 }
 
 
@@ -2683,8 +2772,6 @@ SIGHUP_handler(SIGNAL_ARGS)
 			signal_child(PgArchPID, SIGHUP);
 		if (SysLoggerPID != 0)
 			signal_child(SysLoggerPID, SIGHUP);
-		if (PgStatPID != 0)
-			signal_child(PgStatPID, SIGHUP);
 
 		/* Reload authentication config files too */
 		if (!load_hba())
@@ -2696,6 +2783,16 @@ SIGHUP_handler(SIGNAL_ARGS)
 			ereport(LOG,
 					(errmsg("%s was not reloaded", "pg_ident.conf")));
 
+#ifndef EXEC_BACKEND
+
+		/*
+		 * Preforked backends have the old configuration, including the old
+		 * authentication settings, which they'd use before getting a chance
+		 * to reload.  Replace them.
+		 */
+		RetirePreforkedBackends();
+#endif
+
 #ifdef USE_SSL
 		/* Reload SSL configuration as well */
 		if (EnableSSL)
@@ -2739,6 +2836,11 @@ pmdie(SIGNAL_ARGS)
 			(errmsg_internal("postmaster received signal %d",
 							 postgres_signal_arg)));
 
+#ifndef EXEC_BACKEND
+	/* idle preforked backends can go away right now */
+	RetirePreforkedBackends();
+#endif
+
 	switch (postgres_signal_arg)
 	{
 		case SIGTERM:
@@ -3015,9 +3117,7 @@ reaper(SIGNAL_ARGS)
 			if (!IsBinaryUpgrade && AutoVacuumingActive() && AutoVacPID == 0)
 				AutoVacPID = StartAutoVacLauncher();
 			if (PgArchStartupAllowed() && PgArchPID == 0)
-				PgArchPID = pgarch_start();
-			if (PgStatPID == 0)
-				PgStatPID = pgstat_start();
+				PgArchPID = StartArchiver();
 
 			/* workers may be scheduled to start now */
 			maybe_start_bgworkers();
@@ -3084,13 +3184,6 @@ reaper(SIGNAL_ARGS)
 				SignalChildren(SIGUSR2);
 
 				pmState = PM_SHUTDOWN_2;
-
-				/*
-				 * We can also shut down the stats collector now; there's
-				 * nothing left for it to do.
-				 */
-				if (PgStatPID != 0)
-					signal_child(PgStatPID, SIGQUIT);
 			}
 			else
 			{
@@ -3150,36 +3243,22 @@ reaper(SIGNAL_ARGS)
 		}
 
 		/*
-		 * Was it the archiver?  If so, just try to start a new one; no need
-		 * to force reset of the rest of the system.  (If fail, we'll try
-		 * again in future cycles of the main loop.).  Unless we were waiting
-		 * for it to shut down; don't restart it in that case, and
+		 * Was it the archiver?  If exit status is zero (normal) or one (FATAL
+		 * exit), we assume everything is all right just like normal backends
+		 * and just try to start a new one.  (If fail, we'll try again in
+		 * future cycles of the main loop.)  Unless we were waiting for it to
+		 * shut down; don't restart it in that case, and
 		 * PostmasterStateMachine() will advance to the next shutdown step.
+		 * Any other exit condition is treated as a crash.
 		 */
 		if (pid == PgArchPID)
 		{
 			PgArchPID = 0;
-			if (!EXIT_STATUS_0(exitstatus))
-				LogChildExit(LOG, _("archiver process"),
-							 pid, exitstatus);
+			if (!EXIT_STATUS_0(exitstatus) && !EXIT_STATUS_1(exitstatus))
+				HandleChildCrash(pid, exitstatus,
+								 _("archiver process"));
 			if (PgArchStartupAllowed())
-				PgArchPID = pgarch_start();
-			continue;
-		}
-
-		/*
-		 * Was it the statistics collector?  If so, just try to start a new
-		 * one; no need to force reset of the rest of the system.  (If fail,
-		 * we'll try again in future cycles of the main loop.)
-		 */
-		if (pid == PgStatPID)
-		{
-			PgStatPID = 0;
-			if (!EXIT_STATUS_0(exitstatus))
-				LogChildExit(LOG, _("statistics collector process"),
-							 pid, exitstatus);
-			if (pmState == PM_RUN || pmState == PM_HOT_STANDBY)
-				PgStatPID = pgstat_start();
+				PgArchPID = StartArchiver();
 			continue;
 		}
 
@@ -3361,6 +3440,10 @@ CleanupBackend(int pid,
 	}
 #endif
 
+#ifndef EXEC_BACKEND
+	ForgetPreforkedBackend(pid);
+#endif
+
 	if (!EXIT_STATUS_0(exitstatus) && !EXIT_STATUS_1(exitstatus))
 	{
 		HandleChildCrash(pid, exitstatus, _("server process"));
@@ -3438,6 +3521,15 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 				(errmsg("terminating any other active server processes")));
 	}
 
+#ifndef EXEC_BACKEND
+
+	/*
+	 * Idle preforked backends don't react to signals, but exit once their
+	 * socket pair is closed.
+	 */
+	RetirePreforkedBackends();
+#endif
+
 	/* Process background workers. */
 	slist_foreach(siter, &BackgroundWorkerList)
 	{
@@ -3614,35 +3706,16 @@ HandleChildCrash(int pid, int exitstatus, const char *procname)
 		signal_child(AutoVacPID, (SendStop ? SIGSTOP : SIGQUIT));
 	}
 
-	/*
-	 * Force a power-cycle of the pgarch process too.  (This isn't absolutely
-	 * necessary, but it seems like a good idea for robustness, and it
-	 * simplifies the state-machine logic in the case where a shutdown request
-	 * arrives during crash processing.)
-	 */
-	if (PgArchPID != 0 && take_action)
+	/* Take care of the archiver too */
+	if (pid == PgArchPID)
+		PgArchPID = 0;
+	else if (PgArchPID != 0 && take_action)
 	{
 		ereport(DEBUG2,
 				(errmsg_internal("sending %s to process %d",
-								 "SIGQUIT",
+								 (SendStop ? "SIGSTOP" : "SIGQUIT"),
 								 (int) PgArchPID)));
-		signal_child(PgArchPID, SIGQUIT);
-	}
-
-	/*
-	 * Force a power-cycle of the pgstat process too.  (This isn't absolutely
-	 * necessary, but it seems like a good idea for robustness, and it
-	 * simplifies the state-machine logic in the case where a shutdown request
-	 * arrives during crash processing.)
-	 */
-	if (PgStatPID != 0 && take_action)
-	{
-		ereport(DEBUG2,
-				(errmsg_internal("sending %s to process %d",
-								 "SIGQUIT",
-								 (int) PgStatPID)));
-		signal_child(PgStatPID, SIGQUIT);
-		allow_immediate_pgstat_restart();
+		signal_child(PgArchPID, (SendStop ? SIGSTOP : SIGQUIT));
 	}
 
 	/* We do NOT restart the syslogger */
@@ -3836,12 +3909,10 @@ PostmasterStateMachine(void)
 					FatalError = true;
 					pmState = PM_WAIT_DEAD_END;
 
-					/* Kill the walsenders, archiver and stats collector too */
+					/* Kill the walsenders and archiver too */
 					SignalChildren(SIGQUIT);
 					if (PgArchPID != 0)
 						signal_child(PgArchPID, SIGQUIT);
-					if (PgStatPID != 0)
-						signal_child(PgStatPID, SIGQUIT);
 				}
 			}
 		}
@@ -3865,19 +3936,17 @@ PostmasterStateMachine(void)
 	{
 		/*
 		 * PM_WAIT_DEAD_END state ends when the BackendList is entirely empty
-		 * (ie, no dead_end children remain), and the archiver and stats
-		 * collector are gone too.
+		 * (ie, no dead_end children remain), and the archiver is gone too.
 		 *
-		 * The reason we wait for those two is to protect them against a new
-		 * postmaster starting conflicting subprocesses; this isn't an
-		 * ironclad protection, but it at least helps in the
-		 * shutdown-and-immediately-restart scenario.  Note that they have
-		 * already been sent appropriate shutdown signals, either during a
-		 * normal state transition leading up to PM_WAIT_DEAD_END, or during
-		 * FatalError processing.
+		 * The reason we wait for the archiver is that it is attached to
+		 * shared memory, and to protect it against a new postmaster starting
+		 * a conflicting archiver; this isn't an ironclad protection, but it
+		 * at least helps in the shutdown-and-immediately-restart scenario.
+		 * Note that it has already been sent an appropriate shutdown signal,
+		 * either during a normal state transition leading up to
+		 * PM_WAIT_DEAD_END, or during FatalError processing.
 		 */
-		if (dlist_is_empty(&BackendList) &&
-			PgArchPID == 0 && PgStatPID == 0)
+		if (dlist_is_empty(&BackendList) && PgArchPID == 0)
 		{
 			/* These other guys should be dead already */
 			Assert(StartupPID == 0);
@@ -4077,8 +4146,6 @@ TerminateChildren(int signal)
 		signal_child(AutoVacPID, signal);
 	if (PgArchPID != 0)
 		signal_child(PgArchPID, signal);
-	if (PgStatPID != 0)
-		signal_child(PgStatPID, signal);
 }
 
 /*
@@ -4094,6 +4161,16 @@ BackendStartup(Port *port)
 	Backend    *bn;				/* for backend cleanup */
 	pid_t		pid;
 
+#ifndef EXEC_BACKEND
+	/* Use an idle preforked backend if there is one */
+	if (NumPreforkedBackends > 0 && canAcceptConnections() == CAC_OK)
+	{
+		port->canAcceptConnections = CAC_OK;
+		if (HandOffToPreforkedBackend(port))
+			return STATUS_OK;
+	}
+#endif
+
 	/*
 	 * Create backend data structure.  Better before the fork() so we can
 	 * handle failure cleanly.
@@ -4197,6 +4274,321 @@ BackendStartup(Port *port)
 	return STATUS_OK;
 }
 
+#ifndef EXEC_BACKEND
+
+/*
+ * MaybeStartPreforkedBackends -- top up the pool of preforked backends
+ *
+ * With preforked_backends set, we keep that many backends forked ahead of
+ * connection requests, so that BackendStartup() can hand a new connection
+ * to one of them instead of forking then.  They still authenticate the
+ * client and attach to a database the usual way, but the fork() and the
+ * detangling from the postmaster are done by the time a client connects.
+ */
+static void
+MaybeStartPreforkedBackends(void)
+{
+	while (NumPreforkedBackends < preforked_backends &&
+		   canAcceptConnections() == CAC_OK)
+	{
+		if (!StartPreforkedBackend())
+			break;
+	}
+}
+
+/*
+ * StartPreforkedBackend -- fork a backend that waits for a connection
+ *
+ * Returns false if that failed.
+ */
+static bool
+StartPreforkedBackend(void)
+{
+	Backend    *bn;
+	pgsocket	fds[2];
+	pid_t		pid;
+
+	if (PreforkedBackends == NULL)
+	{
+		PreforkedBackends = (PreforkedBackend *)
+			malloc(preforked_backends * sizeof(PreforkedBackend));
+		if (!PreforkedBackends)
+		{
+			ereport(LOG,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("out of memory")));
+			return false;
+		}
+	}
+
+	bn = (Backend *) malloc(sizeof(Backend));
+	if (!bn)
+	{
+		ereport(LOG,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+		return false;
+	}
+
+	/* as in BackendStartup() */
+	if (!RandomCancelKey(&MyCancelKey))
+	{
+		free(bn);
+		ereport(LOG,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("could not generate random cancel key")));
+		return false;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+	{
+		free(bn);
+		ereport(LOG,
+				(errcode_for_socket_access(),
+				 errmsg("could not create socket pair for preforked backend: %m")));
+		return false;
+	}
+
+	bn->cancel_key = MyCancelKey;
+	bn->dead_end = false;
+	bn->child_slot = MyPMChildSlot = AssignPostmasterChildSlot();
+	bn->bgworker_notify = false;
+
+	pid = fork_process();
+	if (pid == 0)				/* child */
+	{
+		Port	   *port;
+
+		free(bn);
+		closesocket(fds[0]);
+
+		/* Detangle from postmaster */
+		InitPostmasterChild();
+
+		/* Close the postmaster's sockets */
+		ClosePostmasterPorts(false);
+
+		/* Wait for a client connection, then carry on like BackendStartup() */
+		port = ReceivePreforkedConnection(fds[1]);
+
+		BackendInitialize(port);
+		BackendRun(port);
+	}
+
+	closesocket(fds[1]);
+
+	if (pid < 0)
+	{
+		/* in parent, fork failed */
+		int			save_errno = errno;
+
+		closesocket(fds[0]);
+		(void) ReleasePostmasterChildSlot(bn->child_slot);
+		free(bn);
+		errno = save_errno;
+		ereport(LOG,
+				(errmsg("could not fork preforked backend: %m")));
+		return false;
+	}
+
+	ereport(DEBUG2,
+			(errmsg_internal("forked preforked backend, pid=%d", (int) pid)));
+
+	bn->pid = pid;
+	bn->bkend_type = BACKEND_TYPE_NORMAL;	/* Can change later to WALSND */
+	dlist_push_head(&BackendList, &bn->elem);
+
+	PreforkedBackends[NumPreforkedBackends].bn = bn;
+	PreforkedBackends[NumPreforkedBackends].sock = fds[0];
+	NumPreforkedBackends++;
+
+	return true;
+}
+
+/*
+ * ReceivePreforkedConnection -- wait for the postmaster to pass us a client
+ *
+ * Runs in a preforked backend, with signals still blocked as in the
+ * postmaster.  If the postmaster closes its end of the socket pair instead,
+ * we're not needed anymore and exit.
+ */
+static Port *
+ReceivePreforkedConnection(pgsocket sock)
+{
+	Port	   *port;
+	pgsocket	client = PGINVALID_SOCKET;
+	size_t		done = 0;
+
+	if (!(port = (Port *) calloc(1, sizeof(Port))))
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+
+	while (done < sizeof(Port))
+	{
+		struct msghdr msg;
+		struct iovec iov;
+		union
+		{
+			struct cmsghdr hdr;
+			char		buf[CMSG_SPACE(sizeof(pgsocket))];
+		}			ctl;
+		struct cmsghdr *cmsg;
+		ssize_t		rc;
+
+		iov.iov_base = (char *) port + done;
+		iov.iov_len = sizeof(Port) - done;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctl.buf;
+		msg.msg_controllen = sizeof(ctl.buf);
+
+		rc = recvmsg(sock, &msg, 0);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ereport(FATAL,
+					(errcode_for_socket_access(),
+					 errmsg("could not receive connection from postmaster: %m")));
+		}
+		if (rc == 0)
+			proc_exit(0);
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+			 cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+				cmsg->cmsg_type == SCM_RIGHTS)
+				memcpy(&client, CMSG_DATA(cmsg), sizeof(pgsocket));
+		}
+
+		done += rc;
+	}
+
+	closesocket(sock);
+
+	if (client == PGINVALID_SOCKET)
+		ereport(FATAL,
+				(errmsg("postmaster did not pass a connection socket")));
+
+	/*
+	 * The Port is the postmaster's, as set up by ConnCreate(); only plain
+	 * fields are filled in at that point, except for the GSSAPI state.
+	 */
+	port->sock = client;
+#if defined(ENABLE_GSS) || defined(ENABLE_SSPI)
+	port->gss = (pg_gssinfo *) calloc(1, sizeof(pg_gssinfo));
+	if (!port->gss)
+		ereport(FATAL,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+#endif
+
+	/* our session starts now, not when we were forked */
+	MyStartTimestamp = GetCurrentTimestamp();
+	MyStartTime = timestamptz_to_time_t(MyStartTimestamp);
+
+	return port;
+}
+
+/*
+ * HandOffToPreforkedBackend -- pass a new connection to a preforked backend
+ *
+ * Returns false if there's no preforked backend that could take it, in
+ * which case the caller forks a backend for it as usual.  The backend gets
+ * a duplicate of the socket, so the caller closes its copy either way.
+ */
+static bool
+HandOffToPreforkedBackend(Port *port)
+{
+	while (NumPreforkedBackends > 0)
+	{
+		PreforkedBackend *pb = &PreforkedBackends[--NumPreforkedBackends];
+		struct msghdr msg;
+		struct iovec iov;
+		union
+		{
+			struct cmsghdr hdr;
+			char		buf[CMSG_SPACE(sizeof(pgsocket))];
+		}			ctl;
+		struct cmsghdr *cmsg;
+		ssize_t		rc;
+
+		iov.iov_base = (char *) port;
+		iov.iov_len = sizeof(Port);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctl.buf;
+		msg.msg_controllen = sizeof(ctl.buf);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(pgsocket));
+		memcpy(CMSG_DATA(cmsg), &port->sock, sizeof(pgsocket));
+
+		rc = sendmsg(pb->sock, &msg, 0);
+
+		/*
+		 * Either way, we're done with this backend's socket pair.  If the
+		 * whole message didn't make it, the backend will exit when it sees
+		 * the end of file, and we try the next one.
+		 */
+		closesocket(pb->sock);
+
+		if (rc == sizeof(Port))
+		{
+			ereport(DEBUG2,
+					(errmsg_internal("passed connection to preforked backend, pid=%d socket=%d",
+									 (int) pb->bn->pid, (int) port->sock)));
+			return true;
+		}
+
+		if (rc < 0)
+			ereport(LOG,
+					(errcode_for_socket_access(),
+					 errmsg("could not pass connection to preforked backend: %m")));
+	}
+
+	return false;
+}
+
+/*
+ * ForgetPreforkedBackend -- a preforked backend exited before it was used
+ */
+static void
+ForgetPreforkedBackend(pid_t pid)
+{
+	int			i;
+
+	for (i = 0; i < NumPreforkedBackends; i++)
+	{
+		if (PreforkedBackends[i].bn->pid == pid)
+		{
+			closesocket(PreforkedBackends[i].sock);
+			PreforkedBackends[i] = PreforkedBackends[--NumPreforkedBackends];
+			break;
+		}
+	}
+}
+
+/*
+ * RetirePreforkedBackends -- make all idle preforked backends exit
+ *
+ * Closing our ends of their socket pairs is enough; they get reaped like
+ * any other backend.
+ */
+static void
+RetirePreforkedBackends(void)
+{
+	while (NumPreforkedBackends > 0)
+		closesocket(PreforkedBackends[--NumPreforkedBackends].sock);
+}
+#endif							/* !EXEC_BACKEND */
+
 /*
  * Try to report backend fork() failure to client before we close the
  * connection.  Since we do not care to risk blocking the postmaster on
@@ -5051,18 +5443,6 @@ SubPostmasterMain(int argc, char *argv[])
 
 		StartBackgroundWorker();
 	}
-	if (strcmp(argv[1], "--forkarch") == 0)
-	{
-		/* Do not want to attach to shared memory */
-
-		PgArchiverMain(argc, argv); /* does not return */
-	}
-	if (strcmp(argv[1], "--forkcol") == 0)
-	{
-		/* Do not want to attach to shared memory */
-
-		PgstatCollectorMain(argc, argv);	/* does not return */
-	}
 	if (strcmp(argv[1], "--forklog") == 0)
 	{
 		/* Do not want to attach to shared memory */
@@ -5155,7 +5535,7 @@ sigusr1_handler(SIGNAL_ARGS)
 		 */
 		Assert(PgArchPID == 0);
 		if (XLogArchivingAlways())
-			PgArchPID = pgarch_start();
+			PgArchPID = StartArchiver();
 
 		/*
 		 * If we aren't planning to enter hot standby mode later, treat
@@ -5175,12 +5555,6 @@ sigusr1_handler(SIGNAL_ARGS)
 	if (CheckPostmasterSignal(PMSIGNAL_BEGIN_HOT_STANDBY) &&
 		pmState == PM_RECOVERY && Shutdown == NoShutdown)
 	{
-		/*
-		 * Likewise, start other special children as needed.
-		 */
-		Assert(PgStatPID == 0);
-		PgStatPID = pgstat_start();
-
 		ereport(LOG,
 				(errmsg("database system is ready to accept read only connections")));
 
@@ -5454,6 +5828,10 @@ StartChildProcess(AuxProcType type)
 				ereport(LOG,
 						(errmsg("could not fork WAL receiver process: %m")));
 				break;
+			case ArchiverProcess:
+				ereport(LOG,
+						(errmsg("could not fork archiver process: %m")));
+				break;
 			default:
 				ereport(LOG,
 						(errmsg("could not fork process: %m")));
@@ -6065,7 +6443,6 @@ extern slock_t *ShmemLock;
 extern slock_t *ProcStructLock;
 extern PGPROC *AuxiliaryProcs;
 extern PMSignalData *PMSignalState;
-extern pgsocket pgStatSock;
 extern pg_time_t first_syslogger_file_time;
 
 #ifndef WIN32
@@ -6121,8 +6498,6 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->AuxiliaryProcs = AuxiliaryProcs;
 	param->PreparedXactProcs = PreparedXactProcs;
 	param->PMSignalState = PMSignalState;
-	if (!write_inheritable_socket(&param->pgStatSock, pgStatSock, childPid))
-		return false;
 
 	param->PostmasterPid = PostmasterPid;
 	param->PgStartTime = PgStartTime;
@@ -6357,7 +6732,6 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	AuxiliaryProcs = param->AuxiliaryProcs;
 	PreparedXactProcs = param->PreparedXactProcs;
 	PMSignalState = param->PMSignalState;
-	read_inheritable_socket(&pgStatSock, &param->pgStatSock);
 
 	PostmasterPid = param->PostmasterPid;
 	PgStartTime = param->PgStartTime;
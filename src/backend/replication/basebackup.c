@@ -38,6 +38,7 @@
 #include "storage/ipc.h"
 #include "storage/reinit.h"
 #include "utils/builtins.h"
+#include "utils/hashutils.h"
 #include "utils/ps_status.h"
 #include "utils/relcache.h"
 #include "utils/timestamp.h"
@@ -52,6 +53,10 @@ typedef struct
 	bool		includewal;
 	uint32		maxrate;
 	bool		sendtblspcmapfile;
+	XLogRecPtr	incremental_lsn;
+	int			parallel;
+	int			part;
+	int			leader;
 } basebackup_options;
 
 
@@ -59,6 +64,8 @@ static int64 sendDir(const char *path, int basepathlen, bool sizeonly,
 					 List *tablespaces, bool sendtblspclinks);
 static bool sendFile(const char *readfilename, const char *tarfilename,
 					 struct stat *statbuf, bool missing_ok, Oid dboid);
+static bool sendIncrementalFile(const char *readfilename,
+								const char *tarfilename, struct stat *statbuf);
 static void sendFileWithContent(const char *filename, const char *content);
 static int64 _tarWriteHeader(const char *filename, const char *linktarget,
 							 struct stat *statbuf, bool sizeonly);
@@ -68,18 +75,21 @@ static void send_int8_string(StringInfoData *buf, int64 intval);
 static void SendBackupHeader(List *tablespaces);
 static void base_backup_cleanup(int code, Datum arg);
 static void perform_base_backup(basebackup_options *opt);
+static void perform_backup_part(basebackup_options *opt);
+static List *collect_tablespaces(void);
+static void wait_for_backup_parts(void);
+static void setup_throttling(uint32 maxrate);
+static void report_checksum_failures(void);
 static void parse_basebackup_options(List *options, basebackup_options *opt);
 static void SendXlogRecPtrResult(XLogRecPtr ptr, TimeLineID tli);
 static int	compareWalFileNames(const void *a, const void *b);
 static void throttle(size_t increment);
 static bool is_checksummed_file(const char *fullpath, const char *filename);
+static bool file_in_backup_part(const char *tarfilename);
 
 /* Was the backup currently in-progress initiated in recovery mode? */
 static bool backup_started_in_recovery = false;
 
-/* Relative path of temporary statistics directory */
-static char *statrelpath = NULL;
-
 /*
  * Size of each block sent into the tar stream for larger files.
  */
@@ -123,6 +133,19 @@ static int64 total_checksum_failures;
 /* Do not verify checksums. */
 static bool noverify_checksums = false;
 
+/* Send only blocks changed since this LSN, if valid. */
+static XLogRecPtr incremental_lsn = InvalidXLogRecPtr;
+
+/*
+ * A parallel base backup is split into backup_nparts parts, each sent over
+ * its own connection.  The files are divided among the parts by a hash of
+ * their names.  Part 0 is sent by the leader, which also sends all the
+ * directories and symbolic links, and pg_control once the other parts have
+ * been sent.
+ */
+static int	backup_nparts = 1;
+static int	backup_part = 0;
+
 /*
  * The contents of these directories are removed or recreated during server
  * start so they are not included in backups.  The directories themselves are
@@ -134,9 +157,8 @@ static bool noverify_checksums = false;
 static const char *excludeDirContents[] =
 {
 	/*
-	 * Skip temporary statistics files. PG_STAT_TMP_DIR must be skipped even
-	 * when stats_temp_directory is set because PGSS_TEXT_FILE is always
-	 * created there.
+	 * Skip temporary statistics files.  PGSS_TEXT_FILE is created in
+	 * PG_STAT_TMP_DIR.
 	 */
 	PG_STAT_TMP_DIR,
 
@@ -225,6 +247,10 @@ static const char *const noChecksumFiles[] = {
 static void
 base_backup_cleanup(int code, Datum arg)
 {
+	SpinLockAcquire(&MyWalSnd->mutex);
+	MyWalSnd->backupStartPtr = InvalidXLogRecPtr;
+	SpinLockRelease(&MyWalSnd->mutex);
+
 	do_pg_abort_backup();
 }
 
@@ -242,11 +268,8 @@ perform_base_backup(basebackup_options *opt)
 	TimeLineID	endtli;
 	StringInfo	labelfile;
 	StringInfo	tblspc_map_file = NULL;
-	int			datadirpathlen;
 	List	   *tablespaces = NIL;
 
-	datadirpathlen = strlen(DataDir);
-
 	backup_started_in_recovery = RecoveryInProgress();
 
 	labelfile = makeStringInfo();
@@ -271,19 +294,40 @@ perform_base_backup(basebackup_options *opt)
 		ListCell   *lc;
 		tablespaceinfo *ti;
 
-		SendXlogRecPtrResult(startptr, starttli);
-
 		/*
-		 * Calculate the relative path of temporary statistics directory in
-		 * order to skip the files which are located in that directory later.
+		 * An incremental backup must start from a point no later than this
+		 * backup, or changes in between would be missed.  Record the point
+		 * in the backup label, so that it can be checked against the prior
+		 * backup when the two are combined.
 		 */
-		if (is_absolute_path(pgstat_stat_directory) &&
-			strncmp(pgstat_stat_directory, DataDir, datadirpathlen) == 0)
-			statrelpath = psprintf("./%s", pgstat_stat_directory + datadirpathlen + 1);
-		else if (strncmp(pgstat_stat_directory, "./", 2) != 0)
-			statrelpath = psprintf("./%s", pgstat_stat_directory);
-		else
-			statrelpath = pgstat_stat_directory;
+		if (!XLogRecPtrIsInvalid(opt->incremental_lsn))
+		{
+			if (opt->incremental_lsn > startptr)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("incremental backup start location %X/%X is later than the current backup start location %X/%X",
+								(uint32) (opt->incremental_lsn >> 32),
+								(uint32) opt->incremental_lsn,
+								(uint32) (startptr >> 32), (uint32) startptr)));
+			appendStringInfo(labelfile, "INCREMENTAL FROM LSN: %X/%X\n",
+							 (uint32) (opt->incremental_lsn >> 32),
+							 (uint32) opt->incremental_lsn);
+		}
+		incremental_lsn = opt->incremental_lsn;
+
+		/* Let the other parts of a parallel backup join in */
+		backup_nparts = opt->parallel;
+		backup_part = 0;
+		if (backup_nparts > 1)
+		{
+			SpinLockAcquire(&MyWalSnd->mutex);
+			MyWalSnd->backupStartPtr = startptr;
+			MyWalSnd->backupParts = backup_nparts;
+			MyWalSnd->backupPartsDone = 0;
+			SpinLockRelease(&MyWalSnd->mutex);
+		}
+
+		SendXlogRecPtrResult(startptr, starttli);
 
 		/* Add a node for the base directory at the end */
 		ti = palloc0(sizeof(tablespaceinfo));
@@ -294,28 +338,7 @@ perform_base_backup(basebackup_options *opt)
 		SendBackupHeader(tablespaces);
 
 		/* Setup and activate network throttling, if client requested it */
-		if (opt->maxrate > 0)
-		{
-			throttling_sample =
-				(int64) opt->maxrate * (int64) 1024 / THROTTLING_FREQUENCY;
-
-			/*
-			 * The minimum amount of time for throttling_sample bytes to be
-			 * transferred.
-			 */
-			elapsed_min_unit = USECS_PER_SEC / THROTTLING_FREQUENCY;
-
-			/* Enable throttling. */
-			throttling_counter = 0;
-
-			/* The 'real data' starts now (header was ignored). */
-			throttled_last = GetCurrentTimestamp();
-		}
-		else
-		{
-			/* Disable throttling. */
-			throttling_counter = -1;
-		}
+		setup_throttling(opt->maxrate);
 
 		/* Send off our tablespaces one by one */
 		foreach(lc, tablespaces)
@@ -349,6 +372,8 @@ perform_base_backup(basebackup_options *opt)
 					sendDir(".", 1, false, tablespaces, true);
 
 				/* ... and pg_control after everything else. */
+				if (backup_nparts > 1)
+					wait_for_backup_parts();
 				if (lstat(XLOG_CONTROL_FILE, &statbuf) != 0)
 					ereport(ERROR,
 							(errcode_for_file_access(),
@@ -373,6 +398,10 @@ perform_base_backup(basebackup_options *opt)
 				pq_putemptymessage('c');	/* CopyDone */
 		}
 
+		SpinLockAcquire(&MyWalSnd->mutex);
+		MyWalSnd->backupStartPtr = InvalidXLogRecPtr;
+		SpinLockRelease(&MyWalSnd->mutex);
+
 		endptr = do_pg_stop_backup(labelfile->data, !opt->nowait, &endtli);
 	}
 	PG_END_ENSURE_ERROR_CLEANUP(base_backup_cleanup, (Datum) 0);
@@ -618,6 +647,246 @@ perform_base_backup(basebackup_options *opt)
 	}
 	SendXlogRecPtrResult(endptr, endtli);
 
+	report_checksum_failures();
+}
+
+/*
+ * Send one of the other parts of a parallel base backup, as requested by the
+ * "PART" option.
+ *
+ * The backup itself is started and stopped by the leader, whose process ID
+ * is given by the "LEADER" option; we only send our share of the files, in
+ * one tar stream per tablespace like the leader.  Once they are all sent, we
+ * tell the leader, which waits for that before it sends pg_control and stops
+ * the backup.
+ */
+static void
+perform_backup_part(basebackup_options *opt)
+{
+	WalSnd	   *leader = NULL;
+	Latch	   *latch = NULL;
+	List	   *tablespaces;
+	ListCell   *lc;
+	tablespaceinfo *ti;
+	int			i;
+
+	/* Find the leader, and the start location of its backup */
+	for (i = 0; i < max_wal_senders && leader == NULL; i++)
+	{
+		WalSnd	   *walsnd = &WalSndCtl->walsnds[i];
+
+		SpinLockAcquire(&walsnd->mutex);
+		if (walsnd->pid == opt->leader &&
+			!XLogRecPtrIsInvalid(walsnd->backupStartPtr) &&
+			walsnd->backupParts == opt->parallel)
+		{
+			leader = walsnd;
+			startptr = walsnd->backupStartPtr;
+		}
+		SpinLockRelease(&walsnd->mutex);
+	}
+	if (leader == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("process %d is not running a base backup in %d parts",
+						opt->leader, opt->parallel)));
+
+	backup_started_in_recovery = RecoveryInProgress();
+	total_checksum_failures = 0;
+	incremental_lsn = opt->incremental_lsn;
+	backup_nparts = opt->parallel;
+	backup_part = opt->part;
+
+	/* Add a node for the base directory at the end, as the leader does */
+	tablespaces = collect_tablespaces();
+	ti = palloc0(sizeof(tablespaceinfo));
+	ti->size = -1;
+	tablespaces = lappend(tablespaces, ti);
+
+	SendBackupHeader(tablespaces);
+
+	setup_throttling(opt->maxrate);
+
+	foreach(lc, tablespaces)
+	{
+		StringInfoData buf;
+
+		ti = (tablespaceinfo *) lfirst(lc);
+
+		/* Send CopyOutResponse message */
+		pq_beginmessage(&buf, 'H');
+		pq_sendbyte(&buf, 0);	/* overall format */
+		pq_sendint16(&buf, 0);	/* natts */
+		pq_endmessage(&buf);
+
+		if (ti->path == NULL)
+			sendDir(".", 1, false, tablespaces, true);
+		else
+			sendTablespace(ti->path, false);
+
+		pq_putemptymessage('c');	/* CopyDone */
+	}
+
+	/*
+	 * Tell the leader that our part is complete.  Any checksum failures are
+	 * reported to our client afterwards, so that the leader can still finish
+	 * the backup.
+	 */
+	SpinLockAcquire(&leader->mutex);
+	if (leader->pid == opt->leader && leader->backupStartPtr == startptr)
+	{
+		leader->backupPartsDone++;
+		latch = leader->latch;
+	}
+	SpinLockRelease(&leader->mutex);
+
+	if (latch == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("base backup ended before all of its parts were sent")));
+	SetLatch(latch);
+
+	report_checksum_failures();
+}
+
+/*
+ * Wait until the other parts of a parallel base backup have been sent.
+ *
+ * The client sends nothing while it receives the backup, so anything
+ * arriving on the connection means that it has gone away; the other parts
+ * would then never complete.
+ */
+static void
+wait_for_backup_parts(void)
+{
+	for (;;)
+	{
+		int			done;
+		int			rc;
+
+		SpinLockAcquire(&MyWalSnd->mutex);
+		done = MyWalSnd->backupPartsDone;
+		SpinLockRelease(&MyWalSnd->mutex);
+
+		if (done >= backup_nparts - 1)
+			break;
+
+		rc = WaitLatchOrSocket(MyLatch,
+							   WL_LATCH_SET | WL_SOCKET_READABLE |
+							   WL_EXIT_ON_PM_DEATH,
+							   MyProcPort->sock, -1L,
+							   WAIT_EVENT_BASEBACKUP_PARTS);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (rc & WL_SOCKET_READABLE)
+			ereport(ERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("unexpected data or end of file from client during parallel base backup")));
+	}
+}
+
+/*
+ * Build the list of tablespaces for a part of a parallel base backup, in the
+ * same way as do_pg_start_backup() does for the leader.
+ */
+static List *
+collect_tablespaces(void)
+{
+	List	   *tablespaces = NIL;
+	int			datadirpathlen = strlen(DataDir);
+	DIR		   *tblspcdir;
+	struct dirent *de;
+
+	tblspcdir = AllocateDir("pg_tblspc");
+	while ((de = ReadDir(tblspcdir, "pg_tblspc")) != NULL)
+	{
+#if defined(HAVE_READLINK) || defined(WIN32)
+		char		fullpath[MAXPGPATH + 10];
+		char		linkpath[MAXPGPATH];
+		int			rllen;
+		tablespaceinfo *ti;
+
+		/* Skip special stuff */
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+
+		snprintf(fullpath, sizeof(fullpath), "pg_tblspc/%s", de->d_name);
+
+		rllen = readlink(fullpath, linkpath, sizeof(linkpath));
+		if (rllen < 0)
+		{
+			ereport(WARNING,
+					(errmsg("could not read symbolic link \"%s\": %m",
+							fullpath)));
+			continue;
+		}
+		else if (rllen >= sizeof(linkpath))
+		{
+			ereport(WARNING,
+					(errmsg("symbolic link \"%s\" target is too long",
+							fullpath)));
+			continue;
+		}
+		linkpath[rllen] = '\0';
+
+		ti = palloc(sizeof(tablespaceinfo));
+		ti->oid = pstrdup(de->d_name);
+		ti->path = pstrdup(linkpath);
+		if (rllen > datadirpathlen &&
+			strncmp(linkpath, DataDir, datadirpathlen) == 0 &&
+			IS_DIR_SEP(linkpath[datadirpathlen]))
+			ti->rpath = pstrdup(linkpath + datadirpathlen + 1);
+		else
+			ti->rpath = NULL;
+		ti->size = -1;
+
+		tablespaces = lappend(tablespaces, ti);
+#endif
+	}
+	FreeDir(tblspcdir);
+
+	return tablespaces;
+}
+
+/*
+ * Setup and activate network throttling at maxrate kilobytes per second,
+ * or disable it if maxrate is 0.
+ */
+static void
+setup_throttling(uint32 maxrate)
+{
+	if (maxrate > 0)
+	{
+		throttling_sample =
+			(int64) maxrate * (int64) 1024 / THROTTLING_FREQUENCY;
+
+		/*
+		 * The minimum amount of time for throttling_sample bytes to be
+		 * transferred.
+		 */
+		elapsed_min_unit = USECS_PER_SEC / THROTTLING_FREQUENCY;
+
+		/* Enable throttling. */
+		throttling_counter = 0;
+
+		/* The 'real data' starts now (header was ignored). */
+		throttled_last = GetCurrentTimestamp();
+	}
+	else
+	{
+		/* Disable throttling. */
+		throttling_counter = -1;
+	}
+}
+
+/*
+ * Fail the backup if any page checksums failed to verify.
+ */
+static void
+report_checksum_failures(void)
+{
 	if (total_checksum_failures)
 	{
 		if (total_checksum_failures > 1)
@@ -633,7 +902,6 @@ perform_base_backup(basebackup_options *opt)
 				(errcode(ERRCODE_DATA_CORRUPTED),
 				 errmsg("checksum verification failure during base backup")));
 	}
-
 }
 
 /*
@@ -664,6 +932,10 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 	bool		o_maxrate = false;
 	bool		o_tablespace_map = false;
 	bool		o_noverify_checksums = false;
+	bool		o_incremental = false;
+	bool		o_parallel = false;
+	bool		o_part = false;
+	bool		o_leader = false;
 
 	MemSet(opt, 0, sizeof(*opt));
 	foreach(lopt, options)
@@ -752,12 +1024,73 @@ parse_basebackup_options(List *options, basebackup_options *opt)
 			noverify_checksums = true;
 			o_noverify_checksums = true;
 		}
+		else if (strcmp(defel->defname, "incremental") == 0)
+		{
+			uint32		hi,
+						lo;
+
+			if (o_incremental)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			if (sscanf(strVal(defel->arg), "%X/%X", &hi, &lo) != 2)
+				elog(ERROR, "invalid incremental backup start location \"%s\"",
+					 strVal(defel->arg));
+			opt->incremental_lsn = ((uint64) hi) << 32 | lo;
+			o_incremental = true;
+		}
+		else if (strcmp(defel->defname, "parallel") == 0)
+		{
+			if (o_parallel)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->parallel = intVal(defel->arg);
+			if (opt->parallel < 1 || opt->parallel > max_wal_senders)
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("%d is outside the valid range for parameter \"%s\" (%d .. %d)",
+								opt->parallel, "PARALLEL", 1, max_wal_senders)));
+			o_parallel = true;
+		}
+		else if (strcmp(defel->defname, "part") == 0)
+		{
+			if (o_part)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->part = intVal(defel->arg);
+			o_part = true;
+		}
+		else if (strcmp(defel->defname, "leader") == 0)
+		{
+			if (o_leader)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("duplicate option \"%s\"", defel->defname)));
+			opt->leader = intVal(defel->arg);
+			o_leader = true;
+		}
 		else
 			elog(ERROR, "option \"%s\" not recognized",
 				 defel->defname);
 	}
 	if (opt->label == NULL)
 		opt->label = "base backup";
+	if (!o_parallel)
+		opt->parallel = 1;
+
+	/* The other parts of a parallel backup name its leader */
+	if (o_part != o_leader)
+		ereport(ERROR,
+				(errcode(ERRCODE_SYNTAX_ERROR),
+				 errmsg("options \"%s\" and \"%s\" must be given together",
+						"PART", "LEADER")));
+	if (o_part && (opt->part < 1 || opt->part >= opt->parallel))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("%d is outside the valid range for parameter \"%s\" (%d .. %d)",
+						opt->part, "PART", 1, opt->parallel - 1)));
 }
 
 
@@ -781,12 +1114,19 @@ SendBaseBackup(BaseBackupCmd *cmd)
 	{
 		char		activitymsg[50];
 
-		snprintf(activitymsg, sizeof(activitymsg), "sending backup \"%s\"",
-				 opt.label);
+		if (opt.part > 0)
+			snprintf(activitymsg, sizeof(activitymsg),
+					 "sending part %d of backup", opt.part);
+		else
+			snprintf(activitymsg, sizeof(activitymsg), "sending backup \"%s\"",
+					 opt.label);
 		set_ps_display(activitymsg, false);
 	}
 
-	perform_base_backup(&opt);
+	if (opt.part > 0)
+		perform_backup_part(&opt);
+	else
+		perform_base_backup(&opt);
 }
 
 static void
@@ -1195,17 +1535,6 @@ sendDir(const char *path, int basepathlen, bool sizeonly, List *tablespaces,
 		if (excludeFound)
 			continue;
 
-		/*
-		 * Exclude contents of directory specified by statrelpath if not set
-		 * to the default (pg_stat_tmp) which is caught in the loop above.
-		 */
-		if (statrelpath != NULL && strcmp(pathbuf, statrelpath) == 0)
-		{
-			elog(DEBUG1, "contents of directory \"%s\" excluded from backup", statrelpath);
-			size += _tarWriteDir(pathbuf, basepathlen, &statbuf, sizeonly);
-			continue;
-		}
-
 		/*
 		 * We can skip pg_wal, the WAL segments need to be fetched from the
 		 * WAL archive anyway. But include it as an empty directory anyway, so
@@ -1314,9 +1643,31 @@ sendDir(const char *path, int basepathlen, bool sizeonly, List *tablespaces,
 		{
 			bool		sent = false;
 
+			/* Leave files in other parts of a parallel backup to them */
+			if (!sizeonly && !file_in_backup_part(pathbuf + basepathlen + 1))
+				continue;
+
+			/*
+			 * In an incremental backup, send only the changed blocks of main
+			 * fork segments.  The free space map and visibility map are
+			 * changed without advancing page LSNs, so they are sent whole.
+			 */
 			if (!sizeonly)
-				sent = sendFile(pathbuf, pathbuf + basepathlen + 1, &statbuf,
-								true, isDbDir ? pg_atoi(lastDir + 1, sizeof(Oid), 0) : InvalidOid);
+			{
+				if (!XLogRecPtrIsInvalid(incremental_lsn) &&
+					(isDbDir || strcmp(path, "./global") == 0) &&
+					parse_filename_for_nontemp_relation(de->d_name,
+														&relOidChars,
+														&relForkNum) &&
+					relForkNum == MAIN_FORKNUM &&
+					statbuf.st_size % BLCKSZ == 0)
+					sent = sendIncrementalFile(pathbuf,
+											   pathbuf + basepathlen + 1,
+											   &statbuf);
+				else
+					sent = sendFile(pathbuf, pathbuf + basepathlen + 1, &statbuf,
+									true, isDbDir ? pg_atoi(lastDir + 1, sizeof(Oid), 0) : InvalidOid);
+			}
 
 			if (sent || sizeonly)
 			{
@@ -1333,6 +1684,22 @@ sendDir(const char *path, int basepathlen, bool sizeonly, List *tablespaces,
 	return size;
 }
 
+/*
+ * Check if a file belongs to the part of a parallel backup that we send.
+ */
+static bool
+file_in_backup_part(const char *tarfilename)
+{
+	uint32		hash;
+
+	if (backup_nparts <= 1)
+		return true;
+
+	hash = DatumGetUInt32(hash_any((const unsigned char *) tarfilename,
+								   strlen(tarfilename)));
+	return hash % backup_nparts == backup_part;
+}
+
 /*
  * Check if a file should have its checksum validated.
  * We validate checksums on files in regular tablespaces
@@ -1624,6 +1991,151 @@ sendFile(const char *readfilename, const char *tarfilename, struct stat *statbuf
 	return true;
 }
 
+/*
+ * Send a relation segment as part of an incremental backup.
+ *
+ * Only the blocks whose LSN is at or past incremental_lsn are sent, wrapped
+ * in an INCREMENTAL.<filename> member as described in basebackup.h.  New
+ * pages carry no LSN yet, so they are always sent.  The file is read twice,
+ * first to pick the blocks, because the member size is needed for its tar
+ * header.  A block that changes between the two passes was modified after
+ * the backup started, so replaying WAL will restore it either way.
+ *
+ * Checksums are not verified for files sent this way.
+ *
+ * Returns true if the file was sent, false if it no longer exists.
+ */
+static bool
+sendIncrementalFile(const char *readfilename, const char *tarfilename,
+					struct stat *statbuf)
+{
+	int			fd;
+	char		buf[TAR_SEND_SIZE];
+	BlockNumber nblocks = statbuf->st_size / BLCKSZ;
+	BlockNumber blkno;
+	BlockNumber *blocks;
+	uint32		num_blocks = 0;
+	uint32		i;
+	IncrementalFileHeader header;
+	struct stat incstatbuf;
+	const char *sep;
+	char	   *inctarfilename;
+	size_t		used;
+	pgoff_t		len;
+	size_t		pad;
+
+	fd = OpenTransientFile(readfilename, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
+		if (errno == ENOENT)
+			return false;
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", readfilename)));
+	}
+
+	/* First pass: find the blocks that changed since incremental_lsn */
+	blocks = palloc(sizeof(BlockNumber) * nblocks);
+	blkno = 0;
+	while (blkno < nblocks)
+	{
+		ssize_t		cnt;
+
+		CHECK_FOR_INTERRUPTS();
+
+		cnt = pg_pread(fd, buf,
+					   Min(sizeof(buf), (size_t) (nblocks - blkno) * BLCKSZ),
+					   (off_t) blkno * BLCKSZ);
+		if (cnt < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m", readfilename)));
+
+		for (i = 0; i < cnt / BLCKSZ; i++, blkno++)
+		{
+			Page		page = buf + BLCKSZ * i;
+
+			if (PageIsNew(page) || PageGetLSN(page) >= incremental_lsn)
+				blocks[num_blocks++] = blkno;
+		}
+
+		/*
+		 * Stop at a concurrent truncation.  It happened after the backup
+		 * started, so WAL replay truncates the file to this length anyway.
+		 */
+		if (cnt < BLCKSZ || cnt % BLCKSZ != 0)
+			break;
+	}
+	nblocks = blkno;
+
+	/* Send the header, named after the file with the incremental prefix */
+	sep = last_dir_separator(tarfilename);
+	Assert(sep != NULL);
+	inctarfilename = psprintf("%.*s%s%s", (int) (sep + 1 - tarfilename),
+							  tarfilename, INCREMENTAL_PREFIX, sep + 1);
+
+	header.magic = INCREMENTAL_MAGIC;
+	header.num_blocks = num_blocks;
+	header.truncation_block_length = nblocks;
+
+	memcpy(&incstatbuf, statbuf, sizeof(struct stat));
+	incstatbuf.st_size = sizeof(header) +
+		(pgoff_t) num_blocks * (sizeof(BlockNumber) + BLCKSZ);
+	_tarWriteHeader(inctarfilename, NULL, &incstatbuf, false);
+
+	if (pq_putmessage('d', (char *) &header, sizeof(header)) ||
+		(num_blocks > 0 &&
+		 pq_putmessage('d', (char *) blocks, num_blocks * sizeof(BlockNumber))))
+		ereport(ERROR,
+				(errmsg("base backup could not send data, aborting backup")));
+	len = sizeof(header) + num_blocks * sizeof(BlockNumber);
+	throttle(len);
+
+	/* Second pass: send the blocks, a buffer-full at a time */
+	used = 0;
+	for (i = 0; i < num_blocks; i++)
+	{
+		ssize_t		cnt;
+
+		CHECK_FOR_INTERRUPTS();
+
+		cnt = pg_pread(fd, buf + used, BLCKSZ, (off_t) blocks[i] * BLCKSZ);
+		if (cnt < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read file \"%s\": %m", readfilename)));
+
+		/* Truncated since the first pass; as above, replay fixes this up */
+		if (cnt < BLCKSZ)
+			MemSet(buf + used + cnt, 0, BLCKSZ - cnt);
+
+		used += BLCKSZ;
+		if (used == sizeof(buf) || i == num_blocks - 1)
+		{
+			if (pq_putmessage('d', buf, used))
+				ereport(ERROR,
+						(errmsg("base backup could not send data, aborting backup")));
+			len += used;
+			throttle(used);
+			used = 0;
+		}
+	}
+
+	/* Pad to 512 byte boundary, per tar format requirements */
+	pad = ((len + 511) & ~511) - len;
+	if (pad > 0)
+	{
+		MemSet(buf, 0, pad);
+		pq_putmessage('d', buf, pad);
+	}
+
+	CloseTransientFile(fd);
+	pfree(blocks);
+	pfree(inctarfilename);
+
+	return true;
+}
+
 
 static int64
 _tarWriteHeader(const char *filename, const char *linktarget,
@@ -1632,6 +2144,11 @@ _tarWriteHeader(const char *filename, const char *linktarget,
 	char		h[512];
 	enum tarError rc;
 
+	/* In a parallel backup, the leader sends all directories and links */
+	if (backup_part > 0 &&
+		(linktarget != NULL || S_ISDIR(statbuf->st_mode)))
+		return 0;
+
 	if (!sizeonly)
 	{
 		rc = tarCreateHeader(h, filename, linktarget, statbuf->st_size,
@@ -33,6 +33,8 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 
+#include "commands/cluster.h"
+
 #include "replication/decode.h"
 #include "replication/logical.h"
 #include "replication/reorderbuffer.h"
@@ -167,6 +169,7 @@ StartupDecodingContext(List *output_plugin_options,
 	{
 		LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 		MyPgXact->vacuumFlags |= PROC_IN_LOGICAL_DECODING;
+		ProcGlobal->vacuumFlags[MyProc->pgxactoff] = MyPgXact->vacuumFlags;
 		LWLockRelease(ProcArrayLock);
 	}
 
@@ -566,8 +569,12 @@ LoadOutputPlugin(OutputPluginCallbacks *callbacks, char *plugin)
 {
 	LogicalOutputPluginInit plugin_init;
 
-	plugin_init = (LogicalOutputPluginInit)
-		load_external_function(plugin, "_PG_output_plugin_init", false, NULL);
+	/* CLUSTER CONCURRENTLY's plugin is built in, not a loadable module */
+	if (strcmp(plugin, CLUSTER_DECODING_PLUGIN) == 0)
+		plugin_init = cluster_decoding_init;
+	else
+		plugin_init = (LogicalOutputPluginInit)
+			load_external_function(plugin, "_PG_output_plugin_init", false, NULL);
 
 	if (plugin_init == NULL)
 		elog(ERROR, "output plugins have to declare the _PG_output_plugin_init symbol");
@@ -94,6 +94,27 @@ typedef struct SlotErrCallbackArg
 	int			remote_attnum;
 } SlotErrCallbackArg;
 
+/*
+ * Executor state for applying changes to one relation.
+ *
+ * Setting up the executor state and opening the indexes of the relation is
+ * a large part of the cost of applying a single-row change, so we keep them
+ * across consecutive changes to the same relation within a remote
+ * transaction.  apply_dispatch() releases the state before processing any
+ * message other than INSERT, UPDATE or DELETE, in particular before COMMIT
+ * ends the local transaction.
+ */
+typedef struct ApplyRelState
+{
+	LogicalRepRelId remoteid;	/* remote relation the state is for */
+	LogicalRepRelMapEntry *rel; /* its map entry, or NULL if no state */
+	EState	   *estate;
+	TupleTableSlot *remoteslot; /* slot for tuples sent by the publisher */
+	TupleTableSlot *localslot;	/* slot for existing local tuples */
+} ApplyRelState;
+
+static ApplyRelState apply_rel_state;
+
 static MemoryContext ApplyMessageContext = NULL;
 MemoryContext ApplyContext = NULL;
 
@@ -111,6 +132,8 @@ static void store_flush_position(XLogRecPtr remote_lsn);
 
 static void maybe_reread_subscription(void);
 
+static void apply_rel_state_release(void);
+
 /* Flags set by signal handlers */
 static volatile sig_atomic_t got_SIGHUP = false;
 
@@ -195,6 +218,96 @@ create_estate_for_relation(LogicalRepRelMapEntry *rel)
 	estate->es_num_result_relations = 1;
 	estate->es_result_relation_info = resultRelInfo;
 
+	return estate;
+}
+
+/*
+ * Open the relation a change is to be applied to, and set up the executor
+ * state for it, reusing the state of the previous change if that was for the
+ * same relation.
+ *
+ * Returns NULL if changes to the relation are not to be applied.
+ */
+static LogicalRepRelMapEntry *
+apply_rel_state_open(LogicalRepRelId relid)
+{
+	LogicalRepRelMapEntry *rel;
+	EState	   *estate;
+	MemoryContext oldctx;
+
+	if (apply_rel_state.rel != NULL)
+	{
+		/* Reuse the state, unless the map entry has been invalidated. */
+		if (apply_rel_state.remoteid == relid &&
+			OidIsValid(apply_rel_state.rel->localreloid))
+			return apply_rel_state.rel;
+
+		apply_rel_state_release();
+	}
+
+	rel = logicalrep_rel_open(relid, RowExclusiveLock);
+	if (!should_apply_changes_for_rel(rel))
+	{
+		/*
+		 * The relation can't become interesting in the middle of the
+		 * transaction so it's safe to unlock it.
+		 */
+		logicalrep_rel_close(rel, RowExclusiveLock);
+		return NULL;
+	}
+
+	/* The state must survive until the end of the local transaction. */
+	oldctx = MemoryContextSwitchTo(TopTransactionContext);
+	estate = create_estate_for_relation(rel);
+
+	MemoryContextSwitchTo(estate->es_query_cxt);
+	apply_rel_state.remoteslot = ExecInitExtraTupleSlot(estate,
+														RelationGetDescr(rel->localrel),
+														&TTSOpsVirtual);
+	apply_rel_state.localslot = table_slot_create(rel->localrel,
+												  &estate->es_tupleTable);
+	ExecOpenIndices(estate->es_result_relation_info, false);
+	MemoryContextSwitchTo(oldctx);
+
+	apply_rel_state.remoteid = relid;
+	apply_rel_state.rel = rel;
+	apply_rel_state.estate = estate;
+
+	return rel;
+}
+
+/*
+ * Release the executor state set up by apply_rel_state_open, and close the
+ * relation.
+ */
+static void
+apply_rel_state_release(void)
+{
+	EState	   *estate = apply_rel_state.estate;
+
+	if (apply_rel_state.rel == NULL)
+		return;
+
+	ExecCloseIndices(estate->es_result_relation_info);
+	ExecResetTupleTable(estate->es_tupleTable, false);
+	FreeExecutorState(estate);
+
+	logicalrep_rel_close(apply_rel_state.rel, NoLock);
+
+	apply_rel_state.rel = NULL;
+	apply_rel_state.estate = NULL;
+	apply_rel_state.remoteslot = NULL;
+	apply_rel_state.localslot = NULL;
+}
+
+/*
+ * Prepare the executor state for applying one change.
+ */
+static EState *
+apply_change_begin(void)
+{
+	EState	   *estate = apply_rel_state.estate;
+
 	estate->es_output_cid = GetCurrentCommandId(true);
 
 	/* Prepare to catch AFTER triggers. */
@@ -203,6 +316,23 @@ create_estate_for_relation(LogicalRepRelMapEntry *rel)
 	return estate;
 }
 
+/*
+ * Finish applying one change.
+ */
+static void
+apply_change_end(EState *estate)
+{
+	/* Handle queued AFTER triggers. */
+	AfterTriggerEndQuery(estate);
+
+	/* Don't keep buffer pins while waiting for the next message. */
+	ExecClearTuple(apply_rel_state.remoteslot);
+	ExecClearTuple(apply_rel_state.localslot);
+	ResetPerTupleExprContext(estate);
+
+	CommandCounterIncrement();
+}
+
 /*
  * Executes default values for columns for which we can't map to remote
  * relation columns.
@@ -296,13 +426,56 @@ slot_store_error_callback(void *arg)
 }
 
 /*
- * Store data in C string form into slot.
+ * Convert a remote column value, in text or binary format, into a Datum of
+ * the type of the local attribute.
+ */
+static Datum
+slot_input_value(Form_pg_attribute att, LogicalRepTupleData *tupleData,
+				 int remoteattnum)
+{
+	Oid			typfunc;
+	Oid			typioparam;
+	Datum		value;
+
+	if (tupleData->binary[remoteattnum])
+	{
+		StringInfoData buf;
+
+		/* the value is kept terminated, so it can be wrapped directly */
+		buf.data = tupleData->values[remoteattnum];
+		buf.len = tupleData->lengths[remoteattnum];
+		buf.maxlen = buf.len + 1;
+		buf.cursor = 0;
+
+		getTypeBinaryInputInfo(att->atttypid, &typfunc, &typioparam);
+		value = OidReceiveFunctionCall(typfunc, &buf, typioparam,
+									   att->atttypmod);
+
+		/* Trouble if it didn't eat the whole buffer */
+		if (buf.cursor != buf.len)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("incorrect binary data format in logical replication column %d",
+							remoteattnum + 1)));
+	}
+	else
+	{
+		getTypeInputInfo(att->atttypid, &typfunc, &typioparam);
+		value = OidInputFunctionCall(typfunc, tupleData->values[remoteattnum],
+									 typioparam, att->atttypmod);
+	}
+
+	return value;
+}
+
+/*
+ * Store data received from the publisher into slot.
  * This is similar to BuildTupleFromCStrings but TupleTableSlot fits our
  * use better.
  */
 static void
-slot_store_cstrings(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
-					char **values)
+slot_store_data(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
+				LogicalRepTupleData *tupleData)
 {
 	int			natts = slot->tts_tupleDescriptor->natts;
 	int			i;
@@ -320,25 +493,20 @@ slot_store_cstrings(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
 	errcallback.previous = error_context_stack;
 	error_context_stack = &errcallback;
 
-	/* Call the "in" function for each non-dropped attribute */
+	/* Call the "in" or "recv" function for each non-dropped attribute */
 	for (i = 0; i < natts; i++)
 	{
 		Form_pg_attribute att = TupleDescAttr(slot->tts_tupleDescriptor, i);
 		int			remoteattnum = rel->attrmap[i];
 
 		if (!att->attisdropped && remoteattnum >= 0 &&
-			values[remoteattnum] != NULL)
+			tupleData->values[remoteattnum] != NULL)
 		{
-			Oid			typinput;
-			Oid			typioparam;
-
 			errarg.local_attnum = i;
 			errarg.remote_attnum = remoteattnum;
 
-			getTypeInputInfo(att->atttypid, &typinput, &typioparam);
-			slot->tts_values[i] =
-				OidInputFunctionCall(typinput, values[remoteattnum],
-									 typioparam, att->atttypmod);
+			slot->tts_values[i] = slot_input_value(att, tupleData,
+												   remoteattnum);
 			slot->tts_isnull[i] = false;
 
 			errarg.local_attnum = -1;
@@ -363,14 +531,14 @@ slot_store_cstrings(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
 }
 
 /*
- * Modify slot with user data provided as C strings.
+ * Modify slot with the changed columns of data received from the publisher.
  * This is somewhat similar to heap_modify_tuple but also calls the type
- * input function on the user data as the input is the text representation
- * of the types.
+ * input or receive function on the user data as the input is the text or
+ * binary representation of the types.
  */
 static void
-slot_modify_cstrings(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
-					 char **values, bool *replaces)
+slot_modify_data(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
+				 LogicalRepTupleData *tupleData)
 {
 	int			natts = slot->tts_tupleDescriptor->natts;
 	int			i;
@@ -389,7 +557,7 @@ slot_modify_cstrings(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
 	errcallback.previous = error_context_stack;
 	error_context_stack = &errcallback;
 
-	/* Call the "in" function for each replaced attribute */
+	/* Call the "in" or "recv" function for each replaced attribute */
 	for (i = 0; i < natts; i++)
 	{
 		Form_pg_attribute att = TupleDescAttr(slot->tts_tupleDescriptor, i);
@@ -398,21 +566,16 @@ slot_modify_cstrings(TupleTableSlot *slot, LogicalRepRelMapEntry *rel,
 		if (remoteattnum < 0)
 			continue;
 
-		if (!replaces[remoteattnum])
+		if (!tupleData->changed[remoteattnum])
 			continue;
 
-		if (values[remoteattnum] != NULL)
+		if (tupleData->values[remoteattnum] != NULL)
 		{
-			Oid			typinput;
-			Oid			typioparam;
-
 			errarg.local_attnum = i;
 			errarg.remote_attnum = remoteattnum;
 
-			getTypeInputInfo(att->atttypid, &typinput, &typioparam);
-			slot->tts_values[i] =
-				OidInputFunctionCall(typinput, values[remoteattnum],
-									 typioparam, att->atttypmod);
+			slot->tts_values[i] = slot_input_value(att, tupleData,
+												   remoteattnum);
 			slot->tts_isnull[i] = false;
 
 			errarg.local_attnum = -1;
@@ -577,50 +740,30 @@ apply_handle_insert(StringInfo s)
 	ensure_transaction();
 
 	relid = logicalrep_read_insert(s, &newtup);
-	rel = logicalrep_rel_open(relid, RowExclusiveLock);
-	if (!should_apply_changes_for_rel(rel))
-	{
-		/*
-		 * The relation can't become interesting in the middle of the
-		 * transaction so it's safe to unlock it.
-		 */
-		logicalrep_rel_close(rel, RowExclusiveLock);
+	rel = apply_rel_state_open(relid);
+	if (rel == NULL)
 		return;
-	}
 
 	/* Initialize the executor state. */
-	estate = create_estate_for_relation(rel);
-	remoteslot = ExecInitExtraTupleSlot(estate,
-										RelationGetDescr(rel->localrel),
-										&TTSOpsVirtual);
+	estate = apply_change_begin();
+	remoteslot = apply_rel_state.remoteslot;
 
 	/* Input functions may need an active snapshot, so get one */
 	PushActiveSnapshot(GetTransactionSnapshot());
 
 	/* Process and store remote tuple in the slot */
 	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
-	slot_store_cstrings(remoteslot, rel, newtup.values);
+	slot_store_data(remoteslot, rel, &newtup);
 	slot_fill_defaults(rel, estate, remoteslot);
 	MemoryContextSwitchTo(oldctx);
 
-	ExecOpenIndices(estate->es_result_relation_info, false);
-
 	/* Do the insert. */
 	ExecSimpleRelationInsert(estate, remoteslot);
 
 	/* Cleanup. */
-	ExecCloseIndices(estate->es_result_relation_info);
 	PopActiveSnapshot();
 
-	/* Handle queued AFTER triggers. */
-	AfterTriggerEndQuery(estate);
-
-	ExecResetTupleTable(estate->es_tupleTable, false);
-	FreeExecutorState(estate);
-
-	logicalrep_rel_close(rel, NoLock);
-
-	CommandCounterIncrement();
+	apply_change_end(estate);
 }
 
 /*
@@ -681,36 +824,25 @@ apply_handle_update(StringInfo s)
 
 	relid = logicalrep_read_update(s, &has_oldtup, &oldtup,
 								   &newtup);
-	rel = logicalrep_rel_open(relid, RowExclusiveLock);
-	if (!should_apply_changes_for_rel(rel))
-	{
-		/*
-		 * The relation can't become interesting in the middle of the
-		 * transaction so it's safe to unlock it.
-		 */
-		logicalrep_rel_close(rel, RowExclusiveLock);
+	rel = apply_rel_state_open(relid);
+	if (rel == NULL)
 		return;
-	}
 
 	/* Check if we can do the update. */
 	check_relation_updatable(rel);
 
 	/* Initialize the executor state. */
-	estate = create_estate_for_relation(rel);
-	remoteslot = ExecInitExtraTupleSlot(estate,
-										RelationGetDescr(rel->localrel),
-										&TTSOpsVirtual);
-	localslot = table_slot_create(rel->localrel,
-								  &estate->es_tupleTable);
+	estate = apply_change_begin();
+	remoteslot = apply_rel_state.remoteslot;
+	localslot = apply_rel_state.localslot;
 	EvalPlanQualInit(&epqstate, estate, NULL, NIL, -1);
 
 	PushActiveSnapshot(GetTransactionSnapshot());
-	ExecOpenIndices(estate->es_result_relation_info, false);
 
 	/* Build the search tuple. */
 	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
-	slot_store_cstrings(remoteslot, rel,
-						has_oldtup ? oldtup.values : newtup.values);
+	slot_store_data(remoteslot, rel,
+					has_oldtup ? &oldtup : &newtup);
 	MemoryContextSwitchTo(oldctx);
 
 	/*
@@ -741,7 +873,7 @@ apply_handle_update(StringInfo s)
 		/* Process and store remote tuple in the slot */
 		oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
 		ExecCopySlot(remoteslot, localslot);
-		slot_modify_cstrings(remoteslot, rel, newtup.values, newtup.changed);
+		slot_modify_data(remoteslot, rel, &newtup);
 		MemoryContextSwitchTo(oldctx);
 
 		EvalPlanQualSetSlot(&epqstate, remoteslot);
@@ -763,19 +895,10 @@ apply_handle_update(StringInfo s)
 	}
 
 	/* Cleanup. */
-	ExecCloseIndices(estate->es_result_relation_info);
 	PopActiveSnapshot();
-
-	/* Handle queued AFTER triggers. */
-	AfterTriggerEndQuery(estate);
-
 	EvalPlanQualEnd(&epqstate);
-	ExecResetTupleTable(estate->es_tupleTable, false);
-	FreeExecutorState(estate);
 
-	logicalrep_rel_close(rel, NoLock);
-
-	CommandCounterIncrement();
+	apply_change_end(estate);
 }
 
 /*
@@ -800,35 +923,24 @@ apply_handle_delete(StringInfo s)
 	ensure_transaction();
 
 	relid = logicalrep_read_delete(s, &oldtup);
-	rel = logicalrep_rel_open(relid, RowExclusiveLock);
-	if (!should_apply_changes_for_rel(rel))
-	{
-		/*
-		 * The relation can't become interesting in the middle of the
-		 * transaction so it's safe to unlock it.
-		 */
-		logicalrep_rel_close(rel, RowExclusiveLock);
+	rel = apply_rel_state_open(relid);
+	if (rel == NULL)
 		return;
-	}
 
 	/* Check if we can do the delete. */
 	check_relation_updatable(rel);
 
 	/* Initialize the executor state. */
-	estate = create_estate_for_relation(rel);
-	remoteslot = ExecInitExtraTupleSlot(estate,
-										RelationGetDescr(rel->localrel),
-										&TTSOpsVirtual);
-	localslot = table_slot_create(rel->localrel,
-								  &estate->es_tupleTable);
+	estate = apply_change_begin();
+	remoteslot = apply_rel_state.remoteslot;
+	localslot = apply_rel_state.localslot;
 	EvalPlanQualInit(&epqstate, estate, NULL, NIL, -1);
 
 	PushActiveSnapshot(GetTransactionSnapshot());
-	ExecOpenIndices(estate->es_result_relation_info, false);
 
 	/* Find the tuple using the replica identity index. */
 	oldctx = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
-	slot_store_cstrings(remoteslot, rel, oldtup.values);
+	slot_store_data(remoteslot, rel, &oldtup);
 	MemoryContextSwitchTo(oldctx);
 
 	/*
@@ -864,19 +976,10 @@ apply_handle_delete(StringInfo s)
 	}
 
 	/* Cleanup. */
-	ExecCloseIndices(estate->es_result_relation_info);
 	PopActiveSnapshot();
-
-	/* Handle queued AFTER triggers. */
-	AfterTriggerEndQuery(estate);
-
 	EvalPlanQualEnd(&epqstate);
-	ExecResetTupleTable(estate->es_tupleTable, false);
-	FreeExecutorState(estate);
 
-	logicalrep_rel_close(rel, NoLock);
-
-	CommandCounterIncrement();
+	apply_change_end(estate);
 }
 
 /*
@@ -949,6 +1052,13 @@ apply_dispatch(StringInfo s)
 {
 	char		action = pq_getmsgbyte(s);
 
+	/*
+	 * The executor state of the previous change can only be reused by
+	 * another change in the same transaction.
+	 */
+	if (action != 'I' && action != 'U' && action != 'D')
+		apply_rel_state_release();
+
 	switch (action)
 	{
 			/* BEGIN */
@@ -1514,6 +1624,20 @@ maybe_reread_subscription(void)
 		proc_exit(0);
 	}
 
+	/*
+	 * Exit if the data format was changed, as the publisher only reads it at
+	 * the start of streaming.
+	 */
+	if (newsub->binary != MySubscription->binary)
+	{
+		ereport(LOG,
+				(errmsg("logical replication apply worker for subscription \"%s\" will "
+						"restart because subscription's binary option was changed",
+						MySubscription->name)));
+
+		proc_exit(0);
+	}
+
 	/* Check for other changes that should never happen too. */
 	if (newsub->dbid != MySubscription->dbid)
 	{
@@ -1725,6 +1849,7 @@ ApplyWorkerMain(Datum main_arg)
 	options.slotname = myslotname;
 	options.proto.logical.proto_version = LOGICALREP_PROTO_VERSION_NUM;
 	options.proto.logical.publication_names = MySubscription->publications;
+	options.proto.logical.binary = MySubscription->binary;
 
 	/* Start normal logical streaming replication. */
 	walrcv_startstreaming(wrconn, &options);
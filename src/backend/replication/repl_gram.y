@@ -78,6 +78,10 @@ static SQLCmd *make_sqlcmd(void);
 %token K_WAL
 %token K_TABLESPACE_MAP
 %token K_NOVERIFY_CHECKSUMS
+%token K_INCREMENTAL
+%token K_PARALLEL
+%token K_PART
+%token K_LEADER
 %token K_TIMELINE
 %token K_PHYSICAL
 %token K_LOGICAL
@@ -87,6 +91,7 @@ static SQLCmd *make_sqlcmd(void);
 %token K_EXPORT_SNAPSHOT
 %token K_NOEXPORT_SNAPSHOT
 %token K_USE_SNAPSHOT
+%token K_COMPRESSION
 
 %type <node>	command
 %type <node>	base_backup start_replication start_logical_replication
@@ -99,7 +104,7 @@ static SQLCmd *make_sqlcmd(void);
 %type <defelt>	plugin_opt_elem
 %type <node>	plugin_opt_arg
 %type <str>		opt_slot var_name
-%type <boolval>	opt_temporary
+%type <boolval>	opt_temporary opt_compression
 %type <list>	create_slot_opt_list
 %type <defelt>	create_slot_opt
 
@@ -155,7 +160,8 @@ var_name:	IDENT	{ $$ = $1; }
 
 /*
  * BASE_BACKUP [LABEL '<label>'] [PROGRESS] [FAST] [WAL] [NOWAIT]
- * [MAX_RATE %d] [TABLESPACE_MAP] [NOVERIFY_CHECKSUMS]
+ * [MAX_RATE %d] [TABLESPACE_MAP] [NOVERIFY_CHECKSUMS] [INCREMENTAL %X/%X]
+ * [PARALLEL %d [PART %d LEADER %d]]
  */
 base_backup:
 			K_BASE_BACKUP base_backup_opt_list
@@ -214,6 +220,28 @@ base_backup_opt:
 				  $$ = makeDefElem("noverify_checksums",
 								   (Node *)makeInteger(true), -1);
 				}
+			| K_INCREMENTAL RECPTR
+				{
+				  $$ = makeDefElem("incremental",
+								   (Node *)makeString(psprintf("%X/%X",
+															   (uint32) ($2 >> 32),
+															   (uint32) $2)), -1);
+				}
+			| K_PARALLEL UCONST
+				{
+				  $$ = makeDefElem("parallel",
+								   (Node *)makeInteger($2), -1);
+				}
+			| K_PART UCONST
+				{
+				  $$ = makeDefElem("part",
+								   (Node *)makeInteger($2), -1);
+				}
+			| K_LEADER UCONST
+				{
+				  $$ = makeDefElem("leader",
+								   (Node *)makeInteger($2), -1);
+				}
 			;
 
 create_replication_slot:
@@ -293,10 +321,10 @@ drop_replication_slot:
 			;
 
 /*
- * START_REPLICATION [SLOT slot] [PHYSICAL] %X/%X [TIMELINE %d]
+ * START_REPLICATION [SLOT slot] [PHYSICAL] %X/%X [TIMELINE %d] [COMPRESSION]
  */
 start_replication:
-			K_START_REPLICATION opt_slot opt_physical RECPTR opt_timeline
+			K_START_REPLICATION opt_slot opt_physical RECPTR opt_timeline opt_compression
 				{
 					StartReplicationCmd *cmd;
 
@@ -305,6 +333,7 @@ start_replication:
 					cmd->slotname = $2;
 					cmd->startpoint = $4;
 					cmd->timeline = $5;
+					cmd->compression = $6;
 					$$ = (Node *) cmd;
 				}
 			;
@@ -352,6 +381,11 @@ opt_temporary:
 			| /* EMPTY */					{ $$ = false; }
 			;
 
+opt_compression:
+			K_COMPRESSION					{ $$ = true; }
+			| /* EMPTY */					{ $$ = false; }
+			;
+
 opt_slot:
 			K_SLOT IDENT
 				{ $$ = $2; }
@@ -469,6 +469,9 @@ ReplicationSlotRelease(void)
 	/* might not have been set when we've been a plain slot */
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	MyPgXact->vacuumFlags &= ~PROC_IN_LOGICAL_DECODING;
+	/* at process exit, we may already have left the ProcArray */
+	if (MyProc->pgxactoff >= 0)
+		ProcGlobal->vacuumFlags[MyProc->pgxactoff] = MyPgXact->vacuumFlags;
 	LWLockRelease(ProcArrayLock);
 }
 
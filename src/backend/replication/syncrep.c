@@ -84,6 +84,7 @@
 #include "storage/proc.h"
 #include "tcop/tcopprot.h"
 #include "utils/builtins.h"
+#include "utils/memutils.h"
 #include "utils/ps_status.h"
 
 /* User-settable parameters for sync rep */
@@ -97,9 +98,17 @@ static bool announce_next_takeover = true;
 SyncRepConfigData *SyncRepConfig = NULL;
 static int	SyncRepWaitMode = SYNC_REP_NO_WAIT;
 
+/*
+ * Backends removed from the queues by SyncRepWakeQueue(), whose latches are
+ * set by SyncRepWakeWaiters() once SyncRepLock has been released.
+ */
+static PGPROC **SyncRepWakeups = NULL;
+static int	SyncRepNumWakeups = 0;
+
 static void SyncRepQueueInsert(int mode);
 static void SyncRepCancelWait(void);
 static int	SyncRepWakeQueue(bool all, int mode);
+static void SyncRepWakeWaiters(void);
 
 static bool SyncRepGetSyncRecPtr(XLogRecPtr *writePtr,
 								 XLogRecPtr *flushPtr,
@@ -439,8 +448,15 @@ SyncRepReleaseWaiters(void)
 	/*
 	 * We're a potential sync standby. Release waiters if there are enough
 	 * sync standbys and we are considered as sync.
+	 *
+	 * Computing the synced positions only needs a shared lock.  With several
+	 * sync standbys, most replies don't advance the positions, because
+	 * another walsender has already released the waiters or the slowest
+	 * required standby hasn't replied yet.  In that case we're done without
+	 * ever taking the lock exclusively, which the waiting backends need to
+	 * queue themselves.
 	 */
-	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
+	LWLockAcquire(SyncRepLock, LW_SHARED);
 
 	/*
 	 * Check whether we are a sync standby or not, and calculate the synced
@@ -477,6 +493,23 @@ SyncRepReleaseWaiters(void)
 		return;
 	}
 
+	/* Leave if there's nothing to release */
+	if (walsndctl->lsn[SYNC_REP_WAIT_WRITE] >= writePtr &&
+		walsndctl->lsn[SYNC_REP_WAIT_FLUSH] >= flushPtr &&
+		walsndctl->lsn[SYNC_REP_WAIT_APPLY] >= applyPtr)
+	{
+		LWLockRelease(SyncRepLock);
+		return;
+	}
+
+	/*
+	 * Upgrade to an exclusive lock.  Another walsender may have released
+	 * the waiters in the meantime, but the positions never move backwards,
+	 * so the checks below still do the right thing.
+	 */
+	LWLockRelease(SyncRepLock);
+	LWLockAcquire(SyncRepLock, LW_EXCLUSIVE);
+
 	/*
 	 * Set the lsn first so that when we wake backends they will release up to
 	 * this location.
@@ -499,6 +532,8 @@ SyncRepReleaseWaiters(void)
 
 	LWLockRelease(SyncRepLock);
 
+	SyncRepWakeWaiters();
+
 	elog(DEBUG3, "released %d procs up to write %X/%X, %d procs up to flush %X/%X, %d procs up to apply %X/%X",
 		 numwrite, (uint32) (writePtr >> 32), (uint32) writePtr,
 		 numflush, (uint32) (flushPtr >> 32), (uint32) flushPtr,
@@ -989,11 +1024,12 @@ SyncRepGetStandbyPriority(void)
 
 /*
  * Walk the specified queue from head.  Set the state of any backends that
- * need to be woken, remove them from the queue, and then wake them.
- * Pass all = true to wake whole queue; otherwise, just wake up to
- * the walsender's LSN.
+ * need to be woken, remove them from the queue, and remember them to be
+ * woken by SyncRepWakeWaiters().  Pass all = true to wake whole queue;
+ * otherwise, just wake up to the walsender's LSN.
  *
- * Must hold SyncRepLock.
+ * Must hold SyncRepLock.  The caller must call SyncRepWakeWaiters() after
+ * releasing it.
  */
 static int
 SyncRepWakeQueue(bool all, int mode)
@@ -1006,6 +1042,10 @@ SyncRepWakeQueue(bool all, int mode)
 	Assert(mode >= 0 && mode < NUM_SYNC_REP_WAIT_MODE);
 	Assert(SyncRepQueueIsOrderedByLSN(mode));
 
+	if (SyncRepWakeups == NULL)
+		SyncRepWakeups = (PGPROC **)
+			MemoryContextAlloc(TopMemoryContext, MaxBackends * sizeof(PGPROC *));
+
 	proc = (PGPROC *) SHMQueueNext(&(WalSndCtl->SyncRepQueue[mode]),
 								   &(WalSndCtl->SyncRepQueue[mode]),
 								   offsetof(PGPROC, syncRepLinks));
@@ -1048,7 +1088,8 @@ SyncRepWakeQueue(bool all, int mode)
 		/*
 		 * Wake only when we have set state and removed from queue.
 		 */
-		SetLatch(&(thisproc->procLatch));
+		Assert(SyncRepNumWakeups < MaxBackends);
+		SyncRepWakeups[SyncRepNumWakeups++] = thisproc;
 
 		numprocs++;
 	}
@@ -1056,6 +1097,24 @@ SyncRepWakeQueue(bool all, int mode)
 	return numprocs;
 }
 
+/*
+ * Wake the backends collected by SyncRepWakeQueue().
+ *
+ * Setting a latch can mean a system call, so we do it after releasing
+ * SyncRepLock rather than holding the lock for all of them.  A backend may
+ * already have noticed that its wait is complete and moved on by the time
+ * we get to it, but setting its latch then only causes a spurious wakeup.
+ */
+static void
+SyncRepWakeWaiters(void)
+{
+	int			i;
+
+	for (i = 0; i < SyncRepNumWakeups; i++)
+		SetLatch(&SyncRepWakeups[i]->procLatch);
+	SyncRepNumWakeups = 0;
+}
+
 /*
  * The checkpointer calls this as needed to update the shared
  * sync_standbys_defined flag, so that backends don't remain permanently wedged
@@ -1095,6 +1154,8 @@ SyncRepUpdateSyncStandbysDefined(void)
 		WalSndCtl->sync_standbys_defined = sync_standbys_defined;
 
 		LWLockRelease(SyncRepLock);
+
+		SyncRepWakeWaiters();
 	}
 }
 
@@ -60,6 +60,7 @@
 #include "catalog/pg_type.h"
 #include "commands/dbcommands.h"
 #include "commands/defrem.h"
+#include "common/pg_lzcompress.h"
 #include "funcapi.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
@@ -84,6 +85,7 @@
 #include "storage/procarray.h"
 #include "tcop/dest.h"
 #include "tcop/tcopprot.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
@@ -161,6 +163,14 @@ static StringInfoData output_message;
 static StringInfoData reply_message;
 static StringInfoData tmpbuf;
 
+/*
+ * Are WAL data messages compressed, as requested by the COMPRESSION option
+ * of START_REPLICATION?  If so, compressBuffer holds the compressed payload
+ * of the message being sent.
+ */
+static bool sendCompressed = false;
+static char *compressBuffer = NULL;
+
 /* Timestamp of last ProcessRepliesIfAny(). */
 static TimestampTz last_processing = 0;
 
@@ -248,12 +258,14 @@ static void WalSndKeepalive(bool requestReply);
 static void WalSndKeepaliveIfNecessary(void);
 static void WalSndCheckTimeOut(void);
 static long WalSndComputeSleeptime(TimestampTz now);
+static void WalSndWait(uint32 socket_events, long timeout, uint32 wait_event);
 static void WalSndPrepareWrite(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
 static void WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid, bool last_write);
 static void WalSndUpdateProgress(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid);
 static XLogRecPtr WalSndWaitForWal(XLogRecPtr loc);
 static void LagTrackerWrite(XLogRecPtr lsn, TimestampTz local_flush_time);
 static TimeOffset LagTrackerRead(int head, XLogRecPtr lsn, TimestampTz now);
+static int	LagHistogramBucket(TimeOffset lag);
 static bool TransactionIdInRecentPast(TransactionId xid, uint32 epoch);
 
 static void XLogRead(char *buf, XLogRecPtr startptr, Size count);
@@ -684,9 +696,15 @@ StartReplication(StartReplicationCmd *cmd)
 		/* Start streaming from the requested point */
 		sentPtr = cmd->startpoint;
 
+		sendCompressed = cmd->compression;
+		if (sendCompressed && compressBuffer == NULL)
+			compressBuffer = MemoryContextAlloc(TopMemoryContext,
+												PGLZ_MAX_OUTPUT(MAX_SEND_SIZE));
+
 		/* Initialize shared memory status, too */
 		SpinLockAcquire(&MyWalSnd->mutex);
 		MyWalSnd->sentPtr = sentPtr;
+		MyWalSnd->compression = sendCompressed;
 		SpinLockRelease(&MyWalSnd->mutex);
 
 		SyncRepInitConfig();
@@ -697,6 +715,7 @@ StartReplication(StartReplicationCmd *cmd)
 		WalSndLoop(XLogSendPhysical);
 
 		replication_active = false;
+		sendCompressed = false;
 		if (got_STOPPING)
 			proc_exit(0);
 		WalSndSetState(WALSNDSTATE_STARTUP);
@@ -1212,7 +1231,6 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 	/* If we have pending write here, go to slow path */
 	for (;;)
 	{
-		int			wakeEvents;
 		long		sleeptime;
 
 		/* Check for input from the client */
@@ -1229,13 +1247,9 @@ WalSndWriteData(LogicalDecodingContext *ctx, XLogRecPtr lsn, TransactionId xid,
 
 		sleeptime = WalSndComputeSleeptime(GetCurrentTimestamp());
 
-		wakeEvents = WL_LATCH_SET | WL_EXIT_ON_PM_DEATH |
-			WL_SOCKET_WRITEABLE | WL_SOCKET_READABLE | WL_TIMEOUT;
-
 		/* Sleep until something happens or we time out */
-		(void) WaitLatchOrSocket(MyLatch, wakeEvents,
-								 MyProcPort->sock, sleeptime,
-								 WAIT_EVENT_WAL_SENDER_WRITE_DATA);
+		WalSndWait(WL_SOCKET_WRITEABLE | WL_SOCKET_READABLE, sleeptime,
+				   WAIT_EVENT_WAL_SENDER_WRITE_DATA);
 
 		/* Clear any already-pending wakeups */
 		ResetLatch(MyLatch);
@@ -1407,15 +1421,12 @@ WalSndWaitForWal(XLogRecPtr loc)
 		 */
 		sleeptime = WalSndComputeSleeptime(GetCurrentTimestamp());
 
-		wakeEvents = WL_LATCH_SET | WL_EXIT_ON_PM_DEATH |
-			WL_SOCKET_READABLE | WL_TIMEOUT;
+		wakeEvents = WL_SOCKET_READABLE;
 
 		if (pq_is_send_pending())
 			wakeEvents |= WL_SOCKET_WRITEABLE;
 
-		(void) WaitLatchOrSocket(MyLatch, wakeEvents,
-								 MyProcPort->sock, sleeptime,
-								 WAIT_EVENT_WAL_SENDER_WAIT_WAL);
+		WalSndWait(wakeEvents, sleeptime, WAIT_EVENT_WAL_SENDER_WAIT_WAL);
 	}
 
 	/* reactivate latch so WalSndLoop knows to continue */
@@ -1856,6 +1867,12 @@ ProcessStandbyReplyMessage(void)
 			walsnd->flushLag = flushLag;
 		if (applyLag != -1 || clearLagTimes)
 			walsnd->applyLag = applyLag;
+		if (writeLag != -1)
+			walsnd->lagHistogram[SYNC_REP_WAIT_WRITE][LagHistogramBucket(writeLag)]++;
+		if (flushLag != -1)
+			walsnd->lagHistogram[SYNC_REP_WAIT_FLUSH][LagHistogramBucket(flushLag)]++;
+		if (applyLag != -1)
+			walsnd->lagHistogram[SYNC_REP_WAIT_APPLY][LagHistogramBucket(applyLag)]++;
 		walsnd->replyTime = replyTime;
 		SpinLockRelease(&walsnd->mutex);
 	}
@@ -2117,6 +2134,25 @@ WalSndComputeSleeptime(TimestampTz now)
 	return sleeptime;
 }
 
+/*
+ * Wait for the latch, the given socket events on the client connection, or
+ * a timeout.
+ *
+ * This uses the long-lived FeBeWaitSet instead of WaitLatchOrSocket(), so
+ * that we don't create and destroy a kernel wait object every time around
+ * the main loop.  Postmaster death makes us exit.
+ */
+static void
+WalSndWait(uint32 socket_events, long timeout, uint32 wait_event)
+{
+	WaitEvent	event;
+
+	ModifyWaitEvent(FeBeWaitSet, 0, socket_events, NULL);
+	if (WaitEventSetWait(FeBeWaitSet, timeout, &event, 1, wait_event) == 1 &&
+		(event.events & WL_POSTMASTER_DEATH))
+		proc_exit(1);
+}
+
 /*
  * Check whether there have been responses by the client within
  * wal_sender_timeout and shutdown if not.  Using last_processing as the
@@ -2261,8 +2297,7 @@ WalSndLoop(WalSndSendDataCallback send_data)
 			long		sleeptime;
 			int			wakeEvents;
 
-			wakeEvents = WL_LATCH_SET | WL_EXIT_ON_PM_DEATH | WL_TIMEOUT |
-				WL_SOCKET_READABLE;
+			wakeEvents = WL_SOCKET_READABLE;
 
 			/*
 			 * Use fresh timestamp, not last_processed, to reduce the chance
@@ -2274,9 +2309,7 @@ WalSndLoop(WalSndSendDataCallback send_data)
 				wakeEvents |= WL_SOCKET_WRITEABLE;
 
 			/* Sleep until something happens or we time out */
-			(void) WaitLatchOrSocket(MyLatch, wakeEvents,
-									 MyProcPort->sock, sleeptime,
-									 WAIT_EVENT_WAL_SENDER_MAIN);
+			WalSndWait(wakeEvents, sleeptime, WAIT_EVENT_WAL_SENDER_MAIN);
 		}
 	}
 	return;
@@ -2323,9 +2356,16 @@ InitWalSenderSlot(void)
 			walsnd->writeLag = -1;
 			walsnd->flushLag = -1;
 			walsnd->applyLag = -1;
+			memset(walsnd->lagHistogram, 0, sizeof(walsnd->lagHistogram));
 			walsnd->state = WALSNDSTATE_STARTUP;
 			walsnd->latch = &MyProc->procLatch;
 			walsnd->replyTime = 0;
+			walsnd->compression = false;
+			walsnd->sentBytes = 0;
+			walsnd->sentCompressedBytes = 0;
+			walsnd->backupStartPtr = InvalidXLogRecPtr;
+			walsnd->backupParts = 0;
+			walsnd->backupPartsDone = 0;
 			SpinLockRelease(&walsnd->mutex);
 			/* don't need the lock anymore */
 			MyWalSnd = (WalSnd *) walsnd;
@@ -2361,8 +2401,9 @@ WalSndKill(int code, Datum arg)
 /*
  * Read 'count' bytes from WAL into 'buf', starting at location 'startptr'
  *
- * XXX probably this should be improved to suck data directly from the
- * WAL buffers when possible.
+ * Recent WAL is copied from the WAL buffers when it's still there, so that
+ * walsenders that keep up with the primary don't each read the same WAL
+ * from disk.  Otherwise, we read it from the WAL segment files.
  *
  * Will open, and keep open, one WAL segment stored in the global file
  * descriptor sendFile. This means if XLogRead is used once, there will
@@ -2377,6 +2418,9 @@ XLogRead(char *buf, XLogRecPtr startptr, Size count)
 	Size		nbytes;
 	XLogSegNo	segno;
 
+	if (XLogReadFromBuffers(buf, startptr, count, sendTimeLine))
+		return;
+
 retry:
 	p = buf;
 	recptr = startptr;
@@ -2583,6 +2627,7 @@ XLogSendPhysical(void)
 	XLogRecPtr	startptr;
 	XLogRecPtr	endptr;
 	Size		nbytes;
+	Size		sendlen;
 
 	/* If requested switch the WAL sender to the stopping state. */
 	if (got_STOPPING)
@@ -2799,7 +2844,32 @@ XLogSendPhysical(void)
 	 */
 	enlargeStringInfo(&output_message, nbytes);
 	XLogRead(&output_message.data[output_message.len], startptr, nbytes);
-	output_message.len += nbytes;
+	sendlen = nbytes;
+
+	/*
+	 * If the standby asked for compression, replace the payload with its
+	 * compressed form, preceded by the uncompressed length, and mark the
+	 * message with 'z' instead of 'w'.  If the data doesn't compress well,
+	 * it's sent as usual.
+	 */
+	if (sendCompressed)
+	{
+		int32		clen;
+
+		clen = pglz_compress(&output_message.data[output_message.len], nbytes,
+							 compressBuffer, PGLZ_strategy_default);
+		if (clen >= 0)
+		{
+			output_message.data[0] = 'z';
+			pq_sendint32(&output_message, (int32) nbytes);
+			pq_sendbytes(&output_message, compressBuffer, clen);
+			sendlen = sizeof(int32) + clen;
+		}
+		else
+			output_message.len += nbytes;
+	}
+	else
+		output_message.len += nbytes;
 	output_message.data[output_message.len] = '\0';
 
 	/*
@@ -2820,6 +2890,8 @@ XLogSendPhysical(void)
 
 		SpinLockAcquire(&walsnd->mutex);
 		walsnd->sentPtr = sentPtr;
+		walsnd->sentBytes += nbytes;
+		walsnd->sentCompressedBytes += sendlen;
 		SpinLockRelease(&walsnd->mutex);
 	}
 
@@ -3260,7 +3332,7 @@ offset_to_interval(TimeOffset offset)
 Datum
 pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_WAL_SENDERS_COLS	12
+#define PG_STAT_GET_WAL_SENDERS_COLS	18
 	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
 	TupleDesc	tupdesc;
 	Tuplestorestate *tupstore;
@@ -3268,6 +3340,7 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 	MemoryContext oldcontext;
 	List	   *sync_standbys;
 	int			i;
+	int			j;
 
 	/* check to see if caller supports us returning a tuplestore */
 	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
@@ -3315,6 +3388,10 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		int			pid;
 		WalSndState state;
 		TimestampTz replyTime;
+		bool		compression;
+		uint64		sentBytes;
+		uint64		sentCompressedBytes;
+		uint64		lagHistogram[NUM_SYNC_REP_WAIT_MODE][WALSND_LAG_BUCKETS];
 		Datum		values[PG_STAT_GET_WAL_SENDERS_COLS];
 		bool		nulls[PG_STAT_GET_WAL_SENDERS_COLS];
 
@@ -3335,6 +3412,10 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 		applyLag = walsnd->applyLag;
 		priority = walsnd->sync_standby_priority;
 		replyTime = walsnd->replyTime;
+		compression = walsnd->compression;
+		sentBytes = walsnd->sentBytes;
+		sentCompressedBytes = walsnd->sentCompressedBytes;
+		memcpy(lagHistogram, walsnd->lagHistogram, sizeof(lagHistogram));
 		SpinLockRelease(&walsnd->mutex);
 
 		memset(nulls, 0, sizeof(nulls));
@@ -3416,6 +3497,23 @@ pg_stat_get_wal_senders(PG_FUNCTION_ARGS)
 				nulls[11] = true;
 			else
 				values[11] = TimestampTzGetDatum(replyTime);
+
+			values[12] = BoolGetDatum(compression);
+			values[13] = Int64GetDatum((int64) sentBytes);
+			values[14] = Int64GetDatum((int64) sentCompressedBytes);
+
+			for (j = 0; j < NUM_SYNC_REP_WAIT_MODE; j++)
+			{
+				Datum		counts[WALSND_LAG_BUCKETS];
+				int			k;
+
+				for (k = 0; k < WALSND_LAG_BUCKETS; k++)
+					counts[k] = Int64GetDatum((int64) lagHistogram[j][k]);
+				values[15 + j] = PointerGetDatum(construct_array(counts,
+																 WALSND_LAG_BUCKETS,
+																 INT8OID, sizeof(int64),
+																 FLOAT8PASSBYVAL, 'd'));
+			}
 		}
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -3652,3 +3750,21 @@ LagTrackerRead(int head, XLogRecPtr lsn, TimestampTz now)
 	Assert(time != 0);
 	return now - time;
 }
+
+/*
+ * Return the WalSnd lagHistogram bucket for a lag time in microseconds.
+ */
+static int
+LagHistogramBucket(TimeOffset lag)
+{
+	int			bucket = 0;
+	TimeOffset	limit = 1000;
+
+	while (lag >= limit && bucket < WALSND_LAG_BUCKETS - 1)
+	{
+		bucket++;
+		limit *= 2;
+	}
+
+	return bucket;
+}
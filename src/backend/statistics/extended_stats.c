@@ -28,6 +28,7 @@
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
 #include "optimizer/optimizer.h"
+#include "optimizer/pathnode.h"
 #include "postmaster/autovacuum.h"
 #include "statistics/extended_stats_internal.h"
 #include "statistics/statistics.h"
@@ -63,6 +64,22 @@ typedef struct StatExtEntry
 	List	   *types;			/* 'char' list of enabled statistic kinds */
 } StatExtEntry;
 
+/*
+ * Equality join clauses between plain columns of the same two base
+ * relations, for statext_join_clauselist_selectivity().
+ */
+typedef struct JoinClauseGroup
+{
+	Index		relid1;			/* the relation with the lower relid */
+	Index		relid2;
+	Bitmapset  *clauseidxs;		/* list positions of the clauses */
+	List	   *vars1;			/* Vars of relid1, one per clause */
+	List	   *vars2;			/* Vars of relid2, one per clause */
+	Bitmapset  *attnums1;		/* attnums of vars1 */
+	Bitmapset  *attnums2;		/* attnums of vars2 */
+	bool		usable;			/* false if a column appears twice */
+} JoinClauseGroup;
+
 
 static List *fetch_statentries_for_relation(Relation pg_statext, Oid relid);
 static VacAttrStats **lookup_var_attr_stats(Relation rel, Bitmapset *attrs,
@@ -70,6 +87,10 @@ static VacAttrStats **lookup_var_attr_stats(Relation rel, Bitmapset *attrs,
 static void statext_store(Oid relid,
 						  MVNDistinct *ndistinct, MVDependencies *dependencies,
 						  MCVList *mcv, VacAttrStats **stats);
+static bool find_ndistinct_for_attnums(RelOptInfo *rel, Bitmapset *attnums,
+									   double *ndistinct);
+static void join_side_stats(PlannerInfo *root, List *vars, bool have_nd,
+							double *nd, double *nonnull);
 
 
 /*
@@ -1187,6 +1208,257 @@ statext_clauselist_selectivity(PlannerInfo *root, List *clauses, int varRelid,
 	return sel;
 }
 
+/*
+ * find_ndistinct_for_attnums
+ *		Look up the ndistinct coefficient for exactly the given columns.
+ *
+ * Returns false if no ndistinct statistics object on the relation covers
+ * the columns.
+ */
+static bool
+find_ndistinct_for_attnums(RelOptInfo *rel, Bitmapset *attnums,
+						   double *ndistinct)
+{
+	ListCell   *lc;
+
+	foreach(lc, rel->statlist)
+	{
+		StatisticExtInfo *info = (StatisticExtInfo *) lfirst(lc);
+		MVNDistinct *stats;
+		int			i;
+
+		if (info->kind != STATS_EXT_NDISTINCT ||
+			!bms_is_subset(attnums, info->keys))
+			continue;
+
+		stats = statext_ndistinct_load(info->statOid);
+		for (i = 0; i < stats->nitems; i++)
+		{
+			if (bms_equal(stats->items[i].attrs, attnums))
+			{
+				*ndistinct = stats->items[i].ndistinct;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/*
+ * statext_join_clauselist_selectivity
+ *		Estimate equality join clauses using multivariate ndistinct
+ *		coefficients.
+ *
+ * Estimating "r1.a = r2.a AND r1.b = r2.b" as the product of the separate
+ * eqjoinsel() estimates assumes that the columns are independent, which badly
+ * underestimates joins on correlated columns such as composite keys.  When at
+ * least two equalities of plain columns join the same two base relations,
+ * and either relation has ndistinct statistics on exactly its columns of the
+ * equalities, we treat the columns as one composite key instead, and estimate
+ * the selectivity like eqjoinsel() does for a single column without MCV
+ * lists:
+ *
+ *		(1 - nullfrac1) * (1 - nullfrac2) / Max(nd1, nd2)
+ *
+ * For a relation without such statistics, nd is the product of the
+ * columns' ndistinct as usual.  The fraction of rows without NULLs in any of
+ * the columns is estimated assuming independence.
+ *
+ * The clauses estimated here are added to *estimatedclauses.
+ */
+Selectivity
+statext_join_clauselist_selectivity(PlannerInfo *root, List *clauses,
+									int varRelid, JoinType jointype,
+									SpecialJoinInfo *sjinfo,
+									Bitmapset **estimatedclauses)
+{
+	Selectivity sel = 1.0;
+	List	   *groups = NIL;
+	ListCell   *lc;
+	int			listidx;
+
+	/*
+	 * Only join clauses evaluated at a join are of interest, and semi- and
+	 * anti-joins are estimated quite differently by eqjoinsel().
+	 */
+	if (varRelid != 0 || sjinfo == NULL ||
+		jointype == JOIN_SEMI || jointype == JOIN_ANTI)
+		return 1.0;
+
+	/* Collect the equality clauses, grouped by the pair of relations */
+	listidx = -1;
+	foreach(lc, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(lc);
+		RestrictInfo *rinfo;
+		OpExpr	   *expr;
+		Node	   *leftop;
+		Node	   *rightop;
+		Var		   *var1;
+		Var		   *var2;
+		int			relid1;
+		int			relid2;
+		JoinClauseGroup *group = NULL;
+		ListCell   *lc2;
+
+		listidx++;
+
+		if (bms_is_member(listidx, *estimatedclauses) ||
+			!IsA(clause, RestrictInfo))
+			continue;
+		rinfo = (RestrictInfo *) clause;
+		if (rinfo->pseudoconstant || !is_opclause(rinfo->clause))
+			continue;
+		expr = (OpExpr *) rinfo->clause;
+		if (list_length(expr->args) != 2 ||
+			get_oprjoin(expr->opno) != F_EQJOINSEL)
+			continue;
+		if (!bms_get_singleton_member(rinfo->left_relids, &relid1) ||
+			!bms_get_singleton_member(rinfo->right_relids, &relid2) ||
+			relid1 == relid2)
+			continue;
+
+		leftop = linitial(expr->args);
+		rightop = lsecond(expr->args);
+		if (IsA(leftop, RelabelType))
+			leftop = (Node *) ((RelabelType *) leftop)->arg;
+		if (IsA(rightop, RelabelType))
+			rightop = (Node *) ((RelabelType *) rightop)->arg;
+		if (!IsA(leftop, Var) || !IsA(rightop, Var))
+			continue;
+		var1 = (Var *) leftop;
+		var2 = (Var *) rightop;
+		if (var1->varattno <= 0 || var2->varattno <= 0)
+			continue;
+
+		/* put the lower relid first, so that each pair has one group */
+		if (relid1 > relid2)
+		{
+			int			tmprelid = relid1;
+			Var		   *tmpvar = var1;
+
+			relid1 = relid2;
+			relid2 = tmprelid;
+			var1 = var2;
+			var2 = tmpvar;
+		}
+
+		foreach(lc2, groups)
+		{
+			JoinClauseGroup *g = (JoinClauseGroup *) lfirst(lc2);
+
+			if (g->relid1 == relid1 && g->relid2 == relid2)
+			{
+				group = g;
+				break;
+			}
+		}
+		if (group == NULL)
+		{
+			group = (JoinClauseGroup *) palloc0(sizeof(JoinClauseGroup));
+			group->relid1 = relid1;
+			group->relid2 = relid2;
+			group->usable = true;
+			groups = lappend(groups, group);
+		}
+
+		/*
+		 * A column compared to several columns of the other relation doesn't
+		 * make a composite key.
+		 */
+		if (bms_is_member(var1->varattno, group->attnums1) ||
+			bms_is_member(var2->varattno, group->attnums2))
+			group->usable = false;
+
+		group->clauseidxs = bms_add_member(group->clauseidxs, listidx);
+		group->vars1 = lappend(group->vars1, var1);
+		group->vars2 = lappend(group->vars2, var2);
+		group->attnums1 = bms_add_member(group->attnums1, var1->varattno);
+		group->attnums2 = bms_add_member(group->attnums2, var2->varattno);
+	}
+
+	foreach(lc, groups)
+	{
+		JoinClauseGroup *group = (JoinClauseGroup *) lfirst(lc);
+		RelOptInfo *rel1;
+		RelOptInfo *rel2;
+		double		nd1;
+		double		nd2;
+		bool		have_nd1;
+		bool		have_nd2;
+		double		nonnull1;
+		double		nonnull2;
+		Selectivity s;
+
+		if (!group->usable || bms_num_members(group->clauseidxs) < 2)
+			continue;
+
+		rel1 = find_base_rel(root, group->relid1);
+		rel2 = find_base_rel(root, group->relid2);
+		have_nd1 = find_ndistinct_for_attnums(rel1, group->attnums1, &nd1);
+		have_nd2 = find_ndistinct_for_attnums(rel2, group->attnums2, &nd2);
+		if (!have_nd1 && !have_nd2)
+			continue;
+
+		join_side_stats(root, group->vars1, have_nd1, &nd1, &nonnull1);
+		join_side_stats(root, group->vars2, have_nd2, &nd2, &nonnull2);
+
+		/* like get_variable_numdistinct(), don't exceed the number of rows */
+		if (rel1->tuples > 0 && nd1 > rel1->tuples)
+			nd1 = rel1->tuples;
+		if (rel2->tuples > 0 && nd2 > rel2->tuples)
+			nd2 = rel2->tuples;
+
+		s = nonnull1 * nonnull2 / Max(Max(nd1, nd2), 1.0);
+		CLAMP_PROBABILITY(s);
+		sel *= s;
+
+		*estimatedclauses = bms_add_members(*estimatedclauses,
+											group->clauseidxs);
+	}
+
+	return sel;
+}
+
+/*
+ * join_side_stats
+ *		Compute the per-side inputs of statext_join_clauselist_selectivity.
+ *
+ * Sets *nonnull to the estimated fraction of rows with no NULL in any of
+ * the vars, and, unless have_nd, *nd to the product of their ndistinct.
+ */
+static void
+join_side_stats(PlannerInfo *root, List *vars, bool have_nd,
+				double *nd, double *nonnull)
+{
+	ListCell   *lc;
+
+	if (!have_nd)
+		*nd = 1.0;
+	*nonnull = 1.0;
+
+	foreach(lc, vars)
+	{
+		VariableStatData vardata;
+		bool		isdefault;
+
+		examine_variable(root, (Node *) lfirst(lc), 0, &vardata);
+
+		if (!have_nd)
+			*nd *= get_variable_numdistinct(&vardata, &isdefault);
+		if (HeapTupleIsValid(vardata.statsTuple))
+		{
+			Form_pg_statistic stats;
+
+			stats = (Form_pg_statistic) GETSTRUCT(vardata.statsTuple);
+			*nonnull *= 1.0 - stats->stanullfrac;
+		}
+
+		ReleaseVariableStats(vardata);
+	}
+}
+
 /*
  * examine_operator_expression
  *		Split expression into Var and Const parts.
@@ -9,6 +9,19 @@
  * in most cases the caller needs to adjust the buffer header contents
  * before the lock is released (see notes in README).
  *
+ * The table uses open addressing.  It is divided into one sub-table per
+ * buffer mapping partition, so that everything a partition's entries touch
+ * is protected by that partition's lock.  Within a sub-table, collisions are
+ * resolved by linear probing, and deletion shifts later entries back rather
+ * than leaving tombstones.  Compared to a dynahash table, a lookup usually
+ * touches a single cache line, with no bucket directory or element chain to
+ * follow.
+ *
+ * Besides the authoritative hash table, we maintain a lossy, direct-mapped
+ * "hint" array from hash codes to buffer IDs, which can be read without any
+ * lock at all.  A hint only says where a page probably is; the caller must
+ * pin the buffer and then check its tag before trusting it.
+ *
  *
  * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -21,6 +34,7 @@
  */
 #include "postgres.h"
 
+#include "port/atomics.h"
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
 
@@ -29,10 +43,41 @@
 typedef struct
 {
 	BufferTag	key;			/* Tag of a disk page */
-	int			id;				/* Associated buffer ID */
+	int			id;				/* Associated buffer ID, or -1 if unused */
+	uint32		hashcode;		/* hash code of key */
 } BufferLookupEnt;
 
-static HTAB *SharedBufHash;
+/*
+ * The sub-table of partition p is BufLookupSlots[p * BufSubTableSize] up to
+ * BufLookupSlots[(p + 1) * BufSubTableSize - 1].  BufSubTableSize is a power
+ * of 2.  BufPartitionEntries[p] counts the entries in use in it; we keep it
+ * below BufSubTableSize, so that a probe always ends at an unused slot.
+ */
+static BufferLookupEnt *BufLookupSlots;
+static uint32 *BufPartitionEntries;
+static uint32 BufSubTableSize;
+
+/* GUC variable */
+bool		buffer_lookup_hints = true;
+
+/*
+ * Lookup hints: slot (hashcode & BufHintMask) holds buffer ID + 1 of the
+ * buffer most recently entered into the table with a hash code mapping to
+ * that slot, or 0.  NULL if buffer_lookup_hints is off.
+ */
+static pg_atomic_uint32 *BufHintTable = NULL;
+static uint32 BufHintMask;
+
+static uint32 BufSubTableSlots(int size);
+static uint32 BufHintTableSlots(int size);
+
+/* First slot of the partition a hash code belongs to */
+#define BufSubTable(hashcode) \
+	(&BufLookupSlots[BufTableHashPartition(hashcode) * BufSubTableSize])
+
+/* Preferred position of a hash code within its partition's sub-table */
+#define BufSubTableHome(hashcode) \
+	(((hashcode) / NUM_BUFFER_PARTITIONS) & (BufSubTableSize - 1))
 
 
 /*
@@ -42,7 +87,53 @@ static HTAB *SharedBufHash;
 Size
 BufTableShmemSize(int size)
 {
-	return hash_estimate_size(size, sizeof(BufferLookupEnt));
+	Size		result;
+
+	result = mul_size(mul_size(BufSubTableSlots(size), NUM_BUFFER_PARTITIONS),
+					  sizeof(BufferLookupEnt));
+	result = add_size(result, NUM_BUFFER_PARTITIONS * sizeof(uint32));
+
+	if (buffer_lookup_hints)
+		result = add_size(result, mul_size(BufHintTableSlots(size),
+										   sizeof(pg_atomic_uint32)));
+
+	return result;
+}
+
+/*
+ * Number of slots in each partition's sub-table: the next power of 2 that is
+ * at least twice the average number of entries per partition.  Hash codes
+ * are spread evenly enough that no partition comes anywhere near twice the
+ * average in practice; the minimum size covers tiny tables, where the
+ * numbers are too small for that to hold.
+ */
+static uint32
+BufSubTableSlots(int size)
+{
+	uint32		nslots = 16;
+	uint32		perpartition;
+
+	perpartition = ((uint32) size + NUM_BUFFER_PARTITIONS - 1) /
+		NUM_BUFFER_PARTITIONS;
+	while (nslots < perpartition * 2)
+		nslots <<= 1;
+
+	return nslots;
+}
+
+/*
+ * Number of slots in the hint array: the next power of 2 that is at least
+ * twice the table size, to keep collisions between live entries rare.
+ */
+static uint32
+BufHintTableSlots(int size)
+{
+	uint32		nslots = 1024;
+
+	while (nslots < (uint32) size * 2 && nslots < PG_UINT32_MAX / 2 + 1)
+		nslots <<= 1;
+
+	return nslots;
 }
 
 /*
@@ -52,19 +143,47 @@ BufTableShmemSize(int size)
 void
 InitBufTable(int size)
 {
-	HASHCTL		info;
+	uint32		nslots;
+	bool		found;
 
 	/* assume no locking is needed yet */
 
-	/* BufferTag maps to Buffer */
-	info.keysize = sizeof(BufferTag);
-	info.entrysize = sizeof(BufferLookupEnt);
-	info.num_partitions = NUM_BUFFER_PARTITIONS;
+	BufSubTableSize = BufSubTableSlots(size);
+	nslots = BufSubTableSize * NUM_BUFFER_PARTITIONS;
+
+	BufLookupSlots = (BufferLookupEnt *)
+		ShmemInitStruct("Shared Buffer Lookup Table",
+						nslots * sizeof(BufferLookupEnt) +
+						NUM_BUFFER_PARTITIONS * sizeof(uint32),
+						&found);
+	BufPartitionEntries = (uint32 *) &BufLookupSlots[nslots];
+
+	if (!found)
+	{
+		uint32		i;
+
+		for (i = 0; i < nslots; i++)
+			BufLookupSlots[i].id = -1;
+		for (i = 0; i < NUM_BUFFER_PARTITIONS; i++)
+			BufPartitionEntries[i] = 0;
+	}
+
+	if (buffer_lookup_hints)
+	{
+		BufHintTable = (pg_atomic_uint32 *)
+			ShmemInitStruct("Shared Buffer Lookup Hints",
+							BufHintTableSlots(size) * sizeof(pg_atomic_uint32),
+							&found);
+		BufHintMask = BufHintTableSlots(size) - 1;
 
-	SharedBufHash = ShmemInitHash("Shared Buffer Lookup Table",
-								  size, size,
-								  &info,
-								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION);
+		if (!found)
+		{
+			uint32		i;
+
+			for (i = 0; i <= BufHintMask; i++)
+				pg_atomic_init_u32(&BufHintTable[i], 0);
+		}
+	}
 }
 
 /*
@@ -79,7 +198,7 @@ InitBufTable(int size)
 uint32
 BufTableHashCode(BufferTag *tagPtr)
 {
-	return get_hash_value(SharedBufHash, (void *) tagPtr);
+	return tag_hash((void *) tagPtr, sizeof(BufferTag));
 }
 
 /*
@@ -91,19 +210,39 @@ BufTableHashCode(BufferTag *tagPtr)
 int
 BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	BufferLookupEnt *subtable = BufSubTable(hashcode);
+	uint32		i = BufSubTableHome(hashcode);
+
+	for (;;)
+	{
+		BufferLookupEnt *ent = &subtable[i];
+
+		if (ent->id < 0)
+			return -1;
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_FIND,
-									NULL);
+		i = (i + 1) & (BufSubTableSize - 1);
+	}
+}
 
-	if (!result)
+/*
+ * BufTableLookupHint
+ *		Return the buffer ID that probably holds the page with the given hash
+ *		code, or -1 if there is no hint
+ *
+ * No lock is needed.  The result may be stale or belong to another tag that
+ * hashes to the same slot: the caller must pin the buffer and verify that
+ * its tag matches before using it.  Once pinned, a buffer's tag can't change
+ * (see README).
+ */
+int
+BufTableLookupHint(uint32 hashcode)
+{
+	if (BufHintTable == NULL)
 		return -1;
 
-	return result->id;
+	return (int) pg_atomic_read_u32(&BufHintTable[hashcode & BufHintMask]) - 1;
 }
 
 /*
@@ -119,23 +258,40 @@ BufTableLookup(BufferTag *tagPtr, uint32 hashcode)
 int
 BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 {
-	BufferLookupEnt *result;
-	bool		found;
+	int			partition = BufTableHashPartition(hashcode);
+	BufferLookupEnt *subtable = BufSubTable(hashcode);
+	uint32		i = BufSubTableHome(hashcode);
+	BufferLookupEnt *ent;
 
 	Assert(buf_id >= 0);		/* -1 is reserved for not-in-table */
 	Assert(tagPtr->blockNum != P_NEW);	/* invalid tag */
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_ENTER,
-									&found);
+	for (;;)
+	{
+		ent = &subtable[i];
+
+		if (ent->id < 0)
+			break;
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			return ent->id;		/* found something already in the table */
+
+		i = (i + 1) & (BufSubTableSize - 1);
+	}
+
+	/* Keep at least one slot unused, see above */
+	if (BufPartitionEntries[partition] >= BufSubTableSize - 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of shared memory")));
 
-	if (found)					/* found something already in the table */
-		return result->id;
+	ent->key = *tagPtr;
+	ent->hashcode = hashcode;
+	ent->id = buf_id;
+	BufPartitionEntries[partition]++;
 
-	result->id = buf_id;
+	if (BufHintTable != NULL)
+		pg_atomic_write_u32(&BufHintTable[hashcode & BufHintMask],
+							(uint32) buf_id + 1);
 
 	return -1;
 }
@@ -149,15 +305,59 @@ BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id)
 void
 BufTableDelete(BufferTag *tagPtr, uint32 hashcode)
 {
-	BufferLookupEnt *result;
+	BufferLookupEnt *subtable = BufSubTable(hashcode);
+	uint32		mask = BufSubTableSize - 1;
+	uint32		i = BufSubTableHome(hashcode);
+	uint32		hole;
+	int			buf_id;
+
+	for (;;)
+	{
+		BufferLookupEnt *ent = &subtable[i];
+
+		if (ent->id < 0)		/* shouldn't happen */
+			elog(ERROR, "shared buffer hash table corrupted");
+		if (ent->hashcode == hashcode && BUFFERTAGS_EQUAL(ent->key, *tagPtr))
+			break;
+
+		i = (i + 1) & mask;
+	}
+	buf_id = subtable[i].id;
+
+	/*
+	 * Fill the hole by moving back the entries that follow it, up to the
+	 * next unused slot, unless that would put them before their preferred
+	 * position.  That keeps every entry reachable by probing from its
+	 * preferred position without passing an unused slot.
+	 */
+	hole = i;
+	for (;;)
+	{
+		BufferLookupEnt *ent;
+		uint32		home;
+
+		i = (i + 1) & mask;
+		ent = &subtable[i];
+		if (ent->id < 0)
+			break;
+
+		/* Can the entry move to the hole, i.e. is its home not after it? */
+		home = BufSubTableHome(ent->hashcode);
+		if (((i - home) & mask) >= ((i - hole) & mask))
+		{
+			subtable[hole] = *ent;
+			hole = i;
+		}
+	}
+	subtable[hole].id = -1;
+	BufPartitionEntries[BufTableHashPartition(hashcode)]--;
 
-	result = (BufferLookupEnt *)
-		hash_search_with_hash_value(SharedBufHash,
-									(void *) tagPtr,
-									hashcode,
-									HASH_REMOVE,
-									NULL);
+	/* Clear the hint, unless another entry has taken over the slot. */
+	if (BufHintTable != NULL)
+	{
+		uint32		expected = (uint32) buf_id + 1;
 
-	if (!result)				/* shouldn't happen */
-		elog(ERROR, "shared buffer hash table corrupted");
+		(void) pg_atomic_compare_exchange_u32(&BufHintTable[hashcode & BufHintMask],
+											  &expected, 0);
+	}
 }
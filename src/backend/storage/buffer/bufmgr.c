@@ -30,6 +30,7 @@
  */
 #include "postgres.h"
 
+#include <math.h>
 #include <sys/file.h>
 #include <unistd.h>
 
@@ -46,14 +47,60 @@
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
+#include "storage/md.h"
 #include "storage/proc.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
+#include "utils/spccache.h"
 #include "utils/timestamp.h"
 
 
+/*
+ * Private state of a streaming read; see BeginStreamingRead().
+ *
+ * The look-ahead queue is a circular array of block numbers that the
+ * callback has already produced, and for which we have (usually) issued a
+ * prefetch hint, but that have not yet been handed back to the caller.
+ */
+typedef struct StreamingReadData
+{
+	Relation	rel;
+	ForkNumber	forknum;
+	BufferAccessStrategy strategy;
+	StreamingReadCallback callback;
+	void	   *callback_private;
+
+	int			max_distance;	/* max # of blocks to look ahead */
+	int			distance;		/* current look-ahead, ramps up to max */
+	bool		exhausted;		/* callback returned InvalidBlockNumber */
+
+	int			queue_size;		/* allocated length of queue[] */
+	int			head;			/* index of oldest queued block */
+	int			nqueued;		/* # of valid entries in queue[] */
+	BlockNumber queue[FLEXIBLE_ARRAY_MEMBER];
+} StreamingReadData;
+
+/*
+ * Information BgBufferSync saves between calls for each clock sweep
+ * partition, so we can determine the advance rate of the partition's
+ * strategy point and avoid scanning already-cleaned buffers.
+ */
+typedef struct BgSyncPartition
+{
+	bool		saved_info_valid;
+	int			prev_strategy_buf_id;
+	uint32		prev_strategy_passes;
+	int			next_to_clean;	/* relative to the partition's first buffer */
+	uint32		next_passes;
+
+	/* Moving averages of allocation rate and clean-buffer density */
+	float		smoothed_alloc;
+	float		smoothed_density;
+} BgSyncPartition;
+
 /* Note: these two macros only work on shared buffers, not local ones! */
 #define BufHdrGetBlock(bufHdr)	((Block) (BufferBlocks + ((Size) (bufHdr)->buf_id) * BLCKSZ))
 #define BufferGetLSN(bufHdr)	(PageGetLSN(BufHdrGetBlock(bufHdr)))
@@ -68,6 +115,13 @@
 
 #define DROP_RELS_BSEARCH_THRESHOLD		20
 
+/*
+ * When dropping the buffers of relations during recovery without parallel
+ * redo, we look up each block in the buffer mapping table if there are fewer
+ * blocks than this in total, and scan the whole buffer pool otherwise.
+ */
+#define BUF_DROP_FULL_SCAN_THRESHOLD	(BlockNumber) (NBuffers / 32)
+
 typedef struct PrivateRefCountEntry
 {
 	Buffer		buffer;
@@ -103,12 +157,21 @@ typedef struct CkptTsStatus
 
 	/* current offset in CkptBufferIds for this tablespace */
 	int			index;
+
+	/*
+	 * Segment that the last processed buffer of this tablespace belongs to,
+	 * for checkpoint_sync_early.  Valid only if num_scanned > 0.
+	 */
+	RelFileNode last_rnode;
+	ForkNumber	last_forknum;
+	BlockNumber last_segno;
 } CkptTsStatus;
 
 /* GUC variables */
 bool		zero_damaged_pages = false;
 int			bgwriter_lru_maxpages = 100;
 double		bgwriter_lru_multiplier = 2.0;
+bool		bgwriter_fill_freelist = true;
 bool		track_io_timing = false;
 int			effective_io_concurrency = 0;
 
@@ -120,6 +183,9 @@ int			checkpoint_flush_after = 0;
 int			bgwriter_flush_after = 0;
 int			backend_flush_after = 0;
 
+/* fsync each file as soon as the checkpoint has written it out? */
+bool		checkpoint_sync_early = true;
+
 /*
  * How many buffers PrefetchBuffer callers should try to stay ahead of their
  * ReadBuffer calls by.  This is maintained by the assign hook for
@@ -438,7 +504,10 @@ static void PinBuffer_Locked(BufferDesc *buf);
 static void UnpinBuffer(BufferDesc *buf, bool fixOwner);
 static void BufferSync(int flags);
 static uint32 WaitBufHdrUnlocked(BufferDesc *buf);
+static bool BgBufferSyncPartition(WritebackContext *wb_context, int partition,
+								  BgSyncPartition *st, int *num_written);
 static int	SyncOneBuffer(int buf_id, bool skip_recently_used, WritebackContext *flush_context);
+static void BufferSyncSegmentDone(CkptTsStatus *ts_stat, CkptSortItem *item);
 static void WaitIO(BufferDesc *buf);
 static bool StartBufferIO(BufferDesc *buf, bool forInput);
 static void TerminateBufferIO(BufferDesc *buf, bool clear_dirty,
@@ -454,6 +523,12 @@ static BufferDesc *BufferAlloc(SMgrRelation smgr,
 static void FlushBuffer(BufferDesc *buf, SMgrRelation reln);
 static void AtProcExit_Buffers(int code, Datum arg);
 static void CheckForBufferLeaks(void);
+static BlockNumber DropRelFileNodeForkSize(SMgrRelation reln,
+										   ForkNumber forkNum);
+static void FindAndDropRelFileNodeBuffers(RelFileNode rnode,
+										  ForkNumber forkNum,
+										  BlockNumber nForkBlock,
+										  BlockNumber firstDelBlock);
 static int	rnode_comparator(const void *p1, const void *p2);
 static int	buffertag_comparator(const void *p1, const void *p2);
 static int	ckpt_buforder_comparator(const void *pa, const void *pb);
@@ -548,42 +623,253 @@ PrefetchBuffer(Relation reln, ForkNumber forkNum, BlockNumber blockNum)
 		LocalPrefetchBuffer(reln->rd_smgr, forkNum, blockNum);
 	}
 	else
+		(void) PrefetchSharedBuffer(reln->rd_smgr, forkNum, blockNum);
+#endif							/* USE_PREFETCH */
+}
+
+/*
+ * PrefetchSharedBuffer -- initiate asynchronous read of a shared buffer
+ *
+ * This is the guts of PrefetchBuffer() for permanent relations, usable by
+ * callers such as WAL replay that work at the smgr level and have no
+ * relcache entry.  Returns true if the block was already in shared buffers,
+ * in which case no I/O was initiated.
+ */
+bool
+PrefetchSharedBuffer(SMgrRelation smgr_reln, ForkNumber forkNum,
+					 BlockNumber blockNum)
+{
+	BufferTag	newTag;			/* identity of requested block */
+	uint32		newHash;		/* hash value for newTag */
+	LWLock	   *newPartitionLock;	/* buffer partition lock for it */
+	int			buf_id;
+
+	Assert(BlockNumberIsValid(blockNum));
+
+	/* create a tag so we can lookup the buffer */
+	INIT_BUFFERTAG(newTag, smgr_reln->smgr_rnode.node,
+				   forkNum, blockNum);
+
+	/* determine its hash code and partition lock ID */
+	newHash = BufTableHashCode(&newTag);
+	newPartitionLock = BufMappingPartitionLock(newHash);
+
+	/* see if the block is in the buffer pool already */
+	LWLockAcquire(newPartitionLock, LW_SHARED);
+	buf_id = BufTableLookup(&newTag, newHash);
+	LWLockRelease(newPartitionLock);
+
+	/* If not in buffers, initiate prefetch */
+	if (buf_id < 0)
 	{
-		BufferTag	newTag;		/* identity of requested block */
-		uint32		newHash;	/* hash value for newTag */
-		LWLock	   *newPartitionLock;	/* buffer partition lock for it */
-		int			buf_id;
+		smgrprefetch(smgr_reln, forkNum, blockNum);
+		pgBufferUsage.shared_blks_prefetched++;
+		return false;
+	}
 
-		/* create a tag so we can lookup the buffer */
-		INIT_BUFFERTAG(newTag, reln->rd_smgr->smgr_rnode.node,
-					   forkNum, blockNum);
+	/*
+	 * If the block *is* in buffers, we do nothing.  This is not really
+	 * ideal: the block might be just about to be evicted, which would be
+	 * stupid since we know we are going to need it soon.  But the only easy
+	 * answer is to bump the usage_count, which does not seem like a great
+	 * solution: when the caller does ultimately touch the block, usage_count
+	 * would get bumped again, resulting in too much favoritism for blocks
+	 * that are involved in a prefetch sequence. A real fix would involve
+	 * some additional per-buffer state, and it's not clear that there's
+	 * enough of a problem to justify that.
+	 */
+	pgBufferUsage.shared_blks_prefetch_hit++;
+	return true;
+}
 
-		/* determine its hash code and partition lock ID */
-		newHash = BufTableHashCode(&newTag);
-		newPartitionLock = BufMappingPartitionLock(newHash);
 
-		/* see if the block is in the buffer pool already */
-		LWLockAcquire(newPartitionLock, LW_SHARED);
-		buf_id = BufTableLookup(&newTag, newHash);
-		LWLockRelease(newPartitionLock);
+/*
+ * BeginStreamingRead -- set up a look-ahead reader for a block sequence
+ *
+ * The caller supplies a callback that returns the block numbers it is going
+ * to read, in order, and InvalidBlockNumber once there are no more.  Blocks
+ * are then obtained with StreamingReadNextBlock() or
+ * StreamingReadNextBuffer(); behind the scenes we keep calling the callback
+ * ahead of the consumer and issue PrefetchBuffer() for the blocks we have
+ * seen but not yet returned, so that the kernel has several reads in flight
+ * by the time the consumer gets to them.
+ *
+ * The look-ahead distance is derived from effective_io_concurrency (or the
+ * tablespace's setting of it), and ramps up from one block so that scans
+ * that stop early, e.g. below a LIMIT, don't issue a lot of useless I/O.
+ * With prefetching disabled or not compiled in, the stream degenerates to
+ * calling the callback once per block.
+ *
+ * The callback may well be invoked well ahead of the block being consumed,
+ * so it must not depend on the caller's progress through earlier blocks.
+ */
+StreamingRead
+BeginStreamingRead(Relation rel, ForkNumber forkNum,
+				   BufferAccessStrategy strategy,
+				   StreamingReadCallback callback, void *callback_private)
+{
+	StreamingRead stream;
+	int			max_distance = 0;
 
-		/* If not in buffers, initiate prefetch */
-		if (buf_id < 0)
-			smgrprefetch(reln->rd_smgr, forkNum, blockNum);
+#ifdef USE_PREFETCH
+	max_distance = target_prefetch_pages;
+
+	/*
+	 * Looking up the tablespace's options requires catalog access, which we
+	 * must not attempt while scanning the catalogs themselves.  They are
+	 * always in the default tablespace anyway.
+	 */
+	if (!IsCatalogRelation(rel))
+	{
+		int			io_concurrency;
+
+		io_concurrency = get_tablespace_io_concurrency(rel->rd_rel->reltablespace);
+		if (io_concurrency != effective_io_concurrency)
+		{
+			double		target;
+
+			if (ComputeIoConcurrency(io_concurrency, &target))
+				max_distance = (int) rint(target);
+		}
+	}
+#endif							/* USE_PREFETCH */
+
+	/*
+	 * Temp relations are read ahead in runs of consecutive blocks by
+	 * StreamingReadNextBuffer(), which doesn't depend on prefetch hints; look
+	 * far enough ahead to see such runs.
+	 */
+	if (RelationUsesLocalBuffers(rel))
+		max_distance = Max(max_distance, LOCAL_BUFFER_IO_COMBINE);
+
+	stream = palloc(offsetof(StreamingReadData, queue) +
+					sizeof(BlockNumber) * (max_distance + 1));
+	stream->rel = rel;
+	stream->forknum = forkNum;
+	stream->strategy = strategy;
+	stream->callback = callback;
+	stream->callback_private = callback_private;
+	stream->max_distance = max_distance;
+	stream->queue_size = max_distance + 1;
+	ResetStreamingRead(stream);
+
+	return stream;
+}
+
+/*
+ * StreamingReadNextBlock -- return the next block number of the stream
+ *
+ * Returns InvalidBlockNumber once the callback has reported the end of the
+ * sequence and all queued blocks have been consumed.  The caller is expected
+ * to read the block itself (this is the interface used by callers that must
+ * go through a table AM, like ANALYZE).
+ */
+BlockNumber
+StreamingReadNextBlock(StreamingRead stream)
+{
+	BlockNumber blkno;
+
+	/* Top up the look-ahead queue, prefetching what we add to it */
+	while (!stream->exhausted && stream->nqueued <= stream->distance)
+	{
+		blkno = stream->callback(stream->callback_private);
+		if (!BlockNumberIsValid(blkno))
+		{
+			stream->exhausted = true;
+			break;
+		}
 
 		/*
-		 * If the block *is* in buffers, we do nothing.  This is not really
-		 * ideal: the block might be just about to be evicted, which would be
-		 * stupid since we know we are going to need it soon.  But the only
-		 * easy answer is to bump the usage_count, which does not seem like a
-		 * great solution: when the caller does ultimately touch the block,
-		 * usage_count would get bumped again, resulting in too much
-		 * favoritism for blocks that are involved in a prefetch sequence. A
-		 * real fix would involve some additional per-buffer state, and it's
-		 * not clear that there's enough of a problem to justify that.
+		 * There's no point in hinting the block we're about to return
+		 * straight away; the caller is going to read it synchronously.
 		 */
+		if (stream->nqueued > 0)
+			PrefetchBuffer(stream->rel, stream->forknum, blkno);
+
+		stream->queue[(stream->head + stream->nqueued) % stream->queue_size] = blkno;
+		stream->nqueued++;
 	}
-#endif							/* USE_PREFETCH */
+
+	if (stream->nqueued == 0)
+		return InvalidBlockNumber;
+
+	blkno = stream->queue[stream->head];
+	stream->head = (stream->head + 1) % stream->queue_size;
+	stream->nqueued--;
+
+	/* Widen the window as the consumer proves it wants more */
+	if (stream->distance < stream->max_distance)
+		stream->distance = Min(stream->distance * 2 + 1, stream->max_distance);
+
+	return blkno;
+}
+
+/*
+ * StreamingReadNextBuffer -- return the next block of the stream, pinned
+ *
+ * Buffers are returned in the order the callback produced their block
+ * numbers, read with RBM_NORMAL and the strategy given at setup time.
+ * Returns InvalidBuffer at the end of the stream.  The caller is
+ * responsible for releasing the pin.
+ */
+Buffer
+StreamingReadNextBuffer(StreamingRead stream)
+{
+	BlockNumber blkno = StreamingReadNextBlock(stream);
+
+	if (!BlockNumberIsValid(blkno))
+		return InvalidBuffer;
+
+	/*
+	 * For a temp relation, read the block together with those queued right
+	 * behind it that follow it on disk, in one go.
+	 */
+	if (RelationUsesLocalBuffers(stream->rel) &&
+		!RELATION_IS_OTHER_TEMP(stream->rel))
+	{
+		int			nblocks = 1;
+
+		while (nblocks <= stream->nqueued &&
+			   stream->queue[(stream->head + nblocks - 1) % stream->queue_size] ==
+			   blkno + nblocks)
+			nblocks++;
+
+		if (nblocks > 1)
+		{
+			RelationOpenSmgr(stream->rel);
+			LocalReadAheadBuffers(stream->rel->rd_smgr, stream->forknum,
+								  blkno, nblocks);
+		}
+	}
+
+	return ReadBufferExtended(stream->rel, stream->forknum, blkno,
+							  RBM_NORMAL, stream->strategy);
+}
+
+/*
+ * ResetStreamingRead -- forget about queued blocks and restart the stream
+ *
+ * The callback will be invoked afresh on the next request; it's up to the
+ * caller to reset whatever state the callback uses.
+ */
+void
+ResetStreamingRead(StreamingRead stream)
+{
+	stream->distance = Min(1, stream->max_distance);
+	stream->exhausted = false;
+	stream->head = 0;
+	stream->nqueued = 0;
+}
+
+/*
+ * EndStreamingRead -- release a streaming read
+ *
+ * No buffer pins are held by the stream itself, so this just frees memory.
+ */
+void
+EndStreamingRead(StreamingRead stream)
+{
+	pfree(stream);
 }
 
 
@@ -892,13 +1178,13 @@ ReadBuffer_common(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 						io_time;
 
 			if (track_io_timing)
-				INSTR_TIME_SET_CURRENT(io_start);
+				INSTR_TIME_SET_CURRENT_FAST(io_start);
 
 			smgrread(smgr, forkNum, blockNum, (char *) bufBlock);
 
 			if (track_io_timing)
 			{
-				INSTR_TIME_SET_CURRENT(io_time);
+				INSTR_TIME_SET_CURRENT_FAST(io_time);
 				INSTR_TIME_SUBTRACT(io_time, io_start);
 				pgstat_count_buffer_read_time(INSTR_TIME_GET_MICROSEC(io_time));
 				INSTR_TIME_ADD(pgBufferUsage.blk_read_time, io_time);
@@ -1015,23 +1301,49 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 	newHash = BufTableHashCode(&newTag);
 	newPartitionLock = BufMappingPartitionLock(newHash);
 
-	/* see if the block is in the buffer pool already */
-	LWLockAcquire(newPartitionLock, LW_SHARED);
-	buf_id = BufTableLookup(&newTag, newHash);
+	/*
+	 * First try the lookup hints, which don't require the mapping lock.  A
+	 * hint may be stale; but once we hold a pin, the buffer's tag can't
+	 * change under us, so if it matches we have the right buffer, just as
+	 * if we had found it in the table.  If not, drop the pin again and do it
+	 * the hard way.
+	 */
+	buf_id = BufTableLookupHint(newHash);
 	if (buf_id >= 0)
 	{
-		/*
-		 * Found it.  Now, pin the buffer so no one can steal it from the
-		 * buffer pool, and check to see if the correct data has been loaded
-		 * into the buffer.
-		 */
 		buf = GetBufferDescriptor(buf_id);
 
 		valid = PinBuffer(buf, strategy);
+		if (!BUFFERTAGS_EQUAL(buf->tag, newTag))
+		{
+			UnpinBuffer(buf, true);
+			buf_id = -1;
+		}
+	}
+
+	/* see if the block is in the buffer pool already */
+	if (buf_id < 0)
+	{
+		LWLockAcquire(newPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&newTag, newHash);
+		if (buf_id >= 0)
+		{
+			/*
+			 * Found it.  Now, pin the buffer so no one can steal it from the
+			 * buffer pool, and check to see if the correct data has been
+			 * loaded into the buffer.
+			 */
+			buf = GetBufferDescriptor(buf_id);
+
+			valid = PinBuffer(buf, strategy);
+		}
 
 		/* Can release the mapping lock as soon as we've pinned it */
 		LWLockRelease(newPartitionLock);
+	}
 
+	if (buf_id >= 0)
+	{
 		*foundPtr = true;
 
 		if (!valid)
@@ -1058,9 +1370,8 @@ BufferAlloc(SMgrRelation smgr, char relpersistence, ForkNumber forkNum,
 
 	/*
 	 * Didn't find it in the buffer pool.  We'll have to initialize a new
-	 * buffer.  Remember to unlock the mapping lock while doing the work.
+	 * buffer.  We don't hold the mapping lock while doing the work.
 	 */
-	LWLockRelease(newPartitionLock);
 
 	/* Loop here in case we have to try another victim buffer */
 	for (;;)
@@ -1796,6 +2107,7 @@ BufferSync(int flags)
 	int			i;
 	int			mask = BM_DIRTY;
 	WritebackContext wb_context;
+	bool		sync_early;
 
 	/* Make sure we can handle the pin inside SyncOneBuffer */
 	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
@@ -1845,6 +2157,7 @@ BufferSync(int flags)
 			item = &CkptBufferIds[num_to_scan++];
 			item->buf_id = buf_id;
 			item->tsId = bufHdr->tag.rnode.spcNode;
+			item->dbNode = bufHdr->tag.rnode.dbNode;
 			item->relNode = bufHdr->tag.rnode.relNode;
 			item->forkNum = bufHdr->tag.forkNum;
 			item->blockNum = bufHdr->tag.blockNum;
@@ -1953,6 +2266,16 @@ BufferSync(int flags)
 
 	binaryheap_build(ts_heap);
 
+	/*
+	 * Unless we've been asked to finish as quickly as possible, fsync each
+	 * segment as soon as we have moved past it, rather than leaving all the
+	 * fsyncs to the sync phase.  That spreads the cost of flushing the
+	 * kernel's dirty data over the write phase, where CheckpointWriteDelay()
+	 * accounts for it, instead of stalling on it at the end.
+	 */
+	sync_early = checkpoint_sync_early && enableFsync &&
+		!(flags & CHECKPOINT_IMMEDIATE);
+
 	/*
 	 * Iterate through to-be-checkpointed buffers and write the ones (still)
 	 * marked with BM_CHECKPOINT_NEEDED. The writes are balanced between
@@ -1970,6 +2293,9 @@ BufferSync(int flags)
 		buf_id = CkptBufferIds[ts_stat->index].buf_id;
 		Assert(buf_id != -1);
 
+		if (sync_early)
+			BufferSyncSegmentDone(ts_stat, &CkptBufferIds[ts_stat->index]);
+
 		bufHdr = GetBufferDescriptor(buf_id);
 
 		num_processed++;
@@ -1991,7 +2317,7 @@ BufferSync(int flags)
 			if (SyncOneBuffer(buf_id, false, &wb_context) & BUF_WRITTEN)
 			{
 				TRACE_POSTGRESQL_BUFFER_SYNC_WRITTEN(buf_id);
-				BgWriterStats.m_buf_written_checkpoints++;
+				BgWriterStats.buf_written_checkpoints++;
 				num_written++;
 			}
 		}
@@ -2007,6 +2333,8 @@ BufferSync(int flags)
 		/* Have all the buffers from the tablespace been processed? */
 		if (ts_stat->num_scanned == ts_stat->num_to_scan)
 		{
+			if (sync_early)
+				BufferSyncSegmentDone(ts_stat, NULL);
 			binaryheap_remove_first(ts_heap);
 		}
 		else
@@ -2037,39 +2365,122 @@ BufferSync(int flags)
 	TRACE_POSTGRESQL_BUFFER_SYNC_DONE(NBuffers, num_written, num_to_scan);
 }
 
+/*
+ * BufferSyncSegmentDone -- fsync a segment BufferSync has finished with
+ *
+ * Called before BufferSync processes "item", the next to-be-checkpointed
+ * buffer of a tablespace, or with NULL once all of the tablespace's buffers
+ * have been processed.  If the previous buffer of the tablespace was in a
+ * different segment, all of that segment's buffers have now been written,
+ * since CkptBufferIds is sorted, so it can be synced without waiting for the
+ * sync phase.
+ */
+static void
+BufferSyncSegmentDone(CkptTsStatus *ts_stat, CkptSortItem *item)
+{
+	BlockNumber segno = InvalidBlockNumber;
+
+	if (item != NULL)
+		segno = item->blockNum / ((BlockNumber) RELSEG_SIZE);
+
+	if (ts_stat->num_scanned > 0 &&
+		(item == NULL ||
+		 item->dbNode != ts_stat->last_rnode.dbNode ||
+		 item->relNode != ts_stat->last_rnode.relNode ||
+		 item->forkNum != ts_stat->last_forknum ||
+		 segno != ts_stat->last_segno))
+	{
+		(void) SyncSegmentEarly(ts_stat->last_rnode, ts_stat->last_forknum,
+								ts_stat->last_segno * ((BlockNumber) RELSEG_SIZE));
+	}
+
+	if (item != NULL)
+	{
+		ts_stat->last_rnode.spcNode = item->tsId;
+		ts_stat->last_rnode.dbNode = item->dbNode;
+		ts_stat->last_rnode.relNode = item->relNode;
+		ts_stat->last_forknum = item->forkNum;
+		ts_stat->last_segno = segno;
+	}
+}
+
+/* BgBufferSync's state for each clock sweep partition */
+static BgSyncPartition *bgsync_partitions = NULL;
+
 /*
  * BgBufferSync -- Write out some dirty buffers in the pool.
  *
  * This is called periodically by the background writer process.
  *
+ * Each clock sweep partition has its own strategy point, and we clean ahead
+ * of each of them in turn, see BgBufferSyncPartition.  They share the
+ * bgwriter_lru_maxpages limit; we start with a different partition each
+ * time, so that none of them is starved if we keep reaching it.
+ *
  * Returns true if it's appropriate for the bgwriter process to go into
- * low-power hibernation mode.  (This happens if the strategy clock sweep
- * has been "lapped" and no buffer allocations have occurred recently,
+ * low-power hibernation mode.  (This happens if the strategy clock sweeps
+ * have all been "lapped" and no buffer allocations have occurred recently,
  * or if the bgwriter has been effectively disabled by setting
  * bgwriter_lru_maxpages to 0.)
  */
 bool
 BgBufferSync(WritebackContext *wb_context)
+{
+	static int	first_partition = 0;
+	int			nparts = StrategyNumPartitions();
+	int			num_written = 0;
+	bool		hibernate = true;
+	int			i;
+
+	if (bgsync_partitions == NULL)
+	{
+		bgsync_partitions = (BgSyncPartition *)
+			MemoryContextAllocZero(TopMemoryContext,
+								   nparts * sizeof(BgSyncPartition));
+		for (i = 0; i < nparts; i++)
+			bgsync_partitions[i].smoothed_density = 10.0;
+	}
+
+	/* Make sure we can handle the pin inside SyncOneBuffer */
+	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+
+	for (i = 0; i < nparts; i++)
+	{
+		int			partition = (first_partition + i) % nparts;
+
+		if (!BgBufferSyncPartition(wb_context, partition,
+								   &bgsync_partitions[partition],
+								   &num_written))
+			hibernate = false;
+	}
+	first_partition = (first_partition + 1) % nparts;
+
+	BgWriterStats.buf_written_clean += num_written;
+
+	return hibernate;
+}
+
+/*
+ * BgBufferSyncPartition -- Write out some dirty buffers ahead of the clock
+ *		hand of one partition.
+ *
+ * *num_written is the number of buffers written in this round so far, and
+ * is advanced by the number we write.
+ *
+ * Returns true if the partition doesn't need our attention, for hibernation
+ * purposes, see BgBufferSync.
+ */
+static bool
+BgBufferSyncPartition(WritebackContext *wb_context, int partition,
+					  BgSyncPartition *st, int *num_written)
 {
 	/* info obtained from freelist.c */
+	int			first_buffer;
+	int			nbuffers;
 	int			strategy_buf_id;
 	uint32		strategy_passes;
 	uint32		recent_alloc;
 
-	/*
-	 * Information saved between calls so we can determine the strategy
-	 * point's advance rate and avoid scanning already-cleaned buffers.
-	 */
-	static bool saved_info_valid = false;
-	static int	prev_strategy_buf_id;
-	static uint32 prev_strategy_passes;
-	static int	next_to_clean;
-	static uint32 next_passes;
-
-	/* Moving averages of allocation rate and clean-buffer density */
-	static float smoothed_alloc = 0;
-	static float smoothed_density = 10.0;
-
 	/* Potentially these could be tunables, but for now, not */
 	float		smoothing_samples = 16;
 	float		scan_whole_pool_milliseconds = 120000.0;
@@ -2082,10 +2493,10 @@ BgBufferSync(WritebackContext *wb_context)
 	int			reusable_buffers_est;
 	int			upcoming_alloc_est;
 	int			min_scan_buffers;
+	int			freelist_shortfall;
 
 	/* Variables for the scanning loop proper */
 	int			num_to_scan;
-	int			num_written;
 	int			reusable_buffers;
 
 	/* Variables for final smoothed_density update */
@@ -2093,13 +2504,14 @@ BgBufferSync(WritebackContext *wb_context)
 	uint32		new_recent_alloc;
 
 	/*
-	 * Find out where the freelist clock sweep currently is, and how many
-	 * buffer allocations have happened since our last call.
+	 * Find out where the partition's clock sweep currently is, and how many
+	 * buffer allocations have happened in it since our last call.
 	 */
-	strategy_buf_id = StrategySyncStart(&strategy_passes, &recent_alloc);
+	strategy_buf_id = StrategySyncStart(partition, &first_buffer, &nbuffers,
+										&strategy_passes, &recent_alloc);
 
 	/* Report buffer alloc counts to pgstat */
-	BgWriterStats.m_buf_alloc += recent_alloc;
+	BgWriterStats.buf_alloc += recent_alloc;
 
 	/*
 	 * If we're not running the LRU scan, just stop after doing the stats
@@ -2108,7 +2520,7 @@ BgBufferSync(WritebackContext *wb_context)
 	 */
 	if (bgwriter_lru_maxpages <= 0)
 	{
-		saved_info_valid = false;
+		st->saved_info_valid = false;
 		return true;
 	}
 
@@ -2120,34 +2532,34 @@ BgBufferSync(WritebackContext *wb_context)
 	 * weird-looking coding of xxx_passes comparisons are to avoid bogus
 	 * behavior when the passes counts wrap around.
 	 */
-	if (saved_info_valid)
+	if (st->saved_info_valid)
 	{
-		int32		passes_delta = strategy_passes - prev_strategy_passes;
+		int32		passes_delta = strategy_passes - st->prev_strategy_passes;
 
-		strategy_delta = strategy_buf_id - prev_strategy_buf_id;
-		strategy_delta += (long) passes_delta * NBuffers;
+		strategy_delta = strategy_buf_id - st->prev_strategy_buf_id;
+		strategy_delta += (long) passes_delta * nbuffers;
 
 		Assert(strategy_delta >= 0);
 
-		if ((int32) (next_passes - strategy_passes) > 0)
+		if ((int32) (st->next_passes - strategy_passes) > 0)
 		{
 			/* we're one pass ahead of the strategy point */
-			bufs_to_lap = strategy_buf_id - next_to_clean;
+			bufs_to_lap = strategy_buf_id - st->next_to_clean;
 #ifdef BGW_DEBUG
 			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
+				 st->next_passes, st->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta, bufs_to_lap);
 #endif
 		}
-		else if (next_passes == strategy_passes &&
-				 next_to_clean >= strategy_buf_id)
+		else if (st->next_passes == strategy_passes &&
+				 st->next_to_clean >= strategy_buf_id)
 		{
 			/* on same pass, but ahead or at least not behind */
-			bufs_to_lap = NBuffers - (next_to_clean - strategy_buf_id);
+			bufs_to_lap = nbuffers - (st->next_to_clean - strategy_buf_id);
 #ifdef BGW_DEBUG
 			elog(DEBUG2, "bgwriter ahead: bgw %u-%u strategy %u-%u delta=%ld lap=%d",
-				 next_passes, next_to_clean,
+				 st->next_passes, st->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta, bufs_to_lap);
 #endif
@@ -2160,13 +2572,13 @@ BgBufferSync(WritebackContext *wb_context)
 			 */
 #ifdef BGW_DEBUG
 			elog(DEBUG2, "bgwriter behind: bgw %u-%u strategy %u-%u delta=%ld",
-				 next_passes, next_to_clean,
+				 st->next_passes, st->next_to_clean,
 				 strategy_passes, strategy_buf_id,
 				 strategy_delta);
 #endif
-			next_to_clean = strategy_buf_id;
-			next_passes = strategy_passes;
-			bufs_to_lap = NBuffers;
+			st->next_to_clean = strategy_buf_id;
+			st->next_passes = strategy_passes;
+			bufs_to_lap = nbuffers;
 		}
 	}
 	else
@@ -2180,15 +2592,15 @@ BgBufferSync(WritebackContext *wb_context)
 			 strategy_passes, strategy_buf_id);
 #endif
 		strategy_delta = 0;
-		next_to_clean = strategy_buf_id;
-		next_passes = strategy_passes;
-		bufs_to_lap = NBuffers;
+		st->next_to_clean = strategy_buf_id;
+		st->next_passes = strategy_passes;
+		bufs_to_lap = nbuffers;
 	}
 
 	/* Update saved info for next time */
-	prev_strategy_buf_id = strategy_buf_id;
-	prev_strategy_passes = strategy_passes;
-	saved_info_valid = true;
+	st->prev_strategy_buf_id = strategy_buf_id;
+	st->prev_strategy_passes = strategy_passes;
+	st->saved_info_valid = true;
 
 	/*
 	 * Compute how many buffers had to be scanned for each new allocation, ie,
@@ -2199,7 +2611,7 @@ BgBufferSync(WritebackContext *wb_context)
 	if (strategy_delta > 0 && recent_alloc > 0)
 	{
 		scans_per_alloc = (float) strategy_delta / (float) recent_alloc;
-		smoothed_density += (scans_per_alloc - smoothed_density) /
+		st->smoothed_density += (scans_per_alloc - st->smoothed_density) /
 			smoothing_samples;
 	}
 
@@ -2208,22 +2620,22 @@ BgBufferSync(WritebackContext *wb_context)
 	 * strategy point and where we've scanned ahead to, based on the smoothed
 	 * density estimate.
 	 */
-	bufs_ahead = NBuffers - bufs_to_lap;
-	reusable_buffers_est = (float) bufs_ahead / smoothed_density;
+	bufs_ahead = nbuffers - bufs_to_lap;
+	reusable_buffers_est = (float) bufs_ahead / st->smoothed_density;
 
 	/*
 	 * Track a moving average of recent buffer allocations.  Here, rather than
 	 * a true average we want a fast-attack, slow-decline behavior: we
 	 * immediately follow any increase.
 	 */
-	if (smoothed_alloc <= (float) recent_alloc)
-		smoothed_alloc = recent_alloc;
+	if (st->smoothed_alloc <= (float) recent_alloc)
+		st->smoothed_alloc = recent_alloc;
 	else
-		smoothed_alloc += ((float) recent_alloc - smoothed_alloc) /
+		st->smoothed_alloc += ((float) recent_alloc - st->smoothed_alloc) /
 			smoothing_samples;
 
 	/* Scale the estimate by a GUC to allow more aggressive tuning. */
-	upcoming_alloc_est = (int) (smoothed_alloc * bgwriter_lru_multiplier);
+	upcoming_alloc_est = (int) (st->smoothed_alloc * bgwriter_lru_multiplier);
 
 	/*
 	 * If recent_alloc remains at zero for many cycles, smoothed_alloc will
@@ -2234,7 +2646,19 @@ BgBufferSync(WritebackContext *wb_context)
 	 * syndrome.  It will pop back up as soon as recent_alloc increases.
 	 */
 	if (upcoming_alloc_est == 0)
-		smoothed_alloc = 0;
+		st->smoothed_alloc = 0;
+
+	/*
+	 * The clean buffers we find are also put on the freelist, so that
+	 * backends can take them without running the clock sweep.  Aim to have
+	 * enough there to satisfy the allocations expected before the next round;
+	 * any more would just be taken away from the clock sweep's judgement.
+	 * There's only one freelist, so count the partition's share of it.
+	 */
+	freelist_shortfall = 0;
+	if (bgwriter_fill_freelist)
+		freelist_shortfall = upcoming_alloc_est -
+			(int) ((double) StrategyFreelistLength() * nbuffers / NBuffers);
 
 	/*
 	 * Even in cases where there's been little or no buffer allocation
@@ -2246,7 +2670,7 @@ BgBufferSync(WritebackContext *wb_context)
 	 * the BGW will be called during the scan_whole_pool time; slice the
 	 * buffer pool into that many sections.
 	 */
-	min_scan_buffers = (int) (NBuffers / (scan_whole_pool_milliseconds / BgWriterDelay));
+	min_scan_buffers = (int) (nbuffers / (scan_whole_pool_milliseconds / BgWriterDelay));
 
 	if (upcoming_alloc_est < (min_scan_buffers + reusable_buffers_est))
 	{
@@ -2263,33 +2687,33 @@ BgBufferSync(WritebackContext *wb_context)
 	 * enough buffers to match our estimate of the next cycle's allocation
 	 * requirements, or hit the bgwriter_lru_maxpages limit.
 	 */
-
-	/* Make sure we can handle the pin inside SyncOneBuffer */
-	ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
-
 	num_to_scan = bufs_to_lap;
-	num_written = 0;
 	reusable_buffers = reusable_buffers_est;
 
 	/* Execute the LRU scan */
-	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est)
+	while (num_to_scan > 0 && reusable_buffers < upcoming_alloc_est &&
+		   *num_written < bgwriter_lru_maxpages)
 	{
-		int			sync_state = SyncOneBuffer(next_to_clean, true,
-											   wb_context);
+		int			buf_id = first_buffer + st->next_to_clean;
+		int			sync_state = SyncOneBuffer(buf_id, true, wb_context);
+
+		if ((sync_state & BUF_REUSABLE) && freelist_shortfall > 0 &&
+			StrategyAddCleanBuffer(GetBufferDescriptor(buf_id)))
+			freelist_shortfall--;
 
-		if (++next_to_clean >= NBuffers)
+		if (++st->next_to_clean >= nbuffers)
 		{
-			next_to_clean = 0;
-			next_passes++;
+			st->next_to_clean = 0;
+			st->next_passes++;
 		}
 		num_to_scan--;
 
 		if (sync_state & BUF_WRITTEN)
 		{
 			reusable_buffers++;
-			if (++num_written >= bgwriter_lru_maxpages)
+			if (++(*num_written) >= bgwriter_lru_maxpages)
 			{
-				BgWriterStats.m_maxwritten_clean++;
+				BgWriterStats.maxwritten_clean++;
 				break;
 			}
 		}
@@ -2297,14 +2721,12 @@ BgBufferSync(WritebackContext *wb_context)
 			reusable_buffers++;
 	}
 
-	BgWriterStats.m_buf_written_clean += num_written;
-
 #ifdef BGW_DEBUG
 	elog(DEBUG1, "bgwriter: recent_alloc=%u smoothed=%.2f delta=%ld ahead=%d density=%.2f reusable_est=%d upcoming_est=%d scanned=%d wrote=%d reusable=%d",
-		 recent_alloc, smoothed_alloc, strategy_delta, bufs_ahead,
-		 smoothed_density, reusable_buffers_est, upcoming_alloc_est,
+		 recent_alloc, st->smoothed_alloc, strategy_delta, bufs_ahead,
+		 st->smoothed_density, reusable_buffers_est, upcoming_alloc_est,
 		 bufs_to_lap - num_to_scan,
-		 num_written,
+		 *num_written,
 		 reusable_buffers - reusable_buffers_est);
 #endif
 
@@ -2321,13 +2743,13 @@ BgBufferSync(WritebackContext *wb_context)
 	if (new_strategy_delta > 0 && new_recent_alloc > 0)
 	{
 		scans_per_alloc = (float) new_strategy_delta / (float) new_recent_alloc;
-		smoothed_density += (scans_per_alloc - smoothed_density) /
+		st->smoothed_density += (scans_per_alloc - st->smoothed_density) /
 			smoothing_samples;
 
 #ifdef BGW_DEBUG
 		elog(DEBUG2, "bgwriter: cleaner density alloc=%u scan=%ld density=%.2f new smoothed=%.2f",
 			 new_recent_alloc, new_strategy_delta,
-			 scans_per_alloc, smoothed_density);
+			 scans_per_alloc, st->smoothed_density);
 #endif
 	}
 
@@ -2750,7 +3172,7 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 	bufToWrite = PageSetChecksumCopy((Page) bufBlock, buf->tag.blockNum);
 
 	if (track_io_timing)
-		INSTR_TIME_SET_CURRENT(io_start);
+		INSTR_TIME_SET_CURRENT_FAST(io_start);
 
 	/*
 	 * bufToWrite is either the shared buffer or a copy, as appropriate.
@@ -2763,7 +3185,7 @@ FlushBuffer(BufferDesc *buf, SMgrRelation reln)
 
 	if (track_io_timing)
 	{
-		INSTR_TIME_SET_CURRENT(io_time);
+		INSTR_TIME_SET_CURRENT_FAST(io_time);
 		INSTR_TIME_SUBTRACT(io_time, io_start);
 		pgstat_count_buffer_write_time(INSTR_TIME_GET_MICROSEC(io_time));
 		INSTR_TIME_ADD(pgBufferUsage.blk_write_time, io_time);
@@ -2916,16 +3338,18 @@ BufferGetLSNAtomic(Buffer buffer)
  *		that no other process could be trying to load more pages of the
  *		relation into buffers.
  *
- *		XXX currently it sequentially searches the buffer pool, should be
- *		changed to more clever ways of searching.  However, this routine
- *		is used only in code paths that aren't very performance-critical,
- *		and we shouldn't slow down the hot paths to make it faster ...
+ *		In recovery, if the size of the fork is known and only a few blocks
+ *		are affected, we look each of them up in the buffer mapping table.
+ *		Otherwise we sequentially search the buffer pool, which costs the
+ *		same no matter how small the relation is.
  * --------------------------------------------------------------------
  */
 void
-DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
+DropRelFileNodeBuffers(SMgrRelation smgr_reln, ForkNumber forkNum,
 					   BlockNumber firstDelBlock)
 {
+	RelFileNodeBackend rnode = smgr_reln->smgr_rnode;
+	BlockNumber nForkBlock;
 	int			i;
 
 	/* If it's a local relation, it's localbuf.c's problem. */
@@ -2936,6 +3360,19 @@ DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
 		return;
 	}
 
+	nForkBlock = DropRelFileNodeForkSize(smgr_reln, forkNum);
+	if (nForkBlock != InvalidBlockNumber)
+	{
+		if (nForkBlock <= firstDelBlock)
+			return;
+		if (nForkBlock - firstDelBlock < BUF_DROP_FULL_SCAN_THRESHOLD)
+		{
+			FindAndDropRelFileNodeBuffers(rnode.node, forkNum, nForkBlock,
+										  firstDelBlock);
+			return;
+		}
+	}
+
 	for (i = 0; i < NBuffers; i++)
 	{
 		BufferDesc *bufHdr = GetBufferDescriptor(i);
@@ -2970,6 +3407,90 @@ DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
 	}
 }
 
+/*
+ * DropRelFileNodeForkSize -- number of blocks of a fork whose buffers are
+ *		about to be dropped, or InvalidBlockNumber if not reliably known
+ *
+ * A buffer is only ever valid for a block that is present in the file: the
+ * file is extended before a new block's buffer is marked valid, and files are
+ * only truncated or removed after the buffers of the affected blocks have
+ * been dropped.  So no buffer beyond the end of the fork can hold anything
+ * we'd need to get rid of, and a fork that doesn't exist has no such buffers
+ * at all.
+ *
+ * That only helps if we know where the end is, though.  Outside recovery we
+ * don't look: the kernel might not yet report the new size of a file that
+ * another backend has just extended, and callers include post-commit
+ * cleanup, where we'd rather not do I/O that could fail.  When the startup
+ * process replays WAL by itself, the size cached by smgr is exact (see
+ * smgrnblocks_trusted); with parallel redo workers extending relations
+ * concurrently, it isn't, so we don't look then either.
+ */
+static BlockNumber
+DropRelFileNodeForkSize(SMgrRelation reln, ForkNumber forkNum)
+{
+	BlockNumber nblocks;
+
+	if (!smgrnblocks_trusted())
+		return InvalidBlockNumber;
+
+	nblocks = smgrnblocks_cached(reln, forkNum);
+	if (nblocks == InvalidBlockNumber && !smgrexists(reln, forkNum))
+		nblocks = 0;
+
+	return nblocks;
+}
+
+/*
+ * FindAndDropRelFileNodeBuffers -- drop the buffers of blocks firstDelBlock
+ *		to nForkBlock - 1 of a fork, looking up each block in the buffer
+ *		mapping table
+ */
+static void
+FindAndDropRelFileNodeBuffers(RelFileNode rnode, ForkNumber forkNum,
+							  BlockNumber nForkBlock,
+							  BlockNumber firstDelBlock)
+{
+	BlockNumber curBlock;
+
+	for (curBlock = firstDelBlock; curBlock < nForkBlock; curBlock++)
+	{
+		BufferTag	bufTag;
+		uint32		bufHash;
+		LWLock	   *bufPartitionLock;
+		int			buf_id;
+		BufferDesc *bufHdr;
+		uint32		buf_state;
+
+		INIT_BUFFERTAG(bufTag, rnode, forkNum, curBlock);
+		bufHash = BufTableHashCode(&bufTag);
+		bufPartitionLock = BufMappingPartitionLock(bufHash);
+
+		LWLockAcquire(bufPartitionLock, LW_SHARED);
+		buf_id = BufTableLookup(&bufTag, bufHash);
+		LWLockRelease(bufPartitionLock);
+
+		if (buf_id < 0)
+			continue;
+
+		bufHdr = GetBufferDescriptor(buf_id);
+
+		/*
+		 * We need to lock the buffer header and recheck if the buffer is
+		 * still associated with the same block because the buffer could be
+		 * evicted by some other backend loading blocks for a different
+		 * relation after we release the lock on the buffer mapping table.
+		 */
+		buf_state = LockBufHdr(bufHdr);
+		if (RelFileNodeEquals(bufHdr->tag.rnode, rnode) &&
+			bufHdr->tag.forkNum == forkNum &&
+			bufHdr->tag.blockNum >= firstDelBlock)
+			InvalidateBuffer(bufHdr);	/* releases spinlock */
+		else
+			UnlockBufHdr(bufHdr, buf_state);
+	}
+}
+
 /* ---------------------------------------------------------------------
  *		DropRelFileNodesAllBuffers
  *
@@ -2980,28 +3501,32 @@ DropRelFileNodeBuffers(RelFileNodeBackend rnode, ForkNumber forkNum,
  * --------------------------------------------------------------------
  */
 void
-DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes)
+DropRelFileNodesAllBuffers(SMgrRelation *smgr_reln, int nnodes)
 {
 	int			i,
 				n = 0;
+	SMgrRelation *rels;
 	RelFileNode *nodes;
+	BlockNumber (*nForkBlock)[MAX_FORKNUM + 1];
+	uint64		nBlocksToDrop = 0;
+	bool		cached = true;
 	bool		use_bsearch;
 
 	if (nnodes == 0)
 		return;
 
-	nodes = palloc(sizeof(RelFileNode) * nnodes);	/* non-local relations */
+	rels = palloc(sizeof(SMgrRelation) * nnodes);	/* non-local relations */
 
 	/* If it's a local relation, it's localbuf.c's problem. */
 	for (i = 0; i < nnodes; i++)
 	{
-		if (RelFileNodeBackendIsTemp(rnodes[i]))
+		if (RelFileNodeBackendIsTemp(smgr_reln[i]->smgr_rnode))
 		{
-			if (rnodes[i].backend == MyBackendId)
-				DropRelFileNodeAllLocalBuffers(rnodes[i].node);
+			if (smgr_reln[i]->smgr_rnode.backend == MyBackendId)
+				DropRelFileNodeAllLocalBuffers(smgr_reln[i]->smgr_rnode.node);
 		}
 		else
-			nodes[n++] = rnodes[i].node;
+			rels[n++] = smgr_reln[i];
 	}
 
 	/*
@@ -3010,9 +3535,54 @@ DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes)
 	 */
 	if (n == 0)
 	{
-		pfree(nodes);
+		pfree(rels);
+		return;
+	}
+
+	/*
+	 * Add up the sizes of all the forks, to see whether looking up their
+	 * blocks one by one is cheaper than scanning the buffer pool.  We can
+	 * stop as soon as we know it's not, or that some size is unknown.
+	 */
+	nForkBlock = palloc(sizeof(*nForkBlock) * n);
+	for (i = 0; i < n && cached &&
+		 nBlocksToDrop < BUF_DROP_FULL_SCAN_THRESHOLD; i++)
+	{
+		ForkNumber	forkNum;
+
+		for (forkNum = 0; forkNum <= MAX_FORKNUM; forkNum++)
+		{
+			nForkBlock[i][forkNum] = DropRelFileNodeForkSize(rels[i], forkNum);
+			if (nForkBlock[i][forkNum] == InvalidBlockNumber)
+			{
+				cached = false;
+				break;
+			}
+			nBlocksToDrop += nForkBlock[i][forkNum];
+		}
+	}
+
+	if (cached && nBlocksToDrop < BUF_DROP_FULL_SCAN_THRESHOLD)
+	{
+		for (i = 0; i < n; i++)
+		{
+			ForkNumber	forkNum;
+
+			for (forkNum = 0; forkNum <= MAX_FORKNUM; forkNum++)
+				FindAndDropRelFileNodeBuffers(rels[i]->smgr_rnode.node,
+											  forkNum, nForkBlock[i][forkNum],
+											  0);
+		}
+		pfree(nForkBlock);
+		pfree(rels);
 		return;
 	}
+	pfree(nForkBlock);
+
+	nodes = palloc(sizeof(RelFileNode) * n);
+	for (i = 0; i < n; i++)
+		nodes[i] = rels[i]->smgr_rnode.node;
+	pfree(rels);
 
 	/*
 	 * For low number of relations to drop just use a simple walk through, to
@@ -4225,6 +4795,11 @@ ckpt_buforder_comparator(const void *pa, const void *pb)
 		return -1;
 	else if (a->tsId > b->tsId)
 		return 1;
+	/* compare database */
+	if (a->dbNode < b->dbNode)
+		return -1;
+	else if (a->dbNode > b->dbNode)
+		return 1;
 	/* compare relation */
 	if (a->relNode < b->relNode)
 		return -1;
@@ -15,6 +15,7 @@
  */
 #include "postgres.h"
 
+#include "miscadmin.h"
 #include "port/atomics.h"
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
@@ -22,29 +23,46 @@
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
+/*
+ * With clock_sweep_partitions = -1, use one partition per this many buffers,
+ * up to MAX_AUTO_CLOCK_SWEEP_PARTITIONS of them.
+ */
+#define BUFFERS_PER_AUTO_CLOCK_SWEEP_PARTITION	65536
+#define MAX_AUTO_CLOCK_SWEEP_PARTITIONS			64
 
 /*
- * The shared freelist control information.
+ * A backend sweeps another partition than its own if our clock hand is ahead
+ * of that partition's by more than this many passes, see
+ * ChooseClockSweepPartition().
+ */
+#define CLOCK_SWEEP_BALANCE_SLACK	0.125
+
+/* GUC variable */
+int			clock_sweep_partitions = -1;
+
+/*
+ * The buffer pool is divided into one or more clock sweep partitions, each
+ * a contiguous range of buffers with its own clock hand.  Every backend
+ * prefers to sweep the partition assigned to it, so that on large machines
+ * backends don't all contend for one hand, but it helps out in partitions
+ * whose hands lag behind, so that all the hands advance at about the same
+ * rate.
  */
 typedef struct
 {
-	/* Spinlock: protects the values below */
-	slock_t		buffer_strategy_lock;
+	/* Spinlock: protects completePasses, see ClockSweepTick() */
+	slock_t		lock;
 
 	/*
-	 * Clock sweep hand: index of next buffer to consider grabbing. Note that
-	 * this isn't a concrete buffer - we only ever increase the value. So, to
-	 * get an actual buffer, it needs to be used modulo NBuffers.
+	 * Clock sweep hand: index, relative to firstBuffer, of next buffer to
+	 * consider grabbing. Note that this isn't a concrete buffer - we only
+	 * ever increase the value. So, to get an actual buffer, it needs to be
+	 * used modulo numBuffers.
 	 */
 	pg_atomic_uint32 nextVictimBuffer;
 
-	int			firstFreeBuffer;	/* Head of list of unused buffers */
-	int			lastFreeBuffer; /* Tail of list of unused buffers */
-
-	/*
-	 * NOTE: lastFreeBuffer is undefined when firstFreeBuffer is -1 (that is,
-	 * when the list is empty)
-	 */
+	int			firstBuffer;	/* first buffer of the partition */
+	int			numBuffers;		/* number of buffers in the partition */
 
 	/*
 	 * Statistics.  These counters should be wide enough that they can't
@@ -52,17 +70,52 @@ typedef struct
 	 */
 	uint32		completePasses; /* Complete cycles of the clock sweep */
 	pg_atomic_uint32 numBufferAllocs;	/* Buffers allocated since last reset */
+} ClockSweepPartition;
+
+/* Clock sweep partitions are padded to avoid false sharing, too */
+typedef union ClockSweepPartitionPadded
+{
+	ClockSweepPartition part;
+	char		pad[PG_CACHE_LINE_SIZE];
+} ClockSweepPartitionPadded;
+
+/*
+ * The shared freelist control information.
+ */
+typedef struct
+{
+	/* Spinlock: protects the values below */
+	slock_t		buffer_strategy_lock;
+
+	int			firstFreeBuffer;	/* Head of list of unused buffers */
+	int			lastFreeBuffer; /* Tail of list of unused buffers */
+	int			numFreeBuffers; /* Length of the list */
+
+	/*
+	 * NOTE: lastFreeBuffer is undefined when firstFreeBuffer is -1 (that is,
+	 * when the list is empty)
+	 */
 
 	/*
 	 * Bgworker process to be notified upon activity or -1 if none. See
 	 * StrategyNotifyBgWriter.
 	 */
 	int			bgwprocno;
+
+	/* Clock sweep partitions; array is cache line aligned */
+	int			numPartitions;
+	ClockSweepPartitionPadded *partitions;
 } BufferStrategyControl;
 
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
 
+/* Index of the clock sweep partition this backend uses, or -1 if not yet */
+static int	MyClockSweepPartition = -1;
+
+/* Partition to compare ours with next, see ChooseClockSweepPartition() */
+static int	NextClockSweepCandidate = 0;
+
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
  * This is currently the only kind of BufferAccessStrategy object, but someday
@@ -103,14 +156,101 @@ static BufferDesc *GetBufferFromRing(BufferAccessStrategy strategy,
 static void AddBufferToRing(BufferAccessStrategy strategy,
 							BufferDesc *buf);
 
+/*
+ * ClockSweepNumPartitions - number of clock sweep partitions to create
+ */
+static int
+ClockSweepNumPartitions(void)
+{
+	int			nparts = clock_sweep_partitions;
+
+	if (nparts < 0)
+		nparts = Min(NBuffers / BUFFERS_PER_AUTO_CLOCK_SWEEP_PARTITION,
+					 MAX_AUTO_CLOCK_SWEEP_PARTITIONS);
+
+	return Max(Min(nparts, NBuffers), 1);
+}
+
+/*
+ * GetClockSweepPartition - get the partition this backend sweeps first
+ *
+ * Backends are spread over the partitions by their PGPROC number, which
+ * keeps the assignment stable and balanced across concurrent backends.
+ */
+static inline ClockSweepPartition *
+GetClockSweepPartition(void)
+{
+	if (MyClockSweepPartition < 0)
+	{
+		int			procno = MyProc ? MyProc->pgprocno : MyProcPid;
+
+		MyClockSweepPartition = procno % StrategyControl->numPartitions;
+	}
+
+	return &StrategyControl->partitions[MyClockSweepPartition].part;
+}
+
+/*
+ * ClockSweepProgress - how far the hand of a partition has come, in passes
+ *
+ * This is read without the partition's spinlock.  While a hand is being
+ * wrapped around, the result can be a pass short for a moment; that just
+ * makes us pick a partition that isn't quite the most deserving.
+ */
+static inline double
+ClockSweepProgress(ClockSweepPartition *part)
+{
+	uint32		nextVictimBuffer = pg_atomic_read_u32(&part->nextVictimBuffer);
+
+	return (double) part->completePasses +
+		(double) nextVictimBuffer / part->numBuffers;
+}
+
+/*
+ * ChooseClockSweepPartition - choose the partition to take a victim from
+ *
+ * That's normally our own partition.  But if fewer backends are evicting
+ * buffers than there are partitions, sweeping only their own partitions would
+ * leave the rest of the pool alone, while recycling the buffers of those
+ * partitions much faster than a single clock sweep would, hot pages
+ * included.  So we compare our hand with that of one other partition,
+ * taking the others in turn, and sweep that one instead if it's far enough
+ * behind.  That keeps all the hands moving at about the same rate relative
+ * to their partition's size, like a single hand would, however the backends
+ * are distributed.
+ */
+static inline ClockSweepPartition *
+ChooseClockSweepPartition(void)
+{
+	ClockSweepPartition *home = GetClockSweepPartition();
+	ClockSweepPartition *other;
+	int			nparts = StrategyControl->numPartitions;
+
+	if (nparts == 1)
+		return home;
+
+	if (++NextClockSweepCandidate >= nparts)
+		NextClockSweepCandidate = 0;
+	if (NextClockSweepCandidate == MyClockSweepPartition &&
+		++NextClockSweepCandidate >= nparts)
+		NextClockSweepCandidate = 0;
+	other = &StrategyControl->partitions[NextClockSweepCandidate].part;
+
+	if (ClockSweepProgress(home) >
+		ClockSweepProgress(other) + CLOCK_SWEEP_BALANCE_SLACK)
+		return other;
+
+	return home;
+}
+
 /*
  * ClockSweepTick - Helper routine for StrategyGetBuffer()
  *
- * Move the clock hand one buffer ahead of its current position and return the
- * id of the buffer now under the hand.
+ * Move the clock hand of the given partition one buffer ahead of its current
+ * position and return the id of the buffer now under the hand.
  */
 static inline uint32
-ClockSweepTick(void)
+ClockSweepTick(ClockSweepPartition *part)
 {
 	uint32		victim;
 
@@ -120,14 +260,14 @@ ClockSweepTick(void)
 	 * apparent order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&part->nextVictimBuffer, 1);
 
-	if (victim >= NBuffers)
+	if (victim >= part->numBuffers)
 	{
 		uint32		originalVictim = victim;
 
 		/* always wrap what we look up in BufferDescriptors */
-		victim = victim % NBuffers;
+		victim = victim % part->numBuffers;
 
 		/*
 		 * If we're the one that just caused a wraparound, force
@@ -153,19 +293,19 @@ ClockSweepTick(void)
 				 * could lead to an overflow of nextVictimBuffers, but that's
 				 * highly unlikely and wouldn't be particularly harmful.
 				 */
-				SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+				SpinLockAcquire(&part->lock);
 
-				wrapped = expected % NBuffers;
+				wrapped = expected % part->numBuffers;
 
-				success = pg_atomic_compare_exchange_u32(&StrategyControl->nextVictimBuffer,
+				success = pg_atomic_compare_exchange_u32(&part->nextVictimBuffer,
 														 &expected, wrapped);
 				if (success)
-					StrategyControl->completePasses++;
-				SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+					part->completePasses++;
+				SpinLockRelease(&part->lock);
 			}
 		}
 	}
-	return victim;
+	return part->firstBuffer + victim;
 }
 
 /*
@@ -201,8 +341,10 @@ BufferDesc *
 StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 {
 	BufferDesc *buf;
+	ClockSweepPartition *part;
 	int			bgwprocno;
 	int			trycounter;
+	int			partsleft;
 	uint32		local_buf_state;	/* to avoid repeated (de-)referencing */
 
 	/*
@@ -245,9 +387,11 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 	/*
 	 * We count buffer allocation requests so that the bgwriter can estimate
 	 * the rate of buffer consumption.  Note that buffers recycled by a
-	 * strategy object are intentionally not counted here.
+	 * strategy object are intentionally not counted here.  The allocation is
+	 * counted in the partition we'd sweep for it.
 	 */
-	pg_atomic_fetch_add_u32(&StrategyControl->numBufferAllocs, 1);
+	part = ChooseClockSweepPartition();
+	pg_atomic_fetch_add_u32(&part->numBufferAllocs, 1);
 
 	/*
 	 * First check, without acquiring the lock, whether there's buffers in the
@@ -284,6 +428,7 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 			/* Unconditionally remove buffer from freelist */
 			StrategyControl->firstFreeBuffer = buf->freeNext;
 			buf->freeNext = FREENEXT_NOT_IN_LIST;
+			StrategyControl->numFreeBuffers--;
 
 			/*
 			 * Release the lock so someone else can access the freelist while
@@ -293,10 +438,9 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 
 			/*
 			 * If the buffer is pinned or has a nonzero usage_count, we cannot
-			 * use it; discard it and retry.  (This can only happen if VACUUM
-			 * put a valid buffer in the freelist and then someone else used
-			 * it before we got to it.  It's probably impossible altogether as
-			 * of 8.3, but we'd better check anyway.)
+			 * use it; discard it and retry.  (This happens if the bgwriter
+			 * put a clean buffer in the freelist, see StrategyAddCleanBuffer,
+			 * and then someone else used it before we got to it.)
 			 */
 			local_buf_state = LockBufHdr(buf);
 			if (BUF_STATE_GET_REFCOUNT(local_buf_state) == 0
@@ -312,11 +456,16 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 		}
 	}
 
-	/* Nothing on the freelist, so run the "clock sweep" algorithm */
-	trycounter = NBuffers;
+	/*
+	 * Nothing on the freelist, so run the "clock sweep" algorithm in the
+	 * partition chosen above.  We only move on to other partitions if all
+	 * the buffers there are pinned.
+	 */
+	trycounter = part->numBuffers;
+	partsleft = StrategyControl->numPartitions;
 	for (;;)
 	{
-		buf = GetBufferDescriptor(ClockSweepTick());
+		buf = GetBufferDescriptor(ClockSweepTick(part));
 
 		/*
 		 * If the buffer is pinned or has a nonzero usage_count, we cannot use
@@ -330,7 +479,8 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 			{
 				local_buf_state -= BUF_USAGECOUNT_ONE;
 
-				trycounter = NBuffers;
+				trycounter = part->numBuffers;
+				partsleft = StrategyControl->numPartitions;
 			}
 			else
 			{
@@ -344,14 +494,23 @@ StrategyGetBuffer(BufferAccessStrategy strategy, uint32 *buf_state)
 		else if (--trycounter == 0)
 		{
 			/*
-			 * We've scanned all the buffers without making any state changes,
-			 * so all the buffers are pinned (or were when we looked at them).
-			 * We could hope that someone will free one eventually, but it's
-			 * probably better to fail than to risk getting stuck in an
-			 * infinite loop.
+			 * We've scanned all the buffers of the partition without making
+			 * any state changes, so all of them are pinned (or were when we
+			 * looked at them).  Move on to the next partition.  Once that has
+			 * happened in all partitions in a row, we could hope that someone
+			 * will free a buffer eventually, but it's probably better to fail
+			 * than to risk getting stuck in an infinite loop.
 			 */
-			UnlockBufHdr(buf, local_buf_state);
-			elog(ERROR, "no unpinned buffers available");
+			if (--partsleft == 0)
+			{
+				UnlockBufHdr(buf, local_buf_state);
+				elog(ERROR, "no unpinned buffers available");
+			}
+
+			part++;
+			if (part == &StrategyControl->partitions[StrategyControl->numPartitions].part)
+				part = &StrategyControl->partitions[0].part;
+			trycounter = part->numBuffers;
 		}
 		UnlockBufHdr(buf, local_buf_state);
 	}
@@ -375,48 +534,119 @@ StrategyFreeBuffer(BufferDesc *buf)
 		if (buf->freeNext < 0)
 			StrategyControl->lastFreeBuffer = buf->buf_id;
 		StrategyControl->firstFreeBuffer = buf->buf_id;
+		StrategyControl->numFreeBuffers++;
+	}
+
+	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+}
+
+/*
+ * StrategyAddCleanBuffer: append a clean, evictable buffer to the freelist
+ *
+ * The bgwriter uses this to keep a supply of buffers ready for
+ * StrategyGetBuffer(), so that backends needn't run the clock sweep, nor
+ * write out dirty victims themselves.  Unlike the unused buffers put there
+ * by StrategyFreeBuffer(), such a buffer still holds a valid page, which
+ * might be accessed again before anyone takes it off the list; it is then
+ * skipped by StrategyGetBuffer(), since it is pinned or has a nonzero usage
+ * count.  The buffer goes to the tail of the list, so that buffers are
+ * handed out in the order in which the bgwriter found them.
+ *
+ * Returns false if the buffer was already in the list.
+ */
+bool
+StrategyAddCleanBuffer(BufferDesc *buf)
+{
+	bool		added = false;
+
+	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
+
+	if (buf->freeNext == FREENEXT_NOT_IN_LIST)
+	{
+		buf->freeNext = FREENEXT_END_OF_LIST;
+		if (StrategyControl->firstFreeBuffer < 0)
+			StrategyControl->firstFreeBuffer = buf->buf_id;
+		else
+			GetBufferDescriptor(StrategyControl->lastFreeBuffer)->freeNext =
+				buf->buf_id;
+		StrategyControl->lastFreeBuffer = buf->buf_id;
+		StrategyControl->numFreeBuffers++;
+		added = true;
 	}
 
 	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+
+	return added;
+}
+
+/*
+ * StrategyFreelistLength: number of buffers currently in the freelist
+ *
+ * The result is read without locking, so it is only approximate.
+ */
+int
+StrategyFreelistLength(void)
+{
+	return INT_ACCESS_ONCE(StrategyControl->numFreeBuffers);
+}
+
+/*
+ * StrategyNumPartitions -- number of clock sweep partitions
+ */
+int
+StrategyNumPartitions(void)
+{
+	return StrategyControl->numPartitions;
 }
 
 /*
- * StrategySyncStart -- tell BufferSync where to start syncing
+ * StrategySyncStart -- tell BgBufferSync where to start syncing in a
+ *		clock sweep partition
  *
- * The result is the buffer index of the best buffer to sync first.
- * BufferSync() will proceed circularly around the buffer array from there.
+ * The partition's buffers are buffer IDs *first_buffer up to *first_buffer +
+ * *num_buffers - 1.  The result is the index, relative to *first_buffer, of
+ * the best buffer to sync first, which is where the partition's clock hand
+ * is.  BgBufferSync() will proceed circularly around the partition from
+ * there.
  *
- * In addition, we return the completed-pass count (which is effectively
- * the higher-order bits of nextVictimBuffer) and the count of recent buffer
- * allocs if non-NULL pointers are passed.  The alloc count is reset after
- * being read.
+ * In addition, we return the partition's completed-pass count (which is
+ * effectively the higher-order bits of nextVictimBuffer) and the count of
+ * recent buffer allocs from it if non-NULL pointers are passed.  The alloc
+ * count is reset after being read.
  */
 int
-StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc)
+StrategySyncStart(int partition, int *first_buffer, int *num_buffers,
+				  uint32 *complete_passes, uint32 *num_buf_alloc)
 {
+	ClockSweepPartition *part;
 	uint32		nextVictimBuffer;
 	int			result;
 
-	SpinLockAcquire(&StrategyControl->buffer_strategy_lock);
-	nextVictimBuffer = pg_atomic_read_u32(&StrategyControl->nextVictimBuffer);
-	result = nextVictimBuffer % NBuffers;
+	Assert(partition >= 0 && partition < StrategyControl->numPartitions);
+	part = &StrategyControl->partitions[partition].part;
+
+	SpinLockAcquire(&part->lock);
+	nextVictimBuffer = pg_atomic_read_u32(&part->nextVictimBuffer);
+	result = nextVictimBuffer % part->numBuffers;
 
 	if (complete_passes)
 	{
-		*complete_passes = StrategyControl->completePasses;
+		*complete_passes = part->completePasses;
 
 		/*
 		 * Additionally add the number of wraparounds that happened before
 		 * completePasses could be incremented. C.f. ClockSweepTick().
 		 */
-		*complete_passes += nextVictimBuffer / NBuffers;
+		*complete_passes += nextVictimBuffer / part->numBuffers;
 	}
 
 	if (num_buf_alloc)
-	{
-		*num_buf_alloc = pg_atomic_exchange_u32(&StrategyControl->numBufferAllocs, 0);
-	}
-	SpinLockRelease(&StrategyControl->buffer_strategy_lock);
+		*num_buf_alloc = pg_atomic_exchange_u32(&part->numBufferAllocs, 0);
+	SpinLockRelease(&part->lock);
+
+	*first_buffer = part->firstBuffer;
+	*num_buffers = part->numBuffers;
+
 	return result;
 }
 
@@ -461,6 +691,11 @@ StrategyShmemSize(void)
 	/* size of the shared replacement strategy control block */
 	size = add_size(size, MAXALIGN(sizeof(BufferStrategyControl)));
 
+	/* size of the clock sweep partitions, plus alignment padding */
+	size = add_size(size, mul_size(ClockSweepNumPartitions(),
+								   sizeof(ClockSweepPartitionPadded)));
+	size = add_size(size, PG_CACHE_LINE_SIZE);
+
 	return size;
 }
 
@@ -475,6 +710,7 @@ void
 StrategyInitialize(bool init)
 {
 	bool		found;
+	int			nparts = ClockSweepNumPartitions();
 
 	/*
 	 * Initialize the shared buffer lookup hashtable.
@@ -493,11 +729,15 @@ StrategyInitialize(bool init)
 	 */
 	StrategyControl = (BufferStrategyControl *)
 		ShmemInitStruct("Buffer Strategy Status",
-						sizeof(BufferStrategyControl),
+						MAXALIGN(sizeof(BufferStrategyControl)) +
+						nparts * sizeof(ClockSweepPartitionPadded) +
+						PG_CACHE_LINE_SIZE,
 						&found);
 
 	if (!found)
 	{
+		int			i;
+
 		/*
 		 * Only done once, usually in postmaster
 		 */
@@ -511,16 +751,38 @@ StrategyInitialize(bool init)
 		 */
 		StrategyControl->firstFreeBuffer = 0;
 		StrategyControl->lastFreeBuffer = NBuffers - 1;
-
-		/* Initialize the clock sweep pointer */
-		pg_atomic_init_u32(&StrategyControl->nextVictimBuffer, 0);
-
-		/* Clear statistics */
-		StrategyControl->completePasses = 0;
-		pg_atomic_init_u32(&StrategyControl->numBufferAllocs, 0);
+		StrategyControl->numFreeBuffers = NBuffers;
 
 		/* No pending notification */
 		StrategyControl->bgwprocno = -1;
+
+		/*
+		 * Divide the buffers evenly among the clock sweep partitions, the
+		 * first ones getting one more if it doesn't divide exactly.
+		 */
+		StrategyControl->numPartitions = nparts;
+		StrategyControl->partitions = (ClockSweepPartitionPadded *)
+			TYPEALIGN(PG_CACHE_LINE_SIZE,
+					  (char *) StrategyControl +
+					  MAXALIGN(sizeof(BufferStrategyControl)));
+
+		for (i = 0; i < nparts; i++)
+		{
+			ClockSweepPartition *part = &StrategyControl->partitions[i].part;
+
+			SpinLockInit(&part->lock);
+			part->firstBuffer = i * (NBuffers / nparts) +
+				Min(i, NBuffers % nparts);
+			part->numBuffers = NBuffers / nparts +
+				(i < NBuffers % nparts ? 1 : 0);
+
+			/* Initialize the clock sweep pointer */
+			pg_atomic_init_u32(&part->nextVictimBuffer, 0);
+
+			/* Clear statistics */
+			part->completePasses = 0;
+			pg_atomic_init_u32(&part->numBufferAllocs, 0);
+		}
 	}
 	else
 		Assert(!init);
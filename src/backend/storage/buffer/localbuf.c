@@ -38,6 +38,12 @@ typedef struct
 #define LocalBufHdrGetBlock(bufHdr) \
 	LocalBufferBlockPointers[-((bufHdr)->buf_id + 2)]
 
+/*
+ * The pool starts out with this many buffer headers and doubles as needed,
+ * up to temp_buffers.
+ */
+#define LOCAL_BUFFERS_INITIAL	64
+
 int			NLocBuffer = 0;		/* until buffers are initialized */
 
 BufferDesc *LocalBufferDescriptors = NULL;
@@ -45,11 +51,14 @@ Block	   *LocalBufferBlockPointers = NULL;
 int32	   *LocalRefCount = NULL;
 
 static int	nextFreeLocalBuf = 0;
+static int	nextUnusedLocalBuf = 0;	/* buffers from here on were never used */
 
 static HTAB *LocalBufHash = NULL;
 
 
 static void InitLocalBuffers(void);
+static void GrowLocalBuffers(void);
+static void WriteLocalBuffers(BufferDesc *bufHdr);
 static Block GetLocalBufferStorage(void);
 
 
@@ -161,42 +170,63 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 #endif
 
 	/*
-	 * Need to get a new buffer.  We use a clock sweep algorithm (essentially
-	 * the same as what freelist.c does now...)
+	 * Need to get a new buffer.  As long as the pool can still grow, take one
+	 * that has never been used, so that we don't evict anything before the
+	 * pool has reached temp_buffers.
 	 */
-	trycounter = NLocBuffer;
-	for (;;)
-	{
-		b = nextFreeLocalBuf;
-
-		if (++nextFreeLocalBuf >= NLocBuffer)
-			nextFreeLocalBuf = 0;
+	if (nextUnusedLocalBuf >= NLocBuffer && NLocBuffer < num_temp_buffers)
+		GrowLocalBuffers();
 
+	if (nextUnusedLocalBuf < NLocBuffer)
+	{
+		b = nextUnusedLocalBuf++;
 		bufHdr = GetLocalBufferDescriptor(b);
-
-		if (LocalRefCount[b] == 0)
+		buf_state = pg_atomic_read_u32(&bufHdr->state);
+		Assert(LocalRefCount[b] == 0);
+		LocalRefCount[b]++;
+		ResourceOwnerRememberBuffer(CurrentResourceOwner,
+									BufferDescriptorGetBuffer(bufHdr));
+	}
+	else
+	{
+		/*
+		 * Otherwise we use a clock sweep algorithm (essentially the same as
+		 * what freelist.c does now...)
+		 */
+		trycounter = NLocBuffer;
+		for (;;)
 		{
-			buf_state = pg_atomic_read_u32(&bufHdr->state);
+			b = nextFreeLocalBuf;
 
-			if (BUF_STATE_GET_USAGECOUNT(buf_state) > 0)
-			{
-				buf_state -= BUF_USAGECOUNT_ONE;
-				pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
-				trycounter = NLocBuffer;
-			}
-			else
+			if (++nextFreeLocalBuf >= NLocBuffer)
+				nextFreeLocalBuf = 0;
+
+			bufHdr = GetLocalBufferDescriptor(b);
+
+			if (LocalRefCount[b] == 0)
 			{
-				/* Found a usable buffer */
-				LocalRefCount[b]++;
-				ResourceOwnerRememberBuffer(CurrentResourceOwner,
-											BufferDescriptorGetBuffer(bufHdr));
-				break;
+				buf_state = pg_atomic_read_u32(&bufHdr->state);
+
+				if (BUF_STATE_GET_USAGECOUNT(buf_state) > 0)
+				{
+					buf_state -= BUF_USAGECOUNT_ONE;
+					pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
+					trycounter = NLocBuffer;
+				}
+				else
+				{
+					/* Found a usable buffer */
+					LocalRefCount[b]++;
+					ResourceOwnerRememberBuffer(CurrentResourceOwner,
+												BufferDescriptorGetBuffer(bufHdr));
+					break;
+				}
 			}
+			else if (--trycounter == 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+						 errmsg("no empty local buffer available")));
 		}
-		else if (--trycounter == 0)
-			ereport(ERROR,
-					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
-					 errmsg("no empty local buffer available")));
 	}
 
 	/*
@@ -205,26 +235,8 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	 */
 	if (buf_state & BM_DIRTY)
 	{
-		SMgrRelation oreln;
-		Page		localpage = (char *) LocalBufHdrGetBlock(bufHdr);
-
-		/* Find smgr relation for buffer */
-		oreln = smgropen(bufHdr->tag.rnode, MyBackendId);
-
-		PageSetChecksumInplace(localpage, bufHdr->tag.blockNum);
-
-		/* And write... */
-		smgrwrite(oreln,
-				  bufHdr->tag.forkNum,
-				  bufHdr->tag.blockNum,
-				  localpage,
-				  false);
-
-		/* Mark not-dirty now in case we error out below */
-		buf_state &= ~BM_DIRTY;
-		pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
-
-		pgBufferUsage.local_blks_written++;
+		WriteLocalBuffers(bufHdr);
+		buf_state = pg_atomic_read_u32(&bufHdr->state);
 	}
 
 	/*
@@ -272,6 +284,139 @@ LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum, BlockNumber blockNum,
 	return bufHdr;
 }
 
+/*
+ * WriteLocalBuffers -
+ *	  write out a dirty local buffer that is about to be reused
+ *
+ * Temp tables are typically filled in block order, so the blocks following
+ * the victim are likely to be in the pool and dirty as well; we write those
+ * that are not pinned along with it in one vectored write, and they become
+ * clean victims for the next few allocations.
+ */
+static void
+WriteLocalBuffers(BufferDesc *bufHdr)
+{
+	BufferDesc *run[LOCAL_BUFFER_IO_COMBINE];
+	char	   *pages[LOCAL_BUFFER_IO_COMBINE];
+	BufferTag	tag = bufHdr->tag;
+	SMgrRelation oreln;
+	int			nbufs = 0;
+	int			i;
+
+	run[nbufs++] = bufHdr;
+	while (nbufs < LOCAL_BUFFER_IO_COMBINE &&
+		   tag.blockNum < MaxBlockNumber)
+	{
+		LocalBufferLookupEnt *hresult;
+		uint32		buf_state;
+
+		tag.blockNum++;
+		hresult = (LocalBufferLookupEnt *)
+			hash_search(LocalBufHash, (void *) &tag, HASH_FIND, NULL);
+		if (!hresult || LocalRefCount[hresult->id] != 0)
+			break;
+		buf_state = pg_atomic_read_u32(&GetLocalBufferDescriptor(hresult->id)->state);
+		if (!(buf_state & BM_DIRTY))
+			break;
+		run[nbufs++] = GetLocalBufferDescriptor(hresult->id);
+	}
+
+	for (i = 0; i < nbufs; i++)
+	{
+		pages[i] = (char *) LocalBufHdrGetBlock(run[i]);
+		PageSetChecksumInplace((Page) pages[i], run[i]->tag.blockNum);
+	}
+
+	/* Find smgr relation for buffer, and write */
+	oreln = smgropen(bufHdr->tag.rnode, MyBackendId);
+	smgrwritev(oreln, bufHdr->tag.forkNum, bufHdr->tag.blockNum,
+			   pages, nbufs, false);
+
+	/* Mark not-dirty now in case we error out later */
+	for (i = 0; i < nbufs; i++)
+	{
+		uint32		buf_state = pg_atomic_read_u32(&run[i]->state);
+
+		buf_state &= ~BM_DIRTY;
+		pg_atomic_unlocked_write_u32(&run[i]->state, buf_state);
+	}
+
+	pgBufferUsage.local_blks_written += nbufs;
+}
+
+/*
+ * LocalReadAheadBuffers -
+ *	  read a run of consecutive blocks into local buffers at once
+ *
+ * Blocks blockNum .. blockNum + nblocks - 1 are read with one vectored read,
+ * stopping short at the first one that is already in local buffers.  They
+ * are left valid but unpinned, for the ReadBuffer calls that follow to find.
+ * This is used by streaming reads of temporary relations, where it saves
+ * a system call per block.  A page that fails verification is left invalid,
+ * so that reading it again reports the problem in the usual way.
+ */
+void
+LocalReadAheadBuffers(SMgrRelation smgr, ForkNumber forkNum,
+					  BlockNumber blockNum, int nblocks)
+{
+	int			ids[LOCAL_BUFFER_IO_COMBINE];
+	char	   *pages[LOCAL_BUFFER_IO_COMBINE];
+	int			n;
+	int			i;
+
+	/* Initialize local buffers if first request in this session */
+	if (LocalBufHash == NULL)
+		InitLocalBuffers();
+
+	/* Don't let read-ahead push much else out of a small pool */
+	nblocks = Min(nblocks, LOCAL_BUFFER_IO_COMBINE);
+	nblocks = Min(nblocks, num_temp_buffers / 4);
+
+	for (n = 0; n < nblocks; n++)
+	{
+		BufferTag	tag;
+		BufferDesc *bufHdr;
+		bool		found;
+
+		INIT_BUFFERTAG(tag, smgr->smgr_rnode.node, forkNum, blockNum + n);
+		if (hash_search(LocalBufHash, (void *) &tag, HASH_FIND, NULL))
+			break;
+
+		/*
+		 * Remember buffer IDs rather than descriptors; allocation may move
+		 * the descriptor array when the pool grows.
+		 */
+		ResourceOwnerEnlargeBuffers(CurrentResourceOwner);
+		bufHdr = LocalBufferAlloc(smgr, forkNum, blockNum + n, &found);
+		Assert(!found);
+		ids[n] = -(bufHdr->buf_id + 2);
+		pages[n] = (char *) LocalBufHdrGetBlock(bufHdr);
+	}
+
+	if (n == 0)
+		return;
+
+	smgrreadv(smgr, forkNum, blockNum, pages, n);
+	pgBufferUsage.local_blks_read += n;
+
+	for (i = 0; i < n; i++)
+	{
+		BufferDesc *bufHdr = GetLocalBufferDescriptor(ids[i]);
+
+		if (PageIsVerified((Page) pages[i], blockNum + i))
+		{
+			uint32		buf_state = pg_atomic_read_u32(&bufHdr->state);
+
+			buf_state |= BM_VALID;
+			pg_atomic_unlocked_write_u32(&bufHdr->state, buf_state);
+		}
+
+		LocalRefCount[ids[i]]--;
+		ResourceOwnerForgetBuffer(CurrentResourceOwner,
+								  BufferDescriptorGetBuffer(bufHdr));
+	}
+}
+
 /*
  * MarkLocalBufferDirty -
  *	  mark a local buffer dirty
@@ -404,12 +549,13 @@ DropRelFileNodeAllLocalBuffers(RelFileNode rnode)
  * InitLocalBuffers -
  *	  init the local buffer cache. Since most queries (esp. multi-user ones)
  *	  don't involve local buffers, we delay allocating actual memory for the
- *	  buffers until we need them; just make the buffer headers here.
+ *	  buffers until we need them; just make the first buffer headers here.
+ *	  GrowLocalBuffers adds more as needed.
  */
 static void
 InitLocalBuffers(void)
 {
-	int			nbufs = num_temp_buffers;
+	int			nbufs = Min(num_temp_buffers, LOCAL_BUFFERS_INITIAL);
 	HASHCTL		info;
 	int			i;
 
@@ -436,6 +582,7 @@ InitLocalBuffers(void)
 				 errmsg("out of memory")));
 
 	nextFreeLocalBuf = 0;
+	nextUnusedLocalBuf = 0;
 
 	/* initialize fields that need to start off nonzero */
 	for (i = 0; i < nbufs; i++)
@@ -475,6 +622,60 @@ InitLocalBuffers(void)
 	NLocBuffer = nbufs;
 }
 
+/*
+ * GrowLocalBuffers -
+ *	  double the number of local buffer headers, up to temp_buffers
+ *
+ * Local buffers are referenced by index, so the arrays can simply be
+ * reallocated; but any BufferDesc pointer into the old array is invalid
+ * afterwards.
+ */
+static void
+GrowLocalBuffers(void)
+{
+	int			oldbufs = NLocBuffer;
+	int			nbufs;
+	void	   *ptr;
+	int			i;
+
+	Assert(NLocBuffer < num_temp_buffers);
+	nbufs = Min((int64) oldbufs * 2, num_temp_buffers);
+
+	/* Don't update the array pointers until each realloc has succeeded */
+	ptr = realloc(LocalBufferDescriptors, nbufs * sizeof(BufferDesc));
+	if (ptr == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	LocalBufferDescriptors = (BufferDesc *) ptr;
+
+	ptr = realloc(LocalBufferBlockPointers, nbufs * sizeof(Block));
+	if (ptr == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	LocalBufferBlockPointers = (Block *) ptr;
+
+	ptr = realloc(LocalRefCount, nbufs * sizeof(int32));
+	if (ptr == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	LocalRefCount = (int32 *) ptr;
+
+	MemSet(LocalBufferDescriptors + oldbufs, 0,
+		   (nbufs - oldbufs) * sizeof(BufferDesc));
+	MemSet(LocalBufferBlockPointers + oldbufs, 0,
+		   (nbufs - oldbufs) * sizeof(Block));
+	MemSet(LocalRefCount + oldbufs, 0, (nbufs - oldbufs) * sizeof(int32));
+
+	/* see InitLocalBuffers */
+	for (i = oldbufs; i < nbufs; i++)
+		GetLocalBufferDescriptor(i)->buf_id = -i - 2;
+
+	NLocBuffer = nbufs;
+}
+
 /*
  * GetLocalBufferStorage - allocate memory for a local buffer
  *
@@ -515,13 +716,16 @@ GetLocalBufferStorage(void)
 
 		/* Start with a 16-buffer request; subsequent ones double each time */
 		num_bufs = Max(num_bufs_in_block * 2, 16);
-		/* But not more than what we need for all remaining local bufs */
-		num_bufs = Min(num_bufs, NLocBuffer - total_bufs_allocated);
+		/* But not more than the pool can still grow to */
+		num_bufs = Min(num_bufs, num_temp_buffers - total_bufs_allocated);
 		/* And don't overflow MaxAllocSize, either */
-		num_bufs = Min(num_bufs, MaxAllocSize / BLCKSZ);
+		num_bufs = Min(num_bufs, (MaxAllocSize - PG_IO_ALIGN_SIZE) / BLCKSZ);
 
+		/* Buffers are aligned for direct I/O, like shared buffers */
 		cur_block = (char *) MemoryContextAlloc(LocalBufferContext,
-												num_bufs * BLCKSZ);
+												num_bufs * BLCKSZ +
+												PG_IO_ALIGN_SIZE);
+		cur_block = (char *) TYPEALIGN(PG_IO_ALIGN_SIZE, cur_block);
 		next_buf_in_block = 0;
 		num_bufs_in_block = num_bufs;
 	}
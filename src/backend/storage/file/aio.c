@@ -0,0 +1,360 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.c
+ *	  Batched asynchronous execution of file operations.
+ *
+ * Callers that have several independent file operations to perform, such as
+ * the checkpointer's fsync phase, hand them to pgaio_execute() as one batch.
+ * With io_method = io_uring the whole batch is submitted to the kernel with
+ * a single system call and the kernel is free to work on all of them
+ * concurrently; we then wait until every one of them has completed.  With
+ * io_method = sync, or when io_uring can't be set up in this process, the
+ * operations are simply performed one after another, so callers never need
+ * to care which method is in effect.
+ *
+ * We drive io_uring through its raw system call interface rather than
+ * through a library.  The ring is created lazily, once per process, the
+ * first time a batch is executed.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/file/aio.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <unistd.h>
+
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "port/pg_iovec.h"
+#include "storage/aio.h"
+#include "storage/fd.h"
+#include "utils/guc.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define USE_IO_URING
+#endif
+#endif
+
+/* GUC variable */
+int			io_method = IOMETHOD_SYNC;
+
+const struct config_enum_entry io_method_options[] = {
+	{"sync", IOMETHOD_SYNC, false},
+#ifdef USE_IO_URING
+	{"io_uring", IOMETHOD_IO_URING, false},
+#endif
+	{NULL, 0, false}
+};
+
+#ifdef USE_IO_URING
+
+/*
+ * Process-local state of our io_uring instance.  The head and tail pointers
+ * point into memory shared with the kernel.
+ */
+typedef struct PgAioUring
+{
+	int			ring_fd;
+
+	/* submission queue */
+	unsigned   *sq_head;
+	unsigned   *sq_tail;
+	unsigned   *sq_mask;
+	unsigned   *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned	sq_entries;
+
+	/* completion queue */
+	unsigned   *cq_head;
+	unsigned   *cq_tail;
+	unsigned   *cq_mask;
+	struct io_uring_cqe *cqes;
+} PgAioUring;
+
+static PgAioUring uring;
+
+/* ring_state: 0 = not yet tried, 1 = ready, -1 = unavailable */
+static int	ring_state = 0;
+
+static bool pgaio_uring_init(void);
+static void pgaio_uring_execute(PgAioOp *ops, int nops);
+#endif							/* USE_IO_URING */
+
+static void pgaio_sync_execute(PgAioOp *ops, int nops);
+
+
+/*
+ * pgaio_batching_enabled -- will pgaio_execute() overlap operations?
+ *
+ * Callers can use this to decide whether it is worth accumulating a batch
+ * at all, which typically means keeping more files open than otherwise.
+ */
+bool
+pgaio_batching_enabled(void)
+{
+#ifdef USE_IO_URING
+	if (io_method == IOMETHOD_IO_URING)
+		return ring_state == 1 || (ring_state == 0 && pgaio_uring_init());
+#endif
+	return false;
+}
+
+/*
+ * pgaio_execute -- perform a batch of file operations, wait for all of them
+ *
+ * On return, ops[i].result holds the outcome of each operation.  Errors are
+ * never thrown here; interpreting them is up to the caller, who knows which
+ * file each descriptor belongs to.
+ */
+void
+pgaio_execute(PgAioOp *ops, int nops, uint32 wait_event_info)
+{
+	pgstat_report_wait_start(wait_event_info);
+
+#ifdef USE_IO_URING
+	if (pgaio_batching_enabled())
+	{
+		while (nops > 0)
+		{
+			int			n = Min(nops, (int) uring.sq_entries);
+
+			pgaio_uring_execute(ops, n);
+			ops += n;
+			nops -= n;
+		}
+		pgstat_report_wait_end();
+		return;
+	}
+#endif
+
+	pgaio_sync_execute(ops, nops);
+
+	pgstat_report_wait_end();
+}
+
+/*
+ * Perform the operations synchronously, in order.
+ */
+static void
+pgaio_sync_execute(PgAioOp *ops, int nops)
+{
+	int			i;
+
+	for (i = 0; i < nops; i++)
+	{
+		PgAioOp    *op = &ops[i];
+		ssize_t		rc;
+
+		switch (op->type)
+		{
+			case PGAIO_OP_FSYNC:
+				rc = pg_fsync(op->fd);
+				break;
+			case PGAIO_OP_FDATASYNC:
+				rc = pg_fdatasync(op->fd);
+				break;
+			case PGAIO_OP_READV:
+				rc = pg_preadv(op->fd, op->iov, op->iovcnt, op->offset);
+				break;
+			case PGAIO_OP_WRITEV:
+				rc = pg_pwritev(op->fd, op->iov, op->iovcnt, op->offset);
+				break;
+			default:
+				elog(ERROR, "unrecognized AIO operation type: %d",
+					 (int) op->type);
+				rc = -1;		/* keep compiler quiet */
+				break;
+		}
+		op->result = (rc < 0) ? -errno : (int) rc;
+	}
+}
+
+#ifdef USE_IO_URING
+
+/*
+ * Set up this process's ring.  On failure, log why and remember not to try
+ * again, so that the caller falls back to synchronous execution.
+ */
+static bool
+pgaio_uring_init(void)
+{
+	struct io_uring_params p;
+	size_t		sq_size;
+	size_t		cq_size;
+	char	   *sq_ptr;
+	char	   *cq_ptr;
+	int			fd;
+
+	Assert(ring_state == 0);
+	ring_state = -1;
+
+	memset(&p, 0, sizeof(p));
+	fd = syscall(__NR_io_uring_setup, PGAIO_MAX_BATCH, &p);
+	if (fd < 0)
+	{
+		elog(LOG, "could not set up io_uring, falling back to synchronous I/O: %m");
+		return false;
+	}
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		sq_size = cq_size = Max(sq_size, cq_size);
+
+	sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		goto fail;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		cq_ptr = sq_ptr;
+	else
+	{
+		cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+			goto fail;
+	}
+
+	uring.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+					  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  fd, IORING_OFF_SQES);
+	if (uring.sqes == MAP_FAILED)
+		goto fail;
+
+	uring.ring_fd = fd;
+	uring.sq_head = (unsigned *) (sq_ptr + p.sq_off.head);
+	uring.sq_tail = (unsigned *) (sq_ptr + p.sq_off.tail);
+	uring.sq_mask = (unsigned *) (sq_ptr + p.sq_off.ring_mask);
+	uring.sq_array = (unsigned *) (sq_ptr + p.sq_off.array);
+	uring.sq_entries = p.sq_entries;
+	uring.cq_head = (unsigned *) (cq_ptr + p.cq_off.head);
+	uring.cq_tail = (unsigned *) (cq_ptr + p.cq_off.tail);
+	uring.cq_mask = (unsigned *) (cq_ptr + p.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe *) (cq_ptr + p.cq_off.cqes);
+
+	ring_state = 1;
+	return true;
+
+fail:
+	/* any mappings made so far are leaked, but we only get here once */
+	elog(LOG, "could not map io_uring queues, falling back to synchronous I/O: %m");
+	close(fd);
+	return false;
+}
+
+/*
+ * Submit nops operations (no more than the ring size) and wait for all of
+ * them to complete.
+ */
+static void
+pgaio_uring_execute(PgAioOp *ops, int nops)
+{
+	unsigned	tail;
+	unsigned	mask = *uring.sq_mask;
+	int			nsubmitted = 0;
+	int			ncompleted = 0;
+	int			i;
+
+	Assert(nops <= (int) uring.sq_entries);
+
+	/* Fill in submission queue entries; we are the only producer */
+	tail = *uring.sq_tail;
+	for (i = 0; i < nops; i++)
+	{
+		PgAioOp    *op = &ops[i];
+		unsigned	idx = tail & mask;
+		struct io_uring_sqe *sqe = &uring.sqes[idx];
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->fd = op->fd;
+		sqe->user_data = i;
+		switch (op->type)
+		{
+			case PGAIO_OP_FSYNC:
+				/* honor fsync = off, as pg_fsync() would */
+				sqe->opcode = enableFsync ? IORING_OP_FSYNC : IORING_OP_NOP;
+				break;
+			case PGAIO_OP_FDATASYNC:
+				sqe->opcode = enableFsync ? IORING_OP_FSYNC : IORING_OP_NOP;
+				sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+				break;
+			case PGAIO_OP_READV:
+				sqe->opcode = IORING_OP_READV;
+				sqe->addr = (uint64) (uintptr_t) op->iov;
+				sqe->len = op->iovcnt;
+				sqe->off = op->offset;
+				break;
+			case PGAIO_OP_WRITEV:
+				sqe->opcode = IORING_OP_WRITEV;
+				sqe->addr = (uint64) (uintptr_t) op->iov;
+				sqe->len = op->iovcnt;
+				sqe->off = op->offset;
+				break;
+			default:
+				elog(ERROR, "unrecognized AIO operation type: %d",
+					 (int) op->type);
+		}
+		uring.sq_array[idx] = idx;
+		tail++;
+	}
+
+	/* Make the entries visible to the kernel before publishing the tail */
+	pg_write_barrier();
+	*(volatile unsigned *) uring.sq_tail = tail;
+
+	/*
+	 * Submit, and then wait for completions.  A submission interrupted by a
+	 * signal is simply retried; nothing has been consumed in that case.
+	 */
+	while (ncompleted < nops)
+	{
+		unsigned	head;
+		unsigned	cq_tail;
+		int			rc;
+
+		rc = syscall(__NR_io_uring_enter, uring.ring_fd,
+					 nops - nsubmitted, 1, IORING_ENTER_GETEVENTS,
+					 NULL, 0);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			/*
+			 * There's no reasonable way to recover from a ring that has
+			 * stopped working with operations in flight.
+			 */
+			elog(PANIC, "io_uring_enter failed: %m");
+		}
+		nsubmitted += rc;
+
+		/* Reap whatever has completed */
+		head = *(volatile unsigned *) uring.cq_head;
+		cq_tail = *(volatile unsigned *) uring.cq_tail;
+		pg_read_barrier();
+		while (head != cq_tail)
+		{
+			struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+
+			Assert(cqe->user_data < (uint64) nops);
+			ops[cqe->user_data].result = cqe->res;
+			ncompleted++;
+			head++;
+		}
+		pg_memory_barrier();
+		*(volatile unsigned *) uring.cq_head = head;
+	}
+}
+
+#endif							/* USE_IO_URING */
@@ -36,18 +36,26 @@
  * other backends, as infrastructure for parallel execution.  Such files need
  * to be created as a member of a SharedFileSet that all participants are
  * attached to.
+ *
+ * BufFile can also compress the data of private temporary files that are
+ * written once and then read back sequentially, such as hash join batch
+ * files.  Each buffer is then written out as a separately compressed block
+ * of variable size, so such files can't be positioned anywhere except at
+ * their start; see BufFileCreateCompressedTemp.
  *-------------------------------------------------------------------------
  */
 
 #include "postgres.h"
 
 #include "commands/tablespace.h"
+#include "common/pg_lzcompress.h"
 #include "executor/instrument.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/fd.h"
 #include "storage/buffile.h"
 #include "storage/buf_internals.h"
+#include "utils/guc.h"
 #include "utils/resowner.h"
 
 /*
@@ -58,6 +66,26 @@
 #define MAX_PHYSICAL_FILESIZE	0x40000000
 #define BUFFILE_SEG_SIZE		(MAX_PHYSICAL_FILESIZE / BLCKSZ)
 
+/*
+ * Header of each block of a compressed BufFile.  If len == rawlen, the data
+ * is stored uncompressed, because it didn't compress well.
+ */
+typedef struct BufFileBlockHeader
+{
+	int32		rawlen;			/* # of bytes of the buffer */
+	int32		len;			/* # of bytes stored after the header */
+} BufFileBlockHeader;
+
+/*
+ * Scratch space for compressing and decompressing one block.  Compression is
+ * synchronous, so all compressed BufFiles can share it.
+ */
+static union
+{
+	BufFileBlockHeader hdr;
+	char		data[sizeof(BufFileBlockHeader) + PGLZ_MAX_OUTPUT(BLCKSZ)];
+} compressBuffer;
+
 /*
  * This data structure represents a buffered file that consists of one or
  * more physical files (each accessed through a virtual file descriptor
@@ -72,6 +100,7 @@ struct BufFile
 	bool		isInterXact;	/* keep open over transactions? */
 	bool		dirty;			/* does buffer need to be written? */
 	bool		readOnly;		/* has the file been set to read only? */
+	bool		compress;		/* are the blocks compressed? */
 
 	SharedFileSet *fileset;		/* space for segment files if shared */
 	const char *name;			/* name of this BufFile if shared */
@@ -86,6 +115,9 @@ struct BufFile
 	/*
 	 * "current pos" is position of start of buffer within the logical file.
 	 * Position as seen by user of BufFile is (curFile, curOffset + pos).
+	 *
+	 * In a compressed file, curOffset is instead the physical position of the
+	 * next block to read or write.
 	 */
 	int			curFile;		/* file index (0..n) part of current pos */
 	off_t		curOffset;		/* offset part of current pos */
@@ -99,6 +131,8 @@ static BufFile *makeBufFile(File firstfile);
 static void extendBufFile(BufFile *file);
 static void BufFileLoadBuffer(BufFile *file);
 static void BufFileDumpBuffer(BufFile *file);
+static void BufFileLoadCompressedBuffer(BufFile *file);
+static void BufFileDumpCompressedBuffer(BufFile *file);
 static int	BufFileFlush(BufFile *file);
 static File MakeNewSharedSegment(BufFile *file, int segment);
 
@@ -113,6 +147,7 @@ makeBufFileCommon(int nfiles)
 	file->numFiles = nfiles;
 	file->isInterXact = false;
 	file->dirty = false;
+	file->compress = false;
 	file->resowner = CurrentResourceOwner;
 	file->curFile = 0;
 	file->curOffset = 0L;
@@ -206,6 +241,24 @@ BufFileCreateTemp(bool interXact)
 	return file;
 }
 
+/*
+ * Create a BufFile for a new temporary file like BufFileCreateTemp, whose
+ * contents are compressed if temp_file_compression is enabled.
+ *
+ * The file must be written sequentially, and then read sequentially after
+ * rewinding it with BufFileSeek(file, 0, 0L, SEEK_SET); no other seeks are
+ * allowed.
+ */
+BufFile *
+BufFileCreateCompressedTemp(bool interXact)
+{
+	BufFile    *file = BufFileCreateTemp(interXact);
+
+	file->compress = temp_file_compression;
+
+	return file;
+}
+
 /*
  * Build the name for a given segment of a given BufFile.
  */
@@ -414,6 +467,12 @@ BufFileLoadBuffer(BufFile *file)
 {
 	File		thisfile;
 
+	if (file->compress)
+	{
+		BufFileLoadCompressedBuffer(file);
+		return;
+	}
+
 	/*
 	 * Advance to next component file if necessary and possible.
 	 */
@@ -455,6 +514,12 @@ BufFileDumpBuffer(BufFile *file)
 	int			bytestowrite;
 	File		thisfile;
 
+	if (file->compress)
+	{
+		BufFileDumpCompressedBuffer(file);
+		return;
+	}
+
 	/*
 	 * Unlike BufFileLoadBuffer, we must dump the whole buffer even if it
 	 * crosses a component-file boundary; so we need a loop.
@@ -519,6 +584,114 @@ BufFileDumpBuffer(BufFile *file)
 	file->nbytes = 0;
 }
 
+/*
+ * BufFileLoadCompressedBuffer
+ *
+ * Like BufFileLoadBuffer, for a compressed file: read and decompress the
+ * block starting at curOffset, and advance curOffset past it.
+ */
+static void
+BufFileLoadCompressedBuffer(BufFile *file)
+{
+	BufFileBlockHeader *hdr = &compressBuffer.hdr;
+	char	   *data = compressBuffer.data + sizeof(BufFileBlockHeader);
+	File		thisfile;
+	int			nread;
+
+	for (;;)
+	{
+		thisfile = file->files[file->curFile];
+		nread = FileRead(thisfile, (char *) hdr, sizeof(BufFileBlockHeader),
+						 file->curOffset, WAIT_EVENT_BUFFILE_READ);
+		if (nread != 0 || file->curFile + 1 >= file->numFiles)
+			break;
+
+		/* end of this component file, advance to the next one */
+		file->curFile++;
+		file->curOffset = 0L;
+	}
+
+	if (nread <= 0)
+		return;					/* EOF, or read error */
+
+	if (nread != sizeof(BufFileBlockHeader) ||
+		hdr->rawlen <= 0 || hdr->rawlen > BLCKSZ ||
+		hdr->len <= 0 || hdr->len > hdr->rawlen ||
+		FileRead(thisfile, data, hdr->len,
+				 file->curOffset + sizeof(BufFileBlockHeader),
+				 WAIT_EVENT_BUFFILE_READ) != hdr->len)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read compressed block of temporary file")));
+
+	if (hdr->len == hdr->rawlen)
+		memcpy(file->buffer.data, data, hdr->len);
+	else if (pglz_decompress(data, hdr->len, file->buffer.data,
+							 hdr->rawlen, true) != hdr->rawlen)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg_internal("compressed block of temporary file is corrupt")));
+
+	file->curOffset += sizeof(BufFileBlockHeader) + hdr->len;
+	file->nbytes = hdr->rawlen;
+
+	pgBufferUsage.temp_blks_read++;
+}
+
+/*
+ * BufFileDumpCompressedBuffer
+ *
+ * Like BufFileDumpBuffer, for a compressed file: compress the buffer and
+ * write it out as a block at curOffset.  Blocks are never split across
+ * component files; we start a new one when the current one is full.
+ */
+static void
+BufFileDumpCompressedBuffer(BufFile *file)
+{
+	BufFileBlockHeader *hdr = &compressBuffer.hdr;
+	char	   *data = compressBuffer.data + sizeof(BufFileBlockHeader);
+	int32		len;
+	int			bytestowrite;
+
+	/* compressed files are written strictly sequentially */
+	Assert(file->pos == file->nbytes);
+
+	len = pglz_compress(file->buffer.data, file->nbytes, data,
+						PGLZ_strategy_default);
+	if (len < 0 || len >= file->nbytes)
+	{
+		/* not compressible, store it as is */
+		memcpy(data, file->buffer.data, file->nbytes);
+		len = file->nbytes;
+	}
+	hdr->rawlen = file->nbytes;
+	hdr->len = len;
+
+	/*
+	 * Advance to next component file if necessary.
+	 */
+	if (file->curOffset >= MAX_PHYSICAL_FILESIZE)
+	{
+		while (file->curFile + 1 >= file->numFiles)
+			extendBufFile(file);
+		file->curFile++;
+		file->curOffset = 0L;
+	}
+
+	bytestowrite = sizeof(BufFileBlockHeader) + len;
+	if (FileWrite(file->files[file->curFile], compressBuffer.data,
+				  bytestowrite, file->curOffset,
+				  WAIT_EVENT_BUFFILE_WRITE) != bytestowrite)
+		return;					/* failed to write */
+	file->curOffset += bytestowrite;
+
+	pgBufferUsage.temp_blks_written++;
+
+	file->dirty = false;
+	file->pos = 0;
+	file->nbytes = 0;
+}
+
 /*
  * BufFileRead
  *
@@ -542,7 +715,8 @@ BufFileRead(BufFile *file, void *ptr, size_t size)
 		if (file->pos >= file->nbytes)
 		{
 			/* Try to load more data into buffer. */
-			file->curOffset += file->pos;
+			if (!file->compress)
+				file->curOffset += file->pos;
 			file->pos = 0;
 			file->nbytes = 0;
 			BufFileLoadBuffer(file);
@@ -593,6 +767,7 @@ BufFileWrite(BufFile *file, void *ptr, size_t size)
 			else
 			{
 				/* Hmm, went directly from reading to writing? */
+				Assert(!file->compress);
 				file->curOffset += file->pos;
 				file->pos = 0;
 				file->nbytes = 0;
@@ -652,6 +827,20 @@ BufFileSeek(BufFile *file, int fileno, off_t offset, int whence)
 	int			newFile;
 	off_t		newOffset;
 
+	if (file->compress)
+	{
+		/* compressed files can only be rewound */
+		if (whence != SEEK_SET || fileno != 0 || offset != 0)
+			elog(ERROR, "cannot seek in a compressed temporary file");
+		if (BufFileFlush(file) != 0)
+			return EOF;
+		file->curFile = 0;
+		file->curOffset = 0L;
+		file->pos = 0;
+		file->nbytes = 0;
+		return 0;
+	}
+
 	switch (whence)
 	{
 		case SEEK_SET:
@@ -757,6 +946,39 @@ BufFileSeekBlock(BufFile *file, long blknum)
 					   SEEK_SET);
 }
 
+/*
+ * BufFilePrefetchBlocks --- initiate asynchronous read of a range of blocks
+ *
+ * Tells the kernel that the given BLCKSZ-sized blocks of the file are likely
+ * to be read soon, so that they can be read in while the caller is busy with
+ * something else.  This is only a hint: blocks beyond the end of the file are
+ * silently ignored, and so are errors.
+ */
+void
+BufFilePrefetchBlocks(BufFile *file, long blknum, int nblocks)
+{
+#ifdef USE_PREFETCH
+	while (nblocks > 0)
+	{
+		int			fileno = (int) (blknum / BUFFILE_SEG_SIZE);
+		long		segblk = blknum % BUFFILE_SEG_SIZE;
+		int			thistime;
+
+		if (fileno >= file->numFiles)
+			break;
+
+		/* don't cross a segment boundary */
+		thistime = (int) Min((long) nblocks, BUFFILE_SEG_SIZE - segblk);
+
+		(void) FilePrefetch(file->files[fileno], (off_t) segblk * BLCKSZ,
+							thistime * BLCKSZ, WAIT_EVENT_BUFFILE_READ);
+
+		blknum += thistime;
+		nblocks -= thistime;
+	}
+#endif							/* USE_PREFETCH */
+}
+
 #ifdef NOT_USED
 /*
  * BufFileTellBlock --- block-oriented tell
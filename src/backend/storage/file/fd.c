@@ -85,11 +85,14 @@
 #include "catalog/pg_tablespace.h"
 #include "common/file_perm.h"
 #include "pgstat.h"
+#include "port/pg_iovec.h"
 #include "portability/mem.h"
+#include "storage/aio.h"
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "utils/guc.h"
 #include "utils/resowner_private.h"
+#include "utils/varlena.h"
 
 
 /* Define PG_FLUSH_DATA_WORKS if we have an implementation for pg_flush_data */
@@ -148,6 +151,10 @@ int			max_safe_fds = 32;	/* default if not changed */
 /* Whether it is safe to continue running after fsync() fails. */
 bool		data_sync_retry = false;
 
+/* Which files to open with O_DIRECT; see check_io_direct() */
+char	   *io_direct_string;
+int			io_direct_flags;
+
 /* Debugging.... */
 
 #ifdef FDDEBUG
@@ -1860,15 +1867,35 @@ int
 FileRead(File file, char *buffer, int amount, off_t offset,
 		 uint32 wait_event_info)
 {
-	int			returnCode;
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+
+	return (int) FileReadV(file, &iov, 1, offset, wait_event_info);
+}
+
+/*
+ * FileReadV --- read into several buffers with a single system call
+ *
+ * The buffers are filled in order from consecutive file offsets starting at
+ * "offset".  As with FileRead, a short read is not an error; the caller must
+ * check the returned byte count.
+ */
+ssize_t
+FileReadV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		  uint32 wait_event_info)
+{
+	ssize_t		returnCode;
 	Vfd		   *vfdP;
 
 	Assert(FileIsValid(file));
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
 
-	DO_DB(elog(LOG, "FileRead: %d (%s) " INT64_FORMAT " %d %p",
+	DO_DB(elog(LOG, "FileReadV: %d (%s) " INT64_FORMAT " %d %p",
 			   file, VfdCache[file].fileName,
 			   (int64) offset,
-			   amount, buffer));
+			   iovcnt, iov[0].iov_base));
 
 	returnCode = FileAccess(file);
 	if (returnCode < 0)
@@ -1878,7 +1905,7 @@ FileRead(File file, char *buffer, int amount, off_t offset,
 
 retry:
 	pgstat_report_wait_start(wait_event_info);
-	returnCode = pg_pread(vfdP->fd, buffer, amount, offset);
+	returnCode = pg_preadv(vfdP->fd, iov, iovcnt, offset);
 	pgstat_report_wait_end();
 
 	if (returnCode < 0)
@@ -1916,15 +1943,40 @@ int
 FileWrite(File file, char *buffer, int amount, off_t offset,
 		  uint32 wait_event_info)
 {
-	int			returnCode;
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len = amount;
+
+	return (int) FileWriteV(file, &iov, 1, offset, wait_event_info);
+}
+
+/*
+ * FileWriteV --- write out several buffers with a single system call
+ *
+ * The buffers are written in order to consecutive file offsets starting at
+ * "offset".  Like FileWrite, a short write sets errno to ENOSPC if the
+ * kernel didn't say why.
+ */
+ssize_t
+FileWriteV(File file, const struct iovec *iov, int iovcnt, off_t offset,
+		   uint32 wait_event_info)
+{
+	ssize_t		returnCode;
 	Vfd		   *vfdP;
+	size_t		amount = 0;
+	int			i;
 
 	Assert(FileIsValid(file));
+	Assert(iovcnt > 0 && iovcnt <= PG_IOV_MAX);
+
+	for (i = 0; i < iovcnt; i++)
+		amount += iov[i].iov_len;
 
-	DO_DB(elog(LOG, "FileWrite: %d (%s) " INT64_FORMAT " %d %p",
+	DO_DB(elog(LOG, "FileWriteV: %d (%s) " INT64_FORMAT " %zu %p",
 			   file, VfdCache[file].fileName,
 			   (int64) offset,
-			   amount, buffer));
+			   amount, iov[0].iov_base));
 
 	returnCode = FileAccess(file);
 	if (returnCode < 0)
@@ -1960,7 +2012,7 @@ FileWrite(File file, char *buffer, int amount, off_t offset,
 retry:
 	errno = 0;
 	pgstat_report_wait_start(wait_event_info);
-	returnCode = pg_pwrite(VfdCache[file].fd, buffer, amount, offset);
+	returnCode = pg_pwritev(VfdCache[file].fd, iov, iovcnt, offset);
 	pgstat_report_wait_end();
 
 	/* if write didn't set errno, assume problem is no disk space */
@@ -1990,7 +2042,7 @@ retry:
 	else
 	{
 		/*
-		 * See comments in FileRead()
+		 * See comments in FileReadV()
 		 */
 #ifdef WIN32
 		DWORD		error = GetLastError();
@@ -2014,6 +2066,109 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileZero --- write zeroes to a range of the file
+ *
+ * Returns 0 on success, -1 otherwise.  In the latter case errno is set
+ * appropriately; a short write is reported as ENOSPC.
+ */
+int
+FileZero(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+	static const PGAlignedBlock zbuffer = {{0}};
+	struct iovec iov[PG_IOV_MAX];
+	int			i;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileZero: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	for (i = 0; i < PG_IOV_MAX; i++)
+	{
+		iov[i].iov_base = (char *) zbuffer.data;
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	while (amount > 0)
+	{
+		int			iovcnt = Min((amount + BLCKSZ - 1) / BLCKSZ, PG_IOV_MAX);
+		size_t		chunk = Min(amount, (off_t) iovcnt * BLCKSZ);
+		ssize_t		written;
+
+		iov[iovcnt - 1].iov_len = chunk - (size_t) (iovcnt - 1) * BLCKSZ;
+		written = FileWriteV(file, iov, iovcnt, offset, wait_event_info);
+		iov[iovcnt - 1].iov_len = BLCKSZ;
+
+		if (written < 0)
+			return -1;
+		if (written != chunk)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			return -1;
+		}
+
+		offset += chunk;
+		amount -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * FileFallocate --- allocate a range of the file, reading back as zeroes
+ *
+ * This uses posix_fallocate() where available, which lets the filesystem
+ * reserve the space without the cost of actually writing it.  Elsewhere, or
+ * if the filesystem doesn't support it, we fall back to FileZero().  Not for
+ * use on temporary files, as the space isn't counted against temp_file_limit.
+ *
+ * Returns 0 on success, -1 otherwise, with errno set.
+ */
+int
+FileFallocate(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+	Assert(!(VfdCache[file].fdstate & FD_TEMP_FILE_LIMIT));
+
+	DO_DB(elog(LOG, "FileFallocate: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return -1;
+
+retry:
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	pgstat_report_wait_end();
+
+	if (returnCode == 0)
+		return 0;
+	else if (returnCode == EINTR)
+		goto retry;
+
+	/* for compatibility with %m printing etc */
+	errno = returnCode;
+
+	/*
+	 * Return in cases of a "real" failure; if fallocate is not supported,
+	 * fall through to the FileZero() backed implementation.
+	 */
+	if (returnCode != EINVAL && returnCode != EOPNOTSUPP)
+		return -1;
+#endif
+
+	return FileZero(file, offset, amount, wait_event_info);
+}
+
 int
 FileSync(File file, uint32 wait_event_info)
 {
@@ -2035,6 +2190,59 @@ FileSync(File file, uint32 wait_event_info)
 	return returnCode;
 }
 
+
+/*
+ * FileSyncBatch --- fsync several files, letting the kernel overlap them
+ *
+ * results[i] is set to 0 if files[i] was synced successfully, else to the
+ * errno value describing the failure.  The files are handed to the kernel
+ * in as few batches as possible (see aio.c), so with io_method = io_uring
+ * the kernel can flush all of them concurrently.
+ *
+ * All files of a batch must be physically open at the same time, so we
+ * never put more than half of max_safe_fds into one; otherwise opening the
+ * last of them could make the LRU logic close the first.
+ */
+void
+FileSyncBatch(File *files, int nfiles, int *results, uint32 wait_event_info)
+{
+	PgAioOp		ops[PGAIO_MAX_BATCH];
+	int			opfile[PGAIO_MAX_BATCH];
+	int			batch_size = Min(PGAIO_MAX_BATCH, Max(max_safe_fds / 2, 1));
+	int			start;
+
+	for (start = 0; start < nfiles; start += batch_size)
+	{
+		int			end = Min(start + batch_size, nfiles);
+		int			nops = 0;
+		int			i;
+
+		for (i = start; i < end; i++)
+		{
+			Assert(FileIsValid(files[i]));
+
+			DO_DB(elog(LOG, "FileSyncBatch: %d (%s)",
+					   files[i], VfdCache[files[i]].fileName));
+
+			if (FileAccess(files[i]) < 0)
+			{
+				results[i] = errno;
+				continue;
+			}
+
+			ops[nops].type = PGAIO_OP_FSYNC;
+			ops[nops].fd = VfdCache[files[i]].fd;
+			opfile[nops] = i;
+			nops++;
+		}
+
+		pgaio_execute(ops, nops, wait_event_info);
+
+		for (i = 0; i < nops; i++)
+			results[opfile[i]] = (ops[i].result < 0) ? -ops[i].result : 0;
+	}
+}
+
 off_t
 FileSize(File file)
 {
@@ -3489,3 +3697,99 @@ data_sync_elevel(int elevel)
 {
 	return data_sync_retry ? elevel : PANIC;
 }
+
+/*
+ * GUC check_hook for io_direct
+ *
+ * The value is a list of the kinds of files to open with O_DIRECT, so that
+ * their I/O bypasses the kernel's page cache: "data" for relation files
+ * accessed through md.c, "wal" for WAL segments written by XLogWrite().
+ */
+bool
+check_io_direct(char **newval, void **extra, GucSource source)
+{
+	char	   *rawstring;
+	List	   *elemlist;
+	ListCell   *l;
+	int			flags = 0;
+	bool		result = true;
+
+	/* Need a modifiable copy of string */
+	rawstring = pstrdup(*newval);
+
+	if (!SplitGUCList(rawstring, ',', &elemlist))
+	{
+		GUC_check_errdetail("List syntax is invalid.");
+		pfree(rawstring);
+		list_free(elemlist);
+		return false;
+	}
+
+	foreach(l, elemlist)
+	{
+		char	   *item = (char *) lfirst(l);
+
+		if (pg_strcasecmp(item, "data") == 0)
+			flags |= IO_DIRECT_DATA;
+		else if (pg_strcasecmp(item, "wal") == 0)
+			flags |= IO_DIRECT_WAL;
+		else
+		{
+			GUC_check_errdetail("Unrecognized key word: \"%s\".", item);
+			result = false;
+			break;
+		}
+	}
+
+	pfree(rawstring);
+	list_free(elemlist);
+
+	if (!result)
+		return false;
+
+#if PG_O_DIRECT == 0
+	if (flags != 0)
+	{
+		GUC_check_errdetail("Direct I/O is not supported on this platform.");
+		return false;
+	}
+#endif
+
+	/*
+	 * Every transfer must be a multiple of PG_IO_ALIGN_SIZE; we have no
+	 * means to enforce that with smaller page sizes.
+	 */
+#if XLOG_BLCKSZ < PG_IO_ALIGN_SIZE
+	if (flags & IO_DIRECT_WAL)
+	{
+		GUC_check_errdetail("Direct I/O is not supported for WAL because XLOG_BLCKSZ is too small.");
+		return false;
+	}
+#endif
+#if BLCKSZ < PG_IO_ALIGN_SIZE
+	if (flags & IO_DIRECT_DATA)
+	{
+		GUC_check_errdetail("Direct I/O is not supported for data because BLCKSZ is too small.");
+		return false;
+	}
+#endif
+
+	/* Save the flags in *extra, for use by assign_io_direct */
+	*extra = malloc(sizeof(int));
+	if (!*extra)
+		return false;
+	*((int *) *extra) = flags;
+
+	return true;
+}
+
+/*
+ * GUC assign_hook for io_direct
+ */
+void
+assign_io_direct(const char *newval, void *extra)
+{
+	int		   *flags = (int *) extra;
+
+	io_direct_flags = *flags;
+}
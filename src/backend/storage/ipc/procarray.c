@@ -46,6 +46,7 @@
 #include <signal.h>
 
 #include "access/clog.h"
+#include "access/multixact.h"
 #include "access/subtrans.h"
 #include "access/transam.h"
 #include "access/twophase.h"
@@ -60,6 +61,7 @@
 #include "utils/builtins.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 
 #define UINT32_ACCESS_ONCE(var)		 ((uint32)(*((volatile uint32 *)&(var))))
 
@@ -153,7 +155,16 @@ static void DisplayXidCache(void);
 #endif							/* XIDCACHE_DEBUG */
 
 /* Primitives for KnownAssignedXids array handling for standby */
-static void KnownAssignedXidsCompress(bool force);
+/* Reasons for calling KnownAssignedXidsCompress() */
+typedef enum KAXCompressReason
+{
+	KAX_NO_SPACE,				/* need to free up space at array end */
+	KAX_PRUNE,					/* we just pruned old entries */
+	KAX_TRANSACTION_END,		/* we just committed/removed some XIDs */
+	KAX_STARTUP_PROCESS_IDLE	/* startup process is about to sleep */
+} KAXCompressReason;
+
+static void KnownAssignedXidsCompress(KAXCompressReason reason, bool haveLock);
 static void KnownAssignedXidsAdd(TransactionId from_xid, TransactionId to_xid,
 								 bool exclusive_lock);
 static bool KnownAssignedXidsSearch(TransactionId xid, bool remove);
@@ -172,6 +183,8 @@ static void KnownAssignedXidsReset(void);
 static inline void ProcArrayEndTransactionInternal(PGPROC *proc,
 												   PGXACT *pgxact, TransactionId latestXid);
 static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
+static void SubXidOverflowReset(PGPROC *proc);
+static bool GetSnapshotDataReuse(Snapshot snapshot);
 
 /*
  * Report shared-memory space needed by CreateSharedProcArray.
@@ -246,6 +259,7 @@ CreateSharedProcArray(void)
 		procArray->lastOverflowedXid = InvalidTransactionId;
 		procArray->replication_slot_xmin = InvalidTransactionId;
 		procArray->replication_slot_catalog_xmin = InvalidTransactionId;
+		ShmemVariableCache->xactCompletionCount = 1;
 	}
 
 	allProcs = ProcGlobal->allProcs;
@@ -276,9 +290,12 @@ void
 ProcArrayAdd(PGPROC *proc)
 {
 	ProcArrayStruct *arrayP = procArray;
+	PGXACT	   *pgxact = &allPgXact[proc->pgprocno];
 	int			index;
 
+	/* XidGenLock keeps GetNewTransactionId() away while we move entries */
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
 
 	if (arrayP->numProcs >= arrayP->maxProcs)
 	{
@@ -287,6 +304,7 @@ ProcArrayAdd(PGPROC *proc)
 		 * fixed supply of PGPROC structs too, and so we should have failed
 		 * earlier.)
 		 */
+		LWLockRelease(XidGenLock);
 		LWLockRelease(ProcArrayLock);
 		ereport(FATAL,
 				(errcode(ERRCODE_TOO_MANY_CONNECTIONS),
@@ -314,9 +332,27 @@ ProcArrayAdd(PGPROC *proc)
 
 	memmove(&arrayP->pgprocnos[index + 1], &arrayP->pgprocnos[index],
 			(arrayP->numProcs - index) * sizeof(int));
+	memmove(&ProcGlobal->xids[index + 1], &ProcGlobal->xids[index],
+			(arrayP->numProcs - index) * sizeof(*ProcGlobal->xids));
+	memmove(&ProcGlobal->subxidStates[index + 1],
+			&ProcGlobal->subxidStates[index],
+			(arrayP->numProcs - index) * sizeof(*ProcGlobal->subxidStates));
+	memmove(&ProcGlobal->vacuumFlags[index + 1],
+			&ProcGlobal->vacuumFlags[index],
+			(arrayP->numProcs - index) * sizeof(*ProcGlobal->vacuumFlags));
+
 	arrayP->pgprocnos[index] = proc->pgprocno;
+	ProcGlobal->xids[index] = pgxact->xid;
+	ProcGlobal->subxidStates[index].count = pgxact->nxids;
+	ProcGlobal->subxidStates[index].overflowed = pgxact->overflowed;
+	ProcGlobal->vacuumFlags[index] = pgxact->vacuumFlags;
 	arrayP->numProcs++;
 
+	/* Adjust the offsets of the entries that moved, and our own */
+	for (; index < arrayP->numProcs; index++)
+		allProcs[arrayP->pgprocnos[index]].pgxactoff = index;
+
+	LWLockRelease(XidGenLock);
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -342,7 +378,9 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		DisplayXidCache();
 #endif
 
+	/* XidGenLock keeps GetNewTransactionId() away while we move entries */
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
 
 	if (TransactionIdIsValid(latestXid))
 	{
@@ -352,6 +390,9 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
+
+		/* Invalidate cached snapshots */
+		ShmemVariableCache->xactCompletionCount++;
 	}
 	else
 	{
@@ -366,14 +407,30 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 			/* Keep the PGPROC array sorted. See notes above */
 			memmove(&arrayP->pgprocnos[index], &arrayP->pgprocnos[index + 1],
 					(arrayP->numProcs - index - 1) * sizeof(int));
+			memmove(&ProcGlobal->xids[index], &ProcGlobal->xids[index + 1],
+					(arrayP->numProcs - index - 1) * sizeof(*ProcGlobal->xids));
+			memmove(&ProcGlobal->subxidStates[index],
+					&ProcGlobal->subxidStates[index + 1],
+					(arrayP->numProcs - index - 1) * sizeof(*ProcGlobal->subxidStates));
+			memmove(&ProcGlobal->vacuumFlags[index],
+					&ProcGlobal->vacuumFlags[index + 1],
+					(arrayP->numProcs - index - 1) * sizeof(*ProcGlobal->vacuumFlags));
 			arrayP->pgprocnos[arrayP->numProcs - 1] = -1;	/* for debugging */
 			arrayP->numProcs--;
+			proc->pgxactoff = -1;
+
+			/* Adjust the offsets of the entries that moved */
+			for (; index < arrayP->numProcs; index++)
+				allProcs[arrayP->pgprocnos[index]].pgxactoff = index;
+
+			LWLockRelease(XidGenLock);
 			LWLockRelease(ProcArrayLock);
 			return;
 		}
 	}
 
 	/* Oops */
+	LWLockRelease(XidGenLock);
 	LWLockRelease(ProcArrayLock);
 
 	elog(LOG, "failed to find proc %p in ProcArray", proc);
@@ -432,8 +489,18 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 
 		proc->lxid = InvalidLocalTransactionId;
 		pgxact->xmin = InvalidTransactionId;
-		/* must be cleared with xid/xmin: */
-		pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
+
+		/*
+		 * must be cleared with xid/xmin; we need the lock to update the
+		 * dense copy, but that's rarely necessary
+		 */
+		if (pgxact->vacuumFlags & PROC_VACUUM_STATE_MASK)
+		{
+			LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+			pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
+			ProcGlobal->vacuumFlags[proc->pgxactoff] = pgxact->vacuumFlags;
+			LWLockRelease(ProcArrayLock);
+		}
 		pgxact->delayChkpt = false; /* be sure this is cleared in abort */
 		proc->recoveryConflictPending = false;
 
@@ -452,21 +519,30 @@ ProcArrayEndTransactionInternal(PGPROC *proc, PGXACT *pgxact,
 								TransactionId latestXid)
 {
 	pgxact->xid = InvalidTransactionId;
+	ProcGlobal->xids[proc->pgxactoff] = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
 	/* must be cleared with xid/xmin: */
 	pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
+	ProcGlobal->vacuumFlags[proc->pgxactoff] = pgxact->vacuumFlags;
 	pgxact->delayChkpt = false; /* be sure this is cleared in abort */
 	proc->recoveryConflictPending = false;
 
 	/* Clear the subtransaction-XID cache too while holding the lock */
+	if (pgxact->overflowed)
+		SubXidOverflowReset(proc);
 	pgxact->nxids = 0;
 	pgxact->overflowed = false;
+	ProcGlobal->subxidStates[proc->pgxactoff].count = 0;
+	ProcGlobal->subxidStates[proc->pgxactoff].overflowed = false;
 
 	/* Also advance global latestCompletedXid while holding the lock */
 	if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
+
+	/* Invalidate cached snapshots */
+	ShmemVariableCache->xactCompletionCount++;
 }
 
 /*
@@ -602,23 +678,34 @@ ProcArrayClearTransaction(PGPROC *proc)
 	PGXACT	   *pgxact = &allPgXact[proc->pgprocno];
 
 	/*
-	 * We can skip locking ProcArrayLock here, because this action does not
-	 * actually change anyone's view of the set of running XIDs: our entry is
-	 * duplicate with the gxact that has already been inserted into the
-	 * ProcArray.
+	 * This action does not actually change anyone's view of the set of
+	 * running XIDs: our entry is duplicate with the gxact that has already
+	 * been inserted into the ProcArray.  But we need ProcArrayLock to update
+	 * the dense copies of our entries without racing with ProcArrayAdd() or
+	 * ProcArrayRemove().
 	 */
+	LWLockAcquire(ProcArrayLock, LW_SHARED);
+
 	pgxact->xid = InvalidTransactionId;
+	ProcGlobal->xids[proc->pgxactoff] = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
 	proc->recoveryConflictPending = false;
 
 	/* redundant, but just in case */
 	pgxact->vacuumFlags &= ~PROC_VACUUM_STATE_MASK;
+	ProcGlobal->vacuumFlags[proc->pgxactoff] = pgxact->vacuumFlags;
 	pgxact->delayChkpt = false;
 
 	/* Clear the subtransaction-XID cache too */
+	if (pgxact->overflowed)
+		SubXidOverflowReset(proc);
 	pgxact->nxids = 0;
 	pgxact->overflowed = false;
+	ProcGlobal->subxidStates[proc->pgxactoff].count = 0;
+	ProcGlobal->subxidStates[proc->pgxactoff].overflowed = false;
+
+	LWLockRelease(ProcArrayLock);
 }
 
 /*
@@ -878,6 +965,8 @@ ProcArrayApplyRecoveryInfo(RunningTransactions running)
 
 	Assert(TransactionIdIsNormal(ShmemVariableCache->latestCompletedXid));
 
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 
 	/* ShmemVariableCache->nextFullXid must be beyond any observed xid. */
@@ -1063,18 +1152,16 @@ TransactionIdIsInProgress(TransactionId xid)
 	/* No shortcuts, gotta grovel through the array */
 	for (i = 0; i < arrayP->numProcs; i++)
 	{
-		int			pgprocno = arrayP->pgprocnos[i];
-		PGPROC	   *proc = &allProcs[pgprocno];
-		PGXACT	   *pgxact = &allPgXact[pgprocno];
 		TransactionId pxid;
 		int			pxids;
+		PGPROC	   *proc;
 
 		/* Ignore my own proc --- dealt with it above */
-		if (proc == MyProc)
+		if (i == MyProc->pgxactoff)
 			continue;
 
 		/* Fetch xid just once - see GetNewTransactionId */
-		pxid = UINT32_ACCESS_ONCE(pgxact->xid);
+		pxid = UINT32_ACCESS_ONCE(ProcGlobal->xids[i]);
 
 		if (!TransactionIdIsValid(pxid))
 			continue;
@@ -1099,7 +1186,8 @@ TransactionIdIsInProgress(TransactionId xid)
 		/*
 		 * Step 2: check the cached child-Xids arrays
 		 */
-		pxids = pgxact->nxids;
+		proc = &allProcs[arrayP->pgprocnos[i]];
+		pxids = ProcGlobal->subxidStates[i].count;
 		pg_read_barrier();		/* pairs with barrier in GetNewTransactionId() */
 		for (j = pxids - 1; j >= 0; j--)
 		{
@@ -1121,7 +1209,7 @@ TransactionIdIsInProgress(TransactionId xid)
 		 * we hold ProcArrayLock.  So we can't miss an Xid that we need to
 		 * worry about.)
 		 */
-		if (pgxact->overflowed)
+		if (ProcGlobal->subxidStates[i].overflowed)
 			xids[nxids++] = pxid;
 	}
 
@@ -1180,9 +1268,12 @@ TransactionIdIsInProgress(TransactionId xid)
 	/*
 	 * It isn't aborted, so check whether the transaction tree it belongs to
 	 * is still running (or, more precisely, whether it was running when we
-	 * held ProcArrayLock).
+	 * held ProcArrayLock).  Try the subxid overflow arrays before going to
+	 * pg_subtrans.
 	 */
-	topxid = SubTransGetTopmostTransaction(xid);
+	topxid = SubXidOverflowGetTopmost(xid);
+	if (!TransactionIdIsValid(topxid))
+		topxid = SubTransGetTopmostTransaction(xid);
 	Assert(TransactionIdIsValid(topxid));
 	if (!TransactionIdEquals(topxid, xid))
 	{
@@ -1465,6 +1556,52 @@ GetMaxSnapshotSubxidCount(void)
 	return TOTAL_MAX_CACHED_SUBXIDS;
 }
 
+/*
+ * Helper for GetSnapshotData(): if no transaction has completed since the
+ * snapshot was last filled in, its contents are still exactly what we'd
+ * compute now, so just refresh the fields that are local to this call and
+ * return true.  Caller must hold ProcArrayLock.
+ *
+ * Since no XID below the snapshot's xmax can have finished, nobody can have
+ * computed a global xmin beyond the snapshot's xmin either, so it is safe to
+ * advertise that as our xmin again.  We leave RecentGlobalXmin and friends
+ * alone; the values from the last full computation are older, but still
+ * correct.
+ */
+static bool
+GetSnapshotDataReuse(Snapshot snapshot)
+{
+	Assert(LWLockHeldByMe(ProcArrayLock));
+
+	if (snapshot->snapXactCompletionCount == 0 ||
+		snapshot->snapXactCompletionCount !=
+		ShmemVariableCache->xactCompletionCount)
+		return false;
+
+	/* Crossing the end of recovery changes the snapshot's layout */
+	if (snapshot->takenDuringRecovery != RecoveryInProgress())
+		return false;
+
+	/*
+	 * "Snapshot too old" needs a fresh timestamp and LSN, and updates a
+	 * shared map; don't bother reusing snapshots in that case.
+	 */
+	if (old_snapshot_threshold >= 0)
+		return false;
+
+	if (!TransactionIdIsValid(MyPgXact->xmin))
+		MyPgXact->xmin = TransactionXmin = snapshot->xmin;
+
+	RecentXmin = snapshot->xmin;
+
+	snapshot->curcid = GetCurrentCommandId(false);
+	snapshot->active_count = 0;
+	snapshot->regd_count = 0;
+	snapshot->copied = false;
+
+	return true;
+}
+
 /*
  * GetSnapshotData -- returns information about running transactions.
  *
@@ -1498,6 +1635,11 @@ GetMaxSnapshotSubxidCount(void)
  *		RecentGlobalDataXmin: the global xmin for non-catalog tables
  *			>= RecentGlobalXmin
  *
+ * If no transaction has completed since the same snapshot struct was last
+ * filled in, its contents are still valid and we return them without
+ * scanning the ProcArray at all; see GetSnapshotDataReuse().  That makes
+ * snapshots cheap for read-mostly workloads with many connections.
+ *
  * Note: this function should probably not be called with an argument that's
  * not statically allocated (see xip allocation below).
  */
@@ -1514,6 +1656,7 @@ GetSnapshotData(Snapshot snapshot)
 	bool		suboverflowed = false;
 	TransactionId replication_slot_xmin = InvalidTransactionId;
 	TransactionId replication_slot_catalog_xmin = InvalidTransactionId;
+	uint64		curXactCompletionCount;
 
 	Assert(snapshot != NULL);
 
@@ -1555,6 +1698,12 @@ GetSnapshotData(Snapshot snapshot)
 	 */
 	LWLockAcquire(ProcArrayLock, LW_SHARED);
 
+	if (GetSnapshotDataReuse(snapshot))
+	{
+		LWLockRelease(ProcArrayLock);
+		return snapshot;
+	}
+
 	/* xmax is always latestCompletedXid + 1 */
 	xmax = ShmemVariableCache->latestCompletedXid;
 	Assert(TransactionIdIsNormal(xmax));
@@ -1568,36 +1717,39 @@ GetSnapshotData(Snapshot snapshot)
 	if (!snapshot->takenDuringRecovery)
 	{
 		int		   *pgprocnos = arrayP->pgprocnos;
+		TransactionId *other_xids = ProcGlobal->xids;
+		XidCacheStatus *other_subxidstates = ProcGlobal->subxidStates;
+		uint8	   *other_vacuumflags = ProcGlobal->vacuumFlags;
+		int			mypgxactoff = MyProc->pgxactoff;
 		int			numProcs;
 
 		/*
 		 * Spin over procArray checking xid, xmin, and subxids.  The goal is
 		 * to gather all active xids, find the lowest xmin, and try to record
-		 * subxids.
+		 * subxids.  Everything but xmin is read from the dense copies in
+		 * ProcGlobal, in ProcArray order.
 		 */
 		numProcs = arrayP->numProcs;
 		for (index = 0; index < numProcs; index++)
 		{
-			int			pgprocno = pgprocnos[index];
-			PGXACT	   *pgxact = &allPgXact[pgprocno];
 			TransactionId xid;
 
 			/*
 			 * Skip over backends doing logical decoding which manages xmin
 			 * separately (check below) and ones running LAZY VACUUM.
 			 */
-			if (pgxact->vacuumFlags &
+			if (other_vacuumflags[index] &
 				(PROC_IN_LOGICAL_DECODING | PROC_IN_VACUUM))
 				continue;
 
 			/* Update globalxmin to be the smallest valid xmin */
-			xid = UINT32_ACCESS_ONCE(pgxact->xmin);
+			xid = UINT32_ACCESS_ONCE(allPgXact[pgprocnos[index]].xmin);
 			if (TransactionIdIsNormal(xid) &&
 				NormalTransactionIdPrecedes(xid, globalxmin))
 				globalxmin = xid;
 
 			/* Fetch xid just once - see GetNewTransactionId */
-			xid = UINT32_ACCESS_ONCE(pgxact->xid);
+			xid = UINT32_ACCESS_ONCE(other_xids[index]);
 
 			/*
 			 * If the transaction has no XID assigned, we can skip it; it
@@ -1615,7 +1767,7 @@ GetSnapshotData(Snapshot snapshot)
 			 */
 			if (NormalTransactionIdPrecedes(xid, xmin))
 				xmin = xid;
-			if (pgxact == MyPgXact)
+			if (index == mypgxactoff)
 				continue;
 
 			/* Add XID to snapshot. */
@@ -1638,15 +1790,15 @@ GetSnapshotData(Snapshot snapshot)
 			 */
 			if (!suboverflowed)
 			{
-				if (pgxact->overflowed)
+				if (other_subxidstates[index].overflowed)
 					suboverflowed = true;
 				else
 				{
-					int			nxids = pgxact->nxids;
+					int			nxids = other_subxidstates[index].count;
 
 					if (nxids > 0)
 					{
-						PGPROC	   *proc = &allProcs[pgprocno];
+						PGPROC	   *proc = &allProcs[pgprocnos[index]];
 
 						pg_read_barrier();	/* pairs with GetNewTransactionId */
 
@@ -1705,6 +1857,7 @@ GetSnapshotData(Snapshot snapshot)
 	 */
 	replication_slot_xmin = procArray->replication_slot_xmin;
 	replication_slot_catalog_xmin = procArray->replication_slot_catalog_xmin;
+	curXactCompletionCount = ShmemVariableCache->xactCompletionCount;
 
 	if (!TransactionIdIsValid(MyPgXact->xmin))
 		MyPgXact->xmin = TransactionXmin = xmin;
@@ -1747,6 +1900,10 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->xcnt = count;
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
+	snapshot->snapXactCompletionCount = curXactCompletionCount;
+
+	if (suboverflowed)
+		pgstat_count_suboverflowed_snapshot();
 
 	snapshot->curcid = GetCurrentCommandId(false);
 
@@ -3016,6 +3173,82 @@ ProcArrayGetReplicationSlotXmin(TransactionId *xmin,
 	LWLockRelease(ProcArrayLock);
 }
 
+/*
+ * ProcArraySetGlobalTempXids
+ *
+ * Advertise the oldest relfrozenxid and relminmxid of this backend's private
+ * storage of global temporary tables, which pg_class can't tell about.
+ * Invalid values mean that there's nothing to hold back.
+ */
+void
+ProcArraySetGlobalTempXids(TransactionId frozenxid, MultiXactId minmulti)
+{
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
+	MyProc->globalTempFrozenXid = frozenxid;
+	MyProc->globalTempMinMulti = minmulti;
+
+	LWLockRelease(ProcArrayLock);
+}
+
+/*
+ * GetOldestGlobalTempXids
+ *
+ * Return the oldest relfrozenxid and relminmxid advertised for global
+ * temporary table storage by backends of the given database, or of any
+ * database if databaseid is InvalidOid.  *xid_dbid and *multi_dbid, if not
+ * NULL, are set to the database those belong to.  The results are invalid if
+ * no backend has such storage.
+ */
+void
+GetOldestGlobalTempXids(Oid databaseid,
+						TransactionId *frozenxid, Oid *xid_dbid,
+						MultiXactId *minmulti, Oid *multi_dbid)
+{
+	ProcArrayStruct *arrayP = procArray;
+	int			index;
+
+	*frozenxid = InvalidTransactionId;
+	*minmulti = InvalidMultiXactId;
+	if (xid_dbid != NULL)
+		*xid_dbid = InvalidOid;
+	if (multi_dbid != NULL)
+		*multi_dbid = InvalidOid;
+
+	LWLockAcquire(ProcArrayLock, LW_SHARED);
+
+	for (index = 0; index < arrayP->numProcs; index++)
+	{
+		int			pgprocno = arrayP->pgprocnos[index];
+		PGPROC	   *proc = &allProcs[pgprocno];
+		TransactionId xid = proc->globalTempFrozenXid;
+		MultiXactId multi = proc->globalTempMinMulti;
+
+		if (OidIsValid(databaseid) && proc->databaseId != databaseid)
+			continue;
+
+		if (TransactionIdIsNormal(xid) &&
+			(!TransactionIdIsValid(*frozenxid) ||
+			 TransactionIdPrecedes(xid, *frozenxid)))
+		{
+			*frozenxid = xid;
+			if (xid_dbid != NULL)
+				*xid_dbid = proc->databaseId;
+		}
+
+		if (MultiXactIdIsValid(multi) &&
+			(!MultiXactIdIsValid(*minmulti) ||
+			 MultiXactIdPrecedes(multi, *minmulti)))
+		{
+			*minmulti = multi;
+			if (multi_dbid != NULL)
+				*multi_dbid = proc->databaseId;
+		}
+	}
+
+	LWLockRelease(ProcArrayLock);
+}
+
 
 #define XidCacheRemove(i) \
 	do { \
@@ -3097,14 +3330,134 @@ XidCacheRemoveRunningXids(TransactionId xid,
 	if (j < 0 && !MyPgXact->overflowed)
 		elog(WARNING, "did not find subXID %u in MyProc", xid);
 
+	/*
+	 * Aborted XIDs are left in the overflow array, if they got there.  They
+	 * keep mapping to our top-level XID just like their pg_subtrans entries
+	 * do, and whoever asks checks pg_xact for an abort first anyway.
+	 */
+
+	/* Update the dense copy of our subxid count */
+	ProcGlobal->subxidStates[MyProc->pgxactoff].count = MyPgXact->nxids;
+
 	/* Also advance global latestCompletedXid while holding the lock */
 	if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
 
+	/* Invalidate cached snapshots */
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
+/*
+ * SubXidOverflowAdd
+ *
+ * Record a subtransaction XID that didn't fit in proc's subxid cache in its
+ * overflow array, along with the top-level XID it belongs to.  Called by the
+ * owning backend only, as XIDs are assigned, so the array stays sorted.  If
+ * the array is full too, the XID is simply not recorded; readers fall back
+ * to pg_subtrans for it.
+ */
+void
+SubXidOverflowAdd(PGPROC *proc, TransactionId topxid, TransactionId xid)
+{
+	Assert(TransactionIdIsValid(topxid));
+
+	if (proc->nOverflowSubxids >= subxid_overflow_slots)
+		return;
+
+	SpinLockAcquire(&proc->overflowSubxidLock);
+	Assert(proc->nOverflowSubxids == 0 ||
+		   TransactionIdEquals(proc->overflowTopXid, topxid));
+	proc->overflowTopXid = topxid;
+	proc->overflowSubxids[proc->nOverflowSubxids++] = xid;
+	SpinLockRelease(&proc->overflowSubxidLock);
+}
+
+/*
+ * SubXidOverflowReset
+ *
+ * Forget proc's overflowed subtransaction XIDs at the end of its transaction.
+ */
+static void
+SubXidOverflowReset(PGPROC *proc)
+{
+	SpinLockAcquire(&proc->overflowSubxidLock);
+	proc->overflowTopXid = InvalidTransactionId;
+	proc->nOverflowSubxids = 0;
+	SpinLockRelease(&proc->overflowSubxidLock);
+}
+
+/*
+ * SubXidOverflowGetTopmost
+ *
+ * Look for xid in the subxid overflow arrays of all backends, and return the
+ * top-level XID it belongs to, or InvalidTransactionId if it's not there.
+ * This answers the same question as SubTransGetTopmostTransaction() for the
+ * subtransactions of running transactions that overflowed their subxid
+ * cache, without touching pg_subtrans.  Not finding the XID proves nothing;
+ * the caller must then consult pg_subtrans.
+ */
+TransactionId
+SubXidOverflowGetTopmost(TransactionId xid)
+{
+	PROC_HDR   *procglobal = ProcGlobal;
+	uint32		i;
+
+	if (subxid_overflow_slots == 0)
+		return InvalidTransactionId;
+
+	for (i = 0; i < procglobal->allProcCount; i++)
+	{
+		PGPROC	   *proc = &allProcs[i];
+		TransactionId topxid = InvalidTransactionId;
+		int			n;
+
+		/*
+		 * Peek at the count without the lock to skip the (many) backends
+		 * that have nothing here.  If we miss an entry being added
+		 * concurrently, it belongs to an XID the caller can't be asking
+		 * about yet, or pg_subtrans has it anyway.
+		 */
+		if (*((volatile int *) &proc->nOverflowSubxids) == 0)
+			continue;
+
+		SpinLockAcquire(&proc->overflowSubxidLock);
+		n = proc->nOverflowSubxids;
+		if (n > 0 &&
+			TransactionIdFollowsOrEquals(xid, proc->overflowSubxids[0]) &&
+			TransactionIdPrecedesOrEquals(xid, proc->overflowSubxids[n - 1]))
+		{
+			int			low = 0;
+			int			high = n - 1;
+
+			/* binary search; the entries were assigned in increasing order */
+			while (low <= high)
+			{
+				int			middle = low + (high - low) / 2;
+				TransactionId probe = proc->overflowSubxids[middle];
+
+				if (TransactionIdEquals(probe, xid))
+				{
+					topxid = proc->overflowTopXid;
+					break;
+				}
+				if (TransactionIdPrecedes(probe, xid))
+					low = middle + 1;
+				else
+					high = middle - 1;
+			}
+		}
+		SpinLockRelease(&proc->overflowSubxidLock);
+
+		if (TransactionIdIsValid(topxid))
+			return topxid;
+	}
+
+	return InvalidTransactionId;
+}
+
 #ifdef XIDCACHE_DEBUG
 
 /*
@@ -3283,9 +3636,22 @@ ExpireTreeKnownAssignedTransactionIds(TransactionId xid, int nsubxids,
 							  max_xid))
 		ShmemVariableCache->latestCompletedXid = max_xid;
 
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
+/*
+ * KnownAssignedTransactionIdsIdleMaintenance
+ *		Opportunistically do maintenance work when the startup process
+ *		is about to go idle.
+ */
+void
+KnownAssignedTransactionIdsIdleMaintenance(void)
+{
+	KnownAssignedXidsCompress(KAX_STARTUP_PROCESS_IDLE, false);
+}
+
 /*
  * ExpireAllKnownAssignedTransactionIds
  *		Remove all entries in KnownAssignedXids
@@ -3295,6 +3661,7 @@ ExpireAllKnownAssignedTransactionIds(void)
 {
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	KnownAssignedXidsRemovePreceding(InvalidTransactionId);
+	ShmemVariableCache->xactCompletionCount++;
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -3307,6 +3674,7 @@ ExpireOldKnownAssignedTransactionIds(TransactionId xid)
 {
 	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 	KnownAssignedXidsRemovePreceding(xid);
+	ShmemVariableCache->xactCompletionCount++;
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -3382,7 +3750,7 @@ ExpireOldKnownAssignedTransactionIds(TransactionId xid)
  *		must happen)
  *	* Compressing the array is O(S) and requires exclusive lock
  *	* Removing an XID is O(logS) and requires exclusive lock
- *	* Taking a snapshot is O(S) and requires shared lock
+ *	* Taking a snapshot is O(S), amortized O(N), and requires shared lock
  *	* Checking for an XID is O(logS) and requires shared lock
  *
  * In comparison, using a hash table for KnownAssignedXids would mean that
@@ -3392,7 +3760,13 @@ ExpireOldKnownAssignedTransactionIds(TransactionId xid)
  * so there is an optimal point for any workload mix. We use a heuristic to
  * decide when to compress the array, though trimming also helps reduce
  * frequency of compressing. The heuristic requires us to track the number of
- * currently valid XIDs in the array.
+ * currently valid XIDs in the array (N).  Except when we need room, we
+ * compress once more than half of the S elements are gaps, but only check
+ * that every so many transaction ends, so that the O(S) cost of compressing
+ * is spread over many commits.  Since snapshots are taken much more often
+ * than the array is compressed, keeping S below 2N this way is much cheaper
+ * overall than letting gaps accumulate.  The startup process also compresses
+ * when it runs out of WAL to replay, as it has nothing better to do then.
  */
 
 
@@ -3400,42 +3774,83 @@ ExpireOldKnownAssignedTransactionIds(TransactionId xid)
  * Compress KnownAssignedXids by shifting valid data down to the start of the
  * array, removing any gaps.
  *
- * A compression step is forced if "force" is true, otherwise we do it
- * only if a heuristic indicates it's a good time to do it.
+ * A compression step is forced if "reason" is KAX_NO_SPACE, otherwise
+ * we do it only if a heuristic indicates it's a good time to do it.
  *
- * Caller must hold ProcArrayLock in exclusive mode.
+ * Compression requires holding ProcArrayLock in exclusive mode.
+ * Caller must pass haveLock = true if it already holds the lock.
  */
 static void
-KnownAssignedXidsCompress(bool force)
+KnownAssignedXidsCompress(KAXCompressReason reason, bool haveLock)
 {
 	ProcArrayStruct *pArray = procArray;
 	int			head,
-				tail;
+				tail,
+				nelements;
 	int			compress_index;
 	int			i;
 
-	/* no spinlock required since we hold ProcArrayLock exclusively */
+	/* Counters for compression heuristics */
+	static unsigned int transactionEndsCounter;
+	static TimestampTz lastCompressTs;
+
+	/* Tuning constants */
+#define KAX_COMPRESS_FREQUENCY 128	/* in transactions */
+#define KAX_COMPRESS_IDLE_INTERVAL 1000 /* in ms */
+
+	/*
+	 * Since only the startup process modifies the head/tail pointers, we
+	 * don't need a lock to read them here.
+	 */
 	head = pArray->headKnownAssignedXids;
 	tail = pArray->tailKnownAssignedXids;
+	nelements = head - tail;
 
-	if (!force)
+	/*
+	 * If we can choose whether to compress, use a heuristic to avoid
+	 * compressing too often or not often enough.
+	 */
+	if (nelements == pArray->numKnownAssignedXids)
 	{
 		/*
-		 * If we can choose how much to compress, use a heuristic to avoid
-		 * compressing too often or not often enough.
-		 *
-		 * Heuristic is if we have a large enough current spread and less than
-		 * 50% of the elements are currently in use, then compress. This
-		 * should ensure we compress fairly infrequently. We could compress
-		 * less often though the virtual array would spread out more and
-		 * snapshots would become more expensive.
+		 * When there are no gaps between head and tail, don't bother to
+		 * compress, except in the KAX_NO_SPACE case where we must compress to
+		 * create some space after the head.
 		 */
-		int			nelements = head - tail;
+		if (reason != KAX_NO_SPACE)
+			return;
+	}
+	else if (reason == KAX_TRANSACTION_END)
+	{
+		/* Consider compressing only once every so many commits */
+		if ((transactionEndsCounter++) % KAX_COMPRESS_FREQUENCY != 0)
+			return;
 
-		if (nelements < 4 * PROCARRAY_MAXPROCS ||
-			nelements < 2 * pArray->numKnownAssignedXids)
+		/* ... and only if less than 50% of the used part is valid */
+		if (nelements < 2 * pArray->numKnownAssignedXids)
 			return;
 	}
+	else if (reason == KAX_STARTUP_PROCESS_IDLE)
+	{
+		/*
+		 * We're about to go idle for lack of new WAL, so we might as well
+		 * compress.  But not too often, to avoid ProcArrayLock contention
+		 * with readers.
+		 */
+		if (lastCompressTs != 0)
+		{
+			TimestampTz compress_after;
+
+			compress_after = TimestampTzPlusMilliseconds(lastCompressTs,
+														 KAX_COMPRESS_IDLE_INTERVAL);
+			if (GetCurrentTimestamp() < compress_after)
+				return;
+		}
+	}
+
+	/* Need to compress, so get the lock if we don't have it */
+	if (!haveLock)
+		LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 
 	/*
 	 * We compress the array by reading the valid values from tail to head,
@@ -3451,9 +3866,16 @@ KnownAssignedXidsCompress(bool force)
 			compress_index++;
 		}
 	}
+	Assert(compress_index == pArray->numKnownAssignedXids);
 
 	pArray->tailKnownAssignedXids = 0;
 	pArray->headKnownAssignedXids = compress_index;
+
+	if (!haveLock)
+		LWLockRelease(ProcArrayLock);
+
+	/* Update timestamp for maintenance.  No need to hold lock for this. */
+	lastCompressTs = GetCurrentTimestamp();
 }
 
 /*
@@ -3525,18 +3947,11 @@ KnownAssignedXidsAdd(TransactionId from_xid, TransactionId to_xid,
 	 */
 	if (head + nxids > pArray->maxKnownAssignedXids)
 	{
-		/* must hold lock to compress */
-		if (!exclusive_lock)
-			LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
-
-		KnownAssignedXidsCompress(true);
+		KnownAssignedXidsCompress(KAX_NO_SPACE, exclusive_lock);
 
 		head = pArray->headKnownAssignedXids;
 		/* note: we no longer care about the tail pointer */
 
-		if (!exclusive_lock)
-			LWLockRelease(ProcArrayLock);
-
 		/*
 		 * If it still won't fit then we're out of memory
 		 */
@@ -3730,7 +4145,7 @@ KnownAssignedXidsRemoveTree(TransactionId xid, int nsubxids,
 		KnownAssignedXidsRemove(subxids[i]);
 
 	/* Opportunistically compress the array */
-	KnownAssignedXidsCompress(false);
+	KnownAssignedXidsCompress(KAX_TRANSACTION_END, true);
 }
 
 /*
@@ -3805,7 +4220,7 @@ KnownAssignedXidsRemovePreceding(TransactionId removeXid)
 	}
 
 	/* Opportunistically compress the array */
-	KnownAssignedXidsCompress(false);
+	KnownAssignedXidsCompress(KAX_PRUNE, true);
 }
 
 /*
@@ -69,10 +69,11 @@ SendSharedInvalidMessages(const SharedInvalidationMessage *msgs, int n)
  */
 void
 ReceiveSharedInvalidMessages(void (*invalFunction) (SharedInvalidationMessage *msg),
-							 void (*resetFunction) (void))
+							 void (*resetFunction) (const SharedInvalSummary *summary))
 {
 #define MAXINVALMSGS 32
 	static SharedInvalidationMessage messages[MAXINVALMSGS];
+	SharedInvalSummary summary;
 
 	/*
 	 * We use volatile here to prevent bugs if a compiler doesn't realize that
@@ -90,22 +91,25 @@ ReceiveSharedInvalidMessages(void (*invalFunction) (SharedInvalidationMessage *m
 		invalFunction(&msg);
 	}
 
-	do
+	for (;;)
 	{
 		int			getResult;
 
 		nextmsg = nummsgs = 0;
 
 		/* Try to get some more messages */
-		getResult = SIGetDataEntries(messages, MAXINVALMSGS);
+		getResult = SIGetDataEntries(messages, MAXINVALMSGS, &summary);
 
 		if (getResult < 0)
 		{
-			/* got a reset message */
+			/*
+			 * Got a reset message, with a summary of the messages we missed.
+			 * Messages queued after those are still there for us to read.
+			 */
 			elog(DEBUG4, "cache state reset");
 			SharedInvalidMessageCounter++;
-			resetFunction();
-			break;				/* nothing more to do */
+			resetFunction(&summary);
+			continue;
 		}
 
 		/* Process them, being wary that a recursive call might eat some */
@@ -124,7 +128,9 @@ ReceiveSharedInvalidMessages(void (*invalFunction) (SharedInvalidationMessage *m
 		 * We only need to loop if the last SIGetDataEntries call (which might
 		 * have been within a recursive call) returned a full buffer.
 		 */
-	} while (nummsgs == MAXINVALMSGS);
+		if (nummsgs != MAXINVALMSGS)
+			break;
+	}
 
 	/*
 	 * We are now caught up.  If we received a catchup signal, reset that
@@ -48,11 +48,17 @@
  * computing MsgNum % MAXNUMMESSAGES (this should be fast as long as
  * MAXNUMMESSAGES is a constant and a power of 2).  As long as maxMsgNum
  * doesn't exceed minMsgNum by more than MAXNUMMESSAGES, we have enough space
- * in the buffer.  If the buffer does overflow, we recover by setting the
- * "reset" flag for each backend that has fallen too far behind.  A backend
- * that is in "reset" state is ignored while determining minMsgNum.  When
- * it does finally attempt to receive inval messages, it must discard all
- * its invalidatable state, since it won't know what it missed.
+ * in the buffer.  If the buffer does overflow, we recover by moving each
+ * backend that has fallen too far behind forward to maxMsgNum, and setting
+ * its "reset" flag.  When it does finally attempt to receive inval messages,
+ * it must discard the invalidatable state that the skipped messages could
+ * have affected.  So that this needn't be everything, we keep a summary of
+ * each block of SUMMARY_BLOCK messages in the buffer: which catcaches the
+ * messages were for, whether any were for the relcache or smgr, and which
+ * database they were for.  When a backend is moved forward, the summaries
+ * of the blocks it skips that could concern its database are merged into
+ * its ProcState, and handed to it along with the reset.  Messages added
+ * after that are read normally.
  *
  * To reduce the probability of needing resets, we send a "catchup" interrupt
  * to any backend that seems to be falling unreasonably far behind.  The
@@ -74,8 +80,11 @@
  * whenever minMsgNum exceeds MSGNUMWRAPAROUND, we subtract MSGNUMWRAPAROUND
  * from all the MsgNum variables simultaneously.  MSGNUMWRAPAROUND can be
  * large so that we don't need to do this often.  It must be a multiple of
- * MAXNUMMESSAGES so that the existing circular-buffer entries don't need
- * to be moved when we do it.
+ * 2 * MAXNUMMESSAGES so that the existing circular-buffer entries and block
+ * summaries don't need to be moved when we do it.  (There are block
+ * summaries for twice as many messages as the buffer holds, so that the
+ * summary of the oldest block is still intact while the newest block, which
+ * may share its buffer slots, is being filled.)
  *
  * Access to the shared sinval array is protected by two locks, SInvalReadLock
  * and SInvalWriteLock.  Readers take SInvalReadLock in shared mode; this
@@ -111,7 +120,10 @@
  * Must be a power of 2 for speed.
  *
  * MSGNUMWRAPAROUND: how often to reduce MsgNum variables to avoid overflow.
- * Must be a multiple of MAXNUMMESSAGES.  Should be large.
+ * Must be a multiple of 2 * MAXNUMMESSAGES.  Should be large.
+ *
+ * SUMMARY_BLOCK: number of messages summarized together for backends that
+ * fall too far behind.  Must be a power of 2 that divides MAXNUMMESSAGES.
  *
  * CLEANUP_MIN: the minimum number of messages that must be in the buffer
  * before we bother to call SICleanupQueue.
@@ -128,12 +140,24 @@
  * per iteration.
  */
 
-#define MAXNUMMESSAGES 4096
-#define MSGNUMWRAPAROUND (MAXNUMMESSAGES * 262144)
+#define MAXNUMMESSAGES 16384
+#define MSGNUMWRAPAROUND (MAXNUMMESSAGES * 65536)
 #define CLEANUP_MIN (MAXNUMMESSAGES / 2)
 #define CLEANUP_QUANTUM (MAXNUMMESSAGES / 16)
 #define SIG_THRESHOLD (MAXNUMMESSAGES / 2)
 #define WRITE_QUANTUM 64
+#define SUMMARY_BLOCK 64
+
+#define NUMSUMMARYBLOCKS (2 * MAXNUMMESSAGES / SUMMARY_BLOCK)
+
+/* Summary of the messages in one block of SUMMARY_BLOCK message numbers */
+typedef struct SISummaryBlock
+{
+	SharedInvalSummary summary; /* caches of the messages' database */
+	uint8		anydbFlags;		/* SINVAL_SUMMARY_xxx flags for any database */
+	bool		alldbs;			/* messages for several or shared databases? */
+	Oid			dbId;			/* else the one database, if any */
+} SISummaryBlock;
 
 /* Per-backend state in shared invalidation structure */
 typedef struct ProcState
@@ -141,9 +165,10 @@ typedef struct ProcState
 	/* procPid is zero in an inactive ProcState array entry. */
 	pid_t		procPid;		/* PID of backend, for signaling */
 	PGPROC	   *proc;			/* PGPROC of backend */
-	/* nextMsgNum is meaningless if procPid == 0 or resetState is true. */
+	/* nextMsgNum is meaningless if procPid == 0. */
 	int			nextMsgNum;		/* next message number to read */
 	bool		resetState;		/* backend needs to reset its state */
+	SharedInvalSummary summary; /* what to reset, if resetState */
 	bool		signaled;		/* backend has been sent catchup signal */
 	bool		hasMessages;	/* backend has unread messages */
 
@@ -183,6 +208,11 @@ typedef struct SISeg
 	 */
 	SharedInvalidationMessage buffer[MAXNUMMESSAGES];
 
+	/*
+	 * Summaries of blocks of messages, for backends that skip them
+	 */
+	SISummaryBlock summary[NUMSUMMARYBLOCKS];
+
 	/*
 	 * Per-backend invalidation state info (has MaxBackends entries).
 	 */
@@ -195,6 +225,9 @@ static SISeg *shmInvalBuffer;	/* pointer to the shared inval buffer */
 static LocalTransactionId nextLocalTransactionId;
 
 static void CleanupInvalidationState(int status, Datum arg);
+static void SISummarizeMessage(SISummaryBlock *block,
+							   const SharedInvalidationMessage *msg);
+static void SISkipMessages(SISeg *segP, ProcState *stateP);
 
 
 /*
@@ -235,7 +268,10 @@ CreateSharedInvalidationState(void)
 	shmInvalBuffer->maxBackends = MaxBackends;
 	SpinLockInit(&shmInvalBuffer->msgnumLock);
 
-	/* The buffer[] array is initially all unused, so we need not fill it */
+	/*
+	 * The buffer[] array is initially all unused, so we need not fill it.
+	 * Each block summary is cleared when its first message is added.
+	 */
 
 	/* Mark all backends inactive, and initialize nextLXID */
 	for (i = 0; i < shmInvalBuffer->maxBackends; i++)
@@ -244,6 +280,8 @@ CreateSharedInvalidationState(void)
 		shmInvalBuffer->procState[i].proc = NULL;
 		shmInvalBuffer->procState[i].nextMsgNum = 0;	/* meaningless */
 		shmInvalBuffer->procState[i].resetState = false;
+		memset(&shmInvalBuffer->procState[i].summary, 0,
+			   sizeof(SharedInvalSummary));
 		shmInvalBuffer->procState[i].signaled = false;
 		shmInvalBuffer->procState[i].hasMessages = false;
 		shmInvalBuffer->procState[i].nextLXID = InvalidLocalTransactionId;
@@ -312,6 +350,7 @@ SharedInvalBackendInit(bool sendOnly)
 	stateP->proc = MyProc;
 	stateP->nextMsgNum = segP->maxMsgNum;
 	stateP->resetState = false;
+	memset(&stateP->summary, 0, sizeof(SharedInvalSummary));
 	stateP->signaled = false;
 	stateP->hasMessages = false;
 	stateP->sendOnly = sendOnly;
@@ -480,6 +519,13 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
 		max = segP->maxMsgNum;
 		while (nthistime-- > 0)
 		{
+			SISummaryBlock *block;
+
+			block = &segP->summary[(max / SUMMARY_BLOCK) % NUMSUMMARYBLOCKS];
+			if (max % SUMMARY_BLOCK == 0)
+				memset(block, 0, sizeof(SISummaryBlock));
+			SISummarizeMessage(block, data);
+
 			segP->buffer[max % MAXNUMMESSAGES] = *data++;
 			max++;
 		}
@@ -514,11 +560,13 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
  * Possible return values:
  *	0:	 no SI message available
  *	n>0: next n SI messages have been extracted into data[]
- * -1:	 SI reset message extracted
+ * -1:	 SI reset message extracted, with the summary of the skipped messages
+ *		 in *summary
  *
  * If the return value is less than the array size "datasize", the caller
  * can assume that there are no more SI messages after the one(s) returned.
- * Otherwise, another call is needed to collect more messages.
+ * Otherwise, or after a reset, another call is needed to collect more
+ * messages.
  *
  * NB: this can run in parallel with other instances of SIGetDataEntries
  * executing on behalf of other backends, since each instance will modify only
@@ -536,7 +584,8 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
  * to break our hold on SInvalReadLock into segments.
  */
 int
-SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
+SIGetDataEntries(SharedInvalidationMessage *data, int datasize,
+				 SharedInvalSummary *summary)
 {
 	SISeg	   *segP;
 	ProcState  *stateP;
@@ -581,13 +630,17 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	if (stateP->resetState)
 	{
 		/*
-		 * Force reset.  We can say we have dealt with any messages added
-		 * since the reset, as well; and that means we should clear the
-		 * signaled flag, too.
+		 * Force reset.  SICleanupQueue already moved us past the messages we
+		 * missed; any messages added since then are still to be read, so
+		 * make sure we come back for them.
 		 */
-		stateP->nextMsgNum = max;
+		*summary = stateP->summary;
+		memset(&stateP->summary, 0, sizeof(SharedInvalSummary));
 		stateP->resetState = false;
-		stateP->signaled = false;
+		if (stateP->nextMsgNum >= max)
+			stateP->signaled = false;
+		else
+			stateP->hasMessages = true;
 		LWLockRelease(SInvalReadLock);
 		return -1;
 	}
@@ -630,8 +683,9 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
  * callerHasWriteLock is true if caller is holding SInvalWriteLock.
  * minFree is the minimum number of message slots to make free.
  *
- * Possible side effects of this routine include marking one or more
- * backends as "reset" in the array, and sending PROCSIG_CATCHUP_INTERRUPT
+ * Possible side effects of this routine include moving one or more
+ * backends forward and marking them as "reset" in the array (see
+ * SISkipMessages), and sending PROCSIG_CATCHUP_INTERRUPT
  * to some backend that seems to be getting too far behind.  We signal at
  * most one backend at a time, for reasons explained at the top of the file.
  *
@@ -671,17 +725,17 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 		ProcState  *stateP = &segP->procState[i];
 		int			n = stateP->nextMsgNum;
 
-		/* Ignore if inactive or already in reset state */
-		if (stateP->procPid == 0 || stateP->resetState || stateP->sendOnly)
+		/* Ignore if inactive */
+		if (stateP->procPid == 0 || stateP->sendOnly)
 			continue;
 
 		/*
-		 * If we must free some space and this backend is preventing it, force
-		 * him into reset state and then ignore until he catches up.
+		 * If we must free some space and this backend is preventing it, move
+		 * him past all the queued messages and force him into reset state.
 		 */
 		if (n < lowbound)
 		{
-			stateP->resetState = true;
+			SISkipMessages(segP, stateP);
 			/* no point in signaling him ... */
 			continue;
 		}
@@ -752,6 +806,118 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 }
 
 
+/*
+ * SISummarizeMessage
+ *		Add a message to the summary of its block
+ */
+static void
+SISummarizeMessage(SISummaryBlock *block, const SharedInvalidationMessage *msg)
+{
+	Oid			dbId;
+
+	if (msg->id >= 0)
+	{
+		if (msg->id < SINVAL_SUMMARY_MAX_CATCACHES)
+			block->summary.catcaches[msg->id / 64] |=
+				UINT64CONST(1) << (msg->id % 64);
+		else
+			block->summary.flags |= SINVAL_SUMMARY_ALL_CATCACHES;
+		dbId = msg->cc.dbId;
+	}
+	else if (msg->id == SHAREDINVALCATALOG_ID)
+	{
+		block->summary.flags |= SINVAL_SUMMARY_ALL_CATCACHES;
+		dbId = msg->cat.dbId;
+	}
+	else if (msg->id == SHAREDINVALRELCACHE_ID)
+	{
+		block->summary.flags |= SINVAL_SUMMARY_RELCACHE;
+		dbId = msg->rc.dbId;
+	}
+	else if (msg->id == SHAREDINVALSMGR_ID)
+	{
+		/* backends can have smgr entries for other databases' relations */
+		block->anydbFlags |= SINVAL_SUMMARY_SMGR;
+		return;
+	}
+	else if (msg->id == SHAREDINVALRELMAP_ID)
+	{
+		block->summary.flags |= SINVAL_SUMMARY_RELCACHE;
+		dbId = msg->rm.dbId;
+	}
+	else if (msg->id == SHAREDINVALSNAPSHOT_ID)
+	{
+		/* a reset always invalidates the catalog snapshot */
+		dbId = msg->sn.dbId;
+	}
+	else
+	{
+		/* shouldn't happen, but be safe: it means reset everything */
+		block->anydbFlags |= SINVAL_SUMMARY_ALL_CATCACHES |
+			SINVAL_SUMMARY_RELCACHE | SINVAL_SUMMARY_SMGR;
+		return;
+	}
+
+	if (!OidIsValid(dbId))
+		block->alldbs = true;
+	else if (!OidIsValid(block->dbId))
+		block->dbId = dbId;
+	else if (block->dbId != dbId)
+		block->alldbs = true;
+}
+
+/*
+ * SISkipMessages
+ *		Move a backend that has fallen too far behind past all the queued
+ *		messages, and put it into reset state.
+ *
+ * The summaries of the messages it skips are merged into its ProcState, to
+ * be returned by SIGetDataEntries.  Blocks whose messages were all for some
+ * other database than the backend's are left out, except for the things that
+ * matter to any backend.  The backend might already be in reset state, if it
+ * hasn't read its messages since it was last moved forward; then the
+ * summaries just accumulate.
+ *
+ * Caller must hold both SInvalWriteLock and SInvalReadLock exclusively.
+ */
+static void
+SISkipMessages(SISeg *segP, ProcState *stateP)
+{
+	SharedInvalSummary *summary = &stateP->summary;
+	Oid			dbId = stateP->proc->databaseId;
+	int			blk;
+
+	/*
+	 * The backend can't be more than MAXNUMMESSAGES behind, so the summaries
+	 * of all the blocks it skips are still there.
+	 */
+	Assert(stateP->nextMsgNum >= segP->maxMsgNum - MAXNUMMESSAGES);
+
+	for (blk = stateP->nextMsgNum / SUMMARY_BLOCK;
+		 blk <= (segP->maxMsgNum - 1) / SUMMARY_BLOCK;
+		 blk++)
+	{
+		SISummaryBlock *block = &segP->summary[blk % NUMSUMMARYBLOCKS];
+		int			i;
+
+		summary->flags |= block->anydbFlags;
+
+		/* a backend not yet connected to a database gets everything */
+		if (OidIsValid(dbId) && !block->alldbs &&
+			OidIsValid(block->dbId) && block->dbId != dbId)
+			continue;
+
+		for (i = 0; i < lengthof(summary->catcaches); i++)
+			summary->catcaches[i] |= block->summary.catcaches[i];
+		summary->flags |= block->summary.flags;
+	}
+
+	stateP->nextMsgNum = segP->maxMsgNum;
+	stateP->resetState = true;
+	stateP->hasMessages = true;
+}
+
+
 /*
  * GetNextLocalTransactionId --- allocate a new LocalTransactionId
  *
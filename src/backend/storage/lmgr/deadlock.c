@@ -559,6 +559,16 @@ FindLockCycleRecurseMember(PGPROC *checkProc,
 	numLockModes = lockMethodTable->numLockModes;
 	conflictMask = lockMethodTable->conflictTab[checkProc->waitLockMode];
 
+	/*
+	 * Relation extension and page locks can't be part of a deadlock cycle,
+	 * since their holders never wait for other heavyweight locks.  They're
+	 * also the only locks that conflict within a lock group, which the code
+	 * below doesn't expect, so just skip them.
+	 */
+	if (lock->tag.locktag_type == LOCKTAG_RELATION_EXTEND ||
+		lock->tag.locktag_type == LOCKTAG_PAGE)
+		return false;
+
 	/*
 	 * Scan for procs that already hold conflicting locks.  These are "hard"
 	 * edges in the waits-for graph.
@@ -24,7 +24,9 @@
 #include "pgstat.h"
 #include "storage/lmgr.h"
 #include "storage/procarray.h"
+#include "storage/shmem.h"
 #include "storage/sinvaladt.h"
+#include "utils/hashutils.h"
 #include "utils/inval.h"
 
 
@@ -389,25 +391,177 @@ UnlockRelationIdForSession(LockRelId *relid, LOCKMODE lockmode)
 }
 
 /*
- *		LockRelationForExtension
+ * Relation extension locks.
  *
- * This lock tag is used to interlock addition of pages to relations.
- * We need such locking because bufmgr/smgr definition of P_NEW is not
+ * These are used to interlock addition of pages to relations.  We need such
+ * locking because bufmgr/smgr definition of P_NEW is not
  * race-condition-proof.
  *
+ * Extension locks are taken very often and held only briefly, so rather than
+ * going through the heavyweight lock manager they are LWLocks in a fixed-size
+ * array in shared memory, each relation being mapped to one of them by
+ * hashing.  Unrelated relations occasionally sharing a lock is harmless, as
+ * long as nobody waits for an extension lock while holding another one,
+ * which we never do.  Unlike heavyweight locks, they don't show up in
+ * pg_locks, don't take part in deadlock detection, and conflict between the
+ * members of a parallel group just as between unrelated backends.
+ *
+ * A backend may acquire the extension lock of a relation again while already
+ * holding it, for example when the FSM is extended while adding blocks to
+ * the heap.  LWLocks don't allow that by themselves, so we remember the
+ * extension lock we hold and just count further acquisitions of it.
+ */
+#define N_RELEXTLOCK_ENTS 1024
+
+typedef struct RelExtLock
+{
+	LWLock		lock;
+	pg_atomic_uint32 nwaiters;	/* number of backends waiting for it */
+} RelExtLock;
+
+/* Pad to a cache line, so that lock traffic on one doesn't slow others */
+typedef union RelExtLockPadded
+{
+	RelExtLock	relextlock;
+	char		pad[PG_CACHE_LINE_SIZE];
+} RelExtLockPadded;
+
+static RelExtLockPadded *RelExtLockArray;
+
+/* The extension lock held by this backend, and how many times */
+static int	held_relextlock = -1;
+static int	held_relextlock_count = 0;
+
+/*
+ * Return the extension lock for the given relation.
+ */
+static inline int
+RelExtLockTargetIndex(Relation relation)
+{
+	uint32		hashcode;
+
+	hashcode = hash_combine(murmurhash32(relation->rd_lockInfo.lockRelId.dbId),
+							murmurhash32(relation->rd_lockInfo.lockRelId.relId));
+
+	return hashcode % N_RELEXTLOCK_ENTS;
+}
+
+/*
+ * Return the LWLock mode corresponding to the given extension lock mode.
+ */
+static inline LWLockMode
+RelExtLockMode(LOCKMODE lockmode)
+{
+	Assert(lockmode == ExclusiveLock || lockmode == ShareLock);
+
+	return lockmode == ShareLock ? LW_SHARED : LW_EXCLUSIVE;
+}
+
+/*
+ * Do we already hold extension lock 'idx' in a mode covering 'mode'?
+ *
+ * held_relextlock is not reset when an error releases all of our LWLocks, so
+ * check that we still actually hold the lock before trusting it.
+ */
+static bool
+RelExtLockHeldByMe(int idx, LWLockMode mode)
+{
+	LWLock	   *lock = &RelExtLockArray[idx].relextlock.lock;
+
+	if (held_relextlock != idx || !LWLockHeldByMe(lock))
+		return false;
+
+	if (mode == LW_EXCLUSIVE && !LWLockHeldByMeInMode(lock, LW_EXCLUSIVE))
+		elog(ERROR, "cannot upgrade relation extension lock from share to exclusive mode");
+
+	return true;
+}
+
+/*
+ * Remember that we have acquired extension lock 'idx'.
+ */
+static void
+RelExtLockRemember(int idx)
+{
+	/*
+	 * Forget about the lock we remembered before if an error has released
+	 * it.  If it's this one, our caller already found that to be the case.
+	 */
+	if (held_relextlock == -1 || held_relextlock == idx ||
+		!LWLockHeldByMe(&RelExtLockArray[held_relextlock].relextlock.lock))
+	{
+		held_relextlock = idx;
+		held_relextlock_count = 1;
+	}
+}
+
+/*
+ * Report shared-memory space needed by RelExtLockShmemInit
+ */
+Size
+RelExtLockShmemSize(void)
+{
+	return mul_size(N_RELEXTLOCK_ENTS, sizeof(RelExtLockPadded));
+}
+
+/*
+ * Allocate and initialize the relation extension locks
+ */
+void
+RelExtLockShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	RelExtLockArray = (RelExtLockPadded *)
+		ShmemInitStruct("Relation Extension Locks",
+						RelExtLockShmemSize(), &found);
+
+	if (!found)
+	{
+		for (i = 0; i < N_RELEXTLOCK_ENTS; i++)
+		{
+			RelExtLock *relextlock = &RelExtLockArray[i].relextlock;
+
+			LWLockInitialize(&relextlock->lock, LWTRANCHE_RELATION_EXTENSION);
+			pg_atomic_init_u32(&relextlock->nwaiters, 0);
+		}
+	}
+}
+
+/*
+ *		LockRelationForExtension
+ *
  * We assume the caller is already holding some type of regular lock on
  * the relation, so no AcceptInvalidationMessages call is needed here.
  */
 void
 LockRelationForExtension(Relation relation, LOCKMODE lockmode)
 {
-	LOCKTAG		tag;
+	int			idx = RelExtLockTargetIndex(relation);
+	RelExtLock *relextlock = &RelExtLockArray[idx].relextlock;
+	LWLockMode	mode = RelExtLockMode(lockmode);
 
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
+	if (RelExtLockHeldByMe(idx, mode))
+	{
+		held_relextlock_count++;
+		return;
+	}
 
-	(void) LockAcquire(&tag, lockmode, false, false);
+	/*
+	 * Advertise that we're waiting, for RelationExtensionLockWaiterCount(),
+	 * unless we can get the lock right away.  LWLockAcquire() can't fail
+	 * once LWLockConditionalAcquire() got past its sanity checks, so the
+	 * count can't be left behind by an error.
+	 */
+	if (!LWLockConditionalAcquire(&relextlock->lock, mode))
+	{
+		pg_atomic_add_fetch_u32(&relextlock->nwaiters, 1);
+		LWLockAcquire(&relextlock->lock, mode);
+		pg_atomic_sub_fetch_u32(&relextlock->nwaiters, 1);
+	}
+
+	RelExtLockRemember(idx);
 }
 
 /*
@@ -419,30 +573,35 @@ LockRelationForExtension(Relation relation, LOCKMODE lockmode)
 bool
 ConditionalLockRelationForExtension(Relation relation, LOCKMODE lockmode)
 {
-	LOCKTAG		tag;
+	int			idx = RelExtLockTargetIndex(relation);
+	RelExtLock *relextlock = &RelExtLockArray[idx].relextlock;
+	LWLockMode	mode = RelExtLockMode(lockmode);
 
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
+	if (RelExtLockHeldByMe(idx, mode))
+	{
+		held_relextlock_count++;
+		return true;
+	}
 
-	return (LockAcquire(&tag, lockmode, false, true) != LOCKACQUIRE_NOT_AVAIL);
+	if (!LWLockConditionalAcquire(&relextlock->lock, mode))
+		return false;
+
+	RelExtLockRemember(idx);
+	return true;
 }
 
 /*
  *		RelationExtensionLockWaiterCount
  *
- * Count the number of processes waiting for the given relation extension lock.
+ * Count the number of processes waiting for the given relation extension
+ * lock.  This may include waiters for other relations sharing the lock.
  */
 int
 RelationExtensionLockWaiterCount(Relation relation)
 {
-	LOCKTAG		tag;
-
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
+	int			idx = RelExtLockTargetIndex(relation);
 
-	return LockWaiterCount(&tag);
+	return (int) pg_atomic_read_u32(&RelExtLockArray[idx].relextlock.nwaiters);
 }
 
 /*
@@ -451,13 +610,21 @@ RelationExtensionLockWaiterCount(Relation relation)
 void
 UnlockRelationForExtension(Relation relation, LOCKMODE lockmode)
 {
-	LOCKTAG		tag;
+	int			idx = RelExtLockTargetIndex(relation);
 
-	SET_LOCKTAG_RELATION_EXTEND(tag,
-								relation->rd_lockInfo.lockRelId.dbId,
-								relation->rd_lockInfo.lockRelId.relId);
+	if (held_relextlock == idx && held_relextlock_count > 1)
+	{
+		held_relextlock_count--;
+		return;
+	}
 
-	LockRelease(&tag, lockmode, false);
+	if (held_relextlock == idx)
+	{
+		held_relextlock = -1;
+		held_relextlock_count = 0;
+	}
+
+	LWLockRelease(&RelExtLockArray[idx].relextlock.lock);
 }
 
 /*
@@ -76,17 +76,23 @@
  */
 #include "postgres.h"
 
+#include "catalog/pg_type.h"
+#include "funcapi.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "pg_trace.h"
+#include "portability/instr_time.h"
 #include "postmaster/postmaster.h"
 #include "replication/slot.h"
 #include "storage/ipc.h"
 #include "storage/predicate.h"
 #include "storage/proc.h"
 #include "storage/proclist.h"
+#include "storage/shmem.h"
 #include "storage/spin.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 
 #ifdef LWLOCK_STATS
 #include "utils/hsearch.h"
@@ -96,6 +102,12 @@
 /* We use the ShmemLock spinlock to protect LWLockCounter */
 extern slock_t *ShmemLock;
 
+/*
+ * The dynamic-allocation counter for tranches, stored in shared memory just
+ * before the first LWLock; set up by CreateLWLocks().
+ */
+static int *LWLockCounter = NULL;
+
 #define LW_FLAG_HAS_WAITERS			((uint32) 1 << 30)
 #define LW_FLAG_RELEASE_OK			((uint32) 1 << 29)
 #define LW_FLAG_LOCKED				((uint32) 1 << 28)
@@ -184,6 +196,87 @@ static HTAB *lwlock_stats_htab;
 static lwlock_stats lwlock_stats_dummy;
 #endif
 
+/*
+ * Cumulative per-tranche statistics, collected when track_lwlocks is on.
+ *
+ * Unlike LWLOCK_STATS above, these are meant to be cheap enough to leave on
+ * in production.  Every PGPROC has its own array of counters in shared
+ * memory, indexed by tranche ID, which only its owner ever writes, so no
+ * atomic operations or locks are needed to count; readers just add up the
+ * arrays of all PGPROCs.  (On platforms without single-copy 64-bit loads and
+ * stores a reader might see a torn counter; we accept that for what is an
+ * approximate, monitoring-only facility.)  The arrays are never cleared when
+ * a PGPROC is recycled, so the sums are cumulative since server start.
+ * Resetting merely remembers the current sums as a baseline to subtract.
+ *
+ * Tranches registered by extensions are tracked only if their ID is below
+ * NUM_TRACKED_LWLOCK_TRANCHES.
+ */
+#define LWLOCK_STATS_EXTENSION_TRANCHES		64
+#define NUM_TRACKED_LWLOCK_TRANCHES \
+	(LWTRANCHE_FIRST_USER_DEFINED + LWLOCK_STATS_EXTENSION_TRANCHES)
+
+typedef struct LWLockTrancheStats
+{
+	uint64		shared_acquires;
+	uint64		exclusive_acquires;
+	uint64		contended;		/* acquisitions or waits that had to sleep */
+	uint64		spin_delays;	/* delays spinning on the wait list lock */
+	uint64		wait_time;		/* time spent sleeping, in nanoseconds */
+} LWLockTrancheStats;
+
+typedef struct LWLockStatsShmemStruct
+{
+	slock_t		mutex;			/* protects the fields below */
+	TimestampTz stat_reset_timestamp;
+	LWLockTrancheStats baseline[NUM_TRACKED_LWLOCK_TRANCHES];
+} LWLockStatsShmemStruct;
+
+bool		track_lwlocks = false;
+
+/* Other GUC variables */
+int			lwlock_max_spins = 100;
+bool		lwlock_handoff = false;
+
+/* spin delays always allowed before sleeping, see LWLockSpin() */
+#define LWLOCK_MIN_SPINS	4
+
+static LWLockStatsShmemStruct *LWLockStatsShmem = NULL;
+
+/* counters of all PGPROCs, NUM_TRACKED_LWLOCK_TRANCHES per PGPROC */
+static LWLockTrancheStats *LWLockStatsArray = NULL;
+
+/* this process's counters, if it has a PGPROC */
+static LWLockTrancheStats *MyLWLockStats = NULL;
+
+static void LWLockStatsSum(LWLockTrancheStats *sums);
+
+/*
+ * Return the counters to update for an operation on this lock, or NULL if
+ * we aren't collecting statistics for it.
+ */
+static inline LWLockTrancheStats *
+LWLockStatsEntry(LWLock *lock)
+{
+	if (!track_lwlocks || MyLWLockStats == NULL ||
+		lock->tranche >= NUM_TRACKED_LWLOCK_TRANCHES)
+		return NULL;
+	return &MyLWLockStats[lock->tranche];
+}
+
+/*
+ * Add the time elapsed since wait_start to the entry's wait time.
+ */
+static inline void
+LWLockStatsCountWait(LWLockTrancheStats *trstats, instr_time *wait_start)
+{
+	instr_time	wait_time;
+
+	INSTR_TIME_SET_CURRENT(wait_time);
+	INSTR_TIME_SUBTRACT(wait_time, *wait_start);
+	trstats->wait_time += INSTR_TIME_GET_NANOSEC(wait_time);
+}
+
 #ifdef LOCK_DEBUG
 bool		Trace_lwlocks = false;
 
@@ -390,7 +483,6 @@ CreateLWLocks(void)
 	if (!IsUnderPostmaster)
 	{
 		Size		spaceLocks = LWLockShmemSize();
-		int		   *LWLockCounter;
 		char	   *ptr;
 
 		/* Allocate space */
@@ -414,6 +506,11 @@ CreateLWLocks(void)
 		/* Initialize all LWLocks */
 		InitializeLWLocks();
 	}
+	else
+	{
+		/* EXEC_BACKEND child: find the counter in the inherited segment */
+		LWLockCounter = (int *) ((char *) MainLWLockArray - sizeof(int));
+	}
 
 	/* Register all LWLock tranches */
 	RegisterLWLockTranches();
@@ -510,6 +607,8 @@ RegisterLWLockTranches(void)
 						  "predicate_lock_manager");
 	LWLockRegisterTranche(LWTRANCHE_PARALLEL_QUERY_DSA,
 						  "parallel_query_dsa");
+	LWLockRegisterTranche(LWTRANCHE_PARALLEL_ANALYZE_DSA,
+						  "parallel_analyze_dsa");
 	LWLockRegisterTranche(LWTRANCHE_SESSION_DSA,
 						  "session_dsa");
 	LWLockRegisterTranche(LWTRANCHE_SESSION_RECORD_TABLE,
@@ -522,6 +621,15 @@ RegisterLWLockTranches(void)
 	LWLockRegisterTranche(LWTRANCHE_PARALLEL_APPEND, "parallel_append");
 	LWLockRegisterTranche(LWTRANCHE_PARALLEL_HASH_JOIN, "parallel_hash_join");
 	LWLockRegisterTranche(LWTRANCHE_SXACT, "serializable_xact");
+	LWLockRegisterTranche(LWTRANCHE_PARALLEL_REDO_EXTENSION,
+						  "parallel_redo_extension");
+	LWLockRegisterTranche(LWTRANCHE_STATS_DSA, "stats_dsa");
+	LWLockRegisterTranche(LWTRANCHE_STATS_HASH, "stats_hash");
+	LWLockRegisterTranche(LWTRANCHE_SHARED_PLAN_CACHE, "shared_plan_cache");
+	LWLockRegisterTranche(LWTRANCHE_SHARED_PLAN_CACHE_DSA,
+						  "shared_plan_cache_dsa");
+	LWLockRegisterTranche(LWTRANCHE_RELATION_EXTENSION,
+						  "relation_extension");
 
 	/* Register named tranches. */
 	for (i = 0; i < NamedLWLockTrancheRequests; i++)
@@ -538,6 +646,198 @@ InitLWLockAccess(void)
 #ifdef LWLOCK_STATS
 	init_lwlock_stats();
 #endif
+
+	Assert(MyProc != NULL);
+	MyLWLockStats =
+		&LWLockStatsArray[MyProc->pgprocno * NUM_TRACKED_LWLOCK_TRANCHES];
+}
+
+/*
+ * Compute shmem space needed for per-tranche LWLock statistics.
+ */
+Size
+LWLockStatsShmemSize(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(LWLockStatsShmemStruct));
+	size = add_size(size,
+					mul_size(mul_size(MaxBackends + NUM_AUXILIARY_PROCS,
+									  NUM_TRACKED_LWLOCK_TRANCHES),
+							 sizeof(LWLockTrancheStats)));
+	return size;
+}
+
+/*
+ * Allocate and initialize per-tranche LWLock statistics in shared memory.
+ */
+void
+LWLockStatsShmemInit(void)
+{
+	bool		found;
+
+	LWLockStatsShmem = (LWLockStatsShmemStruct *)
+		ShmemInitStruct("LWLock Statistics", LWLockStatsShmemSize(), &found);
+	LWLockStatsArray = (LWLockTrancheStats *)
+		((char *) LWLockStatsShmem + MAXALIGN(sizeof(LWLockStatsShmemStruct)));
+
+	if (!found)
+	{
+		MemSet(LWLockStatsShmem, 0, LWLockStatsShmemSize());
+		SpinLockInit(&LWLockStatsShmem->mutex);
+		LWLockStatsShmem->stat_reset_timestamp = GetCurrentTimestamp();
+	}
+}
+
+/*
+ * Add up the counters of all PGPROCs.
+ */
+static void
+LWLockStatsSum(LWLockTrancheStats *sums)
+{
+	int			nprocs = MaxBackends + NUM_AUXILIARY_PROCS;
+	int			i;
+	int			j;
+
+	MemSet(sums, 0, NUM_TRACKED_LWLOCK_TRANCHES * sizeof(LWLockTrancheStats));
+
+	for (i = 0; i < nprocs; i++)
+	{
+		volatile LWLockTrancheStats *procstats =
+		&LWLockStatsArray[i * NUM_TRACKED_LWLOCK_TRANCHES];
+
+		for (j = 0; j < NUM_TRACKED_LWLOCK_TRANCHES; j++)
+		{
+			sums[j].shared_acquires += procstats[j].shared_acquires;
+			sums[j].exclusive_acquires += procstats[j].exclusive_acquires;
+			sums[j].contended += procstats[j].contended;
+			sums[j].spin_delays += procstats[j].spin_delays;
+			sums[j].wait_time += procstats[j].wait_time;
+		}
+	}
+}
+
+/*
+ * Reset the statistics shown by pg_stat_lwlocks.
+ */
+void
+LWLockStatsReset(void)
+{
+	LWLockTrancheStats *sums;
+
+	sums = palloc(NUM_TRACKED_LWLOCK_TRANCHES * sizeof(LWLockTrancheStats));
+	LWLockStatsSum(sums);
+
+	SpinLockAcquire(&LWLockStatsShmem->mutex);
+	memcpy(LWLockStatsShmem->baseline, sums,
+		   NUM_TRACKED_LWLOCK_TRANCHES * sizeof(LWLockTrancheStats));
+	LWLockStatsShmem->stat_reset_timestamp = GetCurrentTimestamp();
+	SpinLockRelease(&LWLockStatsShmem->mutex);
+
+	pfree(sums);
+}
+
+/*
+ * SQL-callable function backing the pg_stat_lwlocks view.
+ *
+ * Returns one row per tranche known to this backend.  As elsewhere, the
+ * names of tranches registered only in other backends can't be resolved and
+ * are shown as "extension".
+ */
+Datum
+pg_stat_get_lwlocks(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_LWLOCKS_COLS	7
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	LWLockTrancheStats *sums;
+	LWLockTrancheStats *baseline;
+	TimestampTz reset_time;
+	int			ntranches;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	sums = palloc(NUM_TRACKED_LWLOCK_TRANCHES * sizeof(LWLockTrancheStats));
+	baseline = palloc(NUM_TRACKED_LWLOCK_TRANCHES * sizeof(LWLockTrancheStats));
+
+	SpinLockAcquire(&LWLockStatsShmem->mutex);
+	memcpy(baseline, LWLockStatsShmem->baseline,
+		   NUM_TRACKED_LWLOCK_TRANCHES * sizeof(LWLockTrancheStats));
+	reset_time = LWLockStatsShmem->stat_reset_timestamp;
+	SpinLockRelease(&LWLockStatsShmem->mutex);
+
+	LWLockStatsSum(sums);
+
+	/* Don't report tranche IDs that haven't been handed out yet */
+	SpinLockAcquire(ShmemLock);
+	ntranches = Min(*LWLockCounter, NUM_TRACKED_LWLOCK_TRANCHES);
+	SpinLockRelease(ShmemLock);
+
+	for (i = 0; i < ntranches; i++)
+	{
+		Datum		values[PG_STAT_GET_LWLOCKS_COLS];
+		bool		nulls[PG_STAT_GET_LWLOCKS_COLS];
+		const char *name;
+
+		name = GetLWLockIdentifier(PG_WAIT_LWLOCK, i);
+
+		/* Skip holes in the numbering of individual LWLocks */
+		if (i < NUM_INDIVIDUAL_LWLOCKS && strncmp(name, "<unassigned:", 12) == 0)
+			continue;
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(name);
+		values[1] = Int64GetDatum((int64) (sums[i].shared_acquires -
+										   baseline[i].shared_acquires));
+		values[2] = Int64GetDatum((int64) (sums[i].exclusive_acquires -
+										   baseline[i].exclusive_acquires));
+		values[3] = Int64GetDatum((int64) (sums[i].contended -
+										   baseline[i].contended));
+		values[4] = Int64GetDatum((int64) (sums[i].spin_delays -
+										   baseline[i].spin_delays));
+		/* convert from nanoseconds to milliseconds for display */
+		values[5] = Float8GetDatum((double) (sums[i].wait_time -
+											 baseline[i].wait_time) / 1000000.0);
+		values[6] = TimestampTzGetDatum(reset_time);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	pfree(sums);
+	pfree(baseline);
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
 }
 
 /*
@@ -583,9 +883,7 @@ int
 LWLockNewTrancheId(void)
 {
 	int			result;
-	int		   *LWLockCounter;
 
-	LWLockCounter = (int *) ((char *) MainLWLockArray - sizeof(int));
 	SpinLockAcquire(ShmemLock);
 	result = (*LWLockCounter)++;
 	SpinLockRelease(ShmemLock);
@@ -682,6 +980,7 @@ LWLockInitialize(LWLock *lock, int tranche_id)
 	pg_atomic_init_u32(&lock->nwaiters, 0);
 #endif
 	lock->tranche = tranche_id;
+	lock->spins = 0;
 	proclist_init(&lock->waiters);
 }
 
@@ -799,6 +1098,57 @@ LWLockAttemptLock(LWLock *lock, LWLockMode mode)
 	pg_unreachable();
 }
 
+/*
+ * Spin for a while, waiting for the lock to become free, before we go to the
+ * trouble of queueing ourselves and sleeping.  Returns true if we got the
+ * lock.
+ *
+ * Sleeping and being woken up again costs a couple of context switches,
+ * which is a lot longer than most LWLocks are held for.  How long to spin is
+ * adapted per lock: lock->spins is a moving average of the number of spin
+ * delays that recent successful spinners needed, and we spin for about twice
+ * that, up to lwlock_max_spins.  LWLOCK_MIN_SPINS are always allowed, so
+ * that a lock whose average has decayed to zero gets tried again now and
+ * then.  A spin that fails suggests that the lock is held for longer than
+ * it's worth spinning for, so it decays the average.
+ *
+ * lock->spins is read and written without any locking; it's only a hint,
+ * and a lost update doesn't matter.
+ */
+static bool
+LWLockSpin(LWLock *lock, LWLockMode mode)
+{
+	int			estimate = lock->spins;
+	int			limit;
+	int			i;
+
+	limit = Min(2 * estimate + LWLOCK_MIN_SPINS, lwlock_max_spins);
+
+	for (i = 0; i < limit; i++)
+	{
+		uint32		state;
+		bool		lock_free;
+
+		SPIN_DELAY();
+
+		/* only attempt the atomic operation once it looks worthwhile */
+		state = pg_atomic_read_u32(&lock->state);
+		if (mode == LW_EXCLUSIVE)
+			lock_free = (state & LW_LOCK_MASK) == 0;
+		else
+			lock_free = (state & LW_VAL_EXCLUSIVE) == 0;
+
+		if (lock_free && !LWLockAttemptLock(lock, mode))
+		{
+			lock->spins = (uint16) (estimate + (i + 1 - estimate) / 8);
+			return true;
+		}
+	}
+
+	lock->spins = (uint16) (estimate - estimate / 8);
+	return false;
+}
+
 /*
  * Lock the LWLock's wait list against concurrent activity.
  *
@@ -811,9 +1161,9 @@ static void
 LWLockWaitListLock(LWLock *lock)
 {
 	uint32		old_state;
+	uint32		delays = 0;
 #ifdef LWLOCK_STATS
 	lwlock_stats *lwstats;
-	uint32		delays = 0;
 
 	lwstats = get_lwlock_stats_entry(lock);
 #endif
@@ -836,9 +1186,7 @@ LWLockWaitListLock(LWLock *lock)
 				perform_spin_delay(&delayStatus);
 				old_state = pg_atomic_read_u32(&lock->state);
 			}
-#ifdef LWLOCK_STATS
 			delays += delayStatus.delays;
-#endif
 			finish_spin_delay(&delayStatus);
 		}
 
@@ -851,6 +1199,14 @@ LWLockWaitListLock(LWLock *lock)
 #ifdef LWLOCK_STATS
 	lwstats->spin_delay_count += delays;
 #endif
+
+	if (delays > 0)
+	{
+		LWLockTrancheStats *trstats = LWLockStatsEntry(lock);
+
+		if (trstats)
+			trstats->spin_delays += delays;
+	}
 }
 
 /*
@@ -877,6 +1233,7 @@ LWLockWakeup(LWLock *lock)
 {
 	bool		new_release_ok;
 	bool		wokeup_somebody = false;
+	bool		handoff = false;
 	proclist_head wakeup;
 	proclist_mutable_iter iter;
 
@@ -922,16 +1279,32 @@ LWLockWakeup(LWLock *lock)
 
 	Assert(proclist_is_empty(&wakeup) || pg_atomic_read_u32(&lock->state) & LW_FLAG_HAS_WAITERS);
 
+	/*
+	 * In handoff mode, if all we're waking is a single exclusive waiter,
+	 * acquire the lock on its behalf below (if it's still free), rather than
+	 * have it race against everybody else for the lock once it gets to run.
+	 */
+	if (lwlock_handoff && !proclist_is_empty(&wakeup) &&
+		wakeup.head == wakeup.tail &&
+		GetPGProcByNumber(wakeup.head)->lwWaitMode == LW_EXCLUSIVE)
+		handoff = true;
+
 	/* unset required flags, and release lock, in one fell swoop */
 	{
 		uint32		old_state;
 		uint32		desired_state;
+		bool		handed_off = false;
 
 		old_state = pg_atomic_read_u32(&lock->state);
 		while (true)
 		{
 			desired_state = old_state;
 
+			/* grab the lock for the waiter, if we can */
+			handed_off = handoff && (old_state & LW_LOCK_MASK) == 0;
+			if (handed_off)
+				desired_state += LW_VAL_EXCLUSIVE;
+
 			/* compute desired flags */
 
 			if (new_release_ok)
@@ -948,6 +1321,17 @@ LWLockWakeup(LWLock *lock)
 											   desired_state))
 				break;
 		}
+
+		if (handed_off)
+		{
+			PGPROC	   *waiter = GetPGProcByNumber(wakeup.head);
+
+			LOG_LWDEBUG("LWLockRelease", lock, "handing lock over to waiter");
+			waiter->lwGranted = true;
+#ifdef LOCK_DEBUG
+			lock->owner = waiter;
+#endif
+		}
 	}
 
 	/* Awaken any waiters I removed from the queue. */
@@ -966,7 +1350,8 @@ LWLockWakeup(LWLock *lock)
 		 * being corrupted.
 		 *
 		 * The barrier pairs with the LWLockWaitListLock() when enqueuing for
-		 * another lock.
+		 * another lock, and makes sure lwGranted is visible by the time the
+		 * waiter sees lwWaiting being unset.
 		 */
 		pg_write_barrier();
 		waiter->lwWaiting = false;
@@ -1124,6 +1509,8 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 	PGPROC	   *proc = MyProc;
 	bool		result = true;
 	int			extraWaits = 0;
+	LWLockTrancheStats *trstats = LWLockStatsEntry(lock);
+	instr_time	wait_start;
 #ifdef LWLOCK_STATS
 	lwlock_stats *lwstats;
 
@@ -1192,6 +1579,16 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 			break;				/* got the lock */
 		}
 
+		/*
+		 * Unless we've already had to sleep for this lock, spin for a little
+		 * while in the hope that it's about to be released.
+		 */
+		if (result && lwlock_max_spins > 0 && LWLockSpin(lock, mode))
+		{
+			LOG_LWDEBUG("LWLockAcquire", lock, "acquired lock after spinning");
+			break;
+		}
+
 		/*
 		 * Ok, at this point we couldn't grab the lock on the first try. We
 		 * cannot simply queue ourselves to the end of the list and wait to be
@@ -1236,6 +1633,9 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 		lwstats->block_count++;
 #endif
 
+		if (trstats)
+			INSTR_TIME_SET_CURRENT(wait_start);
+
 		LWLockReportWaitStart(lock);
 		TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), mode);
 
@@ -1247,6 +1647,9 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 			extraWaits++;
 		}
 
+		if (trstats)
+			LWLockStatsCountWait(trstats, &wait_start);
+
 		/* Retrying, allow LWLockRelease to release waiters again. */
 		pg_atomic_fetch_or_u32(&lock->state, LW_FLAG_RELEASE_OK);
 
@@ -1264,12 +1667,34 @@ LWLockAcquire(LWLock *lock, LWLockMode mode)
 
 		LOG_LWDEBUG("LWLockAcquire", lock, "awakened");
 
-		/* Now loop back and try to acquire lock again. */
 		result = false;
+
+		/*
+		 * If the releaser handed the lock over to us, we're done.  Otherwise
+		 * loop back and try to acquire it again.  The barrier pairs with the
+		 * one in LWLockWakeup().
+		 */
+		pg_read_barrier();
+		if (proc->lwGranted)
+		{
+			proc->lwGranted = false;
+			LOG_LWDEBUG("LWLockAcquire", lock, "lock handed over by releaser");
+			break;
+		}
 	}
 
 	TRACE_POSTGRESQL_LWLOCK_ACQUIRE(T_NAME(lock), mode);
 
+	if (trstats)
+	{
+		if (mode == LW_EXCLUSIVE)
+			trstats->exclusive_acquires++;
+		else
+			trstats->shared_acquires++;
+		if (!result)
+			trstats->contended++;
+	}
+
 	/* Add lock to list of locks held by this backend */
 	held_lwlocks[num_held_lwlocks].lock = lock;
 	held_lwlocks[num_held_lwlocks++].mode = mode;
@@ -1323,6 +1748,16 @@ LWLockConditionalAcquire(LWLock *lock, LWLockMode mode)
 	}
 	else
 	{
+		LWLockTrancheStats *trstats = LWLockStatsEntry(lock);
+
+		if (trstats)
+		{
+			if (mode == LW_EXCLUSIVE)
+				trstats->exclusive_acquires++;
+			else
+				trstats->shared_acquires++;
+		}
+
 		/* Add lock to list of locks held by this backend */
 		held_lwlocks[num_held_lwlocks].lock = lock;
 		held_lwlocks[num_held_lwlocks++].mode = mode;
@@ -1351,6 +1786,8 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 	PGPROC	   *proc = MyProc;
 	bool		mustwait;
 	int			extraWaits = 0;
+	LWLockTrancheStats *trstats = LWLockStatsEntry(lock);
+	instr_time	wait_start;
 #ifdef LWLOCK_STATS
 	lwlock_stats *lwstats;
 
@@ -1397,6 +1834,9 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 			lwstats->block_count++;
 #endif
 
+			if (trstats)
+				INSTR_TIME_SET_CURRENT(wait_start);
+
 			LWLockReportWaitStart(lock);
 			TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), mode);
 
@@ -1408,6 +1848,12 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 				extraWaits++;
 			}
 
+			if (trstats)
+			{
+				LWLockStatsCountWait(trstats, &wait_start);
+				trstats->contended++;
+			}
+
 #ifdef LOCK_DEBUG
 			{
 				/* not waiting anymore */
@@ -1451,6 +1897,13 @@ LWLockAcquireOrWait(LWLock *lock, LWLockMode mode)
 	else
 	{
 		LOG_LWDEBUG("LWLockAcquireOrWait", lock, "succeeded");
+		if (trstats)
+		{
+			if (mode == LW_EXCLUSIVE)
+				trstats->exclusive_acquires++;
+			else
+				trstats->shared_acquires++;
+		}
 		/* Add lock to list of locks held by this backend */
 		held_lwlocks[num_held_lwlocks].lock = lock;
 		held_lwlocks[num_held_lwlocks++].mode = mode;
@@ -1535,6 +1988,9 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
 	PGPROC	   *proc = MyProc;
 	int			extraWaits = 0;
 	bool		result = false;
+	bool		waited = false;
+	LWLockTrancheStats *trstats = LWLockStatsEntry(lock);
+	instr_time	wait_start;
 #ifdef LWLOCK_STATS
 	lwlock_stats *lwstats;
 
@@ -1613,6 +2069,9 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
 		lwstats->block_count++;
 #endif
 
+		if (trstats)
+			INSTR_TIME_SET_CURRENT(wait_start);
+
 		LWLockReportWaitStart(lock);
 		TRACE_POSTGRESQL_LWLOCK_WAIT_START(T_NAME(lock), LW_EXCLUSIVE);
 
@@ -1624,6 +2083,10 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
 			extraWaits++;
 		}
 
+		if (trstats)
+			LWLockStatsCountWait(trstats, &wait_start);
+		waited = true;
+
 #ifdef LOCK_DEBUG
 		{
 			/* not waiting anymore */
@@ -1643,6 +2106,9 @@ LWLockWaitForVar(LWLock *lock, uint64 *valptr, uint64 oldval, uint64 *newval)
 
 	TRACE_POSTGRESQL_LWLOCK_ACQUIRE(T_NAME(lock), LW_EXCLUSIVE);
 
+	if (trstats && waited)
+		trstats->contended++;
+
 	/*
 	 * Fix the process wait semaphore's count for any absorbed wakeups.
 	 */
@@ -823,8 +823,8 @@ OldSerXidInit(void)
 	 */
 	OldSerXidSlruCtl->PagePrecedes = OldSerXidPagePrecedesLogically;
 	SimpleLruInit(OldSerXidSlruCtl, "oldserxid",
-				  NUM_OLDSERXID_BUFFERS, 0, OldSerXidLock, "pg_serial",
-				  LWTRANCHE_OLDSERXID_BUFFERS);
+				  serializable_buffers, 0, "pg_serial",
+				  LWTRANCHE_OLDSERXID_BUFFERS, LWTRANCHE_OLDSERXID_SLRU);
 	/* Override default assumption that writes should be fsync'd */
 	OldSerXidSlruCtl->do_fsync = false;
 
@@ -859,11 +859,18 @@ OldSerXidAdd(TransactionId xid, SerCommitSeqNo minConflictCommitSeqNo)
 	int			slotno;
 	int			firstZeroPage;
 	bool		isNewPage;
+	LWLock	   *lock;
 
 	Assert(TransactionIdIsValid(xid));
 
 	targetPage = OldSerXidPage(xid);
+	lock = SimpleLruGetBankLock(OldSerXidSlruCtl, targetPage);
 
+	/*
+	 * In this routine, we must hold both OldSerXidLock and the SLRU bank
+	 * lock simultaneously while making the SLRU data catch up with the new
+	 * state that we determine.
+	 */
 	LWLockAcquire(OldSerXidLock, LW_EXCLUSIVE);
 
 	/*
@@ -900,20 +907,28 @@ OldSerXidAdd(TransactionId xid, SerCommitSeqNo minConflictCommitSeqNo)
 
 	if (isNewPage)
 	{
-		/* Initialize intervening pages. */
-		while (firstZeroPage != targetPage)
+		/* Initialize intervening pages; might involve trading bank locks */
+		for (;;)
 		{
-			(void) SimpleLruZeroPage(OldSerXidSlruCtl, firstZeroPage);
+			lock = SimpleLruGetBankLock(OldSerXidSlruCtl, firstZeroPage);
+			LWLockAcquire(lock, LW_EXCLUSIVE);
+			slotno = SimpleLruZeroPage(OldSerXidSlruCtl, firstZeroPage);
+			if (firstZeroPage == targetPage)
+				break;
 			firstZeroPage = OldSerXidNextPage(firstZeroPage);
+			LWLockRelease(lock);
 		}
-		slotno = SimpleLruZeroPage(OldSerXidSlruCtl, targetPage);
 	}
 	else
+	{
+		LWLockAcquire(lock, LW_EXCLUSIVE);
 		slotno = SimpleLruReadPage(OldSerXidSlruCtl, targetPage, true, xid);
+	}
 
 	OldSerXidValue(slotno, xid) = minConflictCommitSeqNo;
 	OldSerXidSlruCtl->shared->page_dirty[slotno] = true;
 
+	LWLockRelease(lock);
 	LWLockRelease(OldSerXidLock);
 }
 
@@ -947,13 +962,14 @@ OldSerXidGetMinConflictCommitSeqNo(TransactionId xid)
 		return 0;
 
 	/*
-	 * The following function must be called without holding OldSerXidLock,
-	 * but will return with that lock held, which must then be released.
+	 * The following function must be called without holding the SLRU bank
+	 * lock, but will return with that lock held, which must then be
+	 * released.
 	 */
 	slotno = SimpleLruReadPage_ReadOnly(OldSerXidSlruCtl,
 										OldSerXidPage(xid), xid);
 	val = OldSerXidValue(slotno, xid);
-	LWLockRelease(OldSerXidLock);
+	LWLockRelease(SimpleLruGetBankLock(OldSerXidSlruCtl, OldSerXidPage(xid)));
 	return val;
 }
 
@@ -1328,7 +1344,7 @@ PredicateLockShmemSize(void)
 
 	/* Shared memory structures for SLRU tracking of old committed xids. */
 	size = add_size(size, sizeof(OldSerXidControlData));
-	size = add_size(size, SimpleLruShmemSize(NUM_OLDSERXID_BUFFERS, 0));
+	size = add_size(size, SimpleLruShmemSize(serializable_buffers, 0));
 
 	return size;
 }
@@ -4059,10 +4075,12 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 								Snapshot snapshot)
 {
 	TransactionId xid;
+	TransactionId topxid;
 	SERIALIZABLEXIDTAG sxidtag;
 	SERIALIZABLEXID *sxid;
 	SERIALIZABLEXACT *sxact;
 	HTSV_Result htsvResult;
+	LWLockMode	lockmode = LW_SHARED;
 
 	if (!SerializationNeededForRead(relation, snapshot))
 		return;
@@ -4131,7 +4149,10 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 	 */
 	if (TransactionIdEquals(xid, GetTopTransactionIdIfAny()))
 		return;
-	xid = SubTransGetTopmostTransaction(xid);
+	topxid = SubXidOverflowGetTopmost(xid);
+	if (!TransactionIdIsValid(topxid))
+		topxid = SubTransGetTopmostTransaction(xid);
+	xid = topxid;
 	if (TransactionIdPrecedes(xid, TransactionXmin))
 		return;
 	if (TransactionIdEquals(xid, GetTopTransactionIdIfAny()))
@@ -4139,9 +4160,17 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 
 	/*
 	 * Find sxact or summarized info for the top level xid.
+	 *
+	 * Most calls end up deciding that there is nothing to record, so we
+	 * start out with only a shared lock on SerializableXactHashLock, which
+	 * lets concurrent readers run this check in parallel.  If it turns out
+	 * that we do need to change something, we release the lock, take it in
+	 * exclusive mode, and start over, since the state we looked at may have
+	 * changed while we weren't holding the lock.
 	 */
 	sxidtag.xid = xid;
-	LWLockAcquire(SerializableXactHashLock, LW_EXCLUSIVE);
+retry:
+	LWLockAcquire(SerializableXactHashLock, lockmode);
 	sxid = (SERIALIZABLEXID *)
 		hash_search(SerializableXidHash, &sxidtag, HASH_FIND, NULL);
 	if (!sxid)
@@ -4173,7 +4202,16 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 						 errdetail_internal("Reason code: Canceled on identification as a pivot, with conflict out to old committed transaction %u.", xid),
 						 errhint("The transaction might succeed if retried.")));
 
-			MySerializableXact->flags |= SXACT_FLAG_SUMMARY_CONFLICT_OUT;
+			if (!SxactHasSummaryConflictOut(MySerializableXact))
+			{
+				if (lockmode == LW_SHARED)
+				{
+					LWLockRelease(SerializableXactHashLock);
+					lockmode = LW_EXCLUSIVE;
+					goto retry;
+				}
+				MySerializableXact->flags |= SXACT_FLAG_SUMMARY_CONFLICT_OUT;
+			}
 		}
 
 		/* It's not serializable or otherwise not important. */
@@ -4199,6 +4237,12 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 	{
 		if (!SxactIsPrepared(sxact))
 		{
+			if (lockmode == LW_SHARED)
+			{
+				LWLockRelease(SerializableXactHashLock);
+				lockmode = LW_EXCLUSIVE;
+				goto retry;
+			}
 			sxact->flags |= SXACT_FLAG_DOOMED;
 			LWLockRelease(SerializableXactHashLock);
 			return;
@@ -4244,6 +4288,13 @@ CheckForSerializableConflictOut(bool visible, Relation relation,
 		return;
 	}
 
+	if (lockmode == LW_SHARED)
+	{
+		LWLockRelease(SerializableXactHashLock);
+		lockmode = LW_EXCLUSIVE;
+		goto retry;
+	}
+
 	/*
 	 * Flag the conflict.  But first, if this conflict creates a dangerous
 	 * structure, ereport an error.
@@ -35,6 +35,7 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "access/multixact.h"
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
@@ -62,7 +63,10 @@ int			DeadlockTimeout = 1000;
 int			StatementTimeout = 0;
 int			LockTimeout = 0;
 int			IdleInTransactionSessionTimeout = 0;
+int			IdleCacheReleaseTimeout = 0;
 bool		log_lock_waits = false;
+int			fast_path_lock_slots = FP_LOCK_SLOTS_PER_GROUP;
+int			subxid_overflow_slots = 1024;
 
 /* Pointer to this process's PGPROC and PGXACT structs, if any */
 PGPROC	   *MyProc = NULL;
@@ -119,6 +123,25 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(PGXACT)));
 	size = add_size(size, mul_size(max_prepared_xacts, sizeof(PGXACT)));
 
+	/* Dense copies of the most heavily accessed PGXACT fields */
+	size = add_size(size, mul_size(MaxBackends + NUM_AUXILIARY_PROCS +
+								   max_prepared_xacts,
+								   sizeof(TransactionId) +
+								   sizeof(XidCacheStatus) +
+								   sizeof(uint8)));
+
+	/* Fast-path lock arrays */
+	size = add_size(size, mul_size(MaxBackends + NUM_AUXILIARY_PROCS +
+								   max_prepared_xacts,
+								   FP_LOCK_GROUPS_PER_BACKEND * sizeof(uint64) +
+								   FP_LOCK_SLOTS_PER_BACKEND * sizeof(Oid)));
+
+	/* Subtransaction XID overflow arrays */
+	size = add_size(size, mul_size(MaxBackends + NUM_AUXILIARY_PROCS +
+								   max_prepared_xacts,
+								   mul_size(subxid_overflow_slots,
+											sizeof(TransactionId))));
+
 	return size;
 }
 
@@ -165,6 +188,9 @@ InitProcGlobal(void)
 {
 	PGPROC	   *procs;
 	PGXACT	   *pgxacts;
+	uint64	   *fpLockBits;
+	Oid		   *fpRelId;
+	TransactionId *overflowSubxids;
 	int			i,
 				j;
 	bool		found;
@@ -190,6 +216,7 @@ InitProcGlobal(void)
 	ProcGlobal->checkpointerLatch = NULL;
 	pg_atomic_init_u32(&ProcGlobal->procArrayGroupFirst, INVALID_PGPROCNO);
 	pg_atomic_init_u32(&ProcGlobal->clogGroupFirst, INVALID_PGPROCNO);
+	pg_atomic_init_u32(&ProcGlobal->walFlushGroupFirst, INVALID_PGPROCNO);
 
 	/*
 	 * Create and initialize all the PGPROC structures we'll need.  There are
@@ -217,6 +244,38 @@ InitProcGlobal(void)
 	MemSet(pgxacts, 0, TotalProcs * sizeof(PGXACT));
 	ProcGlobal->allPgXact = pgxacts;
 
+	/*
+	 * And the dense arrays mirroring some PGXACT fields in ProcArray order;
+	 * see PROC_HDR.  Entries are filled in by ProcArrayAdd().
+	 */
+	ProcGlobal->xids = (TransactionId *)
+		ShmemAlloc(TotalProcs * sizeof(*ProcGlobal->xids));
+	MemSet(ProcGlobal->xids, 0, TotalProcs * sizeof(*ProcGlobal->xids));
+	ProcGlobal->subxidStates = (XidCacheStatus *)
+		ShmemAlloc(TotalProcs * sizeof(*ProcGlobal->subxidStates));
+	MemSet(ProcGlobal->subxidStates, 0,
+		   TotalProcs * sizeof(*ProcGlobal->subxidStates));
+	ProcGlobal->vacuumFlags = (uint8 *)
+		ShmemAlloc(TotalProcs * sizeof(*ProcGlobal->vacuumFlags));
+	MemSet(ProcGlobal->vacuumFlags, 0,
+		   TotalProcs * sizeof(*ProcGlobal->vacuumFlags));
+
+	/*
+	 * Allocate the fast-path lock arrays of all PGPROCs in one chunk; their
+	 * size isn't known until fast_path_lock_slots has been set.
+	 */
+	fpLockBits = (uint64 *)
+		ShmemAlloc(TotalProcs * FP_LOCK_GROUPS_PER_BACKEND * sizeof(uint64));
+	MemSet(fpLockBits, 0,
+		   TotalProcs * FP_LOCK_GROUPS_PER_BACKEND * sizeof(uint64));
+	fpRelId = (Oid *)
+		ShmemAlloc(TotalProcs * FP_LOCK_SLOTS_PER_BACKEND * sizeof(Oid));
+	MemSet(fpRelId, 0, TotalProcs * FP_LOCK_SLOTS_PER_BACKEND * sizeof(Oid));
+
+	/* Likewise for the subtransaction XID overflow arrays */
+	overflowSubxids = (TransactionId *)
+		ShmemAlloc(TotalProcs * subxid_overflow_slots * sizeof(TransactionId));
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		/* Common initialization for all PGPROCs, regardless of type. */
@@ -233,6 +292,13 @@ InitProcGlobal(void)
 			LWLockInitialize(&(procs[i].backendLock), LWTRANCHE_PROC);
 		}
 		procs[i].pgprocno = i;
+		procs[i].pgxactoff = -1;
+		procs[i].fpLockBits = &fpLockBits[i * FP_LOCK_GROUPS_PER_BACKEND];
+		procs[i].fpRelId = &fpRelId[i * FP_LOCK_SLOTS_PER_BACKEND];
+		SpinLockInit(&procs[i].overflowSubxidLock);
+		procs[i].overflowTopXid = InvalidTransactionId;
+		procs[i].nOverflowSubxids = 0;
+		procs[i].overflowSubxids = &overflowSubxids[i * subxid_overflow_slots];
 
 		/*
 		 * Newly created PGPROCs for normal backends, autovacuum and bgworkers
@@ -284,6 +350,7 @@ InitProcGlobal(void)
 		 */
 		pg_atomic_init_u32(&(procs[i].procArrayGroupNext), INVALID_PGPROCNO);
 		pg_atomic_init_u32(&(procs[i].clogGroupNext), INVALID_PGPROCNO);
+		pg_atomic_init_u32(&(procs[i].walFlushGroupNext), INVALID_PGPROCNO);
 	}
 
 	/*
@@ -396,6 +463,8 @@ InitProcess(void)
 	MyProc->databaseId = InvalidOid;
 	MyProc->roleId = InvalidOid;
 	MyProc->tempNamespaceId = InvalidOid;
+	MyProc->globalTempFrozenXid = InvalidTransactionId;
+	MyProc->globalTempMinMulti = InvalidMultiXactId;
 	MyProc->isBackgroundWorker = IsBackgroundWorker;
 	MyPgXact->delayChkpt = false;
 	MyPgXact->vacuumFlags = 0;
@@ -403,6 +472,7 @@ InitProcess(void)
 	if (IsAutoVacuumWorkerProcess())
 		MyPgXact->vacuumFlags |= PROC_IS_AUTOVACUUM;
 	MyProc->lwWaiting = false;
+	MyProc->lwGranted = false;
 	MyProc->lwWaitMode = 0;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
@@ -442,6 +512,11 @@ InitProcess(void)
 	MyProc->clogGroupMemberLsn = InvalidXLogRecPtr;
 	Assert(pg_atomic_read_u32(&MyProc->clogGroupNext) == INVALID_PGPROCNO);
 
+	/* Initialize fields for group WAL flush. */
+	MyProc->walFlushGroupMember = false;
+	MyProc->walFlushGroupUpto = InvalidXLogRecPtr;
+	Assert(pg_atomic_read_u32(&MyProc->walFlushGroupNext) == INVALID_PGPROCNO);
+
 	/*
 	 * Acquire ownership of the PGPROC's latch, so that we can use WaitLatch
 	 * on it.  That allows us to repoint the process latch, which so far
@@ -578,10 +653,13 @@ InitAuxiliaryProcess(void)
 	MyProc->databaseId = InvalidOid;
 	MyProc->roleId = InvalidOid;
 	MyProc->tempNamespaceId = InvalidOid;
+	MyProc->globalTempFrozenXid = InvalidTransactionId;
+	MyProc->globalTempMinMulti = InvalidMultiXactId;
 	MyProc->isBackgroundWorker = IsBackgroundWorker;
 	MyPgXact->delayChkpt = false;
 	MyPgXact->vacuumFlags = 0;
 	MyProc->lwWaiting = false;
+	MyProc->lwGranted = false;
 	MyProc->lwWaitMode = 0;
 	MyProc->waitLock = NULL;
 	MyProc->waitProcLock = NULL;
@@ -618,6 +696,9 @@ InitAuxiliaryProcess(void)
 	 * Arrange to clean up at process exit.
 	 */
 	on_shmem_exit(AuxiliaryProcKill, Int32GetDatum(proctype));
+
+	/* Initialize local state needed for LWLocks */
+	InitLWLockAccess();
 }
 
 /*
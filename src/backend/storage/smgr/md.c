@@ -29,6 +29,7 @@
 #include "access/xlogutils.h"
 #include "access/xlog.h"
 #include "pgstat.h"
+#include "port/pg_iovec.h"
 #include "postmaster/bgwriter.h"
 #include "storage/fd.h"
 #include "storage/bufmgr.h"
@@ -86,6 +87,17 @@ typedef struct _MdfdVec
 
 static MemoryContext MdCxt;		/* context for all MdfdVec objects */
 
+/*
+ * With io_direct = data, buffers handed to the kernel must be aligned to
+ * PG_IO_ALIGN_SIZE.  Shared and local buffers always are, but some callers
+ * build pages in palloc'd memory; those are copied through this buffer.
+ */
+static char *md_bounce_buffer = NULL;
+
+#define MD_BUFFER_NEEDS_BOUNCE(buffer) \
+	((io_direct_flags & IO_DIRECT_DATA) != 0 && \
+	 (((uintptr_t) (buffer)) % PG_IO_ALIGN_SIZE) != 0)
+
 
 /* Populate a file tag describing an md.c segment file. */
 #define INIT_MD_FILETAG(a,xx_rnode,xx_forknum,xx_segno) \
@@ -138,6 +150,20 @@ static MdfdVec *_mdfd_getseg(SMgrRelation reln, ForkNumber forkno,
 							 BlockNumber blkno, bool skipFsync, int behavior);
 static BlockNumber _mdnblocks(SMgrRelation reln, ForkNumber forknum,
 							  MdfdVec *seg);
+static char *md_get_bounce_buffer(void);
+
+
+/* Flags to open relation segments with */
+static inline int
+_mdfd_open_flags(void)
+{
+	int			flags = O_RDWR | PG_BINARY;
+
+	if (io_direct_flags & IO_DIRECT_DATA)
+		flags |= PG_O_DIRECT;
+
+	return flags;
+}
 
 
 /*
@@ -187,14 +213,14 @@ mdcreate(SMgrRelation reln, ForkNumber forkNum, bool isRedo)
 
 	path = relpath(reln->smgr_rnode, forkNum);
 
-	fd = PathNameOpenFile(path, O_RDWR | O_CREAT | O_EXCL | PG_BINARY);
+	fd = PathNameOpenFile(path, _mdfd_open_flags() | O_CREAT | O_EXCL);
 
 	if (fd < 0)
 	{
 		int			save_errno = errno;
 
 		if (isRedo)
-			fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+			fd = PathNameOpenFile(path, _mdfd_open_flags());
 		if (fd < 0)
 		{
 			/* be sure to report the error reported by create, not open */
@@ -401,6 +427,14 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
+	if (MD_BUFFER_NEEDS_BOUNCE(buffer))
+	{
+		char	   *bounce = md_get_bounce_buffer();
+
+		memcpy(bounce, buffer, BLCKSZ);
+		buffer = bounce;
+	}
+
 	if ((nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_EXTEND)) != BLCKSZ)
 	{
 		if (nbytes < 0)
@@ -424,6 +458,89 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdzeroextend() -- Add new zeroed out blocks to the specified relation.
+ *
+ *		Similar to mdextend(), except the relation can be extended by multiple
+ *		blocks at once and the added blocks will be filled with zeroes.
+ */
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum,
+			 BlockNumber blocknum, int nblocks, bool skipFsync)
+{
+	MdfdVec    *v;
+	BlockNumber curblocknum = blocknum;
+	int			remblocks = nblocks;
+
+	Assert(nblocks > 0);
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/*
+	 * If a relation manages to grow to 2^32-1 blocks, refuse to extend it any
+	 * more --- we mustn't create a block whose number actually is
+	 * InvalidBlockNumber or larger.
+	 */
+	if ((uint64) blocknum + nblocks >= (uint64) InvalidBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	while (remblocks > 0)
+	{
+		BlockNumber segstartblock = curblocknum % ((BlockNumber) RELSEG_SIZE);
+		off_t		seekpos = (off_t) BLCKSZ * segstartblock;
+		int			numblocks;
+		int			ret;
+
+		/* Don't cross a segment boundary */
+		if (segstartblock + remblocks > RELSEG_SIZE)
+			numblocks = RELSEG_SIZE - segstartblock;
+		else
+			numblocks = remblocks;
+
+		v = _mdfd_getseg(reln, forknum, curblocknum, skipFsync, EXTENSION_CREATE);
+
+		Assert(segstartblock < RELSEG_SIZE);
+		Assert(segstartblock + numblocks <= RELSEG_SIZE);
+
+		/*
+		 * If only a few blocks are added, just write out zeroes.  For more,
+		 * let the filesystem allocate the space, which can be done without
+		 * writing it (posix_fallocate() falls back to writing zeroes itself
+		 * where that's not supported).  Doing that for every small extension
+		 * could lead to more fragmentation, so it's not worth it.
+		 */
+		if (numblocks > 8)
+			ret = FileFallocate(v->mdfd_vfd,
+								seekpos, (off_t) BLCKSZ * numblocks,
+								WAIT_EVENT_DATA_FILE_EXTEND);
+		else
+			ret = FileZero(v->mdfd_vfd,
+						   seekpos, (off_t) BLCKSZ * numblocks,
+						   WAIT_EVENT_DATA_FILE_EXTEND);
+		if (ret != 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not extend file \"%s\": %m",
+							FilePathName(v->mdfd_vfd)),
+					 errhint("Check free disk space.")));
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		remblocks -= numblocks;
+		curblocknum += numblocks;
+	}
+}
+
 /*
  *	mdopen() -- Open the specified relation.
  *
@@ -447,7 +564,7 @@ mdopen(SMgrRelation reln, ForkNumber forknum, int behavior)
 
 	path = relpath(reln->smgr_rnode, forknum);
 
-	fd = PathNameOpenFile(path, O_RDWR | PG_BINARY);
+	fd = PathNameOpenFile(path, _mdfd_open_flags());
 
 	if (fd < 0)
 	{
@@ -515,6 +632,10 @@ mdprefetch(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum)
 	off_t		seekpos;
 	MdfdVec    *v;
 
+	/* The kernel won't cache anything for us with direct I/O */
+	if (io_direct_flags & IO_DIRECT_DATA)
+		return;
+
 	v = _mdfd_getseg(reln, forknum, blocknum, false, EXTENSION_FAIL);
 
 	seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
@@ -587,6 +708,7 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	off_t		seekpos;
 	int			nbytes;
 	MdfdVec    *v;
+	char	   *readbuf = buffer;
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum,
 										reln->smgr_rnode.node.spcNode,
@@ -601,7 +723,10 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
-	nbytes = FileRead(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
+	if (MD_BUFFER_NEEDS_BOUNCE(buffer))
+		readbuf = md_get_bounce_buffer();
+
+	nbytes = FileRead(v->mdfd_vfd, readbuf, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_READ);
 
 	TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum,
 									   reln->smgr_rnode.node.spcNode,
@@ -628,7 +753,7 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		 * update a block that was later truncated away.
 		 */
 		if (zero_damaged_pages || InRecovery)
-			MemSet(buffer, 0, BLCKSZ);
+			MemSet(readbuf, 0, BLCKSZ);
 		else
 			ereport(ERROR,
 					(errcode(ERRCODE_DATA_CORRUPTED),
@@ -636,6 +761,9 @@ mdread(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 							blocknum, FilePathName(v->mdfd_vfd),
 							nbytes, BLCKSZ)));
 	}
+
+	if (readbuf != buffer)
+		memcpy(buffer, readbuf, BLCKSZ);
 }
 
 /*
@@ -671,6 +799,14 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 
 	Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
 
+	if (MD_BUFFER_NEEDS_BOUNCE(buffer))
+	{
+		char	   *bounce = md_get_bounce_buffer();
+
+		memcpy(bounce, buffer, BLCKSZ);
+		buffer = bounce;
+	}
+
 	nbytes = FileWrite(v->mdfd_vfd, buffer, BLCKSZ, seekpos, WAIT_EVENT_DATA_FILE_WRITE);
 
 	TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum,
@@ -702,6 +838,257 @@ mdwrite(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 		register_dirty_segment(reln, forknum, v);
 }
 
+/*
+ *	md_segment_run() -- How many of nblocks blocks starting at blocknum can
+ *		be transferred with one vectored call?
+ *
+ * A single call must stay within one segment file and within PG_IOV_MAX.
+ */
+static inline BlockNumber
+md_segment_run(BlockNumber blocknum, BlockNumber nblocks)
+{
+	BlockNumber seg_remaining;
+
+	seg_remaining = ((BlockNumber) RELSEG_SIZE) -
+		(blocknum % ((BlockNumber) RELSEG_SIZE));
+
+	return Min(Min(nblocks, seg_remaining), (BlockNumber) PG_IOV_MAX);
+}
+
+/*
+ *	md_buffers_need_bounce() -- Does any of the buffers violate the direct I/O
+ *		alignment rules?  If so, the caller transfers the blocks one by one.
+ */
+static bool
+md_buffers_need_bounce(char **buffers, BlockNumber nblocks)
+{
+	BlockNumber i;
+
+	if ((io_direct_flags & IO_DIRECT_DATA) == 0)
+		return false;
+
+	for (i = 0; i < nblocks; i++)
+	{
+		if (MD_BUFFER_NEEDS_BOUNCE(buffers[i]))
+			return true;
+	}
+	return false;
+}
+
+/*
+ *	mdreadv() -- Read a run of consecutive blocks into the supplied buffers.
+ *
+ *		buffers[i] receives block blocknum + i.  Runs are split only where
+ *		they cross a segment boundary or exceed PG_IOV_MAX, so a scan of
+ *		contiguous blocks needs one system call per run instead of one per
+ *		block.  Error behavior is the same as calling mdread() for each block.
+ */
+void
+mdreadv(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		char **buffers, BlockNumber nblocks)
+{
+	if (md_buffers_need_bounce(buffers, nblocks))
+	{
+		BlockNumber i;
+
+		for (i = 0; i < nblocks; i++)
+			mdread(reln, forknum, blocknum + i, buffers[i]);
+		return;
+	}
+
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		BlockNumber this_nblocks = md_segment_run(blocknum, nblocks);
+		off_t		seekpos;
+		ssize_t		nbytes;
+		size_t		transferred = 0;
+		size_t		total = (size_t) this_nblocks * BLCKSZ;
+		MdfdVec    *v;
+		int			i;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, false,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		/*
+		 * The kernel may hand back fewer bytes than asked for even before
+		 * EOF, so keep going from wherever it stopped.  Only a zero-length
+		 * read means we've hit the end of the file.
+		 */
+		while (transferred < total)
+		{
+			int			first = transferred / BLCKSZ;
+			int			iovcnt = 0;
+
+			for (i = first; i < this_nblocks; i++)
+			{
+				size_t		skip = (i == first) ? transferred % BLCKSZ : 0;
+
+				iov[iovcnt].iov_base = buffers[i] + skip;
+				iov[iovcnt].iov_len = BLCKSZ - skip;
+				iovcnt++;
+			}
+
+			TRACE_POSTGRESQL_SMGR_MD_READ_START(forknum, blocknum + first,
+												reln->smgr_rnode.node.spcNode,
+												reln->smgr_rnode.node.dbNode,
+												reln->smgr_rnode.node.relNode,
+												reln->smgr_rnode.backend);
+
+			nbytes = FileReadV(v->mdfd_vfd, iov, iovcnt,
+							   seekpos + transferred,
+							   WAIT_EVENT_DATA_FILE_READ);
+
+			TRACE_POSTGRESQL_SMGR_MD_READ_DONE(forknum, blocknum + first,
+											   reln->smgr_rnode.node.spcNode,
+											   reln->smgr_rnode.node.dbNode,
+											   reln->smgr_rnode.node.relNode,
+											   reln->smgr_rnode.backend,
+											   nbytes,
+											   total - transferred);
+
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not read block %u in file \"%s\": %m",
+								blocknum + first, FilePathName(v->mdfd_vfd))));
+
+			if (nbytes == 0)
+			{
+				/*
+				 * Short read: we are at or past EOF.  Same rules as in
+				 * mdread(): zero the remainder if zero_damaged_pages is ON
+				 * or we are InRecovery, else complain about the first block
+				 * we could not read completely.
+				 */
+				if (zero_damaged_pages || InRecovery)
+				{
+					for (i = first; i < this_nblocks; i++)
+						MemSet(buffers[i], 0, BLCKSZ);
+					break;
+				}
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("could not read block %u in file \"%s\": read only %d of %d bytes",
+								blocknum + first, FilePathName(v->mdfd_vfd),
+								(int) (transferred % BLCKSZ), BLCKSZ)));
+			}
+
+			transferred += nbytes;
+		}
+
+		buffers += this_nblocks;
+		blocknum += this_nblocks;
+		nblocks -= this_nblocks;
+	}
+}
+
+/*
+ *	mdwritev() -- Write a run of consecutive blocks from the supplied buffers.
+ *
+ *		buffers[i] is written to block blocknum + i.  As with mdwrite(), this
+ *		is only for already-existing blocks; the run is split at segment
+ *		boundaries, and each segment touched is registered for fsync.
+ */
+void
+mdwritev(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+		 char **buffers, BlockNumber nblocks, bool skipFsync)
+{
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum + nblocks <= mdnblocks(reln, forknum));
+#endif
+
+	if (md_buffers_need_bounce(buffers, nblocks))
+	{
+		BlockNumber i;
+
+		for (i = 0; i < nblocks; i++)
+			mdwrite(reln, forknum, blocknum + i, buffers[i], skipFsync);
+		return;
+	}
+
+	while (nblocks > 0)
+	{
+		struct iovec iov[PG_IOV_MAX];
+		BlockNumber this_nblocks = md_segment_run(blocknum, nblocks);
+		off_t		seekpos;
+		ssize_t		nbytes;
+		size_t		transferred = 0;
+		size_t		total = (size_t) this_nblocks * BLCKSZ;
+		MdfdVec    *v;
+		int			i;
+
+		v = _mdfd_getseg(reln, forknum, blocknum, skipFsync,
+						 EXTENSION_FAIL | EXTENSION_CREATE_RECOVERY);
+
+		seekpos = (off_t) BLCKSZ * (blocknum % ((BlockNumber) RELSEG_SIZE));
+
+		Assert(seekpos < (off_t) BLCKSZ * RELSEG_SIZE);
+
+		while (transferred < total)
+		{
+			int			first = transferred / BLCKSZ;
+			int			iovcnt = 0;
+
+			for (i = first; i < this_nblocks; i++)
+			{
+				size_t		skip = (i == first) ? transferred % BLCKSZ : 0;
+
+				iov[iovcnt].iov_base = buffers[i] + skip;
+				iov[iovcnt].iov_len = BLCKSZ - skip;
+				iovcnt++;
+			}
+
+			TRACE_POSTGRESQL_SMGR_MD_WRITE_START(forknum, blocknum + first,
+												 reln->smgr_rnode.node.spcNode,
+												 reln->smgr_rnode.node.dbNode,
+												 reln->smgr_rnode.node.relNode,
+												 reln->smgr_rnode.backend);
+
+			nbytes = FileWriteV(v->mdfd_vfd, iov, iovcnt,
+								seekpos + transferred,
+								WAIT_EVENT_DATA_FILE_WRITE);
+
+			TRACE_POSTGRESQL_SMGR_MD_WRITE_DONE(forknum, blocknum + first,
+												reln->smgr_rnode.node.spcNode,
+												reln->smgr_rnode.node.dbNode,
+												reln->smgr_rnode.node.relNode,
+												reln->smgr_rnode.backend,
+												nbytes,
+												total - transferred);
+
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not write block %u in file \"%s\": %m",
+								blocknum + first, FilePathName(v->mdfd_vfd))));
+			/* zero-length write: complain appropriately */
+			if (nbytes == 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_DISK_FULL),
+						 errmsg("could not write block %u in file \"%s\": wrote only %d of %d bytes",
+								blocknum + first,
+								FilePathName(v->mdfd_vfd),
+								(int) (transferred % BLCKSZ), BLCKSZ),
+						 errhint("Check free disk space.")));
+
+			transferred += nbytes;
+		}
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		buffers += this_nblocks;
+		blocknum += this_nblocks;
+		nblocks -= this_nblocks;
+	}
+}
+
 /*
  *	mdnblocks() -- Get the number of blocks stored in a relation.
  *
@@ -951,6 +1338,23 @@ register_forget_request(RelFileNodeBackend rnode, ForkNumber forknum,
 	RegisterSyncRequest(&tag, SYNC_FORGET_REQUEST, true /* retryOnError */ );
 }
 
+/*
+ * SyncSegmentEarly -- fsync the segment containing a block, if requested
+ *
+ * Used by the checkpointer to sync a segment as soon as it has written out
+ * its part of the segment, see ProcessSyncRequestEarly().  Returns true if
+ * the segment was synced.
+ */
+bool
+SyncSegmentEarly(RelFileNode rnode, ForkNumber forknum, BlockNumber blocknum)
+{
+	FileTag		tag;
+
+	INIT_MD_FILETAG(tag, rnode, forknum, blocknum / ((BlockNumber) RELSEG_SIZE));
+
+	return ProcessSyncRequestEarly(&tag);
+}
+
 /*
  * ForgetDatabaseSyncRequests -- forget any fsyncs and unlinks for a DB
  */
@@ -1076,7 +1480,7 @@ _mdfd_openseg(SMgrRelation reln, ForkNumber forknum, BlockNumber segno,
 	fullpath = _mdfd_segpath(reln, forknum, segno);
 
 	/* open the file */
-	fd = PathNameOpenFile(fullpath, O_RDWR | PG_BINARY | oflags);
+	fd = PathNameOpenFile(fullpath, _mdfd_open_flags() | oflags);
 
 	pfree(fullpath);
 
@@ -1175,12 +1579,12 @@ _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 			 */
 			if (nblocks < ((BlockNumber) RELSEG_SIZE))
 			{
-				char	   *zerobuf = palloc0(BLCKSZ);
+				PGIOAlignedBlock zerobuf;
 
+				MemSet(zerobuf.data, 0, BLCKSZ);
 				mdextend(reln, forknum,
 						 nextsegno * ((BlockNumber) RELSEG_SIZE) - 1,
-						 zerobuf, skipFsync);
-				pfree(zerobuf);
+						 zerobuf.data, skipFsync);
 			}
 			flags = O_CREAT;
 		}
@@ -1230,6 +1634,23 @@ _mdfd_getseg(SMgrRelation reln, ForkNumber forknum, BlockNumber blkno,
 	return v;
 }
 
+/*
+ * Get the buffer used to copy unaligned pages from and to, with io_direct.
+ * We don't rely on pg_attribute_aligned here, it may not be available.
+ */
+static char *
+md_get_bounce_buffer(void)
+{
+	if (md_bounce_buffer == NULL)
+	{
+		char	   *p = MemoryContextAlloc(TopMemoryContext,
+										  BLCKSZ + PG_IO_ALIGN_SIZE);
+
+		md_bounce_buffer = (char *) TYPEALIGN(PG_IO_ALIGN_SIZE, p);
+	}
+	return md_bounce_buffer;
+}
+
 /*
  * Get number of blocks present in a single disk file
  */
@@ -1256,6 +1677,25 @@ _mdnblocks(SMgrRelation reln, ForkNumber forknum, MdfdVec *seg)
  */
 int
 mdsyncfiletag(const FileTag *ftag, char *path)
+{
+	File		file = mdopenfiletag(ftag, path);
+
+	if (file < 0)
+		return -1;
+
+	/* Try to fsync the file. */
+	return FileSync(file, WAIT_EVENT_DATA_FILE_SYNC);
+}
+
+/*
+ * Open the file identified by a file tag, so that the caller can sync it
+ * together with others.  Write the path into an output buffer so the caller
+ * can use it in error messages.
+ *
+ * Return the File on success, -1 on failure, with errno set.
+ */
+File
+mdopenfiletag(const FileTag *ftag, char *path)
 {
 	SMgrRelation reln = smgropen(ftag->rnode, InvalidBackendId);
 	MdfdVec    *v;
@@ -1275,8 +1715,7 @@ mdsyncfiletag(const FileTag *ftag, char *path)
 	if (v == NULL)
 		return -1;
 
-	/* Try to fsync the file. */
-	return FileSync(v->mdfd_vfd, WAIT_EVENT_DATA_FILE_SYNC);
+	return v->mdfd_vfd;
 }
 
 /*
@@ -25,6 +25,7 @@
 #include "commands/tablespace.h"
 #include "portability/instr_time.h"
 #include "postmaster/bgwriter.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
 #include "storage/md.h"
@@ -79,12 +80,24 @@ static CycleCtr checkpoint_cycle_ctr = 0;
 #define FSYNCS_PER_ABSORB		10
 #define UNLINKS_PER_ABSORB		10
 
+/* Number of fsyncs handed to the kernel at once, when batching */
+#define FSYNCS_PER_BATCH		32
+
+/* Statistics on sync times, reported at checkpoint end */
+typedef struct SyncStats
+{
+	int			processed;		/* # of files synced */
+	uint64		longest;		/* longest sync, in microseconds */
+	uint64		total_elapsed;	/* total sync time, in microseconds */
+} SyncStats;
+
 /*
  * Function pointers for handling sync and unlink requests.
  */
 typedef struct SyncOps
 {
 	int			(*sync_syncfiletag) (const FileTag *ftag, char *path);
+	File		(*sync_openfiletag) (const FileTag *ftag, char *path);
 	int			(*sync_unlinkfiletag) (const FileTag *ftag, char *path);
 	bool		(*sync_filetagmatches) (const FileTag *ftag,
 										const FileTag *candidate);
@@ -94,6 +107,7 @@ static const SyncOps syncsw[] = {
 	/* magnetic disk */
 	{
 		.sync_syncfiletag = mdsyncfiletag,
+		.sync_openfiletag = mdopenfiletag,
 		.sync_unlinkfiletag = mdunlinkfiletag,
 		.sync_filetagmatches = mdfiletagmatches
 	}
@@ -228,6 +242,239 @@ SyncPostCheckpoint(void)
 	}
 }
 
+/*
+ * SyncUpdateStats() -- account for a successful sync of one file
+ */
+static void
+SyncUpdateStats(SyncStats *stats, const char *path, uint64 elapsed)
+{
+	if (elapsed > stats->longest)
+		stats->longest = elapsed;
+	stats->total_elapsed += elapsed;
+	stats->processed++;
+
+	if (log_checkpoints)
+		elog(DEBUG1, "checkpoint sync: number=%d file=%s time=%.3f msec",
+			 stats->processed,
+			 path,
+			 (double) elapsed / 1000);
+}
+
+/*
+ * SyncPendingEntry() -- fsync the file of one pending entry, synchronously
+ *
+ * "failures" is the number of earlier attempts that already failed with an
+ * error suggesting the file might have been deleted.
+ */
+static void
+SyncPendingEntry(PendingFsyncEntry *entry, int failures, int *absorb_counter,
+				 SyncStats *stats)
+{
+	/*
+	 * The fsync table could contain requests to fsync segments that have
+	 * been deleted (unlinked) by the time we get to them. Rather than just
+	 * hoping an ENOENT (or EACCES on Windows) error can be ignored, what we
+	 * do on error is absorb pending requests and then retry. Since mdunlink()
+	 * queues a "cancel" message before actually unlinking, the fsync request
+	 * is guaranteed to be marked canceled after the absorb if it really was
+	 * this case. DROP DATABASE likewise has to tell us to forget fsync
+	 * requests before it starts deletions.
+	 */
+	for (; !entry->canceled; failures++)
+	{
+		char		path[MAXPGPATH];
+		instr_time	sync_start,
+					sync_end;
+
+		INSTR_TIME_SET_CURRENT(sync_start);
+		if (syncsw[entry->tag.handler].sync_syncfiletag(&entry->tag,
+														path) == 0)
+		{
+			/* Success; update statistics about sync timing */
+			INSTR_TIME_SET_CURRENT(sync_end);
+			INSTR_TIME_SUBTRACT(sync_end, sync_start);
+			SyncUpdateStats(stats, path, INSTR_TIME_GET_MICROSEC(sync_end));
+			break;				/* out of retry loop */
+		}
+
+		/*
+		 * It is possible that the relation has been dropped or truncated
+		 * since the fsync request was entered. Therefore, allow ENOENT, but
+		 * only if we didn't fail already on this file.
+		 */
+		if (!FILE_POSSIBLY_DELETED(errno) || failures > 0)
+			ereport(data_sync_elevel(ERROR),
+					(errcode_for_file_access(),
+					 errmsg("could not fsync file \"%s\": %m",
+							path)));
+		else
+			ereport(DEBUG1,
+					(errcode_for_file_access(),
+					 errmsg("could not fsync file \"%s\" but retrying: %m",
+							path)));
+
+		/*
+		 * Absorb incoming requests and check to see if a cancel arrived for
+		 * this relation fork.
+		 */
+		AbsorbSyncRequests();
+		*absorb_counter = FSYNCS_PER_ABSORB;	/* might as well... */
+	}							/* end retry loop */
+}
+
+/*
+ * ProcessSyncRequestsBatched() -- fsync pending entries in batches
+ *
+ * This is the variant of the main loop of ProcessSyncRequests() used when
+ * the AIO layer can overlap operations: rather than syncing one file after
+ * another, we open up to FSYNCS_PER_BATCH files and let the kernel flush
+ * them all concurrently.  Any file that can't be opened, or whose sync fails
+ * with an error suggesting it was deleted meanwhile, goes through the usual
+ * synchronous retry logic of SyncPendingEntry().  Any other failure is
+ * reported at once; it must not be retried, since a second fsync could
+ * report success even though data was lost.
+ *
+ * Because entries can't be removed from the hashtable while a sequential
+ * scan of it is in progress (other than the one just returned), we first
+ * collect the entries due for processing.  Entries are never deleted from
+ * pendingOps except here, so the pointers stay valid meanwhile.
+ */
+static void
+ProcessSyncRequestsBatched(int *absorb_counter, SyncStats *stats)
+{
+	HASH_SEQ_STATUS hstat;
+	PendingFsyncEntry *entry;
+	PendingFsyncEntry **entries;
+	long		nentries = 0;
+	long		start;
+
+	entries = palloc(sizeof(PendingFsyncEntry *) *
+					 Max(hash_get_num_entries(pendingOps), 1));
+
+	hash_seq_init(&hstat, pendingOps);
+	while ((entry = (PendingFsyncEntry *) hash_seq_search(&hstat)) != NULL)
+	{
+		/* If the entry is new then don't process it this time */
+		if (entry->cycle_ctr == sync_cycle_ctr)
+			continue;
+
+		/* Else assert we haven't missed it */
+		Assert((CycleCtr) (entry->cycle_ctr + 1) == sync_cycle_ctr);
+
+		entries[nentries++] = entry;
+	}
+
+	for (start = 0; start < nentries; start += FSYNCS_PER_BATCH)
+	{
+		long		end = Min(start + FSYNCS_PER_BATCH, nentries);
+		File		files[FSYNCS_PER_BATCH];
+		int			results[FSYNCS_PER_BATCH];
+		int			batchidx[FSYNCS_PER_BATCH];
+		char		paths[FSYNCS_PER_BATCH][MAXPGPATH];
+		int			nfiles = 0;
+		instr_time	sync_start,
+					sync_end;
+		uint64		elapsed;
+		long		i;
+
+		/* As in the serial loop, absorb new requests every so often */
+		*absorb_counter -= end - start;
+		if (*absorb_counter <= 0)
+		{
+			AbsorbSyncRequests();
+			*absorb_counter = FSYNCS_PER_ABSORB;
+		}
+
+		for (i = start; i < end; i++)
+		{
+			File		file;
+
+			entry = entries[i];
+			if (!entry->canceled)
+			{
+				file = syncsw[entry->tag.handler].sync_openfiletag(&entry->tag,
+																   paths[nfiles]);
+				if (file >= 0)
+				{
+					files[nfiles] = file;
+					batchidx[nfiles] = i;
+					nfiles++;
+					continue;
+				}
+
+				/* let the serial logic sort out a possibly deleted file */
+				if (!FILE_POSSIBLY_DELETED(errno))
+					ereport(data_sync_elevel(ERROR),
+							(errcode_for_file_access(),
+							 errmsg("could not fsync file \"%s\": %m",
+									paths[nfiles])));
+				ereport(DEBUG1,
+						(errcode_for_file_access(),
+						 errmsg("could not fsync file \"%s\" but retrying: %m",
+								paths[nfiles])));
+				AbsorbSyncRequests();
+				SyncPendingEntry(entry, 1, absorb_counter, stats);
+			}
+
+			/* We are done with this entry, remove it */
+			if (hash_search(pendingOps, &entry->tag, HASH_REMOVE, NULL) == NULL)
+				elog(ERROR, "pendingOps corrupted");
+		}
+
+		INSTR_TIME_SET_CURRENT(sync_start);
+		FileSyncBatch(files, nfiles, results, WAIT_EVENT_DATA_FILE_SYNC);
+		INSTR_TIME_SET_CURRENT(sync_end);
+		INSTR_TIME_SUBTRACT(sync_end, sync_start);
+		elapsed = INSTR_TIME_GET_MICROSEC(sync_end);
+
+		/*
+		 * Remove all the entries that were synced successfully before any
+		 * retry below absorbs new requests; a request absorbed into one of
+		 * them now would be lost.  The files were flushed concurrently, so
+		 * the time each one took is unknown; charge the whole batch's time
+		 * to the first of them.
+		 */
+		for (i = 0; i < nfiles; i++)
+		{
+			if (results[i] != 0)
+				continue;
+
+			SyncUpdateStats(stats, paths[i], elapsed);
+			elapsed = 0;
+
+			entry = entries[batchidx[i]];
+			if (hash_search(pendingOps, &entry->tag, HASH_REMOVE, NULL) == NULL)
+				elog(ERROR, "pendingOps corrupted");
+		}
+
+		/* Now handle the failures */
+		for (i = 0; i < nfiles; i++)
+		{
+			if (results[i] == 0)
+				continue;
+
+			errno = results[i];
+			if (!FILE_POSSIBLY_DELETED(errno))
+				ereport(data_sync_elevel(ERROR),
+						(errcode_for_file_access(),
+						 errmsg("could not fsync file \"%s\": %m",
+								paths[i])));
+			ereport(DEBUG1,
+					(errcode_for_file_access(),
+					 errmsg("could not fsync file \"%s\" but retrying: %m",
+							paths[i])));
+			AbsorbSyncRequests();
+
+			entry = entries[batchidx[i]];
+			SyncPendingEntry(entry, 1, absorb_counter, stats);
+			if (hash_search(pendingOps, &entry->tag, HASH_REMOVE, NULL) == NULL)
+				elog(ERROR, "pendingOps corrupted");
+		}
+	}
+
+	pfree(entries);
+}
+
 /*
 
  *	ProcessSyncRequests() -- Process queued fsync requests.
@@ -240,15 +487,7 @@ ProcessSyncRequests(void)
 	HASH_SEQ_STATUS hstat;
 	PendingFsyncEntry *entry;
 	int			absorb_counter;
-
-	/* Statistics on sync times */
-	int			processed = 0;
-	instr_time	sync_start,
-				sync_end,
-				sync_diff;
-	uint64		elapsed;
-	uint64		longest = 0;
-	uint64		total_elapsed = 0;
+	SyncStats	stats = {0, 0, 0};
 
 	/*
 	 * This is only called during checkpoints, and checkpoints should only
@@ -310,118 +549,130 @@ ProcessSyncRequests(void)
 
 	/* Now scan the hashtable for fsync requests to process */
 	absorb_counter = FSYNCS_PER_ABSORB;
-	hash_seq_init(&hstat, pendingOps);
-	while ((entry = (PendingFsyncEntry *) hash_seq_search(&hstat)) != NULL)
+	if (enableFsync && pgaio_batching_enabled())
+		ProcessSyncRequestsBatched(&absorb_counter, &stats);
+	else
 	{
-		int			failures;
-
-		/*
-		 * If fsync is off then we don't have to bother opening the file at
-		 * all.  (We delay checking until this point so that changing fsync on
-		 * the fly behaves sensibly.)
-		 */
-		if (!enableFsync)
-			continue;
-
-		/*
-		 * If the entry is new then don't process it this time; it is new.
-		 * Note "continue" bypasses the hash-remove call at the bottom of the
-		 * loop.
-		 */
-		if (entry->cycle_ctr == sync_cycle_ctr)
-			continue;
-
-		/* Else assert we haven't missed it */
-		Assert((CycleCtr) (entry->cycle_ctr + 1) == sync_cycle_ctr);
-
-		/*
-		 * If in checkpointer, we want to absorb pending requests every so
-		 * often to prevent overflow of the fsync request queue.  It is
-		 * unspecified whether newly-added entries will be visited by
-		 * hash_seq_search, but we don't care since we don't need to process
-		 * them anyway.
-		 */
-		if (--absorb_counter <= 0)
-		{
-			AbsorbSyncRequests();
-			absorb_counter = FSYNCS_PER_ABSORB;
-		}
-
-		/*
-		 * The fsync table could contain requests to fsync segments that have
-		 * been deleted (unlinked) by the time we get to them. Rather than
-		 * just hoping an ENOENT (or EACCES on Windows) error can be ignored,
-		 * what we do on error is absorb pending requests and then retry.
-		 * Since mdunlink() queues a "cancel" message before actually
-		 * unlinking, the fsync request is guaranteed to be marked canceled
-		 * after the absorb if it really was this case. DROP DATABASE likewise
-		 * has to tell us to forget fsync requests before it starts deletions.
-		 */
-		for (failures = 0; !entry->canceled; failures++)
+		hash_seq_init(&hstat, pendingOps);
+		while ((entry = (PendingFsyncEntry *) hash_seq_search(&hstat)) != NULL)
 		{
-			char		path[MAXPGPATH];
-
-			INSTR_TIME_SET_CURRENT(sync_start);
-			if (syncsw[entry->tag.handler].sync_syncfiletag(&entry->tag,
-															path) == 0)
-			{
-				/* Success; update statistics about sync timing */
-				INSTR_TIME_SET_CURRENT(sync_end);
-				sync_diff = sync_end;
-				INSTR_TIME_SUBTRACT(sync_diff, sync_start);
-				elapsed = INSTR_TIME_GET_MICROSEC(sync_diff);
-				if (elapsed > longest)
-					longest = elapsed;
-				total_elapsed += elapsed;
-				processed++;
-
-				if (log_checkpoints)
-					elog(DEBUG1, "checkpoint sync: number=%d file=%s time=%.3f msec",
-						 processed,
-						 path,
-						 (double) elapsed / 1000);
-
-				break;			/* out of retry loop */
-			}
+			/*
+			 * If fsync is off then we don't have to bother opening the file
+			 * at all.  (We delay checking until this point so that changing
+			 * fsync on the fly behaves sensibly.)
+			 */
+			if (!enableFsync)
+				continue;
 
 			/*
-			 * It is possible that the relation has been dropped or truncated
-			 * since the fsync request was entered. Therefore, allow ENOENT,
-			 * but only if we didn't fail already on this file.
+			 * If the entry is new then don't process it this time; it is
+			 * new.  Note "continue" bypasses the hash-remove call at the
+			 * bottom of the loop.
 			 */
-			if (!FILE_POSSIBLY_DELETED(errno) || failures > 0)
-				ereport(data_sync_elevel(ERROR),
-						(errcode_for_file_access(),
-						 errmsg("could not fsync file \"%s\": %m",
-								path)));
-			else
-				ereport(DEBUG1,
-						(errcode_for_file_access(),
-						 errmsg("could not fsync file \"%s\" but retrying: %m",
-								path)));
+			if (entry->cycle_ctr == sync_cycle_ctr)
+				continue;
+
+			/* Else assert we haven't missed it */
+			Assert((CycleCtr) (entry->cycle_ctr + 1) == sync_cycle_ctr);
 
 			/*
-			 * Absorb incoming requests and check to see if a cancel arrived
-			 * for this relation fork.
+			 * If in checkpointer, we want to absorb pending requests every so
+			 * often to prevent overflow of the fsync request queue.  It is
+			 * unspecified whether newly-added entries will be visited by
+			 * hash_seq_search, but we don't care since we don't need to
+			 * process them anyway.
 			 */
-			AbsorbSyncRequests();
-			absorb_counter = FSYNCS_PER_ABSORB; /* might as well... */
-		}						/* end retry loop */
+			if (--absorb_counter <= 0)
+			{
+				AbsorbSyncRequests();
+				absorb_counter = FSYNCS_PER_ABSORB;
+			}
 
-		/* We are done with this entry, remove it */
-		if (hash_search(pendingOps, &entry->tag, HASH_REMOVE, NULL) == NULL)
-			elog(ERROR, "pendingOps corrupted");
-	}							/* end loop over hashtable entries */
+			SyncPendingEntry(entry, 0, &absorb_counter, &stats);
 
-	/* Return sync performance metrics for report at checkpoint end */
-	CheckpointStats.ckpt_sync_rels = processed;
-	CheckpointStats.ckpt_longest_sync = longest;
-	CheckpointStats.ckpt_agg_sync_time = total_elapsed;
+			/* We are done with this entry, remove it */
+			if (hash_search(pendingOps, &entry->tag, HASH_REMOVE, NULL) == NULL)
+				elog(ERROR, "pendingOps corrupted");
+		}						/* end loop over hashtable entries */
+	}
+
+	/*
+	 * Return sync performance metrics for report at checkpoint end.  Files
+	 * synced early, during the write phase, have already been counted.
+	 */
+	CheckpointStats.ckpt_sync_rels += stats.processed;
+	if (stats.longest > CheckpointStats.ckpt_longest_sync)
+		CheckpointStats.ckpt_longest_sync = stats.longest;
+	CheckpointStats.ckpt_agg_sync_time += stats.total_elapsed;
 
 	/* Flag successful completion of ProcessSyncRequests */
 	sync_in_progress = false;
 }
 
+/*
+ * ProcessSyncRequestEarly() -- fsync one file ahead of the sync phase
+ *
+ * BufferSync() calls this once it has written all the buffers it is going to
+ * write to a file, so that the fsyncs are spread over the write phase rather
+ * than all being issued by ProcessSyncRequests() at its end.  If there is a
+ * pending request for the file, it is synced and removed from the table.
+ *
+ * This is safe because any write to the file after the fsync, by us or by a
+ * backend, enters a new request that ProcessSyncRequests() will still see.
+ * A file that seems to have been deleted meanwhile is left for the final
+ * pass, which knows how to wait for the corresponding cancel request.
+ *
+ * Returns true if the file was synced.
+ */
+bool
+ProcessSyncRequestEarly(const FileTag *ftag)
+{
+	PendingFsyncEntry *entry;
+	char		path[MAXPGPATH];
+	instr_time	sync_start,
+				sync_end;
+	uint64		elapsed;
+
+	/* Only processes performing checkpoints have a pendingOps */
+	if (!pendingOps || !enableFsync)
+		return false;
+
+	entry = (PendingFsyncEntry *) hash_search(pendingOps,
+											  (void *) ftag,
+											  HASH_FIND,
+											  NULL);
+	if (entry == NULL || entry->canceled)
+		return false;
+
+	INSTR_TIME_SET_CURRENT(sync_start);
+	if (syncsw[ftag->handler].sync_syncfiletag(ftag, path) != 0)
+	{
+		if (!FILE_POSSIBLY_DELETED(errno))
+			ereport(data_sync_elevel(ERROR),
+					(errcode_for_file_access(),
+					 errmsg("could not fsync file \"%s\": %m", path)));
+		return false;
+	}
+	INSTR_TIME_SET_CURRENT(sync_end);
+	INSTR_TIME_SUBTRACT(sync_end, sync_start);
+	elapsed = INSTR_TIME_GET_MICROSEC(sync_end);
+
+	if (hash_search(pendingOps, ftag, HASH_REMOVE, NULL) == NULL)
+		elog(ERROR, "pendingOps corrupted");
+
+	CheckpointStats.ckpt_sync_rels++;
+	CheckpointStats.ckpt_early_sync_rels++;
+	if (elapsed > CheckpointStats.ckpt_longest_sync)
+		CheckpointStats.ckpt_longest_sync = elapsed;
+	CheckpointStats.ckpt_agg_sync_time += elapsed;
+
+	if (log_checkpoints)
+		elog(DEBUG1, "checkpoint early sync: file=%s time=%.3f msec",
+			 path, (double) elapsed / 1000);
+
+	return true;
+}
+
 /*
  * RememberSyncRequest() -- callback from checkpointer side of sync request
  *
@@ -24,6 +24,9 @@
 #include <signal.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #ifdef HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
@@ -71,6 +74,8 @@
 #include "tcop/pquery.h"
 #include "tcop/tcopprot.h"
 #include "tcop/utility.h"
+#include "utils/ash.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
@@ -195,6 +200,7 @@ static void drop_unnamed_stmt(void);
 static void log_disconnections(int code, Datum arg);
 static void enable_statement_timeout(void);
 static void disable_statement_timeout(void);
+static void ReleaseIdleSessionCaches(void);
 
 
 /* ----------------------------------------------------------------
@@ -1958,6 +1964,8 @@ exec_execute_message(const char *portal_name, long max_rows)
 	bool		execute_is_fetch;
 	bool		was_logged = false;
 	char		msec_str[32];
+	bool		time_run;
+	instr_time	starttime;
 
 	/* Adjust destination to tell printtup.c what to do */
 	dest = whereToSendOutput;
@@ -2087,6 +2095,16 @@ exec_execute_message(const char *portal_name, long max_rows)
 	if (max_rows <= 0)
 		max_rows = FETCH_ALL;
 
+	/*
+	 * If the plan cache wants to know how long cached plans take, time the
+	 * run, provided we run the whole query here.
+	 */
+	time_run = (plan_cache_mode == PLAN_CACHE_MODE_ADAPTIVE &&
+				portal->cplan != NULL && !is_xact_command &&
+				!execute_is_fetch);
+	if (time_run)
+		INSTR_TIME_SET_CURRENT(starttime);
+
 	completed = PortalRun(portal,
 						  max_rows,
 						  true, /* always top level */
@@ -2097,6 +2115,30 @@ exec_execute_message(const char *portal_name, long max_rows)
 
 	receiver->rDestroy(receiver);
 
+	if (time_run && completed)
+	{
+		CachedPlanSource *psrc = NULL;
+		instr_time	duration;
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
+
+		/* the statement may have been replaced; the plan cache checks that */
+		if (portal->prepStmtName == NULL)
+			psrc = unnamed_stmt_psrc;
+		else
+		{
+			PreparedStatement *pstmt;
+
+			pstmt = FetchPreparedStatement(portal->prepStmtName, false);
+			if (pstmt)
+				psrc = pstmt->plansource;
+		}
+		if (psrc)
+			CachedPlanRecordRun(psrc, portal->cplan,
+								INSTR_TIME_GET_MILLISEC(duration));
+	}
+
 	if (completed)
 	{
 		if (is_xact_command)
@@ -3137,8 +3179,45 @@ ProcessInterrupts(void)
 
 	}
 
+	if (IdleCacheReleasePending)
+	{
+		IdleCacheReleasePending = false;
+
+		/* only act if we're still idle outside a transaction */
+		if (DoingCommandRead && !IsTransactionOrTransactionBlock())
+			ReleaseIdleSessionCaches();
+	}
+
 	if (ParallelMessagePending)
 		HandleParallelMessages();
+
+	if (LogMemoryContextPending)
+		ProcessLogMemoryContextInterrupt();
+}
+
+/*
+ * ReleaseIdleSessionCaches --- give back memory held by an idle session
+ *
+ * Called when a session has been idle outside a transaction for
+ * idle_cache_release_timeout.  Catalog caches and relation descriptors
+ * are usually the bulk of an idle backend's private memory, and are
+ * simply rebuilt when they're needed again.  This is done in a
+ * transaction, like the processing of a sinval reset, which has the same
+ * effect.
+ */
+static void
+ReleaseIdleSessionCaches(void)
+{
+	StartTransactionCommand();
+	InvalidateSystemCaches();
+	CommitTransactionCommand();
+
+#ifdef __GLIBC__
+	/* hand the freed memory back to the kernel */
+	malloc_trim(0);
+#endif
+
+	elog(DEBUG1, "released caches of idle session");
 }
 
 
@@ -3713,6 +3792,7 @@ PostgresMain(int argc, char *argv[],
 	sigjmp_buf	local_sigjmp_buf;
 	volatile bool send_ready_for_query = true;
 	bool		disable_idle_in_transaction_timeout = false;
+	bool		disable_idle_cache_release_timeout = false;
 
 	/* Initialize startup process environment if necessary. */
 	if (!IsUnderPostmaster)
@@ -4125,6 +4205,9 @@ PostgresMain(int argc, char *argv[],
 		 */
 		if (send_ready_for_query)
 		{
+			/* We're no longer active, so stop sampling our activity */
+			AshStopSampling();
+
 			if (IsAbortedTransactionBlockState())
 			{
 				set_ps_display("idle in transaction (aborted)", false);
@@ -4158,6 +4241,14 @@ PostgresMain(int argc, char *argv[],
 
 				set_ps_display("idle", false);
 				pgstat_report_activity(STATE_IDLE, NULL);
+
+				/* Start the idle cache release timer */
+				if (IdleCacheReleaseTimeout > 0)
+				{
+					disable_idle_cache_release_timeout = true;
+					enable_timeout_after(IDLE_CACHE_RELEASE_TIMEOUT,
+										 IdleCacheReleaseTimeout);
+				}
 			}
 
 			ReadyForQuery(whereToSendOutput);
@@ -4197,6 +4288,14 @@ PostgresMain(int argc, char *argv[],
 			disable_timeout(IDLE_IN_TRANSACTION_SESSION_TIMEOUT, false);
 			disable_idle_in_transaction_timeout = false;
 		}
+		if (disable_idle_cache_release_timeout)
+		{
+			disable_timeout(IDLE_CACHE_RELEASE_TIMEOUT, false);
+			disable_idle_cache_release_timeout = false;
+		}
+
+		/* Sample our activity until we next go idle, if enabled */
+		AshStartSampling();
 
 		/*
 		 * (6) check for any other interesting events that happened while we
@@ -733,6 +733,123 @@ ParseDateTime(const char *timestr, char *workbuf, size_t buflen,
 }
 
 
+/* DecodeISODateTimeFast()
+ * Fast path for the strict ISO 8601 form that we output ourselves.
+ *
+ *		"YYYY-MM-DD"
+ *		"YYYY-MM-DD HH:MM:SS[.ffffff]"	(or with "T" instead of the space)
+ *
+ * If tzp isn't NULL, a numeric zone "+HH" or "+HH:MM" may follow, and the
+ * session time zone is used if there's none.  Returns true and fills *tm,
+ * *fsec and *tzp like DecodeDateTime() would; returns false, without
+ * complaint, for anything else, including values DecodeDateTime() would
+ * reject, so callers can simply fall back to ParseDateTime() and
+ * DecodeDateTime() to get the general behavior and error reporting.
+ * Bulk loads of machine-generated timestamps spend most of their parsing
+ * time in the general tokenizer, which this skips.
+ */
+bool
+DecodeISODateTimeFast(const char *str, struct pg_tm *tm, fsec_t *fsec,
+					  int *tzp)
+{
+	const char *cp = str;
+	int			i;
+
+#define ISO_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define ISO_2DIGITS(p) \
+	(ISO_DIGIT((p)[0]) && ISO_DIGIT((p)[1]))
+#define ISO_2DIGITS_VAL(p) (((p)[0] - '0') * 10 + ((p)[1] - '0'))
+
+	if (!(ISO_2DIGITS(cp) && ISO_2DIGITS(cp + 2) && cp[4] == '-' &&
+		  ISO_2DIGITS(cp + 5) && cp[7] == '-' && ISO_2DIGITS(cp + 8)))
+		return false;
+
+	tm->tm_year = ISO_2DIGITS_VAL(cp) * 100 + ISO_2DIGITS_VAL(cp + 2);
+	tm->tm_mon = ISO_2DIGITS_VAL(cp + 5);
+	tm->tm_mday = ISO_2DIGITS_VAL(cp + 8);
+	tm->tm_hour = 0;
+	tm->tm_min = 0;
+	tm->tm_sec = 0;
+	tm->tm_isdst = -1;
+	*fsec = 0;
+	cp += 10;
+
+	if (tm->tm_year < 1 ||
+		tm->tm_mon < 1 || tm->tm_mon > MONTHS_PER_YEAR ||
+		tm->tm_mday < 1 ||
+		tm->tm_mday > day_tab[isleap(tm->tm_year)][tm->tm_mon - 1])
+		return false;
+
+	if (*cp == ' ' || *cp == 'T')
+	{
+		cp++;
+		if (!(ISO_2DIGITS(cp) && cp[2] == ':' && ISO_2DIGITS(cp + 3) &&
+			  cp[5] == ':' && ISO_2DIGITS(cp + 6)))
+			return false;
+
+		tm->tm_hour = ISO_2DIGITS_VAL(cp);
+		tm->tm_min = ISO_2DIGITS_VAL(cp + 3);
+		tm->tm_sec = ISO_2DIGITS_VAL(cp + 6);
+		cp += 8;
+
+		/* leave hour 24 and leap seconds to the general code */
+		if (tm->tm_hour >= HOURS_PER_DAY ||
+			tm->tm_min >= MINS_PER_HOUR ||
+			tm->tm_sec >= SECS_PER_MINUTE)
+			return false;
+
+		if (*cp == '.')
+		{
+			int			scale = USECS_PER_SEC;
+
+			cp++;
+			for (i = 0; ISO_DIGIT(cp[i]); i++)
+			{
+				if (i == 6)
+					return false;	/* needs rounding; use the slow path */
+				scale /= 10;
+				*fsec += (cp[i] - '0') * scale;
+			}
+			if (i == 0)
+				return false;
+			cp += i;
+		}
+	}
+
+	if (*cp == '+' || *cp == '-')
+	{
+		int			tz;
+
+		if (tzp == NULL || !ISO_2DIGITS(cp + 1))
+			return false;
+		tz = ISO_2DIGITS_VAL(cp + 1) * SECS_PER_HOUR;
+		if (cp[3] == ':')
+		{
+			if (!ISO_2DIGITS(cp + 4) || ISO_2DIGITS_VAL(cp + 4) >= MINS_PER_HOUR)
+				return false;
+			tz += ISO_2DIGITS_VAL(cp + 4) * SECS_PER_MINUTE;
+			if (cp[6] != '\0')
+				return false;
+		}
+		else if (cp[3] != '\0')
+			return false;
+		if (tz >= TZDISP_LIMIT)
+			return false;
+		*tzp = (*cp == '-') ? tz : -tz;
+	}
+	else if (*cp != '\0')
+		return false;
+	else if (tzp != NULL)
+		*tzp = DetermineTimeZoneOffset(tm, session_timezone);
+
+#undef ISO_DIGIT
+#undef ISO_2DIGITS
+#undef ISO_2DIGITS_VAL
+
+	return true;
+}
+
+
 /* DecodeDateTime()
  * Interpret previously parsed fields for general date and time.
  * Return 0 if full date, 1 if only time, and negative DTERR code if problems.
@@ -0,0 +1,428 @@
+/*-------------------------------------------------------------------------
+ *
+ * jsonb_selfuncs.c
+ *	  Selectivity estimation functions for jsonb operators.
+ *
+ * The containment and existence operators are estimated from the
+ * most-common-elements statistics gathered by jsonb_typanalyze.c: the
+ * query value is broken down into the same elements ANALYZE collects, and
+ * the element frequencies are combined assuming independence, as
+ * ts_selfuncs.c does for tsquery operands.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/jsonb_selfuncs.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/pg_type.h"
+#include "miscadmin.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/jsonb.h"
+#include "utils/jsonpath.h"
+#include "utils/lsyscache.h"
+#include "utils/selfuncs.h"
+
+
+/*
+ * Default selectivity, used when there are no usable statistics.  This is
+ * what contsel() returns, which these operators used before.
+ */
+#define DEFAULT_JSONB_SEL 0.001
+
+/* lookup table type for binary searching through MCELEMs */
+typedef struct
+{
+	text	   *element;
+	float4		frequency;
+} TextFreq;
+
+/* The MCELEM statistics of a jsonb column, transposed for lookups */
+typedef struct
+{
+	TextFreq   *lookup;
+	int			length;
+	float4		minfreq;
+} JsonbElemStats;
+
+static Selectivity jsonb_contains_selec(JsonbElemStats *stats, Jsonb *query);
+static Selectivity jsonb_exists_array_selec(JsonbElemStats *stats,
+											ArrayType *keys, bool all);
+static Selectivity jsonpath_pred_selec(JsonbElemStats *stats,
+									   JsonPathItem *item);
+static Selectivity jsonpath_equal_selec(JsonbElemStats *stats,
+										JsonPathItem *path,
+										JsonPathItem *value);
+static Selectivity jsonb_element_selec(JsonbElemStats *stats, text *element);
+static int	compare_text_textfreq(const void *e1, const void *e2);
+
+
+/*
+ *	jsonbsel -- restriction selectivity for jsonb @>, ?, ?|, ?& and @@
+ */
+Datum
+jsonbsel(PG_FUNCTION_ARGS)
+{
+	PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+	Oid			operator = PG_GETARG_OID(1);
+	List	   *args = (List *) PG_GETARG_POINTER(2);
+	int			varRelid = PG_GETARG_INT32(3);
+	VariableStatData vardata;
+	Node	   *other;
+	bool		varonleft;
+	Datum		constval;
+	Form_pg_statistic stats;
+	AttStatsSlot sslot;
+	JsonbElemStats elemstats;
+	Selectivity selec;
+	int			i;
+
+	/*
+	 * If expression is not variable op something or something op variable,
+	 * then punt and return a default estimate.
+	 */
+	if (!get_restriction_variable(root, args, varRelid,
+								  &vardata, &other, &varonleft))
+		PG_RETURN_FLOAT8(DEFAULT_JSONB_SEL);
+
+	/*
+	 * Can't do anything useful if the something is not a constant, either.
+	 * All of our operators take the jsonb on the left.
+	 */
+	if (!IsA(other, Const) || !varonleft || vardata.vartype != JSONBOID)
+	{
+		ReleaseVariableStats(vardata);
+		PG_RETURN_FLOAT8(DEFAULT_JSONB_SEL);
+	}
+
+	/*
+	 * The operators are strict, so we can cope with NULL right away
+	 */
+	if (((Const *) other)->constisnull)
+	{
+		ReleaseVariableStats(vardata);
+		PG_RETURN_FLOAT8(0.0);
+	}
+	constval = ((Const *) other)->constvalue;
+
+	/*
+	 * Without most-common-elements statistics we have nothing better than
+	 * the default that contsel() would give.
+	 */
+	if (!HeapTupleIsValid(vardata.statsTuple) ||
+		!get_attstatsslot(&sslot, vardata.statsTuple,
+						  STATISTIC_KIND_MCELEM, InvalidOid,
+						  ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+	{
+		ReleaseVariableStats(vardata);
+		PG_RETURN_FLOAT8(DEFAULT_JSONB_SEL);
+	}
+
+	/*
+	 * There should be two more Numbers than Values, because the last two
+	 * cells are taken for minimal and maximal frequency.  Punt if not.
+	 */
+	if (sslot.valuetype != TEXTOID || sslot.nnumbers != sslot.nvalues + 2)
+	{
+		free_attstatsslot(&sslot);
+		ReleaseVariableStats(vardata);
+		PG_RETURN_FLOAT8(DEFAULT_JSONB_SEL);
+	}
+
+	/*
+	 * Transpose the data into a single array so we can use bsearch().  The
+	 * text Datums came from an array, so they cannot be compressed or stored
+	 * out-of-line.
+	 */
+	elemstats.lookup = (TextFreq *) palloc(sizeof(TextFreq) * sslot.nvalues);
+	for (i = 0; i < sslot.nvalues; i++)
+	{
+		elemstats.lookup[i].element = (text *) DatumGetPointer(sslot.values[i]);
+		elemstats.lookup[i].frequency = sslot.numbers[i];
+	}
+	elemstats.length = sslot.nvalues;
+	elemstats.minfreq = sslot.numbers[sslot.nnumbers - 2];
+
+	switch (operator)
+	{
+		case OID_JSONB_CONTAINS_OP:
+			selec = jsonb_contains_selec(&elemstats, DatumGetJsonbP(constval));
+			break;
+
+		case OID_JSONB_EXISTS_OP:
+			{
+				text	   *key = DatumGetTextPP(constval);
+
+				selec = jsonb_element_selec(&elemstats,
+											JsonbStatsKeyElement(VARDATA_ANY(key),
+																 VARSIZE_ANY_EXHDR(key)));
+				break;
+			}
+
+		case OID_JSONB_EXISTS_ANY_OP:
+			selec = jsonb_exists_array_selec(&elemstats,
+											 DatumGetArrayTypeP(constval),
+											 false);
+			break;
+
+		case OID_JSONB_EXISTS_ALL_OP:
+			selec = jsonb_exists_array_selec(&elemstats,
+											 DatumGetArrayTypeP(constval),
+											 true);
+			break;
+
+		case OID_JSONB_PATH_MATCH_OP:
+			{
+				JsonPathItem item;
+
+				jspInit(&item, DatumGetJsonPathP(constval));
+				selec = jsonpath_pred_selec(&elemstats, &item);
+				break;
+			}
+
+		default:
+			elog(ERROR, "jsonbsel called for unrecognized operator %u",
+				 operator);
+			selec = 0.0;		/* keep compiler quiet */
+			break;
+	}
+
+	/*
+	 * MCE stats count only non-null rows, so adjust for null rows.
+	 */
+	stats = (Form_pg_statistic) GETSTRUCT(vardata.statsTuple);
+	selec *= (1.0 - stats->stanullfrac);
+
+	pfree(elemstats.lookup);
+	free_attstatsslot(&sslot);
+	ReleaseVariableStats(vardata);
+
+	CLAMP_PROBABILITY(selec);
+
+	PG_RETURN_FLOAT8((float8) selec);
+}
+
+/*
+ * Selectivity of jsonb @> constant: a document can only contain the query
+ * if it has every scalar of the query at the same path.
+ */
+static Selectivity
+jsonb_contains_selec(JsonbElemStats *stats, Jsonb *query)
+{
+	text	  **elems;
+	int			nelems;
+	int			nleaves = 0;
+	Selectivity selec = 1.0;
+	int			i;
+
+	elems = JsonbStatsElements(query, &nelems);
+	for (i = 0; i < nelems; i++)
+	{
+		/* Key elements are implied by the leaves below them; skip them */
+		if (VARDATA(elems[i])[0] == '?')
+			continue;
+		selec *= jsonb_element_selec(stats, elems[i]);
+		nleaves++;
+	}
+
+	/*
+	 * A query of only empty containers matches every document of the same
+	 * shape, which we know nothing about.
+	 */
+	if (nleaves == 0)
+		return DEFAULT_JSONB_SEL;
+
+	return selec;
+}
+
+/*
+ * Selectivity of jsonb ?| and ?& constant.  Null array elements are ignored,
+ * as jsonb_exists_any() and jsonb_exists_all() do.
+ */
+static Selectivity
+jsonb_exists_array_selec(JsonbElemStats *stats, ArrayType *keys, bool all)
+{
+	Datum	   *key_datums;
+	bool	   *key_nulls;
+	int			nkeys;
+	Selectivity selec = 1.0;
+	int			i;
+
+	deconstruct_array(keys, TEXTOID, -1, false, 'i',
+					  &key_datums, &key_nulls, &nkeys);
+
+	for (i = 0; i < nkeys; i++)
+	{
+		text	   *key;
+		Selectivity s;
+
+		if (key_nulls[i])
+			continue;
+		key = DatumGetTextPP(key_datums[i]);
+		s = jsonb_element_selec(stats,
+								JsonbStatsKeyElement(VARDATA_ANY(key),
+													 VARSIZE_ANY_EXHDR(key)));
+
+		/* For ?| we accumulate the probability that no key is present */
+		selec *= all ? s : (1.0 - s);
+	}
+
+	return all ? selec : 1.0 - selec;
+}
+
+/*
+ * Selectivity of a jsonpath predicate, as used by jsonb @@ jsonpath.
+ *
+ * Equality of a chain of keys from the root with a literal is looked up in
+ * the statistics; AND, OR and NOT are combined assuming independence, and
+ * anything else gets the default estimate.
+ */
+static Selectivity
+jsonpath_pred_selec(JsonbElemStats *stats, JsonPathItem *item)
+{
+	JsonPathItem larg,
+				rarg;
+	Selectivity s1,
+				s2;
+
+	/* since this function recurses, it could be driven to stack overflow */
+	check_stack_depth();
+
+	switch (item->type)
+	{
+		case jpiAnd:
+			jspGetLeftArg(item, &larg);
+			jspGetRightArg(item, &rarg);
+			return jsonpath_pred_selec(stats, &larg) *
+				jsonpath_pred_selec(stats, &rarg);
+
+		case jpiOr:
+			jspGetLeftArg(item, &larg);
+			jspGetRightArg(item, &rarg);
+			s1 = jsonpath_pred_selec(stats, &larg);
+			s2 = jsonpath_pred_selec(stats, &rarg);
+			return s1 + s2 - s1 * s2;
+
+		case jpiNot:
+			jspGetArg(item, &larg);
+			return 1.0 - jsonpath_pred_selec(stats, &larg);
+
+		case jpiEqual:
+			jspGetLeftArg(item, &larg);
+			jspGetRightArg(item, &rarg);
+			if (larg.type == jpiRoot)
+				return jsonpath_equal_selec(stats, &larg, &rarg);
+			if (rarg.type == jpiRoot)
+				return jsonpath_equal_selec(stats, &rarg, &larg);
+			return DEFAULT_JSONB_SEL;
+
+		default:
+			return DEFAULT_JSONB_SEL;
+	}
+}
+
+/*
+ * Selectivity of "path == value", where path starts at the root.  Array
+ * wildcards in the path are skipped, since the statistics look through
+ * arrays anyway.
+ */
+static Selectivity
+jsonpath_equal_selec(JsonbElemStats *stats, JsonPathItem *path,
+					 JsonPathItem *value)
+{
+	JsonbValue *keys;
+	int			nkeys = 0;
+	int			maxkeys = 8;
+	JsonbValue	leaf;
+	JsonPathItem item,
+				next;
+
+	switch (value->type)
+	{
+		case jpiNull:
+			leaf.type = jbvNull;
+			break;
+		case jpiString:
+			leaf.type = jbvString;
+			leaf.val.string.val = jspGetString(value, &leaf.val.string.len);
+			break;
+		case jpiNumeric:
+			leaf.type = jbvNumeric;
+			leaf.val.numeric = jspGetNumeric(value);
+			break;
+		case jpiBool:
+			leaf.type = jbvBool;
+			leaf.val.boolean = jspGetBool(value);
+			break;
+		default:
+			return DEFAULT_JSONB_SEL;
+	}
+
+	keys = (JsonbValue *) palloc(maxkeys * sizeof(JsonbValue));
+	item = *path;
+	while (jspGetNext(&item, &next))
+	{
+		if (next.type == jpiKey)
+		{
+			if (nkeys >= maxkeys)
+			{
+				maxkeys *= 2;
+				keys = (JsonbValue *) repalloc(keys, maxkeys * sizeof(JsonbValue));
+			}
+			keys[nkeys].type = jbvString;
+			keys[nkeys].val.string.val = jspGetString(&next,
+													  &keys[nkeys].val.string.len);
+			nkeys++;
+		}
+		else if (next.type != jpiAnyArray)
+			return DEFAULT_JSONB_SEL;
+		item = next;
+	}
+
+	return jsonb_element_selec(stats,
+							   JsonbStatsLeafElement(keys, nkeys, &leaf));
+}
+
+/*
+ * Frequency of one statistics element.  Elements missing from the MCELEM
+ * list are assumed to be rarer than the rarest one in it.
+ */
+static Selectivity
+jsonb_element_selec(JsonbElemStats *stats, text *element)
+{
+	TextFreq   *found;
+
+	found = bsearch(element, stats->lookup, stats->length,
+					sizeof(TextFreq), compare_text_textfreq);
+	if (found)
+		return found->frequency;
+
+	return Min(DEFAULT_JSONB_SEL, stats->minfreq / 2);
+}
+
+/*
+ * bsearch() comparator for a text element and a TextFreq.  The MCELEM array
+ * is sorted on length, then bytes; see jsonb_typanalyze.c.
+ */
+static int
+compare_text_textfreq(const void *e1, const void *e2)
+{
+	const text *key = (const text *) e1;
+	const TextFreq *t = (const TextFreq *) e2;
+	int			len1 = VARSIZE_ANY_EXHDR(key);
+	int			len2 = VARSIZE_ANY_EXHDR(t->element);
+
+	if (len1 > len2)
+		return 1;
+	else if (len1 < len2)
+		return -1;
+	return memcmp(VARDATA_ANY(key), VARDATA_ANY(t->element), len1);
+}
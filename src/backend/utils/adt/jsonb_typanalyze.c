@@ -0,0 +1,675 @@
+/*-------------------------------------------------------------------------
+ *
+ * jsonb_typanalyze.c
+ *	  Functions for gathering statistics from jsonb columns
+ *
+ * Whole jsonb documents rarely repeat, so besides the standard scalar
+ * statistics we collect the most common "elements" of the documents, in
+ * the same STATISTIC_KIND_MCELEM format that tsvector and array columns
+ * use.  An element is a short text string standing for one thing the
+ * containment and existence operators can test for:
+ *
+ *	- For each scalar in a document, the smallest document that contains
+ *	  it along the same path of object keys, written as jsonb_out would,
+ *	  for example {"a": {"b": 1}} for the 1 in {"a": {"b": 1, "c": [2]}}.
+ *	  Arrays are looked through, as jsonb_path_ops does, so 2 in the same
+ *	  document gives {"a": {"c": 2}}.  A scalar reached through no keys at
+ *	  all is just written as itself.
+ *
+ *	- For each top-level object key, and each string that is a top-level
+ *	  array element, "?" followed by the string, which is what the "?"
+ *	  family of operators looks at.
+ *
+ * jsonb_selfuncs.c decomposes query values into the same elements.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/jsonb_typanalyze.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/tuptoaster.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_type.h"
+#include "commands/vacuum.h"
+#include "utils/builtins.h"
+#include "utils/hashutils.h"
+#include "utils/json.h"
+#include "utils/jsonb.h"
+#include "utils/memutils.h"
+
+
+/*
+ * We ignore documents wider than JSONB_WIDTH_THRESHOLD (after detoasting),
+ * for the same reasons array_typanalyze.c ignores wide arrays, and elements
+ * longer than JSONB_ELEM_WIDTH_THRESHOLD, which would only bloat
+ * pg_statistic.
+ */
+#define JSONB_WIDTH_THRESHOLD		0x10000
+#define JSONB_ELEM_WIDTH_THRESHOLD	1024
+
+/* Extra data for compute_jsonb_stats function */
+typedef struct
+{
+	/* Saved state from std_typanalyze() */
+	AnalyzeAttrComputeStatsFunc std_compute_stats;
+	void	   *std_extra_data;
+} JsonbAnalyzeExtraData;
+
+/* A hash key for elements */
+typedef struct
+{
+	char	   *element;		/* element (not NULL terminated!) */
+	int			length;			/* its length in bytes */
+} ElementHashKey;
+
+/* A hash table entry for the Lossy Counting algorithm */
+typedef struct
+{
+	ElementHashKey key;			/* This is 'e' from the LC algorithm. */
+	int			frequency;		/* This is 'f'. */
+	int			delta;			/* And this is 'delta'. */
+} TrackItem;
+
+static void compute_jsonb_stats(VacAttrStats *stats,
+								AnalyzeAttrFetchFunc fetchfunc,
+								int samplerows,
+								double totalrows);
+static void prune_element_hashtable(HTAB *elements_tab, int b_current);
+static uint32 element_hash(const void *key, Size keysize);
+static int	element_match(const void *key1, const void *key2, Size keysize);
+static int	element_compare(const void *key1, const void *key2);
+static int	text_compare(const void *e1, const void *e2);
+static int	trackitem_compare_frequencies_desc(const void *e1, const void *e2);
+static int	trackitem_compare_elements(const void *e1, const void *e2);
+
+
+/*
+ * jsonb_typanalyze -- typanalyze function for jsonb columns
+ */
+Datum
+jsonb_typanalyze(PG_FUNCTION_ARGS)
+{
+	VacAttrStats *stats = (VacAttrStats *) PG_GETARG_POINTER(0);
+	JsonbAnalyzeExtraData *extra_data;
+
+	/*
+	 * Call the standard typanalyze function.  It may fail to find needed
+	 * operators, in which case we also can't do anything, so just fail.
+	 */
+	if (!std_typanalyze(stats))
+		PG_RETURN_BOOL(false);
+
+	extra_data = (JsonbAnalyzeExtraData *) palloc(sizeof(JsonbAnalyzeExtraData));
+
+	/* Save old compute_stats and extra_data for scalar statistics ... */
+	extra_data->std_compute_stats = stats->compute_stats;
+	extra_data->std_extra_data = stats->extra_data;
+
+	/* ... and replace with our info */
+	stats->compute_stats = compute_jsonb_stats;
+	stats->extra_data = extra_data;
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Append the text form of a jsonb scalar to buf, as jsonb_out would.
+ */
+static void
+put_jsonb_scalar(StringInfo buf, JsonbValue *v)
+{
+	switch (v->type)
+	{
+		case jbvNull:
+			appendStringInfoString(buf, "null");
+			break;
+		case jbvString:
+			escape_json(buf, pnstrdup(v->val.string.val, v->val.string.len));
+			break;
+		case jbvNumeric:
+			appendStringInfoString(buf,
+								   DatumGetCString(DirectFunctionCall1(numeric_out,
+																	   PointerGetDatum(v->val.numeric))));
+			break;
+		case jbvBool:
+			appendStringInfoString(buf, v->val.boolean ? "true" : "false");
+			break;
+		default:
+			elog(ERROR, "unrecognized jsonb scalar type: %d", (int) v->type);
+	}
+}
+
+/*
+ * JsonbStatsKeyElement
+ *		Build the statistics element for a top-level key or string.
+ */
+text *
+JsonbStatsKeyElement(const char *key, int keylen)
+{
+	text	   *result = (text *) palloc(VARHDRSZ + 1 + keylen);
+
+	SET_VARSIZE(result, VARHDRSZ + 1 + keylen);
+	VARDATA(result)[0] = '?';
+	memcpy(VARDATA(result) + 1, key, keylen);
+
+	return result;
+}
+
+/*
+ * JsonbStatsLeafElement
+ *		Build the statistics element for a scalar reached through the given
+ *		object keys, which must be jbvString values.
+ */
+text *
+JsonbStatsLeafElement(JsonbValue *path, int npath, JsonbValue *leaf)
+{
+	StringInfoData buf;
+	text	   *result;
+	int			i;
+
+	initStringInfo(&buf);
+	for (i = 0; i < npath; i++)
+	{
+		appendStringInfoChar(&buf, '{');
+		put_jsonb_scalar(&buf, &path[i]);
+		appendStringInfoString(&buf, ": ");
+	}
+	put_jsonb_scalar(&buf, leaf);
+	for (i = 0; i < npath; i++)
+		appendStringInfoChar(&buf, '}');
+
+	result = cstring_to_text_with_len(buf.data, buf.len);
+	pfree(buf.data);
+
+	return result;
+}
+
+/*
+ * JsonbStatsElements
+ *		Return the distinct statistics elements of a document, sorted.
+ *
+ * Elements wider than JSONB_ELEM_WIDTH_THRESHOLD are left out.
+ */
+text **
+JsonbStatsElements(Jsonb *jb, int *nelems)
+{
+	JsonbIterator *it;
+	JsonbIteratorToken r;
+	JsonbValue	v;
+	JsonbValue	key;
+	bool		havekey = false;
+	JsonbValue *path;			/* keys leading to the current container */
+	bool	   *haskey;			/* was each open container under a key? */
+	int			npath = 0;
+	int			level = 0;
+	int			maxlevel = 8;
+	text	  **elems;
+	int			n = 0;
+	int			nalloc = 16;
+	int			i,
+				j;
+
+	path = (JsonbValue *) palloc((maxlevel + 1) * sizeof(JsonbValue));
+	haskey = (bool *) palloc(maxlevel * sizeof(bool));
+	elems = (text **) palloc(nalloc * sizeof(text *));
+
+#define ADD_ELEMENT(e) \
+	do { \
+		text	   *e_ = (e); \
+		if (VARSIZE(e_) - VARHDRSZ > JSONB_ELEM_WIDTH_THRESHOLD) \
+			break; \
+		if (n >= nalloc) \
+		{ \
+			nalloc *= 2; \
+			elems = (text **) repalloc(elems, nalloc * sizeof(text *)); \
+		} \
+		elems[n++] = e_; \
+	} while (0)
+
+	it = JsonbIteratorInit(&jb->root);
+	while ((r = JsonbIteratorNext(&it, &v, false)) != WJB_DONE)
+	{
+		switch (r)
+		{
+			case WJB_BEGIN_ARRAY:
+			case WJB_BEGIN_OBJECT:
+				if (level >= maxlevel)
+				{
+					maxlevel *= 2;
+					path = (JsonbValue *) repalloc(path, (maxlevel + 1) * sizeof(JsonbValue));
+					haskey = (bool *) repalloc(haskey, maxlevel * sizeof(bool));
+				}
+				haskey[level++] = havekey;
+				if (havekey)
+					path[npath++] = key;
+				havekey = false;
+				break;
+
+			case WJB_END_ARRAY:
+			case WJB_END_OBJECT:
+				if (haskey[--level])
+					npath--;
+				break;
+
+			case WJB_KEY:
+				key = v;
+				havekey = true;
+				if (level == 1)
+					ADD_ELEMENT(JsonbStatsKeyElement(v.val.string.val,
+													 v.val.string.len));
+				break;
+
+			case WJB_VALUE:
+				/* path has room for one more entry beyond the open levels */
+				path[npath] = key;
+				ADD_ELEMENT(JsonbStatsLeafElement(path, npath + 1, &v));
+				havekey = false;
+				break;
+
+			case WJB_ELEM:
+				ADD_ELEMENT(JsonbStatsLeafElement(path, npath, &v));
+				if (level == 1 && v.type == jbvString)
+					ADD_ELEMENT(JsonbStatsKeyElement(v.val.string.val,
+													 v.val.string.len));
+				break;
+
+			default:
+				elog(ERROR, "unexpected jsonb iterator token: %d", (int) r);
+		}
+	}
+
+#undef ADD_ELEMENT
+
+	/* Sort and remove duplicates */
+	if (n > 1)
+	{
+		qsort(elems, n, sizeof(text *), text_compare);
+		for (i = 1, j = 0; i < n; i++)
+		{
+			if (text_compare(&elems[i], &elems[j]) != 0)
+				elems[++j] = elems[i];
+		}
+		n = j + 1;
+	}
+
+	pfree(path);
+	pfree(haskey);
+
+	*nelems = n;
+	return elems;
+}
+
+/*
+ * compute_jsonb_stats() -- compute statistics for a jsonb column
+ *
+ * We invoke the standard compute_stats function first, for the btree-style
+ * comparison operators, and then find the most common elements, as
+ * described at the top of this file, with the Lossy Counting algorithm.
+ * See compute_tsvector_stats() for a description of the algorithm and of
+ * our choice of parameters, which we follow, and compute_array_stats() for
+ * why we count each element once per row and store frequencies as the
+ * fraction of non-null rows that contain the element.
+ */
+static void
+compute_jsonb_stats(VacAttrStats *stats,
+					AnalyzeAttrFetchFunc fetchfunc,
+					int samplerows,
+					double totalrows)
+{
+	JsonbAnalyzeExtraData *extra_data;
+	int			num_mcelem;
+	int			analyzed_rows = 0;
+
+	/* This is D from the LC algorithm. */
+	HTAB	   *elements_tab;
+	HASHCTL		hash_ctl;
+	HASH_SEQ_STATUS scan_status;
+
+	/* This is the current bucket number from the LC algorithm */
+	int			b_current;
+
+	/* This is 'w' from the LC algorithm */
+	int			bucket_width;
+	int			doc_no,
+				element_no;
+	ElementHashKey hash_key;
+	TrackItem  *item;
+	int			slot_idx;
+	MemoryContext doc_context;
+	MemoryContext old_context;
+
+	extra_data = (JsonbAnalyzeExtraData *) stats->extra_data;
+
+	/*
+	 * Invoke analyze.c's standard analysis function to create scalar-style
+	 * stats for the column.  It will expect its own extra_data pointer, so
+	 * temporarily install that.
+	 */
+	stats->extra_data = extra_data->std_extra_data;
+	extra_data->std_compute_stats(stats, fetchfunc, samplerows, totalrows);
+	stats->extra_data = extra_data;
+
+	/* We want statistics_target * 10 elements in the MCELEM array */
+	num_mcelem = stats->attr->attstattarget * 10;
+
+	/* As in compute_tsvector_stats(), bucket width is (K + 10) / 0.007 */
+	bucket_width = (num_mcelem + 10) * 1000 / 7;
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(ElementHashKey);
+	hash_ctl.entrysize = sizeof(TrackItem);
+	hash_ctl.hash = element_hash;
+	hash_ctl.match = element_match;
+	hash_ctl.hcxt = CurrentMemoryContext;
+	elements_tab = hash_create("Analyzed jsonb elements table",
+							   num_mcelem,
+							   &hash_ctl,
+							   HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+
+	/* Elements of each document are built here and thrown away after it */
+	doc_context = AllocSetContextCreate(CurrentMemoryContext,
+										"jsonb analyze document",
+										ALLOCSET_DEFAULT_SIZES);
+
+	/* Initialize counters. */
+	b_current = 1;
+	element_no = 0;
+
+	/* Loop over the documents. */
+	for (doc_no = 0; doc_no < samplerows; doc_no++)
+	{
+		Datum		value;
+		bool		isnull;
+		Jsonb	   *jb;
+		text	  **elems;
+		int			nelems;
+		int			j;
+
+		vacuum_delay_point();
+
+		value = fetchfunc(stats, doc_no, &isnull);
+		if (isnull)
+			continue;
+
+		/* Skip too-large values. */
+		if (toast_raw_datum_size(value) > JSONB_WIDTH_THRESHOLD)
+			continue;
+		analyzed_rows++;
+
+		old_context = MemoryContextSwitchTo(doc_context);
+		jb = DatumGetJsonbP(value);
+		elems = JsonbStatsElements(jb, &nelems);
+		MemoryContextSwitchTo(old_context);
+
+		for (j = 0; j < nelems; j++)
+		{
+			bool		found;
+
+			/*
+			 * The key points into the per-document context at this point,
+			 * but if a new entry is created, we make a copy of it.
+			 */
+			hash_key.element = VARDATA(elems[j]);
+			hash_key.length = VARSIZE(elems[j]) - VARHDRSZ;
+
+			item = (TrackItem *) hash_search(elements_tab,
+											 (const void *) &hash_key,
+											 HASH_ENTER, &found);
+
+			if (found)
+				item->frequency++;
+			else
+			{
+				item->frequency = 1;
+				item->delta = b_current - 1;
+
+				item->key.element = palloc(hash_key.length);
+				memcpy(item->key.element, hash_key.element, hash_key.length);
+			}
+
+			/* element_no is the number of elements processed (ie N) */
+			element_no++;
+
+			/* We prune the D structure after processing each bucket */
+			if (element_no % bucket_width == 0)
+			{
+				prune_element_hashtable(elements_tab, b_current);
+				b_current++;
+			}
+		}
+
+		MemoryContextReset(doc_context);
+	}
+
+	/* Skip pg_statistic slots occupied by standard statistics */
+	slot_idx = 0;
+	while (slot_idx < STATISTIC_NUM_SLOTS && stats->stakind[slot_idx] != 0)
+		slot_idx++;
+	if (slot_idx >= STATISTIC_NUM_SLOTS)
+		elog(ERROR, "insufficient pg_statistic slots for jsonb stats");
+
+	/* We can only compute real stats if we found some non-null values. */
+	if (analyzed_rows > 0)
+	{
+		int			nonnull_cnt = analyzed_rows;
+		int			i;
+		TrackItem **sort_table;
+		int			track_len;
+		int			cutoff_freq;
+		int			minfreq,
+					maxfreq;
+
+		/*
+		 * We assume the standard stats code already took care of setting
+		 * stats_valid, stanullfrac, stawidth, stadistinct.
+		 *
+		 * Since epsilon = s/10 and bucket_width = 1/epsilon, the cutoff
+		 * frequency is 9*N / bucket_width.
+		 */
+		cutoff_freq = 9 * element_no / bucket_width;
+
+		i = hash_get_num_entries(elements_tab); /* surely enough space */
+		sort_table = (TrackItem **) palloc(sizeof(TrackItem *) * i);
+
+		hash_seq_init(&scan_status, elements_tab);
+		track_len = 0;
+		minfreq = element_no;
+		maxfreq = 0;
+		while ((item = (TrackItem *) hash_seq_search(&scan_status)) != NULL)
+		{
+			if (item->frequency > cutoff_freq)
+			{
+				sort_table[track_len++] = item;
+				minfreq = Min(minfreq, item->frequency);
+				maxfreq = Max(maxfreq, item->frequency);
+			}
+		}
+		Assert(track_len <= i);
+
+		/* emit some statistics for debug purposes */
+		elog(DEBUG3, "compute_jsonb_stats: target # mces = %d, bucket width = %d, "
+			 "# elements = %d, hashtable size = %d, usable entries = %d",
+			 num_mcelem, bucket_width, element_no, i, track_len);
+
+		/*
+		 * If we obtained more elements than we really want, get rid of those
+		 * with least frequencies.
+		 */
+		if (num_mcelem < track_len)
+		{
+			qsort(sort_table, track_len, sizeof(TrackItem *),
+				  trackitem_compare_frequencies_desc);
+			/* reset minfreq to the smallest frequency we're keeping */
+			minfreq = sort_table[num_mcelem - 1]->frequency;
+		}
+		else
+			num_mcelem = track_len;
+
+		/* Generate MCELEM slot entry */
+		if (num_mcelem > 0)
+		{
+			Datum	   *mcelem_values;
+			float4	   *mcelem_freqs;
+
+			/*
+			 * Sort on length, then bytes, so that jsonb_selfuncs.c can
+			 * binary-search the array, as with tsvector statistics.
+			 */
+			qsort(sort_table, num_mcelem, sizeof(TrackItem *),
+				  trackitem_compare_elements);
+
+			/* Must copy the target values into anl_context */
+			old_context = MemoryContextSwitchTo(stats->anl_context);
+
+			/*
+			 * The two extra cells hold the minimal and maximal frequencies.
+			 */
+			mcelem_values = (Datum *) palloc(num_mcelem * sizeof(Datum));
+			mcelem_freqs = (float4 *) palloc((num_mcelem + 2) * sizeof(float4));
+
+			for (i = 0; i < num_mcelem; i++)
+			{
+				TrackItem  *item = sort_table[i];
+
+				mcelem_values[i] =
+					PointerGetDatum(cstring_to_text_with_len(item->key.element,
+															 item->key.length));
+				mcelem_freqs[i] = (double) item->frequency / (double) nonnull_cnt;
+			}
+			mcelem_freqs[i++] = (double) minfreq / (double) nonnull_cnt;
+			mcelem_freqs[i] = (double) maxfreq / (double) nonnull_cnt;
+			MemoryContextSwitchTo(old_context);
+
+			stats->stakind[slot_idx] = STATISTIC_KIND_MCELEM;
+			stats->staop[slot_idx] = TextEqualOperator;
+			stats->stacoll[slot_idx] = DEFAULT_COLLATION_OID;
+			stats->stanumbers[slot_idx] = mcelem_freqs;
+			/* See above comment about two extra frequency fields */
+			stats->numnumbers[slot_idx] = num_mcelem + 2;
+			stats->stavalues[slot_idx] = mcelem_values;
+			stats->numvalues[slot_idx] = num_mcelem;
+			/* We are storing text values */
+			stats->statypid[slot_idx] = TEXTOID;
+			stats->statyplen[slot_idx] = -1;	/* typlen, -1 for varlena */
+			stats->statypbyval[slot_idx] = false;
+			stats->statypalign[slot_idx] = 'i';
+		}
+	}
+
+	/*
+	 * We don't need to bother cleaning up any of our temporary palloc's. The
+	 * hashtable should also go away, as it used a child memory context.
+	 */
+}
+
+/*
+ *	A function to prune the D structure from the Lossy Counting algorithm.
+ *	Consult compute_tsvector_stats() for wider explanation.
+ */
+static void
+prune_element_hashtable(HTAB *elements_tab, int b_current)
+{
+	HASH_SEQ_STATUS scan_status;
+	TrackItem  *item;
+
+	hash_seq_init(&scan_status, elements_tab);
+	while ((item = (TrackItem *) hash_seq_search(&scan_status)) != NULL)
+	{
+		if (item->frequency + item->delta <= b_current)
+		{
+			char	   *element = item->key.element;
+
+			if (hash_search(elements_tab, (const void *) &item->key,
+							HASH_REMOVE, NULL) == NULL)
+				elog(ERROR, "hash table corrupted");
+			pfree(element);
+		}
+	}
+}
+
+/*
+ * Hash function for elements, which are not NULL terminated.
+ */
+static uint32
+element_hash(const void *key, Size keysize)
+{
+	const ElementHashKey *e = (const ElementHashKey *) key;
+
+	return DatumGetUInt32(hash_any((const unsigned char *) e->element,
+								   e->length));
+}
+
+/*
+ *	Matching function for elements, to be used in hashtable lookups.
+ */
+static int
+element_match(const void *key1, const void *key2, Size keysize)
+{
+	/* The keysize parameter is superfluous, the keys store their lengths */
+	return element_compare(key1, key2);
+}
+
+/*
+ *	Comparison function for elements: by length, then byte-for-byte.
+ */
+static int
+element_compare(const void *key1, const void *key2)
+{
+	const ElementHashKey *d1 = (const ElementHashKey *) key1;
+	const ElementHashKey *d2 = (const ElementHashKey *) key2;
+
+	if (d1->length > d2->length)
+		return 1;
+	else if (d1->length < d2->length)
+		return -1;
+	return memcmp(d1->element, d2->element, d1->length);
+}
+
+/*
+ *	qsort() comparator for text pointers, in the same order as
+ *	element_compare()
+ */
+static int
+text_compare(const void *e1, const void *e2)
+{
+	const text *t1 = *(const text *const *) e1;
+	const text *t2 = *(const text *const *) e2;
+	int			len1 = VARSIZE(t1) - VARHDRSZ;
+	int			len2 = VARSIZE(t2) - VARHDRSZ;
+
+	if (len1 > len2)
+		return 1;
+	else if (len1 < len2)
+		return -1;
+	return memcmp(VARDATA(t1), VARDATA(t2), len1);
+}
+
+/*
+ *	qsort() comparator for sorting TrackItems on frequencies (descending sort)
+ */
+static int
+trackitem_compare_frequencies_desc(const void *e1, const void *e2)
+{
+	const TrackItem *const *t1 = (const TrackItem *const *) e1;
+	const TrackItem *const *t2 = (const TrackItem *const *) e2;
+
+	return (*t2)->frequency - (*t1)->frequency;
+}
+
+/*
+ *	qsort() comparator for sorting TrackItems on elements
+ */
+static int
+trackitem_compare_elements(const void *e1, const void *e2)
+{
+	const TrackItem *const *t1 = (const TrackItem *const *) e1;
+	const TrackItem *const *t2 = (const TrackItem *const *) e2;
+
+	return element_compare(&(*t1)->key, &(*t2)->key);
+}
@@ -13,6 +13,7 @@
  */
 #include "postgres.h"
 
+#include "access/tuptoaster.h"
 #include "catalog/pg_collation.h"
 #include "miscadmin.h"
 #include "utils/builtins.h"
@@ -33,6 +34,34 @@
 #define JSONB_MAX_ELEMS (Min(MaxAllocSize / sizeof(JsonbValue), JB_CMASK))
 #define JSONB_MAX_PAIRS (Min(MaxAllocSize / sizeof(JsonbPair), JB_CMASK))
 
+/* Minimum prefix of a toasted jsonb to fetch when looking up a key */
+#define JSONB_MIN_PREFIX 1024
+
+/*
+ * Cache of the last out-of-line jsonb value detoasted by an accessor.
+ *
+ * Queries often extract several keys from the same large jsonb column, and
+ * every accessor would otherwise fetch and decompress the value again.  We
+ * remember the identity of the last out-of-line value seen; when it is seen
+ * again, it is detoasted in full and kept, along with the offsets of its
+ * root container's children, until the memory context it was detoasted in
+ * is reset.  That normally is the per-tuple context of the expression being
+ * evaluated, so the cached value lives as long as the tuple it came from.
+ */
+typedef struct JsonbToastCache
+{
+	/* identity of the last value seen */
+	Oid			toastrelid;
+	Oid			valueid;
+	int32		rawsize;
+
+	MemoryContext mcxt;			/* context holding the fields below, or NULL */
+	Jsonb	   *jb;				/* detoasted value */
+	uint32	   *offsets;		/* offsets of root's children, or NULL */
+} JsonbToastCache;
+
+static JsonbToastCache jsonbToastCache;
+
 static void fillJsonbValue(JsonbContainer *container, int index,
 						   char *base_addr, uint32 offset,
 						   JsonbValue *result);
@@ -410,6 +439,325 @@ findJsonbValueFromContainer(JsonbContainer *container, uint32 flags,
 	return NULL;
 }
 
+/*
+ * Fetch a prefix of at least "needed" bytes of the data of a toasted jsonb
+ * datum into *prefix, replacing any shorter prefix fetched before, and return
+ * the root container at its start.
+ */
+static JsonbContainer *
+fetchJsonbPrefix(struct varlena *attr, struct varlena **prefix,
+				 uint32 needed, uint32 total)
+{
+	if (needed > total)
+		elog(ERROR, "jsonb container extends past the end of the datum");
+
+	if (*prefix == NULL || VARSIZE(*prefix) - VARHDRSZ < needed)
+	{
+		uint32		len = Max(needed, JSONB_MIN_PREFIX);
+
+		/*
+		 * Every fetch decompresses the data from its start again, so grow the
+		 * prefix at least geometrically.
+		 */
+		if (*prefix != NULL)
+		{
+			len = Max(len, 2 * (VARSIZE(*prefix) - VARHDRSZ));
+			pfree(*prefix);
+		}
+		len = Min(len, total);
+
+		*prefix = heap_tuple_untoast_attr_slice(attr, 0, len);
+	}
+
+	return (JsonbContainer *) VARDATA(*prefix);
+}
+
+/*
+ * Forget the detoasted value kept in the cache.
+ */
+static void
+jsonbToastCacheClear(void)
+{
+	if (jsonbToastCache.mcxt != NULL)
+	{
+		pfree(jsonbToastCache.jb);
+		if (jsonbToastCache.offsets)
+			pfree(jsonbToastCache.offsets);
+	}
+	jsonbToastCache.mcxt = NULL;
+	jsonbToastCache.jb = NULL;
+	jsonbToastCache.offsets = NULL;
+}
+
+/*
+ * Memory context reset callback, invalidating the cached value if it lives
+ * in the context being reset.
+ */
+static void
+jsonbToastCacheReset(void *arg)
+{
+	if (jsonbToastCache.mcxt == (MemoryContext) arg)
+	{
+		jsonbToastCache.mcxt = NULL;
+		jsonbToastCache.jb = NULL;
+		jsonbToastCache.offsets = NULL;
+	}
+}
+
+/*
+ * Report whether an out-of-line jsonb is the value last seen by an accessor,
+ * and remember it as such otherwise.
+ */
+static bool
+jsonbToastCacheSeen(struct varlena *attr)
+{
+	struct varatt_external toast_pointer;
+
+	VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+
+	if (toast_pointer.va_valueid == jsonbToastCache.valueid &&
+		toast_pointer.va_toastrelid == jsonbToastCache.toastrelid &&
+		toast_pointer.va_rawsize == jsonbToastCache.rawsize)
+		return true;
+
+	jsonbToastCacheClear();
+	jsonbToastCache.toastrelid = toast_pointer.va_toastrelid;
+	jsonbToastCache.valueid = toast_pointer.va_valueid;
+	jsonbToastCache.rawsize = toast_pointer.va_rawsize;
+
+	return false;
+}
+
+/*
+ * Return the detoasted form of an out-of-line jsonb, from the cache if it's
+ * there, or else detoasting it in CurrentMemoryContext and caching it.
+ */
+static Jsonb *
+jsonbToastCacheFetch(struct varlena *attr)
+{
+	MemoryContextCallback *cb;
+
+	if (jsonbToastCacheSeen(attr) && jsonbToastCache.mcxt != NULL)
+		return jsonbToastCache.jb;
+
+	jsonbToastCache.jb = (Jsonb *) heap_tuple_untoast_attr(attr);
+
+	/* precompute the offsets of the root container's children */
+	if (JB_ROOT_IS_OBJECT(jsonbToastCache.jb))
+	{
+		JsonbContainer *container = &jsonbToastCache.jb->root;
+		uint32		nchildren = JsonContainerSize(container) * 2;
+		uint32		offset = 0;
+		uint32		i;
+
+		jsonbToastCache.offsets = palloc((nchildren + 1) * sizeof(uint32));
+		for (i = 0; i < nchildren; i++)
+		{
+			JEntry		entry = container->children[i];
+
+			jsonbToastCache.offsets[i] = offset;
+			if (JBE_HAS_OFF(entry))
+				offset = JBE_OFFLENFLD(entry);
+			else
+				offset += JBE_OFFLENFLD(entry);
+		}
+		jsonbToastCache.offsets[nchildren] = offset;
+	}
+
+	cb = palloc(sizeof(MemoryContextCallback));
+	cb->func = jsonbToastCacheReset;
+	cb->arg = CurrentMemoryContext;
+	MemoryContextRegisterResetCallback(CurrentMemoryContext, cb);
+	jsonbToastCache.mcxt = CurrentMemoryContext;
+
+	return jsonbToastCache.jb;
+}
+
+/*
+ * Detoast a jsonb datum, like DatumGetJsonbP(), but using the cache of
+ * out-of-line values, so that several accessors of the same value in one
+ * tuple only fetch it once.  The result must not be modified or freed.
+ */
+Jsonb *
+DatumGetJsonbPCached(Datum jsonb)
+{
+	struct varlena *attr = (struct varlena *) DatumGetPointer(jsonb);
+
+	if (VARATT_IS_EXTERNAL_ONDISK(attr))
+		return jsonbToastCacheFetch(attr);
+
+	return DatumGetJsonbP(jsonb);
+}
+
+/*
+ * Look up a top-level key in a cached jsonb, using the precomputed offsets
+ * of its root container's children.
+ */
+static JsonbValue *
+findJsonbObjectFieldCached(struct varlena *attr, JsonbValue *key)
+{
+	Jsonb	   *jb = jsonbToastCacheFetch(attr);
+	JsonbContainer *container = &jb->root;
+	uint32	   *offsets = jsonbToastCache.offsets;
+	uint32		count;
+	char	   *base_addr;
+	uint32		stopLow,
+				stopHigh;
+
+	if (!JsonContainerIsObject(container))
+		return NULL;
+
+	count = JsonContainerSize(container);
+	base_addr = (char *) (container->children + count * 2);
+
+	/* Binary search on object/pair keys *only* */
+	stopLow = 0;
+	stopHigh = count;
+	while (stopLow < stopHigh)
+	{
+		uint32		stopMiddle;
+		int			difference;
+		JsonbValue	candidate;
+
+		stopMiddle = stopLow + (stopHigh - stopLow) / 2;
+
+		candidate.type = jbvString;
+		candidate.val.string.val = base_addr + offsets[stopMiddle];
+		candidate.val.string.len = offsets[stopMiddle + 1] - offsets[stopMiddle];
+
+		difference = lengthCompareJsonbStringValue(&candidate, key);
+
+		if (difference == 0)
+		{
+			/* Found our key, return corresponding value */
+			int			index = stopMiddle + count;
+			JsonbValue *result = palloc(sizeof(JsonbValue));
+
+			fillJsonbValue(container, index, base_addr, offsets[index], result);
+
+			return result;
+		}
+		else
+		{
+			if (difference < 0)
+				stopLow = stopMiddle + 1;
+			else
+				stopHigh = stopMiddle;
+		}
+	}
+
+	/* Not found */
+	return NULL;
+}
+
+/*
+ * Find the value of a top-level key of a jsonb object, like
+ * findJsonbValueFromContainer() with JB_FOBJECT on the datum's root container.
+ *
+ * If the datum is compressed or stored out of line, only as much of it as
+ * needed is detoasted: first the root container's JEntry array, then the
+ * keys, which are stored before all the values, and finally the data up to
+ * the end of the matching value.  For an object with large values, that is
+ * usually a small part of the whole datum.
+ *
+ * Returns NULL if the datum isn't an object, or if it doesn't have the key.
+ */
+JsonbValue *
+findJsonbObjectFieldFromDatum(Datum jsonb, JsonbValue *key)
+{
+	struct varlena *attr = (struct varlena *) DatumGetPointer(jsonb);
+	struct varlena *prefix = NULL;
+	JsonbContainer *container;
+	uint32		total;
+	uint32		count;
+	uint32		base;
+	uint32		stopLow,
+				stopHigh;
+
+	Assert(key->type == jbvString);
+
+	/* plain values have nothing to gain */
+	if (!VARATT_IS_COMPRESSED(attr) && !VARATT_IS_EXTERNAL(attr))
+	{
+		Jsonb	   *jb = DatumGetJsonbP(jsonb);
+
+		return findJsonbValueFromContainer(&jb->root, JB_FOBJECT, key);
+	}
+
+	/*
+	 * An out-of-line value that was looked at before is detoasted in full and
+	 * cached, since more lookups are likely to follow.
+	 */
+	if (VARATT_IS_EXTERNAL_ONDISK(attr) && jsonbToastCacheSeen(attr))
+		return findJsonbObjectFieldCached(attr, key);
+
+	total = toast_raw_datum_size(jsonb) - VARHDRSZ;
+
+	container = fetchJsonbPrefix(attr, &prefix,
+								 offsetof(JsonbContainer, children), total);
+	count = JsonContainerSize(container);
+	if (!JsonContainerIsObject(container) || count == 0)
+	{
+		pfree(prefix);
+		return NULL;
+	}
+
+	/* Since this is an object, account for *Pairs* of Jentrys */
+	base = offsetof(JsonbContainer, children) + count * 2 * sizeof(JEntry);
+	container = fetchJsonbPrefix(attr, &prefix, base, total);
+	container = fetchJsonbPrefix(attr, &prefix,
+								 base + getJsonbOffset(container, count), total);
+
+	/* Binary search on object/pair keys *only* */
+	stopLow = 0;
+	stopHigh = count;
+	while (stopLow < stopHigh)
+	{
+		uint32		stopMiddle;
+		int			difference;
+		JsonbValue	candidate;
+
+		stopMiddle = stopLow + (stopHigh - stopLow) / 2;
+
+		candidate.type = jbvString;
+		candidate.val.string.val =
+			(char *) container + base + getJsonbOffset(container, stopMiddle);
+		candidate.val.string.len = getJsonbLength(container, stopMiddle);
+
+		difference = lengthCompareJsonbStringValue(&candidate, key);
+
+		if (difference == 0)
+		{
+			/* Found our key, fetch enough to include its value too */
+			int			index = stopMiddle + count;
+			JsonbValue *result;
+
+			container = fetchJsonbPrefix(attr, &prefix,
+										 base + getJsonbOffset(container, index) +
+										 getJsonbLength(container, index),
+										 total);
+
+			result = palloc(sizeof(JsonbValue));
+			fillJsonbValue(container, index, (char *) container + base,
+						   getJsonbOffset(container, index),
+						   result);
+
+			return result;
+		}
+		else
+		{
+			if (difference < 0)
+				stopLow = stopMiddle + 1;
+			else
+				stopHigh = stopMiddle;
+		}
+	}
+
+	/* Not found */
+	pfree(prefix);
+	return NULL;
+}
+
 /*
  * Get i-th value of a Jsonb array.
  *
@@ -263,7 +263,7 @@ static JsonbValue *wrapItemsInArray(const JsonValueList *items);
 Datum
 jsonb_path_exists(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Jsonb	   *jb = PG_GETARG_JSONB_P_CACHED(0);
 	JsonPath   *jp = PG_GETARG_JSONPATH_P(1);
 	JsonPathExecResult res;
 	Jsonb	   *vars = NULL;
@@ -277,7 +277,6 @@ jsonb_path_exists(PG_FUNCTION_ARGS)
 
 	res = executeJsonPath(jp, vars, jb, !silent, NULL);
 
-	PG_FREE_IF_COPY(jb, 0);
 	PG_FREE_IF_COPY(jp, 1);
 
 	if (jperIsError(res))
@@ -306,7 +305,7 @@ jsonb_path_exists_opr(PG_FUNCTION_ARGS)
 Datum
 jsonb_path_match(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Jsonb	   *jb = PG_GETARG_JSONB_P_CACHED(0);
 	JsonPath   *jp = PG_GETARG_JSONPATH_P(1);
 	JsonValueList found = {0};
 	Jsonb	   *vars = NULL;
@@ -320,7 +319,6 @@ jsonb_path_match(PG_FUNCTION_ARGS)
 
 	(void) executeJsonPath(jp, vars, jb, !silent, &found);
 
-	PG_FREE_IF_COPY(jb, 0);
 	PG_FREE_IF_COPY(jp, 1);
 
 	if (JsonValueListLength(&found) == 1)
@@ -413,7 +411,7 @@ jsonb_path_query(PG_FUNCTION_ARGS)
 Datum
 jsonb_path_query_array(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Jsonb	   *jb = PG_GETARG_JSONB_P_CACHED(0);
 	JsonPath   *jp = PG_GETARG_JSONPATH_P(1);
 	JsonValueList found = {0};
 	Jsonb	   *vars = PG_GETARG_JSONB_P(2);
@@ -432,7 +430,7 @@ jsonb_path_query_array(PG_FUNCTION_ARGS)
 Datum
 jsonb_path_query_first(PG_FUNCTION_ARGS)
 {
-	Jsonb	   *jb = PG_GETARG_JSONB_P(0);
+	Jsonb	   *jb = PG_GETARG_JSONB_P_CACHED(0);
 	JsonPath   *jp = PG_GETARG_JSONPATH_P(1);
 	JsonValueList found = {0};
 	Jsonb	   *vars = PG_GETARG_JSONB_P(2);
@@ -18,6 +18,7 @@
 #include "postgres.h"
 
 #include <ctype.h>
+#include <limits.h>
 
 #include "catalog/pg_collation.h"
 #include "mb/pg_wchar.h"
@@ -47,6 +48,7 @@ static int	SB_IMatchText(const char *t, int tlen, const char *p, int plen,
 
 static int	GenericMatchText(const char *s, int slen, const char *p, int plen, Oid collation);
 static int	Generic_Text_IC_like(text *str, text *pat, Oid collation);
+static text *like_detoast_text(Datum str, const char *p, int plen);
 
 /*--------------------
  * Support routine for MatchText. Compares given multibyte streams
@@ -126,6 +128,7 @@ SB_lower_char(unsigned char c, pg_locale_t locale, bool locale_is_c)
 #define NextChar(p, plen) NextByte((p), (plen))
 #define CopyAdvChar(dst, src, srclen) (*(dst)++ = *(src)++, (srclen)--)
 
+#define SEARCH_LITERAL
 #define MatchText	SB_MatchText
 #define do_like_escape	SB_do_like_escape
 
@@ -142,6 +145,8 @@ SB_lower_char(unsigned char c, pg_locale_t locale, bool locale_is_c)
 
 #define NextChar(p, plen) \
 	do { (p)++; (plen)--; } while ((plen) > 0 && (*(p) & 0xC0) == 0x80 )
+/* UTF8 lead bytes never appear inside a character, so memchr() is safe */
+#define SEARCH_LITERAL
 #define MatchText	UTF8_MatchText
 
 #include "like_match.c"
@@ -168,6 +173,71 @@ GenericMatchText(const char *s, int slen, const char *p, int plen, Oid collation
 		return MB_MatchText(s, slen, p, plen, 0, true);
 }
 
+/*
+ * Return the number of bytes at the start of a string that matching it
+ * against a LIKE pattern can look at, or -1 if the match may need the whole
+ * string.
+ *
+ * This is only known for patterns like 'foo%' or 'f_o%%', whose only
+ * wildcard '%' signs are at the end.  Matching stops as soon as it gets to
+ * them, and every pattern byte before them matches at most one character of
+ * the string.
+ */
+static int
+like_prefix_length(const char *p, int plen)
+{
+	int			n = 0;
+
+	while (plen > 0 && *p != '%')
+	{
+		if (*p == '\\')
+		{
+			/* leave an invalid trailing escape for the matcher to complain */
+			if (plen < 2)
+				return -1;
+			p++, plen--;
+		}
+		p++, plen--;
+		n++;
+	}
+
+	/* with no '%' at all, the match must reach the end of the string */
+	if (plen == 0)
+		return -1;
+
+	for (; plen > 0; p++, plen--)
+	{
+		if (*p != '%')
+			return -1;
+	}
+
+	if (n > INT_MAX / pg_database_encoding_max_length())
+		return -1;
+
+	return n * pg_database_encoding_max_length();
+}
+
+/*
+ * Detoast a string that is to be matched against a LIKE pattern.  If it is
+ * compressed or stored out of line, and the pattern only looks at a prefix
+ * of it, we only fetch and decompress that prefix.
+ */
+static text *
+like_detoast_text(Datum str, const char *p, int plen)
+{
+	struct varlena *s = (struct varlena *) DatumGetPointer(str);
+
+	if (VARATT_IS_COMPRESSED(s) || VARATT_IS_EXTERNAL(s))
+	{
+		int			prefixlen = like_prefix_length(p, plen);
+
+		if (prefixlen > 0)
+			return DatumGetTextPSlice(str, 0, prefixlen);
+	}
+
+	return DatumGetTextPP(str);
+}
+
 static inline int
 Generic_Text_IC_like(text *str, text *pat, Oid collation)
 {
@@ -283,18 +353,19 @@ namenlike(PG_FUNCTION_ARGS)
 Datum
 textlike(PG_FUNCTION_ARGS)
 {
-	text	   *str = PG_GETARG_TEXT_PP(0);
 	text	   *pat = PG_GETARG_TEXT_PP(1);
+	text	   *str;
 	bool		result;
 	char	   *s,
 			   *p;
 	int			slen,
 				plen;
 
-	s = VARDATA_ANY(str);
-	slen = VARSIZE_ANY_EXHDR(str);
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
+	str = like_detoast_text(PG_GETARG_DATUM(0), p, plen);
+	s = VARDATA_ANY(str);
+	slen = VARSIZE_ANY_EXHDR(str);
 
 	result = (GenericMatchText(s, slen, p, plen, PG_GET_COLLATION()) == LIKE_TRUE);
 
@@ -304,18 +375,19 @@ textlike(PG_FUNCTION_ARGS)
 Datum
 textnlike(PG_FUNCTION_ARGS)
 {
-	text	   *str = PG_GETARG_TEXT_PP(0);
 	text	   *pat = PG_GETARG_TEXT_PP(1);
+	text	   *str;
 	bool		result;
 	char	   *s,
 			   *p;
 	int			slen,
 				plen;
 
-	s = VARDATA_ANY(str);
-	slen = VARSIZE_ANY_EXHDR(str);
 	p = VARDATA_ANY(pat);
 	plen = VARSIZE_ANY_EXHDR(pat);
+	str = like_detoast_text(PG_GETARG_DATUM(0), p, plen);
+	s = VARDATA_ANY(str);
+	slen = VARSIZE_ANY_EXHDR(str);
 
 	result = (GenericMatchText(s, slen, p, plen, PG_GET_COLLATION()) != LIKE_TRUE);
 
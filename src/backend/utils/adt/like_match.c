@@ -15,6 +15,9 @@
  * MatchText - to name of function wanted
  * do_like_escape - name of function if wanted - needs CHAREQ and CopyAdvChar
  * MATCH_LOWER - define for case (4) to specify case folding for 1-byte chars
+ * SEARCH_LITERAL - define if any text byte equal to the first byte of a
+ *		pattern character is the start of a character, so that literal runs
+ *		in the pattern can be located with memchr() and memcmp()
  *
  * Copyright (c) 1996-2019, PostgreSQL Global Development Group
  *
@@ -150,6 +153,52 @@ MatchText(const char *t, int tlen, const char *p, int plen,
 			if (plen <= 0)
 				return LIKE_TRUE;
 
+#ifdef SEARCH_LITERAL
+
+			/*
+			 * If the rest of the pattern starts with a run of plain literal
+			 * bytes, as in '%error%', any match has to start with a copy of
+			 * that run.  Find the candidates with memchr(), which libc
+			 * implements with wide vector loads, and check the rest of the
+			 * run with memcmp() before recursing on what follows it.
+			 * Positions we skip would have returned LIKE_FALSE, or LIKE_ABORT
+			 * if the run hangs off the end of the text, so falling out of the
+			 * loop with LIKE_ABORT gives the same answer as the loop below.
+			 */
+			if (*p != '\\')
+			{
+				int			litlen = 1;
+
+				while (litlen < plen && p[litlen] != '%' &&
+					   p[litlen] != '_' && p[litlen] != '\\')
+					litlen++;
+
+				while (tlen >= litlen)
+				{
+					const char *hit = memchr(t, *p, tlen - litlen + 1);
+
+					if (hit == NULL)
+						break;
+					tlen -= hit - t;
+					t = hit;
+
+					if (memcmp(t, p, litlen) == 0)
+					{
+						int			matched = MatchText(t + litlen, tlen - litlen,
+														p + litlen, plen - litlen,
+														locale, locale_is_c);
+
+						if (matched != LIKE_FALSE)
+							return matched; /* TRUE or ABORT */
+					}
+
+					NextByte(t, tlen);
+				}
+
+				return LIKE_ABORT;
+			}
+#endif
+
 			/*
 			 * Otherwise, scan for a text position at which we can match the
 			 * rest of the pattern.  The first remaining pattern char is known
@@ -353,6 +402,10 @@ do_like_escape(text *pat, text *esc)
 
 #undef GETCHAR
 
+#ifdef SEARCH_LITERAL
+#undef SEARCH_LITERAL
+#endif
+
 #ifdef MATCH_LOWER
 #undef MATCH_LOWER
 
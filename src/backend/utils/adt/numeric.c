@@ -102,6 +102,23 @@ typedef signed char NumericDigit;
 typedef int16 NumericDigit;
 #endif
 
+/*
+ * Values are handled by the int128 fast paths for addition, subtraction,
+ * multiplication and aggregate sums when they need no more than
+ * NUMERIC_INT128_MAX_DIGITS NBASE digits at the chosen scale, i.e. stay
+ * below 10^32.  That leaves plenty of headroom below the int128 limit of
+ * about 1.7 * 10^38: a sum of two such values can't overflow, and aggregate
+ * partial sums are folded into the general accumulator once they exceed
+ * NUMERIC_INT128_SUM_LIMIT.  NUMERIC_INT128_BUF_DIGITS is enough NBASE
+ * digits for any int128.
+ */
+#ifdef HAVE_INT128
+#define NUMERIC_INT128_MAX_DIGITS	(32 / DEC_DIGITS)
+#define NUMERIC_INT128_BUF_DIGITS	(40 / DEC_DIGITS)
+#define NUMERIC_INT128_SUM_LIMIT \
+	((int128) INT64CONST(1000000000000000000) * INT64CONST(1000000000000000000))
+#endif
+
 /*
  * The Numeric type as stored on disk.
  *
@@ -485,6 +502,15 @@ static void int64_to_numericvar(int64 val, NumericVar *var);
 #ifdef HAVE_INT128
 static bool numericvar_to_int128(const NumericVar *var, int128 *result);
 static void int128_to_numericvar(int128 val, NumericVar *var);
+static int	numericvar_frac_digits(const NumericVar *var);
+static bool numericvar_to_scaled_int128(const NumericVar *var, int scale,
+										int maxdigits, int128 *result);
+static void scaled_int128_to_numericvar(int128 val, int scale, int dscale,
+										NumericVar *var, NumericDigit *digits);
+static Numeric numeric_addsub_int128(const NumericVar *var1,
+									 const NumericVar *var2, bool subtract);
+static Numeric numeric_mul_int128(const NumericVar *var1,
+								  const NumericVar *var2);
 #endif
 static double numeric_to_double_no_overflow(Numeric num);
 static double numericvar_to_double_no_overflow(const NumericVar *var);
@@ -492,7 +518,6 @@ static double numericvar_to_double_no_overflow(const NumericVar *var);
 static Datum numeric_abbrev_convert(Datum original_datum, SortSupport ssup);
 static bool numeric_abbrev_abort(int memtupcount, SortSupport ssup);
 static int	numeric_fast_cmp(Datum x, Datum y, SortSupport ssup);
-static int	numeric_cmp_abbrev(Datum x, Datum y, SortSupport ssup);
 
 static Datum numeric_abbrev_convert_var(const NumericVar *var,
 										NumericSortSupport *nss);
@@ -1630,10 +1655,13 @@ compute_bucket(Numeric operand, Numeric bound1, Numeric bound2,
  *
  * Two different representations are used for the abbreviated form, one in
  * int32 and one in int64, whichever fits into a by-value Datum.  In both cases
- * the representation is negated relative to the original value, because we use
- * the largest negative value for NaN, which sorts higher than other values. We
- * convert the absolute value of the numeric to a 31-bit or 63-bit positive
- * value, and then negate it if the original number was positive.
+ * the representation is first built negated relative to the original value,
+ * because we use the largest negative value for NaN, which sorts higher than
+ * other values. We convert the absolute value of the numeric to a 31-bit or
+ * 63-bit positive value, and then negate it if the original number was
+ * positive.  Finally the bits are complemented, which makes the abbreviation
+ * sort in the same order as the original values, so that the generic signed
+ * integer comparators (and the radix sort in tuplesort.c) can be used.
  *
  * We abort the abbreviation process if the abbreviation cardinality is below
  * 0.01% of the row count (1 per 10k non-null rows).  The actual break-even
@@ -1680,7 +1708,11 @@ numeric_sortsupport(PG_FUNCTION_ARGS)
 		ssup->ssup_extra = nss;
 
 		ssup->abbrev_full_comparator = ssup->comparator;
-		ssup->comparator = numeric_cmp_abbrev;
+#if NUMERIC_ABBREV_BITS == 64
+		ssup->comparator = ssup_datum_signed_cmp;
+#else
+		ssup->comparator = ssup_datum_int32_cmp;
+#endif
 		ssup->abbrev_converter = numeric_abbrev_convert;
 		ssup->abbrev_abort = numeric_abbrev_abort;
 
@@ -1736,6 +1768,9 @@ numeric_abbrev_convert(Datum original_datum, SortSupport ssup)
 		result = numeric_abbrev_convert_var(&var, nss);
 	}
 
+	/* complement, so that the abbreviation orders like the original value */
+	result = NumericAbbrevGetDatum(~DatumGetNumericAbbrev(result));
+
 	/* should happen only for external/compressed toasts */
 	if ((Pointer) original_varatt != DatumGetPointer(original_datum))
 		pfree(original_varatt);
@@ -1841,25 +1876,6 @@ numeric_fast_cmp(Datum x, Datum y, SortSupport ssup)
 	return result;
 }
 
-/*
- * Compare abbreviations of values. (Abbreviations may be equal where the true
- * values differ, but if the abbreviations differ, they must reflect the
- * ordering of the true values.)
- */
-static int
-numeric_cmp_abbrev(Datum x, Datum y, SortSupport ssup)
-{
-	/*
-	 * NOTE WELL: this is intentionally backwards, because the abbreviation is
-	 * negated relative to the original value, to handle NaN.
-	 */
-	if (DatumGetNumericAbbrev(x) < DatumGetNumericAbbrev(y))
-		return 1;
-	if (DatumGetNumericAbbrev(x) > DatumGetNumericAbbrev(y))
-		return -1;
-	return 0;
-}
-
 /*
  * Abbreviate a NumericVar according to the available bit size.
  *
@@ -2444,6 +2460,12 @@ numeric_add_opt_error(Numeric num1, Numeric num2, bool *have_error)
 	init_var_from_num(num1, &arg1);
 	init_var_from_num(num2, &arg2);
 
+#ifdef HAVE_INT128
+	/* Small enough values can be added without a digit-array temporary */
+	if ((res = numeric_addsub_int128(&arg1, &arg2, false)) != NULL)
+		return res;
+#endif
+
 	init_var(&result);
 	add_var(&arg1, &arg2, &result);
 
@@ -2500,6 +2522,11 @@ numeric_sub_opt_error(Numeric num1, Numeric num2, bool *have_error)
 	init_var_from_num(num1, &arg1);
 	init_var_from_num(num2, &arg2);
 
+#ifdef HAVE_INT128
+	if ((res = numeric_addsub_int128(&arg1, &arg2, true)) != NULL)
+		return res;
+#endif
+
 	init_var(&result);
 	sub_var(&arg1, &arg2, &result);
 
@@ -2560,6 +2587,11 @@ numeric_mul_opt_error(Numeric num1, Numeric num2, bool *have_error)
 	init_var_from_num(num1, &arg1);
 	init_var_from_num(num2, &arg2);
 
+#ifdef HAVE_INT128
+	if ((res = numeric_mul_int128(&arg1, &arg2)) != NULL)
+		return res;
+#endif
+
 	init_var(&result);
 	mul_var(&arg1, &arg2, &result, arg1.dscale + arg2.dscale);
 
@@ -3517,6 +3549,16 @@ typedef struct NumericAggState
 	int			maxScale;		/* maximum scale seen so far */
 	int64		maxScaleCount;	/* number of values seen with maximum scale */
 	int64		NaNcount;		/* count of NaN values (not included in N!) */
+#ifdef HAVE_INT128
+	/*
+	 * Inputs that fit are summed here as an integer scaled by
+	 * NBASE^fastScale rather than into sumX; the partial sum is folded into
+	 * sumX before anything reads it, see numeric_agg_flush_int128().
+	 */
+	int128		fastSumX;		/* scaled sum of fast-path inputs */
+	int			fastScale;		/* fractional NBASE digits in fastSumX */
+	int64		fastCount;		/* inputs in fastSumX since last flush */
+#endif
 } NumericAggState;
 
 /*
@@ -3560,6 +3602,72 @@ makeNumericAggStateCurrentContext(bool calcSumX2)
 	return state;
 }
 
+#ifdef HAVE_INT128
+/*
+ * Move the 128-bit partial sum into sumX.
+ *
+ * Every input had a dscale of at most maxScale, so that is the right dscale
+ * for their sum, too.
+ */
+static void
+numeric_agg_flush_int128(NumericAggState *state)
+{
+	NumericVar	X;
+	NumericDigit digits[NUMERIC_INT128_BUF_DIGITS];
+	MemoryContext old_context;
+
+	if (state->fastCount == 0)
+		return;
+
+	scaled_int128_to_numericvar(state->fastSumX, state->fastScale,
+								state->maxScale, &X, digits);
+
+	old_context = MemoryContextSwitchTo(state->agg_context);
+	accum_sum_add(&state->sumX, &X);
+	MemoryContextSwitchTo(old_context);
+
+	state->fastSumX = 0;
+	state->fastCount = 0;
+}
+
+/*
+ * Add X to the state's 128-bit partial sum, if it fits there.
+ *
+ * The partial sum's scale only ever grows; an input with more fractional
+ * digits than it allows forces a flush, after which the scale is raised.
+ * Returns false if the input must be added to sumX the slow way.
+ */
+static bool
+numeric_agg_accum_int128(NumericAggState *state, const NumericVar *X)
+{
+	int			frac = numericvar_frac_digits(X);
+	int128		val;
+
+	if (frac > state->fastScale)
+	{
+		/* leave at least half the digits for the integer part */
+		if (frac > NUMERIC_INT128_MAX_DIGITS / 2)
+			return false;
+		numeric_agg_flush_int128(state);
+		state->fastScale = frac;
+	}
+
+	if (!numericvar_to_scaled_int128(X, state->fastScale,
+									 NUMERIC_INT128_MAX_DIGITS, &val))
+		return false;
+
+	/* fold the partial sum into sumX long before it could overflow */
+	if (state->fastSumX > NUMERIC_INT128_SUM_LIMIT ||
+		state->fastSumX < -NUMERIC_INT128_SUM_LIMIT)
+		numeric_agg_flush_int128(state);
+
+	state->fastSumX += val;
+	state->fastCount++;
+
+	return true;
+}
+#endif							/* HAVE_INT128 */
+
 /*
  * Accumulate a new input value for numeric aggregate functions.
  */
@@ -3605,7 +3713,12 @@ do_numeric_accum(NumericAggState *state, Numeric newval)
 	state->N++;
 
 	/* Accumulate sums */
+#ifdef HAVE_INT128
+	if (!numeric_agg_accum_int128(state, &X))
+		accum_sum_add(&(state->sumX), &X);
+#else
 	accum_sum_add(&(state->sumX), &X);
+#endif
 
 	if (state->calcSumX2)
 		accum_sum_add(&(state->sumX2), &X2);
@@ -3645,6 +3758,10 @@ do_numeric_discard(NumericAggState *state, Numeric newval)
 	/* load processed number in short-lived context */
 	init_var_from_num(newval, &X);
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state);
+#endif
+
 	/*
 	 * state->sumX's dscale is the maximum dscale of any of the inputs.
 	 * Removing the last input with that dscale would require us to recompute
@@ -3753,6 +3870,10 @@ numeric_combine(PG_FUNCTION_ARGS)
 	if (state2 == NULL)
 		PG_RETURN_POINTER(state1);
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state2);
+#endif
+
 	/* manually copy all fields from state2 to state1 */
 	if (state1 == NULL)
 	{
@@ -3841,6 +3962,10 @@ numeric_avg_combine(PG_FUNCTION_ARGS)
 	if (state2 == NULL)
 		PG_RETURN_POINTER(state1);
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state2);
+#endif
+
 	/* manually copy all fields from state2 to state1 */
 	if (state1 == NULL)
 	{
@@ -3908,6 +4033,10 @@ numeric_avg_serialize(PG_FUNCTION_ARGS)
 
 	state = (NumericAggState *) PG_GETARG_POINTER(0);
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state);
+#endif
+
 	/*
 	 * This is a little wasteful since make_result converts the NumericVar
 	 * into a Numeric and numeric_send converts it back again. Is it worth
@@ -4021,6 +4150,10 @@ numeric_serialize(PG_FUNCTION_ARGS)
 
 	state = (NumericAggState *) PG_GETARG_POINTER(0);
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state);
+#endif
+
 	/*
 	 * This is a little wasteful since make_result converts the NumericVar
 	 * into a Numeric and numeric_send converts it back again. Is it worth
@@ -4922,6 +5055,10 @@ numeric_avg(PG_FUNCTION_ARGS)
 	if (state->NaNcount > 0)	/* there was at least one NaN input */
 		PG_RETURN_NUMERIC(make_result(&const_nan));
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state);
+#endif
+
 	N_datum = DirectFunctionCall1(int8_numeric, Int64GetDatum(state->N));
 
 	init_var(&sumX_var);
@@ -4948,6 +5085,10 @@ numeric_sum(PG_FUNCTION_ARGS)
 	if (state->NaNcount > 0)	/* there was at least one NaN input */
 		PG_RETURN_NUMERIC(make_result(&const_nan));
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state);
+#endif
+
 	init_var(&sumX_var);
 	accum_sum_final(&state->sumX, &sumX_var);
 	result = make_result(&sumX_var);
@@ -4992,6 +5133,10 @@ numeric_stddev_internal(NumericAggState *state,
 	if (state->NaNcount > 0)
 		return make_result(&const_nan);
 
+#ifdef HAVE_INT128
+	numeric_agg_flush_int128(state);
+#endif
+
 	init_var(&vN);
 	init_var(&vsumX);
 	init_var(&vsumX2);
@@ -6659,6 +6804,173 @@ int128_to_numericvar(int128 val, NumericVar *var)
 	var->ndigits = ndigits;
 	var->weight = ndigits - 1;
 }
+
+/*
+ * Number of NBASE digits after the decimal point in var's digit array.
+ */
+static int
+numericvar_frac_digits(const NumericVar *var)
+{
+	if (var->ndigits == 0)
+		return 0;
+	return Max(var->ndigits - 1 - var->weight, 0);
+}
+
+/*
+ * Convert var to an integer scaled by NBASE^scale.
+ *
+ * Fails, returning false, if var has more than scale fractional NBASE
+ * digits, or if the scaled value would need more than maxdigits NBASE
+ * digits.
+ */
+static bool
+numericvar_to_scaled_int128(const NumericVar *var, int scale, int maxdigits,
+							int128 *result)
+{
+	int128		val = 0;
+	int			i;
+
+	if (var->ndigits == 0)
+	{
+		*result = 0;
+		return true;
+	}
+
+	if (numericvar_frac_digits(var) > scale ||
+		var->weight + 1 + scale > maxdigits)
+		return false;
+
+	for (i = 0; i < var->ndigits; i++)
+		val = val * NBASE + var->digits[i];
+
+	/* move the last digit to position -scale */
+	for (i = var->ndigits - 1 - var->weight; i < scale; i++)
+		val *= NBASE;
+
+	*result = (var->sign == NUMERIC_NEG) ? -val : val;
+	return true;
+}
+
+/*
+ * Convert an integer scaled by NBASE^scale back to a NumericVar.
+ *
+ * The digits are built in the caller-supplied array, which must have room
+ * for NUMERIC_INT128_BUF_DIGITS digits, so that no palloc is needed; var
+ * must not be passed to free_var() or otherwise modified in place.
+ */
+static void
+scaled_int128_to_numericvar(int128 val, int scale, int dscale,
+							NumericVar *var, NumericDigit *digits)
+{
+	uint128		uval;
+	uint64		uval64;
+	NumericDigit *ptr = digits + NUMERIC_INT128_BUF_DIGITS;
+	int			ndigits = 0;
+
+	var->buf = NULL;
+	var->dscale = dscale;
+	if (val < 0)
+	{
+		var->sign = NUMERIC_NEG;
+		uval = -(uint128) val;
+	}
+	else
+	{
+		var->sign = NUMERIC_POS;
+		uval = val;
+	}
+
+	/* 128-bit division is slow, so only use it for the high digits */
+	while (uval > PG_UINT64_MAX)
+	{
+		uint128		newuval = uval / NBASE;
+
+		*--ptr = uval - newuval * NBASE;
+		ndigits++;
+		uval = newuval;
+	}
+	uval64 = (uint64) uval;
+	while (uval64)
+	{
+		uint64		newuval = uval64 / NBASE;
+
+		*--ptr = uval64 - newuval * NBASE;
+		ndigits++;
+		uval64 = newuval;
+	}
+
+	var->digits = ptr;
+	var->ndigits = ndigits;
+	if (ndigits == 0)
+	{
+		var->sign = NUMERIC_POS;
+		var->weight = 0;
+	}
+	else
+		var->weight = ndigits - 1 - scale;
+}
+
+/*
+ * Add or subtract two numerics as scaled 128-bit integers.
+ *
+ * Returns NULL if either value is too large or has too many fractional
+ * digits, in which case the caller must use add_var()/sub_var().  The
+ * result is the same as theirs: its dscale is the larger input dscale.
+ */
+static Numeric
+numeric_addsub_int128(const NumericVar *var1, const NumericVar *var2,
+					  bool subtract)
+{
+	int			scale = Max(numericvar_frac_digits(var1),
+							numericvar_frac_digits(var2));
+	int128		val1,
+				val2;
+	NumericVar	result;
+	NumericDigit digits[NUMERIC_INT128_BUF_DIGITS];
+
+	if (!numericvar_to_scaled_int128(var1, scale, NUMERIC_INT128_MAX_DIGITS,
+									 &val1) ||
+		!numericvar_to_scaled_int128(var2, scale, NUMERIC_INT128_MAX_DIGITS,
+									 &val2))
+		return NULL;
+
+	scaled_int128_to_numericvar(subtract ? val1 - val2 : val1 + val2, scale,
+								Max(var1->dscale, var2->dscale),
+								&result, digits);
+
+	return make_result(&result);
+}
+
+/*
+ * Multiply two numerics as scaled 128-bit integers.
+ *
+ * Each input may use only half the digits the add/subtract path allows, so
+ * that the product fits.  Like numeric_mul(), the result is exact, with
+ * dscale the sum of the input dscales.  Returns NULL if the inputs don't
+ * qualify.
+ */
+static Numeric
+numeric_mul_int128(const NumericVar *var1, const NumericVar *var2)
+{
+	int			scale1 = numericvar_frac_digits(var1);
+	int			scale2 = numericvar_frac_digits(var2);
+	int128		val1,
+				val2;
+	NumericVar	result;
+	NumericDigit digits[NUMERIC_INT128_BUF_DIGITS];
+
+	if (!numericvar_to_scaled_int128(var1, scale1,
+									 NUMERIC_INT128_MAX_DIGITS / 2, &val1) ||
+		!numericvar_to_scaled_int128(var2, scale2,
+									 NUMERIC_INT128_MAX_DIGITS / 2, &val2))
+		return NULL;
+
+	scaled_int128_to_numericvar(val1 * val2, scale1 + scale2,
+								var1->dscale + var2->dscale,
+								&result, digits);
+
+	return make_result(&result);
+}
 #endif
 
 /*
@@ -33,9 +33,6 @@
 
 #define UINT32_ACCESS_ONCE(var)		 ((uint32)(*((volatile uint32 *)&(var))))
 
-/* Global bgwriter statistics, from bgwriter.c */
-extern PgStat_MsgBgWriter bgwriterStats;
-
 Datum
 pg_stat_get_numscans(PG_FUNCTION_ARGS)
 {
@@ -84,6 +81,22 @@ pg_stat_get_tuples_fetched(PG_FUNCTION_ARGS)
 }
 
 
+Datum
+pg_stat_get_heap_fetches(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int64		result;
+	PgStat_StatTabEntry *tabentry;
+
+	if ((tabentry = pgstat_fetch_stat_tabentry(relid)) == NULL)
+		result = 0;
+	else
+		result = (int64) (tabentry->heap_fetches);
+
+	PG_RETURN_INT64(result);
+}
+
+
 Datum
 pg_stat_get_tuples_inserted(PG_FUNCTION_ARGS)
 {
@@ -546,7 +559,7 @@ pg_stat_get_progress_info(PG_FUNCTION_ARGS)
 Datum
 pg_stat_get_activity(PG_FUNCTION_ARGS)
 {
-#define PG_STAT_GET_ACTIVITY_COLS	29
+#define PG_STAT_GET_ACTIVITY_COLS	38
 	int			num_backends = pgstat_fetch_stat_numbackends();
 	int			curr_backend;
 	int			pid = PG_ARGISNULL(0) ? -1 : PG_GETARG_INT32(0);
@@ -650,6 +663,11 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 		else
 			nulls[16] = true;
 
+		if (beentry->st_numa_node >= 0)
+			values[37] = Int32GetDatum(beentry->st_numa_node);
+		else
+			nulls[37] = true;
+
 		/* Values only available to role member or pg_read_all_stats */
 		if (has_privs_of_role(GetUserId(), beentry->st_userid) ||
 			is_member_of_role(GetUserId(), DEFAULT_ROLE_READ_ALL_STATS))
@@ -875,6 +893,25 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 				values[28] = BoolGetDatum(false);	/* GSS Encryption not in
 													 * use */
 			}
+
+			/* Protocol compression information */
+			if (beentry->st_compression)
+			{
+				PgBackendCompressionStatus *cstatus = &beentry->st_compressionstatus;
+
+				values[29] = CStringGetTextDatum(cstatus->compression_algorithm);
+				values[30] = Int64GetDatum(cstatus->raw_bytes_sent);
+				values[31] = Int64GetDatum(cstatus->compressed_bytes_sent);
+				values[32] = Int64GetDatum(cstatus->raw_bytes_received);
+				values[33] = Int64GetDatum(cstatus->compressed_bytes_received);
+			}
+			else
+				nulls[29] = nulls[30] = nulls[31] = nulls[32] = nulls[33] = true;
+
+			/* WAL usage */
+			values[34] = Int64GetDatum(beentry->st_wal_records);
+			values[35] = Int64GetDatum(beentry->st_wal_fpi);
+			values[36] = Int64GetDatum((int64) beentry->st_wal_bytes);
 		}
 		else
 		{
@@ -902,6 +939,14 @@ pg_stat_get_activity(PG_FUNCTION_ARGS)
 			nulls[26] = true;
 			nulls[27] = true;
 			nulls[28] = true;
+			nulls[29] = true;
+			nulls[30] = true;
+			nulls[31] = true;
+			nulls[32] = true;
+			nulls[33] = true;
+			nulls[34] = true;
+			nulls[35] = true;
+			nulls[36] = true;
 		}
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -1520,6 +1565,36 @@ pg_stat_get_db_deadlocks(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(result);
 }
 
+Datum
+pg_stat_get_db_fastpath_overflows(PG_FUNCTION_ARGS)
+{
+	Oid			dbid = PG_GETARG_OID(0);
+	int64		result;
+	PgStat_StatDBEntry *dbentry;
+
+	if ((dbentry = pgstat_fetch_stat_dbentry(dbid)) == NULL)
+		result = 0;
+	else
+		result = (int64) (dbentry->n_fastpath_overflows);
+
+	PG_RETURN_INT64(result);
+}
+
+Datum
+pg_stat_get_db_suboverflowed_snapshots(PG_FUNCTION_ARGS)
+{
+	Oid			dbid = PG_GETARG_OID(0);
+	int64		result;
+	PgStat_StatDBEntry *dbentry;
+
+	if ((dbentry = pgstat_fetch_stat_dbentry(dbid)) == NULL)
+		result = 0;
+	else
+		result = (int64) (dbentry->n_suboverflowed_snapshots);
+
+	PG_RETURN_INT64(result);
+}
+
 Datum
 pg_stat_get_db_checksum_failures(PG_FUNCTION_ARGS)
 {
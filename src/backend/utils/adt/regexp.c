@@ -29,12 +29,16 @@
  */
 #include "postgres.h"
 
+#include <ctype.h>
+
 #include "catalog/pg_type.h"
 #include "funcapi.h"
+#include "lib/ilist.h"
 #include "miscadmin.h"
 #include "regex/regex.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/hashutils.h"
 #include "utils/memutils.h"
 #include "utils/varlena.h"
 
@@ -68,46 +72,43 @@ typedef struct regexp_matches_ctx
 } regexp_matches_ctx;
 
 /*
- * We cache precompiled regular expressions using a "self organizing list"
- * structure, in which recently-used items tend to be near the front.
- * Whenever we use an entry, it's moved up to the front of the list.
- * Over time, an item's average position corresponds to its frequency of use.
- *
- * When we first create an entry, it's inserted at the front of
- * the array, dropping the entry at the end of the array if necessary to
- * make room.  (This might seem to be weighting the new entry too heavily,
- * but if we insert new entries further back, we'll be unable to adjust to
- * a sudden shift in the query mix where we are presented with MAX_CACHED_RES
- * never-before-seen items used circularly.  We ought to be able to handle
- * that case, so we have to insert at the front.)
+ * We cache precompiled regular expressions in a list kept in
+ * least-recently-used order: whenever we use an entry, it's moved to the
+ * front of the list, and when the cache is full the entry at the back is
+ * discarded to make room for a new one.  A reusable pattern is thus
+ * guaranteed to stay in the cache as long as it's used at least once in
+ * every regex_cache_size uses.
  *
- * Knuth mentions a variant strategy in which a used item is moved up just
- * one place in the list.  Although he says this uses fewer comparisons on
- * average, it seems not to adapt very well to the situation where you have
- * both some reusable patterns and a steady stream of non-reusable patterns.
- * A reusable pattern that isn't used at least as often as non-reusable
- * patterns are seen will "fail to keep up" and will drop off the end of the
- * cache.  With move-to-front, a reusable pattern is guaranteed to stay in
- * the cache as long as it's used at least once in every MAX_CACHED_RES uses.
+ * Workloads can use hundreds of distinct patterns, so lookups go through a
+ * small hash table rather than scanning the list.  Entries are malloc'd
+ * because they have to persist across transactions, and because we want to
+ * get control back on out-of-memory.
  */
 
-/* this is the maximum number of cached regular expressions */
-#ifndef MAX_CACHED_RES
-#define MAX_CACHED_RES	32
-#endif
+/* GUC parameter: maximum number of cached regular expressions */
+int			regex_cache_size = 128;
+
+/* number of hash buckets; must be a power of 2 */
+#define RE_CACHE_BUCKETS	256
 
 /* this structure describes one cached regular expression */
 typedef struct cached_re_str
 {
+	dlist_node	cre_lru;		/* link in LRU list, most recent first */
+	struct cached_re_str *cre_next; /* next entry in same hash bucket */
+	uint32		cre_hash;		/* hash of pattern, flags and collation */
 	char	   *cre_pat;		/* original RE (not null terminated!) */
 	int			cre_pat_len;	/* length of original RE, in bytes */
 	int			cre_flags;		/* compile flags: extended,icase etc */
 	Oid			cre_collation;	/* collation to use */
+	char	   *cre_must;		/* literal every match contains, or NULL */
+	int			cre_must_len;	/* length of cre_must, in bytes */
 	regex_t		cre_re;			/* the compiled regular expression */
 } cached_re_str;
 
 static int	num_res = 0;		/* # of cached re's */
-static cached_re_str re_array[MAX_CACHED_RES];	/* cached re's */
+static dlist_head re_lru = DLIST_STATIC_INIT(re_lru);
+static cached_re_str *re_buckets[RE_CACHE_BUCKETS];
 
 
 /* Local functions */
@@ -122,52 +123,227 @@ static Datum build_regexp_split_result(regexp_matches_ctx *splitctx);
 
 
 /*
- * RE_compile_and_cache - compile a RE, caching if possible
- *
- * Returns regex_t *
+ * RE_required_literal - find a literal string every match of a RE contains
  *
- *	text_re --- the pattern, expressed as a TEXT object
- *	cflags --- compile options for the pattern
- *	collation --- collation to use for LC_CTYPE-dependent behavior
+ * Returns a pointer into the pattern and sets *litlen, or returns NULL if we
+ * can't tell.  This is deliberately conservative: it only looks at the
+ * top level of patterns without alternation, skipping over groups, bracket
+ * expressions, escapes and anything a quantifier applies to, and returns the
+ * longest run of ordinary characters left over.  Since such characters
+ * match only themselves, a string that doesn't contain the run as a byte
+ * sequence can't match the pattern.
+ */
+static const char *
+RE_required_literal(const char *pat, int len, int cflags, int *litlen)
+{
+	const char *end = pat + len;
+	const char *p = pat;
+	const char *run = NULL;
+	const char *best = NULL;
+	int			runlen = 0;
+	int			bestlen = 0;
+	int			depth = 0;
+
+	*litlen = 0;
+
+	if (cflags & (REG_ICASE | REG_EXPANDED))
+		return NULL;
+	if (cflags & REG_QUOTE)
+	{
+		*litlen = len;
+		return len > 0 ? pat : NULL;
+	}
+	if ((cflags & REG_EXTENDED) == 0)
+		return NULL;
+
+	/* directors and embedded options can change the syntax */
+	if ((len >= 3 && strncmp(pat, "***", 3) == 0) ||
+		(len >= 2 && strncmp(pat, "(?", 2) == 0))
+		return NULL;
+
+	while (p < end)
+	{
+		int			clen = pg_mblen(p);
+		bool		literal = false;
+
+		switch (*p)
+		{
+			case '|':
+				if (depth == 0)
+					return NULL;
+				p++;
+				break;
+			case '(':
+				depth++;
+				p++;
+				break;
+			case ')':
+				if (--depth < 0)
+					return NULL;
+				p++;
+				break;
+			case '\\':
+				p++;
+				if (p >= end || *p == 'c')
+					return NULL;
+				/* \d, \x41, \u00e9, \1 and the like: skip the whole escape */
+				if (isalnum((unsigned char) *p))
+				{
+					while (p < end && isalnum((unsigned char) *p))
+						p++;
+				}
+				else
+					p += pg_mblen(p);
+				break;
+			case '[':
+				/* skip a bracket expression, including [:class:] and kin */
+				p++;
+				if (p < end && *p == '^')
+					p++;
+				if (p < end && *p == ']')
+					p++;
+				while (p < end && *p != ']')
+				{
+					if (*p == '[' && p + 1 < end &&
+						(p[1] == ':' || p[1] == '.' || p[1] == '='))
+					{
+						char		delim = p[1];
+
+						p += 2;
+						while (p + 1 < end && !(p[0] == delim && p[1] == ']'))
+							p++;
+						if (p + 1 >= end)
+							return NULL;
+						p += 2;
+					}
+					else
+						p += pg_mblen(p);
+				}
+				if (p >= end)
+					return NULL;
+				p++;
+				break;
+			case '{':
+				/* skip a bound; the atom it applies to is already dropped */
+				while (p < end && *p != '}')
+					p++;
+				if (p >= end)
+					return NULL;
+				p++;
+				break;
+			case '*':
+			case '+':
+			case '?':
+			case '.':
+			case '^':
+			case '$':
+				p++;
+				break;
+			default:
+				/* an ordinary character, unless a quantifier follows it */
+				if (p + clen > end)
+					return NULL;
+				if (depth == 0 &&
+					(p + clen >= end ||
+					 (p[clen] != '*' && p[clen] != '+' &&
+					  p[clen] != '?' && p[clen] != '{')))
+					literal = true;
+				p += clen;
+				break;
+		}
+
+		if (literal)
+		{
+			if (run == NULL)
+				run = p - clen;
+			runlen += clen;
+		}
+		else if (run != NULL)
+		{
+			if (runlen > bestlen)
+			{
+				best = run;
+				bestlen = runlen;
+			}
+			run = NULL;
+			runlen = 0;
+		}
+	}
+
+	if (depth != 0)
+		return NULL;
+	if (run != NULL && runlen > bestlen)
+	{
+		best = run;
+		bestlen = runlen;
+	}
+
+	*litlen = bestlen;
+	return best;
+}
+
+/*
+ * Remove an entry from the cache and release it.
+ */
+static void
+RE_cache_evict(cached_re_str *cre)
+{
+	cached_re_str **prev = &re_buckets[cre->cre_hash & (RE_CACHE_BUCKETS - 1)];
+
+	while (*prev != cre)
+		prev = &(*prev)->cre_next;
+	*prev = cre->cre_next;
+
+	dlist_delete(&cre->cre_lru);
+	pg_regfree(&cre->cre_re);
+	free(cre);
+	num_res--;
+}
+
+/*
+ * RE_compile_and_cache_entry - compile a RE, caching if possible
  *
- * Pattern is given in the database encoding.  We internally convert to
- * an array of pg_wchar, which is what Spencer's regex package wants.
+ * Like RE_compile_and_cache, but returns the whole cache entry.
  */
-regex_t *
-RE_compile_and_cache(text *text_re, int cflags, Oid collation)
+static cached_re_str *
+RE_compile_and_cache_entry(text *text_re, int cflags, Oid collation)
 {
 	int			text_re_len = VARSIZE_ANY_EXHDR(text_re);
 	char	   *text_re_val = VARDATA_ANY(text_re);
 	pg_wchar   *pattern;
 	int			pattern_len;
-	int			i;
+	uint32		hash;
 	int			regcomp_result;
-	cached_re_str re_temp;
+	cached_re_str *cre;
+	regex_t		re_temp;
+	const char *must;
+	int			must_len;
 	char		errMsg[100];
 
+	hash = DatumGetUInt32(hash_any((unsigned char *) text_re_val,
+								   text_re_len));
+	hash = hash_combine(hash, (uint32) cflags);
+	hash = hash_combine(hash, (uint32) collation);
+
 	/*
-	 * Look for a match among previously compiled REs.  Since the data
-	 * structure is self-organizing with most-used entries at the front, our
-	 * search strategy can just be to scan from the front.
+	 * Look for a match among previously compiled REs.
 	 */
-	for (i = 0; i < num_res; i++)
+	for (cre = re_buckets[hash & (RE_CACHE_BUCKETS - 1)];
+		 cre != NULL;
+		 cre = cre->cre_next)
 	{
-		if (re_array[i].cre_pat_len == text_re_len &&
-			re_array[i].cre_flags == cflags &&
-			re_array[i].cre_collation == collation &&
-			memcmp(re_array[i].cre_pat, text_re_val, text_re_len) == 0)
+		if (cre->cre_hash == hash &&
+			cre->cre_pat_len == text_re_len &&
+			cre->cre_flags == cflags &&
+			cre->cre_collation == collation &&
+			memcmp(cre->cre_pat, text_re_val, text_re_len) == 0)
 		{
 			/*
 			 * Found a match; move it to front if not there already.
 			 */
-			if (i > 0)
-			{
-				re_temp = re_array[i];
-				memmove(&re_array[1], &re_array[0], i * sizeof(cached_re_str));
-				re_array[0] = re_temp;
-			}
+			dlist_move_head(&re_lru, &cre->cre_lru);
 
-			return &re_array[0].cre_re;
+			return cre;
 		}
 	}
 
@@ -182,7 +358,7 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 									   pattern,
 									   text_re_len);
 
-	regcomp_result = pg_regcomp(&re_temp.cre_re,
+	regcomp_result = pg_regcomp(&re_temp,
 								pattern,
 								pattern_len,
 								cflags,
@@ -202,50 +378,96 @@ RE_compile_and_cache(text *text_re, int cflags, Oid collation)
 		 */
 		CHECK_FOR_INTERRUPTS();
 
-		pg_regerror(regcomp_result, &re_temp.cre_re, errMsg, sizeof(errMsg));
+		pg_regerror(regcomp_result, &re_temp, errMsg, sizeof(errMsg));
 		ereport(ERROR,
 				(errcode(ERRCODE_INVALID_REGULAR_EXPRESSION),
 				 errmsg("invalid regular expression: %s", errMsg)));
 	}
 
-	/*
-	 * We use malloc/free for the cre_pat field because the storage has to
-	 * persist across transactions, and because we want to get control back on
-	 * out-of-memory.  The Max() is because some malloc implementations return
-	 * NULL for malloc(0).
-	 */
-	re_temp.cre_pat = malloc(Max(text_re_len, 1));
-	if (re_temp.cre_pat == NULL)
+	must = RE_required_literal(text_re_val, text_re_len, cflags, &must_len);
+
+	/* The pattern and required literal are stored right after the entry */
+	cre = malloc(sizeof(cached_re_str) + text_re_len + must_len);
+	if (cre == NULL)
 	{
-		pg_regfree(&re_temp.cre_re);
+		pg_regfree(&re_temp);
 		ereport(ERROR,
 				(errcode(ERRCODE_OUT_OF_MEMORY),
 				 errmsg("out of memory")));
 	}
-	memcpy(re_temp.cre_pat, text_re_val, text_re_len);
-	re_temp.cre_pat_len = text_re_len;
-	re_temp.cre_flags = cflags;
-	re_temp.cre_collation = collation;
-
-	/*
-	 * Okay, we have a valid new item in re_temp; insert it into the storage
-	 * array.  Discard last entry if needed.
-	 */
-	if (num_res >= MAX_CACHED_RES)
+	cre->cre_hash = hash;
+	cre->cre_pat = (char *) cre + sizeof(cached_re_str);
+	memcpy(cre->cre_pat, text_re_val, text_re_len);
+	cre->cre_pat_len = text_re_len;
+	cre->cre_flags = cflags;
+	cre->cre_collation = collation;
+	if (must != NULL)
 	{
-		--num_res;
-		Assert(num_res < MAX_CACHED_RES);
-		pg_regfree(&re_array[num_res].cre_re);
-		free(re_array[num_res].cre_pat);
+		cre->cre_must = cre->cre_pat + text_re_len;
+		memcpy(cre->cre_must, must, must_len);
 	}
+	else
+		cre->cre_must = NULL;
+	cre->cre_must_len = must_len;
+	cre->cre_re = re_temp;
 
-	if (num_res > 0)
-		memmove(&re_array[1], &re_array[0], num_res * sizeof(cached_re_str));
+	/*
+	 * Okay, we have a valid new entry; discard the least recently used ones
+	 * if needed, then link it in at the front.
+	 */
+	while (num_res >= regex_cache_size && !dlist_is_empty(&re_lru))
+		RE_cache_evict(dlist_tail_element(cached_re_str, cre_lru, &re_lru));
 
-	re_array[0] = re_temp;
+	cre->cre_next = re_buckets[hash & (RE_CACHE_BUCKETS - 1)];
+	re_buckets[hash & (RE_CACHE_BUCKETS - 1)] = cre;
+	dlist_push_head(&re_lru, &cre->cre_lru);
 	num_res++;
 
-	return &re_array[0].cre_re;
+	return cre;
+}
+
+/*
+ * RE_compile_and_cache - compile a RE, caching if possible
+ *
+ * Returns regex_t *
+ *
+ *	text_re --- the pattern, expressed as a TEXT object
+ *	cflags --- compile options for the pattern
+ *	collation --- collation to use for LC_CTYPE-dependent behavior
+ *
+ * Pattern is given in the database encoding.  We internally convert to
+ * an array of pg_wchar, which is what Spencer's regex package wants.
+ *
+ * The result stays valid until regex_cache_size other patterns have been
+ * compiled.
+ */
+regex_t *
+RE_compile_and_cache(text *text_re, int cflags, Oid collation)
+{
+	return &RE_compile_and_cache_entry(text_re, cflags, collation)->cre_re;
+}
+
+/*
+ * RE_contains_literal - does the data contain the given byte string?
+ */
+static bool
+RE_contains_literal(const char *dat, int dat_len, const char *lit, int lit_len)
+{
+	while (dat_len >= lit_len)
+	{
+		const char *hit = memchr(dat, lit[0], dat_len - lit_len + 1);
+
+		if (hit == NULL)
+			return false;
+		dat_len -= hit - dat;
+		dat = hit;
+		if (memcmp(dat, lit, lit_len) == 0)
+			return true;
+		dat++;
+		dat_len--;
+	}
+
+	return false;
 }
 
 /*
@@ -344,12 +566,20 @@ RE_compile_and_execute(text *text_re, char *dat, int dat_len,
 					   int cflags, Oid collation,
 					   int nmatch, regmatch_t *pmatch)
 {
-	regex_t    *re;
+	cached_re_str *cre;
 
 	/* Compile RE */
-	re = RE_compile_and_cache(text_re, cflags, collation);
+	cre = RE_compile_and_cache_entry(text_re, cflags, collation);
+
+	/*
+	 * Skip the regex engine, and converting the data to wide characters,
+	 * if the data lacks a literal every match must contain.
+	 */
+	if (cre->cre_must != NULL &&
+		!RE_contains_literal(dat, dat_len, cre->cre_must, cre->cre_must_len))
+		return false;
 
-	return RE_execute(re, dat, dat_len, nmatch, pmatch);
+	return RE_execute(&cre->cre_re, dat, dat_len, nmatch, pmatch);
 }
 
 
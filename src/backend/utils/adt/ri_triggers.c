@@ -23,11 +23,14 @@
 
 #include "postgres.h"
 
+#include "access/genam.h"
 #include "access/htup_details.h"
+#include "access/stratnum.h"
 #include "access/sysattr.h"
 #include "access/table.h"
 #include "access/tableam.h"
 #include "access/xact.h"
+#include "catalog/pg_am.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_constraint.h"
 #include "catalog/pg_operator.h"
@@ -106,6 +109,7 @@ typedef struct RI_ConstraintInfo
 	NameData	conname;		/* name of the FK constraint */
 	Oid			pk_relid;		/* referenced relation */
 	Oid			fk_relid;		/* referencing relation */
+	Oid			conindid;		/* index supporting the referenced key */
 	char		confupdtype;	/* foreign key's ON UPDATE action */
 	char		confdeltype;	/* foreign key's ON DELETE action */
 	char		confmatchtype;	/* foreign key's match type */
@@ -211,6 +215,9 @@ static const RI_ConstraintInfo *ri_LoadConstraintInfo(Oid constraintOid);
 static SPIPlanPtr ri_PlanCheck(const char *querystr, int nargs, Oid *argtypes,
 							   RI_QueryKey *qkey, Relation fk_rel, Relation pk_rel,
 							   bool cache_plan);
+static bool ri_FastPathCheck(const RI_ConstraintInfo *riinfo,
+							 Relation fk_rel, Relation pk_rel,
+							 TupleTableSlot *newslot);
 static bool ri_PerformCheck(const RI_ConstraintInfo *riinfo,
 							RI_QueryKey *qkey, SPIPlanPtr qplan,
 							Relation fk_rel, Relation pk_rel,
@@ -335,6 +342,16 @@ RI_FKey_check(TriggerData *trigdata)
 			break;
 	}
 
+	/*
+	 * Look up the key in the PK table's index directly if we can; that is
+	 * much cheaper than running the query below for every row.
+	 */
+	if (ri_FastPathCheck(riinfo, fk_rel, pk_rel, newslot))
+	{
+		table_close(pk_rel, RowShareLock);
+		return PointerGetDatum(NULL);
+	}
+
 	if (SPI_connect() != SPI_OK_CONNECT)
 		elog(ERROR, "SPI_connect failed");
 
@@ -2048,6 +2065,7 @@ ri_LoadConstraintInfo(Oid constraintOid)
 	memcpy(&riinfo->conname, &conForm->conname, sizeof(NameData));
 	riinfo->pk_relid = conForm->confrelid;
 	riinfo->fk_relid = conForm->conrelid;
+	riinfo->conindid = conForm->conindid;
 	riinfo->confupdtype = conForm->confupdtype;
 	riinfo->confdeltype = conForm->confdeltype;
 	riinfo->confmatchtype = conForm->confmatchtype;
@@ -2170,6 +2188,169 @@ ri_PlanCheck(const char *querystr, int nargs, Oid *argtypes,
 	return qplan;
 }
 
+/*
+ * Check that the referenced key of an FK row exists, without SPI
+ *
+ * This does what the RI_PLAN_CHECK_LOOKUPPK query does for RI_FKey_check:
+ * it scans the unique index on the PK table for the key, and locks the row
+ * it finds in KEY SHARE mode, following its update chain to the latest
+ * version the way EvalPlanQual would.  Reports a violation if there is no
+ * such row.
+ *
+ * Returns false, without doing anything, in the cases the query handles
+ * differently: partitioned PK tables, the transaction-snapshot isolation
+ * levels, missing privileges, and keys that the query would have to cast
+ * or compare under another collation.
+ */
+static bool
+ri_FastPathCheck(const RI_ConstraintInfo *riinfo,
+				 Relation fk_rel, Relation pk_rel, TupleTableSlot *newslot)
+{
+	Oid			pk_owner = RelationGetForm(pk_rel)->relowner;
+	Relation	idxrel;
+	ScanKeyData skey[RI_MAX_NUMKEYS];
+	RegProcedure eq_procs[RI_MAX_NUMKEYS];
+	Oid			collations[RI_MAX_NUMKEYS];
+	Datum		vals[RI_MAX_NUMKEYS];
+	char		nulls[RI_MAX_NUMKEYS];
+	Snapshot	snapshot;
+	IndexScanDesc scan;
+	TupleTableSlot *slot;
+	Oid			save_userid;
+	int			save_sec_context;
+	bool		found = false;
+
+	if (pk_rel->rd_rel->relkind != RELKIND_RELATION ||
+		IsolationUsesXactSnapshot() ||
+		pg_class_aclmask(RelationGetRelid(pk_rel), pk_owner,
+						 ACL_SELECT | ACL_UPDATE, ACLMASK_ALL) !=
+		(ACL_SELECT | ACL_UPDATE))
+		return false;
+
+	idxrel = index_open(riinfo->conindid, AccessShareLock);
+	if (idxrel->rd_rel->relam != BTREE_AM_OID ||
+		idxrel->rd_index->indrelid != RelationGetRelid(pk_rel) ||
+		IndexRelationGetNumberOfKeyAttributes(idxrel) != riinfo->nkeys)
+	{
+		index_close(idxrel, AccessShareLock);
+		return false;
+	}
+
+	ri_ExtractValues(fk_rel, newslot, riinfo, false, vals, nulls);
+
+	/*
+	 * Build a scan key for each index column, in index column order.  The
+	 * PK = FK operator must be the index's equality operator for the FK
+	 * column's type, so that the FK value can be compared as it is.
+	 */
+	for (int i = 0; i < riinfo->nkeys; i++)
+	{
+		Oid			pf_eq_opr = riinfo->pf_eq_oprs[i];
+		Oid			pk_coll = RIAttCollation(pk_rel, riinfo->pk_attnums[i]);
+		Oid			lefttype;
+		Oid			righttype;
+		int			j;
+
+		for (j = 0; j < riinfo->nkeys; j++)
+		{
+			if (idxrel->rd_index->indkey.values[j] == riinfo->pk_attnums[i])
+				break;
+		}
+
+		op_input_types(pf_eq_opr, &lefttype, &righttype);
+		if (j == riinfo->nkeys ||
+			get_op_opfamily_strategy(pf_eq_opr, idxrel->rd_opfamily[j]) !=
+			BTEqualStrategyNumber ||
+			righttype != RIAttType(fk_rel, riinfo->fk_attnums[i]) ||
+			idxrel->rd_indcollation[j] != pk_coll ||
+			RIAttCollation(fk_rel, riinfo->fk_attnums[i]) != pk_coll)
+		{
+			index_close(idxrel, AccessShareLock);
+			return false;
+		}
+
+		eq_procs[i] = get_opcode(pf_eq_opr);
+		collations[i] = pk_coll;
+		ScanKeyEntryInitialize(&skey[j], 0, j + 1, BTEqualStrategyNumber,
+							   righttype, pk_coll, eq_procs[i], vals[i]);
+	}
+
+	/* Switch to proper UID to perform check as, like ri_PerformCheck */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(pk_owner,
+						   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+						   SECURITY_NOFORCE_RLS);
+
+	/* As SPI would for the query, make our own work visible */
+	CommandCounterIncrement();
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+
+	slot = table_slot_create(pk_rel, NULL);
+	scan = index_beginscan(pk_rel, idxrel, snapshot, riinfo->nkeys, 0);
+	index_rescan(scan, skey, riinfo->nkeys, NULL, 0);
+
+	while (!found && index_getnext_slot(scan, ForwardScanDirection, slot))
+	{
+		TM_FailureData tmfd;
+		TM_Result	result;
+
+		result = table_tuple_lock(pk_rel, &slot->tts_tid, snapshot, slot,
+								  GetCurrentCommandId(true),
+								  LockTupleKeyShare, LockWaitBlock,
+								  TUPLE_LOCK_FLAG_FIND_LAST_VERSION, &tmfd);
+		switch (result)
+		{
+			case TM_Ok:
+				found = true;
+
+				/*
+				 * If the row was updated concurrently, we have locked its
+				 * latest version, whose key must still match.
+				 */
+				if (tmfd.traversed)
+				{
+					for (int i = 0; i < riinfo->nkeys && found; i++)
+					{
+						Datum		pkval;
+						bool		isnull;
+
+						pkval = slot_getattr(slot, riinfo->pk_attnums[i],
+											 &isnull);
+						found = !isnull &&
+							DatumGetBool(OidFunctionCall2Coll(eq_procs[i],
+															  collations[i],
+															  pkval,
+															  vals[i]));
+					}
+				}
+				break;
+
+			case TM_SelfModified:
+			case TM_Deleted:
+				/* The row is gone; keep looking */
+				break;
+
+			default:
+				elog(ERROR, "unexpected table_tuple_lock status: %u", result);
+				break;
+		}
+	}
+
+	index_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+	UnregisterSnapshot(snapshot);
+	index_close(idxrel, AccessShareLock);
+
+	/* Restore UID and security context */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	if (!found)
+		ri_ReportViolation(riinfo, pk_rel, fk_rel, newslot, NULL,
+						   RI_PLAN_CHECK_LOOKUPPK, false);
+
+	return true;
+}
+
 /*
  * Perform a query to enforce an RI restriction
  */
@@ -106,6 +106,7 @@
 #include "access/table.h"
 #include "access/tableam.h"
 #include "access/visibilitymap.h"
+#include "catalog/catalog.h"
 #include "catalog/pg_am.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_operator.h"
@@ -164,6 +165,7 @@ static double eqjoinsel_semi(Oid opfuncoid,
 							 RelOptInfo *inner_rel);
 static bool estimate_multivariate_ndistinct(PlannerInfo *root,
 											RelOptInfo *rel, List **varinfos, double *ndistinct);
+static Bitmapset *groupvar_attnums(Node *var, Index relid);
 static bool convert_to_scalar(Datum value, Oid valuetypid, Oid collid,
 							  double *scaledvalue,
 							  Datum lobound, Datum hibound, Oid boundstypid,
@@ -3564,7 +3566,11 @@ estimate_hashagg_tablesize(Path *path, const AggClauseCosts *agg_costs,
  * the MVNDistinctItem that best matches.  If a match it found, *varinfos is
  * updated to remove the list of matched varinfos.
  *
- * Varinfos that aren't for simple Vars are ignored.
+ * A varinfo for an expression matches if the statistics object covers all
+ * the columns the expression uses, since the expression can't have more
+ * distinct values than those columns together.  As that's only an upper
+ * bound, the estimate is then clamped to the product of the separate
+ * estimates of the matched varinfos.
  *
  * Return true if we're able to find a match, false otherwise.
  */
@@ -3573,7 +3579,9 @@ estimate_multivariate_ndistinct(PlannerInfo *root, RelOptInfo *rel,
 								List **varinfos, double *ndistinct)
 {
 	ListCell   *lc;
-	Bitmapset  *attnums = NULL;
+	Bitmapset **varattnos;
+	int			nvarinfos;
+	int			i;
 	int			nmatches;
 	Oid			statOid = InvalidOid;
 	MVNDistinct *stats;
@@ -3583,18 +3591,17 @@ estimate_multivariate_ndistinct(PlannerInfo *root, RelOptInfo *rel,
 	if (!rel->statlist)
 		return false;
 
-	/* Determine the attnums we're looking for */
+	/* Determine the attnums each varinfo needs */
+	nvarinfos = list_length(*varinfos);
+	varattnos = (Bitmapset **) palloc0(sizeof(Bitmapset *) * nvarinfos);
+	i = 0;
 	foreach(lc, *varinfos)
 	{
 		GroupVarInfo *varinfo = (GroupVarInfo *) lfirst(lc);
 
 		Assert(varinfo->rel == rel);
 
-		if (IsA(varinfo->var, Var))
-		{
-			attnums = bms_add_member(attnums,
-									 ((Var *) varinfo->var)->varattno);
-		}
+		varattnos[i++] = groupvar_attnums(varinfo->var, rel->relid);
 	}
 
 	/* look for the ndistinct statistics matching the most vars */
@@ -3602,15 +3609,19 @@ estimate_multivariate_ndistinct(PlannerInfo *root, RelOptInfo *rel,
 	foreach(lc, rel->statlist)
 	{
 		StatisticExtInfo *info = (StatisticExtInfo *) lfirst(lc);
-		Bitmapset  *shared;
+		Bitmapset  *shared = NULL;
 		int			nshared;
 
 		/* skip statistics of other kinds */
 		if (info->kind != STATS_EXT_NDISTINCT)
 			continue;
 
-		/* compute attnums shared by the vars and the statistics object */
-		shared = bms_intersect(info->keys, attnums);
+		/* compute attnums of the varinfos covered by the statistics object */
+		for (i = 0; i < nvarinfos; i++)
+		{
+			if (varattnos[i] != NULL && bms_is_subset(varattnos[i], info->keys))
+				shared = bms_add_members(shared, varattnos[i]);
+		}
 		nshared = bms_num_members(shared);
 
 		/*
@@ -3641,9 +3652,10 @@ estimate_multivariate_ndistinct(PlannerInfo *root, RelOptInfo *rel,
 	 */
 	if (stats)
 	{
-		int			i;
 		List	   *newlist = NIL;
 		MVNDistinctItem *item = NULL;
+		bool		matched_expr = false;
+		double		clamp = 1.0;
 
 		/* Find the specific item that exactly matches the combination */
 		for (i = 0; i < stats->nitems; i++)
@@ -3662,30 +3674,71 @@ estimate_multivariate_ndistinct(PlannerInfo *root, RelOptInfo *rel,
 			elog(ERROR, "corrupt MVNDistinct entry");
 
 		/* Form the output varinfo list, keeping only unmatched ones */
+		i = 0;
 		foreach(lc, *varinfos)
 		{
 			GroupVarInfo *varinfo = (GroupVarInfo *) lfirst(lc);
-			AttrNumber	attnum;
+			Bitmapset  *needed = varattnos[i++];
 
-			if (!IsA(varinfo->var, Var))
+			if (needed == NULL || !bms_is_subset(needed, matched))
 			{
 				newlist = lappend(newlist, varinfo);
 				continue;
 			}
 
-			attnum = ((Var *) varinfo->var)->varattno;
-			if (!bms_is_member(attnum, matched))
-				newlist = lappend(newlist, varinfo);
+			if (!IsA(varinfo->var, Var))
+				matched_expr = true;
+			clamp *= varinfo->ndistinct;
 		}
 
 		*varinfos = newlist;
 		*ndistinct = item->ndistinct;
+		if (matched_expr && *ndistinct > clamp)
+			*ndistinct = clamp;
 		return true;
 	}
 
 	return false;
 }
 
+/*
+ * groupvar_attnums
+ *		Return the attnums of the given relation used by a GROUP BY item.
+ *
+ * Returns NULL if the item uses no columns, or uses a system column or the
+ * whole row, none of which extended statistics can cover.
+ */
+static Bitmapset *
+groupvar_attnums(Node *var, Index relid)
+{
+	Bitmapset  *varattnos = NULL;
+	Bitmapset  *result = NULL;
+	int			k = -1;
+
+	if (IsA(var, Var))
+	{
+		AttrNumber	attnum = ((Var *) var)->varattno;
+
+		return AttrNumberIsForUserDefinedAttr(attnum) ?
+			bms_make_singleton(attnum) : NULL;
+	}
+
+	pull_varattnos(var, relid, &varattnos);
+	while ((k = bms_next_member(varattnos, k)) >= 0)
+	{
+		AttrNumber	attnum = k + FirstLowInvalidHeapAttributeNumber;
+
+		if (!AttrNumberIsForUserDefinedAttr(attnum))
+		{
+			bms_free(result);
+			return NULL;
+		}
+		result = bms_add_member(result, attnum);
+	}
+
+	return result;
+}
+
 /*
  * convert_to_scalar
  *	  Convert non-NULL values of the indicated types to the comparison
@@ -5571,9 +5624,10 @@ genericcostestimate(PlannerInfo *root,
 
 	/*
 	 * Check for ScalarArrayOpExpr index quals, and estimate the number of
-	 * index scans that will be performed.
+	 * index scans that will be performed.  The caller may already have
+	 * counted some repeated index scans of its own in costs->num_sa_scans.
 	 */
-	num_sa_scans = 1;
+	num_sa_scans = Max(costs->num_sa_scans, 1);
 	foreach(l, indexQuals)
 	{
 		RestrictInfo *rinfo = (RestrictInfo *) lfirst(l);
@@ -5778,6 +5832,43 @@ add_predicate_to_index_quals(IndexOptInfo *index, List *indexQuals)
 }
 
 
+/*
+ * Estimate the number of distinct values of a btree index's first column,
+ * for costing a skip scan of the index.  Returns 0 if a skip scan isn't
+ * expected to pay off.
+ *
+ * The btree code stops skipping when the groups of tuples sharing a first
+ * column value turn out to be too small to skip over any leaf pages, so we
+ * don't cost a skip scan unless there are fewer distinct values than index
+ * pages.  We also don't if we have no real statistics for the column, since
+ * DEFAULT_NUM_DISTINCT could make a skip scan look far cheaper than it is.
+ *
+ * Note that parallel index scans don't skip.  We don't know whether this
+ * path will become one, so we accept overestimating how cheap those are.
+ */
+static double
+btskipndistinct(PlannerInfo *root, IndexOptInfo *index)
+{
+	TargetEntry *tle;
+	VariableStatData vardata;
+	double		ndistinct;
+	bool		isdefault;
+
+	/* the btree code doesn't skip when scanning system catalogs */
+	if (index->nkeycolumns < 2 || IsCatalogRelationOid(index->indexoid))
+		return 0;
+
+	tle = linitial_node(TargetEntry, index->indextlist);
+	examine_variable(root, (Node *) tle->expr, 0, &vardata);
+	ndistinct = get_variable_numdistinct(&vardata, &isdefault);
+	ReleaseVariableStats(vardata);
+
+	if (isdefault || ndistinct < 1 || ndistinct >= index->pages)
+		return 0;
+
+	return ndistinct;
+}
+
 void
 btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 			   Cost *indexStartupCost, Cost *indexTotalCost,
@@ -5797,8 +5888,21 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	bool		found_saop;
 	bool		found_is_null_op;
 	double		num_sa_scans;
+	double		skip_ndistinct;
 	ListCell   *lc;
 
+	/*
+	 * If there are no quals on the first index column, but there are some on
+	 * the second, the btree code performs a skip scan: one index scan for
+	 * each distinct value of the first column, as though there were an "="
+	 * ScalarArrayOpExpr qual listing all of them.  Each of those scans
+	 * treats the quals on the following columns as its boundary quals.
+	 */
+	skip_ndistinct = 0;
+	if (path->indexclauses != NIL &&
+		linitial_node(IndexClause, path->indexclauses)->indexcol == 1)
+		skip_ndistinct = btskipndistinct(root, index);
+
 	/*
 	 * For a btree scan, only leading '=' quals plus inequality quals for the
 	 * immediately next attribute contribute to index selectivity (these are
@@ -5817,7 +5921,7 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 * considered to act the same as it normally does.
 	 */
 	indexBoundQuals = NIL;
-	indexcol = 0;
+	indexcol = (skip_ndistinct > 0) ? 1 : 0;
 	eqQualHere = false;
 	found_saop = false;
 	found_is_null_op = false;
@@ -5899,17 +6003,23 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 		}
 	}
 
+	/* A skip scan repeats the index scan for each first column value */
+	if (skip_ndistinct > 0)
+		num_sa_scans *= skip_ndistinct;
+
 	/*
 	 * If index is unique and we found an '=' clause for each column, we can
 	 * just assume numIndexTuples = 1 and skip the expensive
 	 * clauselist_selectivity calculations.  However, a ScalarArrayOp or
-	 * NullTest invalidates that theory, even though it sets eqQualHere.
+	 * NullTest invalidates that theory, even though it sets eqQualHere, and
+	 * so does a skip scan.
 	 */
 	if (index->unique &&
 		indexcol == index->nkeycolumns - 1 &&
 		eqQualHere &&
 		!found_saop &&
-		!found_is_null_op)
+		!found_is_null_op &&
+		skip_ndistinct == 0)
 		numIndexTuples = 1.0;
 	else
 	{
@@ -5942,6 +6052,7 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 */
 	MemSet(&costs, 0, sizeof(costs));
 	costs.numIndexTuples = numIndexTuples;
+	costs.num_sa_scans = skip_ndistinct;
 
 	genericcostestimate(root, path, loop_count, &costs);
 
@@ -797,6 +797,7 @@ get_docrep(TSVector txt, QueryRepresentation *qr, int *doclen)
 		DocRepresentation *rptr = doc + 1,
 				   *wptr = doc,
 					storage;
+		QueryItem **items;
 
 		/*
 		 * Sort representation in ascending order by pos and entry
@@ -804,10 +805,15 @@ get_docrep(TSVector txt, QueryRepresentation *qr, int *doclen)
 		qsort((void *) doc, cur, sizeof(DocRepresentation), compareDocR);
 
 		/*
-		 * Join QueryItem per WordEntry and it's position
+		 * Join QueryItem per WordEntry and it's position.  Every entry of the
+		 * sorted array lands in exactly one group, so the groups' item lists
+		 * are carved out of a single array of 'cur' pointers, in order;
+		 * doc[0].data.query.items is its start.
 		 */
+		items = (QueryItem **) palloc(sizeof(QueryItem *) * cur);
+
 		storage.pos = doc->pos;
-		storage.data.query.items = palloc(sizeof(QueryItem *) * qr->query->size);
+		storage.data.query.items = items;
 		storage.data.query.items[0] = doc->data.map.item;
 		storage.data.query.nitem = 1;
 
@@ -824,7 +830,7 @@ get_docrep(TSVector txt, QueryRepresentation *qr, int *doclen)
 				*wptr = storage;
 				wptr++;
 				storage.pos = rptr->pos;
-				storage.data.query.items = palloc(sizeof(QueryItem *) * qr->query->size);
+				storage.data.query.items += storage.data.query.nitem;
 				storage.data.query.items[0] = rptr->data.map.item;
 				storage.data.query.nitem = 1;
 			}
@@ -847,7 +853,7 @@ static float4
 calc_rank_cd(const float4 *arrdata, TSVector txt, TSQuery query, int method)
 {
 	DocRepresentation *doc;
-	int			len,
+	int			len = 0,
 				i,
 				doclen = 0;
 	CoverExt	ext;
@@ -917,15 +923,14 @@ calc_rank_cd(const float4 *arrdata, TSVector txt, TSQuery query, int method)
 		NExtent++;
 	}
 
+	if (method & (RANK_NORM_LOGLENGTH | RANK_NORM_LENGTH))
+		len = cnt_length(txt);
+
 	if ((method & RANK_NORM_LOGLENGTH) && txt->size > 0)
-		Wdoc /= log((double) (cnt_length(txt) + 1));
+		Wdoc /= log((double) (len + 1));
 
-	if (method & RANK_NORM_LENGTH)
-	{
-		len = cnt_length(txt);
-		if (len > 0)
-			Wdoc /= (double) len;
-	}
+	if ((method & RANK_NORM_LENGTH) && len > 0)
+		Wdoc /= (double) len;
 
 	if ((method & RANK_NORM_EXTDIST) && NExtent > 0 && SumDist > 0)
 		Wdoc /= ((double) NExtent) / SumDist;
@@ -939,6 +944,7 @@ calc_rank_cd(const float4 *arrdata, TSVector txt, TSQuery query, int method)
 	if (method & RANK_NORM_RDIVRPLUS1)
 		Wdoc /= (Wdoc + 1);
 
+	pfree(doc[0].data.query.items);
 	pfree(doc);
 
 	pfree(qr.operandData);
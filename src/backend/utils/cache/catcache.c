@@ -63,6 +63,9 @@
 /* Cache management header --- pointer is NULL until created */
 static CatCacheHeader *CacheHdr = NULL;
 
+/* GUC variable: limit on the memory used by cache tuples, in kB, or 0 */
+int			catalog_cache_max_size = 0;
+
 static inline HeapTuple SearchCatCacheInternal(CatCache *cache,
 											   int nkeys,
 											   Datum v1, Datum v2,
@@ -88,6 +91,7 @@ static void CatCachePrintStats(int code, Datum arg);
 #endif
 static void CatCacheRemoveCTup(CatCache *cache, CatCTup *ct);
 static void CatCacheRemoveCList(CatCache *cache, CatCList *cl);
+static void CatCacheEvict(CatCTup *keep);
 static void CatalogCacheInitializeCache(CatCache *cache);
 static CatCTup *CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 										Datum *arguments,
@@ -445,6 +449,18 @@ CatCachePrintStats(int code, Datum arg)
 #endif							/* CATCACHE_STATS */
 
 
+/*
+ * Amount of memory accounted to a cache entry.  Keys of negative entries
+ * are allocated separately, and are not counted.
+ */
+static inline Size
+CatCTupSize(CatCTup *ct)
+{
+	if (ct->negative)
+		return sizeof(CatCTup);
+	return sizeof(CatCTup) + MAXIMUM_ALIGNOF + ct->tuple.t_len;
+}
+
 /*
  *		CatCacheRemoveCTup
  *
@@ -471,8 +487,10 @@ CatCacheRemoveCTup(CatCache *cache, CatCTup *ct)
 		return;					/* nothing left to do */
 	}
 
-	/* delink from linked list */
+	/* delink from linked lists */
 	dlist_delete(&ct->cache_elem);
+	dlist_delete(&ct->lru_elem);
+	CacheHdr->ch_size -= CatCTupSize(ct);
 
 	/*
 	 * Free keys when we're dealing with a negative entry, normal entries just
@@ -638,7 +656,7 @@ CreateCacheMemoryContext(void)
  * This is not very efficient if the target cache is nearly empty.
  * However, it shouldn't need to be efficient; we don't invoke it often.
  */
-static void
+void
 ResetCatalogCache(CatCache *cache)
 {
 	dlist_mutable_iter iter;
@@ -802,6 +820,8 @@ InitCatCache(int id,
 		CacheHdr = (CatCacheHeader *) palloc(sizeof(CatCacheHeader));
 		slist_init(&CacheHdr->ch_caches);
 		CacheHdr->ch_ntup = 0;
+		dlist_init(&CacheHdr->ch_lru);
+		CacheHdr->ch_size = 0;
 #ifdef CATCACHE_STATS
 		/* set up to dump stats at backend exit */
 		on_proc_exit(CatCachePrintStats, 0);
@@ -1263,6 +1283,7 @@ SearchCatCacheInternal(CatCache *cache,
 		 * near the front of the hashbucket's list.)
 		 */
 		dlist_move_head(bucket, &ct->cache_elem);
+		dlist_move_head(&CacheHdr->ch_lru, &ct->lru_elem);
 
 		/*
 		 * If it's a positive entry, bump its refcount and return it. If it's
@@ -1890,9 +1911,16 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp, Datum *arguments,
 	ct->hash_value = hashValue;
 
 	dlist_push_head(&cache->cc_bucket[hashIndex], &ct->cache_elem);
+	dlist_push_head(&CacheHdr->ch_lru, &ct->lru_elem);
 
 	cache->cc_ntup++;
 	CacheHdr->ch_ntup++;
+	CacheHdr->ch_size += CatCTupSize(ct);
+
+	/* Make room for the new entry, if we're over the limit */
+	if (catalog_cache_max_size > 0 &&
+		CacheHdr->ch_size > (Size) catalog_cache_max_size * 1024)
+		CatCacheEvict(ct);
 
 	/*
 	 * If the hash table has become too full, enlarge the buckets array. Quite
@@ -1904,6 +1932,38 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp, Datum *arguments,
 	return ct;
 }
 
+/*
+ * CatCacheEvict
+ *		Remove least recently used entries until the caches fit within
+ *		catalog_cache_max_size.
+ *
+ * Only entries that nobody holds a reference to can go, and members of
+ * lists are left alone, since the list would have to go with them.  "keep"
+ * is the entry just created, which our caller is about to return.
+ */
+static void
+CatCacheEvict(CatCTup *keep)
+{
+	Size		limit = (Size) catalog_cache_max_size * 1024;
+	dlist_node *cur = dlist_tail_node(&CacheHdr->ch_lru);
+
+	while (CacheHdr->ch_size > limit && cur != &keep->lru_elem)
+	{
+		CatCTup    *ct = dlist_container(CatCTup, lru_elem, cur);
+
+		/* step before removing, as that frees the entry */
+		cur = cur->prev;
+
+		if (ct->refcount > 0 || ct->c_list != NULL)
+			continue;
+
+		CACHE_elog(DEBUG2, "CatCacheEvict(%s): evicting entry",
+				   ct->my_cache->cc_relname);
+
+		CatCacheRemoveCTup(ct->my_cache, ct);
+	}
+}
+
 /*
  * Helper routine that frees keys stored in the keys array.
  */
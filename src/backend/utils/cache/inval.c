@@ -635,9 +635,10 @@ LocalExecuteInvalidationMessage(SharedInvalidationMessage *msg)
  *		all the cached relation descriptors and smgr cache entries.
  *		Relation descriptors that have positive refcounts are then rebuilt.
  *
- *		We call this when we see a shared-inval-queue overflow signal,
- *		since that tells us we've lost some shared-inval messages and hence
- *		don't know what needs to be invalidated.
+ *		This is for callers that need all the caches rebuilt.  When we fall
+ *		behind in the shared-inval queue and lose some messages, we get a
+ *		summary of them and flush only the caches they could have affected;
+ *		see InvalidateSummarizedCaches.
  */
 void
 InvalidateSystemCaches(void)
@@ -663,6 +664,62 @@ InvalidateSystemCaches(void)
 	}
 }
 
+/*
+ *		InvalidateSummarizedCaches
+ *
+ *		Like InvalidateSystemCaches, but only for the caches that the
+ *		shared-inval messages we lost could have affected, as described by
+ *		'summary'.  This is the reset function we give to
+ *		ReceiveSharedInvalidMessages.
+ */
+static void
+InvalidateSummarizedCaches(const SharedInvalSummary *summary)
+{
+	int			i;
+
+	InvalidateCatalogSnapshot();
+
+	if (summary->flags & SINVAL_SUMMARY_ALL_CATCACHES)
+	{
+		ResetCatalogCaches();
+
+		for (i = 0; i < syscache_callback_count; i++)
+		{
+			struct SYSCACHECALLBACK *ccitem = syscache_callback_list + i;
+
+			ccitem->function(ccitem->arg, ccitem->id, 0);
+		}
+	}
+	else
+	{
+		StaticAssertStmt(SysCacheSize <= SINVAL_SUMMARY_MAX_CATCACHES,
+						 "too many syscaches for SharedInvalSummary");
+
+		for (i = 0; i < SysCacheSize; i++)
+		{
+			if (!SInvalSummaryHasCatcache(summary, i))
+				continue;
+
+			SysCacheReset(i);
+			CallSyscacheCallbacks(i, 0);
+		}
+	}
+
+	if (summary->flags & SINVAL_SUMMARY_RELCACHE)
+	{
+		RelationCacheInvalidate();	/* gets smgr and relmap too */
+
+		for (i = 0; i < relcache_callback_count; i++)
+		{
+			struct RELCACHECALLBACK *ccitem = relcache_callback_list + i;
+
+			ccitem->function(ccitem->arg, InvalidOid);
+		}
+	}
+	else if (summary->flags & SINVAL_SUMMARY_SMGR)
+		smgrcloseall();
+}
+
 
 /* ----------------------------------------------------------------
  *					  public functions
@@ -681,7 +738,7 @@ void
 AcceptInvalidationMessages(void)
 {
 	ReceiveSharedInvalidMessages(LocalExecuteInvalidationMessage,
-								 InvalidateSystemCaches);
+								 InvalidateSummarizedCaches);
 
 	/*
 	 * Test code to force cache flushes anytime a flush could happen.
@@ -58,11 +58,13 @@
 
 #include "access/transam.h"
 #include "catalog/namespace.h"
+#include "executor/execPartition.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
 #include "parser/analyze.h"
+#include "portability/instr_time.h"
 #include "parser/parsetree.h"
 #include "storage/lmgr.h"
 #include "tcop/pquery.h"
@@ -71,6 +73,7 @@
 #include "utils/memutils.h"
 #include "utils/resowner_private.h"
 #include "utils/rls.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
 
@@ -99,14 +102,19 @@ static dlist_head cached_expression_list = DLIST_STATIC_INIT(cached_expression_l
 static void ReleaseGenericPlan(CachedPlanSource *plansource);
 static List *RevalidateCachedQuery(CachedPlanSource *plansource,
 								   QueryEnvironment *queryEnv);
-static bool CheckCachedPlan(CachedPlanSource *plansource);
+static bool CheckCachedPlan(CachedPlanSource *plansource,
+							ParamListInfo boundParams);
 static CachedPlan *BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 								   ParamListInfo boundParams, QueryEnvironment *queryEnv);
+static CachedPlan *LoadSharedGenericPlan(CachedPlanSource *plansource,
+										 ParamListInfo boundParams);
 static bool choose_custom_plan(CachedPlanSource *plansource,
 							   ParamListInfo boundParams);
+static void update_run_time(double *avg_time, int *num_runs, double elapsed);
 static double cached_plan_cost(CachedPlan *plan, bool include_planner);
 static Query *QueryListGetPrimaryStmt(List *stmts);
 static void AcquireExecutorLocks(List *stmt_list, bool acquire);
+static void AcquirePartitionLocks(List *stmt_list, ParamListInfo boundParams);
 static void AcquirePlannerLocks(List *stmt_list, bool acquire);
 static void ScanQueryForLocks(Query *parsetree, bool acquire);
 static bool ScanQueryWalker(Node *node, bool *acquire);
@@ -118,6 +126,21 @@ static void PlanCacheSysCallback(Datum arg, int cacheid, uint32 hashvalue);
 /* GUC parameter */
 int			plan_cache_mode;
 
+/*
+ * In "adaptive" mode, the average run times are plain averages of the first
+ * ADAPTIVE_PLAN_WINDOW runs, and after that exponentially weighted moving
+ * averages that follow the most recent runs.  We trust them once we have
+ * seen ADAPTIVE_PLAN_MIN_RUNS runs of both kinds of plan, and every
+ * ADAPTIVE_PLAN_RECHECK runs, try the losing kind again in case things have
+ * changed.
+ */
+#define ADAPTIVE_PLAN_WINDOW	16
+#define ADAPTIVE_PLAN_MIN_RUNS	5
+#define ADAPTIVE_PLAN_RECHECK	100
+
+/* last CachedPlanSource.source_id assigned */
+static uint64 last_source_id = 0;
+
 /*
  * InitPlanCache: initialize module during InitPostgres.
  *
@@ -216,9 +239,15 @@ CreateCachedPlan(RawStmt *raw_parse_tree,
 	plansource->is_saved = false;
 	plansource->is_valid = false;
 	plansource->generation = 0;
+	plansource->source_id = ++last_source_id;
 	plansource->generic_cost = -1;
 	plansource->total_custom_cost = 0;
 	plansource->num_custom_plans = 0;
+	plansource->generic_time = 0;
+	plansource->custom_time = 0;
+	plansource->num_generic_runs = 0;
+	plansource->num_custom_runs = 0;
+	plansource->num_runs = 0;
 
 	MemoryContextSwitchTo(oldcxt);
 
@@ -283,9 +312,15 @@ CreateOneShotCachedPlan(RawStmt *raw_parse_tree,
 	plansource->is_saved = false;
 	plansource->is_valid = false;
 	plansource->generation = 0;
+	plansource->source_id = ++last_source_id;
 	plansource->generic_cost = -1;
 	plansource->total_custom_cost = 0;
 	plansource->num_custom_plans = 0;
+	plansource->generic_time = 0;
+	plansource->custom_time = 0;
+	plansource->num_generic_runs = 0;
+	plansource->num_custom_runs = 0;
+	plansource->num_runs = 0;
 
 	return plansource;
 }
@@ -788,9 +823,11 @@ RevalidateCachedQuery(CachedPlanSource *plansource,
  *
  * On a "true" return, we have acquired the locks needed to run the plan.
  * (We must do this for the "true" result to be race-condition-free.)
+ * boundParams are the parameter values it's going to be run with, which
+ * determine the partitions that survive initial pruning.
  */
 static bool
-CheckCachedPlan(CachedPlanSource *plansource)
+CheckCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams)
 {
 	CachedPlan *plan = plansource->gplan;
 
@@ -835,6 +872,13 @@ CheckCachedPlan(CachedPlanSource *plansource)
 			!TransactionIdEquals(plan->saved_xmin, TransactionXmin))
 			plan->is_valid = false;
 
+		/*
+		 * Now that the rest of the plan is known to be valid, we can see
+		 * which partitions survive initial pruning and lock them too.
+		 */
+		if (plan->is_valid)
+			AcquirePartitionLocks(plan->stmt_list, boundParams);
+
 		/*
 		 * By now, if any invalidation has happened, the inval callback
 		 * functions will have marked the plan invalid.
@@ -883,6 +927,8 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	bool		is_transient;
 	MemoryContext plan_context;
 	MemoryContext oldcxt = CurrentMemoryContext;
+	instr_time	planstart;
+	instr_time	planduration;
 	ListCell   *lc;
 
 	/*
@@ -928,10 +974,22 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	}
 
 	/*
-	 * Generate the plan.
+	 * Generate the plan.  Time it if we'll need to know what custom plans
+	 * cost.
 	 */
+	if (plan_cache_mode == PLAN_CACHE_MODE_ADAPTIVE)
+		INSTR_TIME_SET_CURRENT(planstart);
+
 	plist = pg_plan_queries(qlist, plansource->cursor_options, boundParams);
 
+	if (plan_cache_mode == PLAN_CACHE_MODE_ADAPTIVE)
+	{
+		INSTR_TIME_SET_CURRENT(planduration);
+		INSTR_TIME_SUBTRACT(planduration, planstart);
+	}
+	else
+		INSTR_TIME_SET_ZERO(planduration);
+
 	/* Release snapshot if we got one */
 	if (snapshot_set)
 		PopActiveSnapshot();
@@ -998,6 +1056,96 @@ BuildCachedPlan(CachedPlanSource *plansource, List *qlist,
 	plan->is_oneshot = plansource->is_oneshot;
 	plan->is_saved = false;
 	plan->is_valid = true;
+	plan->source_id = plansource->source_id;
+	plan->is_generic = false;
+	plan->planning_time = INSTR_TIME_GET_MILLISEC(planduration);
+
+	/* assign generation number to new plan */
+	plan->generation = ++(plansource->generation);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	return plan;
+}
+
+/*
+ * LoadSharedGenericPlan: use a generic plan from the shared plan cache
+ *
+ * Returns NULL if there is no usable shared plan.  Otherwise the plan is
+ * returned in a new memory context, the same as BuildCachedPlan would make
+ * it, and we hold the locks the executor needs on its relations.
+ */
+static CachedPlan *
+LoadSharedGenericPlan(CachedPlanSource *plansource, ParamListInfo boundParams)
+{
+	CachedPlan *plan;
+	List	   *plist;
+	uint64		generation;
+	MemoryContext plan_context;
+	MemoryContext oldcxt = CurrentMemoryContext;
+	ListCell   *lc;
+
+	plan_context = AllocSetContextCreate(CurrentMemoryContext,
+										 "CachedPlan",
+										 ALLOCSET_START_SMALL_SIZES);
+	MemoryContextCopyAndSetIdentifier(plan_context, plansource->query_string);
+	MemoryContextSwitchTo(plan_context);
+
+	plist = SharedPlanCacheLookup(plansource, &generation);
+	if (plist == NIL)
+	{
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextDelete(plan_context);
+		return NULL;
+	}
+
+	/*
+	 * Lock the plan's relations, and then make sure the entry is still
+	 * there: taking the locks makes us process any invalidations that were
+	 * committed before, and those would have removed the entry.  This is the
+	 * same check CheckCachedPlan makes on a local generic plan.
+	 */
+	AcquireExecutorLocks(plist, true);
+
+	if (plansource->is_valid &&
+		SharedPlanCacheRecheck(plansource, generation))
+		AcquirePartitionLocks(plist, boundParams);
+
+	if (!plansource->is_valid ||
+		!SharedPlanCacheRecheck(plansource, generation))
+	{
+		AcquireExecutorLocks(plist, false);
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextDelete(plan_context);
+		return NULL;
+	}
+
+	/*
+	 * Create and fill the CachedPlan struct, as BuildCachedPlan does.
+	 * Transient plans are never stored in the shared cache.
+	 */
+	plan = (CachedPlan *) palloc(sizeof(CachedPlan));
+	plan->magic = CACHEDPLAN_MAGIC;
+	plan->stmt_list = plist;
+	plan->planRoleId = GetUserId();
+	plan->dependsOnRole = plansource->dependsOnRLS;
+	foreach(lc, plist)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
+
+		Assert(!plannedstmt->transientPlan);
+		if (plannedstmt->dependsOnRole)
+			plan->dependsOnRole = true;
+	}
+	plan->saved_xmin = InvalidTransactionId;
+	plan->refcount = 0;
+	plan->context = plan_context;
+	plan->is_oneshot = false;
+	plan->is_saved = false;
+	plan->is_valid = true;
+	plan->source_id = plansource->source_id;
+	plan->is_generic = false;
+	plan->planning_time = 0;
 
 	/* assign generation number to new plan */
 	plan->generation = ++(plansource->generation);
@@ -1044,6 +1192,24 @@ choose_custom_plan(CachedPlanSource *plansource, ParamListInfo boundParams)
 	if (plansource->num_custom_plans < 5)
 		return true;
 
+	/*
+	 * In adaptive mode, once we have measured enough runs of both kinds of
+	 * plan, go by what they actually took rather than by the estimates.
+	 * Custom plan times include planning, so this is a fair comparison.  As
+	 * we only learn more about the kind of plan we use, try the other kind
+	 * once in a while; the parameter values or the data might have changed.
+	 */
+	if (plan_cache_mode == PLAN_CACHE_MODE_ADAPTIVE &&
+		plansource->num_generic_runs >= ADAPTIVE_PLAN_MIN_RUNS &&
+		plansource->num_custom_runs >= ADAPTIVE_PLAN_MIN_RUNS)
+	{
+		bool		custom = plansource->custom_time < plansource->generic_time;
+
+		if (plansource->num_runs % ADAPTIVE_PLAN_RECHECK == 0)
+			custom = !custom;
+		return custom;
+	}
+
 	avg_custom_cost = plansource->total_custom_cost / plansource->num_custom_plans;
 
 	/*
@@ -1157,7 +1323,7 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 
 	if (!customplan)
 	{
-		if (CheckCachedPlan(plansource))
+		if (CheckCachedPlan(plansource, boundParams))
 		{
 			/* We want a generic plan, and we already have a valid one */
 			plan = plansource->gplan;
@@ -1165,12 +1331,25 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 		}
 		else
 		{
-			/* Build a new generic plan */
-			plan = BuildCachedPlan(plansource, qlist, NULL, queryEnv);
+			bool		share = SharedPlanCacheEligible(plansource, queryEnv);
+
+			/*
+			 * Build a new generic plan, unless another backend has already
+			 * made one we can use.  Newly built plans are offered to the
+			 * shared cache, provided they are still valid.
+			 */
+			plan = share ? LoadSharedGenericPlan(plansource, boundParams) : NULL;
+			if (plan == NULL)
+			{
+				plan = BuildCachedPlan(plansource, qlist, NULL, queryEnv);
+				if (share && plansource->is_valid)
+					SharedPlanCacheStore(plansource, plan->stmt_list);
+			}
 			/* Just make real sure plansource->gplan is clear */
 			ReleaseGenericPlan(plansource);
 			/* Link the new generic plan into the plansource */
 			plansource->gplan = plan;
+			plan->is_generic = true;
 			plan->refcount++;
 			/* Immediately reparent into appropriate context */
 			if (plansource->is_saved)
@@ -1187,6 +1366,9 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 			}
 			/* Update generic_cost whenever we make a new generic plan */
 			plansource->generic_cost = cached_plan_cost(plan, false);
+			/* ... and forget how long the old one took */
+			plansource->generic_time = 0;
+			plansource->num_generic_runs = 0;
 
 			/*
 			 * If, based on the now-known value of generic_cost, we'd not have
@@ -1244,6 +1426,45 @@ GetCachedPlan(CachedPlanSource *plansource, ParamListInfo boundParams,
 	return plan;
 }
 
+/*
+ * CachedPlanRecordRun: report how long a run of a cached plan took.
+ *
+ * Callers that ran a plan obtained from GetCachedPlan report the elapsed
+ * time in milliseconds, which is used to choose between generic and custom
+ * plans in "adaptive" mode.  Reports about plans that weren't made from this
+ * plansource, which can happen if it was replaced meanwhile, are ignored.
+ */
+void
+CachedPlanRecordRun(CachedPlanSource *plansource, CachedPlan *plan,
+					double elapsed)
+{
+	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
+	Assert(plan->magic == CACHEDPLAN_MAGIC);
+
+	if (plansource->is_oneshot || plan->source_id != plansource->source_id)
+		return;
+
+	if (plan->is_generic)
+		update_run_time(&plansource->generic_time,
+						&plansource->num_generic_runs, elapsed);
+	else
+		update_run_time(&plansource->custom_time,
+						&plansource->num_custom_runs,
+						elapsed + plan->planning_time);
+	plansource->num_runs++;
+}
+
+/*
+ * update_run_time: add a run to an average run time
+ */
+static void
+update_run_time(double *avg_time, int *num_runs, double elapsed)
+{
+	if (*num_runs < ADAPTIVE_PLAN_WINDOW)
+		(*num_runs)++;
+	*avg_time += (elapsed - *avg_time) / *num_runs;
+}
+
 /*
  * ReleaseCachedPlan: release active use of a cached plan.
  *
@@ -1392,11 +1613,17 @@ CopyCachedPlan(CachedPlanSource *plansource)
 	newsource->is_saved = false;
 	newsource->is_valid = plansource->is_valid;
 	newsource->generation = plansource->generation;
+	newsource->source_id = ++last_source_id;
 
 	/* We may as well copy any acquired cost knowledge */
 	newsource->generic_cost = plansource->generic_cost;
 	newsource->total_custom_cost = plansource->total_custom_cost;
 	newsource->num_custom_plans = plansource->num_custom_plans;
+	newsource->generic_time = plansource->generic_time;
+	newsource->custom_time = plansource->custom_time;
+	newsource->num_generic_runs = plansource->num_generic_runs;
+	newsource->num_custom_runs = plansource->num_custom_runs;
+	newsource->num_runs = plansource->num_runs;
 
 	MemoryContextSwitchTo(oldcxt);
 
@@ -1418,6 +1645,183 @@ CachedPlanIsValid(CachedPlanSource *plansource)
 	return plansource->is_valid;
 }
 
+/*
+ * CachedPlanAllowsSimpleValidityCheck: can we use CachedPlanIsSimplyValid?
+ *
+ * This function, together with CachedPlanIsSimplyValid, provides a fast path
+ * for revalidating "simple" generic plans.  The core requirement to be simple
+ * is that the plan must not require taking any locks, which translates to
+ * not touching any tables; this happens to match up well with an important
+ * use-case in PL/pgSQL.  This function tests whether that's true, along
+ * with checking some other corner cases that we'd rather not bother with
+ * handling in the fast path.  (Note that it's still possible for such a plan
+ * to be invalidated, for example due to a change in a function that was
+ * inlined into the plan.)
+ *
+ * If the plan is simply valid, and "owner" is not NULL, record a refcount on
+ * the plan in that resowner before returning.  It is caller's responsibility
+ * to be sure that a refcount is held on any plan that's being actively used.
+ *
+ * This must only be called on known-valid generic plans (eg, ones just
+ * returned by GetCachedPlan).  If it returns true, the caller may re-use
+ * the cached plan as long as CachedPlanIsSimplyValid returns true; that
+ * check is much cheaper than the full revalidation done by GetCachedPlan.
+ * Nonetheless, no required checks are omitted.
+ */
+bool
+CachedPlanAllowsSimpleValidityCheck(CachedPlanSource *plansource,
+									CachedPlan *plan, ResourceOwner owner)
+{
+	ListCell   *lc;
+
+	/*
+	 * Sanity-check that the caller gave us a validated generic plan.  Notice
+	 * that we *don't* assert plansource->is_valid as you might expect; that's
+	 * because it's possible that that's already false when GetCachedPlan
+	 * returns, e.g. because ResetPlanCache happened partway through.  We
+	 * should accept the plan as long as plan->is_valid is true, and expect to
+	 * replan after the next CachedPlanIsSimplyValid call.
+	 */
+	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
+	Assert(plan->magic == CACHEDPLAN_MAGIC);
+	Assert(plan->is_valid);
+	Assert(plan == plansource->gplan);
+	Assert(plansource->search_path != NULL);
+	Assert(OverrideSearchPathMatchesCurrent(plansource->search_path));
+
+	/* We don't support oneshot plans here. */
+	if (plansource->is_oneshot)
+		return false;
+	Assert(!plan->is_oneshot);
+
+	/*
+	 * If the plan is dependent on RLS considerations, or it's transient,
+	 * reject.  These things probably can't ever happen for table-free
+	 * queries, but for safety's sake let's check.
+	 */
+	if (plansource->dependsOnRLS)
+		return false;
+	if (plan->dependsOnRole)
+		return false;
+	if (TransactionIdIsValid(plan->saved_xmin))
+		return false;
+
+	/*
+	 * Reject if AcquirePlannerLocks would have anything to do.  This is
+	 * simplistic, but there's no need to inquire any more carefully; indeed,
+	 * for current callers it shouldn't even be possible to hit any of these
+	 * checks.
+	 */
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = lfirst_node(Query, lc);
+
+		if (query->commandType == CMD_UTILITY)
+			return false;
+		if (query->rtable || query->cteList || query->hasSubLinks)
+			return false;
+	}
+
+	/*
+	 * Reject if AcquireExecutorLocks would have anything to do.  This is
+	 * probably unnecessary given the previous check, but let's be safe.
+	 */
+	foreach(lc, plan->stmt_list)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
+		ListCell   *lc2;
+
+		if (plannedstmt->commandType == CMD_UTILITY)
+			return false;
+
+		/*
+		 * We have to grovel through the rtable because it's likely to
+		 * contain an RTE_RESULT relation, rather than being totally empty.
+		 */
+		foreach(lc2, plannedstmt->rtable)
+		{
+			RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc2);
+
+			if (rte->rtekind == RTE_RELATION)
+				return false;
+		}
+	}
+
+	/*
+	 * Okay, it's simple.  Note that what we've primarily established here is
+	 * that no locks need be taken before checking the plan's is_valid flag.
+	 */
+
+	/* Bump refcount if requested. */
+	if (owner)
+	{
+		ResourceOwnerEnlargePlanCacheRefs(owner);
+		plan->refcount++;
+		ResourceOwnerRememberPlanCacheRef(owner, plan);
+	}
+
+	return true;
+}
+
+/*
+ * CachedPlanIsSimplyValid: quick check for plan still being valid
+ *
+ * This function must not be used unless CachedPlanAllowsSimpleValidityCheck
+ * previously said it was OK.
+ *
+ * If the plan is valid, and "owner" is not NULL, record a refcount on
+ * the plan in that resowner before returning.  It is caller's responsibility
+ * to be sure that a refcount is held on any plan that's being actively used.
+ *
+ * The code here is unconditionally safe as long as the only use of this
+ * CachedPlanSource is in connection with the particular CachedPlan pointer
+ * that's passed in.  If the plansource were being used for other purposes,
+ * it's possible that its generic plan could be invalidated and regenerated
+ * while the current caller wasn't looking, and then there could be a chance
+ * collision of address between this caller's now-stale plan pointer and the
+ * actual address of the new generic plan.  For current uses, that scenario
+ * can't happen; but with a plansource shared across multiple uses, it'd be
+ * advisable to also save plan->generation and verify that that still matches.
+ */
+bool
+CachedPlanIsSimplyValid(CachedPlanSource *plansource, CachedPlan *plan,
+						ResourceOwner owner)
+{
+	/*
+	 * Careful here: since the caller doesn't necessarily hold a refcount on
+	 * the plan to start with, it's possible that "plan" is a dangling
+	 * pointer.  Don't dereference it until we've verified that it still
+	 * matches the plansource's gplan (which is either valid or NULL).
+	 */
+	Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
+
+	/*
+	 * Has cache invalidation fired on this plan?  We can check this right
+	 * away since there are no locks that we'd need to acquire first.  Note
+	 * that here we *do* check plansource->is_valid, so as to force plan
+	 * rebuild if that's become false.
+	 */
+	if (!plansource->is_valid || plan != plansource->gplan || !plan->is_valid)
+		return false;
+
+	Assert(plan->magic == CACHEDPLAN_MAGIC);
+
+	/* Is the search_path still the same as when we made it? */
+	Assert(plansource->search_path != NULL);
+	if (!OverrideSearchPathMatchesCurrent(plansource->search_path))
+		return false;
+
+	/* It's still good.  Bump refcount if requested. */
+	if (owner)
+	{
+		ResourceOwnerEnlargePlanCacheRefs(owner);
+		plan->refcount++;
+		ResourceOwnerRememberPlanCacheRef(owner, plan);
+	}
+
+	return true;
+}
+
 /*
  * CachedPlanGetTargetList: return tlist, if any, describing plan's output
  *
@@ -1555,6 +1959,9 @@ QueryListGetPrimaryStmt(List *stmts)
 /*
  * AcquireExecutorLocks: acquire locks needed for execution of a cached plan;
  * or release them if acquire is false.
+ *
+ * Partitions that initial pruning may eliminate are not covered; see
+ * AcquirePartitionLocks.
  */
 static void
 AcquireExecutorLocks(List *stmt_list, bool acquire)
@@ -1565,6 +1972,7 @@ AcquireExecutorLocks(List *stmt_list, bool acquire)
 	{
 		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc1);
 		ListCell   *lc2;
+		Index		rti;
 
 		if (plannedstmt->commandType == CMD_UTILITY)
 		{
@@ -1582,11 +1990,14 @@ AcquireExecutorLocks(List *stmt_list, bool acquire)
 			continue;
 		}
 
+		rti = 0;
 		foreach(lc2, plannedstmt->rtable)
 		{
 			RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc2);
 
-			if (rte->rtekind != RTE_RELATION)
+			rti++;
+			if (rte->rtekind != RTE_RELATION ||
+				bms_is_member(rti, plannedstmt->prunableRelids))
 				continue;
 
 			/*
@@ -1603,6 +2014,47 @@ AcquireExecutorLocks(List *stmt_list, bool acquire)
 	}
 }
 
+/*
+ * AcquirePartitionLocks: acquire locks on the partitions of a cached plan
+ * that survive initial pruning with the given parameter values.
+ *
+ * With thousands of partitions, locking them all would cost far more than
+ * running a query that only needs one.  This must be called after
+ * AcquireExecutorLocks has locked the rest of the plan, and only if the plan
+ * is still valid, since pruning needs to look at the partitioned tables.
+ * The executor locks any other partition it ends up scanning, should it
+ * prune differently.
+ *
+ * These locks are not released if the plan turns out to be invalid after
+ * all; they are simply held until the end of the transaction.
+ */
+static void
+AcquirePartitionLocks(List *stmt_list, ParamListInfo boundParams)
+{
+	ListCell   *lc;
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
+		Bitmapset  *relids;
+		int			rti;
+
+		if (plannedstmt->prunableRelids == NULL)
+			continue;
+
+		relids = ExecInitialPruningRelids(plannedstmt, boundParams);
+
+		rti = -1;
+		while ((rti = bms_next_member(relids, rti)) >= 0)
+		{
+			RangeTblEntry *rte = rt_fetch(rti, plannedstmt->rtable);
+
+			LockRelationOid(rte->relid, rte->rellockmode);
+		}
+		bms_free(relids);
+	}
+}
+
 /*
  * AcquirePlannerLocks: acquire locks needed for planning of a querytree list;
  * or release them if acquire is false.
@@ -1765,6 +2217,8 @@ PlanCacheRelCallback(Datum arg, Oid relid)
 {
 	dlist_iter	iter;
 
+	SharedPlanCacheInvalidateRel(relid);
+
 	dlist_foreach(iter, &saved_plan_list)
 	{
 		CachedPlanSource *plansource = dlist_container(CachedPlanSource,
@@ -1849,6 +2303,8 @@ PlanCacheObjectCallback(Datum arg, int cacheid, uint32 hashvalue)
 {
 	dlist_iter	iter;
 
+	SharedPlanCacheInvalidateObject(cacheid, hashvalue);
+
 	dlist_foreach(iter, &saved_plan_list)
 	{
 		CachedPlanSource *plansource = dlist_container(CachedPlanSource,
@@ -1956,6 +2412,8 @@ PlanCacheObjectCallback(Datum arg, int cacheid, uint32 hashvalue)
 static void
 PlanCacheSysCallback(Datum arg, int cacheid, uint32 hashvalue)
 {
+	/* none of the caches we're registered for are on shared catalogs */
+	SharedPlanCacheReset(MyDatabaseId);
 	ResetPlanCache();
 }
 
@@ -130,10 +130,24 @@ typedef struct relidcacheent
 {
 	Oid			reloid;
 	Relation	reldesc;
+	dlist_node	lru_elem;		/* member of RelationCacheLRU */
+	Size		size;			/* memory accounted to the entry */
 } RelIdCacheEnt;
 
 static HTAB *RelationIdCache;
 
+/*
+ * All relcache entries are also kept in an LRU list, most recently used
+ * first, so that unused entries can be evicted once relation_cache_max_size
+ * is exceeded.  RelationCacheSize is the total of their sizes, as estimated
+ * by RelationCacheEntrySize() when the entries were added.
+ */
+static dlist_head RelationCacheLRU = DLIST_STATIC_INIT(RelationCacheLRU);
+static Size RelationCacheSize = 0;
+
+/* GUC variable: limit on RelationCacheSize, in kB, or 0 for no limit */
+int			relation_cache_max_size = 0;
+
 /*
  * This flag is false until we have prepared the critical relcache entries
  * that are needed to do indexscans on the tables read by relcache building.
@@ -206,9 +220,16 @@ do { \
 		else if (!IsBootstrapProcessingMode()) \
 			elog(WARNING, "leaking still-referenced relcache entry for \"%s\"", \
 				 RelationGetRelationName(_old_rel)); \
+		RelationCacheSize -= hentry->size; \
+		dlist_move_head(&RelationCacheLRU, &hentry->lru_elem); \
 	} \
 	else \
+	{ \
 		hentry->reldesc = (RELATION); \
+		dlist_push_head(&RelationCacheLRU, &hentry->lru_elem); \
+	} \
+	hentry->size = RelationCacheEntrySize(RELATION); \
+	RelationCacheSize += hentry->size; \
 } while(0)
 
 #define RelationIdCacheLookup(ID, RELATION) \
@@ -232,6 +253,12 @@ do { \
 	if (hentry == NULL) \
 		elog(WARNING, "failed to delete relcache entry for OID %u", \
 			 (RELATION)->rd_id); \
+	else \
+	{ \
+		/* the removed entry stays valid until the next hash_search */ \
+		dlist_delete(&hentry->lru_elem); \
+		RelationCacheSize -= hentry->size; \
+	} \
 } while(0)
 
 
@@ -258,6 +285,8 @@ static HTAB *OpClassCache = NULL;
 
 static void RelationDestroyRelation(Relation relation, bool remember_tupdesc);
 static void RelationClearRelation(Relation relation, bool rebuild);
+static Size RelationCacheEntrySize(Relation relation);
+static void RelationCachePrune(void);
 
 static void RelationReloadIndexInfo(Relation relation);
 static void RelationReloadNailed(Relation relation);
@@ -1131,6 +1160,10 @@ RelationBuildDesc(Oid targetRelId, bool insertIt)
 				relation->rd_islocaltemp = false;
 			}
 			break;
+		case RELPERSISTENCE_GLOBAL_TEMP:
+			relation->rd_backend = BackendIdForTempRelations();
+			relation->rd_islocaltemp = true;
+			break;
 		default:
 			elog(ERROR, "invalid relpersistence: %c",
 				 relation->rd_rel->relpersistence);
@@ -1990,6 +2023,7 @@ formrdesc(const char *relationName, Oid relationReltype,
 Relation
 RelationIdGetRelation(Oid relationId)
 {
+	RelIdCacheEnt *hentry;
 	Relation	rd;
 
 	/* Make sure we're in an xact, even if this ends up being a cache hit */
@@ -1998,10 +2032,15 @@ RelationIdGetRelation(Oid relationId)
 	/*
 	 * first try to find reldesc in the cache
 	 */
-	RelationIdCacheLookup(relationId, rd);
+	hentry = (RelIdCacheEnt *) hash_search(RelationIdCache,
+										   (void *) &relationId,
+										   HASH_FIND, NULL);
+	rd = hentry ? hentry->reldesc : NULL;
 
 	if (RelationIsValid(rd))
 	{
+		dlist_move_head(&RelationCacheLRU, &hentry->lru_elem);
+
 		RelationIncrementReferenceCount(rd);
 		/* revalidate cache entry if necessary */
 		if (!rd->rd_isvalid)
@@ -2377,6 +2416,39 @@ RelationDestroyRelation(Relation relation, bool remember_tupdesc)
 	pfree(relation);
 }
 
+/*
+ * RelationCacheEntrySize
+ *
+ *	Estimate the memory used by a relcache entry, for relation_cache_max_size.
+ *	This counts the fixed parts and the entry's private memory contexts;
+ *	smaller pieces allocated directly in CacheMemoryContext, and data that's
+ *	loaded later on demand into those, are left out.
+ */
+static Size
+RelationCacheEntrySize(Relation relation)
+{
+	Size		size = sizeof(RelationData);
+
+	if (relation->rd_rel)
+		size += CLASS_TUPLE_SIZE;
+	if (relation->rd_att)
+		size += TupleDescSize(relation->rd_att);
+	if (relation->rd_indexcxt)
+		size += MemoryContextMemAllocated(relation->rd_indexcxt, true);
+	if (relation->rd_rulescxt)
+		size += MemoryContextMemAllocated(relation->rd_rulescxt, true);
+	if (relation->rd_rsdesc)
+		size += MemoryContextMemAllocated(relation->rd_rsdesc->rscxt, true);
+	if (relation->rd_partkeycxt)
+		size += MemoryContextMemAllocated(relation->rd_partkeycxt, true);
+	if (relation->rd_pdcxt)
+		size += MemoryContextMemAllocated(relation->rd_pdcxt, true);
+	if (relation->rd_partcheckcxt)
+		size += MemoryContextMemAllocated(relation->rd_partcheckcxt, true);
+
+	return size;
+}
+
 /*
  * RelationClearRelation
  *
@@ -2601,6 +2673,8 @@ RelationClearRelation(Relation relation, bool rebuild)
 		/* creation sub-XIDs must be preserved */
 		SWAPFIELD(SubTransactionId, rd_createSubid);
 		SWAPFIELD(SubTransactionId, rd_newRelfilenodeSubid);
+		/* global temp rels never change storage, so this remains valid */
+		SWAPFIELD(bool, rd_localstorage);
 		/* un-swap rd_rel pointers, swap contents instead */
 		SWAPFIELD(Form_pg_class, rd_rel);
 		/* ... but actually, we don't have to update newrel->rd_rel */
@@ -2619,6 +2693,8 @@ RelationClearRelation(Relation relation, bool rebuild)
 		SWAPFIELD(Oid, rd_toastoid);
 		/* pgstat_info must be preserved */
 		SWAPFIELD(struct PgStat_TableStatus *, pgstat_info);
+		/* preserve the heap's update history */
+		SWAPFIELD(float4, rd_update_spill);
 		/* preserve old partitioning info if no logical change */
 		if (keep_partkey)
 		{
@@ -2989,6 +3065,53 @@ AtEOXact_RelationCache(bool isCommit)
 	eoxact_list_overflowed = false;
 	NextEOXactTupleDescNum = 0;
 	EOXactTupleDescArrayLen = 0;
+
+	/* Trim the cache, now that no relations are open */
+	if (relation_cache_max_size > 0 &&
+		RelationCacheSize > (Size) relation_cache_max_size * 1024)
+		RelationCachePrune();
+}
+
+/*
+ * RelationCachePrune
+ *
+ *	Evict least recently used relcache entries until the total size is
+ *	within relation_cache_max_size.
+ *
+ * This is done only at main-transaction end: while a transaction is running,
+ * code may hold on to relcache entries without a reference count across
+ * operations that could build new ones, such as around a hash_seq_search()
+ * of the cache.  At this point, entries that have a zero refcount are
+ * really unused.  Nailed entries, and entries that must survive for the
+ * sake of transaction-local state, are kept.
+ */
+static void
+RelationCachePrune(void)
+{
+	Size		limit = (Size) relation_cache_max_size * 1024;
+	dlist_node *cur;
+
+	if (!criticalRelcachesBuilt || !criticalSharedRelcachesBuilt ||
+		dlist_is_empty(&RelationCacheLRU))
+		return;
+
+	cur = dlist_tail_node(&RelationCacheLRU);
+	while (RelationCacheSize > limit && cur != &RelationCacheLRU.head)
+	{
+		RelIdCacheEnt *hentry = dlist_container(RelIdCacheEnt, lru_elem, cur);
+		Relation	relation = hentry->reldesc;
+
+		/* step before removing, as that unlinks the entry */
+		cur = cur->prev;
+
+		if (!RelationHasReferenceCountZero(relation) ||
+			relation->rd_isnailed ||
+			relation->rd_createSubid != InvalidSubTransactionId ||
+			relation->rd_newRelfilenodeSubid != InvalidSubTransactionId)
+			continue;
+
+		RelationClearRelation(relation, false);
+	}
 }
 
 /*
@@ -3312,6 +3435,10 @@ RelationBuildLocalRelation(const char *relname,
 			rel->rd_backend = BackendIdForTempRelations();
 			rel->rd_islocaltemp = true;
 			break;
+		case RELPERSISTENCE_GLOBAL_TEMP:
+			rel->rd_backend = BackendIdForTempRelations();
+			rel->rd_islocaltemp = true;
+			break;
 		default:
 			elog(ERROR, "invalid relpersistence: %c", relpersistence);
 			break;
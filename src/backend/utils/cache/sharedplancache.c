@@ -0,0 +1,807 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.c
+ *	  Generic plans shared across backends.
+ *
+ * With shared_plan_cache_size set, a backend that builds a generic plan for
+ * a saved CachedPlanSource also stores a copy of it in shared memory, where
+ * other backends preparing the same statement can find it instead of
+ * planning it again.  Entries are keyed by database, current user and a
+ * hash of the query string, parameter types, cursor options, row security
+ * setting and effective search_path; all of those are compared in full on
+ * lookup, as are the OIDs of the relations the analyzed query refers to.
+ * The plans themselves are stored as nodeToString() output in a DSA area
+ * created in the main shared memory segment, in the same way parallel query
+ * ships plans to its workers.
+ *
+ * Invalidation piggybacks on plancache.c's sinval callbacks: each backend
+ * that processes an invalidation event removes the shared entries that
+ * depend on the invalidated object.  Every catalog change that requires
+ * replanning is seen by the backend that made it, when it processes its own
+ * invalidation messages, so no entry can survive a change of an object it
+ * depends on.  To close the window in which an entry is looked up before an
+ * invalidation is processed, the caller locks the plan's relations and then
+ * checks with SharedPlanCacheRecheck() that the entry is still present, just
+ * as CheckCachedPlan() does for a local generic plan.
+ *
+ * Plans are not shared during recovery, where invalidations arrive only
+ * through the sinval queue and are ignored by backends connected to other
+ * databases; nor by backends that have a temporary namespace, whose name
+ * lookups can differ from those of other backends.
+ *
+ * When the area or the entry table is full, the least recently used entries
+ * are evicted.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/cache/sharedplancache.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/xlog.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_class.h"
+#include "miscadmin.h"
+#include "nodes/parsenodes.h"
+#include "nodes/plannodes.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/dsa.h"
+#include "utils/hashutils.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/sharedplancache.h"
+
+
+/* GUC variable: size of the shared plan cache, in kB, or 0 to disable it */
+int			shared_plan_cache_size = 0;
+
+/* We allow one entry for each this many bytes of the area */
+#define SHARED_PLAN_BYTES_PER_ENTRY		4096
+
+typedef struct SharedPlanKey
+{
+	Oid			dbid;			/* database the plan was made in */
+	Oid			userid;			/* user it was made for */
+	uint64		hash;			/* hash of the rest of the identity */
+} SharedPlanKey;
+
+typedef struct SharedPlanEntry
+{
+	SharedPlanKey key;			/* hash key of entry - MUST BE FIRST */
+	uint64		generation;		/* distinguishes successive entries */
+	pg_atomic_uint64 last_used; /* clock value at last lookup */
+	uint64		relmask;		/* bit (relid % 64) set for each relation */
+	uint64		itemmask;		/* bit (hashValue % 64) for each inval item */
+	dsa_pointer data;			/* SharedPlanData, in SharedPlanArea */
+} SharedPlanEntry;
+
+typedef struct SharedPlanItem
+{
+	int			cacheId;		/* PlanInvalItem contents */
+	uint32		hashValue;
+} SharedPlanItem;
+
+/*
+ * Variable-length data of an entry.  The header is followed by the arrays
+ * and strings listed, in this order.
+ */
+typedef struct SharedPlanData
+{
+	int			cursor_options;
+	bool		row_security;
+	int			num_params;		/* Oid param_types[] */
+	int			num_path;		/* Oid search_path[] */
+	int			num_query_rels; /* Oid query_rels[] (of the analyzed query) */
+	int			num_rels;		/* Oid rels[] (of the plans) */
+	int			num_items;		/* SharedPlanItem items[] */
+	int			query_len;		/* char query_string[], with terminator */
+	Size		plan_len;		/* char plan[], with terminator */
+} SharedPlanData;
+
+typedef struct SharedPlanCacheShmemStruct
+{
+	LWLock		lock;			/* protects the hash table and the area */
+	pg_atomic_uint64 clock;		/* for generations and LRU */
+	/* the DSA area follows */
+} SharedPlanCacheShmemStruct;
+
+#define SharedPlanDSAPlace() \
+	((char *) SharedPlanCache + MAXALIGN(sizeof(SharedPlanCacheShmemStruct)))
+
+/*
+ * The identity of a plansource in the current environment, as computed by
+ * SharedPlanIdentityInit().
+ */
+typedef struct SharedPlanIdentity
+{
+	SharedPlanKey key;
+	CachedPlanSource *plansource;
+	Oid		   *path;
+	int			num_path;
+} SharedPlanIdentity;
+
+static SharedPlanCacheShmemStruct *SharedPlanCache = NULL;
+static HTAB *SharedPlanHash = NULL;
+static dsa_area *SharedPlanArea = NULL;
+
+static void SharedPlanIdentityInit(SharedPlanIdentity *id,
+								   CachedPlanSource *plansource);
+static bool SharedPlanIdentityMatches(SharedPlanIdentity *id,
+									  SharedPlanData *data);
+static void SharedPlanCacheAttach(void);
+static void SharedPlanRemoveEntry(SharedPlanEntry *entry);
+static bool SharedPlanEvictOne(void);
+
+
+/*
+ * Number of entries the hash table is allowed to hold.
+ */
+static long
+SharedPlanCacheMaxEntries(void)
+{
+	return Max((long) shared_plan_cache_size * 1024 /
+			   SHARED_PLAN_BYTES_PER_ENTRY, 64);
+}
+
+/*
+ * Size of the DSA area.
+ */
+static Size
+SharedPlanDSASize(void)
+{
+	return Max((Size) shared_plan_cache_size * 1024, dsa_minimum_size());
+}
+
+/*
+ * SharedPlanCacheShmemSize
+ *		Compute the space needed for the shared plan cache.
+ */
+Size
+SharedPlanCacheShmemSize(void)
+{
+	Size		size;
+
+	if (shared_plan_cache_size == 0)
+		return 0;
+
+	size = MAXALIGN(sizeof(SharedPlanCacheShmemStruct));
+	size = add_size(size, SharedPlanDSASize());
+	size = add_size(size, hash_estimate_size(SharedPlanCacheMaxEntries(),
+											 sizeof(SharedPlanEntry)));
+
+	return size;
+}
+
+/*
+ * SharedPlanCacheShmemInit
+ *		Create the shared plan cache during postmaster startup (or in a
+ *		standalone backend).
+ */
+void
+SharedPlanCacheShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (shared_plan_cache_size == 0)
+		return;
+
+	SharedPlanCache = (SharedPlanCacheShmemStruct *)
+		ShmemInitStruct("Shared Plan Cache",
+						MAXALIGN(sizeof(SharedPlanCacheShmemStruct)) +
+						SharedPlanDSASize(),
+						&found);
+
+	if (!found)
+	{
+		dsa_area   *area;
+
+		LWLockInitialize(&SharedPlanCache->lock, LWTRANCHE_SHARED_PLAN_CACHE);
+		pg_atomic_init_u64(&SharedPlanCache->clock, 0);
+
+		/*
+		 * The area must never need DSM segments, as they could not be
+		 * created in the postmaster, and backends attach to the in-place
+		 * area only.
+		 */
+		area = dsa_create_in_place(SharedPlanDSAPlace(), SharedPlanDSASize(),
+								   LWTRANCHE_SHARED_PLAN_CACHE_DSA, NULL);
+		dsa_pin(area);
+		dsa_set_size_limit(area, SharedPlanDSASize());
+		dsa_detach(area);
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(SharedPlanKey);
+	info.entrysize = sizeof(SharedPlanEntry);
+	SharedPlanHash = ShmemInitHash("Shared Plan Cache Hash",
+								   SharedPlanCacheMaxEntries(),
+								   SharedPlanCacheMaxEntries(),
+								   &info,
+								   HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * Attach to the DSA area, if not done yet.
+ *
+ * The area is pinned and never extends beyond its in-place segment, so
+ * there's nothing to release when the backend exits.
+ */
+static void
+SharedPlanCacheAttach(void)
+{
+	MemoryContext oldcontext;
+
+	if (SharedPlanArea != NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	SharedPlanArea = dsa_attach_in_place(SharedPlanDSAPlace(), NULL);
+	dsa_pin_mapping(SharedPlanArea);
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * SharedPlanCacheEligible
+ *		Can the generic plan of this plansource be shared?
+ *
+ * Utility statements are excluded because their parse trees don't all have
+ * node read/write support, and one-shot or unsaved plansources because they
+ * won't be reused.
+ */
+bool
+SharedPlanCacheEligible(CachedPlanSource *plansource,
+						QueryEnvironment *queryEnv)
+{
+	Oid			tempNamespaceId;
+	Oid			tempToastNamespaceId;
+	ListCell   *lc;
+
+	if (SharedPlanCache == NULL)
+		return false;
+
+	if (!plansource->is_saved || plansource->is_oneshot ||
+		plansource->raw_parse_tree == NULL || queryEnv != NULL)
+		return false;
+
+	if (RecoveryInProgress())
+		return false;
+
+	GetTempNamespaceState(&tempNamespaceId, &tempToastNamespaceId);
+	if (OidIsValid(tempNamespaceId))
+		return false;
+
+	foreach(lc, plansource->query_list)
+	{
+		Query	   *query = lfirst_node(Query, lc);
+
+		if (query->commandType == CMD_UTILITY)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Compute the identity of the plansource in the current environment.
+ */
+static void
+SharedPlanIdentityInit(SharedPlanIdentity *id, CachedPlanSource *plansource)
+{
+	uint64		hash;
+	int			num_path;
+
+	/* the temp namespace isn't included, but we don't get here if we have one */
+	num_path = fetch_search_path_array(NULL, 0);
+	id->path = (Oid *) palloc(Max(num_path, 1) * sizeof(Oid));
+	id->num_path = fetch_search_path_array(id->path, num_path);
+	Assert(id->num_path == num_path);
+	id->plansource = plansource;
+
+	hash = DatumGetUInt64(hash_any_extended((const unsigned char *) plansource->query_string,
+											strlen(plansource->query_string),
+											0));
+	if (plansource->num_params > 0)
+		hash = DatumGetUInt64(hash_any_extended((const unsigned char *) plansource->param_types,
+												plansource->num_params * sizeof(Oid),
+												hash));
+	hash = DatumGetUInt64(hash_any_extended((const unsigned char *) id->path,
+											id->num_path * sizeof(Oid),
+											hash));
+	hash = DatumGetUInt64(hash_uint32_extended((uint32) plansource->cursor_options,
+											   hash));
+	hash = DatumGetUInt64(hash_uint32_extended((uint32) plansource->rewriteRowSecurity,
+											   hash));
+
+	memset(&id->key, 0, sizeof(SharedPlanKey));
+	id->key.dbid = MyDatabaseId;
+	id->key.userid = GetUserId();
+	id->key.hash = hash;
+}
+
+/*
+ * Does a stored entry match the given identity?
+ */
+static bool
+SharedPlanIdentityMatches(SharedPlanIdentity *id, SharedPlanData *data)
+{
+	CachedPlanSource *plansource = id->plansource;
+	char	   *p = (char *) data + MAXALIGN(sizeof(SharedPlanData));
+	ListCell   *lc;
+	Oid		   *query_rels;
+	int			i;
+
+	if (data->cursor_options != plansource->cursor_options ||
+		data->row_security != plansource->rewriteRowSecurity ||
+		data->num_params != plansource->num_params ||
+		data->num_path != id->num_path ||
+		data->num_query_rels != list_length(plansource->relationOids) ||
+		data->query_len != strlen(plansource->query_string) + 1)
+		return false;
+
+	if (data->num_params > 0 &&
+		memcmp(p, plansource->param_types, data->num_params * sizeof(Oid)) != 0)
+		return false;
+	p += data->num_params * sizeof(Oid);
+
+	if (memcmp(p, id->path, data->num_path * sizeof(Oid)) != 0)
+		return false;
+	p += data->num_path * sizeof(Oid);
+
+	query_rels = (Oid *) p;
+	i = 0;
+	foreach(lc, plansource->relationOids)
+	{
+		if (query_rels[i++] != lfirst_oid(lc))
+			return false;
+	}
+	p += data->num_query_rels * sizeof(Oid);
+
+	p += data->num_rels * sizeof(Oid);
+	p += data->num_items * sizeof(SharedPlanItem);
+
+	return strcmp(p, plansource->query_string) == 0;
+}
+
+/*
+ * SharedPlanCacheLookup
+ *		Look for a shared generic plan for the plansource.
+ *
+ * Returns the list of PlannedStmts, built in the current memory context, or
+ * NIL if there's none.  *generation is set to identify the entry for
+ * SharedPlanCacheRecheck().
+ */
+List *
+SharedPlanCacheLookup(CachedPlanSource *plansource, uint64 *generation)
+{
+	SharedPlanIdentity id;
+	SharedPlanEntry *entry;
+	char	   *planstr = NULL;
+	List	   *stmt_list;
+
+	SharedPlanIdentityInit(&id, plansource);
+	SharedPlanCacheAttach();
+
+	LWLockAcquire(&SharedPlanCache->lock, LW_SHARED);
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &id.key,
+											HASH_FIND, NULL);
+	if (entry)
+	{
+		SharedPlanData *data = dsa_get_address(SharedPlanArea, entry->data);
+
+		if (SharedPlanIdentityMatches(&id, data))
+		{
+			char	   *p = (char *) data + MAXALIGN(sizeof(SharedPlanData)) +
+			(data->num_params + data->num_path + data->num_query_rels +
+			 data->num_rels) * sizeof(Oid) +
+			data->num_items * sizeof(SharedPlanItem) +
+			data->query_len;
+
+			planstr = palloc(data->plan_len);
+			memcpy(planstr, p, data->plan_len);
+			*generation = entry->generation;
+			pg_atomic_write_u64(&entry->last_used,
+								pg_atomic_fetch_add_u64(&SharedPlanCache->clock, 1));
+		}
+	}
+
+	LWLockRelease(&SharedPlanCache->lock);
+
+	pfree(id.path);
+
+	if (planstr == NULL)
+		return NIL;
+
+	stmt_list = (List *) stringToNode(planstr);
+	pfree(planstr);
+
+	return stmt_list;
+}
+
+/*
+ * SharedPlanCacheRecheck
+ *		Is the entry returned by SharedPlanCacheLookup() still there?
+ *
+ * The caller should have locked the plan's relations first, so that any
+ * pending invalidations affecting it have been processed.
+ */
+bool
+SharedPlanCacheRecheck(CachedPlanSource *plansource, uint64 generation)
+{
+	SharedPlanIdentity id;
+	SharedPlanEntry *entry;
+	bool		result;
+
+	SharedPlanIdentityInit(&id, plansource);
+
+	LWLockAcquire(&SharedPlanCache->lock, LW_SHARED);
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &id.key,
+											HASH_FIND, NULL);
+	result = (entry != NULL && entry->generation == generation);
+	LWLockRelease(&SharedPlanCache->lock);
+
+	pfree(id.path);
+
+	return result;
+}
+
+/*
+ * SharedPlanCacheStore
+ *		Store a newly built generic plan of the plansource.
+ *
+ * Plans that are transient, that involve temporary relations or that
+ * include nodes other backends might not be able to read back are not
+ * stored.
+ */
+void
+SharedPlanCacheStore(CachedPlanSource *plansource, List *stmt_list)
+{
+	SharedPlanIdentity id;
+	List	   *rels = NIL;
+	List	   *items = NIL;
+	uint64		relmask = 0;
+	uint64		itemmask = 0;
+	char	   *planstr;
+	Size		plan_len;
+	Size		size;
+	dsa_pointer dp;
+	SharedPlanData *data;
+	SharedPlanEntry *entry;
+	bool		found;
+	char	   *p;
+	ListCell   *lc;
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt *plannedstmt = lfirst_node(PlannedStmt, lc);
+		ListCell   *lc2;
+
+		if (plannedstmt->commandType == CMD_UTILITY ||
+			plannedstmt->transientPlan)
+			return;
+
+		foreach(lc2, plannedstmt->relationOids)
+		{
+			Oid			relid = lfirst_oid(lc2);
+
+			char		relpersistence = get_rel_persistence(relid);
+
+			if (relpersistence == RELPERSISTENCE_TEMP ||
+				relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+				return;
+			rels = lappend_oid(rels, relid);
+			relmask |= UINT64CONST(1) << (relid % 64);
+		}
+		foreach(lc2, plannedstmt->invalItems)
+		{
+			PlanInvalItem *item = lfirst_node(PlanInvalItem, lc2);
+
+			items = lappend(items, item);
+			itemmask |= UINT64CONST(1) << (item->hashValue % 64);
+		}
+	}
+
+	planstr = nodeToString(stmt_list);
+
+	/*
+	 * Reading back custom scan nodes requires the provider to be loaded, and
+	 * extensible nodes the extension, which may not be the case in another
+	 * backend.  This crude check can have false positives, which only means
+	 * that such a plan isn't shared.
+	 */
+	if (strstr(planstr, "{CUSTOMSCAN") != NULL ||
+		strstr(planstr, "{EXTENSIBLENODE") != NULL)
+	{
+		pfree(planstr);
+		return;
+	}
+	plan_len = strlen(planstr) + 1;
+
+	SharedPlanIdentityInit(&id, plansource);
+
+	size = MAXALIGN(sizeof(SharedPlanData)) +
+		(plansource->num_params + id.num_path +
+		 list_length(plansource->relationOids) +
+		 list_length(rels)) * sizeof(Oid) +
+		list_length(items) * sizeof(SharedPlanItem) +
+		strlen(plansource->query_string) + 1 +
+		plan_len;
+
+	SharedPlanCacheAttach();
+
+	LWLockAcquire(&SharedPlanCache->lock, LW_EXCLUSIVE);
+
+	/* Someone may have stored a plan for this meanwhile; replace it */
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &id.key,
+											HASH_FIND, NULL);
+	if (entry)
+		SharedPlanRemoveEntry(entry);
+
+	/* Make room */
+	while (hash_get_num_entries(SharedPlanHash) >= SharedPlanCacheMaxEntries())
+	{
+		if (!SharedPlanEvictOne())
+			break;
+	}
+	for (;;)
+	{
+		dp = dsa_allocate_extended(SharedPlanArea, size, DSA_ALLOC_NO_OOM);
+		if (DsaPointerIsValid(dp) || !SharedPlanEvictOne())
+			break;
+	}
+	if (!DsaPointerIsValid(dp))
+	{
+		LWLockRelease(&SharedPlanCache->lock);
+		goto done;
+	}
+
+	entry = (SharedPlanEntry *) hash_search(SharedPlanHash, &id.key,
+											HASH_ENTER_NULL, &found);
+	if (entry == NULL)
+	{
+		dsa_free(SharedPlanArea, dp);
+		LWLockRelease(&SharedPlanCache->lock);
+		goto done;
+	}
+	Assert(!found);
+
+	data = dsa_get_address(SharedPlanArea, dp);
+	data->cursor_options = plansource->cursor_options;
+	data->row_security = plansource->rewriteRowSecurity;
+	data->num_params = plansource->num_params;
+	data->num_path = id.num_path;
+	data->num_query_rels = list_length(plansource->relationOids);
+	data->num_rels = list_length(rels);
+	data->num_items = list_length(items);
+	data->query_len = strlen(plansource->query_string) + 1;
+	data->plan_len = plan_len;
+
+	p = (char *) data + MAXALIGN(sizeof(SharedPlanData));
+	if (plansource->num_params > 0)
+		memcpy(p, plansource->param_types, plansource->num_params * sizeof(Oid));
+	p += plansource->num_params * sizeof(Oid);
+	memcpy(p, id.path, id.num_path * sizeof(Oid));
+	p += id.num_path * sizeof(Oid);
+	foreach(lc, plansource->relationOids)
+	{
+		Oid			relid = lfirst_oid(lc);
+
+		memcpy(p, &relid, sizeof(Oid));
+		p += sizeof(Oid);
+	}
+	foreach(lc, rels)
+	{
+		Oid			relid = lfirst_oid(lc);
+
+		memcpy(p, &relid, sizeof(Oid));
+		p += sizeof(Oid);
+	}
+	foreach(lc, items)
+	{
+		PlanInvalItem *item = (PlanInvalItem *) lfirst(lc);
+		SharedPlanItem sitem;
+
+		sitem.cacheId = item->cacheId;
+		sitem.hashValue = item->hashValue;
+		memcpy(p, &sitem, sizeof(SharedPlanItem));
+		p += sizeof(SharedPlanItem);
+	}
+	memcpy(p, plansource->query_string, data->query_len);
+	p += data->query_len;
+	memcpy(p, planstr, plan_len);
+
+	entry->generation = pg_atomic_fetch_add_u64(&SharedPlanCache->clock, 1);
+	pg_atomic_init_u64(&entry->last_used, entry->generation);
+	entry->relmask = relmask;
+	entry->itemmask = itemmask;
+	entry->data = dp;
+
+	LWLockRelease(&SharedPlanCache->lock);
+
+done:
+	pfree(planstr);
+	pfree(id.path);
+	list_free(rels);
+	list_free(items);
+}
+
+/*
+ * Remove an entry.  Caller must hold the lock exclusively.
+ */
+static void
+SharedPlanRemoveEntry(SharedPlanEntry *entry)
+{
+	dsa_free(SharedPlanArea, entry->data);
+	hash_search(SharedPlanHash, &entry->key, HASH_REMOVE, NULL);
+}
+
+/*
+ * Evict the least recently used entry.  Returns false if there is none.
+ * Caller must hold the lock exclusively.
+ */
+static bool
+SharedPlanEvictOne(void)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanEntry *entry;
+	SharedPlanEntry *victim = NULL;
+	uint64		victim_used = PG_UINT64_MAX;
+
+	hash_seq_init(&status, SharedPlanHash);
+	while ((entry = (SharedPlanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		uint64		used = pg_atomic_read_u64(&entry->last_used);
+
+		if (used < victim_used)
+		{
+			victim = entry;
+			victim_used = used;
+		}
+	}
+
+	if (victim == NULL)
+		return false;
+
+	SharedPlanRemoveEntry(victim);
+	return true;
+}
+
+/*
+ * SharedPlanCacheInvalidateRel
+ *		Remove entries that depend on the given relation, or all entries if
+ *		relid is InvalidOid.
+ *
+ * Note: entries of all databases are checked, since the relation could be a
+ * shared catalog.  A false match on a relation of another database only
+ * costs a replan.
+ */
+void
+SharedPlanCacheInvalidateRel(Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanEntry *entry;
+	uint64		mask = UINT64CONST(1) << (relid % 64);
+
+	if (SharedPlanCache == NULL)
+		return;
+
+	SharedPlanCacheAttach();
+
+	LWLockAcquire(&SharedPlanCache->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedPlanHash);
+	while ((entry = (SharedPlanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		SharedPlanData *data;
+		Oid		   *rels;
+		int			i;
+
+		if (OidIsValid(relid))
+		{
+			if ((entry->relmask & mask) == 0)
+				continue;
+
+			data = dsa_get_address(SharedPlanArea, entry->data);
+			rels = (Oid *) ((char *) data + MAXALIGN(sizeof(SharedPlanData)) +
+							(data->num_params + data->num_path +
+							 data->num_query_rels) * sizeof(Oid));
+			for (i = 0; i < data->num_rels; i++)
+			{
+				if (rels[i] == relid)
+					break;
+			}
+			if (i == data->num_rels)
+				continue;
+		}
+
+		SharedPlanRemoveEntry(entry);
+	}
+
+	LWLockRelease(&SharedPlanCache->lock);
+}
+
+/*
+ * SharedPlanCacheInvalidateObject
+ *		Remove entries that depend on the object with the given syscache
+ *		hash value, or on any member of the cache if hashvalue is 0.
+ */
+void
+SharedPlanCacheInvalidateObject(int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanEntry *entry;
+	uint64		mask = UINT64CONST(1) << (hashvalue % 64);
+
+	if (SharedPlanCache == NULL)
+		return;
+
+	SharedPlanCacheAttach();
+
+	LWLockAcquire(&SharedPlanCache->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedPlanHash);
+	while ((entry = (SharedPlanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		SharedPlanData *data;
+		SharedPlanItem *items;
+		int			i;
+
+		if (hashvalue != 0 && (entry->itemmask & mask) == 0)
+			continue;
+
+		data = dsa_get_address(SharedPlanArea, entry->data);
+		items = (SharedPlanItem *) ((char *) data + MAXALIGN(sizeof(SharedPlanData)) +
+									(data->num_params + data->num_path +
+									 data->num_query_rels +
+									 data->num_rels) * sizeof(Oid));
+		for (i = 0; i < data->num_items; i++)
+		{
+			if (items[i].cacheId == cacheid &&
+				(hashvalue == 0 || items[i].hashValue == hashvalue))
+				break;
+		}
+		if (i == data->num_items)
+			continue;
+
+		SharedPlanRemoveEntry(entry);
+	}
+
+	LWLockRelease(&SharedPlanCache->lock);
+}
+
+/*
+ * SharedPlanCacheReset
+ *		Remove all entries of the given database, or of all databases if
+ *		dbid is InvalidOid.
+ */
+void
+SharedPlanCacheReset(Oid dbid)
+{
+	HASH_SEQ_STATUS status;
+	SharedPlanEntry *entry;
+
+	if (SharedPlanCache == NULL)
+		return;
+
+	SharedPlanCacheAttach();
+
+	LWLockAcquire(&SharedPlanCache->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&status, SharedPlanHash);
+	while ((entry = (SharedPlanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (!OidIsValid(dbid) || entry->key.dbid == dbid)
+			SharedPlanRemoveEntry(entry);
+	}
+
+	LWLockRelease(&SharedPlanCache->lock);
+}
@@ -1466,6 +1466,23 @@ SysCacheInvalidate(int cacheId, uint32 hashValue)
 	CatCacheInvalidate(SysCache[cacheId], hashValue);
 }
 
+/*
+ * SysCacheReset
+ *	Flush all entries of one system cache.
+ */
+void
+SysCacheReset(int cacheId)
+{
+	if (cacheId < 0 || cacheId >= SysCacheSize)
+		elog(ERROR, "invalid cache ID: %d", cacheId);
+
+	/* if this cache isn't initialized yet, no need to do anything */
+	if (!PointerIsValid(SysCache[cacheId]))
+		return;
+
+	ResetCatalogCache(SysCache[cacheId]);
+}
+
 /*
  * Certain relations that do not have system caches send snapshot invalidation
  * messages in lieu of catcache messages.  This is for the benefit of
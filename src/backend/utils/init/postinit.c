@@ -54,8 +54,10 @@
 #include "storage/sync.h"
 #include "tcop/tcopprot.h"
 #include "utils/acl.h"
+#include "utils/ash.h"
 #include "utils/fmgroids.h"
 #include "utils/guc.h"
+#include "utils/memlimit.h"
 #include "utils/memutils.h"
 #include "utils/pg_locale.h"
 #include "utils/portal.h"
@@ -74,6 +76,7 @@ static void ShutdownPostgres(int code, Datum arg);
 static void StatementTimeoutHandler(void);
 static void LockTimeoutHandler(void);
 static void IdleInTransactionSessionTimeoutHandler(void);
+static void IdleCacheReleaseTimeoutHandler(void);
 static bool ThereIsAtLeastOneRole(void);
 static void process_startup_options(Port *port, bool am_superuser);
 static void process_settings(Oid databaseid, Oid roleid);
@@ -556,6 +559,9 @@ BaseInit(void)
 	InitCommunication();
 	DebugFileOpen();
 
+	/* Start publishing our memory usage for max_total_backend_memory */
+	MemoryLimitAttach();
+
 	/* Do local initialization of file, storage and buffer managers */
 	InitFileAccess();
 	InitSync();
@@ -633,6 +639,9 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 		RegisterTimeout(LOCK_TIMEOUT, LockTimeoutHandler);
 		RegisterTimeout(IDLE_IN_TRANSACTION_SESSION_TIMEOUT,
 						IdleInTransactionSessionTimeoutHandler);
+		RegisterTimeout(IDLE_CACHE_RELEASE_TIMEOUT,
+						IdleCacheReleaseTimeoutHandler);
+		RegisterTimeout(ASH_SAMPLE_TIMEOUT, AshSampleTimeoutHandler);
 	}
 
 	/*
@@ -699,10 +708,11 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 	RelationCacheInitializePhase2();
 
 	/*
-	 * Set up process-exit callback to do pre-shutdown cleanup.  This is the
-	 * first before_shmem_exit callback we register; thus, this will be the
-	 * last thing we do before low-level modules like the buffer manager begin
-	 * to close down.  We need to have this in place before we begin our first
+	 * Set up process-exit callback to do pre-shutdown cleanup.  Apart from
+	 * pgstat's, which must flush the statistics of the final transaction,
+	 * this is the first before_shmem_exit callback we register; thus, this
+	 * will be the last thing we do before low-level modules like the buffer
+	 * manager begin to close down.  We need to have this in place before we begin our first
 	 * transaction --- if we fail during the initialization transaction, as is
 	 * entirely possible, we need the AbortTransaction call to clean up.
 	 */
@@ -1243,6 +1253,14 @@ IdleInTransactionSessionTimeoutHandler(void)
 	SetLatch(MyLatch);
 }
 
+static void
+IdleCacheReleaseTimeoutHandler(void)
+{
+	IdleCacheReleasePending = true;
+	InterruptPending = true;
+	SetLatch(MyLatch);
+}
+
 /*
  * Returns true if at least one role is defined in this database cluster.
  */
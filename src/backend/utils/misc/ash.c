@@ -0,0 +1,444 @@
+/*-------------------------------------------------------------------------
+ *
+ * ash.c
+ *	  Active session history: periodic sampling of running backends.
+ *
+ * pg_stat_activity shows what each backend is doing at the moment it is
+ * queried, which is too coarse to tell where the time of a busy server goes,
+ * while auto_explain with timing is too expensive to leave on.  With
+ * active_session_sample_interval set, each regular backend arms a repeating
+ * timeout while it is executing a command.  Every time the timeout fires,
+ * the handler records the backend's query ID, wait event and the plan node
+ * it is executing into a shared ring buffer of active_session_history_size
+ * entries, which pg_stat_active_session_history shows.  Aggregating those
+ * samples gives a cheap statistical picture of which statements, waits and
+ * plan nodes account for the server's time.
+ *
+ * The handler runs inside the SIGALRM handler, so it must not take locks or
+ * allocate memory.  Slots are claimed with an atomic counter, and each slot
+ * has a change count that is odd while the slot is being written, which
+ * readers use to skip torn entries.  A writer that finds the count odd
+ * (another backend lapped the ring while writing that slot) just drops its
+ * sample.
+ *
+ * The executor keeps the current plan node in AshCurrentNodeTag and
+ * AshCurrentNodeId, through a wrapper that ExecProcNodeFirst() installs
+ * only while sampling is enabled, so there is no cost otherwise.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/misc/ash.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/pg_authid.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/nodes.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/acl.h"
+#include "utils/ash.h"
+#include "utils/builtins.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+typedef struct AshSample
+{
+	pg_atomic_uint32 changecount;	/* odd while being written */
+	TimestampTz sample_time;	/* 0 if the slot was never used */
+	int			pid;
+	Oid			userid;
+	Oid			dbid;
+	uint64		query_id;
+	uint32		wait_event_info;
+	int			node_tag;		/* T_Invalid if not inside a plan node */
+	int			node_id;
+} AshSample;
+
+typedef struct AshShmemStruct
+{
+	pg_atomic_uint32 next;		/* next slot to write, modulo the size */
+	AshSample	samples[FLEXIBLE_ARRAY_MEMBER];
+} AshShmemStruct;
+
+/* GUC parameters */
+int			active_session_sample_interval = 0;
+int			active_session_history_size = 8192;
+
+volatile uint64 AshCurrentQueryId = 0;
+volatile int AshCurrentNodeTag = T_Invalid;
+volatile int AshCurrentNodeId = 0;
+
+static AshShmemStruct *AshShmem = NULL;
+
+/* is our sampling timeout currently enabled? */
+static bool sampling = false;
+
+
+/*
+ * AshShmemSize
+ *		Compute the space needed for the sample ring buffer.
+ */
+Size
+AshShmemSize(void)
+{
+	Size		size;
+
+	size = offsetof(AshShmemStruct, samples);
+	size = add_size(size, mul_size(active_session_history_size,
+								   sizeof(AshSample)));
+	return MAXALIGN(size);
+}
+
+/*
+ * AshShmemInit
+ *		Create or attach to the sample ring buffer.
+ */
+void
+AshShmemInit(void)
+{
+	bool		found;
+	int			i;
+
+	AshShmem = (AshShmemStruct *)
+		ShmemInitStruct("Active Session History",
+						AshShmemSize(),
+						&found);
+
+	if (!found)
+	{
+		pg_atomic_init_u32(&AshShmem->next, 0);
+		for (i = 0; i < active_session_history_size; i++)
+		{
+			AshSample  *sample = &AshShmem->samples[i];
+
+			pg_atomic_init_u32(&sample->changecount, 0);
+			sample->sample_time = 0;
+		}
+	}
+}
+
+/*
+ * AshStartSampling
+ *		Start sampling this backend, if enabled and not already running.
+ *
+ * Called for every message a backend receives from its client.  Sampling
+ * keeps its phase across the messages of an extended-protocol query, and
+ * only stops when the backend goes idle.
+ */
+void
+AshStartSampling(void)
+{
+	if (!sampling &&
+		active_session_sample_interval > 0 &&
+		active_session_history_size > 0)
+	{
+		enable_timeout_every(ASH_SAMPLE_TIMEOUT,
+							 TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+														 active_session_sample_interval),
+							 active_session_sample_interval);
+		sampling = true;
+	}
+}
+
+/*
+ * AshStopSampling
+ *		Stop sampling this backend.
+ *
+ * Called when a backend goes idle.  Also forgets what we were executing, in
+ * case an error prevented the executor from doing so.
+ */
+void
+AshStopSampling(void)
+{
+	if (sampling)
+	{
+		disable_timeout(ASH_SAMPLE_TIMEOUT, false);
+		sampling = false;
+	}
+
+	AshCurrentQueryId = 0;
+	AshCurrentNodeTag = T_Invalid;
+	AshCurrentNodeId = 0;
+}
+
+/*
+ * AshSampleTimeoutHandler
+ *		Record one sample of this backend's activity.
+ *
+ * This runs in the SIGALRM handler; see the comments at the top of the file.
+ */
+void
+AshSampleTimeoutHandler(void)
+{
+	AshSample  *sample;
+	uint32		slot;
+	uint32		changecount;
+
+	if (AshShmem == NULL || active_session_history_size <= 0)
+		return;
+
+	slot = pg_atomic_fetch_add_u32(&AshShmem->next, 1) %
+		active_session_history_size;
+	sample = &AshShmem->samples[slot];
+
+	/* Claim the slot, unless someone else is writing it */
+	changecount = pg_atomic_read_u32(&sample->changecount);
+	if ((changecount & 1) != 0 ||
+		!pg_atomic_compare_exchange_u32(&sample->changecount, &changecount,
+										changecount + 1))
+		return;
+
+	sample->sample_time = GetCurrentTimestamp();
+	sample->pid = MyProcPid;
+	sample->userid = GetSessionUserId();
+	sample->dbid = MyDatabaseId;
+	sample->query_id = AshCurrentQueryId;
+	sample->wait_event_info = MyProc ? MyProc->wait_event_info : 0;
+
+	/*
+	 * The executor clears the tag before changing the node ID, so a valid
+	 * tag always goes with the right ID.
+	 */
+	sample->node_tag = AshCurrentNodeTag;
+	sample->node_id = AshCurrentNodeId;
+
+	pg_write_barrier();
+	pg_atomic_fetch_add_u32(&sample->changecount, 1);
+}
+
+/*
+ * Name a plan node the way EXPLAIN does, from the tag of its PlanState.
+ */
+static const char *
+ash_plan_node_name(NodeTag tag)
+{
+	switch (tag)
+	{
+		case T_ResultState:
+			return "Result";
+		case T_ProjectSetState:
+			return "ProjectSet";
+		case T_ModifyTableState:
+			return "ModifyTable";
+		case T_AppendState:
+			return "Append";
+		case T_MergeAppendState:
+			return "Merge Append";
+		case T_RecursiveUnionState:
+			return "Recursive Union";
+		case T_BitmapAndState:
+			return "BitmapAnd";
+		case T_BitmapOrState:
+			return "BitmapOr";
+		case T_SeqScanState:
+			return "Seq Scan";
+		case T_SampleScanState:
+			return "Sample Scan";
+		case T_IndexScanState:
+			return "Index Scan";
+		case T_IndexOnlyScanState:
+			return "Index Only Scan";
+		case T_BitmapIndexScanState:
+			return "Bitmap Index Scan";
+		case T_BitmapHeapScanState:
+			return "Bitmap Heap Scan";
+		case T_TidScanState:
+			return "Tid Scan";
+		case T_TidRangeScanState:
+			return "Tid Range Scan";
+		case T_SubqueryScanState:
+			return "Subquery Scan";
+		case T_FunctionScanState:
+			return "Function Scan";
+		case T_TableFuncScanState:
+			return "Table Function Scan";
+		case T_ValuesScanState:
+			return "Values Scan";
+		case T_CteScanState:
+			return "CTE Scan";
+		case T_NamedTuplestoreScanState:
+			return "Named Tuplestore Scan";
+		case T_WorkTableScanState:
+			return "WorkTable Scan";
+		case T_ForeignScanState:
+			return "Foreign Scan";
+		case T_CustomScanState:
+			return "Custom Scan";
+		case T_NestLoopState:
+			return "Nested Loop";
+		case T_MergeJoinState:
+			return "Merge Join";
+		case T_HashJoinState:
+			return "Hash Join";
+		case T_MaterialState:
+			return "Materialize";
+		case T_ResultCacheState:
+			return "Result Cache";
+		case T_SortState:
+			return "Sort";
+		case T_IncrementalSortState:
+			return "Incremental Sort";
+		case T_GroupState:
+			return "Group";
+		case T_AggState:
+			return "Aggregate";
+		case T_WindowAggState:
+			return "WindowAgg";
+		case T_UniqueState:
+			return "Unique";
+		case T_GatherState:
+			return "Gather";
+		case T_GatherMergeState:
+			return "Gather Merge";
+		case T_HashState:
+			return "Hash";
+		case T_SetOpState:
+			return "SetOp";
+		case T_LockRowsState:
+			return "LockRows";
+		case T_LimitState:
+			return "Limit";
+		default:
+			return "???";
+	}
+}
+
+/*
+ * Return the contents of the sample ring buffer, oldest first.
+ */
+Datum
+pg_stat_get_active_session_history(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_ASH_COLS	9
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	bool		read_all_stats;
+	uint32		start;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (AshShmem == NULL || active_session_history_size <= 0)
+		return (Datum) 0;
+
+	read_all_stats = is_member_of_role(GetUserId(),
+									   DEFAULT_ROLE_READ_ALL_STATS);
+
+	start = pg_atomic_read_u32(&AshShmem->next) % active_session_history_size;
+	for (i = 0; i < active_session_history_size; i++)
+	{
+		AshSample  *slot;
+		AshSample	sample;
+		uint32		before;
+		Datum		values[PG_STAT_GET_ASH_COLS];
+		bool		nulls[PG_STAT_GET_ASH_COLS];
+
+		slot = &AshShmem->samples[(start + i) % active_session_history_size];
+
+		/* Copy the sample, skipping it if it changes under us */
+		before = pg_atomic_read_u32(&slot->changecount);
+		if ((before & 1) != 0)
+			continue;
+		pg_read_barrier();
+		memcpy(&sample, slot, sizeof(AshSample));
+		pg_read_barrier();
+		if (pg_atomic_read_u32(&slot->changecount) != before)
+			continue;
+
+		if (sample.sample_time == 0)
+			continue;
+
+		MemSet(values, 0, sizeof(values));
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = TimestampTzGetDatum(sample.sample_time);
+		values[1] = Int32GetDatum(sample.pid);
+		values[2] = ObjectIdGetDatum(sample.dbid);
+		values[3] = ObjectIdGetDatum(sample.userid);
+
+		/* Values only available to role member or pg_read_all_stats */
+		if (read_all_stats || has_privs_of_role(GetUserId(), sample.userid))
+		{
+			const char *wait_event_type;
+			const char *wait_event;
+
+			if (sample.query_id != 0)
+				values[4] = Int64GetDatum((int64) sample.query_id);
+			else
+				nulls[4] = true;
+
+			wait_event_type = pgstat_get_wait_event_type(sample.wait_event_info);
+			wait_event = pgstat_get_wait_event(sample.wait_event_info);
+			if (wait_event_type)
+				values[5] = CStringGetTextDatum(wait_event_type);
+			else
+				nulls[5] = true;
+			if (wait_event)
+				values[6] = CStringGetTextDatum(wait_event);
+			else
+				nulls[6] = true;
+
+			if (sample.node_tag != T_Invalid)
+			{
+				values[7] = Int32GetDatum(sample.node_id);
+				values[8] = CStringGetTextDatum(ash_plan_node_name((NodeTag) sample.node_tag));
+			}
+			else
+			{
+				nulls[7] = true;
+				nulls[8] = true;
+			}
+		}
+		else
+		{
+			nulls[4] = true;
+			nulls[5] = true;
+			nulls[6] = true;
+			nulls[7] = true;
+			nulls[8] = true;
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	/* clean up and return the tuplestore */
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -28,21 +28,29 @@
 
 #include "access/commit_ts.h"
 #include "access/gin.h"
+#include "access/heapam.h"
+#include "access/hio.h"
+#include "access/parallel.h"
+#include "access/parallelredo.h"
 #include "access/rmgr.h"
+#include "access/slru.h"
 #include "access/tableam.h"
 #include "access/transam.h"
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogprefetcher.h"
 #include "catalog/namespace.h"
 #include "catalog/pg_authid.h"
 #include "commands/async.h"
 #include "commands/prepare.h"
+#include "commands/sequence.h"
 #include "commands/user.h"
 #include "commands/vacuum.h"
 #include "commands/variable.h"
 #include "commands/trigger.h"
 #include "common/string.h"
+#include "executor/execBatch.h"
 #include "funcapi.h"
 #include "jit/jit.h"
 #include "libpq/auth.h"
@@ -65,11 +73,14 @@
 #include "postmaster/postmaster.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
+#include "regex/regex.h"
 #include "replication/logicallauncher.h"
+#include "replication/reorderbuffer.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
 #include "replication/walreceiver.h"
 #include "replication/walsender.h"
+#include "storage/aio.h"
 #include "storage/bufmgr.h"
 #include "storage/dsm_impl.h"
 #include "storage/standby.h"
@@ -80,10 +91,13 @@
 #include "storage/predicate.h"
 #include "tcop/tcopprot.h"
 #include "tsearch/ts_cache.h"
+#include "utils/ash.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
+#include "utils/catcache.h"
 #include "utils/guc_tables.h"
 #include "utils/float.h"
+#include "utils/memlimit.h"
 #include "utils/memutils.h"
 #include "utils/pg_locale.h"
 #include "utils/pg_lsn.h"
@@ -91,6 +105,7 @@
 #include "utils/portal.h"
 #include "utils/ps_status.h"
 #include "utils/rls.h"
+#include "utils/sharedplancache.h"
 #include "utils/snapmgr.h"
 #include "utils/tzparser.h"
 #include "utils/varlena.h"
@@ -170,6 +185,13 @@ static void assign_syslog_facility(int newval, void *extra);
 static void assign_syslog_ident(const char *newval, void *extra);
 static void assign_session_replication_role(int newval, void *extra);
 static bool check_temp_buffers(int *newval, void **extra, GucSource source);
+static bool check_commit_timestamp_buffers(int *newval, void **extra, GucSource source);
+static bool check_multixact_member_buffers(int *newval, void **extra, GucSource source);
+static bool check_multixact_offset_buffers(int *newval, void **extra, GucSource source);
+static bool check_notify_buffers(int *newval, void **extra, GucSource source);
+static bool check_serializable_buffers(int *newval, void **extra, GucSource source);
+static bool check_subtransaction_buffers(int *newval, void **extra, GucSource source);
+static bool check_transaction_buffers(int *newval, void **extra, GucSource source);
 static bool check_bonjour(bool *newval, void **extra, GucSource source);
 static bool check_ssl(bool *newval, void **extra, GucSource source);
 static bool check_stage_log_stats(bool *newval, void **extra, GucSource source);
@@ -194,7 +216,8 @@ static bool check_max_wal_senders(int *newval, void **extra, GucSource source);
 static bool check_autovacuum_work_mem(int *newval, void **extra, GucSource source);
 static bool check_effective_io_concurrency(int *newval, void **extra, GucSource source);
 static void assign_effective_io_concurrency(int newval, void *extra);
-static void assign_pgstat_temp_directory(const char *newval, void *extra);
+static bool check_recovery_prefetch_distance(int *newval, void **extra, GucSource source);
+static bool check_fast_path_lock_slots(int *newval, void **extra, GucSource source);
 static bool check_application_name(char **newval, void **extra, GucSource source);
 static void assign_application_name(const char *newval, void *extra);
 static bool check_cluster_name(char **newval, void **extra, GucSource source);
@@ -426,10 +449,17 @@ static const struct config_enum_entry force_parallel_mode_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry parallel_worker_affinity_options[] = {
+	{"off", PARALLEL_WORKER_AFFINITY_OFF, false},
+	{"leader_node", PARALLEL_WORKER_AFFINITY_LEADER_NODE, false},
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry plan_cache_mode_options[] = {
 	{"auto", PLAN_CACHE_MODE_AUTO, false},
 	{"force_generic_plan", PLAN_CACHE_MODE_FORCE_GENERIC_PLAN, false},
 	{"force_custom_plan", PLAN_CACHE_MODE_FORCE_CUSTOM_PLAN, false},
+	{"adaptive", PLAN_CACHE_MODE_ADAPTIVE, false},
 	{NULL, 0, false}
 };
 
@@ -478,6 +508,7 @@ extern const struct config_enum_entry archive_mode_options[];
 extern const struct config_enum_entry recovery_target_action_options[];
 extern const struct config_enum_entry sync_method_options[];
 extern const struct config_enum_entry dynamic_shared_memory_options[];
+extern const struct config_enum_entry io_method_options[];
 
 /*
  * GUC option variables that are exported from this module
@@ -515,6 +546,7 @@ double		log_xact_sample_rate = 0;
 int			trace_recovery_messages = LOG;
 
 int			temp_file_limit = -1;
+bool		temp_file_compression = false;
 
 int			num_temp_buffers = 1024;
 
@@ -524,8 +556,6 @@ char	   *HbaFileName;
 char	   *IdentFileName;
 char	   *external_pid_file;
 
-char	   *pgstat_temp_directory;
-
 char	   *application_name;
 
 int			tcp_keepalives_idle;
@@ -664,6 +694,8 @@ const char *const config_group_names[] =
 	gettext_noop("Write-Ahead Log / Checkpoints"),
 	/* WAL_ARCHIVING */
 	gettext_noop("Write-Ahead Log / Archiving"),
+	/* WAL_RECOVERY */
+	gettext_noop("Write-Ahead Log / Recovery"),
 	/* WAL_ARCHIVE_RECOVERY */
 	gettext_noop("Write-Ahead Log / Archive Recovery"),
 	/* WAL_RECOVERY_TARGET */
@@ -940,6 +972,16 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_incremental_sort", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of incremental sort steps."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_incremental_sort,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_hashagg", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of hashed aggregation plans."),
@@ -960,6 +1002,18 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_resultcache", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of result caching."),
+			gettext_noop("Result caching keeps the inner rows of a "
+						 "parameterized nested-loop join for reuse when the "
+						 "same join keys come up again."),
+			GUC_EXPLAIN
+		},
+		&enable_resultcache,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_nestloop", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of nested-loop join plans."),
@@ -970,6 +1024,17 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_adaptive_nestloop", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables nested-loop joins to switch to hashing at run time."),
+			gettext_noop("Applies when the outer input of a nested-loop join "
+						 "turns out to be much larger than estimated."),
+			GUC_EXPLAIN
+		},
+		&enable_adaptive_nestloop,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_mergejoin", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables the planner's use of merge join plans."),
@@ -1040,6 +1105,16 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_async_append", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of async append plans."),
+			NULL,
+			GUC_EXPLAIN
+		},
+		&enable_async_append,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"enable_partition_pruning", PGC_USERSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables plan-time and run-time partition pruning."),
@@ -1063,6 +1138,16 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"geqo_linear_search", PGC_USERSET, QUERY_TUNING_GEQO,
+			gettext_noop("Plans queries above geqo_threshold by linearized dynamic programming."),
+			gettext_noop("When off, the genetic algorithm is used instead."),
+			GUC_EXPLAIN
+		},
+		&linear_join_search_enabled,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		/* Not for general use --- used by SET SESSION AUTHORIZATION */
 		{"is_superuser", PGC_INTERNAL, UNGROUPED,
@@ -1083,6 +1168,15 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		check_bonjour, NULL, NULL
 	},
+	{
+		{"libpq_compression", PGC_SIGHUP, CONN_AUTH_SETTINGS,
+			gettext_noop("Allows clients to request protocol compression."),
+			NULL
+		},
+		&libpq_compression,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"track_commit_timestamp", PGC_POSTMASTER, REPLICATION,
 			gettext_noop("Collects transaction commit time."),
@@ -1174,6 +1268,57 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"deferred_page_pruning", PGC_USERSET, AUTOVACUUM,
+			gettext_noop("Queues heap pages that could not be pruned for pruning by autovacuum."),
+			gettext_noop("Pages are queued when a reader finds them worth pruning "
+						 "but cannot get the lock needed to do so right away.")
+		},
+		&deferred_page_pruning,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"adaptive_fillfactor", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Leaves free space on heap pages of tables whose updates often move to other pages."),
+			NULL
+		},
+		&adaptive_fillfactor,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_sequence_cache", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Keeps the cached values of sequences in shared memory."),
+			NULL
+		},
+		&shared_sequence_cache,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"bgwriter_fill_freelist", PGC_SIGHUP, RESOURCES_BGWRITER,
+			gettext_noop("Background writer puts the clean buffers it finds on the freelist."),
+			gettext_noop("Backends then take buffers from there instead of running the clock sweep.")
+		},
+		&bgwriter_fill_freelist,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"checkpoint_sync_early", PGC_SIGHUP, WAL_CHECKPOINTS,
+			gettext_noop("Syncs each file written by a checkpoint as soon as its writes are done."),
+			gettext_noop("Otherwise all files are synced at the end of the checkpoint.")
+		},
+		&checkpoint_sync_early,
+		true,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_log_hints", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Writes full pages to WAL when first modified after a checkpoint, even for a non-critical modifications."),
@@ -1184,6 +1329,16 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"defer_hint_bit_writes", PGC_USERSET, WAL_SETTINGS,
+			gettext_noop("Does not write out pages only because sequential scans set hint bits on them."),
+			NULL
+		},
+		&defer_hint_bit_writes,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_compression", PGC_SUSET, WAL_SETTINGS,
 			gettext_noop("Compresses full-page writes written in WAL file."),
@@ -1194,6 +1349,37 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_record_compression", PGC_SUSET, WAL_SETTINGS,
+			gettext_noop("Compresses whole WAL records of moderate size."),
+			NULL
+		},
+		&wal_record_compression,
+		false,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"wal_group_commit", PGC_USERSET, WAL_SETTINGS,
+			gettext_noop("Lets one backend flush WAL on behalf of a group of committing backends."),
+			NULL
+		},
+		&wal_group_commit,
+		true,
+		NULL, NULL, NULL
+	},
+	{
+		{"recovery_prefetch_fpw", PGC_SIGHUP, WAL_RECOVERY,
+			gettext_noop("Prefetches blocks that have full page images in the WAL."),
+			gettext_noop("Replay restores such blocks from the image, but prefetching "
+						 "them can avoid read-before-write on some file systems.")
+		},
+		&recovery_prefetch_fpw,
+		false,
+		NULL, NULL, NULL
+	},
+
+
 	{
 		{"wal_init_zero", PGC_SUSET, WAL_SETTINGS,
 			gettext_noop("Writes zeroes to new WAL files before first use."),
@@ -1407,6 +1593,15 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"track_lwlocks", PGC_SUSET, STATS_COLLECTOR,
+			gettext_noop("Collects statistics on lightweight lock acquisitions and waits."),
+			NULL
+		},
+		&track_lwlocks,
+		false,
+		NULL, NULL, NULL
+	},
 
 	{
 		{"update_process_title", PGC_SUSET, PROCESS_TITLE,
@@ -1496,6 +1691,16 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"lwlock_handoff", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Hands lightweight locks over directly to the next exclusive waiter."),
+			NULL
+		},
+		&lwlock_handoff,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"log_hostname", PGC_SIGHUP, LOGGING_WHAT,
 			gettext_noop("Logs the host name in the connection logs."),
@@ -1577,6 +1782,15 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"vacuum_eager_freeze", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Lets VACUUM freeze all rows of pages it is modifying anyway."),
+			gettext_noop("This is done only if it lets the page be marked all-frozen.")
+		},
+		&vacuum_eager_freeze,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"check_function_bodies", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Check function bodies during CREATE FUNCTION."),
@@ -1769,6 +1983,16 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"wal_receiver_compression", PGC_SIGHUP, REPLICATION_STANDBY,
+			gettext_noop("Asks the primary to compress the WAL it streams."),
+			NULL
+		},
+		&wal_receiver_compression,
+		false,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"allow_system_table_mods", PGC_POSTMASTER, DEVELOPER_OPTIONS,
 			gettext_noop("Allows modifications of the structure of system tables."),
@@ -1952,6 +2176,26 @@ static struct config_bool ConfigureNamesBool[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"buffer_lookup_hints", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Enables looking up shared buffers without taking the buffer mapping lock."),
+			NULL
+		},
+		&buffer_lookup_hints,
+		true,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"temp_file_compression", PGC_USERSET, RESOURCES_DISK,
+			gettext_noop("Compresses temporary files written by hash joins."),
+			NULL
+		},
+		&temp_file_compression,
+		false,
+		NULL, NULL, NULL
+	},
+
 	/* End-of-list marker */
 	{
 		{NULL, 0, 0, NULL, NULL}, NULL, false, NULL, NULL, NULL
@@ -2021,6 +2265,17 @@ static struct config_int ConfigureNamesInt[] =
 		8, 1, INT_MAX,
 		NULL, NULL, NULL
 	},
+	{
+		{"executor_batch_size", PGC_USERSET, QUERY_TUNING_OTHER,
+			gettext_noop("Sets the maximum number of rows a sequential scan "
+						 "processes at a time in batch mode."),
+			gettext_noop("Zero disables batch-at-a-time execution."),
+			GUC_EXPLAIN
+		},
+		&executor_batch_size,
+		1024, 0, MAX_EXECUTOR_BATCH_SIZE,
+		NULL, NULL, NULL
+	},
 	{
 		{"geqo_threshold", PGC_USERSET, QUERY_TUNING_GEQO,
 			gettext_noop("Sets the threshold of FROM items beyond which GEQO is used."),
@@ -2150,6 +2405,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"preforked_backends", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
+			gettext_noop("Sets the number of idle server processes started ahead of connection requests."),
+			NULL
+		},
+		&preforked_backends,
+		0, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We sometimes multiply the number of shared buffers by two without
 	 * checking for overflow, so we mustn't allow more than INT_MAX / 2.
@@ -2165,6 +2430,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"clock_sweep_partitions", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of partitions of the buffer replacement clock sweep."),
+			gettext_noop("-1 means choose based on shared_buffers.")
+		},
+		&clock_sweep_partitions,
+		-1, -1, 256,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"temp_buffers", PGC_USERSET, RESOURCES_MEM,
 			gettext_noop("Sets the maximum number of temporary buffers used by each session."),
@@ -2176,6 +2451,83 @@ static struct config_int ConfigureNamesInt[] =
 		check_temp_buffers, NULL, NULL
 	},
 
+	{
+		{"commit_timestamp_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the commit timestamp cache."),
+			gettext_noop("0 means use a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&commit_timestamp_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_commit_timestamp_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_member_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact member cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_member_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_member_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_offset_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact offset cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_offset_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_offset_buffers, NULL, NULL
+	},
+
+	{
+		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the LISTEN/NOTIFY message cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&notify_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_notify_buffers, NULL, NULL
+	},
+
+	{
+		{"serializable_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the serializable transaction cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&serializable_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_serializable_buffers, NULL, NULL
+	},
+
+	{
+		{"subtransaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the subtransaction cache."),
+			gettext_noop("0 means use a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&subtransaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_subtransaction_buffers, NULL, NULL
+	},
+
+	{
+		{"transaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the transaction status cache."),
+			gettext_noop("0 means use a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&transaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_transaction_buffers, NULL, NULL
+	},
+
 	{
 		{"port", PGC_POSTMASTER, CONN_AUTH_SETTINGS,
 			gettext_noop("Sets the TCP port the server listens on."),
@@ -2254,6 +2606,30 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"min_dynamic_shared_memory", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Amount of dynamic shared memory reserved at startup."),
+			NULL,
+			GUC_UNIT_MB
+		},
+		&min_dynamic_shared_memory,
+		0, 0, (int) Min((size_t) INT_MAX, SIZE_MAX / (1024 * 1024)),
+		NULL, NULL, NULL
+	},
+
+	{
+		{"max_total_backend_memory", PGC_SIGHUP, RESOURCES_MEM,
+			gettext_noop("Sets the memory all server processes together should try to stay within."),
+			gettext_noop("Sorts and hash tables use less than work_mem when "
+						 "the server as a whole approaches this limit. "
+						 "0 disables the limit."),
+			GUC_UNIT_MB
+		},
+		&max_total_backend_memory,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We use the hopefully-safely-small value of 100kB as the compiled-in
 	 * default for max_stack_depth.  InitializeGUCOptions will increase it if
@@ -2410,6 +2786,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"idle_cache_release_timeout", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the idle time after which a session releases its caches."),
+			gettext_noop("A value of 0 turns off the timeout."),
+			GUC_UNIT_MS
+		},
+		&IdleCacheReleaseTimeout,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_freeze_min_age", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Minimum age at which VACUUM should freeze a table row."),
@@ -2487,6 +2874,37 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"fast_path_lock_slots", PGC_POSTMASTER, LOCK_MANAGEMENT,
+			gettext_noop("Sets the number of fast-path relation lock slots per backend."),
+			gettext_noop("The value is rounded up to the next power of two.")
+		},
+		&fast_path_lock_slots,
+		FP_LOCK_SLOTS_PER_GROUP, FP_LOCK_SLOTS_PER_GROUP, FP_LOCK_SLOTS_PER_BACKEND_MAX,
+		check_fast_path_lock_slots, NULL, NULL
+	},
+
+	{
+		{"subxid_overflow_slots", PGC_POSTMASTER, LOCK_MANAGEMENT,
+			gettext_noop("Sets the number of overflowed subtransaction XIDs each backend keeps in shared memory."),
+			gettext_noop("Subtransaction XIDs beyond this many per transaction are "
+						 "only recorded in pg_subtrans.")
+		},
+		&subxid_overflow_slots,
+		1024, 0, SUBXID_OVERFLOW_SLOTS_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"lwlock_max_spins", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Sets the maximum number of spin delays before sleeping on a lightweight lock."),
+			gettext_noop("Zero disables spinning.")
+		},
+		&lwlock_max_spins,
+		100, 0, 10000,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_pred_locks_per_relation", PGC_SIGHUP, LOCK_MANAGEMENT,
 			gettext_noop("Sets the maximum number of predicate-locked pages and tuples per relation."),
@@ -2613,6 +3031,16 @@ static struct config_int ConfigureNamesInt[] =
 		check_wal_buffers, NULL, NULL
 	},
 
+	{
+		{"wal_insert_locks", PGC_POSTMASTER, WAL_SETTINGS,
+			gettext_noop("Sets the number of locks allowing WAL insertions to happen concurrently."),
+			gettext_noop("-1 means choose based on max_connections.")
+		},
+		&wal_insert_locks,
+		-1, -1, MAX_XLOGINSERT_LOCKS,
+		check_wal_insert_locks, NULL, NULL
+	},
+
 	{
 		{"wal_writer_delay", PGC_SIGHUP, WAL_SETTINGS,
 			gettext_noop("Time between WAL flushes performed in the WAL writer."),
@@ -2800,6 +3228,27 @@ static struct config_int ConfigureNamesInt[] =
 		check_max_worker_processes, NULL, NULL
 	},
 
+	{
+		{"parallel_redo_workers", PGC_POSTMASTER, WAL_RECOVERY,
+			gettext_noop("Sets the number of background workers that replay WAL records during recovery."),
+			gettext_noop("Zero means that the startup process replays all WAL records itself.")
+		},
+		&parallel_redo_workers,
+		0, 0, MAX_PARALLEL_REDO_WORKERS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"recovery_prefetch_distance", PGC_SIGHUP, WAL_RECOVERY,
+			gettext_noop("Sets how far ahead of replay to look in the WAL for blocks to prefetch."),
+			gettext_noop("Zero disables prefetching during recovery."),
+			GUC_UNIT_BYTE
+		},
+		&recovery_prefetch_distance,
+		0, 0, INT_MAX,
+		check_recovery_prefetch_distance, NULL, NULL
+	},
+
 	{
 		{"max_logical_replication_workers",
 			PGC_POSTMASTER,
@@ -2997,6 +3446,27 @@ static struct config_int ConfigureNamesInt[] =
 		check_autovacuum_max_workers, NULL, NULL
 	},
 
+	{
+		{"autovacuum_max_parallel_workers", PGC_SIGHUP, AUTOVACUUM,
+			gettext_noop("Sets the maximum number of parallel workers an autovacuum worker can use to vacuum indexes."),
+			gettext_noop("Zero disables parallel vacuum in autovacuum.")
+		},
+		&autovacuum_max_parallel_workers,
+		0, 0, MAX_PARALLEL_WORKER_LIMIT,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"autovacuum_eager_freeze_pages", PGC_SIGHUP, AUTOVACUUM,
+			gettext_noop("Sets the number of pages in which autovacuum freezes all-visible pages ahead of an aggressive vacuum."),
+			gettext_noop("Zero disables this."),
+			GUC_UNIT_BLOCKS
+		},
+		&autovacuum_eager_freeze_pages,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_parallel_maintenance_workers", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
 			gettext_noop("Sets the maximum number of parallel processes per maintenance operation."),
@@ -3040,6 +3510,53 @@ static struct config_int ConfigureNamesInt[] =
 		check_autovacuum_work_mem, NULL, NULL
 	},
 
+	{
+		{"logical_decoding_work_mem", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for logical decoding."),
+			gettext_noop("This much memory can be used by each internal "
+						 "reorder buffer before spilling to disk."),
+			GUC_UNIT_KB
+		},
+		&logical_decoding_work_mem,
+		65536, 64, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"catalog_cache_max_size", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for cached catalog tuples."),
+			gettext_noop("Least recently used entries are evicted beyond this "
+						 "limit. 0 means no limit."),
+			GUC_UNIT_KB
+		},
+		&catalog_cache_max_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"relation_cache_max_size", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the maximum memory to be used for cached relation descriptors."),
+			gettext_noop("Least recently used descriptors are evicted beyond "
+						 "this limit at transaction end. 0 means no limit."),
+			GUC_UNIT_KB
+		},
+		&relation_cache_max_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_plan_cache_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the amount of shared memory used to share generic plans between sessions."),
+			gettext_noop("0 disables sharing of plans."),
+			GUC_UNIT_KB
+		},
+		&shared_plan_cache_size,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"old_snapshot_threshold", PGC_POSTMASTER, RESOURCES_ASYNCHRONOUS,
 			gettext_noop("Time before a snapshot is too old to read pages changed after the snapshot was taken."),
@@ -3107,6 +3624,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"regex_cache_size", PGC_USERSET, CLIENT_CONN_OTHER,
+			gettext_noop("Sets the maximum number of compiled regular expressions cached by each session."),
+			NULL
+		},
+		&regex_cache_size,
+		128, 1, 65536,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"effective_cache_size", PGC_USERSET, QUERY_TUNING_COST,
 			gettext_noop("Sets the planner's assumption about the total size of the data caches."),
@@ -3141,6 +3668,18 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"jit_warmup_calls", PGC_USERSET, QUERY_TUNING_COST,
+			gettext_noop("Sets the number of evaluations of an expression before it is JIT compiled."),
+			gettext_noop("Expressions are interpreted until then, so that queries "
+						 "evaluating them only a few times don't pay for compilation."),
+			GUC_EXPLAIN
+		},
+		&jit_warmup_calls,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		/* Can't be set in postgresql.conf */
 		{"server_version_num", PGC_INTERNAL, PRESET_OPTIONS,
@@ -3175,6 +3714,27 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"active_session_sample_interval", PGC_SUSET, STATS_COLLECTOR,
+			gettext_noop("Sets the interval between active session history samples."),
+			gettext_noop("Zero turns off sampling."),
+			GUC_UNIT_MS
+		},
+		&active_session_sample_interval,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"active_session_history_size", PGC_POSTMASTER, STATS_COLLECTOR,
+			gettext_noop("Sets the number of active session history samples kept in shared memory."),
+			NULL
+		},
+		&active_session_history_size,
+		8192, 0, INT_MAX / 1024,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"gin_pending_list_limit", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the maximum size of the pending list for GIN index."),
@@ -3657,6 +4217,17 @@ static struct config_string ConfigureNamesString[] =
 		check_temp_tablespaces, assign_temp_tablespaces, NULL
 	},
 
+	{
+		{"io_direct", PGC_POSTMASTER, RESOURCES_DISK,
+			gettext_noop("Bypasses the kernel's page cache for the given kinds of files."),
+			gettext_noop("The list may contain \"data\" and \"wal\"."),
+			GUC_LIST_INPUT
+		},
+		&io_direct_string,
+		"",
+		check_io_direct, assign_io_direct, NULL
+	},
+
 	{
 		{"dynamic_library_path", PGC_SUSET, CLIENT_CONN_OTHER,
 			gettext_noop("Sets the path for dynamically loadable modules."),
@@ -4075,17 +4646,6 @@ static struct config_string ConfigureNamesString[] =
 		NULL, NULL, NULL
 	},
 
-	{
-		{"stats_temp_directory", PGC_SIGHUP, STATS_COLLECTOR,
-			gettext_noop("Writes temporary statistics files to the specified directory."),
-			NULL,
-			GUC_SUPERUSER_ONLY
-		},
-		&pgstat_temp_directory,
-		PG_STAT_TMP_DIR,
-		check_canonical_path, assign_pgstat_temp_directory, NULL
-	},
-
 	{
 		{"synchronous_standby_names", PGC_SIGHUP, REPLICATION_MASTER,
 			gettext_noop("Number of synchronous standbys and list of names of potential synchronous ones."),
@@ -4449,6 +5009,27 @@ static struct config_enum ConfigureNamesEnum[] =
 		NULL, assign_xlog_sync_method, NULL
 	},
 
+	{
+		{"io_method", PGC_SIGHUP, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the method used for batches of asynchronous file operations."),
+			NULL
+		},
+		&io_method,
+		IOMETHOD_SYNC, io_method_options,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"parallel_worker_affinity", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Selects the CPUs that parallel workers may run on."),
+			gettext_noop("With leader_node, workers are bound to the NUMA node "
+						 "their leader was running on when it launched them.")
+		},
+		&parallel_worker_affinity,
+		PARALLEL_WORKER_AFFINITY_OFF, parallel_worker_affinity_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"xmlbinary", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets how binary values are to be encoded in XML."),
@@ -11043,16 +11624,59 @@ static bool
 check_temp_buffers(int *newval, void **extra, GucSource source)
 {
 	/*
-	 * Once local buffers have been initialized, it's too late to change this.
+	 * The local buffer pool grows on demand, but never shrinks.
 	 */
-	if (NLocBuffer && NLocBuffer != *newval)
+	if (*newval < NLocBuffer)
 	{
-		GUC_check_errdetail("\"temp_buffers\" cannot be changed after any temporary tables have been accessed in the session.");
+		GUC_check_errdetail("\"temp_buffers\" cannot be set below the %d buffers already in use in the session.",
+							NLocBuffer);
 		return false;
 	}
 	return true;
 }
 
+static bool
+check_commit_timestamp_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("commit_timestamp_buffers", newval);
+}
+
+static bool
+check_multixact_member_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("multixact_member_buffers", newval);
+}
+
+static bool
+check_multixact_offset_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("multixact_offset_buffers", newval);
+}
+
+static bool
+check_notify_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("notify_buffers", newval);
+}
+
+static bool
+check_serializable_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("serializable_buffers", newval);
+}
+
+static bool
+check_subtransaction_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("subtransaction_buffers", newval);
+}
+
+static bool
+check_transaction_buffers(int *newval, void **extra, GucSource source)
+{
+	return check_slru_buffers("transaction_buffers", newval);
+}
+
 static bool
 check_bonjour(bool *newval, void **extra, GucSource source)
 {
@@ -11355,33 +11979,29 @@ assign_effective_io_concurrency(int newval, void *extra)
 #endif							/* USE_PREFETCH */
 }
 
-static void
-assign_pgstat_temp_directory(const char *newval, void *extra)
+static bool
+check_recovery_prefetch_distance(int *newval, void **extra, GucSource source)
 {
-	/* check_canonical_path already canonicalized newval for us */
-	char	   *dname;
-	char	   *tname;
-	char	   *fname;
+#ifndef USE_PREFETCH
+	if (*newval != 0)
+	{
+		GUC_check_errdetail("recovery_prefetch_distance must be set to 0 on platforms that lack posix_fadvise().");
+		return false;
+	}
+#endif							/* USE_PREFETCH */
+	return true;
+}
 
-	/* directory */
-	dname = guc_malloc(ERROR, strlen(newval) + 1);	/* runtime dir */
-	sprintf(dname, "%s", newval);
-
-	/* global stats */
-	tname = guc_malloc(ERROR, strlen(newval) + 12); /* /global.tmp */
-	sprintf(tname, "%s/global.tmp", newval);
-	fname = guc_malloc(ERROR, strlen(newval) + 13); /* /global.stat */
-	sprintf(fname, "%s/global.stat", newval);
-
-	if (pgstat_stat_directory)
-		free(pgstat_stat_directory);
-	pgstat_stat_directory = dname;
-	if (pgstat_stat_tmpname)
-		free(pgstat_stat_tmpname);
-	pgstat_stat_tmpname = tname;
-	if (pgstat_stat_filename)
-		free(pgstat_stat_filename);
-	pgstat_stat_filename = fname;
+static bool
+check_fast_path_lock_slots(int *newval, void **extra, GucSource source)
+{
+	int			slots = FP_LOCK_SLOTS_PER_GROUP;
+
+	/* lock.c maps relations to groups of slots with a mask */
+	while (slots < *newval)
+		slots *= 2;
+	*newval = slots;
+	return true;
 }
 
 static bool
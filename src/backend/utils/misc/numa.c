@@ -0,0 +1,127 @@
+/*-------------------------------------------------------------------------
+ *
+ * numa.c
+ *	  NUMA node lookup and CPU affinity support.
+ *
+ * This is used to keep parallel workers on the same NUMA node as their
+ * leader.  Only Linux is supported; elsewhere, the current node is always
+ * unknown and binding to a node always fails.  We read the node topology
+ * from sysfs rather than depending on libnuma.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/misc/numa.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "utils/numa.h"
+
+
+int			MyNumaNode = -1;
+
+
+/*
+ * pg_numa_current_node
+ *		Return the NUMA node of the CPU we're running on, or -1 if unknown.
+ *
+ * The result may be out of date as soon as it's returned, unless we're bound
+ * to a node.
+ */
+int
+pg_numa_current_node(void)
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned int cpu;
+	unsigned int node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+		return (int) node;
+#endif
+	return -1;
+}
+
+/*
+ * pg_numa_bind_node
+ *		Restrict this process to the CPUs of the given NUMA node.
+ *
+ * Returns true on success, and sets MyNumaNode.  On failure, returns false
+ * with errno set.
+ */
+bool
+pg_numa_bind_node(int node)
+{
+#if defined(__linux__) && defined(CPU_SET)
+	char		path[MAXPGPATH];
+	char		buf[1024];
+	FILE	   *file;
+	cpu_set_t	cpus;
+	char	   *p;
+
+	snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", node);
+	file = fopen(path, "r");
+	if (file == NULL)
+		return false;
+	if (fgets(buf, sizeof(buf), file) == NULL)
+	{
+		fclose(file);
+		errno = EINVAL;
+		return false;
+	}
+	fclose(file);
+
+	/* The list looks like "0-7,16-23" */
+	CPU_ZERO(&cpus);
+	p = buf;
+	for (;;)
+	{
+		char	   *end;
+		long		first;
+		long		last;
+
+		first = strtol(p, &end, 10);
+		if (end == p)
+			break;
+		last = first;
+		if (*end == '-')
+		{
+			p = end + 1;
+			last = strtol(p, &end, 10);
+			if (end == p)
+				break;
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, &cpus);
+
+		if (*end != ',')
+			break;
+		p = end + 1;
+	}
+
+	if (CPU_COUNT(&cpus) == 0)
+	{
+		errno = EINVAL;
+		return false;
+	}
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+		return false;
+
+	MyNumaNode = node;
+	return true;
+#else
+	errno = ENOSYS;
+	return false;
+#endif
+}
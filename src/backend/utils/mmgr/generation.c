@@ -297,6 +297,8 @@ GenerationReset(MemoryContext context)
 
 		dlist_delete(miter.cur);
 
+		MemoryContextNoteFree(context, block->blksize);
+
 #ifdef CLOBBER_FREED_MEMORY
 		wipe_mem(block, block->blksize);
 #endif
@@ -307,6 +309,7 @@ GenerationReset(MemoryContext context)
 	set->block = NULL;
 
 	Assert(dlist_is_empty(&set->blocks));
+	Assert(context->mem_allocated == 0);
 }
 
 /*
@@ -352,6 +355,8 @@ GenerationAlloc(MemoryContext context, Size size)
 		if (block == NULL)
 			return NULL;
 
+		MemoryContextNoteAlloc(context, blksize);
+
 		/* block with a single (used) chunk */
 		block->blksize = blksize;
 		block->nchunks = 1;
@@ -407,6 +412,8 @@ GenerationAlloc(MemoryContext context, Size size)
 		if (block == NULL)
 			return NULL;
 
+		MemoryContextNoteAlloc(context, blksize);
+
 		block->blksize = blksize;
 		block->nchunks = 0;
 		block->nfree = 0;
@@ -522,6 +529,7 @@ GenerationFree(MemoryContext context, void *pointer)
 	if (set->block == block)
 		set->block = NULL;
 
+	MemoryContextNoteFree(context, block->blksize);
 	free(block);
 }
 
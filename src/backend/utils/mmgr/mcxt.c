@@ -52,9 +52,24 @@ MemoryContext CurTransactionContext = NULL;
 /* This is a transient link to the active portal's memory context: */
 MemoryContext PortalContext = NULL;
 
+/*
+ * Process-wide totals of memory obtained by memory contexts, see
+ * MemoryContextNoteAlloc().
+ */
+Size		MemoryContextTotalAllocated = 0;
+Size		MemoryContextPeakAllocated = 0;
+
+/* passthru state for MemoryContextStatsPrint */
+typedef struct MemoryContextStatsPrintState
+{
+	int			level;			/* nesting level of the context */
+	bool		print_to_stderr;	/* fprintf(stderr) rather than ereport? */
+} MemoryContextStatsPrintState;
+
 static void MemoryContextCallResetCallbacks(MemoryContext context);
 static void MemoryContextStatsInternal(MemoryContext context, int level,
 									   bool print, int max_children,
+									   bool print_to_stderr,
 									   MemoryContextCounters *totals);
 static void MemoryContextStatsPrint(MemoryContext context, void *passthru,
 									const char *stats_string);
@@ -462,6 +477,94 @@ MemoryContextIsEmpty(MemoryContext context)
 	return context->methods->is_empty(context);
 }
 
+/*
+ * MemoryContextMemAllocated
+ *		Find the memory allocated to blocks for this memory context.  If
+ *		recurse is true, also include children.
+ *
+ * This is cheap for a single context, since every context type keeps its
+ * total up to date as blocks are obtained from and returned to malloc().
+ */
+Size
+MemoryContextMemAllocated(MemoryContext context, bool recurse)
+{
+	Size		total = context->mem_allocated;
+
+	AssertArg(MemoryContextIsValid(context));
+
+	if (recurse)
+	{
+		MemoryContext child;
+
+		for (child = context->firstchild;
+			 child != NULL;
+			 child = child->nextchild)
+			total += MemoryContextMemAllocated(child, true);
+	}
+
+	return total;
+}
+
+/*
+ * MemoryContextMemConsumed
+ *		Add up the statistics of the given context and all its descendants
+ *		into *consumed.
+ *
+ * Unlike MemoryContextMemAllocated, this tells how much of the allocated
+ * space is actually in use, but it has to walk all the blocks to find out.
+ */
+void
+MemoryContextMemConsumed(MemoryContext context,
+						 MemoryContextCounters *consumed)
+{
+	memset(consumed, 0, sizeof(*consumed));
+
+	MemoryContextStatsInternal(context, 0, false, 0, false, consumed);
+}
+
+/*
+ * MemoryContextBeginPeakTracking
+ *		Start measuring the most memory allocated at once while doing some
+ *		piece of work, such as executing a query.
+ *
+ * This restarts the process-wide peak from the current total.  Trackers may
+ * be nested, as when a query calls a function that runs queries of its own;
+ * MemoryContextEndPeakTracking() then puts back the peak the enclosing one
+ * would have seen.
+ */
+void
+MemoryContextBeginPeakTracking(MemoryPeakTracker *tracker)
+{
+	tracker->baseline = MemoryContextTotalAllocated;
+	tracker->saved_peak = MemoryContextPeakAllocated;
+	MemoryContextPeakAllocated = MemoryContextTotalAllocated;
+}
+
+/*
+ * MemoryContextGetPeak
+ *		Return the peak so far, not counting memory that was allocated
+ *		already when tracking began.
+ */
+Size
+MemoryContextGetPeak(const MemoryPeakTracker *tracker)
+{
+	/* a tracker that wasn't properly nested in ours may have lowered it */
+	if (MemoryContextPeakAllocated < tracker->baseline)
+		return 0;
+	return MemoryContextPeakAllocated - tracker->baseline;
+}
+
+/*
+ * MemoryContextEndPeakTracking
+ *		Stop tracking, restoring the peak of any enclosing tracker.
+ */
+void
+MemoryContextEndPeakTracking(const MemoryPeakTracker *tracker)
+{
+	MemoryContextPeakAllocated = Max(MemoryContextPeakAllocated,
+									 tracker->saved_peak);
+}
+
 /*
  * MemoryContextStats
  *		Print statistics about the named context and all its descendants.
@@ -474,28 +577,42 @@ void
 MemoryContextStats(MemoryContext context)
 {
 	/* A hard-wired limit on the number of children is usually good enough */
-	MemoryContextStatsDetail(context, 100);
+	MemoryContextStatsDetail(context, 100, true);
 }
 
 /*
  * MemoryContextStatsDetail
  *
  * Entry point for use if you want to vary the number of child contexts shown.
+ *
+ * If print_to_stderr is true, print statistics about the memory contexts
+ * with fprintf(stderr), otherwise use ereport().
  */
 void
-MemoryContextStatsDetail(MemoryContext context, int max_children)
+MemoryContextStatsDetail(MemoryContext context, int max_children,
+						 bool print_to_stderr)
 {
 	MemoryContextCounters grand_totals;
 
 	memset(&grand_totals, 0, sizeof(grand_totals));
 
-	MemoryContextStatsInternal(context, 0, true, max_children, &grand_totals);
+	MemoryContextStatsInternal(context, 0, true, max_children,
+							   print_to_stderr, &grand_totals);
 
-	fprintf(stderr,
-			"Grand total: %zu bytes in %zd blocks; %zu free (%zd chunks); %zu used\n",
-			grand_totals.totalspace, grand_totals.nblocks,
-			grand_totals.freespace, grand_totals.freechunks,
-			grand_totals.totalspace - grand_totals.freespace);
+	if (print_to_stderr)
+		fprintf(stderr,
+				"Grand total: %zu bytes in %zd blocks; %zu free (%zd chunks); %zu used\n",
+				grand_totals.totalspace, grand_totals.nblocks,
+				grand_totals.freespace, grand_totals.freechunks,
+				grand_totals.totalspace - grand_totals.freespace);
+	else
+		ereport(LOG_SERVER_ONLY,
+				(errhidestmt(true),
+				 errhidecontext(true),
+				 errmsg_internal("Grand total: %zu bytes in %zd blocks; %zu free (%zd chunks); %zu used",
+								 grand_totals.totalspace, grand_totals.nblocks,
+								 grand_totals.freespace, grand_totals.freechunks,
+								 grand_totals.totalspace - grand_totals.freespace)));
 }
 
 /*
@@ -508,18 +625,23 @@ MemoryContextStatsDetail(MemoryContext context, int max_children)
 static void
 MemoryContextStatsInternal(MemoryContext context, int level,
 						   bool print, int max_children,
+						   bool print_to_stderr,
 						   MemoryContextCounters *totals)
 {
 	MemoryContextCounters local_totals;
 	MemoryContext child;
+	MemoryContextStatsPrintState pstate;
 	int			ichild;
 
 	AssertArg(MemoryContextIsValid(context));
 
+	pstate.level = level;
+	pstate.print_to_stderr = print_to_stderr;
+
 	/* Examine the context itself */
 	context->methods->stats(context,
 							print ? MemoryContextStatsPrint : NULL,
-							(void *) &level,
+							(void *) &pstate,
 							totals);
 
 	/*
@@ -535,10 +657,12 @@ MemoryContextStatsInternal(MemoryContext context, int level,
 		if (ichild < max_children)
 			MemoryContextStatsInternal(child, level + 1,
 									   print, max_children,
+									   print_to_stderr,
 									   totals);
 		else
 			MemoryContextStatsInternal(child, level + 1,
 									   false, max_children,
+									   print_to_stderr,
 									   &local_totals);
 	}
 
@@ -547,18 +671,33 @@ MemoryContextStatsInternal(MemoryContext context, int level,
 	{
 		if (print)
 		{
-			int			i;
-
-			for (i = 0; i <= level; i++)
-				fprintf(stderr, "  ");
-			fprintf(stderr,
-					"%d more child contexts containing %zu total in %zd blocks; %zu free (%zd chunks); %zu used\n",
-					ichild - max_children,
-					local_totals.totalspace,
-					local_totals.nblocks,
-					local_totals.freespace,
-					local_totals.freechunks,
-					local_totals.totalspace - local_totals.freespace);
+			if (print_to_stderr)
+			{
+				int			i;
+
+				for (i = 0; i <= level; i++)
+					fprintf(stderr, "  ");
+				fprintf(stderr,
+						"%d more child contexts containing %zu total in %zd blocks; %zu free (%zd chunks); %zu used\n",
+						ichild - max_children,
+						local_totals.totalspace,
+						local_totals.nblocks,
+						local_totals.freespace,
+						local_totals.freechunks,
+						local_totals.totalspace - local_totals.freespace);
+			}
+			else
+				ereport(LOG_SERVER_ONLY,
+						(errhidestmt(true),
+						 errhidecontext(true),
+						 errmsg_internal("level: %d; %d more child contexts containing %zu total in %zd blocks; %zu free (%zd chunks); %zu used",
+										 level + 1,
+										 ichild - max_children,
+										 local_totals.totalspace,
+										 local_totals.nblocks,
+										 local_totals.freespace,
+										 local_totals.freechunks,
+										 local_totals.totalspace - local_totals.freespace)));
 		}
 
 		if (totals)
@@ -575,16 +714,18 @@ MemoryContextStatsInternal(MemoryContext context, int level,
  * MemoryContextStatsPrint
  *		Print callback used by MemoryContextStatsInternal
  *
- * For now, the passthru pointer just points to "int level"; later we might
- * make that more complicated.
+ * The passthru pointer points to a MemoryContextStatsPrintState, telling the
+ * nesting level and where the output goes.
  */
 static void
 MemoryContextStatsPrint(MemoryContext context, void *passthru,
 						const char *stats_string)
 {
-	int			level = *(int *) passthru;
+	MemoryContextStatsPrintState *pstate = (MemoryContextStatsPrintState *) passthru;
+	int			level = pstate->level;
 	const char *name = context->name;
 	const char *ident = context->ident;
+	char		truncated_ident[110];
 	int			i;
 
 	/*
@@ -598,9 +739,8 @@ MemoryContextStatsPrint(MemoryContext context, void *passthru,
 		ident = NULL;
 	}
 
-	for (i = 0; i < level; i++)
-		fprintf(stderr, "  ");
-	fprintf(stderr, "%s: %s", name, stats_string);
+	truncated_ident[0] = '\0';
+
 	if (ident)
 	{
 		/*
@@ -612,24 +752,89 @@ MemoryContextStatsPrint(MemoryContext context, void *passthru,
 		int			idlen = strlen(ident);
 		bool		truncated = false;
 
+		strcpy(truncated_ident, ": ");
+		i = strlen(truncated_ident);
+
 		if (idlen > 100)
 		{
 			idlen = pg_mbcliplen(ident, idlen, 100);
 			truncated = true;
 		}
-		fprintf(stderr, ": ");
+
 		while (idlen-- > 0)
 		{
 			unsigned char c = *ident++;
 
 			if (c < ' ')
 				c = ' ';
-			fputc(c, stderr);
+			truncated_ident[i++] = c;
 		}
+		truncated_ident[i] = '\0';
+
 		if (truncated)
-			fprintf(stderr, "...");
+			strcat(truncated_ident, "...");
 	}
-	fputc('\n', stderr);
+
+	if (pstate->print_to_stderr)
+	{
+		for (i = 0; i < level; i++)
+			fprintf(stderr, "  ");
+		fprintf(stderr, "%s: %s%s\n", name, stats_string, truncated_ident);
+	}
+	else
+		ereport(LOG_SERVER_ONLY,
+				(errhidestmt(true),
+				 errhidecontext(true),
+				 errmsg_internal("level: %d; %s: %s%s",
+								 level, name, stats_string, truncated_ident)));
+}
+
+/*
+ * HandleLogMemoryContextInterrupt
+ *		Handle receipt of an interrupt indicating logging of memory
+ *		contexts.
+ *
+ * All the actual work is deferred to ProcessLogMemoryContextInterrupt(),
+ * because we cannot safely emit a log message inside the signal handler.
+ */
+void
+HandleLogMemoryContextInterrupt(void)
+{
+	InterruptPending = true;
+	LogMemoryContextPending = true;
+	/* latch will be set by procsignal_sigusr1_handler */
+}
+
+/*
+ * ProcessLogMemoryContextInterrupt
+ *		Perform logging of memory contexts of this backend process.
+ *
+ * Any backend that participates in ProcSignal signaling must arrange
+ * to call this function if we see LogMemoryContextPending set.
+ * It is called from CHECK_FOR_INTERRUPTS(), which is enough because
+ * the target process for logging of memory contexts is a backend.
+ */
+void
+ProcessLogMemoryContextInterrupt(void)
+{
+	LogMemoryContextPending = false;
+
+	ereport(LOG_SERVER_ONLY,
+			(errhidestmt(true),
+			 errhidecontext(true),
+			 errmsg("logging memory contexts of PID %d", MyProcPid)));
+
+	/*
+	 * When a backend process is consuming huge memory, logging all its memory
+	 * contexts might overrun available disk space.  To prevent this, we limit
+	 * the number of child contexts to log per parent to 100.
+	 *
+	 * As with MemoryContextStats(), we suppose that practical cases where the
+	 * dump gets long will typically be huge numbers of siblings under the
+	 * same parent context; while the additional debugging value from seeing
+	 * details about individual siblings beyond 100 will not be large.
+	 */
+	MemoryContextStatsDetail(TopMemoryContext, 100, false);
 }
 
 /*
@@ -733,6 +938,7 @@ MemoryContextCreate(MemoryContext node,
 	/* Initialize all standard fields of memory context header */
 	node->type = tag;
 	node->isReset = true;
+	node->mem_allocated = 0;
 	node->methods = methods;
 	node->parent = parent;
 	node->firstchild = NULL;
@@ -0,0 +1,193 @@
+/*-------------------------------------------------------------------------
+ *
+ * memlimit.c
+ *	  Cluster-wide budget for memory allocated by backends.
+ *
+ * work_mem limits each sort or hash node in each backend separately, so a
+ * large number of sessions running big queries at once can together use far
+ * more memory than the machine has.  With max_total_backend_memory set, all
+ * processes attached to shared memory publish the amount of memory their
+ * memory contexts have obtained from malloc() in a shared counter, and
+ * executor nodes that can spill to disk consult it when they size their
+ * in-memory workspace, falling back to a smaller budget (and so spilling
+ * earlier) when the cluster as a whole is close to the limit.
+ *
+ * The limit is advisory: nothing fails because it is exceeded, memory that
+ * is already allocated is not given back, and nodes that cannot spill are
+ * not restricted.  The aim is to make the common memory hogs back off before
+ * the kernel has to intervene.
+ *
+ * Each process keeps its own total up to date in MemoryContextNoteAlloc()
+ * and MemoryContextNoteFree(), and only reports to the shared counter when
+ * its total has moved by more than MEMLIMIT_REPORT_GRANULE since the last
+ * report, so the shared cache line is touched rarely.  The shared total may
+ * therefore be off by up to that much per process.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/mmgr/memlimit.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "port/atomics.h"
+#include "storage/ipc.h"
+#include "storage/shmem.h"
+#include "utils/memlimit.h"
+#include "utils/memutils.h"
+
+/*
+ * Report to shared memory when our total has moved by this much.
+ */
+#define MEMLIMIT_REPORT_GRANULE		((Size) 1024 * 1024)
+
+/*
+ * A node is never offered more than this fraction of what is left of the
+ * budget, so that concurrent nodes don't all claim the same headroom, nor
+ * less than MEMLIMIT_MIN_WORKSPACE, so that it can still make progress.
+ */
+#define MEMLIMIT_WORKSPACE_FRACTION	4
+#define MEMLIMIT_MIN_WORKSPACE		((Size) 64 * 1024)
+
+typedef struct MemoryLimitShmemStruct
+{
+	/* sum of the memory reported by all attached processes, in bytes */
+	pg_atomic_uint64 total_allocated;
+} MemoryLimitShmemStruct;
+
+/* GUC parameter, in megabytes; 0 disables the limit */
+int			max_total_backend_memory = 0;
+
+/*
+ * MemoryContextNoteAlloc() and MemoryContextNoteFree() call
+ * MemoryLimitReport() when MemoryContextTotalAllocated crosses these.  The
+ * defaults can never be crossed, which is what we want until we're attached.
+ */
+Size		MemoryLimitReportAbove = SIZE_MAX;
+Size		MemoryLimitReportBelow = 0;
+
+static MemoryLimitShmemStruct *MemoryLimitShmem = NULL;
+
+/* amount of memory we have added to the shared total */
+static Size reported_allocated = 0;
+
+static void MemoryLimitDetach(int code, Datum arg);
+
+
+/*
+ * MemoryLimitShmemSize
+ *		Compute the space needed for the shared memory counter.
+ */
+Size
+MemoryLimitShmemSize(void)
+{
+	return MAXALIGN(sizeof(MemoryLimitShmemStruct));
+}
+
+/*
+ * MemoryLimitShmemInit
+ *		Create or attach to the shared memory counter.
+ */
+void
+MemoryLimitShmemInit(void)
+{
+	bool		found;
+
+	MemoryLimitShmem = (MemoryLimitShmemStruct *)
+		ShmemInitStruct("Memory Limit",
+						MemoryLimitShmemSize(),
+						&found);
+
+	if (!found)
+		pg_atomic_init_u64(&MemoryLimitShmem->total_allocated, 0);
+}
+
+/*
+ * MemoryLimitAttach
+ *		Start reporting this process's memory to the shared counter.
+ *
+ * Called during process initialization, once shared memory is available.
+ * Memory inherited from the postmaster counts as ours from here on.
+ */
+void
+MemoryLimitAttach(void)
+{
+	Assert(MemoryLimitShmem != NULL);
+	Assert(reported_allocated == 0);
+
+	on_shmem_exit(MemoryLimitDetach, 0);
+	MemoryLimitReport();
+}
+
+/*
+ * MemoryLimitDetach
+ *		on_shmem_exit callback: withdraw our memory from the shared counter.
+ */
+static void
+MemoryLimitDetach(int code, Datum arg)
+{
+	pg_atomic_fetch_sub_u64(&MemoryLimitShmem->total_allocated,
+							(int64) reported_allocated);
+	reported_allocated = 0;
+
+	/* stop reporting */
+	MemoryLimitReportAbove = SIZE_MAX;
+	MemoryLimitReportBelow = 0;
+}
+
+/*
+ * MemoryLimitReport
+ *		Bring our contribution to the shared counter up to date.
+ */
+void
+MemoryLimitReport(void)
+{
+	Size		total = MemoryContextTotalAllocated;
+
+	if (total >= reported_allocated)
+		pg_atomic_fetch_add_u64(&MemoryLimitShmem->total_allocated,
+								(int64) (total - reported_allocated));
+	else
+		pg_atomic_fetch_sub_u64(&MemoryLimitShmem->total_allocated,
+								(int64) (reported_allocated - total));
+	reported_allocated = total;
+
+	MemoryLimitReportAbove = total + MEMLIMIT_REPORT_GRANULE;
+	MemoryLimitReportBelow = total > MEMLIMIT_REPORT_GRANULE ?
+		total - MEMLIMIT_REPORT_GRANULE : 0;
+}
+
+/*
+ * MemoryLimitClampWorkspace
+ *		Reduce a node's memory budget if the cluster is short of memory.
+ *
+ * "wanted" is the number of bytes the caller would use under its own limit
+ * (normally work_mem).  The result is what it should use instead, which is
+ * never more than "wanted".
+ */
+Size
+MemoryLimitClampWorkspace(Size wanted)
+{
+	uint64		limit;
+	uint64		total;
+	Size		available;
+
+	if (max_total_backend_memory == 0 || MemoryLimitShmem == NULL)
+		return wanted;
+
+	limit = (uint64) max_total_backend_memory * 1024 * 1024;
+	total = pg_atomic_read_u64(&MemoryLimitShmem->total_allocated);
+
+	if (total >= limit)
+		available = 0;
+	else
+		available = (limit - total) / MEMLIMIT_WORKSPACE_FRACTION;
+
+	if (wanted <= available)
+		return wanted;
+	return Min(wanted, Max(available, MEMLIMIT_MIN_WORKSPACE));
+}
@@ -783,6 +783,31 @@ ResourceOwnerNewParent(ResourceOwner owner,
 	}
 }
 
+/*
+ * Release all plancache references held by a ResourceOwner
+ *
+ * This is for owners that hold plan references on behalf of long-lived data
+ * structures, such as PL/pgSQL's simple-expression resowner, and want to drop
+ * them cleanly before the owner itself is released.  No leak warnings are
+ * issued, since the caller knows the references are still outstanding.
+ */
+void
+ResourceOwnerReleaseAllPlanCacheRefs(ResourceOwner owner)
+{
+	ResourceOwner save = CurrentResourceOwner;
+	Datum		foundres;
+
+	/* ReleaseCachedPlan forgets the reference in CurrentResourceOwner */
+	CurrentResourceOwner = owner;
+	while (ResourceArrayGetAny(&(owner->planrefarr), &foundres))
+	{
+		CachedPlan *res = (CachedPlan *) DatumGetPointer(foundres);
+
+		ReleaseCachedPlan(res, true);
+	}
+	CurrentResourceOwner = save;
+}
+
 /*
  * Register or deregister callback functions for resource cleanup
  *
@@ -47,7 +47,10 @@
  *
  * To further make the I/Os more sequential, we can use a larger buffer
  * when reading, and read multiple blocks from the same tape in one go,
- * whenever the buffer becomes empty.
+ * whenever the buffer becomes empty.  After filling the buffer, we issue
+ * a prefetch hint for the blocks that will be needed to refill it, so that
+ * during a merge the kernel reads one buffer's worth of each input tape
+ * ahead while we are consuming the current one.
  *
  * To support the above policy of writing to the lowest free block,
  * ltsGetFreeBlock sorts the list of free block numbers into decreasing
@@ -151,7 +154,8 @@ typedef struct LogicalTape
 	 * Buffer for current data block(s).
 	 */
 	char	   *buffer;			/* physical buffer (separately palloc'd) */
-	int			buffer_size;	/* allocated size of the buffer */
+	int			buffer_size;	/* allocated size of the buffer (or size to
+								 * allocate, if buffer is still NULL) */
 	int			max_size;		/* highest useful, safe buffer_size */
 	int			pos;			/* next read/write position in buffer */
 	int			nbytes;			/* total # of valid bytes in buffer */
@@ -161,7 +165,8 @@ typedef struct LogicalTape
  * This data structure represents a set of related "logical tapes" sharing
  * space in a single underlying file.  (But that "file" may be multiple files
  * if needed to escape OS limits on file size; buffile.c handles that for us.)
- * The number of tapes is fixed at creation.
+ * The number of tapes is set at creation, but more can be added later with
+ * LogicalTapeSetExtend().
  */
 struct LogicalTapeSet
 {
@@ -202,7 +207,7 @@ struct LogicalTapeSet
 
 	/* The array of logical tapes. */
 	int			nTapes;			/* # of logical tapes in set */
-	LogicalTape tapes[FLEXIBLE_ARRAY_MEMBER];	/* has nTapes nentries */
+	LogicalTape *tapes;			/* has nTapes nentries */
 };
 
 static void ltsWriteBlock(LogicalTapeSet *lts, long blocknum, void *buffer);
@@ -211,6 +216,7 @@ static long ltsGetFreeBlock(LogicalTapeSet *lts);
 static void ltsReleaseBlock(LogicalTapeSet *lts, long blocknum);
 static void ltsConcatWorkerTapes(LogicalTapeSet *lts, TapeShare *shared,
 								 SharedFileSet *fileset);
+static void ltsInitTape(LogicalTape *lt);
 
 
 /*
@@ -318,6 +324,22 @@ ltsReadFillBuffer(LogicalTapeSet *lts, LogicalTape *lt)
 		/* Advance to next block, if we have buffer space left */
 	} while (lt->buffer_size - lt->nbytes > BLCKSZ);
 
+	/*
+	 * Ask the kernel to start reading the blocks needed to refill the buffer
+	 * next time, so that the reads overlap with the caller's processing of
+	 * the data we just read.  We only know the first of those blocks, but
+	 * the blocks of a tape are mostly consecutive (see notes at top of file),
+	 * so we prefetch the range following it.  If that guess is wrong, we
+	 * just waste a little I/O bandwidth.  (pgaio_execute() can read several
+	 * blocks in one batch, but it waits for the whole batch to complete, so
+	 * it can't overlap the reads with our processing; and the blocks after
+	 * the first one aren't known until each has been read anyway.)
+	 */
+	if (lt->nextBlockNumber != -1L)
+		BufFilePrefetchBlocks(lts->pfile,
+							  lt->nextBlockNumber + lt->offsetBlockNumber,
+							  (int) (lt->buffer_size / BLCKSZ));
+
 	return (lt->nbytes > 0);
 }
 
@@ -397,6 +419,31 @@ ltsReleaseBlock(LogicalTapeSet *lts, long blocknum)
 		lts->blocksSorted = false;
 }
 
+/*
+ * Initialize a LogicalTape struct for an empty tape in write state.
+ *
+ * Note we allocate the I/O buffer and the first block for a tape only when it
+ * is first actually written to.  This avoids wasting memory space when
+ * tuplesort.c overestimates the number of tapes needed.
+ */
+static void
+ltsInitTape(LogicalTape *lt)
+{
+	lt->writing = true;
+	lt->frozen = false;
+	lt->dirty = false;
+	lt->firstBlockNumber = -1L;
+	lt->curBlockNumber = -1L;
+	lt->nextBlockNumber = -1L;
+	lt->offsetBlockNumber = 0L;
+	lt->buffer = NULL;
+	lt->buffer_size = 0;
+	/* palloc() larger than MaxAllocSize would fail */
+	lt->max_size = MaxAllocSize;
+	lt->pos = 0;
+	lt->nbytes = 0;
+}
+
 /*
  * Claim ownership of a set of logical tapes from existing shared BufFiles.
  *
@@ -511,15 +558,13 @@ LogicalTapeSetCreate(int ntapes, TapeShare *shared, SharedFileSet *fileset,
 					 int worker)
 {
 	LogicalTapeSet *lts;
-	LogicalTape *lt;
 	int			i;
 
 	/*
 	 * Create top-level struct including per-tape LogicalTape structs.
 	 */
 	Assert(ntapes > 0);
-	lts = (LogicalTapeSet *) palloc(offsetof(LogicalTapeSet, tapes) +
-									ntapes * sizeof(LogicalTape));
+	lts = (LogicalTapeSet *) palloc(sizeof(LogicalTapeSet));
 	lts->nBlocksAllocated = 0L;
 	lts->nBlocksWritten = 0L;
 	lts->nHoleBlocks = 0L;
@@ -529,30 +574,10 @@ LogicalTapeSetCreate(int ntapes, TapeShare *shared, SharedFileSet *fileset,
 	lts->freeBlocks = (long *) palloc(lts->freeBlocksLen * sizeof(long));
 	lts->nFreeBlocks = 0;
 	lts->nTapes = ntapes;
+	lts->tapes = (LogicalTape *) palloc(ntapes * sizeof(LogicalTape));
 
-	/*
-	 * Initialize per-tape structs.  Note we allocate the I/O buffer and the
-	 * first block for a tape only when it is first actually written to.  This
-	 * avoids wasting memory space when tuplesort.c overestimates the number
-	 * of tapes needed.
-	 */
 	for (i = 0; i < ntapes; i++)
-	{
-		lt = &lts->tapes[i];
-		lt->writing = true;
-		lt->frozen = false;
-		lt->dirty = false;
-		lt->firstBlockNumber = -1L;
-		lt->curBlockNumber = -1L;
-		lt->nextBlockNumber = -1L;
-		lt->offsetBlockNumber = 0L;
-		lt->buffer = NULL;
-		lt->buffer_size = 0;
-		/* palloc() larger than MaxAllocSize would fail */
-		lt->max_size = MaxAllocSize;
-		lt->pos = 0;
-		lt->nbytes = 0;
-	}
+		ltsInitTape(&lts->tapes[i]);
 
 	/*
 	 * Create temp BufFile storage as required.
@@ -593,6 +618,7 @@ LogicalTapeSetClose(LogicalTapeSet *lts)
 		if (lt->buffer)
 			pfree(lt->buffer);
 	}
+	pfree(lts->tapes);
 	pfree(lts->freeBlocks);
 	pfree(lts);
 }
@@ -612,6 +638,29 @@ LogicalTapeSetForgetFreeSpace(LogicalTapeSet *lts)
 	lts->forgetFreeSpace = true;
 }
 
+/*
+ * Add additional tapes to this tape set.  The new tapes are numbered
+ * consecutively after the existing ones, and are initialized in write state.
+ *
+ * This is only supported for tape sets that are not shared with other
+ * processes.
+ */
+void
+LogicalTapeSetExtend(LogicalTapeSet *lts, int nAdditional)
+{
+	int			i;
+	int			nTapesOrig = lts->nTapes;
+
+	Assert(nAdditional > 0);
+
+	lts->nTapes += nAdditional;
+	lts->tapes = (LogicalTape *) repalloc(lts->tapes,
+										  lts->nTapes * sizeof(LogicalTape));
+
+	for (i = nTapesOrig; i < lts->nTapes; i++)
+		ltsInitTape(&lts->tapes[i]);
+}
+
 /*
  * Write to a logical tape.
  *
@@ -704,6 +753,10 @@ LogicalTapeWrite(LogicalTapeSet *lts, int tapenum,
  * rounded down and truncated to fit those constraints, if necessary.  If the
  * tape is frozen, the 'buffer_size' argument is ignored, and a small BLCKSZ
  * byte buffer is used.
+ *
+ * For a tape that isn't frozen, the read buffer is not allocated until the
+ * first LogicalTapeRead() call, so that callers can keep many tapes rewound
+ * and waiting to be read without paying for all of their buffers at once.
  */
 void
 LogicalTapeRewindForRead(LogicalTapeSet *lts, int tapenum, size_t buffer_size)
@@ -766,22 +819,30 @@ LogicalTapeRewindForRead(LogicalTapeSet *lts, int tapenum, size_t buffer_size)
 		Assert(lt->frozen);
 	}
 
-	/* Allocate a read buffer (unless the tape is empty) */
 	if (lt->buffer)
 		pfree(lt->buffer);
 	lt->buffer = NULL;
 	lt->buffer_size = 0;
-	if (lt->firstBlockNumber != -1L)
+	lt->nextBlockNumber = lt->firstBlockNumber;
+	lt->pos = 0;
+	lt->nbytes = 0;
+
+	/* Nothing more to do if the tape is empty */
+	if (lt->firstBlockNumber == -1L)
+		return;
+
+	if (lt->frozen)
 	{
+		/* Allocate a read buffer and read the first block */
 		lt->buffer = palloc(buffer_size);
 		lt->buffer_size = buffer_size;
+		ltsReadFillBuffer(lts, lt);
+	}
+	else
+	{
+		/* Just remember the buffer size; see LogicalTapeRead() */
+		lt->buffer_size = buffer_size;
 	}
-
-	/* Read the first block, or reset if tape is empty */
-	lt->nextBlockNumber = lt->firstBlockNumber;
-	lt->pos = 0;
-	lt->nbytes = 0;
-	ltsReadFillBuffer(lts, lt);
 }
 
 /*
@@ -830,6 +891,13 @@ LogicalTapeRead(LogicalTapeSet *lts, int tapenum,
 	lt = &lts->tapes[tapenum];
 	Assert(!lt->writing);
 
+	/* Allocate the read buffer on first read, if the tape isn't empty */
+	if (lt->buffer == NULL && lt->buffer_size > 0)
+	{
+		lt->buffer = palloc(lt->buffer_size);
+		ltsReadFillBuffer(lts, lt);
+	}
+
 	while (size > 0)
 	{
 		if (lt->pos >= lt->nbytes)
@@ -108,6 +108,7 @@
 #include "utils/datum.h"
 #include "utils/logtape.h"
 #include "utils/lsyscache.h"
+#include "utils/memlimit.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
 #include "utils/rel.h"
@@ -226,6 +227,37 @@ typedef enum
 typedef int (*SortTupleComparator) (const SortTuple *a, const SortTuple *b,
 									Tuplesortstate *state);
 
+/*
+ * Radix sorting of in-memory tuples on their leading key.
+ *
+ * When datum1 holds the leading key (or its abbreviation), and the key's
+ * comparator is one of the generic integer comparators from sortsupport.c,
+ * the order of the tuples is determined by the bytes of datum1 alone, except
+ * for ties.  We then sort with an in-place most-significant-digit radix sort
+ * (an "American flag sort"), which needs no comparator calls at all, and fall
+ * back to comparison sorting for small partitions and for groups of tuples
+ * whose leading keys are equal.
+ *
+ * RADIX_SORT_THRESHOLD is the partition size at or below which we use
+ * quicksort instead.
+ */
+#define RADIX_SORT_THRESHOLD	64
+
+typedef enum
+{
+	RADIX_KEY_UNSIGNED,			/* ssup_datum_unsigned_cmp */
+	RADIX_KEY_SIGNED,			/* ssup_datum_signed_cmp */
+	RADIX_KEY_INT32				/* ssup_datum_int32_cmp */
+} RadixKeyKind;
+
+typedef struct RadixSortInfo
+{
+	RadixKeyKind kind;			/* how to map datum1 to an unsigned key */
+	bool		reverse;		/* descending sort? */
+	int			nbytes;			/* number of significant bytes in the key */
+	Tuplesortstate *state;
+} RadixSortInfo;
+
 /*
  * Private state of a Tuplesort operation.
  */
@@ -245,6 +277,7 @@ struct Tuplesortstate
 	int			tapeRange;		/* maxTapes-1 (Knuth's P) */
 	MemoryContext sortcontext;	/* memory context holding most sort data */
 	MemoryContext tuplecontext; /* sub-context of sortcontext for tuple data */
+	bool		tuplecontextIsBump; /* is tuplecontext a bump context? */
 	LogicalTapeSet *tapeset;	/* logtape.c object for tapes in a temp file */
 
 	/*
@@ -419,6 +452,14 @@ struct Tuplesortstate
 	 */
 	SortSupport onlyKey;
 
+	/*
+	 * Is datum1 of the SortTuples the leading sort key?  That's true in all
+	 * cases except for the hash index case, and CLUSTER when the leading
+	 * index column is an expression.  Radix sorting on datum1 is only possible
+	 * when this is set.
+	 */
+	bool		haveDatum1;
+
 	/*
 	 * Additional state for managing "abbreviated key" sortsupport routines
 	 * (which currently may be used by all cases except the hash index case).
@@ -529,6 +570,8 @@ struct Sharedsort
 #define LACKMEM(state)		((state)->availMem < 0 && !(state)->slabAllocatorUsed)
 #define USEMEM(state,amt)	((state)->availMem -= (amt))
 #define FREEMEM(state,amt)	((state)->availMem += (amt))
+#define TUPLESPACE(state,tup,len) \
+	((state)->tuplecontextIsBump ? BumpChunkSpace(len) : GetMemoryChunkSpace(tup))
 #define SERIAL(state)		((state)->shared == NULL)
 #define WORKER(state)		((state)->shared && (state)->worker != -1)
 #define LEADER(state)		((state)->shared && (state)->worker == -1)
@@ -574,6 +617,8 @@ struct Sharedsort
  * a lot better than what we were doing before 7.3.  As of 9.6, a
  * separate memory context is used for caller passed tuples.  Resetting
  * it at certain key increments significantly ameliorates fragmentation.
+ * When that is a bump context, GetMemoryChunkSpace doesn't work, so
+ * TUPLESPACE computes the space from the tuple's length instead.
  * Note that this places a responsibility on readtup and copytup routines
  * to use the right memory context for these tuples (and to not use the
  * reset context for anything whose lifetime needs to span multiple
@@ -590,7 +635,8 @@ struct Sharedsort
 
 static Tuplesortstate *tuplesort_begin_common(int workMem,
 											  SortCoordinate coordinate,
-											  bool randomAccess);
+											  bool randomAccess,
+											  bool bumpTuples);
 static void puttuple_common(Tuplesortstate *state, SortTuple *tuple);
 static bool consider_abort_common(Tuplesortstate *state);
 static void inittapes(Tuplesortstate *state, bool mergeruns);
@@ -605,6 +651,10 @@ static void dumptuples(Tuplesortstate *state, bool alltuples);
 static void make_bounded_heap(Tuplesortstate *state);
 static void sort_bounded_heap(Tuplesortstate *state);
 static void tuplesort_sort_memtuples(Tuplesortstate *state);
+static bool radix_sort_memtuples(Tuplesortstate *state);
+static void radix_sort_tuple(SortTuple *data, size_t n, int level,
+							 RadixSortInfo *info);
+static void radix_sort_ties(SortTuple *data, size_t n, Tuplesortstate *state);
 static void tuplesort_heap_insert(Tuplesortstate *state, SortTuple *tuple);
 static void tuplesort_heap_replace_top(Tuplesortstate *state, SortTuple *tuple);
 static void tuplesort_heap_delete_top(Tuplesortstate *state);
@@ -679,7 +729,7 @@ static void free_sort_tuple(Tuplesortstate *state, SortTuple *stup);
 
 static Tuplesortstate *
 tuplesort_begin_common(int workMem, SortCoordinate coordinate,
-					   bool randomAccess)
+					   bool randomAccess, bool bumpTuples)
 {
 	Tuplesortstate *state;
 	MemoryContext sortcontext;
@@ -706,10 +756,21 @@ tuplesort_begin_common(int workMem, SortCoordinate coordinate,
 	 * fragmentation. Note that the memtuples array of SortTuples is allocated
 	 * in the parent context, not this context, because there is no need to
 	 * free memtuples early.
+	 *
+	 * If the caller says its tuples are formed with nothing but a single
+	 * palloc each, we can use a bump context, since we otherwise only free
+	 * tuples individually when they're written out by dumptuples(), and that
+	 * resets the context right after.  Bounded sorts do free tuples as they
+	 * go; tuplesort_set_bound() switches to an AllocSet in that case.
 	 */
-	tuplecontext = AllocSetContextCreate(sortcontext,
+	if (bumpTuples)
+		tuplecontext = BumpContextCreate(sortcontext,
 										 "Caller tuples",
 										 ALLOCSET_DEFAULT_SIZES);
+	else
+		tuplecontext = AllocSetContextCreate(sortcontext,
+											 "Caller tuples",
+											 ALLOCSET_DEFAULT_SIZES);
 
 	/*
 	 * Make the Tuplesortstate within the per-sort context.  This way, we
@@ -734,12 +795,15 @@ tuplesort_begin_common(int workMem, SortCoordinate coordinate,
 	 * workMem is forced to be at least 64KB, the current minimum valid value
 	 * for the work_mem GUC.  This is a defense against parallel sort callers
 	 * that divide out memory among many workers in a way that leaves each
-	 * with very little memory.
+	 * with very little memory.  We may get less than that if the server as a
+	 * whole is short of memory.
 	 */
-	state->allowedMem = Max(workMem, 64) * (int64) 1024;
+	state->allowedMem =
+		MemoryLimitClampWorkspace(Max(workMem, 64) * (int64) 1024);
 	state->availMem = state->allowedMem;
 	state->sortcontext = sortcontext;
 	state->tuplecontext = tuplecontext;
+	state->tuplecontextIsBump = bumpTuples;
 	state->tapeset = NULL;
 
 	state->memtupcount = 0;
@@ -810,7 +874,7 @@ tuplesort_begin_heap(TupleDesc tupDesc,
 					 int workMem, SortCoordinate coordinate, bool randomAccess)
 {
 	Tuplesortstate *state = tuplesort_begin_common(workMem, coordinate,
-												   randomAccess);
+												   randomAccess, true);
 	MemoryContext oldcontext;
 	int			i;
 
@@ -841,6 +905,7 @@ tuplesort_begin_heap(TupleDesc tupDesc,
 
 	state->tupDesc = tupDesc;	/* assume we need not copy tupDesc */
 	state->abbrevNext = 10;
+	state->haveDatum1 = true;
 
 	/* Prepare SortSupport data for each column */
 	state->sortKeys = (SortSupport) palloc0(nkeys * sizeof(SortSupportData));
@@ -883,7 +948,7 @@ tuplesort_begin_cluster(TupleDesc tupDesc,
 						SortCoordinate coordinate, bool randomAccess)
 {
 	Tuplesortstate *state = tuplesort_begin_common(workMem, coordinate,
-												   randomAccess);
+												   randomAccess, true);
 	BTScanInsert indexScanKey;
 	MemoryContext oldcontext;
 	int			i;
@@ -938,6 +1003,9 @@ tuplesort_begin_cluster(TupleDesc tupDesc,
 		econtext->ecxt_scantuple = slot;
 	}
 
+	/* datum1 is only set up when the leading column is a simple column */
+	state->haveDatum1 = (state->indexInfo->ii_IndexAttrNumbers[0] != 0);
+
 	/* Prepare SortSupport data for each column */
 	state->sortKeys = (SortSupport) palloc0(state->nKeys *
 											sizeof(SortSupportData));
@@ -980,7 +1048,7 @@ tuplesort_begin_index_btree(Relation heapRel,
 							bool randomAccess)
 {
 	Tuplesortstate *state = tuplesort_begin_common(workMem, coordinate,
-												   randomAccess);
+												   randomAccess, false);
 	BTScanInsert indexScanKey;
 	MemoryContext oldcontext;
 	int			i;
@@ -1016,6 +1084,8 @@ tuplesort_begin_index_btree(Relation heapRel,
 
 	indexScanKey = _bt_mkscankey(indexRel, NULL);
 
+	state->haveDatum1 = true;
+
 	/* Prepare SortSupport data for each column */
 	state->sortKeys = (SortSupport) palloc0(state->nKeys *
 											sizeof(SortSupportData));
@@ -1060,7 +1130,7 @@ tuplesort_begin_index_hash(Relation heapRel,
 						   bool randomAccess)
 {
 	Tuplesortstate *state = tuplesort_begin_common(workMem, coordinate,
-												   randomAccess);
+												   randomAccess, false);
 	MemoryContext oldcontext;
 
 	oldcontext = MemoryContextSwitchTo(state->sortcontext);
@@ -1095,13 +1165,82 @@ tuplesort_begin_index_hash(Relation heapRel,
 	return state;
 }
 
+Tuplesortstate *
+tuplesort_begin_index_gist(Relation heapRel,
+						   Relation indexRel,
+						   int workMem,
+						   SortCoordinate coordinate,
+						   bool randomAccess)
+{
+	Tuplesortstate *state = tuplesort_begin_common(workMem, coordinate,
+												   randomAccess, false);
+	MemoryContext oldcontext;
+	int			i;
+
+	oldcontext = MemoryContextSwitchTo(state->sortcontext);
+
+#ifdef TRACE_SORT
+	if (trace_sort)
+		elog(LOG,
+			 "begin index sort: workMem = %d, randomAccess = %c",
+			 workMem, randomAccess ? 't' : 'f');
+#endif
+
+	state->nKeys = IndexRelationGetNumberOfKeyAttributes(indexRel);
+
+	TRACE_POSTGRESQL_SORT_START(INDEX_SORT,
+								false,
+								state->nKeys,
+								workMem,
+								randomAccess,
+								PARALLEL_SORT(state));
+
+	/* The comparison logic is the same as for B-tree, only with no uniqueness */
+	state->comparetup = comparetup_index_btree;
+	state->copytup = copytup_index;
+	state->writetup = writetup_index;
+	state->readtup = readtup_index;
+	state->abbrevNext = 10;
+
+	state->heapRel = heapRel;
+	state->indexRel = indexRel;
+	state->enforceUnique = false;
+
+	state->haveDatum1 = true;
+
+	/* Prepare SortSupport data for each column */
+	state->sortKeys = (SortSupport) palloc0(state->nKeys *
+											sizeof(SortSupportData));
+
+	for (i = 0; i < state->nKeys; i++)
+	{
+		SortSupport sortKey = state->sortKeys + i;
+
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_collation = indexRel->rd_indcollation[i];
+		sortKey->ssup_nulls_first = false;
+		sortKey->ssup_attno = i + 1;
+		/* Convey if abbreviation optimization is applicable in principle */
+		sortKey->abbreviate = (i == 0);
+
+		AssertState(sortKey->ssup_attno != 0);
+
+		/* Look for a sort support function */
+		PrepareSortSupportFromGistIndexRel(indexRel, sortKey);
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return state;
+}
+
 Tuplesortstate *
 tuplesort_begin_datum(Oid datumType, Oid sortOperator, Oid sortCollation,
 					  bool nullsFirstFlag, int workMem,
 					  SortCoordinate coordinate, bool randomAccess)
 {
 	Tuplesortstate *state = tuplesort_begin_common(workMem, coordinate,
-												   randomAccess);
+												   randomAccess, true);
 	MemoryContext oldcontext;
 	int16		typlen;
 	bool		typbyval;
@@ -1136,6 +1275,7 @@ tuplesort_begin_datum(Oid datumType, Oid sortOperator, Oid sortCollation,
 	get_typlenbyval(datumType, &typlen, &typbyval);
 	state->datumTypeLen = typlen;
 	state->tuples = !typbyval;
+	state->haveDatum1 = true;
 
 	/* Prepare SortSupport data */
 	state->sortKeys = (SortSupport) palloc0(sizeof(SortSupportData));
@@ -1208,6 +1348,20 @@ tuplesort_set_bound(Tuplesortstate *state, int64 bound)
 	state->bounded = true;
 	state->bound = (int) bound;
 
+	/*
+	 * A bounded heap discards tuples one at a time, which a bump context
+	 * can't do.  It hasn't been used yet, so just replace it.
+	 */
+	if (state->tuplecontextIsBump)
+	{
+		Assert(MemoryContextIsEmpty(state->tuplecontext));
+		MemoryContextDelete(state->tuplecontext);
+		state->tuplecontext = AllocSetContextCreate(state->sortcontext,
+													"Caller tuples",
+													ALLOCSET_DEFAULT_SIZES);
+		state->tuplecontextIsBump = false;
+	}
+
 	/*
 	 * Bounded sorts are not an effective target for abbreviated key
 	 * optimization.  Disable by setting state to be consistent with no
@@ -1586,7 +1740,9 @@ tuplesort_putdatum(Tuplesortstate *state, Datum val, bool isNull)
 
 		stup.isnull1 = false;
 		stup.tuple = DatumGetPointer(original);
-		USEMEM(state, GetMemoryChunkSpace(stup.tuple));
+		USEMEM(state, TUPLESPACE(state, stup.tuple,
+								 datumGetSize(original, false,
+											  state->datumTypeLen)));
 		MemoryContextSwitchTo(state->sortcontext);
 
 		if (!state->sortKeys->abbrev_converter)
@@ -3312,6 +3468,10 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 
 	if (state->memtupcount > 1)
 	{
+		/* Can we radix sort on the leading key? */
+		if (radix_sort_memtuples(state))
+			return;
+
 		/* Can we use the single-key sort function? */
 		if (state->onlyKey != NULL)
 			qsort_ssup(state->memtuples, state->memtupcount,
@@ -3324,6 +3484,232 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 	}
 }
 
+/*
+ * Sort all memtuples by radix sorting on datum1, if possible.
+ *
+ * Returns false, without changing anything, if the leading key can't be
+ * radix sorted, or if there are too few tuples for it to be worthwhile.
+ */
+static bool
+radix_sort_memtuples(Tuplesortstate *state)
+{
+	SortSupport ssup = state->sortKeys;
+	RadixSortInfo info;
+	SortTuple  *memtuples = state->memtuples;
+	int			nnulls = 0;
+	int			i;
+
+	if (state->memtupcount <= RADIX_SORT_THRESHOLD ||
+		ssup == NULL || !state->haveDatum1)
+		return false;
+
+	if (ssup->comparator == ssup_datum_unsigned_cmp)
+	{
+		info.kind = RADIX_KEY_UNSIGNED;
+		info.nbytes = SIZEOF_DATUM;
+	}
+#if SIZEOF_DATUM >= 8
+	else if (ssup->comparator == ssup_datum_signed_cmp)
+	{
+		info.kind = RADIX_KEY_SIGNED;
+		info.nbytes = 8;
+	}
+#endif
+	else if (ssup->comparator == ssup_datum_int32_cmp)
+	{
+		info.kind = RADIX_KEY_INT32;
+		info.nbytes = 4;
+	}
+	else
+		return false;
+
+	info.reverse = ssup->ssup_reverse;
+	info.state = state;
+
+	/*
+	 * Move the tuples with a NULL leading key to the front or the back, as
+	 * ApplySortComparator() would order them.
+	 */
+	if (ssup->ssup_nulls_first)
+	{
+		for (i = 0; i < state->memtupcount; i++)
+		{
+			if (memtuples[i].isnull1)
+			{
+				SortTuple	tmp = memtuples[i];
+
+				memtuples[i] = memtuples[nnulls];
+				memtuples[nnulls] = tmp;
+				nnulls++;
+			}
+		}
+		radix_sort_ties(memtuples, nnulls, state);
+		radix_sort_tuple(memtuples + nnulls, state->memtupcount - nnulls,
+						 0, &info);
+	}
+	else
+	{
+		int			nonnulls = state->memtupcount;
+
+		for (i = state->memtupcount - 1; i >= 0; i--)
+		{
+			if (memtuples[i].isnull1)
+			{
+				SortTuple	tmp = memtuples[i];
+
+				nonnulls--;
+				memtuples[i] = memtuples[nonnulls];
+				memtuples[nonnulls] = tmp;
+				nnulls++;
+			}
+		}
+		radix_sort_tuple(memtuples, nonnulls, 0, &info);
+		radix_sort_ties(memtuples + nonnulls, nnulls, state);
+	}
+
+	return true;
+}
+
+/*
+ * Get the radix sort key of a tuple, as an unsigned integer whose order
+ * matches the sort order of the leading key.
+ */
+static inline uint64
+radix_sort_key(const SortTuple *stup, const RadixSortInfo *info)
+{
+	uint64		key;
+
+	switch (info->kind)
+	{
+		case RADIX_KEY_UNSIGNED:
+			key = ((uint64) stup->datum1) << (64 - SIZEOF_DATUM * BITS_PER_BYTE);
+			break;
+		case RADIX_KEY_SIGNED:
+			key = ((uint64) stup->datum1) ^ (UINT64CONST(1) << 63);
+			break;
+		case RADIX_KEY_INT32:
+		default:
+			key = ((uint64) ((uint32) DatumGetInt32(stup->datum1) ^
+							 UINT64CONST(0x80000000))) << 32;
+			break;
+	}
+
+	return info->reverse ? ~key : key;
+}
+
+/*
+ * Get the byte of the radix sort key that's used at the given level, most
+ * significant byte first.
+ */
+static inline int
+radix_sort_byte(const SortTuple *stup, int level, const RadixSortInfo *info)
+{
+	return (int) ((radix_sort_key(stup, info) >> (56 - level * 8)) & 0xFF);
+}
+
+/*
+ * Radix sort the given non-NULL tuples, starting at the given level.  All the
+ * tuples' keys have the same bytes above that level.
+ */
+static void
+radix_sort_tuple(SortTuple *data, size_t n, int level, RadixSortInfo *info)
+{
+	size_t		counts[256];
+	size_t		next[256];
+	size_t		end[256];
+	size_t		pos;
+	int			b;
+	size_t		i;
+
+	if (n <= 1)
+		return;
+
+	if (n <= RADIX_SORT_THRESHOLD)
+	{
+		if (info->state->onlyKey != NULL)
+			qsort_ssup(data, n, info->state->onlyKey);
+		else
+			qsort_tuple(data, n, info->state->comparetup, info->state);
+		return;
+	}
+
+	/*
+	 * Count the tuples in each bucket, skipping levels where all the tuples
+	 * fall into the same bucket.
+	 */
+	for (;;)
+	{
+		if (level >= info->nbytes)
+		{
+			/* all the leading keys are equal */
+			radix_sort_ties(data, n, info->state);
+			return;
+		}
+
+		memset(counts, 0, sizeof(counts));
+		for (i = 0; i < n; i++)
+			counts[radix_sort_byte(&data[i], level, info)]++;
+
+		if (counts[radix_sort_byte(&data[0], level, info)] != n)
+			break;
+		level++;
+	}
+
+	pos = 0;
+	for (b = 0; b < 256; b++)
+	{
+		next[b] = pos;
+		pos += counts[b];
+		end[b] = pos;
+	}
+
+	/*
+	 * Permute the tuples into their buckets, by swapping each misplaced tuple
+	 * into the next free position of the bucket where it belongs.
+	 */
+	for (b = 0; b < 256; b++)
+	{
+		while (next[b] < end[b])
+		{
+			int			d = radix_sort_byte(&data[next[b]], level, info);
+
+			if (d == b)
+				next[b]++;
+			else
+			{
+				SortTuple	tmp = data[next[b]];
+
+				data[next[b]] = data[next[d]];
+				data[next[d]] = tmp;
+				next[d]++;
+			}
+		}
+	}
+
+	/* sort each bucket on the remaining bytes */
+	pos = 0;
+	for (b = 0; b < 256; b++)
+	{
+		if (counts[b] > 1)
+			radix_sort_tuple(data + pos, counts[b], level + 1, info);
+		pos += counts[b];
+	}
+}
+
+/*
+ * Sort tuples whose leading keys are all equal (or all NULL).
+ *
+ * In the single-key case, the tuples are all equal already.  Otherwise the
+ * order is decided by comparetup, which also takes care of resolving
+ * abbreviated key ties and of enforcing unique indexes.
+ */
+static void
+radix_sort_ties(SortTuple *data, size_t n, Tuplesortstate *state)
+{
+	if (n > 1 && state->onlyKey == NULL)
+		qsort_tuple(data, n, state->comparetup, state);
+}
+
 /*
  * Insert a new tuple into an empty or existing heap, maintaining the
  * heap invariant.  Caller is responsible for ensuring there's room.
@@ -3583,7 +3969,7 @@ copytup_heap(Tuplesortstate *state, SortTuple *stup, void *tup)
 	/* copy the tuple into sort storage */
 	tuple = ExecCopySlotMinimalTuple(slot);
 	stup->tuple = (void *) tuple;
-	USEMEM(state, GetMemoryChunkSpace(tuple));
+	USEMEM(state, TUPLESPACE(state, tuple, tuple->t_len));
 	/* set up first-column key value */
 	htup.t_len = tuple->t_len + MINIMAL_TUPLE_OFFSET;
 	htup.t_data = (HeapTupleHeader) ((char *) tuple - MINIMAL_TUPLE_OFFSET);
@@ -3667,8 +4053,10 @@ writetup_heap(Tuplesortstate *state, int tapenum, SortTuple *stup)
 
 	if (!state->slabAllocatorUsed)
 	{
-		FREEMEM(state, GetMemoryChunkSpace(tuple));
-		heap_free_minimal_tuple(tuple);
+		FREEMEM(state, TUPLESPACE(state, tuple, tuple->t_len));
+		/* a bump context is reset by dumptuples() instead */
+		if (!state->tuplecontextIsBump)
+			heap_free_minimal_tuple(tuple);
 	}
 }
 
@@ -3825,7 +4213,7 @@ copytup_cluster(Tuplesortstate *state, SortTuple *stup, void *tup)
 	/* copy the tuple into sort storage */
 	tuple = heap_copytuple(tuple);
 	stup->tuple = (void *) tuple;
-	USEMEM(state, GetMemoryChunkSpace(tuple));
+	USEMEM(state, TUPLESPACE(state, tuple, HEAPTUPLESIZE + tuple->t_len));
 
 	MemoryContextSwitchTo(oldcontext);
 
@@ -3907,8 +4295,10 @@ writetup_cluster(Tuplesortstate *state, int tapenum, SortTuple *stup)
 
 	if (!state->slabAllocatorUsed)
 	{
-		FREEMEM(state, GetMemoryChunkSpace(tuple));
-		heap_freetuple(tuple);
+		FREEMEM(state, TUPLESPACE(state, tuple, HEAPTUPLESIZE + tuple->t_len));
+		/* a bump context is reset by dumptuples() instead */
+		if (!state->tuplecontextIsBump)
+			heap_freetuple(tuple);
 	}
 }
 
@@ -4314,8 +4704,10 @@ writetup_datum(Tuplesortstate *state, int tapenum, SortTuple *stup)
 
 	if (!state->slabAllocatorUsed && stup->tuple)
 	{
-		FREEMEM(state, GetMemoryChunkSpace(stup->tuple));
-		pfree(stup->tuple);
+		FREEMEM(state, TUPLESPACE(state, stup->tuple, tuplen));
+		/* a bump context is reset by dumptuples() instead */
+		if (!state->tuplecontextIsBump)
+			pfree(stup->tuple);
 	}
 }
 
@@ -4585,6 +4977,8 @@ leader_takeover_tapes(Tuplesortstate *state)
 static void
 free_sort_tuple(Tuplesortstate *state, SortTuple *stup)
 {
+	/* only bounded sorts get here, and they never use a bump context */
+	Assert(!state->tuplecontextIsBump);
 	FREEMEM(state, GetMemoryChunkSpace(stup->tuple));
 	pfree(stup->tuple);
 }
@@ -604,6 +604,9 @@ SetTransactionSnapshot(Snapshot sourcesnap, VirtualTransactionId *sourcevxid,
 	CurrentSnapshot->takenDuringRecovery = sourcesnap->takenDuringRecovery;
 	/* NB: curcid should NOT be copied, it's a local matter */
 
+	/* This isn't what GetSnapshotData computed anymore, so don't reuse it */
+	CurrentSnapshot->snapXactCompletionCount = 0;
+
 	/*
 	 * Now we have to fix what GetSnapshotData did with MyPgXact->xmin and
 	 * TransactionXmin.  There is a race condition: to make sure we are not
@@ -2189,6 +2192,7 @@ RestoreSnapshot(char *start_address)
 	snapshot->curcid = serialized_snapshot.curcid;
 	snapshot->whenTaken = serialized_snapshot.whenTaken;
 	snapshot->lsn = serialized_snapshot.lsn;
+	snapshot->snapXactCompletionCount = 0;
 
 	/* Copy XIDs, if present. */
 	if (serialized_snapshot.xcnt > 0)
@@ -2285,11 +2289,32 @@ XidInMVCCSnapshot(TransactionId xid, Snapshot snapshot)
 		}
 		else
 		{
+			TransactionId topxid;
+
+			/*
+			 * A running top-level XID needs no conversion; check for it
+			 * first, since that's cheap and saves a pg_subtrans lookup.
+			 */
+			for (i = 0; i < snapshot->xcnt; i++)
+			{
+				if (TransactionIdEquals(xid, snapshot->xip[i]))
+					return true;
+			}
+
 			/*
 			 * Snapshot overflowed, so convert xid to top-level.  This is safe
-			 * because we eliminated too-old XIDs above.
+			 * because we eliminated too-old XIDs above.  The subxid overflow
+			 * arrays of running transactions usually have the answer; only
+			 * go to pg_subtrans if they don't.
 			 */
-			xid = SubTransGetTopmostTransaction(xid);
+			topxid = SubXidOverflowGetTopmost(xid);
+			if (!TransactionIdIsValid(topxid))
+				topxid = SubTransGetTopmostTransaction(xid);
+
+			/* If xid wasn't a subxact, we already know it's not running */
+			if (TransactionIdEquals(topxid, xid))
+				return false;
+			xid = topxid;
 
 			/*
 			 * If xid was indeed a subxact, we might now have an xid < xmin,
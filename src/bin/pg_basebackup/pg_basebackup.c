@@ -17,6 +17,9 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 #include <signal.h>
 #include <time.h>
 #ifdef HAVE_SYS_SELECT_H
@@ -25,6 +28,9 @@
 #ifdef HAVE_LIBZ
 #include <zlib.h>
 #endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 
 #include "access/xlog_internal.h"
 #include "common/file_perm.h"
@@ -43,6 +49,10 @@
 
 #define ERRCODE_DATA_CORRUPTED	"XX001"
 
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
 typedef struct TablespaceListCell
 {
 	struct TablespaceListCell *next;
@@ -93,6 +103,11 @@ static bool checksum_failure = false;
 static bool showprogress = false;
 static int	verbose = 0;
 static int	compresslevel = 0;
+static bool use_zstd = false;
+static int	compressworkers = 0;
+static int	numjobs = 1;
+static char *incremental_dir = NULL;
+static XLogRecPtr incremental_lsn = InvalidXLogRecPtr;
 static IncludeWal includewal = STREAM_WAL;
 static bool fastcheckpoint = false;
 static bool writerecoveryconf = false;
@@ -137,6 +152,20 @@ static int	has_xlogendptr = 0;
 static volatile LONG has_xlogendptr = 0;
 #endif
 
+/*
+ * In a parallel backup, each of the other parts is received by a child
+ * process over a connection of its own.  backup_part is the part received
+ * by this process, 0 in the leader.  The children report their progress in
+ * partsdone, which is shared with the leader.
+ */
+static int	backup_part = 0;
+static pid_t *partchildren = NULL;
+static volatile uint64 *partsdone = NULL;
+static PGcancel *leadercancel = NULL;
+
+/* Exit status of a part that failed only because of checksum errors */
+#define PART_EXIT_CHECKSUM_FAILURE	2
+
 /* Contents of configuration file to be generated */
 static PQExpBuffer recoveryconfcontents = NULL;
 
@@ -150,6 +179,12 @@ static void ReceiveAndUnpackTarFile(PGconn *conn, PGresult *res, int rownum);
 static void GenerateRecoveryConf(PGconn *conn);
 static void WriteRecoveryConf(void);
 static void BaseBackup(void);
+#ifndef WIN32
+static void StartBackupParts(PGresult *res);
+static void ReceiveBackupPart(PGresult *leaderres, int part, int leaderpid);
+static void SkipCopyStream(PGconn *conn);
+static void WaitForBackupParts(void);
+#endif
 
 static bool reached_end_position(XLogRecPtr segendpos, uint32 timeline,
 								 bool segment_finished);
@@ -161,7 +196,8 @@ static void tablespace_list_append(const char *arg);
 static void
 cleanup_directories_atexit(void)
 {
-	if (success || in_log_streamer)
+	/* The leader cleans up after a parallel backup */
+	if (success || in_log_streamer || backup_part > 0)
 		return;
 
 	if (!noclean && !checksum_failure)
@@ -224,6 +260,38 @@ kill_bgchild_atexit(void)
 	if (bgchild > 0)
 		kill(bgchild, SIGTERM);
 }
+
+/*
+ * Likewise, kill the processes receiving the other parts of a parallel
+ * backup if the leader fails.
+ */
+static void
+kill_parts_atexit(void)
+{
+	int			i;
+
+	if (backup_part > 0)
+		return;
+
+	for (i = 1; i < numjobs; i++)
+		if (partchildren[i] > 0)
+			kill(partchildren[i], SIGTERM);
+}
+
+/*
+ * If a part of a parallel backup fails, the server would wait for it
+ * forever before finishing the backup, so cancel the leader's command.
+ */
+static void
+cancel_leader_atexit(void)
+{
+	char		errbuf[256];
+
+	if (success || checksum_failure)
+		return;
+
+	(void) PQcancel(leadercancel, errbuf, sizeof(errbuf));
+}
 #endif
 
 /*
@@ -305,6 +373,11 @@ tablespace_list_append(const char *arg)
 }
 
 
+#ifdef HAVE_LIBZSTD
+/* zstd context of the tar file being received, if compressing with zstd */
+static ZSTD_CCtx *tarzstdctx = NULL;
+#endif
+
 #ifdef HAVE_LIBZ
 static const char *
 get_gz_error(gzFile gzf)
@@ -341,10 +414,15 @@ usage(void)
 			 "                         include required WAL files with specified method\n"));
 	printf(_("  -z, --gzip             compress tar output\n"));
 	printf(_("  -Z, --compress=0-9     compress tar output with given compression level\n"));
+	printf(_("      --compression-method=gzip|zstd\n"
+			 "                         method to compress tar output with (default: gzip)\n"));
+	printf(_("      --compress-workers=NUM\n"
+			 "                         number of threads to compress with zstd\n"));
 	printf(_("\nGeneral options:\n"));
 	printf(_("  -c, --checkpoint=fast|spread\n"
 			 "                         set fast or spread checkpointing\n"));
 	printf(_("  -C, --create-slot      create replication slot\n"));
+	printf(_("  -j, --jobs=NUM         use this many parallel connections to back up\n"));
 	printf(_("  -l, --label=LABEL      set backup label\n"));
 	printf(_("  -n, --no-clean         do not clean up after errors\n"));
 	printf(_("  -N, --no-sync          do not wait for changes to be written safely to disk\n"));
@@ -352,6 +430,8 @@ usage(void)
 	printf(_("  -S, --slot=SLOTNAME    replication slot to use\n"));
 	printf(_("  -v, --verbose          output verbose messages\n"));
 	printf(_("  -V, --version          output version information, then exit\n"));
+	printf(_("      --incremental=DIR\n"
+			 "                         send only what changed since the backup in DIR\n"));
 	printf(_("      --no-slot          prevent creation of temporary replication slot\n"));
 	printf(_("      --no-verify-checksums\n"
 			 "                         do not verify checksums\n"));
@@ -496,8 +576,12 @@ LogStreamerMain(logstreamer_param *param)
 		stream.walmethod = CreateWalDirectoryMethod(param->xlog, 0,
 													stream.do_sync);
 	else
-		stream.walmethod = CreateWalTarMethod(param->xlog, compresslevel,
+	{
+		/* The WAL tar method only knows gzip, so leave pg_wal.tar plain */
+		stream.walmethod = CreateWalTarMethod(param->xlog,
+											  use_zstd ? 0 : compresslevel,
 											  stream.do_sync);
+	}
 
 	if (!ReceiveXlogStream(param->bgconn, &stream))
 
@@ -716,6 +800,21 @@ progress_report(int tablespacenum, const char *filename, bool force)
 	char		totaldone_str[32];
 	char		totalsize_str[32];
 	pg_time_t	now;
+	uint64		done = totaldone;
+
+	/* In a parallel backup, only the leader reports the sum of all parts */
+	if (partsdone)
+	{
+		int			i;
+
+		partsdone[backup_part] = totaldone;
+		if (backup_part > 0)
+			return;
+
+		done = 0;
+		for (i = 0; i < numjobs; i++)
+			done += partsdone[i];
+	}
 
 	if (!showprogress)
 		return;
@@ -725,7 +824,7 @@ progress_report(int tablespacenum, const char *filename, bool force)
 		return;					/* Max once per second */
 
 	last_progress_report = now;
-	percent = totalsize ? (int) ((totaldone / 1024) * 100 / totalsize) : 0;
+	percent = totalsize ? (int) ((done / 1024) * 100 / totalsize) : 0;
 
 	/*
 	 * Avoid overflowing past 100% or the full size. This may make the total
@@ -735,8 +834,8 @@ progress_report(int tablespacenum, const char *filename, bool force)
 	 */
 	if (percent > 100)
 		percent = 100;
-	if (totaldone / 1024 > totalsize)
-		totalsize = totaldone / 1024;
+	if (done / 1024 > totalsize)
+		totalsize = done / 1024;
 
 	/*
 	 * Separate step to keep platform-dependent format code out of
@@ -744,7 +843,7 @@ progress_report(int tablespacenum, const char *filename, bool force)
 	 * in snprintf, not fprintf.
 	 */
 	snprintf(totaldone_str, sizeof(totaldone_str), INT64_FORMAT,
-			 totaldone / 1024);
+			 done / 1024);
 	snprintf(totalsize_str, sizeof(totalsize_str), INT64_FORMAT, totalsize);
 
 #define VERBOSE_FILENAME_LENGTH 35
@@ -879,6 +978,132 @@ parse_max_rate(char *src)
 	return (int32) result;
 }
 
+#ifdef HAVE_LIBZSTD
+/*
+ * Set up a zstd compression context for a tar file, with the requested
+ * compression level and number of worker threads.
+ */
+static ZSTD_CCtx *
+createZstdContext(void)
+{
+	ZSTD_CCtx  *cctx;
+	size_t		ret;
+
+	cctx = ZSTD_createCCtx();
+	if (cctx == NULL)
+	{
+		pg_log_error("could not create zstd compression context");
+		exit(1);
+	}
+
+	ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, compresslevel);
+	if (ZSTD_isError(ret))
+	{
+		pg_log_error("could not set compression level %d: %s",
+					 compresslevel, ZSTD_getErrorName(ret));
+		exit(1);
+	}
+
+	/* Fails if libzstd was built without multithreading support */
+	if (compressworkers > 0)
+	{
+		ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, compressworkers);
+		if (ZSTD_isError(ret))
+		{
+			pg_log_error("could not set number of compression workers to %d: %s",
+						 compressworkers, ZSTD_getErrorName(ret));
+			exit(1);
+		}
+	}
+
+	return cctx;
+}
+
+/*
+ * Feed a piece of tar data to the zstd compressor and write out whatever
+ * compressed output it produces.  With "end" set, the frame is finished and
+ * everything still buffered in the compressor is flushed.
+ */
+static void
+writeZstdData(FILE *tarfile, char *buf, int r, bool end, char *current_file)
+{
+	static char *outbuf = NULL;
+	static size_t outbufsize = 0;
+	ZSTD_inBuffer in = {buf, r, 0};
+
+	if (outbuf == NULL)
+	{
+		outbufsize = ZSTD_CStreamOutSize();
+		outbuf = pg_malloc(outbufsize);
+	}
+
+	for (;;)
+	{
+		ZSTD_outBuffer out = {outbuf, outbufsize, 0};
+		size_t		remaining;
+
+		remaining = ZSTD_compressStream2(tarzstdctx, &out, &in,
+										 end ? ZSTD_e_end : ZSTD_e_continue);
+		if (ZSTD_isError(remaining))
+		{
+			pg_log_error("could not compress data for file \"%s\": %s",
+						 current_file, ZSTD_getErrorName(remaining));
+			exit(1);
+		}
+
+		if (out.pos > 0 && fwrite(outbuf, out.pos, 1, tarfile) != 1)
+		{
+			pg_log_error("could not write to compressed file \"%s\": %m",
+						 current_file);
+			exit(1);
+		}
+
+		if (end ? remaining == 0 : in.pos == in.size)
+			break;
+	}
+}
+#endif
+
+/*
+ * Read the start location of the backup in the given directory from its
+ * backup_label, as the point to take an incremental backup from.
+ */
+static XLogRecPtr
+GetPriorBackupStart(const char *dir)
+{
+	char		path[MAXPGPATH];
+	char		line[MAXPGPATH];
+	FILE	   *fp;
+	uint32		hi,
+				lo;
+	bool		found = false;
+
+	snprintf(path, sizeof(path), "%s/backup_label", dir);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		pg_log_error("could not open file \"%s\": %m", path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (sscanf(line, "START WAL LOCATION: %X/%X", &hi, &lo) == 2)
+		{
+			found = true;
+			break;
+		}
+	}
+	fclose(fp);
+
+	if (!found)
+	{
+		pg_log_error("could not find start location in file \"%s\"", path);
+		exit(1);
+	}
+
+	return ((uint64) hi) << 32 | lo;
+}
+
 /*
  * Write a piece of tar data
  */
@@ -900,6 +1125,11 @@ writeTarData(
 		}
 	}
 	else
+#endif
+#ifdef HAVE_LIBZSTD
+	if (tarzstdctx != NULL)
+		writeZstdData(tarfile, buf, r, false, current_file);
+	else
 #endif
 	{
 		if (fwrite(buf, r, 1, tarfile) != 1)
@@ -921,8 +1151,8 @@ writeTarData(
  * the data from this file directly into a tar file. If compression is
  * enabled, the data will be compressed while written to the file.
  *
- * The file will be named base.tar[.gz] if it's for the main data directory
- * or <tablespaceoid>.tar[.gz] if it's for another tablespace.
+ * The file will be named base.tar[.gz|.zst] if it's for the main data
+ * directory or <tablespaceoid>.tar[.gz|.zst] if it's for another tablespace.
  *
  * No attempt to inspect or validate the contents of the file is done.
  */
@@ -962,8 +1192,12 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 			_setmode(fileno(stdout), _O_BINARY);
 #endif
 
+#ifdef HAVE_LIBZSTD
+			if (use_zstd)
+				tarzstdctx = createZstdContext();
+#endif
 #ifdef HAVE_LIBZ
-			if (compresslevel != 0)
+			if (compresslevel != 0 && !use_zstd)
 			{
 				ztarfile = gzdopen(dup(fileno(stdout)), "wb");
 				if (gzsetparams(ztarfile, compresslevel,
@@ -981,6 +1215,15 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 		}
 		else
 		{
+#ifdef HAVE_LIBZSTD
+			if (use_zstd)
+			{
+				snprintf(filename, sizeof(filename), "%s/base.tar.zst", basedir);
+				tarzstdctx = createZstdContext();
+				tarfile = fopen(filename, "wb");
+			}
+			else
+#endif
 #ifdef HAVE_LIBZ
 			if (compresslevel != 0)
 			{
@@ -1007,6 +1250,16 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 		/*
 		 * Specific tablespace
 		 */
+#ifdef HAVE_LIBZSTD
+		if (use_zstd)
+		{
+			snprintf(filename, sizeof(filename), "%s/%s.tar.zst", basedir,
+					 PQgetvalue(res, rownum, 0));
+			tarzstdctx = createZstdContext();
+			tarfile = fopen(filename, "wb");
+		}
+		else
+#endif
 #ifdef HAVE_LIBZ
 		if (compresslevel != 0)
 		{
@@ -1031,7 +1284,7 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 	}
 
 #ifdef HAVE_LIBZ
-	if (compresslevel != 0)
+	if (compresslevel != 0 && !use_zstd)
 	{
 		if (!ztarfile)
 		{
@@ -1044,7 +1297,7 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 	else
 #endif
 	{
-		/* Either no zlib support, or zlib support but compresslevel = 0 */
+		/* Uncompressed, or compressed with zstd on the way to the file */
 		if (!tarfile)
 		{
 			pg_log_error("could not create file \"%s\": %m", filename);
@@ -1138,6 +1391,15 @@ ReceiveTarFile(PGconn *conn, PGresult *res, int rownum)
 			/* 2 * 512 bytes empty data at end of file */
 			WRITE_TAR_DATA(zerobuf, sizeof(zerobuf));
 
+#ifdef HAVE_LIBZSTD
+			if (tarzstdctx != NULL)
+			{
+				writeZstdData(tarfile, NULL, 0, true, filename);
+				ZSTD_freeCCtx(tarzstdctx);
+				tarzstdctx = NULL;
+			}
+#endif
+
 #ifdef HAVE_LIBZ
 			if (ztarfile != NULL)
 			{
@@ -1498,10 +1760,14 @@ ReceiveAndUnpackTarFile(PGconn *conn, PGresult *res, int rownum)
 						 * already been created as a symbolic link before
 						 * starting the actual backup. So just ignore creation
 						 * failures on related directories.
+						 *
+						 * In a parallel backup, the other parts create the
+						 * directories they need too.
 						 */
 						if (!((pg_str_endswith(filename, "/pg_wal") ||
 							   pg_str_endswith(filename, "/pg_xlog") ||
-							   pg_str_endswith(filename, "/archive_status")) &&
+							   pg_str_endswith(filename, "/archive_status") ||
+							   numjobs > 1) &&
 							  errno == EEXIST))
 						{
 							pg_log_error("could not create directory \"%s\": %m",
@@ -1552,6 +1818,27 @@ ReceiveAndUnpackTarFile(PGconn *conn, PGresult *res, int rownum)
 			 * regular file
 			 */
 			file = fopen(filename, "wb");
+
+			/*
+			 * In a parallel backup, the directory might not have been created
+			 * by the leader yet.  Create it here; the leader sets its
+			 * permissions when it gets to it.
+			 */
+			while (!file && errno == ENOENT && numjobs > 1)
+			{
+				char		dirpath[MAXPGPATH];
+
+				strlcpy(dirpath, filename, sizeof(dirpath));
+				get_parent_directory(dirpath);
+				if (pg_mkdir_p(dirpath, pg_dir_create_mode) != 0 &&
+					errno != EEXIST)
+				{
+					pg_log_error("could not create directory \"%s\": %m",
+								 dirpath);
+					exit(1);
+				}
+				file = fopen(filename, "wb");
+			}
 			if (!file)
 			{
 				pg_log_error("could not create file \"%s\": %m", filename);
@@ -1624,7 +1911,7 @@ ReceiveAndUnpackTarFile(PGconn *conn, PGresult *res, int rownum)
 	if (copybuf != NULL)
 		PQfreemem(copybuf);
 
-	if (basetablespace && writerecoveryconf)
+	if (basetablespace && writerecoveryconf && backup_part == 0)
 		WriteRecoveryConf();
 
 	/*
@@ -1784,6 +2071,226 @@ WriteRecoveryConf(void)
 }
 
 
+#ifndef WIN32
+/*
+ * Start a child process for each of the other parts of a parallel backup.
+ * 'res' is the tablespace header of the leader's backup.
+ */
+static void
+StartBackupParts(PGresult *res)
+{
+	int			leaderpid = PQbackendPID(conn);
+	int			i;
+
+	partsdone = mmap(NULL, numjobs * sizeof(uint64), PROT_READ | PROT_WRITE,
+					 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (partsdone == MAP_FAILED)
+	{
+		pg_log_error("could not allocate shared memory: %m");
+		exit(1);
+	}
+	memset((void *) partsdone, 0, numjobs * sizeof(uint64));
+
+	leadercancel = PQgetCancel(conn);
+	if (leadercancel == NULL)
+	{
+		pg_log_error("could not get cancel request for the backup");
+		exit(1);
+	}
+
+	partchildren = pg_malloc0(numjobs * sizeof(pid_t));
+	atexit(kill_parts_atexit);
+
+	if (verbose)
+		pg_log_info("starting %d more connections for parallel backup",
+					numjobs - 1);
+
+	/* Flush stdio, so that the children don't print it again */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 1; i < numjobs; i++)
+	{
+		pid_t		pid = fork();
+
+		if (pid == 0)
+			ReceiveBackupPart(res, i, leaderpid);	/* does not return */
+		else if (pid < 0)
+		{
+			pg_log_error("could not create child process: %m");
+			exit(1);
+		}
+		partchildren[i] = pid;
+	}
+}
+
+/*
+ * Receive one of the other parts of a parallel backup, in a child process.
+ *
+ * Each tablespace is unpacked into the same directory as the leader's, so
+ * they are matched up by OID with the leader's tablespace header.
+ */
+static void
+ReceiveBackupPart(PGresult *leaderres, int part, int leaderpid)
+{
+	PGresult   *res;
+	char		maxrate_clause[32] = "";
+	char		incremental_clause[64] = "";
+	char	   *command;
+	int			i;
+
+	backup_part = part;
+
+	/* The log streamer and the other parts belong to the leader */
+	bgchild = -1;
+	atexit(cancel_leader_atexit);
+
+	/* The leader's connection is not ours to use */
+	conn = GetConnection();
+	if (!conn)
+		exit(1);
+
+	if (maxrate > 0)
+		snprintf(maxrate_clause, sizeof(maxrate_clause), "MAX_RATE %u",
+				 maxrate);
+	if (!XLogRecPtrIsInvalid(incremental_lsn))
+		snprintf(incremental_clause, sizeof(incremental_clause),
+				 "INCREMENTAL %X/%X",
+				 (uint32) (incremental_lsn >> 32),
+				 (uint32) incremental_lsn);
+
+	command = psprintf("BASE_BACKUP PARALLEL %d PART %d LEADER %d %s %s %s",
+					   numjobs, part, leaderpid,
+					   maxrate_clause,
+					   verify_checksums ? "" : "NOVERIFY_CHECKSUMS",
+					   incremental_clause);
+
+	if (PQsendQuery(conn, command) == 0)
+	{
+		pg_log_error("could not send replication command \"%s\": %s",
+					 "BASE_BACKUP", PQerrorMessage(conn));
+		exit(1);
+	}
+
+	res = PQgetResult(conn);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		pg_log_error("could not get backup header: %s",
+					 PQerrorMessage(conn));
+		exit(1);
+	}
+
+	for (i = 0; i < PQntuples(res); i++)
+	{
+		int			j;
+
+		for (j = 0; j < PQntuples(leaderres); j++)
+		{
+			if (PQgetisnull(res, i, 0) && PQgetisnull(leaderres, j, 0))
+				break;
+			if (!PQgetisnull(res, i, 0) && !PQgetisnull(leaderres, j, 0) &&
+				strcmp(PQgetvalue(res, i, 0), PQgetvalue(leaderres, j, 0)) == 0)
+				break;
+		}
+
+		/*
+		 * A tablespace created after the backup started is not in the
+		 * leader's header, and its contents are not part of the backup.
+		 */
+		if (j < PQntuples(leaderres))
+			ReceiveAndUnpackTarFile(conn, leaderres, j);
+		else
+			SkipCopyStream(conn);
+	}
+	PQclear(res);
+
+	res = PQgetResult(conn);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+	{
+		const char *sqlstate = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+
+		if (sqlstate &&
+			strcmp(sqlstate, ERRCODE_DATA_CORRUPTED) == 0)
+		{
+			pg_log_error("checksum error occurred");
+			checksum_failure = true;
+			exit(PART_EXIT_CHECKSUM_FAILURE);
+		}
+		pg_log_error("final receive failed: %s",
+					 PQerrorMessage(conn));
+		exit(1);
+	}
+	PQclear(res);
+
+	success = true;
+	exit(0);
+}
+
+/*
+ * Read and throw away a COPY stream from the server.
+ */
+static void
+SkipCopyStream(PGconn *conn)
+{
+	PGresult   *res;
+	char	   *copybuf;
+	int			r;
+
+	res = PQgetResult(conn);
+	if (PQresultStatus(res) != PGRES_COPY_OUT)
+	{
+		pg_log_error("could not get COPY data stream: %s",
+					 PQerrorMessage(conn));
+		exit(1);
+	}
+	PQclear(res);
+
+	while ((r = PQgetCopyData(conn, &copybuf, 0)) > 0)
+		PQfreemem(copybuf);
+	if (r == -2)
+	{
+		pg_log_error("could not read COPY data: %s",
+					 PQerrorMessage(conn));
+		exit(1);
+	}
+}
+
+/*
+ * Wait for the child processes of a parallel backup to finish.
+ */
+static void
+WaitForBackupParts(void)
+{
+	bool		failed = false;
+	int			i;
+
+	for (i = 1; i < numjobs; i++)
+	{
+		int			status;
+
+		if (waitpid(partchildren[i], &status, 0) != partchildren[i])
+		{
+			pg_log_error("could not wait for child process: %m");
+			exit(1);
+		}
+		partchildren[i] = -1;
+
+		if (WIFEXITED(status) &&
+			WEXITSTATUS(status) == PART_EXIT_CHECKSUM_FAILURE)
+			checksum_failure = true;
+		else if (status != 0)
+		{
+			pg_log_error("child process receiving part %d of the backup failed: %s",
+						 i, wait_result_to_str(status));
+			failed = true;
+		}
+	}
+
+	if (failed || checksum_failure)
+		exit(1);
+}
+#endif
+
 static void
 BaseBackup(void)
 {
@@ -1794,6 +2301,8 @@ BaseBackup(void)
 	char	   *basebkp;
 	char		escaped_label[MAXPGPATH];
 	char	   *maxrate_clause = NULL;
+	char	   *incremental_clause = NULL;
+	char	   *parallel_clause = NULL;
 	int			i;
 	char		xlogstart[64];
 	char		xlogend[64];
@@ -1855,6 +2364,14 @@ BaseBackup(void)
 	if (maxrate > 0)
 		maxrate_clause = psprintf("MAX_RATE %u", maxrate);
 
+	if (!XLogRecPtrIsInvalid(incremental_lsn))
+		incremental_clause = psprintf("INCREMENTAL %X/%X",
+									  (uint32) (incremental_lsn >> 32),
+									  (uint32) incremental_lsn);
+
+	if (numjobs > 1)
+		parallel_clause = psprintf("PARALLEL %d", numjobs);
+
 	if (verbose)
 		pg_log_info("initiating base backup, waiting for checkpoint to complete");
 
@@ -1868,7 +2385,7 @@ BaseBackup(void)
 	}
 
 	basebkp =
-		psprintf("BASE_BACKUP LABEL '%s' %s %s %s %s %s %s %s",
+		psprintf("BASE_BACKUP LABEL '%s' %s %s %s %s %s %s %s %s %s",
 				 escaped_label,
 				 showprogress ? "PROGRESS" : "",
 				 includewal == FETCH_WAL ? "WAL" : "",
@@ -1876,7 +2393,9 @@ BaseBackup(void)
 				 includewal == NO_WAL ? "" : "NOWAIT",
 				 maxrate_clause ? maxrate_clause : "",
 				 format == 't' ? "TABLESPACE_MAP" : "",
-				 verify_checksums ? "" : "NOVERIFY_CHECKSUMS");
+				 verify_checksums ? "" : "NOVERIFY_CHECKSUMS",
+				 incremental_clause ? incremental_clause : "",
+				 parallel_clause ? parallel_clause : "");
 
 	if (PQsendQuery(conn, basebkp) == 0)
 	{
@@ -1982,6 +2501,12 @@ BaseBackup(void)
 		StartLogStreamer(xlogstart, starttli, sysidentifier);
 	}
 
+#ifndef WIN32
+	/* Start receiving the other parts of a parallel backup */
+	if (numjobs > 1)
+		StartBackupParts(res);
+#endif
+
 	/*
 	 * Start receiving chunks
 	 */
@@ -1993,6 +2518,11 @@ BaseBackup(void)
 			ReceiveAndUnpackTarFile(conn, res, i);
 	}							/* Loop over all tablespaces */
 
+#ifndef WIN32
+	if (numjobs > 1)
+		WaitForBackupParts();
+#endif
+
 	if (showprogress)
 	{
 		progress_report(PQntuples(res), NULL, true);
@@ -2172,6 +2702,7 @@ main(int argc, char **argv)
 		{"pgdata", required_argument, NULL, 'D'},
 		{"format", required_argument, NULL, 'F'},
 		{"checkpoint", required_argument, NULL, 'c'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"create-slot", no_argument, NULL, 'C'},
 		{"max-rate", required_argument, NULL, 'r'},
 		{"write-recovery-conf", no_argument, NULL, 'R'},
@@ -2195,6 +2726,9 @@ main(int argc, char **argv)
 		{"waldir", required_argument, NULL, 1},
 		{"no-slot", no_argument, NULL, 2},
 		{"no-verify-checksums", no_argument, NULL, 3},
+		{"compression-method", required_argument, NULL, 4},
+		{"compress-workers", required_argument, NULL, 5},
+		{"incremental", required_argument, NULL, 6},
 		{NULL, 0, NULL, 0}
 	};
 	int			c;
@@ -2222,7 +2756,7 @@ main(int argc, char **argv)
 
 	atexit(cleanup_directories_atexit);
 
-	while ((c = getopt_long(argc, argv, "CD:F:r:RS:T:X:l:nNzZ:d:c:h:p:U:s:wWkvP",
+	while ((c = getopt_long(argc, argv, "CD:F:r:RS:T:X:j:l:nNzZ:d:c:h:p:U:s:wWkvP",
 							long_options, &option_index)) != -1)
 	{
 		switch (c)
@@ -2292,6 +2826,15 @@ main(int argc, char **argv)
 			case 1:
 				xlog_dir = pg_strdup(optarg);
 				break;
+			case 'j':
+				numjobs = atoi(optarg);
+				if (numjobs <= 0)
+				{
+					pg_log_error("invalid number of parallel jobs \"%s\"",
+								 optarg);
+					exit(1);
+				}
+				break;
 			case 'l':
 				label = pg_strdup(optarg);
 				break;
@@ -2309,13 +2852,38 @@ main(int argc, char **argv)
 #endif
 				break;
 			case 'Z':
+				/* the upper limit depends on the method, checked below */
 				compresslevel = atoi(optarg);
-				if (compresslevel < 0 || compresslevel > 9)
+				if (compresslevel < 0)
 				{
 					pg_log_error("invalid compression level \"%s\"", optarg);
 					exit(1);
 				}
 				break;
+			case 4:
+				if (pg_strcasecmp(optarg, "gzip") == 0)
+					use_zstd = false;
+				else if (pg_strcasecmp(optarg, "zstd") == 0)
+					use_zstd = true;
+				else
+				{
+					pg_log_error("invalid compression method \"%s\", must be \"gzip\" or \"zstd\"",
+								 optarg);
+					exit(1);
+				}
+				break;
+			case 5:
+				compressworkers = atoi(optarg);
+				if (compressworkers < 1)
+				{
+					pg_log_error("invalid number of compression workers \"%s\"",
+								 optarg);
+					exit(1);
+				}
+				break;
+			case 6:
+				incremental_dir = pg_strdup(optarg);
+				break;
 			case 'c':
 				if (pg_strcasecmp(optarg, "fast") == 0)
 					fastcheckpoint = true;
@@ -2400,7 +2968,7 @@ main(int argc, char **argv)
 	/*
 	 * Mutually exclusive arguments
 	 */
-	if (format == 'p' && compresslevel != 0)
+	if (format == 'p' && (compresslevel != 0 || use_zstd))
 	{
 		pg_log_error("only tar mode backups can be compressed");
 		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
@@ -2477,13 +3045,64 @@ main(int argc, char **argv)
 		}
 	}
 
-#ifndef HAVE_LIBZ
-	if (compresslevel != 0)
+	if (numjobs > 1)
+	{
+#ifdef WIN32
+		pg_log_error("parallel backups are not supported on this platform");
+		exit(1);
+#endif
+		if (format != 'p')
+		{
+			pg_log_error("parallel backups are only supported in plain mode");
+			fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+					progname);
+			exit(1);
+		}
+	}
+
+	if (compressworkers != 0 && !use_zstd)
+	{
+		pg_log_error("--compress-workers requires --compression-method=zstd");
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+	if (use_zstd)
 	{
-		pg_log_error("this build does not support compression");
+#ifdef HAVE_LIBZSTD
+		/* -z asks for the default level, which zstd spells as 0 */
+		if (compresslevel < 0)
+			compresslevel = 0;
+		if (compresslevel > ZSTD_maxCLevel())
+		{
+			pg_log_error("compression level must be in range 0..%d for zstd",
+						 ZSTD_maxCLevel());
+			exit(1);
+		}
+#else
+		pg_log_error("this build does not support zstd compression");
 		exit(1);
+#endif
 	}
+	else
+	{
+#ifndef HAVE_LIBZ
+		if (compresslevel != 0)
+		{
+			pg_log_error("this build does not support compression");
+			exit(1);
+		}
 #endif
+		if (compresslevel > 9)
+		{
+			pg_log_error("compression level must be in range 0..9 for gzip");
+			exit(1);
+		}
+	}
+
+	if (incremental_dir)
+		incremental_lsn = GetPriorBackupStart(incremental_dir);
 
 	/* connection in replication mode to server */
 	conn = GetConnection();
@@ -6,7 +6,7 @@ use File::Basename qw(basename dirname);
 use File::Path qw(rmtree);
 use PostgresNode;
 use TestLib;
-use Test::More tests => 106;
+use Test::More tests => 113;
 
 program_help_ok('pg_basebackup');
 program_version_ok('pg_basebackup');
@@ -174,6 +174,29 @@ $node->command_ok([ 'pg_basebackup', '-D', "$tempdir/tarbackup", '-Ft' ],
 ok(-f "$tempdir/tarbackup/base.tar", 'backup tar was created');
 rmtree("$tempdir/tarbackup");
 
+$node->command_fails(
+	[
+		'pg_basebackup', '-D', "$tempdir/backup_foo", '-Ft',
+		'--compress-workers=2'
+	],
+	'--compress-workers without zstd fails');
+
+SKIP:
+{
+	skip "zstd not supported by this build", 2
+	  unless check_pg_config("#define HAVE_LIBZSTD 1");
+
+	$node->command_ok(
+		[
+			'pg_basebackup', '-D', "$tempdir/tarbackup_zstd", '-Ft',
+			'--compression-method=zstd', '--compress-workers=2'
+		],
+		'tar format with zstd compression');
+	ok(-f "$tempdir/tarbackup_zstd/base.tar.zst",
+		'zstd backup tar was created');
+	rmtree("$tempdir/tarbackup_zstd");
+}
+
 $node->command_fails(
 	[ 'pg_basebackup', '-D', "$tempdir/backup_foo", '-Fp', "-T=/foo" ],
 	'-T with empty old directory fails');
@@ -402,6 +425,23 @@ $node->command_ok(
 	'pg_basebackup -X stream runs with --no-slot');
 rmtree("$tempdir/backupnoslot");
 
+$node->command_fails(
+	[ 'pg_basebackup', '-D', "$tempdir/backupj_fail", '-Ft', '-j', '2' ],
+	'pg_basebackup -j fails in tar mode');
+SKIP:
+{
+	skip "parallel backups not supported on Windows", 3
+	  if ($windows_os);
+
+	$node->command_ok(
+		[ 'pg_basebackup', '-D', "$tempdir/backupj", '-X', 'stream', '-j', '3' ],
+		'pg_basebackup -j runs');
+	ok(-f "$tempdir/backupj/global/pg_control", 'pg_control was copied');
+	ok(-f "$tempdir/backupj/base/$postgresOid/PG_VERSION",
+		'database directory was copied');
+	rmtree("$tempdir/backupj");
+}
+
 $node->command_fails(
 	[
 		'pg_basebackup',             '-D',
@@ -0,0 +1,779 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_combinebackup.c
+ *	  Reconstruct a full base backup from a full backup and a chain of
+ *	  incremental backups taken on top of it
+ *
+ * Every file of the result comes from the latest backup.  Relation files
+ * sent incrementally, as INCREMENTAL.<filename>, hold only the blocks that
+ * changed since the backup before; the other blocks are looked up in the
+ * earlier backups, newest first.
+ *
+ * Copyright (c) 2010-2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/bin/pg_combinebackup/pg_combinebackup.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres_fe.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "access/xlogdefs.h"
+#include "common/controldata_utils.h"
+#include "common/file_perm.h"
+#include "common/file_utils.h"
+#include "common/logging.h"
+#include "getopt_long.h"
+#include "replication/basebackup.h"
+#include "storage/block.h"
+
+
+/* A backup given on the command line, oldest first */
+typedef struct BackupInfo
+{
+	char	   *dir;
+	XLogRecPtr	start_lsn;		/* START WAL LOCATION from backup_label */
+	XLogRecPtr	incremental_lsn;	/* invalid for a full backup */
+} BackupInfo;
+
+/* One backup's version of a relation file, full or incremental */
+typedef struct SourceFile
+{
+	char		path[MAXPGPATH];
+	int			fd;
+	bool		incremental;
+	BlockNumber truncation_block_length;	/* length in blocks */
+	uint32		num_blocks;		/* number of blocks in an incremental file */
+	BlockNumber *blocks;		/* their block numbers */
+	off_t		data_offset;	/* where the blocks start in the file */
+} SourceFile;
+
+#define COPY_BUF_SIZE	(64 * 1024)
+
+static const char *progname;
+
+static BackupInfo *backups;
+static int	nbackups;
+static char *output_dir = NULL;
+static bool do_sync = true;
+static bool verbose = false;
+
+
+static void
+usage(void)
+{
+	printf(_("%s reconstructs a full backup from incremental backups.\n\n"), progname);
+	printf(_("Usage:\n"));
+	printf(_("  %s [OPTION]... -o OUTPUTDIR FULLBACKUP INCREMENTAL...\n"), progname);
+	printf(_("\nOptions:\n"));
+	printf(_("  -o, --output=DIRECTORY  write the combined backup into this directory\n"));
+	printf(_("  -N, --no-sync           do not wait for changes to be written safely to disk\n"));
+	printf(_("  -v, --verbose           output verbose messages\n"));
+	printf(_("  -V, --version           output version information, then exit\n"));
+	printf(_("  -?, --help              show this help, then exit\n"));
+	printf(_("\nThe backups are given oldest first, starting with a full backup, each one\n"
+			 "taken incrementally from the one before.\n\n"));
+	printf(_("Report bugs to <pgsql-bugs@lists.postgresql.org>.\n"));
+}
+
+/*
+ * Read the start location of a backup, and the location it was taken
+ * incrementally from if any, from its backup_label.
+ */
+static void
+read_backup_label(BackupInfo *backup)
+{
+	char		path[MAXPGPATH];
+	char		line[MAXPGPATH];
+	FILE	   *fp;
+	uint32		hi,
+				lo;
+
+	backup->start_lsn = InvalidXLogRecPtr;
+	backup->incremental_lsn = InvalidXLogRecPtr;
+
+	snprintf(path, sizeof(path), "%s/backup_label", backup->dir);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		pg_log_error("could not open file \"%s\": %m", path);
+		exit(1);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (sscanf(line, "START WAL LOCATION: %X/%X", &hi, &lo) == 2)
+			backup->start_lsn = ((uint64) hi) << 32 | lo;
+		else if (sscanf(line, "INCREMENTAL FROM LSN: %X/%X", &hi, &lo) == 2)
+			backup->incremental_lsn = ((uint64) hi) << 32 | lo;
+	}
+	fclose(fp);
+
+	if (XLogRecPtrIsInvalid(backup->start_lsn))
+	{
+		pg_log_error("could not find start location in file \"%s\"", path);
+		exit(1);
+	}
+}
+
+/*
+ * Check that the backups form a chain that can be combined: a full backup
+ * of one cluster, then incremental backups each starting no later than the
+ * backup before it.
+ */
+static void
+check_backups(void)
+{
+	uint64		system_identifier = 0;
+	int			i;
+
+	for (i = 0; i < nbackups; i++)
+	{
+		BackupInfo *backup = &backups[i];
+		ControlFileData *control;
+		bool		crc_ok;
+
+		read_backup_label(backup);
+
+		control = get_controlfile(backup->dir, &crc_ok);
+		if (!crc_ok)
+		{
+			pg_log_error("pg_control CRC value is incorrect in backup \"%s\"",
+						 backup->dir);
+			exit(1);
+		}
+		if (i == 0)
+			system_identifier = control->system_identifier;
+		else if (control->system_identifier != system_identifier)
+		{
+			pg_log_error("backup \"%s\" is from a different system than backup \"%s\"",
+						 backup->dir, backups[0].dir);
+			exit(1);
+		}
+		pfree(control);
+
+		if (i == 0)
+		{
+			if (!XLogRecPtrIsInvalid(backup->incremental_lsn))
+			{
+				pg_log_error("backup \"%s\" is an incremental backup, but the first backup must be a full backup",
+							 backup->dir);
+				exit(1);
+			}
+		}
+		else if (XLogRecPtrIsInvalid(backup->incremental_lsn))
+		{
+			pg_log_error("backup \"%s\" is a full backup, but only the first backup can be a full backup",
+						 backup->dir);
+			exit(1);
+		}
+		else if (backup->incremental_lsn > backups[i - 1].start_lsn)
+		{
+			pg_log_error("backup \"%s\" was taken from %X/%X, which is later than the start %X/%X of the preceding backup \"%s\"",
+						 backup->dir,
+						 (uint32) (backup->incremental_lsn >> 32),
+						 (uint32) backup->incremental_lsn,
+						 (uint32) (backups[i - 1].start_lsn >> 32),
+						 (uint32) backups[i - 1].start_lsn,
+						 backups[i - 1].dir);
+			exit(1);
+		}
+	}
+}
+
+/*
+ * Build "base/reldir/name", leaving out reldir when it's empty.
+ */
+static void
+make_path(char *path, const char *base, const char *reldir, const char *name)
+{
+	if (reldir[0] == '\0')
+		snprintf(path, MAXPGPATH, "%s/%s", base, name);
+	else
+		snprintf(path, MAXPGPATH, "%s/%s/%s", base, reldir, name);
+}
+
+/*
+ * Read exactly 'size' bytes at 'offset' of a file, or fail.
+ */
+static void
+read_exactly(int fd, const char *path, void *buf, size_t size, off_t offset)
+{
+	ssize_t		rb;
+
+	rb = pg_pread(fd, buf, size, offset);
+	if (rb < 0)
+	{
+		pg_log_error("could not read file \"%s\": %m", path);
+		exit(1);
+	}
+	if (rb != size)
+	{
+		pg_log_error("could not read file \"%s\": read %d of %zu",
+					 path, (int) rb, size);
+		exit(1);
+	}
+}
+
+/*
+ * Open the version of relation file reldir/name in the given backup, either
+ * incremental or full.  Returns NULL if the backup has neither.
+ */
+static SourceFile *
+open_source_file(const char *backupdir, const char *reldir, const char *name)
+{
+	SourceFile *sf = pg_malloc0(sizeof(SourceFile));
+	char		incname[MAXPGPATH];
+	struct stat st;
+
+	snprintf(incname, sizeof(incname), "%s%s", INCREMENTAL_PREFIX, name);
+	make_path(sf->path, backupdir, reldir, incname);
+	sf->fd = open(sf->path, O_RDONLY | PG_BINARY, 0);
+	if (sf->fd >= 0)
+	{
+		IncrementalFileHeader header;
+		uint32		i;
+
+		sf->incremental = true;
+		read_exactly(sf->fd, sf->path, &header, sizeof(header), 0);
+		if (header.magic != INCREMENTAL_MAGIC)
+		{
+			pg_log_error("file \"%s\" has invalid magic number %08X",
+						 sf->path, header.magic);
+			exit(1);
+		}
+		sf->num_blocks = header.num_blocks;
+		sf->truncation_block_length = header.truncation_block_length;
+		sf->blocks = pg_malloc(sizeof(BlockNumber) * Max(sf->num_blocks, 1));
+		read_exactly(sf->fd, sf->path, sf->blocks,
+					 sizeof(BlockNumber) * sf->num_blocks, sizeof(header));
+		sf->data_offset = sizeof(header) + sizeof(BlockNumber) * sf->num_blocks;
+
+		for (i = 0; i < sf->num_blocks; i++)
+		{
+			if (sf->blocks[i] >= sf->truncation_block_length)
+			{
+				pg_log_error("file \"%s\" contains block %u beyond its length of %u blocks",
+							 sf->path, sf->blocks[i],
+							 sf->truncation_block_length);
+				exit(1);
+			}
+		}
+		return sf;
+	}
+	if (errno != ENOENT)
+	{
+		pg_log_error("could not open file \"%s\": %m", sf->path);
+		exit(1);
+	}
+
+	make_path(sf->path, backupdir, reldir, name);
+	sf->fd = open(sf->path, O_RDONLY | PG_BINARY, 0);
+	if (sf->fd < 0)
+	{
+		if (errno == ENOENT)
+		{
+			pg_free(sf);
+			return NULL;
+		}
+		pg_log_error("could not open file \"%s\": %m", sf->path);
+		exit(1);
+	}
+	if (fstat(sf->fd, &st) != 0)
+	{
+		pg_log_error("could not stat file \"%s\": %m", sf->path);
+		exit(1);
+	}
+	sf->incremental = false;
+	sf->truncation_block_length = st.st_size / BLCKSZ;
+
+	return sf;
+}
+
+static void
+close_source_file(SourceFile *sf)
+{
+	close(sf->fd);
+	if (sf->blocks)
+		pg_free(sf->blocks);
+	pg_free(sf);
+}
+
+/*
+ * Reconstruct relation file reldir/name, which the latest backup holds as
+ * an incremental file, into the output directory.
+ *
+ * Each block comes from the newest backup that has it: an incremental file
+ * that contains it, or else the full file of the first backup.  A block
+ * past the length the file had in some backup was created after that
+ * backup, so if no newer backup contains it either, it's a new, all-zero
+ * page.
+ */
+static void
+reconstruct_file(const char *reldir, const char *name)
+{
+	SourceFile **sources;
+	SourceFile **blocksource;
+	off_t	   *blockoffset;
+	bool	   *found;
+	BlockNumber nblocks;
+	BlockNumber nfound = 0;
+	BlockNumber b;
+	char		outpath[MAXPGPATH];
+	char		buf[BLCKSZ];
+	int			outfd;
+	int			i;
+
+	sources = pg_malloc0(sizeof(SourceFile *) * nbackups);
+	sources[nbackups - 1] = open_source_file(backups[nbackups - 1].dir,
+											 reldir, name);
+	Assert(sources[nbackups - 1] != NULL &&
+		   sources[nbackups - 1]->incremental);
+
+	nblocks = sources[nbackups - 1]->truncation_block_length;
+	blocksource = pg_malloc0(sizeof(SourceFile *) * Max(nblocks, 1));
+	blockoffset = pg_malloc0(sizeof(off_t) * Max(nblocks, 1));
+	found = pg_malloc0(sizeof(bool) * Max(nblocks, 1));
+
+	for (i = nbackups - 1; i >= 0 && nfound < nblocks; i--)
+	{
+		SourceFile *sf = sources[i];
+
+		if (sf == NULL)
+		{
+			sf = open_source_file(backups[i].dir, reldir, name);
+			if (sf == NULL)
+			{
+				pg_log_error("file \"%s/%s\" is missing in backup \"%s\"",
+							 reldir, name, backups[i].dir);
+				pg_log_info("files copied on the server without being written block by block, as by CREATE DATABASE, need a new full backup");
+				exit(1);
+			}
+			sources[i] = sf;
+		}
+
+		if (sf->incremental)
+		{
+			uint32		j;
+
+			for (j = 0; j < sf->num_blocks; j++)
+			{
+				b = sf->blocks[j];
+				if (b < nblocks && !found[b])
+				{
+					blocksource[b] = sf;
+					blockoffset[b] = sf->data_offset + (off_t) j * BLCKSZ;
+					found[b] = true;
+					nfound++;
+				}
+			}
+			for (b = sf->truncation_block_length; b < nblocks; b++)
+			{
+				if (!found[b])
+				{
+					found[b] = true;
+					nfound++;
+				}
+			}
+		}
+		else
+		{
+			for (b = 0; b < nblocks; b++)
+			{
+				if (!found[b])
+				{
+					if (b < sf->truncation_block_length)
+					{
+						blocksource[b] = sf;
+						blockoffset[b] = (off_t) b * BLCKSZ;
+					}
+					found[b] = true;
+					nfound++;
+				}
+			}
+		}
+	}
+
+	/* The first backup is a full backup, so every block must be known */
+	Assert(nfound == nblocks);
+
+	make_path(outpath, output_dir, reldir, name);
+	if (verbose)
+		pg_log_info("reconstructing \"%s\" (%u blocks)", outpath, nblocks);
+
+	outfd = open(outpath, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY,
+				 pg_file_create_mode);
+	if (outfd < 0)
+	{
+		pg_log_error("could not create file \"%s\": %m", outpath);
+		exit(1);
+	}
+
+	for (b = 0; b < nblocks; b++)
+	{
+		if (blocksource[b] != NULL)
+			read_exactly(blocksource[b]->fd, blocksource[b]->path,
+						 buf, BLCKSZ, blockoffset[b]);
+		else
+			memset(buf, 0, BLCKSZ);
+
+		errno = 0;
+		if (write(outfd, buf, BLCKSZ) != BLCKSZ)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			pg_log_error("could not write file \"%s\": %m", outpath);
+			exit(1);
+		}
+	}
+
+	if (close(outfd) != 0)
+	{
+		pg_log_error("could not close file \"%s\": %m", outpath);
+		exit(1);
+	}
+
+	for (i = 0; i < nbackups; i++)
+		if (sources[i] != NULL)
+			close_source_file(sources[i]);
+	pg_free(sources);
+	pg_free(blocksource);
+	pg_free(blockoffset);
+	pg_free(found);
+}
+
+/*
+ * Copy a file of the latest backup unchanged.
+ */
+static void
+copy_file(const char *reldir, const char *name)
+{
+	char		srcpath[MAXPGPATH];
+	char		dstpath[MAXPGPATH];
+	char	   *buf;
+	int			srcfd;
+	int			dstfd;
+	ssize_t		rb;
+
+	make_path(srcpath, backups[nbackups - 1].dir, reldir, name);
+	make_path(dstpath, output_dir, reldir, name);
+
+	srcfd = open(srcpath, O_RDONLY | PG_BINARY, 0);
+	if (srcfd < 0)
+	{
+		pg_log_error("could not open file \"%s\": %m", srcpath);
+		exit(1);
+	}
+	dstfd = open(dstpath, O_WRONLY | O_CREAT | O_EXCL | PG_BINARY,
+				 pg_file_create_mode);
+	if (dstfd < 0)
+	{
+		pg_log_error("could not create file \"%s\": %m", dstpath);
+		exit(1);
+	}
+
+	buf = pg_malloc(COPY_BUF_SIZE);
+	while ((rb = read(srcfd, buf, COPY_BUF_SIZE)) > 0)
+	{
+		errno = 0;
+		if (write(dstfd, buf, rb) != rb)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			pg_log_error("could not write file \"%s\": %m", dstpath);
+			exit(1);
+		}
+	}
+	if (rb < 0)
+	{
+		pg_log_error("could not read file \"%s\": %m", srcpath);
+		exit(1);
+	}
+	pg_free(buf);
+
+	if (close(dstfd) != 0)
+	{
+		pg_log_error("could not close file \"%s\": %m", dstpath);
+		exit(1);
+	}
+	close(srcfd);
+}
+
+/*
+ * Copy the backup_label of the latest backup, leaving out the line that
+ * marks it as incremental: the result is a full backup, which later
+ * incremental backups can be combined with in turn.
+ */
+static void
+copy_backup_label(void)
+{
+	char		srcpath[MAXPGPATH];
+	char		dstpath[MAXPGPATH];
+	char		line[MAXPGPATH];
+	FILE	   *src;
+	FILE	   *dst;
+
+	snprintf(srcpath, sizeof(srcpath), "%s/backup_label",
+			 backups[nbackups - 1].dir);
+	snprintf(dstpath, sizeof(dstpath), "%s/backup_label", output_dir);
+
+	src = fopen(srcpath, "r");
+	if (src == NULL)
+	{
+		pg_log_error("could not open file \"%s\": %m", srcpath);
+		exit(1);
+	}
+	dst = fopen(dstpath, "w");
+	if (dst == NULL)
+	{
+		pg_log_error("could not create file \"%s\": %m", dstpath);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), src) != NULL)
+	{
+		if (strncmp(line, "INCREMENTAL FROM LSN:", 21) == 0)
+			continue;
+		if (fputs(line, dst) < 0)
+		{
+			pg_log_error("could not write file \"%s\": %m", dstpath);
+			exit(1);
+		}
+	}
+
+	fclose(src);
+	if (fclose(dst) != 0)
+	{
+		pg_log_error("could not write file \"%s\": %m", dstpath);
+		exit(1);
+	}
+}
+
+/*
+ * Recreate directory reldir of the latest backup in the output directory.
+ */
+static void
+process_directory(const char *reldir)
+{
+	char		path[MAXPGPATH];
+	DIR		   *dir;
+	struct dirent *de;
+
+	if (reldir[0] == '\0')
+		snprintf(path, sizeof(path), "%s", backups[nbackups - 1].dir);
+	else
+		snprintf(path, sizeof(path), "%s/%s", backups[nbackups - 1].dir,
+				 reldir);
+
+	dir = opendir(path);
+	if (dir == NULL)
+	{
+		pg_log_error("could not open directory \"%s\": %m", path);
+		exit(1);
+	}
+
+	while (errno = 0, (de = readdir(dir)) != NULL)
+	{
+		char		fn[MAXPGPATH];
+		char		subdir[MAXPGPATH];
+		struct stat st;
+
+		if (strcmp(de->d_name, ".") == 0 ||
+			strcmp(de->d_name, "..") == 0)
+			continue;
+
+		/* Tablespaces live outside the backup directory */
+		if (strcmp(reldir, "pg_tblspc") == 0)
+		{
+			pg_log_error("backups with tablespaces are not supported");
+			exit(1);
+		}
+
+		make_path(fn, backups[nbackups - 1].dir, reldir, de->d_name);
+
+		/* Follow symbolic links, such as pg_wal made by --waldir */
+		if (stat(fn, &st) != 0)
+		{
+			pg_log_error("could not stat file \"%s\": %m", fn);
+			exit(1);
+		}
+
+		if (S_ISDIR(st.st_mode))
+		{
+			char		outdir[MAXPGPATH];
+
+			make_path(outdir, output_dir, reldir, de->d_name);
+			if (mkdir(outdir, pg_dir_create_mode) != 0)
+			{
+				pg_log_error("could not create directory \"%s\": %m", outdir);
+				exit(1);
+			}
+
+			if (reldir[0] == '\0')
+				snprintf(subdir, sizeof(subdir), "%s", de->d_name);
+			else
+				snprintf(subdir, sizeof(subdir), "%s/%s", reldir, de->d_name);
+			process_directory(subdir);
+		}
+		else if (S_ISREG(st.st_mode))
+		{
+			if (strncmp(de->d_name, INCREMENTAL_PREFIX,
+						INCREMENTAL_PREFIX_LENGTH) == 0)
+				reconstruct_file(reldir,
+								 de->d_name + INCREMENTAL_PREFIX_LENGTH);
+			else if (reldir[0] == '\0' &&
+					 strcmp(de->d_name, "backup_label") == 0)
+				copy_backup_label();
+			else
+				copy_file(reldir, de->d_name);
+		}
+		else
+			pg_log_warning("skipping special file \"%s\"", fn);
+	}
+
+	if (errno)
+	{
+		pg_log_error("could not read directory \"%s\": %m", path);
+		exit(1);
+	}
+
+	if (closedir(dir))
+	{
+		pg_log_error("could not close directory \"%s\": %m", path);
+		exit(1);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"output", required_argument, NULL, 'o'},
+		{"no-sync", no_argument, NULL, 'N'},
+		{"verbose", no_argument, NULL, 'v'},
+		{NULL, 0, NULL, 0}
+	};
+
+	int			c;
+	int			option_index;
+	int			i;
+
+	pg_logging_init(argv[0]);
+	set_pglocale_pgservice(argv[0], PG_TEXTDOMAIN("pg_combinebackup"));
+	progname = get_progname(argv[0]);
+
+	if (argc > 1)
+	{
+		if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-?") == 0)
+		{
+			usage();
+			exit(0);
+		}
+		if (strcmp(argv[1], "--version") == 0 || strcmp(argv[1], "-V") == 0)
+		{
+			puts("pg_combinebackup (PostgreSQL) " PG_VERSION);
+			exit(0);
+		}
+	}
+
+	while ((c = getopt_long(argc, argv, "o:Nv", long_options, &option_index)) != -1)
+	{
+		switch (c)
+		{
+			case 'o':
+				output_dir = pg_strdup(optarg);
+				break;
+			case 'N':
+				do_sync = false;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			default:
+				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
+				exit(1);
+		}
+	}
+
+	if (output_dir == NULL)
+	{
+		pg_log_error("no output directory specified");
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+	if (optind >= argc)
+	{
+		pg_log_error("no backups specified");
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"),
+				progname);
+		exit(1);
+	}
+
+	nbackups = argc - optind;
+	backups = pg_malloc0(sizeof(BackupInfo) * nbackups);
+	for (i = 0; i < nbackups; i++)
+	{
+		backups[i].dir = pg_strdup(argv[optind + i]);
+		canonicalize_path(backups[i].dir);
+	}
+	canonicalize_path(output_dir);
+
+	check_backups();
+
+	/* Create files with the same permissions as the latest backup */
+	if (!GetDataDirectoryCreatePerm(backups[nbackups - 1].dir))
+	{
+		pg_log_error("could not read permissions of directory \"%s\": %m",
+					 backups[nbackups - 1].dir);
+		exit(1);
+	}
+	umask(pg_mode_mask);
+
+	switch (pg_check_dir(output_dir))
+	{
+		case 0:
+			if (pg_mkdir_p(output_dir, pg_dir_create_mode) == -1)
+			{
+				pg_log_error("could not create directory \"%s\": %m",
+							 output_dir);
+				exit(1);
+			}
+			break;
+		case 1:
+			/* Exists, empty */
+			break;
+		case 2:
+		case 3:
+		case 4:
+			pg_log_error("directory \"%s\" exists but is not empty",
+						 output_dir);
+			exit(1);
+		case -1:
+			pg_log_error("could not access directory \"%s\": %m",
+						 output_dir);
+			exit(1);
+	}
+
+	process_directory("");
+
+	if (do_sync)
+	{
+		if (verbose)
+			pg_log_info("syncing data to disk");
+		fsync_pgdata(output_dir, PG_VERSION_NUM);
+	}
+
+	if (verbose)
+		pg_log_info("combined backup written to \"%s\"", output_dir);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+# Take a full backup and two incremental backups, combine them, and check
+# that the result starts up with the data as of the last backup.
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 8;
+
+my $primary = get_new_node('primary');
+$primary->init(allows_streaming => 1);
+$primary->start;
+my $backupdir = $primary->backup_dir;
+
+$primary->safe_psql('postgres',
+	"CREATE TABLE t AS SELECT g AS a, repeat('x', 100) AS b FROM generate_series(1, 10000) g"
+);
+
+$primary->command_ok(
+	[ 'pg_basebackup', '-D', "$backupdir/full", '-Fp', '--no-sync' ],
+	'full backup');
+
+$primary->safe_psql('postgres',
+	"UPDATE t SET b = 'y' WHERE a % 100 = 0; CREATE TABLE u AS SELECT 1 AS c"
+);
+
+$primary->command_ok(
+	[
+		'pg_basebackup', '-D', "$backupdir/incr1", '-Fp', '--no-sync',
+		"--incremental=$backupdir/full"
+	],
+	'first incremental backup');
+
+my $relpath =
+  $primary->safe_psql('postgres', "SELECT pg_relation_filepath('t')");
+my ($reldir, $relfile) = $relpath =~ m!^(.*)/([^/]+)$!;
+ok(-f "$backupdir/incr1/$reldir/INCREMENTAL.$relfile",
+	'changed table sent incrementally');
+ok(-s "$backupdir/incr1/$reldir/INCREMENTAL.$relfile" <
+	  -s "$backupdir/full/$relpath",
+	'incremental file is smaller than the full file');
+
+$primary->safe_psql('postgres',
+	"DELETE FROM t WHERE a > 9000; INSERT INTO u VALUES (2); VACUUM t");
+
+$primary->command_ok(
+	[
+		'pg_basebackup', '-D', "$backupdir/incr2", '-Fp', '--no-sync',
+		"--incremental=$backupdir/incr1"
+	],
+	'second incremental backup');
+
+$primary->command_fails(
+	[
+		'pg_combinebackup', '-o', "$backupdir/bad", "$backupdir/full",
+		"$backupdir/incr2"
+	],
+	'combining with a backup missing from the chain fails');
+
+$primary->command_ok(
+	[
+		'pg_combinebackup', '-o', "$backupdir/combined", "$backupdir/full",
+		"$backupdir/incr1", "$backupdir/incr2"
+	],
+	'combine backups');
+
+my $restored = get_new_node('restored');
+$restored->init_from_backup($primary, 'combined');
+$restored->start;
+
+my $query =
+  "SELECT count(*), sum(a), count(*) FILTER (WHERE b = 'y'), (SELECT sum(c) FROM u) FROM t";
+is($restored->safe_psql('postgres', $query),
+	$primary->safe_psql('postgres', $query),
+	'combined backup has the data of the last backup');
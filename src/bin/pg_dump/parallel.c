@@ -1125,7 +1125,8 @@ buildWorkerCommand(ArchiveHandle *AH, TocEntry *te, T_Action act,
 	if (act == ACT_DUMP)
 		snprintf(buf, buflen, "DUMP %d", te->dumpId);
 	else if (act == ACT_RESTORE)
-		snprintf(buf, buflen, "RESTORE %d", te->dumpId);
+		snprintf(buf, buflen, "RESTORE %d %d", te->dumpId,
+				 te->maintenanceWorkers);
 	else
 		Assert(false);
 }
@@ -1138,6 +1139,7 @@ parseWorkerCommand(ArchiveHandle *AH, TocEntry **te, T_Action *act,
 				   const char *msg)
 {
 	DumpId		dumpId;
+	int			maintenanceWorkers;
 	int			nBytes;
 
 	if (messageStartsWith(msg, "DUMP "))
@@ -1151,10 +1153,12 @@ parseWorkerCommand(ArchiveHandle *AH, TocEntry **te, T_Action *act,
 	else if (messageStartsWith(msg, "RESTORE "))
 	{
 		*act = ACT_RESTORE;
-		sscanf(msg, "RESTORE %d%n", &dumpId, &nBytes);
+		sscanf(msg, "RESTORE %d %d%n", &dumpId, &maintenanceWorkers,
+			   &nBytes);
 		Assert(nBytes == strlen(msg));
 		*te = getTocEntryByDumpId(AH, dumpId);
 		Assert(*te != NULL);
+		(*te)->maintenanceWorkers = maintenanceWorkers;
 	}
 	else
 		fatal("unrecognized command received from master: \"%s\"",
@@ -1291,6 +1295,23 @@ IsEveryWorkerIdle(ParallelState *pstate)
 	return true;
 }
 
+/*
+ * Return the number of workers in the WRKR_IDLE state.
+ */
+int
+GetIdleWorkerCount(ParallelState *pstate)
+{
+	int			count = 0;
+	int			i;
+
+	for (i = 0; i < pstate->numWorkers; i++)
+	{
+		if (pstate->parallelSlot[i].workerStatus == WRKR_IDLE)
+			count++;
+	}
+	return count;
+}
+
 /*
  * Acquire lock on a table to be dumped by a worker process.
  *
@@ -53,6 +53,7 @@ extern DWORD mainThreadId;
 extern void init_parallel_dump_utils(void);
 
 extern bool IsEveryWorkerIdle(ParallelState *pstate);
+extern int	GetIdleWorkerCount(ParallelState *pstate);
 extern void WaitForWorkers(ArchiveHandle *AH, ParallelState *pstate,
 						   WFW_WaitOption mode);
 
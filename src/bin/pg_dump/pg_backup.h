@@ -118,6 +118,8 @@ typedef struct _restoreOptions
 	int			suppressDumpWarnings;	/* Suppress output of WARNING entries
 										 * to stderr */
 	bool		single_txn;
+	int			txn_size;		/* restore this many entries per transaction,
+								 * or 0 for one transaction per entry */
 
 	bool	   *idWanted;		/* array showing which dump IDs to emit */
 	int			enable_row_security;
@@ -159,6 +161,7 @@ typedef struct _dumpOptions
 	int			use_setsessauth;
 	int			enable_row_security;
 	int			load_via_partition_root;
+	int			split_large_tables; /* 0 = never, else chunk size in MB */
 
 	/* default, if no "inclusion" switches appear, is to dump everything */
 	bool		include_everything;
@@ -80,6 +80,7 @@ static void _doSetSessionAuth(ArchiveHandle *AH, const char *user);
 static void _reconnectToDB(ArchiveHandle *AH, const char *dbname);
 static void _becomeUser(ArchiveHandle *AH, const char *user);
 static void _becomeOwner(ArchiveHandle *AH, TocEntry *te);
+static void _setMaintenanceWorkers(ArchiveHandle *AH, int nworkers);
 static void _selectOutputSchema(ArchiveHandle *AH, const char *schemaName);
 static void _selectTablespace(ArchiveHandle *AH, const char *tablespace);
 static void _selectTableAccessMethod(ArchiveHandle *AH, const char *tableam);
@@ -103,6 +104,7 @@ static OutputContext SaveOutput(ArchiveHandle *AH);
 static void RestoreOutput(ArchiveHandle *AH, OutputContext savedContext);
 
 static int	restore_toc_entry(ArchiveHandle *AH, TocEntry *te, bool is_parallel);
+static void commit_txn_batch(ArchiveHandle *AH);
 static void restore_toc_entries_prefork(ArchiveHandle *AH,
 										TocEntry *pending_list);
 static void restore_toc_entries_parallel(ArchiveHandle *AH,
@@ -717,6 +719,8 @@ RestoreArchive(Archive *AHX)
 		}
 	}
 
+	commit_txn_batch(AH);
+
 	if (ropt->single_txn)
 	{
 		if (AH->connection)
@@ -756,9 +760,25 @@ restore_toc_entry(ArchiveHandle *AH, TocEntry *te, bool is_parallel)
 	int			status = WORKER_OK;
 	teReqs		reqs;
 	bool		defnDumped;
+	bool		batched;
 
 	AH->currentTE = te;
 
+	/*
+	 * Under --transaction-size, group the entries into transactions of that
+	 * many, to save a commit per object.  Creating the database can't be done
+	 * in a transaction block, and changing its properties makes us reconnect,
+	 * so those are done by themselves.  Parallel workers restore each entry
+	 * in a transaction of its own as usual.
+	 */
+	batched = (ropt->txn_size > 0 && !is_parallel && AH->connection != NULL &&
+			   strcmp(te->desc, "DATABASE") != 0 &&
+			   strcmp(te->desc, "DATABASE PROPERTIES") != 0);
+	if (!batched)
+		commit_txn_batch(AH);
+	else if (AH->txnCount == 0)
+		StartTransaction(&AH->public);
+
 	/* Dump any relevant dump warnings to stderr */
 	if (!ropt->suppressDumpWarnings && strcmp(te->desc, "WARNING") == 0)
 	{
@@ -786,9 +806,19 @@ restore_toc_entry(ArchiveHandle *AH, TocEntry *te, bool is_parallel)
 			pg_log_info("creating %s \"%s\"",
 						te->desc, te->tag);
 
+		/*
+		 * In parallel restore, the master decides how many parallel workers
+		 * an index build may use.
+		 */
+		if (is_parallel && te->maintenanceWorkers >= 0)
+			_setMaintenanceWorkers(AH, te->maintenanceWorkers);
+
 		_printTocEntry(AH, te, false);
 		defnDumped = true;
 
+		if (is_parallel && te->maintenanceWorkers >= 0)
+			_setMaintenanceWorkers(AH, -1);
+
 		if (strcmp(te->desc, "TABLE") == 0)
 		{
 			if (AH->lastErrorTE == te)
@@ -958,9 +988,26 @@ restore_toc_entry(ArchiveHandle *AH, TocEntry *te, bool is_parallel)
 	if (AH->public.n_errors > 0 && status == WORKER_OK)
 		status = WORKER_IGNORED_ERRORS;
 
+	if (batched && ++AH->txnCount >= ropt->txn_size)
+		commit_txn_batch(AH);
+
 	return status;
 }
 
+/*
+ * Commit the transaction opened by restore_toc_entry() under
+ * --transaction-size, if there is one.
+ */
+static void
+commit_txn_batch(ArchiveHandle *AH)
+{
+	if (AH->txnCount > 0)
+	{
+		CommitTransaction(&AH->public);
+		AH->txnCount = 0;
+	}
+}
+
 /*
  * Allocate a new RestoreOptions block.
  * This is mainly so we can initialize it, but also for future expansion,
@@ -1259,7 +1306,8 @@ StartRestoreBlobs(ArchiveHandle *AH)
 {
 	RestoreOptions *ropt = AH->public.ropt;
 
-	if (!ropt->single_txn)
+	/* no need for a transaction if we are in one already */
+	if (!ropt->single_txn && AH->txnCount == 0)
 	{
 		if (AH->connection)
 			StartTransaction(&AH->public);
@@ -1278,7 +1326,7 @@ EndRestoreBlobs(ArchiveHandle *AH)
 {
 	RestoreOptions *ropt = AH->public.ropt;
 
-	if (!ropt->single_txn)
+	if (!ropt->single_txn && AH->txnCount == 0)
 	{
 		if (AH->connection)
 			CommitTransaction(&AH->public);
@@ -1856,7 +1904,9 @@ buildTocEntryArrays(ArchiveHandle *AH)
 		 * tableDataId provides the TABLE DATA item's dump ID for each TABLE
 		 * TOC entry that has a DATA item.  We compute this by reversing the
 		 * TABLE DATA item's dependency, knowing that a TABLE DATA item has
-		 * just one dependency and it is the TABLE item.
+		 * just one dependency and it is the TABLE item.  A table whose data
+		 * was dumped in chunks has several TABLE DATA items; those are
+		 * chained through nextTableData, starting from the one recorded here.
 		 */
 		if (strcmp(te->desc, "TABLE DATA") == 0 && te->nDeps > 0)
 		{
@@ -1870,6 +1920,7 @@ buildTocEntryArrays(ArchiveHandle *AH)
 			if (tableId <= 0 || tableId > maxDumpId)
 				fatal("bad table dumpId for TABLE DATA item");
 
+			te->nextTableData = AH->tableDataId[tableId];
 			AH->tableDataId[tableId] = te->dumpId;
 		}
 	}
@@ -3294,6 +3345,40 @@ _becomeOwner(ArchiveHandle *AH, TocEntry *te)
 }
 
 
+/*
+ * Set max_parallel_maintenance_workers for the next index build, or reset it
+ * if nworkers is negative.  This is only used in parallel restore, which
+ * always talks directly to a server.
+ */
+static void
+_setMaintenanceWorkers(ArchiveHandle *AH, int nworkers)
+{
+	PQExpBuffer qry;
+	PGresult   *res;
+
+	/* The setting only exists in server versions 11 and up */
+	if (PQserverVersion(AH->connection) < 110000)
+		return;
+
+	qry = createPQExpBuffer();
+
+	if (nworkers >= 0)
+		appendPQExpBuffer(qry, "SET max_parallel_maintenance_workers = %d",
+						  nworkers);
+	else
+		appendPQExpBufferStr(qry, "RESET max_parallel_maintenance_workers");
+
+	res = PQexec(AH->connection, qry->data);
+
+	if (!res || PQresultStatus(res) != PGRES_COMMAND_OK)
+		warn_or_exit_horribly(AH,
+							  "could not set max_parallel_maintenance_workers: %s",
+							  PQerrorMessage(AH->connection));
+
+	PQclear(res);
+	destroyPQExpBuffer(qry);
+}
+
 /*
  * Issue the commands to select the specified schema as the current schema
  * in the target database.
@@ -4016,6 +4101,7 @@ restore_toc_entries_prefork(ArchiveHandle *AH, TocEntry *pending_list)
 	 * mainly to ensure that we don't exceed the specified number of parallel
 	 * connections.
 	 */
+	commit_txn_batch(AH);
 	DisconnectDatabase(&AH->public);
 
 	/* blow away any transient state from the old connection */
@@ -4094,9 +4180,35 @@ restore_toc_entries_parallel(ArchiveHandle *AH, ParallelState *pstate,
 				continue;
 			}
 
-			pg_log_info("launching item %d %s %s",
-						next_work_item->dumpId,
-						next_work_item->desc, next_work_item->tag);
+			/*
+			 * An index build that starts while some workers would otherwise
+			 * be left idle may use that many parallel workers of its own.
+			 * Else it gets none, so as not to compete with the running jobs
+			 * for CPU and I/O.  Since the ready list is sorted by size, this
+			 * means the largest index builds near the end of the restore get
+			 * the help.
+			 */
+			next_work_item->maintenanceWorkers = -1;
+			if (strcmp(next_work_item->desc, "INDEX") == 0 ||
+				strcmp(next_work_item->desc, "CONSTRAINT") == 0)
+			{
+				int			spare;
+
+				spare = GetIdleWorkerCount(pstate) - 1 -
+					(ready_list.last_te - ready_list.first_te + 1);
+				next_work_item->maintenanceWorkers = Max(spare, 0);
+
+				pg_log_info("launching item %d %s %s with %d parallel workers",
+							next_work_item->dumpId,
+							next_work_item->desc, next_work_item->tag,
+							next_work_item->maintenanceWorkers);
+			}
+			else
+				pg_log_info("launching item %d %s %s",
+							next_work_item->dumpId,
+							next_work_item->desc, next_work_item->tag);
+
+			INSTR_TIME_SET_CURRENT(next_work_item->startTime);
 
 			/* Dispatch to some worker */
 			DispatchJobForTocEntry(AH, pstate, next_work_item, ACT_RESTORE,
@@ -4471,9 +4583,21 @@ mark_restore_job_done(ArchiveHandle *AH,
 					  void *callback_data)
 {
 	ParallelReadyList *ready_list = (ParallelReadyList *) callback_data;
-
-	pg_log_info("finished item %d %s %s",
-				te->dumpId, te->desc, te->tag);
+	instr_time	duration;
+	double		elapsed;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, te->startTime);
+	elapsed = INSTR_TIME_GET_DOUBLE(duration);
+
+	/* For data items, also report how fast the archive data was loaded */
+	if (te->hadDumper && te->dataLength > 0 && elapsed > 0)
+		pg_log_info("finished item %d %s %s in %.3f s (%.1f MB/s)",
+					te->dumpId, te->desc, te->tag, elapsed,
+					te->dataLength / elapsed / (1024 * 1024));
+	else
+		pg_log_info("finished item %d %s %s in %.3f s",
+					te->dumpId, te->desc, te->tag, elapsed);
 
 	if (status == WORKER_CREATE_DONE)
 		mark_create_done(AH, te);
@@ -4630,7 +4754,8 @@ fix_dependencies(ArchiveHandle *AH)
  * but only in POST_DATA items.
  *
  * Also, for any item having such dependency(s), set its dataLength to the
- * largest dataLength of the table data items it depends on.  This ensures
+ * largest dataLength of the tables it depends on, adding up the items of a
+ * table whose data was dumped in chunks.  This ensures
  * that parallel restore will prioritize larger jobs (index builds, FK
  * constraint checks, etc) over smaller ones, avoiding situations where we
  * end a restore with only one active job working on a large table.
@@ -4655,10 +4780,29 @@ repoint_table_dependencies(ArchiveHandle *AH)
 				DumpId		tabledataid = AH->tableDataId[olddep];
 				TocEntry   *tabledatate = AH->tocsByDumpId[tabledataid];
 
+				pgoff_t		dataLength = tabledatate->dataLength;
+
 				te->dependencies[i] = tabledataid;
-				te->dataLength = Max(te->dataLength, tabledatate->dataLength);
 				pg_log_debug("transferring dependency %d -> %d to %d",
 							 te->dumpId, olddep, tabledataid);
+
+				/* If the data was dumped in chunks, wait for all of them */
+				while (tabledatate->nextTableData != 0)
+				{
+					tabledataid = tabledatate->nextTableData;
+					tabledatate = AH->tocsByDumpId[tabledataid];
+
+					te->dependencies = (DumpId *)
+						pg_realloc(te->dependencies,
+								   (te->nDeps + 1) * sizeof(DumpId));
+					te->dependencies[te->nDeps++] = tabledataid;
+					te->depCount++;
+					dataLength += tabledatate->dataLength;
+					pg_log_debug("adding dependency %d -> %d",
+								 te->dumpId, tabledataid);
+				}
+
+				te->dataLength = Max(te->dataLength, dataLength);
 			}
 		}
 	}
@@ -4780,7 +4924,13 @@ mark_create_done(ArchiveHandle *AH, TocEntry *te)
 	{
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
-		ted->created = true;
+		/*
+		 * Don't do this for a table whose data was dumped in chunks: they are
+		 * loaded concurrently, and the TRUNCATE that restore_toc_entry issues
+		 * for a created table would wipe out the other chunks' rows.
+		 */
+		if (ted->nextTableData == 0)
+			ted->created = true;
 	}
 }
 
@@ -4798,7 +4948,13 @@ inhibit_data_for_failed_table(ArchiveHandle *AH, TocEntry *te)
 	{
 		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
 
-		ted->reqs = 0;
+		for (;;)
+		{
+			ted->reqs = 0;
+			if (ted->nextTableData == 0)
+				break;
+			ted = AH->tocsByDumpId[ted->nextTableData];
+		}
 	}
 }
 
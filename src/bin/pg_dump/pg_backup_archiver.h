@@ -30,6 +30,7 @@
 #include "pg_backup.h"
 
 #include "libpq-fe.h"
+#include "portability/instr_time.h"
 #include "pqexpbuffer.h"
 
 #define LOBBUFSIZE 16384
@@ -95,10 +96,12 @@ typedef z_stream *z_streamp;
 #define K_VERS_1_13 MAKE_ARCHIVE_VERSION(1, 13, 0)	/* change search_path
 													 * behavior */
 #define K_VERS_1_14 MAKE_ARCHIVE_VERSION(1, 14, 0)	/* add tableam */
+#define K_VERS_1_15 MAKE_ARCHIVE_VERSION(1, 15, 0)	/* allow several TABLE
+													 * DATA items per table */
 
 /* Current archive version number (the format we can output) */
 #define K_VERS_MAJOR 1
-#define K_VERS_MINOR 14
+#define K_VERS_MINOR 15
 #define K_VERS_REV 0
 #define K_VERS_SELF MAKE_ARCHIVE_VERSION(K_VERS_MAJOR, K_VERS_MINOR, K_VERS_REV);
 
@@ -350,6 +353,8 @@ struct _archiveHandle
 	size_t		lo_buf_size;
 
 	int			noTocComments;
+	int			txnCount;		/* entries restored in the open transaction
+								 * under --transaction-size, 0 if none */
 	ArchiverStage stage;
 	ArchiverStage lastErrorStage;
 	RestorePass restorePass;	/* used only during parallel restore */
@@ -387,6 +392,8 @@ struct _tocEntry
 	pgoff_t		dataLength;		/* item's data size; 0 if none or unknown */
 	teReqs		reqs;			/* do we need schema and/or data of object */
 	bool		created;		/* set for DATA member if TABLE was created */
+	DumpId		nextTableData;	/* another DATA member of the same TABLE, if
+								 * its data was dumped in chunks; else 0 */
 
 	/* working state (needed only for parallel restore) */
 	struct _tocEntry *pending_prev; /* list links for pending-items list; */
@@ -396,6 +403,9 @@ struct _tocEntry
 	int			nRevDeps;		/* number of such dependencies */
 	DumpId	   *lockDeps;		/* dumpIds of objects this one needs lock on */
 	int			nLockDeps;		/* number of such dependencies */
+	int			maintenanceWorkers; /* max_parallel_maintenance_workers to
+									 * build an index with, or -1 */
+	instr_time	startTime;		/* when the item was dispatched */
 };
 
 extern int	parallel_restore(ArchiveHandle *AH, TocEntry *te);
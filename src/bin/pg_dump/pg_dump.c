@@ -165,6 +165,9 @@ static void expand_table_name_patterns(Archive *fout,
 									   bool strict_names);
 static NamespaceInfo *findNamespace(Archive *fout, Oid nsoid);
 static void dumpTableData(Archive *fout, TableDataInfo *tdinfo);
+static void dumpTableDataChunks(Archive *fout, TableDataInfo *tdinfo,
+								BlockNumber relpages, BlockNumber chunkpages,
+								const char *copyStmt, DataDumperPtr dumpFn);
 static void refreshMatViewData(Archive *fout, TableDataInfo *tdinfo);
 static void guessConstraintInheritance(TableInfo *tblinfo, int numTables);
 static void dumpComment(Archive *fout, const char *type, const char *name,
@@ -319,6 +322,7 @@ main(int argc, char **argv)
 	const char *dumpsnapshot = NULL;
 	char	   *use_role = NULL;
 	long		rowsPerInsert;
+	long		splitLargeTables;
 	int			numWorkers = 1;
 	trivalue	prompt_password = TRI_DEFAULT;
 	int			compressLevel = -1;
@@ -380,6 +384,7 @@ main(int argc, char **argv)
 		{"section", required_argument, NULL, 5},
 		{"serializable-deferrable", no_argument, &dopt.serializable_deferrable, 1},
 		{"snapshot", required_argument, NULL, 6},
+		{"split-large-tables", required_argument, NULL, 11},
 		{"strict-names", no_argument, &strict_names, 1},
 		{"use-set-session-authorization", no_argument, &dopt.use_setsessauth, 1},
 		{"no-comments", no_argument, &dopt.no_comments, 1},
@@ -607,6 +612,22 @@ main(int argc, char **argv)
 				dopt.dump_inserts = (int) rowsPerInsert;
 				break;
 
+			case 11:			/* split large tables */
+				errno = 0;
+				splitLargeTables = strtol(optarg, &endptr, 10);
+
+				if (endptr == optarg || *endptr != '\0' ||
+					splitLargeTables <= 0 ||
+					splitLargeTables > MaxBlockNumber / (1024 * 1024 / BLCKSZ) ||
+					errno == ERANGE)
+				{
+					pg_log_error("split-large-tables must be in range %d..%d",
+								 1, (int) (MaxBlockNumber / (1024 * 1024 / BLCKSZ)));
+					exit_nicely(1);
+				}
+				dopt.split_large_tables = (int) splitLargeTables;
+				break;
+
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit_nicely(1);
@@ -1033,6 +1054,8 @@ help(const char *progname)
 	printf(_("  --section=SECTION            dump named section (pre-data, data, or post-data)\n"));
 	printf(_("  --serializable-deferrable    wait until the dump can run without anomalies\n"));
 	printf(_("  --snapshot=SNAPSHOT          use given snapshot for the dump\n"));
+	printf(_("  --split-large-tables=SIZE    dump data of tables larger than SIZE megabytes\n"
+			 "                               in chunks of that size\n"));
 	printf(_("  --strict-names               require table and/or schema include patterns to\n"
 			 "                               match at least one entity each\n"));
 	printf(_("  --use-set-session-authorization\n"
@@ -1812,6 +1835,15 @@ dumpTableData_copy(Archive *fout, void *dcontext)
 	 */
 	column_list = fmtCopyColumnList(tbinfo, clistBuf);
 
+	/*
+	 * A chunk of a split table is read by a sequential scan of the whole
+	 * table that filters on ctid.  The other chunks are likely being dumped
+	 * concurrently by other workers, so let the scans synchronize and share
+	 * their reads.
+	 */
+	if (tdinfo->chunked)
+		ExecuteSqlStatement(fout, "SET synchronize_seqscans TO on");
+
 	if (tdinfo->filtercond)
 	{
 		/* Note: this syntax is only supported in 8.2 and up */
@@ -1824,7 +1856,7 @@ dumpTableData_copy(Archive *fout, void *dcontext)
 		}
 		else
 			appendPQExpBufferStr(q, "* ");
-		appendPQExpBuffer(q, "FROM %s %s) TO stdout;",
+		appendPQExpBuffer(q, "FROM ONLY %s %s) TO stdout;",
 						  fmtQualifiedDumpable(tbinfo),
 						  tdinfo->filtercond);
 	}
@@ -1924,6 +1956,9 @@ dumpTableData_copy(Archive *fout, void *dcontext)
 		pg_log_warning("unexpected extra results during COPY of table \"%s\"",
 					   classname);
 
+	if (tdinfo->chunked)
+		ExecuteSqlStatement(fout, "SET synchronize_seqscans TO off");
+
 	destroyPQExpBuffer(q);
 	return 1;
 }
@@ -1949,6 +1984,10 @@ dumpTableData_insert(Archive *fout, void *dcontext)
 	int			rows_per_statement = dopt->dump_inserts;
 	int			rows_this_statement = 0;
 
+	/* See dumpTableData_copy */
+	if (tdinfo->chunked)
+		ExecuteSqlStatement(fout, "SET synchronize_seqscans TO on");
+
 	appendPQExpBuffer(q, "DECLARE _pg_dump_cursor CURSOR FOR "
 					  "SELECT * FROM ONLY %s",
 					  fmtQualifiedDumpable(tbinfo));
@@ -2149,6 +2188,9 @@ dumpTableData_insert(Archive *fout, void *dcontext)
 
 	ExecuteSqlStatement(fout, "CLOSE _pg_dump_cursor");
 
+	if (tdinfo->chunked)
+		ExecuteSqlStatement(fout, "SET synchronize_seqscans TO off");
+
 	destroyPQExpBuffer(q);
 	if (insertStmt != NULL)
 		destroyPQExpBuffer(insertStmt);
@@ -2237,18 +2279,8 @@ dumpTableData(Archive *fout, TableDataInfo *tdinfo)
 	if (tdinfo->dobj.dump & DUMP_COMPONENT_DATA)
 	{
 		TocEntry   *te;
-
-		te = ArchiveEntry(fout, tdinfo->dobj.catId, tdinfo->dobj.dumpId,
-						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
-									   .namespace = tbinfo->dobj.namespace->dobj.name,
-									   .owner = tbinfo->rolname,
-									   .description = "TABLE DATA",
-									   .section = SECTION_DATA,
-									   .copyStmt = copyStmt,
-									   .deps = &(tbinfo->dobj.dumpId),
-									   .nDeps = 1,
-									   .dumpFn = dumpFn,
-									   .dumpArg = tdinfo));
+		BlockNumber relpages;
+		BlockNumber chunkpages = 0;
 
 		/*
 		 * Set the TocEntry's dataLength in case we are doing a parallel dump
@@ -2259,13 +2291,105 @@ dumpTableData(Archive *fout, TableDataInfo *tdinfo)
 		 * Cast so that we get the right interpretation of table sizes
 		 * exceeding INT_MAX pages.
 		 */
-		te->dataLength = (BlockNumber) tbinfo->relpages;
+		relpages = (BlockNumber) tbinfo->relpages;
+
+		/*
+		 * Tables larger than --split-large-tables are dumped as several
+		 * TABLE DATA items, each covering a range of blocks, so that a
+		 * parallel dump or restore can work on one table with several jobs.
+		 * We need ctid comparison operators for that; tables with a filter
+		 * condition (extension configuration tables) are always small enough
+		 * not to bother.
+		 */
+		if (dopt->split_large_tables > 0 && tdinfo->filtercond == NULL &&
+			fout->remoteVersion >= 80300)
+			chunkpages = (BlockNumber) dopt->split_large_tables *
+				(1024 * 1024 / BLCKSZ);
+
+		if (chunkpages > 0 && relpages > chunkpages)
+			dumpTableDataChunks(fout, tdinfo, relpages, chunkpages,
+								copyStmt, dumpFn);
+		else
+		{
+			te = ArchiveEntry(fout, tdinfo->dobj.catId, tdinfo->dobj.dumpId,
+							  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
+										   .namespace = tbinfo->dobj.namespace->dobj.name,
+										   .owner = tbinfo->rolname,
+										   .description = "TABLE DATA",
+										   .section = SECTION_DATA,
+										   .copyStmt = copyStmt,
+										   .deps = &(tbinfo->dobj.dumpId),
+										   .nDeps = 1,
+										   .dumpFn = dumpFn,
+										   .dumpArg = tdinfo));
+			te->dataLength = relpages;
+		}
 	}
 
 	destroyPQExpBuffer(copyBuf);
 	destroyPQExpBuffer(clistBuf);
 }
 
+/*
+ * dumpTableDataChunks -
+ *	  make ArchiveEntries for the contents of a table in block-range chunks
+ *
+ * Each chunk dumps the rows whose ctid falls in 'chunkpages' consecutive
+ * blocks.  relpages is only an estimate of the table's size, so the last
+ * chunk has no upper bound, and rows beyond the estimate are not lost.
+ *
+ * The first chunk uses the data object's own dump ID; the others get new
+ * ones.  Since they all depend on the table and are all TABLE DATA items,
+ * pg_restore recognizes them as chunks of the same table's data.
+ */
+static void
+dumpTableDataChunks(Archive *fout, TableDataInfo *tdinfo,
+					BlockNumber relpages, BlockNumber chunkpages,
+					const char *copyStmt, DataDumperPtr dumpFn)
+{
+	TableInfo  *tbinfo = tdinfo->tdtable;
+	BlockNumber start = 0;
+
+	for (;;)
+	{
+		TableDataInfo *chunk;
+		TocEntry   *te;
+		bool		last = (relpages - start <= chunkpages);
+
+		chunk = (TableDataInfo *) pg_malloc(sizeof(TableDataInfo));
+		memcpy(chunk, tdinfo, sizeof(TableDataInfo));
+		chunk->chunked = true;
+
+		if (start == 0)
+			chunk->filtercond = psprintf("WHERE ctid < '(%u,0)'",
+										 chunkpages);
+		else if (last)
+			chunk->filtercond = psprintf("WHERE ctid >= '(%u,0)'",
+										 start);
+		else
+			chunk->filtercond = psprintf("WHERE ctid >= '(%u,0)' AND ctid < '(%u,0)'",
+										 start, start + chunkpages);
+
+		te = ArchiveEntry(fout, tdinfo->dobj.catId,
+						  start == 0 ? tdinfo->dobj.dumpId : createDumpId(),
+						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
+									   .namespace = tbinfo->dobj.namespace->dobj.name,
+									   .owner = tbinfo->rolname,
+									   .description = "TABLE DATA",
+									   .section = SECTION_DATA,
+									   .copyStmt = copyStmt,
+									   .deps = &(tbinfo->dobj.dumpId),
+									   .nDeps = 1,
+									   .dumpFn = dumpFn,
+									   .dumpArg = chunk));
+		te->dataLength = last ? relpages - start : chunkpages;
+
+		if (last)
+			break;
+		start += chunkpages;
+	}
+}
+
 /*
  * refreshMatViewData -
  *	  load or refresh the contents of a single materialized view
@@ -2349,6 +2473,10 @@ makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo)
 	if (tbinfo->relkind == RELKIND_PARTITIONED_TABLE)
 		return;
 
+	/* Skip global temporary tables (contents belong to other sessions) */
+	if (tbinfo->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+		return;
+
 	/* Don't dump data in unlogged tables, if so requested */
 	if (tbinfo->relpersistence == RELPERSISTENCE_UNLOGGED &&
 		dopt->no_unlogged_table_data)
@@ -2380,6 +2508,7 @@ makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo)
 	tdinfo->dobj.namespace = tbinfo->dobj.namespace;
 	tdinfo->tdtable = tbinfo;
 	tdinfo->filtercond = NULL;	/* might get set later */
+	tdinfo->chunked = false;
 	addObjectDependency(&tdinfo->dobj, tbinfo->dobj.dumpId);
 
 	tbinfo->dataObj = tdinfo;
@@ -4099,6 +4228,7 @@ getSubscriptions(Archive *fout)
 	int			i_rolname;
 	int			i_subconninfo;
 	int			i_subslotname;
+	int			i_subbinary;
 	int			i_subsynccommit;
 	int			i_subpublications;
 	int			i,
@@ -4132,11 +4262,18 @@ getSubscriptions(Archive *fout)
 					  "SELECT s.tableoid, s.oid, s.subname,"
 					  "(%s s.subowner) AS rolname, "
 					  " s.subconninfo, s.subslotname, s.subsynccommit, "
-					  " s.subpublications "
-					  "FROM pg_subscription s "
-					  "WHERE s.subdbid = (SELECT oid FROM pg_database"
-					  "                   WHERE datname = current_database())",
+					  " s.subpublications, ",
 					  username_subquery);
+
+	if (fout->remoteVersion >= 120000)
+		appendPQExpBufferStr(query, " s.subbinary ");
+	else
+		appendPQExpBufferStr(query, " false AS subbinary ");
+
+	appendPQExpBufferStr(query,
+						 "FROM pg_subscription s "
+						 "WHERE s.subdbid = (SELECT oid FROM pg_database"
+						 "                   WHERE datname = current_database())");
 	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
 
 	ntups = PQntuples(res);
@@ -4147,6 +4284,7 @@ getSubscriptions(Archive *fout)
 	i_rolname = PQfnumber(res, "rolname");
 	i_subconninfo = PQfnumber(res, "subconninfo");
 	i_subslotname = PQfnumber(res, "subslotname");
+	i_subbinary = PQfnumber(res, "subbinary");
 	i_subsynccommit = PQfnumber(res, "subsynccommit");
 	i_subpublications = PQfnumber(res, "subpublications");
 
@@ -4166,6 +4304,8 @@ getSubscriptions(Archive *fout)
 			subinfo[i].subslotname = NULL;
 		else
 			subinfo[i].subslotname = pg_strdup(PQgetvalue(res, i, i_subslotname));
+		subinfo[i].subbinary =
+			pg_strdup(PQgetvalue(res, i, i_subbinary));
 		subinfo[i].subsynccommit =
 			pg_strdup(PQgetvalue(res, i, i_subsynccommit));
 		subinfo[i].subpublications =
@@ -4238,6 +4378,9 @@ dumpSubscription(Archive *fout, SubscriptionInfo *subinfo)
 	else
 		appendPQExpBufferStr(query, "NONE");
 
+	if (strcmp(subinfo->subbinary, "t") == 0)
+		appendPQExpBufferStr(query, ", binary = true");
+
 	if (strcmp(subinfo->subsynccommit, "off") != 0)
 		appendPQExpBuffer(query, ", synchronous_commit = %s", fmtId(subinfo->subsynccommit));
 
@@ -5919,6 +6062,7 @@ getTables(Archive *fout, int *numTables)
 	int			i_toastminmxid;
 	int			i_relpersistence;
 	int			i_relispopulated;
+	int			i_relisivm;
 	int			i_relreplident;
 	int			i_owning_tab;
 	int			i_owning_col;
@@ -6023,6 +6167,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "tc.relminmxid AS tminmxid, "
 						  "c.relpersistence, c.relispopulated, "
+						  "c.relkind = '%c' AND EXISTS (SELECT 1 FROM pg_depend dt JOIN pg_trigger t ON (dt.classid = 'pg_trigger'::regclass AND dt.objid = t.oid) JOIN pg_proc p ON (t.tgfoid = p.oid) WHERE dt.refclassid = 'pg_class'::regclass AND dt.refobjid = c.oid AND p.proname = 'ivm_immediate_maintenance') AS relisivm, "
 						  "c.relreplident, c.relpages, am.amname, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
 						  "d.refobjid AS owning_tab, "
@@ -6067,6 +6212,7 @@ getTables(Archive *fout, int *numTables)
 						  initracl_subquery->data,
 						  username_subquery,
 						  relhasoids,
+						  RELKIND_MATVIEW,
 						  RELKIND_SEQUENCE,
 						  attacl_subquery->data,
 						  attracl_subquery->data,
@@ -6112,6 +6258,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "tc.relminmxid AS tminmxid, "
 						  "c.relpersistence, c.relispopulated, "
+						  "'f' AS relisivm, "
 						  "c.relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
@@ -6162,6 +6309,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "tc.relminmxid AS tminmxid, "
 						  "c.relpersistence, c.relispopulated, "
+						  "'f' AS relisivm, "
 						  "c.relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
@@ -6212,6 +6360,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "tc.relminmxid AS tminmxid, "
 						  "c.relpersistence, c.relispopulated, "
+						  "'f' AS relisivm, "
 						  "'d' AS relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
@@ -6262,6 +6411,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "0 AS tminmxid, "
 						  "c.relpersistence, 't' as relispopulated, "
+						  "'f' AS relisivm, "
 						  "'d' AS relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
@@ -6310,6 +6460,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "0 AS tminmxid, "
 						  "'p' AS relpersistence, 't' as relispopulated, "
+						  "'f' AS relisivm, "
 						  "'d' AS relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "CASE WHEN c.reloftype <> 0 THEN c.reloftype::pg_catalog.regtype ELSE NULL END AS reloftype, "
@@ -6357,6 +6508,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "0 AS tminmxid, "
 						  "'p' AS relpersistence, 't' as relispopulated, "
+						  "'f' AS relisivm, "
 						  "'d' AS relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "NULL AS reloftype, "
@@ -6404,6 +6556,7 @@ getTables(Archive *fout, int *numTables)
 						  "tc.relfrozenxid AS tfrozenxid, "
 						  "0 AS tminmxid, "
 						  "'p' AS relpersistence, 't' as relispopulated, "
+						  "'f' AS relisivm, "
 						  "'d' AS relreplident, c.relpages, "
 						  "NULL AS amname, "
 						  "NULL AS reloftype, "
@@ -6450,6 +6603,7 @@ getTables(Archive *fout, int *numTables)
 						  "0 AS toid, "
 						  "0 AS tfrozenxid, 0 AS tminmxid,"
 						  "'p' AS relpersistence, 't' as relispopulated, "
+						  "'f' AS relisivm, "
 						  "'d' AS relreplident, relpages, "
 						  "NULL AS amname, "
 						  "NULL AS reloftype, "
@@ -6517,6 +6671,7 @@ getTables(Archive *fout, int *numTables)
 	i_toastminmxid = PQfnumber(res, "tminmxid");
 	i_relpersistence = PQfnumber(res, "relpersistence");
 	i_relispopulated = PQfnumber(res, "relispopulated");
+	i_relisivm = PQfnumber(res, "relisivm");
 	i_relreplident = PQfnumber(res, "relreplident");
 	i_relpages = PQfnumber(res, "relpages");
 	i_owning_tab = PQfnumber(res, "owning_tab");
@@ -6572,6 +6727,7 @@ getTables(Archive *fout, int *numTables)
 		tblinfo[i].forcerowsec = (strcmp(PQgetvalue(res, i, i_relforcerowsec), "t") == 0);
 		tblinfo[i].hasoids = (strcmp(PQgetvalue(res, i, i_relhasoids), "t") == 0);
 		tblinfo[i].relispopulated = (strcmp(PQgetvalue(res, i, i_relispopulated), "t") == 0);
+		tblinfo[i].relisivm = (strcmp(PQgetvalue(res, i, i_relisivm), "t") == 0);
 		tblinfo[i].relreplident = *(PQgetvalue(res, i, i_relreplident));
 		tblinfo[i].relpages = atoi(PQgetvalue(res, i, i_relpages));
 		tblinfo[i].frozenxid = atooid(PQgetvalue(res, i, i_relfrozenxid));
@@ -8219,6 +8375,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 	int			i_atthasdef;
 	int			i_attidentity;
 	int			i_attgenerated;
+	int			i_attcompression;
 	int			i_attisdropped;
 	int			i_attlen;
 	int			i_attalign;
@@ -8273,10 +8430,12 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 
 		if (fout->remoteVersion >= 120000)
 			appendPQExpBuffer(q,
-							  "a.attgenerated,\n");
+							  "a.attgenerated,\n"
+							  "a.attcompression,\n");
 		else
 			appendPQExpBuffer(q,
-							  "'' AS attgenerated,\n");
+							  "'' AS attgenerated,\n"
+							  "'' AS attcompression,\n");
 
 		if (fout->remoteVersion >= 110000)
 			appendPQExpBuffer(q,
@@ -8351,6 +8510,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 		i_atthasdef = PQfnumber(res, "atthasdef");
 		i_attidentity = PQfnumber(res, "attidentity");
 		i_attgenerated = PQfnumber(res, "attgenerated");
+		i_attcompression = PQfnumber(res, "attcompression");
 		i_attisdropped = PQfnumber(res, "attisdropped");
 		i_attlen = PQfnumber(res, "attlen");
 		i_attalign = PQfnumber(res, "attalign");
@@ -8369,6 +8529,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 		tbinfo->typstorage = (char *) pg_malloc(ntups * sizeof(char));
 		tbinfo->attidentity = (char *) pg_malloc(ntups * sizeof(char));
 		tbinfo->attgenerated = (char *) pg_malloc(ntups * sizeof(char));
+		tbinfo->attcompression = (char *) pg_malloc(ntups * sizeof(char));
 		tbinfo->attisdropped = (bool *) pg_malloc(ntups * sizeof(bool));
 		tbinfo->attlen = (int *) pg_malloc(ntups * sizeof(int));
 		tbinfo->attalign = (char *) pg_malloc(ntups * sizeof(char));
@@ -8395,6 +8556,7 @@ getTableAttrs(Archive *fout, TableInfo *tblinfo, int numTables)
 			tbinfo->typstorage[j] = *(PQgetvalue(res, j, i_typstorage));
 			tbinfo->attidentity[j] = *(PQgetvalue(res, j, i_attidentity));
 			tbinfo->attgenerated[j] = *(PQgetvalue(res, j, i_attgenerated));
+			tbinfo->attcompression[j] = *(PQgetvalue(res, j, i_attcompression));
 			tbinfo->needs_override = tbinfo->needs_override || (tbinfo->attidentity[j] == ATTRIBUTE_IDENTITY_ALWAYS);
 			tbinfo->attisdropped[j] = (PQgetvalue(res, j, i_attisdropped)[0] == 't');
 			tbinfo->attlen[j] = atoi(PQgetvalue(res, j, i_attlen));
@@ -15586,9 +15748,12 @@ dumpTableSchema(Archive *fout, TableInfo *tbinfo)
 			binary_upgrade_set_pg_class_oids(fout, q,
 											 tbinfo->dobj.catId.oid, false);
 
-		appendPQExpBuffer(q, "CREATE %s%s %s",
+		appendPQExpBuffer(q, "CREATE %s%s%s %s",
 						  tbinfo->relpersistence == RELPERSISTENCE_UNLOGGED ?
-						  "UNLOGGED " : "",
+						  "UNLOGGED " :
+						  tbinfo->relpersistence == RELPERSISTENCE_GLOBAL_TEMP ?
+						  "GLOBAL TEMPORARY " : "",
+						  tbinfo->relisivm ? "INCREMENTAL " : "",
 						  reltypename,
 						  qualrelname);
 
@@ -16095,6 +16260,34 @@ dumpTableSchema(Archive *fout, TableInfo *tbinfo)
 				}
 			}
 
+			/*
+			 * Dump per-column compression method, if one has been set
+			 * explicitly.
+			 */
+			if (tbinfo->attcompression[j] != '\0')
+			{
+				const char *cmname;
+
+				switch (tbinfo->attcompression[j])
+				{
+					case ATTRIBUTE_COMPRESSION_PGLZ:
+						cmname = "pglz";
+						break;
+					default:
+						cmname = NULL;
+				}
+
+				if (cmname != NULL)
+				{
+					appendPQExpBuffer(q, "ALTER TABLE ONLY %s ",
+									  qualrelname);
+					appendPQExpBuffer(q, "ALTER COLUMN %s ",
+									  fmtId(tbinfo->attnames[j]));
+					appendPQExpBuffer(q, "SET COMPRESSION %s;\n",
+									  cmname);
+				}
+			}
+
 			/*
 			 * Dump per-column attributes.
 			 */
@@ -4,7 +4,7 @@ use warnings;
 use Config;
 use PostgresNode;
 use TestLib;
-use Test::More tests => 74;
+use Test::More tests => 80;
 
 my $tempdir       = TestLib::tempdir;
 my $tempdir_short = TestLib::tempdir_short;
@@ -127,6 +127,11 @@ command_fails_like(
 	'pg_dump: --on-conflict-do-nothing requires --inserts, --rows-per-insert, --column-inserts'
 );
 
+command_fails_like(
+	[ 'pg_dump', '--split-large-tables=0' ],
+	qr/\Qpg_dump: error: split-large-tables must be in range 1..\E/,
+	'pg_dump: split-large-tables must be in range');
+
 # pg_dumpall command-line argument checks
 command_fails_like(
 	[ 'pg_dumpall', '-g', '-r' ],
@@ -157,6 +162,17 @@ command_fails_like(
 	'pg_restore: options -C\/--create and -1\/--single-transaction cannot be used together'
 );
 
+command_fails_like(
+	[ 'pg_restore', '-1', '--transaction-size=100', '-f -' ],
+	qr/\Qpg_restore: error: options -1\/--single-transaction and --transaction-size cannot be used together\E/,
+	'pg_restore: options -1/--single-transaction and --transaction-size cannot be used together'
+);
+
+command_fails_like(
+	[ 'pg_restore', '--transaction-size=0', '-f -' ],
+	qr/\Qpg_restore: error: transaction size must be greater than zero\E/,
+	'pg_restore: transaction size must be greater than zero');
+
 # also fails for -r and -t, but it seems pointless to add more tests for those.
 command_fails_like(
 	[ 'pg_dumpall', '--exclude-database=foo', '--globals-only' ],
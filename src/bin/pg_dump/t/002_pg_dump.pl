@@ -708,6 +708,25 @@ my %tests = (
 		},
 	},
 
+	'ALTER TABLE ONLY test_table ALTER COLUMN col4 SET COMPRESSION' => {
+		create_order => 95,
+		create_sql =>
+		  'ALTER TABLE dump_test.test_table ALTER COLUMN col4 SET COMPRESSION pglz;',
+		regexp => qr/^
+			\QALTER TABLE ONLY dump_test.test_table ALTER COLUMN col4 SET COMPRESSION pglz;\E\n
+			/xm,
+		like => {
+			%full_runs,
+			%dump_test_schema_runs,
+			only_dump_test_table => 1,
+			section_pre_data     => 1,
+		},
+		unlike => {
+			exclude_dump_test_schema => 1,
+			exclude_test_table       => 1,
+		},
+	},
+
 	'ALTER TABLE ONLY test_table ALTER COLUMN col4 SET n_distinct' => {
 		create_order => 95,
 		create_sql =>
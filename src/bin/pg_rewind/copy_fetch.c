@@ -249,14 +249,29 @@ execute_pagemap(datapagemap_t *pagemap, const char *path)
 {
 	datapagemap_iterator_t *iter;
 	BlockNumber blkno;
-	off_t		offset;
+	BlockNumber start = InvalidBlockNumber;
+	BlockNumber end = InvalidBlockNumber;
 
+	/*
+	 * The blocks come in order.  Copy each run of consecutive blocks in one
+	 * go.
+	 */
 	iter = datapagemap_iterate(pagemap);
 	while (datapagemap_next(iter, &blkno))
 	{
-		offset = blkno * BLCKSZ;
-		rewind_copy_file_range(path, offset, offset + BLCKSZ, false);
-		/* Ok, this block has now been copied from new data dir to old */
+		if (start != InvalidBlockNumber && blkno == end)
+		{
+			end++;
+			continue;
+		}
+		if (start != InvalidBlockNumber)
+			rewind_copy_file_range(path, (off_t) start * BLCKSZ,
+								   (off_t) end * BLCKSZ, false);
+		start = blkno;
+		end = blkno + 1;
 	}
+	if (start != InvalidBlockNumber)
+		rewind_copy_file_range(path, (off_t) start * BLCKSZ,
+							   (off_t) end * BLCKSZ, false);
 	pg_free(iter);
 }
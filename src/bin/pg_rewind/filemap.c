@@ -17,6 +17,7 @@
 #include "filemap.h"
 #include "pg_rewind.h"
 
+#include "access/xlog_internal.h"
 #include "common/string.h"
 #include "catalog/pg_tablespace_d.h"
 #include "storage/fd.h"
@@ -24,6 +25,7 @@
 filemap_t  *filemap = NULL;
 
 static bool isRelDataFile(const char *path);
+static bool isOldWalSegment(const char *path);
 static char *datasegpath(RelFileNode rnode, ForkNumber forknum,
 						 BlockNumber segno);
 static int	path_cmp(const void *a, const void *b);
@@ -43,9 +45,8 @@ static bool check_file_excluded(const char *path, bool is_source);
 static const char *excludeDirContents[] =
 {
 	/*
-	 * Skip temporary statistics files. PG_STAT_TMP_DIR must be skipped even
-	 * when stats_temp_directory is set because PGSS_TEXT_FILE is always
-	 * created there.
+	 * Skip temporary statistics files.  PGSS_TEXT_FILE is created in
+	 * PG_STAT_TMP_DIR.
 	 */
 	"pg_stat_tmp",				/* defined as PG_STAT_TMP_DIR */
 
@@ -109,9 +110,12 @@ static const char *excludeFiles[] =
 
 /*
  * Create a new file map (stored in the global pointer "filemap").
+ *
+ * chkptredo is the redo pointer of the last common checkpoint, where the
+ * recovery of the rewound target will begin.
  */
 void
-filemap_create(void)
+filemap_create(XLogRecPtr chkptredo)
 {
 	filemap_t  *map;
 
@@ -120,6 +124,7 @@ filemap_create(void)
 	map->nlist = 0;
 	map->array = NULL;
 	map->narray = 0;
+	XLByteToSeg(chkptredo, map->first_wal_segno, WalSegSz);
 
 	Assert(filemap == NULL);
 	filemap = map;
@@ -250,6 +255,17 @@ process_source_file(const char *path, file_type_t type, size_t newsize,
 					action = FILE_ACTION_NONE;
 					oldsize = statbuf.st_size;
 				}
+				else if (isOldWalSegment(path))
+				{
+					/*
+					 * Another exception: WAL from before the last common
+					 * checkpoint is not needed by the target, so don't spend
+					 * time copying it.  Leave the target's copy alone if it
+					 * has one.
+					 */
+					action = FILE_ACTION_NONE;
+					oldsize = exists ? statbuf.st_size : 0;
+				}
 				else
 				{
 					action = FILE_ACTION_COPY;
@@ -754,6 +770,28 @@ isRelDataFile(const char *path)
 	return matched;
 }
 
+/*
+ * Does the path point to a WAL segment that precedes the last common
+ * checkpoint?
+ */
+static bool
+isOldWalSegment(const char *path)
+{
+	TimeLineID	tli;
+	XLogSegNo	segno;
+
+	if (strncmp(path, XLOGDIR "/", strlen(XLOGDIR "/")) != 0)
+		return false;
+	path += strlen(XLOGDIR "/");
+
+	if (!IsXLogFileName(path))
+		return false;
+
+	XLogFromFileName(path, &tli, &segno, WalSegSz);
+
+	return segno < filemap->first_wal_segno;
+}
+
 /*
  * A helper function to create the path of a relation file and segment.
  *
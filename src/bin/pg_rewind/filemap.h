@@ -8,6 +8,7 @@
 #ifndef FILEMAP_H
 #define FILEMAP_H
 
+#include "access/xlogdefs.h"
 #include "storage/relfilenode.h"
 #include "storage/block.h"
 
@@ -85,11 +86,17 @@ typedef struct filemap_t
 	 */
 	uint64		total_size;
 	uint64		fetch_size;
+
+	/*
+	 * WAL segments before this one are not needed after the rewind, because
+	 * recovery starts at the redo point of the last common checkpoint.
+	 */
+	XLogSegNo	first_wal_segno;
 } filemap_t;
 
 extern filemap_t *filemap;
 
-extern void filemap_create(void);
+extern void filemap_create(XLogRecPtr chkptredo);
 extern void calculate_totals(void);
 extern void print_filemap(void);
 
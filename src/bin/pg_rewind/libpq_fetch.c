@@ -13,6 +13,9 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
 
 #include "pg_rewind.h"
 #include "datapagemap.h"
@@ -27,6 +30,15 @@
 
 static PGconn *conn = NULL;
 
+/*
+ * Connections to fetch file contents over, --jobs of them.  The first one is
+ * conn; the others are only used for fetching.  fetchqueued counts the bytes
+ * to be fetched over each.
+ */
+static PGconn **fetchconns = NULL;
+static uint64 *fetchqueued = NULL;
+static int	nfetchconns = 0;
+
 /*
  * Files are fetched max CHUNKSIZE bytes at a time.
  *
@@ -36,36 +48,25 @@ static PGconn *conn = NULL;
  */
 #define CHUNKSIZE 1000000
 
+static PGconn *connect_source(const char *connstr);
 static void receiveFileChunks(const char *sql);
-static void execute_pagemap(datapagemap_t *pagemap, const char *path);
+static void processFileChunk(PGresult *res);
+static void execute_pagemap(int connno, datapagemap_t *pagemap,
+							const char *path);
 static char *run_simple_query(const char *sql);
-static void run_simple_command(const char *sql);
+static void run_simple_command(PGconn *pgconn, const char *sql);
 
 void
 libpqConnect(const char *connstr)
 {
 	char	   *str;
-	PGresult   *res;
+	int			i;
 
-	conn = PQconnectdb(connstr);
-	if (PQstatus(conn) == CONNECTION_BAD)
-		pg_fatal("could not connect to server: %s",
-				 PQerrorMessage(conn));
+	conn = connect_source(connstr);
 
 	if (showprogress)
 		pg_log_info("connected to server");
 
-	/* disable all types of timeouts */
-	run_simple_command("SET statement_timeout = 0");
-	run_simple_command("SET lock_timeout = 0");
-	run_simple_command("SET idle_in_transaction_session_timeout = 0");
-
-	res = PQexec(conn, ALWAYS_SECURE_SEARCH_PATH_SQL);
-	if (PQresultStatus(res) != PGRES_TUPLES_OK)
-		pg_fatal("could not clear search_path: %s",
-				 PQresultErrorMessage(res));
-	PQclear(res);
-
 	/*
 	 * Check that the server is not in hot standby mode. There is no
 	 * fundamental reason that couldn't be made to work, but it doesn't
@@ -87,6 +88,40 @@ libpqConnect(const char *connstr)
 		pg_fatal("full_page_writes must be enabled in the source server");
 	pg_free(str);
 
+	/* Open the additional connections for fetching */
+	fetchconns = pg_malloc(num_jobs * sizeof(PGconn *));
+	fetchqueued = pg_malloc0(num_jobs * sizeof(uint64));
+	fetchconns[0] = conn;
+	for (i = 1; i < num_jobs; i++)
+		fetchconns[i] = connect_source(connstr);
+	nfetchconns = num_jobs;
+}
+
+/*
+ * Open a connection to the source server, and set it up for our use.
+ */
+static PGconn *
+connect_source(const char *connstr)
+{
+	PGconn	   *pgconn;
+	PGresult   *res;
+
+	pgconn = PQconnectdb(connstr);
+	if (PQstatus(pgconn) == CONNECTION_BAD)
+		pg_fatal("could not connect to server: %s",
+				 PQerrorMessage(pgconn));
+
+	/* disable all types of timeouts */
+	run_simple_command(pgconn, "SET statement_timeout = 0");
+	run_simple_command(pgconn, "SET lock_timeout = 0");
+	run_simple_command(pgconn, "SET idle_in_transaction_session_timeout = 0");
+
+	res = PQexec(pgconn, ALWAYS_SECURE_SEARCH_PATH_SQL);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pg_fatal("could not clear search_path: %s",
+				 PQresultErrorMessage(res));
+	PQclear(res);
+
 	/*
 	 * Although we don't do any "real" updates, we do work with a temporary
 	 * table. We don't care about synchronous commit for that. It doesn't
@@ -94,7 +129,9 @@ libpqConnect(const char *connstr)
 	 * replication, and replication isn't working for some reason, we don't
 	 * want to get stuck, waiting for it to start working again.
 	 */
-	run_simple_command("SET synchronous_commit = off");
+	run_simple_command(pgconn, "SET synchronous_commit = off");
+
+	return pgconn;
 }
 
 /*
@@ -125,15 +162,15 @@ run_simple_query(const char *sql)
 }
 
 /*
- * Runs a command.
+ * Runs a command on the given connection.
  * In the event of a failure, exit immediately.
  */
 static void
-run_simple_command(const char *sql)
+run_simple_command(PGconn *pgconn, const char *sql)
 {
 	PGresult   *res;
 
-	res = PQexec(conn, sql);
+	res = PQexec(pgconn, sql);
 
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		pg_fatal("error running query (%s) in source server: %s",
@@ -244,9 +281,10 @@ libpqProcessFileList(void)
 }
 
 /*----
- * Runs a query, which returns pieces of files from the remote source data
- * directory, and overwrites the corresponding parts of target files with
- * the received parts. The result set is expected to be of format:
+ * Runs a query on all the fetch connections, which returns pieces of files
+ * from the remote source data directory, and overwrites the corresponding
+ * parts of target files with the received parts, in whatever order they
+ * arrive. The result set is expected to be of format:
  *
  * path		text	-- path in the data directory, e.g "base/1/123"
  * begin	int8	-- offset within the file
@@ -256,113 +294,185 @@ libpqProcessFileList(void)
 static void
 receiveFileChunks(const char *sql)
 {
-	PGresult   *res;
+	bool	   *active;
+	int			nactive;
+	int			i;
 
-	if (PQsendQueryParams(conn, sql, 0, NULL, NULL, NULL, NULL, 1) != 1)
-		pg_fatal("could not send query: %s", PQerrorMessage(conn));
+	/* Start the query on all connections */
+	active = pg_malloc(nfetchconns * sizeof(bool));
+	for (i = 0; i < nfetchconns; i++)
+	{
+		if (PQsendQueryParams(fetchconns[i], sql, 0, NULL, NULL, NULL, NULL,
+							  1) != 1)
+			pg_fatal("could not send query: %s",
+					 PQerrorMessage(fetchconns[i]));
 
-	pg_log_debug("getting file chunks");
+		if (PQsetSingleRowMode(fetchconns[i]) != 1)
+			pg_fatal("could not set libpq connection to single row mode");
+
+		active[i] = true;
+	}
+	nactive = nfetchconns;
 
-	if (PQsetSingleRowMode(conn) != 1)
-		pg_fatal("could not set libpq connection to single row mode");
+	pg_log_debug("getting file chunks");
 
-	while ((res = PQgetResult(conn)) != NULL)
+	while (nactive > 0)
 	{
-		char	   *filename;
-		int			filenamelen;
-		int64		chunkoff;
-		char		chunkoff_str[32];
-		int			chunksize;
-		char	   *chunk;
-
-		switch (PQresultStatus(res))
-		{
-			case PGRES_SINGLE_TUPLE:
-				break;
+		fd_set		input_mask;
+		pgsocket	maxfd = -1;
 
-			case PGRES_TUPLES_OK:
-				PQclear(res);
-				continue;		/* final zero-row result */
-
-			default:
-				pg_fatal("unexpected result while fetching remote files: %s",
-						 PQresultErrorMessage(res));
+		/* Process the rows that have arrived on each connection */
+		for (i = 0; i < nfetchconns; i++)
+		{
+			while (active[i] && !PQisBusy(fetchconns[i]))
+			{
+				PGresult   *res = PQgetResult(fetchconns[i]);
+
+				if (res == NULL)
+				{
+					/* query is complete */
+					active[i] = false;
+					nactive--;
+				}
+				else
+					processFileChunk(res);
+			}
 		}
+		if (nactive == 0)
+			break;
 
-		/* sanity check the result set */
-		if (PQnfields(res) != 3 || PQntuples(res) != 1)
-			pg_fatal("unexpected result set size while fetching remote files");
-
-		if (PQftype(res, 0) != TEXTOID ||
-			PQftype(res, 1) != INT8OID ||
-			PQftype(res, 2) != BYTEAOID)
+		/* Wait for more data to arrive on any of them */
+		FD_ZERO(&input_mask);
+		for (i = 0; i < nfetchconns; i++)
 		{
-			pg_fatal("unexpected data types in result set while fetching remote files: %u %u %u",
-					 PQftype(res, 0), PQftype(res, 1), PQftype(res, 2));
+			if (active[i])
+			{
+				FD_SET(PQsocket(fetchconns[i]), &input_mask);
+				maxfd = Max(maxfd, PQsocket(fetchconns[i]));
+			}
 		}
 
-		if (PQfformat(res, 0) != 1 &&
-			PQfformat(res, 1) != 1 &&
-			PQfformat(res, 2) != 1)
+		if (select(maxfd + 1, &input_mask, NULL, NULL, NULL) < 0)
 		{
-			pg_fatal("unexpected result format while fetching remote files");
+			if (errno == EINTR)
+				continue;
+			pg_fatal("select() failed: %m");
 		}
 
-		if (PQgetisnull(res, 0, 0) ||
-			PQgetisnull(res, 0, 1))
+		for (i = 0; i < nfetchconns; i++)
 		{
-			pg_fatal("unexpected null values in result while fetching remote files");
+			if (active[i] &&
+				FD_ISSET(PQsocket(fetchconns[i]), &input_mask) &&
+				!PQconsumeInput(fetchconns[i]))
+				pg_fatal("could not receive data from server: %s",
+						 PQerrorMessage(fetchconns[i]));
 		}
+	}
 
-		if (PQgetlength(res, 0, 1) != sizeof(int64))
-			pg_fatal("unexpected result length while fetching remote files");
+	pg_free(active);
+}
 
-		/* Read result set to local variables */
-		memcpy(&chunkoff, PQgetvalue(res, 0, 1), sizeof(int64));
-		chunkoff = pg_ntoh64(chunkoff);
-		chunksize = PQgetlength(res, 0, 2);
+/*
+ * Process one row of the result of the query in receiveFileChunks(), and
+ * free it.
+ */
+static void
+processFileChunk(PGresult *res)
+{
+	char	   *filename;
+	int			filenamelen;
+	int64		chunkoff;
+	char		chunkoff_str[32];
+	int			chunksize;
+	char	   *chunk;
+
+	switch (PQresultStatus(res))
+	{
+		case PGRES_SINGLE_TUPLE:
+			break;
 
-		filenamelen = PQgetlength(res, 0, 0);
-		filename = pg_malloc(filenamelen + 1);
-		memcpy(filename, PQgetvalue(res, 0, 0), filenamelen);
-		filename[filenamelen] = '\0';
+		case PGRES_TUPLES_OK:
+			PQclear(res);
+			return;			/* final zero-row result */
 
-		chunk = PQgetvalue(res, 0, 2);
+		default:
+			pg_fatal("unexpected result while fetching remote files: %s",
+					 PQresultErrorMessage(res));
+	}
 
-		/*
-		 * If a file has been deleted on the source, remove it on the target
-		 * as well.  Note that multiple unlink() calls may happen on the same
-		 * file if multiple data chunks are associated with it, hence ignore
-		 * unconditionally anything missing.  If this file is not a relation
-		 * data file, then it has been already truncated when creating the
-		 * file chunk list at the previous execution of the filemap.
-		 */
-		if (PQgetisnull(res, 0, 2))
-		{
-			pg_log_debug("received null value for chunk for file \"%s\", file has been deleted",
-						 filename);
-			remove_target_file(filename, true);
-			pg_free(filename);
-			PQclear(res);
-			continue;
-		}
+	/* sanity check the result set */
+	if (PQnfields(res) != 3 || PQntuples(res) != 1)
+		pg_fatal("unexpected result set size while fetching remote files");
 
-		/*
-		 * Separate step to keep platform-dependent format code out of
-		 * translatable strings.
-		 */
-		snprintf(chunkoff_str, sizeof(chunkoff_str), INT64_FORMAT, chunkoff);
-		pg_log_debug("received chunk for file \"%s\", offset %s, size %d",
-					 filename, chunkoff_str, chunksize);
+	if (PQftype(res, 0) != TEXTOID ||
+		PQftype(res, 1) != INT8OID ||
+		PQftype(res, 2) != BYTEAOID)
+	{
+		pg_fatal("unexpected data types in result set while fetching remote files: %u %u %u",
+				 PQftype(res, 0), PQftype(res, 1), PQftype(res, 2));
+	}
 
-		open_target_file(filename, false);
+	if (PQfformat(res, 0) != 1 &&
+		PQfformat(res, 1) != 1 &&
+		PQfformat(res, 2) != 1)
+	{
+		pg_fatal("unexpected result format while fetching remote files");
+	}
 
-		write_target_range(chunk, chunkoff, chunksize);
+	if (PQgetisnull(res, 0, 0) ||
+		PQgetisnull(res, 0, 1))
+	{
+		pg_fatal("unexpected null values in result while fetching remote files");
+	}
 
-		pg_free(filename);
+	if (PQgetlength(res, 0, 1) != sizeof(int64))
+		pg_fatal("unexpected result length while fetching remote files");
+
+	/* Read result set to local variables */
+	memcpy(&chunkoff, PQgetvalue(res, 0, 1), sizeof(int64));
+	chunkoff = pg_ntoh64(chunkoff);
+	chunksize = PQgetlength(res, 0, 2);
 
+	filenamelen = PQgetlength(res, 0, 0);
+	filename = pg_malloc(filenamelen + 1);
+	memcpy(filename, PQgetvalue(res, 0, 0), filenamelen);
+	filename[filenamelen] = '\0';
+
+	chunk = PQgetvalue(res, 0, 2);
+
+	/*
+	 * If a file has been deleted on the source, remove it on the target as
+	 * well.  Note that multiple unlink() calls may happen on the same file if
+	 * multiple data chunks are associated with it, hence ignore
+	 * unconditionally anything missing.  If this file is not a relation data
+	 * file, then it has been already truncated when creating the file chunk
+	 * list at the previous execution of the filemap.
+	 */
+	if (PQgetisnull(res, 0, 2))
+	{
+		pg_log_debug("received null value for chunk for file \"%s\", file has been deleted",
+					 filename);
+		remove_target_file(filename, true);
+		pg_free(filename);
 		PQclear(res);
+		return;
 	}
+
+	/*
+	 * Separate step to keep platform-dependent format code out of
+	 * translatable strings.
+	 */
+	snprintf(chunkoff_str, sizeof(chunkoff_str), INT64_FORMAT, chunkoff);
+	pg_log_debug("received chunk for file \"%s\", offset %s, size %d",
+				 filename, chunkoff_str, chunksize);
+
+	open_target_file(filename, false);
+
+	write_target_range(chunk, chunkoff, chunksize);
+
+	pg_free(filename);
+
+	PQclear(res);
 }
 
 /*
@@ -407,15 +517,17 @@ libpqGetFile(const char *filename, size_t *filesize)
 /*
  * Write a file range to a temporary table in the server.
  *
- * The range is sent to the server as a COPY formatted line, to be inserted
- * into the 'fetchchunks' temporary table. It is used in receiveFileChunks()
- * function to actually fetch the data.
+ * The range is sent to the server over fetch connection connno as a COPY
+ * formatted line, to be inserted into the 'fetchchunks' temporary table. It
+ * is used in receiveFileChunks() function to actually fetch the data.
  */
 static void
-fetch_file_range(const char *path, uint64 begin, uint64 end)
+fetch_file_range(int connno, const char *path, uint64 begin, uint64 end)
 {
 	char		linebuf[MAXPGPATH + 23];
 
+	fetchqueued[connno] += end - begin;
+
 	/* Split the range into CHUNKSIZE chunks */
 	while (end - begin > 0)
 	{
@@ -429,9 +541,9 @@ fetch_file_range(const char *path, uint64 begin, uint64 end)
 
 		snprintf(linebuf, sizeof(linebuf), "%s\t" UINT64_FORMAT "\t%u\n", path, begin, len);
 
-		if (PQputCopyData(conn, linebuf, strlen(linebuf)) != 1)
+		if (PQputCopyData(fetchconns[connno], linebuf, strlen(linebuf)) != 1)
 			pg_fatal("could not send COPY data: %s",
-					 PQerrorMessage(conn));
+					 PQerrorMessage(fetchconns[connno]));
 
 		begin += len;
 	}
@@ -449,26 +561,43 @@ libpq_executeFileMap(filemap_t *map)
 	int			i;
 
 	/*
-	 * First create a temporary table, and load it with the blocks that we
-	 * need to fetch.
+	 * First create a temporary table on each fetch connection, and load them
+	 * with the blocks that we need to fetch.
 	 */
-	sql = "CREATE TEMPORARY TABLE fetchchunks(path text, begin int8, len int4);";
-	run_simple_command(sql);
+	for (i = 0; i < nfetchconns; i++)
+	{
+		sql = "CREATE TEMPORARY TABLE fetchchunks(path text, begin int8, len int4);";
+		run_simple_command(fetchconns[i], sql);
 
-	sql = "COPY fetchchunks FROM STDIN";
-	res = PQexec(conn, sql);
+		sql = "COPY fetchchunks FROM STDIN";
+		res = PQexec(fetchconns[i], sql);
 
-	if (PQresultStatus(res) != PGRES_COPY_IN)
-		pg_fatal("could not send file list: %s",
-				 PQresultErrorMessage(res));
-	PQclear(res);
+		if (PQresultStatus(res) != PGRES_COPY_IN)
+			pg_fatal("could not send file list: %s",
+					 PQresultErrorMessage(res));
+		PQclear(res);
+	}
 
 	for (i = 0; i < map->narray; i++)
 	{
+		int			connno = 0;
+		int			j;
+
 		entry = map->array[i];
 
+		/*
+		 * All the ranges of a file are fetched over the same connection, the
+		 * one with the least data to fetch so far.  That keeps the writes to
+		 * each file together.
+		 */
+		for (j = 1; j < nfetchconns; j++)
+		{
+			if (fetchqueued[j] < fetchqueued[connno])
+				connno = j;
+		}
+
 		/* If this is a relation file, copy the modified blocks */
-		execute_pagemap(&entry->pagemap, entry->path);
+		execute_pagemap(connno, &entry->pagemap, entry->path);
 
 		switch (entry->action)
 		{
@@ -479,7 +608,7 @@ libpq_executeFileMap(filemap_t *map)
 			case FILE_ACTION_COPY:
 				/* Truncate the old file out of the way, if any */
 				open_target_file(entry->path, true);
-				fetch_file_range(entry->path, 0, entry->newsize);
+				fetch_file_range(connno, entry->path, 0, entry->newsize);
 				break;
 
 			case FILE_ACTION_TRUNCATE:
@@ -487,7 +616,8 @@ libpq_executeFileMap(filemap_t *map)
 				break;
 
 			case FILE_ACTION_COPY_TAIL:
-				fetch_file_range(entry->path, entry->oldsize, entry->newsize);
+				fetch_file_range(connno, entry->path, entry->oldsize,
+								 entry->newsize);
 				break;
 
 			case FILE_ACTION_REMOVE:
@@ -500,16 +630,19 @@ libpq_executeFileMap(filemap_t *map)
 		}
 	}
 
-	if (PQputCopyEnd(conn, NULL) != 1)
-		pg_fatal("could not send end-of-COPY: %s",
-				 PQerrorMessage(conn));
-
-	while ((res = PQgetResult(conn)) != NULL)
+	for (i = 0; i < nfetchconns; i++)
 	{
-		if (PQresultStatus(res) != PGRES_COMMAND_OK)
-			pg_fatal("unexpected result while sending file list: %s",
-					 PQresultErrorMessage(res));
-		PQclear(res);
+		if (PQputCopyEnd(fetchconns[i], NULL) != 1)
+			pg_fatal("could not send end-of-COPY: %s",
+					 PQerrorMessage(fetchconns[i]));
+
+		while ((res = PQgetResult(fetchconns[i])) != NULL)
+		{
+			if (PQresultStatus(res) != PGRES_COMMAND_OK)
+				pg_fatal("unexpected result while sending file list: %s",
+						 PQresultErrorMessage(res));
+			PQclear(res);
+		}
 	}
 
 	/*
@@ -525,18 +658,33 @@ libpq_executeFileMap(filemap_t *map)
 }
 
 static void
-execute_pagemap(datapagemap_t *pagemap, const char *path)
+execute_pagemap(int connno, datapagemap_t *pagemap, const char *path)
 {
 	datapagemap_iterator_t *iter;
 	BlockNumber blkno;
-	off_t		offset;
+	BlockNumber start = InvalidBlockNumber;
+	BlockNumber end = InvalidBlockNumber;
 
+	/*
+	 * The blocks come in order.  Fetch each run of consecutive blocks as one
+	 * range, which fetch_file_range() splits into CHUNKSIZE pieces.
+	 */
 	iter = datapagemap_iterate(pagemap);
 	while (datapagemap_next(iter, &blkno))
 	{
-		offset = blkno * BLCKSZ;
-
-		fetch_file_range(path, offset, offset + BLCKSZ);
+		if (start != InvalidBlockNumber && blkno == end)
+		{
+			end++;
+			continue;
+		}
+		if (start != InvalidBlockNumber)
+			fetch_file_range(connno, path, (uint64) start * BLCKSZ,
+							 (uint64) end * BLCKSZ);
+		start = blkno;
+		end = blkno + 1;
 	}
+	if (start != InvalidBlockNumber)
+		fetch_file_range(connno, path, (uint64) start * BLCKSZ,
+						 (uint64) end * BLCKSZ);
 	pg_free(iter);
 }
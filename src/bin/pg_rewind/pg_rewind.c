@@ -55,6 +55,7 @@ char	   *connstr_source = NULL;
 static bool debug = false;
 bool		showprogress = false;
 bool		dry_run = false;
+int			num_jobs = 1;
 bool		do_sync = true;
 
 /* Target history */
@@ -75,6 +76,8 @@ usage(const char *progname)
 	printf(_("  -D, --target-pgdata=DIRECTORY  existing data directory to modify\n"));
 	printf(_("      --source-pgdata=DIRECTORY  source data directory to synchronize with\n"));
 	printf(_("      --source-server=CONNSTR    source server to synchronize with\n"));
+	printf(_("  -j, --jobs=NUM                 use this many parallel connections to\n"
+			 "                                 fetch from the source server\n"));
 	printf(_("  -n, --dry-run                  stop before modifying anything\n"));
 	printf(_("  -N, --no-sync                  do not wait for changes to be written\n"
 			 "                                 safely to disk\n"));
@@ -96,6 +99,7 @@ main(int argc, char **argv)
 		{"source-server", required_argument, NULL, 2},
 		{"version", no_argument, NULL, 'V'},
 		{"dry-run", no_argument, NULL, 'n'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"no-sync", no_argument, NULL, 'N'},
 		{"progress", no_argument, NULL, 'P'},
 		{"debug", no_argument, NULL, 3},
@@ -134,7 +138,7 @@ main(int argc, char **argv)
 		}
 	}
 
-	while ((c = getopt_long(argc, argv, "D:nNP", long_options, &option_index)) != -1)
+	while ((c = getopt_long(argc, argv, "D:j:nNP", long_options, &option_index)) != -1)
 	{
 		switch (c)
 		{
@@ -150,6 +154,15 @@ main(int argc, char **argv)
 				dry_run = true;
 				break;
 
+			case 'j':
+				num_jobs = atoi(optarg);
+				if (num_jobs <= 0)
+				{
+					pg_log_error("number of parallel jobs must be at least 1");
+					exit(1);
+				}
+				break;
+
 			case 'N':
 				do_sync = false;
 				break;
@@ -186,6 +199,13 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (num_jobs > 1 && connstr_source == NULL)
+	{
+		pg_log_error("--jobs can only be used with --source-server");
+		fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
+		exit(1);
+	}
+
 	if (datadir_target == NULL)
 	{
 		pg_log_error("no target data directory specified (--target-pgdata)");
@@ -310,7 +330,7 @@ main(int argc, char **argv)
 	/*
 	 * Build the filemap, by comparing the source and target data directories.
 	 */
-	filemap_create();
+	filemap_create(chkptredo);
 	if (showprogress)
 		pg_log_info("reading source file list");
 	fetchSourceFileList();
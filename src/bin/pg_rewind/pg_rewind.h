@@ -25,6 +25,7 @@ extern char *datadir_source;
 extern char *connstr_source;
 extern bool showprogress;
 extern bool dry_run;
+extern int	num_jobs;
 extern int	WalSegSz;
 
 /* Target history */
@@ -270,6 +270,19 @@ sub run_pg_rewind
 			],
 			'pg_rewind remote');
 	}
+	elsif ($test_mode eq "parallel")
+	{
+
+		# Do rewind using several remote connections as source
+		command_ok(
+			[
+				'pg_rewind',                      "--debug",
+				"--source-server",                $standby_connstr,
+				"--target-pgdata=$master_pgdata", "--no-sync",
+				"--jobs=3"
+			],
+			'pg_rewind parallel');
+	}
 	else
 	{
 
@@ -14,7 +14,7 @@ static const char *progname;
 static int32 test_duration = 3;
 
 static void handle_args(int argc, char *argv[]);
-static uint64 test_timing(int32);
+static uint64 test_timing(int32 duration, bool fast);
 static void output(uint64 loop_count);
 
 /* record duration in powers of 2 microseconds */
@@ -30,10 +30,27 @@ main(int argc, char *argv[])
 
 	handle_args(argc, argv);
 
-	loop_count = test_timing(test_duration);
+	loop_count = test_timing(test_duration, false);
 
 	output(loop_count);
 
+	/*
+	 * If the fast clock used for EXPLAIN ANALYZE node timing is available,
+	 * run the same test against it, which also checks its calibration.
+	 */
+	if (pg_initialize_fast_clock())
+	{
+		printf(ngettext("\nTesting fast clock (timestamp counter) overhead for %d second.\n",
+						"\nTesting fast clock (timestamp counter) overhead for %d seconds.\n",
+						test_duration),
+			   test_duration);
+		memset(histogram, 0, sizeof(histogram));
+		loop_count = test_timing(test_duration, true);
+		output(loop_count);
+	}
+	else
+		printf(_("\nFast clock not available, node timing will use the system clock.\n"));
+
 	return 0;
 }
 
@@ -108,7 +125,7 @@ handle_args(int argc, char *argv[])
 }
 
 static uint64
-test_timing(int32 duration)
+test_timing(int32 duration, bool fast)
 {
 	uint64		total_time;
 	int64		time_elapsed = 0;
@@ -117,11 +134,17 @@ test_timing(int32 duration)
 				cur;
 	instr_time	start_time,
 				end_time,
-				temp;
+				temp,
+				sys_start_time,
+				sys_end_time;
 
 	total_time = duration > 0 ? duration * INT64CONST(1000000) : 0;
 
-	INSTR_TIME_SET_CURRENT(start_time);
+	INSTR_TIME_SET_CURRENT(sys_start_time);
+	if (fast)
+		INSTR_TIME_SET_CURRENT_FAST(start_time);
+	else
+		INSTR_TIME_SET_CURRENT(start_time);
 	cur = INSTR_TIME_GET_MICROSEC(start_time);
 
 	while (time_elapsed < total_time)
@@ -130,7 +153,10 @@ test_timing(int32 duration)
 					bits = 0;
 
 		prev = cur;
-		INSTR_TIME_SET_CURRENT(temp);
+		if (fast)
+			INSTR_TIME_SET_CURRENT_FAST(temp);
+		else
+			INSTR_TIME_SET_CURRENT(temp);
 		cur = INSTR_TIME_GET_MICROSEC(temp);
 		diff = cur - prev;
 
@@ -157,13 +183,31 @@ test_timing(int32 duration)
 		time_elapsed = INSTR_TIME_GET_MICROSEC(temp);
 	}
 
-	INSTR_TIME_SET_CURRENT(end_time);
+	if (fast)
+		INSTR_TIME_SET_CURRENT_FAST(end_time);
+	else
+		INSTR_TIME_SET_CURRENT(end_time);
+	INSTR_TIME_SET_CURRENT(sys_end_time);
 
 	INSTR_TIME_SUBTRACT(end_time, start_time);
+	INSTR_TIME_SUBTRACT(sys_end_time, sys_start_time);
 
 	printf(_("Per loop time including overhead: %0.2f ns\n"),
 		   INSTR_TIME_GET_DOUBLE(end_time) * 1e9 / loop_count);
 
+	/* Check that the fast clock agrees with the system clock */
+	if (fast)
+	{
+		double		fast_secs = INSTR_TIME_GET_DOUBLE(end_time);
+		double		sys_secs = INSTR_TIME_GET_DOUBLE(sys_end_time);
+		double		skew = (fast_secs - sys_secs) * 100.0 / sys_secs;
+
+		printf(_("Fast clock measured %0.6f s, system clock %0.6f s (%+0.4f%%)\n"),
+			   fast_secs, sys_secs, skew);
+		if (skew > 1.0 || skew < -1.0)
+			fprintf(stderr, _("Fast clock is not calibrated correctly; node timings will be inaccurate.\n"));
+	}
+
 	return loop_count;
 }
 
@@ -36,11 +36,8 @@ typedef struct
 
 typedef struct
 {
-	DbInfoArr  *old_db_arr;
-	DbInfoArr  *new_db_arr;
-	char	   *old_pgdata;
-	char	   *new_pgdata;
-	char	   *old_tablespace;
+	FileNameMap *maps;
+	int			size;
 } transfer_thread_arg;
 
 exec_thread_arg **exec_thread_args;
@@ -50,7 +47,7 @@ transfer_thread_arg **transfer_thread_args;
 void	  **cur_thread_args;
 
 DWORD		win32_exec_prog(exec_thread_arg *args);
-DWORD		win32_transfer_all_new_dbs(transfer_thread_arg *args);
+DWORD		win32_transfer_file_maps(transfer_thread_arg *args);
 #endif
 
 /*
@@ -169,15 +166,13 @@ win32_exec_prog(exec_thread_arg *args)
 
 
 /*
- *	parallel_transfer_all_new_dbs
+ *	parallel_transfer_file_maps
  *
- *	This has the same API as transfer_all_new_dbs, except it does parallel execution
- *	by transferring multiple tablespaces in parallel
+ *	This has the same API as transfer_file_maps, except it does parallel
+ *	execution, by transferring each given array of mappings in a worker
  */
 void
-parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-							  char *old_pgdata, char *new_pgdata,
-							  char *old_tablespace)
+parallel_transfer_file_maps(FileNameMap *maps, int size)
 {
 #ifndef WIN32
 	pid_t		child;
@@ -187,7 +182,7 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 #endif
 
 	if (user_opts.jobs <= 1)
-		transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata, new_pgdata, NULL);
+		transfer_file_maps(maps, size);
 	else
 	{
 		/* parallel */
@@ -230,8 +225,7 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 		child = fork();
 		if (child == 0)
 		{
-			transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata, new_pgdata,
-								 old_tablespace);
+			transfer_file_maps(maps, size);
 			/* if we take another exit path, it will be non-zero */
 			/* use _exit to skip atexit() functions */
 			_exit(0);
@@ -243,20 +237,14 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 		/* empty array element are always at the end */
 		new_arg = transfer_thread_args[parallel_jobs - 1];
 
-		/* Can only pass one pointer into the function, so use a struct */
-		new_arg->old_db_arr = old_db_arr;
-		new_arg->new_db_arr = new_db_arr;
-		if (new_arg->old_pgdata)
-			pg_free(new_arg->old_pgdata);
-		new_arg->old_pgdata = pg_strdup(old_pgdata);
-		if (new_arg->new_pgdata)
-			pg_free(new_arg->new_pgdata);
-		new_arg->new_pgdata = pg_strdup(new_pgdata);
-		if (new_arg->old_tablespace)
-			pg_free(new_arg->old_tablespace);
-		new_arg->old_tablespace = old_tablespace ? pg_strdup(old_tablespace) : NULL;
-
-		child = (HANDLE) _beginthreadex(NULL, 0, (void *) win32_transfer_all_new_dbs,
+		/*
+		 * Can only pass one pointer into the function, so use a struct.  The
+		 * caller keeps the mappings until all workers are done.
+		 */
+		new_arg->maps = maps;
+		new_arg->size = size;
+
+		child = (HANDLE) _beginthreadex(NULL, 0, (void *) win32_transfer_file_maps,
 										new_arg, 0, NULL);
 		if (child == 0)
 			pg_fatal("could not create worker thread: %s\n", strerror(errno));
@@ -271,10 +259,9 @@ parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 
 #ifdef WIN32
 DWORD
-win32_transfer_all_new_dbs(transfer_thread_arg *args)
+win32_transfer_file_maps(transfer_thread_arg *args)
 {
-	transfer_all_new_dbs(args->old_db_arr, args->new_db_arr, args->old_pgdata,
-						 args->new_pgdata, args->old_tablespace);
+	transfer_file_maps(args->maps, args->size);
 
 	/* terminates thread */
 	return 0;
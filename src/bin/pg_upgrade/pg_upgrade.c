@@ -48,6 +48,13 @@
 #include <langinfo.h>
 #endif
 
+/*
+ * Number of objects pg_restore creates per transaction when restoring the
+ * schemas.  It is divided among the jobs, since the locks held by all of
+ * them share the new server's lock table.
+ */
+#define RESTORE_TRANSACTION_SIZE	1000
+
 static void prepare_new_cluster(void);
 static void prepare_new_globals(void);
 static void create_new_objects(void);
@@ -314,9 +321,18 @@ static void
 create_new_objects(void)
 {
 	int			dbnum;
+	int			txn_size;
+	double		total_rels = 0;
 
 	prep_status("Restoring database schemas in the new cluster\n");
 
+	txn_size = RESTORE_TRANSACTION_SIZE;
+	if (user_opts.jobs > 1)
+		txn_size = Max(txn_size / user_opts.jobs, 10);
+
+	for (dbnum = 0; dbnum < old_cluster.dbarr.ndbs; dbnum++)
+		total_rels += old_cluster.dbarr.dbs[dbnum].rel_arr.nrels;
+
 	/*
 	 * We cannot process the template1 database concurrently with others,
 	 * because when it's transiently dropped, connection attempts would fail.
@@ -350,10 +366,11 @@ create_new_objects(void)
 				  true,
 				  true,
 				  "\"%s/pg_restore\" %s %s --exit-on-error --verbose "
-				  "--dbname postgres \"%s\"",
+				  "--transaction-size=%d --dbname postgres \"%s\"",
 				  new_cluster.bindir,
 				  cluster_conn_opts(&new_cluster),
 				  create_opts,
+				  txn_size,
 				  sql_file_name);
 
 		break;					/* done once we've processed template1 */
@@ -365,6 +382,7 @@ create_new_objects(void)
 					log_file_name[MAXPGPATH];
 		DbInfo	   *old_db = &old_cluster.dbarr.dbs[dbnum];
 		const char *create_opts;
+		int			restore_jobs = 1;
 
 		/* Skip template1 in this pass */
 		if (strcmp(old_db->db_name, "template1") == 0)
@@ -385,13 +403,26 @@ create_new_objects(void)
 		else
 			create_opts = "--create";
 
+		/*
+		 * Restoring the databases concurrently doesn't help if one database
+		 * holds most of the relations, so also give each database a share of
+		 * the jobs for a parallel pg_restore, in proportion to its number of
+		 * relations.
+		 */
+		if (user_opts.jobs > 1 && total_rels > 0)
+			restore_jobs = Max((int) (user_opts.jobs *
+									  old_db->rel_arr.nrels / total_rels), 1);
+
 		parallel_exec_prog(log_file_name,
 						   NULL,
 						   "\"%s/pg_restore\" %s %s --exit-on-error --verbose "
+						   "--transaction-size=%d --jobs=%d "
 						   "--dbname template1 \"%s\"",
 						   new_cluster.bindir,
 						   cluster_conn_opts(&new_cluster),
 						   create_opts,
+						   txn_size,
+						   restore_jobs,
 						   sql_file_name);
 	}
 
@@ -413,8 +413,8 @@ void		get_sock_dir(ClusterInfo *cluster, bool live_check);
 void		transfer_all_new_tablespaces(DbInfoArr *old_db_arr,
 										 DbInfoArr *new_db_arr, char *old_pgdata, char *new_pgdata);
 void		transfer_all_new_dbs(DbInfoArr *old_db_arr,
-								 DbInfoArr *new_db_arr, char *old_pgdata, char *new_pgdata,
-								 char *old_tablespace);
+								 DbInfoArr *new_db_arr, char *old_pgdata, char *new_pgdata);
+void		transfer_file_maps(FileNameMap *maps, int size);
 
 /* tablespace.c */
 
@@ -461,7 +461,5 @@ void		old_9_6_invalidate_hash_indexes(ClusterInfo *cluster,
 /* parallel.c */
 void		parallel_exec_prog(const char *log_file, const char *opt_log_file,
 							   const char *fmt,...) pg_attribute_printf(3, 4);
-void		parallel_transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-										  char *old_pgdata, char *new_pgdata,
-										  char *old_tablespace);
+void		parallel_transfer_file_maps(FileNameMap *maps, int size);
 bool		reap_child(bool wait_for_child);
@@ -16,7 +16,12 @@
 #include "access/transam.h"
 
 
-static void transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace);
+/*
+ * In parallel mode, the relations of each database are split into chunks
+ * transferred by separate jobs, but no chunk is made smaller than this.
+ */
+#define MIN_TRANSFER_CHUNK	1000
+
 static void transfer_relfile(FileNameMap *map, const char *suffix, bool vm_must_add_frozenbit);
 
 
@@ -43,34 +48,7 @@ transfer_all_new_tablespaces(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 			break;
 	}
 
-	/*
-	 * Transferring files by tablespace is tricky because a single database
-	 * can use multiple tablespaces.  For non-parallel mode, we just pass a
-	 * NULL tablespace path, which matches all tablespaces.  In parallel mode,
-	 * we pass the default tablespace and all user-created tablespaces and let
-	 * those operations happen in parallel.
-	 */
-	if (user_opts.jobs <= 1)
-		parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
-									  new_pgdata, NULL);
-	else
-	{
-		int			tblnum;
-
-		/* transfer default tablespace */
-		parallel_transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata,
-									  new_pgdata, old_pgdata);
-
-		for (tblnum = 0; tblnum < os_info.num_old_tablespaces; tblnum++)
-			parallel_transfer_all_new_dbs(old_db_arr,
-										  new_db_arr,
-										  old_pgdata,
-										  new_pgdata,
-										  os_info.old_tablespaces[tblnum]);
-		/* reap all children */
-		while (reap_child(true) == true)
-			;
-	}
+	transfer_all_new_dbs(old_db_arr, new_db_arr, old_pgdata, new_pgdata);
 
 	end_progress_output();
 	check_ok();
@@ -84,13 +62,22 @@ transfer_all_new_tablespaces(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
  *
  * Responsible for upgrading all database. invokes routines to generate mappings and then
  * physically link the databases.
+ *
+ * In parallel mode, the relations of each database are divided among the
+ * jobs, so a single database with very many relations is transferred as fast
+ * as many small ones.  This also spreads the work over all tablespaces.
  */
 void
 transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
-					 char *old_pgdata, char *new_pgdata, char *old_tablespace)
+					 char *old_pgdata, char *new_pgdata)
 {
 	int			old_dbnum,
 				new_dbnum;
+	FileNameMap **db_mappings;
+
+	/* the mappings must stay around until all jobs are done with them */
+	db_mappings = (FileNameMap **) pg_malloc(sizeof(FileNameMap *) *
+											 old_db_arr->ndbs);
 
 	/* Scan the old cluster databases and transfer their files */
 	for (old_dbnum = new_dbnum = 0;
@@ -122,24 +109,39 @@ transfer_all_new_dbs(DbInfoArr *old_db_arr, DbInfoArr *new_db_arr,
 									new_pgdata);
 		if (n_maps)
 		{
+			int			chunk = n_maps;
+			int			mapnum;
+
 			print_maps(mappings, n_maps, new_db->db_name);
 
-			transfer_single_new_db(mappings, n_maps, old_tablespace);
+			if (user_opts.jobs > 1)
+				chunk = Max((n_maps + user_opts.jobs - 1) / user_opts.jobs,
+							MIN_TRANSFER_CHUNK);
+
+			for (mapnum = 0; mapnum < n_maps; mapnum += chunk)
+				parallel_transfer_file_maps(&mappings[mapnum],
+											Min(chunk, n_maps - mapnum));
 		}
 		/* We allocate something even for n_maps == 0 */
-		pg_free(mappings);
+		db_mappings[old_dbnum] = mappings;
 	}
 
-	return;
+	/* reap all children */
+	while (reap_child(true) == true)
+		;
+
+	for (old_dbnum = 0; old_dbnum < old_db_arr->ndbs; old_dbnum++)
+		pg_free(db_mappings[old_dbnum]);
+	pg_free(db_mappings);
 }
 
 /*
- * transfer_single_new_db()
+ * transfer_file_maps()
  *
  * create links for mappings stored in "maps" array.
  */
-static void
-transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
+void
+transfer_file_maps(FileNameMap *maps, int size)
 {
 	int			mapnum;
 	bool		vm_crashsafe_match = true;
@@ -162,22 +164,18 @@ transfer_single_new_db(FileNameMap *maps, int size, char *old_tablespace)
 
 	for (mapnum = 0; mapnum < size; mapnum++)
 	{
-		if (old_tablespace == NULL ||
-			strcmp(maps[mapnum].old_tablespace, old_tablespace) == 0)
-		{
-			/* transfer primary file */
-			transfer_relfile(&maps[mapnum], "", vm_must_add_frozenbit);
+		/* transfer primary file */
+		transfer_relfile(&maps[mapnum], "", vm_must_add_frozenbit);
 
-			/* fsm/vm files added in PG 8.4 */
-			if (GET_MAJOR_VERSION(old_cluster.major_version) >= 804)
-			{
-				/*
-				 * Copy/link any fsm and vm files, if they exist
-				 */
-				transfer_relfile(&maps[mapnum], "_fsm", vm_must_add_frozenbit);
-				if (vm_crashsafe_match)
-					transfer_relfile(&maps[mapnum], "_vm", vm_must_add_frozenbit);
-			}
+		/* fsm/vm files added in PG 8.4 */
+		if (GET_MAJOR_VERSION(old_cluster.major_version) >= 804)
+		{
+			/*
+			 * Copy/link any fsm and vm files, if they exist
+			 */
+			transfer_relfile(&maps[mapnum], "_fsm", vm_must_add_frozenbit);
+			if (vm_crashsafe_match)
+				transfer_relfile(&maps[mapnum], "_vm", vm_must_add_frozenbit);
 		}
 	}
 }
@@ -469,6 +469,22 @@ XLogDumpRecordLen(XLogReaderState *record, uint32 *rec_len, uint32 *fpi_len)
 			*fpi_len += record->blocks[block_id].bimg_len;
 	}
 
+	/*
+	 * If the whole record was compressed, the block images were compressed
+	 * along with the rest, and we can't tell how much space they take.
+	 * Count the images as if they compressed as well as the whole record.
+	 */
+	if (XLogRecGetInfo(record) & XLR_COMPRESSED)
+	{
+		uint32		rawlen;
+
+		memcpy(&rawlen, (char *) record->decoded_record + SizeOfXLogRecord,
+			   sizeof(uint32));
+		*fpi_len = (uint32) ((uint64) *fpi_len *
+							 (XLogRecGetTotalLen(record) - SizeOfXLogRecord) /
+							 rawlen);
+	}
+
 	/*
 	 * Calculate the length of the record as the total length - the length of
 	 * all the block images.
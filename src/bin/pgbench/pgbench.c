@@ -37,6 +37,7 @@
 #include "fe_utils/conditional.h"
 #include "getopt_long.h"
 #include "libpq-fe.h"
+#include "port/pg_bitutils.h"
 #include "portability/instr_time.h"
 
 #include <ctype.h>
@@ -161,6 +162,17 @@ int			fillfactor = 100;
  */
 bool		unlogged_tables = false;
 
+/*
+ * number of partitions of pgbench_accounts, or 0 to not partition it
+ */
+int			partitions = 0;
+
+/*
+ * number of connections used to generate pgbench_accounts' rows on the server
+ * side (initialization step G)
+ */
+int			init_jobs = 1;
+
 /*
  * log sampling rate (1.0 = log everything, 0.0 = option not given)
  */
@@ -218,6 +230,9 @@ int			nclients = 1;		/* number of clients */
 int			nthreads = 1;		/* number of threads */
 bool		is_connect;			/* establish connection for each transaction */
 bool		report_per_command; /* report per-command latencies */
+bool		latency_percentiles = false;	/* report latency percentiles */
+bool		latency_hist = false;	/* collect latency histograms */
+char	   *json_report = NULL; /* write results to this file as JSON */
 int			main_pid;			/* main process id used in log filename */
 
 char	   *pghost = "";
@@ -266,6 +281,28 @@ typedef struct SimpleStats
 	double		sum2;			/* sum of squared values */
 } SimpleStats;
 
+/*
+ * Histogram of latencies in microseconds, kept under --latency-percentiles.
+ *
+ * The buckets are log-linear, as in HDR histograms: each value below
+ * LATENCY_HIST_SUB_BUCKETS has a bucket of its own, and each following
+ * power-of-two range is split into LATENCY_HIST_SUB_BUCKETS equal buckets, so
+ * a percentile is reported within about 1.5% of its actual value.  Values
+ * of 2^LATENCY_HIST_MAX_BITS microseconds (about 19 hours) and more all fall
+ * into the last bucket.
+ */
+#define LATENCY_HIST_SUB_BITS		6
+#define LATENCY_HIST_SUB_BUCKETS	(1 << LATENCY_HIST_SUB_BITS)
+#define LATENCY_HIST_MAX_BITS		36
+#define LATENCY_HIST_BUCKETS \
+	(LATENCY_HIST_SUB_BUCKETS * (LATENCY_HIST_MAX_BITS - LATENCY_HIST_SUB_BITS + 1))
+
+typedef struct LatencyHist
+{
+	int64		count;			/* how many values were encountered */
+	int64		buckets[LATENCY_HIST_BUCKETS];
+} LatencyHist;
+
 /*
  * Data structure to hold various statistics: per-thread and per-script stats
  * are maintained and merged together.
@@ -278,6 +315,7 @@ typedef struct StatsData
 								 * and --latency-limit */
 	SimpleStats latency;
 	SimpleStats lag;
+	LatencyHist latency_hist;	/* only filled under --latency-percentiles */
 } StatsData;
 
 /*
@@ -437,6 +475,9 @@ typedef struct
 	instr_time	conn_time;
 	StatsData	stats;
 	int64		latency_late;	/* executed but late transactions */
+	int64	   *xacts_per_sec;	/* transactions finished in each second since
+								 * start_time, under --json-report */
+	int			nsecs;			/* allocated length of xacts_per_sec[] */
 } TState;
 
 #define INVALID_THREAD		((pthread_t) 0)
@@ -464,7 +505,9 @@ typedef enum MetaCommand
 	META_IF,					/* \if */
 	META_ELIF,					/* \elif */
 	META_ELSE,					/* \else */
-	META_ENDIF					/* \endif */
+	META_ENDIF,					/* \endif */
+	META_STARTPIPELINE,			/* \startpipeline */
+	META_ENDPIPELINE			/* \endpipeline */
 } MetaCommand;
 
 typedef enum QueryMode
@@ -495,6 +538,8 @@ static const char *QUERYMODE[] = {"simple", "extended", "prepared"};
  *				variable name that receives the value.
  * expr			Parsed expression, if needed.
  * stats		Time spent in this command.
+ * hist			Distribution of the time spent in this command, in
+ *				microseconds, under --latency-percentiles.
  */
 typedef struct Command
 {
@@ -507,6 +552,7 @@ typedef struct Command
 	char	   *varprefix;
 	PgBenchExpr *expr;
 	SimpleStats stats;
+	LatencyHist hist;
 } Command;
 
 typedef struct ParsedScript
@@ -566,6 +612,36 @@ static const BuiltinScript builtin_script[] =
 		"<builtin: select only>",
 		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
 		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+	},
+	{
+		"hot-update",
+		"<builtin: hot row update>",
+		"\\set aid random(1, 10)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid;\n"
+	},
+	{
+		"range-scan",
+		"<builtin: range scan>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"SELECT count(*), sum(abalance), max(filler) FROM pgbench_accounts WHERE aid BETWEEN :aid AND :aid + 9999;\n"
+	},
+	{
+		"subxact",
+		"<builtin: subtransaction overflow>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"BEGIN;\n"
+		"SELECT set_config('pgbench.aid', :aid::text, true);\n"
+		"DO $$ BEGIN FOR i IN 1..70 LOOP BEGIN UPDATE pgbench_accounts SET abalance = abalance + 1 WHERE aid = current_setting('pgbench.aid')::bigint; EXCEPTION WHEN unique_violation THEN NULL; END; END LOOP; END $$;\n"
+		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+		"END;\n"
+	},
+	{
+		"notify",
+		"<builtin: listen/notify>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"LISTEN pgbench_notify;\n"
+		"SELECT pg_notify('pgbench_notify', :aid::text);\n"
 	}
 };
 
@@ -583,6 +659,9 @@ static void doLog(TState *thread, CState *st,
 static void processXactStats(TState *thread, CState *st, instr_time *now,
 							 bool skipped, StatsData *agg);
 static void addScript(ParsedScript script);
+static void writeJsonReport(StatsData *total, instr_time total_time,
+							instr_time conn_total_time, int64 latency_late,
+							TState *threads);
 static void *threadRun(void *arg);
 static void finishCon(CState *st);
 static void setalarm(int seconds);
@@ -608,7 +687,7 @@ usage(void)
 		   "  %s [OPTION]... [DBNAME]\n"
 		   "\nInitialization options:\n"
 		   "  -i, --initialize         invokes initialization mode\n"
-		   "  -I, --init-steps=[dtgvpf]+ (default \"dtgvp\")\n"
+		   "  -I, --init-steps=[dtgGvpf]+ (default \"dtgvp\")\n"
 		   "                           run selected initialization steps\n"
 		   "  -F, --fillfactor=NUM     set fill factor\n"
 		   "  -n, --no-vacuum          do not run VACUUM during initialization\n"
@@ -617,6 +696,8 @@ usage(void)
 		   "  --foreign-keys           create foreign key constraints between tables\n"
 		   "  --index-tablespace=TABLESPACE\n"
 		   "                           create indexes in the specified tablespace\n"
+		   "  --init-jobs=NUM          number of connections generating data in step G\n"
+		   "  --partitions=NUM         partition pgbench_accounts into NUM parts\n"
 		   "  --tablespace=TABLESPACE  create tables in the specified tablespace\n"
 		   "  --unlogged-tables        create tables as unlogged tables\n"
 		   "\nOptions to select what to run:\n"
@@ -646,6 +727,8 @@ usage(void)
 		   "  -T, --time=NUM           duration of benchmark test in seconds\n"
 		   "  -v, --vacuum-all         vacuum all four standard tables before tests\n"
 		   "  --aggregate-interval=NUM aggregate data over NUM seconds\n"
+		   "  --json-report=FILENAME   write results to FILENAME in JSON format\n"
+		   "  --latency-percentiles    report p50, p99 and p99.9 latencies\n"
 		   "  --log-prefix=PREFIX      prefix for transaction time log file\n"
 		   "                           (default: \"pgbench_log\")\n"
 		   "  --progress-timestamp     use Unix epoch timestamps for progress\n"
@@ -1078,6 +1161,115 @@ mergeSimpleStats(SimpleStats *acc, SimpleStats *ss)
 	acc->sum2 += ss->sum2;
 }
 
+/*
+ * Initialize the given LatencyHist struct to all zeroes
+ */
+static void
+initLatencyHist(LatencyHist *hist)
+{
+	memset(hist, 0, sizeof(LatencyHist));
+}
+
+/*
+ * Accumulate one latency, in microseconds, into a LatencyHist struct.
+ */
+static void
+addToLatencyHist(LatencyHist *hist, double usec)
+{
+	uint64		val = usec > 0 ? (uint64) usec : 0;
+	int			bucket;
+
+	if (val < LATENCY_HIST_SUB_BUCKETS)
+		bucket = (int) val;
+	else
+	{
+		int			shift;
+
+		/* the top LATENCY_HIST_SUB_BITS + 1 bits select the bucket */
+		shift = pg_leftmost_one_pos64(val) - LATENCY_HIST_SUB_BITS;
+		bucket = (shift + 1) * LATENCY_HIST_SUB_BUCKETS +
+			(int) (val >> shift) - LATENCY_HIST_SUB_BUCKETS;
+		if (bucket >= LATENCY_HIST_BUCKETS)
+			bucket = LATENCY_HIST_BUCKETS - 1;
+	}
+
+	hist->buckets[bucket]++;
+	hist->count++;
+}
+
+/*
+ * Merge two LatencyHist objects
+ */
+static void
+mergeLatencyHist(LatencyHist *acc, LatencyHist *hist)
+{
+	acc->count += hist->count;
+	for (int i = 0; i < LATENCY_HIST_BUCKETS; i++)
+		acc->buckets[i] += hist->buckets[i];
+}
+
+/*
+ * Return the latency, in microseconds, that the given fraction of the values
+ * in a LatencyHist do not exceed.  This is the middle of the bucket holding
+ * the percentile, or zero if the histogram is empty.
+ */
+static double
+getLatencyHistPercentile(LatencyHist *hist, double fraction)
+{
+	int64		target;
+	int64		seen = 0;
+	int			bucket;
+	int			shift;
+
+	if (hist->count == 0)
+		return 0.0;
+
+	target = (int64) ceil(fraction * hist->count);
+	for (bucket = 0; bucket < LATENCY_HIST_BUCKETS - 1; bucket++)
+	{
+		seen += hist->buckets[bucket];
+		if (seen >= target)
+			break;
+	}
+
+	if (bucket < LATENCY_HIST_SUB_BUCKETS)
+		return (double) bucket;
+
+	shift = bucket / LATENCY_HIST_SUB_BUCKETS - 1;
+	return (double) (((uint64) (bucket % LATENCY_HIST_SUB_BUCKETS +
+								LATENCY_HIST_SUB_BUCKETS)) << shift) +
+		(double) ((uint64) 1 << shift) / 2;
+}
+
+/*
+ * Count a transaction finished at "now" in the thread's per-second
+ * transaction counts, for --json-report.
+ */
+static void
+countXactPerSecond(TState *thread, instr_time *now)
+{
+	int64		sec = (INSTR_TIME_GET_MICROSEC(*now) -
+					   INSTR_TIME_GET_MICROSEC(thread->start_time)) / 1000000;
+
+	if (sec < 0)
+		sec = 0;
+
+	if (sec >= thread->nsecs)
+	{
+		int			newlen = Max(thread->nsecs * 2, 64);
+
+		while (newlen <= sec)
+			newlen *= 2;
+		thread->xacts_per_sec = (int64 *)
+			pg_realloc(thread->xacts_per_sec, sizeof(int64) * newlen);
+		memset(thread->xacts_per_sec + thread->nsecs, 0,
+			   sizeof(int64) * (newlen - thread->nsecs));
+		thread->nsecs = newlen;
+	}
+
+	thread->xacts_per_sec[sec]++;
+}
+
 /*
  * Initialize a StatsData struct to mostly zeroes, with its start time set to
  * the given value.
@@ -1090,6 +1282,7 @@ initStats(StatsData *sd, time_t start_time)
 	sd->skipped = 0;
 	initSimpleStats(&sd->latency);
 	initSimpleStats(&sd->lag);
+	initLatencyHist(&sd->latency_hist);
 }
 
 /*
@@ -1108,6 +1301,8 @@ accumStats(StatsData *stats, bool skipped, double lat, double lag)
 	else
 	{
 		addToSimpleStats(&stats->latency, lat);
+		if (latency_hist)
+			addToLatencyHist(&stats->latency_hist, lat);
 
 		/* and possibly the same for schedule lag */
 		if (throttle_delay)
@@ -2479,6 +2674,10 @@ getMetaCommand(const char *cmd)
 		mc = META_ENDIF;
 	else if (pg_strcasecmp(cmd, "gset") == 0)
 		mc = META_GSET;
+	else if (pg_strcasecmp(cmd, "startpipeline") == 0)
+		mc = META_STARTPIPELINE;
+	else if (pg_strcasecmp(cmd, "endpipeline") == 0)
+		mc = META_ENDPIPELINE;
 	else
 		mc = META_NONE;
 	return mc;
@@ -2626,6 +2825,37 @@ chooseScript(TState *thread)
 	return i - 1;
 }
 
+/*
+ * Prepare all the SQL commands of the client's current script, if not done
+ * yet on this connection.  This is done in one go, with synchronous calls,
+ * so it must happen before entering pipeline mode.
+ */
+static void
+prepareScript(CState *st)
+{
+	int			j;
+	Command   **commands = sql_script[st->use_file].commands;
+
+	if (st->prepared[st->use_file])
+		return;
+
+	for (j = 0; commands[j] != NULL; j++)
+	{
+		PGresult   *res;
+		char		name[MAX_PREPARE_NAME];
+
+		if (commands[j]->type != SQL_COMMAND)
+			continue;
+		preparedStatementName(name, st->use_file, j);
+		res = PQprepare(st->con, name,
+						commands[j]->argv[0], commands[j]->argc - 1, NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			fprintf(stderr, "%s", PQerrorMessage(st->con));
+		PQclear(res);
+	}
+	st->prepared[st->use_file] = true;
+}
+
 /* Send a SQL command, using the chosen querymode */
 static bool
 sendCommand(CState *st, Command *command)
@@ -2661,27 +2891,7 @@ sendCommand(CState *st, Command *command)
 		char		name[MAX_PREPARE_NAME];
 		const char *params[MAX_ARGS];
 
-		if (!st->prepared[st->use_file])
-		{
-			int			j;
-			Command   **commands = sql_script[st->use_file].commands;
-
-			for (j = 0; commands[j] != NULL; j++)
-			{
-				PGresult   *res;
-				char		name[MAX_PREPARE_NAME];
-
-				if (commands[j]->type != SQL_COMMAND)
-					continue;
-				preparedStatementName(name, st->use_file, j);
-				res = PQprepare(st->con, name,
-								commands[j]->argv[0], commands[j]->argc - 1, NULL);
-				if (PQresultStatus(res) != PGRES_COMMAND_OK)
-					fprintf(stderr, "%s", PQerrorMessage(st->con));
-				PQclear(res);
-			}
-			st->prepared[st->use_file] = true;
-		}
+		prepareScript(st);
 
 		getQueryParams(st, command, params);
 		preparedStatementName(name, st->use_file, st->command);
@@ -2712,6 +2922,10 @@ sendCommand(CState *st, Command *command)
  * If varprefix is not NULL, it's the variable name prefix where to store
  * the results of the *last* command.
  *
+ * In pipeline mode, this reads the results of one of the pipelined commands,
+ * or the pipeline's synchronization point, in which case pipeline mode is
+ * exited.
+ *
  * Returns true if everything is A-OK, false if any error occurs.
  */
 static bool
@@ -2719,6 +2933,7 @@ readCommandResponse(CState *st, char *varprefix)
 {
 	PGresult   *res;
 	PGresult   *next_res;
+	PGnotify   *notify;
 	int			qrynum = 0;
 
 	res = PQgetResult(st->con);
@@ -2783,6 +2998,18 @@ readCommandResponse(CState *st, char *varprefix)
 				/* otherwise the result is simply thrown away by PQclear below */
 				break;
 
+			case PGRES_PIPELINE_SYNC:
+				if (debug)
+					fprintf(stderr, "client %d pipeline ending\n", st->id);
+				if (PQexitPipelineMode(st->con) != 1)
+				{
+					fprintf(stderr,
+							"client %d failed to exit pipeline mode: %s",
+							st->id, PQerrorMessage(st->con));
+					goto error;
+				}
+				break;
+
 			default:
 				/* anything else is unexpected */
 				fprintf(stderr,
@@ -2797,6 +3024,10 @@ readCommandResponse(CState *st, char *varprefix)
 		res = next_res;
 	}
 
+	/* throw away notifications received under LISTEN, nobody reads them */
+	while ((notify = PQnotifies(st->con)) != NULL)
+		PQfreemem(notify);
+
 	if (qrynum == 0)
 	{
 		fprintf(stderr, "client %d command %d: no results\n", st->id, st->command);
@@ -3031,6 +3262,13 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 				/* Transition to script end processing if done */
 				if (command == NULL)
 				{
+					if (PQpipelineStatus(st->con) != PQ_PIPELINE_OFF)
+					{
+						commandFailed(st, "endpipeline",
+									  "end of script reached within a pipeline");
+						st->state = CSTATE_ABORTED;
+						break;
+					}
 					st->state = CSTATE_END_TX;
 					break;
 				}
@@ -3045,11 +3283,25 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 				/* Execute the command */
 				if (command->type == SQL_COMMAND)
 				{
-					if (!sendCommand(st, command))
+					bool		in_pipeline;
+
+					in_pipeline = PQpipelineStatus(st->con) != PQ_PIPELINE_OFF;
+					if (in_pipeline && command->varprefix != NULL)
+					{
+						commandFailed(st, "gset",
+									  "\\gset is not allowed in pipeline mode");
+						st->state = CSTATE_ABORTED;
+					}
+					else if (!sendCommand(st, command))
 					{
 						commandFailed(st, "SQL", "SQL command send failed");
 						st->state = CSTATE_ABORTED;
 					}
+					else if (in_pipeline)
+					{
+						/* results are read at \endpipeline */
+						st->state = CSTATE_END_COMMAND;
+					}
 					else
 						st->state = CSTATE_WAIT_RESULT;
 				}
@@ -3059,6 +3311,7 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 					 * Possible state changes when executing meta commands:
 					 * - on errors CSTATE_ABORTED
 					 * - on sleep CSTATE_SLEEP
+					 * - on \endpipeline CSTATE_WAIT_RESULT
 					 * - else CSTATE_END_COMMAND
 					 */
 					st->state = executeMetaCommand(st, &now);
@@ -3188,11 +3441,15 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 				if (PQisBusy(st->con))
 					return;		/* don't have the whole result yet */
 
-				/* store or discard the query results */
-				if (readCommandResponse(st, sql_script[st->use_file].commands[st->command]->varprefix))
-					st->state = CSTATE_END_COMMAND;
-				else
+				/*
+				 * Store or discard the query results.  At \endpipeline, keep
+				 * reading until the pipeline's sync point has been seen and
+				 * pipeline mode has been exited.
+				 */
+				if (!readCommandResponse(st, sql_script[st->use_file].commands[st->command]->varprefix))
 					st->state = CSTATE_ABORTED;
+				else if (PQpipelineStatus(st->con) == PQ_PIPELINE_OFF)
+					st->state = CSTATE_END_COMMAND;
 				break;
 
 				/*
@@ -3230,6 +3487,10 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 					addToSimpleStats(&command->stats,
 									 INSTR_TIME_GET_DOUBLE(now) -
 									 INSTR_TIME_GET_DOUBLE(st->stmt_begin));
+					if (latency_percentiles)
+						addToLatencyHist(&command->hist,
+										 INSTR_TIME_GET_MICROSEC(now) -
+										 INSTR_TIME_GET_MICROSEC(st->stmt_begin));
 				}
 
 				/* Go ahead with next command, to be executed or skipped */
@@ -3427,6 +3688,49 @@ executeMetaCommand(CState *st, instr_time *now)
 			return CSTATE_ABORTED;
 		}
 	}
+	else if (command->meta == META_STARTPIPELINE)
+	{
+		/*
+		 * In pipeline mode, we use a workflow based on libpq pipeline
+		 * functions.
+		 */
+		if (querymode == QUERY_SIMPLE)
+		{
+			commandFailed(st, "startpipeline", "cannot use pipeline mode with the simple query protocol");
+			return CSTATE_ABORTED;
+		}
+
+		if (PQpipelineStatus(st->con) != PQ_PIPELINE_OFF)
+		{
+			commandFailed(st, "startpipeline", "already in pipeline mode");
+			return CSTATE_ABORTED;
+		}
+
+		/* statements cannot be prepared once the pipeline is started */
+		if (querymode == QUERY_PREPARED)
+			prepareScript(st);
+
+		if (PQenterPipelineMode(st->con) == 0)
+		{
+			commandFailed(st, "startpipeline", "failed to enter pipeline mode");
+			return CSTATE_ABORTED;
+		}
+	}
+	else if (command->meta == META_ENDPIPELINE)
+	{
+		if (PQpipelineStatus(st->con) == PQ_PIPELINE_OFF)
+		{
+			commandFailed(st, "endpipeline", "not in pipeline mode");
+			return CSTATE_ABORTED;
+		}
+		if (!PQpipelineSync(st->con))
+		{
+			commandFailed(st, "endpipeline", "failed to send a pipeline sync");
+			return CSTATE_ABORTED;
+		}
+		/* collect the results of all the pipelined commands */
+		return CSTATE_WAIT_RESULT;
+	}
 
 	/*
 	 * executing the expression or shell command might have taken a
@@ -3491,6 +3795,11 @@ doLog(TState *thread, CState *st,
 				if (latency_limit)
 					fprintf(logfile, " " INT64_FORMAT, agg->skipped);
 			}
+			if (latency_percentiles)
+				fprintf(logfile, " %.0f %.0f %.0f",
+						getLatencyHistPercentile(&agg->latency_hist, 0.5),
+						getLatencyHistPercentile(&agg->latency_hist, 0.99),
+						getLatencyHistPercentile(&agg->latency_hist, 0.999));
 			fputc('\n', logfile);
 
 			/* reset data and move to next interval */
@@ -3532,7 +3841,8 @@ processXactStats(TState *thread, CState *st, instr_time *now,
 {
 	double		latency = 0.0,
 				lag = 0.0;
-	bool		thread_details = progress || throttle_delay || latency_limit,
+	bool		thread_details = progress || throttle_delay || latency_limit ||
+				latency_hist,
 				detailed = thread_details || use_log || per_script_stats;
 
 	if (detailed && !skipped)
@@ -3559,6 +3869,9 @@ processXactStats(TState *thread, CState *st, instr_time *now,
 		thread->stats.cnt++;
 	}
 
+	if (json_report && !skipped)
+		countXactPerSecond(thread, now);
+
 	/* client stat is just counting */
 	st->cnt++;
 
@@ -3600,6 +3913,59 @@ initDropTables(PGconn *con)
 					 "pgbench_tellers");
 }
 
+/*
+ * Create the partitions of pgbench_accounts, under --partitions
+ *
+ * The accounts are split by ranges of aid of about the same size.  The first
+ * and last partitions are unbounded below and above.
+ */
+static void
+initCreatePartitions(PGconn *con)
+{
+	int64		part_size = ((int64) naccounts * scale + partitions - 1) / partitions;
+	int			p;
+
+	for (p = 1; p <= partitions; p++)
+	{
+		char		minvalue[32];
+		char		maxvalue[32];
+		char		opts[256];
+		char		buffer[512];
+
+		if (p == 1)
+			strcpy(minvalue, "minvalue");
+		else
+			snprintf(minvalue, sizeof(minvalue), INT64_FORMAT,
+					 (p - 1) * part_size + 1);
+
+		if (p == partitions)
+			strcpy(maxvalue, "maxvalue");
+		else
+			snprintf(maxvalue, sizeof(maxvalue), INT64_FORMAT,
+					 p * part_size + 1);
+
+		snprintf(opts, sizeof(opts), " with (fillfactor=%d)", fillfactor);
+		if (tablespace != NULL)
+		{
+			char	   *escape_tablespace;
+
+			escape_tablespace = PQescapeIdentifier(con, tablespace,
+												   strlen(tablespace));
+			snprintf(opts + strlen(opts), sizeof(opts) - strlen(opts),
+					 " tablespace %s", escape_tablespace);
+			PQfreemem(escape_tablespace);
+		}
+
+		snprintf(buffer, sizeof(buffer),
+				 "create%s table pgbench_accounts_%d partition of pgbench_accounts"
+				 " for values from (%s) to (%s)%s",
+				 unlogged_tables ? " unlogged" : "",
+				 p, minvalue, maxvalue, opts);
+
+		executeStatement(con, buffer);
+	}
+}
+
 /*
  * Create pgbench's standard tables
  */
@@ -3663,7 +4029,13 @@ initCreateTables(PGconn *con)
 
 		/* Construct new create table statement. */
 		opts[0] = '\0';
-		if (ddl->declare_fillfactor)
+		if (partitions > 0 && strcmp(ddl->table, "pgbench_accounts") == 0)
+		{
+			/* storage parameters go to the partitions */
+			snprintf(opts + strlen(opts), sizeof(opts) - strlen(opts),
+					 " partition by range (aid)");
+		}
+		else if (ddl->declare_fillfactor)
 			snprintf(opts + strlen(opts), sizeof(opts) - strlen(opts),
 					 " with (fillfactor=%d)", fillfactor);
 		if (tablespace != NULL)
@@ -3684,6 +4056,9 @@ initCreateTables(PGconn *con)
 				 ddl->table, cols, opts);
 
 		executeStatement(con, buffer);
+
+		if (partitions > 0 && strcmp(ddl->table, "pgbench_accounts") == 0)
+			initCreatePartitions(con);
 	}
 }
 
@@ -3825,6 +4200,112 @@ initGenerateData(PGconn *con)
 	executeStatement(con, "commit");
 }
 
+/*
+ * Fill the standard tables with some data generated on the server side
+ *
+ * Unlike initGenerateData(), no data is sent from the client, and the rows
+ * of pgbench_accounts are inserted over init_jobs connections at the same
+ * time, each filling its own range of aid.  Each range is inserted in a
+ * transaction of its own, so the load can't use the optimizations that
+ * apply to tables truncated in the same transaction.
+ */
+static void
+initGenerateDataServerSide(PGconn *con)
+{
+	char		sql[256];
+	PGconn	  **cons;
+	int64		total = (int64) naccounts * scale;
+	int64		chunk;
+	int			i;
+	instr_time	start,
+				diff;
+
+	fprintf(stderr, "generating data (server-side)...\n");
+
+	/*
+	 * truncate away any old data, in one command in case there are foreign
+	 * keys
+	 */
+	executeStatement(con, "truncate table "
+					 "pgbench_accounts, "
+					 "pgbench_branches, "
+					 "pgbench_history, "
+					 "pgbench_tellers");
+
+	/*
+	 * fill branches, tellers, accounts in that order in case foreign keys
+	 * already exist
+	 */
+	snprintf(sql, sizeof(sql),
+			 "insert into pgbench_branches(bid,bbalance) "
+			 "select bid, 0 from generate_series(1, %d) as bid",
+			 nbranches * scale);
+	executeStatement(con, sql);
+
+	snprintf(sql, sizeof(sql),
+			 "insert into pgbench_tellers(tid,bid,tbalance) "
+			 "select tid, (tid - 1) / %d + 1, 0 from generate_series(1, %d) as tid",
+			 ntellers, ntellers * scale);
+	executeStatement(con, sql);
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	/* no point in more connections than rows */
+	if (init_jobs > total)
+		init_jobs = (int) total;
+	chunk = (total + init_jobs - 1) / init_jobs;
+
+	cons = (PGconn **) pg_malloc(sizeof(PGconn *) * init_jobs);
+	cons[0] = con;
+	for (i = 1; i < init_jobs; i++)
+	{
+		if ((cons[i] = doConnect()) == NULL)
+			exit(1);
+	}
+
+	for (i = 0; i < init_jobs; i++)
+	{
+		int64		first = i * chunk + 1;
+		int64		last = Min((i + 1) * chunk, total);
+
+		/* "filler" column is set to blank padded empty string, like COPY */
+		snprintf(sql, sizeof(sql),
+				 "insert into pgbench_accounts(aid,bid,abalance,filler) "
+				 "select aid, (aid - 1) / %d + 1, 0, '' "
+				 "from generate_series(" INT64_FORMAT ", " INT64_FORMAT ") as aid",
+				 naccounts, first, last);
+		if (!PQsendQuery(cons[i], sql))
+		{
+			fprintf(stderr, "%s", PQerrorMessage(cons[i]));
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < init_jobs; i++)
+	{
+		PGresult   *res;
+
+		while ((res = PQgetResult(cons[i])) != NULL)
+		{
+			if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			{
+				fprintf(stderr, "%s", PQerrorMessage(cons[i]));
+				exit(1);
+			}
+			PQclear(res);
+		}
+
+		if (i > 0)
+			PQfinish(cons[i]);
+	}
+	pg_free(cons);
+
+	INSTR_TIME_SET_CURRENT(diff);
+	INSTR_TIME_SUBTRACT(diff, start);
+	fprintf(stderr, INT64_FORMAT " tuples done (elapsed %.2f s, %d connections)\n",
+			total, INSTR_TIME_GET_DOUBLE(diff), init_jobs);
+}
+
 /*
  * Invoke vacuum on the standard tables
  */
@@ -3915,11 +4396,11 @@ checkInitSteps(const char *initialize_steps)
 
 	for (step = initialize_steps; *step != '\0'; step++)
 	{
-		if (strchr("dtgvpf ", *step) == NULL)
+		if (strchr("dtgGvpf ", *step) == NULL)
 		{
 			fprintf(stderr, "unrecognized initialization step \"%c\"\n",
 					*step);
-			fprintf(stderr, "allowed steps are: \"d\", \"t\", \"g\", \"v\", \"p\", \"f\"\n");
+			fprintf(stderr, "allowed steps are: \"d\", \"t\", \"g\", \"G\", \"v\", \"p\", \"f\"\n");
 			exit(1);
 		}
 	}
@@ -3950,6 +4431,9 @@ runInitSteps(const char *initialize_steps)
 			case 'g':
 				initGenerateData(con);
 				break;
+			case 'G':
+				initGenerateDataServerSide(con);
+				break;
 			case 'v':
 				initVacuum(con);
 				break;
@@ -4127,6 +4611,7 @@ create_sql_command(PQExpBuffer buf, const char *source)
 	my_command->varprefix = NULL;	/* allocated later, if needed */
 	my_command->expr = NULL;
 	initSimpleStats(&my_command->stats);
+	initLatencyHist(&my_command->hist);
 
 	return my_command;
 }
@@ -4217,6 +4702,7 @@ process_backslash_command(PsqlScanState sstate, const char *source)
 	my_command->type = META_COMMAND;
 	my_command->argc = 0;
 	initSimpleStats(&my_command->stats);
+	initLatencyHist(&my_command->hist);
 
 	/* Save first word (command name) */
 	j = 0;
@@ -4347,7 +4833,9 @@ process_backslash_command(PsqlScanState sstate, const char *source)
 			syntax_error(source, lineno, my_command->first_line, my_command->argv[0],
 						 "missing command", NULL, -1);
 	}
-	else if (my_command->meta == META_ELSE || my_command->meta == META_ENDIF)
+	else if (my_command->meta == META_ELSE || my_command->meta == META_ENDIF ||
+			 my_command->meta == META_STARTPIPELINE ||
+			 my_command->meta == META_ENDPIPELINE)
 	{
 		if (my_command->argc != 1)
 			syntax_error(source, lineno, my_command->first_line, my_command->argv[0],
@@ -4861,6 +5349,17 @@ printSimpleStats(const char *prefix, SimpleStats *ss)
 	}
 }
 
+static void
+printLatencyPercentiles(const char *prefix, LatencyHist *hist)
+{
+	if (hist->count > 0)
+		printf("%s percentiles: p50 = %.3f ms, p99 = %.3f ms, p99.9 = %.3f ms\n",
+			   prefix,
+			   0.001 * getLatencyHistPercentile(hist, 0.5),
+			   0.001 * getLatencyHistPercentile(hist, 0.99),
+			   0.001 * getLatencyHistPercentile(hist, 0.999));
+}
+
 /* print out results */
 static void
 printResults(StatsData *total, instr_time total_time,
@@ -4912,8 +5411,12 @@ printResults(StatsData *total, instr_time total_time,
 			   latency_limit / 1000.0, latency_late, ntx,
 			   (ntx > 0) ? 100.0 * latency_late / ntx : 0.0);
 
-	if (throttle_delay || progress || latency_limit)
+	if (throttle_delay || progress || latency_limit || latency_percentiles)
+	{
 		printSimpleStats("latency", &total->latency);
+		if (latency_percentiles)
+			printLatencyPercentiles("latency", &total->latency_hist);
+	}
 	else
 	{
 		/* no measurement, show average latency computed from run time */
@@ -4963,6 +5466,8 @@ printResults(StatsData *total, instr_time total_time,
 						   100.0 * sstats->skipped / sstats->cnt);
 
 				printSimpleStats(" - latency", &sstats->latency);
+				if (latency_percentiles)
+					printLatencyPercentiles(" - latency", &sstats->latency_hist);
 			}
 
 			/* Report per-command latencies */
@@ -4971,26 +5476,165 @@ printResults(StatsData *total, instr_time total_time,
 				Command   **commands;
 
 				if (per_script_stats)
-					printf(" - statement latencies in milliseconds:\n");
+					printf(" - statement latencies in milliseconds%s:\n",
+						   latency_percentiles ? " (average, p50, p99, p99.9)" : "");
 				else
-					printf("statement latencies in milliseconds:\n");
+					printf("statement latencies in milliseconds%s:\n",
+						   latency_percentiles ? " (average, p50, p99, p99.9)" : "");
 
 				for (commands = sql_script[i].commands;
 					 *commands != NULL;
 					 commands++)
 				{
 					SimpleStats *cstats = &(*commands)->stats;
-
-					printf("   %11.3f  %s\n",
-						   (cstats->count > 0) ?
-						   1000.0 * cstats->sum / cstats->count : 0.0,
-						   (*commands)->first_line);
+					LatencyHist *chist = &(*commands)->hist;
+
+					if (latency_percentiles)
+						printf("   %11.3f %11.3f %11.3f %11.3f  %s\n",
+							   (cstats->count > 0) ?
+							   1000.0 * cstats->sum / cstats->count : 0.0,
+							   0.001 * getLatencyHistPercentile(chist, 0.5),
+							   0.001 * getLatencyHistPercentile(chist, 0.99),
+							   0.001 * getLatencyHistPercentile(chist, 0.999),
+							   (*commands)->first_line);
+					else
+						printf("   %11.3f  %s\n",
+							   (cstats->count > 0) ?
+							   1000.0 * cstats->sum / cstats->count : 0.0,
+							   (*commands)->first_line);
 				}
 			}
 		}
 	}
 }
 
+/* write a string to a JSON file, quoted and escaped */
+static void
+writeJsonString(FILE *fp, const char *str)
+{
+	const char *p;
+
+	fputc('"', fp);
+	for (p = str; *p; p++)
+	{
+		unsigned char c = (unsigned char) *p;
+
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('"', fp);
+}
+
+/*
+ * Write the results to the --json-report file
+ *
+ * This reports the same figures as printResults(), along with latency
+ * percentiles and the number of transactions finished in each second of the
+ * run.
+ */
+static void
+writeJsonReport(StatsData *total, instr_time total_time,
+				instr_time conn_total_time, int64 latency_late,
+				TState *threads)
+{
+	FILE	   *fp;
+	double		time_include;
+	int64		ntx = total->cnt - total->skipped;
+	int			nsecs = 0;
+	int			i;
+
+	fp = fopen(json_report, "w");
+	if (fp == NULL)
+	{
+		fprintf(stderr, "could not open file \"%s\": %s\n",
+				json_report, strerror(errno));
+		exit(1);
+	}
+
+	time_include = INSTR_TIME_GET_DOUBLE(total_time);
+
+	fprintf(fp, "{\n  \"transaction_type\": ");
+	writeJsonString(fp, num_scripts == 1 ? sql_script[0].desc : "multiple scripts");
+	fprintf(fp, ",\n  \"scaling_factor\": %d", scale);
+	fprintf(fp, ",\n  \"query_mode\": \"%s\"", QUERYMODE[querymode]);
+	fprintf(fp, ",\n  \"clients\": %d", nclients);
+	fprintf(fp, ",\n  \"threads\": %d", nthreads);
+	if (duration <= 0)
+		fprintf(fp, ",\n  \"transactions_per_client\": %d", nxacts);
+	else
+		fprintf(fp, ",\n  \"duration\": %d", duration);
+	fprintf(fp, ",\n  \"transactions\": " INT64_FORMAT, ntx);
+	fprintf(fp, ",\n  \"skipped\": " INT64_FORMAT, total->skipped);
+	fprintf(fp, ",\n  \"late\": " INT64_FORMAT, latency_late);
+	fprintf(fp, ",\n  \"time\": %.6f", time_include);
+
+	if (total->latency.count > 0)
+	{
+		SimpleStats *ss = &total->latency;
+		double		latency = ss->sum / ss->count;
+		double		stddev = sqrt(ss->sum2 / ss->count - latency * latency);
+
+		fprintf(fp, ",\n  \"latency_ms\": {\"average\": %.3f, \"stddev\": %.3f, "
+				"\"min\": %.3f, \"max\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+				"\"p99\": %.3f, \"p99.9\": %.3f}",
+				0.001 * latency,
+				0.001 * stddev,
+				0.001 * ss->min,
+				0.001 * ss->max,
+				0.001 * getLatencyHistPercentile(&total->latency_hist, 0.5),
+				0.001 * getLatencyHistPercentile(&total->latency_hist, 0.9),
+				0.001 * getLatencyHistPercentile(&total->latency_hist, 0.99),
+				0.001 * getLatencyHistPercentile(&total->latency_hist, 0.999));
+	}
+
+	if (ntx > 0)
+	{
+		fprintf(fp, ",\n  \"tps_including_connections\": %f",
+				ntx / time_include);
+		fprintf(fp, ",\n  \"tps_excluding_connections\": %f",
+				ntx / (time_include -
+					   (INSTR_TIME_GET_DOUBLE(conn_total_time) / nclients)));
+	}
+
+	/* sum up the per-second counts of all threads */
+	for (i = 0; i < nthreads; i++)
+	{
+		for (int s = threads[i].nsecs - 1; s >= nsecs; s--)
+		{
+			if (threads[i].xacts_per_sec[s] != 0)
+			{
+				nsecs = s + 1;
+				break;
+			}
+		}
+	}
+
+	fprintf(fp, ",\n  \"tps_per_second\": [");
+	for (int s = 0; s < nsecs; s++)
+	{
+		int64		count = 0;
+
+		for (i = 0; i < nthreads; i++)
+		{
+			if (s < threads[i].nsecs)
+				count += threads[i].xacts_per_sec[s];
+		}
+		fprintf(fp, "%s" INT64_FORMAT, s > 0 ? ", " : "", count);
+	}
+	fprintf(fp, "]\n}\n");
+
+	if (fclose(fp) != 0)
+	{
+		fprintf(stderr, "could not write file \"%s\": %s\n",
+				json_report, strerror(errno));
+		exit(1);
+	}
+}
+
 /*
  * Set up a random seed according to seed parameter (NULL means default),
  * and initialize base_random_sequence for use in initializing other sequences.
@@ -5088,6 +5732,10 @@ main(int argc, char **argv)
 		{"log-prefix", required_argument, NULL, 7},
 		{"foreign-keys", no_argument, NULL, 8},
 		{"random-seed", required_argument, NULL, 9},
+		{"latency-percentiles", no_argument, NULL, 10},
+		{"partitions", required_argument, NULL, 11},
+		{"init-jobs", required_argument, NULL, 12},
+		{"json-report", required_argument, NULL, 13},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -5440,6 +6088,34 @@ main(int argc, char **argv)
 					exit(1);
 				}
 				break;
+			case 10:			/* latency-percentiles */
+				benchmarking_option_set = true;
+				latency_percentiles = true;
+				break;
+			case 11:			/* partitions */
+				initialization_option_set = true;
+				partitions = atoi(optarg);
+				if (partitions <= 0)
+				{
+					fprintf(stderr, "invalid number of partitions: \"%s\"\n",
+							optarg);
+					exit(1);
+				}
+				break;
+			case 12:			/* init-jobs */
+				initialization_option_set = true;
+				init_jobs = atoi(optarg);
+				if (init_jobs <= 0)
+				{
+					fprintf(stderr, "invalid number of initialization jobs: \"%s\"\n",
+							optarg);
+					exit(1);
+				}
+				break;
+			case 13:			/* json-report */
+				benchmarking_option_set = true;
+				json_report = pg_strdup(optarg);
+				break;
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit(1);
@@ -5478,6 +6154,9 @@ main(int argc, char **argv)
 	if (num_scripts > 1)
 		per_script_stats = true;
 
+	/* the JSON report always includes latency percentiles */
+	latency_hist = latency_percentiles || json_report != NULL;
+
 	/*
 	 * Don't need more threads than there are clients.  (This is not merely an
 	 * optimization; throttle_delay is calculated incorrectly below if some
@@ -5782,6 +6461,8 @@ main(int argc, char **argv)
 		initRandomState(&thread->ts_sample_rs);
 		thread->logfile = NULL; /* filled in later */
 		thread->latency_late = 0;
+		thread->xacts_per_sec = NULL;
+		thread->nsecs = 0;
 		initStats(&thread->stats, 0);
 
 		nclients_dealt += thread->nstate;
@@ -5860,6 +6541,8 @@ main(int argc, char **argv)
 		/* aggregate thread level stats */
 		mergeSimpleStats(&stats.latency, &thread->stats.latency);
 		mergeSimpleStats(&stats.lag, &thread->stats.lag);
+		if (latency_hist)
+			mergeLatencyHist(&stats.latency_hist, &thread->stats.latency_hist);
 		stats.cnt += thread->stats.cnt;
 		stats.skipped += thread->stats.skipped;
 		latency_late += thread->latency_late;
@@ -5880,6 +6563,9 @@ main(int argc, char **argv)
 	INSTR_TIME_SET_CURRENT(total_time);
 	INSTR_TIME_SUBTRACT(total_time, start_time);
 	printResults(&stats, total_time, conn_total_time, latency_late);
+	if (json_report)
+		writeJsonReport(&stats, total_time, conn_total_time, latency_late,
+						threads);
 
 	if (exit_code != 0)
 		fprintf(stderr, "Run was aborted; the above results are incomplete.\n");
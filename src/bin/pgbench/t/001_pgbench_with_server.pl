@@ -128,6 +128,22 @@ pgbench(
 	],
 	'pgbench --init-steps');
 
+# Server-side data generation over several connections, into partitions
+pgbench(
+	'--initialize --init-steps=dtGvp --init-jobs=3 --partitions=4 --scale=1',
+	0,
+	[qr{^$}],
+	[
+		qr{dropping old tables},
+		qr{creating tables},
+		qr{generating data \(server-side\)},
+		qr{100000 tuples done \(elapsed .* s, 3 connections\)},
+		qr{vacuuming},
+		qr{creating primary keys},
+		qr{done\.}
+	],
+	'pgbench server-side generation with partitions');
+
 # Run all builtin scripts, for a few transactions each
 pgbench(
 	'--transactions=5 -Dfoo=bla --client=2 --protocol=simple --builtin=t'
@@ -171,6 +187,20 @@ pgbench(
 	],
 	'pgbench select only');
 
+pgbench(
+	'-t 10 -c 3 -M prepared -b hot-update -b range-scan -b subxact -b notify -n',
+	0,
+	[
+		qr{multiple scripts},
+		qr{processed: 30/30},
+		qr{builtin: hot row update},
+		qr{builtin: range scan},
+		qr{builtin: subtransaction overflow},
+		qr{builtin: listen/notify}
+	],
+	[qr{^$}],
+	'pgbench workload builtins');
+
 # check if threads are supported
 my $nthreads = 2;
 
@@ -567,6 +597,43 @@ SELECT 0 AS i4, 4 AS i4 \gset
 }
 	});
 
+# working \startpipeline
+pgbench(
+	'-t 1 -n -M extended',
+	0,
+	[ qr{type: .*/001_pgbench_pipeline}, qr{actually processed: 1/1} ],
+	[qr{^$}],
+	'working \startpipeline',
+	{
+		'001_pgbench_pipeline' => q{
+-- test startpipeline
+\startpipeline
+} . "select 1;\n" x 10 . q{
+\endpipeline
+}
+	});
+
+# working \startpipeline in prepared query mode
+pgbench(
+	'-t 1 -n -M prepared',
+	0,
+	[ qr{type: .*/001_pgbench_pipeline_prep}, qr{actually processed: 1/1} ],
+	[qr{^$}],
+	'working \startpipeline in prepared query mode',
+	{
+		'001_pgbench_pipeline_prep' => q{
+-- test startpipeline
+\startpipeline
+\endpipeline
+\startpipeline
+SELECT 1;
+SELECT 2;
+\endpipeline
+\startpipeline
+\endpipeline
+}
+	});
+
 # trigger many expression errors
 my @errors = (
 
@@ -803,6 +870,44 @@ SELECT LEAST(} . join(', ', (':i') x 256) . q{)}
 		2,
 		[qr{error storing into variable bad name!}],
 		q{SELECT 1 AS "bad name!" \gset}
+	],
+
+	# PIPELINE
+	[
+		'pipeline unexpected argument', 1,
+		[qr{unexpected argument}], q{\startpipeline x}
+	],
+	[
+		'pipeline with simple protocol',
+		2,
+		[qr{cannot use pipeline mode with the simple query protocol}],
+		q{\startpipeline
+SELECT 1;
+\endpipeline},
+		1
+	],
+	[
+		'pipeline already started',
+		2,
+		[qr{already in pipeline mode}],
+		q{\startpipeline
+\startpipeline}
+	],
+	[ 'pipeline not started', 2, [qr{not in pipeline mode}], q{\endpipeline} ],
+	[
+		'pipeline not ended',
+		2,
+		[qr{end of script reached within a pipeline}],
+		q{\startpipeline
+SELECT 1;}
+	],
+	[
+		'pipeline gset',
+		2,
+		[qr{gset is not allowed in pipeline mode}],
+		q{\startpipeline
+SELECT 1 AS i \gset
+\endpipeline}
 	],);
 
 for my $e (@errors)
@@ -844,6 +949,26 @@ pgbench(
 	'pgbench late throttling',
 	{ '001_pgbench_sleep' => q{\sleep 2ms} });
 
+# latency percentiles, overall and per statement
+pgbench(
+	'-n -t 20 -c 2 -r --latency-percentiles -M extended',
+	0,
+	[
+		qr{processed: 40/40},
+		qr{latency percentiles: p50 = \d+\.\d{3} ms, p99 = \d+\.\d{3} ms, p99\.9 = \d+\.\d{3} ms},
+		qr{statement latencies in milliseconds \(average, p50, p99, p99\.9\):},
+		qr{^\s+\d+\.\d{3}\s+\d+\.\d{3}\s+\d+\.\d{3}\s+\d+\.\d{3}\s+\\endpipeline}m
+	],
+	[qr{^$}],
+	'pgbench latency percentiles',
+	{
+		'001_pgbench_percentiles' => q{\startpipeline
+SELECT 1;
+SELECT 2;
+\endpipeline
+}
+	});
+
 # return a list of files from directory $dir matching regexpr $re
 # this works around glob portability and escaping issues
 sub list_files
@@ -907,6 +1032,30 @@ pgbench(
 check_pgbench_logs($bdir, '001_pgbench_log_3', 1, 10, 10,
 	qr{^\d \d{1,2} \d+ \d \d+ \d+$});
 
+# aggregated log with latency percentiles
+pgbench(
+	"-n -S -T 2 --aggregate-interval=1 --latency-percentiles -l", 0,
+	[ qr{select only}, qr{latency percentiles: } ], [qr{^$}],
+	'pgbench aggregated logs with percentiles', undef,
+	"--log-prefix=$bdir/001_pgbench_log_4");
+
+check_pgbench_logs($bdir, '001_pgbench_log_4', 1, 1, 3,
+	qr{^\d{10,} \d+ \d+ \d+ \d+ \d+ \d+ \d+ \d+$});
+
+# results in JSON format
+pgbench(
+	"-n -S -t 50 -c 2 --json-report=$bdir/001_pgbench_report.json",
+	0, [ qr{select only}, qr{processed: 100/100} ], [qr{^$}],
+	'pgbench JSON report');
+
+my $report = slurp_file("$bdir/001_pgbench_report.json");
+like($report, qr{"transactions": 100,}, 'JSON report transactions');
+like(
+	$report,
+	qr{"latency_ms": \{"average": [\d.]+, .*"p99\.9": [\d.]+\}},
+	'JSON report latencies');
+like($report, qr{"tps_per_second": \[\d+(, \d+)*\]}, 'JSON report per second');
+
 # done
 $node->stop;
 done_testing();
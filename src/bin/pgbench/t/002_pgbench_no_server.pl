@@ -149,6 +149,21 @@ my @options = (
 		'-i -I dta',
 		[ qr{unrecognized initialization step}, qr{allowed steps are} ]
 	],
+	[
+		'bad partition number',
+		'-i --partitions=0',
+		[qr{invalid number of partitions: "0"}]
+	],
+	[
+		'bad initialization jobs',
+		'-i -I dtG --init-jobs=-1',
+		[qr{invalid number of initialization jobs: "-1"}]
+	],
+	[
+		'--partitions without init option',
+		'--partitions=2',
+		[qr{cannot be used in benchmarking mode}]
+	],
 	[
 		'bad random seed',
 		'--random-seed=one',
@@ -214,7 +229,9 @@ pgbench(
 	[qr{^$}],
 	[
 		qr{Available builtin scripts:}, qr{tpcb-like},
-		qr{simple-update},              qr{select-only}
+		qr{simple-update},              qr{select-only},
+		qr{hot-update},                 qr{range-scan},
+		qr{subxact},                    qr{notify}
 	],
 	'pgbench builtin list');
 
@@ -771,3 +771,32 @@ pglz_decompress(const char *source, int32 slen, char *dest,
 	 */
 	return (char *) dp - dest;
 }
+
+
+/* ----------
+ * pglz_maximum_compressed_size -
+ *
+ *		Calculate the maximum number of bytes of compressed data that
+ *		pglz_decompress() may have to read to produce the first rawsize
+ *		bytes of output.  This lets callers that only want a prefix of the
+ *		uncompressed data fetch only a prefix of the compressed data.
+ * ----------
+ */
+int32
+pglz_maximum_compressed_size(int32 rawsize, int32 total_compressed_size)
+{
+	int64		compressed_size;
+
+	/*
+	 * Every item either is a literal byte, or is a tag that takes at most as
+	 * many bytes as it produces.  So the items that produce all but the last
+	 * output byte take at most rawsize - 1 bytes, and the item that produces
+	 * the last one takes at most 3 bytes.  Each item also needs one control
+	 * bit, and there are at most rawsize items.  Use int64 to avoid
+	 * overflow.
+	 */
+	compressed_size = ((int64) rawsize * 9 + 7) / 8 + 2;
+
+	/* it can't be more than the whole compressed data, of course */
+	return (int32) Min(compressed_size, (int64) total_compressed_size);
+}
@@ -0,0 +1,404 @@
+/*-------------------------------------------------------------------------
+ *
+ * zpq_stream.c
+ *	  Streaming compression for the frontend/backend protocol.
+ *
+ * A ZpqStream holds one compressor for the data a peer sends and one
+ * decompressor for the data it receives.  Both sides of a connection keep
+ * their stream alive for the whole session, so the compression dictionary
+ * carries over from one message to the next; every call to zpq_compress()
+ * ends with a flush point, so that whatever has been compressed can be
+ * decompressed by the peer without waiting for more data.
+ *
+ * The code is shared by the backend and libpq, and so allocates with plain
+ * malloc() and reports failure through its return values.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/common/zpq_stream.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef FRONTEND
+#include "postgres.h"
+#else
+#include "postgres_fe.h"
+#endif
+
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+#include "common/zpq_stream.h"
+
+/* Minimum free space zpq_rx_space() makes available for a read */
+#define ZPQ_RX_CHUNK	8192
+
+struct ZpqStream
+{
+	ZpqAlgorithm algorithm;
+	ZpqCounters counters;
+
+	/* compressed output, valid until the next zpq_compress() */
+	char	   *tx_buf;
+	size_t		tx_size;
+
+	/* compressed input not yet consumed is rx_buf[rx_pos .. rx_len) */
+	char	   *rx_buf;
+	size_t		rx_size;
+	size_t		rx_pos;
+	size_t		rx_len;
+	bool		rx_full;		/* last decompression filled its output */
+
+#ifdef HAVE_LIBZ
+	z_stream	tx;
+	z_stream	rx;
+#endif
+};
+
+static const char *const zpq_algorithm_names[ZPQ_NUM_ALGORITHMS] = {
+	"none",
+	"zlib"
+};
+
+
+/*
+ * Return the protocol name of a compression algorithm.
+ */
+const char *
+zpq_algorithm_name(ZpqAlgorithm algorithm)
+{
+	if ((int) algorithm < 0 || algorithm >= ZPQ_NUM_ALGORITHMS)
+		return NULL;
+	return zpq_algorithm_names[algorithm];
+}
+
+/*
+ * Is the algorithm available in this build?
+ */
+bool
+zpq_algorithm_supported(ZpqAlgorithm algorithm)
+{
+	switch (algorithm)
+	{
+		case ZPQ_ZLIB:
+#ifdef HAVE_LIBZ
+			return true;
+#else
+			return false;
+#endif
+		default:
+			return false;
+	}
+}
+
+/*
+ * Look up an algorithm by name.  Returns -1 if the name is not known.
+ */
+ZpqAlgorithm
+zpq_parse_algorithm(const char *name)
+{
+	int			i;
+
+	for (i = 0; i < ZPQ_NUM_ALGORITHMS; i++)
+	{
+		if (pg_strcasecmp(name, zpq_algorithm_names[i]) == 0)
+			return (ZpqAlgorithm) i;
+	}
+	return (ZpqAlgorithm) -1;
+}
+
+/*
+ * Choose the first supported algorithm from a comma-separated list of names,
+ * as the client sends it in the _pq_.compression option.  Unknown names are
+ * ignored, so that a newer client can list algorithms an older server has no
+ * idea about.  Returns ZPQ_NONE if nothing in the list is usable.
+ */
+ZpqAlgorithm
+zpq_choose_algorithm(const char *list)
+{
+	const char *p = list;
+
+	while (*p)
+	{
+		char		name[32];
+		size_t		len = 0;
+		ZpqAlgorithm algorithm;
+
+		while (*p == ',' || *p == ' ')
+			p++;
+		while (*p && *p != ',' && *p != ' ')
+		{
+			if (len < sizeof(name) - 1)
+				name[len++] = *p;
+			p++;
+		}
+		if (len == 0)
+			continue;
+		name[len] = '\0';
+
+		algorithm = zpq_parse_algorithm(name);
+		if (algorithm != ZPQ_NONE && zpq_algorithm_supported(algorithm))
+			return algorithm;
+	}
+	return ZPQ_NONE;
+}
+
+/*
+ * Create a stream for the given algorithm.  Returns NULL if the algorithm is
+ * not supported or we run out of memory.
+ */
+ZpqStream *
+zpq_create(ZpqAlgorithm algorithm)
+{
+	ZpqStream  *zs;
+
+	if (algorithm == ZPQ_NONE || !zpq_algorithm_supported(algorithm))
+		return NULL;
+
+	zs = (ZpqStream *) malloc(sizeof(ZpqStream));
+	if (zs == NULL)
+		return NULL;
+	memset(zs, 0, sizeof(ZpqStream));
+	zs->algorithm = algorithm;
+
+	zs->rx_size = ZPQ_RX_CHUNK;
+	zs->rx_buf = malloc(zs->rx_size);
+	if (zs->rx_buf == NULL)
+	{
+		free(zs);
+		return NULL;
+	}
+
+#ifdef HAVE_LIBZ
+	/*
+	 * Favor speed over ratio: the point is to trade a little CPU for a lot
+	 * of bandwidth, and higher levels rarely pay off for query results.
+	 */
+	if (deflateInit(&zs->tx, Z_BEST_SPEED) != Z_OK)
+	{
+		free(zs->rx_buf);
+		free(zs);
+		return NULL;
+	}
+	if (inflateInit(&zs->rx) != Z_OK)
+	{
+		deflateEnd(&zs->tx);
+		free(zs->rx_buf);
+		free(zs);
+		return NULL;
+	}
+#endif
+
+	return zs;
+}
+
+/*
+ * Release a stream and everything it holds.
+ */
+void
+zpq_free(ZpqStream *zs)
+{
+	if (zs == NULL)
+		return;
+#ifdef HAVE_LIBZ
+	deflateEnd(&zs->tx);
+	inflateEnd(&zs->rx);
+#endif
+	if (zs->tx_buf)
+		free(zs->tx_buf);
+	free(zs->rx_buf);
+	free(zs);
+}
+
+ZpqAlgorithm
+zpq_algorithm(ZpqStream *zs)
+{
+	return zs->algorithm;
+}
+
+const ZpqCounters *
+zpq_counters(ZpqStream *zs)
+{
+	return &zs->counters;
+}
+
+/*
+ * Compress len bytes at src, followed by a flush point.
+ *
+ * On success, returns 0 and sets *dst and *dstlen to the compressed data,
+ * which lives in the stream's own buffer and remains valid until the next
+ * call.  Returns -1 on failure (out of memory, or a compressor error); the
+ * stream must not be used for sending after that.
+ */
+int
+zpq_compress(ZpqStream *zs, const char *src, size_t len,
+			 const char **dst, size_t *dstlen)
+{
+#ifdef HAVE_LIBZ
+	size_t		produced = 0;
+	size_t		needed;
+
+	/* deflateBound() doesn't cover the flush marker, so add some slack */
+	needed = deflateBound(&zs->tx, len) + 16;
+	if (zs->tx_size < needed)
+	{
+		char	   *newbuf = realloc(zs->tx_buf, needed);
+
+		if (newbuf == NULL)
+			return -1;
+		zs->tx_buf = newbuf;
+		zs->tx_size = needed;
+	}
+
+	zs->tx.next_in = (Bytef *) src;
+	zs->tx.avail_in = len;
+
+	for (;;)
+	{
+		zs->tx.next_out = (Bytef *) zs->tx_buf + produced;
+		zs->tx.avail_out = zs->tx_size - produced;
+
+		if (deflate(&zs->tx, Z_SYNC_FLUSH) != Z_OK)
+			return -1;
+		produced = zs->tx_size - zs->tx.avail_out;
+
+		/* done once all input is consumed and the flush fitted */
+		if (zs->tx.avail_in == 0 && zs->tx.avail_out > 0)
+			break;
+
+		/* out of output space; enlarge the buffer and go around again */
+		{
+			size_t		newsize = zs->tx_size * 2;
+			char	   *newbuf = realloc(zs->tx_buf, newsize);
+
+			if (newbuf == NULL)
+				return -1;
+			zs->tx_buf = newbuf;
+			zs->tx_size = newsize;
+		}
+	}
+
+	zs->counters.raw_sent += len;
+	zs->counters.compressed_sent += produced;
+	*dst = zs->tx_buf;
+	*dstlen = produced;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Return a pointer to free space for reading compressed data from the peer,
+ * and its size in *space.  After reading, report the number of bytes placed
+ * there with zpq_rx_added().  Returns NULL if out of memory.
+ */
+char *
+zpq_rx_space(ZpqStream *zs, size_t *space)
+{
+	/* left-justify any unconsumed data */
+	if (zs->rx_pos > 0)
+	{
+		if (zs->rx_len > zs->rx_pos)
+			memmove(zs->rx_buf, zs->rx_buf + zs->rx_pos,
+					zs->rx_len - zs->rx_pos);
+		zs->rx_len -= zs->rx_pos;
+		zs->rx_pos = 0;
+	}
+
+	if (zs->rx_size - zs->rx_len < ZPQ_RX_CHUNK)
+	{
+		size_t		newsize = zs->rx_len + ZPQ_RX_CHUNK;
+		char	   *newbuf = realloc(zs->rx_buf, newsize);
+
+		if (newbuf == NULL)
+			return NULL;
+		zs->rx_buf = newbuf;
+		zs->rx_size = newsize;
+	}
+
+	*space = zs->rx_size - zs->rx_len;
+	return zs->rx_buf + zs->rx_len;
+}
+
+void
+zpq_rx_added(ZpqStream *zs, size_t len)
+{
+	Assert(zs->rx_len + len <= zs->rx_size);
+	zs->rx_len += len;
+	zs->counters.compressed_received += len;
+}
+
+/*
+ * Hand the stream compressed data that was already read from the peer, such
+ * as whatever followed the compression acknowledgement in the same read.
+ * Returns false if out of memory.
+ */
+bool
+zpq_rx_feed(ZpqStream *zs, const char *src, size_t len)
+{
+	while (len > 0)
+	{
+		size_t		space;
+		char	   *dst = zpq_rx_space(zs, &space);
+		size_t		n = Min(len, space);
+
+		if (dst == NULL)
+			return false;
+		memcpy(dst, src, n);
+		zpq_rx_added(zs, n);
+		src += n;
+		len -= n;
+	}
+	return true;
+}
+
+/*
+ * Might zpq_decompress() produce data without more input being read?
+ */
+bool
+zpq_rx_pending(ZpqStream *zs)
+{
+	return zs->rx_pos < zs->rx_len || zs->rx_full;
+}
+
+/*
+ * Decompress buffered input into dst, which has room for len bytes.
+ *
+ * Returns the number of bytes produced, which is zero if more input must be
+ * read first, or -1 if the input is corrupt.
+ */
+ssize_t
+zpq_decompress(ZpqStream *zs, char *dst, size_t len)
+{
+#ifdef HAVE_LIBZ
+	int			rc;
+	size_t		produced;
+
+	zs->rx.next_in = (Bytef *) zs->rx_buf + zs->rx_pos;
+	zs->rx.avail_in = zs->rx_len - zs->rx_pos;
+	zs->rx.next_out = (Bytef *) dst;
+	zs->rx.avail_out = len;
+
+	rc = inflate(&zs->rx, Z_SYNC_FLUSH);
+
+	zs->rx_pos = zs->rx_len - zs->rx.avail_in;
+	if (zs->rx_pos == zs->rx_len)
+		zs->rx_pos = zs->rx_len = 0;
+
+	/* Z_BUF_ERROR just means no progress was possible */
+	if (rc != Z_OK && rc != Z_BUF_ERROR)
+		return -1;
+
+	produced = len - zs->rx.avail_out;
+	zs->rx_full = (zs->rx.avail_out == 0);
+	zs->counters.raw_received += produced;
+	return produced;
+#else
+	return -1;
+#endif
+}
@@ -15,11 +15,26 @@
 #include "access/tupdesc.h"
 
 
+/*
+ * Callback used by opclasses that keep the summary in a different form in
+ * memory than on disk.  It must store the on-disk form of mem_value into
+ * values[], which has room for oi_nstored Datums.
+ */
+typedef void (*brin_serialize_callback_type) (BrinDesc *bdesc,
+											  Datum mem_value,
+											  Datum *values);
+
 /*
  * A BRIN index stores one index tuple per page range.  Each index tuple
  * has one BrinValues struct for each indexed column; in turn, each BrinValues
  * has (besides the null flags) an array of Datum whose size is determined by
  * the opclass.
+ *
+ * An opclass may instead keep the summary in an expanded in-memory form in
+ * bv_mem_value, allocated in bv_context, in which case it must also set
+ * bv_serialize; the on-disk values are then produced when the tuple is
+ * formed.  bv_mem_value is reset whenever the tuple is, so opclasses must
+ * be prepared to rebuild it from bv_values.
  */
 typedef struct BrinValues
 {
@@ -27,6 +42,9 @@ typedef struct BrinValues
 	bool		bv_hasnulls;	/* are there any nulls in the page range? */
 	bool		bv_allnulls;	/* are all values nulls in the page range? */
 	Datum	   *bv_values;		/* current accumulated values */
+	Datum		bv_mem_value;	/* expanded accumulated values */
+	MemoryContext bv_context;	/* memory context holding bv_mem_value */
+	brin_serialize_callback_type bv_serialize;	/* serializes bv_mem_value */
 } BrinValues;
 
 /*
@@ -158,6 +158,13 @@ typedef struct HashScanOpaqueData
 	/* Hash value of the scan key, ie, the hash key we seek */
 	uint32		hashso_sk_hash;
 
+	/*
+	 * Hash values of all the scan keys, in the same order as keyData.  These
+	 * are checked against the per-column hash codes stored in the index
+	 * tuples of a multicolumn index.
+	 */
+	uint32	   *hashso_sk_hashes;
+
 	/* remember the buffer associated with primary bucket */
 	Buffer		hashso_bucket_buf;
 
@@ -367,7 +374,9 @@ extern bool hashvalidate(Oid opclassoid);
 /* private routines */
 
 /* hashinsert.c */
-extern void _hash_doinsert(Relation rel, IndexTuple itup, Relation heapRel);
+extern bool _hash_doinsert(Relation rel, IndexTuple itup, Relation heapRel,
+						   IndexUniqueCheck checkUnique,
+						   struct IndexInfo *indexInfo, bool isbuild);
 extern OffsetNumber _hash_pgaddtup(Relation rel, Buffer buf,
 								   Size itemsize, IndexTuple itup);
 extern void _hash_pgaddmultitup(Relation rel, Buffer buf, IndexTuple *itups,
@@ -427,12 +436,14 @@ extern HSpool *_h_spoolinit(Relation heap, Relation index, uint32 num_buckets);
 extern void _h_spooldestroy(HSpool *hspool);
 extern void _h_spool(HSpool *hspool, ItemPointer self,
 					 Datum *values, bool *isnull);
-extern void _h_indexbuild(HSpool *hspool, Relation heapRel);
+extern void _h_indexbuild(HSpool *hspool, Relation heapRel,
+						  struct IndexInfo *indexInfo);
 
 /* hashutil.c */
 extern bool _hash_checkqual(IndexScanDesc scan, IndexTuple itup);
-extern uint32 _hash_datum2hashkey(Relation rel, Datum key);
-extern uint32 _hash_datum2hashkey_type(Relation rel, Datum key, Oid keytype);
+extern uint32 _hash_datum2hashkey(Relation rel, AttrNumber attno, Datum key);
+extern uint32 _hash_datum2hashkey_type(Relation rel, AttrNumber attno,
+									   Datum key, Oid keytype);
 extern Bucket _hash_hashkey2bucket(uint32 hashkey, uint32 maxbucket,
 								   uint32 highmask, uint32 lowmask);
 extern uint32 _hash_log2(uint32 num);
@@ -451,6 +462,10 @@ extern Bucket _hash_get_newbucket_from_oldbucket(Relation rel, Bucket old_bucket
 												 uint32 lowmask, uint32 maxbucket);
 extern void _hash_kill_items(IndexScanDesc scan);
 
+/* hashfunc.c */
+extern Datum hashtext_inmemory(PG_FUNCTION_ARGS);
+extern Datum hashvarlena_inmemory(PG_FUNCTION_ARGS);
+
 /* hash.c */
 extern void hashbucketcleanup(Relation rel, Bucket cur_bucket,
 							  Buffer bucket_buf, BlockNumber bucket_blkno,
@@ -23,7 +23,9 @@
 #include "nodes/lockoptions.h"
 #include "nodes/primnodes.h"
 #include "storage/bufpage.h"
+#include "storage/dsm.h"
 #include "storage/lockdefs.h"
+#include "storage/shm_toc.h"
 #include "utils/relcache.h"
 #include "utils/snapshot.h"
 
@@ -34,6 +36,8 @@
 #define HEAP_INSERT_FROZEN		TABLE_INSERT_FROZEN
 #define HEAP_INSERT_NO_LOGICAL	TABLE_INSERT_NO_LOGICAL
 #define HEAP_INSERT_SPECULATIVE 0x0010
+#define HEAP_INSERT_PARALLEL	TABLE_INSERT_PARALLEL
+#define HEAP_INSERT_DIRECT		TABLE_INSERT_DIRECT
 
 typedef struct BulkInsertStateData *BulkInsertState;
 struct TupleTableSlot;
@@ -62,8 +66,17 @@ typedef struct HeapScanDescData
 	/* rs_numblocks is usually InvalidBlockNumber, meaning "scan whole rel" */
 	BufferAccessStrategy rs_strategy;	/* access strategy for reads */
 
+	/* look-ahead for forward serial scans, or NULL */
+	struct StreamingReadData *rs_stream;
+	BlockNumber rs_stream_next; /* next block to hand to the stream */
+	BlockNumber rs_stream_left; /* # blocks not yet handed to the stream */
+
 	HeapTupleData rs_ctup;		/* current tuple in scan, if any */
 
+	/* range of TIDs returned by a TID range scan, see heap_set_tidrange */
+	ItemPointerData rs_mintid;
+	ItemPointerData rs_maxtid;
+
 	/* these fields only used in page-at-a-time mode and for bitmap scans */
 	int			rs_cindex;		/* current tuple's index in vistuples */
 	int			rs_ntuples;		/* number of visible tuples on page */
@@ -120,6 +133,11 @@ extern void heap_endscan(TableScanDesc scan);
 extern HeapTuple heap_getnext(TableScanDesc scan, ScanDirection direction);
 extern bool heap_getnextslot(TableScanDesc sscan,
 							 ScanDirection direction, struct TupleTableSlot *slot);
+extern void heap_set_tidrange(TableScanDesc sscan, ItemPointer mintid,
+							  ItemPointer maxtid);
+extern bool heap_getnextslot_tidrange(TableScanDesc sscan,
+									  ScanDirection direction,
+									  struct TupleTableSlot *slot);
 
 extern bool heap_fetch(Relation relation, Snapshot snapshot,
 					   HeapTuple tuple, Buffer *userbuf);
@@ -173,7 +191,9 @@ extern TransactionId heap_compute_xid_horizon_for_tuples(Relation rel,
 														 int nitems);
 
 /* in heap/pruneheap.c */
+extern bool deferred_page_pruning;
 extern void heap_page_prune_opt(Relation relation, Buffer buffer);
+extern void heap_page_prune_deferred(Oid relid, BlockNumber blkno);
 extern int	heap_page_prune(Relation relation, Buffer buffer,
 							TransactionId OldestXmin,
 							bool report_stats, TransactionId *latestRemovedXid);
@@ -193,8 +213,12 @@ extern Size SyncScanShmemSize(void);
 struct VacuumParams;
 extern void heap_vacuum_rel(Relation onerel,
 							struct VacuumParams *params, BufferAccessStrategy bstrategy);
+extern void parallel_vacuum_main(dsm_segment *seg, shm_toc *toc);
 
 /* in heap/heapam_visibility.c */
+extern bool defer_hint_bit_writes;
+extern void HeapBeginHintBatch(Buffer buffer);
+extern void HeapEndHintBatch(void);
 extern bool HeapTupleSatisfiesVisibility(HeapTuple stup, Snapshot snapshot,
 										 Buffer buffer);
 extern TM_Result HeapTupleSatisfiesUpdate(HeapTuple stup, CommandId curcid,
@@ -25,12 +25,24 @@
  * If current_buf isn't InvalidBuffer, then we are holding an extra pin
  * on that buffer.
  *
+ * The direct_* fields are used for HEAP_INSERT_DIRECT, in which case new
+ * tuples are placed on a run of pages built in private memory, to be written
+ * out with RelationFlushDirectPages(); direct_pages is NULL until then.
+ *
  * "typedef struct BulkInsertStateData *BulkInsertState" is in heapam.h
  */
 typedef struct BulkInsertStateData
 {
 	BufferAccessStrategy strategy;	/* our BULKWRITE strategy object */
 	Buffer		current_buf;	/* current insertion target page */
+
+	Relation	direct_rel;		/* relation being loaded */
+	char	   *direct_pages;	/* run of private pages, or NULL */
+	int			direct_npages;	/* number of pages in the run in use */
+	BlockNumber direct_runblk;	/* block number of the run's first page */
+	BlockNumber direct_startblk;	/* first block written since last flush */
+	bool		direct_needwal; /* WAL-log the pages? */
+	bool		direct_frozen;	/* pages are all-visible and all-frozen */
 } BulkInsertStateData;
 
 
@@ -40,5 +52,13 @@ extern Buffer RelationGetBufferForTuple(Relation relation, Size len,
 										Buffer otherBuffer, int options,
 										BulkInsertStateData *bistate,
 										Buffer *vmbuffer, Buffer *vmbuffer_other);
+extern void RelationPutHeapTuplesDirect(Relation relation, HeapTuple *tuples,
+										int ntuples, int options,
+										BulkInsertStateData *bistate);
+extern void RelationFlushDirectPages(BulkInsertStateData *bistate);
+
+extern bool adaptive_fillfactor;
+extern void RelationRecordUpdatePlacement(Relation relation, bool samepage);
+extern Size RelationGetAdaptiveFreeSpace(Relation relation);
 
 #endif							/* HIO_H */
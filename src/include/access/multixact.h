@@ -28,10 +28,6 @@
 
 #define MaxMultiXactOffset	((MultiXactOffset) 0xFFFFFFFF)
 
-/* Number of SLRU buffers to use for multixact */
-#define NUM_MXACTOFFSET_BUFFERS		8
-#define NUM_MXACTMEMBER_BUFFERS		16
-
 /*
  * Possible multixact lock modes ("status").  The first four modes are for
  * tuple locks (FOR KEY SHARE, FOR SHARE, FOR NO KEY UPDATE, FOR UPDATE); the
@@ -55,6 +51,20 @@ typedef enum
 #define ISUPDATE_from_mxstatus(status) \
 			((status) > MultiXactStatusForUpdate)
 
+/*
+ * A member entry with this bit set in its status links to an older,
+ * lock-only multixact whose members all belong to this one too; the entry's
+ * xid field holds that MultiXactId, and the remaining status bits hold the
+ * length of the chain of such links.  See MultiXactIdExpand.  These entries
+ * only appear in the members SLRU and in WAL records, never in the arrays
+ * returned by GetMultiXactIdMembers.
+ */
+#define MXACT_PARENT_LINK			0x80
+#define MXACT_IS_PARENT_LINK(status) \
+			(((int) (status) & MXACT_PARENT_LINK) != 0)
+#define MXACT_PARENT_LINK_DEPTH(status) \
+			((int) (status) & ~MXACT_PARENT_LINK)
+
 
 typedef struct MultiXactMember
 {
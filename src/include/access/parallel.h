@@ -53,9 +53,17 @@ typedef struct ParallelWorkerContext
 	shm_toc    *toc;
 } ParallelWorkerContext;
 
+/* possible values for parallel_worker_affinity */
+typedef enum
+{
+	PARALLEL_WORKER_AFFINITY_OFF,
+	PARALLEL_WORKER_AFFINITY_LEADER_NODE
+}			ParallelWorkerAffinity;
+
 extern volatile bool ParallelMessagePending;
 extern PGDLLIMPORT int ParallelWorkerNumber;
 extern PGDLLIMPORT bool InitializingParallelWorker;
+extern int	parallel_worker_affinity;
 
 #define		IsParallelWorker()		(ParallelWorkerNumber >= 0)
 
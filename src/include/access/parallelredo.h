@@ -0,0 +1,46 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallelredo.h
+ *	  Parallel application of WAL records during recovery.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/access/parallelredo.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PARALLELREDO_H
+#define PARALLELREDO_H
+
+#include "access/xlogreader.h"
+#include "common/relpath.h"
+#include "storage/block.h"
+#include "storage/relfilenode.h"
+
+/* upper limit for parallel_redo_workers */
+#define MAX_PARALLEL_REDO_WORKERS	32
+
+/* GUC variable */
+extern int	parallel_redo_workers;
+
+extern Size ParallelRedoShmemSize(void);
+extern void ParallelRedoShmemInit(void);
+
+/* in the startup process */
+extern void ParallelRedoStart(void);
+extern bool ParallelRedoDispatch(XLogReaderState *record);
+extern void ParallelRedoDrain(void);
+extern void ParallelRedoStop(void);
+
+/* in any process replaying WAL */
+extern bool ParallelRedoLockExtension(RelFileNode rnode, ForkNumber forknum);
+extern void ParallelRedoUnlockExtension(RelFileNode rnode, ForkNumber forknum);
+
+/* in a parallel redo worker */
+extern bool IsParallelRedoWorker(void);
+extern void ParallelRedoRememberInvalidPage(RelFileNode node, ForkNumber forkno,
+											BlockNumber blkno, bool present);
+extern void ParallelRedoWorkerMain(Datum main_arg);
+
+#endif							/* PARALLELREDO_H */
@@ -136,6 +136,16 @@ typedef struct IndexScanDescData
 
 	bool		xs_recheck;		/* T means scan keys must be rechecked */
 
+	/*
+	 * Optional caller-supplied callback.  Index AMs that collect the matches
+	 * of a whole index page at a time may pass it the heap TIDs they are
+	 * about to return, in scan order, so that the caller can issue prefetch
+	 * requests for the heap pages it will need to visit.
+	 */
+	void		(*xs_prefetch_heap) (struct IndexScanDescData *scan,
+									 ItemPointer tids, int ntids);
+	void	   *xs_prefetch_arg;	/* private state for xs_prefetch_heap */
+
 	/*
 	 * When fetching with an ordering operator, the values of the ORDER BY
 	 * expressions of the last returned tuple, according to the index.  If
@@ -125,6 +125,8 @@ typedef struct SpGistState
 	SpGistTypeDesc attPrefixType;	/* type of inner-tuple prefix values */
 	SpGistTypeDesc attLabelType;	/* type of node label values */
 
+	TupleDesc	inclTupDesc;	/* descriptor of INCLUDE columns, or NULL */
+
 	char	   *deadTupleStorage;	/* workspace for spgFormDeadTuple */
 
 	TransactionId myXid;		/* XID to use when creating a redirect tuple */
@@ -139,6 +141,7 @@ typedef struct SpGistSearchItem
 	void	   *traversalValue; /* opclass-specific traverse value */
 	int			level;			/* level of items on this page */
 	ItemPointerData heapPtr;	/* heap info, if heap tuple */
+	struct SpGistLeafTupleData *leafTuple;	/* leaf tuple copy, if needed */
 	bool		isNull;			/* SearchItem is NULL item */
 	bool		isLeaf;			/* SearchItem is heap item */
 	bool		recheck;		/* qual recheck is needed */
@@ -225,6 +228,8 @@ typedef struct SpGistCache
 	SpGistTypeDesc attPrefixType;	/* type of inner-tuple prefix values */
 	SpGistTypeDesc attLabelType;	/* type of node label values */
 
+	TupleDesc	inclTupDesc;	/* descriptor of INCLUDE columns, or NULL */
+
 	SpGistLUPCache lastUsedPages;	/* local storage of last-used info */
 } SpGistCache;
 
@@ -329,6 +334,12 @@ typedef SpGistNodeTupleData *SpGistNodeTuple;
  * however, the SGDTSIZE limit ensures that's there's a Datum word there
  * anyway, so SGLTDATUM can be applied safely as long as you don't do
  * anything with the result.
+ *
+ * If the index has INCLUDE columns, their values follow the leaf datum
+ * (which occupies no space at all if it's NULL): first a null bitmap with
+ * one bit per INCLUDE column, then, starting at the next MAXALIGN boundary,
+ * the non-null values laid out as in a heap tuple.  Use spgDeformLeafTuple
+ * to fetch them.  Indexes without INCLUDE columns have no such data.
  */
 typedef struct SpGistLeafTupleData
 {
@@ -434,9 +445,13 @@ extern void SpGistInitPage(Page page, uint16 f);
 extern void SpGistInitBuffer(Buffer b, uint16 f);
 extern void SpGistInitMetapage(Page page);
 extern unsigned int SpGistGetTypeSize(SpGistTypeDesc *att, Datum datum);
+extern Size SpGistGetLeafTupleSize(SpGistState *state,
+								   Datum *datums, bool *isnulls);
 extern SpGistLeafTuple spgFormLeafTuple(SpGistState *state,
 										ItemPointer heapPtr,
-										Datum datum, bool isnull);
+										Datum *datums, bool *isnulls);
+extern void spgDeformLeafTuple(SpGistState *state, SpGistLeafTuple tup,
+							   bool keyIsNull, Datum *datums, bool *isnulls);
 extern SpGistNodeTuple spgFormNodeTuple(SpGistState *state,
 										Datum label, bool isnull);
 extern SpGistInnerTuple spgFormInnerTuple(SpGistState *state,
@@ -462,7 +477,7 @@ extern void spgPageIndexMultiDelete(SpGistState *state, Page page,
 									int firststate, int reststate,
 									BlockNumber blkno, OffsetNumber offnum);
 extern bool spgdoinsert(Relation index, SpGistState *state,
-						ItemPointer heapPtr, Datum datum, bool isnull);
+						ItemPointer heapPtr, Datum *datums, bool *isnulls);
 
 /* spgproc.c */
 extern double *spg_key_orderbys_distances(Datum key, bool isLeaf,
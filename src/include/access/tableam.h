@@ -48,17 +48,18 @@ typedef enum ScanOptions
 	SO_TYPE_BITMAPSCAN = 1 << 1,
 	SO_TYPE_SAMPLESCAN = 1 << 2,
 	SO_TYPE_ANALYZE = 1 << 3,
+	SO_TYPE_TIDRANGESCAN = 1 << 4,
 
 	/* several of SO_ALLOW_* may be specified */
 	/* allow or disallow use of access strategy */
-	SO_ALLOW_STRAT = 1 << 4,
+	SO_ALLOW_STRAT = 1 << 5,
 	/* report location to syncscan logic? */
-	SO_ALLOW_SYNC = 1 << 5,
+	SO_ALLOW_SYNC = 1 << 6,
 	/* verify visibility page-at-a-time? */
-	SO_ALLOW_PAGEMODE = 1 << 6,
+	SO_ALLOW_PAGEMODE = 1 << 7,
 
 	/* unregister snapshot at scan end? */
-	SO_TEMP_SNAPSHOT = 1 << 7
+	SO_TEMP_SNAPSHOT = 1 << 8
 } ScanOptions;
 
 /*
@@ -131,6 +132,9 @@ typedef struct TM_FailureData
 #define TABLE_INSERT_SKIP_FSM		0x0002
 #define TABLE_INSERT_FROZEN			0x0004
 #define TABLE_INSERT_NO_LOGICAL		0x0008
+/* 0x0010 is reserved for HEAP_INSERT_SPECULATIVE */
+#define TABLE_INSERT_PARALLEL		0x0020
+#define TABLE_INSERT_DIRECT			0x0040
 
 /* flag bits for table_tuple_lock */
 /* Follow tuples whose update is in progress if lock modes don't conflict  */
@@ -223,6 +227,51 @@ typedef struct TableAmRoutine
 									 ScanDirection direction,
 									 TupleTableSlot *slot);
 
+	/*
+	 * Optional callback, called by sequential scans before fetching the
+	 * first tuple, to tell the AM how the scan's tuples are going to be used.
+	 *
+	 * `attrs` contains the numbers of the attributes the caller is going to
+	 * look at, offset by FirstLowInvalidHeapAttributeNumber as computed by
+	 * pull_varattnos(); the AM need not fill in the other user attributes
+	 * (they may be returned as NULLs).  Attribute number zero means that the
+	 * whole row is needed.
+	 *
+	 * Every tuple returned is going to be checked by the caller against the
+	 * `nkeys` scan keys in `keys`, so the AM may skip tuples that can't
+	 * satisfy them, but it doesn't have to filter.  Each key compares an
+	 * attribute with a constant in the sense of the attribute type's default
+	 * btree operator family, using btree strategy numbers, and its sk_func
+	 * is that family's BTORDER_PROC comparison function for the attribute's
+	 * type and sk_subtype.
+	 *
+	 * If this is set, the planner avoids giving a sequential scan of the
+	 * relation a physical tlist, so that scans reference only the attributes
+	 * that are needed above them.
+	 */
+	void		(*scan_set_column_hints) (TableScanDesc scan,
+										  struct Bitmapset *attrs,
+										  int nkeys,
+										  struct ScanKeyData *keys);
+
+	/*
+	 * Optional callbacks for TID range scans, which an AM must either both
+	 * provide or both leave unset; the planner only considers TID range
+	 * scans if they're set.
+	 *
+	 * scan_set_tidrange restricts a scan begun with SO_TYPE_TIDRANGESCAN to
+	 * the tuples whose TIDs are between mintid and maxtid, inclusive; either
+	 * may be outside the relation.  It's called before the first tuple is
+	 * fetched, and again after each rescan.  scan_getnextslot_tidrange then
+	 * returns the next such tuple.
+	 */
+	void		(*scan_set_tidrange) (TableScanDesc scan,
+									  ItemPointer mintid,
+									  ItemPointer maxtid);
+	bool		(*scan_getnextslot_tidrange) (TableScanDesc scan,
+											  ScanDirection direction,
+											  TupleTableSlot *slot);
+
 
 	/* ------------------------------------------------------------------------
 	 * Parallel table scan related functions.
@@ -824,6 +873,64 @@ table_beginscan_analyze(Relation rel)
 	return rel->rd_tableam->scan_begin(rel, NULL, 0, NULL, NULL, flags);
 }
 
+/*
+ * table_beginscan_tidrange is the entry point for setting up a TableScanDesc
+ * for a TID range scan, returning the tuples from mintid to maxtid.
+ */
+static inline TableScanDesc
+table_beginscan_tidrange(Relation rel, Snapshot snapshot,
+						 ItemPointer mintid, ItemPointer maxtid)
+{
+	TableScanDesc sscan;
+	uint32		flags = SO_TYPE_TIDRANGESCAN | SO_ALLOW_PAGEMODE;
+
+	sscan = rel->rd_tableam->scan_begin(rel, snapshot, 0, NULL, NULL, flags);
+
+	/* Set the range of TIDs to scan */
+	sscan->rs_rd->rd_tableam->scan_set_tidrange(sscan, mintid, maxtid);
+
+	return sscan;
+}
+
+/*
+ * Restart a TID range scan, with a new range of TIDs.
+ */
+static inline void
+table_rescan_tidrange(TableScanDesc sscan, ItemPointer mintid,
+					  ItemPointer maxtid)
+{
+	sscan->rs_rd->rd_tableam->scan_rescan(sscan, NULL, false, false, false,
+										  false);
+	sscan->rs_rd->rd_tableam->scan_set_tidrange(sscan, mintid, maxtid);
+}
+
+/*
+ * Return the next tuple of a TID range scan, store in slot.
+ */
+static inline bool
+table_scan_getnextslot_tidrange(TableScanDesc sscan, ScanDirection direction,
+								TupleTableSlot *slot)
+{
+	slot->tts_tableOid = RelationGetRelid(sscan->rs_rd);
+	return sscan->rs_rd->rd_tableam->scan_getnextslot_tidrange(sscan,
+															   direction,
+															   slot);
+}
+
+/*
+ * Tell a sequential scan which attributes are needed and which quals will be
+ * applied to its tuples, if the AM wants to know.  See scan_set_column_hints
+ * in TableAmRoutine.
+ */
+static inline void
+table_scan_set_column_hints(TableScanDesc scan, struct Bitmapset *attrs,
+							int nkeys, struct ScanKeyData *keys)
+{
+	if (scan->rs_rd->rd_tableam->scan_set_column_hints)
+		scan->rs_rd->rd_tableam->scan_set_column_hints(scan, attrs,
+													   nkeys, keys);
+}
+
 /*
  * End relation scan.
  */
@@ -1108,6 +1215,17 @@ table_compute_xid_horizon_for_tuples(Relation rel,
  * where RelationIsLogicallyLogged(relation) is not yet accurate for the new
  * relation.
  *
+ * TABLE_INSERT_PARALLEL allows the insertion to be done by a parallel worker.
+ * It should only be specified by parallel operations whose leader has made
+ * sure that's safe, as parallel COPY FROM does.
+ *
+ * TABLE_INSERT_DIRECT allows the AM to build pages in private memory and
+ * write them out itself, bypassing shared buffers, when table_multi_insert()
+ * is called with a BulkInsertState.  It should only be specified for inserts
+ * into relfilenodes created during the current transaction, and the caller
+ * must not try to read the new tuples back, nor insert them into any index
+ * that would, until the BulkInsertState has been released.
+ *
  * Note that most of these options will be applied when inserting into the
  * heap's TOAST table, too, if the tuple requires any out-of-line data.
  *
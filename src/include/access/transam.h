@@ -182,6 +182,14 @@ typedef struct VariableCacheData
 	TransactionId latestCompletedXid;	/* newest XID that has committed or
 										 * aborted */
 
+	/*
+	 * Number of top-level transactions with XIDs completed since the server
+	 * started, incremented whenever the set of running XIDs shrinks or
+	 * latestCompletedXid advances.  Lets GetSnapshotData() reuse a snapshot
+	 * when nothing it depends on has changed.
+	 */
+	uint64		xactCompletionCount;
+
 	/*
 	 * These fields are protected by CLogTruncationLock
 	 */
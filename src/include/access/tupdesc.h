@@ -82,6 +82,8 @@ typedef struct TupleDescData
 	Oid			tdtypeid;		/* composite type ID for tuple type */
 	int32		tdtypmod;		/* typmod for tuple type */
 	int			tdrefcount;		/* reference count, or -1 if not counting */
+	int			tdnfixed;		/* # of leading fixed-width attributes, or -1
+								 * if not yet computed */
 	TupleConstr *constr;		/* constraints, or NULL if none */
 	/* attrs[N] is the description of Attribute Number N+1 */
 	FormData_pg_attribute attrs[FLEXIBLE_ARRAY_MEMBER];
@@ -99,6 +101,16 @@ extern TupleDesc CreateTupleDescCopy(TupleDesc tupdesc);
 
 extern TupleDesc CreateTupleDescCopyConstr(TupleDesc tupdesc);
 
+extern int	TupleDescComputeFixedPrefix(TupleDesc tupdesc);
+
+/*
+ * Number of leading attributes of tupdesc that have a fixed width, and hence
+ * a fixed offset (attcacheoff) in any tuple without nulls among them.
+ */
+#define TupleDescFixedPrefix(tupdesc) \
+	((tupdesc)->tdnfixed >= 0 ? (tupdesc)->tdnfixed : \
+	 TupleDescComputeFixedPrefix(tupdesc))
+
 #define TupleDescSize(src) \
 	(offsetof(struct TupleDescData, attrs) + \
 	 (src)->natts * sizeof(FormData_pg_attribute))
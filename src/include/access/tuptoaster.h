@@ -111,6 +111,21 @@
 #define VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer) \
 	((toast_pointer).va_extsize < (toast_pointer).va_rawsize - VARHDRSZ)
 
+/*
+ * Compression method IDs, as stored in the high-order bits of the raw size
+ * of a compressed datum (see VARCOMPRESS_4B_C).  These must never change,
+ * since they are stored on disk.  Data written before per-column
+ * compression methods existed has zero there, and so reads as pglz.
+ */
+#define TOAST_PGLZ_COMPRESSION_ID	0
+
+/*
+ * Compression method to use for columns whose attcompression is not set.
+ */
+#define DefaultCompressionMethod	ATTRIBUTE_COMPRESSION_PGLZ
+
+#define CompressionMethodIsValid(cm)	((cm) != '\0')
+
 /*
  * Macro to fetch the possibly-unaligned contents of an EXTERNAL datum
  * into a local "struct varatt_external" toast pointer.  This should be
@@ -210,7 +225,23 @@ extern HeapTuple toast_build_flattened_tuple(TupleDesc tupleDesc,
  *	Create a compressed version of a varlena datum, if possible
  * ----------
  */
-extern Datum toast_compress_datum(Datum value);
+extern Datum toast_compress_datum(Datum value, char cmethod);
+
+/* ----------
+ * toast_get_compression_method -
+ *
+ *	Return the compression method used for a varlena datum, or '\0' if
+ *	it isn't compressed
+ * ----------
+ */
+extern char toast_get_compression_method(struct varlena *attr);
+
+/* ----------
+ * Conversion between compression method names and attcompression values
+ * ----------
+ */
+extern char GetCompressionMethod(const char *name);
+extern const char *GetCompressionMethodName(char cmethod);
 
 /* ----------
  * toast_raw_datum_size -
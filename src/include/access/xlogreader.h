@@ -133,6 +133,10 @@ struct XLogReaderState
 	uint32		main_data_len;	/* main data portion's length */
 	uint32		main_data_bufsz;	/* allocated size of the buffer */
 
+	/* buffer holding the decompressed payload of a compressed record */
+	char	   *decompression_buf;
+	uint32		decompression_bufsz;	/* allocated size of the buffer */
+
 	RepOriginId record_origin;
 
 	/* information about blocks referenced by the record. */
@@ -79,6 +79,24 @@ typedef struct XLogRecord
  */
 #define XLR_CHECK_CONSISTENCY	0x02
 
+/*
+ * If wal_record_compression is enabled, the whole payload of a record, that
+ * is everything that follows the XLogRecord struct, may be compressed with
+ * pglz.  In that case this flag is set, and the XLogRecord struct is
+ * followed by a uint32 holding the uncompressed length of the payload, and
+ * then by the compressed payload.  Once decompressed, the payload has the
+ * usual layout.  This flag is set only by XLogInsert.
+ */
+#define XLR_COMPRESSED			0x04
+
+/*
+ * Records are only compressed as a whole if their payload is between these
+ * sizes.  Smaller records don't gain much, and the upper limit bounds the
+ * size of the buffers needed to compress a record.
+ */
+#define XLR_COMPRESS_MIN_LEN	512
+#define XLR_COMPRESS_MAX_LEN	(4 * BLCKSZ)
+
 /*
  * Header info for block data appended to an XLOG record.
  *
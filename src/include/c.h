@@ -1056,6 +1056,22 @@ typedef union PGAlignedXLogBlock
 	int64		force_align_i64;
 } PGAlignedXLogBlock;
 
+/*
+ * Same as PGAlignedBlock, but aligned for direct I/O (see PG_IO_ALIGN_SIZE).
+ * Use this for local page buffers that are read or written through smgr.
+ * Compilers lacking pg_attribute_aligned only give MAXALIGN here; md.c
+ * copes with that by bouncing such buffers through an aligned one.
+ */
+typedef union PGIOAlignedBlock
+{
+#ifdef pg_attribute_aligned
+	pg_attribute_aligned(PG_IO_ALIGN_SIZE)
+#endif
+	char		data[BLCKSZ];
+	double		force_align_d;
+	int64		force_align_i64;
+} PGIOAlignedBlock;
+
 /* msb for char */
 #define HIGHBIT					(0x80)
 #define IS_HIGHBIT_SET(ch)		((unsigned char)(ch) & HIGHBIT)
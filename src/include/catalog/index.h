@@ -78,6 +78,9 @@ extern Oid	index_create(Relation heapRelation,
 #define	INDEX_CONSTR_CREATE_UPDATE_INDEX	(1 << 3)
 #define	INDEX_CONSTR_CREATE_REMOVE_OLD_DEPS	(1 << 4)
 
+extern Oid	index_create_copy(Relation heapRelation, bits16 flags,
+							  Oid oldIndexId, const char *newName);
+
 extern Oid	index_concurrently_create_copy(Relation heapRelation,
 										   Oid oldIndexId,
 										   const char *newName);
@@ -125,6 +128,8 @@ extern void index_build(Relation heapRelation,
 						bool isreindex,
 						bool parallel);
 
+extern void index_build_global_temp(Relation indexRelation);
+
 extern void validate_index(Oid heapId, Oid indexId, Snapshot snapshot);
 
 extern void index_set_state_flags(Oid indexId, IndexStateFlagsAction action);
@@ -143,6 +143,12 @@ CATALOG(pg_attribute,1249,AttributeRelationId) BKI_BOOTSTRAP BKI_ROWTYPE_OID(75,
 	/* One of the ATTRIBUTE_GENERATED_* constants below, or '\0' */
 	char		attgenerated BKI_DEFAULT('\0');
 
+	/*
+	 * Compression method used for new compressed values of this column, or
+	 * '\0' to use the default method.  Only meaningful for varlena columns.
+	 */
+	char		attcompression BKI_DEFAULT('\0');
+
 	/* Is dropped (ie, logically invisible) or not */
 	bool		attisdropped BKI_DEFAULT(f);
 
@@ -206,6 +212,8 @@ typedef FormData_pg_attribute *Form_pg_attribute;
 
 #define		  ATTRIBUTE_GENERATED_STORED	's'
 
+#define		  ATTRIBUTE_COMPRESSION_PGLZ	'p'
+
 #endif							/* EXPOSE_TO_CLIENT_CODE */
 
 #endif							/* PG_ATTRIBUTE_H */
@@ -20,6 +20,10 @@
 #include "utils/relcache.h"
 
 extern SMgrRelation RelationCreateStorage(RelFileNode rnode, char relpersistence);
+extern void RelationInitLocalStorage(Relation rel);
+extern void RelationSetLocalFrozenXids(RelFileNode rnode,
+									   TransactionId frozenxid,
+									   MultiXactId minmulti);
 extern void RelationDropStorage(Relation rel);
 extern void RelationPreserveStorage(RelFileNode rnode, bool atCommit);
 extern void RelationTruncate(Relation rel, BlockNumber nblocks);
@@ -18,8 +18,15 @@
 #include "utils/relcache.h"
 
 
+/* name of the built-in output plugin used by CLUSTER CONCURRENTLY */
+#define CLUSTER_DECODING_PLUGIN "pg_cluster"
+
+struct OutputPluginCallbacks;
+
 extern void cluster(ClusterStmt *stmt, bool isTopLevel);
 extern void cluster_rel(Oid tableOid, Oid indexOid, int options);
+extern void cluster_concurrently(Oid tableOid, Oid indexOid, bool verbose);
+extern void cluster_decoding_init(struct OutputPluginCallbacks *cb);
 extern void check_index_is_clusterable(Relation OldHeap, Oid indexOid,
 									   bool recheck, LOCKMODE lockmode);
 extern void mark_index_clustered(Relation rel, Oid indexOid, bool is_internal);
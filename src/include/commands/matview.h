@@ -30,4 +30,8 @@ extern DestReceiver *CreateTransientRelDestReceiver(Oid oid);
 
 extern bool MatViewIncrementalMaintenanceIsEnabled(void);
 
+extern void CheckIvmQuery(Query *query);
+extern void AddIvmHiddenColumns(Query *query);
+extern void CreateIvmTriggers(Oid matviewOid, Query *query);
+
 #endif							/* MATVIEW_H */
@@ -51,6 +51,12 @@ typedef struct xl_seq_rec
 	/* SEQUENCE TUPLE DATA FOLLOWS AT THE END */
 } xl_seq_rec;
 
+/* GUC variable */
+extern bool shared_sequence_cache;
+
+extern Size SequenceShmemSize(void);
+extern void SequenceShmemInit(void);
+
 extern int64 nextval_internal(Oid relid, bool check_permissions);
 extern Datum nextval(PG_FUNCTION_ARGS);
 extern List *sequence_options(Oid relid);
@@ -20,7 +20,9 @@
 #include "catalog/pg_type.h"
 #include "nodes/parsenodes.h"
 #include "storage/buf.h"
+#include "storage/dsm.h"
 #include "storage/lock.h"
+#include "storage/shm_toc.h"
 #include "utils/relcache.h"
 
 
@@ -184,6 +186,20 @@ typedef struct VacuumParams
 										 * default value depends on reloptions */
 	VacOptTernaryValue truncate;	/* Truncate empty pages at the end,
 									 * default value depends on reloptions */
+
+	/*
+	 * The number of parallel workers to use for vacuuming indexes and for
+	 * computing column statistics.  0 means to choose based on the number of
+	 * indexes or the size of the sample, -1 disables parallelism.
+	 */
+	int			nworkers;
+
+	/*
+	 * The number of pages of the table, starting where the previous such
+	 * vacuum left off, in which all-visible but not all-frozen pages are
+	 * scanned and frozen ahead of an aggressive vacuum.  0 disables this.
+	 */
+	int			eager_freeze_pages;
 } VacuumParams;
 
 /* GUC parameters */
@@ -192,6 +208,7 @@ extern int	vacuum_freeze_min_age;
 extern int	vacuum_freeze_table_age;
 extern int	vacuum_multixact_freeze_min_age;
 extern int	vacuum_multixact_freeze_table_age;
+extern bool vacuum_eager_freeze;
 
 
 /* in commands/vacuum.c */
@@ -234,6 +251,7 @@ extern void analyze_rel(Oid relid, RangeVar *relation,
 						VacuumParams *params, List *va_cols, bool in_outer_xact,
 						BufferAccessStrategy bstrategy);
 extern bool std_typanalyze(VacAttrStats *stats);
+extern void parallel_analyze_main(dsm_segment *seg, shm_toc *toc);
 
 /* in utils/misc/sampling.c --- duplicate of declarations in utils/sampling.h */
 extern double anl_random_fract(void);
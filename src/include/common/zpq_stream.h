@@ -0,0 +1,55 @@
+/*
+ * zpq_stream.h
+ *	  Streaming compression for the frontend/backend protocol.
+ *
+ * Portions Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * src/include/common/zpq_stream.h
+ */
+#ifndef ZPQ_STREAM_H
+#define ZPQ_STREAM_H
+
+/*
+ * Compression algorithms that can be negotiated with the _pq_.compression
+ * startup option.  The names used on the wire are given by
+ * zpq_algorithm_name(); ZPQ_NONE means no compression.
+ */
+typedef enum ZpqAlgorithm
+{
+	ZPQ_NONE = 0,
+	ZPQ_ZLIB
+} ZpqAlgorithm;
+
+#define ZPQ_NUM_ALGORITHMS	(ZPQ_ZLIB + 1)
+
+/* Bytes passed through a stream, in both directions */
+typedef struct ZpqCounters
+{
+	uint64		raw_sent;		/* bytes given to zpq_compress */
+	uint64		compressed_sent;	/* bytes it produced */
+	uint64		compressed_received;	/* bytes fed to the stream */
+	uint64		raw_received;	/* bytes zpq_decompress produced */
+} ZpqCounters;
+
+typedef struct ZpqStream ZpqStream;
+
+extern const char *zpq_algorithm_name(ZpqAlgorithm algorithm);
+extern bool zpq_algorithm_supported(ZpqAlgorithm algorithm);
+extern ZpqAlgorithm zpq_parse_algorithm(const char *name);
+extern ZpqAlgorithm zpq_choose_algorithm(const char *list);
+
+extern ZpqStream *zpq_create(ZpqAlgorithm algorithm);
+extern void zpq_free(ZpqStream *zs);
+extern ZpqAlgorithm zpq_algorithm(ZpqStream *zs);
+extern const ZpqCounters *zpq_counters(ZpqStream *zs);
+
+extern int	zpq_compress(ZpqStream *zs, const char *src, size_t len,
+						 const char **dst, size_t *dstlen);
+
+extern char *zpq_rx_space(ZpqStream *zs, size_t *space);
+extern void zpq_rx_added(ZpqStream *zs, size_t len);
+extern bool zpq_rx_feed(ZpqStream *zs, const char *src, size_t len);
+extern bool zpq_rx_pending(ZpqStream *zs);
+extern ssize_t zpq_decompress(ZpqStream *zs, char *dst, size_t len);
+
+#endif							/* ZPQ_STREAM_H */
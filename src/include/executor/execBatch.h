@@ -0,0 +1,98 @@
+/*-------------------------------------------------------------------------
+ *
+ * execBatch.h
+ *	  Batch-at-a-time evaluation of scan quals and simple aggregates.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/executor/execBatch.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECBATCH_H
+#define EXECBATCH_H
+
+#include "nodes/execnodes.h"
+#include "nodes/primnodes.h"
+
+/* upper limit for executor_batch_size */
+#define MAX_EXECUTOR_BATCH_SIZE		8192
+
+/* GUC variable */
+extern int	executor_batch_size;
+
+/*
+ * How the values of a batch column are stored.  Columns that are only tested
+ * for NULL-ness can be of any type.
+ */
+typedef enum BatchColumnKind
+{
+	BATCH_COL_NULLONLY,			/* only isnull[] is filled in */
+	BATCH_COL_INT,				/* int2, int4 or int8, widened to int64 */
+	BATCH_COL_FLOAT				/* float8 */
+} BatchColumnKind;
+
+/*
+ * One column of a batch, extracted from the batch's tuples.  Entries for
+ * NULL values are not valid in ints[] or floats[].
+ */
+typedef struct BatchColumn
+{
+	AttrNumber	attnum;			/* attribute number in the tuples */
+	Oid			typid;			/* type of the attribute */
+	BatchColumnKind kind;
+	bool	   *isnull;
+	int64	   *ints;			/* for BATCH_COL_INT */
+	float8	   *floats;			/* for BATCH_COL_FLOAT */
+} BatchColumn;
+
+/*
+ * A batch of tuples from a scan, with the columns needed by batch quals and
+ * aggregates pulled out into arrays.  sel[] lists, in scan order, the indexes
+ * of the rows that passed the quals evaluated so far.
+ */
+typedef struct TupleBatch
+{
+	int			maxrows;		/* allocated number of rows */
+	int			nrows;			/* number of valid slots */
+	int			nslots;			/* number of slots created so far */
+	TupleTableSlot **slots;		/* the tuples themselves */
+	int			nsel;			/* number of valid entries in sel[] */
+	int		   *sel;			/* selected rows */
+	int			ncols;			/* number of valid entries in cols[] */
+	BatchColumn *cols;			/* extracted columns */
+	AttrNumber	maxattnum;		/* highest attnum in cols[] */
+
+	/* for creating more slots, see ExecBatchReserveSlots */
+	EState	   *estate;
+	TupleDesc	desc;
+	const TupleTableSlotOps *tts_ops;
+} TupleBatch;
+
+typedef struct BatchQual BatchQual;
+typedef struct BatchAggState BatchAggState;
+
+extern TupleBatch *ExecCreateTupleBatch(EState *estate, TupleDesc desc,
+										const TupleTableSlotOps *tts_ops,
+										int maxrows);
+extern int	ExecBatchAddColumn(TupleBatch *batch, AttrNumber attnum,
+							   Oid typid, bool need_values);
+extern void ExecBatchReserveSlots(TupleBatch *batch, int nrows);
+extern void ExecBatchClear(TupleBatch *batch);
+extern void ExecBatchExtractColumns(TupleBatch *batch);
+
+extern bool ExecQualHasBatchClauses(List *qual, Index scanrelid);
+extern BatchQual *ExecInitBatchQual(List *qual, Index scanrelid,
+									TupleBatch *batch, List **residual);
+extern void ExecBatchQualEval(BatchQual *bqual, TupleBatch *batch);
+
+extern bool ExecBatchAggSupported(Aggref *aggref);
+extern BatchAggState *ExecInitBatchAgg(Aggref *aggref, TupleBatch *batch);
+extern void ExecBatchAggReset(BatchAggState *state);
+extern void ExecBatchAggAdvance(BatchAggState *state, TupleBatch *batch);
+extern void ExecBatchAggFinal(BatchAggState *state, Datum *value,
+							  bool *isnull);
+
+#endif							/* EXECBATCH_H */
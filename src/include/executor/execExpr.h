@@ -20,6 +20,7 @@
 /* forward references to avoid circularity */
 struct ExprEvalStep;
 struct SubscriptingRefState;
+struct ScalarArrayOpExprHashTable;
 
 /* Bits in ExprState->flags (see also execnodes.h for public flag bits): */
 /* expression's interpreter has been initialized */
@@ -213,6 +214,7 @@ typedef enum ExprEvalOp
 	/* evaluate assorted special-purpose expression types */
 	EEOP_CONVERT_ROWTYPE,
 	EEOP_SCALARARRAYOP,
+	EEOP_HASHED_SCALARARRAYOP,
 	EEOP_XMLEXPR,
 	EEOP_AGGREF,
 	EEOP_GROUPING_FUNC,
@@ -227,8 +229,10 @@ typedef enum ExprEvalOp
 	EEOP_AGG_STRICT_INPUT_CHECK_NULLS,
 	EEOP_AGG_INIT_TRANS,
 	EEOP_AGG_STRICT_TRANS_CHECK,
+	EEOP_AGG_PLAIN_PERGROUP_NULLCHECK,
 	EEOP_AGG_PLAIN_TRANS_BYVAL,
 	EEOP_AGG_PLAIN_TRANS,
+	EEOP_AGG_PLAIN_TRANS_INLINE,
 	EEOP_AGG_ORDERED_TRANS_DATUM,
 	EEOP_AGG_ORDERED_TRANS_TUPLE,
 
@@ -236,6 +240,26 @@ typedef enum ExprEvalOp
 	EEOP_LAST
 } ExprEvalOp;
 
+/*
+ * Transition (or combine) functions that EEOP_AGG_PLAIN_TRANS_INLINE
+ * evaluates directly, without going through the function manager.  Only
+ * used for by-value transition types.
+ */
+typedef enum AggTransInlineFn
+{
+	AGG_TRANS_INLINE_NONE = 0,
+	AGG_TRANS_INLINE_INT8INC,	/* int8inc, int8inc_any: count() */
+	AGG_TRANS_INLINE_INT8PL,	/* int8pl: combining count() */
+	AGG_TRANS_INLINE_INT4_SUM,	/* int4_sum: sum(int4) */
+	AGG_TRANS_INLINE_FLOAT8PL,	/* float8pl: sum(float8) */
+	AGG_TRANS_INLINE_INT4LARGER,	/* max(int4) */
+	AGG_TRANS_INLINE_INT4SMALLER,	/* min(int4) */
+	AGG_TRANS_INLINE_INT8LARGER,	/* max(int8) */
+	AGG_TRANS_INLINE_INT8SMALLER,	/* min(int8) */
+	AGG_TRANS_INLINE_FLOAT8LARGER,	/* max(float8) */
+	AGG_TRANS_INLINE_FLOAT8SMALLER	/* min(float8) */
+} AggTransInlineFn;
+
 
 typedef struct ExprEvalStep
 {
@@ -547,6 +571,22 @@ typedef struct ExprEvalStep
 			PGFunction	fn_addr;	/* actual call address */
 		}			scalararrayop;
 
+		/* for EEOP_HASHED_SCALARARRAYOP */
+		struct
+		{
+			bool		has_nulls;	/* does the array contain NULLs? */
+			/* hash table of the array's elements, built at first use: */
+			struct ScalarArrayOpExprHashTable *elements_tab;
+			FmgrInfo   *finfo;	/* equality function's lookup data */
+			FunctionCallInfo fcinfo_data;	/* arguments etc */
+			/* faster to access without additional indirection: */
+			PGFunction	fn_addr;	/* actual call address */
+			FmgrInfo   *hash_finfo; /* hash function's lookup data */
+			FunctionCallInfo hash_fcinfo_data;	/* arguments etc */
+			/* faster to access without additional indirection: */
+			PGFunction	hash_fn_addr;	/* actual call address */
+		}			hashedscalararrayop;
+
 		/* for EEOP_XMLEXPR */
 		struct
 		{
@@ -644,6 +684,13 @@ typedef struct ExprEvalStep
 			int			jumpnull;
 		}			agg_strict_trans_check;
 
+		/* for EEOP_AGG_PLAIN_PERGROUP_NULLCHECK */
+		struct
+		{
+			int			setoff;
+			int			jumpnull;
+		}			agg_plain_pergroup_nullcheck;
+
 		/* for EEOP_AGG_{PLAIN,ORDERED}_TRANS* */
 		struct
 		{
@@ -653,6 +700,8 @@ typedef struct ExprEvalStep
 			int			setno;
 			int			transno;
 			int			setoff;
+			/* for EEOP_AGG_PLAIN_TRANS_INLINE */
+			AggTransInlineFn inlinefn;
 		}			agg_trans;
 	}			d;
 } ExprEvalStep;
@@ -742,6 +791,8 @@ extern void ExecEvalSubscriptingRefAssign(ExprState *state, ExprEvalStep *op);
 extern void ExecEvalConvertRowtype(ExprState *state, ExprEvalStep *op,
 								   ExprContext *econtext);
 extern void ExecEvalScalarArrayOp(ExprState *state, ExprEvalStep *op);
+extern void ExecEvalHashedScalarArrayOp(ExprState *state, ExprEvalStep *op,
+										ExprContext *econtext);
 extern void ExecEvalConstraintNotNull(ExprState *state, ExprEvalStep *op);
 extern void ExecEvalConstraintCheck(ExprState *state, ExprEvalStep *op);
 extern void ExecEvalXmlExpr(ExprState *state, ExprEvalStep *op);
@@ -756,6 +807,8 @@ extern void ExecEvalSysVar(ExprState *state, ExprEvalStep *op,
 						   ExprContext *econtext, TupleTableSlot *slot);
 
 extern void ExecAggInitGroup(AggState *aggstate, AggStatePerTrans pertrans, AggStatePerGroup pergroup);
+extern void ExecAggPlainTransInline(ExprState *state, ExprEvalStep *op,
+									ExprContext *econtext);
 extern Datum ExecAggTransReparent(AggState *aggstate, AggStatePerTrans pertrans,
 								  Datum newValue, bool newValueIsNull,
 								  Datum oldValue, bool oldValueIsNull);
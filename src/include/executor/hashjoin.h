@@ -159,6 +159,7 @@ typedef struct ParallelHashJoinBatch
 	size_t		ntuples;		/* number of tuples loaded */
 	size_t		old_ntuples;	/* number of tuples before repartitioning */
 	bool		space_exhausted;
+	bool		claimed;		/* striped batch taken by one participant */
 
 	/*
 	 * Variable-sized SharedTuplestore objects follow this struct in memory.
@@ -243,6 +244,8 @@ typedef struct ParallelHashJoinState
 	int			nparticipants;
 	size_t		space_allowed;
 	size_t		total_tuples;	/* total number of inner tuples */
+	dsa_pointer skew_hashes;	/* sorted array of outer MCV hash values */
+	int			nskew_hashes;	/* number of them, or 0 if not in use */
 	LWLock		lock;			/* lock protecting the above */
 
 	Barrier		build_barrier;	/* synchronization for the build phases */
@@ -307,6 +310,16 @@ typedef struct HashJoinTableData
 	int			nSkewBuckets;	/* number of active skew buckets */
 	int		   *skewBucketNums; /* array indexes of active skew buckets */
 
+	/* Parallel Hash uses a shared set of MCV hash values instead */
+	uint32	   *parallelSkewHashes;
+
+	/*
+	 * Parallel Hash: inner tuple that didn't fit into the current stripe of
+	 * an oversized batch, which will start the next one.
+	 */
+	MinimalTuple stripeTuple;
+	uint32		stripeHashValue;
+
 	int			nbatch;			/* number of batches */
 	int			curbatch;		/* current batch #; 0 during 1st pass */
 
@@ -359,4 +372,31 @@ typedef struct HashJoinTableData
 	dsa_pointer current_chunk_shared;
 }			HashJoinTableData;
 
+/*
+ * A Bloom filter over the hash values of the inner tuples of a hash join
+ * whose outer plan is a SeqScan, built along with a private hash table.  The
+ * scan computes the hash value of each of its tuples, the same way the join
+ * would, and skips those that can't be in the hash table.  Each hash value
+ * sets two bits, one chosen by the value itself and one by a remix of it.
+ *
+ * The filter isn't used while (re)building the hash table, nor if it turns
+ * out too full to be selective; and the scan stops testing its tuples if
+ * few of the first BLOOM_TRIAL_TUPLES are removed.
+ */
+#define BLOOM_TRIAL_TUPLES	1024
+
+typedef struct HashBloomFilterData
+{
+	uint64	   *bits;			/* the bitmap, of mask + 1 bits */
+	uint32		mask;			/* the number of bits is a power of 2 */
+	bool		active;			/* may the scan use it now? */
+	bool		disabled;		/* has the scan given up on it? */
+	List	   *keys;			/* outer hash keys, as ExprStates of the scan */
+	FmgrInfo   *hashfunctions;	/* outer hash functions */
+	bool	   *hashStrict;		/* is each hash join operator strict? */
+	Oid		   *collations;
+	uint64		ntested;		/* tuples tested by the scan so far */
+	uint64		nremoved;		/* ... and found not to be in the filter */
+}			HashBloomFilterData;
+
 #endif							/* HASHJOIN_H */
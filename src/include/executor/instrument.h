@@ -28,31 +28,58 @@ typedef struct BufferUsage
 	long		local_blks_written; /* # of local disk blocks written */
 	long		temp_blks_read; /* # of temp blocks read */
 	long		temp_blks_written;	/* # of temp blocks written */
+	long		shared_blks_prefetched; /* # of shared prefetches issued */
+	long		shared_blks_prefetch_hit;	/* # of prefetches of blocks
+											 * already in shared buffers */
 	instr_time	blk_read_time;	/* time spent reading */
 	instr_time	blk_write_time; /* time spent writing */
 } BufferUsage;
 
+typedef struct WalUsage
+{
+	long		wal_records;	/* # of WAL records produced */
+	long		wal_fpi;		/* # of WAL full page images produced */
+	uint64		wal_bytes;		/* size of WAL records produced */
+} WalUsage;
+
 /* Flag bits included in InstrAlloc's instrument_options bitmask */
 typedef enum InstrumentOption
 {
 	INSTRUMENT_TIMER = 1 << 0,	/* needs timer (and row counts) */
 	INSTRUMENT_BUFFERS = 1 << 1,	/* needs buffer usage */
 	INSTRUMENT_ROWS = 1 << 2,	/* needs row count */
-	INSTRUMENT_ALL = PG_INT32_MAX
+	INSTRUMENT_WAL = 1 << 3,	/* needs WAL usage */
+	INSTRUMENT_TIMER_SAMPLED = 1 << 4,	/* time only some calls of a node */
+	/* everything, with exact rather than sampled timing */
+	INSTRUMENT_ALL = PG_INT32_MAX & ~INSTRUMENT_TIMER_SAMPLED
 } InstrumentOption;
 
+/*
+ * With INSTRUMENT_TIMER_SAMPLED, the first INSTR_SAMPLE_WARMUP calls of each
+ * loop are timed, then one call in every INSTR_SAMPLE_INTERVAL.  The time of
+ * the calls that were skipped is extrapolated at the end of the loop.
+ */
+#define INSTR_SAMPLE_WARMUP		16
+#define INSTR_SAMPLE_INTERVAL	16
+
 typedef struct Instrumentation
 {
 	/* Parameters set at node creation: */
 	bool		need_timer;		/* true if we need timer data */
 	bool		need_bufusage;	/* true if we need buffer usage data */
+	bool		need_walusage;	/* true if we need WAL usage data */
+	bool		sample_timer;	/* true if only some calls are timed */
 	/* Info about current plan cycle: */
 	bool		running;		/* true if we've completed first tuple */
+	bool		timing_call;	/* true if the current call is being timed */
+	uint64		ncalls;			/* # of calls of the node this cycle */
+	uint64		ntimed;			/* # of those calls that were timed */
 	instr_time	starttime;		/* Start time of current iteration of node */
 	instr_time	counter;		/* Accumulated runtime for this node */
 	double		firsttuple;		/* Time for first tuple of this cycle */
 	double		tuplecount;		/* Tuples emitted so far this cycle */
 	BufferUsage bufusage_start; /* Buffer usage at start */
+	WalUsage	walusage_start; /* WAL usage at start */
 	/* Accumulated statistics across all completed cycles: */
 	double		startup;		/* Total startup time (in seconds) */
 	double		total;			/* Total total time (in seconds) */
@@ -61,7 +88,9 @@ typedef struct Instrumentation
 	double		nloops;			/* # of run cycles for this node */
 	double		nfiltered1;		/* # tuples removed by scanqual or joinqual */
 	double		nfiltered2;		/* # tuples removed by "other" quals */
+	double		nfiltered3;		/* # tuples removed by a join's Bloom filter */
 	BufferUsage bufusage;		/* Total buffer usage */
+	WalUsage	walusage;		/* Total WAL usage */
 } Instrumentation;
 
 typedef struct WorkerInstrumentation
@@ -71,15 +100,19 @@ typedef struct WorkerInstrumentation
 } WorkerInstrumentation;
 
 extern PGDLLIMPORT BufferUsage pgBufferUsage;
+extern PGDLLIMPORT WalUsage pgWalUsage;
 
 extern Instrumentation *InstrAlloc(int n, int instrument_options);
 extern void InstrInit(Instrumentation *instr, int instrument_options);
 extern void InstrStartNode(Instrumentation *instr);
 extern void InstrStopNode(Instrumentation *instr, double nTuples);
+extern void InstrUpdateTupleCount(Instrumentation *instr, double nTuples);
 extern void InstrEndLoop(Instrumentation *instr);
 extern void InstrAggNode(Instrumentation *dst, Instrumentation *add);
 extern void InstrStartParallelQuery(void);
-extern void InstrEndParallelQuery(BufferUsage *result);
-extern void InstrAccumParallelQuery(BufferUsage *result);
+extern void InstrEndParallelQuery(BufferUsage *bufusage, WalUsage *walusage);
+extern void InstrAccumParallelQuery(BufferUsage *bufusage, WalUsage *walusage);
+extern void WalUsageAccumDiff(WalUsage *dst, const WalUsage *add,
+							  const WalUsage *sub);
 
 #endif							/* INSTRUMENT_H */
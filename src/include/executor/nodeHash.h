@@ -24,6 +24,14 @@ extern Node *MultiExecHash(HashState *node);
 extern void ExecEndHash(HashState *node);
 extern void ExecReScanHash(HashState *node);
 
+extern HashBloomFilter ExecHashBloomFilterCreate(HashState *node,
+												 PlanState *scanstate,
+												 List *bloomkeys,
+												 List *hashOperators,
+												 List *hashCollations);
+extern bool ExecHashBloomFilterTest(HashBloomFilter bloom,
+									ExprContext *econtext);
+
 extern HashJoinTable ExecHashTableCreate(HashState *state, List *hashOperators, List *hashCollations,
 										 bool keepNulls);
 extern void ExecParallelHashTableAlloc(HashJoinTable hashtable,
@@ -43,6 +51,10 @@ extern void ExecParallelHashTableInsert(HashJoinTable hashtable,
 extern void ExecParallelHashTableInsertCurrentBatch(HashJoinTable hashtable,
 													TupleTableSlot *slot,
 													uint32 hashvalue);
+extern bool ExecParallelHashTableInsertStripe(HashJoinTable hashtable,
+											  TupleTableSlot *slot,
+											  uint32 hashvalue);
+extern void ExecParallelHashTableResetBatch(HashJoinTable hashtable);
 extern bool ExecHashGetHashValue(HashJoinTable hashtable,
 								 ExprContext *econtext,
 								 List *hashkeys,
@@ -53,6 +65,10 @@ extern void ExecHashGetBucketAndBatch(HashJoinTable hashtable,
 									  uint32 hashvalue,
 									  int *bucketno,
 									  int *batchno);
+extern void ExecParallelHashGetBucketAndBatch(HashJoinTable hashtable,
+											  uint32 hashvalue,
+											  int *bucketno,
+											  int *batchno);
 extern bool ExecScanHashBucket(HashJoinState *hjstate, ExprContext *econtext);
 extern bool ExecParallelScanHashBucket(HashJoinState *hjstate, ExprContext *econtext);
 extern void ExecPrepHashTableForUnmatched(HashJoinState *hjstate);
@@ -15,6 +15,7 @@
 #define NODESEQSCAN_H
 
 #include "access/parallel.h"
+#include "executor/execBatch.h"
 #include "nodes/execnodes.h"
 
 extern SeqScanState *ExecInitSeqScan(SeqScan *node, EState *estate, int eflags);
@@ -28,4 +29,8 @@ extern void ExecSeqScanReInitializeDSM(SeqScanState *node, ParallelContext *pcxt
 extern void ExecSeqScanInitializeWorker(SeqScanState *node,
 										ParallelWorkerContext *pwcxt);
 
+/* batch mode support */
+extern TupleBatch *ExecSeqScanStartBatchMode(SeqScanState *node);
+extern TupleBatch *ExecSeqScanNextBatch(SeqScanState *node);
+
 #endif							/* NODESEQSCAN_H */
@@ -68,13 +68,18 @@ typedef void (*JitProviderInit) (JitProviderCallbacks *cb);
 typedef void (*JitProviderResetAfterErrorCB) (void);
 typedef void (*JitProviderReleaseContextCB) (JitContext *context);
 struct ExprState;
+struct EState;
 typedef bool (*JitProviderCompileExprCB) (struct ExprState *state);
+typedef bool (*JitProviderCompileStandaloneExprCB) (struct ExprState *state,
+													struct EState *estate);
 
 struct JitProviderCallbacks
 {
 	JitProviderResetAfterErrorCB reset_after_error;
 	JitProviderReleaseContextCB release_context;
 	JitProviderCompileExprCB compile_expr;
+	/* optional; may be NULL if the provider doesn't support it */
+	JitProviderCompileStandaloneExprCB compile_standalone_expr;
 };
 
 
@@ -89,6 +94,7 @@ extern bool jit_tuple_deforming;
 extern double jit_above_cost;
 extern double jit_inline_above_cost;
 extern double jit_optimize_above_cost;
+extern int	jit_warmup_calls;
 
 
 extern void jit_reset_after_error(void);
@@ -99,6 +105,8 @@ extern void jit_release_context(JitContext *context);
  * not be able to perform JIT (i.e. return false).
  */
 extern bool jit_compile_expr(struct ExprState *state);
+extern bool jit_compile_standalone_expr(struct ExprState *state,
+										struct EState *estate);
 extern void InstrJitAgg(JitInstrumentation *dst, JitInstrumentation *add);
 
 
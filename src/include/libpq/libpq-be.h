@@ -63,6 +63,7 @@ typedef struct
 #endif
 #endif							/* ENABLE_SSPI */
 
+#include "common/zpq_stream.h"
 #include "datatype/timestamp.h"
 #include "libpq/hba.h"
 #include "libpq/pqcomm.h"
@@ -184,6 +185,11 @@ typedef struct Port
 	void	   *gss;
 #endif
 
+	/*
+	 * Protocol compression stream, if compression was negotiated at startup.
+	 */
+	ZpqStream  *zpq_stream;
+
 	/*
 	 * SSL structures.
 	 */
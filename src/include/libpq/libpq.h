@@ -73,6 +73,7 @@ extern int	pq_getbyte(void);
 extern int	pq_peekbyte(void);
 extern int	pq_getbyte_if_available(unsigned char *c);
 extern int	pq_putbytes(const char *s, size_t len);
+extern void pq_enable_compression(ZpqStream *zs);
 
 /*
  * prototypes for functions in be-secure.c
@@ -16,7 +16,9 @@
 
 #include "access/tupconvert.h"
 #include "executor/instrument.h"
+#include "lib/ilist.h"
 #include "lib/pairingheap.h"
+#include "nodes/memnodes.h"
 #include "nodes/params.h"
 #include "nodes/plannodes.h"
 #include "partitioning/partdefs.h"
@@ -595,6 +597,13 @@ typedef struct EState
 	int			es_jit_flags;
 	struct JitContext *es_jit;
 	struct JitInstrumentation *es_jit_worker_instr;
+
+	/*
+	 * Tracks the most memory this process had allocated at once while
+	 * running the query, for EXPLAIN and extensions to report.  Started by
+	 * ExecutorStart and ended by ExecutorEnd.
+	 */
+	MemoryPeakTracker es_mem_peak;
 } EState;
 
 
@@ -953,6 +962,8 @@ typedef struct PlanState
 	/* Per-worker JIT instrumentation */
 	struct SharedJitInstrumentation *worker_jit_instrument;
 
+	bool		async_capable;	/* true if node is run asynchronously */
+
 	/*
 	 * Common structural data for all Plan types.  These links to subsidiary
 	 * state trees parallel links in the associated plan tree (except for the
@@ -1049,6 +1060,11 @@ typedef struct PlanState
 		if (((PlanState *)(node))->instrument) \
 			((PlanState *)(node))->instrument->nfiltered2 += (delta); \
 	} while(0)
+#define InstrCountFiltered3(node, delta) \
+	do { \
+		if (((PlanState *)(node))->instrument) \
+			((PlanState *)(node))->instrument->nfiltered3 += (delta); \
+	} while(0)
 
 /*
  * EPQState is state for executing an EvalPlanQual recheck on a candidate
@@ -1193,16 +1209,40 @@ typedef struct ModifyTableState
 	TupleConversionMap **mt_per_subplan_tupconv_maps;
 } ModifyTableState;
 
+/* ----------------
+ *	 AsyncRequest
+ *
+ * State for an asynchronous tuple request.  The requestor (an Append) asks
+ * the requestee (an async-capable subplan) for a tuple; the requestee either
+ * completes the request at once or marks it pending and produces the
+ * tuple later, when the wait event it configured fires.
+ * ----------------
+ */
+typedef struct AsyncRequest
+{
+	struct PlanState *requestor;	/* Node that wants a tuple */
+	struct PlanState *requestee;	/* Node from which a tuple is wanted */
+	int			request_index;	/* Scratch space for requestor */
+	bool		callback_pending;	/* Callback is needed */
+	bool		request_complete;	/* Request complete, result valid */
+	TupleTableSlot *result;		/* Result (NULL or an empty slot if no more
+								 * tuples) */
+} AsyncRequest;
+
 /* ----------------
  *	 AppendState information
  *
  *		nplans				how many plans are in the array
- *		whichplan			which plan is being executed (0 .. n-1), or a
- *							special negative value. See nodeAppend.c.
+ *		whichplan			which synchronous plan is being executed (0 ..
+ *							n-1), or a special negative value.  See
+ *							nodeAppend.c.
+ *		asyncplans			which appendplans are run asynchronously; see
+ *							the as_async* fields for their state.
  *		prune_state			details required to allow partitions to be
  *							eliminated from the scan, or NULL if not possible.
- *		valid_subplans		for runtime pruning, valid appendplans indexes to
- *							scan.
+ *		valid_subplans		for runtime pruning, valid synchronous
+ *							appendplans indexes to scan.
+ *		valid_asyncplans	likewise, for asynchronous appendplans.
  * ----------------
  */
 
@@ -1218,12 +1258,25 @@ struct AppendState
 	PlanState **appendplans;	/* array of PlanStates for my inputs */
 	int			as_nplans;
 	int			as_whichplan;
+	bool		as_begun;		/* false means need to initialize */
+	Bitmapset  *as_asyncplans;	/* asynchronous plans indexes */
+	int			as_nasyncplans; /* # of asynchronous plans */
+	AsyncRequest **as_asyncrequests;	/* array of AsyncRequests */
+	TupleTableSlot **as_asyncresults;	/* unreturned results of async plans */
+	int			as_nasyncresults;	/* # of valid entries in as_asyncresults */
+	bool		as_syncdone;	/* true if all synchronous plans done in
+								 * asynchronous mode, else false */
+	int			as_nasyncremain;	/* # of remaining asynchronous plans */
+	Bitmapset  *as_needrequest; /* asynchronous plans needing a new request */
+	struct WaitEventSet *as_eventset;	/* WaitEventSet used to configure
+										 * file descriptor wait events */
 	int			as_first_partial_plan;	/* Index of 'appendplans' containing
 										 * the first partial plan */
 	ParallelAppendState *as_pstate; /* parallel coordination info */
 	Size		pstate_len;		/* size of parallel coordination info */
 	struct PartitionPruneState *as_prune_state;
 	Bitmapset  *as_valid_subplans;
+	Bitmapset  *as_valid_asyncplans;	/* valid asynchronous plans indexes */
 	bool		(*choose_next_subplan) (AppendState *);
 };
 
@@ -1336,12 +1389,26 @@ typedef struct ScanState
 
 /* ----------------
  *	 SeqScanState information
+ *
+ *		batch_allowed	could batch mode be used for this scan?
+ *		batch			rows fetched ahead in batch mode, else NULL
+ *		batchqual		quals evaluated over a whole batch
+ *		residualqual	remaining quals, evaluated row by row
+ *		batch_next		next entry of batch->sel to return
+ *		batch_rows		number of rows to fetch into the next batch
  * ----------------
  */
 typedef struct SeqScanState
 {
 	ScanState	ss;				/* its first field is NodeTag */
 	Size		pscan_len;		/* size of parallel heap scan descriptor */
+	bool		batch_allowed;
+	struct TupleBatch *batch;
+	struct BatchQual *batchqual;
+	ExprState  *residualqual;
+	int			batch_next;
+	int			batch_rows;
+	struct HashBloomFilterData *bloom;	/* set by a parent HashJoin, if any */
 } SeqScanState;
 
 /* ----------------
@@ -1411,6 +1478,14 @@ typedef struct
  *		OrderByTypByVals   is the datatype of order by expression pass-by-value?
  *		OrderByTypLens	   typlens of the datatypes of order by expressions
  *		PscanLen		   size of parallel index scan descriptor
+ *
+ *		PrefetchMaximum    max heap pages to keep prefetched ahead of the scan
+ *		PrefetchTids	   heap TIDs of the index AM's current batch
+ *		PrefetchNumTids    number of valid entries in PrefetchTids
+ *		PrefetchNext	   next entry of PrefetchTids to consider prefetching
+ *		PrefetchPages	   # of heap pages prefetched but not yet visited
+ *		PrefetchBlock	   last heap block prefetched
+ *		CurrentBlock	   heap block of the last tuple returned
  * ----------------
  */
 typedef struct IndexScanState
@@ -1438,6 +1513,15 @@ typedef struct IndexScanState
 	bool	   *iss_OrderByTypByVals;
 	int16	   *iss_OrderByTypLens;
 	Size		iss_PscanLen;
+
+	/* These are needed for heap read-ahead */
+	int			iss_PrefetchMaximum;
+	ItemPointerData *iss_PrefetchTids;
+	int			iss_PrefetchNumTids;
+	int			iss_PrefetchNext;
+	int			iss_PrefetchPages;
+	BlockNumber iss_PrefetchBlock;
+	BlockNumber iss_CurrentBlock;
 } IndexScanState;
 
 /* ----------------
@@ -1457,6 +1541,7 @@ typedef struct IndexScanState
  *		TableSlot		   slot for holding tuples fetched from the table
  *		VMBuffer		   buffer in use for visibility map testing, if any
  *		PscanLen		   size of parallel index-only scan descriptor
+ *		PrefetchMaximum    max heap pages to prefetch per index page
  * ----------------
  */
 typedef struct IndexOnlyScanState
@@ -1476,6 +1561,7 @@ typedef struct IndexOnlyScanState
 	TupleTableSlot *ioss_TableSlot;
 	Buffer		ioss_VMBuffer;
 	Size		ioss_PscanLen;
+	int			ioss_PrefetchMaximum;
 } IndexOnlyScanState;
 
 /* ----------------
@@ -1533,11 +1619,7 @@ typedef enum
 /* ----------------
  *	 ParallelBitmapHeapState information
  *		tbmiterator				iterator for scanning current pages
- *		prefetch_iterator		iterator for prefetching ahead of current page
- *		mutex					mutual exclusion for the prefetching variable
- *								and state
- *		prefetch_pages			# pages prefetch iterator is ahead of current
- *		prefetch_target			current target prefetch distance
+ *		mutex					mutual exclusion for the state
  *		state					current state of the TIDBitmap
  *		cv						conditional wait variable
  *		phs_snapshot_data		snapshot data shared to workers
@@ -1546,10 +1628,7 @@ typedef enum
 typedef struct ParallelBitmapHeapState
 {
 	dsa_pointer tbmiterator;
-	dsa_pointer prefetch_iterator;
 	slock_t		mutex;
-	int			prefetch_pages;
-	int			prefetch_target;
 	SharedBitmapState state;
 	ConditionVariable cv;
 	char		phs_snapshot_data[FLEXIBLE_ARRAY_MEMBER];
@@ -1570,12 +1649,15 @@ typedef struct ParallelBitmapHeapState
  *		lossy_pages		   total number of lossy pages retrieved
  *		prefetch_iterator  iterator for prefetching ahead of current page
  *		prefetch_pages	   # pages prefetch iterator is ahead of current
+ *						   (parallel: # pages in prefetch_queue)
  *		prefetch_target    current target prefetch distance
  *		prefetch_maximum   maximum value for prefetch_target
  *		pscan_len		   size of the shared memory for parallel bitmap
  *		initialized		   is node is ready to iterate
  *		shared_tbmiterator	   shared iterator
- *		shared_prefetch_iterator shared iterator for prefetching
+ *		prefetch_queue	   pages claimed from shared iterator, parallel only
+ *		prefetch_head	   index of next page to scan in prefetch_queue
+ *		shared_exhausted   shared iterator has returned all pages
  *		pstate			   shared state for parallel bitmap scan
  * ----------------
  */
@@ -1599,7 +1681,9 @@ typedef struct BitmapHeapScanState
 	Size		pscan_len;
 	bool		initialized;
 	TBMSharedIterator *shared_tbmiterator;
-	TBMSharedIterator *shared_prefetch_iterator;
+	TBMIterateResult **prefetch_queue;
+	int			prefetch_head;
+	bool		shared_exhausted;
 	ParallelBitmapHeapState *pstate;
 } BitmapHeapScanState;
 
@@ -1625,6 +1709,24 @@ typedef struct TidScanState
 	HeapTupleData tss_htup;
 } TidScanState;
 
+/* ----------------
+ *	 TidRangeScanState information
+ *
+ *		trss_tidexprs		list of TidOpExpr structs (see nodeTidrangescan.c)
+ *		trss_mintid			the lowest TID in the scan range
+ *		trss_maxtid			the highest TID in the scan range
+ *		trss_inScan			is a scan currently in progress?
+ * ----------------
+ */
+typedef struct TidRangeScanState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	List	   *trss_tidexprs;
+	ItemPointerData trss_mintid;
+	ItemPointerData trss_maxtid;
+	bool		trss_inScan;
+} TidRangeScanState;
+
 /* ----------------
  *	 SubqueryScanState information
  *
@@ -1841,6 +1943,24 @@ typedef struct JoinState
  *		NeedNewOuter	   true if need new outer tuple on next call
  *		MatchedOuter	   true if found a join match for current outer tuple
  *		NullInnerTupleSlot prepared null tuple for left outer joins
+ *
+ *	The remaining fields are used only if the plan has hashclauses:
+ *
+ *		HashThreshold	   switch to hashing after this many outer tuples,
+ *						   or -1 if hashing has been given up on
+ *		OuterCount		   number of outer tuples fetched since (re)scan
+ *		Hashing			   true if probing HashTable instead of rescanning
+ *		HashSwitchRow	   OuterCount at the latest switch, for EXPLAIN
+ *		HashTable		   hash table of inner tuples, grouped by key
+ *		HashTableContext   memory context holding HashTable's contents
+ *		HashTempContext	   short-term context for hash table operations
+ *		InnerKeyContext    expression context for computing inner keys
+ *		InnerKeyProj	   computes the keys of an inner tuple
+ *		OuterKeyProj	   computes the keys of an outer tuple
+ *		OuterHashFunctions hash functions for the outer keys
+ *		CrossEqComp		   compares outer keys with those in HashTable
+ *		HashInnerSlot	   slot holding inner tuple fetched from HashTable
+ *		CurMatch		   next candidate inner tuple for current outer tuple
  * ----------------
  */
 typedef struct NestLoopState
@@ -1849,6 +1969,20 @@ typedef struct NestLoopState
 	bool		nl_NeedNewOuter;
 	bool		nl_MatchedOuter;
 	TupleTableSlot *nl_NullInnerTupleSlot;
+	double		nl_HashThreshold;
+	double		nl_OuterCount;
+	bool		nl_Hashing;
+	double		nl_HashSwitchRow;
+	TupleHashTable nl_HashTable;
+	MemoryContext nl_HashTableContext;
+	MemoryContext nl_HashTempContext;
+	ExprContext *nl_InnerKeyContext;
+	ProjectionInfo *nl_InnerKeyProj;
+	ProjectionInfo *nl_OuterKeyProj;
+	FmgrInfo   *nl_OuterHashFunctions;
+	ExprState  *nl_CrossEqComp;
+	TupleTableSlot *nl_HashInnerSlot;
+	struct NestLoopHashTuple *nl_CurMatch;
 } NestLoopState;
 
 /* ----------------
@@ -1927,6 +2061,7 @@ typedef struct MergeJoinState
 /* these structs are defined in executor/hashjoin.h: */
 typedef struct HashJoinTupleData *HashJoinTuple;
 typedef struct HashJoinTableData *HashJoinTable;
+typedef struct HashBloomFilterData *HashBloomFilter;
 
 typedef struct HashJoinState
 {
@@ -1948,6 +2083,7 @@ typedef struct HashJoinState
 	int			hj_JoinState;
 	bool		hj_MatchedOuter;
 	bool		hj_OuterNotEmpty;
+	HashBloomFilter hj_BloomFilter; /* filter for the outer SeqScan, or NULL */
 } HashJoinState;
 
 
@@ -1973,6 +2109,68 @@ typedef struct MaterialState
 	Tuplestorestate *tuplestorestate;
 } MaterialState;
 
+struct ResultCacheEntry;
+struct ResultCacheTuple;
+
+/* ----------------
+ *	 ResultCacheInstrumentation information
+ *
+ *		counters showing how well a Result Cache node did, for EXPLAIN
+ * ----------------
+ */
+typedef struct ResultCacheInstrumentation
+{
+	uint64		cache_hits;		/* number of rescans where we've found the
+								 * scan parameter values to be cached */
+	uint64		cache_misses;	/* number of rescans where we've not found the
+								 * scan parameter values to be cached. */
+	uint64		cache_evictions;	/* number of cache entries removed due to
+									 * the need to free memory */
+	uint64		cache_overflows;	/* number of times we've had to bypass the
+									 * cache when filling it due to not being
+									 * able to free enough space to store the
+									 * current scan's tuples. */
+	uint64		mem_peak;		/* peak memory usage in bytes */
+} ResultCacheInstrumentation;
+
+/* ----------------
+ *	 ResultCacheState information
+ *
+ *		resultcache nodes are used to cache recent and commonly seen results
+ *		from a parameterized scan.
+ * ----------------
+ */
+typedef struct ResultCacheState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	int			rc_status;		/* value of ExecResultCache state machine */
+	int			nkeys;			/* number of cache keys */
+	struct resultcache_hash *hashtable; /* hash table for cache entries */
+	TupleDesc	hashkeydesc;	/* tuple descriptor for cache keys */
+	TupleTableSlot *tableslot;	/* min tuple slot for existing cache entries */
+	TupleTableSlot *probeslot;	/* virtual slot used for hash lookups */
+	ExprState  *cache_eq_expr;	/* Compare exec params to hash key */
+	ExprState **param_exprs;	/* exprs containing the parameters to this
+								 * node */
+	FmgrInfo   *hashfunctions;	/* lookup data for hash funcs nkeys in size */
+	Oid		   *collations;		/* collation for comparisons nkeys in size */
+	uint64		mem_used;		/* bytes of memory used by cache */
+	uint64		mem_limit;		/* memory limit in bytes for the cache */
+	MemoryContext tableContext; /* memory context to store cache data */
+	dlist_head	lru_list;		/* least recently used entry list */
+	struct ResultCacheTuple *last_tuple;	/* Used to point to the last tuple
+											 * returned during a cache hit and
+											 * the tuple we last stored when
+											 * populating the cache. */
+	struct ResultCacheEntry *entry; /* the entry that 'last_tuple' belongs to
+									 * or NULL if 'last_tuple' is NULL. */
+	bool		singlerow;		/* true if the cache entry is to be marked as
+								 * complete after caching the first tuple. */
+	Bitmapset  *keyparamids;	/* Param->paramids of expressions belonging to
+								 * param_exprs */
+	ResultCacheInstrumentation stats;	/* execution statistics */
+} ResultCacheState;
+
 /* ----------------
  *	 Shared memory container for per-worker sort information
  * ----------------
@@ -2001,6 +2199,43 @@ typedef struct SortState
 	SharedSortInfo *shared_info;	/* one entry per worker */
 } SortState;
 
+/* ----------------
+ *	 Instrumentation information for IncrementalSort
+ * ----------------
+ */
+typedef struct IncrementalSortInfo
+{
+	int64		groupCount;		/* number of groups sorted */
+	long		maxMemorySpaceUsed; /* peak memory used by one group, in kB */
+	long		maxDiskSpaceUsed;	/* peak disk space used by one group, in kB */
+	bits32		sortMethods;	/* bitmask of TuplesortMethods used */
+} IncrementalSortInfo;
+
+/* ----------------
+ *	 IncrementalSortState information
+ *
+ *	The input is read in batches that consist of whole groups of tuples
+ *	with equal presorted keys, and each batch is sorted by all the keys.
+ *	group_pivot holds the tuple that the presorted keys of the following
+ *	input tuples are compared with: once a batch has reached its minimum
+ *	size, it is the last tuple added to it, and at the start of a batch it
+ *	is the first tuple of the batch, read while filling the previous one.
+ * ----------------
+ */
+typedef struct IncrementalSortState
+{
+	ScanState	ss;				/* its first field is NodeTag */
+	bool		bounded;		/* is the result set bounded? */
+	int64		bound;			/* if bounded, how many tuples are needed */
+	bool		outerNodeDone;	/* has the outer plan been exhausted? */
+	bool		sorting;		/* are we returning tuples of a batch? */
+	int64		bound_Done;		/* tuples returned so far, for the bound */
+	ExprState  *presortedEq;	/* compares the presorted keys */
+	TupleTableSlot *group_pivot;	/* see above */
+	void	   *tuplesortstate; /* private state of tuplesort.c */
+	IncrementalSortInfo incsort_info;	/* EXPLAIN ANALYZE statistics */
+} IncrementalSortState;
+
 /* ---------------------
  *	GroupState information
  * ---------------------
@@ -2030,6 +2265,8 @@ typedef struct AggStatePerTransData *AggStatePerTrans;
 typedef struct AggStatePerGroupData *AggStatePerGroup;
 typedef struct AggStatePerPhaseData *AggStatePerPhase;
 typedef struct AggStatePerHashData *AggStatePerHash;
+typedef struct HashTapeInfo HashTapeInfo;
+typedef struct HashAggSpill HashAggSpill;
 
 typedef struct AggState
 {
@@ -2081,6 +2318,29 @@ typedef struct AggState
 	AggStatePerGroup *all_pergroups;	/* array of first ->pergroups, than
 										 * ->hash_pergroup */
 	ProjectionInfo *combinedproj;	/* projection machinery */
+
+	/* these fields are used for spilling hash tables to disk: */
+	MemoryContext hash_metacxt; /* memory for hash table itself */
+	MemoryContext hash_tablecxt;	/* memory for hash table entries */
+	HashTapeInfo *hash_tapeinfo;	/* metadata for spill tapes */
+	HashAggSpill *hash_spills;	/* HashAggSpill for each grouping set,
+								 * exists only during first pass */
+	TupleTableSlot *hash_spill_slot;	/* for reading spill files */
+	List	   *hash_batches;	/* hash batches remaining to be processed */
+	bool		hash_ever_spilled;	/* ever spilled during this execution? */
+	bool		hash_spill_mode;	/* we hit a limit during the current batch
+									 * and we must not create new groups */
+	Size		hash_mem_limit; /* limit before spilling hash table */
+	uint64		hash_ngroups_limit; /* limit before spilling hash table */
+	double		hashentrysize;	/* estimate revised during execution */
+	Size		hash_mem_peak;	/* peak hash table memory usage */
+	uint64		hash_ngroups_current;	/* number of groups currently in
+										 * memory in all hash tables */
+	uint64		hash_disk_used; /* kB of disk space used */
+	int			hash_batches_used;	/* batches used during entire execution */
+	/* these fields are used in AGG_PLAIN mode with a batch-mode input: */
+	struct BatchAggState **batch_aggs;	/* per-aggregate batch states, or
+										 * NULL */
 } AggState;
 
 /* ----------------
@@ -2271,6 +2531,7 @@ typedef struct HashState
 	PlanState	ps;				/* its first field is NodeTag */
 	HashJoinTable hashtable;	/* hash table for the hashjoin */
 	List	   *hashkeys;		/* list of ExprState nodes */
+	HashBloomFilter bloom;		/* Bloom filter to build as well, or NULL */
 
 	SharedHashInfo *shared_info;	/* one entry per worker */
 	HashInstrumentation *hinstrument;	/* this worker's entry */
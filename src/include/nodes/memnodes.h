@@ -34,6 +34,17 @@ typedef struct MemoryContextCounters
 	Size		freespace;		/* The unused portion of totalspace */
 } MemoryContextCounters;
 
+/*
+ * MemoryPeakTracker
+ *		State for measuring the most memory allocated at once by this process
+ *		while doing some piece of work; see MemoryContextBeginPeakTracking().
+ */
+typedef struct MemoryPeakTracker
+{
+	Size		baseline;		/* memory already allocated at the start */
+	Size		saved_peak;		/* peak to restore when tracking ends */
+} MemoryPeakTracker;
+
 /*
  * MemoryContext
  *		A logical context in which memory allocations occur.
@@ -79,6 +90,7 @@ typedef struct MemoryContextData
 	/* these two fields are placed here to minimize alignment wastage: */
 	bool		isReset;		/* T = no space alloced since last reset */
 	bool		allowInCritSection; /* allow palloc in critical section */
+	Size		mem_allocated;	/* track memory allocated for this context */
 	const MemoryContextMethods *methods;	/* virtual function table */
 	MemoryContext parent;		/* NULL if no parent (toplevel context) */
 	MemoryContext firstchild;	/* head of linked list of children */
@@ -102,6 +114,7 @@ typedef struct MemoryContextData
 	((context) != NULL && \
 	 (IsA((context), AllocSetContext) || \
 	  IsA((context), SlabContext) || \
-	  IsA((context), GenerationContext)))
+	  IsA((context), GenerationContext) || \
+	  IsA((context), BumpContext)))
 
 #endif							/* MEMNODES_H */
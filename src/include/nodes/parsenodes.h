@@ -650,6 +650,8 @@ typedef struct ColumnDef
 	bool		is_not_null;	/* NOT NULL constraint specified? */
 	bool		is_from_type;	/* column definition came from table type */
 	char		storage;		/* attstorage setting, or 0 for default */
+	char	   *compression;	/* compression method name, or NULL for
+								 * default */
 	Node	   *raw_default;	/* default value (untransformed parse tree) */
 	Node	   *cooked_default; /* default value (transformed expr tree) */
 	char		identity;		/* attidentity setting */
@@ -1769,6 +1771,7 @@ typedef enum AlterTableType
 	AT_SetOptions,				/* alter column set ( options ) */
 	AT_ResetOptions,			/* alter column reset ( options ) */
 	AT_SetStorage,				/* alter column set storage */
+	AT_SetCompression,			/* alter column set compression */
 	AT_DropColumn,				/* drop column */
 	AT_DropColumnRecurse,		/* internal to commands/tablecmds.c */
 	AT_AddIndex,				/* add index */
@@ -3152,7 +3155,8 @@ typedef struct AlterSystemStmt
 typedef enum ClusterOption
 {
 	CLUOPT_RECHECK = 1 << 0,	/* recheck relation state */
-	CLUOPT_VERBOSE = 1 << 1		/* print progress info */
+	CLUOPT_VERBOSE = 1 << 1,	/* print progress info */
+	CLUOPT_CONCURRENTLY = 1 << 2	/* allow concurrent DML */
 } ClusterOption;
 
 typedef struct ClusterStmt
@@ -3229,6 +3233,7 @@ typedef struct CreateTableAsStmt
 	ObjectType	relkind;		/* OBJECT_TABLE or OBJECT_MATVIEW */
 	bool		is_select_into; /* it was written as SELECT INTO */
 	bool		if_not_exists;	/* just do nothing if it already exists? */
+	bool		incremental;	/* maintain a matview incrementally? */
 } CreateTableAsStmt;
 
 /* ----------------------
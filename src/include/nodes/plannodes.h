@@ -87,8 +87,27 @@ typedef struct PlannedStmt
 
 	List	   *paramExecTypes; /* type OIDs for PARAM_EXEC Params */
 
+	/*
+	 * rtable indexes of relations scanned only by subplans that initial
+	 * partition pruning can remove.  These are locked only once pruning has
+	 * shown them to be needed; partPruneInfos lists the PartitionPruneInfos
+	 * that must be evaluated to decide that.
+	 */
+	Bitmapset  *prunableRelids;
+
+	List	   *partPruneInfos; /* list of PartitionPruneInfo */
+
 	Node	   *utilityStmt;	/* non-null if this is utility stmt */
 
+	/*
+	 * Set by the executor once the permission checks for rtable have passed,
+	 * so that they can be skipped when the same user executes the plan again
+	 * (see ExecCheckPlannedStmtPerms).  These are meaningful only within the
+	 * backend that set them, so they aren't written out.
+	 */
+	Oid			permsCheckedAs; /* user the checks passed for, or InvalidOid */
+	uint64		permsCheckedGen;	/* exec_perms_generation at that time */
+
 	/* statement location in source string (copied from Query) */
 	int			stmt_location;	/* start location, or -1 if unknown */
 	int			stmt_len;		/* length in bytes; 0 means "rest of string" */
@@ -133,6 +152,11 @@ typedef struct Plan
 	bool		parallel_aware; /* engage parallel-aware logic? */
 	bool		parallel_safe;	/* OK to use as part of parallel plan? */
 
+	/*
+	 * information needed for asynchronous execution
+	 */
+	bool		async_capable;	/* engage asynchronous-capable logic? */
+
 	/*
 	 * Common structural data for all Plan types.
 	 */
@@ -489,6 +513,19 @@ typedef struct TidScan
 	List	   *tidquals;		/* qual(s) involving CTID = something */
 } TidScan;
 
+/* ----------------
+ *		tid range scan node
+ *
+ * tidrangequals is an implicitly AND'ed list of qual expressions of the form
+ * "CTID relop pseudoconstant", where relop is one of >,>=,<,<=.
+ * ----------------
+ */
+typedef struct TidRangeScan
+{
+	Scan		scan;
+	List	   *tidrangequals;	/* qual(s) involving CTID op something */
+} TidRangeScan;
+
 /* ----------------
  *		subquery scan node
  *
@@ -691,12 +728,19 @@ typedef struct Join
  * Vars, but perhaps someday that'd be worth relaxing.  (Note: during plan
  * creation, the paramval can actually be a PlaceHolderVar expression; but it
  * must be a Var with varno OUTER_VAR by the time it gets to the executor.)
+ *
+ * If the inner subplan doesn't depend on the outer one and materializes its
+ * output, hashclauses lists the hashable equality clauses among the joinqual,
+ * with the outer argument on the left.  The executor uses them to switch to
+ * probing a hash table of the inner rows when the outer subplan returns many
+ * more rows than estimated.  The joinqual is still checked as usual.
  * ----------------
  */
 typedef struct NestLoop
 {
 	Join		join;
 	List	   *nestParams;		/* list of NestLoopParam nodes */
+	List	   *hashclauses;	/* clauses usable for hashing the inner rows */
 } NestLoop;
 
 typedef struct NestLoopParam
@@ -745,6 +789,13 @@ typedef struct HashJoin
 	 * perform lookups in the hashtable over the inner plan.
 	 */
 	List	   *hashkeys;
+
+	/*
+	 * The same expressions in terms of the outer plan's scan tuple, if the
+	 * outer plan is a SeqScan that may skip tuples not passing a Bloom
+	 * filter built over the inner plan's hash keys; else NIL.
+	 */
+	List	   *bloomkeys;
 } HashJoin;
 
 /* ----------------
@@ -756,6 +807,31 @@ typedef struct Material
 	Plan		plan;
 } Material;
 
+/* ----------------
+ *		result cache node
+ *
+ * Caches the rows produced by the subplan for each distinct set of values
+ * of param_exprs, so that rescanning with parameters that have been seen
+ * recently needn't execute the subplan again.
+ * ----------------
+ */
+typedef struct ResultCache
+{
+	Plan		plan;
+
+	int			numKeys;		/* size of the two arrays below */
+
+	Oid		   *hashOperators;	/* hash operators for each key */
+	Oid		   *collations;		/* collations for each key */
+	List	   *param_exprs;	/* cache keys, exprs containing parameters */
+	bool		singlerow;		/* true if the cache entry should be marked
+								 * as complete after we store the first
+								 * tuple in it. */
+	uint32		est_entries;	/* The maximum number of entries that the
+								 * planner expects will fit in the cache, or
+								 * 0 if unknown */
+} ResultCache;
+
 /* ----------------
  *		sort node
  * ----------------
@@ -770,6 +846,20 @@ typedef struct Sort
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
 } Sort;
 
+/* ----------------
+ *		incremental sort node
+ *
+ * The input is already sorted by the first nPresortedCols sort columns, so
+ * the tuples only need to be sorted within each group of tuples that have
+ * equal values in those columns.
+ * ----------------
+ */
+typedef struct IncrementalSort
+{
+	Sort		sort;
+	int			nPresortedCols; /* number of presorted columns */
+} IncrementalSort;
+
 /* ---------------
  *	 group node -
  *		Used for queries with GROUP BY (but no aggregates) specified.
@@ -1094,12 +1184,19 @@ typedef struct PlanRowMark
  * other_subplans		Indexes of any subplans that are not accounted for
  *						by any of the PartitionedRelPruneInfo nodes in
  *						"prune_infos".  These subplans must not be pruned.
+ * nsubplans			Length of subplan_rtis[]: the number of subplans of
+ *						the parent plan node, or 0 if no initial pruning is
+ *						required at any level.
+ * subplan_rtis			For each subplan that just scans a leaf partition,
+ *						the RT index of that partition, else 0.
  */
 typedef struct PartitionPruneInfo
 {
 	NodeTag		type;
 	List	   *prune_infos;
 	Bitmapset  *other_subplans;
+	int			nsubplans;
+	int		   *subplan_rtis;
 } PartitionPruneInfo;
 
 /*
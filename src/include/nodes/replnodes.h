@@ -84,6 +84,7 @@ typedef struct StartReplicationCmd
 	TimeLineID	timeline;
 	XLogRecPtr	startpoint;
 	List	   *options;
+	bool		compression;	/* compress WAL data messages (physical only) */
 } StartReplicationCmd;
 
 
@@ -22,6 +22,7 @@
  */
 extern PGDLLIMPORT bool enable_geqo;
 extern PGDLLIMPORT int geqo_threshold;
+extern PGDLLIMPORT bool linear_join_search_enabled;
 extern PGDLLIMPORT int min_parallel_table_scan_size;
 extern PGDLLIMPORT int min_parallel_index_scan_size;
 
@@ -65,6 +66,13 @@ extern void generate_partitionwise_join_paths(PlannerInfo *root,
 extern void debug_print_rel(PlannerInfo *root, RelOptInfo *rel);
 #endif
 
+/*
+ * linearjoin.c
+ *	  join search by linearized dynamic programming
+ */
+extern RelOptInfo *linear_join_search(PlannerInfo *root, int levels_needed,
+									  List *initial_rels);
+
 /*
  * indxpath.c
  *	  routines to generate index paths
@@ -183,6 +191,8 @@ typedef enum
 
 extern PathKeysComparison compare_pathkeys(List *keys1, List *keys2);
 extern bool pathkeys_contained_in(List *keys1, List *keys2);
+extern bool pathkeys_count_contained_in(List *keys1, List *keys2,
+										int *n_common);
 extern Path *get_cheapest_path_for_pathkeys(List *paths, List *pathkeys,
 											Relids required_outer,
 											CostSelector cost_criterion,
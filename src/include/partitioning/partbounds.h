@@ -85,6 +85,9 @@ extern PartitionBoundInfo partition_bounds_create(PartitionBoundSpec **boundspec
 extern bool partition_bounds_equal(int partnatts, int16 *parttyplen,
 								   bool *parttypbyval, PartitionBoundInfo b1,
 								   PartitionBoundInfo b2);
+extern int *partition_bounds_refine(int partnatts, FmgrInfo *partsupfunc,
+									Oid *partcollation, PartitionBoundInfo fine,
+									int fine_nparts, PartitionBoundInfo coarse);
 extern PartitionBoundInfo partition_bounds_copy(PartitionBoundInfo src,
 												PartitionKey key);
 extern bool partitions_are_ordered(PartitionBoundInfo boundinfo, int nparts);
@@ -234,6 +234,14 @@
  */
 #define PG_CACHE_LINE_SIZE		128
 
+/*
+ * Assumed alignment requirement for direct I/O.  4K corresponds to common
+ * sector and memory page size.  Buffers handed to the kernel for files
+ * opened with O_DIRECT (see io_direct) must be aligned to this boundary,
+ * and transfers must be multiples of it.
+ */
+#define PG_IO_ALIGN_SIZE		4096
+
 /*
  *------------------------------------------------------------------------
  * The following symbols are for enabling debugging code, not for
@@ -0,0 +1,103 @@
+/*-------------------------------------------------------------------------
+ *
+ * simd.h
+ *	  Support for platform-specific vector operations.
+ *
+ * A Vector8 holds a number of bytes that are operated on in parallel.  We
+ * use SSE2 on x86-64 and Neon on AArch64, which are part of the base
+ * instruction set of those architectures, so no runtime check is needed.
+ * Elsewhere we fall back to treating a uint64 as a vector of 8 bytes, which
+ * is still a good deal faster than looking at one byte at a time.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * src/include/port/simd.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMD_H
+#define SIMD_H
+
+#if (defined(__x86_64__) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define USE_SSE2
+typedef __m128i Vector8;
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON
+typedef uint8x16_t Vector8;
+
+#else
+#define USE_NO_SIMD
+typedef uint64 Vector8;
+#endif
+
+
+/*
+ * Load a chunk of memory into the given vector.  No alignment is required.
+ */
+static inline void
+vector8_load(Vector8 *v, const uint8 *s)
+{
+#if defined(USE_SSE2)
+	*v = _mm_loadu_si128((const __m128i *) s);
+#elif defined(USE_NEON)
+	*v = vld1q_u8(s);
+#else
+	memcpy(v, s, sizeof(Vector8));
+#endif
+}
+
+/*
+ * Create a vector with all elements set to the same value.
+ */
+static inline Vector8
+vector8_broadcast(const uint8 c)
+{
+#if defined(USE_SSE2)
+	return _mm_set1_epi8((char) c);
+#elif defined(USE_NEON)
+	return vdupq_n_u8(c);
+#else
+	return ~UINT64CONST(0) / 0xFF * c;
+#endif
+}
+
+/*
+ * Return true if any elements in the vector are equal to the given scalar.
+ */
+static inline bool
+vector8_has(const Vector8 v, const uint8 c)
+{
+#if defined(USE_SSE2)
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, vector8_broadcast(c))) != 0;
+#elif defined(USE_NEON)
+	return vmaxvq_u8(vceqq_u8(v, vector8_broadcast(c))) != 0;
+#else
+	Vector8		x = v ^ vector8_broadcast(c);
+
+	/*
+	 * The usual test for a zero byte in a word: subtracting 1 from a zero
+	 * byte is the only way to set its high bit when it wasn't set before.
+	 */
+	return ((x - vector8_broadcast(0x01)) & ~x & vector8_broadcast(0x80)) != 0;
+#endif
+}
+
+/*
+ * Return true if the high bit of any element is set.
+ */
+static inline bool
+vector8_is_highbit_set(const Vector8 v)
+{
+#if defined(USE_SSE2)
+	return _mm_movemask_epi8(v) != 0;
+#elif defined(USE_NEON)
+	return vmaxvq_u8(v) > 0x7F;
+#else
+	return (v & vector8_broadcast(0x80)) != 0;
+#endif
+}
+
+#endif							/* SIMD_H */
@@ -23,6 +23,9 @@
  * INSTR_TIME_SET_CURRENT_LAZY(t)	set t to current time if t is zero,
  *									evaluates to whether t changed
  *
+ * INSTR_TIME_SET_CURRENT_FAST(t)	set t to current time using the cheapest
+ *									available clock (see below)
+ *
  * INSTR_TIME_ADD(x, y)				x += y
  *
  * INSTR_TIME_SUBTRACT(x, y)		x -= y
@@ -35,6 +38,8 @@
  *
  * INSTR_TIME_GET_MICROSEC(t)		convert t to uint64 (in microseconds)
  *
+ * INSTR_TIME_GET_NANOSEC(t)		convert t to uint64 (in nanoseconds)
+ *
  * Note that INSTR_TIME_SUBTRACT and INSTR_TIME_ACCUM_DIFF convert
  * absolute times to intervals.  The INSTR_TIME_GET_xxx operations are
  * only useful on intervals.
@@ -43,6 +48,13 @@
  * running sum in instr_time form (ie, use INSTR_TIME_ADD or
  * INSTR_TIME_ACCUM_DIFF) and convert to a result format only at the end.
  *
+ * INSTR_TIME_SET_CURRENT_FAST reads the CPU's timestamp counter when
+ * pg_initialize_fast_clock() has been able to calibrate it, which costs a
+ * few nanoseconds instead of a clock_gettime() call.  It is meant for
+ * high-frequency instrumentation such as per-node EXPLAIN ANALYZE timing.
+ * Its absolute values share no reference point with INSTR_TIME_SET_CURRENT,
+ * so an interval must be measured with the same macro at both ends.
+ *
  * Beware of multiple evaluations of the macro arguments.
  *
  *
@@ -141,6 +153,47 @@ typedef struct timespec instr_time;
 #define INSTR_TIME_GET_MICROSEC(t) \
 	(((uint64) (t).tv_sec * (uint64) 1000000) + (uint64) ((t).tv_nsec / 1000))
 
+#define INSTR_TIME_GET_NANOSEC(t) \
+	(((uint64) (t).tv_sec * (uint64) 1000000000) + (uint64) (t).tv_nsec)
+
+/*
+ * On x86-64 an invariant TSC ticks at a constant rate on every core, so once
+ * its frequency has been measured against PG_INSTR_CLOCK it can stand in for
+ * clock_gettime() when timing intervals.
+ */
+#if defined(__x86_64__) && defined(HAVE__GET_CPUID) && \
+	(defined(__GNUC__) || defined(__clang__))
+#define PG_HAVE_FAST_CLOCK
+
+extern bool pg_fast_clock_enabled;
+extern double pg_fast_clock_ns_per_tick;
+extern uint64 pg_fast_clock_base;
+
+static inline uint64
+pg_rdtsc(void)
+{
+	uint32		lo,
+				hi;
+
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64) hi << 32) | lo;
+}
+
+static inline void
+pg_fast_clock_get(struct timespec *t)
+{
+	uint64		ns;
+
+	ns = (uint64) ((double) (pg_rdtsc() - pg_fast_clock_base) *
+				   pg_fast_clock_ns_per_tick);
+	t->tv_sec = ns / 1000000000;
+	t->tv_nsec = ns % 1000000000;
+}
+
+#define INSTR_TIME_SET_CURRENT_FAST(t) \
+	(pg_fast_clock_enabled ? pg_fast_clock_get(&(t)) : INSTR_TIME_SET_CURRENT(t))
+#endif
+
 #else							/* !HAVE_CLOCK_GETTIME */
 
 /* Use gettimeofday() */
@@ -205,6 +258,9 @@ typedef struct timeval instr_time;
 #define INSTR_TIME_GET_MICROSEC(t) \
 	(((uint64) (t).tv_sec * (uint64) 1000000) + (uint64) (t).tv_usec)
 
+#define INSTR_TIME_GET_NANOSEC(t) \
+	(((uint64) (t).tv_sec * (uint64) 1000000000) + (uint64) (t).tv_usec * 1000)
+
 #endif							/* HAVE_CLOCK_GETTIME */
 
 #else							/* WIN32 */
@@ -237,6 +293,9 @@ typedef LARGE_INTEGER instr_time;
 #define INSTR_TIME_GET_MICROSEC(t) \
 	((uint64) (((double) (t).QuadPart * 1000000.0) / GetTimerFrequency()))
 
+#define INSTR_TIME_GET_NANOSEC(t) \
+	((uint64) (((double) (t).QuadPart * 1000000000.0) / GetTimerFrequency()))
+
 static inline double
 GetTimerFrequency(void)
 {
@@ -253,4 +312,10 @@ GetTimerFrequency(void)
 #define INSTR_TIME_SET_CURRENT_LAZY(t) \
 	(INSTR_TIME_IS_ZERO(t) ? INSTR_TIME_SET_CURRENT(t), true : false)
 
+#ifndef PG_HAVE_FAST_CLOCK
+#define INSTR_TIME_SET_CURRENT_FAST(t)	INSTR_TIME_SET_CURRENT(t)
+#endif
+
+extern bool pg_initialize_fast_clock(void);
+
 #endif							/* INSTR_TIME_H */
@@ -22,13 +22,17 @@
  */
 typedef enum
 {
-	AVW_BRINSummarizeRange
+	AVW_BRINSummarizeRange,
+	AVW_GINCleanPendingList,
+	AVW_HeapPrunePage
 } AutoVacuumWorkItemType;
 
 
 /* GUC variables */
 extern bool autovacuum_start_daemon;
 extern int	autovacuum_max_workers;
+extern int	autovacuum_max_parallel_workers;
+extern int	autovacuum_eager_freeze_pages;
 extern int	autovacuum_work_mem;
 extern int	autovacuum_naptime;
 extern int	autovacuum_vac_thresh;
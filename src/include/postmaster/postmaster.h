@@ -15,7 +15,9 @@
 
 /* GUC options */
 extern bool EnableSSL;
+extern bool libpq_compression;
 extern int	ReservedBackends;
+extern int	preforked_backends;
 extern PGDLLIMPORT int PostPortNumber;
 extern int	Unix_socket_permissions;
 extern char *Unix_socket_group;
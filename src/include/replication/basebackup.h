@@ -20,6 +20,25 @@
 #define MAX_RATE_LOWER	32
 #define MAX_RATE_UPPER	1048576
 
+/*
+ * In an incremental base backup, the main fork segments of relations are
+ * sent as INCREMENTAL.<filename> members holding only the blocks changed
+ * since the LSN given in the INCREMENTAL option.  Such a file consists of
+ * an IncrementalFileHeader, then the numbers of the blocks it contains,
+ * then the blocks themselves in the same order.
+ */
+#define INCREMENTAL_PREFIX			"INCREMENTAL."
+#define INCREMENTAL_PREFIX_LENGTH	(sizeof(INCREMENTAL_PREFIX) - 1)
+#define INCREMENTAL_MAGIC			0xd3ae1f0d
+
+typedef struct IncrementalFileHeader
+{
+	uint32		magic;			/* INCREMENTAL_MAGIC */
+	uint32		num_blocks;		/* number of blocks in the file */
+	uint32		truncation_block_length;	/* length of the relation
+											 * segment, in blocks */
+} IncrementalFileHeader;
+
 
 typedef struct
 {
@@ -22,6 +22,7 @@ typedef struct PGOutputData
 
 	/* client info */
 	uint32		protocol_version;
+	bool		binary;			/* send column values in binary format */
 
 	List	   *publication_names;
 	List	   *publications;
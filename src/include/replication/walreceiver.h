@@ -27,6 +27,7 @@
 extern int	wal_receiver_status_interval;
 extern int	wal_receiver_timeout;
 extern bool hot_standby_feedback;
+extern bool wal_receiver_compression;
 
 /*
  * MAXCONNINFO: maximum size of a connection string.
@@ -158,11 +159,13 @@ typedef struct
 		struct
 		{
 			TimeLineID	startpointTLI;	/* Starting timeline */
+			bool		compression;	/* Ask for compressed WAL data */
 		}			physical;
 		struct
 		{
 			uint32		proto_version;	/* Logical protocol version */
 			List	   *publication_names;	/* String list of publications */
+			bool		binary;		/* Ask publisher to use binary format */
 		}			logical;
 	}			proto;
 } WalRcvStreamOptions;
@@ -28,6 +28,13 @@ typedef enum WalSndState
 	WALSNDSTATE_STOPPING
 } WalSndState;
 
+/*
+ * Number of buckets in the lag histograms.  Bucket 0 counts lag times below
+ * 1 ms, bucket i those from 2^(i-1) ms up to 2^i ms, and the last bucket all
+ * longer ones.
+ */
+#define WALSND_LAG_BUCKETS	16
+
 /*
  * Each walsender has a WalSnd struct in shared memory.
  *
@@ -60,6 +67,27 @@ typedef struct WalSnd
 	TimeOffset	flushLag;
 	TimeOffset	applyLag;
 
+	/* Number of lag times measured, by mode and WALSND_LAG_BUCKETS bucket */
+	uint64		lagHistogram[NUM_SYNC_REP_WAIT_MODE][WALSND_LAG_BUCKETS];
+
+	/*
+	 * Whether WAL data messages are compressed, and the number of bytes of
+	 * WAL sent, before and after compression.
+	 */
+	bool		compression;
+	uint64		sentBytes;
+	uint64		sentCompressedBytes;
+
+	/*
+	 * If this walsender leads a parallel base backup, the backup's start
+	 * location, the number of streams it is split into, and how many of the
+	 * other streams have been sent completely.  backupStartPtr is invalid
+	 * otherwise.
+	 */
+	XLogRecPtr	backupStartPtr;
+	int			backupParts;
+	int			backupPartsDone;
+
 	/* Protects shared variables shown above. */
 	slock_t		mutex;
 
@@ -0,0 +1,59 @@
+/*-------------------------------------------------------------------------
+ *
+ * aio.h
+ *	  Batched asynchronous execution of file operations.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/aio.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef AIO_H
+#define AIO_H
+
+struct iovec;					/* avoid including port/pg_iovec.h here */
+
+/* Possible values for io_method */
+typedef enum IoMethod
+{
+	IOMETHOD_SYNC,				/* perform operations one after another */
+	IOMETHOD_IO_URING			/* submit them all at once to io_uring */
+} IoMethod;
+
+/* GUC variable */
+extern int	io_method;
+
+/* Operation types understood by pgaio_execute() */
+typedef enum PgAioOpType
+{
+	PGAIO_OP_FSYNC,
+	PGAIO_OP_FDATASYNC,
+	PGAIO_OP_READV,
+	PGAIO_OP_WRITEV
+} PgAioOpType;
+
+/*
+ * One operation of a batch.  The caller fills in everything except result,
+ * which is set to the byte count (or zero, for syncs) on success, or to a
+ * negated errno value on failure.
+ */
+typedef struct PgAioOp
+{
+	PgAioOpType type;
+	int			fd;				/* raw kernel file descriptor */
+	off_t		offset;			/* for READV and WRITEV */
+	const struct iovec *iov;	/* for READV and WRITEV */
+	int			iovcnt;
+	int			result;
+} PgAioOp;
+
+/* Maximum number of operations the kernel is asked to run at once */
+#define PGAIO_MAX_BATCH		64
+
+extern void pgaio_execute(PgAioOp *ops, int nops, uint32 wait_event_info);
+extern bool pgaio_batching_enabled(void);
+
+#endif							/* AIO_H */
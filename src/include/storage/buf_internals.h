@@ -289,6 +289,7 @@ extern BufferDesc *LocalBufferDescriptors;
 typedef struct CkptSortItem
 {
 	Oid			tsId;
+	Oid			dbNode;
 	Oid			relNode;
 	ForkNumber	forkNum;
 	BlockNumber blockNum;
@@ -309,10 +310,15 @@ extern void ScheduleBufferTagForWriteback(WritebackContext *context, BufferTag *
 extern BufferDesc *StrategyGetBuffer(BufferAccessStrategy strategy,
 									 uint32 *buf_state);
 extern void StrategyFreeBuffer(BufferDesc *buf);
+extern bool StrategyAddCleanBuffer(BufferDesc *buf);
+extern int	StrategyFreelistLength(void);
 extern bool StrategyRejectBuffer(BufferAccessStrategy strategy,
 								 BufferDesc *buf);
 
-extern int	StrategySyncStart(uint32 *complete_passes, uint32 *num_buf_alloc);
+extern int	StrategyNumPartitions(void);
+extern int	StrategySyncStart(int partition, int *first_buffer,
+							  int *num_buffers, uint32 *complete_passes,
+							  uint32 *num_buf_alloc);
 extern void StrategyNotifyBgWriter(int bgwprocno);
 
 extern Size StrategyShmemSize(void);
@@ -324,12 +330,19 @@ extern Size BufTableShmemSize(int size);
 extern void InitBufTable(int size);
 extern uint32 BufTableHashCode(BufferTag *tagPtr);
 extern int	BufTableLookup(BufferTag *tagPtr, uint32 hashcode);
+extern int	BufTableLookupHint(uint32 hashcode);
 extern int	BufTableInsert(BufferTag *tagPtr, uint32 hashcode, int buf_id);
 extern void BufTableDelete(BufferTag *tagPtr, uint32 hashcode);
 
 /* localbuf.c */
+
+/* Max # of temp relation blocks read or written by one smgr call */
+#define LOCAL_BUFFER_IO_COMBINE		16
+
 extern void LocalPrefetchBuffer(SMgrRelation smgr, ForkNumber forkNum,
 								BlockNumber blockNum);
+extern void LocalReadAheadBuffers(SMgrRelation smgr, ForkNumber forkNum,
+								  BlockNumber blockNum, int nblocks);
 extern BufferDesc *LocalBufferAlloc(SMgrRelation smgr, ForkNumber forkNum,
 									BlockNumber blockNum, bool *foundPtr);
 extern void MarkLocalBufferDirty(Buffer buffer);
@@ -46,8 +46,16 @@ typedef enum
 								 * replay; otherwise same as RBM_NORMAL */
 } ReadBufferMode;
 
+/*
+ * Streaming reads: the callback returns the next block number to read, or
+ * InvalidBlockNumber at the end.  StreamingReadData is private to bufmgr.c.
+ */
+typedef BlockNumber (*StreamingReadCallback) (void *callback_private);
+typedef struct StreamingReadData *StreamingRead;
+
 /* forward declared, to avoid having to expose buf_internals.h here */
 struct WritebackContext;
+struct SMgrRelationData;
 
 /* in globals.c ... this duplicates miscadmin.h */
 extern PGDLLIMPORT int NBuffers;
@@ -56,16 +64,24 @@ extern PGDLLIMPORT int NBuffers;
 extern bool zero_damaged_pages;
 extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
+extern bool bgwriter_fill_freelist;
 extern bool track_io_timing;
 extern int	target_prefetch_pages;
 
 extern int	checkpoint_flush_after;
+extern bool checkpoint_sync_early;
 extern int	backend_flush_after;
 extern int	bgwriter_flush_after;
 
 /* in buf_init.c */
 extern PGDLLIMPORT char *BufferBlocks;
 
+/* in buf_table.c */
+extern bool buffer_lookup_hints;
+
+/* in freelist.c */
+extern int	clock_sweep_partitions;
+
 /* in guc.c */
 extern int	effective_io_concurrency;
 
@@ -164,6 +180,16 @@ extern PGDLLIMPORT int32 *LocalRefCount;
 extern bool ComputeIoConcurrency(int io_concurrency, double *target);
 extern void PrefetchBuffer(Relation reln, ForkNumber forkNum,
 						   BlockNumber blockNum);
+extern bool PrefetchSharedBuffer(struct SMgrRelationData *smgr_reln,
+								 ForkNumber forkNum, BlockNumber blockNum);
+extern StreamingRead BeginStreamingRead(Relation rel, ForkNumber forkNum,
+										BufferAccessStrategy strategy,
+										StreamingReadCallback callback,
+										void *callback_private);
+extern BlockNumber StreamingReadNextBlock(StreamingRead stream);
+extern Buffer StreamingReadNextBuffer(StreamingRead stream);
+extern void ResetStreamingRead(StreamingRead stream);
+extern void EndStreamingRead(StreamingRead stream);
 extern Buffer ReadBuffer(Relation reln, BlockNumber blockNum);
 extern Buffer ReadBufferExtended(Relation reln, ForkNumber forkNum,
 								 BlockNumber blockNum, ReadBufferMode mode,
@@ -190,9 +216,10 @@ extern BlockNumber RelationGetNumberOfBlocksInFork(Relation relation,
 extern void FlushOneBuffer(Buffer buffer);
 extern void FlushRelationBuffers(Relation rel);
 extern void FlushDatabaseBuffers(Oid dbid);
-extern void DropRelFileNodeBuffers(RelFileNodeBackend rnode,
+extern void DropRelFileNodeBuffers(struct SMgrRelationData *smgr_reln,
 								   ForkNumber forkNum, BlockNumber firstDelBlock);
-extern void DropRelFileNodesAllBuffers(RelFileNodeBackend *rnodes, int nnodes);
+extern void DropRelFileNodesAllBuffers(struct SMgrRelationData **smgr_reln,
+									   int nnodes);
 extern void DropDatabaseBuffers(Oid dbid);
 
 #define RelationGetNumberOfBlocks(reln) \
@@ -98,6 +98,14 @@
  * to unroll the inner loop to avoid loop overhead and minimize register
  * spilling. For less sophisticated compilers it might be beneficial to
  * manually unroll the inner loop.
+ *
+ * Baseline x86-64 only guarantees SSE2, which lacks pmulld, so unless the
+ * whole build targets a newer CPU the loop can't be vectorized usefully.
+ * With a GCC-compatible compiler, we therefore also compile the loop for
+ * AVX2 and AVX-512, and pick the best version the CPU supports on first
+ * use, much like pg_comp_crc32c does.  All versions compute exactly the
+ * same result, since they're the same code.  On ARM, NEON is part of the
+ * baseline of 64-bit targets, so the plain version is already vectorized.
  */
 
 #include "storage/bufpage.h"
@@ -138,12 +146,20 @@ do { \
 	(checksum) = __tmp * FNV_PRIME ^ (__tmp >> 17); \
 } while (0)
 
+#if defined(__x86_64__) && \
+	(defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define USE_CHECKSUM_RUNTIME_CHECK
+#define pg_attribute_checksum_inline __attribute__((always_inline)) inline
+#else
+#define pg_attribute_checksum_inline
+#endif
+
 /*
  * Block checksum algorithm.  The page must be adequately aligned
  * (at least on 4-byte boundary).
  */
-static uint32
-pg_checksum_block(const PGChecksummablePage *page)
+static pg_attribute_checksum_inline uint32
+pg_checksum_block_internal(const PGChecksummablePage *page)
 {
 	uint32		sums[N_SUMS];
 	uint32		result = 0;
@@ -173,6 +189,58 @@ pg_checksum_block(const PGChecksummablePage *page)
 	return result;
 }
 
+#ifdef USE_CHECKSUM_RUNTIME_CHECK
+
+static uint32
+pg_checksum_block_default(const PGChecksummablePage *page)
+{
+	return pg_checksum_block_internal(page);
+}
+
+__attribute__((target("avx2")))
+static uint32
+pg_checksum_block_avx2(const PGChecksummablePage *page)
+{
+	return pg_checksum_block_internal(page);
+}
+
+__attribute__((target("avx512f")))
+static uint32
+pg_checksum_block_avx512(const PGChecksummablePage *page)
+{
+	return pg_checksum_block_internal(page);
+}
+
+static uint32 pg_checksum_block_choose(const PGChecksummablePage *page);
+
+static uint32 (*pg_checksum_block) (const PGChecksummablePage *page) =
+pg_checksum_block_choose;
+
+/*
+ * This gets called on the first call. It replaces the function pointer
+ * so that subsequent calls are routed directly to the chosen implementation.
+ */
+static uint32
+pg_checksum_block_choose(const PGChecksummablePage *page)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		pg_checksum_block = pg_checksum_block_avx512;
+	else if (__builtin_cpu_supports("avx2"))
+		pg_checksum_block = pg_checksum_block_avx2;
+	else
+		pg_checksum_block = pg_checksum_block_default;
+
+	return pg_checksum_block(page);
+}
+
+#else							/* !USE_CHECKSUM_RUNTIME_CHECK */
+
+#define pg_checksum_block(page) pg_checksum_block_internal(page)
+
+#endif
+
 /*
  * Compute the checksum for a Postgres page.
  *
@@ -32,6 +32,8 @@ struct PGPROC;
 typedef struct LWLock
 {
 	uint16		tranche;		/* tranche ID */
+	uint16		spins;			/* recent spins needed to acquire, see
+								 * LWLockSpin() */
 	pg_atomic_uint32 state;		/* state of exclusive/nonexclusive lockers */
 	proclist_head waiters;		/* list of waiting PGPROCs */
 #ifdef LOCK_DEBUG
@@ -143,6 +145,11 @@ typedef enum LWLockMode
 extern bool Trace_lwlocks;
 #endif
 
+/* GUC variables */
+extern bool track_lwlocks;
+extern int	lwlock_max_spins;
+extern bool lwlock_handoff;
+
 extern bool LWLockAcquire(LWLock *lock, LWLockMode mode);
 extern bool LWLockConditionalAcquire(LWLock *lock, LWLockMode mode);
 extern bool LWLockAcquireOrWait(LWLock *lock, LWLockMode mode);
@@ -159,6 +166,10 @@ extern Size LWLockShmemSize(void);
 extern void CreateLWLocks(void);
 extern void InitLWLockAccess(void);
 
+extern Size LWLockStatsShmemSize(void);
+extern void LWLockStatsShmemInit(void);
+extern void LWLockStatsReset(void);
+
 extern const char *GetLWLockIdentifier(uint32 classId, uint16 eventId);
 
 /*
@@ -202,6 +213,13 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_MXACTMEMBER_BUFFERS,
 	LWTRANCHE_ASYNC_BUFFERS,
 	LWTRANCHE_OLDSERXID_BUFFERS,
+	LWTRANCHE_CLOG_SLRU,
+	LWTRANCHE_COMMITTS_SLRU,
+	LWTRANCHE_SUBTRANS_SLRU,
+	LWTRANCHE_MXACTOFFSET_SLRU,
+	LWTRANCHE_MXACTMEMBER_SLRU,
+	LWTRANCHE_ASYNC_SLRU,
+	LWTRANCHE_OLDSERXID_SLRU,
 	LWTRANCHE_WAL_INSERT,
 	LWTRANCHE_BUFFER_CONTENT,
 	LWTRANCHE_BUFFER_IO_IN_PROGRESS,
@@ -213,6 +231,7 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_PREDICATE_LOCK_MANAGER,
 	LWTRANCHE_PARALLEL_HASH_JOIN,
 	LWTRANCHE_PARALLEL_QUERY_DSA,
+	LWTRANCHE_PARALLEL_ANALYZE_DSA,
 	LWTRANCHE_SESSION_DSA,
 	LWTRANCHE_SESSION_RECORD_TABLE,
 	LWTRANCHE_SESSION_TYPMOD_TABLE,
@@ -220,6 +239,12 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_TBM,
 	LWTRANCHE_PARALLEL_APPEND,
 	LWTRANCHE_SXACT,
+	LWTRANCHE_PARALLEL_REDO_EXTENSION,
+	LWTRANCHE_STATS_DSA,
+	LWTRANCHE_STATS_HASH,
+	LWTRANCHE_SHARED_PLAN_CACHE,
+	LWTRANCHE_SHARED_PLAN_CACHE_DSA,
+	LWTRANCHE_RELATION_EXTENSION,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
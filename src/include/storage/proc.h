@@ -40,6 +40,16 @@ struct XidCache
 	TransactionId xids[PGPROC_MAX_CACHED_SUBXIDS];
 };
 
+/*
+ * Subtransaction XIDs that don't fit in the XidCache are also recorded, up
+ * to subxid_overflow_slots of them, in a per-backend overflow array along
+ * with the top-level XID they belong to.  The cache still counts as
+ * overflowed, but a reader can usually map such an XID to its top-level XID
+ * from this array instead of looking it up in pg_subtrans; see
+ * SubXidOverflowGetTopmost().
+ */
+#define SUBXID_OVERFLOW_SLOTS_MAX	65536
+
 /*
  * Flags for PGXACT->vacuumFlags
  *
@@ -67,8 +77,18 @@ struct XidCache
  * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure
  * rather than the main lock table.  This eases contention on the lock
  * manager LWLocks.  See storage/lmgr/README for additional details.
+ *
+ * The slots are divided into groups of FP_LOCK_SLOTS_PER_GROUP, and the lock
+ * modes held in each group are packed into a single uint64, so a relation
+ * only ever has to be looked for in the one group its OID hashes to.  The
+ * number of slots is set at server start by fast_path_lock_slots, which is
+ * always a power of two no smaller than one group.
  */
-#define		FP_LOCK_SLOTS_PER_BACKEND 16
+#define		FP_LOCK_SLOTS_PER_GROUP		16
+#define		FP_LOCK_SLOTS_PER_BACKEND_MAX	16384
+#define		FP_LOCK_SLOTS_PER_BACKEND	fast_path_lock_slots
+#define		FP_LOCK_GROUPS_PER_BACKEND	\
+	(FP_LOCK_SLOTS_PER_BACKEND / FP_LOCK_SLOTS_PER_GROUP)
 
 /*
  * An invalid pgprocno.  Must be larger than the maximum number of PGPROC
@@ -108,6 +128,8 @@ struct PGPROC
 								 * else InvalidLocalTransactionId */
 	int			pid;			/* Backend's process ID; 0 if prepared xact */
 	int			pgprocno;
+	int			pgxactoff;		/* index into ProcGlobal's dense arrays while
+								 * in the ProcArray, else -1 */
 
 	/* These fields are zero while a backend is still starting up: */
 	BackendId	backendId;		/* This backend's backend ID (if assigned) */
@@ -117,6 +139,11 @@ struct PGPROC
 	Oid			tempNamespaceId;	/* OID of temp schema this backend is
 									 * using */
 
+	/* Protected by ProcArrayLock; see ProcArraySetGlobalTempXids() */
+	TransactionId globalTempFrozenXid;	/* oldest relfrozenxid of this
+										 * backend's global temp storage */
+	MultiXactId globalTempMinMulti; /* oldest relminmxid of same */
+
 	bool		isBackgroundWorker; /* true if background worker. */
 
 	/*
@@ -128,6 +155,8 @@ struct PGPROC
 
 	/* Info about LWLock the process is currently waiting for, if any. */
 	bool		lwWaiting;		/* true if waiting for an LW lock */
+	bool		lwGranted;		/* true if the lock was handed to us on
+								 * wakeup */
 	uint8		lwWaitMode;		/* lwlock mode being waited for */
 	proclist_node lwWaitLink;	/* position in LW lock wait list */
 
@@ -161,6 +190,16 @@ struct PGPROC
 
 	struct XidCache subxids;	/* cache for subtransaction XIDs */
 
+	/*
+	 * Subtransaction XIDs that overflowed subxids, in increasing order.  Only
+	 * the owning backend adds entries; they are cleared at transaction end.
+	 * All three fields are protected by overflowSubxidLock.
+	 */
+	slock_t		overflowSubxidLock;
+	TransactionId overflowTopXid;	/* top-level XID of the entries */
+	int			nOverflowSubxids;	/* number of valid entries */
+	TransactionId *overflowSubxids; /* subxid_overflow_slots entries */
+
 	/* Support for group XID clearing. */
 	/* true, if member of ProcArray group waiting for XID clear */
 	bool		procArrayGroupMember;
@@ -186,12 +225,19 @@ struct PGPROC
 	XLogRecPtr	clogGroupMemberLsn; /* WAL location of commit record for clog
 									 * group member */
 
+	/* Support for group WAL flush. */
+	bool		walFlushGroupMember;	/* true, if member of WAL flush group */
+	pg_atomic_uint32 walFlushGroupNext; /* next WAL flush group member */
+	XLogRecPtr	walFlushGroupUpto;	/* WAL location group member needs
+									 * flushed */
+
 	/* Per-backend LWLock.  Protects fields below (but not group fields). */
 	LWLock		backendLock;
 
 	/* Lock manager data, recording fast-path locks taken by this backend. */
-	uint64		fpLockBits;		/* lock modes held for each fast-path slot */
-	Oid			fpRelId[FP_LOCK_SLOTS_PER_BACKEND]; /* slots for rel oids */
+	uint64	   *fpLockBits;		/* lock modes held for each fast-path slot,
+								 * one word per group of slots */
+	Oid		   *fpRelId;		/* slots for rel oids */
 	bool		fpVXIDLock;		/* are we holding a fast-path VXID lock? */
 	LocalTransactionId fpLocalTransactionId;	/* lxid for fast-path VXID
 												 * lock */
@@ -238,6 +284,16 @@ typedef struct PGXACT
 	uint8		nxids;
 } PGXACT;
 
+/*
+ * Status of a backend's subtransaction XID cache, as kept in
+ * ProcGlobal->subxidStates.
+ */
+typedef struct XidCacheStatus
+{
+	uint8		count;			/* copy of PGXACT->nxids */
+	bool		overflowed;		/* copy of PGXACT->overflowed */
+} XidCacheStatus;
+
 /*
  * There is one ProcGlobal struct for the whole database cluster.
  */
@@ -247,6 +303,22 @@ typedef struct PROC_HDR
 	PGPROC	   *allProcs;
 	/* Array of PGXACT structures (not including dummies for prepared txns) */
 	PGXACT	   *allPgXact;
+
+	/*
+	 * Copies of the PGXACT fields that GetSnapshotData() and
+	 * TransactionIdIsInProgress() look at for every backend, stored densely
+	 * in ProcArray order: entry i belongs to the PGPROC that is i'th in the
+	 * ProcArray, whose pgxactoff is i.  This lets those scans walk a few
+	 * contiguous cache lines rather than chase pgprocnos into allPgXact.
+	 *
+	 * The entries only move when ProcArrayAdd() or ProcArrayRemove() hold
+	 * both ProcArrayLock and XidGenLock exclusively.  A backend updates its
+	 * own entries together with its PGXACT, while holding at least one of
+	 * those locks; readers hold ProcArrayLock.
+	 */
+	TransactionId *xids;
+	XidCacheStatus *subxidStates;
+	uint8	   *vacuumFlags;
 	/* Length of allProcs array */
 	uint32		allProcCount;
 	/* Head of list of free PGPROC structures */
@@ -261,6 +333,8 @@ typedef struct PROC_HDR
 	pg_atomic_uint32 procArrayGroupFirst;
 	/* First pgproc waiting for group transaction status update */
 	pg_atomic_uint32 clogGroupFirst;
+	/* First pgproc waiting for group WAL flush */
+	pg_atomic_uint32 walFlushGroupFirst;
 	/* WALWriter process's latch */
 	Latch	   *walwriterLatch;
 	/* Checkpointer process's latch */
@@ -285,18 +359,21 @@ extern PGPROC *PreparedXactProcs;
  * We set aside some extra PGPROC structures for auxiliary processes,
  * ie things that aren't full-fledged backends but need shmem access.
  *
- * Background writer, checkpointer and WAL writer run during normal operation.
- * Startup process and WAL receiver also consume 2 slots, but WAL writer is
- * launched only after startup has exited, so we only need 4 slots.
+ * Background writer, checkpointer, WAL writer and archiver run during normal
+ * operation.  Startup process and WAL receiver also consume 2 slots, but WAL
+ * writer is launched only after startup has exited, so we only need 5 slots.
  */
-#define NUM_AUXILIARY_PROCS		4
+#define NUM_AUXILIARY_PROCS		5
 
 /* configurable options */
 extern PGDLLIMPORT int DeadlockTimeout;
 extern int	StatementTimeout;
 extern int	LockTimeout;
 extern int	IdleInTransactionSessionTimeout;
+extern int	IdleCacheReleaseTimeout;
 extern bool log_lock_waits;
+extern int	fast_path_lock_slots;
+extern int	subxid_overflow_slots;
 
 
 /*
@@ -72,6 +72,7 @@ extern void RecordKnownAssignedTransactionIds(TransactionId xid);
 extern void ExpireTreeKnownAssignedTransactionIds(TransactionId xid,
 												  int nsubxids, TransactionId *subxids,
 												  TransactionId max_xid);
+extern void KnownAssignedTransactionIdsIdleMaintenance(void);
 extern void ExpireAllKnownAssignedTransactionIds(void);
 extern void ExpireOldKnownAssignedTransactionIds(TransactionId xid);
 
@@ -117,6 +118,9 @@ extern bool CountOtherDBBackends(Oid databaseId,
 extern void XidCacheRemoveRunningXids(TransactionId xid,
 									  int nxids, const TransactionId *xids,
 									  TransactionId latestXid);
+extern void SubXidOverflowAdd(PGPROC *proc, TransactionId topxid,
+							  TransactionId xid);
+extern TransactionId SubXidOverflowGetTopmost(TransactionId xid);
 
 extern void ProcArraySetReplicationSlotXmin(TransactionId xmin,
 											TransactionId catalog_xmin, bool already_locked);
@@ -124,4 +128,10 @@ extern void ProcArraySetReplicationSlotXmin(TransactionId xmin,
 extern void ProcArrayGetReplicationSlotXmin(TransactionId *xmin,
 											TransactionId *catalog_xmin);
 
+extern void ProcArraySetGlobalTempXids(TransactionId frozenxid,
+									   MultiXactId minmulti);
+extern void GetOldestGlobalTempXids(Oid databaseid,
+									TransactionId *frozenxid, Oid *xid_dbid,
+									MultiXactId *minmulti, Oid *multi_dbid);
+
 #endif							/* PROCARRAY_H */
@@ -121,6 +121,29 @@ typedef union
 	SharedInvalSnapshotMsg sn;
 } SharedInvalidationMessage;
 
+/*
+ * When a backend falls so far behind in the shared-inval queue that the
+ * messages it hasn't read must be overwritten, it is handed a summary of
+ * them instead, saying which of its caches they could have affected.  Only
+ * those need to be flushed.  Catcache IDs beyond SINVAL_SUMMARY_MAX_CATCACHES
+ * are summarized as SINVAL_SUMMARY_ALL_CATCACHES.
+ */
+#define SINVAL_SUMMARY_MAX_CATCACHES	128
+
+typedef struct SharedInvalSummary
+{
+	uint64		catcaches[SINVAL_SUMMARY_MAX_CATCACHES / 64];	/* bitmap of
+																 * catcache IDs */
+	uint8		flags;			/* SINVAL_SUMMARY_xxx flags below */
+} SharedInvalSummary;
+
+#define SINVAL_SUMMARY_ALL_CATCACHES	0x01	/* all catcaches */
+#define SINVAL_SUMMARY_RELCACHE			0x02	/* relcache and relmap */
+#define SINVAL_SUMMARY_SMGR				0x04	/* smgr cache */
+
+#define SInvalSummaryHasCatcache(summary, cacheid) \
+	(((summary)->catcaches[(cacheid) / 64] & (UINT64CONST(1) << ((cacheid) % 64))) != 0)
+
 
 /* Counter of messages processed; don't worry about overflow. */
 extern uint64 SharedInvalidMessageCounter;
@@ -130,7 +153,7 @@ extern volatile sig_atomic_t catchupInterruptPending;
 extern void SendSharedInvalidMessages(const SharedInvalidationMessage *msgs,
 									  int n);
 extern void ReceiveSharedInvalidMessages(void (*invalFunction) (SharedInvalidationMessage *msg),
-										 void (*resetFunction) (void));
+										 void (*resetFunction) (const SharedInvalSummary *summary));
 
 /* signal handler for catchup events (PROCSIG_CATCHUP_INTERRUPT) */
 extern void HandleCatchupInterrupt(void);
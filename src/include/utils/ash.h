@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * ash.h
+ *	  Active session history: periodic sampling of running backends.
+ *
+ * See ash.c for comments.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/ash.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef ASH_H
+#define ASH_H
+
+/* GUC parameters */
+extern PGDLLIMPORT int active_session_sample_interval;
+extern PGDLLIMPORT int active_session_history_size;
+
+/*
+ * What this backend is currently doing, as far as the sampler can tell.
+ * These are maintained by the executor and read from the timeout handler.
+ */
+extern volatile uint64 AshCurrentQueryId;
+extern volatile int AshCurrentNodeTag;
+extern volatile int AshCurrentNodeId;
+
+extern Size AshShmemSize(void);
+extern void AshShmemInit(void);
+
+extern void AshStartSampling(void);
+extern void AshStopSampling(void);
+extern void AshSampleTimeoutHandler(void);
+
+#endif							/* ASH_H */
@@ -256,6 +256,7 @@ extern int	log_temp_files;
 extern double log_xact_sample_rate;
 
 extern int	temp_file_limit;
+extern bool temp_file_compression;
 
 extern int	num_temp_buffers;
 
@@ -432,6 +433,11 @@ extern void assign_search_path(const char *newval, void *extra);
 
 /* in access/transam/xlog.c */
 extern bool check_wal_buffers(int *newval, void **extra, GucSource source);
+extern bool check_wal_insert_locks(int *newval, void **extra, GucSource source);
 extern void assign_xlog_sync_method(int new_sync_method, void *extra);
 
+/* in storage/file/fd.c */
+extern bool check_io_direct(char **newval, void **extra, GucSource source);
+extern void assign_io_direct(const char *newval, void *extra);
+
 #endif							/* GUC_H */
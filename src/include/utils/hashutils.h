@@ -25,6 +25,7 @@ extern Datum hash_any_extended(register const unsigned char *k,
 							   register int keylen, uint64 seed);
 extern Datum hash_uint32(uint32 k);
 extern Datum hash_uint32_extended(uint32 k, uint64 seed);
+extern uint32 hash_bytes_fast(const unsigned char *k, int keylen);
 
 /*
  * Combine two 32-bit hash values, resulting in another hash value, with
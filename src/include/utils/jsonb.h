@@ -73,6 +73,7 @@ typedef enum
 #define JsonbPGetDatum(p)	PointerGetDatum(p)
 #define PG_GETARG_JSONB_P(x)	DatumGetJsonbP(PG_GETARG_DATUM(x))
 #define PG_GETARG_JSONB_P_COPY(x)	DatumGetJsonbPCopy(PG_GETARG_DATUM(x))
+#define PG_GETARG_JSONB_P_CACHED(x)	DatumGetJsonbPCached(PG_GETARG_DATUM(x))
 #define PG_RETURN_JSONB_P(x)	PG_RETURN_POINTER(x)
 
 typedef struct JsonbPair JsonbPair;
@@ -364,6 +365,8 @@ extern int	compareJsonbContainers(JsonbContainer *a, JsonbContainer *b);
 extern JsonbValue *findJsonbValueFromContainer(JsonbContainer *sheader,
 											   uint32 flags,
 											   JsonbValue *key);
+extern JsonbValue *findJsonbObjectFieldFromDatum(Datum jsonb, JsonbValue *key);
+extern Jsonb *DatumGetJsonbPCached(Datum jsonb);
 extern JsonbValue *getIthJsonbValueFromContainer(JsonbContainer *sheader,
 												 uint32 i);
 extern JsonbValue *pushJsonbValue(JsonbParseState **pstate,
@@ -386,5 +389,10 @@ extern char *JsonbToCStringIndent(StringInfo out, JsonbContainer *in,
 extern bool JsonbExtractScalar(JsonbContainer *jbc, JsonbValue *res);
 extern const char *JsonbTypeName(JsonbValue *jb);
 
+/* jsonb_typanalyze.c support functions */
+extern text **JsonbStatsElements(Jsonb *jb, int *nelems);
+extern text *JsonbStatsLeafElement(JsonbValue *path, int npath,
+								   JsonbValue *leaf);
+extern text *JsonbStatsKeyElement(const char *key, int keylen);
 
 #endif							/* __JSONB_H__ */
@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * memlimit.h
+ *	  Cluster-wide budget for memory allocated by backends.
+ *
+ * See memlimit.c for comments.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/memlimit.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef MEMLIMIT_H
+#define MEMLIMIT_H
+
+/* GUC parameter */
+extern PGDLLIMPORT int max_total_backend_memory;
+
+extern Size MemoryLimitShmemSize(void);
+extern void MemoryLimitShmemInit(void);
+extern void MemoryLimitAttach(void);
+
+extern Size MemoryLimitClampWorkspace(Size wanted);
+
+#endif							/* MEMLIMIT_H */
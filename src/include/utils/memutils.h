@@ -63,6 +63,21 @@ extern PGDLLIMPORT MemoryContext CurTransactionContext;
 /* This is a transient link to the active portal's memory context: */
 extern PGDLLIMPORT MemoryContext PortalContext;
 
+/*
+ * Memory obtained from malloc() by all live memory contexts of this process,
+ * and the highest value that has reached since it was last reset.
+ */
+extern PGDLLIMPORT Size MemoryContextTotalAllocated;
+extern PGDLLIMPORT Size MemoryContextPeakAllocated;
+
+/*
+ * Thresholds at which the process total is next reported to the cluster-wide
+ * counter; see memlimit.c.
+ */
+extern PGDLLIMPORT Size MemoryLimitReportAbove;
+extern PGDLLIMPORT Size MemoryLimitReportBelow;
+extern void MemoryLimitReport(void);
+
 /* Backwards compatibility macro */
 #define MemoryContextResetAndDeleteChildren(ctx) MemoryContextReset(ctx)
 
@@ -82,10 +97,19 @@ extern void MemoryContextSetParent(MemoryContext context,
 extern Size GetMemoryChunkSpace(void *pointer);
 extern MemoryContext MemoryContextGetParent(MemoryContext context);
 extern bool MemoryContextIsEmpty(MemoryContext context);
+extern Size MemoryContextMemAllocated(MemoryContext context, bool recurse);
+extern void MemoryContextMemConsumed(MemoryContext context,
+									 MemoryContextCounters *consumed);
+extern void MemoryContextBeginPeakTracking(MemoryPeakTracker *tracker);
+extern Size MemoryContextGetPeak(const MemoryPeakTracker *tracker);
+extern void MemoryContextEndPeakTracking(const MemoryPeakTracker *tracker);
 extern void MemoryContextStats(MemoryContext context);
-extern void MemoryContextStatsDetail(MemoryContext context, int max_children);
+extern void MemoryContextStatsDetail(MemoryContext context, int max_children,
+									 bool print_to_stderr);
 extern void MemoryContextAllowInCriticalSection(MemoryContext context,
 												bool allow);
+extern void HandleLogMemoryContextInterrupt(void);
+extern void ProcessLogMemoryContextInterrupt(void);
 
 #ifdef MEMORY_CONTEXT_CHECKING
 extern void MemoryContextCheck(MemoryContext context);
@@ -132,6 +156,38 @@ GetMemoryChunkContext(void *pointer)
 }
 #endif
 
+#ifndef FRONTEND
+/*
+ * MemoryContextNoteAlloc
+ * MemoryContextNoteFree
+ *		Account for a block obtained from or returned to malloc().
+ *
+ * Context types must keep mem_allocated up to date through these, so that
+ * the process-wide totals stay accurate too.  All of a context's memory must
+ * have been accounted as freed by the time its delete_context method returns.
+ */
+static inline void
+MemoryContextNoteAlloc(MemoryContext context, Size size)
+{
+	context->mem_allocated += size;
+	MemoryContextTotalAllocated += size;
+	if (MemoryContextTotalAllocated > MemoryContextPeakAllocated)
+		MemoryContextPeakAllocated = MemoryContextTotalAllocated;
+	if (unlikely(MemoryContextTotalAllocated > MemoryLimitReportAbove))
+		MemoryLimitReport();
+}
+
+static inline void
+MemoryContextNoteFree(MemoryContext context, Size size)
+{
+	Assert(context->mem_allocated >= size);
+	context->mem_allocated -= size;
+	MemoryContextTotalAllocated -= size;
+	if (unlikely(MemoryContextTotalAllocated < MemoryLimitReportBelow))
+		MemoryLimitReport();
+}
+#endif
+
 /*
  * This routine handles the context-type-independent part of memory
  * context creation.  It's intended to be called from context-type-
@@ -181,6 +237,20 @@ extern MemoryContext GenerationContextCreate(MemoryContext parent,
 											 const char *name,
 											 Size blockSize);
 
+/* bump.c */
+extern MemoryContext BumpContextCreate(MemoryContext parent,
+									   const char *name,
+									   Size minContextSize,
+									   Size initBlockSize,
+									   Size maxBlockSize);
+
+/*
+ * Space taken by a chunk of the given size in a bump context, for callers
+ * that need to account for it; GetMemoryChunkSpace() doesn't work there.
+ * This ignores the extra header fields of MEMORY_CONTEXT_CHECKING builds.
+ */
+#define BumpChunkSpace(size)	(MAXALIGN(size) + MAXALIGN(sizeof(void *)))
+
 /*
  * Recommended default alloc parameters, suitable for "ordinary" contexts
  * that might hold quite a lot of data.
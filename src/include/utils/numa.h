@@ -0,0 +1,23 @@
+/*-------------------------------------------------------------------------
+ *
+ * numa.h
+ *	  NUMA node lookup and CPU affinity support.
+ *
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/numa.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef PG_NUMA_H
+#define PG_NUMA_H
+
+/* NUMA node this process is bound to, or -1 */
+extern int	MyNumaNode;
+
+extern int	pg_numa_current_node(void);
+extern bool pg_numa_bind_node(int node);
+
+#endif							/* PG_NUMA_H */
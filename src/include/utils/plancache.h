@@ -19,6 +19,7 @@
 #include "lib/ilist.h"
 #include "nodes/params.h"
 #include "utils/queryenvironment.h"
+#include "utils/resowner.h"
 
 /* Forward declaration, to avoid including parsenodes.h here */
 struct RawStmt;
@@ -28,7 +29,8 @@ typedef enum
 {
 	PLAN_CACHE_MODE_AUTO,
 	PLAN_CACHE_MODE_FORCE_GENERIC_PLAN,
-	PLAN_CACHE_MODE_FORCE_CUSTOM_PLAN
+	PLAN_CACHE_MODE_FORCE_CUSTOM_PLAN,
+	PLAN_CACHE_MODE_ADAPTIVE
 }			PlanCacheMode;
 
 /* GUC parameter */
@@ -122,12 +124,19 @@ typedef struct CachedPlanSource
 	bool		is_saved;		/* has CachedPlanSource been "saved"? */
 	bool		is_valid;		/* is the query_list currently valid? */
 	int			generation;		/* increments each time we create a plan */
+	uint64		source_id;		/* unique ID, also stored in derived plans */
 	/* If CachedPlanSource has been saved, it is a member of a global list */
 	dlist_node	node;			/* list link, if is_saved */
 	/* State kept to help decide whether to use custom or generic plans: */
 	double		generic_cost;	/* cost of generic plan, or -1 if not known */
 	double		total_custom_cost;	/* total cost of custom plans so far */
 	int			num_custom_plans;	/* number of plans included in total */
+	/* Measured run times, used if plan_cache_mode is "adaptive": */
+	double		generic_time;	/* average msec per run of generic plan */
+	double		custom_time;	/* same for custom plans, incl. planning */
+	int			num_generic_runs;	/* runs included in generic_time */
+	int			num_custom_runs;	/* runs included in custom_time */
+	uint64		num_runs;		/* total number of runs measured */
 } CachedPlanSource;
 
 /*
@@ -152,6 +161,9 @@ typedef struct CachedPlan
 	TransactionId saved_xmin;	/* if valid, replan when TransactionXmin
 								 * changes from this value */
 	int			generation;		/* parent's generation number for this plan */
+	uint64		source_id;		/* parent's source_id */
+	bool		is_generic;		/* is it the parent's generic plan? */
+	double		planning_time;	/* msec spent planning, if measured */
 	int			refcount;		/* count of live references to this struct */
 	MemoryContext context;		/* context containing this CachedPlan */
 } CachedPlan;
@@ -210,6 +222,13 @@ extern CachedPlanSource *CopyCachedPlan(CachedPlanSource *plansource);
 
 extern bool CachedPlanIsValid(CachedPlanSource *plansource);
 
+extern bool CachedPlanAllowsSimpleValidityCheck(CachedPlanSource *plansource,
+												CachedPlan *plan,
+												ResourceOwner owner);
+extern bool CachedPlanIsSimplyValid(CachedPlanSource *plansource,
+									CachedPlan *plan,
+									ResourceOwner owner);
+
 extern List *CachedPlanGetTargetList(CachedPlanSource *plansource,
 									 QueryEnvironment *queryEnv);
 
@@ -217,6 +236,8 @@ extern CachedPlan *GetCachedPlan(CachedPlanSource *plansource,
 								 ParamListInfo boundParams,
 								 bool useResOwner,
 								 QueryEnvironment *queryEnv);
+extern void CachedPlanRecordRun(CachedPlanSource *plansource,
+								CachedPlan *plan, double elapsed);
 extern void ReleaseCachedPlan(CachedPlan *plan, bool useResOwner);
 
 extern CachedExpression *GetCachedExpression(Node *expr);
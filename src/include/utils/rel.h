@@ -58,6 +58,8 @@ typedef struct RelationData
 	int			rd_refcnt;		/* reference count */
 	BackendId	rd_backend;		/* owning backend id, if temporary relation */
 	bool		rd_islocaltemp; /* rel is a temp rel of this session */
+	bool		rd_localstorage;	/* global temp rel's storage is known to
+									 * exist in this session */
 	bool		rd_isnailed;	/* rel is nailed in cache */
 	bool		rd_isvalid;		/* relcache entry is valid */
 	bool		rd_indexvalid;	/* is rd_indexlist valid? (also rd_pkindex and
@@ -203,6 +205,13 @@ typedef struct RelationData
 
 	/* use "struct" here to avoid needing to include pgstat.h: */
 	struct PgStat_TableStatus *pgstat_info; /* statistics collection area */
+
+	/*
+	 * Moving average of the fraction of this backend's recent updates of the
+	 * relation whose new tuple version didn't fit on the old one's page.
+	 * Used by heap relations only, see RelationGetAdaptiveFreeSpace().
+	 */
+	float4		rd_update_spill;
 } RelationData;
 
 
@@ -273,6 +282,7 @@ typedef struct StdRdOptions
 	int			parallel_workers;	/* max number of parallel workers */
 	bool		vacuum_index_cleanup;	/* enables index vacuuming and cleanup */
 	bool		vacuum_truncate;	/* enables vacuum to truncate a relation */
+	bool		deduplicate_items;	/* btree: try to deduplicate items? */
 } StdRdOptions;
 
 #define HEAP_MIN_FILLFACTOR			10
@@ -524,7 +534,17 @@ typedef struct ViewOptions
  *		True if relation's pages are stored in local buffers.
  */
 #define RelationUsesLocalBuffers(relation) \
-	((relation)->rd_rel->relpersistence == RELPERSISTENCE_TEMP)
+	((relation)->rd_rel->relpersistence == RELPERSISTENCE_TEMP || \
+	 (relation)->rd_rel->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
+
+/*
+ * RelationIsGlobalTemp
+ *		True if relation is a global temporary table, or an index or toast
+ *		table of one.  Its catalog entries are shared by all sessions, but
+ *		each session has its own, private storage.
+ */
+#define RelationIsGlobalTemp(relation) \
+	((relation)->rd_rel->relpersistence == RELPERSISTENCE_GLOBAL_TEMP)
 
 /*
  * RELATION_IS_LOCAL
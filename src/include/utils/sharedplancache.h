@@ -0,0 +1,40 @@
+/*-------------------------------------------------------------------------
+ *
+ * sharedplancache.h
+ *	  Generic plans shared across backends.
+ *
+ * See sharedplancache.c for comments.
+ *
+ * Portions Copyright (c) 1996-2019, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/utils/sharedplancache.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SHAREDPLANCACHE_H
+#define SHAREDPLANCACHE_H
+
+#include "nodes/pg_list.h"
+#include "utils/plancache.h"
+
+/* GUC parameter */
+extern int	shared_plan_cache_size;
+
+extern Size SharedPlanCacheShmemSize(void);
+extern void SharedPlanCacheShmemInit(void);
+
+extern bool SharedPlanCacheEligible(CachedPlanSource *plansource,
+									QueryEnvironment *queryEnv);
+extern List *SharedPlanCacheLookup(CachedPlanSource *plansource,
+								   uint64 *generation);
+extern bool SharedPlanCacheRecheck(CachedPlanSource *plansource,
+								   uint64 generation);
+extern void SharedPlanCacheStore(CachedPlanSource *plansource,
+								 List *stmt_list);
+
+extern void SharedPlanCacheInvalidateRel(Oid relid);
+extern void SharedPlanCacheInvalidateObject(int cacheid, uint32 hashvalue);
+extern void SharedPlanCacheReset(Oid dbid);
+
+#endif							/* SHAREDPLANCACHE_H */
@@ -338,6 +338,10 @@ static const internalPQconninfoOption PQconninfoOptions[] = {
 		"Replication", "D", 5,
 	offsetof(struct pg_conn, replication)},
 
+	{"compression", "PGCOMPRESSION", "off", NULL,
+		"Compression", "", 10,
+	offsetof(struct pg_conn, compression)},
+
 	{"target_session_attrs", "PGTARGETSESSIONATTRS",
 		DefaultTargetSessionAttrs, NULL,
 		"Target-Session-Attrs", "", 11, /* sizeof("read-write") = 11 */
@@ -372,12 +376,14 @@ static const char short_uri_designator[] = "postgres://";
 
 static bool connectOptions1(PGconn *conn, const char *conninfo);
 static bool connectOptions2(PGconn *conn);
+static bool parse_compression_option(PGconn *conn);
 static int	connectDBStart(PGconn *conn);
 static int	connectDBComplete(PGconn *conn);
 static PGPing internal_ping(PGconn *conn);
 static PGconn *makeEmptyPGconn(void);
 static bool fillPGconn(PGconn *conn, PQconninfoOption *connOptions);
 static void freePGconn(PGconn *conn);
+static void pqFreeCommandQueue(PGcmdQueueEntry *queue);
 static void closePGconn(PGconn *conn);
 static void release_conn_addrinfo(PGconn *conn);
 static void sendTerminateConn(PGconn *conn);
@@ -459,6 +465,20 @@ pqDropConnection(PGconn *conn, bool flushInput)
 	/* Always discard any unsent data */
 	conn->outCount = 0;
 
+	/* Compression starts over with the next connection attempt */
+	if (conn->zpq_stream)
+	{
+		zpq_free(conn->zpq_stream);
+		conn->zpq_stream = NULL;
+	}
+	conn->zpq_tx_raw = 0;
+
+	/* Likewise, discard any pending pipelined commands */
+	pqFreeCommandQueue(conn->cmd_queue_head);
+	conn->cmd_queue_head = conn->cmd_queue_tail = NULL;
+	pqFreeCommandQueue(conn->cmd_queue_recycle);
+	conn->cmd_queue_recycle = NULL;
+
 	/* Free authentication state */
 #ifdef ENABLE_GSS
 	{
@@ -502,6 +522,24 @@ pqDropConnection(PGconn *conn, bool flushInput)
 }
 
 
+/*
+ * pqFreeCommandQueue
+ * Free all the entries of PGcmdQueueEntry queue passed.
+ */
+static void
+pqFreeCommandQueue(PGcmdQueueEntry *queue)
+{
+	while (queue != NULL)
+	{
+		PGcmdQueueEntry *cur = queue;
+
+		queue = cur->next;
+		if (cur->query)
+			free(cur->query);
+		free(cur);
+	}
+}
+
 /*
  *		pqDropServerData
  *
@@ -966,6 +1004,106 @@ parse_comma_separated_list(char **startptr, bool *more)
 	return p;
 }
 
+/*
+ * Parse the compression option into conn->compression_request, the list of
+ * algorithms to offer the server in the startup packet (NULL for none).
+ *
+ * "on" offers every algorithm this build supports, "off" none; otherwise
+ * the value is a comma-separated list of algorithm names, in order of
+ * preference.  Names of algorithms this build can't do are skipped, but
+ * something must be left.
+ *
+ * Returns false and sets errorMessage on trouble.
+ */
+static bool
+parse_compression_option(PGconn *conn)
+{
+	const char *val = conn->compression;
+	PQExpBufferData buf;
+	int			i;
+
+	if (conn->compression_request)
+	{
+		free(conn->compression_request);
+		conn->compression_request = NULL;
+	}
+
+	if (val == NULL || val[0] == '\0' ||
+		strcmp(val, "off") == 0 || strcmp(val, "0") == 0)
+		return true;
+
+	initPQExpBuffer(&buf);
+	if (strcmp(val, "on") == 0 || strcmp(val, "1") == 0)
+	{
+		for (i = ZPQ_NONE + 1; i < ZPQ_NUM_ALGORITHMS; i++)
+		{
+			if (!zpq_algorithm_supported((ZpqAlgorithm) i))
+				continue;
+			if (buf.len > 0)
+				appendPQExpBufferChar(&buf, ',');
+			appendPQExpBufferStr(&buf, zpq_algorithm_name((ZpqAlgorithm) i));
+		}
+	}
+	else
+	{
+		const char *p = val;
+
+		while (*p)
+		{
+			char		name[32];
+			size_t		len = 0;
+			ZpqAlgorithm algorithm;
+
+			while (*p == ',' || *p == ' ')
+				p++;
+			if (*p == '\0')
+				break;
+			while (*p && *p != ',' && *p != ' ')
+			{
+				if (len < sizeof(name) - 1)
+					name[len++] = *p;
+				p++;
+			}
+			name[len] = '\0';
+
+			algorithm = zpq_parse_algorithm(name);
+			if ((int) algorithm <= (int) ZPQ_NONE)
+			{
+				printfPQExpBuffer(&conn->errorMessage,
+								  libpq_gettext("invalid compression value: \"%s\"\n"),
+								  val);
+				termPQExpBuffer(&buf);
+				return false;
+			}
+			if (!zpq_algorithm_supported(algorithm))
+				continue;
+			if (buf.len > 0)
+				appendPQExpBufferChar(&buf, ',');
+			appendPQExpBufferStr(&buf, zpq_algorithm_name(algorithm));
+		}
+	}
+
+	if (PQExpBufferDataBroken(buf))
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("out of memory\n"));
+		termPQExpBuffer(&buf);
+		return false;
+	}
+	if (buf.len == 0)
+	{
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("compression value \"%s\" invalid when no such compression support is compiled in\n"),
+						  val);
+		termPQExpBuffer(&buf);
+		return false;
+	}
+
+	/* hand over the buffer's storage */
+	conn->compression_request = buf.data;
+	return true;
+}
+
 /*
  *		connectOptions2
  *
@@ -1305,6 +1443,15 @@ connectOptions2(PGconn *conn)
 		}
 	}
 
+	/*
+	 * Validate compression option, and work out what to offer the server.
+	 */
+	if (!parse_compression_option(conn))
+	{
+		conn->status = CONNECTION_BAD;
+		return false;
+	}
+
 	/*
 	 * Only if we get this far is it appropriate to try to connect. (We need a
 	 * state flag, rather than just the boolean result of this function, in
@@ -3097,10 +3244,14 @@ keep_going:						/* We will come back to here until there is
 
 				/*
 				 * Validate message type: we expect only an authentication
-				 * request or an error here.  Anything else probably means
-				 * it's not Postgres on the other end at all.
+				 * request or an error here, or an answer to our compression
+				 * request if we made one.  Anything else probably means it's
+				 * not Postgres on the other end at all.
 				 */
-				if (!(beresp == 'R' || beresp == 'E'))
+				if (!(beresp == 'R' || beresp == 'E' ||
+					  (conn->compression_request &&
+					   PG_PROTOCOL_MAJOR(conn->pversion) >= 3 &&
+					   (beresp == 'z' || beresp == 'v'))))
 				{
 					appendPQExpBuffer(&conn->errorMessage,
 									  libpq_gettext(
@@ -3133,7 +3284,8 @@ keep_going:						/* We will come back to here until there is
 				 * length in an error, it means we're really talking to a
 				 * pre-3.0-protocol server; cope.
 				 */
-				if (beresp == 'R' && (msgLength < 8 || msgLength > 2000))
+				if ((beresp == 'R' || beresp == 'z' || beresp == 'v') &&
+					(msgLength < 8 || msgLength > 2000))
 				{
 					appendPQExpBuffer(&conn->errorMessage,
 									  libpq_gettext(
@@ -3197,6 +3349,72 @@ keep_going:						/* We will come back to here until there is
 					return PGRES_POLLING_READING;
 				}
 
+				/*
+				 * A server that doesn't know about compression lists our
+				 * request among the protocol options it doesn't recognize.
+				 * That's fine; we just proceed without compression.
+				 */
+				if (beresp == 'v')
+				{
+					int			newest_version;
+					int			noptions;
+					int			i;
+
+					if (pqGetInt(&newest_version, 4, conn) ||
+						pqGetInt(&noptions, 4, conn))
+						goto error_return;
+					for (i = 0; i < noptions; i++)
+					{
+						if (pqGets(&conn->workBuffer, conn))
+							goto error_return;
+						if (strcmp(conn->workBuffer.data,
+								   "_pq_.compression") != 0)
+						{
+							appendPQExpBuffer(&conn->errorMessage,
+											  libpq_gettext("server does not support protocol option \"%s\"\n"),
+											  conn->workBuffer.data);
+							goto error_return;
+						}
+					}
+					conn->inStart = conn->inCursor;
+					goto keep_going;
+				}
+
+				/*
+				 * The server accepted compression; everything after this
+				 * message is compressed.
+				 */
+				if (beresp == 'z')
+				{
+					ZpqAlgorithm algorithm;
+
+					if (pqGets(&conn->workBuffer, conn))
+						goto error_return;
+					conn->inStart = conn->inCursor;
+
+					algorithm = zpq_parse_algorithm(conn->workBuffer.data);
+					if ((int) algorithm <= (int) ZPQ_NONE ||
+						!zpq_algorithm_supported(algorithm) ||
+						conn->zpq_stream != NULL)
+					{
+						appendPQExpBuffer(&conn->errorMessage,
+										  libpq_gettext("server selected unexpected compression method \"%s\"\n"),
+										  conn->workBuffer.data);
+						goto error_return;
+					}
+					if (pqEnableCompression(conn, algorithm))
+						goto error_return;
+
+					/*
+					 * Whatever followed the acknowledgement in the same read
+					 * is now in the decompressor; pull it out before going
+					 * back to waiting on the socket.
+					 */
+					if (pqReadData(conn) < 0)
+						goto error_return;
+					goto keep_going;
+				}
+
 				/* Handle errors. */
 				if (beresp == 'E')
 				{
@@ -3941,6 +4159,10 @@ freePGconn(PGconn *conn)
 		free(conn->sslcrl);
 	if (conn->sslcompression)
 		free(conn->sslcompression);
+	if (conn->compression)
+		free(conn->compression);
+	if (conn->compression_request)
+		free(conn->compression_request);
 	if (conn->requirepeer)
 		free(conn->requirepeer);
 	if (conn->connip)
@@ -3972,8 +4194,6 @@ freePGconn(PGconn *conn)
 		free(conn->gsslib);
 #endif
 	/* Note that conn->Pfdebug is not ours to close or free */
-	if (conn->last_query)
-		free(conn->last_query);
 	if (conn->write_err_msg)
 		free(conn->write_err_msg);
 	if (conn->inBuffer)
@@ -4063,6 +4283,7 @@ closePGconn(PGconn *conn)
 	conn->status = CONNECTION_BAD;	/* Well, not really _bad_ - just absent */
 	conn->asyncStatus = PGASYNC_IDLE;
 	conn->xactStatus = PQTRANS_IDLE;
+	conn->pipelineStatus = PQ_PIPELINE_OFF;
 	pqClearAsyncResult(conn);	/* deallocate result */
 	resetPQExpBuffer(&conn->errorMessage);
 	release_conn_addrinfo(conn);
@@ -6539,6 +6760,24 @@ PQtransactionStatus(const PGconn *conn)
 	return conn->xactStatus;
 }
 
+PGpipelineStatus
+PQpipelineStatus(const PGconn *conn)
+{
+	if (!conn)
+		return PQ_PIPELINE_OFF;
+
+	return conn->pipelineStatus;
+}
+
+const char *
+PQcompression(const PGconn *conn)
+{
+	if (!conn || !conn->zpq_stream)
+		return NULL;
+
+	return zpq_algorithm_name(zpq_algorithm(conn->zpq_stream));
+}
+
 const char *
 PQparameterStatus(const PGconn *conn, const char *paramName)
 {
@@ -56,6 +56,8 @@
 
 static int	pqPutMsgBytes(const void *buf, size_t len, PGconn *conn);
 static int	pqSendSome(PGconn *conn, int len);
+static ssize_t pqConnRead(PGconn *conn, void *ptr, size_t len);
+static ssize_t pqConnWrite(PGconn *conn, const void *ptr, size_t len);
 static int	pqSocketCheck(PGconn *conn, int forRead, int forWrite,
 						  time_t end_time);
 static int	pqSocketPoll(int sock, int forRead, int forWrite, time_t end_time);
@@ -678,8 +680,8 @@ pqReadData(PGconn *conn)
 
 	/* OK, try to read some data */
 retry3:
-	nread = pqsecure_read(conn, conn->inBuffer + conn->inEnd,
-						  conn->inBufSize - conn->inEnd);
+	nread = pqConnRead(conn, conn->inBuffer + conn->inEnd,
+					   conn->inBufSize - conn->inEnd);
 	if (nread < 0)
 	{
 		if (SOCK_ERRNO == EINTR)
@@ -705,6 +707,19 @@ retry3:
 	{
 		conn->inEnd += nread;
 
+		/*
+		 * If the decompressor still holds output, take it all now: once we
+		 * return, the caller may well wait for the socket to become
+		 * readable, and it won't on account of data we already have.
+		 */
+		if (conn->zpq_stream && zpq_rx_pending(conn->zpq_stream))
+		{
+			if (pqCheckInBufferSpace(conn->inEnd + (size_t) 8192, conn))
+				return -1;
+			someread = 1;
+			goto retry3;
+		}
+
 		/*
 		 * Hack to deal with the fact that some kernels will only give us back
 		 * 1 packet per recv() call, even if we asked for more and there is
@@ -768,8 +783,8 @@ retry3:
 	 * arrived.
 	 */
 retry4:
-	nread = pqsecure_read(conn, conn->inBuffer + conn->inEnd,
-						  conn->inBufSize - conn->inEnd);
+	nread = pqConnRead(conn, conn->inBuffer + conn->inEnd,
+					   conn->inBufSize - conn->inEnd);
 	if (nread < 0)
 	{
 		if (SOCK_ERRNO == EINTR)
@@ -873,7 +888,7 @@ pqSendSome(PGconn *conn, int len)
 		int			sent;
 
 #ifndef WIN32
-		sent = pqsecure_write(conn, ptr, len);
+		sent = pqConnWrite(conn, ptr, len);
 #else
 
 		/*
@@ -881,7 +896,7 @@ pqSendSome(PGconn *conn, int len)
 		 * failure-point appears to be different in different versions of
 		 * Windows, but 64k should always be safe.
 		 */
-		sent = pqsecure_write(conn, ptr, Min(len, 65536));
+		sent = pqConnWrite(conn, ptr, Min(len, 65536));
 #endif
 
 		if (sent < 0)
@@ -1006,6 +1021,137 @@ pqFlush(PGconn *conn)
 	return 0;
 }
 
+/*
+ * pqEnableCompression: start compressing the connection
+ *
+ * Called when the server has acknowledged our compression request.  From
+ * then on, everything is compressed in both directions; anything already
+ * read past the acknowledgement was compressed by the server, and is moved
+ * from the input buffer into the decompressor.
+ *
+ * Return 0 on success, EOF on failure (errorMessage is set).
+ */
+int
+pqEnableCompression(PGconn *conn, ZpqAlgorithm algorithm)
+{
+	ZpqStream  *zs;
+
+	Assert(conn->zpq_stream == NULL);
+	Assert(conn->outCount == 0);
+
+	zs = zpq_create(algorithm);
+	if (zs == NULL ||
+		!zpq_rx_feed(zs, conn->inBuffer + conn->inStart,
+					 conn->inEnd - conn->inStart))
+	{
+		zpq_free(zs);
+		printfPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("out of memory\n"));
+		return EOF;
+	}
+	conn->inEnd = conn->inCursor = conn->inStart;
+
+	conn->zpq_stream = zs;
+	conn->zpq_tx_raw = 0;
+	return 0;
+}
+
+/*
+ * pqConnRead: read from the server, decompressing if needed
+ *
+ * Same API as pqsecure_read().
+ */
+static ssize_t
+pqConnRead(PGconn *conn, void *ptr, size_t len)
+{
+	ZpqStream  *zs = conn->zpq_stream;
+
+	if (zs == NULL)
+		return pqsecure_read(conn, ptr, len);
+
+	for (;;)
+	{
+		ssize_t		n;
+		char	   *buf;
+		size_t		space;
+
+		if (zpq_rx_pending(zs))
+		{
+			n = zpq_decompress(zs, ptr, len);
+			if (n < 0)
+			{
+				printfPQExpBuffer(&conn->errorMessage,
+								  libpq_gettext("could not decompress data received from server\n"));
+				SOCK_ERRNO_SET(EINVAL);
+				return -1;
+			}
+			if (n > 0)
+				return n;
+		}
+
+		/* need more compressed input */
+		buf = zpq_rx_space(zs, &space);
+		if (buf == NULL)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("out of memory\n"));
+			SOCK_ERRNO_SET(ENOMEM);
+			return -1;
+		}
+		n = pqsecure_read(conn, buf, space);
+		if (n <= 0)
+			return n;
+		zpq_rx_added(zs, n);
+	}
+}
+
+/*
+ * pqConnWrite: write to the server, compressing if needed
+ *
+ * Same API as pqsecure_write(), except that with compression, a call that
+ * fails with EAGAIN, EWOULDBLOCK or EINTR must be retried with the same data
+ * (possibly followed by more), because that data has already been
+ * compressed.  The compressed data is only reported as sent once the
+ * transport has taken all of it.  pqSendSome() always retries that way.
+ */
+static ssize_t
+pqConnWrite(PGconn *conn, const void *ptr, size_t len)
+{
+	ZpqStream  *zs = conn->zpq_stream;
+	ssize_t		n;
+
+	if (zs == NULL)
+		return pqsecure_write(conn, ptr, len);
+
+	if (conn->zpq_tx_raw == 0)
+	{
+		if (zpq_compress(zs, ptr, len, &conn->zpq_tx_data,
+						 &conn->zpq_tx_len) != 0)
+		{
+			printfPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("could not compress data to send to server\n"));
+			SOCK_ERRNO_SET(EINVAL);
+			return -1;
+		}
+		conn->zpq_tx_sent = 0;
+		conn->zpq_tx_raw = len;
+	}
+	Assert(len >= conn->zpq_tx_raw);
+
+	while (conn->zpq_tx_sent < conn->zpq_tx_len)
+	{
+		n = pqsecure_write(conn, conn->zpq_tx_data + conn->zpq_tx_sent,
+						   conn->zpq_tx_len - conn->zpq_tx_sent);
+		if (n < 0)
+			return n;
+		conn->zpq_tx_sent += n;
+	}
+
+	n = conn->zpq_tx_raw;
+	conn->zpq_tx_raw = 0;
+	return n;
+}
+
 
 /*
  * pqWait: wait until we can read or write the connection socket
@@ -1092,6 +1238,10 @@ pqSocketCheck(PGconn *conn, int forRead, int forWrite, time_t end_time)
 		return -1;
 	}
 
+	/* Check for the decompressor holding data */
+	if (forRead && conn->zpq_stream && zpq_rx_pending(conn->zpq_stream))
+		return 1;
+
 #ifdef USE_SSL
 	/* Check for SSL library buffering read bytes */
 	if (forRead && conn->ssl_in_use && pgtls_read_pending(conn))
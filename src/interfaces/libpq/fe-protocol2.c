@@ -517,6 +517,7 @@ pqParseInput2(PGconn *conn)
 					conn->asyncStatus = PGASYNC_READY;
 					break;
 				case 'Z':		/* backend is ready for new query */
+					pqCommandQueueAdvance(conn, true, false);
 					conn->asyncStatus = PGASYNC_IDLE;
 					break;
 				case 'I':		/* empty query */
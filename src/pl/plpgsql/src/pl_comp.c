@@ -356,6 +356,7 @@ do_compile(FunctionCallInfo fcinfo,
 	function->out_param_varno = -1; /* set up for no OUT param */
 	function->resolve_option = plpgsql_variable_conflict;
 	function->print_strict_params = plpgsql_print_strict_params;
+	function->jit = plpgsql_jit;
 	/* only promote extra warnings and errors at CREATE FUNCTION time */
 	function->extra_warnings = forValidator ? plpgsql_extra_warnings : 0;
 	function->extra_errors = forValidator ? plpgsql_extra_errors : 0;
@@ -890,6 +891,7 @@ plpgsql_compile_inline(char *proc_source)
 	function->out_param_varno = -1; /* set up for no OUT param */
 	function->resolve_option = plpgsql_variable_conflict;
 	function->print_strict_params = plpgsql_print_strict_params;
+	function->jit = plpgsql_jit;
 
 	/*
 	 * don't do extra validation for inline code as we don't want to add spam
@@ -305,6 +305,7 @@ static	void			check_raise_parameters(PLpgSQL_stmt_raise *stmt);
 %token <keyword>	K_INSERT
 %token <keyword>	K_INTO
 %token <keyword>	K_IS
+%token <keyword>	K_JIT
 %token <keyword>	K_LAST
 %token <keyword>	K_LOG
 %token <keyword>	K_LOOP
@@ -383,6 +384,15 @@ comp_option		: '#' K_OPTION K_DUMP
 						else
 							elog(ERROR, "unrecognized print_strict_params option %s", $3);
 					}
+				| '#' K_JIT option_value
+					{
+						if (strcmp($3, "on") == 0)
+							plpgsql_curr_compile->jit = true;
+						else if (strcmp($3, "off") == 0)
+							plpgsql_curr_compile->jit = false;
+						else
+							elog(ERROR, "unrecognized jit option %s", $3);
+					}
 				| '#' K_VARIABLE_CONFLICT K_ERROR
 					{
 						plpgsql_curr_compile->resolve_option = PLPGSQL_RESOLVE_ERROR;
@@ -2536,6 +2546,7 @@ unreserved_keyword	:
 				| K_INFO
 				| K_INSERT
 				| K_IS
+				| K_JIT
 				| K_LAST
 				| K_LOG
 				| K_MESSAGE
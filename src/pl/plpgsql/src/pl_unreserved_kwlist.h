@@ -68,6 +68,7 @@ PG_KEYWORD("import", K_IMPORT)
 PG_KEYWORD("info", K_INFO)
 PG_KEYWORD("insert", K_INSERT)
 PG_KEYWORD("is", K_IS)
+PG_KEYWORD("jit", K_JIT)
 PG_KEYWORD("last", K_LAST)
 PG_KEYWORD("log", K_LOG)
 PG_KEYWORD("message", K_MESSAGE)
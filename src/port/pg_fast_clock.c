@@ -0,0 +1,129 @@
+/*-------------------------------------------------------------------------
+ *
+ * pg_fast_clock.c
+ *	  Calibrate the CPU timestamp counter for use as an interval timer.
+ *
+ * INSTR_TIME_SET_CURRENT_FAST() reads the timestamp counter directly and
+ * scales it to nanoseconds with the factor computed here.  We only trust the
+ * counter if the CPU advertises it as invariant (constant rate regardless of
+ * frequency scaling and sleep states, and synchronized across cores), and if
+ * two independent measurements of its rate against the system clock agree.
+ * Otherwise INSTR_TIME_SET_CURRENT_FAST() falls back to clock_gettime().
+ *
+ * Calibration sleeps for a few milliseconds, so it should be done once per
+ * process tree; the postmaster does it at startup and forked children
+ * inherit the result.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/port/pg_fast_clock.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "c.h"
+
+#include <math.h>
+
+#include "portability/instr_time.h"
+
+#ifdef PG_HAVE_FAST_CLOCK
+
+#include <cpuid.h>
+
+/* length of each calibration window, in microseconds */
+#define FAST_CLOCK_CALIBRATION_USEC		5000
+
+/* the two calibration windows must agree to within this fraction */
+#define FAST_CLOCK_MAX_SKEW				0.01
+
+bool		pg_fast_clock_enabled = false;
+double		pg_fast_clock_ns_per_tick = 0;
+uint64		pg_fast_clock_base = 0;
+
+static bool fast_clock_initialized = false;
+
+/*
+ * Measure nanoseconds per timestamp counter tick over one sleep.  Returns
+ * zero if the counter did not advance.
+ */
+static double
+calibrate_window(void)
+{
+	struct timespec start,
+				end;
+	uint64		tsc_start,
+				tsc_end;
+	double		elapsed_ns;
+
+	clock_gettime(PG_INSTR_CLOCK, &start);
+	tsc_start = pg_rdtsc();
+
+	pg_usleep(FAST_CLOCK_CALIBRATION_USEC);
+
+	clock_gettime(PG_INSTR_CLOCK, &end);
+	tsc_end = pg_rdtsc();
+
+	if (tsc_end <= tsc_start)
+		return 0;
+
+	elapsed_ns = (double) (end.tv_sec - start.tv_sec) * 1000000000.0 +
+		(double) (end.tv_nsec - start.tv_nsec);
+
+	return elapsed_ns / (double) (tsc_end - tsc_start);
+}
+
+/*
+ * Decide whether the timestamp counter can be used, and calibrate it if so.
+ *
+ * Returns true if INSTR_TIME_SET_CURRENT_FAST() will use the counter.  The
+ * answer is cached, so repeated calls are cheap.
+ */
+bool
+pg_initialize_fast_clock(void)
+{
+	unsigned int eax,
+				ebx,
+				ecx,
+				edx;
+	double		first,
+				second;
+
+	if (fast_clock_initialized)
+		return pg_fast_clock_enabled;
+	fast_clock_initialized = true;
+
+	/* Invariant TSC is reported in CPUID.80000007H:EDX[8] */
+	if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0 ||
+		(edx & (1 << 8)) == 0)
+		return false;
+
+	pg_fast_clock_base = pg_rdtsc();
+
+	first = calibrate_window();
+	second = calibrate_window();
+
+	/*
+	 * Reject rates outside 100MHz..10GHz as well as windows that disagree;
+	 * either suggests a virtualized or otherwise unreliable counter.
+	 */
+	if (first < 0.1 || first > 10.0 || second < 0.1 || second > 10.0)
+		return false;
+	if (fabs(first - second) > FAST_CLOCK_MAX_SKEW * second)
+		return false;
+
+	pg_fast_clock_ns_per_tick = (first + second) / 2;
+	pg_fast_clock_enabled = true;
+
+	return true;
+}
+
+#else							/* !PG_HAVE_FAST_CLOCK */
+
+bool
+pg_initialize_fast_clock(void)
+{
+	return false;
+}
+
+#endif							/* PG_HAVE_FAST_CLOCK */
@@ -0,0 +1,28 @@
+# Run the libpq_pipeline test program against a fresh server
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More;
+
+my $node = get_new_node('main');
+$node->init;
+$node->start;
+
+my $libpq_pipeline = "$ENV{TESTDIR}/libpq_pipeline";
+
+my ($out, $err) = run_command([ $libpq_pipeline, 'tests' ]);
+die "oops: $err" unless $err eq '';
+my @tests = split(/\s+/, $out);
+
+plan tests => scalar @tests;
+
+for my $testname (@tests)
+{
+	$node->command_ok(
+		[ $libpq_pipeline, $testname, $node->connstr('postgres') ],
+		"libpq_pipeline $testname");
+}
+
+$node->stop('fast');
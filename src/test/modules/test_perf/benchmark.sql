@@ -0,0 +1,3 @@
+-- Run all benchmarks with their default sizes.  See "make benchmark".
+CREATE EXTENSION IF NOT EXISTS test_perf;
+SELECT * FROM test_perf_all();
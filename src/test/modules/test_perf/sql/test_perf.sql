@@ -0,0 +1,13 @@
+CREATE EXTENSION test_perf;
+
+-- The timings depend on the machine, so just check that everything runs
+SELECT benchmark, ops, ns_per_op > 0 AS ok FROM test_perf_simplehash(10000);
+SELECT benchmark, ops, ns_per_op > 0 AS ok FROM test_perf_dynahash(10000);
+SELECT benchmark, ops, ns_per_op > 0 AS ok FROM test_perf_tuplesort(10000);
+SELECT benchmark, ops, ns_per_op > 0 AS ok FROM test_perf_lwlock(2, 10000);
+SELECT benchmark, ops, ns_per_op > 0 AS ok FROM test_perf_lwlock(2, 10000, true);
+SELECT benchmark, ops, ns_per_op > 0 AS ok FROM test_perf_expr('i % 7 = 0', 10000);
+
+-- errors
+SELECT * FROM test_perf_simplehash(0);
+SELECT * FROM test_perf_lwlock(0, 10);
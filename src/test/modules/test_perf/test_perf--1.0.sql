@@ -0,0 +1,59 @@
+/* src/test/modules/test_perf/test_perf--1.0.sql */
+
+-- complain if script is sourced in psql, rather than via CREATE EXTENSION
+\echo Use "CREATE EXTENSION test_perf" to load this file. \quit
+
+CREATE FUNCTION test_perf_simplehash(nelements bigint,
+	OUT benchmark text, OUT ops bigint,
+	OUT ns_per_op float8, OUT ops_per_sec float8)
+RETURNS SETOF record STRICT
+AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION test_perf_dynahash(nelements bigint,
+	OUT benchmark text, OUT ops bigint,
+	OUT ns_per_op float8, OUT ops_per_sec float8)
+RETURNS SETOF record STRICT
+AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION test_perf_tuplesort(nelements bigint,
+	OUT benchmark text, OUT ops bigint,
+	OUT ns_per_op float8, OUT ops_per_sec float8)
+RETURNS SETOF record STRICT
+AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION test_perf_lwlock(nworkers int, nloops bigint,
+	shared_mode bool DEFAULT false,
+	OUT benchmark text, OUT ops bigint,
+	OUT ns_per_op float8, OUT ops_per_sec float8)
+RETURNS SETOF record STRICT
+AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION test_perf_expr(expr text, nrows bigint,
+	OUT benchmark text, OUT ops bigint,
+	OUT ns_per_op float8, OUT ops_per_sec float8)
+RETURNS SETOF record STRICT
+AS 'MODULE_PATHNAME' LANGUAGE C;
+
+CREATE FUNCTION test_perf_all(
+	OUT benchmark text, OUT ops bigint,
+	OUT ns_per_op float8, OUT ops_per_sec float8)
+RETURNS SETOF record
+AS $$
+	SELECT * FROM test_perf_simplehash(1000000)
+	UNION ALL
+	SELECT * FROM test_perf_dynahash(1000000)
+	UNION ALL
+	SELECT * FROM test_perf_tuplesort(1000000)
+	UNION ALL
+	SELECT * FROM test_perf_lwlock(1, 10000000)
+	UNION ALL
+	SELECT * FROM test_perf_lwlock(4, 10000000)
+	UNION ALL
+	SELECT * FROM test_perf_lwlock(4, 10000000, true)
+	UNION ALL
+	SELECT * FROM test_perf_expr('i', 1000000)
+	UNION ALL
+	SELECT * FROM test_perf_expr('i * 2 + 1 > 100', 1000000)
+	UNION ALL
+	SELECT * FROM test_perf_expr('i::text', 1000000)
+$$ LANGUAGE sql;
@@ -0,0 +1,576 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_perf.c
+ *		Micro-benchmarks for core data structures and code paths.
+ *
+ * Each benchmark function returns a set of (benchmark, ops, ns_per_op,
+ * ops_per_sec) rows, one for each operation it measured.
+ *
+ * Copyright (c) 2019, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_perf/test_perf.c
+ *
+ * -------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "catalog/pg_operator.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "portability/instr_time.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hashutils.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/tuplesort.h"
+#include "utils/tuplestore.h"
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(test_perf_simplehash);
+PG_FUNCTION_INFO_V1(test_perf_dynahash);
+PG_FUNCTION_INFO_V1(test_perf_tuplesort);
+PG_FUNCTION_INFO_V1(test_perf_lwlock);
+PG_FUNCTION_INFO_V1(test_perf_expr);
+
+extern PGDLLEXPORT void test_perf_lwlock_main(Datum main_arg);
+
+/*
+ * Keys are spread over the whole uint32 range by multiplying with an odd
+ * constant, so that consecutive keys don't hash to consecutive buckets.
+ */
+#define PERF_KEY(i)		((uint32) (i) * 2654435761U)
+
+/* simplehash table of uint32 keys */
+typedef struct perf_hash_entry
+{
+	uint32		key;
+	char		status;
+} perf_hash_entry;
+
+#define SH_PREFIX perfhash
+#define SH_ELEMENT_TYPE perf_hash_entry
+#define SH_KEY_TYPE uint32
+#define SH_KEY key
+#define SH_HASH_KEY(tb, key) murmurhash32(key)
+#define SH_EQUAL(tb, a, b) ((a) == (b))
+#define SH_SCOPE static inline
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+/* State shared with the workers of test_perf_lwlock */
+typedef struct PerfLWLockShared
+{
+	LWLock		lock;
+	int			tranche_id;
+	bool		shared_mode;
+	int64		nloops;
+	uint64		counter;		/* incremented under the lock, in exclusive
+								 * mode */
+	pg_atomic_uint32 nready;	/* number of workers waiting to start */
+	pg_atomic_uint32 go;		/* set by the leader to start the workers */
+	pg_atomic_uint32 ndone;		/* number of workers finished */
+} PerfLWLockShared;
+
+typedef struct PerfWorkers
+{
+	int			nworkers;
+	BackgroundWorkerHandle *handle[FLEXIBLE_ARRAY_MEMBER];
+} PerfWorkers;
+
+/* Result set under construction */
+typedef struct PerfResults
+{
+	Tuplestorestate *tupstore;
+	TupleDesc	tupdesc;
+} PerfResults;
+
+static void init_results(FunctionCallInfo fcinfo, PerfResults *results);
+static void add_result(PerfResults *results, const char *benchmark,
+					   int64 ops, instr_time elapsed);
+static void check_count(int64 count, const char *what);
+static void wait_for_workers(PerfWorkers *workers, pg_atomic_uint32 *counter);
+static void terminate_workers(dsm_segment *seg, Datum arg);
+
+/*
+ * Prepare to return the results in materialize mode.
+ */
+static void
+init_results(FunctionCallInfo fcinfo, PerfResults *results)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	MemoryContext oldcontext;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	results->tupdesc = CreateTupleDescCopy(tupdesc);
+	results->tupstore = tuplestore_begin_heap(true, false, work_mem);
+	MemoryContextSwitchTo(oldcontext);
+
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = results->tupstore;
+	rsinfo->setDesc = results->tupdesc;
+}
+
+/*
+ * Add a result row for 'ops' operations that took 'elapsed'.
+ */
+static void
+add_result(PerfResults *results, const char *benchmark, int64 ops,
+		   instr_time elapsed)
+{
+	Datum		values[4];
+	bool		nulls[4];
+	double		secs = INSTR_TIME_GET_DOUBLE(elapsed);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = CStringGetTextDatum(benchmark);
+	values[1] = Int64GetDatum(ops);
+	values[2] = Float8GetDatum(ops > 0 ? secs * 1e9 / ops : 0);
+	values[3] = Float8GetDatum(secs > 0 ? ops / secs : 0);
+
+	tuplestore_putvalues(results->tupstore, results->tupdesc, values, nulls);
+}
+
+static void
+check_count(int64 count, const char *what)
+{
+	if (count <= 0 || count > PG_INT32_MAX)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("%s must be between 1 and %d", what, PG_INT32_MAX)));
+}
+
+/*
+ * Insert and look up 'nelements' keys in a simplehash table.
+ */
+Datum
+test_perf_simplehash(PG_FUNCTION_ARGS)
+{
+	int64		nelements = PG_GETARG_INT64(0);
+	PerfResults results;
+	MemoryContext cxt;
+	MemoryContext oldcontext;
+	perfhash_hash *tb;
+	instr_time	start;
+	instr_time	elapsed;
+	int64		nfound = 0;
+	int64		i;
+
+	check_count(nelements, "number of elements");
+	init_results(fcinfo, &results);
+
+	cxt = AllocSetContextCreate(CurrentMemoryContext, "test_perf",
+								ALLOCSET_DEFAULT_SIZES);
+	oldcontext = MemoryContextSwitchTo(cxt);
+
+	tb = perfhash_create(cxt, 256, NULL);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < nelements; i++)
+	{
+		bool		found;
+
+		perfhash_insert(tb, PERF_KEY(i), &found);
+	}
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	add_result(&results, "simplehash insert", nelements, elapsed);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < nelements; i++)
+	{
+		if (perfhash_lookup(tb, PERF_KEY(i)) != NULL)
+			nfound++;
+	}
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	add_result(&results, "simplehash lookup", nelements, elapsed);
+
+	if (nfound != nelements)
+		elog(ERROR, "found " INT64_FORMAT " of " INT64_FORMAT " keys",
+			 nfound, nelements);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(cxt);
+
+	return (Datum) 0;
+}
+
+/*
+ * Insert and look up 'nelements' keys in a dynahash table.
+ */
+Datum
+test_perf_dynahash(PG_FUNCTION_ARGS)
+{
+	int64		nelements = PG_GETARG_INT64(0);
+	PerfResults results;
+	HASHCTL		ctl;
+	HTAB	   *htab;
+	instr_time	start;
+	instr_time	elapsed;
+	int64		nfound = 0;
+	int64		i;
+
+	check_count(nelements, "number of elements");
+	init_results(fcinfo, &results);
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(uint32);
+	ctl.entrysize = sizeof(uint32);
+	ctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("test_perf dynahash", 256, &ctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < nelements; i++)
+	{
+		uint32		key = PERF_KEY(i);
+
+		(void) hash_search(htab, &key, HASH_ENTER, NULL);
+	}
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	add_result(&results, "dynahash insert", nelements, elapsed);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < nelements; i++)
+	{
+		uint32		key = PERF_KEY(i);
+
+		if (hash_search(htab, &key, HASH_FIND, NULL) != NULL)
+			nfound++;
+	}
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	add_result(&results, "dynahash lookup", nelements, elapsed);
+
+	if (nfound != nelements)
+		elog(ERROR, "found " INT64_FORMAT " of " INT64_FORMAT " keys",
+			 nfound, nelements);
+
+	hash_destroy(htab);
+
+	return (Datum) 0;
+}
+
+/*
+ * Sort 'nelements' pseudo-random int4 datums in memory.
+ */
+Datum
+test_perf_tuplesort(PG_FUNCTION_ARGS)
+{
+	int64		nelements = PG_GETARG_INT64(0);
+	PerfResults results;
+	Tuplesortstate *state;
+	instr_time	start;
+	instr_time	elapsed;
+	Datum		val;
+	bool		isnull;
+	int32		prev = PG_INT32_MIN;
+	int64		i;
+
+	check_count(nelements, "number of elements");
+	init_results(fcinfo, &results);
+
+	/*
+	 * Use enough memory for the sort to stay in memory; we want to measure
+	 * the comparisons, not the I/O.
+	 */
+	state = tuplesort_begin_datum(INT4OID, Int4LessOperator, InvalidOid,
+								  false, MAX_KILOBYTES, NULL, false);
+
+	INSTR_TIME_SET_CURRENT(start);
+	for (i = 0; i < nelements; i++)
+		tuplesort_putdatum(state, Int32GetDatum((int32) PERF_KEY(i)), false);
+	tuplesort_performsort(state);
+	for (i = 0; i < nelements; i++)
+	{
+		if (!tuplesort_getdatum(state, true, &val, &isnull, NULL))
+			elog(ERROR, "sort returned too few values");
+		if (DatumGetInt32(val) < prev)
+			elog(ERROR, "sort returned values out of order");
+		prev = DatumGetInt32(val);
+	}
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+	add_result(&results, "tuplesort int4", nelements, elapsed);
+
+	tuplesort_end(state);
+
+	return (Datum) 0;
+}
+
+/*
+ * Acquire and release an LWLock 'nloops' times in each of 'nworkers'
+ * background workers at the same time.
+ *
+ * The result is the total number of acquisitions and the throughput over
+ * all workers.
+ */
+Datum
+test_perf_lwlock(PG_FUNCTION_ARGS)
+{
+	int32		nworkers = PG_GETARG_INT32(0);
+	int64		nloops = PG_GETARG_INT64(1);
+	bool		shared_mode = PG_GETARG_BOOL(2);
+	PerfResults results;
+	dsm_segment *seg;
+	PerfLWLockShared *shared;
+	PerfWorkers *workers;
+	BackgroundWorker worker;
+	instr_time	start;
+	instr_time	elapsed;
+	int			i;
+
+	if (nworkers < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of workers must be at least 1")));
+	if (nworkers > max_worker_processes)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of workers cannot exceed max_worker_processes (%d)",
+						max_worker_processes)));
+	check_count(nloops, "number of loops");
+	init_results(fcinfo, &results);
+
+	seg = dsm_create(sizeof(PerfLWLockShared), 0);
+	shared = dsm_segment_address(seg);
+	shared->tranche_id = LWLockNewTrancheId();
+	LWLockRegisterTranche(shared->tranche_id, "test_perf");
+	LWLockInitialize(&shared->lock, shared->tranche_id);
+	shared->shared_mode = shared_mode;
+	shared->nloops = nloops;
+	shared->counter = 0;
+	pg_atomic_init_u32(&shared->nready, 0);
+	pg_atomic_init_u32(&shared->go, 0);
+	pg_atomic_init_u32(&shared->ndone, 0);
+
+	/*
+	 * Make sure the workers are gone if we error out.  The handles must live
+	 * until the segment is detached at the end of the transaction.
+	 */
+	workers = MemoryContextAlloc(TopTransactionContext,
+								 offsetof(PerfWorkers, handle) +
+								 sizeof(BackgroundWorkerHandle *) * nworkers);
+	workers->nworkers = 0;
+	on_dsm_detach(seg, terminate_workers, PointerGetDatum(workers));
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	sprintf(worker.bgw_library_name, "test_perf");
+	sprintf(worker.bgw_function_name, "test_perf_lwlock_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "test_perf lwlock worker");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "test_perf");
+	worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(seg));
+	worker.bgw_notify_pid = MyProcPid;
+
+	for (i = 0; i < nworkers; i++)
+	{
+		BackgroundWorkerHandle *handle;
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("could not register background process"),
+					 errhint("You may need to increase max_worker_processes.")));
+		workers->handle[workers->nworkers++] = handle;
+	}
+
+	/* Start the clock once all the workers are ready */
+	wait_for_workers(workers, &shared->nready);
+	INSTR_TIME_SET_CURRENT(start);
+	pg_atomic_write_u32(&shared->go, 1);
+	wait_for_workers(workers, &shared->ndone);
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	if (!shared_mode && shared->counter != (uint64) nworkers * nloops)
+		elog(ERROR, "LWLock did not provide mutual exclusion");
+
+	add_result(&results,
+			   psprintf("lwlock %s, %d backends",
+						shared_mode ? "shared" : "exclusive", nworkers),
+			   nworkers * nloops, elapsed);
+
+	dsm_detach(seg);
+
+	return (Datum) 0;
+}
+
+/*
+ * Wait until 'counter' reaches the number of workers.
+ *
+ * Workers set the counters before they exit, so if more of them have
+ * stopped than the counter shows, one must have failed.
+ */
+static void
+wait_for_workers(PerfWorkers *workers, pg_atomic_uint32 *counter)
+{
+	for (;;)
+	{
+		int			nstopped = 0;
+		int			i;
+
+		for (i = 0; i < workers->nworkers; i++)
+		{
+			pid_t		pid;
+
+			if (GetBackgroundWorkerPid(workers->handle[i], &pid) == BGWH_STOPPED)
+				nstopped++;
+		}
+
+		if (pg_atomic_read_u32(counter) >= (uint32) workers->nworkers)
+			break;
+		if ((uint32) nstopped > pg_atomic_read_u32(counter))
+			ereport(ERROR,
+					(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+					 errmsg("background worker exited unexpectedly")));
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 1L, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+static void
+terminate_workers(dsm_segment *seg, Datum arg)
+{
+	PerfWorkers *workers = (PerfWorkers *) DatumGetPointer(arg);
+
+	while (workers->nworkers > 0)
+	{
+		--workers->nworkers;
+		TerminateBackgroundWorker(workers->handle[workers->nworkers]);
+	}
+}
+
+/*
+ * Main function of the test_perf_lwlock workers.
+ */
+void
+test_perf_lwlock_main(Datum main_arg)
+{
+	dsm_segment *seg;
+	PerfLWLockShared *shared;
+	int64		i;
+
+	BackgroundWorkerUnblockSignals();
+
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+	shared = dsm_segment_address(seg);
+	LWLockRegisterTranche(shared->tranche_id, "test_perf");
+
+	pg_atomic_fetch_add_u32(&shared->nready, 1);
+	while (pg_atomic_read_u32(&shared->go) == 0)
+	{
+		CHECK_FOR_INTERRUPTS();
+		pg_usleep(100L);
+	}
+
+	if (shared->shared_mode)
+	{
+		for (i = 0; i < shared->nloops; i++)
+		{
+			LWLockAcquire(&shared->lock, LW_SHARED);
+			LWLockRelease(&shared->lock);
+		}
+	}
+	else
+	{
+		for (i = 0; i < shared->nloops; i++)
+		{
+			LWLockAcquire(&shared->lock, LW_EXCLUSIVE);
+			shared->counter++;
+			LWLockRelease(&shared->lock);
+		}
+	}
+
+	pg_atomic_fetch_add_u32(&shared->ndone, 1);
+
+	dsm_detach(seg);
+}
+
+/*
+ * Evaluate 'expr' for 'nrows' rows, in which the column "i" runs from 1
+ * to 'nrows'.
+ *
+ * This includes the cost of generating the rows and of the count()
+ * aggregate, so compare different expressions with each other (or with
+ * just "i") rather than looking at the absolute numbers.
+ */
+Datum
+test_perf_expr(PG_FUNCTION_ARGS)
+{
+	char	   *expr = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	int64		nrows = PG_GETARG_INT64(1);
+	PerfResults results;
+	char	   *query;
+	SPIPlanPtr	plan;
+	instr_time	start;
+	instr_time	elapsed;
+	int			ret;
+
+	check_count(nrows, "number of rows");
+	init_results(fcinfo, &results);
+
+	query = psprintf("SELECT count((%s)) FROM generate_series(1, " INT64_FORMAT ") AS t(i)",
+					 expr, nrows);
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	plan = SPI_prepare(query, 0, NULL);
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare failed for \"%s\": %s",
+			 query, SPI_result_code_string(SPI_result));
+
+	INSTR_TIME_SET_CURRENT(start);
+	ret = SPI_execute_plan(plan, NULL, NULL, true, 0);
+	INSTR_TIME_SET_CURRENT(elapsed);
+	INSTR_TIME_SUBTRACT(elapsed, start);
+
+	if (ret != SPI_OK_SELECT)
+		elog(ERROR, "SPI_execute_plan failed for \"%s\": %s",
+			 query, SPI_result_code_string(ret));
+
+	SPI_finish();
+
+	add_result(&results, psprintf("expression %s", expr), nrows, elapsed);
+
+	return (Datum) 0;
+}
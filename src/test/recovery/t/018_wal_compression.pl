@@ -0,0 +1,42 @@
+# Test streaming replication with compressed WAL data messages
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 3;
+
+# Initialize master node
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->start;
+my $backup_name = 'my_backup';
+
+$node_master->backup($backup_name);
+
+# Create streaming standby asking for compression
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf('postgresql.conf',
+	"wal_receiver_compression = on");
+$node_standby->start;
+
+# Generate some easily compressible WAL
+$node_master->safe_psql('postgres',
+	"CREATE TABLE tab_int AS SELECT generate_series(1, 10000) AS a, repeat('x', 100) AS b"
+);
+
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+
+my $result =
+  $node_standby->safe_psql('postgres', "SELECT count(*) FROM tab_int");
+is($result, qq(10000), 'data replicated to standby');
+
+$result = $node_master->safe_psql('postgres',
+	"SELECT compression FROM pg_stat_replication");
+is($result, qq(t), 'walsender reports compression');
+
+$result = $node_master->safe_psql('postgres',
+	"SELECT sent_compressed_bytes < sent_bytes FROM pg_stat_replication");
+is($result, qq(t), 'WAL was sent compressed');
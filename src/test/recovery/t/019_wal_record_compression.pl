@@ -0,0 +1,44 @@
+# Test replay of WAL records compressed as a whole
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 2;
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->append_conf('postgresql.conf', "wal_record_compression = on");
+$node_master->start;
+my $backup_name = 'my_backup';
+
+$node_master->backup($backup_name);
+
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+# Multi-row inserts and wide tuples produce large, compressible records,
+# and so do the full-page images of a table rewrite.
+$node_master->safe_psql(
+	'postgres', qq(
+	CREATE TABLE tab_int (a int, b text);
+	INSERT INTO tab_int SELECT i, repeat('x', 1000) FROM generate_series(1, 1000) i;
+	INSERT INTO tab_int SELECT i, repeat('y', 200) FROM generate_series(1001, 2000) i;
+	CHECKPOINT;
+	UPDATE tab_int SET b = b || 'z' WHERE a % 10 = 0;
+	));
+
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+
+my $query = "SELECT count(*), sum(length(b)) FROM tab_int";
+my $expected = $node_master->safe_psql('postgres', $query);
+my $result = $node_standby->safe_psql('postgres', $query);
+is($result, $expected, 'compressed records replayed on standby');
+
+# Crash recovery must replay them too
+$node_master->stop('immediate');
+$node_master->start;
+$result = $node_master->safe_psql('postgres', $query);
+is($result, $expected, 'compressed records replayed by crash recovery');
@@ -0,0 +1,63 @@
+# Test replay of WAL by parallel redo workers
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 4;
+
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->append_conf('postgresql.conf', "parallel_redo_workers = 4");
+$node_master->start;
+my $backup_name = 'my_backup';
+
+$node_master->backup($backup_name);
+
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+# Make the workers decode many records of different shapes one after the
+# other: full-page images after each checkpoint, updates that move tuples to
+# another page, and index page splits, which touch several blocks each.
+$node_master->safe_psql(
+	'postgres', qq(
+	CREATE TABLE tab_int (a int, b text);
+	CREATE INDEX tab_int_b ON tab_int (b);
+	INSERT INTO tab_int SELECT i, repeat('x', 500) || i FROM generate_series(1, 2000) i;
+	CHECKPOINT;
+	UPDATE tab_int SET b = repeat('y', 700) || a WHERE a % 3 = 0;
+	CHECKPOINT;
+	UPDATE tab_int SET b = b || 'z' WHERE a % 5 = 0;
+	DELETE FROM tab_int WHERE a % 7 = 0;
+	VACUUM tab_int;
+	INSERT INTO tab_int SELECT i, repeat('w', 100) || i FROM generate_series(2001, 4000) i;
+	));
+
+$node_master->wait_for_catchup($node_standby, 'replay',
+	$node_master->lsn('insert'));
+
+ok( slurp_file($node_standby->logfile) =~
+	  qr/replaying WAL with 4 parallel redo workers/,
+	'standby replays WAL with parallel redo workers');
+
+my $query =
+  "SELECT count(*), sum(length(b)), count(DISTINCT b) FROM tab_int WHERE b > ''";
+my $expected = $node_master->safe_psql('postgres', $query);
+my $result = $node_standby->safe_psql('postgres', $query);
+is($result, $expected, 'records replayed on standby by parallel redo');
+
+# Crash recovery uses the workers too
+$node_master->safe_psql('postgres',
+	"UPDATE tab_int SET b = b || 'v' WHERE a % 2 = 0");
+$expected = $node_master->safe_psql('postgres', $query);
+$node_master->stop('immediate');
+$node_master->start;
+
+ok( slurp_file($node_master->logfile) =~
+	  qr/replaying WAL with 4 parallel redo workers/,
+	'crash recovery replays WAL with parallel redo workers');
+
+$result = $node_master->safe_psql('postgres', $query);
+is($result, $expected, 'records replayed by crash recovery with parallel redo');
@@ -0,0 +1,37 @@
+# Test the largest number of WAL insertion locks
+use strict;
+use warnings;
+use PostgresNode;
+use TestLib;
+use Test::More tests => 3;
+
+my $node = get_new_node('master');
+$node->init;
+$node->append_conf('postgresql.conf', "wal_insert_locks = 128");
+$node->start;
+
+# A checkpoint holds all insertion locks at once
+$node->safe_psql(
+	'postgres', qq(
+	CREATE TABLE tab_int AS SELECT generate_series(1, 1000) AS a;
+	CHECKPOINT;
+	INSERT INTO tab_int SELECT generate_series(1001, 2000);
+	CHECKPOINT;
+	));
+
+# So does the checkpoint at the end of crash recovery
+$node->stop('immediate');
+$node->start;
+
+my $result = $node->safe_psql('postgres', "SELECT count(*) FROM tab_int");
+is($result, '2000', 'checkpoints with wal_insert_locks = 128');
+
+$result = $node->safe_psql('postgres', "SHOW wal_insert_locks");
+is($result, '128', 'wal_insert_locks is set');
+
+my ($ret, $stdout, $stderr) =
+  $node->psql('postgres', "ALTER SYSTEM SET wal_insert_locks = 1024");
+like(
+	$stderr,
+	qr/1024 is outside the valid range/,
+	'too many WAL insertion locks are rejected');
@@ -1017,3 +1017,39 @@ select v||'a', case when v||'a' = 'aa' then 1 else 0 end, count(*)
 explain (costs off)
   select 1 from tenk1
    where (hundred, thousand) in (select twothousand, twothousand from onek);
+
+-- Hash aggregation that exceeds work_mem must spill to disk, and still
+-- produce every group exactly once
+set work_mem = '64kB';
+set enable_sort = false;
+select count(*) as groups, sum(c) as total, sum(length(k)) as keylen
+  from (select (g % 10000)::text as k, count(*) as c
+          from generate_series(1, 20000) g
+         group by (g % 10000)::text) s;
+select count(*) as groups, sum(c) as total
+  from (select count(*) as c
+          from generate_series(1, 20000) g
+         group by grouping sets ((g % 10000), (g % 5000))) s;
+reset enable_sort;
+reset work_mem;
+
+-- Batch-at-a-time scans and aggregates must agree with row-at-a-time ones
+create temp table batch_tbl as
+  select i::int4 as a, (i % 7)::int8 as b,
+         case when i % 10 = 0 then null else i::float8 / 4 end as c
+    from generate_series(1, 5000) i;
+select count(*), count(c), sum(a), sum(b), sum(c)
+  from batch_tbl where a > 100 and b <> 3 and c is not null;
+select count(*), sum(a), count(c), sum(c)
+  from batch_tbl where c is null and a <= 2500;
+set executor_batch_size = 0;
+create temp table batch_res as
+  select count(*) as n, sum(a) as sa, sum(b) as sb, sum(c) as sc,
+         avg(a) as aa, avg(b) as ab, avg(c) as ac
+    from batch_tbl where a >= 17 and a < 4000.5 and c is not null;
+reset executor_batch_size;
+select * from batch_res
+except
+select count(*), sum(a), sum(b), sum(c), avg(a), avg(b), avg(c)
+  from batch_tbl where a >= 17 and a < 4000.5 and c is not null;
+drop table batch_tbl, batch_res;
@@ -26,6 +26,14 @@ CREATE INDEX i_bmtest_b ON bmscantest(b);
 set enable_indexscan=false;
 set enable_seqscan=false;
 
+-- Test with exact bitmaps first.  Pages with few matches are stored
+-- differently from pages with many, so use conditions that give both.
+SELECT count(*) FROM bmscantest WHERE a = 1 AND b = 1;
+SELECT count(*) FROM bmscantest WHERE a = 1 OR b = 1;
+SELECT count(*) FROM bmscantest WHERE a < 10 AND b = 1;
+SELECT count(*) FROM bmscantest WHERE a < 10 OR b = 1;
+SELECT count(*) FROM bmscantest WHERE a = 1 AND b < 10;
+
 -- Lower work_mem to trigger use of lossy bitmaps
 set work_mem = 64;
 
@@ -36,6 +44,10 @@ SELECT count(*) FROM bmscantest WHERE a = 1 AND b = 1;
 -- Test bitmap-or.
 SELECT count(*) FROM bmscantest WHERE a = 1 OR b = 1;
 
+-- Test a mix of lossy and exact pages.
+SELECT count(*) FROM bmscantest WHERE a < 10 AND b = 1;
+SELECT count(*) FROM bmscantest WHERE a < 10 OR b = 1;
+
 
 -- clean up
 DROP TABLE bmscantest;
@@ -140,3 +140,101 @@ VACUUM delete_test_table;
 -- The vacuum above should've turned the leaf page into a fast root. We just
 -- need to insert some rows to cause the fast root page to split.
 INSERT INTO delete_test_table SELECT i, 1, 2, 3 FROM generate_series(1,1000) i;
+
+--
+-- Test B-tree deduplication
+--
+CREATE TABLE dedup_test_table (a int, b text, c int) WITH (autovacuum_enabled = false);
+CREATE INDEX dedup_idx ON dedup_test_table (a);
+CREATE INDEX dedup_text_idx ON dedup_test_table (b);
+CREATE INDEX nodedup_idx ON dedup_test_table (a) WITH (deduplicate_items = off);
+select reloptions from pg_class WHERE oid = 'nodedup_idx'::regclass;
+INSERT INTO dedup_test_table
+  SELECT g % 10, 'value ' || (g % 10), g FROM generate_series(1, 20000) g;
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM dedup_test_table WHERE a = 5;
+SELECT count(*) FROM dedup_test_table WHERE b = 'value 7';
+-- VACUUM must remove some but not all TIDs from posting list tuples
+DELETE FROM dedup_test_table WHERE c % 3 = 0;
+VACUUM dedup_test_table;
+SELECT count(*) FROM dedup_test_table WHERE a = 5;
+SELECT count(*) FROM dedup_test_table WHERE b = 'value 7';
+-- CREATE INDEX deduplicates as it builds
+REINDEX TABLE dedup_test_table;
+SELECT count(*) FROM dedup_test_table WHERE a = 5;
+SELECT count(*) FROM dedup_test_table WHERE b = 'value 7';
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE dedup_test_table;
+
+-- Unique indexes deduplicate to absorb versions of the same logical row
+CREATE TABLE dedup_unique_test_table (a int) WITH (autovacuum_enabled = false);
+CREATE UNIQUE INDEX dedup_unique ON dedup_unique_test_table (a) WITH (deduplicate_items = on);
+CREATE UNIQUE INDEX plain_unique ON dedup_unique_test_table (a) WITH (deduplicate_items = off);
+DO $$
+BEGIN
+    FOR r IN 1..1350 LOOP
+        DELETE FROM dedup_unique_test_table;
+        INSERT INTO dedup_unique_test_table SELECT 1;
+    END LOOP;
+END$$;
+INSERT INTO dedup_unique_test_table SELECT 1;
+DROP TABLE dedup_unique_test_table;
+
+-- Skip scans, with quals on the second index column only
+CREATE TABLE skip_scan_test_table (a int, b int);
+INSERT INTO skip_scan_test_table SELECT i % 5, i FROM generate_series(1, 1000) i;
+INSERT INTO skip_scan_test_table SELECT NULL, i FROM generate_series(1, 10) i;
+CREATE INDEX skip_scan_test ON skip_scan_test_table (a, b);
+VACUUM ANALYZE skip_scan_test_table;
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT * FROM skip_scan_test_table WHERE b = 7 ORDER BY a, b;
+SELECT * FROM skip_scan_test_table WHERE b < 4 ORDER BY a DESC, b DESC;
+SELECT * FROM skip_scan_test_table WHERE b > 995 AND b <= 998 ORDER BY a, b;
+SELECT * FROM skip_scan_test_table WHERE b IN (5, 6, 1000) ORDER BY a, b;
+SET enable_indexscan = off;
+SET enable_bitmapscan = on;
+SELECT count(*) FROM skip_scan_test_table WHERE b = 7;
+RESET enable_indexscan;
+SET enable_bitmapscan = off;
+-- Too many distinct leading values to skip, so the scan stops skipping
+CREATE TABLE skip_scan_dense_table (a int, b int);
+INSERT INTO skip_scan_dense_table SELECT i, i % 10 FROM generate_series(1, 10000) i;
+INSERT INTO skip_scan_dense_table SELECT NULL, 3 FROM generate_series(1, 2);
+CREATE INDEX skip_scan_dense ON skip_scan_dense_table (a, b);
+SELECT count(*), sum(a) FROM skip_scan_dense_table WHERE b = 3;
+SELECT count(*) FROM (SELECT a FROM skip_scan_dense_table WHERE b = 3 ORDER BY a DESC OFFSET 0) s;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE skip_scan_test_table;
+DROP TABLE skip_scan_dense_table;
+
+-- COPY inserts into non-unique indexes a whole buffer at a time
+CREATE TABLE batch_copy_test (a int, b text, c int);
+CREATE INDEX batch_copy_test_a ON batch_copy_test (a);
+CREATE INDEX batch_copy_test_b ON batch_copy_test (b DESC NULLS LAST) WHERE a > 2;
+CREATE UNIQUE INDEX batch_copy_test_c ON batch_copy_test (c);
+COPY batch_copy_test FROM stdin;
+5	e	1
+3	c	2
+\N	x	3
+1	a	4
+4	\N	5
+2	b	6
+3	cc	7
+\.
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT a FROM batch_copy_test WHERE a > 0 ORDER BY a;
+SELECT a, b FROM batch_copy_test WHERE a > 2 ORDER BY b DESC NULLS LAST;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+-- Unique violations are still reported against the right line
+COPY batch_copy_test FROM stdin;
+6	f	8
+7	g	4
+\.
+SELECT count(*) FROM batch_copy_test;
+DROP TABLE batch_copy_test;
@@ -222,6 +222,21 @@ where row(hundred, thousand, tenthous) <= row(lhundred, lthousand, ltenthous);
 reset enable_indexscan;
 reset maintenance_work_mem;
 
+-- CLUSTER CONCURRENTLY and VACUUM (FULL, CONCURRENTLY)
+CREATE TABLE clstr_conc (a int, b text);
+CREATE INDEX clstr_conc_idx ON clstr_conc (a);
+BEGIN;
+CLUSTER CONCURRENTLY clstr_conc USING clstr_conc_idx;
+ROLLBACK;
+CLUSTER CONCURRENTLY clstr_conc USING clstr_conc_idx;
+VACUUM (FULL, CONCURRENTLY) clstr_conc;
+VACUUM (CONCURRENTLY) clstr_conc;
+VACUUM (FULL, ANALYZE, CONCURRENTLY) clstr_conc;
+VACUUM (FULL, CONCURRENTLY) clstr_conc, clstr_1;
+CREATE TEMP TABLE clstr_conc_temp (a int PRIMARY KEY);
+VACUUM (FULL, CONCURRENTLY) clstr_conc_temp;
+DROP TABLE clstr_conc, clstr_conc_temp;
+
 -- clean up
 DROP TABLE clustertest;
 DROP TABLE clstr_1;
@@ -0,0 +1,63 @@
+--
+-- Tests for per-column compression methods
+--
+CREATE TABLE cmdata(f1 text COMPRESSION pglz);
+INSERT INTO cmdata VALUES (repeat('1234567890', 1000));
+INSERT INTO cmdata VALUES ('short');
+SELECT pg_column_compression(f1), length(f1) FROM cmdata ORDER BY 2;
+
+-- columns without an explicit method use the default
+CREATE TABLE cmdata1(f1 text, f2 int);
+INSERT INTO cmdata1 VALUES (repeat('1234567890', 1000), 1);
+SELECT pg_column_compression(f1), pg_column_compression(f2) FROM cmdata1;
+SELECT attname, attcompression FROM pg_attribute
+  WHERE attrelid = 'cmdata1'::regclass AND attnum > 0 ORDER BY attnum;
+
+-- only varlena datatypes can be compressed
+CREATE TABLE cmdata2(f1 int COMPRESSION pglz);
+ALTER TABLE cmdata1 ALTER COLUMN f2 SET COMPRESSION pglz;
+ALTER TABLE cmdata1 ADD COLUMN f3 int COMPRESSION pglz;
+
+-- unknown methods
+CREATE TABLE cmdata2(f1 text COMPRESSION lz4);
+ALTER TABLE cmdata1 ALTER COLUMN f1 SET COMPRESSION lz4;
+
+-- setting the method doesn't affect existing values
+ALTER TABLE cmdata1 ALTER COLUMN f1 SET COMPRESSION pglz;
+ALTER TABLE cmdata1 ADD COLUMN f3 text COMPRESSION pglz;
+INSERT INTO cmdata1 VALUES (repeat('1234567890', 1000), 2, repeat('0987654321', 1000));
+SELECT f2, pg_column_compression(f1), pg_column_compression(f3), length(f1)
+  FROM cmdata1 ORDER BY f2;
+SELECT attname, attcompression FROM pg_attribute
+  WHERE attrelid = 'cmdata1'::regclass AND attnum > 0 ORDER BY attnum;
+
+-- changing to a type that can't be compressed resets the method
+CREATE TABLE cmdata2(f1 varchar COMPRESSION pglz);
+ALTER TABLE cmdata2 ALTER COLUMN f1 TYPE int USING f1::int;
+SELECT attcompression FROM pg_attribute
+  WHERE attrelid = 'cmdata2'::regclass AND attname = 'f1';
+
+-- the method is inherited, and copied by LIKE ... INCLUDING STORAGE
+CREATE TABLE cminh() INHERITS (cmdata);
+CREATE TABLE cmlike (LIKE cmdata INCLUDING STORAGE);
+CREATE TABLE cmlike1 (LIKE cmdata);
+SELECT attrelid::regclass, attcompression FROM pg_attribute
+  WHERE attrelid IN ('cminh'::regclass, 'cmlike'::regclass, 'cmlike1'::regclass)
+    AND attname = 'f1'
+  ORDER BY 1;
+
+-- non-varlena values are never compressed
+SELECT pg_column_compression(42);
+
+-- operators that only need a prefix of a large value detoast just that
+CREATE TABLE cmslice(t text, j jsonb);
+INSERT INTO cmslice SELECT repeat('abcdefghij', 100000),
+  jsonb_build_object('a', 1, 'z', 'last', 'big',
+    (SELECT string_agg(md5((i % 100)::text), '') FROM generate_series(1, 3000) i));
+SELECT t LIKE 'abc%', t LIKE 'abd%', t LIKE 'ab_d%', t NOT LIKE 'abcdefghija%',
+  t LIKE '%j' FROM cmslice;
+SELECT pg_column_size(j) < 96000 FROM cmslice;
+SELECT j->>'a', j->'z', length(j->>'big'), j->'missing' IS NULL FROM cmslice;
+SELECT j @? '$.z', jsonb_path_query_first(j, '$.a'), j @@ '$.a == 1' FROM cmslice;
+
+DROP TABLE cmdata, cminh, cmdata1, cmdata2, cmlike, cmlike1, cmslice;
@@ -440,6 +440,35 @@ test1
 SELECT * FROM instead_of_insert_tbl;
 COMMIT;
 
+-- parallel COPY FROM
+CREATE TABLE parallel_copy_t (a int primary key, b text default 'dflt', c int check (c > 0));
+COPY parallel_copy_t FROM stdin (format binary, parallel 2);
+COPY parallel_copy_t FROM stdin (parallel -1);
+COPY parallel_copy_t FROM stdin (parallel 1, parallel 2);
+COPY parallel_copy_t (a, c) FROM stdin (format csv, parallel 2);
+1,10
+2,"20"
+3,30
+\.
+SELECT * FROM parallel_copy_t ORDER BY a;
+-- an error in any row aborts the whole command
+\set VERBOSITY terse
+COPY parallel_copy_t (a, c) FROM stdin (format csv, parallel 2);
+4,40
+5,-50
+\.
+\set VERBOSITY default
+SELECT count(*) FROM parallel_copy_t;
+COPY parallel_copy_t TO stdout (format csv, parallel 2);
+-- temporary tables are copied to without workers
+CREATE TEMP TABLE parallel_copy_temp (a int);
+COPY parallel_copy_temp FROM stdin (parallel 2);
+1
+2
+\.
+SELECT * FROM parallel_copy_temp ORDER BY a;
+DROP TABLE parallel_copy_t, parallel_copy_temp;
+
 -- clean up
 DROP TABLE forcetest;
 DROP TABLE vistest;
@@ -34,3 +34,31 @@ SELECT current_schema;
 SET search_path = 'pg_catalog';
 SELECT current_schema;
 RESET search_path;
+
+--
+-- = ANY over a constant array large enough to be hashed
+--
+-- The stable functions keep the planner from folding the comparisons.
+begin;
+create function return_int_input(int) returns int as $$
+begin
+	return $1;
+end;
+$$ language plpgsql stable;
+create function return_text_input(text) returns text as $$
+begin
+	return $1;
+end;
+$$ language plpgsql stable;
+
+select return_int_input(1) in (10, 9, 2, 8, 3, 7, 4, 6, 5, 1);
+select return_int_input(11) in (10, 9, 2, 8, 3, 7, 4, 6, 5, 1);
+select return_int_input(5) in (10, 9, 2, 8, 3, 7, 4, 6, 5, null);
+select return_int_input(1) in (10, 9, 2, 8, 3, 7, 4, 6, 5, null);
+select return_int_input(null::int) in (10, 9, 2, 8, 3, 7, 4, 6, 5, 1);
+select return_text_input('a') in ('a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j');
+select return_text_input('z') in ('a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j');
+select count(*) from generate_series(1, 100) g
+where return_int_input(g) = any ('{3,1,4,1,5,9,2,6,5,3,5,8,9,7,9}'::int[]);
+
+rollback;
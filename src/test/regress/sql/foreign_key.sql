@@ -1679,3 +1679,23 @@ INSERT INTO fkpart8.tbl2 VALUES(1);
 ALTER TABLE fkpart8.tbl2 DROP CONSTRAINT tbl2_f1_fkey;
 COMMIT;
 DROP SCHEMA fkpart8 CASCADE;
+
+-- checks that look up the referenced key in its index directly
+CREATE TABLE fkfast_pk (a int, b text, PRIMARY KEY (b, a));
+CREATE DOMAIN fkfast_dom AS int;
+CREATE TABLE fkfast_fk (a bigint, b text, c fkfast_dom,
+  FOREIGN KEY (a, b) REFERENCES fkfast_pk (a, b),
+  FOREIGN KEY (c, b) REFERENCES fkfast_pk (a, b));
+INSERT INTO fkfast_pk VALUES (1, 'one'), (2, 'two');
+INSERT INTO fkfast_fk VALUES (1, 'one', 1), (2, 'two', NULL), (NULL, 'three', NULL);
+INSERT INTO fkfast_fk VALUES (2, 'one', NULL);
+INSERT INTO fkfast_fk VALUES (NULL, 'one', 2);
+BEGIN;
+INSERT INTO fkfast_pk VALUES (3, 'three');
+INSERT INTO fkfast_fk VALUES (3, 'three', 3);
+UPDATE fkfast_pk SET a = 4 WHERE a = 3;
+COMMIT;
+UPDATE fkfast_pk SET b = 'uno' WHERE a = 1;
+SELECT * FROM fkfast_fk ORDER BY a;
+DROP TABLE fkfast_fk, fkfast_pk;
+DROP DOMAIN fkfast_dom;
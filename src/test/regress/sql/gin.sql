@@ -34,3 +34,23 @@ insert into gin_test_tbl select array[1, 3, g] from generate_series(1, 1000) g;
 
 delete from gin_test_tbl where i @> array[2];
 vacuum gin_test_tbl;
+
+-- Test a parallel build.  A small maintenance_work_mem makes each
+-- participant write several runs, which the leader merges.
+create table gin_par_tbl(i int4[])
+  with (autovacuum_enabled = off, parallel_workers = 2);
+insert into gin_par_tbl
+  select array[g % 10, g % 1000, g] from generate_series(1, 100000) g;
+set max_parallel_maintenance_workers = 2;
+set maintenance_work_mem = '1MB';
+create index gin_par_idx on gin_par_tbl using gin (i);
+reset maintenance_work_mem;
+reset max_parallel_maintenance_workers;
+
+set enable_seqscan = off;
+select count(*) from gin_par_tbl where i @> array[5];
+select count(*) from gin_par_tbl where i @> array[5, 505];
+select count(*) from gin_par_tbl where i && array[99999, 77];
+reset enable_seqscan;
+
+drop table gin_par_tbl;
@@ -126,6 +126,19 @@ and p <@ box(point(5,5), point(6, 6));
 
 drop index gist_tbl_multi_index;
 
+-- Test an index built with the sorted build method.  With fillfactor = 100
+-- the points are packed into full leaf pages in Z-order.
+create index gist_tbl_point_index on gist_tbl using gist (p) with (fillfactor = 100);
+
+explain (costs off)
+select count(*) from gist_tbl where p <@ box(point(99.99, 99.99), point(300.01, 300.01));
+
+select count(*) from gist_tbl where p <@ box(point(99.99, 99.99), point(300.01, 300.01));
+
+select p from gist_tbl order by p <-> point(250.01, 250.01) limit 3;
+
+drop index gist_tbl_point_index;
+
 -- Clean up
 reset enable_seqscan;
 reset enable_bitmapscan;
@@ -202,3 +202,63 @@ CREATE INDEX hash_f8_index2 ON hash_f8_heap USING hash (random float8_ops)
 	WITH (fillfactor=9);
 CREATE INDEX hash_f8_index2 ON hash_f8_heap USING hash (random float8_ops)
 	WITH (fillfactor=101);
+
+-- Unique hash indexes
+CREATE TABLE hash_unique_heap (id int, t text);
+INSERT INTO hash_unique_heap SELECT g, 'x' || g FROM generate_series(1, 1000) g;
+CREATE UNIQUE INDEX hash_unique_index ON hash_unique_heap USING hash (id);
+INSERT INTO hash_unique_heap VALUES (1000, 'dup');
+INSERT INTO hash_unique_heap VALUES (NULL, 'null1'), (NULL, 'null2');
+UPDATE hash_unique_heap SET id = 1 WHERE id = 2;
+INSERT INTO hash_unique_heap VALUES (1001, 'new') ON CONFLICT (id) DO NOTHING;
+INSERT INTO hash_unique_heap VALUES (1001, 'new')
+	ON CONFLICT (id) DO UPDATE SET t = 'updated';
+SELECT * FROM hash_unique_heap WHERE id = 1001;
+DELETE FROM hash_unique_heap WHERE id = 1;
+INSERT INTO hash_unique_heap VALUES (1, 'again');
+CREATE UNIQUE INDEX hash_unique_index2 ON hash_unique_heap USING hash (t);
+INSERT INTO hash_unique_heap VALUES (2000, 'x5');
+CREATE UNIQUE INDEX hash_unique_index3 ON hash_unique_heap
+	USING hash ((id % 10));
+-- hash unique indexes can be referenced by foreign keys
+CREATE TABLE hash_fk_heap (x int REFERENCES hash_unique_heap (id));
+INSERT INTO hash_fk_heap VALUES (5);
+INSERT INTO hash_fk_heap VALUES (5000);
+DROP TABLE hash_fk_heap;
+DROP TABLE hash_unique_heap;
+
+-- Sorted build of a unique hash index
+CREATE TABLE hash_unique_sort_heap AS
+	SELECT g AS id FROM generate_series(1, 20000) g;
+SET maintenance_work_mem = '1MB';
+CREATE UNIQUE INDEX hash_unique_sort_index ON hash_unique_sort_heap
+	USING hash (id) WITH (fillfactor = 10);
+\set VERBOSITY terse \\ -- the duplicate reported depends on the sort order
+CREATE UNIQUE INDEX hash_unique_sort_index2 ON hash_unique_sort_heap
+	USING hash ((id % 1000)) WITH (fillfactor = 10);
+\set VERBOSITY default
+RESET maintenance_work_mem;
+INSERT INTO hash_unique_sort_heap VALUES (12345);
+DROP TABLE hash_unique_sort_heap;
+
+-- Multicolumn hash indexes
+CREATE TABLE hash_multi_heap (a int, b text);
+INSERT INTO hash_multi_heap SELECT g % 10, 'b' || g FROM generate_series(1, 1000) g;
+CREATE UNIQUE INDEX hash_multi_index ON hash_multi_heap USING hash (a, b);
+INSERT INTO hash_multi_heap VALUES (1, 'b1');
+INSERT INTO hash_multi_heap VALUES (2, 'b1'), (1, NULL), (1, NULL);
+SET enable_seqscan = OFF;
+SET enable_bitmapscan = OFF;
+EXPLAIN (COSTS OFF)
+SELECT * FROM hash_multi_heap WHERE a = 1 AND b = 'b11';
+SELECT * FROM hash_multi_heap WHERE a = 1 AND b = 'b11';
+SELECT * FROM hash_multi_heap WHERE a = 1 AND b = 'b12';
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM hash_multi_heap WHERE a = 1;
+SELECT count(*) FROM hash_multi_heap WHERE a = 1;
+-- can't be used without a condition on the first column
+EXPLAIN (COSTS OFF)
+SELECT * FROM hash_multi_heap WHERE b = 'b11';
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE hash_multi_heap;
@@ -0,0 +1,65 @@
+--
+-- Incrementally maintained materialized views
+--
+CREATE TABLE ivm_t (i int, j int, v int);
+CREATE TABLE ivm_s (j int, name text);
+INSERT INTO ivm_t VALUES (1, 10, 100), (2, 10, 200), (3, 20, 300), (4, NULL, 400);
+INSERT INTO ivm_s VALUES (10, 'ten'), (20, 'twenty'), (30, 'thirty');
+-- join without aggregates
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_join AS
+  SELECT t.i, s.name FROM ivm_t t JOIN ivm_s s ON t.j = s.j;
+SELECT * FROM ivm_join ORDER BY i;
+INSERT INTO ivm_t VALUES (5, 30, 500), (6, 30, 600);
+DELETE FROM ivm_t WHERE i = 1;
+UPDATE ivm_s SET name = 'TEN' WHERE j = 10;
+SELECT * FROM ivm_join ORDER BY i;
+-- duplicate rows are deleted one at a time
+INSERT INTO ivm_t VALUES (2, 10, 999);
+SELECT * FROM ivm_join WHERE i = 2;
+DELETE FROM ivm_t WHERE v = 999;
+SELECT * FROM ivm_join WHERE i = 2;
+-- aggregates, with hidden count columns
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_agg AS
+  SELECT j, count(*) AS n, count(v) AS nv, sum(v) AS total FROM ivm_t GROUP BY j;
+SELECT * FROM ivm_agg ORDER BY j;
+INSERT INTO ivm_t VALUES (7, 20, NULL), (8, 40, 800), (9, NULL, NULL);
+SELECT j, n, nv, total FROM ivm_agg ORDER BY j;
+DELETE FROM ivm_t WHERE i IN (3, 8);
+UPDATE ivm_t SET j = 10 WHERE i = 5;
+SELECT j, n, nv, total FROM ivm_agg ORDER BY j;
+-- compare with the result of the query
+(SELECT j, n, nv, total FROM ivm_agg
+ EXCEPT SELECT j, count(*), count(v), sum(v) FROM ivm_t GROUP BY j)
+UNION ALL
+(SELECT j, count(*), count(v), sum(v) FROM ivm_t GROUP BY j
+ EXCEPT SELECT j, n, nv, total FROM ivm_agg);
+SELECT * FROM ivm_join ORDER BY i;
+-- aggregates without GROUP BY over a join
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_total AS
+  SELECT count(*) AS n, sum(t.v) AS total FROM ivm_t t JOIN ivm_s s USING (j);
+SELECT n, total FROM ivm_total;
+TRUNCATE ivm_s;
+SELECT n, total FROM ivm_total;
+SELECT * FROM ivm_join;
+INSERT INTO ivm_s VALUES (30, 'thirty');
+SELECT n, total FROM ivm_total;
+SELECT * FROM ivm_join;
+-- a view that is not populated is not maintained
+REFRESH MATERIALIZED VIEW ivm_total WITH NO DATA;
+INSERT INTO ivm_s VALUES (10, 'ten');
+REFRESH MATERIALIZED VIEW ivm_total;
+SELECT n, total FROM ivm_total;
+-- unsupported queries
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS SELECT DISTINCT j FROM ivm_t;
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS SELECT j, avg(v) FROM ivm_t GROUP BY j;
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS SELECT sum(v) FROM ivm_t GROUP BY j;
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS
+  SELECT t.i FROM ivm_t t LEFT JOIN ivm_s s ON t.j = s.j;
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS SELECT a.i FROM ivm_t a, ivm_t b;
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS SELECT i, random() FROM ivm_t;
+CREATE INCREMENTAL MATERIALIZED VIEW ivm_bad AS SELECT i AS __ivm_i FROM ivm_t;
+-- the maintenance triggers go away with the views
+SELECT count(*) FROM pg_trigger WHERE tgrelid = 'ivm_t'::regclass;
+DROP MATERIALIZED VIEW ivm_join, ivm_agg, ivm_total;
+SELECT count(*) FROM pg_trigger WHERE tgrelid = 'ivm_t'::regclass;
+DROP TABLE ivm_t, ivm_s;
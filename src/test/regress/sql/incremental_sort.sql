@@ -0,0 +1,54 @@
+--
+-- Incremental sort
+--
+
+-- groups of 100 tuples, sorted by a but not by b
+create table incsort_test (a int, b int, c text);
+insert into incsort_test
+  select i / 100, 1000 - i % 1000, 'x' || i from generate_series(1, 1000) i;
+create index on incsort_test (a);
+analyze incsort_test;
+
+-- groups of 10 tuples, smaller than a batch
+create table incsort_small (a int, b int);
+insert into incsort_small select i / 10, -i from generate_series(1, 1000) i;
+create index on incsort_small (a);
+analyze incsort_small;
+
+set enable_sort = off;
+
+explain (costs off)
+select a, b from incsort_test order by a, b limit 5;
+select a, b from incsort_test order by a, b limit 5;
+
+-- the result crosses a group boundary
+select a, b from incsort_test where a between 3 and 4
+  order by a, b offset 95 limit 10;
+
+-- check the ordering of the whole result, across batches
+explain (costs off)
+select a, b from incsort_small order by a, b;
+select count(*) from
+  (select a, b, lag(a) over w as pa, lag(b) over w as pb
+   from (select a, b from incsort_small order by a, b) s
+   window w as ()) x
+  where (pa, pb) > (a, b);
+
+-- descending order of the second key, starting from a later group
+select a, b from incsort_small where a >= 50 order by a, b desc limit 12;
+
+-- rescans
+select t.a, s.b from (values (7), (42)) t(a),
+  lateral (select b from incsort_small where incsort_small.a >= t.a
+           order by incsort_small.a, b limit 2) s
+  order by t.a, s.b;
+
+reset enable_sort;
+
+set enable_incremental_sort = off;
+explain (costs off)
+select a, b from incsort_test order by a, b limit 5;
+reset enable_incremental_sort;
+
+drop table incsort_test;
+drop table incsort_small;
@@ -604,3 +604,23 @@ alter table returningwrtest2 drop c;
 alter table returningwrtest attach partition returningwrtest2 for values in (2);
 insert into returningwrtest values (2, 'foo') returning returningwrtest;
 drop table returningwrtest;
+
+-- check tuple routing of many consecutive rows going to the same partition,
+-- which makes it check the last partition found first
+create table cachedrange (a int) partition by range (a);
+create table cachedrange1 partition of cachedrange for values from (minvalue) to (100);
+create table cachedrange2 partition of cachedrange for values from (100) to (200);
+create table cachedrange3 partition of cachedrange for values from (300) to (maxvalue);
+create table cachedrange_def partition of cachedrange default;
+insert into cachedrange select generate_series(0, 399);
+select tableoid::regclass, count(*), min(a), max(a) from cachedrange group by 1 order by 1;
+drop table cachedrange;
+
+create table cachedlist (a int) partition by list (a);
+create table cachedlist1 partition of cachedlist for values in (1, 2);
+create table cachedlist2 partition of cachedlist for values in (3, null);
+create table cachedlist_def partition of cachedlist default;
+insert into cachedlist select i / 20 from generate_series(0, 99) i;
+insert into cachedlist select null from generate_series(1, 20);
+select tableoid::regclass, count(*), min(a), max(a) from cachedlist group by 1 order by 1;
+drop table cachedlist;
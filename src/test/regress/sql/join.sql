@@ -373,6 +373,22 @@ select count(*) from tenk1 x where
   x.unique1 in (select a.f1 from int4_tbl a,float8_tbl b where a.f1=b.f1) and
   x.unique1 = 0 and
   x.unique1 in (select aa.f1 from int4_tbl aa,float8_tbl bb where aa.f1=bb.f1);
+select count(*) from int4_tbl t1
+  join int4_tbl t2 on t1.f1 = t2.f1
+  left join int4_tbl t3 on t2.f1 = t3.f1
+  left join (int4_tbl t4 join int4_tbl t5 on t4.f1 = t5.f1) on t3.f1 = t4.f1
+  full join int4_tbl t6 on t1.f1 = t6.f1;
+-- and with the genetic algorithm instead of linearized search
+set geqo_linear_search = off;
+select count(*) from tenk1 x where
+  x.unique1 in (select a.f1 from int4_tbl a,float8_tbl b where a.f1=b.f1) and
+  x.unique1 = 0 and
+  x.unique1 in (select aa.f1 from int4_tbl aa,float8_tbl bb where aa.f1=bb.f1);
+select count(*) from int4_tbl t1
+  join int4_tbl t2 on t1.f1 = t2.f1
+  left join int4_tbl t3 on t2.f1 = t3.f1
+  left join (int4_tbl t4 join int4_tbl t5 on t4.f1 = t5.f1) on t3.f1 = t4.f1
+  full join int4_tbl t6 on t1.f1 = t6.f1;
 rollback;
 
 --
@@ -2067,3 +2083,62 @@ where exists (select 1 from j3
       and t1.unique1 < 1;
 
 drop table j3;
+
+--
+-- nested loops switching to hashing when the outer side is much larger
+-- than estimated
+--
+create temp table nl_inner as select g as a, g % 3 as b from generate_series(1, 10) g;
+insert into nl_inner values (5, 100), (null, 0);
+analyze nl_inner;
+
+set enable_hashjoin to off;
+set enable_mergejoin to off;
+
+explain (analyze, costs off, summary off, timing off)
+select count(*), count(t.a), sum(t.b)
+from generate_series(1, 20000) g left join nl_inner t on t.a = g % 20
+where g % 1 = 0;
+select count(*), count(t.a), sum(t.b)
+from generate_series(1, 20000) g left join nl_inner t on t.a = g % 20
+where g % 1 = 0;
+select count(*) from generate_series(1, 20000) g
+where g % 1 = 0 and not exists (select 1 from nl_inner t where t.a = g % 20);
+
+-- same results without switching
+set enable_adaptive_nestloop to off;
+select count(*), count(t.a), sum(t.b)
+from generate_series(1, 20000) g left join nl_inner t on t.a = g % 20
+where g % 1 = 0;
+select count(*) from generate_series(1, 20000) g
+where g % 1 = 0 and not exists (select 1 from nl_inner t where t.a = g % 20);
+
+reset enable_adaptive_nestloop;
+reset enable_hashjoin;
+reset enable_mergejoin;
+
+--
+-- result cache on the inner side of parameterized nested loops
+--
+set enable_resultcache to on;
+set enable_hashjoin to off;
+set enable_mergejoin to off;
+
+select count(*), avg(t1.unique1) from tenk1 t1
+inner join tenk1 t2 on t1.unique1 = t2.twenty
+where t2.unique1 < 1000;
+
+select count(*), avg(t2.unique1) from tenk1 t1,
+lateral (select t2.unique1 from tenk1 t2 where t1.twenty = t2.unique1) t2
+where t1.unique1 < 1000;
+
+-- more distinct keys than fit in the cache
+set work_mem to '64kB';
+select count(*), sum(t1.unique1) from tenk1 t1
+inner join tenk1 t2 on t1.unique1 = t2.thousand
+where t2.unique1 < 1200;
+
+reset work_mem;
+reset enable_resultcache;
+reset enable_hashjoin;
+reset enable_mergejoin;
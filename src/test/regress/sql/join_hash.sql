@@ -153,6 +153,19 @@ $$
 $$);
 rollback to settings;
 
+-- non-parallel, with compressed batch files
+savepoint settings;
+set local max_parallel_workers_per_gather = 0;
+set local work_mem = '128kB';
+set local temp_file_compression = on;
+select count(*) from simple r join simple s using (id);
+select original > 1 as initially_multibatch, final > original as increased_batches
+  from hash_join_batches(
+$$
+  select count(*) from simple r join simple s using (id);
+$$);
+rollback to settings;
+
 -- parallel with parallel-oblivious hash join
 savepoint settings;
 set local max_parallel_workers_per_gather = 2;
@@ -236,7 +249,9 @@ rollback to settings;
 -- doesn't help, so stop trying to fit in work_mem and hope for the
 -- best; in this case we plan for 1 batch, increases just once and
 -- then stop increasing because that didn't help at all, so we blow
--- right through the work_mem budget and hope for the best...
+-- right through the work_mem budget and hope for the best (except for
+-- parallel-aware inner joins, which process the oversized batch in
+-- several passes instead)...
 
 -- non-parallel
 savepoint settings;
@@ -408,6 +423,35 @@ $$
 $$);
 rollback to settings;
 
+-- The outer scan skips the rows that can't find a match, using a Bloom
+-- filter built along with the hash table.
+create or replace function bloom_filter_removed(query text)
+returns int language plpgsql
+as
+$$
+declare
+  whole_plan json;
+  scan_node json;
+begin
+  execute 'explain (analyze, format ''json'') ' || query into whole_plan;
+  -- the outer plan of the join below the Aggregate
+  scan_node := json_extract_path(whole_plan, '0', 'Plan', 'Plans', '0', 'Plans', '0');
+  return scan_node->>'Rows Removed by Bloom Filter';
+end;
+$$;
+savepoint settings;
+set local max_parallel_workers_per_gather = 0;
+set local enable_mergejoin = off;
+set local enable_nestloop = off;
+explain (costs off)
+  select count(*) from join_bar b join join_foo f using (id);
+select count(*) from join_bar b join join_foo f using (id);
+select bloom_filter_removed(
+$$
+  select count(*) from join_bar b join join_foo f using (id);
+$$) > 9900 as filtered;
+rollback to settings;
+
 -- A full outer join where every record is matched.
 
 -- non-parallel
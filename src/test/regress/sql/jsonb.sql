@@ -1256,3 +1256,14 @@ select '12345.0000000000000000000000000000000000000000000005'::jsonb::float8;
 select '12345.0000000000000000000000000000000000000000000005'::jsonb::int2;
 select '12345.0000000000000000000000000000000000000000000005'::jsonb::int4;
 select '12345.0000000000000000000000000000000000000000000005'::jsonb::int8;
+
+-- most common elements statistics
+CREATE TABLE jsonb_stats_test AS
+  SELECT CASE WHEN g % 4 = 0 THEN '{"a": 1, "b": ["x", "y"]}'::jsonb
+              ELSE ('{"a": ' || g % 4 || '}')::jsonb END AS j
+  FROM generate_series(1, 100) g;
+ANALYZE jsonb_stats_test;
+SELECT e, f FROM pg_stats,
+  unnest(most_common_elems::text::text[], most_common_elem_freqs) AS u(e, f)
+  WHERE tablename = 'jsonb_stats_test' AND attname = 'j';
+DROP TABLE jsonb_stats_test;
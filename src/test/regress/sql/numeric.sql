@@ -1043,3 +1043,10 @@ select scale(-13.000000000000000);
 -- cases that need carry propagation
 SELECT SUM(9999::numeric) FROM generate_series(1, 100000);
 SELECT SUM((-9999)::numeric) FROM generate_series(1, 100000);
+
+-- mixing inputs that fit the 128-bit fast path with ones that don't
+SELECT SUM(x) FROM (VALUES (1.5), (2.25), (1e40), (-1e40), (0.001)) v(x);
+SELECT SUM(x) FROM (VALUES (0.1), (0.00000000000000000001), (-0.1)) v(x);
+SELECT 99999999999999999999999999999999.5 + 0.5;
+SELECT 0.10 - 0.1;
+SELECT 1234.5678 * -0.0001;
@@ -318,6 +318,18 @@ EXPLAIN (COSTS OFF)
 SELECT x, sum(y), avg(y), count(*) FROM pagg_tab_para GROUP BY x HAVING avg(y) < 7 ORDER BY 1, 2, 3;
 SELECT x, sum(y), avg(y), count(*) FROM pagg_tab_para GROUP BY x HAVING avg(y) < 7 ORDER BY 1, 2, 3;
 
+-- Window functions partitioned by the partition key can be computed by
+-- workers that each take whole partitions.
+SET parallel_tuple_cost TO 0;
+EXPLAIN (COSTS OFF)
+SELECT x, y, rank() OVER (PARTITION BY x ORDER BY y) FROM pagg_tab_para;
+SELECT sum(r), count(*) FROM (SELECT rank() OVER (PARTITION BY x ORDER BY y) AS r FROM pagg_tab_para) s;
+
+-- But not if PARTITION BY doesn't include the partition key.
+EXPLAIN (COSTS OFF)
+SELECT x, y, rank() OVER (PARTITION BY y ORDER BY x) FROM pagg_tab_para;
+RESET parallel_tuple_cost;
+
 -- Reset parallelism parameters to get partitionwise aggregation plan.
 RESET min_parallel_table_scan_size;
 RESET parallel_setup_cost;
@@ -427,11 +427,38 @@ SELECT t1.a, t1.c, t2.b, t2.c FROM prt1_n t1 JOIN prt2_n t2 ON (t1.c = t2.c) JOI
 EXPLAIN (COSTS OFF)
 SELECT t1.a, t1.c, t2.b, t2.c FROM prt1_n t1 FULL JOIN prt1 t2 ON (t1.c = t2.c);
 
--- partitionwise join can not be applied if only one of joining tables has
--- default partition
+-- partitionwise join can be applied if only one of joining tables has
+-- default partition, as long as each partition of one side overlaps only one
+-- partition of the other side
 ALTER TABLE prt2 DETACH PARTITION prt2_p3;
 ALTER TABLE prt2 ATTACH PARTITION prt2_p3 FOR VALUES FROM (500) TO (600);
 ANALYZE prt2;
 
 EXPLAIN (COSTS OFF)
 SELECT t1.a, t1.c, t2.b, t2.c FROM prt1 t1, prt2 t2 WHERE t1.a = t2.b AND t1.b = 0 ORDER BY t1.a, t2.b;
+
+-- partitionwise join between tables whose partition bounds differ, but each
+-- partition of one side overlaps only one partition of the other side
+CREATE TABLE prt1_q (a int, b int, c varchar) PARTITION BY RANGE(a);
+CREATE TABLE prt1_q_p1 PARTITION OF prt1_q FOR VALUES FROM (0) TO (250);
+CREATE TABLE prt1_q_p2 PARTITION OF prt1_q FOR VALUES FROM (250) TO (600);
+INSERT INTO prt1_q SELECT i, i % 25, to_char(i, 'FM0000') FROM generate_series(0, 599, 2) i;
+ANALYZE prt1_q;
+
+SELECT count(*), sum(t1.a), sum(t2.b) FROM prt1_q t1 JOIN prt2 t2 ON t1.a = t2.b;
+SELECT count(*), count(t1.a), sum(t1.a) FROM prt2 t2 LEFT JOIN prt1_q t1 ON t1.a = t2.b;
+SELECT count(*), sum(t1.a) FROM prt1_q t1 WHERE t1.a IN (SELECT t2.b FROM prt2 t2);
+SELECT count(*) FROM prt2 t2 WHERE NOT EXISTS (SELECT 1 FROM prt1_q t1 WHERE t1.a = t2.b);
+
+CREATE TABLE pht3 (a int, b int, c text) PARTITION BY HASH(c);
+CREATE TABLE pht3_p1 PARTITION OF pht3 FOR VALUES WITH (MODULUS 6, REMAINDER 0);
+CREATE TABLE pht3_p2 PARTITION OF pht3 FOR VALUES WITH (MODULUS 6, REMAINDER 1);
+CREATE TABLE pht3_p3 PARTITION OF pht3 FOR VALUES WITH (MODULUS 6, REMAINDER 2);
+CREATE TABLE pht3_p4 PARTITION OF pht3 FOR VALUES WITH (MODULUS 6, REMAINDER 3);
+CREATE TABLE pht3_p5 PARTITION OF pht3 FOR VALUES WITH (MODULUS 6, REMAINDER 4);
+CREATE TABLE pht3_p6 PARTITION OF pht3 FOR VALUES WITH (MODULUS 6, REMAINDER 5);
+INSERT INTO pht3 SELECT i, i, to_char(i/50, 'FM0000') FROM generate_series(0, 599, 3) i;
+ANALYZE pht3;
+
+SELECT count(*), sum(t1.a) FROM pht1 t1 JOIN pht3 t2 ON t1.c = t2.c AND t1.b = t2.b;
+SELECT count(*), count(t2.a) FROM pht3 t1 LEFT JOIN pht1 t2 ON t1.c = t2.c AND t1.b = t2.b;
@@ -1110,3 +1110,25 @@ reset constraint_exclusion;
 reset enable_partition_pruning;
 
 drop table listp;
+
+--
+-- check that a generic plan locks only the partitions that survive initial
+-- pruning when it's reused
+--
+create table lockp (a int) partition by list (a);
+create table lockp1 partition of lockp for values in (1);
+create table lockp2 partition of lockp for values in (2);
+create table lockp3 partition of lockp for values in (3);
+set plan_cache_mode to force_generic_plan;
+prepare lockp_q (int) as select * from lockp where a = $1;
+execute lockp_q (1);
+begin;
+execute lockp_q (2);
+select relation::regclass, mode from pg_locks
+  where locktype = 'relation' and pid = pg_backend_pid() and
+        relation::regclass::text like 'lockp%'
+  order by 1;
+commit;
+reset plan_cache_mode;
+deallocate lockp_q;
+drop table lockp;
@@ -209,4 +209,8 @@ explain (costs off) execute test_mode_pp(2);
 set plan_cache_mode to force_custom_plan;
 explain (costs off) execute test_mode_pp(2);
 
+-- adaptive mode goes by the estimates until it has timed both kinds of plan
+set plan_cache_mode to adaptive;
+explain (costs off) execute test_mode_pp(2);
+
 drop table test_mode;
@@ -1271,3 +1271,31 @@ REVOKE TRUNCATE ON lock_table FROM regress_locktable_user;
 -- clean up
 DROP TABLE lock_table;
 DROP USER regress_locktable_user;
+
+-- permission checks of a reused plan must notice changes of user and role
+CREATE ROLE regress_priv_cached_group;
+CREATE ROLE regress_priv_cached_user IN ROLE regress_priv_cached_group;
+CREATE ROLE regress_priv_cached_other;
+CREATE TABLE priv_cached_tbl (a int);
+INSERT INTO priv_cached_tbl VALUES (1);
+GRANT SELECT ON priv_cached_tbl TO regress_priv_cached_group;
+SET SESSION AUTHORIZATION regress_priv_cached_user;
+PREPARE priv_cached_q AS SELECT a FROM priv_cached_tbl;
+EXECUTE priv_cached_q;
+EXECUTE priv_cached_q;
+SET SESSION AUTHORIZATION regress_priv_cached_other;
+EXECUTE priv_cached_q; -- fail
+RESET SESSION AUTHORIZATION;
+REVOKE regress_priv_cached_group FROM regress_priv_cached_user;
+SET SESSION AUTHORIZATION regress_priv_cached_user;
+EXECUTE priv_cached_q; -- fail
+RESET SESSION AUTHORIZATION;
+GRANT regress_priv_cached_group TO regress_priv_cached_user;
+SET SESSION AUTHORIZATION regress_priv_cached_user;
+EXECUTE priv_cached_q;
+RESET SESSION AUTHORIZATION;
+DEALLOCATE priv_cached_q;
+DROP TABLE priv_cached_tbl;
+DROP ROLE regress_priv_cached_user;
+DROP ROLE regress_priv_cached_other;
+DROP ROLE regress_priv_cached_group;
@@ -135,6 +135,11 @@ select 'a' ~ '.. ()|\1';
 select 'a' ~ '()*\1';
 select 'a' ~ '()+\1';
 
+-- Patterns with a required literal, which is checked before matching
+select 'foo12barbaz' ~ 'foo\d+barbaz' as t, 'foo12barba' ~ 'foo\d+barbaz' as f;
+select 'errx' ~ 'err(or|x)' as t, 'abd' ~ 'abc?d' as t, 'ABC' ~* 'abc' as t;
+select 'a.b' ~ 'a\.b' as t, 'zyz' ~ '[xz]yz' as t, 'xyz' ~ '(?i)XYZ' as t;
+
 -- Error conditions
 select 'xyz' ~ 'x(\w)(?=\1)';  -- no backrefs in LACONs
 select 'xyz' ~ 'x(\w)(?=(\1))';
@@ -432,4 +432,15 @@ EXPLAIN (COSTS OFF)
 SELECT 1 FROM tenk1_vw_sec
   WHERE (SELECT sum(f1) FROM int4_tbl WHERE f1 < unique1) < 100;
 
+-- test parallel INSERT ... SELECT
+CREATE TABLE parallel_ins (unique1 int, stringu1 name);
+EXPLAIN (COSTS OFF)
+INSERT INTO parallel_ins SELECT unique1, stringu1 FROM tenk1 WHERE hundred > 1;
+INSERT INTO parallel_ins SELECT unique1, stringu1 FROM tenk1 WHERE hundred > 1;
+SELECT count(*), sum(unique1) FROM parallel_ins;
+-- but not with a CHECK constraint that isn't parallel safe
+ALTER TABLE parallel_ins ADD CHECK (unique1 < random() + 10000);
+EXPLAIN (COSTS OFF)
+INSERT INTO parallel_ins SELECT unique1, stringu1 FROM tenk1 WHERE hundred > 1;
+
 rollback;
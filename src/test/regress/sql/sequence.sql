@@ -406,3 +406,19 @@ SELECT nextval('test_seq1');
 SELECT nextval('test_seq1');
 
 DROP SEQUENCE test_seq1;
+
+-- shared cache tests
+SET shared_sequence_cache = on;
+CREATE SEQUENCE test_seq1 CACHE 10;
+SELECT nextval('test_seq1');
+SELECT nextval('test_seq1');
+SELECT last_value FROM test_seq1;
+-- setval and ALTER SEQUENCE throw away the shared values
+SELECT setval('test_seq1', 100);
+SELECT nextval('test_seq1');
+SELECT currval('test_seq1');
+ALTER SEQUENCE test_seq1 INCREMENT BY 5;
+SELECT nextval('test_seq1');
+SELECT nextval('test_seq1');
+DROP SEQUENCE test_seq1;
+RESET shared_sequence_cache;
@@ -214,6 +214,27 @@ SELECT * FROM check_estimated_rows('SELECT COUNT(*) FROM ndistinct GROUP BY b, c
 
 SELECT * FROM check_estimated_rows('SELECT COUNT(*) FROM ndistinct GROUP BY a, d');
 
+-- ndistinct coefficients for joins on several columns
+CREATE TABLE ndistinct_j1 (a INT, b INT);
+CREATE TABLE ndistinct_j2 (a INT, b INT);
+INSERT INTO ndistinct_j1 SELECT mod(i, 100), mod(i, 100) FROM generate_series(1, 1000) s(i);
+INSERT INTO ndistinct_j2 SELECT mod(i, 100), mod(i, 100) FROM generate_series(1, 1000) s(i);
+CREATE INDEX ndistinct_j1_expr ON ndistinct_j1 ((a + 1));
+ANALYZE ndistinct_j1, ndistinct_j2;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM ndistinct_j1 j1 JOIN ndistinct_j2 j2 ON (j1.a = j2.a AND j1.b = j2.b)');
+
+CREATE STATISTICS ndistinct_j1_stats (ndistinct) ON a, b FROM ndistinct_j1;
+CREATE STATISTICS ndistinct_j2_stats (ndistinct) ON a, b FROM ndistinct_j2;
+ANALYZE ndistinct_j1, ndistinct_j2;
+
+SELECT * FROM check_estimated_rows('SELECT * FROM ndistinct_j1 j1 JOIN ndistinct_j2 j2 ON (j1.a = j2.a AND j1.b = j2.b)');
+
+-- expressions are covered by the statistics on the columns they use
+SELECT * FROM check_estimated_rows('SELECT COUNT(*) FROM ndistinct_j1 GROUP BY (a + 1), b');
+
+DROP TABLE ndistinct_j1, ndistinct_j2;
+
 -- functional dependencies tests
 CREATE TABLE functional_dependencies (
     filler1 TEXT,
@@ -338,6 +338,10 @@ SELECT 'foo' LIKE '%__' as t, 'foo' LIKE '%___' as t, 'foo' LIKE '%____' as f;
 
 SELECT 'jack' LIKE '%____%' AS t;
 
+-- literal runs after % with several partial candidates
+SELECT 'abcabd' LIKE '%abd' AS t, 'abcabd' LIKE '%ab_d%' AS f, 'abcab' LIKE '%abd%' AS f;
+SELECT 'xaxab%ab' LIKE '%ab\%ab' AS t, 'ERROR: disk' ILIKE '%error%' AS t;
+
 
 --
 -- basic tests of LIKE with indexes
@@ -292,3 +292,28 @@ SET search_path TO 'pg_temp';
 BEGIN;
 SELECT current_schema() ~ 'pg_temp' AS is_temp_schema;
 PREPARE TRANSACTION 'twophase_search';
+
+-- Global temporary tables: the definition is shared by all sessions, but
+-- each session only sees the rows it has inserted itself.
+\c -
+create global temp table gtt (a int primary key, b text);
+insert into gtt values (1, 'one'), (2, 'two');
+select * from gtt order by a;
+select relname, relpersistence from pg_class
+  where relname in ('gtt', 'gtt_pkey') order by relname;
+\c -
+select * from gtt;
+insert into gtt values (1, 'uno'), (3, 'tres');
+insert into gtt values (1, 'dup');
+set enable_seqscan = off;
+select * from gtt where a = 3;
+reset enable_seqscan;
+truncate gtt;
+select count(*) from gtt;
+-- unsupported forms
+create global temp table gtt_del (a int) on commit delete rows;
+create table gtt_child () inherits (gtt);
+create table gtt_ref (a int references gtt);
+alter table gtt set logged;
+alter table gtt alter column a type bigint;
+drop table gtt;
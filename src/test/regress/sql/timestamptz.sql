@@ -156,6 +156,13 @@ SELECT 'Wed Jul 11 10:51:14 GMT+4 2001'::timestamptz;
 SELECT 'Wed Jul 11 10:51:14 PST-03:00 2001'::timestamptz;
 SELECT 'Wed Jul 11 10:51:14 PST+03:00 2001'::timestamptz;
 
+-- ISO 8601 input, which has its own fast path
+SELECT '2001-07-11 10:51:14'::timestamptz;
+SELECT '2001-07-11T10:51:14-04'::timestamptz;
+SELECT '2001-07-11 10:51:14.5+05:30'::timestamptz;
+SELECT '2001-07-11 10:51:14.1234567+00'::timestamptz;
+SELECT '2001-02-29 10:51:14'::timestamptz;
+
 SELECT '' AS "64", d1 FROM TIMESTAMPTZ_TBL;
 
 -- Check behavior at the lower boundary of the timestamp range
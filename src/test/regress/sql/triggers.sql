@@ -2209,3 +2209,35 @@ drop table self_ref;
 drop function dump_insert();
 drop function dump_update();
 drop function dump_delete();
+
+--
+-- Row events of one trigger for consecutive tuples are queued as a single
+-- run; check that they still fire once each, in order
+--
+create table trig_run (a int);
+create function trig_run_func() returns trigger language plpgsql as
+$$
+begin
+  if TG_OP = 'UPDATE' then
+    raise notice '% % -> %', TG_OP, old.a, new.a;
+  else
+    raise notice '% %', TG_OP, new.a;
+  end if;
+  return null;
+end$$;
+create constraint trigger trig_run_trig after insert or update on trig_run
+  deferrable initially deferred
+  for each row execute procedure trig_run_func();
+begin;
+insert into trig_run select generate_series(1, 5);
+update trig_run set a = a + 10;
+commit;
+begin;
+insert into trig_run values (1), (2);
+savepoint s;
+insert into trig_run values (3), (4);
+rollback to s;
+insert into trig_run values (5);
+commit;
+drop table trig_run;
+drop function trig_run_func();
@@ -440,3 +440,18 @@ select * from
    union all
    select *, 1 as x from int8_tbl b) ss
 where (x = 0) or (q1 >= q2 and q1 <= q2);
+
+--
+-- Test UNION with duplicates removed in parallel workers
+--
+set parallel_setup_cost = 0;
+set parallel_tuple_cost = 0;
+set min_parallel_table_scan_size = 0;
+set max_parallel_workers_per_gather = 2;
+explain (costs off)
+select four from tenk1 union select ten from tenk1;
+select four from tenk1 union select ten from tenk1 order by 1;
+REset max_parallel_workers_per_gather;
+REset min_parallel_table_scan_size;
+REset parallel_tuple_cost;
+REset parallel_setup_cost;
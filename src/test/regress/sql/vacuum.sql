@@ -121,6 +121,48 @@ SELECT pg_relation_size('vac_truncate_test') = 0;
 VACUUM (TRUNCATE FALSE, FULL TRUE) vac_truncate_test;
 DROP TABLE vac_truncate_test;
 
+-- PARALLEL option
+CREATE TABLE pvactst (i INT, a INT[], p POINT) with (autovacuum_enabled = off);
+INSERT INTO pvactst SELECT i, array[1,2,3], point(i, i+1) FROM generate_series(1,1000) i;
+CREATE INDEX btree_pvactst ON pvactst USING btree (i);
+CREATE INDEX hash_pvactst ON pvactst USING hash (i);
+CREATE INDEX brin_pvactst ON pvactst USING brin (i);
+CREATE INDEX gin_pvactst ON pvactst USING gin (a);
+CREATE INDEX gist_pvactst ON pvactst USING gist (p);
+CREATE INDEX spgist_pvactst ON pvactst USING spgist (p);
+-- let the workers vacuum even these small indexes
+SET min_parallel_index_scan_size TO 0;
+-- parallel index cleanup only
+VACUUM (PARALLEL 2) pvactst;
+-- parallel bulk-deletion and cleanup
+UPDATE pvactst SET i = i WHERE i < 1000;
+VACUUM (PARALLEL 2) pvactst;
+SELECT count(*) FROM pvactst WHERE i < 100;
+UPDATE pvactst SET i = i WHERE i < 1000;
+VACUUM (PARALLEL 0) pvactst; -- disable parallel vacuum
+VACUUM (PARALLEL -1) pvactst; -- error
+VACUUM (PARALLEL 2, INDEX_CLEANUP FALSE) pvactst;
+VACUUM (PARALLEL 2, FULL TRUE) pvactst; -- error, cannot use both PARALLEL and FULL
+VACUUM (PARALLEL) pvactst; -- error, cannot use PARALLEL option without parallel degree
+CREATE TEMPORARY TABLE tmp (a int PRIMARY KEY);
+CREATE INDEX tmp_idx1 ON tmp (a);
+VACUUM (PARALLEL 1, FULL FALSE) tmp; -- parallel vacuum disabled for temp tables
+VACUUM (PARALLEL 0, FULL TRUE) tmp; -- can specify parallel disabled (even though that's implied by FULL)
+-- parallel ANALYZE computes the same statistics as serial ANALYZE
+ANALYZE (PARALLEL 0) pvactst;
+CREATE TEMP TABLE pvactst_stats AS
+  SELECT attname, null_frac, n_distinct, most_common_vals::text AS mcv,
+         histogram_bounds::text AS hist, correlation
+  FROM pg_stats WHERE tablename = 'pvactst';
+ANALYZE (PARALLEL 2) pvactst;
+SELECT attname, null_frac, n_distinct, most_common_vals::text AS mcv,
+       histogram_bounds::text AS hist, correlation
+  FROM pg_stats WHERE tablename = 'pvactst'
+EXCEPT SELECT * FROM pvactst_stats;
+DROP TABLE pvactst_stats;
+RESET min_parallel_index_scan_size;
+DROP TABLE pvactst;
+
 -- partitioned table
 CREATE TABLE vacparted (a int, b char) PARTITION BY LIST (a);
 CREATE TABLE vacparted1 PARTITION OF vacparted FOR VALUES IN (1);
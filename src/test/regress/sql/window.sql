@@ -1257,3 +1257,19 @@ SELECT to_char(SUM(n::float8) OVER (ORDER BY i ROWS BETWEEN CURRENT ROW AND 1 FO
 SELECT i, b, bool_and(b) OVER w, bool_or(b) OVER w
   FROM (VALUES (1,true), (2,true), (3,false), (4,false), (5,true)) v(i,b)
   WINDOW w AS (ORDER BY i ROWS BETWEEN CURRENT ROW AND 1 FOLLOWING);
+
+-- min() and max() have no inverse transition functions, but follow a moving
+-- frame head without restarting
+SELECT i, v, min(v) OVER w, max(v) OVER w,
+       min(v::text) FILTER (WHERE i % 3 <> 0) OVER w AS min_filt
+  FROM (VALUES (1,5), (2,3), (3,NULL), (4,3), (5,8), (6,1), (7,NULL), (8,7), (9,2)) t(i,v)
+  WINDOW w AS (ORDER BY i ROWS BETWEEN 1 PRECEDING AND 2 FOLLOWING);
+
+-- compare with the restarting implementation, forced by a volatile argument
+SELECT count(*) FROM (
+  SELECT min(v) OVER w AS a, min(v + (random() * 0)::int) OVER w AS b,
+         max(v::text) OVER w AS c, max(v::text || left(random()::text, 0)) OVER w AS d
+    FROM (SELECT i, nullif((i * 7919) % 1013, 5) AS v
+            FROM generate_series(1, 2000) i) s
+    WINDOW w AS (ORDER BY i ROWS BETWEEN 25 PRECEDING AND 10 FOLLOWING)) x
+  WHERE a IS DISTINCT FROM b OR c IS DISTINCT FROM d;